@@ -9,6 +9,15 @@ const TranscodeMode = {
 	IfFormatNotSupported: 2,
 }
 
+// Keep in sync with Database::AudioCodec cpp
+const AudioCodec = {
+	MP3: 1,
+	Opus: 2,
+	Vorbis: 3,
+	FLAC: 4,
+}
+Object.freeze(AudioCodec);
+
 const Mode = {
 	Transcode: 1,
 	File: 2,
@@ -22,6 +31,9 @@ LMS.mediaplayer = function () {
 	var _offset = 0;
 	var _trackId = null;
 	var _duration = 0;
+	var _sessionDurations = [];	// current and next tracks being transcoded in the same session
+	var _sessionTrackStart = 0;	// audio time at which the current track started
+	var _sessionTrackEnded = false;
 	var _audioNativeSrc;
 	var _audioTranscodeSrc;
 	var _settings = {};
@@ -60,6 +72,10 @@ LMS.mediaplayer = function () {
 		_lastStartPlaying = null;
 	}
 
+	var _getCurrentTime = function() {
+		return _offset + _elems.audio.currentTime - _sessionTrackStart;
+	}
+
 	var _durationToString = function (duration) {
 		var minutes = parseInt(duration / 60, 10);
 		var seconds = parseInt(duration, 10) % 60;
@@ -120,6 +136,24 @@ LMS.mediaplayer = function () {
 		_setVolume(_elems.volumeslider.value);
 	}
 
+	// Only done once per session: the server picks the files that can be played directly
+	var _reportPlayableCodecs = function() {
+		const mimeTypes = [
+			{ codec: AudioCodec.MP3, type: "audio/mpeg" },
+			{ codec: AudioCodec.Opus, type: "audio/ogg; codecs=\"opus\"" },
+			{ codec: AudioCodec.Vorbis, type: "audio/ogg; codecs=\"vorbis\"" },
+			{ codec: AudioCodec.FLAC, type: "audio/flac" },
+		];
+
+		let codecs = [];
+		for (const mimeType of mimeTypes) {
+			if (_elems.audio.canPlayType(mimeType.type) != "")
+				codecs.push(mimeType.codec);
+		}
+
+		Wt.emit(_root, "codecsReported", codecs.join(","));
+	}
+
 	var _initDefaultSettings = function(defaultSettings) {
 		if (typeof(Storage) !== "undefined" && localStorage.settings) {
 			_settings = Object.assign(defaultSettings, JSON.parse(localStorage.settings));
@@ -205,6 +239,7 @@ LMS.mediaplayer = function () {
 			switch (mode) {
 				case Mode.Transcode:
 					_offset = selectedOffset;
+					_sessionTrackStart = 0;
 					_removeAudioSources();
 					_addAudioSource(_audioTranscodeSrc + "&offset=" + _offset);
 					_elems.audio.load();
@@ -228,8 +263,14 @@ LMS.mediaplayer = function () {
 		_elems.audio.addEventListener("waiting", _stopTimer);
 
 		_elems.audio.addEventListener("timeupdate", function() {
-			_elems.progress.style.width = "" + ((_offset + _elems.audio.currentTime) / _duration) * 100 + "%";
-			_elems.curtime.innerHTML = _durationToString(_offset + _elems.audio.currentTime);
+			_elems.progress.style.width = "" + (_getCurrentTime() / _duration) * 100 + "%";
+			_elems.curtime.innerHTML = _durationToString(_getCurrentTime());
+
+			// The next track directly follows in the same audio stream
+			if (_sessionDurations.length > 1 && !_sessionTrackEnded && _getCurrentTime() >= _sessionDurations[0]) {
+				_sessionTrackEnded = true;
+				Wt.emit(_root, "sessionTrackEnded");
+			}
 		});
 
 		_elems.audio.addEventListener("ended", function() {
@@ -246,6 +287,7 @@ LMS.mediaplayer = function () {
 		});
 
 		_initVolume();
+		_reportPlayableCodecs();
 		_initDefaultSettings(defaultSettings);
 
 		_elems.volumeslider.addEventListener("input", function() {
@@ -322,6 +364,16 @@ LMS.mediaplayer = function () {
 		_stopTimer();
 		_resetTimer();
 
+		const continueSession = params.continueSession && _sessionTrackEnded && _sessionDurations.length > 1;
+		if (continueSession) {
+			_sessionTrackStart += _sessionDurations.shift() - _offset;
+		}
+		else {
+			_sessionDurations = params.sessionDurations;
+			_sessionTrackStart = 0;
+		}
+		_sessionTrackEnded = false;
+
 		_trackId = params.trackId;
 		_offset = 0;
 		_duration = params.duration;
@@ -330,24 +382,39 @@ LMS.mediaplayer = function () {
 
 		_elems.seek.max = _duration;
 
-		_removeAudioSources();
-		// ! order is important
-		if (_settings.transcode.mode == TranscodeMode.Never || _settings.transcode.mode == TranscodeMode.IfFormatNotSupported)
-		{
-			_addAudioSource(_audioNativeSrc);
-		}
-		if (_settings.transcode.mode == TranscodeMode.Always || _settings.transcode.mode == TranscodeMode.IfFormatNotSupported)
-		{
-			_addAudioSource(_audioTranscodeSrc);
+		// Already playing the right audio stream
+		if (!continueSession) {
+			_removeAudioSources();
+			if (params.directPlay === true) {
+				_addAudioSource(_audioNativeSrc);
+			}
+			else if (params.directPlay === false) {
+				_addAudioSource(_audioTranscodeSrc);
+			}
+			else {
+				// ! order is important
+				if (_settings.transcode.mode == TranscodeMode.Never || _settings.transcode.mode == TranscodeMode.IfFormatNotSupported)
+				{
+					_addAudioSource(_audioNativeSrc);
+				}
+				if (_settings.transcode.mode == TranscodeMode.Always || _settings.transcode.mode == TranscodeMode.IfFormatNotSupported)
+				{
+					_addAudioSource(_audioTranscodeSrc);
+				}
+			}
+			_elems.audio.load();
 		}
-		_elems.audio.load();
 
 		_setReplayGain(params.replayGain);
 
-		_elems.curtime.innerHTML = _durationToString(_offset);
+		_elems.curtime.innerHTML = _durationToString(_getCurrentTime());
 		_elems.duration.innerHTML = _durationToString(_duration);
 
-		if (autoplay && _audioCtx.state == "running")
+		if (continueSession) {
+			if (!_elems.audio.paused)
+				_startTimer();
+		}
+		else if (autoplay && _audioCtx.state == "running")
 			_playTrack();
 
 		if ('mediaSession' in navigator) {
@@ -0,0 +1,873 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LibAvTranscoder.hpp"
+
+extern "C"
+{
+#define __STDC_CONSTANT_MACROS
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/audio_fifo.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/dict.h>
+#include <libavutil/error.h>
+#include <libswresample/swresample.h>
+}
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Wt/WIOService.h>
+
+#include "av/Types.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Service.hpp"
+
+// AVChannelLayout replaced the channel masks in libavutil 57.24 (ffmpeg 5.1)
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 24, 100)
+#define LMS_AV_HAS_CHANNEL_LAYOUT
+#endif
+
+namespace Av
+{
+#define LOG(sev)	LMS_LOG(TRANSCODE, sev) << "[libav " << _id << "] - "
+
+	namespace
+	{
+		std::atomic<std::size_t> globalId {};
+
+		// ffmpeg 7 made the avio write buffer const
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+		using AvioWriteBuffer = const std::uint8_t*;
+#else
+		using AvioWriteBuffer = std::uint8_t*;
+#endif
+
+		std::string
+		averrorToString(int error)
+		{
+			std::array<char, 128> buf = {0};
+
+			if (av_strerror(error, buf.data(), buf.size()) == 0)
+				return buf.data();
+
+			return "Unknown error";
+		}
+
+		class LibAvException : public Exception
+		{
+			public:
+				LibAvException(const std::string& operation, int avError)
+					: Exception {operation + ": " + averrorToString(avError)}
+				{}
+		};
+
+		struct InputContextDeleter
+		{
+			void operator()(AVFormatContext* context) const { avformat_close_input(&context); }
+		};
+
+		struct OutputContextDeleter
+		{
+			void operator()(AVFormatContext* context) const
+			{
+				if (context->pb)
+				{
+					av_freep(&context->pb->buffer);
+					avio_context_free(&context->pb);
+				}
+				avformat_free_context(context);
+			}
+		};
+
+		struct CodecContextDeleter
+		{
+			void operator()(AVCodecContext* context) const { avcodec_free_context(&context); }
+		};
+
+		struct ResamplerDeleter
+		{
+			void operator()(SwrContext* context) const { swr_free(&context); }
+		};
+
+		struct FifoDeleter
+		{
+			void operator()(AVAudioFifo* fifo) const { av_audio_fifo_free(fifo); }
+		};
+
+		struct PacketDeleter
+		{
+			void operator()(AVPacket* packet) const { av_packet_free(&packet); }
+		};
+
+		struct FrameDeleter
+		{
+			void operator()(AVFrame* frame) const { av_frame_free(&frame); }
+		};
+
+		// Reused across frames, only grows
+		class SampleBuffer
+		{
+			public:
+				SampleBuffer() = default;
+				~SampleBuffer() { release(); }
+
+				SampleBuffer(const SampleBuffer&) = delete;
+				SampleBuffer& operator=(const SampleBuffer&) = delete;
+				SampleBuffer(SampleBuffer&&) = delete;
+				SampleBuffer& operator=(SampleBuffer&&) = delete;
+
+				std::uint8_t** reserve(int channelCount, int sampleCount, AVSampleFormat format)
+				{
+					if (sampleCount > _capacity)
+					{
+						release();
+
+						const int error {av_samples_alloc_array_and_samples(&_data, nullptr, channelCount, sampleCount, format, 0)};
+						if (error < 0)
+							throw LibAvException {"Cannot allocate samples", error};
+
+						_capacity = sampleCount;
+					}
+
+					return _data;
+				}
+
+			private:
+				void release()
+				{
+					if (_data)
+					{
+						av_freep(&_data[0]);
+						av_freep(&_data);
+					}
+					_capacity = 0;
+				}
+
+				std::uint8_t**	_data {};
+				int				_capacity {};
+		};
+
+		struct OutputFormat
+		{
+			const char* encoderName;
+			const char* muxerName;
+		};
+
+		OutputFormat
+		getOutputFormat(Format format)
+		{
+			switch (format)
+			{
+				case Format::MP3:			return {"libmp3lame", "mp3"};
+				case Format::OGG_OPUS:		return {"libopus", "ogg"};
+				case Format::MATROSKA_OPUS:	return {"libopus", "matroska"};
+				case Format::OGG_VORBIS:	return {"libvorbis", "ogg"};
+				case Format::WEBM_VORBIS:	return {"libvorbis", "webm"};
+				case Format::MPEGTS_MP3:	return {"libmp3lame", "mpegts"};
+			}
+
+			throw Exception {"Unhandled format (" + std::to_string(static_cast<int>(format)) + ")"};
+		}
+
+		int
+		selectSampleRate(const AVCodec* encoder, int inputSampleRate)
+		{
+			if (!encoder->supported_samplerates)
+				return inputSampleRate;
+
+			int bestSampleRate {};
+			for (const int* sampleRate {encoder->supported_samplerates}; *sampleRate; ++sampleRate)
+			{
+				if (*sampleRate == inputSampleRate)
+					return inputSampleRate;
+
+				if (!bestSampleRate || std::abs(*sampleRate - inputSampleRate) < std::abs(bestSampleRate - inputSampleRate))
+					bestSampleRate = *sampleRate;
+			}
+
+			return bestSampleRate;
+		}
+
+		AVSampleFormat
+		selectSampleFormat(const AVCodec* encoder, AVSampleFormat inputSampleFormat)
+		{
+			if (!encoder->sample_fmts)
+				return inputSampleFormat;
+
+			for (const AVSampleFormat* sampleFormat {encoder->sample_fmts}; *sampleFormat != AV_SAMPLE_FMT_NONE; ++sampleFormat)
+			{
+				if (*sampleFormat == inputSampleFormat)
+					return inputSampleFormat;
+			}
+
+			return encoder->sample_fmts[0];
+		}
+
+		int
+		getChannelCount(const AVCodecContext& context)
+		{
+#ifdef LMS_AV_HAS_CHANNEL_LAYOUT
+			return context.ch_layout.nb_channels;
+#else
+			return context.channels;
+#endif
+		}
+
+		void
+		copyChannelLayout(const AVCodecContext& context, AVFrame& frame)
+		{
+#ifdef LMS_AV_HAS_CHANNEL_LAYOUT
+			av_channel_layout_copy(&frame.ch_layout, &context.ch_layout);
+#else
+			frame.channel_layout = context.channel_layout;
+			frame.channels = context.channels;
+#endif
+		}
+
+		Wt::WIOService&
+		getWorkerPool()
+		{
+			static const std::unique_ptr<Wt::WIOService> workerPool {[]
+			{
+				std::size_t threadCount {Service<IConfig>::get()->getULong("transcoder-libav-thread-count", 0)};
+				if (threadCount == 0)
+					threadCount = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+
+				LMS_LOG(TRANSCODE, INFO) << "Using " << threadCount << " transcoding worker(s)";
+
+				auto ioService {std::make_unique<Wt::WIOService>()};
+				ioService->setThreadCount(threadCount);
+				ioService->start();
+
+				return ioService;
+			}()};
+
+			return *workerPool;
+		}
+	}
+
+	// All the libav objects of a transcode, only used by one worker at a time
+	class LibAvTranscoder::Engine
+	{
+		public:
+			Engine(const std::vector<std::filesystem::path>& filePaths, const TranscodeParameters& parameters);
+
+			Engine(const Engine&) = delete;
+			Engine& operator=(const Engine&) = delete;
+			Engine(Engine&&) = delete;
+			Engine& operator=(Engine&&) = delete;
+
+			// Not called if aborted
+			void read(std::byte* buffer, std::size_t bufferSize, const ReadCallback& readCallback);
+			void abort();
+
+			bool finished() const { return _finished; }
+			bool succeeded() const { return !_failed; }
+
+		private:
+			void openInput(const std::filesystem::path& filePath, const TranscodeParameters& parameters);
+			void openEncoder(const TranscodeParameters& parameters, const OutputFormat& outputFormat);
+			void openOutput(const TranscodeParameters& parameters, const OutputFormat& outputFormat);
+			void openResampler();
+			bool openNextInput();	// false if no more input
+
+			std::size_t fill(std::byte* buffer, std::size_t bufferSize);
+			void transcodeStep();
+			void finish();
+			void decode(AVPacket* packet);			// nullptr flushes
+			void resample(const AVFrame* frame);	// nullptr flushes
+			void encodeFifo(bool flush);
+			void encode(AVFrame* frame);			// nullptr flushes
+
+			static int writeOutput(void* opaque, AvioWriteBuffer data, int dataSize);
+
+			const std::size_t _id;
+			const std::vector<std::filesystem::path> _filePaths;
+
+			std::size_t												_inputIndex {};
+			std::unique_ptr<AVFormatContext, InputContextDeleter>	_inputContext;
+			int														_inputStreamIndex {-1};
+			std::int64_t											_skipUntilPts {AV_NOPTS_VALUE};	// partial transcode, in input stream time base
+			std::int64_t											_stopAtPts {AV_NOPTS_VALUE};	// same
+			bool													_durationReached {};
+			std::unique_ptr<AVCodecContext, CodecContextDeleter>	_decoderContext;
+			std::unique_ptr<AVCodecContext, CodecContextDeleter>	_encoderContext;
+			std::unique_ptr<AVFormatContext, OutputContextDeleter>	_outputContext;
+			std::unique_ptr<SwrContext, ResamplerDeleter>			_resampler;
+			std::unique_ptr<AVAudioFifo, FifoDeleter>				_fifo;
+			std::unique_ptr<AVPacket, PacketDeleter>				_inputPacket {av_packet_alloc()};
+			std::unique_ptr<AVPacket, PacketDeleter>				_outputPacket {av_packet_alloc()};
+			std::unique_ptr<AVFrame, FrameDeleter>					_decodedFrame {av_frame_alloc()};
+			std::unique_ptr<AVFrame, FrameDeleter>					_encoderFrame {av_frame_alloc()};
+			SampleBuffer											_resampledSamples;
+			int														_encoderFrameSize {};
+			std::int64_t											_nextPts {};
+
+			std::mutex				_mutex;		// held while filling and calling back
+			bool					_aborted {};
+			bool					_outputComplete {};
+			std::atomic<bool>		_finished {};
+			std::atomic<bool>		_failed {};		// set before _finished
+
+			// Encoded data goes straight to the reader's buffer, the overflow is kept for the next read
+			std::byte*				_outputBuffer {};
+			std::size_t				_outputBufferSize {};
+			std::size_t				_outputBufferUsed {};
+			std::vector<std::byte>	_pendingOutput;
+			std::size_t				_pendingOutputOffset {};
+	};
+
+	LibAvTranscoder::Engine::Engine(const std::vector<std::filesystem::path>& filePaths, const TranscodeParameters& parameters)
+		: _id {globalId++}
+		, _filePaths {filePaths}
+	{
+		if (_filePaths.empty())
+			throw Exception {"No file to transcode"};
+
+		if (!_inputPacket || !_outputPacket || !_decodedFrame || !_encoderFrame)
+			throw Exception {"Cannot allocate packets and frames"};
+
+		LOG(INFO) << "Transcoding file '" << _filePaths.front().string() << "'";
+
+		const OutputFormat outputFormat {getOutputFormat(parameters.format)};
+
+		openInput(_filePaths.front(), parameters);
+		openEncoder(parameters, outputFormat);
+		openOutput(parameters, outputFormat);
+		openResampler();
+	}
+
+	void
+	LibAvTranscoder::Engine::openInput(const std::filesystem::path& filePath, const TranscodeParameters& parameters)
+	{
+		_skipUntilPts = AV_NOPTS_VALUE;
+		_stopAtPts = AV_NOPTS_VALUE;
+
+		{
+			AVFormatContext* inputContext {};
+			const int error {avformat_open_input(&inputContext, filePath.c_str(), nullptr, nullptr)};
+			if (error < 0)
+				throw LibAvException {"Cannot open '" + filePath.string() + "'", error};
+			_inputContext.reset(inputContext);
+		}
+
+		int error {avformat_find_stream_info(_inputContext.get(), nullptr)};
+		if (error < 0)
+			throw LibAvException {"Cannot find stream information", error};
+
+		_inputStreamIndex = parameters.stream ? static_cast<int>(*parameters.stream) : av_find_best_stream(_inputContext.get(), AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+		if (_inputStreamIndex < 0 || static_cast<unsigned>(_inputStreamIndex) >= _inputContext->nb_streams)
+			throw Exception {"Cannot find audio stream"};
+
+		AVStream* inputStream {_inputContext->streams[_inputStreamIndex]};
+		if (inputStream->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+			throw Exception {"Stream " + std::to_string(_inputStreamIndex) + " is not an audio stream"};
+
+		// Other streams (covers, etc.) are not even demuxed
+		for (unsigned i {}; i < _inputContext->nb_streams; ++i)
+		{
+			if (static_cast<int>(i) != _inputStreamIndex)
+				_inputContext->streams[i]->discard = AVDISCARD_ALL;
+		}
+
+		const AVCodec* decoder {avcodec_find_decoder(inputStream->codecpar->codec_id)};
+		if (!decoder)
+			throw Exception {"Cannot find decoder"};
+
+		_decoderContext.reset(avcodec_alloc_context3(decoder));
+		if (!_decoderContext)
+			throw Exception {"Cannot allocate decoder context"};
+
+		error = avcodec_parameters_to_context(_decoderContext.get(), inputStream->codecpar);
+		if (error < 0)
+			throw LibAvException {"Cannot set decoder parameters", error};
+		_decoderContext->pkt_timebase = inputStream->time_base;
+
+		error = avcodec_open2(_decoderContext.get(), decoder, nullptr);
+		if (error < 0)
+			throw LibAvException {"Cannot open decoder", error};
+
+		if (parameters.offset.count() > 0)
+		{
+			// Seek to the previous key frame, then drop the decoded frames until the requested offset
+			const std::int64_t timestamp {av_rescale_q(parameters.offset.count(), AVRational {1, 1000}, AV_TIME_BASE_Q)};
+			error = avformat_seek_file(_inputContext.get(), -1, INT64_MIN, timestamp, timestamp, 0);
+			if (error < 0)
+				LOG(WARNING) << "Cannot seek to offset " << parameters.offset.count() << "ms: " << averrorToString(error);
+			else
+				_skipUntilPts = av_rescale_q(parameters.offset.count(), AVRational {1, 1000}, inputStream->time_base);
+		}
+
+		if (parameters.duration)
+			_stopAtPts = av_rescale_q((parameters.offset + *parameters.duration).count(), AVRational {1, 1000}, inputStream->time_base);
+	}
+
+	void
+	LibAvTranscoder::Engine::openEncoder(const TranscodeParameters& parameters, const OutputFormat& outputFormat)
+	{
+		const AVCodec* encoder {avcodec_find_encoder_by_name(outputFormat.encoderName)};
+		if (!encoder)
+			throw Exception {"Cannot find encoder '" + std::string {outputFormat.encoderName} + "'"};
+
+		_encoderContext.reset(avcodec_alloc_context3(encoder));
+		if (!_encoderContext)
+			throw Exception {"Cannot allocate encoder context"};
+
+		// Mono stays mono, everything else is downmixed to stereo
+		const int channelCount {std::min(getChannelCount(*_decoderContext), 2)};
+#ifdef LMS_AV_HAS_CHANNEL_LAYOUT
+		av_channel_layout_default(&_encoderContext->ch_layout, channelCount);
+#else
+		_encoderContext->channel_layout = av_get_default_channel_layout(channelCount);
+		_encoderContext->channels = channelCount;
+#endif
+		_encoderContext->sample_rate = selectSampleRate(encoder, parameters.encoder.sampleRate ? static_cast<int>(*parameters.encoder.sampleRate) : _decoderContext->sample_rate);
+		_encoderContext->sample_fmt = selectSampleFormat(encoder, _decoderContext->sample_fmt);
+		_encoderContext->bit_rate = parameters.bitrate;
+		_encoderContext->time_base = AVRational {1, _encoderContext->sample_rate};
+
+		const AVOutputFormat* muxer {av_guess_format(outputFormat.muxerName, nullptr, nullptr)};
+		if (muxer && (muxer->flags & AVFMT_GLOBALHEADER))
+			_encoderContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+		if (parameters.encoder.compressionLevel)
+			_encoderContext->compression_level = static_cast<int>(*parameters.encoder.compressionLevel);
+
+		AVDictionary* encoderOptions {};
+		if (parameters.encoder.frameDuration && (parameters.format == Format::OGG_OPUS || parameters.format == Format::MATROSKA_OPUS))
+			av_dict_set(&encoderOptions, "frame_duration", std::to_string(parameters.encoder.frameDuration->count()).c_str(), 0);
+
+		const int error {avcodec_open2(_encoderContext.get(), encoder, &encoderOptions)};
+		av_dict_free(&encoderOptions);
+		if (error < 0)
+			throw LibAvException {"Cannot open encoder", error};
+
+		const bool hasVariableFrameSize {(encoder->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE) || _encoderContext->frame_size <= 0};
+		_encoderFrameSize = hasVariableFrameSize ? 4096 : _encoderContext->frame_size;
+
+		_fifo.reset(av_audio_fifo_alloc(_encoderContext->sample_fmt, getChannelCount(*_encoderContext), _encoderFrameSize));
+		if (!_fifo)
+			throw Exception {"Cannot allocate fifo"};
+	}
+
+	void
+	LibAvTranscoder::Engine::openOutput(const TranscodeParameters& parameters, const OutputFormat& outputFormat)
+	{
+		{
+			AVFormatContext* outputContext {};
+			const int error {avformat_alloc_output_context2(&outputContext, nullptr, outputFormat.muxerName, nullptr)};
+			if (error < 0)
+				throw LibAvException {"Cannot allocate output context", error};
+			_outputContext.reset(outputContext);
+		}
+
+		// Muxed data is given to writeOutput
+		{
+			constexpr int ioBufferSize {32768};
+			unsigned char* ioBuffer {static_cast<unsigned char*>(av_malloc(ioBufferSize))};
+			if (!ioBuffer)
+				throw Exception {"Cannot allocate io buffer"};
+
+			_outputContext->pb = avio_alloc_context(ioBuffer, ioBufferSize, 1, this, nullptr, &Engine::writeOutput, nullptr);
+			if (!_outputContext->pb)
+			{
+				av_free(ioBuffer);
+				throw Exception {"Cannot allocate io context"};
+			}
+		}
+
+		AVStream* outputStream {avformat_new_stream(_outputContext.get(), nullptr)};
+		if (!outputStream)
+			throw Exception {"Cannot create output stream"};
+
+		int error {avcodec_parameters_from_context(outputStream->codecpar, _encoderContext.get())};
+		if (error < 0)
+			throw LibAvException {"Cannot set output stream parameters", error};
+		outputStream->time_base = _encoderContext->time_base;
+
+		// Segments of a stream are timestamped with their position in the track
+		if (parameters.format == Format::MPEGTS_MP3)
+			_outputContext->output_ts_offset = av_rescale_q(parameters.offset.count(), AVRational {1, 1000}, AV_TIME_BASE_Q);
+
+		if (!parameters.stripMetadata)
+		{
+			av_dict_copy(&_outputContext->metadata, _inputContext->metadata, 0);
+			av_dict_copy(&outputStream->metadata, _inputContext->streams[_inputStreamIndex]->metadata, 0);
+		}
+
+		error = avformat_write_header(_outputContext.get(), nullptr);
+		if (error < 0)
+			throw LibAvException {"Cannot write header", error};
+	}
+
+	void
+	LibAvTranscoder::Engine::openResampler()
+	{
+#ifdef LMS_AV_HAS_CHANNEL_LAYOUT
+		AVChannelLayout inputChannelLayout {};
+		if (_decoderContext->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC)
+			av_channel_layout_default(&inputChannelLayout, _decoderContext->ch_layout.nb_channels);
+		else
+			av_channel_layout_copy(&inputChannelLayout, &_decoderContext->ch_layout);
+
+		SwrContext* resampler {};
+		const int error {swr_alloc_set_opts2(&resampler,
+				&_encoderContext->ch_layout, _encoderContext->sample_fmt, _encoderContext->sample_rate,
+				&inputChannelLayout, _decoderContext->sample_fmt, _decoderContext->sample_rate,
+				0, nullptr)};
+		av_channel_layout_uninit(&inputChannelLayout);
+		if (error < 0)
+			throw LibAvException {"Cannot allocate resampler", error};
+#else
+		const std::int64_t inputChannelLayout {_decoderContext->channel_layout ? static_cast<std::int64_t>(_decoderContext->channel_layout) : av_get_default_channel_layout(_decoderContext->channels)};
+
+		SwrContext* resampler {swr_alloc_set_opts(nullptr,
+				_encoderContext->channel_layout, _encoderContext->sample_fmt, _encoderContext->sample_rate,
+				inputChannelLayout, _decoderContext->sample_fmt, _decoderContext->sample_rate,
+				0, nullptr)};
+		if (!resampler)
+			throw Exception {"Cannot allocate resampler"};
+#endif
+		_resampler.reset(resampler);
+
+		const int error {swr_init(_resampler.get())};
+		if (error < 0)
+			throw LibAvException {"Cannot init resampler", error};
+	}
+
+	bool
+	LibAvTranscoder::Engine::openNextInput()
+	{
+		// The fifo and the encoder are kept as is, so that the next file directly follows
+		decode(nullptr);
+		resample(nullptr);
+
+		// Next files are entirely transcoded, using their best audio stream
+		const TranscodeParameters parameters {};
+
+		while (++_inputIndex < _filePaths.size())
+		{
+			const std::filesystem::path& filePath {_filePaths[_inputIndex]};
+
+			try
+			{
+				openInput(filePath, parameters);
+				openResampler();
+			}
+			catch (const Exception& e)
+			{
+				LOG(ERROR) << "Skipping file '" << filePath.string() << "': " << e.what();
+				continue;
+			}
+
+			const std::int64_t startSample {_nextPts + av_audio_fifo_size(_fifo.get())};
+			LOG(INFO) << "Transcoding file '" << filePath.string() << "', starting at " << av_rescale(startSample, 1000, _encoderContext->sample_rate) << "ms";
+
+			return true;
+		}
+
+		return false;
+	}
+
+	void
+	LibAvTranscoder::Engine::read(std::byte* buffer, std::size_t bufferSize, const ReadCallback& readCallback)
+	{
+		std::scoped_lock lock {_mutex};
+		if (_aborted)
+			return;
+
+		readCallback(fill(buffer, bufferSize));
+	}
+
+	void
+	LibAvTranscoder::Engine::abort()
+	{
+		// waits for the running read, if any
+		std::scoped_lock lock {_mutex};
+		_aborted = true;
+	}
+
+	std::size_t
+	LibAvTranscoder::Engine::fill(std::byte* buffer, std::size_t bufferSize)
+	{
+		_outputBuffer = buffer;
+		_outputBufferSize = bufferSize;
+		_outputBufferUsed = 0;
+
+		if (_pendingOutputOffset < _pendingOutput.size())
+		{
+			const std::size_t size {std::min(bufferSize, _pendingOutput.size() - _pendingOutputOffset)};
+			std::memcpy(_outputBuffer, _pendingOutput.data() + _pendingOutputOffset, size);
+			_outputBufferUsed = size;
+
+			_pendingOutputOffset += size;
+			if (_pendingOutputOffset == _pendingOutput.size())
+			{
+				_pendingOutput.clear();
+				_pendingOutputOffset = 0;
+			}
+		}
+
+		try
+		{
+			while (_outputBufferUsed < _outputBufferSize && !_outputComplete)
+				transcodeStep();
+		}
+		catch (const Exception& e)
+		{
+			LOG(ERROR) << "Transcode failed: " << e.what();
+			_failed = true;
+			_outputComplete = true;
+		}
+
+		const std::size_t nbBytesRead {_outputBufferUsed};
+
+		_outputBuffer = nullptr;
+		_outputBufferSize = 0;
+		_outputBufferUsed = 0;
+
+		if (_outputComplete && _pendingOutput.empty())
+		{
+			LOG(DEBUG) << "Transcode complete";
+			_finished = true;
+		}
+
+		return nbBytesRead;
+	}
+
+	void
+	LibAvTranscoder::Engine::transcodeStep()
+	{
+		if (_durationReached)
+		{
+			finish();
+			return;
+		}
+
+		const int error {av_read_frame(_inputContext.get(), _inputPacket.get())};
+		if (error == AVERROR_EOF)
+		{
+			if (!openNextInput())
+				finish();
+			return;
+		}
+		if (error < 0)
+			throw LibAvException {"Cannot read input", error};
+
+		if (_inputPacket->stream_index == _inputStreamIndex)
+			decode(_inputPacket.get());
+		av_packet_unref(_inputPacket.get());
+
+		// make the muxed data available right now
+		avio_flush(_outputContext->pb);
+	}
+
+	void
+	LibAvTranscoder::Engine::finish()
+	{
+		decode(nullptr);
+		resample(nullptr);
+		encodeFifo(true);
+		encode(nullptr);
+
+		const int error {av_write_trailer(_outputContext.get())};
+		if (error < 0)
+			throw LibAvException {"Cannot write trailer", error};
+
+		avio_flush(_outputContext->pb);
+		_outputComplete = true;
+	}
+
+	void
+	LibAvTranscoder::Engine::decode(AVPacket* packet)
+	{
+		int error {avcodec_send_packet(_decoderContext.get(), packet)};
+		if (error < 0 && error != AVERROR_EOF)
+		{
+			// Corrupted packets are just skipped
+			LOG(WARNING) << "Cannot decode packet: " << averrorToString(error);
+			return;
+		}
+
+		while (true)
+		{
+			error = avcodec_receive_frame(_decoderContext.get(), _decodedFrame.get());
+			if (error == AVERROR(EAGAIN) || error == AVERROR_EOF)
+				break;
+			if (error < 0)
+				throw LibAvException {"Cannot receive decoded frame", error};
+
+			const std::int64_t pts {_decodedFrame->best_effort_timestamp};
+			if (_stopAtPts != AV_NOPTS_VALUE && pts != AV_NOPTS_VALUE && pts >= _stopAtPts)
+				_durationReached = true;
+
+			const bool skip {_durationReached || (_skipUntilPts != AV_NOPTS_VALUE && pts != AV_NOPTS_VALUE && pts < _skipUntilPts)};
+			if (!skip)
+			{
+				resample(_decodedFrame.get());
+				encodeFifo(false);
+			}
+
+			av_frame_unref(_decodedFrame.get());
+		}
+	}
+
+	void
+	LibAvTranscoder::Engine::resample(const AVFrame* frame)
+	{
+		const int inputSampleCount {frame ? frame->nb_samples : 0};
+		const int maxOutputSampleCount {swr_get_out_samples(_resampler.get(), inputSampleCount)};
+		if (maxOutputSampleCount <= 0)
+			return;
+
+		std::uint8_t** samples {_resampledSamples.reserve(getChannelCount(*_encoderContext), maxOutputSampleCount, _encoderContext->sample_fmt)};
+
+		const int outputSampleCount {swr_convert(_resampler.get(), samples, maxOutputSampleCount,
+				frame ? const_cast<const std::uint8_t**>(frame->extended_data) : nullptr, inputSampleCount)};
+		if (outputSampleCount < 0)
+			throw LibAvException {"Cannot resample", outputSampleCount};
+
+		if (av_audio_fifo_write(_fifo.get(), reinterpret_cast<void**>(samples), outputSampleCount) < outputSampleCount)
+			throw Exception {"Cannot write samples in fifo"};
+	}
+
+	void
+	LibAvTranscoder::Engine::encodeFifo(bool flush)
+	{
+		while (av_audio_fifo_size(_fifo.get()) >= _encoderFrameSize || (flush && av_audio_fifo_size(_fifo.get()) > 0))
+		{
+			const int sampleCount {std::min(av_audio_fifo_size(_fifo.get()), _encoderFrameSize)};
+
+			AVFrame* frame {_encoderFrame.get()};
+			av_frame_unref(frame);
+			frame->nb_samples = sampleCount;
+			frame->format = _encoderContext->sample_fmt;
+			frame->sample_rate = _encoderContext->sample_rate;
+			copyChannelLayout(*_encoderContext, *frame);
+
+			int error {av_frame_get_buffer(frame, 0)};
+			if (error < 0)
+				throw LibAvException {"Cannot allocate frame", error};
+
+			if (av_audio_fifo_read(_fifo.get(), reinterpret_cast<void**>(frame->data), sampleCount) < sampleCount)
+				throw Exception {"Cannot read samples from fifo"};
+
+			frame->pts = _nextPts;
+			_nextPts += sampleCount;
+
+			encode(frame);
+		}
+	}
+
+	void
+	LibAvTranscoder::Engine::encode(AVFrame* frame)
+	{
+		int error {avcodec_send_frame(_encoderContext.get(), frame)};
+		if (error < 0 && error != AVERROR_EOF)
+			throw LibAvException {"Cannot encode frame", error};
+
+		while (true)
+		{
+			error = avcodec_receive_packet(_encoderContext.get(), _outputPacket.get());
+			if (error == AVERROR(EAGAIN) || error == AVERROR_EOF)
+				break;
+			if (error < 0)
+				throw LibAvException {"Cannot receive encoded packet", error};
+
+			_outputPacket->stream_index = 0;
+			av_packet_rescale_ts(_outputPacket.get(), _encoderContext->time_base, _outputContext->streams[0]->time_base);
+
+			// takes ownership of the packet data
+			error = av_interleaved_write_frame(_outputContext.get(), _outputPacket.get());
+			if (error < 0)
+				throw LibAvException {"Cannot write packet", error};
+		}
+	}
+
+	int
+	LibAvTranscoder::Engine::writeOutput(void* opaque, AvioWriteBuffer data, int dataSize)
+	{
+		Engine& engine {*static_cast<Engine*>(opaque)};
+		const std::byte* bytes {reinterpret_cast<const std::byte*>(data)};
+		const std::size_t size {static_cast<std::size_t>(dataSize)};
+
+		const std::size_t directSize {std::min(size, engine._outputBufferSize - engine._outputBufferUsed)};
+		if (directSize > 0)
+		{
+			std::memcpy(engine._outputBuffer + engine._outputBufferUsed, bytes, directSize);
+			engine._outputBufferUsed += directSize;
+		}
+
+		engine._pendingOutput.insert(std::end(engine._pendingOutput), bytes + directSize, bytes + size);
+
+		return dataSize;
+	}
+
+	LibAvTranscoder::LibAvTranscoder(const std::filesystem::path& filePath, const TranscodeParameters& parameters)
+		: LibAvTranscoder {std::vector<std::filesystem::path> {filePath}, parameters}
+	{
+	}
+
+	LibAvTranscoder::LibAvTranscoder(const std::vector<std::filesystem::path>& filePaths, const TranscodeParameters& parameters)
+		: _parameters {parameters}
+		, _outputMimeType {formatToMimetype(parameters.format)}
+		, _engine {std::make_shared<Engine>(filePaths, parameters)}
+	{
+	}
+
+	LibAvTranscoder::~LibAvTranscoder()
+	{
+		// Pending reads may still hold the engine
+		_engine->abort();
+	}
+
+	void
+	LibAvTranscoder::asyncRead(std::byte* buffer, std::size_t bufferSize, ReadCallback readCallback)
+	{
+		getWorkerPool().post([engine = _engine, buffer, bufferSize, readCallback = std::move(readCallback)]
+		{
+			engine->read(buffer, bufferSize, readCallback);
+		});
+	}
+
+	bool
+	LibAvTranscoder::finished() const
+	{
+		return _engine->finished();
+	}
+
+	bool
+	LibAvTranscoder::succeeded() const
+	{
+		return _engine->succeeded();
+	}
+
+} // namespace Av
+
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "av/ITranscoder.hpp"
+#include "av/TranscodeParameters.hpp"
+
+namespace Av
+{
+	// Transcodes in process using libavcodec/libswresample
+	// Work is done on a shared pool of threads, only when the output is read
+	class LibAvTranscoder final : public ITranscoder
+	{
+		public:
+			LibAvTranscoder(const std::filesystem::path& file, const TranscodeParameters& parameters);
+			// Files are decoded one after the other into the same encoder, the offset only applies to the first one
+			LibAvTranscoder(const std::vector<std::filesystem::path>& files, const TranscodeParameters& parameters);
+			~LibAvTranscoder();
+
+			LibAvTranscoder(const LibAvTranscoder&) = delete;
+			LibAvTranscoder& operator=(const LibAvTranscoder&) = delete;
+			LibAvTranscoder(LibAvTranscoder&&) = delete;
+			LibAvTranscoder& operator=(LibAvTranscoder&&) = delete;
+
+			// The encoded output is directly written in the given buffer
+			void	asyncRead(std::byte* buffer, std::size_t bufferSize, ReadCallback) override;
+
+			const std::string&	getOutputMimeType() const override { return _outputMimeType; }
+			const TranscodeParameters& getParameters() const override { return _parameters; }
+
+			bool	finished() const override;
+			bool	succeeded() const override;
+
+		private:
+			class Engine;
+
+			const TranscodeParameters	_parameters;
+			const std::string			_outputMimeType;
+			std::shared_ptr<Engine>		_engine;	// shared with the pending jobs
+	};
+
+} // namespace Av
+
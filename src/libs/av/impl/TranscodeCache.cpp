@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TranscodeCache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+#include <Wt/Utils.h>
+
+#include "utils/IConfig.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Service.hpp"
+
+namespace Av
+{
+	namespace
+	{
+		const std::filesystem::path tmpFileExtension {".part"};
+
+		std::filesystem::path
+		getTmpPath(const std::filesystem::path& entryPath)
+		{
+			static std::atomic<std::size_t> counter {};
+
+			std::filesystem::path tmpPath {entryPath};
+			tmpPath += "-" + std::to_string(counter++);
+			tmpPath += tmpFileExtension;
+
+			return tmpPath;
+		}
+	}
+
+	TranscodeCache::TranscodeCache(const std::filesystem::path& directory, std::uintmax_t maxSize)
+		: _directory {directory}
+		, _maxSize {maxSize}
+	{
+		loadEntries();
+
+		LMS_LOG(TRANSCODE, INFO) << "Transcode cache: " << _entries.size() << " entries, size = " << _size / (1000 * 1000) << "/" << _maxSize / (1000 * 1000) << " MB";
+	}
+
+	TranscodeCache*
+	TranscodeCache::getInstance()
+	{
+		static const std::unique_ptr<TranscodeCache> instance {[]() -> std::unique_ptr<TranscodeCache>
+		{
+			const std::uintmax_t maxSize {static_cast<std::uintmax_t>(Service<IConfig>::get()->getULong("transcode-cache-size", 500)) * 1000 * 1000};
+			if (maxSize == 0)
+				return {};
+
+			try
+			{
+				return std::make_unique<TranscodeCache>(Service<IConfig>::get()->getPath("working-dir") / "cache" / "transcode", maxSize);
+			}
+			catch (const std::filesystem::filesystem_error& e)
+			{
+				LMS_LOG(TRANSCODE, ERROR) << "Cannot set up transcode cache: " << e.what();
+				return {};
+			}
+		}()};
+
+		return instance.get();
+	}
+
+	std::optional<TranscodeCache::Key>
+	TranscodeCache::computeKey(const std::filesystem::path& trackPath, const TranscodeParameters& parameters)
+	{
+		// Seeking clients would hardly get the same offset again, unlike segments
+		if (parameters.offset.count() > 0 && !parameters.duration)
+			return std::nullopt;
+
+		std::error_code ec;
+		const std::filesystem::file_time_type lastWriteTime {std::filesystem::last_write_time(trackPath, ec)};
+		if (ec)
+			return std::nullopt;
+
+		std::ostringstream oss;
+		oss << trackPath.string() << '\0'
+			<< lastWriteTime.time_since_epoch().count() << '\0'
+			<< static_cast<int>(parameters.format) << '\0'
+			<< parameters.bitrate << '\0'
+			<< (parameters.stream ? std::to_string(*parameters.stream) : "") << '\0'
+			<< parameters.stripMetadata << '\0'
+			<< parameters.copyAudio;
+		if (!parameters.copyAudio)
+		{
+			const EncoderSettings& encoder {parameters.encoder};
+			oss << '\0' << (encoder.compressionLevel ? std::to_string(*encoder.compressionLevel) : "")
+				<< '\0' << (encoder.frameDuration ? std::to_string(encoder.frameDuration->count()) : "")
+				<< '\0' << (encoder.sampleRate ? std::to_string(*encoder.sampleRate) : "");
+		}
+		if (parameters.duration)
+			oss << '\0' << parameters.offset.count() << '\0' << parameters.duration->count();
+
+		return Wt::Utils::hexEncode(Wt::Utils::sha1(oss.str()));
+	}
+
+	std::shared_ptr<const TranscodeCache::Entry>
+	TranscodeCache::get(const Key& key)
+	{
+		std::scoped_lock lock {_mutex};
+
+		auto it {_entries.find(key)};
+		if (it == std::cend(_entries))
+			return {};
+
+		_lru.splice(std::begin(_lru), _lru, it->second.itLru);
+
+		// keep the usage order across restarts
+		std::error_code ec;
+		std::filesystem::last_write_time(it->second.entry->path, std::filesystem::file_time_type::clock::now(), ec);
+
+		return it->second.entry;
+	}
+
+	std::unique_ptr<TranscodeCache::Writer>
+	TranscodeCache::createWriter(const Key& key)
+	{
+		{
+			std::scoped_lock lock {_mutex};
+
+			if (_entries.find(key) != std::cend(_entries) || !_pendingKeys.insert(key).second)
+				return {};
+		}
+
+		return std::make_unique<Writer>(*this, key);
+	}
+
+	void
+	TranscodeCache::loadEntries()
+	{
+		std::filesystem::create_directories(_directory);
+
+		std::vector<std::tuple<std::filesystem::file_time_type, Key, std::uintmax_t>> entries;
+
+		std::error_code ec;
+		std::filesystem::directory_iterator itEnd;
+		for (std::filesystem::directory_iterator itPath {_directory, ec}; !ec && itPath != itEnd; itPath.increment(ec))
+		{
+			const std::filesystem::path& path {itPath->path()};
+			if (!itPath->is_regular_file(ec))
+				continue;
+
+			// Leftovers of interrupted transcodes
+			if (path.extension() == tmpFileExtension)
+			{
+				std::filesystem::remove(path, ec);
+				continue;
+			}
+
+			const std::uintmax_t size {itPath->file_size(ec)};
+			if (ec)
+				continue;
+			const std::filesystem::file_time_type lastWriteTime {itPath->last_write_time(ec)};
+			if (ec)
+				continue;
+
+			entries.emplace_back(lastWriteTime, path.filename().string(), size);
+		}
+
+		std::sort(std::begin(entries), std::end(entries), [](const auto& entryA, const auto& entryB) { return std::get<0>(entryA) > std::get<0>(entryB); });
+
+		std::scoped_lock lock {_mutex};
+		for (const auto& [lastWriteTime, key, size] : entries)
+		{
+			(void)lastWriteTime;
+			auto itLru {_lru.insert(std::end(_lru), key)};
+			_entries.emplace(key, EntryInfo {std::make_shared<Entry>(Entry {getEntryPath(key), size}), itLru});
+			_size += size;
+		}
+
+		evictEntries();
+	}
+
+	void
+	TranscodeCache::addEntry(const Key& key, std::uintmax_t size)
+	{
+		std::scoped_lock lock {_mutex};
+
+		auto itLru {_lru.insert(std::begin(_lru), key)};
+		_entries.emplace(key, EntryInfo {std::make_shared<Entry>(Entry {getEntryPath(key), size}), itLru});
+		_size += size;
+
+		evictEntries();
+	}
+
+	void
+	TranscodeCache::evictEntries()
+	{
+		// must be called locked
+		auto itLru {std::end(_lru)};
+		while (_size > _maxSize && itLru != std::begin(_lru))
+		{
+			--itLru;
+
+			auto itEntry {_entries.find(*itLru)};
+			// entries being served are kept
+			if (itEntry->second.entry.use_count() > 1)
+				continue;
+
+			LMS_LOG(TRANSCODE, DEBUG) << "Evicting transcode cache entry '" << itEntry->second.entry->path.string() << "'";
+
+			std::error_code ec;
+			std::filesystem::remove(itEntry->second.entry->path, ec);
+			_size -= itEntry->second.entry->size;
+			_entries.erase(itEntry);
+			itLru = _lru.erase(itLru);
+		}
+	}
+
+	std::filesystem::path
+	TranscodeCache::getEntryPath(const Key& key) const
+	{
+		return _directory / key;
+	}
+
+	TranscodeCache::Writer::Writer(TranscodeCache& cache, const Key& key)
+		: _cache {cache}
+		, _key {key}
+		, _tmpPath {getTmpPath(cache.getEntryPath(key))}
+		, _ofs {_tmpPath, std::ios::out | std::ios::binary | std::ios::trunc}
+	{
+		if (!_ofs)
+			LMS_LOG(TRANSCODE, ERROR) << "Cannot open '" << _tmpPath.string() << "' for writing";
+	}
+
+	TranscodeCache::Writer::~Writer()
+	{
+		if (!_committed)
+		{
+			_ofs.close();
+
+			std::error_code ec;
+			std::filesystem::remove(_tmpPath, ec);
+		}
+
+		std::scoped_lock lock {_cache._mutex};
+		_cache._pendingKeys.erase(_key);
+	}
+
+	void
+	TranscodeCache::Writer::write(const std::byte* data, std::size_t size)
+	{
+		if (!_ofs)
+			return;
+
+		_ofs.write(reinterpret_cast<const char*>(data), size);
+		_size += size;
+	}
+
+	void
+	TranscodeCache::Writer::commit()
+	{
+		_ofs.close();
+		if (!_ofs || _size == 0)
+			return;
+
+		std::error_code ec;
+		std::filesystem::rename(_tmpPath, _cache.getEntryPath(_key), ec);
+		if (ec)
+		{
+			LMS_LOG(TRANSCODE, ERROR) << "Cannot rename '" << _tmpPath.string() << "': " << ec.message();
+			return;
+		}
+
+		_cache.addEntry(_key, _size);
+		_committed = true;
+	}
+} // namespace Av
+
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "av/TranscodeParameters.hpp"
+
+namespace Av
+{
+	// Transcoded outputs stored on disk, named after a hash of the input file and of the transcode parameters
+	// Least recently used entries are removed when the max size is reached
+	class TranscodeCache
+	{
+		public:
+			using Key = std::string;
+
+			TranscodeCache(const std::filesystem::path& directory, std::uintmax_t maxSize);
+
+			TranscodeCache(const TranscodeCache&) = delete;
+			TranscodeCache(TranscodeCache&&) = delete;
+			TranscodeCache& operator=(const TranscodeCache&) = delete;
+			TranscodeCache& operator=(TranscodeCache&&) = delete;
+
+			// Process-wide instance, set up using the configuration (none if the cache is disabled)
+			static TranscodeCache* getInstance();
+
+			// Not set if the output cannot be cached (partial transcode, etc.)
+			static std::optional<Key> computeKey(const std::filesystem::path& trackPath, const TranscodeParameters& parameters);
+
+			// The cached file is not removed as long as the entry is alive
+			struct Entry
+			{
+				std::filesystem::path	path;
+				std::uintmax_t			size {};
+			};
+			std::shared_ptr<const Entry> get(const Key& key);
+
+			// Write through: the entry is added on commit, or discarded on destruction
+			class Writer
+			{
+				public:
+					Writer(TranscodeCache& cache, const Key& key);
+					~Writer();
+
+					Writer(const Writer&) = delete;
+					Writer(Writer&&) = delete;
+					Writer& operator=(const Writer&) = delete;
+					Writer& operator=(Writer&&) = delete;
+
+					void write(const std::byte* data, std::size_t size);
+					void commit();
+
+				private:
+					TranscodeCache&				_cache;
+					const Key					_key;
+					const std::filesystem::path	_tmpPath;
+					std::ofstream				_ofs;
+					std::uintmax_t				_size {};
+					bool						_committed {};
+			};
+			// Not set if the entry is already being written
+			std::unique_ptr<Writer> createWriter(const Key& key);
+
+		private:
+			void loadEntries();
+			void addEntry(const Key& key, std::uintmax_t size);
+			void evictEntries();
+			std::filesystem::path getEntryPath(const Key& key) const;
+
+			const std::filesystem::path	_directory;
+			const std::uintmax_t		_maxSize;
+
+			struct EntryInfo
+			{
+				std::shared_ptr<Entry>		entry;
+				std::list<Key>::iterator	itLru;
+			};
+
+			std::mutex								_mutex;
+			std::unordered_map<Key, EntryInfo>		_entries;
+			std::list<Key>							_lru;	// most recently used first
+			std::unordered_set<Key>					_pendingKeys;	// being written
+			std::uintmax_t							_size {};
+	};
+} // namespace Av
+
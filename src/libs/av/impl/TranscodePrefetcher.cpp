@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TranscodePrefetcher.hpp"
+
+#include "av/TranscodeResourceHandlerCreator.hpp"
+#include "av/Types.hpp"
+#include "utils/Logger.hpp"
+
+namespace Av
+{
+	void
+	prefetchTranscode(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const std::string& clientId)
+	{
+		TranscodePrefetcher::getInstance().prefetch(trackPath, parameters, clientId);
+	}
+
+	TranscodePrefetcher::TranscodePrefetcher()
+	{
+		// Jobs refer to them, make sure they outlive this instance
+		TranscodeCache::getInstance();
+		TranscodeScheduler::getInstance();
+	}
+
+	TranscodePrefetcher::~TranscodePrefetcher() = default;
+
+	TranscodePrefetcher&
+	TranscodePrefetcher::getInstance()
+	{
+		static TranscodePrefetcher instance;
+		return instance;
+	}
+
+	void
+	TranscodePrefetcher::prefetch(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const std::string& clientId)
+	{
+		TranscodeCache* cache {TranscodeCache::getInstance()};
+		if (!cache)
+			return;
+
+		const std::optional<TranscodeCache::Key> key {TranscodeCache::computeKey(trackPath, parameters)};
+		if (!key || cache->get(*key))
+			return;
+
+		// Not set if already being transcoded
+		std::unique_ptr<TranscodeCache::Writer> cacheWriter {cache->createWriter(*key)};
+		if (!cacheWriter)
+			return;
+
+		std::unique_ptr<TranscodeScheduler::Ticket> ticket {TranscodeScheduler::getInstance().createTicket(TranscodeRequestInfo {clientId, TranscodePriority::Prefetch, std::nullopt})};
+		if (!ticket)
+			return;
+
+		LMS_LOG(TRANSCODE, DEBUG) << "Prefetching transcode of '" << trackPath.string() << "'";
+
+		Job* job {};
+		{
+			std::scoped_lock lock {_mutex};
+
+			_jobs.remove_if([](const std::unique_ptr<Job>& job) { return job->isComplete(); });
+			job = _jobs.emplace_back(std::make_unique<Job>(trackPath, parameters, std::move(ticket), std::move(cacheWriter))).get();
+		}
+
+		// not removed until complete
+		job->start();
+	}
+
+	TranscodePrefetcher::Job::Job(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, std::unique_ptr<TranscodeScheduler::Ticket> ticket, std::unique_ptr<TranscodeCache::Writer> cacheWriter)
+		: _trackPath {trackPath}
+		, _parameters {parameters}
+		, _ticket {std::move(ticket)}
+		, _cacheWriter {std::move(cacheWriter)}
+	{
+	}
+
+	void
+	TranscodePrefetcher::Job::start()
+	{
+		if (_ticket->asyncWaitForGrant([this] { startTranscode(); }))
+			return;
+
+		startTranscode();
+	}
+
+	void
+	TranscodePrefetcher::Job::startTranscode()
+	{
+		try
+		{
+			_transcoder = createTranscoder(_trackPath, _parameters);
+		}
+		catch (const Exception& e)
+		{
+			LMS_LOG(TRANSCODE, ERROR) << "Cannot prefetch transcode of '" << _trackPath.string() << "': " << e.what();
+			_cacheWriter.reset();
+			complete();
+			return;
+		}
+
+		read();
+	}
+
+	void
+	TranscodePrefetcher::Job::read()
+	{
+		if (_transcoder->finished())
+		{
+			// Truncated outputs are discarded along with the writer
+			if (_transcoder->succeeded())
+			{
+				_cacheWriter->commit();
+				LMS_LOG(TRANSCODE, DEBUG) << "Prefetched transcode of '" << _trackPath.string() << "'";
+			}
+			else
+				LMS_LOG(TRANSCODE, ERROR) << "Cannot prefetch transcode of '" << _trackPath.string() << "': transcode failed";
+
+			_cacheWriter.reset();
+			complete();
+			return;
+		}
+
+		_transcoder->asyncRead(_buffer.data(), _buffer.size(), [this](std::size_t nbBytesRead)
+		{
+			_cacheWriter->write(_buffer.data(), nbBytesRead);
+			read();
+		});
+	}
+
+	void
+	TranscodePrefetcher::Job::complete()
+	{
+		// let waiting transcodes start, the transcoder cannot be destroyed from its own callback
+		_ticket.reset();
+		_complete = true;
+	}
+} // namespace Av
+
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "av/ITranscoder.hpp"
+#include "av/TranscodeParameters.hpp"
+#include "TranscodeCache.hpp"
+#include "TranscodeScheduler.hpp"
+
+namespace Av
+{
+	// Transcodes in the background into the transcode cache, at prefetch priority
+	class TranscodePrefetcher
+	{
+		public:
+			TranscodePrefetcher();
+			~TranscodePrefetcher();
+
+			TranscodePrefetcher(const TranscodePrefetcher&) = delete;
+			TranscodePrefetcher(TranscodePrefetcher&&) = delete;
+			TranscodePrefetcher& operator=(const TranscodePrefetcher&) = delete;
+			TranscodePrefetcher& operator=(TranscodePrefetcher&&) = delete;
+
+			static TranscodePrefetcher& getInstance();
+
+			void prefetch(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const std::string& clientId);
+
+		private:
+			class Job
+			{
+				public:
+					Job(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, std::unique_ptr<TranscodeScheduler::Ticket> ticket, std::unique_ptr<TranscodeCache::Writer> cacheWriter);
+
+					Job(const Job&) = delete;
+					Job(Job&&) = delete;
+					Job& operator=(const Job&) = delete;
+					Job& operator=(Job&&) = delete;
+
+					void start();
+					bool isComplete() const { return _complete; }
+
+				private:
+					void startTranscode();
+					void read();
+					void complete();
+
+					const std::filesystem::path					_trackPath;
+					const TranscodeParameters					_parameters;
+					std::unique_ptr<TranscodeScheduler::Ticket>	_ticket;
+					std::unique_ptr<TranscodeCache::Writer>		_cacheWriter;
+					std::unique_ptr<ITranscoder>				_transcoder;
+					std::array<std::byte, 65536>				_buffer;
+					std::atomic<bool>							_complete {};
+			};
+
+			std::mutex				_mutex;
+			std::list<std::unique_ptr<Job>>	_jobs;	// complete jobs are removed on the next prefetch
+	};
+} // namespace Av
+
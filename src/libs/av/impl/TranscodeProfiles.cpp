@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "av/TranscodeProfiles.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "av/Types.hpp"
+#include "utils/Exception.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Service.hpp"
+#include "utils/String.hpp"
+
+namespace Av
+{
+	namespace
+	{
+		// Set once at startup, read only afterwards
+		std::vector<TranscodeProfile>							profiles;
+		std::unordered_map<std::string, std::size_t>			profileIndexByUser;
+		std::unordered_map<std::string, std::size_t>			profileIndexBySubsonicClient;
+		std::optional<std::size_t>								defaultProfileIndex;
+
+		std::optional<Format>
+		formatFromString(std::string_view str)
+		{
+			const std::string format {StringUtils::stringToLower(str)};
+
+			if (format == "mp3")
+				return Format::MP3;
+			if (format == "ogg_opus")
+				return Format::OGG_OPUS;
+			if (format == "matroska_opus")
+				return Format::MATROSKA_OPUS;
+			if (format == "ogg_vorbis")
+				return Format::OGG_VORBIS;
+			if (format == "webm_vorbis")
+				return Format::WEBM_VORBIS;
+
+			return std::nullopt;
+		}
+
+		// "name: key=value, key=value"
+		TranscodeProfile
+		parseProfile(std::string_view str)
+		{
+			auto throwBadValue {[&]
+			{
+				throw LmsException {"Bad value '" + std::string {str} + "' for 'transcode-profiles'"};
+			}};
+
+			const std::size_t nameEnd {str.find(':')};
+
+			TranscodeProfile profile;
+			profile.name = StringUtils::stringTrim(str.substr(0, nameEnd));
+			if (profile.name.empty())
+				throwBadValue();
+
+			if (nameEnd == std::string_view::npos)
+				return profile;
+
+			for (std::string_view setting : StringUtils::splitString(str.substr(nameEnd + 1), ","))
+			{
+				const std::size_t separator {setting.find('=')};
+				if (separator == std::string_view::npos)
+					throwBadValue();
+
+				const std::string key {StringUtils::stringTrim(setting.substr(0, separator))};
+				const std::string value {StringUtils::stringTrim(setting.substr(separator + 1))};
+
+				if (key == "format")
+				{
+					profile.format = formatFromString(value);
+					if (!profile.format)
+						throwBadValue();
+				}
+				else if (key == "max-bitrate")
+				{
+					profile.maxBitrate = StringUtils::readAs<std::size_t>(value);
+					if (!profile.maxBitrate || *profile.maxBitrate == 0)
+						throwBadValue();
+				}
+				else if (key == "compression-level")
+				{
+					profile.encoder.compressionLevel = StringUtils::readAs<unsigned>(value);
+					if (!profile.encoder.compressionLevel)
+						throwBadValue();
+				}
+				else if (key == "frame-duration")
+				{
+					const std::optional<unsigned> frameDuration {StringUtils::readAs<unsigned>(value)};
+					if (!frameDuration || *frameDuration == 0)
+						throwBadValue();
+
+					profile.encoder.frameDuration = std::chrono::milliseconds {*frameDuration};
+				}
+				else if (key == "sample-rate")
+				{
+					profile.encoder.sampleRate = StringUtils::readAs<unsigned>(value);
+					if (!profile.encoder.sampleRate || *profile.encoder.sampleRate == 0)
+						throwBadValue();
+				}
+				else
+					throwBadValue();
+			}
+
+			return profile;
+		}
+
+		std::size_t
+		getProfileIndex(std::string_view name, std::string_view setting)
+		{
+			auto itProfile {std::find_if(std::cbegin(profiles), std::cend(profiles), [&](const TranscodeProfile& profile) { return profile.name == name; })};
+			if (itProfile == std::cend(profiles))
+				throw LmsException {"Unknown transcode profile '" + std::string {name} + "' in '" + std::string {setting} + "'"};
+
+			return std::distance(std::cbegin(profiles), itProfile);
+		}
+
+		// "key = profile"
+		void
+		readAssignments(std::string_view setting, std::unordered_map<std::string, std::size_t>& profileIndexes)
+		{
+			Service<IConfig>::get()->visitStrings(setting, [&](std::string_view str)
+			{
+				const std::size_t separator {str.rfind('=')};
+				if (separator == std::string_view::npos)
+					throw LmsException {"Bad value '" + std::string {str} + "' for '" + std::string {setting} + "'"};
+
+				const std::string key {StringUtils::stringTrim(str.substr(0, separator))};
+				const std::string profileName {StringUtils::stringTrim(str.substr(separator + 1))};
+
+				profileIndexes[key] = getProfileIndex(profileName, setting);
+			});
+		}
+	}
+
+	void
+	initTranscodeProfiles()
+	{
+		profiles.clear();
+		profileIndexByUser.clear();
+		profileIndexBySubsonicClient.clear();
+		defaultProfileIndex.reset();
+
+		Service<IConfig>::get()->visitStrings("transcode-profiles", [&](std::string_view str)
+		{
+			TranscodeProfile profile {parseProfile(str)};
+			if (std::any_of(std::cbegin(profiles), std::cend(profiles), [&](const TranscodeProfile& other) { return other.name == profile.name; }))
+				throw LmsException {"Duplicate transcode profile '" + profile.name + "'"};
+
+			profiles.push_back(std::move(profile));
+		});
+
+		readAssignments("transcode-profile-users", profileIndexByUser);
+		readAssignments("transcode-profile-subsonic-clients", profileIndexBySubsonicClient);
+
+		const std::string_view defaultProfileName {Service<IConfig>::get()->getString("transcode-default-profile", "")};
+		if (!defaultProfileName.empty())
+			defaultProfileIndex = getProfileIndex(defaultProfileName, "transcode-default-profile");
+
+		LMS_LOG(TRANSCODE, INFO) << profiles.size() << " transcode profile(s) loaded";
+	}
+
+	const TranscodeProfile*
+	findTranscodeProfile(std::string_view userLoginName, std::optional<std::string_view> subsonicClientName)
+	{
+		if (subsonicClientName)
+		{
+			auto it {profileIndexBySubsonicClient.find(std::string {*subsonicClientName})};
+			if (it != std::cend(profileIndexBySubsonicClient))
+				return &profiles[it->second];
+		}
+
+		auto it {profileIndexByUser.find(std::string {userLoginName})};
+		if (it != std::cend(profileIndexByUser))
+			return &profiles[it->second];
+
+		if (defaultProfileIndex)
+			return &profiles[*defaultProfileIndex];
+
+		return nullptr;
+	}
+
+	void
+	applyTranscodeProfile(const TranscodeProfile& profile, TranscodeParameters& parameters)
+	{
+		if (profile.format)
+			parameters.format = *profile.format;
+		if (profile.maxBitrate)
+			parameters.bitrate = std::min(parameters.bitrate, *profile.maxBitrate);
+
+		parameters.encoder = profile.encoder;
+	}
+} // namespace Av
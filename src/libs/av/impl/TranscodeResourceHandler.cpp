@@ -19,48 +19,370 @@
 
 #include "TranscodeResourceHandler.hpp"
 
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <utility>
+
+#include "utils/FileResourceHandlerCreator.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/Logger.hpp"
+#include "utils/MediaActivity.hpp"
+#include "utils/Service.hpp"
+
 namespace Av
 {
+	namespace
+	{
+		std::size_t
+		getBufferSize()
+		{
+			static const std::size_t bufferSize {std::max<std::size_t>(Service<IConfig>::get()->getULong("transcode-buffer-size", 256), 32) * 1024};
+			return bufferSize;
+		}
+
+		std::vector<std::filesystem::path>
+		getTrackPaths(const std::vector<TranscodeSessionTrack>& tracks)
+		{
+			std::vector<std::filesystem::path> trackPaths;
+			std::transform(std::cbegin(tracks), std::cend(tracks), std::back_inserter(trackPaths), [](const TranscodeSessionTrack& track) { return track.path; });
+			return trackPaths;
+		}
+
+		std::vector<std::chrono::milliseconds>
+		getTrackOffsets(const std::vector<TranscodeSessionTrack>& tracks, std::chrono::milliseconds firstTrackOffset)
+		{
+			std::vector<std::chrono::milliseconds> trackOffsets;
+
+			std::chrono::milliseconds trackOffset {};
+			for (const TranscodeSessionTrack& track : tracks)
+			{
+				trackOffsets.push_back(trackOffset);
+				trackOffset += track.duration;
+				if (trackOffsets.size() == 1)
+					trackOffset -= std::min(firstTrackOffset, track.duration);
+			}
+
+			return trackOffsets;
+		}
+
+		TranscodeParameters
+		getSessionParameters(const TranscodeParameters& parameters)
+		{
+			TranscodeParameters sessionParameters {parameters};
+			sessionParameters.stream.reset();
+			sessionParameters.duration.reset();
+			return sessionParameters;
+		}
+
+		EgressScheduler::TransferInfo
+		getTransferInfo(const TranscodeRequestInfo& requestInfo)
+		{
+			return EgressScheduler::TransferInfo {requestInfo.priority == TranscodePriority::Prefetch ? EgressScheduler::TrafficClass::Bulk : EgressScheduler::TrafficClass::Interactive, requestInfo.clientId};
+		}
+
+		TranscodeRequestInfo
+		getSessionRequestInfo(const TranscodeRequestInfo& requestInfo)
+		{
+			// Byte offsets cannot be mapped to time offsets across tracks
+			TranscodeRequestInfo sessionRequestInfo {requestInfo};
+			sessionRequestInfo.trackDuration.reset();
+			return sessionRequestInfo;
+		}
+	}
 
 	std::unique_ptr<IResourceHandler>
-	createTranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters)
+	createTranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const TranscodeRequestInfo& requestInfo)
 	{
-		return std::make_unique<TranscodeResourceHandler>(trackPath, parameters);
+		TranscodeCache* cache {TranscodeCache::getInstance()};
+		if (!cache)
+			return std::make_unique<TranscodeResourceHandler>(trackPath, parameters, requestInfo);
+
+		const std::optional<TranscodeCache::Key> key {TranscodeCache::computeKey(trackPath, parameters)};
+		if (!key)
+			return std::make_unique<TranscodeResourceHandler>(trackPath, parameters, requestInfo);
+
+		if (std::shared_ptr<const TranscodeCache::Entry> entry {cache->get(*key)})
+		{
+			LMS_LOG(TRANSCODE, DEBUG) << "Serving '" << trackPath.string() << "' from transcode cache";
+			return std::make_unique<CachedTranscodeResourceHandler>(std::move(entry), formatToMimetype(parameters.format), requestInfo);
+		}
+
+		return std::make_unique<TranscodeResourceHandler>(trackPath, parameters, requestInfo, cache->createWriter(*key));
+	}
+
+	std::unique_ptr<IResourceHandler>
+	createTranscodeSessionResourceHandler(const std::vector<TranscodeSessionTrack>& tracks, const TranscodeParameters& parameters, const TranscodeRequestInfo& requestInfo)
+	{
+		// Cache entries are per track
+		return std::make_unique<TranscodeResourceHandler>(tracks, parameters, requestInfo);
 	}
 
 	// TODO set some nice HTTP return code
 
-	TranscodeResourceHandler::TranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters)
-		: _transcoder {trackPath, parameters}
+	TranscodeResourceHandler::TranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const TranscodeRequestInfo& requestInfo, std::unique_ptr<TranscodeCache::Writer> cacheWriter)
+		: TranscodeResourceHandler {std::vector<std::filesystem::path> {trackPath}, {}, parameters, requestInfo, std::move(cacheWriter)}
+	{
+	}
+
+	TranscodeResourceHandler::TranscodeResourceHandler(const std::vector<TranscodeSessionTrack>& tracks, const TranscodeParameters& parameters, const TranscodeRequestInfo& requestInfo)
+		: TranscodeResourceHandler {getTrackPaths(tracks), getTrackOffsets(tracks, parameters.offset), getSessionParameters(parameters), getSessionRequestInfo(requestInfo), {}}
+	{
+	}
+
+	TranscodeResourceHandler::TranscodeResourceHandler(const std::vector<std::filesystem::path>& trackPaths, std::vector<std::chrono::milliseconds> trackOffsets, const TranscodeParameters& parameters, const TranscodeRequestInfo& requestInfo, std::unique_ptr<TranscodeCache::Writer> cacheWriter)
+		: _buffer(getBufferSize())
+		, _trackPaths {trackPaths}
+		, _trackOffsets {std::move(trackOffsets)}
+		, _parameters {parameters}
+		, _ticket {TranscodeScheduler::getInstance().createTicket(requestInfo)}
+		, _cacheWriter {std::move(cacheWriter)}
+		, _transfer {getTransferInfo(requestInfo)}
 	{
+		if (requestInfo.trackDuration && *requestInfo.trackDuration > _parameters.offset)
+			_estimatedContentLength = static_cast<std::uint64_t>((*requestInfo.trackDuration - _parameters.offset).count()) * _parameters.bitrate / 8 / 1000;
 	}
 
 	Wt::Http::ResponseContinuation*
-	TranscodeResourceHandler::processRequest(const Wt::Http::Request& /*request*/, Wt::Http::Response& response)
+	TranscodeResourceHandler::processRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
 	{
-		response.setMimeType(_transcoder.getOutputMimeType());
+		MediaActivity::notify();
 
-		if (_nbBytesReady > 0)
+		if (!_transcoder && !_ticket)
 		{
-			response.out().write(reinterpret_cast<const char *>(&_buffer[0]), _nbBytesReady);
-			_nbBytesReady = 0;
+			// Let the client retry later
+			response.setStatus(503);
+			response.addHeader("Retry-After", "10");
+			return {};
 		}
 
-		if (!_transcoder.finished())
+		response.setMimeType(std::string {formatToMimetype(_parameters.format)});
+
+		if (!request.continuation())
+		{
+			if (!_trackOffsets.empty())
+			{
+				std::ostringstream trackOffsets;
+				for (std::size_t i {}; i < _trackOffsets.size(); ++i)
+					trackOffsets << (i > 0 ? "," : "") << _trackOffsets[i].count();
+				response.addHeader("X-Track-Offsets", trackOffsets.str());
+			}
+
+			if (_estimatedContentLength && !setContentRange(request, response))
+				return {};
+		}
+
+		if (!_transcoder)
 		{
 			Wt::Http::ResponseContinuation *continuation {response.createContinuation()};
 			continuation->waitForMoreData();
-			_transcoder.asyncRead(_buffer.data(), _buffer.size(), [=](std::size_t nbBytesRead)
+			if (_ticket->asyncWaitForGrant([=] { continuation->haveMoreData(); }))
+				return continuation;
+
+			_transcoder = createTranscoder(_trackPaths, _parameters);
+		}
+
+		{
+			std::scoped_lock lock {_mutex};
+
+			std::size_t nbBytesWritten {};
+			while (_nbBytesReady > 0)
 			{
-				assert(_nbBytesReady == 0);
-				_nbBytesReady = nbBytesRead;
-				continuation->haveMoreData();
-			});
+				const std::size_t size {std::min(_nbBytesReady, _buffer.size() - _readOffset)};
+				nbBytesWritten += writeOutput(response, _buffer.data() + _readOffset, size);
+
+				_readOffset = (_readOffset + size) % _buffer.size();
+				_nbBytesReady -= size;
+			}
+
+			// keep the free space contiguous
+			if (!_readInProgress)
+				_readOffset = 0;
+
+			startRead();
+
+			const std::chrono::steady_clock::duration delay {_transfer.onDataSent(nbBytesWritten)};
 
-			return continuation;
+			const bool contentLengthReached {_remainingBytes && *_remainingBytes == 0};
+			if (!contentLengthReached && _readInProgress)
+			{
+				Wt::Http::ResponseContinuation *continuation {response.createContinuation()};
+				continuation->waitForMoreData();
+
+				// Output read in the meantime is sent once resumed
+				if (delay > std::chrono::steady_clock::duration::zero())
+					EgressScheduler::resumeAfter(continuation, delay);
+				else
+					_waitingContinuation = continuation;
+
+				return continuation;
+			}
+		}
+
+		if (_transcoder->finished() && !_transcoder->succeeded())
+		{
+			LMS_LOG(TRANSCODE, ERROR) << "Transcode failed, ending the response as failed";
+
+			_cacheWriter.reset();
+			_ticket.reset();
+
+			// Otherwise not padded up to the declared content length: the client sees a truncated transfer
+			if (!_outputSent)
+				response.setStatus(500);
+
+			return {};
+		}
+
+		// Aborted requests never get here: only complete and successful outputs are cached
+		if (!_transcoder->finished())
+			_cacheWriter.reset();
+
+		if (_cacheWriter)
+		{
+			_cacheWriter->commit();
+			_cacheWriter.reset();
+		}
+
+		// let waiting transcodes start
+		_ticket.reset();
+
+		// Actual output is shorter than declared
+		if (_remainingBytes && *_remainingBytes > 0)
+		{
+			static const std::array<char, _chunkSize> padding {};
+
+			const std::size_t paddingSize {static_cast<std::size_t>(std::min<std::uint64_t>(*_remainingBytes, padding.size()))};
+			response.out().write(padding.data(), paddingSize);
+			*_remainingBytes -= paddingSize;
+
+			if (*_remainingBytes > 0)
+				return response.createContinuation();
 		}
 
 		return {};
 	}
+
+	bool
+	TranscodeResourceHandler::setContentRange(const Wt::Http::Request& request, Wt::Http::Response& response)
+	{
+		const std::uint64_t contentLength {*_estimatedContentLength};
+
+		const Wt::Http::Request::ByteRangeSpecifier ranges {request.getRanges(contentLength)};
+		if (!ranges.isSatisfiable())
+		{
+			std::ostringstream contentRange;
+			contentRange << "bytes */" << contentLength;
+			response.setStatus(416); // Requested range not satisfiable
+			response.addHeader("Content-Range", contentRange.str());
+			return false;
+		}
+
+		std::uint64_t firstByte {};
+		std::uint64_t beyondLastByte {contentLength};
+		if (ranges.size() == 1)
+		{
+			firstByte = ranges[0].firstByte();
+			beyondLastByte = ranges[0].lastByte() + 1;
+
+			std::ostringstream contentRange;
+			contentRange << "bytes " << firstByte << "-" << beyondLastByte - 1 << "/" << contentLength;
+			response.setStatus(206);
+			response.addHeader("Content-Range", contentRange.str());
+		}
+
+		response.setContentLength(beyondLastByte - firstByte);
+		_remainingBytes = beyondLastByte - firstByte;
+
+		if (firstByte > 0)
+		{
+			// Byte offsets are mapped to time offsets using the declared bitrate
+			_parameters.offset += std::chrono::milliseconds {firstByte * 8 * 1000 / _parameters.bitrate};
+			_cacheWriter.reset();
+
+			LMS_LOG(TRANSCODE, DEBUG) << "Range starting at byte " << firstByte << ", transcode offset = " << _parameters.offset.count() << "ms";
+		}
+
+		return true;
+	}
+
+	std::size_t
+	TranscodeResourceHandler::writeOutput(Wt::Http::Response& response, const std::byte* data, std::size_t size)
+	{
+		if (_cacheWriter)
+			_cacheWriter->write(data, size);
+
+		std::size_t nbBytesToWrite {size};
+		if (_remainingBytes)
+		{
+			// Actual output is longer than declared
+			if (nbBytesToWrite > *_remainingBytes)
+			{
+				nbBytesToWrite = static_cast<std::size_t>(*_remainingBytes);
+				_cacheWriter.reset();
+			}
+			*_remainingBytes -= nbBytesToWrite;
+		}
+
+		response.out().write(reinterpret_cast<const char *>(data), nbBytesToWrite);
+		if (nbBytesToWrite > 0)
+			_outputSent = true;
+
+		return nbBytesToWrite;
+	}
+
+	void
+	TranscodeResourceHandler::startRead()
+	{
+		// must be called locked
+		if (_readInProgress || _nbBytesReady == _buffer.size() || _transcoder->finished())
+			return;
+
+		const std::size_t writeOffset {(_readOffset + _nbBytesReady) % _buffer.size()};
+		// some transcoders only complete reads once the whole requested size is available
+		const std::size_t writeSize {std::min(_chunkSize, writeOffset < _readOffset ? _readOffset - writeOffset : _buffer.size() - writeOffset)};
+
+		_readInProgress = true;
+		_transcoder->asyncRead(_buffer.data() + writeOffset, writeSize, [this](std::size_t nbBytesRead)
+		{
+			onReadComplete(nbBytesRead);
+		});
+	}
+
+	void
+	TranscodeResourceHandler::onReadComplete(std::size_t nbBytesRead)
+	{
+		Wt::Http::ResponseContinuation* continuation {};
+
+		{
+			std::scoped_lock lock {_mutex};
+
+			_readInProgress = false;
+			_nbBytesReady += nbBytesRead;
+
+			// keep on reading in the background until the buffer is full
+			startRead();
+
+			// buffer full or transcode complete if no read in progress
+			if (_waitingContinuation && (_nbBytesReady >= _buffer.size() / 4 || !_readInProgress))
+				continuation = std::exchange(_waitingContinuation, nullptr);
+		}
+
+		if (continuation)
+			continuation->haveMoreData();
+	}
+
+	CachedTranscodeResourceHandler::CachedTranscodeResourceHandler(std::shared_ptr<const TranscodeCache::Entry> entry, std::string_view mimeType, const TranscodeRequestInfo& requestInfo)
+		: _entry {std::move(entry)}
+		, _mimeType {mimeType}
+		, _fileResourceHandler {createFileResourceHandler(_entry->path, getTransferInfo(requestInfo))}
+	{
+	}
+
+	Wt::Http::ResponseContinuation*
+	CachedTranscodeResourceHandler::processRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
+	{
+		response.setMimeType(_mimeType);
+		return _fileResourceHandler->processRequest(request, response);
+	}
 }
 
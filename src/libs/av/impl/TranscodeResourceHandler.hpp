@@ -20,11 +20,21 @@
 #pragma once
 
 #include <array>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 
+#include "av/ITranscoder.hpp"
 #include "av/TranscodeParameters.hpp"
+#include "utils/EgressScheduler.hpp"
 #include "utils/IResourceHandler.hpp"
-#include "Transcoder.hpp"
+#include "TranscodeCache.hpp"
+#include "TranscodeScheduler.hpp"
 
 namespace Av
 {
@@ -32,16 +42,56 @@ namespace Av
 	class TranscodeResourceHandler final : public IResourceHandler
 	{
 		public:
-			TranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters);
+			// Output is also written to the cache, if set
+			// The transcode is started once granted by the scheduler
+			// Output is read ahead in a ring buffer, the response is resumed once a significant part of it is filled
+			TranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const TranscodeRequestInfo& requestInfo, std::unique_ptr<TranscodeCache::Writer> cacheWriter = {});
+			// Tracks are transcoded one after the other by the same transcoder
+			TranscodeResourceHandler(const std::vector<TranscodeSessionTrack>& tracks, const TranscodeParameters& parameters, const TranscodeRequestInfo& requestInfo);
 
 		private:
+			TranscodeResourceHandler(const std::vector<std::filesystem::path>& trackPaths, std::vector<std::chrono::milliseconds> trackOffsets, const TranscodeParameters& parameters, const TranscodeRequestInfo& requestInfo, std::unique_ptr<TranscodeCache::Writer> cacheWriter);
+
 			Wt::Http::ResponseContinuation* processRequest(const Wt::Http::Request& request, Wt::Http::Response& reponse) override;
+			bool setContentRange(const Wt::Http::Request& request, Wt::Http::Response& response);
+			// returns the number of bytes actually written
+			std::size_t writeOutput(Wt::Http::Response& response, const std::byte* data, std::size_t size);
+			void startRead();
+			void onReadComplete(std::size_t nbBytesRead);
+
+			static constexpr std::size_t _chunkSize {32768};	// max size of each read
 
-			static constexpr std::size_t _chunkSize {32768};
-			std::array<std::byte, _chunkSize> _buffer;
+			std::mutex _mutex;	// protects the ring buffer, filled from the transcoder's threads
+			std::vector<std::byte> _buffer;
+			std::size_t _readOffset {};
 			std::size_t _nbBytesReady {};
-			const std::filesystem::path _trackPath;
-			Transcoder _transcoder;
+			bool _readInProgress {};
+			Wt::Http::ResponseContinuation* _waitingContinuation {};
+
+			const std::vector<std::filesystem::path> _trackPaths;
+			const std::vector<std::chrono::milliseconds> _trackOffsets;	// only for sessions
+			TranscodeParameters _parameters;
+			std::optional<std::uint64_t> _estimatedContentLength;
+			std::optional<std::uint64_t> _remainingBytes;	// to stick to the declared content length
+			bool _outputSent {};	// once set, the headers can no longer be changed
+			std::unique_ptr<TranscodeScheduler::Ticket> _ticket;
+			std::unique_ptr<ITranscoder> _transcoder;
+			std::unique_ptr<TranscodeCache::Writer> _cacheWriter;
+			EgressScheduler::Transfer _transfer;
+	};
+
+	// Serves a previously transcoded output, byte ranges are supported
+	class CachedTranscodeResourceHandler final : public IResourceHandler
+	{
+		public:
+			CachedTranscodeResourceHandler(std::shared_ptr<const TranscodeCache::Entry> entry, std::string_view mimeType, const TranscodeRequestInfo& requestInfo);
+
+		private:
+			Wt::Http::ResponseContinuation* processRequest(const Wt::Http::Request& request, Wt::Http::Response& reponse) override;
+
+			const std::shared_ptr<const TranscodeCache::Entry> _entry;
+			const std::string _mimeType;
+			std::unique_ptr<IResourceHandler> _fileResourceHandler;
 	};
 }
 
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TranscodeScheduler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <vector>
+
+#include "utils/IConfig.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Service.hpp"
+
+namespace Av
+{
+	namespace
+	{
+		std::size_t
+		getCount(const std::unordered_map<std::string, std::size_t>& counts, const std::string& clientId)
+		{
+			auto it {counts.find(clientId)};
+			return it == std::cend(counts) ? 0 : it->second;
+		}
+
+		void
+		decrementCount(std::unordered_map<std::string, std::size_t>& counts, const std::string& clientId)
+		{
+			auto it {counts.find(clientId)};
+			assert(it != std::end(counts) && it->second > 0);
+			if (--it->second == 0)
+				counts.erase(it);
+		}
+
+		Metrics::Gauge&
+		getRunningTranscodesGauge()
+		{
+			static Metrics::Gauge& runningTranscodes {Metrics::getRegistry().createGauge("lms_transcodes_running", "Number of running transcodes")};
+			return runningTranscodes;
+		}
+
+		Metrics::Gauge&
+		getQueuedTranscodesGauge()
+		{
+			static Metrics::Gauge& queuedTranscodes {Metrics::getRegistry().createGauge("lms_transcodes_queued", "Number of transcodes waiting for a slot")};
+			return queuedTranscodes;
+		}
+
+		void
+		callGrantedCallbacks(std::vector<TranscodeScheduler::Ticket::GrantedCallback>& callbacks)
+		{
+			for (TranscodeScheduler::Ticket::GrantedCallback& callback : callbacks)
+				callback();
+		}
+	}
+
+	TranscodeLoad
+	getTranscodeLoad()
+	{
+		return TranscodeLoad {static_cast<std::size_t>(std::max<std::int64_t>(getRunningTranscodesGauge().get(), 0)),
+				static_cast<std::size_t>(std::max<std::int64_t>(getQueuedTranscodesGauge().get(), 0))};
+	}
+
+	TranscodeScheduler::TranscodeScheduler(std::size_t maxRunningCount, std::size_t maxQueuedCountPerClient)
+		: _maxRunningCount {maxRunningCount}
+		, _maxQueuedCountPerClient {maxQueuedCountPerClient}
+	{
+		LMS_LOG(TRANSCODE, INFO) << "Max concurrent transcodes = " << _maxRunningCount << ", max queued transcodes per client = " << _maxQueuedCountPerClient;
+	}
+
+	TranscodeScheduler&
+	TranscodeScheduler::getInstance()
+	{
+		static TranscodeScheduler instance {[]
+		{
+			const std::size_t maxRunningCount {Service<IConfig>::get()->getULong("transcoder-max-concurrent-transcodes", 16)};
+			const std::size_t maxQueuedCountPerClient {Service<IConfig>::get()->getULong("transcoder-max-queued-transcodes-per-client", 32)};
+
+			return TranscodeScheduler {maxRunningCount ? maxRunningCount : std::numeric_limits<std::size_t>::max(),
+					maxQueuedCountPerClient ? maxQueuedCountPerClient : std::numeric_limits<std::size_t>::max()};
+		}()};
+
+		return instance;
+	}
+
+	TranscodeScheduler::Ticket::Ticket(TranscodeScheduler& scheduler, const TranscodeRequestInfo& requestInfo)
+		: _scheduler {scheduler}
+		, _requestInfo {requestInfo}
+	{
+	}
+
+	TranscodeScheduler::Ticket::~Ticket()
+	{
+		_scheduler.release(*this);
+	}
+
+	bool
+	TranscodeScheduler::Ticket::asyncWaitForGrant(GrantedCallback callback)
+	{
+		std::scoped_lock lock {_scheduler._mutex};
+
+		if (_granted)
+			return false;
+
+		_grantedCallback = std::move(callback);
+		return true;
+	}
+
+	std::unique_ptr<TranscodeScheduler::Ticket>
+	TranscodeScheduler::createTicket(const TranscodeRequestInfo& requestInfo)
+	{
+		std::unique_ptr<Ticket> ticket;
+		std::vector<Ticket::GrantedCallback> grantedCallbacks;
+
+		{
+			std::scoped_lock lock {_mutex};
+
+			if (getCount(_queuedCountByClient, requestInfo.clientId) >= _maxQueuedCountPerClient)
+			{
+				LMS_LOG(TRANSCODE, WARNING) << "Too many queued transcodes for client '" << requestInfo.clientId << "'";
+				return {};
+			}
+
+			ticket = std::make_unique<Ticket>(*this, requestInfo);
+
+			ClientQueues& queues {getQueues(requestInfo.priority)};
+			auto itQueue {std::find_if(std::begin(queues), std::end(queues), [&](const ClientQueue& queue) { return queue.clientId == requestInfo.clientId; })};
+			if (itQueue == std::end(queues))
+				itQueue = queues.insert(std::end(queues), ClientQueue {requestInfo.clientId, {}});
+
+			itQueue->tickets.push_back(ticket.get());
+			_queuedCountByClient[requestInfo.clientId]++;
+			getQueuedTranscodesGauge().add();
+
+			grantTickets(grantedCallbacks);
+
+			if (!ticket->_granted)
+				LMS_LOG(TRANSCODE, DEBUG) << "Transcode queued for client '" << requestInfo.clientId << "', running = " << _runningCount;
+		}
+
+		callGrantedCallbacks(grantedCallbacks);
+
+		return ticket;
+	}
+
+	TranscodeScheduler::ClientQueues&
+	TranscodeScheduler::getQueues(TranscodePriority priority)
+	{
+		switch (priority)
+		{
+			case TranscodePriority::Interactive:	return _interactiveQueues;
+			case TranscodePriority::Prefetch:		return _prefetchQueues;
+		}
+
+		return _interactiveQueues;
+	}
+
+	void
+	TranscodeScheduler::release(Ticket& ticket)
+	{
+		std::vector<Ticket::GrantedCallback> grantedCallbacks;
+
+		{
+			std::scoped_lock lock {_mutex};
+
+			if (ticket._granted)
+			{
+				--_runningCount;
+				decrementCount(_runningCountByClient, ticket._requestInfo.clientId);
+				getRunningTranscodesGauge().sub();
+				grantTickets(grantedCallbacks);
+			}
+			else
+			{
+				removeFromQueue(ticket);
+			}
+		}
+
+		callGrantedCallbacks(grantedCallbacks);
+	}
+
+	void
+	TranscodeScheduler::removeFromQueue(Ticket& ticket)
+	{
+		// must be called locked
+		ClientQueues& queues {getQueues(ticket._requestInfo.priority)};
+		auto itQueue {std::find_if(std::begin(queues), std::end(queues), [&](const ClientQueue& queue) { return queue.clientId == ticket._requestInfo.clientId; })};
+		assert(itQueue != std::end(queues));
+
+		itQueue->tickets.remove(&ticket);
+		if (itQueue->tickets.empty())
+			queues.erase(itQueue);
+
+		decrementCount(_queuedCountByClient, ticket._requestInfo.clientId);
+		getQueuedTranscodesGauge().sub();
+	}
+
+	void
+	TranscodeScheduler::grantTickets(std::vector<Ticket::GrantedCallback>& grantedCallbacks)
+	{
+		// must be called locked, callbacks have to be called once unlocked
+		while (_runningCount < _maxRunningCount)
+		{
+			ClientQueues& queues {!_interactiveQueues.empty() ? _interactiveQueues : _prefetchQueues};
+			if (queues.empty())
+				break;
+
+			// first in round robin order on ties
+			auto itQueue {std::min_element(std::begin(queues), std::end(queues), [this](const ClientQueue& queueA, const ClientQueue& queueB)
+			{
+				return getCount(_runningCountByClient, queueA.clientId) < getCount(_runningCountByClient, queueB.clientId);
+			})};
+
+			Ticket* ticket {itQueue->tickets.front()};
+			itQueue->tickets.pop_front();
+			if (itQueue->tickets.empty())
+				queues.erase(itQueue);
+			else
+				queues.splice(std::end(queues), queues, itQueue);
+
+			decrementCount(_queuedCountByClient, ticket->_requestInfo.clientId);
+			_runningCountByClient[ticket->_requestInfo.clientId]++;
+			++_runningCount;
+			getQueuedTranscodesGauge().sub();
+			getRunningTranscodesGauge().add();
+
+			ticket->_granted = true;
+			if (ticket->_grantedCallback)
+			{
+				grantedCallbacks.emplace_back(std::move(ticket->_grantedCallback));
+				ticket->_grantedCallback = {};
+			}
+		}
+	}
+} // namespace Av
+
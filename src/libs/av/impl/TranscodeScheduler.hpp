@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "av/TranscodeResourceHandlerCreator.hpp"
+
+namespace Av
+{
+	// Limits the number of concurrent transcodes
+	// Waiting transcodes are granted by priority, then to the client having the fewest running transcodes
+	class TranscodeScheduler
+	{
+		public:
+			TranscodeScheduler(std::size_t maxRunningCount, std::size_t maxQueuedCountPerClient);
+			~TranscodeScheduler() = default;
+
+			TranscodeScheduler(const TranscodeScheduler&) = delete;
+			TranscodeScheduler(TranscodeScheduler&&) = delete;
+			TranscodeScheduler& operator=(const TranscodeScheduler&) = delete;
+			TranscodeScheduler& operator=(TranscodeScheduler&&) = delete;
+
+			// Process-wide instance, set up using the configuration (0 means no limit)
+			static TranscodeScheduler& getInstance();
+
+			// Holds a transcode slot once granted, leaves the queue or releases the slot on destruction
+			class Ticket
+			{
+				public:
+					Ticket(TranscodeScheduler& scheduler, const TranscodeRequestInfo& requestInfo);
+					~Ticket();
+
+					Ticket(const Ticket&) = delete;
+					Ticket(Ticket&&) = delete;
+					Ticket& operator=(const Ticket&) = delete;
+					Ticket& operator=(Ticket&&) = delete;
+
+					// Returns false if already granted, otherwise the callback will be called once granted (from another thread)
+					using GrantedCallback = std::function<void()>;
+					bool asyncWaitForGrant(GrantedCallback callback);
+
+				private:
+					friend class TranscodeScheduler;
+
+					TranscodeScheduler&			_scheduler;
+					const TranscodeRequestInfo	_requestInfo;
+					bool						_granted {};
+					GrantedCallback				_grantedCallback;
+			};
+
+			// Not set if too many transcodes are already queued for this client
+			std::unique_ptr<Ticket> createTicket(const TranscodeRequestInfo& requestInfo);
+
+		private:
+			struct ClientQueue
+			{
+				std::string			clientId;
+				std::list<Ticket*>	tickets;
+			};
+			using ClientQueues = std::list<ClientQueue>;	// round robin order
+
+			ClientQueues& getQueues(TranscodePriority priority);
+			void release(Ticket& ticket);
+			void removeFromQueue(Ticket& ticket);
+			void grantTickets(std::vector<Ticket::GrantedCallback>& grantedCallbacks);
+
+			const std::size_t	_maxRunningCount;
+			const std::size_t	_maxQueuedCountPerClient;
+
+			std::mutex		_mutex;
+			ClientQueues	_interactiveQueues;
+			ClientQueues	_prefetchQueues;
+			std::unordered_map<std::string, std::size_t>	_queuedCountByClient;
+			std::unordered_map<std::string, std::size_t>	_runningCountByClient;
+			std::size_t		_runningCount {};
+	};
+} // namespace Av
+
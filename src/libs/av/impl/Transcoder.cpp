@@ -21,12 +21,15 @@
 
 #include <atomic>
 #include <iomanip>
+#include <sstream>
 
 #include "utils/IChildProcessManager.hpp"
 #include "utils/IConfig.hpp"
 #include "utils/Path.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
 #include "utils/Service.hpp"
+#include "utils/Tracing.hpp"
 
 namespace Av {
 
@@ -44,8 +47,13 @@ Transcoder::init()
 }
 
 Transcoder::Transcoder(const std::filesystem::path& filePath, const TranscodeParameters& parameters)
+: Transcoder {std::vector<std::filesystem::path> {filePath}, parameters}
+{
+}
+
+Transcoder::Transcoder(const std::vector<std::filesystem::path>& filePaths, const TranscodeParameters& parameters)
 :  _id {globalId++}
-, _filePath {filePath}
+, _filePaths {filePaths}
 , _parameters {parameters}
 {
 	start();
@@ -59,20 +67,26 @@ Transcoder::start()
 	if (ffmpegPath.empty())
 		init();
 
-	try
-	{
-		if (!std::filesystem::exists(_filePath))
-			throw Exception {"File '" + _filePath.string() + "' does not exist!"};
-		else if (!std::filesystem::is_regular_file( _filePath) )
-			throw Exception {"File '" + _filePath.string() + "' is not regular!"};
-	}
-	catch (const std::filesystem::filesystem_error& e)
+	if (_filePaths.empty())
+		throw Exception {"No file to transcode!"};
+
+	for (const std::filesystem::path& filePath : _filePaths)
 	{
-		throw Exception {"File error '" + _filePath.string() + "': " + e.what()};
+		try
+		{
+			if (!std::filesystem::exists(filePath))
+				throw Exception {"File '" + filePath.string() + "' does not exist!"};
+			else if (!std::filesystem::is_regular_file(filePath))
+				throw Exception {"File '" + filePath.string() + "' is not regular!"};
+		}
+		catch (const std::filesystem::filesystem_error& e)
+		{
+			throw Exception {"File error '" + filePath.string() + "': " + e.what()};
+		}
+
+		LOG(INFO) << "Transcoding file '" << filePath.string() << "'";
 	}
 
-	LOG(INFO) << "Transcoding file '" << _filePath.string() << "'";
-
 	std::vector<std::string> args;
 
 	args.emplace_back(ffmpegPath.string());
@@ -94,12 +108,28 @@ Transcoder::start()
 		args.emplace_back(oss.str());
 	}
 
-	// Input file
-	args.emplace_back("-i");
-	args.emplace_back(_filePath.string());
+	// Input files
+	for (const std::filesystem::path& filePath : _filePaths)
+	{
+		args.emplace_back("-i");
+		args.emplace_back(filePath.string());
+	}
 
+	if (_filePaths.size() > 1)
+	{
+		// Decoded audio is concatenated and fed to a single encoder, so that there is no gap between files
+		std::ostringstream filter;
+		for (std::size_t i {}; i < _filePaths.size(); ++i)
+			filter << "[" << i << ":" << (_parameters.stream ? std::to_string(*_parameters.stream) : "a:0") << "]";
+		filter << "concat=n=" << _filePaths.size() << ":v=0:a=1[out]";
+
+		args.emplace_back("-filter_complex");
+		args.emplace_back(filter.str());
+		args.emplace_back("-map");
+		args.emplace_back("[out]");
+	}
 	// Stream mapping, if set
-	if (_parameters.stream)
+	else if (_parameters.stream)
 	{
 		args.emplace_back("-map");
 		args.emplace_back("0:" + std::to_string(*_parameters.stream));
@@ -115,46 +145,100 @@ Transcoder::start()
 	// Skip video flows (including covers)
 	args.emplace_back("-vn");
 
-	// Output bitrates
-	args.emplace_back("-b:a");
-	args.emplace_back(std::to_string(_parameters.bitrate));
+	// Output duration, if set
+	if (_parameters.duration)
+	{
+		args.emplace_back("-t");
+
+		std::ostringstream oss;
+		oss << std::fixed << std::showpoint << std::setprecision(3) << (_parameters.duration->count() / float {1000});
+		args.emplace_back(oss.str());
+	}
+
+	// Output bitrates, irrelevant when the audio stream is just copied
+	if (!_parameters.copyAudio)
+	{
+		args.emplace_back("-b:a");
+		args.emplace_back(std::to_string(_parameters.bitrate));
+	}
+
+	auto addAudioCodec {[&](const char* encoder)
+	{
+		args.emplace_back("-acodec");
+		args.emplace_back(_parameters.copyAudio ? "copy" : encoder);
+	}};
+
+	// Encoder settings, irrelevant when the audio stream is just copied
+	if (!_parameters.copyAudio)
+	{
+		const EncoderSettings& encoder {_parameters.encoder};
+
+		if (encoder.compressionLevel)
+		{
+			args.emplace_back("-compression_level");
+			args.emplace_back(std::to_string(*encoder.compressionLevel));
+		}
+
+		if (encoder.sampleRate)
+		{
+			args.emplace_back("-ar");
+			args.emplace_back(std::to_string(*encoder.sampleRate));
+		}
+
+		if (encoder.frameDuration && (_parameters.format == Format::OGG_OPUS || _parameters.format == Format::MATROSKA_OPUS))
+		{
+			args.emplace_back("-frame_duration");
+			args.emplace_back(std::to_string(encoder.frameDuration->count()));
+		}
+	}
 
 	// Codecs and formats
 	switch (_parameters.format)
 	{
 		case Format::MP3:
+			if (_parameters.copyAudio)
+				addAudioCodec("copy");
 			args.emplace_back("-f");
 			args.emplace_back("mp3");
 			break;
 
 		case Format::OGG_OPUS:
-			args.emplace_back("-acodec");
-			args.emplace_back("libopus");
+			addAudioCodec("libopus");
 			args.emplace_back("-f");
 			args.emplace_back("ogg");
 			break;
 
 		case Format::MATROSKA_OPUS:
-			args.emplace_back("-acodec");
-			args.emplace_back("libopus");
+			addAudioCodec("libopus");
 			args.emplace_back("-f");
 			args.emplace_back("matroska");
 			break;
 
 		case Format::OGG_VORBIS:
-			args.emplace_back("-acodec");
-			args.emplace_back("libvorbis");
+			addAudioCodec("libvorbis");
 			args.emplace_back("-f");
 			args.emplace_back("ogg");
 			break;
 
 		case Format::WEBM_VORBIS:
-			args.emplace_back("-acodec");
-			args.emplace_back("libvorbis");
+			addAudioCodec("libvorbis");
 			args.emplace_back("-f");
 			args.emplace_back("webm");
 			break;
 
+		case Format::MPEGTS_MP3:
+			addAudioCodec("libmp3lame");
+			args.emplace_back("-f");
+			args.emplace_back("mpegts");
+			if (_parameters.offset.count() > 0)
+			{
+				std::ostringstream oss;
+				oss << std::fixed << std::showpoint << std::setprecision(3) << (_parameters.offset.count() / float {1000});
+				args.emplace_back("-output_ts_offset");
+				args.emplace_back(oss.str());
+			}
+			break;
+
 		default:
 			throw Exception {"Unhandled format (" + std::to_string(static_cast<int>(_parameters.format)) + ")"};
 	}
@@ -170,7 +254,11 @@ Transcoder::start()
 	// Caution: stdin must have been closed before
 	try
 	{
-		_childProcess = Service<IChildProcessManager>::get()->spawnChildProcess(ffmpegPath, args);
+		static Metrics::Histogram& spawnDurations {Metrics::getRegistry().createHistogram("lms_transcode_ffmpeg_spawn_duration_seconds", "Time spent to spawn the ffmpeg processes")};
+		const Metrics::ScopedTimer timer {spawnDurations};
+		const Tracing::ScopedSpan span {"transcode.spawn"};
+
+		_childProcess = Service<IChildProcessManager>::get()->spawnChildProcess(ffmpegPath, args, CpuPlacement::Workload::Transcoder);
 	}
 	catch (ChildProcessException& exception)
 	{
@@ -218,4 +306,12 @@ Transcoder::finished() const
 	return _childProcess->finished();
 }
 
+bool
+Transcoder::succeeded() const
+{
+	assert(_childProcess);
+
+	return _childProcess->succeeded();
+}
+
 } // namespace Transcode
@@ -21,7 +21,9 @@
 
 #include <filesystem>
 #include <functional>
+#include <vector>
 
+#include "av/ITranscoder.hpp"
 #include "av/TranscodeParameters.hpp"
 #include "av/Types.hpp"
 
@@ -29,10 +31,13 @@ class IChildProcess;
 
 namespace Av
 {
-	class Transcoder
+	// Transcodes using a ffmpeg child process
+	class Transcoder final : public ITranscoder
 	{
 		public:
 			Transcoder(const std::filesystem::path& file, const TranscodeParameters& parameters);
+			// Files are concatenated before being encoded, the offset only applies to the first one
+			Transcoder(const std::vector<std::filesystem::path>& files, const TranscodeParameters& parameters);
 			~Transcoder();
 
 			Transcoder(const Transcoder&) = delete;
@@ -44,14 +49,14 @@ namespace Av
 			void			asyncWaitForData(WaitCallback cb);
 
 			// non blocking calls
-			using ReadCallback = std::function<void(std::size_t nbReadBytes)>;
-			void			asyncRead(std::byte* buffer, std::size_t bufferSize, ReadCallback);
+			void			asyncRead(std::byte* buffer, std::size_t bufferSize, ReadCallback) override;
 			std::size_t		readSome(std::byte* buffer, std::size_t bufferSize);
 
-			const std::string&	getOutputMimeType() const { return _outputMimeType; }
-			const TranscodeParameters& getParameters() const { return _parameters; }
+			const std::string&	getOutputMimeType() const override { return _outputMimeType; }
+			const TranscodeParameters& getParameters() const override { return _parameters; }
 
-			bool			finished() const;
+			bool			finished() const override;
+			bool			succeeded() const override;
 
 		private:
 			static void init();
@@ -59,7 +64,7 @@ namespace Av
 			void start();
 
 			const std::size_t		_id {};
-			const std::filesystem::path	_filePath;
+			const std::vector<std::filesystem::path>	_filePaths;
 			const TranscodeParameters	_parameters;
 
 			std::unique_ptr<IChildProcess>	_childProcess;
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "av/ITranscoder.hpp"
+
+#include "av/Types.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/Service.hpp"
+#include "LibAvTranscoder.hpp"
+#include "Transcoder.hpp"
+
+namespace Av
+{
+	std::unique_ptr<ITranscoder>
+	createTranscoder(const std::filesystem::path& trackPath, const TranscodeParameters& parameters)
+	{
+		return createTranscoder(std::vector<std::filesystem::path> {trackPath}, parameters);
+	}
+
+	std::unique_ptr<ITranscoder>
+	createTranscoder(const std::vector<std::filesystem::path>& trackPaths, const TranscodeParameters& parameters)
+	{
+		static const TranscoderBackend backend {Service<IConfig>::get()->getString("transcoder-backend", "ffmpeg") == "libav" ? TranscoderBackend::LibAv : TranscoderBackend::FFmpeg};
+
+		return createTranscoder(trackPaths, parameters, backend);
+	}
+
+	std::unique_ptr<ITranscoder>
+	createTranscoder(const std::vector<std::filesystem::path>& trackPaths, const TranscodeParameters& parameters, TranscoderBackend backend)
+	{
+		switch (backend)
+		{
+			case TranscoderBackend::FFmpeg:	return std::make_unique<Transcoder>(trackPaths, parameters);
+			case TranscoderBackend::LibAv:	return std::make_unique<LibAvTranscoder>(trackPaths, parameters);
+		}
+
+		throw Exception {"Unhandled transcoder backend"};
+	}
+} // namespace Av
@@ -32,6 +32,7 @@ namespace Av
 			case Format::MATROSKA_OPUS:	return "audio/x-matroska";
 			case Format::OGG_VORBIS:	return "audio/ogg";
 			case Format::WEBM_VORBIS:	return "audio/webm";
+			case Format::MPEGTS_MP3:	return "video/mp2t";
 		}
 
 		throw Exception {"Invalid encoding"};
@@ -26,13 +26,24 @@
 
 namespace Av
 {
+	// Trade some quality for less CPU, encoder defaults by default
+	struct EncoderSettings
+	{
+		std::optional<unsigned>						compressionLevel; // encoder effort, as understood by the encoder (libopus: 0 (fastest) - 10, libmp3lame: 9 (fastest) - 0)
+		std::optional<std::chrono::milliseconds>	frameDuration; // opus only, larger frames are cheaper to encode
+		std::optional<unsigned>						sampleRate; // resample the output, must be supported by the encoder (opus: 48000, 24000, 16000, 12000, 8000)
+	};
+
 	struct TranscodeParameters
 	{
 		Format						format;
 		std::size_t					bitrate {128000};
 		std::optional<std::size_t>	stream; // Id of the stream to be transcoded (auto detect by default)
 		std::chrono::milliseconds	offset {0};
+		std::optional<std::chrono::milliseconds>	duration; // Only transcode this duration (until the end by default)
 		bool 						stripMetadata {true};
+		EncoderSettings				encoder;
+		bool						copyAudio {}; // Only change the container, the audio stream must already use the format codec (not supported by the libav backend, that always encodes)
 	};
 } // namespace Av
 
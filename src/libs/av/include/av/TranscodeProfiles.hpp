@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "av/TranscodeParameters.hpp"
+
+namespace Av
+{
+	// Named set of transcode settings, used to serve more streams per core on weak hosts or for some device classes
+	struct TranscodeProfile
+	{
+		std::string					name;
+		std::optional<Format>		format;		// replaces the requested format
+		std::optional<std::size_t>	maxBitrate;	// caps the requested bitrate
+		EncoderSettings				encoder;
+	};
+
+	// Reads the profiles and their assignments from the configuration, throws on bad values
+	void initTranscodeProfiles();
+
+	// Most specific assignment first: Subsonic client name, user login name, then the default profile
+	// Returns nullptr if no profile applies
+	const TranscodeProfile* findTranscodeProfile(std::string_view userLoginName, std::optional<std::string_view> subsonicClientName = std::nullopt);
+
+	void applyTranscodeProfile(const TranscodeProfile& profile, TranscodeParameters& parameters);
+} // namespace Av
@@ -19,8 +19,13 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <filesystem>
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include "utils/IResourceHandler.hpp"
 
@@ -28,6 +33,46 @@ namespace Av
 {
 	struct TranscodeParameters;
 
-	std::unique_ptr<IResourceHandler> createTranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters);
+	enum class TranscodePriority
+	{
+		Interactive,	// someone is waiting for the playback
+		Prefetch,		// offline caching, etc.
+	};
+
+	struct TranscodeRequestInfo
+	{
+		// Used to schedule the transcodes fairly
+		std::string			clientId;	// usually the user
+		TranscodePriority	priority {TranscodePriority::Interactive};
+
+		// If set, a content length of bitrate x duration is declared and byte ranges are served
+		std::optional<std::chrono::milliseconds>	trackDuration;
+	};
+
+	struct TranscodeLoad
+	{
+		std::size_t	runningCount {};
+		std::size_t	queuedCount {};	// waiting for a slot
+	};
+	// Never waits for the scheduler, values may be slightly out of date
+	TranscodeLoad getTranscodeLoad();
+
+	// The transcode may wait for other ones to complete, the response is a 503 if too many transcodes are queued for this client
+	std::unique_ptr<IResourceHandler> createTranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const TranscodeRequestInfo& requestInfo = {});
+
+	struct TranscodeSessionTrack
+	{
+		std::filesystem::path		path;
+		std::chrono::milliseconds	duration;	// used to announce where the next tracks start
+	};
+
+	// Transcodes consecutive tracks using a single encoder, so that the output is gapless
+	// The offset only applies to the first track, the duration and the stream are not used
+	// The start offsets of the tracks in the output are given in the "X-Track-Offsets" response header (comma separated, in milliseconds)
+	std::unique_ptr<IResourceHandler> createTranscodeSessionResourceHandler(const std::vector<TranscodeSessionTrack>& tracks, const TranscodeParameters& parameters, const TranscodeRequestInfo& requestInfo = {});
+
+	// Transcodes in the background into the transcode cache, so that a later request with the same parameters is served right away
+	// No effect if the cache is disabled, or if the output is already cached or being transcoded
+	void prefetchTranscode(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const std::string& clientId);
 }
 
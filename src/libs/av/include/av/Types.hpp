@@ -38,6 +38,7 @@ namespace Av {
 		MATROSKA_OPUS,
 		OGG_VORBIS,
 		WEBM_VORBIS,
+		MPEGTS_MP3,		// timestamps start at the transcode offset
 	};
 
 	std::string_view formatToMimetype(Format format);
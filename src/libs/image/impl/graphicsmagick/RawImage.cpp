@@ -22,19 +22,20 @@
 #include <magick/resource.h>
 
 #include "JPEGImage.hpp"
+#include "WebPImage.hpp"
 #include "image/Exception.hpp"
 #include "utils/Logger.hpp"
 
 namespace Image
 {
-	std::unique_ptr<IRawImage> decodeImage(const std::byte* encodedData, std::size_t encodedDataSize)
+	std::unique_ptr<IRawImage> decodeImage(const std::byte* encodedData, std::size_t encodedDataSize, std::optional<ImageSize> sizeHint)
 	{
-		return std::make_unique<GraphicsMagick::RawImage>(encodedData, encodedDataSize);
+		return std::make_unique<GraphicsMagick::RawImage>(encodedData, encodedDataSize, sizeHint);
 	}
 
-	std::unique_ptr<IRawImage> decodeImage(const std::filesystem::path& path)
+	std::unique_ptr<IRawImage> decodeImage(const std::filesystem::path& path, std::optional<ImageSize> sizeHint)
 	{
-		return std::make_unique<GraphicsMagick::RawImage>(path);
+		return std::make_unique<GraphicsMagick::RawImage>(path, sizeHint);
 	}
 
 	void
@@ -53,16 +54,48 @@ namespace Image
 
 		LMS_LOG(COVER, INFO) << "Magick threads resource limit = " << GetMagickResourceLimit(MagickLib::ThreadsResource);
 		LMS_LOG(COVER, INFO) << "Magick Disk resource limit = " << GetMagickResourceLimit(MagickLib::DiskResource);
+		LMS_LOG(COVER, INFO) << "Magick WebP export supported = " << isEncodingSupported(EncodingFormat::WebP);
+	}
+
+	bool
+	isEncodingSupported(EncodingFormat format)
+	{
+		// depends on the delegates GraphicsMagick has been built with
+		auto isWritable {[](const char* name)
+		{
+			try
+			{
+				return Magick::CoderInfo {name}.isWritable();
+			}
+			catch (Magick::Exception&)
+			{
+				return false;
+			}
+		}};
+
+		switch (format)
+		{
+			case EncodingFormat::JPEG:	return true;
+			case EncodingFormat::WebP:
+			{
+				static const bool isWebPWritable {isWritable("WEBP")};
+				return isWebPWritable;
+			}
+		}
+
+		return false;
 	}
 }
 
 namespace Image::GraphicsMagick
 {
 
-RawImage::RawImage(const std::byte* encodedData, std::size_t encodedDataSize)
+RawImage::RawImage(const std::byte* encodedData, std::size_t encodedDataSize, std::optional<ImageSize> sizeHint)
 {
 	try
 	{
+		setSizeHint(sizeHint);
+
 		Magick::Blob blob {encodedData, encodedDataSize};
 		_image.read(blob);
 	}
@@ -82,10 +115,12 @@ RawImage::RawImage(const std::byte* encodedData, std::size_t encodedDataSize)
 	}
 }
 
-RawImage::RawImage(const std::filesystem::path& p)
+RawImage::RawImage(const std::filesystem::path& p, std::optional<ImageSize> sizeHint)
 {
 	try
 	{
+		setSizeHint(sizeHint);
+
 		_image.read(p.string().c_str());
 	}
 	catch (Magick::WarningCoder& e)
@@ -104,6 +139,14 @@ RawImage::RawImage(const std::filesystem::path& p)
 	}
 }
 
+void
+RawImage::setSizeHint(std::optional<ImageSize> sizeHint)
+{
+	// Used by the JPEG coder to decode at 1/2, 1/4 or 1/8 scale, never below the requested size
+	if (sizeHint)
+		_image.size(Magick::Geometry {static_cast<unsigned int>(*sizeHint), static_cast<unsigned int>(*sizeHint)});
+}
+
 void
 RawImage::resize(ImageSize width)
 {
@@ -124,6 +167,12 @@ RawImage::encodeToJPEG(unsigned quality) const
 	return std::make_unique<JPEGImage>(*this, quality);
 }
 
+std::unique_ptr<IEncodedImage>
+RawImage::encodeToWebP(unsigned quality) const
+{
+	return std::make_unique<WebPImage>(*this, quality);
+}
+
 Magick::Image
 RawImage::getMagickImage() const
 {
@@ -27,6 +27,7 @@
 
 #include <cstddef>
 #include <filesystem>
+#include <optional>
 
 #include "image/IEncodedImage.hpp"
 #include "image/IRawImage.hpp"
@@ -36,15 +37,18 @@ namespace Image::GraphicsMagick
 	class RawImage : public IRawImage
 	{
 		public:
-			RawImage(const std::byte* encodedData, std::size_t encodedDataSize);
-			RawImage(const std::filesystem::path& path);
+			RawImage(const std::byte* encodedData, std::size_t encodedDataSize, std::optional<ImageSize> sizeHint);
+			RawImage(const std::filesystem::path& path, std::optional<ImageSize> sizeHint);
 
 			void resize(ImageSize width) override;
 			std::unique_ptr<IEncodedImage> encodeToJPEG(unsigned quality) const override;
+			std::unique_ptr<IEncodedImage> encodeToWebP(unsigned quality) const override;
 
 		private:
 			friend class JPEGImage;
+			friend class WebPImage;
 			Magick::Image getMagickImage() const;
+			void setSizeHint(std::optional<ImageSize> sizeHint);
 
 			Magick::Image _image;
 	};
@@ -19,51 +19,105 @@
 
 #include "RawImage.hpp"
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <fstream>
+#include <vector>
 
-#define STBIR_DEFAULT_FILTER_DOWNSAMPLE   STBIR_FILTER_MITCHELL
-#define STBIR_DEFAULT_FILTER_UPSAMPLE   STBIR_FILTER_CATMULLROM
+#define STB_IMAGE_IMPLEMENTATION
 
 #include <stb/stb_image.h>
-#include <stb/stb_image_resize.h>
 
 #include "JPEGImage.hpp"
+#include "Resize.hpp"
+#if LMS_SUPPORT_IMAGE_TURBOJPEG
+#include "ScaledJPEGDecoder.hpp"
+#endif
+#if LMS_SUPPORT_IMAGE_WEBP
+#include "WebPImage.hpp"
+#endif
 
 #include "image/Exception.hpp"
 
 namespace Image
 {
-	std::unique_ptr<IRawImage> decodeImage(const std::byte* encodedData, std::size_t encodedDataSize)
+	std::unique_ptr<IRawImage> decodeImage(const std::byte* encodedData, std::size_t encodedDataSize, std::optional<ImageSize> sizeHint)
 	{
-		return std::make_unique<STB::RawImage>(encodedData, encodedDataSize);
+		return std::make_unique<STB::RawImage>(encodedData, encodedDataSize, sizeHint);
 	}
 
-	std::unique_ptr<IRawImage> decodeImage(const std::filesystem::path& path)
+	std::unique_ptr<IRawImage> decodeImage(const std::filesystem::path& path, std::optional<ImageSize> sizeHint)
 	{
-		return std::make_unique<STB::RawImage>(path);
+		return std::make_unique<STB::RawImage>(path, sizeHint);
 	}
 
 	void
 	init(const std::filesystem::path&)
 	{
 	}
+
+	bool
+	isEncodingSupported(EncodingFormat format)
+	{
+		switch (format)
+		{
+			case EncodingFormat::JPEG:	return true;
+#if LMS_SUPPORT_IMAGE_WEBP
+			case EncodingFormat::WebP:	return true;
+#else
+			case EncodingFormat::WebP:	return false;
+#endif
+		}
+
+		return false;
+	}
 }
 
 namespace Image::STB
 {
-	RawImage::RawImage(const std::byte* encodedData, std::size_t encodedDataSize)
+	RawImage::RawImage(const std::byte* encodedData, std::size_t encodedDataSize, std::optional<ImageSize> sizeHint)
+	{
+		load(encodedData, encodedDataSize, sizeHint);
+	}
+
+	RawImage::RawImage(const std::filesystem::path& p, std::optional<ImageSize> sizeHint)
 	{
+#if LMS_SUPPORT_IMAGE_TURBOJPEG
+		if (sizeHint)
+		{
+			// stb reads the whole file anyway
+			std::ifstream ifs {p, std::ios::in | std::ios::binary | std::ios::ate};
+			if (!ifs)
+				throw ImageException {"Cannot open file '" + p.string() + "'"};
+
+			std::vector<std::byte> encodedData(static_cast<std::size_t>(ifs.tellg()));
+			ifs.seekg(0);
+			if (!ifs.read(reinterpret_cast<char*>(encodedData.data()), encodedData.size()))
+				throw ImageException {"Cannot read file '" + p.string() + "'"};
+
+			load(encodedData.data(), encodedData.size(), sizeHint);
+			return;
+		}
+#endif
+
 		int n;
-		_data = UniquePtrFree {stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(encodedData), encodedDataSize, &_width, &_height, &n, 3), std::free};
+		_data = UniquePtrFree {stbi_load(p.string().c_str(), &_width, &_height, &n, 3), std::free};
 		if (!_data)
 			throw ImageException {"Cannot load image from memory"};
 	}
 
-	RawImage::RawImage(const std::filesystem::path& p)
+	void
+	RawImage::load(const std::byte* encodedData, std::size_t encodedDataSize, [[maybe_unused]] std::optional<ImageSize> sizeHint)
 	{
+#if LMS_SUPPORT_IMAGE_TURBOJPEG
+		if (sizeHint)
+		{
+			_data = decodeScaledJPEG(encodedData, encodedDataSize, *sizeHint, _width, _height);
+			if (_data)
+				return;
+		}
+#endif
+
 		int n;
-		_data = UniquePtrFree {stbi_load(p.string().c_str(), &_width, &_height, &n, 3), std::free};
+		_data = UniquePtrFree {stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(encodedData), encodedDataSize, &_width, &_height, &n, 3), std::free};
 		if (!_data)
 			throw ImageException {"Cannot load image from memory"};
 	}
@@ -90,12 +144,7 @@ namespace Image::STB
 		if (!resizedData)
 			throw ImageException {"Cannot allocate memory for resized image!"};
 
-		if (stbir_resize_uint8_srgb(reinterpret_cast<const unsigned char*>(_data.get()), _width, _height, 0,
-					reinterpret_cast<unsigned char*>(resizedData.get()), width, height, 0,
-					3, STBIR_ALPHA_CHANNEL_NONE, 0) == 0)
-		{
-			throw ImageException {"Failed to resize image!"};
-		}
+		resizeRGB8(_data.get(), _width, _height, resizedData.get(), width, height);
 
 		_data = std::move(resizedData);
 		_height = height;
@@ -108,6 +157,16 @@ namespace Image::STB
 		return std::make_unique<JPEGImage>(*this, quality);
 	}
 
+	std::unique_ptr<IEncodedImage>
+	RawImage::encodeToWebP([[maybe_unused]] unsigned quality) const
+	{
+#if LMS_SUPPORT_IMAGE_WEBP
+		return std::make_unique<WebPImage>(*this, quality);
+#else
+		throw ImageException {"WebP export not supported!"};
+#endif
+	}
+
 	ImageSize
 	RawImage::getWidth() const
 	{
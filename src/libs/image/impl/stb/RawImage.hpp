@@ -25,6 +25,7 @@
 
 #include <cstddef>
 #include <filesystem>
+#include <optional>
 
 #include "image/IEncodedImage.hpp"
 #include "image/IRawImage.hpp"
@@ -34,17 +35,20 @@ namespace Image::STB
 	class RawImage : public IRawImage
 	{
 		public:
-			RawImage(const std::byte* encodedData, std::size_t encodedDataSize);
-			RawImage(const std::filesystem::path& path);
+			RawImage(const std::byte* encodedData, std::size_t encodedDataSize, std::optional<ImageSize> sizeHint);
+			RawImage(const std::filesystem::path& path, std::optional<ImageSize> sizeHint);
 
 			void resize(ImageSize width) override;
 			std::unique_ptr<IEncodedImage> encodeToJPEG(unsigned quality) const override;
+			std::unique_ptr<IEncodedImage> encodeToWebP(unsigned quality) const override;
 
 			ImageSize getWidth() const;
 			ImageSize getHeight() const;
 			const std::byte* getData() const;
 
 		private:
+			void load(const std::byte* encodedData, std::size_t encodedDataSize, std::optional<ImageSize> sizeHint);
+
 			int _width;
 			int _height;
 			using UniquePtrFree = std::unique_ptr<unsigned char, decltype(&std::free)>;
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Resize.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "image/Exception.hpp"
+#include "utils/TargetClones.hpp"
+
+// The kernels are written so that the compiler vectorizes them
+// On x86-64 (glibc), several versions are built and picked at load time depending on the CPU
+#define LMS_RESIZE_KERNEL LMS_TARGET_CLONES("avx2", "sse4.1", "default")
+
+namespace Image::STB
+{
+	namespace
+	{
+		constexpr std::size_t channelCount {3};
+		constexpr std::size_t linearToSRGBTableSize {1 << 12};
+
+		struct Contributions
+		{
+			std::size_t tapCount {};
+			std::vector<int> firstIndexes;	// per output pixel
+			std::vector<float> weights;		// tapCount per output pixel
+		};
+
+		// Mitchell-Netravali family, support is [-2, 2]
+		float
+		cubicFilter(float x, float b, float c)
+		{
+			x = std::abs(x);
+			if (x < 1.f)
+				return ((12.f - 9.f * b - 6.f * c) * x * x * x + (-18.f + 12.f * b + 6.f * c) * x * x + (6.f - 2.f * b)) / 6.f;
+			if (x < 2.f)
+				return ((-b - 6.f * c) * x * x * x + (6.f * b + 30.f * c) * x * x + (-12.f * b - 48.f * c) * x + (8.f * b + 24.f * c)) / 6.f;
+
+			return 0.f;
+		}
+
+		Contributions
+		computeContributions(int inputSize, int outputSize)
+		{
+			const float scale {static_cast<float>(outputSize) / inputSize};
+			const bool downsample {scale < 1.f};
+			// Mitchell (1/3, 1/3) or Catmull-Rom (0, 1/2)
+			const float b {downsample ? 1.f / 3.f : 0.f};
+			const float c {downsample ? 1.f / 3.f : 0.5f};
+			const float filterScale {downsample ? scale : 1.f};
+			const float radius {2.f / filterScale};
+			const int windowSize {static_cast<int>(std::ceil(radius * 2)) + 1};
+
+			Contributions res;
+			res.tapCount = std::min(windowSize, inputSize);
+			res.firstIndexes.resize(outputSize);
+			res.weights.resize(outputSize * res.tapCount, 0.f);
+
+			for (int i {}; i < outputSize; ++i)
+			{
+				const float center {(i + 0.5f) / scale};
+				const int first {static_cast<int>(std::floor(center - radius))};
+				// edges are clamped: out of range samples fold onto the border pixels
+				const int windowFirst {std::clamp(first, 0, inputSize - static_cast<int>(res.tapCount))};
+
+				float* weights {&res.weights[i * res.tapCount]};
+				float totalWeight {};
+				for (int j {first}; j < first + windowSize; ++j)
+				{
+					const float weight {cubicFilter((j + 0.5f - center) * filterScale, b, c)};
+					weights[std::clamp(j, 0, inputSize - 1) - windowFirst] += weight;
+					totalWeight += weight;
+				}
+
+				if (totalWeight != 0.f)
+				{
+					for (std::size_t tap {}; tap < res.tapCount; ++tap)
+						weights[tap] /= totalWeight;
+				}
+
+				res.firstIndexes[i] = windowFirst;
+			}
+
+			return res;
+		}
+
+		const std::array<float, 256>&
+		getSRGBToLinearTable()
+		{
+			static const std::array<float, 256> table {[]
+			{
+				std::array<float, 256> res;
+				for (std::size_t i {}; i < res.size(); ++i)
+				{
+					const float value {i / 255.f};
+					res[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+				}
+				return res;
+			}()};
+
+			return table;
+		}
+
+		const std::array<unsigned char, linearToSRGBTableSize>&
+		getLinearToSRGBTable()
+		{
+			static const std::array<unsigned char, linearToSRGBTableSize> table {[]
+			{
+				std::array<unsigned char, linearToSRGBTableSize> res;
+				for (std::size_t i {}; i < res.size(); ++i)
+				{
+					const float value {static_cast<float>(i) / (res.size() - 1)};
+					const float srgb {value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f};
+					res[i] = static_cast<unsigned char>(std::clamp(srgb * 255.f + 0.5f, 0.f, 255.f));
+				}
+				return res;
+			}()};
+
+			return table;
+		}
+
+		LMS_RESIZE_KERNEL
+		void
+		resizeRow(const float* __restrict input, float* __restrict output, std::size_t outputWidth, const Contributions& contributions)
+		{
+			const std::size_t tapCount {contributions.tapCount};
+
+			for (std::size_t x {}; x < outputWidth; ++x)
+			{
+				const float* __restrict pixels {input + contributions.firstIndexes[x] * channelCount};
+				const float* __restrict weights {&contributions.weights[x * tapCount]};
+
+				float r {};
+				float g {};
+				float b {};
+				for (std::size_t tap {}; tap < tapCount; ++tap)
+				{
+					r += weights[tap] * pixels[tap * channelCount + 0];
+					g += weights[tap] * pixels[tap * channelCount + 1];
+					b += weights[tap] * pixels[tap * channelCount + 2];
+				}
+
+				output[x * channelCount + 0] = r;
+				output[x * channelCount + 1] = g;
+				output[x * channelCount + 2] = b;
+			}
+		}
+
+		LMS_RESIZE_KERNEL
+		void
+		accumulateRow(const float* __restrict input, float weight, float* __restrict output, std::size_t size)
+		{
+			for (std::size_t i {}; i < size; ++i)
+				output[i] += weight * input[i];
+		}
+	}
+
+	void
+	resizeRGB8(const unsigned char* input, int inputWidth, int inputHeight,
+			unsigned char* output, int outputWidth, int outputHeight)
+	{
+		if (inputWidth <= 0 || inputHeight <= 0 || outputWidth <= 0 || outputHeight <= 0)
+			throw ImageException {"Bad image dimensions!"};
+
+		const Contributions horizontalContributions {computeContributions(inputWidth, outputWidth)};
+		const Contributions verticalContributions {computeContributions(inputHeight, outputHeight)};
+		const std::array<float, 256>& srgbToLinear {getSRGBToLinearTable()};
+		const std::array<unsigned char, linearToSRGBTableSize>& linearToSRGB {getLinearToSRGBTable()};
+
+		const std::size_t inputRowSize {static_cast<std::size_t>(inputWidth) * channelCount};
+		const std::size_t outputRowSize {static_cast<std::size_t>(outputWidth) * channelCount};
+
+		// horizontal pass first: all the input rows, in linear light
+		std::vector<float> linearRow(inputRowSize);
+		std::vector<float> horizontallyResized(outputRowSize * inputHeight);
+		for (std::size_t y {}; y < static_cast<std::size_t>(inputHeight); ++y)
+		{
+			const unsigned char* inputRow {input + y * inputRowSize};
+			for (std::size_t i {}; i < inputRowSize; ++i)
+				linearRow[i] = srgbToLinear[inputRow[i]];
+
+			resizeRow(linearRow.data(), &horizontallyResized[y * outputRowSize], outputWidth, horizontalContributions);
+		}
+
+		// vertical pass, back to sRGB
+		std::vector<float> outputRow(outputRowSize);
+		for (std::size_t y {}; y < static_cast<std::size_t>(outputHeight); ++y)
+		{
+			std::fill(std::begin(outputRow), std::end(outputRow), 0.f);
+
+			const std::size_t firstIndex {static_cast<std::size_t>(verticalContributions.firstIndexes[y])};
+			for (std::size_t tap {}; tap < verticalContributions.tapCount; ++tap)
+			{
+				accumulateRow(&horizontallyResized[(firstIndex + tap) * outputRowSize],
+						verticalContributions.weights[y * verticalContributions.tapCount + tap],
+						outputRow.data(), outputRowSize);
+			}
+
+			unsigned char* dstRow {output + y * outputRowSize};
+			for (std::size_t i {}; i < outputRowSize; ++i)
+			{
+				const float value {std::clamp(outputRow[i], 0.f, 1.f)};
+				dstRow[i] = linearToSRGB[static_cast<std::size_t>(value * (linearToSRGBTableSize - 1) + 0.5f)];
+			}
+		}
+	}
+}
+
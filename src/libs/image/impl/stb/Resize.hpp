@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+namespace Image::STB
+{
+	// Separable resampling of packed RGB8 pixels, done in linear light
+	// Mitchell filter when downsampling, Catmull-Rom when upsampling (same as the stb defaults we use)
+	// Throws ImageException on bad dimensions
+	void resizeRGB8(const unsigned char* input, int inputWidth, int inputHeight,
+			unsigned char* output, int outputWidth, int outputHeight);
+}
+
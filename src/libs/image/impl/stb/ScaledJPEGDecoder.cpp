@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ScaledJPEGDecoder.hpp"
+
+#include <algorithm>
+#include <array>
+
+#include <turbojpeg.h>
+
+#include "utils/Logger.hpp"
+
+namespace Image::STB
+{
+	namespace
+	{
+		struct ScalingFactor
+		{
+			int num;
+			int denom;
+		};
+
+		// smallest first
+		constexpr std::array<ScalingFactor, 3> scalingFactors {{ {1, 8}, {1, 4}, {1, 2} }};
+
+		int
+		getScaledSize(int size, ScalingFactor factor)
+		{
+			return (size * factor.num + factor.denom - 1) / factor.denom; // same as TJSCALED
+		}
+
+		bool
+		isJPEG(const std::byte* encodedData, std::size_t encodedDataSize)
+		{
+			return encodedDataSize >= 3
+				&& encodedData[0] == std::byte {0xFF}
+				&& encodedData[1] == std::byte {0xD8}
+				&& encodedData[2] == std::byte {0xFF};
+		}
+	}
+
+	std::unique_ptr<unsigned char, decltype(&std::free)>
+	decodeScaledJPEG(const std::byte* encodedData, std::size_t encodedDataSize, ImageSize sizeHint, int& width, int& height)
+	{
+		std::unique_ptr<unsigned char, decltype(&std::free)> res {nullptr, std::free};
+
+		if (!isJPEG(encodedData, encodedDataSize))
+			return res;
+
+		std::unique_ptr<void, decltype(&tjDestroy)> handle {tjInitDecompress(), tjDestroy};
+		if (!handle)
+			return res;
+
+		const unsigned char* jpegData {reinterpret_cast<const unsigned char*>(encodedData)};
+
+		int jpegWidth;
+		int jpegHeight;
+		int jpegSubsamp;
+		int jpegColorspace;
+		if (tjDecompressHeader3(handle.get(), jpegData, encodedDataSize, &jpegWidth, &jpegHeight, &jpegSubsamp, &jpegColorspace) != 0)
+			return res;
+
+		const int maxSize {std::max(jpegWidth, jpegHeight)};
+		auto itFactor {std::find_if(std::cbegin(scalingFactors), std::cend(scalingFactors), [&](ScalingFactor factor)
+		{
+			return static_cast<ImageSize>(getScaledSize(maxSize, factor)) >= sizeHint;
+		})};
+		if (itFactor == std::cend(scalingFactors))
+			return res; // full decode needed, let stb handle it
+
+		const int scaledWidth {getScaledSize(jpegWidth, *itFactor)};
+		const int scaledHeight {getScaledSize(jpegHeight, *itFactor)};
+
+		res.reset(static_cast<unsigned char*>(std::malloc(static_cast<std::size_t>(scaledWidth) * scaledHeight * 3)));
+		if (!res)
+			return res;
+
+		if (tjDecompress2(handle.get(), jpegData, encodedDataSize, res.get(), scaledWidth, 0 /* pitch */, scaledHeight, TJPF_RGB, 0) != 0)
+		{
+			LMS_LOG(COVER, DEBUG) << "Cannot decode scaled JPEG: " << tjGetErrorStr2(handle.get());
+			res.reset();
+			return res;
+		}
+
+		width = scaledWidth;
+		height = scaledHeight;
+
+		return res;
+	}
+}
+
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef LMS_SUPPORT_IMAGE_TURBOJPEG
+#error "Bad configuration"
+#endif
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+
+#include "image/IEncodedImage.hpp"
+
+namespace Image::STB
+{
+	// Decodes JPEG images to RGB8 at 1/2, 1/4 or 1/8 scale, as long as their largest side stays at least sizeHint
+	// Not set if the image is not a JPEG, is too small to be scaled down or cannot be decoded
+	std::unique_ptr<unsigned char, decltype(&std::free)> decodeScaledJPEG(const std::byte* encodedData, std::size_t encodedDataSize, ImageSize sizeHint, int& width, int& height);
+}
+
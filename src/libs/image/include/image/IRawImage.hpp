@@ -21,6 +21,7 @@
 
 #include <filesystem>
 #include <memory>
+#include <optional>
 
 #include "image/IEncodedImage.hpp"
 
@@ -32,10 +33,15 @@ namespace Image
 			virtual ~IRawImage() = default;
 			virtual void resize(ImageSize width) = 0;
 			virtual std::unique_ptr<IEncodedImage> encodeToJPEG(unsigned quality) const = 0;
+			virtual std::unique_ptr<IEncodedImage> encodeToWebP(unsigned quality) const = 0; // throws if not supported
 	};
 
 	void init(const std::filesystem::path& path);
-	std::unique_ptr<IRawImage> decodeImage(const std::byte* encodedData, std::size_t encodedDataSize);
-	std::unique_ptr<IRawImage> decodeImage(const std::filesystem::path& path);
+	bool isEncodingSupported(EncodingFormat format);
+
+	// sizeHint: size the image is going to be resized to
+	// Decoders may use it to directly decode at a lower resolution (still at least sizeHint)
+	std::unique_ptr<IRawImage> decodeImage(const std::byte* encodedData, std::size_t encodedDataSize, std::optional<ImageSize> sizeHint = std::nullopt);
+	std::unique_ptr<IRawImage> decodeImage(const std::filesystem::path& path, std::optional<ImageSize> sizeHint = std::nullopt);
 }
 
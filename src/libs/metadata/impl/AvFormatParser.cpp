@@ -146,6 +146,14 @@ AvFormatParser::parse(const std::filesystem::path& p, bool debug)
 
 		track.duration = mediaFile->getDuration();
 		track.hasCover = mediaFile->hasAttachedPictures();
+		if (track.hasCover)
+		{
+			mediaFile->visitAttachedPictures([&](const Av::Picture& picture)
+			{
+				if (!track.coverHash)
+					track.coverHash = Utils::computePictureHash(picture.data, picture.dataSize);
+			});
+		}
 
 		MetaData::Clusters clusters;
 
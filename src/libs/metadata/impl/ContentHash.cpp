@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "metadata/ContentHash.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "utils/Crc32Calculator.hpp"
+
+namespace MetaData
+{
+	namespace
+	{
+		std::uint32_t
+		computeCrc(const std::byte* data, std::size_t size)
+		{
+			Utils::Crc32Calculator crcCalculator;
+			crcCalculator.processBytes(data, size);
+			return crcCalculator.getResult();
+		}
+	}
+
+	std::string
+	computeContentHash(const std::filesystem::path& file)
+	{
+		std::error_code ec;
+		const std::uintmax_t fileSize {std::filesystem::file_size(file, ec)};
+		if (ec)
+			return {};
+
+		std::ifstream ifs {file, std::ios::in | std::ios::binary};
+		if (!ifs)
+			return {};
+
+		static thread_local std::array<std::byte, contentHashChunkSize> head;
+		static thread_local std::array<std::byte, contentHashChunkSize> tail;
+
+		const std::size_t headSize {static_cast<std::size_t>(std::min<std::uintmax_t>(fileSize, contentHashChunkSize))};
+		if (!ifs.read(reinterpret_cast<char*>(head.data()), headSize))
+			return {};
+
+		// Small files are entirely covered by the head chunk
+		const std::size_t tailSize {static_cast<std::size_t>(std::min<std::uintmax_t>(fileSize - headSize, contentHashChunkSize))};
+		if (tailSize > 0 && (!ifs.seekg(fileSize - tailSize) || !ifs.read(reinterpret_cast<char*>(tail.data()), tailSize)))
+			return {};
+
+		return computeContentHash(fileSize, head.data(), headSize, tail.data(), tailSize);
+	}
+
+	std::string
+	computeContentHash(std::uint64_t fileSize, const std::byte* head, std::size_t headSize, const std::byte* tail, std::size_t tailSize)
+	{
+		const std::uint32_t headCrc {computeCrc(head, headSize)};
+		const std::uint32_t tailCrc {tailSize > 0 ? computeCrc(tail, tailSize) : 0};
+
+		std::ostringstream oss;
+		oss << fileSize << '-' << std::hex << std::setfill('0') << std::setw(8) << headCrc << std::setw(8) << tailCrc;
+
+		return oss.str();
+	}
+} // namespace MetaData
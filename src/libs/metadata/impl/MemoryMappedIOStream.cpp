@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MemoryMappedIOStream.hpp"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils/Logger.hpp"
+
+namespace MetaData
+{
+	namespace
+	{
+		// Tags are mostly located at the beginning of the files
+		constexpr std::size_t sequentialHeaderSize {1024 * 1024};
+	}
+
+	std::unique_ptr<MemoryMappedIOStream>
+	MemoryMappedIOStream::open(const std::filesystem::path& p)
+	{
+		const int fd {::open(p.c_str(), O_RDONLY | O_CLOEXEC)};
+		if (fd < 0)
+			return nullptr;
+
+		struct stat fileStat;
+		if (::fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0)
+		{
+			::close(fd);
+			return nullptr;
+		}
+
+		const std::size_t size {static_cast<std::size_t>(fileStat.st_size)};
+		void* data {::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)};
+		// the mapping keeps the file referenced
+		::close(fd);
+
+		if (data == MAP_FAILED)
+		{
+			LMS_LOG(METADATA, DEBUG) << "File '" << p.string() << "': cannot map file";
+			return nullptr;
+		}
+
+		::madvise(data, std::min(size, sequentialHeaderSize), MADV_SEQUENTIAL);
+
+		return std::unique_ptr<MemoryMappedIOStream> {new MemoryMappedIOStream {p, static_cast<const char*>(data), size}};
+	}
+
+	MemoryMappedIOStream::MemoryMappedIOStream(const std::filesystem::path& p, const char* data, std::size_t size)
+		: _path {p.string()}
+		, _data {data}
+		, _size {size}
+	{
+	}
+
+	MemoryMappedIOStream::~MemoryMappedIOStream()
+	{
+		::munmap(const_cast<char*>(_data), _size);
+	}
+
+	TagLib::FileName
+	MemoryMappedIOStream::name() const
+	{
+		return _path.c_str();
+	}
+
+	TagLib::ByteVector
+	MemoryMappedIOStream::readBlock(Size length)
+	{
+		const std::size_t readSize {std::min(static_cast<std::size_t>(length), _size - _position)};
+
+		TagLib::ByteVector res {_data + _position, static_cast<unsigned int>(readSize)};
+		_position += readSize;
+
+		return res;
+	}
+
+	void
+	MemoryMappedIOStream::writeBlock(const TagLib::ByteVector&)
+	{
+		// read only
+	}
+
+	void
+	MemoryMappedIOStream::insert(const TagLib::ByteVector&, BlockOffset, Size)
+	{
+		// read only
+	}
+
+	void
+	MemoryMappedIOStream::removeBlock(BlockOffset, Size)
+	{
+		// read only
+	}
+
+	void
+	MemoryMappedIOStream::seek(Offset offset, Position p)
+	{
+		Offset position {};
+		switch (p)
+		{
+			case Beginning:	position = offset; break;
+			case Current:	position = static_cast<Offset>(_position) + offset; break;
+			case End:		position = static_cast<Offset>(_size) + offset; break;
+		}
+
+		// Clamped to the file bounds, reads past the end just return nothing
+		_position = position < 0 ? 0 : std::min(static_cast<std::size_t>(position), _size);
+	}
+
+	void
+	MemoryMappedIOStream::truncate(Offset)
+	{
+		// read only
+	}
+} // namespace MetaData
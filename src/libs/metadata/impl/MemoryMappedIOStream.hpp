@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include <taglib/taglib.h>
+#include <taglib/tiostream.h>
+
+namespace MetaData
+{
+	// Read-only TagLib stream on a memory mapping of the whole file
+	// Saves the many small read calls made by TagLib while probing the tags, best suited for local disks
+	class MemoryMappedIOStream : public TagLib::IOStream
+	{
+		public:
+#if TAGLIB_MAJOR_VERSION >= 2
+			using Offset = TagLib::offset_t;
+			using BlockOffset = TagLib::offset_t;
+			using Size = std::size_t;
+#else
+			using Offset = long;
+			using BlockOffset = unsigned long;
+			using Size = unsigned long;
+#endif
+
+			// nullptr if the file cannot be mapped (empty or unreadable file, etc.)
+			static std::unique_ptr<MemoryMappedIOStream> open(const std::filesystem::path& p);
+
+			~MemoryMappedIOStream() override;
+
+			MemoryMappedIOStream(const MemoryMappedIOStream&) = delete;
+			MemoryMappedIOStream& operator=(const MemoryMappedIOStream&) = delete;
+
+			TagLib::FileName name() const override;
+			TagLib::ByteVector readBlock(Size length) override;
+			void writeBlock(const TagLib::ByteVector& data) override;
+			void insert(const TagLib::ByteVector& data, BlockOffset start = 0, Size replace = 0) override;
+			void removeBlock(BlockOffset start = 0, Size length = 0) override;
+			bool readOnly() const override { return true; }
+			bool isOpen() const override { return true; }
+			void seek(Offset offset, Position p = Beginning) override;
+			Offset tell() const override { return static_cast<Offset>(_position); }
+			Offset length() override { return static_cast<Offset>(_size); }
+			void truncate(Offset length) override;
+
+		private:
+			MemoryMappedIOStream(const std::filesystem::path& p, const char* data, std::size_t size);
+
+			const std::string	_path;
+			const char*			_data;
+			const std::size_t	_size;
+			std::size_t			_position {};
+	};
+} // namespace MetaData
@@ -19,8 +19,11 @@
 
 #include "metadata/TagLibParser.hpp"
 
+#include <algorithm>
+
 #include <taglib/apetag.h>
 #include <taglib/asffile.h>
+#include <taglib/attachedpictureframe.h>
 #include <taglib/id3v2tag.h>
 #include <taglib/fileref.h>
 #include <taglib/flacfile.h>
@@ -33,8 +36,11 @@
 #include <taglib/vorbisfile.h>
 #include <taglib/wavpackfile.h>
 
+#include "metadata/ContentHash.hpp"
+#include "utils/Exception.hpp"
 #include "utils/Logger.hpp"
 #include "utils/String.hpp"
+#include "MemoryMappedIOStream.hpp"
 #include "Utils.hpp"
 
 namespace MetaData
@@ -76,15 +82,25 @@ getPropertyValuesAs(const TagLib::PropertyMap& properties, const std::string& ke
 	return getPropertyValuesFirstMatchAs<T>(properties, {std::move(key)});
 }
 
+// Views on str, no copy
 static
-std::vector<std::string>
-splitAndTrimString(const std::string& str, std::string_view delimiters)
+std::vector<std::string_view>
+splitAndTrimString(std::string_view str, std::string_view delimiters)
 {
-	std::vector<std::string> res;
+	constexpr std::string_view whitespaces {" \t"};
+
+	std::vector<std::string_view> res {StringUtils::splitString(str, delimiters)};
+	for (std::string_view& s : res)
+	{
+		const std::size_t first {s.find_first_not_of(whitespaces)};
+		if (first == std::string_view::npos)
+		{
+			s = {};
+			continue;
+		}
 
-	std::vector<std::string_view> strings {StringUtils::splitString(str, delimiters)};
-	for (std::string_view s : strings)
-		res.emplace_back(StringUtils::stringTrim(s));
+		s = s.substr(first, s.find_last_not_of(whitespaces) - first + 1);
+	}
 
 	return res;
 }
@@ -97,21 +113,21 @@ getArtists(const TagLib::PropertyMap& properties,
 		const std::vector<std::string_view>& artistMBIDTagNames
 		)
 {
-	const std::vector<std::string> artistNames {getPropertyValuesFirstMatchAs<std::string>(properties, artistTagNames)};
+	std::vector<std::string> artistNames {getPropertyValuesFirstMatchAs<std::string>(properties, artistTagNames)};
 	if (artistNames.empty())
 		return {};
 
 	std::vector<Artist> artists;
 	artists.reserve(artistNames.size());
-	std::transform(std::cbegin(artistNames), std::cend(artistNames), std::back_inserter(artists),
-		[&](const std::string& name) { return Artist {name}; });
+	for (std::string& name : artistNames)
+		artists.emplace_back(std::move(name));
 
 	{
-		const std::vector<std::string> artistSortNames {getPropertyValuesFirstMatchAs<std::string>(properties, artistSortTagNames)};
+		std::vector<std::string> artistSortNames {getPropertyValuesFirstMatchAs<std::string>(properties, artistSortTagNames)};
 		if (artistSortNames.size() == artists.size())
 		{
 			for (std::size_t i {}; i < artistSortNames.size(); ++i)
-				artists[i].sortName = artistSortNames[i];
+				artists[i].sortName = std::move(artistSortNames[i]);
 		}
 	}
 
@@ -163,7 +179,7 @@ TagLibParser::processTag(Track& track, const std::string& tag, const TagLib::Str
 	std::string value {StringUtils::stringTrim(values.front().to8Bit(true))};
 
 	if (tag == "TITLE")
-		track.title = value;
+		track.title = std::move(value);
 	else if (tag == "MUSICBRAINZ_RELEASETRACKID"
 			|| tag == "MUSICBRAINZ RELEASE TRACK ID")
 	{
@@ -183,7 +199,7 @@ TagLibParser::processTag(Track& track, const std::string& tag, const TagLib::Str
 	else if (tag == "TRACKNUMBER")
 	{
 		// Expecting 'Number/Total'
-		std::vector<std::string> strings {splitAndTrimString(value, "/")};
+		const std::vector<std::string_view> strings {splitAndTrimString(value, "/")};
 
 		if (!strings.empty())
 		{
@@ -238,37 +254,122 @@ TagLibParser::processTag(Track& track, const std::string& tag, const TagLib::Str
 	else if (tag == "METADATA_BLOCK_PICTURE")
 		track.hasCover = true;
 	else if (tag == "COPYRIGHT")
-		track.copyright = value;
+		track.copyright = std::move(value);
 	else if (tag == "COPYRIGHTURL")
-		track.copyrightURL = value;
+		track.copyrightURL = std::move(value);
 	else if (tag == "REPLAYGAIN_ALBUM_GAIN")
 		track.albumReplayGain = StringUtils::readAs<float>(value);
 	else if (tag == "REPLAYGAIN_TRACK_GAIN")
 		track.trackReplayGain = StringUtils::readAs<float>(value);
 	else if (tag == "DISCSUBTITLE" || tag == "SETSUBTITLE")
-		track.discSubtitle = value;
+		track.discSubtitle = std::move(value);
 	else if (_clusterTypeNames.find(tag) != _clusterTypeNames.end())
 	{
 		std::set<std::string> clusterNames;
 		for (const auto& valueList : values)
 		{
-			const auto splittedValues {splitAndTrimString(valueList.to8Bit(true), "/,;")};
+			const std::string values8Bit {valueList.to8Bit(true)};
 
-			for (const auto& value : splittedValues)
-				clusterNames.insert(value);
+			for (std::string_view value : splitAndTrimString(values8Bit, "/,;"))
+				clusterNames.emplace(value);
 		}
 
 		if (!clusterNames.empty())
-			track.clusters[tag] = clusterNames;
+			track.clusters[tag] = std::move(clusterNames);
 	}
 }
 
+static
+std::uint64_t
+computePictureHash(const TagLib::ByteVector& data)
+{
+	return Utils::computePictureHash(reinterpret_cast<const std::byte*>(data.data()), data.size());
+}
+
+static
+TagLib::AudioProperties::ReadStyle
+readStyleToTagLibReadStyle(TagLibParser::ReadStyle readStyle)
+{
+	switch (readStyle)
+	{
+		case TagLibParser::ReadStyle::Fast: return TagLib::AudioProperties::Fast;
+		case TagLibParser::ReadStyle::Average: return TagLib::AudioProperties::Average;
+		case TagLibParser::ReadStyle::Accurate: return TagLib::AudioProperties::Accurate;
+	}
+
+	throw LmsException {"Unknown read style"};
+}
+
+TagLibParser::TagLibParser(ReadStyle readStyle, bool memoryMapFiles)
+: _readStyle {readStyle}
+, _memoryMapFiles {memoryMapFiles}
+{
+}
+
 std::optional<Track>
 TagLibParser::parse(const std::filesystem::path& p, bool debug)
 {
-	TagLib::FileRef f {p.string().c_str(),
-		true, // read audio properties
-		TagLib::AudioProperties::Fast}; // TODO parametrize this
+	return parse(p, true, debug);
+}
+
+std::optional<Track>
+TagLibParser::parseTags(const std::filesystem::path& p)
+{
+	return parse(p, false, false);
+}
+
+static
+AudioCodec
+getAudioCodec(TagLib::File* file)
+{
+	if (dynamic_cast<TagLib::MPEG::File*>(file))
+		return AudioCodec::MP3;
+	if (dynamic_cast<TagLib::Ogg::Opus::File*>(file))
+		return AudioCodec::Opus;
+	if (dynamic_cast<TagLib::Ogg::Vorbis::File*>(file))
+		return AudioCodec::Vorbis;
+	if (dynamic_cast<TagLib::FLAC::File*>(file))
+		return AudioCodec::FLAC;
+
+	return AudioCodec::Unknown;
+}
+
+// Reads the chunks through the stream TagLib has already opened (or mapped), the file is not opened again
+// The head chunk usually holds the tags: already read by TagLib, it is served by the page cache
+static
+std::string
+computeContentHash(TagLib::File& file)
+{
+	const auto fileSize {file.length()};
+	if (fileSize < 0)
+		return {};
+
+	const std::size_t headSize {static_cast<std::size_t>(std::min<std::uint64_t>(fileSize, contentHashChunkSize))};
+	file.seek(0);
+	const TagLib::ByteVector head {file.readBlock(headSize)};
+
+	const std::size_t tailSize {static_cast<std::size_t>(std::min<std::uint64_t>(fileSize - headSize, contentHashChunkSize))};
+	TagLib::ByteVector tail;
+	if (tailSize > 0)
+	{
+		file.seek(fileSize - static_cast<decltype(fileSize)>(tailSize));
+		tail = file.readBlock(tailSize);
+	}
+
+	if (head.size() != headSize || tail.size() != tailSize)
+		return {};
+
+	return computeContentHash(fileSize, reinterpret_cast<const std::byte*>(head.data()), headSize, reinterpret_cast<const std::byte*>(tail.data()), tailSize);
+}
+
+std::optional<Track>
+TagLibParser::parse(const std::filesystem::path& p, bool readAudioProperties, bool debug)
+{
+	// Must outlive the file ref, fallback on regular reads if the file cannot be mapped
+	const std::unique_ptr<MemoryMappedIOStream> stream {_memoryMapFiles ? MemoryMappedIOStream::open(p) : nullptr};
+
+	TagLib::FileRef f {stream ? TagLib::FileRef {stream.get(), readAudioProperties, readStyleToTagLibReadStyle(_readStyle)}
+		: TagLib::FileRef {p.string().c_str(), readAudioProperties, readStyleToTagLibReadStyle(_readStyle)}};
 
 	if (f.isNull())
 	{
@@ -276,7 +377,7 @@ TagLibParser::parse(const std::filesystem::path& p, bool debug)
 		return std::nullopt;
 	}
 
-	if (!f.audioProperties())
+	if (readAudioProperties && !f.audioProperties())
 	{
 		LMS_LOG(METADATA, INFO) << "File '" << p.string() << "': no audio properties";
 		return std::nullopt;
@@ -284,12 +385,13 @@ TagLibParser::parse(const std::filesystem::path& p, bool debug)
 
 	Track track;
 
+	if (readAudioProperties)
 	{
 		const TagLib::AudioProperties *properties {f.audioProperties() };
 
 		track.duration = std::chrono::milliseconds {properties->length() * 1000};
 
-		MetaData::AudioStream audioStream {static_cast<unsigned>(properties->bitrate() * 1000)};
+		MetaData::AudioStream audioStream {static_cast<unsigned>(properties->bitrate() * 1000), getAudioCodec(f.file())};
 		track.audioStreams = {std::move(audioStream)};
 	}
 
@@ -319,8 +421,14 @@ TagLibParser::parse(const std::filesystem::path& p, bool debug)
 		if (tag)
 		{
 			if (tag->attributeListMap().contains("WM/Picture"))
+			{
 				track.hasCover = true;
 
+				const TagLib::ASF::AttributeList& pictures {tag->attributeListMap()["WM/Picture"]};
+				if (!pictures.isEmpty())
+					track.coverHash = computePictureHash(pictures.front().toPicture().picture());
+			}
+
 			for (const auto& [name, attributeList] : tag->attributeListMap())
 			{
 				if (name.to8Bit().find("WM/") == 0 || properties.contains(name))
@@ -352,7 +460,12 @@ TagLibParser::parse(const std::filesystem::path& p, bool debug)
 			const auto& frameListMap {mp3File->ID3v2Tag()->frameListMap()};
 
 			if (!frameListMap["APIC"].isEmpty())
+			{
 				track.hasCover = true;
+
+				if (const auto* pictureFrame {dynamic_cast<const TagLib::ID3v2::AttachedPictureFrame*>(frameListMap["APIC"].front())})
+					track.coverHash = computePictureHash(pictureFrame->picture());
+			}
 			if (!frameListMap["TSST"].isEmpty())
 				properties.insert("DISCSUBTITLE", frameListMap["TSST"].front()->toString());
 		}
@@ -365,7 +478,10 @@ TagLibParser::parse(const std::filesystem::path& p, bool debug)
 		auto& coverItem {mp4File->tag()->itemListMap()["covr"]};
 		TagLib::MP4::CoverArtList coverArtList {coverItem.toCoverArtList()};
 		if (!coverArtList.isEmpty())
+		{
 			track.hasCover = true;
+			track.coverHash = computePictureHash(coverArtList.front().data());
+		}
 	}
 	// MPC
 	else if (TagLib::MPC::File* mpcFile {dynamic_cast<TagLib::MPC::File*>(f.file())})
@@ -381,17 +497,26 @@ TagLibParser::parse(const std::filesystem::path& p, bool debug)
 	else if (TagLib::FLAC::File* flacFile {dynamic_cast<TagLib::FLAC::File*>(f.file())})
 	{
 		if (!flacFile->pictureList().isEmpty())
+		{
 			track.hasCover = true;
+			track.coverHash = computePictureHash(flacFile->pictureList().front()->data());
+		}
 	}
 	else if (TagLib::Ogg::Vorbis::File* vorbisFile {dynamic_cast<TagLib::Ogg::Vorbis::File*>(f.file())})
 	{
 		if (!vorbisFile->tag()->pictureList().isEmpty())
+		{
 			track.hasCover = true;
+			track.coverHash = computePictureHash(vorbisFile->tag()->pictureList().front()->data());
+		}
 	}
 	else if (TagLib::Ogg::Opus::File* opusFile {dynamic_cast<TagLib::Ogg::Opus::File*>(f.file())})
 	{
 		if (!opusFile->tag()->pictureList().isEmpty())
+		{
 			track.hasCover = true;
+			track.coverHash = computePictureHash(opusFile->tag()->pictureList().front()->data());
+		}
 	}
 
 	for (const auto& property : properties)
@@ -412,6 +537,9 @@ TagLibParser::parse(const std::filesystem::path& p, bool debug)
 	track.producerArtists = getArtists(properties, {"PRODUCERS", "PRODUCER"}, {"PRODUCERSSORT", "PRODUCERSORT"}, {});
 	track.remixerArtists = getArtists(properties, {"REMIXERS", "REMIXER", "ModifiedBy"}, {"REMIXERSSORT", "REMIXERSORT"}, {});
 
+	// Last, since it moves the file position
+	track.contentHash = computeContentHash(*f.file());
+
 	return track;
 }
 
@@ -23,6 +23,8 @@
 #include <iomanip>
 #include <sstream>
 
+#include "utils/Crc32Calculator.hpp"
+
 namespace MetaData::Utils
 {
 	Wt::WDate
@@ -56,5 +58,14 @@ namespace MetaData::Utils
 
 		return {};
 	}
-}
 
+	std::uint64_t
+	computePictureHash(const std::byte* data, std::size_t dataSize)
+	{
+		::Utils::Crc32Calculator crc32;
+		crc32.processBytes(data, dataSize);
+
+		// size in the upper bits: cheap way to lower the collision odds of a 32 bit checksum
+		return (static_cast<std::uint64_t>(dataSize + 1) << 32) | crc32.getResult();
+	}
+}
@@ -18,10 +18,16 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstddef>
+#include <cstdint>
+
 #include <Wt/WDate.h>
 
 namespace MetaData::Utils
 {
 	Wt::WDate parseDate(const std::string& dateStr);
+
+	// Identical pictures embedded in different files get the same hash (never 0)
+	std::uint64_t computePictureHash(const std::byte* data, std::size_t dataSize);
 }
 
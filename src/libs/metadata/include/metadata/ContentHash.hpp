@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace MetaData
+{
+	// Cheap partial hash of a file content: size and CRC-32 of the first and last 64 KiB
+	// Used to match moved files with their former tracks, not to detect content changes
+	// Returns an empty string if the file cannot be read
+	std::string computeContentHash(const std::filesystem::path& file);
+
+	// Same, using chunks read by the caller: the first min(fileSize, contentHashChunkSize) bytes as head,
+	// and the last min(fileSize - headSize, contentHashChunkSize) bytes as tail
+	static inline constexpr std::size_t contentHashChunkSize {64 * 1024};
+	std::string computeContentHash(std::uint64_t fileSize, const std::byte* head, std::size_t headSize, const std::byte* tail, std::size_t tailSize);
+} // namespace MetaData
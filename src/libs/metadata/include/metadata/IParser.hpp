@@ -20,6 +20,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <map>
 #include <optional>
@@ -41,6 +42,7 @@ namespace MetaData
 		std::optional<UUID> musicBrainzArtistID;
 
 		Artist(std::string_view _name) : name {_name} {}
+		Artist(std::string&& _name) : name {std::move(_name)} {}
 		Artist(std::string_view _name, std::optional<std::string> _sortName, std::optional<UUID> _musicBrainzArtistID) : name {_name}, sortName {_sortName}, musicBrainzArtistID {_musicBrainzArtistID} {}
 	};
 
@@ -50,9 +52,19 @@ namespace MetaData
 		std::optional<UUID> musicBrainzAlbumID;
 	};
 
+	enum class AudioCodec
+	{
+		Unknown,
+		MP3,
+		Opus,	// in an Ogg container
+		Vorbis,	// in an Ogg container
+		FLAC,
+	};
+
 	struct AudioStream
 	{
-		unsigned bitRate;
+		unsigned	bitRate;
+		AudioCodec	codec {AudioCodec::Unknown};
 	};
 
 	struct Track
@@ -72,6 +84,8 @@ namespace MetaData
 		Wt::WDate					date;
 		Wt::WDate					originalDate;
 		bool						hasCover {};
+		std::uint64_t				coverHash {}; // identifies the content of the first embedded picture, 0 if unknown
+		std::string					contentHash; // see computeContentHash, empty if not computed by the parser
 		std::vector<AudioStream>	audioStreams;
 		std::optional<UUID>		acoustID;
 		std::string				copyright;
@@ -94,6 +108,9 @@ namespace MetaData
 
 			virtual std::optional<Track> parse(const std::filesystem::path& p, bool debug = false) = 0;
 
+			// Same as parse, but audio properties (duration, audio streams) may be left empty to save some time
+			virtual std::optional<Track> parseTags(const std::filesystem::path& p) { return parse(p); }
+
 			void setClusterTypeNames(const std::set<std::string>& clusterTypeNames) { _clusterTypeNames = clusterTypeNames; }
 
 		protected:
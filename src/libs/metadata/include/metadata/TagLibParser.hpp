@@ -32,10 +32,28 @@ namespace MetaData
 // Parse that makes use of AvFormat
 class TagLibParser : public IParser
 {
+	public:
+		// How accurately audio properties are read (see TagLib::AudioProperties::ReadStyle)
+		enum class ReadStyle
+		{
+			Fast,
+			Average,
+			Accurate,
+		};
+
+		// memoryMapFiles: read files through memory mappings instead of read calls (faster on local disks)
+		TagLibParser(ReadStyle readStyle = ReadStyle::Fast, bool memoryMapFiles = false);
+
 	private:
 		std::optional<Track> parse(const std::filesystem::path& p, bool debug = false) override;
+		std::optional<Track> parseTags(const std::filesystem::path& p) override;
+
+		std::optional<Track> parse(const std::filesystem::path& p, bool readAudioProperties, bool debug);
 
 		void processTag(Track& track, const std::string& tag, const TagLib::StringList& values, bool debug);
+
+		const ReadStyle _readStyle;
+		const bool _memoryMapFiles;
 };
 
 } // namespace MetaData
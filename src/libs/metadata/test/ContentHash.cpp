@@ -0,0 +1,94 @@
+
+/*
+ * Copyright (C) 2024 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <vector>
+
+#include "metadata/ContentHash.hpp"
+
+namespace
+{
+	std::vector<std::byte>
+	generateContent(std::size_t size)
+	{
+		std::vector<std::byte> content(size);
+		for (std::size_t i {}; i < size; ++i)
+			content[i] = static_cast<std::byte>((i * 31) ^ (i >> 8));
+
+		return content;
+	}
+
+	std::string
+	computeContentHashFromFile(const std::vector<std::byte>& content)
+	{
+		const std::filesystem::path file {std::filesystem::temp_directory_path() / "lms_content_hash_test.bin"};
+		{
+			std::ofstream ofs {file, std::ios::out | std::ios::binary | std::ios::trunc};
+			ofs.write(reinterpret_cast<const char*>(content.data()), content.size());
+		}
+
+		const std::string res {MetaData::computeContentHash(file)};
+		std::filesystem::remove(file);
+
+		return res;
+	}
+
+	std::string
+	computeContentHashFromChunks(const std::vector<std::byte>& content)
+	{
+		const std::size_t headSize {std::min(content.size(), MetaData::contentHashChunkSize)};
+		const std::size_t tailSize {std::min(content.size() - headSize, MetaData::contentHashChunkSize)};
+
+		return MetaData::computeContentHash(content.size(), content.data(), headSize, content.data() + content.size() - tailSize, tailSize);
+	}
+}
+
+TEST(MetaData, contentHash)
+{
+	// empty, head only, head and partial tail, head and tail, chunks that skip the middle
+	for (const std::size_t size : {std::size_t {0}, std::size_t {1000}, MetaData::contentHashChunkSize + 1000, 2 * MetaData::contentHashChunkSize, 5 * MetaData::contentHashChunkSize + 17})
+	{
+		const std::vector<std::byte> content {generateContent(size)};
+
+		const std::string hash {computeContentHashFromFile(content)};
+		EXPECT_FALSE(hash.empty());
+		EXPECT_EQ(hash, computeContentHashFromChunks(content)) << "size = " << size;
+		EXPECT_EQ(hash.substr(0, hash.find('-')), std::to_string(size));
+	}
+}
+
+TEST(MetaData, contentHashIgnoresMiddle)
+{
+	std::vector<std::byte> content {generateContent(3 * MetaData::contentHashChunkSize)};
+	const std::string hash {computeContentHashFromChunks(content)};
+
+	content[content.size() / 2] ^= std::byte {0xFF};
+	EXPECT_EQ(computeContentHashFromChunks(content), hash);
+
+	content.front() ^= std::byte {0xFF};
+	EXPECT_NE(computeContentHashFromChunks(content), hash);
+}
+
+TEST(MetaData, contentHashMissingFile)
+{
+	EXPECT_TRUE(MetaData::computeContentHash("/nonexistent/lms_content_hash_test.bin").empty());
+}
@@ -21,6 +21,7 @@
 
 #include <Wt/Auth/HashFunction.h>
 #include <Wt/Auth/PasswordStrengthValidator.h>
+#include <Wt/Dbo/Exception.h>
 #include <Wt/WRandom.h>
 
 #include "services/auth/Types.hpp"
@@ -33,17 +34,26 @@
 namespace Auth
 {
 
-	std::unique_ptr<IAuthTokenService> createAuthTokenService(Database::Db& db, std::size_t maxThrottlerEntries)
+	std::unique_ptr<IAuthTokenService> createAuthTokenService(boost::asio::io_context& ioContext, Database::Db& db, std::size_t maxThrottlerEntries)
 	{
-		return std::make_unique<AuthTokenService>(db, maxThrottlerEntries);
+		return std::make_unique<AuthTokenService>(ioContext, db, maxThrottlerEntries);
 	}
 
 	static const Wt::Auth::SHA1HashFunction sha1Function;
+	static constexpr std::size_t maxCachedAuthTokenCount {1000};
+	static constexpr std::chrono::hours expiredAuthTokensRemovalPeriod {1};
 
-	AuthTokenService::AuthTokenService(Database::Db& db, std::size_t maxThrottlerEntries)
+	AuthTokenService::AuthTokenService(boost::asio::io_context& ioContext, Database::Db& db, std::size_t maxThrottlerEntries)
 	: AuthServiceBase {db}
+	, _ioContext {ioContext}
 	, _loginThrottler {maxThrottlerEntries}
 	{
+		scheduleExpiredAuthTokensRemoval();
+	}
+
+	AuthTokenService::~AuthTokenService()
+	{
+		_expiredAuthTokensRemovalTimer.cancel();
 	}
 
 	std::string
@@ -54,18 +64,24 @@ namespace Auth
 
 		Database::Session& session {getDbSession()};
 
-		auto transaction {session.createUniqueTransaction()};
+		{
+			auto transaction {session.createUniqueTransaction()};
 
-		Database::User::pointer user {Database::User::find(session, userId)};
-		if (!user)
-			throw Exception {"User deleted"};
+			Database::User::pointer user {Database::User::find(session, userId)};
+			if (!user)
+				throw Exception {"User deleted"};
 
-		Database::AuthToken::pointer authToken {Database::AuthToken::create(session, secretHash, expiry, user)};
+			Database::AuthToken::pointer authToken {Database::AuthToken::create(session, secretHash, expiry, user)};
 
-		LMS_LOG(UI, DEBUG) << "Created auth token for user '" << user->getLoginName() << "', expiry = " << expiry.toString();
+			LMS_LOG(UI, DEBUG) << "Created auth token for user '" << user->getLoginName() << "', expiry = " << expiry.toString();
+		}
 
-		if (user->getAuthTokensCount() >= 50)
-			Database::AuthToken::removeExpiredTokens(session, Wt::WDateTime::currentDateTime());
+		// Only once committed: a cached token must exist in the db
+		{
+			std::scoped_lock lock {_authTokensMutex};
+			if (_cachedAuthTokens.size() < maxCachedAuthTokenCount)
+				_cachedAuthTokens.emplace(secretHash, CachedAuthToken {userId, expiry});
+		}
 
 		return secret;
 	}
@@ -75,55 +91,105 @@ namespace Auth
 	{
 		const std::string secretHash {sha1Function.compute(std::string {secret}, {})};
 
-		Database::Session& session {getDbSession()};
-		auto transaction {session.createUniqueTransaction()};
+		std::optional<AuthTokenProcessResult::AuthTokenInfo> res;
+		{
+			std::scoped_lock lock {_authTokensMutex};
 
-		Database::AuthToken::pointer authToken {Database::AuthToken::find(session, secretHash)};
-		if (!authToken)
-			return std::nullopt;
+			if (auto it {_cachedAuthTokens.find(secretHash)}; it != std::cend(_cachedAuthTokens))
+			{
+				res = AuthTokenProcessResult::AuthTokenInfo {it->second.userId, it->second.expiry};
+				_cachedAuthTokens.erase(it);
+			}
+		}
 
-		if (authToken->getExpiry() < Wt::WDateTime::currentDateTime())
+		// Tokens are only accepted once: the token is removed in the transaction that validates it, concurrent uses of the same token cannot both find it
 		{
+			Database::Session& session {getDbSession()};
+			auto transaction {session.createUniqueTransaction()};
+
+			Database::AuthToken::pointer authToken {Database::AuthToken::find(session, secretHash)};
+			if (!authToken)
+				return std::nullopt;
+
+			if (!res)
+				res = AuthTokenProcessResult::AuthTokenInfo {authToken->getUser()->getId(), authToken->getExpiry()};
+
 			authToken.remove();
-			return std::nullopt;
 		}
 
-		LMS_LOG(UI, DEBUG) << "Found auth token for user '" << authToken->getUser()->getLoginName() << "'!";
+		if (res->expiry < Wt::WDateTime::currentDateTime())
+			return std::nullopt;
 
-		AuthTokenService::AuthTokenProcessResult::AuthTokenInfo res {authToken->getUser()->getId(), authToken->getExpiry()};
-		authToken.remove();
+		LMS_LOG(UI, DEBUG) << "Found auth token for user id '" << res->userId.toString() << "'!";
 
 		return res;
 	}
 
-	AuthTokenService::AuthTokenProcessResult
-	AuthTokenService::processAuthToken(const boost::asio::ip::address& clientAddress, std::string_view tokenValue)
+	void
+	AuthTokenService::scheduleExpiredAuthTokensRemoval()
 	{
-		// Do not waste too much resource on brute force attacks (optim)
+		_expiredAuthTokensRemovalTimer.expires_after(expiredAuthTokensRemovalPeriod);
+		_expiredAuthTokensRemovalTimer.async_wait([this](const boost::system::error_code& ec)
 		{
-			std::shared_lock lock {_mutex};
+			if (ec)
+				return;
 
-			if (_loginThrottler.isClientThrottled(clientAddress))
-				return AuthTokenProcessResult {AuthTokenProcessResult::State::Throttled};
+			removeExpiredAuthTokens();
+			scheduleExpiredAuthTokensRemoval();
+		});
+	}
+
+	void
+	AuthTokenService::removeExpiredAuthTokens()
+	{
+		const Wt::WDateTime now {Wt::WDateTime::currentDateTime()};
+
+		{
+			std::scoped_lock lock {_authTokensMutex};
+			for (auto it {std::begin(_cachedAuthTokens)}; it != std::end(_cachedAuthTokens); )
+			{
+				if (it->second.expiry < now)
+					it = _cachedAuthTokens.erase(it);
+				else
+					++it;
+			}
 		}
 
-		auto res {processAuthToken(tokenValue)};
+		try
 		{
-			std::unique_lock lock {_mutex};
+			Database::Session& session {getDbSession()};
+			auto transaction {session.createUniqueTransaction()};
 
-			if (_loginThrottler.isClientThrottled(clientAddress))
-				return AuthTokenProcessResult {AuthTokenProcessResult::State::Throttled};
+			Database::AuthToken::removeExpiredTokens(session, now);
+		}
+		catch (const Wt::Dbo::Exception& e)
+		{
+			LMS_LOG(UI, ERROR) << "Cannot remove expired auth tokens: " << e.what();
+		}
+	}
 
-			if (!res)
-			{
-				_loginThrottler.onBadClientAttempt(clientAddress);
-				return AuthTokenProcessResult {AuthTokenProcessResult::State::Denied};
-			}
+	AuthTokenService::AuthTokenProcessResult
+	AuthTokenService::processAuthToken(const boost::asio::ip::address& clientAddress, std::string_view tokenValue)
+	{
+		// Do not waste too much resource on brute force attacks (optim)
+		if (_loginThrottler.isClientThrottled(clientAddress))
+			return AuthTokenProcessResult {AuthTokenProcessResult::State::Throttled};
+
+		auto res {processAuthToken(tokenValue)};
+
+		// the client may have been throttled in the meantime by concurrent attempts
+		if (_loginThrottler.isClientThrottled(clientAddress))
+			return AuthTokenProcessResult {AuthTokenProcessResult::State::Throttled};
 
-			_loginThrottler.onGoodClientAttempt(clientAddress);
-			onUserAuthenticated(res->userId);
-			return AuthTokenProcessResult {AuthTokenProcessResult::State::Granted, std::move(*res)};
+		if (!res)
+		{
+			_loginThrottler.onBadClientAttempt(clientAddress);
+			return AuthTokenProcessResult {AuthTokenProcessResult::State::Denied};
 		}
+
+		_loginThrottler.onGoodClientAttempt(clientAddress);
+		onUserAuthenticated(res->userId);
+		return AuthTokenProcessResult {AuthTokenProcessResult::State::Granted, std::move(*res)};
 	}
 
 	void
@@ -138,6 +204,15 @@ namespace Auth
 			throw Exception {"User deleted"};
 
 		user.modify()->clearAuthTokens();
+
+		std::scoped_lock lock {_authTokensMutex};
+		for (auto it {std::begin(_cachedAuthTokens)}; it != std::end(_cachedAuthTokens); )
+		{
+			if (it->second.userId == userId)
+				it = _cachedAuthTokens.erase(it);
+			else
+				++it;
+		}
 	}
 
 } // namespace Auth
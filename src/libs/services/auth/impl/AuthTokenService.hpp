@@ -19,7 +19,11 @@
 
 #pragma once
 
-#include <shared_mutex>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 #include "services/auth/IAuthTokenService.hpp"
 #include "AuthServiceBase.hpp"
@@ -35,7 +39,8 @@ namespace Auth
 	class AuthTokenService : public IAuthTokenService, public AuthServiceBase
 	{
 		public:
-			AuthTokenService(Database::Db& db, std::size_t maxThrottlerEntries);
+			AuthTokenService(boost::asio::io_context& ioContext, Database::Db& db, std::size_t maxThrottlerEntries);
+			~AuthTokenService();
 
 			AuthTokenService(const AuthTokenService&) = delete;
 			AuthTokenService& operator=(const AuthTokenService&) = delete;
@@ -49,7 +54,20 @@ namespace Auth
 
 			std::optional<AuthTokenService::AuthTokenProcessResult::AuthTokenInfo> processAuthToken(std::string_view secret);
 
-			std::shared_mutex	_mutex;
-			LoginThrottler		_loginThrottler;
+			void					scheduleExpiredAuthTokensRemoval();
+			void					removeExpiredAuthTokens();
+
+			boost::asio::io_context&	_ioContext;
+			boost::asio::steady_timer	_expiredAuthTokensRemovalTimer {_ioContext};
+			LoginThrottler				_loginThrottler;
+
+			// Recently created tokens, keyed by secret hash
+			struct CachedAuthToken
+			{
+				Database::UserId	userId;
+				Wt::WDateTime		expiry;
+			};
+			std::mutex											_authTokensMutex;
+			std::unordered_map<std::string, CachedAuthToken>	_cachedAuthTokens;
 	};
 }
@@ -17,85 +17,222 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-/* This file contains some classes in order to get info from file using the libavconv */
-
 #include "LoginThrottler.hpp"
 
+#include <algorithm>
+
 #include "utils/Logger.hpp"
-#include "utils/Random.hpp"
 
 namespace Auth {
 
-static
-boost::asio::ip::address_v6
-getAddressWithMask(const boost::asio::ip::address_v6& address, std::size_t prefix)
+LoginThrottler::LoginThrottler(std::size_t maxEntries)
+	: _bucketCount {std::max<std::size_t>(1, maxEntries / (_shards.size() * _bucketSize))}
+{
+	for (Shard& shard : _shards)
+		shard.entries.resize(_bucketCount * _bucketSize);
+}
+
+LoginThrottler::Keys
+LoginThrottler::getKeys(const boost::asio::ip::address& address)
 {
-	assert(prefix % 8 == 0);
+	Keys keys;
 
-	std::array<uint8_t, 16> truncatedBytes;
+	if (address.is_v4() || address.to_v6().is_v4_mapped())
+	{
+		const boost::asio::ip::address_v4::bytes_type v4Bytes {address.is_v4() ? address.to_v4().to_bytes() : address.to_v6().to_v4().to_bytes()};
 
-	auto bytes {address.to_bytes()};
-	std::copy(std::cbegin(bytes), std::next(std::cbegin(bytes), prefix / 8), truncatedBytes.begin());
+		Key& key {keys.keys[keys.count++]};
+		key.bytes[10] = 0xFF;
+		key.bytes[11] = 0xFF;
+		std::copy(std::cbegin(v4Bytes), std::cend(v4Bytes), std::next(std::begin(key.bytes), 12));
+		key.prefixLength = 128;
+	}
+	else
+	{
+		const boost::asio::ip::address_v6::bytes_type v6Bytes {address.to_v6().to_bytes()};
 
-	return boost::asio::ip::address_v6 {truncatedBytes};
+		Key& key {keys.keys[keys.count++]};
+		std::copy(std::cbegin(v6Bytes), std::cend(v6Bytes), std::begin(key.bytes));
+		key.prefixLength = 128;
+
+		Key& prefixKey {keys.keys[keys.count++]};
+		std::copy(std::cbegin(v6Bytes), std::next(std::cbegin(v6Bytes), 8), std::begin(prefixKey.bytes));
+		prefixKey.prefixLength = 64;
+	}
+
+	return keys;
 }
 
-static
-boost::asio::ip::address
-getAddressToThrottle(const boost::asio::ip::address& address)
+std::size_t
+LoginThrottler::computeHash(const Key& key)
 {
-	return address.is_v6() ? getAddressWithMask(address.to_v6(), 64) : address;
+	// FNV-1a
+	std::uint64_t hash {14695981039346656037ULL};
+	auto update {[&](unsigned char byte)
+	{
+		hash ^= byte;
+		hash *= 1099511628211ULL;
+	}};
+
+	for (unsigned char byte : key.bytes)
+		update(byte);
+	update(static_cast<unsigned char>(key.prefixLength));
+
+	return static_cast<std::size_t>(hash);
 }
 
-void
-LoginThrottler::removeOutdatedEntries()
+std::size_t
+LoginThrottler::findEntryIndex(const Shard& shard, const Key& key, std::size_t hash) const
+{
+	const std::size_t bucketBegin {getBucketIndex(hash) * _bucketSize};
+
+	for (std::size_t index {bucketBegin}; index < bucketBegin + _bucketSize; ++index)
+	{
+		const Entry& entry {shard.entries[index]};
+		if (entry.used && entry.key == key)
+			return index;
+	}
+
+	return shard.entries.size();
+}
+
+const LoginThrottler::Entry*
+LoginThrottler::findEntry(const Shard& shard, const Key& key, std::size_t hash) const
+{
+	const std::size_t index {findEntryIndex(shard, key, hash)};
+	return index != shard.entries.size() ? &shard.entries[index] : nullptr;
+}
+
+LoginThrottler::Entry*
+LoginThrottler::findEntry(Shard& shard, const Key& key, std::size_t hash)
+{
+	const std::size_t index {findEntryIndex(shard, key, hash)};
+	return index != shard.entries.size() ? &shard.entries[index] : nullptr;
+}
+
+LoginThrottler::Entry&
+LoginThrottler::findOrCreateEntry(Shard& shard, const Key& key, std::size_t hash)
+{
+	if (Entry* entry {findEntry(shard, key, hash)})
+		return *entry;
+
+	const auto bucketBegin {std::next(std::begin(shard.entries), getBucketIndex(hash) * _bucketSize)};
+	const auto bucketEnd {std::next(bucketBegin, _bucketSize)};
+
+	// reuse a free entry or evict the least recently updated one
+	auto it {std::min_element(bucketBegin, bucketEnd, [](const Entry& a, const Entry& b)
+	{
+		if (a.used != b.used)
+			return !a.used;
+
+		return a.lastBadAttempt < b.lastBadAttempt;
+	})};
+
+	*it = Entry {};
+	it->key = key;
+	it->used = true;
+
+	return *it;
+}
+
+double
+LoginThrottler::getAttemptCount(const Entry& entry, Clock::time_point now)
 {
-	const Wt::WDateTime now {Wt::WDateTime::currentDateTime()};
+	const Clock::duration elapsed {now - entry.windowStart};
+	if (elapsed >= 2 * _attemptWindow)
+		return 0;
+
+	double previousWindowCount {static_cast<double>(entry.previousWindowCount)};
+	double currentWindowCount {static_cast<double>(entry.currentWindowCount)};
+	Clock::duration elapsedInWindow {elapsed};
+	if (elapsed >= _attemptWindow)
+	{
+		previousWindowCount = currentWindowCount;
+		currentWindowCount = 0;
+		elapsedInWindow -= _attemptWindow;
+	}
+
+	const double previousWindowWeight {1. - std::chrono::duration<double> {elapsedInWindow} / _attemptWindow};
+	return previousWindowCount * previousWindowWeight + currentWindowCount;
+}
 
-	for (auto it {std::begin(_attemptsInfo)}; it != std::end(_attemptsInfo); )
+void
+LoginThrottler::addAttempt(Entry& entry, Clock::time_point now)
+{
+	const Clock::duration elapsed {now - entry.windowStart};
+	if (elapsed >= 2 * _attemptWindow)
 	{
-		if (it->second <= now)
-			it = _attemptsInfo.erase(it);
-		else
-			++it;
+		entry.previousWindowCount = 0;
+		entry.currentWindowCount = 0;
+		entry.windowStart = now;
 	}
+	else if (elapsed >= _attemptWindow)
+	{
+		entry.previousWindowCount = entry.currentWindowCount;
+		entry.currentWindowCount = 0;
+		entry.windowStart += _attemptWindow;
+	}
+
+	entry.currentWindowCount++;
+	entry.lastBadAttempt = now;
+}
+
+bool
+LoginThrottler::isThrottled(const Entry& entry, Clock::time_point now)
+{
+	if (entry.key.prefixLength == 64)
+		return getAttemptCount(entry, now) >= _maxAttemptsPerPrefix;
+
+	return now < entry.lastBadAttempt + _badAttemptPenalty
+		|| getAttemptCount(entry, now) >= _maxAttemptsPerAddress;
 }
 
 void
 LoginThrottler::onBadClientAttempt(const boost::asio::ip::address& address)
 {
-	const boost::asio::ip::address clientAddress {getAddressToThrottle(address)};
+	const Clock::time_point now {Clock::now()};
 
-	const Wt::WDateTime now {Wt::WDateTime::currentDateTime()};
-
-	if (_attemptsInfo.size() >= _maxEntries)
-		removeOutdatedEntries();
-	if (_attemptsInfo.size() >= _maxEntries)
-		_attemptsInfo.erase(Random::pickRandom(_attemptsInfo));
+	for (const Key& key : getKeys(address))
+	{
+		const std::size_t hash {computeHash(key)};
+		Shard& shard {getShard(hash)};
 
-	_attemptsInfo[address] = now.addSecs(3);
+		const std::scoped_lock lock {shard.mutex};
+		addAttempt(findOrCreateEntry(shard, key, hash), now);
+	}
 
-	LMS_LOG(AUTH, DEBUG) << "Registering bad attempt for '" << clientAddress.to_string() << "'";
+	LMS_LOG(AUTH, DEBUG) << "Registering bad attempt for '" << address.to_string() << "'";
 }
 
 void
 LoginThrottler::onGoodClientAttempt(const boost::asio::ip::address& address)
 {
-	const boost::asio::ip::address clientAddress {getAddressToThrottle(address)};
-
-	_attemptsInfo.erase(clientAddress);
+	// only forget about this address, other clients may share the same prefix
+	const Key key {*getKeys(address).begin()};
+	const std::size_t hash {computeHash(key)};
+	Shard& shard {getShard(hash)};
+
+	const std::scoped_lock lock {shard.mutex};
+	if (Entry* entry {findEntry(shard, key, hash)})
+		entry->used = false;
 }
 
 bool
 LoginThrottler::isClientThrottled(const boost::asio::ip::address& address) const
 {
-	const boost::asio::ip::address clientAddress {getAddressToThrottle(address)};
+	const Clock::time_point now {Clock::now()};
 
-	auto it {_attemptsInfo.find(clientAddress)};
-	if (it == _attemptsInfo.end())
-		return false;
+	for (const Key& key : getKeys(address))
+	{
+		const std::size_t hash {computeHash(key)};
+		const Shard& shard {getShard(hash)};
+
+		const std::scoped_lock lock {shard.mutex};
+		if (const Entry* entry {findEntry(shard, key, hash)}; entry && isThrottled(*entry, now))
+			return true;
+	}
 
-	return it->second > Wt::WDateTime::currentDateTime();
+	return false;
 }
 
 } // Auth
@@ -19,33 +19,93 @@
 
 #pragma once
 
-#include <shared_mutex>
-#include <string>
-#include <unordered_map>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
 
-#include <Wt/WDateTime.h>
-
-#include "utils/NetAddress.hpp"
-#include "utils/Exception.hpp"
+#include <boost/asio/ip/address.hpp>
 
 namespace Auth
 {
+	// Thread safe, fixed memory usage
+	// Bad attempts are counted in sliding windows, per address and per IPv6 /64 prefix
 	class LoginThrottler
 	{
 		public:
-			LoginThrottler(std::size_t maxEntries) : _maxEntries {maxEntries} {}
+			LoginThrottler(std::size_t maxEntries);
+
+			LoginThrottler(const LoginThrottler&) = delete;
+			LoginThrottler& operator=(const LoginThrottler&) = delete;
 
-			// user must lock these calls to avoid races
 			bool isClientThrottled(const boost::asio::ip::address& address) const;
 			void onBadClientAttempt(const boost::asio::ip::address& address);
 			void onGoodClientAttempt(const boost::asio::ip::address& address);
 
 		private:
-			void removeOutdatedEntries();
+			using Clock = std::chrono::steady_clock;
+
+			// IPv4 addresses are stored as IPv4-mapped IPv6 addresses
+			struct Key
+			{
+				std::array<unsigned char, 16>	bytes {};
+				unsigned						prefixLength {};
+
+				bool operator==(const Key& other) const { return prefixLength == other.prefixLength && bytes == other.bytes; }
+			};
+
+			// The sliding window count is approximated using the counts of the current and previous fixed windows
+			struct Entry
+			{
+				Key					key;
+				bool				used {};
+				Clock::time_point	windowStart;
+				std::uint32_t		currentWindowCount {};
+				std::uint32_t		previousWindowCount {};
+				Clock::time_point	lastBadAttempt;
+			};
+
+			// Entries are stored in small fixed size buckets: when a bucket is full, the least recently updated entry is evicted
+			struct Shard
+			{
+				mutable std::mutex	mutex;
+				std::vector<Entry>	entries;
+			};
 
-			const std::size_t _maxEntries;
+			// The address itself first, then its prefix if any
+			struct Keys
+			{
+				std::array<Key, 2>	keys;
+				std::size_t			count {};
 
-			std::unordered_map<boost::asio::ip::address, Wt::WDateTime>	_attemptsInfo;
+				const Key* begin() const { return keys.data(); }
+				const Key* end() const { return keys.data() + count; }
+			};
+			static Keys getKeys(const boost::asio::ip::address& address);
+			static std::size_t computeHash(const Key& key);
+
+			Shard& getShard(std::size_t hash) { return _shards[hash % _shards.size()]; }
+			const Shard& getShard(std::size_t hash) const { return _shards[hash % _shards.size()]; }
+			std::size_t getBucketIndex(std::size_t hash) const { return (hash / _shards.size()) % _bucketCount; }
+
+			// Shard mutex must be held
+			std::size_t findEntryIndex(const Shard& shard, const Key& key, std::size_t hash) const; // entries.size() if not found
+			const Entry* findEntry(const Shard& shard, const Key& key, std::size_t hash) const;
+			Entry* findEntry(Shard& shard, const Key& key, std::size_t hash);
+			Entry& findOrCreateEntry(Shard& shard, const Key& key, std::size_t hash);
+
+			static bool isThrottled(const Entry& entry, Clock::time_point now);
+			static double getAttemptCount(const Entry& entry, Clock::time_point now);
+			static void addAttempt(Entry& entry, Clock::time_point now);
+
+			static constexpr std::size_t			_bucketSize {4};
+			static constexpr std::chrono::seconds	_badAttemptPenalty {3};
+			static constexpr std::chrono::seconds	_attemptWindow {60};
+			static constexpr unsigned				_maxAttemptsPerAddress {10};
+			static constexpr unsigned				_maxAttemptsPerPrefix {50};
+
+			std::array<Shard, 16>	_shards;
+			std::size_t				_bucketCount;
 	};
 } // Auth
-
@@ -19,6 +19,9 @@
 
 #include "PasswordServiceBase.hpp"
 
+#include <future>
+
+#include <boost/asio/post.hpp>
 #include <Wt/Auth/HashFunction.h>
 #include <Wt/WRandom.h>
 
@@ -31,12 +34,15 @@
 #include "services/database/Session.hpp"
 #include "services/database/User.hpp"
 #include "utils/Exception.hpp"
+#include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Service.hpp"
 
 namespace Auth
 {
 
 	static const Wt::Auth::SHA1HashFunction sha1Function;
+	static constexpr std::size_t maxCachedCredentialCount {1000};
 
 	std::unique_ptr<IPasswordService>
 	createPasswordService(std::string_view passwordAuthenticationBackend, Database::Db& db, std::size_t maxThrottlerEntries, IAuthTokenService& authTokenService)
@@ -55,43 +61,191 @@ namespace Auth
 		: AuthServiceBase {db}
 		, _loginThrottler {maxThrottlerEntries}
 		, _authTokenService {authTokenService}
+		, _credentialCacheTTL {Service<IConfig>::get()->getULong("login-credential-cache-ttl", 60)}
+		, _credentialCacheSalt {Wt::WRandom::generateId(32)}
+		, _maxPendingCheckCount {Service<IConfig>::get()->getULong("login-check-max-pending-count", 32)}
+		, _checkTimeout {Service<IConfig>::get()->getULong("login-check-timeout", 10)}
 	{
+		LMS_LOG(AUTH, INFO) << "Credential cache TTL = " << _credentialCacheTTL.count() << "s";
+
+		if (const std::size_t checkThreadCount {Service<IConfig>::get()->getULong("login-check-thread-count", 2)})
+			_checkRunner.emplace(_checkIOContext, checkThreadCount);
 	}
 
-	PasswordServiceBase::CheckResult
-	PasswordServiceBase::checkUserPassword(const boost::asio::ip::address& clientAddress, std::string_view loginName, std::string_view password)
+	PasswordServiceBase::~PasswordServiceBase()
 	{
-		LMS_LOG(AUTH, DEBUG) << "Checking password for user '" << loginName << "'";
+		// Pending checks use this service
+		_checkRunner.reset();
+	}
 
-		// Do not waste too much resource on brute force attacks (optim)
+	void
+	PasswordServiceBase::clearCachedCredentials(Database::UserId userId)
+	{
+		std::unique_lock lock {_credentialCacheMutex};
+
+		for (auto it {std::begin(_credentialCache)}; it != std::end(_credentialCache);)
+		{
+			if (it->second.userId == userId)
+				it = _credentialCache.erase(it);
+			else
+				++it;
+		}
+	}
+
+	std::string
+	PasswordServiceBase::computeCredentialCacheKey(std::string_view loginName, std::string_view password) const
+	{
+		// never keep the password in clear, even in memory
+		return std::string {loginName} + '\0' + sha1Function.compute(std::string {password}, _credentialCacheSalt);
+	}
+
+	std::optional<Database::UserType>
+	PasswordServiceBase::getUserType(Database::UserId userId)
+	{
+		Database::Session& session {getDbSession()};
+		auto transaction {session.createSharedTransaction()};
+
+		const Database::User::pointer user {Database::User::find(session, userId)};
+		if (!user)
+			return std::nullopt;
+
+		return user->getType();
+	}
+
+	std::optional<Database::UserId>
+	PasswordServiceBase::getCachedCredential(const std::string& key)
+	{
+		CachedCredential credential;
 		{
-			std::shared_lock lock {_mutex};
+			std::shared_lock lock {_credentialCacheMutex};
 
-			if (_loginThrottler.isClientThrottled(clientAddress))
-				return {CheckResult::State::Throttled};
+			auto it {_credentialCache.find(key)};
+			if (it == std::cend(_credentialCache) || it->second.expiry < std::chrono::steady_clock::now())
+				return std::nullopt;
+
+			credential = it->second;
 		}
 
-		const bool match {checkUserPassword(loginName, password)};
+		// Users may have been deleted or modified in the meantime, the database is the reference
+		if (getUserType(credential.userId) != credential.userType)
 		{
-			std::unique_lock lock {_mutex};
+			clearCachedCredentials(credential.userId);
+			return std::nullopt;
+		}
+
+		return credential.userId;
+	}
 
-			if (_loginThrottler.isClientThrottled(clientAddress))
-				return {CheckResult::State::Throttled};
+	void
+	PasswordServiceBase::cacheCredential(const std::string& key, Database::UserId userId)
+	{
+		const std::optional<Database::UserType> userType {getUserType(userId)};
+		if (!userType)
+			return;
+
+		const auto now {std::chrono::steady_clock::now()};
+
+		std::unique_lock lock {_credentialCacheMutex};
 
-			if (match)
+		if (_credentialCache.size() >= maxCachedCredentialCount)
+		{
+			for (auto it {std::begin(_credentialCache)}; it != std::end(_credentialCache);)
 			{
-				_loginThrottler.onGoodClientAttempt(clientAddress);
+				if (it->second.expiry < now)
+					it = _credentialCache.erase(it);
+				else
+					++it;
+			}
+
+			if (_credentialCache.size() >= maxCachedCredentialCount)
+				return;
+		}
 
-				const Database::UserId userId {getOrCreateUser(loginName)};
-				onUserAuthenticated(userId);
-				return {CheckResult::State::Granted, userId};
+		_credentialCache[key] = CachedCredential {userId, *userType, now + _credentialCacheTTL};
+	}
+
+	std::optional<bool>
+	PasswordServiceBase::runPasswordCheck(const boost::asio::ip::address& clientAddress, std::string_view loginName, std::string_view password)
+	{
+		if (!_checkRunner)
+			return checkUserPassword(loginName, password);
+
+		if (_pendingCheckCount++ >= _maxPendingCheckCount)
+		{
+			_pendingCheckCount--;
+			LMS_LOG(AUTH, WARNING) << "Too many pending password checks, rejecting login for user '" << loginName << "'";
+			return std::nullopt;
+		}
+
+		// Shared with the worker: the caller may stop waiting before the check is done
+		auto result {std::make_shared<std::promise<bool>>()};
+		std::future<bool> futureResult {result->get_future()};
+
+		boost::asio::post(_checkIOContext, [this, result, clientAddress, loginName = std::string {loginName}, password = std::string {password}]
+		{
+			try
+			{
+				// No need to spend time on clients throttled while waiting, the caller checks again anyway
+				result->set_value(!_loginThrottler.isClientThrottled(clientAddress) && checkUserPassword(loginName, password));
 			}
-			else
+			catch (...)
 			{
-				_loginThrottler.onBadClientAttempt(clientAddress);
-				return {CheckResult::State::Denied};
+				result->set_exception(std::current_exception());
 			}
+			_pendingCheckCount--;
+		});
+
+		if (futureResult.wait_for(_checkTimeout) != std::future_status::ready)
+		{
+			LMS_LOG(AUTH, WARNING) << "Password check timed out for user '" << loginName << "'";
+			return std::nullopt;
 		}
+
+		return futureResult.get();
+	}
+
+	PasswordServiceBase::CheckResult
+	PasswordServiceBase::checkUserPassword(const boost::asio::ip::address& clientAddress, std::string_view loginName, std::string_view password)
+	{
+		LMS_LOG(AUTH, DEBUG) << "Checking password for user '" << loginName << "'";
+
+		// Do not waste too much resource on brute force attacks (optim)
+		if (_loginThrottler.isClientThrottled(clientAddress))
+			return {CheckResult::State::Throttled};
+
+		std::string credentialCacheKey;
+		if (_credentialCacheTTL.count() > 0)
+		{
+			credentialCacheKey = computeCredentialCacheKey(loginName, password);
+			if (const std::optional<Database::UserId> userId {getCachedCredential(credentialCacheKey)})
+			{
+				_loginThrottler.onGoodClientAttempt(clientAddress);
+				return {CheckResult::State::Granted, *userId};
+			}
+		}
+
+		const std::optional<bool> match {runPasswordCheck(clientAddress, loginName, password)};
+		if (!match)
+			return {CheckResult::State::Busy};
+
+		// the client may have been throttled in the meantime by concurrent attempts
+		if (_loginThrottler.isClientThrottled(clientAddress))
+			return {CheckResult::State::Throttled};
+
+		if (!*match)
+		{
+			_loginThrottler.onBadClientAttempt(clientAddress);
+			return {CheckResult::State::Denied};
+		}
+
+		_loginThrottler.onGoodClientAttempt(clientAddress);
+
+		const Database::UserId userId {getOrCreateUser(loginName)};
+		onUserAuthenticated(userId);
+		if (!credentialCacheKey.empty())
+			cacheCredential(credentialCacheKey, userId);
+
+		return {CheckResult::State::Granted, userId};
 	}
 } // namespace Auth
 
@@ -19,9 +19,18 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <optional>
 #include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include <boost/asio/io_service.hpp>
 
 #include "services/auth/IPasswordService.hpp"
+#include "services/database/Types.hpp"
+#include "utils/IOContextRunner.hpp"
 #include "AuthServiceBase.hpp"
 #include "LoginThrottler.hpp"
 
@@ -38,6 +47,7 @@ namespace Auth
 	{
 		public:
 			PasswordServiceBase(Database::Db& db, std::size_t maxThrottlerEntries, IAuthTokenService& authTokenService);
+			~PasswordServiceBase();
 
 			PasswordServiceBase(const PasswordServiceBase&) = delete;
 			PasswordServiceBase& operator=(const PasswordServiceBase&) = delete;
@@ -47,6 +57,9 @@ namespace Auth
 		protected:
 			IAuthTokenService&	getAuthTokenService() { return _authTokenService; }
 
+			// To be called each time a user password changes
+			void				clearCachedCredentials(Database::UserId userId);
+
 		private:
 			virtual bool	checkUserPassword(std::string_view loginName, std::string_view password) = 0;
 
@@ -54,9 +67,37 @@ namespace Auth
 												std::string_view loginName,
 												std::string_view password) override;
 
-			std::shared_mutex			_mutex;
+			// Runs the check on the check workers, if any. Returns nothing if too many checks are pending or if the check takes too long
+			std::optional<bool>	runPasswordCheck(const boost::asio::ip::address& clientAddress, std::string_view loginName, std::string_view password);
+
+			std::string		computeCredentialCacheKey(std::string_view loginName, std::string_view password) const;
+			std::optional<Database::UserId>	getCachedCredential(const std::string& key);
+			void			cacheCredential(const std::string& key, Database::UserId userId);
+			// std::nullopt if the user does not exist anymore
+			std::optional<Database::UserType>	getUserType(Database::UserId userId);
+
 			LoginThrottler				_loginThrottler;
 			IAuthTokenService&			_authTokenService;
+
+			// Recently verified credentials, keyed by login name and salted hash of the password
+			// Entries are dropped as soon as the user is deleted or gets another type
+			struct CachedCredential
+			{
+				Database::UserId						userId;
+				Database::UserType						userType;
+				std::chrono::steady_clock::time_point	expiry;
+			};
+			const std::chrono::seconds		_credentialCacheTTL;
+			const std::string				_credentialCacheSalt;
+			mutable std::shared_mutex		_credentialCacheMutex;
+			std::unordered_map<std::string, CachedCredential>	_credentialCache;
+
+			// Password hashing and PAM conversations are slow: they are run on a few dedicated threads so that a burst of logins cannot hold all the request threads
+			const std::size_t				_maxPendingCheckCount;
+			const std::chrono::seconds		_checkTimeout;
+			std::atomic<std::size_t>		_pendingCheckCount {};
+			boost::asio::io_service			_checkIOContext;
+			std::optional<IOContextRunner>	_checkRunner;	// not set if checks are run by the calling threads
 	};
 
 } // namespace Auth
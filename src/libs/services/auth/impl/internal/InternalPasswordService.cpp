@@ -118,6 +118,7 @@ namespace Auth
 
 		user.modify()->setPasswordHash(passwordHash);
 		getAuthTokenService().clearAuthTokens(userId);
+		clearCachedCredentials(userId);
 	}
 
 	Database::User::PasswordHash
@@ -51,6 +51,7 @@ namespace Auth
 					Granted,
 					Denied,
 					Throttled,
+					Busy,		// too many pending checks, or check timed out
 				};
 				State state {State::Denied};
 				std::optional<Database::UserId> userId {};
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "CoverCache.hpp"
+
+#include <cassert>
+#include <iterator>
+
+#include "utils/Logger.hpp"
+
+namespace Cover
+{
+	CoverCache::CoverCache(std::size_t maxSize)
+		: _maxShardSize {maxSize / _shardCount}
+		, _maxProtectedShardSize {_maxShardSize * _protectedPercent / 100}
+	{
+	}
+
+	std::shared_ptr<Image::IEncodedImage>
+	CoverCache::get(const CacheEntryDesc& entryDesc)
+	{
+		Shard& shard {getShard(entryDesc)};
+		std::scoped_lock lock {shard.mutex};
+
+		Stats& stats {shard.statsBySize[entryDesc.size]};
+
+		auto it {shard.entries.find(entryDesc)};
+		if (it == std::cend(shard.entries))
+		{
+			stats.misses++;
+			return nullptr;
+		}
+
+		stats.hits++;
+
+		const EntryList::iterator itEntry {it->second};
+		if (itEntry->isProtected)
+			shard.protectedEntries.splice(std::begin(shard.protectedEntries), shard.protectedEntries, itEntry);
+		else
+			protect(shard, itEntry);
+
+		return itEntry->image;
+	}
+
+	void
+	CoverCache::add(const CacheEntryDesc& entryDesc, std::shared_ptr<Image::IEncodedImage> image)
+	{
+		const std::size_t size {image->getDataSize()};
+		if (size > _maxShardSize)
+			return;
+
+		Shard& shard {getShard(entryDesc)};
+		std::scoped_lock lock {shard.mutex};
+
+		// may have been added concurrently
+		if (shard.entries.find(entryDesc) != std::cend(shard.entries))
+			return;
+
+		shard.probationEntries.push_front(Entry {entryDesc, std::move(image)});
+		shard.entries.emplace(entryDesc, std::begin(shard.probationEntries));
+		shard.probationSize += size;
+
+		evict(shard);
+	}
+
+	void
+	CoverCache::clear()
+	{
+		std::size_t entryCount {};
+		std::size_t size {};
+		std::map<Image::ImageSize, Stats> statsBySize;
+
+		for (Shard& shard : _shards)
+		{
+			std::scoped_lock lock {shard.mutex};
+
+			entryCount += shard.entries.size();
+			size += shard.probationSize + shard.protectedSize;
+			for (const auto& [imageSize, stats] : shard.statsBySize)
+			{
+				statsBySize[imageSize].hits += stats.hits;
+				statsBySize[imageSize].misses += stats.misses;
+			}
+
+			shard.entries.clear();
+			shard.probationEntries.clear();
+			shard.protectedEntries.clear();
+			shard.probationSize = 0;
+			shard.protectedSize = 0;
+			shard.statsBySize.clear();
+		}
+
+		LMS_LOG(COVER, DEBUG) << "Cache stats: nb entries = " << entryCount << ", size = " << size;
+		for (const auto& [imageSize, stats] : statsBySize)
+		{
+			const std::size_t total {stats.hits + stats.misses};
+			LMS_LOG(COVER, DEBUG) << "Cache stats for size " << imageSize << ": hits = " << stats.hits << ", misses = " << stats.misses << ", hit rate = " << (total ? stats.hits * 100 / total : 0) << "%";
+		}
+	}
+
+	std::vector<CacheEntryDesc>
+	CoverCache::getHotEntries(std::size_t maxCount)
+	{
+		std::array<std::vector<CacheEntryDesc>, _shardCount> entriesByShard;
+		for (std::size_t i {}; i < _shardCount; ++i)
+		{
+			Shard& shard {_shards[i]};
+			std::scoped_lock lock {shard.mutex};
+
+			for (const EntryList* entries : {&shard.protectedEntries, &shard.probationEntries})
+			{
+				for (const Entry& entry : *entries)
+				{
+					if (entriesByShard[i].size() == maxCount)
+						break;
+					entriesByShard[i].push_back(entry.desc);
+				}
+			}
+		}
+
+		// Shards are picked in turn, entries are evenly spread over them
+		std::vector<CacheEntryDesc> res;
+		for (std::size_t rank {}; res.size() < maxCount; ++rank)
+		{
+			bool found {};
+			for (const std::vector<CacheEntryDesc>& entries : entriesByShard)
+			{
+				if (rank < entries.size() && res.size() < maxCount)
+				{
+					res.push_back(entries[rank]);
+					found = true;
+				}
+			}
+
+			if (!found)
+				break;
+		}
+
+		return res;
+	}
+
+	CoverCache::Shard&
+	CoverCache::getShard(const CacheEntryDesc& entryDesc)
+	{
+		return _shards[std::hash<CacheEntryDesc>{}(entryDesc) % _shardCount];
+	}
+
+	void
+	CoverCache::protect(Shard& shard, EntryList::iterator itEntry)
+	{
+		// must be called locked
+		const std::size_t size {itEntry->image->getDataSize()};
+
+		itEntry->isProtected = true;
+		shard.protectedEntries.splice(std::begin(shard.protectedEntries), shard.probationEntries, itEntry);
+		shard.probationSize -= size;
+		shard.protectedSize += size;
+
+		// demote the least recently used protected entries, they get a new chance in the probation segment
+		while (shard.protectedSize > _maxProtectedShardSize && shard.protectedEntries.size() > 1)
+		{
+			const EntryList::iterator itDemoted {std::prev(std::end(shard.protectedEntries))};
+			const std::size_t demotedSize {itDemoted->image->getDataSize()};
+
+			itDemoted->isProtected = false;
+			shard.probationEntries.splice(std::begin(shard.probationEntries), shard.protectedEntries, itDemoted);
+			shard.protectedSize -= demotedSize;
+			shard.probationSize += demotedSize;
+		}
+	}
+
+	void
+	CoverCache::evict(Shard& shard)
+	{
+		// must be called locked, the most recent entry is kept
+		while (shard.probationSize + shard.protectedSize > _maxShardSize)
+		{
+			const bool evictProbation {shard.probationEntries.size() > 1 || shard.protectedEntries.empty()};
+			EntryList& entries {evictProbation ? shard.probationEntries : shard.protectedEntries};
+			assert(!entries.empty());
+
+			const EntryList::iterator itEvicted {std::prev(std::end(entries))};
+			(evictProbation ? shard.probationSize : shard.protectedSize) -= itEvicted->image->getDataSize();
+			shard.entries.erase(itEvicted->desc);
+			entries.erase(itEvicted);
+		}
+	}
+
+} // namespace Cover
+
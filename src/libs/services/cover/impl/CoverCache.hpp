@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "image/IEncodedImage.hpp"
+#include "services/database/Types.hpp"
+
+namespace Cover
+{
+	// Embedded pictures are identified by their content, so that the tracks sharing the same picture share the same entry
+	struct EmbeddedPictureId
+	{
+		std::uint64_t		hash;
+		Database::TrackId	trackId;	// any track embedding the picture, not part of the identity
+
+		bool operator==(const EmbeddedPictureId& other) const
+		{
+			return hash == other.hash;
+		}
+	};
+
+	struct CacheEntryDesc
+	{
+		std::variant<Database::TrackId, Database::ReleaseId, EmbeddedPictureId> id;
+		std::size_t			size;
+		Image::EncodingFormat	format;
+
+		bool operator==(const CacheEntryDesc& other) const
+		{
+			return id == other.id
+				&& size == other.size
+				&& format == other.format;
+		}
+	};
+
+} // ns Cover
+
+namespace std
+{
+
+	template<>
+	class hash<Cover::EmbeddedPictureId>
+	{
+		public:
+			size_t operator()(const Cover::EmbeddedPictureId& id) const
+			{
+				return std::hash<std::uint64_t>()(id.hash);
+			}
+	};
+
+	template<>
+	class hash<Cover::CacheEntryDesc>
+	{
+		public:
+			size_t operator()(const Cover::CacheEntryDesc& e) const
+			{
+				size_t h {};
+				std::visit([&](auto id)
+				{
+					using IdType = std::decay_t<decltype(id)>;
+					h ^= std::hash<IdType>()(id);
+				}, e.id);
+				h ^= std::hash<std::size_t>()(e.size) << 1;
+				h ^= std::hash<int>()(static_cast<int>(e.format)) << 2;
+				return h;
+			}
+	};
+
+} // ns std
+
+namespace Cover
+{
+	// Segmented LRU: entries hit once are moved to the protected segment, so that one-off lookups cannot evict them
+	// Entries are spread over shards, each having its own lock and its own part of the size budget
+	class CoverCache
+	{
+		public:
+			CoverCache(std::size_t maxSize);
+
+			CoverCache(const CoverCache&) = delete;
+			CoverCache& operator=(const CoverCache&) = delete;
+			CoverCache(CoverCache&&) = delete;
+			CoverCache& operator=(CoverCache&&) = delete;
+
+			std::shared_ptr<Image::IEncodedImage> get(const CacheEntryDesc& entryDesc);
+			void add(const CacheEntryDesc& entryDesc, std::shared_ptr<Image::IEncodedImage> image);
+
+			// Also logs and resets the stats
+			void clear();
+
+			// Most valuable entries first: protected entries, then probation entries, most recently used first
+			std::vector<CacheEntryDesc> getHotEntries(std::size_t maxCount);
+
+		private:
+			struct Entry
+			{
+				CacheEntryDesc							desc;
+				std::shared_ptr<Image::IEncodedImage>	image;
+				bool									isProtected {};
+			};
+			using EntryList = std::list<Entry>;	// most recently used first
+
+			struct Stats
+			{
+				std::size_t	hits {};
+				std::size_t	misses {};
+			};
+
+			struct Shard
+			{
+				std::mutex	mutex;
+				EntryList	probationEntries;
+				EntryList	protectedEntries;
+				std::unordered_map<CacheEntryDesc, EntryList::iterator> entries;
+				std::size_t	probationSize {};
+				std::size_t	protectedSize {};
+				std::map<Image::ImageSize, Stats> statsBySize;
+			};
+
+			Shard& getShard(const CacheEntryDesc& entryDesc);
+			void protect(Shard& shard, EntryList::iterator itEntry);
+			void evict(Shard& shard);
+
+			static constexpr std::size_t _shardCount {16};
+			static constexpr std::size_t _protectedPercent {80};
+
+			const std::size_t _maxShardSize;
+			const std::size_t _maxProtectedShardSize;
+			std::array<Shard, _shardCount> _shards;
+	};
+
+} // namespace Cover
+
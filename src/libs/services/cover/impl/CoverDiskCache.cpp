@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CoverDiskCache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+#include <Wt/Utils.h>
+
+#include "utils/Logger.hpp"
+
+namespace Cover
+{
+	namespace
+	{
+		const std::filesystem::path tmpFileExtension {".part"};
+
+		std::filesystem::path
+		getTmpPath(const std::filesystem::path& entryPath)
+		{
+			static std::atomic<std::size_t> counter {};
+
+			std::filesystem::path tmpPath {entryPath};
+			tmpPath += "-" + std::to_string(counter++);
+			tmpPath += tmpFileExtension;
+
+			return tmpPath;
+		}
+
+		std::string_view
+		getMimeType(Image::EncodingFormat format)
+		{
+			switch (format)
+			{
+				case Image::EncodingFormat::JPEG:	return "image/jpeg";
+				case Image::EncodingFormat::WebP:	return "image/webp";
+			}
+
+			return "application/octet-stream";
+		}
+
+		class CachedImage : public Image::IEncodedImage
+		{
+			public:
+				CachedImage(std::vector<std::byte> data, Image::EncodingFormat format) : _data {std::move(data)}, _mimeType {getMimeType(format)} {}
+
+			private:
+				const std::byte* getData() const override { return _data.data(); }
+				std::size_t getDataSize() const override { return _data.size(); }
+				std::string_view getMimeType() const override { return _mimeType; }
+
+				const std::vector<std::byte> _data;
+				const std::string_view _mimeType;
+		};
+	}
+
+	CoverDiskCache::CoverDiskCache(const std::filesystem::path& directory, std::uintmax_t maxSize)
+		: _directory {directory}
+		, _maxSize {maxSize}
+	{
+		loadEntries();
+
+		LMS_LOG(COVER, INFO) << "Cover disk cache: " << _entries.size() << " entries, size = " << _size / (1000 * 1000) << "/" << _maxSize / (1000 * 1000) << " MB";
+	}
+
+	std::optional<CoverDiskCache::Key>
+	CoverDiskCache::computeKey(const std::filesystem::path& sourcePath, Image::ImageSize width, Image::EncodingFormat format, unsigned quality)
+	{
+		std::error_code ec;
+		const std::filesystem::file_time_type lastWriteTime {std::filesystem::last_write_time(sourcePath, ec)};
+		if (ec)
+			return std::nullopt;
+
+		std::ostringstream oss;
+		oss << sourcePath.string() << '\0'
+			<< lastWriteTime.time_since_epoch().count() << '\0'
+			<< width << '\0'
+			<< quality;
+		// keep the keys of the former JPEG only entries
+		if (format != Image::EncodingFormat::JPEG)
+			oss << '\0' << static_cast<int>(format);
+
+		return Wt::Utils::hexEncode(Wt::Utils::sha1(oss.str()));
+	}
+
+	std::unique_ptr<Image::IEncodedImage>
+	CoverDiskCache::get(const Key& key, Image::EncodingFormat format)
+	{
+		{
+			std::scoped_lock lock {_mutex};
+
+			auto it {_entries.find(key)};
+			if (it == std::cend(_entries))
+				return {};
+
+			_lru.splice(std::begin(_lru), _lru, it->second.itLru);
+		}
+
+		const std::filesystem::path entryPath {getEntryPath(key)};
+
+		// keep the usage order across restarts
+		std::error_code ec;
+		std::filesystem::last_write_time(entryPath, std::filesystem::file_time_type::clock::now(), ec);
+
+		std::ifstream ifs {entryPath, std::ios::in | std::ios::binary | std::ios::ate};
+		if (ifs)
+		{
+			std::vector<std::byte> data(static_cast<std::size_t>(ifs.tellg()));
+			ifs.seekg(0);
+			if (!data.empty() && ifs.read(reinterpret_cast<char*>(data.data()), data.size()))
+				return std::make_unique<CachedImage>(std::move(data), format);
+		}
+
+		LMS_LOG(COVER, ERROR) << "Cannot read cover cache entry '" << entryPath.string() << "'";
+
+		// may have been evicted meanwhile
+		std::scoped_lock lock {_mutex};
+		if (auto it {_entries.find(key)}; it != std::cend(_entries))
+		{
+			_size -= it->second.size;
+			_lru.erase(it->second.itLru);
+			_entries.erase(it);
+		}
+
+		return {};
+	}
+
+	void
+	CoverDiskCache::add(const Key& key, const Image::IEncodedImage& image)
+	{
+		const std::uintmax_t size {image.getDataSize()};
+		if (size == 0 || size > _maxSize)
+			return;
+
+		{
+			std::scoped_lock lock {_mutex};
+
+			// may have been added concurrently
+			if (_entries.find(key) != std::cend(_entries))
+				return;
+		}
+
+		const std::filesystem::path entryPath {getEntryPath(key)};
+		const std::filesystem::path tmpPath {getTmpPath(entryPath)};
+
+		{
+			std::ofstream ofs {tmpPath, std::ios::out | std::ios::binary | std::ios::trunc};
+			ofs.write(reinterpret_cast<const char*>(image.getData()), image.getDataSize());
+			ofs.close();
+
+			if (!ofs)
+			{
+				LMS_LOG(COVER, ERROR) << "Cannot write '" << tmpPath.string() << "'";
+
+				std::error_code ec;
+				std::filesystem::remove(tmpPath, ec);
+				return;
+			}
+		}
+
+		std::scoped_lock lock {_mutex};
+
+		if (_entries.find(key) != std::cend(_entries))
+		{
+			std::error_code ec;
+			std::filesystem::remove(tmpPath, ec);
+			return;
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tmpPath, entryPath, ec);
+		if (ec)
+		{
+			LMS_LOG(COVER, ERROR) << "Cannot rename '" << tmpPath.string() << "': " << ec.message();
+			std::filesystem::remove(tmpPath, ec);
+			return;
+		}
+
+		auto itLru {_lru.insert(std::begin(_lru), key)};
+		_entries.emplace(key, EntryInfo {size, itLru});
+		_size += size;
+
+		evictEntries();
+	}
+
+	void
+	CoverDiskCache::loadEntries()
+	{
+		std::filesystem::create_directories(_directory);
+
+		std::vector<std::tuple<std::filesystem::file_time_type, Key, std::uintmax_t>> entries;
+
+		std::error_code ec;
+		std::filesystem::directory_iterator itEnd;
+		for (std::filesystem::directory_iterator itPath {_directory, ec}; !ec && itPath != itEnd; itPath.increment(ec))
+		{
+			const std::filesystem::path& path {itPath->path()};
+			if (!itPath->is_regular_file(ec))
+				continue;
+
+			// Leftovers of interrupted writes
+			if (path.extension() == tmpFileExtension)
+			{
+				std::filesystem::remove(path, ec);
+				continue;
+			}
+
+			const std::uintmax_t size {itPath->file_size(ec)};
+			if (ec)
+				continue;
+			const std::filesystem::file_time_type lastWriteTime {itPath->last_write_time(ec)};
+			if (ec)
+				continue;
+
+			entries.emplace_back(lastWriteTime, path.filename().string(), size);
+		}
+
+		std::sort(std::begin(entries), std::end(entries), [](const auto& entryA, const auto& entryB) { return std::get<0>(entryA) > std::get<0>(entryB); });
+
+		std::scoped_lock lock {_mutex};
+		for (const auto& [lastWriteTime, key, size] : entries)
+		{
+			(void)lastWriteTime;
+			auto itLru {_lru.insert(std::end(_lru), key)};
+			_entries.emplace(key, EntryInfo {size, itLru});
+			_size += size;
+		}
+
+		evictEntries();
+	}
+
+	void
+	CoverDiskCache::evictEntries()
+	{
+		// must be called locked
+		while (_size > _maxSize && !_lru.empty())
+		{
+			auto itEntry {_entries.find(_lru.back())};
+
+			std::error_code ec;
+			std::filesystem::remove(getEntryPath(itEntry->first), ec);
+			_size -= itEntry->second.size;
+			_entries.erase(itEntry);
+			_lru.pop_back();
+		}
+	}
+
+	std::filesystem::path
+	CoverDiskCache::getEntryPath(const Key& key) const
+	{
+		return _directory / key;
+	}
+} // namespace Cover
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "image/IEncodedImage.hpp"
+
+namespace Cover
+{
+	// Resized covers stored on disk, named after a hash of the source file and of the export parameters
+	// Least recently used entries are removed when the max size is reached
+	class CoverDiskCache
+	{
+		public:
+			using Key = std::string;
+
+			CoverDiskCache(const std::filesystem::path& directory, std::uintmax_t maxSize);
+
+			CoverDiskCache(const CoverDiskCache&) = delete;
+			CoverDiskCache& operator=(const CoverDiskCache&) = delete;
+			CoverDiskCache(CoverDiskCache&&) = delete;
+			CoverDiskCache& operator=(CoverDiskCache&&) = delete;
+
+			// Source is either a picture file or an audio file with an embedded picture
+			// Not set if the source cannot be accessed
+			static std::optional<Key> computeKey(const std::filesystem::path& sourcePath, Image::ImageSize width, Image::EncodingFormat format, unsigned quality);
+
+			// Served as is, no decode involved
+			std::unique_ptr<Image::IEncodedImage> get(const Key& key, Image::EncodingFormat format);
+			void add(const Key& key, const Image::IEncodedImage& image);
+
+		private:
+			void loadEntries();
+			void evictEntries();
+			std::filesystem::path getEntryPath(const Key& key) const;
+
+			const std::filesystem::path	_directory;
+			const std::uintmax_t		_maxSize;
+
+			struct EntryInfo
+			{
+				std::uintmax_t				size;
+				std::list<Key>::iterator	itLru;
+			};
+
+			std::mutex							_mutex;
+			std::unordered_map<Key, EntryInfo>	_entries;
+			std::list<Key>						_lru;	// most recently used first
+			std::uintmax_t						_size {};
+	};
+} // namespace Cover
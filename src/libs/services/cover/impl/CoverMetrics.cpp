@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "services/cover/CoverMetrics.hpp"
+
+#include <array>
+#include <string>
+
+namespace Cover
+{
+	namespace
+	{
+		constexpr std::size_t sourceCount {3};
+		constexpr std::size_t sourceFormatCount {3};
+		constexpr std::size_t stageCount {3};
+
+		using ProcessingHistograms = std::array<Metrics::Histogram*, sourceCount * sourceFormatCount * stageCount>;
+
+		std::size_t
+		getIndex(CoverSource source, CoverSourceFormat sourceFormat, ProcessingStage stage)
+		{
+			return (static_cast<std::size_t>(source) * sourceFormatCount + static_cast<std::size_t>(sourceFormat)) * stageCount + static_cast<std::size_t>(stage);
+		}
+
+		ProcessingHistograms
+		createProcessingHistograms()
+		{
+			ProcessingHistograms res;
+
+			for (CoverSource source : {CoverSource::Embedded, CoverSource::File, CoverSource::Cache})
+			{
+				for (CoverSourceFormat sourceFormat : {CoverSourceFormat::JPEG, CoverSourceFormat::PNG, CoverSourceFormat::Other})
+				{
+					for (ProcessingStage stage : {ProcessingStage::Decode, ProcessingStage::Resize, ProcessingStage::Encode})
+					{
+						const std::string labels {"source=\"" + std::string {toString(source)} + "\",format=\"" + std::string {toString(sourceFormat)} + "\",stage=\"" + std::string {toString(stage)} + "\""};
+						res[getIndex(source, sourceFormat, stage)] = &Metrics::getRegistry().createHistogram("lms_cover_processing_duration", "Time spent to process covers", labels);
+					}
+				}
+			}
+
+			return res;
+		}
+	}
+
+	Metrics::Histogram&
+	getProcessingHistogram(CoverSource source, CoverSourceFormat sourceFormat, ProcessingStage stage)
+	{
+		static const ProcessingHistograms histograms {createProcessingHistograms()};
+
+		return *histograms[getIndex(source, sourceFormat, stage)];
+	}
+
+	std::string_view
+	toString(CoverSource source)
+	{
+		switch (source)
+		{
+			case CoverSource::Embedded:	return "embedded";
+			case CoverSource::File:		return "file";
+			case CoverSource::Cache:	return "cache";
+		}
+
+		return "";
+	}
+
+	std::string_view
+	toString(CoverSourceFormat sourceFormat)
+	{
+		switch (sourceFormat)
+		{
+			case CoverSourceFormat::JPEG:	return "jpeg";
+			case CoverSourceFormat::PNG:	return "png";
+			case CoverSourceFormat::Other:	return "other";
+		}
+
+		return "";
+	}
+
+	std::string_view
+	toString(ProcessingStage stage)
+	{
+		switch (stage)
+		{
+			case ProcessingStage::Decode:	return "decode";
+			case ProcessingStage::Resize:	return "resize";
+			case ProcessingStage::Encode:	return "encode";
+		}
+
+		return "";
+	}
+} // namespace Cover
@@ -21,20 +21,107 @@
 
 #include "av/IAudioFile.hpp"
 
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
 #include "services/database/Db.hpp"
 #include "services/database/Release.hpp"
 #include "services/database/Session.hpp"
 #include "services/database/Track.hpp"
+#include "services/cover/CoverMetrics.hpp"
 
 #include "image/Exception.hpp"
 #include "image/IRawImage.hpp"
+#include "utils/Crc32Calculator.hpp"
 #include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
-#include "utils/Random.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/String.hpp"
+#include "utils/Tracing.hpp"
 #include "utils/Utils.hpp"
+#include "utils/WorkBudget.hpp"
+#include "EmbeddedPictureReader.hpp"
 
 namespace
 {
+	Metrics::Counter&
+	getCacheRequestCounter(std::string_view labels)
+	{
+		return Metrics::getRegistry().createCounter("lms_cover_cache_requests", "Number of cover cache lookups", labels);
+	}
+
+	void
+	reportMemoryCacheLookup(bool hit)
+	{
+		static Metrics::Counter& hits {getCacheRequestCounter("tier=\"memory\",result=\"hit\"")};
+		static Metrics::Counter& misses {getCacheRequestCounter("tier=\"memory\",result=\"miss\"")};
+
+		(hit ? hits : misses).add();
+	}
+
+	void
+	reportDiskCacheLookup(bool hit)
+	{
+		static Metrics::Counter& hits {getCacheRequestCounter("tier=\"disk\",result=\"hit\"")};
+		static Metrics::Counter& misses {getCacheRequestCounter("tier=\"disk\",result=\"miss\"")};
+
+		(hit ? hits : misses).add();
+	}
+
+	Cover::CoverSourceFormat
+	getSourceFormat(const std::byte* data, std::size_t dataSize)
+	{
+		auto startsWith {[&](std::initializer_list<unsigned char> magic)
+		{
+			if (dataSize < magic.size())
+				return false;
+
+			return std::equal(std::cbegin(magic), std::cend(magic), data, [](unsigned char a, std::byte b) { return a == static_cast<unsigned char>(b); });
+		}};
+
+		if (startsWith({0xFF, 0xD8, 0xFF}))
+			return Cover::CoverSourceFormat::JPEG;
+		if (startsWith({0x89, 'P', 'N', 'G'}))
+			return Cover::CoverSourceFormat::PNG;
+
+		return Cover::CoverSourceFormat::Other;
+	}
+
+	Cover::CoverSourceFormat
+	getSourceFormat(const std::filesystem::path& p)
+	{
+		const std::string extension {StringUtils::stringToLower(p.extension().string())};
+		if (extension == ".jpg" || extension == ".jpeg")
+			return Cover::CoverSourceFormat::JPEG;
+		if (extension == ".png")
+			return Cover::CoverSourceFormat::PNG;
+
+		return Cover::CoverSourceFormat::Other;
+	}
+
+	std::vector<Image::ImageSize>
+	getSizeBuckets()
+	{
+		std::vector<Image::ImageSize> sizes;
+
+		Service<IConfig>::get()->visitStrings("cover-size-buckets",
+				[&](std::string_view str)
+				{
+					const std::optional<Image::ImageSize> size {StringUtils::readAs<Image::ImageSize>(str)};
+					if (!size || *size == 0)
+						throw LmsException {"Bad value '" + std::string {str} + "' for 'cover-size-buckets'"};
+
+					sizes.push_back(*size);
+				}, {"64", "128", "256", "512", "1024"});
+
+		std::sort(std::begin(sizes), std::end(sizes));
+		sizes.erase(std::unique(std::begin(sizes), std::end(sizes)), std::end(sizes));
+
+		return sizes;
+	}
+
 	struct TrackInfo
 	{
 		bool hasCover {};
@@ -68,6 +155,47 @@ namespace
 
 		return res;
 	}
+
+	// 0 if the track has no embedded picture or if its hash is not known yet
+	std::uint64_t
+	getTrackCoverHash(Database::Session& dbSession, Database::TrackId trackId)
+	{
+		auto transaction {dbSession.createSharedTransaction()};
+
+		const Database::Track::pointer track {Database::Track::find(dbSession, trackId)};
+		if (!track || !track->hasCover())
+			return 0;
+
+		return track->getCoverHash();
+	}
+
+	struct ReleaseInfo
+	{
+		Database::TrackId firstTrackId;
+		std::filesystem::path releaseDirectory;
+		std::filesystem::path coverPath;
+	};
+
+	std::optional<ReleaseInfo>
+	getReleaseInfo(Database::Session& dbSession, Database::ReleaseId releaseId)
+	{
+		std::optional<ReleaseInfo> res;
+
+		auto transaction {dbSession.createSharedTransaction()};
+
+		if (const Database::Release::pointer release {Database::Release::find(dbSession, releaseId)})
+		{
+			if (const auto firstTrack {release->getFirstTrack()})
+			{
+				res = ReleaseInfo {};
+				res->firstTrackId = firstTrack->getId();
+				res->releaseDirectory = firstTrack->getPath().parent_path();
+				res->coverPath = release->getCoverPath();
+			}
+		}
+
+		return res;
+	}
 }
 
 namespace Cover {
@@ -81,6 +209,27 @@ isFileSupported(const std::filesystem::path& file, const std::vector<std::filesy
 	return (std::find(std::cbegin(extensions), std::cend(extensions), file.extension()) != std::cend(extensions));
 }
 
+EncodingFormat
+selectEncodingFormat(std::string_view acceptHeader)
+{
+	// No need to go for a full q-value parsing: clients that explicitly accept WebP prefer it
+	if (acceptHeader.find("image/webp") != std::string_view::npos && isEncodingSupported(EncodingFormat::WebP))
+		return EncodingFormat::WebP;
+
+	return EncodingFormat::JPEG;
+}
+
+std::string
+computeEntityTag(const IEncodedImage& image)
+{
+	Utils::Crc32Calculator crc32;
+	crc32.processBytes(image.getData(), image.getDataSize());
+
+	std::ostringstream oss;
+	oss << '"' << std::hex << std::setfill('0') << std::setw(8) << crc32.getResult() << '-' << std::dec << image.getDataSize() << '"';
+	return oss.str();
+}
+
 std::unique_ptr<ICoverService>
 createCoverService(Database::Db& db, const std::filesystem::path& execPath, const std::filesystem::path& defaultCoverPath)
 {
@@ -93,11 +242,26 @@ CoverService::CoverService(Database::Db& db,
 	: _db {db}
 	, _defaultCoverPath {defaultCoverPath}
 	, _maxCacheSize {Service<IConfig>::get()->getULong("cover-max-cache-size", 30) * 1000 * 1000}
+	, _cache {_maxCacheSize}
+	, _sizeBuckets {getSizeBuckets()}
 	, _maxFileSize {Service<IConfig>::get()->getULong("cover-max-file-size", 10) * 1000 * 1000}
-
+	, _hotEntriesFilePath {Service<IConfig>::get()->getPath("working-dir") / "cache" / "hot-covers.txt"}
+	, _maxHotEntryCount {Service<IConfig>::get()->getULong("cover-warm-cache-entry-count", 500)}
 {
 	setJpegQuality(Service<IConfig>::get()->getULong("cover-jpeg-quality", 75));
 
+	if (const std::uintmax_t maxDiskCacheSize {static_cast<std::uintmax_t>(Service<IConfig>::get()->getULong("cover-disk-cache-size", 100)) * 1000 * 1000})
+	{
+		try
+		{
+			_diskCache = std::make_unique<CoverDiskCache>(Service<IConfig>::get()->getPath("working-dir") / "cache" / "covers", maxDiskCacheSize);
+		}
+		catch (const std::filesystem::filesystem_error& e)
+		{
+			LMS_LOG(COVER, ERROR) << "Cannot set up cover disk cache: " << e.what();
+		}
+	}
+
 	LMS_LOG(COVER, INFO) << "Default cover path = '" << _defaultCoverPath.string() << "'";
 	LMS_LOG(COVER, INFO) << "Max cache size = " << _maxCacheSize;
 	LMS_LOG(COVER, INFO) << "Max file size = " << _maxFileSize;
@@ -110,76 +274,93 @@ CoverService::CoverService(Database::Db& db,
 
 	try
 	{
-		getDefault(512);
+		getDefault(512, EncodingFormat::JPEG);
 	}
 	catch (const Image::ImageException& e)
 	{
 		throw LmsException("Cannot read default cover file '" + _defaultCoverPath.string() + "': " + e.what());
 	}
+
+	if (_maxHotEntryCount)
+		_warmingThread = std::thread {[this] { warmCache(); }};
+}
+
+CoverService::~CoverService()
+{
+	if (_warmingThread.joinable())
+	{
+		_stopWarming = true;
+		_warmingThread.join();
+	}
+
+	if (_maxHotEntryCount)
+		saveHotEntries();
 }
 
 std::unique_ptr<IEncodedImage>
-CoverService::getFromAvMediaFile(const Av::IAudioFile& input, ImageSize width) const
+CoverService::getFromPicture(const Av::Picture& picture, ImageSize width, EncodingFormat format) const
 {
 	std::unique_ptr<IEncodedImage> image;
 
-	input.visitAttachedPictures([&](const Av::Picture& picture)
+	try
 	{
-		if (image)
-			return;
-
-		try
-		{
-			std::unique_ptr<IRawImage> rawImage {decodeImage(picture.data, picture.dataSize)};
-			rawImage->resize(width);
-			image = rawImage->encodeToJPEG(_jpegQuality);
-		}
-		catch (const Image::ImageException& e)
-		{
-			LMS_LOG(COVER, ERROR) << "Cannot read embedded cover: " << e.what();
-		}
-	});
+		image = processImage(CoverSource::Embedded, getSourceFormat(picture.data, picture.dataSize), [&] { return decodeImage(picture.data, picture.dataSize, width); }, width, format);
+	}
+	catch (const Image::ImageException& e)
+	{
+		LMS_LOG(COVER, ERROR) << "Cannot read embedded cover: " << e.what();
+	}
 
 	return image;
 }
 
 std::unique_ptr<IEncodedImage>
-CoverService::getFromCoverFile(const std::filesystem::path& p, ImageSize width) const
+CoverService::getFromCoverFile(const std::filesystem::path& p, ImageSize width, EncodingFormat format) const
 {
+	const std::optional<CoverDiskCache::Key> diskCacheKey {_diskCache ? CoverDiskCache::computeKey(p, width, format, _jpegQuality) : std::nullopt};
+	if (diskCacheKey)
+	{
+		std::unique_ptr<IEncodedImage> image {_diskCache->get(*diskCacheKey, format)};
+		reportDiskCacheLookup(static_cast<bool>(image));
+		if (image)
+			return image;
+	}
+
 	std::unique_ptr<IEncodedImage> image;
 
 	try
 	{
-		std::unique_ptr<IRawImage> rawImage {decodeImage(p)};
-		rawImage->resize(width);
-		image = rawImage->encodeToJPEG(_jpegQuality);
+		image = processImage(CoverSource::File, getSourceFormat(p), [&] { return decodeImage(p, width); }, width, format);
 	}
 	catch (const ImageException& e)
 	{
 		LMS_LOG(COVER, ERROR) << "Cannot read cover in file '" << p.string() << "': " << e.what();
 	}
 
+	if (image && diskCacheKey)
+		_diskCache->add(*diskCacheKey, *image);
+
 	return image;
 }
 
 std::shared_ptr<IEncodedImage>
-CoverService::getDefault(ImageSize width)
+CoverService::getDefault(ImageSize width, EncodingFormat format)
 {
 	{
-		std::shared_lock lock {_cacheMutex};
+		std::shared_lock lock {_defaultCoverCacheMutex};
 
-		if (auto it {_defaultCoverCache.find(width)}; it != std::cend(_defaultCoverCache))
+		if (auto it {_defaultCoverCache.find({width, format})}; it != std::cend(_defaultCoverCache))
 			return it->second;
 	}
 
 	{
-		std::unique_lock lock {_cacheMutex};
+		std::unique_lock lock {_defaultCoverCacheMutex};
 
-		if (auto it {_defaultCoverCache.find(width)}; it != std::cend(_defaultCoverCache))
+		if (auto it {_defaultCoverCache.find({width, format})}; it != std::cend(_defaultCoverCache))
 			return it->second;
 
-		std::shared_ptr<IEncodedImage> image {getFromCoverFile(_defaultCoverPath, width)};
-		_defaultCoverCache[width] = image;
+		std::shared_ptr<IEncodedImage> image {getFromCoverFile(_defaultCoverPath, width, format)};
+		_defaultCoverCache[{width, format}] = image;
 		LMS_LOG(COVER, DEBUG) << "Default cache entries = " << _defaultCoverCache.size();
 
 		return image;
@@ -187,7 +368,7 @@ CoverService::getDefault(ImageSize width)
 }
 
 std::unique_ptr<IEncodedImage>
-CoverService::getFromDirectory(const std::filesystem::path& directory, ImageSize width) const
+CoverService::getFromDirectory(const std::filesystem::path& directory, ImageSize width, EncodingFormat format) const
 {
 	const std::multimap<std::string, std::filesystem::path> coverPaths {getCoverPaths(directory)};
 
@@ -198,7 +379,7 @@ CoverService::getFromDirectory(const std::filesystem::path& directory, ImageSize
 		auto range {coverPaths.equal_range(std::string {fileName})};
 		for (auto it {range.first}; it != range.second; ++it)
 		{
-			image = getFromCoverFile(it->second, width);
+			image = getFromCoverFile(it->second, width, format);
 			if (image)
 				break;
 		}
@@ -217,7 +398,7 @@ CoverService::getFromDirectory(const std::filesystem::path& directory, ImageSize
 	// Just pick one
 	for (const auto& [filename, coverPath] : coverPaths)
 	{
-		image = getFromCoverFile(coverPath, width);
+		image = getFromCoverFile(coverPath, width, format);
 		if (image)
 			return image;
 	}
@@ -226,7 +407,7 @@ CoverService::getFromDirectory(const std::filesystem::path& directory, ImageSize
 }
 
 std::unique_ptr<IEncodedImage>
-CoverService::getFromSameNamedFile(const std::filesystem::path& filePath, ImageSize width) const
+CoverService::getFromSameNamedFile(const std::filesystem::path& filePath, ImageSize width, EncodingFormat format) const
 {
 	std::unique_ptr<IEncodedImage> res;
 
@@ -238,7 +419,7 @@ CoverService::getFromSameNamedFile(const std::filesystem::path& filePath, ImageS
 		if (!checkCoverFile(coverPath))
 			continue;
 
-		res = getFromCoverFile(coverPath, width);
+		res = getFromCoverFile(coverPath, width, format);
 		if (res)
 			break;
 	}
@@ -246,6 +427,82 @@ CoverService::getFromSameNamedFile(const std::filesystem::path& filePath, ImageS
 	return res;
 }
 
+std::unique_ptr<IEncodedImage>
+CoverService::getFromCoverSource(const std::filesystem::path& coverPath, ImageSize width, EncodingFormat format) const
+{
+	std::error_code ec;
+	if (!std::filesystem::exists(coverPath, ec))
+		return {};
+
+	if (isFileSupported(coverPath, _fileExtensions))
+		return getFromCoverFile(coverPath, width, format);
+
+	// embedded picture
+	return getFromTrack(coverPath, width, format);
+}
+
+std::optional<std::filesystem::path>
+CoverService::findCoverPathInDirectory(const std::filesystem::path& directory) const
+{
+	const std::multimap<std::string, std::filesystem::path> coverPaths {getCoverPaths(directory)};
+
+	for (std::string_view filename : _preferredFileNames)
+	{
+		if (auto it {coverPaths.find(std::string {filename})}; it != std::cend(coverPaths))
+			return it->second;
+	}
+
+	if (!coverPaths.empty())
+		return std::cbegin(coverPaths)->second;
+
+	return std::nullopt;
+}
+
+std::optional<std::filesystem::path>
+CoverService::findSameNamedCoverPath(const std::filesystem::path& filePath) const
+{
+	std::filesystem::path coverPath {filePath};
+	for (const std::filesystem::path& extension : _fileExtensions)
+	{
+		coverPath.replace_extension(extension);
+
+		if (checkCoverFile(coverPath))
+			return coverPath;
+	}
+
+	return std::nullopt;
+}
+
+std::unique_ptr<IEncodedImage>
+CoverService::processImage(CoverSource source, CoverSourceFormat sourceFormat, const std::function<std::unique_ptr<IRawImage>()>& decode, ImageSize width, EncodingFormat format) const
+{
+	std::unique_ptr<IRawImage> rawImage;
+	{
+		const Metrics::ScopedTimer timer {getProcessingHistogram(source, sourceFormat, ProcessingStage::Decode)};
+		rawImage = decode();
+	}
+
+	{
+		const Metrics::ScopedTimer timer {getProcessingHistogram(source, sourceFormat, ProcessingStage::Resize)};
+		rawImage->resize(width);
+	}
+
+	const Metrics::ScopedTimer timer {getProcessingHistogram(source, sourceFormat, ProcessingStage::Encode)};
+	return encode(*rawImage, format);
+}
+
+std::unique_ptr<IEncodedImage>
+CoverService::encode(const IRawImage& rawImage, EncodingFormat format) const
+{
+	switch (format)
+	{
+		case EncodingFormat::JPEG:	return rawImage.encodeToJPEG(_jpegQuality);
+		case EncodingFormat::WebP:	return rawImage.encodeToWebP(_jpegQuality);
+	}
+
+	throw ImageException {"Unhandled encoding format"};
+}
+
 bool
 CoverService::checkCoverFile(const std::filesystem::path& filePath) const
 {
@@ -291,114 +548,266 @@ CoverService::getCoverPaths(const std::filesystem::path& directoryPath) const
 }
 
 std::unique_ptr<IEncodedImage>
-CoverService::getFromTrack(const std::filesystem::path& p, ImageSize width) const
+CoverService::getFromTrack(const std::filesystem::path& p, ImageSize width, EncodingFormat format) const
 {
+	const std::optional<CoverDiskCache::Key> diskCacheKey {_diskCache ? CoverDiskCache::computeKey(p, width, format, _jpegQuality) : std::nullopt};
+	if (diskCacheKey)
+	{
+		std::unique_ptr<IEncodedImage> image {_diskCache->get(*diskCacheKey, format)};
+		reportDiskCacheLookup(static_cast<bool>(image));
+		if (image)
+			return image;
+	}
+
 	std::unique_ptr<IEncodedImage> image;
 
+	auto visitPicture {[&](const Av::Picture& picture)
+	{
+		if (!image)
+			image = getFromPicture(picture, width, format);
+	}};
+
 	try
 	{
-		image = getFromAvMediaFile(*Av::parseAudioFile(p), width);
+		// Only fall back on the costly demuxer setup for containers not handled by the lightweight reader
+		if (!visitEmbeddedPictures(p, visitPicture))
+			Av::parseAudioFile(p)->visitAttachedPictures(visitPicture);
 	}
 	catch (Av::Exception& e)
 	{
 		LMS_LOG(COVER, ERROR) << "Cannot get covers from track " << p.string() << ": " << e.what();
 	}
 
+	if (image && diskCacheKey)
+		_diskCache->add(*diskCacheKey, *image);
+
 	return image;
 }
 
 std::shared_ptr<IEncodedImage>
-CoverService::getFromTrack(Database::TrackId trackId, ImageSize width)
+CoverService::getFromTrack(Database::TrackId trackId, ImageSize width, EncodingFormat format)
 {
-	return getFromTrack(_db.getTLSSession(), trackId, width, true /* allow release fallback*/);
+	const ImageSize size {snapToBucket(width)};
+
+	if (const std::uint64_t coverHash {getTrackCoverHash(_db.getTLSSession(), trackId)})
+	{
+		const CacheEntryDesc pictureCacheEntryDesc {EmbeddedPictureId {coverHash, trackId}, size, format};
+		std::shared_ptr<IEncodedImage> pictureCover {getFromCacheOrCompute(pictureCacheEntryDesc, [&]() -> std::shared_ptr<IEncodedImage>
+		{
+			if (std::shared_ptr<IEncodedImage> cover {getFromLargerBucket(pictureCacheEntryDesc)})
+				return cover;
+
+			const std::optional<TrackInfo> trackInfo {getTrackInfo(_db.getTLSSession(), trackId)};
+			if (!trackInfo)
+				return {};
+
+			return getFromTrack(trackInfo->trackPath, size, format);
+		})};
+
+		// Otherwise, the picture cannot be decoded: use the usual fallbacks of this track
+		if (pictureCover)
+			return pictureCover;
+	}
+
+	const CacheEntryDesc cacheEntryDesc {trackId, size, format};
+	return getFromCacheOrCompute(cacheEntryDesc, [&]
+	{
+		if (std::shared_ptr<IEncodedImage> cover {getFromLargerBucket(cacheEntryDesc)})
+			return cover;
+
+		return getFromTrack(_db.getTLSSession(), trackId, cacheEntryDesc.size, format, true /* allow release fallback*/);
+	});
 }
 
 std::shared_ptr<IEncodedImage>
-CoverService::getFromTrack(Database::Session& dbSession, Database::TrackId trackId, ImageSize width, bool allowReleaseFallback)
+CoverService::getFromTrack(Database::Session& dbSession, Database::TrackId trackId, ImageSize width, EncodingFormat format, bool allowReleaseFallback)
 {
 	using namespace Database;
 
-	const CacheEntryDesc cacheEntryDesc {trackId, width};
-
-	std::shared_ptr<IEncodedImage> cover {loadFromCache(cacheEntryDesc)};
-	if (cover)
-		return cover;
+	std::shared_ptr<IEncodedImage> cover;
 
 	if (const std::optional<TrackInfo> trackInfo {getTrackInfo(dbSession, trackId)})
 	{
 		if (trackInfo->hasCover)
-			cover = getFromTrack(trackInfo->trackPath, width);
+			cover = getFromTrack(trackInfo->trackPath, width, format);
 
 		if (!cover)
-			cover = getFromSameNamedFile(trackInfo->trackPath, width);
+			cover = getFromSameNamedFile(trackInfo->trackPath, width, format);
 
+		// cached and shared with concurrent requests: fine since release covers never wait for track covers
 		if (!cover && trackInfo->releaseId && allowReleaseFallback)
-			cover = getFromRelease(*trackInfo->releaseId, width);
+			cover = getFromRelease(*trackInfo->releaseId, width, format);
 
 		if (!cover && trackInfo->isMultiDisc)
 		{
 			if (trackInfo->trackPath.parent_path().has_parent_path())
-				cover = getFromDirectory(trackInfo->trackPath.parent_path().parent_path(), width);
+				cover = getFromDirectory(trackInfo->trackPath.parent_path().parent_path(), width, format);
 		}
 	}
 
 	if (!cover)
-		cover = getDefault(width);
-
-	if (cover)
-		saveToCache(cacheEntryDesc, cover);
+		cover = getDefault(width, format);
 
 	return cover;
 }
 
 std::shared_ptr<IEncodedImage>
-CoverService::getFromRelease(Database::ReleaseId releaseId, ImageSize width)
+CoverService::getFromRelease(Database::ReleaseId releaseId, ImageSize width, EncodingFormat format)
 {
-	const CacheEntryDesc cacheEntryDesc {releaseId, width};
+	const CacheEntryDesc cacheEntryDesc {releaseId, snapToBucket(width), format};
+	return getFromCacheOrCompute(cacheEntryDesc, [&]
+	{
+		if (std::shared_ptr<IEncodedImage> cover {getFromLargerBucket(cacheEntryDesc)})
+			return cover;
 
-	std::shared_ptr<IEncodedImage> cover {loadFromCache(cacheEntryDesc)};
-	if (cover)
-		return cover;
+		return getFromRelease(_db.getTLSSession(), releaseId, cacheEntryDesc.size, format);
+	});
+}
 
-	struct ReleaseInfo
+std::shared_ptr<IEncodedImage>
+CoverService::getFromRelease(Database::Session& session, Database::ReleaseId releaseId, ImageSize width, EncodingFormat format)
+{
+	std::shared_ptr<IEncodedImage> cover;
+
+	if (const std::optional<ReleaseInfo> releaseInfo {getReleaseInfo(session, releaseId)})
 	{
-		Database::TrackId firstTrackId;
-		std::filesystem::path releaseDirectory;
-	};
+		// chosen by the scanner, may be outdated
+		if (!releaseInfo->coverPath.empty())
+			cover = getFromCoverSource(releaseInfo->coverPath, width, format);
 
+		if (!cover)
+			cover = getFromDirectory(releaseInfo->releaseDirectory, width, format);
+		if (!cover)
+			cover = getFromTrack(session, releaseInfo->firstTrackId, width, format, false /* no release fallback */);
+	}
+
+	if (!cover)
+		cover = getDefault(width, format);
+
+	return cover;
+}
+
+std::filesystem::path
+CoverService::findReleaseCoverPath(Database::ReleaseId releaseId)
+{
+	// Same lookup order as getFromRelease
 	Database::Session& session {_db.getTLSSession()};
 
-	auto getReleaseInfo {[&]
+	const std::optional<ReleaseInfo> releaseInfo {getReleaseInfo(session, releaseId)};
+	if (!releaseInfo)
+		return {};
+
+	if (std::optional<std::filesystem::path> coverPath {findCoverPathInDirectory(releaseInfo->releaseDirectory)})
+		return *coverPath;
+
+	if (const std::optional<TrackInfo> trackInfo {getTrackInfo(session, releaseInfo->firstTrackId)})
 	{
-		std::optional<ReleaseInfo> res;
+		if (trackInfo->hasCover)
+			return trackInfo->trackPath;
 
-		auto transaction {session.createSharedTransaction()};
+		if (std::optional<std::filesystem::path> coverPath {findSameNamedCoverPath(trackInfo->trackPath)})
+			return *coverPath;
 
-		if (const Database::Release::pointer release {Database::Release::find(session, releaseId)})
+		if (trackInfo->isMultiDisc && trackInfo->trackPath.parent_path().has_parent_path())
 		{
-			if (const auto firstTrack {release->getFirstTrack()})
-			{
-				res = ReleaseInfo {};
-				res->firstTrackId = firstTrack->getId();
-				res->releaseDirectory = firstTrack->getPath().parent_path();
-			}
+			if (std::optional<std::filesystem::path> coverPath {findCoverPathInDirectory(trackInfo->trackPath.parent_path().parent_path())})
+				return *coverPath;
 		}
+	}
 
-		return res;
-	}};
+	return {};
+}
+
+ImageSize
+CoverService::snapToBucket(ImageSize width) const
+{
+	if (_sizeBuckets.empty())
+		return width;
+
+	auto it {std::lower_bound(std::cbegin(_sizeBuckets), std::cend(_sizeBuckets), width)};
+	if (it == std::cend(_sizeBuckets))
+		return _sizeBuckets.back();
 
-	if (const std::optional<ReleaseInfo> releaseInfo {getReleaseInfo()})
+	return *it;
+}
+
+std::shared_ptr<IEncodedImage>
+CoverService::getFromLargerBucket(const CacheEntryDesc& cacheEntryDesc)
+{
+	// Smallest larger bucket first: cheaper to decode
+	for (auto it {std::upper_bound(std::cbegin(_sizeBuckets), std::cend(_sizeBuckets), cacheEntryDesc.size)}; it != std::cend(_sizeBuckets); ++it)
 	{
-		cover = getFromDirectory(releaseInfo->releaseDirectory, width);
-		if (!cover)
-			cover = getFromTrack(session, releaseInfo->firstTrackId, width, false /* no release fallback */);
+		CacheEntryDesc largerCacheEntryDesc {cacheEntryDesc};
+		largerCacheEntryDesc.size = *it;
+
+		const std::shared_ptr<IEncodedImage> largerCover {_cache.get(largerCacheEntryDesc)};
+		if (!largerCover)
+			continue;
+
+		try
+		{
+			return processImage(CoverSource::Cache, getSourceFormat(largerCover->getData(), largerCover->getDataSize()), [&] { return decodeImage(largerCover->getData(), largerCover->getDataSize(), cacheEntryDesc.size); }, cacheEntryDesc.size, cacheEntryDesc.format);
+		}
+		catch (const ImageException& e)
+		{
+			LMS_LOG(COVER, ERROR) << "Cannot resize cached cover: " << e.what();
+		}
 	}
 
-	if (!cover)
-		cover = getDefault(width);
+	return {};
+}
 
+std::shared_ptr<IEncodedImage>
+CoverService::getFromCacheOrCompute(const CacheEntryDesc& cacheEntryDesc, const std::function<std::shared_ptr<IEncodedImage>()>& computeCover)
+{
+	if (std::shared_ptr<IEncodedImage> cover {_cache.get(cacheEntryDesc)})
+	{
+		reportMemoryCacheLookup(true);
+		return cover;
+	}
+	reportMemoryCacheLookup(false);
+
+	std::promise<std::shared_ptr<IEncodedImage>> coverPromise;
+	{
+		std::unique_lock lock {_pendingCoversMutex};
+
+		// Someone is already computing the very same cover, just wait for it
+		if (auto it {_pendingCovers.find(cacheEntryDesc)}; it != std::cend(_pendingCovers))
+		{
+			const std::shared_future<std::shared_ptr<IEncodedImage>> pendingCover {it->second};
+			lock.unlock();
+
+			return pendingCover.get();
+		}
+
+		_pendingCovers.emplace(cacheEntryDesc, coverPromise.get_future().share());
+	}
+
+	std::shared_ptr<IEncodedImage> cover;
+	try
+	{
+		const Tracing::ScopedSpan span {"cover.compute"};
+		cover = computeCover();
+	}
+	catch (...)
+	{
+		{
+			std::scoped_lock lock {_pendingCoversMutex};
+			_pendingCovers.erase(cacheEntryDesc);
+		}
+		coverPromise.set_exception(std::current_exception());
+		throw;
+	}
+
+	// add to the cache first, so that there is no window in which neither the cache nor the pending covers have it
 	if (cover)
-		saveToCache(cacheEntryDesc, cover);
+		_cache.add(cacheEntryDesc, cover);
+
+	{
+		std::scoped_lock lock {_pendingCoversMutex};
+		_pendingCovers.erase(cacheEntryDesc);
+	}
+	coverPromise.set_value(cover);
 
 	return cover;
 }
@@ -406,53 +815,78 @@ CoverService::getFromRelease(Database::ReleaseId releaseId, ImageSize width)
 void
 CoverService::flushCache()
 {
-	std::unique_lock lock {_cacheMutex};
-
-	LMS_LOG(COVER, DEBUG) << "Cache stats: hits = " << _cacheHits << ", misses = " << _cacheMisses << ", nb entries = " << _cache.size() << ", size = " << _cacheSize;
-	_cacheHits = 0;
-	_cacheMisses = 0;
-	_cacheSize = 0;
 	_cache.clear();
 }
 
 void
-CoverService::setJpegQuality(unsigned quality)
+CoverService::saveHotEntries()
 {
-	_jpegQuality = Utils::clamp<unsigned>(quality, 1, 100);
+	const std::vector<CacheEntryDesc> entries {_cache.getHotEntries(_maxHotEntryCount)};
 
-	LMS_LOG(COVER, INFO) << "JPEG export quality = " << _jpegQuality;
+	// one entry per line: "<r|t> <id> <size> <format>"
+	// embedded pictures are saved as one of their tracks, the track lookup leads to the same entry
+	std::ofstream ofs {_hotEntriesFilePath, std::ios::out | std::ios::trunc};
+	for (const CacheEntryDesc& entry : entries)
+	{
+		if (const Database::ReleaseId* releaseId {std::get_if<Database::ReleaseId>(&entry.id)})
+			ofs << "r " << releaseId->getValue();
+		else if (const EmbeddedPictureId* pictureId {std::get_if<EmbeddedPictureId>(&entry.id)})
+			ofs << "t " << pictureId->trackId.getValue();
+		else
+			ofs << "t " << std::get<Database::TrackId>(entry.id).getValue();
+
+		ofs << " " << entry.size << " " << static_cast<int>(entry.format) << "\n";
+	}
+
+	if (!ofs)
+		LMS_LOG(COVER, ERROR) << "Cannot save hot cover entries in '" << _hotEntriesFilePath.string() << "'";
+	else
+		LMS_LOG(COVER, INFO) << "Saved " << entries.size() << " hot cover entries";
 }
 
 void
-CoverService::saveToCache(const CacheEntryDesc& entryDesc, std::shared_ptr<IEncodedImage> image)
+CoverService::warmCache()
 {
-	std::unique_lock lock {_cacheMutex};
-
-	while (_cacheSize + image->getDataSize() > _maxCacheSize && !_cache.empty())
+	std::ifstream ifs {_hotEntriesFilePath};
+	if (!ifs)
+		return;
+
+	std::size_t entryCount {};
+	char type;
+	Database::IdType::ValueType id;
+	ImageSize size;
+	int format;
+	while (!_stopWarming && entryCount < _maxHotEntryCount && ifs >> type >> id >> size >> format)
 	{
-		auto itRandom {Random::pickRandom(_cache)};
-		_cacheSize -= itRandom->second->getDataSize();
-		_cache.erase(itRandom);
+		if ((type != 'r' && type != 't') || (format != static_cast<int>(EncodingFormat::JPEG) && format != static_cast<int>(EncodingFormat::WebP)))
+			break;
+
+		// Low priority: shares the background work budget with the scanner
+		const WorkBudget::ScopedSlot slot {WorkBudget::WorkClass::Background};
+		try
+		{
+			if (type == 'r')
+				getFromRelease(Database::ReleaseId {id}, size, static_cast<EncodingFormat>(format));
+			else
+				getFromTrack(Database::TrackId {id}, size, static_cast<EncodingFormat>(format));
+		}
+		catch (const std::exception& e)
+		{
+			LMS_LOG(COVER, DEBUG) << "Cannot warm cover: " << e.what();
+		}
+
+		entryCount++;
 	}
 
-	_cacheSize += image->getDataSize();
-	_cache[entryDesc] = image;
+	LMS_LOG(COVER, INFO) << "Cover cache warmed with " << entryCount << " entries";
 }
 
-std::shared_ptr<IEncodedImage>
-CoverService::loadFromCache(const CacheEntryDesc& entryDesc)
+void
+CoverService::setJpegQuality(unsigned quality)
 {
-	std::shared_lock lock {_cacheMutex};
-
-	auto it {_cache.find(entryDesc)};
-	if (it == std::cend(_cache))
-	{
-		++_cacheMisses;
-		return nullptr;
-	}
+	_jpegQuality = Utils::clamp<unsigned>(quality, 1, 100);
 
-	++_cacheHits;
-	return it->second;
+	LMS_LOG(COVER, INFO) << "JPEG export quality = " << _jpegQuality;
 }
 
 } // namespace Cover
@@ -21,17 +21,25 @@
 
 #include <atomic>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <map>
+#include <mutex>
 #include <optional>
 #include <shared_mutex>
 #include <string_view>
+#include <thread>
 #include <unordered_map>
-#include <variant>
+#include <utility>
 #include <vector>
 
+#include "services/cover/CoverMetrics.hpp"
 #include "services/cover/ICoverService.hpp"
 #include "image/IEncodedImage.hpp"
+#include "image/IRawImage.hpp"
 #include "services/database/Types.hpp"
+#include "CoverCache.hpp"
+#include "CoverDiskCache.hpp"
 
 namespace Database
 {
@@ -40,47 +48,9 @@ namespace Database
 
 namespace Av
 {
-	class IAudioFile;
+	struct Picture;
 }
 
-namespace Cover
-{
-	struct CacheEntryDesc
-	{
-		std::variant<Database::TrackId, Database::ReleaseId> id;
-		std::size_t			size;
-
-		bool operator==(const CacheEntryDesc& other) const
-		{
-			return id == other.id
-				&& size == other.size;
-		}
-	};
-
-} // ns Cover
-
-namespace std
-{
-
-	template<>
-	class hash<Cover::CacheEntryDesc>
-	{
-		public:
-			size_t operator()(const Cover::CacheEntryDesc& e) const
-			{
-				size_t h {};
-				std::visit([&](auto id)
-				{
-					using IdType = std::decay_t<decltype(id)>;
-					h ^= std::hash<IdType>()(id);
-				}, e.id);
-				h ^= std::hash<std::size_t>()(e.size) << 1;
-				return h;
-			}
-	};
-
-} // ns std
-
 namespace Cover
 {
 	class CoverService : public ICoverService
@@ -89,6 +59,7 @@ namespace Cover
 			CoverService(Database::Db& db,
 					const std::filesystem::path& execPath,
 					const std::filesystem::path& defaultCoverPath);
+			~CoverService();
 
 			CoverService(const CoverService&) = delete;
 			CoverService& operator=(const CoverService&) = delete;
@@ -96,41 +67,64 @@ namespace Cover
 			CoverService& operator=(CoverService&&) = delete;
 
 		private:
-			std::shared_ptr<Image::IEncodedImage>	getFromTrack(Database::TrackId trackId, Image::ImageSize width) override;
-			std::shared_ptr<Image::IEncodedImage>	getFromRelease(Database::ReleaseId releaseId, Image::ImageSize width) override;
+			std::shared_ptr<Image::IEncodedImage>	getFromTrack(Database::TrackId trackId, Image::ImageSize width, Image::EncodingFormat format) override;
+			std::shared_ptr<Image::IEncodedImage>	getFromRelease(Database::ReleaseId releaseId, Image::ImageSize width, Image::EncodingFormat format) override;
+			std::filesystem::path			findReleaseCoverPath(Database::ReleaseId releaseId) override;
 			void							flushCache() override;
 			void							setJpegQuality(unsigned quality) override;
 
-			std::shared_ptr<Image::IEncodedImage>	getFromTrack(Database::Session& dbSession, Database::TrackId trackId, Image::ImageSize width, bool allowReleaseFallback);
-			std::unique_ptr<Image::IEncodedImage>	getFromAvMediaFile(const Av::IAudioFile& input, Image::ImageSize width) const;
-			std::unique_ptr<Image::IEncodedImage>	getFromCoverFile(const std::filesystem::path& p, Image::ImageSize width) const;
+			// Smallest bucket that is at least as large as the requested width, or the largest bucket
+			Image::ImageSize				snapToBucket(Image::ImageSize width) const;
+			// Downscales a larger bucket of the same cover, if already in the memory cache
+			std::shared_ptr<Image::IEncodedImage>	getFromLargerBucket(const CacheEntryDesc& cacheEntryDesc);
+
+			// Concurrent requests for the same entry share the same computation
+			std::shared_ptr<Image::IEncodedImage>	getFromCacheOrCompute(const CacheEntryDesc& cacheEntryDesc, const std::function<std::shared_ptr<Image::IEncodedImage>()>& computeCover);
 
-			std::unique_ptr<Image::IEncodedImage>	getFromTrack(const std::filesystem::path& path, Image::ImageSize width) const;
+			std::shared_ptr<Image::IEncodedImage>	getFromTrack(Database::Session& dbSession, Database::TrackId trackId, Image::ImageSize width, Image::EncodingFormat format, bool allowReleaseFallback);
+			std::shared_ptr<Image::IEncodedImage>	getFromRelease(Database::Session& dbSession, Database::ReleaseId releaseId, Image::ImageSize width, Image::EncodingFormat format);
+			std::unique_ptr<Image::IEncodedImage>	getFromPicture(const Av::Picture& picture, Image::ImageSize width, Image::EncodingFormat format) const;
+			std::unique_ptr<Image::IEncodedImage>	getFromCoverFile(const std::filesystem::path& p, Image::ImageSize width, Image::EncodingFormat format) const;
+
+			std::unique_ptr<Image::IEncodedImage>	getFromTrack(const std::filesystem::path& path, Image::ImageSize width, Image::EncodingFormat format) const;
 			std::multimap<std::string, std::filesystem::path>	getCoverPaths(const std::filesystem::path& directoryPath) const;
-			std::unique_ptr<Image::IEncodedImage>	getFromDirectory(const std::filesystem::path& directory, Image::ImageSize width) const;
-			std::unique_ptr<Image::IEncodedImage>	getFromSameNamedFile(const std::filesystem::path& filePath, Image::ImageSize width) const;
-			std::shared_ptr<Image::IEncodedImage>	getDefault(Image::ImageSize width);
+			std::unique_ptr<Image::IEncodedImage>	getFromDirectory(const std::filesystem::path& directory, Image::ImageSize width, Image::EncodingFormat format) const;
+			std::unique_ptr<Image::IEncodedImage>	getFromSameNamedFile(const std::filesystem::path& filePath, Image::ImageSize width, Image::EncodingFormat format) const;
+			std::unique_ptr<Image::IEncodedImage>	getFromCoverSource(const std::filesystem::path& coverPath, Image::ImageSize width, Image::EncodingFormat format) const;
+			std::optional<std::filesystem::path>	findCoverPathInDirectory(const std::filesystem::path& directory) const;
+			std::optional<std::filesystem::path>	findSameNamedCoverPath(const std::filesystem::path& filePath) const;
+			std::shared_ptr<Image::IEncodedImage>	getDefault(Image::ImageSize width, Image::EncodingFormat format);
+
+			// decode, resize and encode, timed separately
+			std::unique_ptr<Image::IEncodedImage>	processImage(CoverSource source, CoverSourceFormat sourceFormat, const std::function<std::unique_ptr<Image::IRawImage>()>& decode, Image::ImageSize width, Image::EncodingFormat format) const;
+			std::unique_ptr<Image::IEncodedImage>	encode(const Image::IRawImage& rawImage, Image::EncodingFormat format) const;
 
 			bool							checkCoverFile(const std::filesystem::path& directoryPath) const;
 
-			Database::Db&				_db;
+			// The hottest entries are saved at shutdown, and computed again in the background at startup
+			void							saveHotEntries();
+			void							warmCache();
 
-			std::shared_mutex _cacheMutex;
-			std::unordered_map<CacheEntryDesc, std::shared_ptr<Image::IEncodedImage>> _cache;
-			std::unordered_map<Image::ImageSize, std::shared_ptr<Image::IEncodedImage>> _defaultCoverCache;
-			std::atomic<std::size_t>	_cacheMisses {};
-			std::atomic<std::size_t>	_cacheHits {};
-			std::size_t					_cacheSize {};
+			Database::Db&				_db;
 
-			void saveToCache(const CacheEntryDesc& entryDesc, std::shared_ptr<Image::IEncodedImage> image);
-			std::shared_ptr<Image::IEncodedImage> loadFromCache(const CacheEntryDesc& entryDesc);
+			std::shared_mutex _defaultCoverCacheMutex;
+			std::map<std::pair<Image::ImageSize, Image::EncodingFormat>, std::shared_ptr<Image::IEncodedImage>> _defaultCoverCache;
 
 			const std::filesystem::path _defaultCoverPath;
 			const std::size_t _maxCacheSize;
+			CoverCache _cache;
+			const std::vector<Image::ImageSize> _sizeBuckets;	// sorted, empty if sizes are not snapped
+			std::mutex _pendingCoversMutex;
+			std::unordered_map<CacheEntryDesc, std::shared_future<std::shared_ptr<Image::IEncodedImage>>> _pendingCovers;
+			std::unique_ptr<CoverDiskCache> _diskCache;	// second tier, not set if disabled
 			static inline const std::vector<std::filesystem::path> _fileExtensions {".jpg", ".jpeg", ".png", ".bmp"}; // TODO parametrize
 			const std::size_t _maxFileSize;
 			static inline const std::vector<std::string> _preferredFileNames {"cover", "front"}; // TODO parametrize
 			unsigned _jpegQuality;
+			const std::filesystem::path _hotEntriesFilePath;
+			const std::size_t _maxHotEntryCount;	// 0 if disabled
+			std::atomic<bool> _stopWarming {};
+			std::thread _warmingThread;
 	};
 
 } // namespace Cover
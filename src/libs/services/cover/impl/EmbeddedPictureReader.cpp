@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "EmbeddedPictureReader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Cover
+{
+	namespace
+	{
+		using Bytes = std::vector<std::byte>;
+
+		// avoid huge allocations on corrupted files
+		constexpr std::size_t maxTagSize {64 * 1024 * 1024};
+
+		std::uint32_t
+		readU32BE(const std::byte* data)
+		{
+			return (std::to_integer<std::uint32_t>(data[0]) << 24)
+				| (std::to_integer<std::uint32_t>(data[1]) << 16)
+				| (std::to_integer<std::uint32_t>(data[2]) << 8)
+				| std::to_integer<std::uint32_t>(data[3]);
+		}
+
+		std::uint32_t
+		readU24BE(const std::byte* data)
+		{
+			return (std::to_integer<std::uint32_t>(data[0]) << 16)
+				| (std::to_integer<std::uint32_t>(data[1]) << 8)
+				| std::to_integer<std::uint32_t>(data[2]);
+		}
+
+		std::uint32_t
+		readSyncSafe(const std::byte* data)
+		{
+			return ((std::to_integer<std::uint32_t>(data[0]) & 0x7F) << 21)
+				| ((std::to_integer<std::uint32_t>(data[1]) & 0x7F) << 14)
+				| ((std::to_integer<std::uint32_t>(data[2]) & 0x7F) << 7)
+				| (std::to_integer<std::uint32_t>(data[3]) & 0x7F);
+		}
+
+		bool
+		startsWith(const Bytes& data, std::string_view magic)
+		{
+			return data.size() >= magic.size() && std::memcmp(data.data(), magic.data(), magic.size()) == 0;
+		}
+
+		bool
+		readBytes(std::ifstream& ifs, std::size_t size, Bytes& data)
+		{
+			data.resize(size);
+			return static_cast<bool>(ifs.read(reinterpret_cast<char*>(data.data()), size));
+		}
+
+		// 0xFF 0x00 -> 0xFF
+		void
+		removeUnsynchronisation(Bytes& data)
+		{
+			std::size_t dst {};
+			for (std::size_t src {}; src < data.size(); ++src)
+			{
+				data[dst++] = data[src];
+				if (data[src] == std::byte {0xFF} && src + 1 < data.size() && data[src + 1] == std::byte {0x00})
+					++src;
+			}
+			data.resize(dst);
+		}
+
+		// returns the offset just after the terminator, if any
+		std::optional<std::size_t>
+		skipTerminatedString(const std::byte* data, std::size_t size, std::size_t offset, bool wideChars)
+		{
+			if (!wideChars)
+			{
+				const std::byte* end {std::find(data + offset, data + size, std::byte {0})};
+				if (end == data + size)
+					return std::nullopt;
+
+				return static_cast<std::size_t>(end - data) + 1;
+			}
+
+			for (std::size_t i {offset}; i + 1 < size; i += 2)
+			{
+				if (data[i] == std::byte {0} && data[i + 1] == std::byte {0})
+					return i + 2;
+			}
+
+			return std::nullopt;
+		}
+
+		std::string
+		getMimeTypeFromImageFormat(std::string_view imageFormat)
+		{
+			std::string format {imageFormat};
+			std::transform(std::cbegin(format), std::cend(format), std::begin(format), [](unsigned char c) { return std::tolower(c); });
+
+			if (format == "jpg")
+				return "image/jpeg";
+
+			return "image/" + format;
+		}
+
+		// APIC (v2.3/v2.4) or PIC (v2.2) frame content
+		bool
+		parseID3PictureFrame(const std::byte* data, std::size_t size, bool isV22, const std::function<void(const Av::Picture&)>& func)
+		{
+			if (size < 1)
+				return false;
+
+			const std::byte encoding {data[0]};
+			const bool wideChars {encoding == std::byte {1} || encoding == std::byte {2}};
+
+			Av::Picture picture;
+			std::size_t offset {1};
+			if (isV22)
+			{
+				if (size < offset + 3)
+					return false;
+
+				picture.mimeType = getMimeTypeFromImageFormat(std::string_view {reinterpret_cast<const char*>(data + offset), 3});
+				offset += 3;
+			}
+			else
+			{
+				const std::optional<std::size_t> mimeTypeEnd {skipTerminatedString(data, size, offset, false)};
+				if (!mimeTypeEnd)
+					return false;
+
+				picture.mimeType.assign(reinterpret_cast<const char*>(data + offset), *mimeTypeEnd - offset - 1);
+				offset = *mimeTypeEnd;
+			}
+
+			offset += 1; // picture type
+			if (offset > size)
+				return false;
+
+			const std::optional<std::size_t> descriptionEnd {skipTerminatedString(data, size, offset, wideChars)};
+			if (!descriptionEnd || *descriptionEnd >= size)
+				return false;
+
+			picture.data = data + *descriptionEnd;
+			picture.dataSize = size - *descriptionEnd;
+			func(picture);
+
+			return true;
+		}
+
+		bool
+		parseID3Tag(std::ifstream& ifs, const Bytes& header, const std::function<void(const Av::Picture&)>& func)
+		{
+			const unsigned version {std::to_integer<unsigned>(header[3])};
+			const std::byte flags {header[5]};
+			const std::size_t tagSize {readSyncSafe(&header[6])};
+
+			if (version < 2 || version > 4 || tagSize > maxTagSize)
+				return false;
+
+			Bytes tag;
+			if (!readBytes(ifs, tagSize, tag))
+				return false;
+
+			const bool isV22 {version == 2};
+			if ((flags & std::byte {0x80}) != std::byte {0} && version < 4)
+				removeUnsynchronisation(tag);
+
+			std::size_t offset {};
+			if ((flags & std::byte {0x40}) != std::byte {0} && !isV22)
+			{
+				// extended header
+				if (tag.size() < 4)
+					return false;
+
+				offset = version == 3 ? 4 + readU32BE(&tag[0]) : readSyncSafe(&tag[0]);
+			}
+
+			const std::size_t frameHeaderSize {isV22 ? std::size_t {6} : std::size_t {10}};
+			while (offset + frameHeaderSize <= tag.size())
+			{
+				const std::byte* frameHeader {&tag[offset]};
+				if (frameHeader[0] == std::byte {0})
+					break; // padding
+
+				const std::string_view frameId {reinterpret_cast<const char*>(frameHeader), isV22 ? std::size_t {3} : std::size_t {4}};
+				std::size_t frameSize;
+				if (isV22)
+					frameSize = readU24BE(frameHeader + 3);
+				else if (version == 3)
+					frameSize = readU32BE(frameHeader + 4);
+				else
+					frameSize = readSyncSafe(frameHeader + 4);
+
+				offset += frameHeaderSize;
+				if (frameSize > tag.size() - offset)
+					return false;
+
+				if (frameId == (isV22 ? "PIC" : "APIC"))
+				{
+					const std::byte* frameData {&tag[offset]};
+					std::size_t frameDataSize {frameSize};
+					Bytes unsynchronisedFrameData;
+
+					if (!isV22)
+					{
+						const std::byte formatFlags {frameHeader[9]};
+						if (version == 3)
+						{
+							// compressed or encrypted
+							if ((formatFlags & std::byte {0xC0}) != std::byte {0})
+								return false;
+							if ((formatFlags & std::byte {0x20}) != std::byte {0})
+							{
+								// group identifier
+								frameData += 1;
+								frameDataSize -= std::min<std::size_t>(frameDataSize, 1);
+							}
+						}
+						else
+						{
+							// compressed or encrypted
+							if ((formatFlags & std::byte {0x0C}) != std::byte {0})
+								return false;
+
+							const std::size_t skippedSize {((formatFlags & std::byte {0x40}) != std::byte {0} ? std::size_t {1} : std::size_t {0}) // group identifier
+								+ ((formatFlags & std::byte {0x01}) != std::byte {0} ? std::size_t {4} : std::size_t {0})}; // data length indicator
+							if (skippedSize > frameDataSize)
+								return false;
+
+							frameData += skippedSize;
+							frameDataSize -= skippedSize;
+
+							if ((formatFlags & std::byte {0x02}) != std::byte {0} || (flags & std::byte {0x80}) != std::byte {0})
+							{
+								unsynchronisedFrameData.assign(frameData, frameData + frameDataSize);
+								removeUnsynchronisation(unsynchronisedFrameData);
+								frameData = unsynchronisedFrameData.data();
+								frameDataSize = unsynchronisedFrameData.size();
+							}
+						}
+					}
+
+					if (!parseID3PictureFrame(frameData, frameDataSize, isV22, func))
+						return false;
+				}
+
+				offset += frameSize;
+			}
+
+			// footer is only present for appended tags, no need to skip it
+			return true;
+		}
+
+		bool
+		parseFlacMetadata(std::ifstream& ifs, const std::function<void(const Av::Picture&)>& func)
+		{
+			constexpr unsigned pictureBlockType {6};
+
+			Bytes header;
+			Bytes block;
+			bool isLastBlock {};
+			while (!isLastBlock)
+			{
+				if (!readBytes(ifs, 4, header))
+					return false;
+
+				isLastBlock = (header[0] & std::byte {0x80}) != std::byte {0};
+				const unsigned blockType {std::to_integer<unsigned>(header[0] & std::byte {0x7F})};
+				const std::size_t blockSize {readU24BE(&header[1])};
+
+				if (blockType != pictureBlockType)
+				{
+					if (!ifs.seekg(blockSize, std::ios::cur))
+						return false;
+
+					continue;
+				}
+
+				if (!readBytes(ifs, blockSize, block))
+					return false;
+
+				// picture type, mime type, description, width, height, depth, colors, data
+				std::size_t offset {4};
+				auto readLength {[&]() -> std::optional<std::size_t>
+				{
+					if (offset + 4 > block.size())
+						return std::nullopt;
+
+					const std::size_t length {readU32BE(&block[offset])};
+					offset += 4;
+					if (length > block.size() - offset)
+						return std::nullopt;
+
+					return length;
+				}};
+
+				const std::optional<std::size_t> mimeTypeLength {readLength()};
+				if (!mimeTypeLength)
+					return false;
+
+				Av::Picture picture;
+				picture.mimeType.assign(reinterpret_cast<const char*>(&block[offset]), *mimeTypeLength);
+				offset += *mimeTypeLength;
+
+				const std::optional<std::size_t> descriptionLength {readLength()};
+				if (!descriptionLength)
+					return false;
+				offset += *descriptionLength + 16;
+
+				const std::optional<std::size_t> dataLength {readLength()};
+				if (!dataLength || *dataLength == 0)
+					return false;
+
+				picture.data = &block[offset];
+				picture.dataSize = *dataLength;
+				func(picture);
+			}
+
+			return true;
+		}
+	}
+
+	bool
+	visitEmbeddedPictures(const std::filesystem::path& path, std::function<void(const Av::Picture&)> func)
+	{
+		std::ifstream ifs {path, std::ios::in | std::ios::binary};
+		if (!ifs)
+			return false;
+
+		Bytes header;
+		if (!readBytes(ifs, 10, header))
+			return false;
+
+		if (startsWith(header, "ID3"))
+		{
+			if (!parseID3Tag(ifs, header, func))
+				return false;
+
+			// Some FLAC files have a leading ID3 tag
+			const std::size_t tagEnd {10 + readSyncSafe(&header[6])};
+			ifs.seekg(tagEnd);
+			if (!readBytes(ifs, 4, header) || !startsWith(header, "fLaC"))
+				return true;
+
+			return parseFlacMetadata(ifs, func);
+		}
+
+		if (startsWith(header, "fLaC"))
+		{
+			ifs.seekg(4);
+			return parseFlacMetadata(ifs, func);
+		}
+
+		return false;
+	}
+}
+
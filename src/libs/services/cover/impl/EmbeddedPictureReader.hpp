@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <functional>
+
+#include "av/IAudioFile.hpp"
+
+namespace Cover
+{
+	// Lightweight alternative to Av::parseAudioFile, only reading the tag blocks at the beginning of the file
+	// Handles ID3v2 APIC/PIC frames and FLAC PICTURE blocks
+	// Returns false if the file is not handled (other containers, unsupported or corrupted tags)
+	bool visitEmbeddedPictures(const std::filesystem::path& path, std::function<void(const Av::Picture&)> func);
+}
+
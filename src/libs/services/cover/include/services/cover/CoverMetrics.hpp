@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string_view>
+
+#include "utils/Metrics.hpp"
+
+// Time spent by the cover pipeline on the covers that are not found in any cache
+namespace Cover
+{
+	enum class CoverSource
+	{
+		Embedded,	// picture attached to an audio file
+		File,		// picture file
+		Cache,		// larger cover already in the cache
+	};
+
+	enum class CoverSourceFormat
+	{
+		JPEG,
+		PNG,
+		Other,
+	};
+
+	enum class ProcessingStage
+	{
+		Decode,
+		Resize,
+		Encode,
+	};
+
+	// Exported as 'lms_cover_processing_duration{source="...",format="...",stage="..."}'
+	Metrics::Histogram& getProcessingHistogram(CoverSource source, CoverSourceFormat sourceFormat, ProcessingStage stage);
+
+	std::string_view toString(CoverSource source);
+	std::string_view toString(CoverSourceFormat sourceFormat);
+	std::string_view toString(ProcessingStage stage);
+} // namespace Cover
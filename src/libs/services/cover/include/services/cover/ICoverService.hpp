@@ -21,6 +21,8 @@
 
 #include <filesystem>
 #include <memory>
+#include <string>
+#include <string_view>
 
 #include "services/database/ReleaseId.hpp"
 #include "services/database/TrackId.hpp"
@@ -38,14 +40,24 @@ namespace Cover
 		public:
 			virtual ~ICoverService() = default;
 
-			virtual std::shared_ptr<Image::IEncodedImage>	getFromTrack(Database::TrackId trackId, Image::ImageSize width) = 0;
-			virtual std::shared_ptr<Image::IEncodedImage>	getFromRelease(Database::ReleaseId releaseId, Image::ImageSize width) = 0;
+			// The width is snapped to the closest configured size bucket, so the returned image may be larger than requested: clients are expected to downscale it
+			virtual std::shared_ptr<Image::IEncodedImage>	getFromTrack(Database::TrackId trackId, Image::ImageSize width, Image::EncodingFormat format) = 0;
+			virtual std::shared_ptr<Image::IEncodedImage>	getFromRelease(Database::ReleaseId releaseId, Image::ImageSize width, Image::EncodingFormat format) = 0;
+
+			// Picture file or audio file to get the release cover from, without decoding anything (empty if none)
+			virtual std::filesystem::path findReleaseCoverPath(Database::ReleaseId releaseId) = 0;
 
 			virtual void flushCache() = 0;
 
 			virtual void setJpegQuality(unsigned quality) = 0; // from 1 to 100
 	};
 
+	// Best supported format for a request, given its HTTP Accept header
+	Image::EncodingFormat selectEncodingFormat(std::string_view acceptHeader);
+
+	// Strong HTTP entity tag (quoted) of an encoded cover, computed from its content
+	std::string computeEntityTag(const Image::IEncodedImage& image);
+
 	std::unique_ptr<ICoverService> createCoverService(Database::Db& db,
 										const std::filesystem::path& execPath,
 										const std::filesystem::path& defaultCoverPath);
@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "services/database/generator/LibraryGenerator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "services/database/Artist.hpp"
+#include "services/database/Cluster.hpp"
+#include "services/database/Db.hpp"
+#include "services/database/Directory.hpp"
+#include "services/database/Listen.hpp"
+#include "services/database/Release.hpp"
+#include "services/database/Session.hpp"
+#include "services/database/StarredArtist.hpp"
+#include "services/database/StarredRelease.hpp"
+#include "services/database/StarredTrack.hpp"
+#include "services/database/Track.hpp"
+#include "services/database/TrackArtistLink.hpp"
+#include "services/database/TrackFeatures.hpp"
+#include "services/database/TrackList.hpp"
+#include "services/database/User.hpp"
+#include "utils/Exception.hpp"
+#include "utils/UUID.hpp"
+
+namespace Database::Generator
+{
+	namespace
+	{
+		using RandGenerator = std::mt19937;
+
+		bool
+		isPicked(RandGenerator& randGenerator, unsigned percent)
+		{
+			return std::uniform_int_distribution<unsigned> {0, 99}(randGenerator) < percent;
+		}
+
+		template <typename T>
+		const T&
+		pickRandom(RandGenerator& randGenerator, const std::vector<T>& values)
+		{
+			return values[std::uniform_int_distribution<std::size_t> {0, values.size() - 1}(randGenerator)];
+		}
+
+		// Index in [0, count), the probability of index i is roughly proportional to 1/(i + 1)
+		std::size_t
+		pickPopular(RandGenerator& randGenerator, std::size_t count)
+		{
+			const double value {std::pow(static_cast<double>(count + 1), std::uniform_real_distribution<double> {0, 1}(randGenerator))};
+			return std::min(static_cast<std::size_t>(value) - 1, count - 1);
+		}
+
+		// Varies around the mean value, at least 1
+		std::size_t
+		pickCount(RandGenerator& randGenerator, std::size_t mean)
+		{
+			if (mean <= 1)
+				return 1;
+
+			return std::uniform_int_distribution<std::size_t> {(mean + 1) / 2, mean + mean / 2}(randGenerator);
+		}
+
+		std::optional<UUID>
+		generateMBID(RandGenerator& randGenerator, unsigned mbidPercent)
+		{
+			if (!isPicked(randGenerator, mbidPercent))
+				return std::nullopt;
+
+			std::uniform_int_distribution<unsigned> dist {0, 0xFFFF};
+			char str[37];
+			std::snprintf(str, sizeof(str), "%04x%04x-%04x-%04x-%04x-%04x%04x%04x", dist(randGenerator), dist(randGenerator), dist(randGenerator), dist(randGenerator), dist(randGenerator), dist(randGenerator), dist(randGenerator), dist(randGenerator));
+
+			return UUID::fromString(str);
+		}
+
+		// Same layout as the AcousticBrainz low level data
+		std::string
+		generateJsonEncodedFeatures(RandGenerator& randGenerator)
+		{
+			std::normal_distribution<double> dist {0, 1};
+
+			boost::property_tree::ptree root;
+			for (const FeatureDef& featureDef : TrackFeatures::getFeatureDefs())
+			{
+				if (featureDef.nbDimensions == 1)
+				{
+					root.put(featureDef.name, dist(randGenerator));
+					continue;
+				}
+
+				boost::property_tree::ptree values;
+				for (std::size_t i {}; i < featureDef.nbDimensions; ++i)
+				{
+					boost::property_tree::ptree value;
+					value.put("", dist(randGenerator));
+					values.push_back(std::make_pair("", value));
+				}
+				root.put_child(featureDef.name, values);
+			}
+
+			std::ostringstream oss;
+			boost::property_tree::write_json(oss, root, false);
+			return oss.str();
+		}
+
+		// Sparse file, so that large libraries do not need much disk space
+		void
+		createPlaceholderFile(const std::filesystem::path& path, std::uintmax_t size)
+		{
+			std::filesystem::create_directories(path.parent_path());
+			{
+				std::ofstream ofs {path, std::ios_base::binary | std::ios_base::trunc};
+				if (!ofs)
+					throw LmsException {"Cannot create file '" + path.string() + "'"};
+			}
+			std::filesystem::resize_file(path, size);
+		}
+
+		std::vector<Cluster::pointer>
+		createClusters(Session& session, std::string_view clusterTypeName, std::string_view namePrefix, std::size_t count)
+		{
+			std::vector<Cluster::pointer> res;
+
+			// Default cluster types may already exist
+			ClusterType::pointer clusterType {ClusterType::find(session, std::string {clusterTypeName})};
+			if (!clusterType)
+				clusterType = ClusterType::create(session, std::string {clusterTypeName});
+
+			for (std::size_t i {}; i < count; ++i)
+				res.push_back(Cluster::create(session, clusterType, std::string {namePrefix} + " " + std::to_string(i)));
+
+			return res;
+		}
+	}
+
+	Library
+	generateLibrary(Db& db, const LibraryParameters& parameters, const ProgressCallback& progressCallback)
+	{
+		RandGenerator randGenerator {parameters.seed};
+		Session& session {db.getTLSSession()};
+		Library library;
+
+		std::vector<Cluster::pointer> genres;
+		std::vector<Cluster::pointer> moods;
+		Directory::pointer rootDirectory;
+		{
+			auto transaction {session.createUniqueTransaction()};
+
+			genres = createClusters(session, "GENRE", "Genre", parameters.genreCount);
+			moods = createClusters(session, "MOOD", "Mood", parameters.moodCount);
+			rootDirectory = Directory::create(session, parameters.mediaDirectory);
+
+			for (std::size_t i {}; i < parameters.userCount; ++i)
+				library.userIds.push_back(User::create(session, "user-" + std::to_string(i))->getId());
+		}
+
+		const Wt::WDateTime now {Wt::WDateTime::currentDateTime()};
+		for (std::size_t artistIndex {}; artistIndex < parameters.artistCount; ++artistIndex)
+		{
+			// one transaction per artist to keep the memory usage low
+			auto transaction {session.createUniqueTransaction()};
+
+			std::vector<User::pointer> users;
+			for (const UserId userId : library.userIds)
+				users.push_back(User::find(session, userId));
+
+			const Artist::pointer artist {Artist::create(session, "Artist " + std::to_string(artistIndex), generateMBID(randGenerator, parameters.mbidPercent))};
+			library.artistIds.push_back(artist->getId());
+			for (const User::pointer& user : users)
+			{
+				if (isPicked(randGenerator, parameters.starredPercent))
+					StarredArtist::create(session, artist, user, Scrobbler::Internal);
+			}
+
+			const std::filesystem::path artistPath {parameters.mediaDirectory / artist->getName()};
+			const Directory::pointer artistDirectory {Directory::create(session, artistPath, rootDirectory)};
+
+			const std::size_t releaseCount {pickCount(randGenerator, parameters.releasesPerArtist)};
+			for (std::size_t releaseIndex {}; releaseIndex < releaseCount; ++releaseIndex)
+			{
+				const std::string releaseName {"Release " + std::to_string(artistIndex) + "-" + std::to_string(releaseIndex)};
+				const Release::pointer release {Release::create(session, releaseName, generateMBID(randGenerator, parameters.mbidPercent))};
+				library.releaseIds.push_back(release->getId());
+				for (const User::pointer& user : users)
+				{
+					if (isPicked(randGenerator, parameters.starredPercent))
+						StarredRelease::create(session, release, user, Scrobbler::Internal);
+				}
+
+				const std::filesystem::path releasePath {artistPath / releaseName};
+				const Directory::pointer releaseDirectory {Directory::create(session, releasePath, artistDirectory)};
+
+				const std::size_t releaseNumber {library.releaseIds.size() - 1};
+				const Wt::WDateTime addedTime {now.addSecs(-static_cast<int>(releaseNumber) * 3600)};
+				const Wt::WDate date {1960 + static_cast<int>(releaseNumber % 60), 1, 1};
+
+				// One or two genres per release, and sometimes a mood per track
+				std::vector<Cluster::pointer> releaseClusters;
+				if (!genres.empty())
+				{
+					releaseClusters.push_back(genres[pickPopular(randGenerator, genres.size())]);
+					if (isPicked(randGenerator, 30))
+						releaseClusters.push_back(pickRandom(randGenerator, genres));
+				}
+
+				const std::size_t trackCount {pickCount(randGenerator, parameters.tracksPerRelease)};
+				for (std::size_t trackIndex {}; trackIndex < trackCount; ++trackIndex)
+				{
+					const std::filesystem::path trackPath {releasePath / ("track-" + std::to_string(trackIndex) + ".mp3")};
+					const std::chrono::seconds duration {std::uniform_int_distribution<long> {120, 420}(randGenerator)};
+					constexpr std::size_t bitrate {320000};
+
+					Track::pointer track {Track::create(session, trackPath)};
+					track.modify()->setName("Track " + std::to_string(artistIndex) + "-" + std::to_string(releaseIndex) + "-" + std::to_string(trackIndex));
+					track.modify()->setTrackNumber(static_cast<int>(trackIndex) + 1);
+					track.modify()->setTotalTrack(static_cast<int>(trackCount));
+					track.modify()->setDiscNumber(1);
+					track.modify()->setDuration(duration);
+					track.modify()->setBitrate(bitrate);
+					track.modify()->setAudioCodec(AudioCodec::MP3);
+					track.modify()->setDate(date);
+					track.modify()->setLastWriteTime(addedTime);
+					track.modify()->setAddedTime(addedTime);
+					track.modify()->setRecordingMBID(generateMBID(randGenerator, parameters.mbidPercent));
+					track.modify()->setRelease(release);
+					track.modify()->setPath(releaseDirectory, trackPath.filename());
+
+					std::vector<Cluster::pointer> clusters {releaseClusters};
+					if (!moods.empty() && isPicked(randGenerator, 50))
+						clusters.push_back(pickRandom(randGenerator, moods));
+					track.modify()->setClusters(clusters);
+
+					TrackArtistLink::create(session, track, artist, TrackArtistLinkType::Artist);
+					TrackArtistLink::create(session, track, artist, TrackArtistLinkType::ReleaseArtist);
+
+					// Other artists are only picked among the ones that have already been generated
+					if (artistIndex > 0 && isPicked(randGenerator, parameters.multiArtistTrackPercent))
+					{
+						const Artist::pointer otherArtist {Artist::find(session, library.artistIds[pickPopular(randGenerator, artistIndex)])};
+						const TrackArtistLinkType linkType {isPicked(randGenerator, 70) ? TrackArtistLinkType::Artist : pickRandom(randGenerator, std::vector {TrackArtistLinkType::Composer, TrackArtistLinkType::Producer, TrackArtistLinkType::Remixer})};
+						TrackArtistLink::create(session, track, otherArtist, linkType);
+					}
+
+					if (isPicked(randGenerator, parameters.trackFeaturesPercent))
+						TrackFeatures::create(session, track, generateJsonEncodedFeatures(randGenerator));
+
+					library.trackIds.push_back(track->getId());
+					for (const User::pointer& user : users)
+					{
+						if (isPicked(randGenerator, parameters.starredPercent))
+							StarredTrack::create(session, track, user, Scrobbler::Internal);
+					}
+
+					if (parameters.createFiles)
+						createPlaceholderFile(trackPath, static_cast<std::uintmax_t>(duration.count()) * bitrate / 8);
+				}
+			}
+
+			if (progressCallback)
+				progressCallback(artistIndex + 1);
+		}
+
+		if (library.trackIds.empty())
+			return library;
+
+		// Popular tracks are spread over the whole library
+		std::vector<TrackId> tracksByPopularity {library.trackIds};
+		std::shuffle(std::begin(tracksByPopularity), std::end(tracksByPopularity), randGenerator);
+
+		for (const UserId userId : library.userIds)
+		{
+			{
+				auto transaction {session.createUniqueTransaction()};
+
+				const User::pointer user {User::find(session, userId)};
+				for (std::size_t i {}; i < parameters.listensPerUser; ++i)
+				{
+					const Track::pointer track {Track::find(session, tracksByPopularity[pickPopular(randGenerator, tracksByPopularity.size())])};
+					const Wt::WDateTime dateTime {now.addSecs(-static_cast<int>((parameters.listensPerUser - i) * 600))};
+					Listen::create(session, user, track, Scrobbler::Internal, dateTime);
+				}
+			}
+
+			for (std::size_t playlistIndex {}; playlistIndex < parameters.playlistsPerUser; ++playlistIndex)
+			{
+				auto transaction {session.createUniqueTransaction()};
+
+				const User::pointer user {User::find(session, userId)};
+				const TrackList::pointer trackList {TrackList::create(session, "Playlist " + std::to_string(playlistIndex), TrackList::Type::Playlist, isPicked(randGenerator, 50), user)};
+				library.trackListIds.push_back(trackList->getId());
+
+				std::vector<TrackId> trackIds;
+				for (std::size_t i {}; i < parameters.tracksPerPlaylist; ++i)
+					trackIds.push_back(pickRandom(randGenerator, library.trackIds));
+				TrackListEntry::create(session, trackIds, trackList);
+			}
+		}
+
+		return library;
+	}
+} // namespace Database::Generator
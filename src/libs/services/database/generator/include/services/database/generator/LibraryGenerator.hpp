@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+#include "services/database/ArtistId.hpp"
+#include "services/database/ReleaseId.hpp"
+#include "services/database/TrackId.hpp"
+#include "services/database/TrackListId.hpp"
+#include "services/database/UserId.hpp"
+
+namespace Database
+{
+	class Db;
+}
+
+// Fills a database with a synthetic library, to be shared by the benchmarks and load tests
+// Same parameters and seed give the same library
+namespace Database::Generator
+{
+	struct LibraryParameters
+	{
+		std::size_t		artistCount {100};
+		std::size_t		releasesPerArtist {4};		// mean value
+		std::size_t		tracksPerRelease {10};		// mean value
+		unsigned		multiArtistTrackPercent {15};	// tracks with featured artists, composers, etc.
+		unsigned		mbidPercent {80};			// artists, releases and tracks that have a MusicBrainz id
+		std::size_t		genreCount {30};
+		std::size_t		moodCount {10};
+		std::size_t		userCount {1};
+		unsigned		starredPercent {5};			// starred artists, releases and tracks, per user
+		std::size_t		listensPerUser {1000};		// some tracks are much more listened than others
+		std::size_t		playlistsPerUser {5};
+		std::size_t		tracksPerPlaylist {50};
+		unsigned		trackFeaturesPercent {0};	// tracks that have features (used by the recommendation engine)
+		std::filesystem::path	mediaDirectory {"/lms-synthetic"};
+		bool			createFiles {};				// create sparse placeholder files (not actual audio) for the tracks
+		std::uint_fast32_t	seed {42};
+	};
+
+	struct Library
+	{
+		std::vector<UserId>			userIds;
+		std::vector<ArtistId>		artistIds;
+		std::vector<ReleaseId>		releaseIds;
+		std::vector<TrackId>		trackIds;
+		std::vector<TrackListId>	trackListIds;
+	};
+
+	// Called after each generated artist
+	using ProgressCallback = std::function<void(std::size_t generatedArtistCount)>;
+
+	// Users are named "user-<index>", tables must already be prepared
+	Library generateLibrary(Db& db, const LibraryParameters& parameters, const ProgressCallback& progressCallback = {});
+} // namespace Database::Generator
@@ -18,24 +18,43 @@
  */
 #include "services/database/Artist.hpp"
 
+#include <limits>
+
 #include <Wt/Dbo/WtSqlTraits.h>
 
 #include "services/database/Cluster.hpp"
+#include "services/database/Db.hpp"
 #include "services/database/Release.hpp"
 #include "services/database/Session.hpp"
 #include "services/database/Track.hpp"
 #include "services/database/User.hpp"
 #include "utils/Logger.hpp"
+#include "utils/String.hpp"
 #include "SqlQuery.hpp"
 #include "Utils.hpp"
 #include "IdTypeTraits.hpp"
+#include "LibraryIndex.hpp"
 
 namespace Database
 {
 
+namespace
+{
+	// link type used to store the summaries of any link type
+	constexpr int anyLinkTypeSummary {-1};
+
+	int
+	getSummaryLinkType(std::optional<TrackArtistLinkType> linkType)
+	{
+		return linkType ? static_cast<int>(*linkType) : anyLinkTypeSummary;
+	}
+}
+
 Artist::Artist(const std::string& name, const std::optional<UUID>& MBID)
 : _name {std::string(name, 0 , _maxNameLength)},
 _sortName {_name},
+_nameSortKey {StringUtils::computeSortKey(_name)},
+_sortNameSortKey {_nameSortKey},
 _MBID {MBID ? MBID->getAsString() : ""}
 {
 }
@@ -74,6 +93,15 @@ Artist::find(Session& session, ArtistId id)
 	return session.getDboSession().find<Artist>().where("id = ?").bind(id).resultValue();
 }
 
+std::vector<Artist::pointer>
+Artist::find(Session& session, const std::vector<ArtistId>& ids)
+{
+	session.checkSharedLocked();
+
+	const auto artists {loadByIds<Artist>(session.getDboSession(), ids)};
+	return std::vector<Artist::pointer>(std::cbegin(artists), std::cend(artists));
+}
+
 bool
 Artist::exists(Session& session, ArtistId id)
 {
@@ -81,6 +109,46 @@ Artist::exists(Session& session, ArtistId id)
 	return session.getDboSession().query<int>("SELECT 1 FROM artist").where("id = ?").bind(id).resultValue() == 1;
 }
 
+std::unordered_map<ArtistId, Artist::Summary>
+Artist::getSummaries(Session& session, std::optional<TrackArtistLinkType> linkType)
+{
+	session.checkSharedLocked();
+
+	auto query {session.getDboSession().query<std::tuple<ArtistId, int, int>>("SELECT artist_id, release_count, track_count FROM artist_summary")
+		.where("link_type = ?").bind(getSummaryLinkType(linkType))};
+
+	std::unordered_map<ArtistId, Summary> res;
+	for (const auto& [artistId, releaseCount, trackCount] : query.resultList())
+		res.emplace(artistId, Summary {static_cast<std::size_t>(releaseCount), static_cast<std::size_t>(trackCount)});
+
+	return res;
+}
+
+std::size_t
+Artist::updateSummaries(Session& session, std::size_t maxCount)
+{
+	session.checkUniqueLocked();
+
+	// Make sure pending changes are written before bypassing Dbo
+	session.getDboSession().flush();
+
+	// the artists whose tracks changed are tracked using triggers (see Session::prepareTables)
+	const int limit {static_cast<int>(std::min<std::size_t>(maxCount, std::numeric_limits<int>::max()))};
+	const std::string changedArtists {"SELECT artist_id FROM artist_summary_dirty ORDER BY artist_id LIMIT ?"};
+	const std::string countSelect {"COUNT(DISTINCT t.release_id), COUNT(DISTINCT t.id) FROM track_artist_link t_a_l INNER JOIN track t ON t.id = t_a_l.track_id"
+		" WHERE t_a_l.artist_id IN (" + changedArtists + ")"};
+
+	session.getDboSession().execute("DELETE FROM artist_summary WHERE artist_id IN (" + changedArtists + ")").bind(limit);
+	session.getDboSession().execute("INSERT INTO artist_summary(artist_id, link_type, release_count, track_count)"
+			" SELECT t_a_l.artist_id, t_a_l.type, " + countSelect + " GROUP BY t_a_l.artist_id, t_a_l.type"
+			" UNION ALL SELECT t_a_l.artist_id, " + std::to_string(anyLinkTypeSummary) + ", " + countSelect + " GROUP BY t_a_l.artist_id")
+		.bind(limit)
+		.bind(limit);
+	session.getDboSession().execute("DELETE FROM artist_summary_dirty WHERE artist_id IN (" + changedArtists + ")").bind(limit);
+
+	return session.getDboSession().query<int>("SELECT changes()");
+}
+
 Artist::pointer
 Artist::create(Session& session, const std::string& name, const std::optional<UUID>& MBID)
 {
@@ -117,16 +185,10 @@ createQuery(Session& session, const Artist::FindParameters& params)
 		std::vector<std::string> sortClauses;
 
 		for (std::string_view keyword : params.keywords)
-		{
-			clauses.push_back("a.name LIKE ? ESCAPE '" ESCAPE_CHAR_STR "'");
-			query.bind("%" + escapeLikeKeyword(keyword) + "%");
-		}
+			clauses.push_back(bindKeywordClause(session, query, "artist", "a", "name", keyword));
 
 		for (std::string_view keyword : params.keywords)
-		{
-			sortClauses.push_back("a.sort_name LIKE ? ESCAPE '" ESCAPE_CHAR_STR "'");
-			query.bind("%" + escapeLikeKeyword(keyword) + "%");
-		}
+			sortClauses.push_back(bindKeywordClause(session, query, "artist", "a", "sort_name", keyword));
 
 		query.where("(" + StringUtils::joinStrings(clauses, " AND ") + ") OR (" + StringUtils::joinStrings(sortClauses, " AND ") + ")");
 	}
@@ -166,10 +228,10 @@ createQuery(Session& session, const Artist::FindParameters& params)
 		case ArtistSortMethod::None:
 			break;
 		case ArtistSortMethod::ByName:
-			query.orderBy("a.name COLLATE NOCASE");
+			query.orderBy("a.name_sort_key");
 			break;
 		case ArtistSortMethod::BySortName:
-			query.orderBy("a.sort_name COLLATE NOCASE");
+			query.orderBy("a.sort_name_sort_key");
 			break;
 		case ArtistSortMethod::Random:
 			query.orderBy("RANDOM()");
@@ -195,11 +257,49 @@ Artist::findAllOrphans(Session& session, Range range)
 	return execQuery(query, range);
 }
 
+std::size_t
+Artist::getOrphanCount(Session& session)
+{
+	session.checkSharedLocked();
+
+	return session.getDboSession().query<int>("SELECT COUNT(*) FROM artist a WHERE NOT EXISTS(SELECT 1 FROM track t INNER JOIN track_artist_link t_a_l ON t_a_l.artist_id = a.id WHERE t.id = t_a_l.track_id)");
+}
+
+std::size_t
+Artist::removeOrphans(Session& session, std::size_t maxCount)
+{
+	session.checkUniqueLocked();
+
+	// Make sure pending changes are written before bypassing Dbo
+	session.getDboSession().flush();
+
+	session.getDboSession().execute("DELETE FROM artist WHERE id IN (SELECT a.id FROM artist a WHERE NOT EXISTS(SELECT 1 FROM track t INNER JOIN track_artist_link t_a_l ON t_a_l.artist_id = a.id WHERE t.id = t_a_l.track_id) LIMIT ?)")
+		.bind(static_cast<int>(maxCount));
+
+	return session.getDboSession().query<int>("SELECT changes()");
+}
+
 RangeResults<ArtistId>
 Artist::find(Session& session, const FindParameters& params)
 {
 	session.checkSharedLocked();
 
+	if (const std::shared_ptr<const LibraryIndex> libraryIndex {session.getDb().getLibraryIndex()})
+	{
+		if (auto res {libraryIndex->find(params)})
+			return *res;
+	}
+
+	if (params.sortMethod == ArtistSortMethod::Random)
+	{
+		FindParameters unsortedParams {params};
+		unsortedParams.setSortMethod(ArtistSortMethod::None);
+
+		auto query {createQuery(session, unsortedParams)};
+		if (auto res {findRandomIds(session.getDboSession(), query, "artist", "a.id", params.range)})
+			return *res;
+	}
+
 	auto query {createQuery(session, params)};
 	return execQuery(query, params.range);
 }
@@ -234,7 +334,7 @@ Artist::getReleases(const std::vector<ClusterId>& clusterIds) const
 	if (!clusterIds.empty())
 		oss << " GROUP BY t.id HAVING COUNT(DISTINCT c.id) = " << clusterIds.size();
 
-	oss << " ORDER BY t.date DESC, r.name COLLATE NOCASE";
+	oss << " ORDER BY t.date DESC, r.name_sort_key";
 
 	auto query {session()->query<Wt::Dbo::ptr<Release>>(oss.str())};
 
@@ -255,6 +355,20 @@ Artist::getReleaseCount() const
 	return res;
 }
 
+Artist::Summary
+Artist::getSummary(std::optional<TrackArtistLinkType> linkType) const
+{
+	assert(session());
+
+	// No summary if the artist has no track with this link type
+	auto query {session()->query<std::tuple<int, int>>("SELECT COALESCE(MAX(release_count), 0), COALESCE(MAX(track_count), 0) FROM artist_summary")
+		.where("artist_id = ?").bind(getId())
+		.where("link_type = ?").bind(getSummaryLinkType(linkType))};
+	const auto [releaseCount, trackCount] {query.resultValue()};
+
+	return Summary {static_cast<std::size_t>(releaseCount), static_cast<std::size_t>(trackCount)};
+}
+
 std::vector<Track::pointer>
 Artist::getTracks(std::optional<TrackArtistLinkType> linkType) const
 {
@@ -402,10 +516,18 @@ Artist::getClusterGroups(std::vector<ClusterType::pointer> clusterTypes, std::si
 	return res;
 }
 
+void
+Artist::setName(std::string_view name)
+{
+	_name = name;
+	_nameSortKey = StringUtils::computeSortKey(_name);
+}
+
 void
 Artist::setSortName(const std::string& sortName)
 {
 	_sortName = std::string(sortName, 0 , _maxNameLength);
+	_sortNameSortKey = StringUtils::computeSortKey(_sortName);
 }
 
 } // namespace Database
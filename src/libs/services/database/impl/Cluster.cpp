@@ -73,6 +73,28 @@ Cluster::findOrphans(Session& session, Range range)
 	return execQuery(query, range);
 }
 
+std::size_t
+Cluster::getOrphanCount(Session& session)
+{
+	session.checkSharedLocked();
+
+	return session.getDboSession().query<int>("SELECT COUNT(*) FROM cluster c WHERE NOT EXISTS(SELECT 1 FROM track_cluster t_c WHERE t_c.cluster_id = c.id)");
+}
+
+std::size_t
+Cluster::removeOrphans(Session& session, std::size_t maxCount)
+{
+	session.checkUniqueLocked();
+
+	// Make sure pending changes are written before bypassing Dbo
+	session.getDboSession().flush();
+
+	session.getDboSession().execute("DELETE FROM cluster WHERE id IN (SELECT c.id FROM cluster c WHERE NOT EXISTS(SELECT 1 FROM track_cluster t_c WHERE t_c.cluster_id = c.id) LIMIT ?)")
+		.bind(static_cast<int>(maxCount));
+
+	return session.getDboSession().query<int>("SELECT changes()");
+}
+
 Cluster::pointer
 Cluster::find(Session& session, ClusterId id)
 {
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "services/database/ClusterCatalog.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+#include <unordered_map>
+
+#include "services/database/Db.hpp"
+#include "services/database/Session.hpp"
+#include "utils/Logger.hpp"
+#include "IdTypeTraits.hpp"
+
+namespace Database
+{
+	std::unique_ptr<ClusterCatalog>
+	ClusterCatalog::build(Session& session)
+	{
+		session.checkSharedLocked();
+
+		const auto start {std::chrono::steady_clock::now()};
+
+		std::unique_ptr<ClusterCatalog> catalog {new ClusterCatalog};
+
+		std::unordered_map<ClusterId, std::size_t> releaseCounts;
+		{
+			const auto rows {session.getDboSession().query<std::tuple<ClusterId, int>>("SELECT t_c.cluster_id, COUNT(DISTINCT t.release_id) FROM track_cluster t_c INNER JOIN track t ON t.id = t_c.track_id")
+				.where("t.release_id IS NOT NULL")
+				.groupBy("t_c.cluster_id")
+				.resultList()};
+			for (const auto& [clusterId, releaseCount] : rows)
+				releaseCounts.emplace(clusterId, releaseCount);
+		}
+
+		std::unordered_map<ClusterTypeId, std::size_t> clusterTypeIndexes;
+		{
+			const auto rows {session.getDboSession().query<std::tuple<ClusterTypeId, std::string>>("SELECT id, name FROM cluster_type")
+				.orderBy("id")
+				.resultList()};
+			for (const auto& [clusterTypeId, name] : rows)
+			{
+				clusterTypeIndexes.emplace(clusterTypeId, catalog->_clusterTypes.size());
+				catalog->_clusterTypes.push_back(ClusterType {clusterTypeId, name, {}});
+			}
+		}
+
+		std::size_t clusterCount {};
+		{
+			// Same order as ClusterType::getClusters
+			const auto rows {session.getDboSession().query<std::tuple<ClusterId, ClusterTypeId, std::string, int>>("SELECT c.id, c.cluster_type_id, c.name, (SELECT COUNT(*) FROM track_cluster t_c WHERE t_c.cluster_id = c.id) FROM cluster c")
+				.orderBy("c.name")
+				.resultList()};
+			for (const auto& [clusterId, clusterTypeId, name, trackCount] : rows)
+			{
+				auto itClusterTypeIndex {clusterTypeIndexes.find(clusterTypeId)};
+				if (itClusterTypeIndex == std::cend(clusterTypeIndexes))
+					continue;
+
+				auto itReleaseCount {releaseCounts.find(clusterId)};
+				const std::size_t releaseCount {itReleaseCount != std::cend(releaseCounts) ? itReleaseCount->second : 0};
+
+				catalog->_clusterTypes[itClusterTypeIndex->second].clusters.push_back(Cluster {clusterId, name, static_cast<std::size_t>(trackCount), releaseCount});
+				clusterCount++;
+			}
+		}
+
+		// Same as ClusterType::findUsed
+		catalog->_clusterTypes.erase(std::remove_if(std::begin(catalog->_clusterTypes), std::end(catalog->_clusterTypes), [](const ClusterType& clusterType) { return clusterType.clusters.empty(); }), std::end(catalog->_clusterTypes));
+
+		LMS_LOG(DB, DEBUG) << "Cluster catalog built in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms ("
+			<< catalog->_clusterTypes.size() << " types, " << clusterCount << " clusters)";
+
+		return catalog;
+	}
+
+	std::shared_ptr<const ClusterCatalog>
+	ClusterCatalog::get(Session& session)
+	{
+		if (std::shared_ptr<const ClusterCatalog> catalog {session.getDb().getClusterCatalog()})
+			return catalog;
+
+		auto transaction {session.createSharedTransaction()};
+		return build(session);
+	}
+
+	const ClusterCatalog::ClusterType*
+	ClusterCatalog::findClusterType(std::string_view name) const
+	{
+		auto it {std::find_if(std::cbegin(_clusterTypes), std::cend(_clusterTypes), [&](const ClusterType& clusterType) { return clusterType.name == name; })};
+		return it != std::cend(_clusterTypes) ? &(*it) : nullptr;
+	}
+
+	const ClusterCatalog::Cluster*
+	ClusterCatalog::findCluster(std::string_view typeName, std::string_view name) const
+	{
+		const ClusterType* clusterType {findClusterType(typeName)};
+		if (!clusterType)
+			return nullptr;
+
+		auto it {std::find_if(std::cbegin(clusterType->clusters), std::cend(clusterType->clusters), [&](const Cluster& cluster) { return cluster.name == name; })};
+		return it != std::cend(clusterType->clusters) ? &(*it) : nullptr;
+	}
+} // namespace Database
@@ -19,29 +19,259 @@
 
 #include "services/database/Db.hpp"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#ifdef LMS_SUPPORT_SQLITE3_API
+#include <sqlite3.h>
+#endif // LMS_SUPPORT_SQLITE3_API
 #include <Wt/Dbo/FixedSqlConnectionPool.h>
 #include <Wt/Dbo/backend/Sqlite3.h>
 
+#include "services/database/ClusterCatalog.hpp"
 #include "services/database/Session.hpp"
 #include "services/database/User.hpp"
+#include "utils/Exception.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+
+#include "DbBackupRunner.hpp"
+#include "DbStatsCollector.hpp"
+#include "LibraryIndex.hpp"
 
 namespace Database {
 
+namespace
+{
+	// Connection pragmas are not persistent: make sure all the connections cloned by the pool get them
+	class Connection : public Wt::Dbo::backend::Sqlite3
+	{
+		public:
+			Connection(const std::filesystem::path& dbPath, const ConnectionSettings& settings)
+				: Wt::Dbo::backend::Sqlite3 {dbPath.string()}
+				, _settings {settings}
+			{
+				prepare();
+			}
+
+			Connection(const Connection& other)
+				: Wt::Dbo::backend::Sqlite3 {other}
+				, _settings {other._settings}
+				, _statsCollector {other._statsCollector}
+			{
+				prepare();
+			}
+
+			Connection(Connection&&) = delete;
+			Connection& operator=(const Connection&) = delete;
+			Connection& operator=(Connection&&) = delete;
+
+			std::unique_ptr<Wt::Dbo::SqlConnection> clone() const override
+			{
+				return std::make_unique<Connection>(*this);
+			}
+
+#ifdef LMS_SUPPORT_SQLITE3_API
+			// To be called before the connection is cloned, and only if the SQLite3 API is usable
+			void enableStats(DbStatsCollector* statsCollector)
+			{
+				_statsCollector = statsCollector;
+				enableTracing();
+			}
+#endif // LMS_SUPPORT_SQLITE3_API
+
+			std::unique_ptr<Wt::Dbo::SqlStatement> prepareStatement(const std::string& sql) override
+			{
+				_preparedStatementCount++;
+				return Wt::Dbo::backend::Sqlite3::prepareStatement(sql);
+			}
+
+			void startTransaction() override
+			{
+				// Queries built on the fly give many different statements, each of them cached for the connection lifetime
+				// No statement is in use between transactions: safe to drop them all
+				if (_settings.maxCachedStatementCount && _preparedStatementCount > *_settings.maxCachedStatementCount)
+				{
+					clearStatementCache();
+					_preparedStatementCount = 0;
+
+					static Metrics::Counter& statementCacheClears {Metrics::getRegistry().createCounter("lms_db_statement_cache_clears", "Number of times a connection dropped its cached statements")};
+					statementCacheClears.add();
+				}
+
+				Wt::Dbo::backend::Sqlite3::startTransaction();
+			}
+
+		private:
+			void prepare()
+			{
+//				setProperty("show-queries", "true");
+				executeSql("pragma synchronous=normal");
+				// Wait for other processes (tools, etc.) instead of failing while they write
+				executeSql("pragma busy_timeout=" + std::to_string(busyTimeout.count()));
+
+				if (_settings.cacheSize)
+					executeSql("pragma cache_size=" + std::to_string(*_settings.cacheSize));
+				if (_settings.mmapSize)
+					executeSql("pragma mmap_size=" + std::to_string(*_settings.mmapSize));
+				if (_settings.tempStoreMemory)
+					executeSql("pragma temp_store=memory");
+				if (_settings.walAutoCheckpoint)
+					executeSql("pragma wal_autocheckpoint=" + std::to_string(*_settings.walAutoCheckpoint));
+
+#ifdef LMS_SUPPORT_SQLITE3_API
+				// No tracing at all if stats are disabled
+				if (_statsCollector)
+					enableTracing();
+#endif // LMS_SUPPORT_SQLITE3_API
+			}
+
+#ifdef LMS_SUPPORT_SQLITE3_API
+			void enableTracing()
+			{
+				sqlite3_trace_v2(connection(), SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW, &Connection::onTrace, this);
+			}
+
+			// Called by the thread using the connection, once per row and once the statement is done
+			static int onTrace(unsigned type, void* context, void* p, void* x)
+			{
+				Connection& connection {*static_cast<Connection*>(context)};
+				sqlite3_stmt* statement {static_cast<sqlite3_stmt*>(p)};
+
+				switch (type)
+				{
+					case SQLITE_TRACE_ROW:
+						connection._pendingRowCounts[statement]++;
+						break;
+
+					case SQLITE_TRACE_PROFILE:
+					{
+						std::size_t rowCount {};
+						if (auto itRowCount {connection._pendingRowCounts.find(statement)}; itRowCount != std::end(connection._pendingRowCounts))
+						{
+							rowCount = itRowCount->second;
+							connection._pendingRowCounts.erase(itRowCount);
+						}
+
+						const std::chrono::nanoseconds duration {*static_cast<const sqlite3_int64*>(x)};
+						connection._statsCollector->addQuery(sqlite3_sql(statement), duration, rowCount);
+
+						static Metrics::Histogram& queryDurations {Metrics::getRegistry().createHistogram("lms_db_query_duration_seconds", "Duration of the database queries (only if db-stats is enabled)")};
+						queryDurations.observe(std::chrono::duration_cast<Metrics::Histogram::Duration>(duration));
+						break;
+					}
+				}
+
+				return 0;
+			}
+#endif // LMS_SUPPORT_SQLITE3_API
+
+			static constexpr std::chrono::milliseconds busyTimeout {10'000};
+			const ConnectionSettings _settings;
+			DbStatsCollector* _statsCollector {};
+#ifdef LMS_SUPPORT_SQLITE3_API
+			std::unordered_map<sqlite3_stmt*, std::size_t> _pendingRowCounts;
+#endif // LMS_SUPPORT_SQLITE3_API
+			std::size_t _preparedStatementCount {}; // upper bound of the cached statement count
+	};
+
+	long long
+	queryPragmaValue(Wt::Dbo::SqlConnection& connection, const std::string& pragma)
+	{
+		std::unique_ptr<Wt::Dbo::SqlStatement> statement {connection.prepareStatement("pragma " + pragma)};
+		statement->execute();
+
+		// Steps until done (one page is removed per step for incremental_vacuum), last row wins
+		long long value {};
+		while (statement->nextRow())
+		{
+			long long rowValue;
+			if (statement->getResult(0, &rowValue))
+				value = rowValue;
+		}
+
+		return value;
+	}
+
+	// Connection handles are given to the SQLite library LMS is linked with: Wt::Dbo must use the very same library
+	bool
+	checkSQLiteApiUsable([[maybe_unused]] Wt::Dbo::SqlConnection& connection)
+	{
+#ifdef LMS_SUPPORT_SQLITE3_API
+		std::unique_ptr<Wt::Dbo::SqlStatement> statement {connection.prepareStatement("select sqlite_version()")};
+		statement->execute();
+
+		std::string dboVersion;
+		if (!statement->nextRow() || !statement->getResult(0, &dboVersion, 32))
+			return false;
+
+		if (dboVersion != sqlite3_libversion())
+		{
+			LMS_LOG(DB, ERROR) << "Wt::Dbo uses SQLite " << dboVersion << " but LMS is linked against SQLite " << sqlite3_libversion() << ": database stats and backups disabled";
+			return false;
+		}
+
+		return true;
+#else
+		return false;
+#endif // LMS_SUPPORT_SQLITE3_API
+	}
+
+	// Full text indexes use the trigram tokenizer: FTS5, SQLite 3.34.0 and later
+	bool
+	checkFullTextIndexUsable(Wt::Dbo::SqlConnection& connection)
+	{
+		try
+		{
+			connection.executeSql("CREATE VIRTUAL TABLE temp.fts_check USING fts5(value, tokenize='trigram')");
+			connection.executeSql("DROP TABLE temp.fts_check");
+			return true;
+		}
+		catch (const Wt::Dbo::Exception& e)
+		{
+			LMS_LOG(DB, WARNING) << "Full text indexes not supported (SQLite 3.34.0 or later built with FTS5 is required), keyword searches will be slower: " << e.what();
+			return false;
+		}
+	}
+}
+
 // Session living class handling the database and the login
-Db::Db(const std::filesystem::path& dbPath, std::size_t connectionCount)
+Db::Db(const std::filesystem::path& dbPath, std::size_t connectionCount, ConcurrencyMode concurrencyMode, const ConnectionSettings& connectionSettings)
+: _dbPath {dbPath}
+, _concurrencyMode {concurrencyMode}
 {
-	LMS_LOG(DB, INFO) << "Creating connection pool on file " << dbPath.string();
+	LMS_LOG(DB, INFO) << "Creating connection pool on file " << dbPath.string() << " (" << connectionCount << " connections" << (_concurrencyMode == ConcurrencyMode::SQLite ? ", SQLite concurrency mode" : "") << ")";
 
-	std::unique_ptr<Wt::Dbo::backend::Sqlite3> connection {std::make_unique<Wt::Dbo::backend::Sqlite3>(dbPath.string())};
-//	connection->setProperty("show-queries", "true");
+	std::unique_ptr<Connection> connection {std::make_unique<Connection>(dbPath, connectionSettings)};
 	connection->executeSql("pragma journal_mode=WAL");
-	connection->executeSql("pragma synchronous=normal");
+
+	_sqliteApiUsable = checkSQLiteApiUsable(*connection);
+	_fullTextIndexUsable = checkFullTextIndexUsable(*connection);
+	if (connectionSettings.collectStats)
+	{
+#ifdef LMS_SUPPORT_SQLITE3_API
+		if (_sqliteApiUsable)
+		{
+			_statsCollector = std::make_unique<DbStatsCollector>();
+			connection->enableStats(_statsCollector.get());
+		}
+#endif // LMS_SUPPORT_SQLITE3_API
+		if (!_statsCollector)
+			LMS_LOG(DB, WARNING) << "Db stats not supported, see USE_SQLITE3_API";
+	}
 
 	auto connectionPool = std::make_unique<Wt::Dbo::FixedSqlConnectionPool>(std::move(connection), connectionCount);
 	connectionPool->setTimeout(std::chrono::seconds(10));
 
 	_connectionPool = std::move(connectionPool);
+	// The backups open their own connections: two copies of the SQLite library in the same process would break each other's file locks
+	if (_sqliteApiUsable)
+		_backupRunner = std::make_unique<DbBackupRunner>(dbPath);
 }
 
 Db::~Db()
@@ -58,6 +288,210 @@ Db::executeSql(const std::string& sql)
 	connection->executeSql(sql);
 }
 
+bool
+Db::isReachable() const
+{
+#ifdef LMS_SUPPORT_SQLITE3_API
+	if (!_sqliteApiUsable)
+		return isFileReadable();
+
+	sqlite3* connection {};
+	bool res {sqlite3_open_v2(_dbPath.c_str(), &connection, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK};
+	if (res)
+	{
+		sqlite3_busy_timeout(connection, 1000);
+		res = sqlite3_exec(connection, "SELECT COUNT(*) FROM sqlite_master", nullptr, nullptr, nullptr) == SQLITE_OK;
+	}
+	// Always needed, even if the open failed
+	sqlite3_close(connection);
+
+	return res;
+#else
+	return isFileReadable();
+#endif // LMS_SUPPORT_SQLITE3_API
+}
+
+bool
+Db::isFileReadable() const
+{
+	// Only checks the header of the file
+	constexpr std::string_view sqliteHeader {"SQLite format 3", 16}; // including the null char
+
+	std::array<char, sqliteHeader.size()> header;
+	std::ifstream ifs {_dbPath, std::ios::binary};
+	return ifs.read(header.data(), header.size()) && std::string_view {header.data(), header.size()} == sqliteHeader;
+}
+
+void
+Db::performMaintenance()
+{
+	LMS_LOG(DB, DEBUG) << "Performing db maintenance...";
+	// Only analyzes the tables that may benefit from it. Statistics are used by all the connections
+	executeSql("pragma optimize");
+	// Passive: never waits for readers or writers
+	executeSql("pragma wal_checkpoint(PASSIVE)");
+	LMS_LOG(DB, DEBUG) << "Performing db maintenance DONE";
+}
+
+void
+Db::enableIncrementalVacuum()
+{
+	constexpr long long incrementalAutoVacuum {2};
+
+	// The pragma is per connection until the vacuum makes it persistent: both must use the same connection
+	ScopedConnection connection {*_connectionPool};
+	Wt::Dbo::SqlConnection& sqlConnection {*connection.operator->()};
+
+	if (queryPragmaValue(sqlConnection, "auto_vacuum") == incrementalAutoVacuum)
+		return;
+
+	LMS_LOG(DB, INFO) << "Enabling incremental vacuum, this may take a while...";
+	// Only applied by the next vacuum if the database already has tables
+	sqlConnection.executeSql("pragma auto_vacuum=incremental");
+	sqlConnection.executeSql("VACUUM");
+
+	const long long autoVacuum {queryPragmaValue(sqlConnection, "auto_vacuum")};
+	if (autoVacuum != incrementalAutoVacuum)
+	{
+		LMS_LOG(DB, ERROR) << "Cannot enable incremental vacuum, auto_vacuum = " << autoVacuum;
+		return;
+	}
+
+	LMS_LOG(DB, INFO) << "Incremental vacuum enabled";
+}
+
+Db::FreeSpace
+Db::getFreeSpace()
+{
+	ScopedConnection connection {*_connectionPool};
+
+	FreeSpace res;
+	res.pageSize = static_cast<std::size_t>(queryPragmaValue(*connection.operator->(), "page_size"));
+	res.freePageCount = static_cast<std::size_t>(queryPragmaValue(*connection.operator->(), "freelist_count"));
+
+	return res;
+}
+
+std::size_t
+Db::reclaimFreePages(std::size_t maxPageCount)
+{
+	if (maxPageCount == 0)
+		return 0;
+
+	// Same as a unique transaction, other processes are waited for using the busy timeout
+	const std::unique_lock lock {_sharedMutex};
+
+	ScopedConnection connection {*_connectionPool};
+	Wt::Dbo::SqlConnection& sqlConnection {*connection.operator->()};
+
+	const long long freePageCountBefore {queryPragmaValue(sqlConnection, "freelist_count")};
+	queryPragmaValue(sqlConnection, "incremental_vacuum(" + std::to_string(maxPageCount) + ")");
+	const long long freePageCountAfter {queryPragmaValue(sqlConnection, "freelist_count")};
+
+	return freePageCountBefore > freePageCountAfter ? static_cast<std::size_t>(freePageCountBefore - freePageCountAfter) : 0;
+}
+
+bool
+Db::startBackup(const std::filesystem::path& backupPath)
+{
+	if (!_backupRunner)
+		return false;
+
+	return _backupRunner->start(backupPath);
+}
+
+std::optional<DbBackupStatus>
+Db::getBackupStatus() const
+{
+	if (!_backupRunner)
+		return std::nullopt;
+
+	return _backupRunner->getStatus();
+}
+
+void
+Db::buildLibraryIndex()
+{
+	Session& session {getTLSSession()};
+
+	std::shared_ptr<const LibraryIndex> libraryIndex;
+	{
+		auto transaction {session.createSharedTransaction()};
+		libraryIndex = LibraryIndex::build(session);
+	}
+
+	std::scoped_lock lock {_libraryIndexMutex};
+	_libraryIndex = std::move(libraryIndex);
+}
+
+void
+Db::clearLibraryIndex()
+{
+	std::scoped_lock lock {_libraryIndexMutex};
+	_libraryIndex.reset();
+}
+
+std::shared_ptr<const LibraryIndex>
+Db::getLibraryIndex() const
+{
+	std::scoped_lock lock {_libraryIndexMutex};
+	return _libraryIndex;
+}
+
+void
+Db::buildClusterCatalog()
+{
+	Session& session {getTLSSession()};
+
+	std::shared_ptr<const ClusterCatalog> clusterCatalog;
+	{
+		auto transaction {session.createSharedTransaction()};
+		clusterCatalog = ClusterCatalog::build(session);
+	}
+
+	std::scoped_lock lock {_clusterCatalogMutex};
+	_clusterCatalog = std::move(clusterCatalog);
+}
+
+std::shared_ptr<const ClusterCatalog>
+Db::getClusterCatalog() const
+{
+	std::scoped_lock lock {_clusterCatalogMutex};
+	return _clusterCatalog;
+}
+
+std::optional<DbStats>
+Db::getStats() const
+{
+	if (!_statsCollector)
+		return std::nullopt;
+
+	return _statsCollector->getStats();
+}
+
+void
+Db::logStats(std::size_t maxQueryCount) const
+{
+	if (!_statsCollector)
+		return;
+
+	const DbStats stats {_statsCollector->getStats()};
+
+	std::chrono::microseconds totalQueryDuration {};
+	for (const QueryStats& query : stats.queries)
+		totalQueryDuration += query.totalDuration;
+
+	LMS_LOG(DB, INFO) << "Db stats: " << stats.queries.size() << " query shapes, total execution = " << totalQueryDuration.count() / 1000 << " ms"
+		<< ", shared locks = " << stats.sharedLocks.count << " (total wait = " << stats.sharedLocks.totalWaitDuration.count() / 1000 << " ms, p99 = " << stats.sharedLocks.p99WaitDuration.count() << " us)"
+		<< ", unique locks = " << stats.uniqueLocks.count << " (total wait = " << stats.uniqueLocks.totalWaitDuration.count() / 1000 << " ms, p99 = " << stats.uniqueLocks.p99WaitDuration.count() << " us)";
+
+	for (std::size_t i {}; i < std::min(maxQueryCount, stats.queries.size()); ++i)
+	{
+		const QueryStats& query {stats.queries[i]};
+		LMS_LOG(DB, INFO) << "Db stats: total = " << query.totalDuration.count() / 1000 << " ms, count = " << query.count << ", p99 = " << query.p99Duration.count() << " us, rows = " << query.rowCount << ": " << query.sql;
+	}
+}
+
 Session&
 Db::getTLSSession()
 {
@@ -65,13 +499,10 @@ Db::getTLSSession()
 
 	if (!tlsSession)
 	{
-		auto newSession {std::make_unique<Session>(*this)};
-		tlsSession = newSession.get();
+		std::scoped_lock lock {_tlsSessionsMutex};
 
-		{
-			std::scoped_lock lock {_tlsSessionsMutex};
-			_tlsSessions.push_back(std::move(newSession));
-		}
+		_tlsSessions.push_back(std::make_unique<Session>(*this, "tls-" + std::to_string(_tlsSessions.size())));
+		tlsSession = _tlsSessions.back().get();
 	}
 
 	return *tlsSession;
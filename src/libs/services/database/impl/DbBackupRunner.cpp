@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DbBackupRunner.hpp"
+
+#ifdef LMS_SUPPORT_SQLITE3_API
+#include <sqlite3.h>
+#endif // LMS_SUPPORT_SQLITE3_API
+
+#include "utils/Exception.hpp"
+#include "utils/Logger.hpp"
+
+namespace Database
+{
+#ifdef LMS_SUPPORT_SQLITE3_API
+	namespace
+	{
+		class SQLiteConnection
+		{
+			public:
+				SQLiteConnection(const std::filesystem::path& path, int flags)
+				{
+					const int res {sqlite3_open_v2(path.c_str(), &_connection, flags, nullptr)};
+					if (res != SQLITE_OK)
+					{
+						const std::string error {_connection ? sqlite3_errmsg(_connection) : sqlite3_errstr(res)};
+						// Always needed, even if the open failed
+						sqlite3_close(_connection);
+						throw LmsException {"Cannot open '" + path.string() + "': " + error};
+					}
+
+					sqlite3_busy_timeout(_connection, 1000);
+				}
+
+				~SQLiteConnection()
+				{
+					sqlite3_close(_connection);
+				}
+
+				SQLiteConnection(const SQLiteConnection&) = delete;
+				SQLiteConnection& operator=(const SQLiteConnection&) = delete;
+
+				sqlite3* get() const { return _connection; }
+
+				void execute(const char* sql)
+				{
+					if (sqlite3_exec(_connection, sql, nullptr, nullptr, nullptr) != SQLITE_OK)
+						throw LmsException {"Cannot execute '" + std::string {sql} + "': " + sqlite3_errmsg(_connection)};
+				}
+
+			private:
+				sqlite3* _connection {};
+		};
+	}
+#endif // LMS_SUPPORT_SQLITE3_API
+
+	DbBackupRunner::DbBackupRunner(const std::filesystem::path& dbPath)
+		: _dbPath {dbPath}
+	{
+	}
+
+	DbBackupRunner::~DbBackupRunner()
+	{
+		_abort = true;
+		if (_thread.joinable())
+			_thread.join();
+	}
+
+	bool
+	DbBackupRunner::start(const std::filesystem::path& backupPath)
+	{
+		std::scoped_lock lock {_mutex};
+
+		if (_status && _status->state == DbBackupStatus::State::InProgress)
+			return false;
+
+		// previous backup is done
+		if (_thread.joinable())
+			_thread.join();
+
+		_status = DbBackupStatus {};
+		_status->backupPath = backupPath;
+		_thread = std::thread {[this, backupPath] { run(backupPath); }};
+
+		return true;
+	}
+
+	std::optional<DbBackupStatus>
+	DbBackupRunner::getStatus() const
+	{
+		std::scoped_lock lock {_mutex};
+		return _status;
+	}
+
+	void
+	DbBackupRunner::run(const std::filesystem::path& backupPath)
+	{
+		LMS_LOG(DB, INFO) << "Starting db backup to '" << backupPath.string() << "'...";
+
+		// Only replace the previous backup once the new one is complete
+		const std::filesystem::path tmpPath {backupPath.string() + ".tmp"};
+
+		std::string error;
+		try
+		{
+			std::error_code ec;
+			std::filesystem::remove(tmpPath, ec);
+
+			backup(tmpPath);
+
+			std::filesystem::rename(tmpPath, backupPath);
+		}
+		catch (const std::exception& e)
+		{
+			error = e.what();
+
+			std::error_code ec;
+			std::filesystem::remove(tmpPath, ec);
+		}
+
+		std::scoped_lock lock {_mutex};
+		if (error.empty())
+		{
+			LMS_LOG(DB, INFO) << "Db backup to '" << backupPath.string() << "' complete: " << _status->copiedPageCount << " pages";
+			_status->state = DbBackupStatus::State::Complete;
+		}
+		else
+		{
+			LMS_LOG(DB, ERROR) << "Db backup to '" << backupPath.string() << "' failed: " << error;
+			_status->state = DbBackupStatus::State::Failed;
+			_status->error = error;
+		}
+	}
+
+	void
+	DbBackupRunner::backup([[maybe_unused]] const std::filesystem::path& destinationPath)
+	{
+#ifdef LMS_SUPPORT_SQLITE3_API
+		SQLiteConnection source {_dbPath, SQLITE_OPEN_READONLY};
+		SQLiteConnection destination {destinationPath, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE};
+
+		// Reading within a single transaction prevents the backup from restarting each time another connection writes
+		// Drawback: the WAL file cannot be fully checkpointed until the backup is complete
+		source.execute("BEGIN");
+		source.execute("SELECT COUNT(*) FROM sqlite_master");
+
+		sqlite3_backup* backup {sqlite3_backup_init(destination.get(), "main", source.get(), "main")};
+		if (!backup)
+			throw LmsException {std::string {"Cannot init backup: "} + sqlite3_errmsg(destination.get())};
+
+		int res;
+		do
+		{
+			res = sqlite3_backup_step(backup, _pageCountPerStep);
+
+			const int totalPageCount {sqlite3_backup_pagecount(backup)};
+			onProgress(totalPageCount, totalPageCount - sqlite3_backup_remaining(backup));
+
+			if (res == SQLITE_OK || res == SQLITE_BUSY || res == SQLITE_LOCKED)
+				std::this_thread::sleep_for(_stepInterval); // leave some room for the other users of the disk
+		}
+		while ((res == SQLITE_OK || res == SQLITE_BUSY || res == SQLITE_LOCKED) && !_abort);
+
+		// Releases the backup resources even on errors, and reports the first error
+		sqlite3_backup_finish(backup);
+		if (_abort)
+			throw LmsException {"Aborted"};
+		if (res != SQLITE_DONE)
+			throw LmsException {std::string {"Backup step failed: "} + sqlite3_errstr(res)};
+
+		source.execute("COMMIT");
+#else
+		throw LmsException {"Not supported, see USE_SQLITE3_API"};
+#endif // LMS_SUPPORT_SQLITE3_API
+	}
+
+	void
+	DbBackupRunner::onProgress(std::size_t totalPageCount, std::size_t copiedPageCount)
+	{
+		std::scoped_lock lock {_mutex};
+
+		_status->totalPageCount = totalPageCount;
+		_status->copiedPageCount = copiedPageCount;
+	}
+} // namespace Database
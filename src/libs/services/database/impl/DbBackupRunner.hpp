@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "services/database/DbBackup.hpp"
+
+namespace Database
+{
+	// Copies the database using the SQLite online backup API, in small steps on a dedicated thread
+	// The source is read within a single read transaction: the backup is a consistent snapshot and the
+	// other connections can still read and write in the WAL file meanwhile
+	class DbBackupRunner
+	{
+		public:
+			DbBackupRunner(const std::filesystem::path& dbPath);
+			~DbBackupRunner();
+
+			DbBackupRunner(const DbBackupRunner&) = delete;
+			DbBackupRunner& operator=(const DbBackupRunner&) = delete;
+
+			// false if a backup is already in progress
+			bool start(const std::filesystem::path& backupPath);
+			std::optional<DbBackupStatus> getStatus() const;
+
+		private:
+			void run(const std::filesystem::path& backupPath);
+			void backup(const std::filesystem::path& destinationPath);
+			void onProgress(std::size_t totalPageCount, std::size_t copiedPageCount);
+
+			static constexpr int						_pageCountPerStep {256};
+			static constexpr std::chrono::milliseconds	_stepInterval {10};
+
+			const std::filesystem::path	_dbPath;
+			std::atomic<bool>			_abort {};
+			std::thread					_thread;
+
+			mutable std::mutex				_mutex;
+			std::optional<DbBackupStatus>	_status;
+	};
+} // namespace Database
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DbStatsCollector.hpp"
+
+#include <algorithm>
+
+namespace Database
+{
+	void
+	DbStatsCollector::addQuery(std::string_view sql, std::chrono::nanoseconds duration, std::size_t rowCount)
+	{
+		std::scoped_lock lock {_mutex};
+
+		auto itQuery {_queries.find(std::string {sql})};
+		if (itQuery == std::end(_queries))
+			itQuery = _queries.emplace(std::string {sql}, QueryEntry {}).first;
+
+		QueryEntry& entry {itQuery->second};
+		entry.count++;
+		entry.totalDuration += duration;
+		entry.durations.add(std::chrono::duration_cast<DurationHistogram::Duration>(duration));
+		entry.rowCount += rowCount;
+	}
+
+	void
+	DbStatsCollector::addLockWait(LockType type, std::chrono::nanoseconds duration)
+	{
+		std::scoped_lock lock {_mutex};
+
+		LockEntry& entry {type == LockType::Shared ? _sharedLocks : _uniqueLocks};
+		entry.count++;
+		entry.totalWaitDuration += duration;
+		entry.waitDurations.add(std::chrono::duration_cast<DurationHistogram::Duration>(duration));
+	}
+
+	DbStats
+	DbStatsCollector::getStats() const
+	{
+		DbStats stats;
+
+		{
+			std::scoped_lock lock {_mutex};
+
+			stats.queries.reserve(_queries.size());
+			for (const auto& [sql, entry] : _queries)
+			{
+				QueryStats& queryStats {stats.queries.emplace_back()};
+				queryStats.sql = sql;
+				queryStats.count = entry.count;
+				queryStats.totalDuration = std::chrono::duration_cast<std::chrono::microseconds>(entry.totalDuration);
+				queryStats.p99Duration = entry.durations.getPercentile(99);
+				queryStats.rowCount = entry.rowCount;
+			}
+
+			stats.sharedLocks = toLockStats(_sharedLocks);
+			stats.uniqueLocks = toLockStats(_uniqueLocks);
+		}
+
+		std::sort(std::begin(stats.queries), std::end(stats.queries), [](const QueryStats& lhs, const QueryStats& rhs) { return lhs.totalDuration > rhs.totalDuration; });
+
+		return stats;
+	}
+
+	LockStats
+	DbStatsCollector::toLockStats(const LockEntry& entry)
+	{
+		LockStats stats;
+		stats.count = entry.count;
+		stats.totalWaitDuration = std::chrono::duration_cast<std::chrono::microseconds>(entry.totalWaitDuration);
+		stats.p99WaitDuration = entry.waitDurations.getPercentile(99);
+
+		return stats;
+	}
+} // namespace Database
+
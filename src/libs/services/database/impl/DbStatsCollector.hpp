@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "services/database/DbStats.hpp"
+#include "utils/DurationHistogram.hpp"
+
+namespace Database
+{
+	// Thread safe, only created when the stats are enabled
+	class DbStatsCollector
+	{
+		public:
+			enum class LockType
+			{
+				Shared,
+				Unique,
+			};
+
+			void addQuery(std::string_view sql, std::chrono::nanoseconds duration, std::size_t rowCount);
+			void addLockWait(LockType type, std::chrono::nanoseconds duration);
+
+			DbStats getStats() const;
+
+		private:
+			struct QueryEntry
+			{
+				std::size_t					count {};
+				std::chrono::nanoseconds	totalDuration {};
+				DurationHistogram			durations;
+				std::size_t					rowCount {};
+			};
+
+			struct LockEntry
+			{
+				std::size_t					count {};
+				std::chrono::nanoseconds	totalWaitDuration {};
+				DurationHistogram			waitDurations;
+			};
+
+			static LockStats toLockStats(const LockEntry& entry);
+
+			mutable std::mutex								_mutex;
+			std::unordered_map<std::string, QueryEntry>		_queries;
+			LockEntry										_sharedLocks;
+			LockEntry										_uniqueLocks;
+	};
+} // namespace Database
+
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "services/database/Directory.hpp"
+
+#include <cassert>
+
+#include "services/database/Session.hpp"
+#include "IdTypeTraits.hpp"
+#include "Utils.hpp"
+
+namespace Database {
+
+Directory::Directory(const std::filesystem::path& p, ObjectPtr<Directory> parent)
+: _path {p.string()}
+, _name {p.filename().string()}
+, _parent {getDboPtr(parent)}
+{
+}
+
+Directory::pointer
+Directory::create(Session& session, const std::filesystem::path& p, ObjectPtr<Directory> parent)
+{
+	session.checkUniqueLocked();
+
+	Directory::pointer res {session.getDboSession().add(std::make_unique<Directory>(p, parent))};
+	session.getDboSession().flush();
+
+	return res;
+}
+
+std::size_t
+Directory::getCount(Session& session)
+{
+	session.checkSharedLocked();
+
+	return session.getDboSession().query<int>("SELECT COUNT(*) FROM directory");
+}
+
+Directory::pointer
+Directory::find(Session& session, DirectoryId id)
+{
+	session.checkSharedLocked();
+
+	return session.getDboSession().find<Directory>()
+		.where("id = ?").bind(id)
+		.resultValue();
+}
+
+Directory::pointer
+Directory::findByPath(Session& session, const std::filesystem::path& p)
+{
+	session.checkSharedLocked();
+
+	return session.getDboSession().find<Directory>()
+		.where("path = ?").bind(p.string())
+		.resultValue();
+}
+
+RangeResults<Directory::pointer>
+Directory::find(Session& session, Range range)
+{
+	session.checkSharedLocked();
+
+	auto query {session.getDboSession().query<Wt::Dbo::ptr<Directory>>("SELECT d FROM directory d")};
+
+	return execQuery(query, range);
+}
+
+RangeResults<DirectoryId>
+Directory::findRootDirectories(Session& session, Range range)
+{
+	session.checkSharedLocked();
+
+	auto query {session.getDboSession().query<DirectoryId>("SELECT id FROM directory")
+		.where("parent_id IS NULL")
+		.orderBy("name COLLATE NOCASE")};
+
+	return execQuery(query, range);
+}
+
+RangeResults<DirectoryId>
+Directory::findChildren(Session& session, DirectoryId parentId, Range range)
+{
+	session.checkSharedLocked();
+
+	auto query {session.getDboSession().query<DirectoryId>("SELECT id FROM directory")
+		.where("parent_id = ?").bind(parentId)
+		.orderBy("name COLLATE NOCASE")};
+
+	return execQuery(query, range);
+}
+
+RangeResults<DirectoryId>
+Directory::findOrphans(Session& session, Range range)
+{
+	session.checkSharedLocked();
+
+	auto query {session.getDboSession().query<DirectoryId>("SELECT d.id FROM directory d")
+		.where("NOT EXISTS (SELECT 1 FROM track t WHERE t.directory_id = d.id)")
+		.where("NOT EXISTS (SELECT 1 FROM directory c WHERE c.parent_id = d.id)")};
+
+	return execQuery(query, range);
+}
+
+std::size_t
+Directory::getOrphanCount(Session& session)
+{
+	session.checkSharedLocked();
+
+	return session.getDboSession().query<int>("SELECT COUNT(*) FROM directory d WHERE NOT EXISTS (SELECT 1 FROM track t WHERE t.directory_id = d.id) AND NOT EXISTS (SELECT 1 FROM directory c WHERE c.parent_id = d.id)");
+}
+
+std::size_t
+Directory::removeOrphans(Session& session, std::size_t maxCount)
+{
+	session.checkUniqueLocked();
+
+	// Make sure pending changes are written before bypassing Dbo
+	session.getDboSession().flush();
+
+	session.getDboSession().execute("DELETE FROM directory WHERE id IN (SELECT d.id FROM directory d WHERE NOT EXISTS (SELECT 1 FROM track t WHERE t.directory_id = d.id) AND NOT EXISTS (SELECT 1 FROM directory c WHERE c.parent_id = d.id) LIMIT ?)")
+		.bind(static_cast<int>(maxCount));
+
+	return session.getDboSession().query<int>("SELECT changes()");
+}
+
+std::optional<ReleaseId>
+Directory::getCoverReleaseId() const
+{
+	assert(session());
+
+	const auto releaseIds {session()->query<ReleaseId>("SELECT release_id FROM track")
+		.where("directory_id = ?").bind(getId())
+		.where("release_id IS NOT NULL")
+		.limit(1)
+		.resultList()};
+
+	if (releaseIds.empty())
+		return std::nullopt;
+
+	return releaseIds.front();
+}
+
+} // namespace Database
+
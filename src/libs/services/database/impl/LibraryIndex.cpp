@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LibraryIndex.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <tuple>
+
+#include "services/database/Session.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Random.hpp"
+
+namespace Database
+{
+	namespace
+	{
+		using Index = std::uint32_t;
+		using IndexContainer = std::vector<Index>;
+		using IdValue = IdType::ValueType;
+
+		constexpr Index invalidIndex {std::numeric_limits<Index>::max()};
+
+		Index
+		getIndex(const std::vector<IdValue>& ids, IdValue id)
+		{
+			const auto it {std::lower_bound(std::cbegin(ids), std::cend(ids), id)};
+			if (it == std::cend(ids) || *it != id)
+				return invalidIndex;
+
+			return static_cast<Index>(std::distance(std::cbegin(ids), it));
+		}
+
+		std::vector<IdValue>
+		getIds(Session& session, const std::string& table)
+		{
+			auto ids {session.getDboSession().query<IdValue>("SELECT id FROM " + table).orderBy("id").resultList()};
+			return std::vector<IdValue>(ids.begin(), ids.end());
+		}
+
+		// rank of each object in the order given by the query, objects not returned are ranked last
+		IndexContainer
+		getRanks(Session& session, const std::vector<IdValue>& ids, const std::string& orderedIdQuery)
+		{
+			IndexContainer ranks(ids.size(), static_cast<Index>(ids.size()));
+
+			Index rank {};
+			for (const IdValue id : session.getDboSession().query<IdValue>(orderedIdQuery).resultList())
+			{
+				const Index index {getIndex(ids, id)};
+				if (index != invalidIndex)
+					ranks[index] = rank++;
+			}
+
+			return ranks;
+		}
+
+		// indices must be sorted
+		void
+		intersect(IndexContainer& indices, const IndexContainer& otherIndices)
+		{
+			indices.erase(std::set_intersection(std::cbegin(indices), std::cend(indices), std::cbegin(otherIndices), std::cend(otherIndices), std::begin(indices)), std::end(indices));
+		}
+
+		// Only the requested range is sorted
+		void
+		sortIndices(IndexContainer& indices, Range range, const IndexContainer* ranks)
+		{
+			const std::size_t sortedCount {range.size ? std::min(indices.size(), range.offset + range.size) : indices.size()};
+
+			if (!ranks)
+			{
+				// partial Fisher-Yates shuffle
+				for (std::size_t i {}; i < sortedCount; ++i)
+				{
+					std::uniform_int_distribution<std::size_t> dist {i, indices.size() - 1};
+					std::swap(indices[i], indices[dist(Random::getRandGenerator())]);
+				}
+				return;
+			}
+
+			std::partial_sort(std::begin(indices), std::begin(indices) + sortedCount, std::end(indices), [&](Index lhs, Index rhs)
+			{
+				return std::tie((*ranks)[lhs], lhs) < std::tie((*ranks)[rhs], rhs);
+			});
+		}
+
+		template <typename IdType>
+		RangeResults<IdType>
+		toRangeResults(const IndexContainer& indices, const std::vector<IdValue>& ids, Range range)
+		{
+			const std::size_t offset {std::min(range.offset, indices.size())};
+			const std::size_t size {range.size ? std::min(range.size, indices.size() - offset) : indices.size() - offset};
+
+			RangeResults<IdType> res;
+			res.results.reserve(size);
+			for (std::size_t i {offset}; i < offset + size; ++i)
+				res.results.emplace_back(ids[indices[i]]);
+
+			res.range.offset = range.offset;
+			res.range.size = res.results.size();
+			res.moreResults = offset + size < indices.size();
+
+			return res;
+		}
+
+		// Objects of the given tracks, sorted
+		IndexContainer
+		getObjects(const IndexContainer& trackIndices, std::size_t objectCount, const std::function<void(Index, const std::function<void(Index)>&)>& visitTrackObjects)
+		{
+			std::vector<bool> found(objectCount);
+			IndexContainer indices;
+			for (const Index trackIndex : trackIndices)
+			{
+				visitTrackObjects(trackIndex, [&](Index index)
+				{
+					if (index == invalidIndex || found[index])
+						return;
+
+					found[index] = true;
+					indices.push_back(index);
+				});
+			}
+			std::sort(std::begin(indices), std::end(indices));
+
+			return indices;
+		}
+
+		template <typename T>
+		std::size_t
+		getContainerMemoryUsage(const std::vector<T>& container)
+		{
+			return container.capacity() * sizeof(T);
+		}
+	}
+
+	std::unique_ptr<LibraryIndex>
+	LibraryIndex::build(Session& session)
+	{
+		session.checkSharedLocked();
+
+		auto index {std::make_unique<LibraryIndex>()};
+
+		index->_trackIds = getIds(session, "track");
+		index->_releaseIds = getIds(session, "release");
+		index->_artistIds = getIds(session, "artist");
+
+		index->_trackReleases.assign(index->_trackIds.size(), invalidIndex);
+		for (const auto& [trackId, releaseId] : session.getDboSession().query<std::tuple<IdValue, IdValue>>("SELECT id, release_id FROM track WHERE release_id IS NOT NULL").resultList())
+		{
+			const Index trackIndex {getIndex(index->_trackIds, trackId)};
+			if (trackIndex != invalidIndex)
+				index->_trackReleases[trackIndex] = getIndex(index->_releaseIds, releaseId);
+		}
+
+		{
+			// links are sorted by track: just record where each track starts
+			index->_trackArtistOffsets.assign(index->_trackIds.size() + 1, 0);
+			index->_artistLinkTypes.assign(index->_artistIds.size(), 0);
+
+			Index previousTrackIndex {};
+			for (const auto& [trackId, artistId, linkType] : session.getDboSession().query<std::tuple<IdValue, IdValue, int>>("SELECT track_id, artist_id, type FROM track_artist_link").orderBy("track_id").resultList())
+			{
+				const Index trackIndex {getIndex(index->_trackIds, trackId)};
+				const Index artistIndex {getIndex(index->_artistIds, artistId)};
+				if (trackIndex == invalidIndex || artistIndex == invalidIndex)
+					continue;
+
+				for (Index i {previousTrackIndex + 1}; i <= trackIndex; ++i)
+					index->_trackArtistOffsets[i] = static_cast<Index>(index->_trackArtists.size());
+				previousTrackIndex = trackIndex;
+
+				index->_trackArtists.push_back(artistIndex);
+				index->_artistLinkTypes[artistIndex] |= std::uint32_t {1} << linkType;
+			}
+			for (Index i {previousTrackIndex + 1}; i <= index->_trackIds.size(); ++i)
+				index->_trackArtistOffsets[i] = static_cast<Index>(index->_trackArtists.size());
+		}
+
+		for (const auto& [clusterId, trackId] : session.getDboSession().query<std::tuple<IdValue, IdValue>>("SELECT cluster_id, track_id FROM track_cluster").orderBy("cluster_id, track_id").resultList())
+		{
+			const Index trackIndex {getIndex(index->_trackIds, trackId)};
+			if (trackIndex != invalidIndex)
+				index->_tracksByCluster[ClusterId {clusterId}].push_back(trackIndex);
+		}
+
+		// Same orders as the SQL queries
+		index->_trackLastWrittenRanks = getRanks(session, index->_trackIds, "SELECT id FROM track ORDER BY file_last_write DESC");
+		index->_releaseNameRanks = getRanks(session, index->_releaseIds, "SELECT id FROM release ORDER BY name_sort_key");
+		index->_releaseLastWrittenRanks = getRanks(session, index->_releaseIds, "SELECT r.id FROM release r INNER JOIN track t ON t.release_id = r.id GROUP BY r.id ORDER BY MAX(t.file_last_write) DESC");
+		index->_artistNameRanks = getRanks(session, index->_artistIds, "SELECT id FROM artist ORDER BY name_sort_key");
+		index->_artistSortNameRanks = getRanks(session, index->_artistIds, "SELECT id FROM artist ORDER BY sort_name_sort_key");
+		index->_artistLastWrittenRanks = getRanks(session, index->_artistIds, "SELECT a.id FROM artist a INNER JOIN track_artist_link t_a_l ON t_a_l.artist_id = a.id INNER JOIN track t ON t.id = t_a_l.track_id GROUP BY a.id ORDER BY MAX(t.file_last_write) DESC");
+
+		LMS_LOG(DB, INFO) << "Library index built: " << index->_trackIds.size() << " tracks, " << index->_releaseIds.size() << " releases, " << index->_artistIds.size() << " artists, "
+			<< index->_tracksByCluster.size() << " clusters, " << index->getMemoryUsage() << " bytes";
+
+		return index;
+	}
+
+	LibraryIndex::IndexContainer
+	LibraryIndex::getTracks(const std::vector<ClusterId>& clusters) const
+	{
+		std::vector<const IndexContainer*> clusterTracks;
+		clusterTracks.reserve(clusters.size());
+		for (const ClusterId clusterId : clusters)
+		{
+			auto it {_tracksByCluster.find(clusterId)};
+			if (it == std::cend(_tracksByCluster))
+				return {};
+
+			clusterTracks.push_back(&it->second);
+		}
+
+		// Start with the smallest cluster to keep the intermediate results small
+		std::sort(std::begin(clusterTracks), std::end(clusterTracks), [](const IndexContainer* lhs, const IndexContainer* rhs) { return lhs->size() < rhs->size(); });
+
+		IndexContainer indices {*clusterTracks.front()};
+		for (auto it {std::next(std::cbegin(clusterTracks))}; it != std::cend(clusterTracks) && !indices.empty(); ++it)
+			intersect(indices, **it);
+
+		return indices;
+	}
+
+	std::optional<RangeResults<TrackId>>
+	LibraryIndex::find(const Track::FindParameters& params) const
+	{
+		if (params.clusters.empty() || !params.keywords.empty() || params.writtenAfter.isValid() || params.addedAfterGeneration || params.starringUser.isValid() || params.directory.isValid())
+			return std::nullopt;
+
+		const IndexContainer* ranks {};
+		switch (params.sortMethod)
+		{
+			case TrackSortMethod::None:
+			case TrackSortMethod::Random:
+				break;
+			case TrackSortMethod::LastWritten:
+				ranks = &_trackLastWrittenRanks;
+				break;
+			case TrackSortMethod::AddedDesc:
+			case TrackSortMethod::StarredDateDesc:
+			case TrackSortMethod::FilePath:
+				return std::nullopt;
+		}
+
+		IndexContainer indices {getTracks(params.clusters)};
+		if (params.sortMethod != TrackSortMethod::None)
+			sortIndices(indices, params.range, ranks);
+
+		return toRangeResults<TrackId>(indices, _trackIds, params.range);
+	}
+
+	std::optional<RangeResults<ReleaseId>>
+	LibraryIndex::find(const Release::FindParameters& params) const
+	{
+		if (params.clusters.empty() || !params.keywords.empty() || params.writtenAfter.isValid() || params.addedAfterGeneration || params.dateRange || params.starringUser.isValid())
+			return std::nullopt;
+
+		const IndexContainer* ranks {};
+		switch (params.sortMethod)
+		{
+			case ReleaseSortMethod::None:
+			case ReleaseSortMethod::Random:
+				break;
+			case ReleaseSortMethod::Name:
+				ranks = &_releaseNameRanks;
+				break;
+			case ReleaseSortMethod::LastWritten:
+				ranks = &_releaseLastWrittenRanks;
+				break;
+			case ReleaseSortMethod::AddedDesc:
+			case ReleaseSortMethod::Date:
+			case ReleaseSortMethod::StarredDateDesc:
+				return std::nullopt;
+		}
+
+		IndexContainer indices {getObjects(getTracks(params.clusters), _releaseIds.size(), [this](Index trackIndex, const std::function<void(Index)>& func)
+		{
+			func(_trackReleases[trackIndex]);
+		})};
+		if (params.sortMethod != ReleaseSortMethod::None)
+			sortIndices(indices, params.range, ranks);
+
+		return toRangeResults<ReleaseId>(indices, _releaseIds, params.range);
+	}
+
+	std::optional<RangeResults<ArtistId>>
+	LibraryIndex::find(const Artist::FindParameters& params) const
+	{
+		if (params.clusters.empty() || !params.keywords.empty() || params.writtenAfter.isValid() || params.starringUser.isValid())
+			return std::nullopt;
+
+		const IndexContainer* ranks {};
+		switch (params.sortMethod)
+		{
+			case ArtistSortMethod::None:
+			case ArtistSortMethod::Random:
+				break;
+			case ArtistSortMethod::ByName:
+				ranks = &_artistNameRanks;
+				break;
+			case ArtistSortMethod::BySortName:
+				ranks = &_artistSortNameRanks;
+				break;
+			case ArtistSortMethod::LastWritten:
+				ranks = &_artistLastWrittenRanks;
+				break;
+			case ArtistSortMethod::StarredDateDesc:
+				return std::nullopt;
+		}
+
+		IndexContainer indices {getObjects(getTracks(params.clusters), _artistIds.size(), [this](Index trackIndex, const std::function<void(Index)>& func)
+		{
+			for (Index i {_trackArtistOffsets[trackIndex]}; i < _trackArtistOffsets[trackIndex + 1]; ++i)
+				func(_trackArtists[i]);
+		})};
+
+		// like SQL, the link type applies to any track of the artist
+		if (params.linkType)
+		{
+			const std::uint32_t linkTypeMask {std::uint32_t {1} << static_cast<int>(*params.linkType)};
+			indices.erase(std::remove_if(std::begin(indices), std::end(indices), [&](Index index) { return (_artistLinkTypes[index] & linkTypeMask) == 0; }), std::end(indices));
+		}
+
+		if (params.sortMethod != ArtistSortMethod::None)
+			sortIndices(indices, params.range, ranks);
+
+		return toRangeResults<ArtistId>(indices, _artistIds, params.range);
+	}
+
+	std::size_t
+	LibraryIndex::getMemoryUsage() const
+	{
+		std::size_t res {getContainerMemoryUsage(_trackIds)
+			+ getContainerMemoryUsage(_trackReleases)
+			+ getContainerMemoryUsage(_trackArtistOffsets)
+			+ getContainerMemoryUsage(_trackArtists)
+			+ getContainerMemoryUsage(_trackLastWrittenRanks)
+			+ getContainerMemoryUsage(_releaseIds)
+			+ getContainerMemoryUsage(_releaseNameRanks)
+			+ getContainerMemoryUsage(_releaseLastWrittenRanks)
+			+ getContainerMemoryUsage(_artistIds)
+			+ getContainerMemoryUsage(_artistLinkTypes)
+			+ getContainerMemoryUsage(_artistNameRanks)
+			+ getContainerMemoryUsage(_artistSortNameRanks)
+			+ getContainerMemoryUsage(_artistLastWrittenRanks)};
+
+		for (const auto& [clusterId, trackIndices] : _tracksByCluster)
+			res += sizeof(clusterId) + getContainerMemoryUsage(trackIndices);
+
+		return res;
+	}
+} // namespace Database
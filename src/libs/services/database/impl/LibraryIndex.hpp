@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "services/database/Artist.hpp"
+#include "services/database/ClusterId.hpp"
+#include "services/database/Release.hpp"
+#include "services/database/Track.hpp"
+#include "services/database/Types.hpp"
+
+namespace Database
+{
+	class Session;
+
+	// Compact in-memory copy of the track/release/artist/cluster relations, used to answer the cluster filtered finds without SQL joins
+	// Objects are referred to using their position in dense arrays sorted by id, sort orders are precomputed ranks
+	// Immutable once built: shared by all the sessions, and built again when the library changes
+	class LibraryIndex
+	{
+		public:
+			// Shared lock must be held
+			static std::unique_ptr<LibraryIndex> build(Session& session);
+
+			// std::nullopt if the parameters cannot be handled: the caller must fallback on SQL
+			std::optional<RangeResults<TrackId>>	find(const Track::FindParameters& params) const;
+			std::optional<RangeResults<ReleaseId>>	find(const Release::FindParameters& params) const;
+			std::optional<RangeResults<ArtistId>>	find(const Artist::FindParameters& params) const;
+
+			std::size_t getMemoryUsage() const; // approximation, in bytes
+
+		private:
+			using Index = std::uint32_t;
+			using IndexContainer = std::vector<Index>;
+			using IdValue = IdType::ValueType;
+
+			// sorted indices of the tracks that belong to all the clusters
+			IndexContainer getTracks(const std::vector<ClusterId>& clusters) const;
+
+			std::vector<IdValue>	_trackIds;
+			IndexContainer			_trackReleases;				// release of each track, max value if none
+			IndexContainer			_trackArtistOffsets;		// _trackArtists range of each track (size is track count + 1)
+			IndexContainer			_trackArtists;
+			IndexContainer			_trackLastWrittenRanks;
+			std::unordered_map<ClusterId, IndexContainer>	_tracksByCluster;
+
+			std::vector<IdValue>	_releaseIds;
+			IndexContainer			_releaseNameRanks;
+			IndexContainer			_releaseLastWrittenRanks;
+
+			std::vector<IdValue>	_artistIds;
+			std::vector<std::uint32_t>	_artistLinkTypes;		// bitmask of the TrackArtistLinkType of each artist
+			IndexContainer			_artistNameRanks;
+			IndexContainer			_artistSortNameRanks;
+			IndexContainer			_artistLastWrittenRanks;
+	};
+} // namespace Database
@@ -35,9 +35,9 @@ namespace
 		auto query {session.query<ArtistId>("SELECT a.id from artist a")
 						.join("track t ON t.id = t_a_l.track_id")
 						.join("track_artist_link t_a_l ON t_a_l.artist_id = a.id")
-						.join("listen l ON l.track_id = t.id")
-						.where("l.user_id = ?").bind(userId)
-						.where("l.scrobbler = ?").bind(scrobbler)};
+						.join("track_listen_stats l_s ON l_s.track_id = t.id")
+						.where("l_s.user_id = ?").bind(userId)
+						.where("l_s.scrobbler = ?").bind(scrobbler)};
 
 		if (linkType)
 			query.where("t_a_l.type = ?").bind(*linkType);
@@ -72,9 +72,9 @@ namespace
 	{
 		auto query {session.query<ReleaseId>("SELECT r.id from release r")
 						.join("track t ON t.release_id = r.id")
-						.join("listen l ON l.track_id = t.id")
-						.where("l.user_id = ?").bind(userId)
-						.where("l.scrobbler = ?").bind(scrobbler)};
+						.join("track_listen_stats l_s ON l_s.track_id = t.id")
+						.where("l_s.user_id = ?").bind(userId)
+						.where("l_s.scrobbler = ?").bind(scrobbler)};
 
 		if (!clusterIds.empty())
 		{
@@ -104,9 +104,9 @@ namespace
 	createTracksQuery(Wt::Dbo::Session& session, UserId userId, Scrobbler scrobbler, const std::vector<ClusterId>& clusterIds)
 	{
 		auto query {session.query<TrackId>("SELECT t.id from track t")
-					.join("listen l ON l.track_id = t.id")
-					.where("l.user_id = ?").bind(userId)
-					.where("l.scrobbler = ?").bind(scrobbler)};
+					.join("track_listen_stats l_s ON l_s.track_id = t.id")
+					.where("l_s.user_id = ?").bind(userId)
+					.where("l_s.scrobbler = ?").bind(scrobbler)};
 
 		if (!clusterIds.empty())
 		{
@@ -199,6 +199,47 @@ namespace Database
 		return res;
 	}
 
+	std::size_t
+	Listen::compact(Session& session, const Wt::WDateTime& dateTime)
+	{
+		session.checkUniqueLocked();
+
+		const std::string condition {"date_time < ? AND scrobbling_state = " + std::to_string(static_cast<int>(ScrobblingState::Synchronized))};
+
+		const std::size_t count {static_cast<std::size_t>(session.getDboSession().query<int>("SELECT COUNT(*) FROM listen WHERE " + condition).bind(dateTime).resultValue())};
+		if (count == 0)
+			return 0;
+
+		auto& dboSession {session.getDboSession()};
+
+		dboSession.execute("INSERT INTO listen_period_stats(user_id, scrobbler, period, track_id, listen_count, last_date_time)"
+				" SELECT user_id, scrobbler, SUBSTR(date_time, 1, 7), track_id, COUNT(*), MAX(date_time) FROM listen WHERE " + condition +
+				" GROUP BY user_id, scrobbler, SUBSTR(date_time, 1, 7), track_id"
+				" ON CONFLICT(user_id, scrobbler, period, track_id) DO UPDATE SET listen_count = listen_count + excluded.listen_count, last_date_time = MAX(last_date_time, excluded.last_date_time)").bind(dateTime);
+
+		// The listen delete trigger decrements the stats for each removed listen: add the compacted listens back first
+		dboSession.execute("INSERT INTO track_listen_stats(user_id, scrobbler, track_id, listen_count, last_date_time)"
+				" SELECT user_id, scrobbler, track_id, COUNT(*), MAX(date_time) FROM listen WHERE " + condition +
+				" GROUP BY user_id, scrobbler, track_id"
+				" ON CONFLICT(user_id, scrobbler, track_id) DO UPDATE SET listen_count = listen_count + excluded.listen_count").bind(dateTime);
+
+		dboSession.execute("DELETE FROM listen WHERE " + condition).bind(dateTime);
+
+		return count;
+	}
+
+	bool
+	Listen::isCompacted(Session& session, UserId userId, Scrobbler scrobbler, const Wt::WDateTime& dateTime)
+	{
+		session.checkSharedLocked();
+
+		return session.getDboSession().query<int>("SELECT COUNT(*) FROM (SELECT 1 FROM listen_period_stats WHERE user_id = ? AND scrobbler = ? AND period = ? LIMIT 1)")
+			.bind(userId)
+			.bind(scrobbler)
+			.bind(dateTime.toString("yyyy-MM").toUTF8())
+			.resultValue() > 0;
+	}
+
 	RangeResults<ArtistId>
 	Listen::getTopArtists(Session& session,
 			UserId userId,
@@ -209,9 +250,8 @@ namespace Database
 	{
 		auto query {createArtistsQuery(session.getDboSession(), userId, scrobbler, clusterIds, linkType)};
 
-		auto collection {query
-			.orderBy("COUNT(a.id) DESC")
-			.groupBy("a.id")};
+		query.orderBy("SUM(l_s.listen_count) DESC")
+			.groupBy("a.id");
 
 		return execQuery(query, range);
 	}
@@ -224,7 +264,7 @@ namespace Database
 			Range range)
 	{
 		auto query {createReleasesQuery(session.getDboSession(), userId, scrobbler, clusterIds)
-						.orderBy("COUNT(r.id) DESC")
+						.orderBy("SUM(l_s.listen_count) DESC")
 						.groupBy("r.id")};
 
 		return execQuery(query, range);
@@ -238,8 +278,7 @@ namespace Database
 			Range range)
 	{
 		auto query {createTracksQuery(session.getDboSession(), userId, scrobbler, clusterIds)
-						.orderBy("COUNT(t.id) DESC")
-						.groupBy("t.id")};
+						.orderBy("l_s.listen_count DESC")};
 
 		return execQuery(query, range);
 	}
@@ -253,8 +292,8 @@ namespace Database
 			Range range)
 	{
 		auto query {createArtistsQuery(session.getDboSession(), userId, scrobbler, clusterIds, linkType)
-						.groupBy("a.id").having("l.date_time = MAX(l.date_time)")
-						.orderBy("l.date_time DESC")};
+						.groupBy("a.id")
+						.orderBy("MAX(l_s.last_date_time) DESC")};
 
 		return execQuery(query, range);
 	}
@@ -267,8 +306,8 @@ namespace Database
 			Range range)
 	{
 		auto query {createReleasesQuery(session.getDboSession(), userId, scrobbler, clusterIds)
-						.groupBy("r.id").having("l.date_time = MAX(l.date_time)")
-						.orderBy("l.date_time DESC")};
+						.groupBy("r.id")
+						.orderBy("MAX(l_s.last_date_time) DESC")};
 
 		return execQuery(query, range);
 	}
@@ -281,8 +320,7 @@ namespace Database
 			Range range)
 	{
 		auto query {createTracksQuery(session.getDboSession(), userId, scrobbler, clusterIds)
-						.groupBy("t.id").having("l.date_time = MAX(l.date_time)")
-						.orderBy("l.date_time DESC")};
+						.orderBy("l_s.last_date_time DESC")};
 
 		return execQuery(query, range);
 	}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "services/database/MediaRoot.hpp"
+
+#include "services/database/ScanSettings.hpp"
+#include "services/database/Session.hpp"
+#include "utils/String.hpp"
+
+namespace Database {
+
+MediaRoot::MediaRoot(const std::filesystem::path& directory)
+	: _directory {StringUtils::stringTrimEnd(directory.string(), "/\\")}
+{
+}
+
+MediaRoot::pointer
+MediaRoot::create(Session& session, const std::filesystem::path& directory)
+{
+	session.checkUniqueLocked();
+
+	MediaRoot::pointer res {session.getDboSession().add(std::make_unique<MediaRoot>(directory))};
+	session.getDboSession().flush();
+
+	return res;
+}
+
+std::vector<std::filesystem::path>
+MediaRoot::getAudioFileExtensions() const
+{
+	const auto extensions {StringUtils::splitString(_audioFileExtensions, " ")};
+	return std::vector<std::filesystem::path>(std::cbegin(extensions), std::cend(extensions));
+}
+
+void
+MediaRoot::setAudioFileExtensions(const std::vector<std::filesystem::path>& extensions)
+{
+	_audioFileExtensions.clear();
+	for (const std::filesystem::path& extension : extensions)
+	{
+		if (!_audioFileExtensions.empty())
+			_audioFileExtensions += " ";
+		_audioFileExtensions += extension.string();
+	}
+}
+
+} // namespace Database
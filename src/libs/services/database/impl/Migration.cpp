@@ -19,6 +19,12 @@
 
 #include "Migration.hpp"
 
+#include <chrono>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
 #include <Wt/Dbo/WtSqlTraits.h>
 
 #include "services/database/Db.hpp"
@@ -27,6 +33,8 @@
 #include "services/database/User.hpp"
 #include "utils/Exception.hpp"
 #include "utils/Logger.hpp"
+#include "utils/String.hpp"
+#include "TrackFeaturesEncoding.hpp"
 
 namespace Database
 {
@@ -549,6 +557,422 @@ CREATE TABLE "listen" (
 		ScanSettings::get(session).modify()->addAudioFileExtension(".wv");
 	}
 
+	static
+	void
+	migrateFromV33(Session& session)
+	{
+		// Directory fingerprints, used to skip unchanged directories
+		session.getDboSession().execute(R"(
+CREATE TABLE IF NOT EXISTS "directory" (
+  "id" integer primary key autoincrement,
+  "version" integer not null,
+  "path" text not null,
+  "last_write" text,
+  "entry_count" integer not null,
+  "scan_version" integer not null
+))");
+	}
+
+	static
+	void
+	migrateFromV34(Session& session)
+	{
+		// Superseded by covering indexes, created along with the other indexes
+		session.getDboSession().execute("DROP INDEX IF EXISTS track_release_idx");
+		session.getDboSession().execute("DROP INDEX IF EXISTS listen_user_scrobbler_idx");
+		session.getDboSession().execute("DROP INDEX IF EXISTS starred_artist_user_scrobbler_idx");
+		session.getDboSession().execute("DROP INDEX IF EXISTS starred_release_user_scrobbler_idx");
+		session.getDboSession().execute("DROP INDEX IF EXISTS starred_track_user_scrobbler_idx");
+	}
+
+	static
+	void
+	migrateFromV35(Session& session)
+	{
+		// Play queues saved by Subsonic clients
+		session.getDboSession().execute(R"(
+CREATE TABLE IF NOT EXISTS "playqueue" (
+  "id" integer primary key autoincrement,
+  "version" integer not null,
+  "current_index" integer not null,
+  "current_position_in_track" integer,
+  "last_modified_date_time" text,
+  "changed_by" text not null,
+  "user_id" bigint,
+  "tracklist_id" bigint,
+  constraint "fk_playqueue_user" foreign key ("user_id") references "user" ("id") on delete cascade deferrable initially deferred,
+  constraint "fk_playqueue_tracklist" foreign key ("tracklist_id") references "tracklist" ("id") on delete cascade deferrable initially deferred
+))");
+	}
+
+	static
+	void
+	migrateFromV36(Session& session)
+	{
+		// Cover source chosen by the scanner
+		session.getDboSession().execute("ALTER TABLE release ADD cover_path TEXT NOT NULL DEFAULT ''");
+
+		// Just increment the scan version of the settings to make the next scheduled scan rescan everything
+		ScanSettings::get(session).modify()->incScanVersion();
+	}
+
+	static
+	void
+	migrateFromV37(Session& session)
+	{
+		// Track features: only keep the defined features, packed instead of the whole JSON data
+		session.getDboSession().execute(R"(
+CREATE TABLE "track_features_backup" (
+  "id" integer primary key autoincrement,
+  "version" integer not null,
+  "schema_version" integer not null,
+  "feature_values" blob not null,
+  "track_id" bigint,
+  constraint "fk_track_features_track" foreign key ("track_id") references "track" ("id") on delete cascade deferrable initially deferred
+))");
+
+		using IdValue = IdType::ValueType;
+
+		// Rows are converted one by one, JSON data can be large
+		const auto ids {session.getDboSession().query<IdValue>("SELECT id FROM track_features").resultList()};
+		const std::vector<IdValue> trackFeaturesIds (std::cbegin(ids), std::cend(ids));
+
+		LMS_LOG(DB, INFO) << "Converting " << trackFeaturesIds.size() << " track features...";
+
+		for (const IdValue id : trackFeaturesIds)
+		{
+			const auto [version, data, trackId] {session.getDboSession().query<std::tuple<int, std::string, IdValue>>("SELECT version, data, track_id FROM track_features")
+				.where("id = ?").bind(id)
+				.resultValue()};
+
+			session.getDboSession().execute("INSERT INTO track_features_backup ('id', 'version', 'schema_version', 'feature_values', 'track_id') VALUES (?, ?, ?, ?, ?)")
+				.bind(id)
+				.bind(version)
+				.bind(TrackFeaturesEncoding::schemaVersion)
+				.bind(TrackFeaturesEncoding::encode(data))
+				.bind(trackId);
+		}
+
+		session.getDboSession().execute("DROP TABLE track_features");
+		session.getDboSession().execute("ALTER TABLE track_features_backup RENAME TO track_features");
+	}
+
+	static
+	void
+	migrateFromV38(Session& session)
+	{
+		// Listens are now incrementally synchronized
+		session.getDboSession().execute("ALTER TABLE user ADD listenbrainz_sync_cursor TEXT");
+	}
+
+	static
+	void
+	migrateFromV39(Session& session)
+	{
+		// Library changes are now visible to the other instances sharing the database
+		session.getDboSession().execute("ALTER TABLE scan_settings ADD library_generation INTEGER NOT NULL DEFAULT 0");
+	}
+
+	static
+	void
+	migrateFromV40(Session& session)
+	{
+		// Content hash to detect moved files, need to rescan the whole files
+		session.getDboSession().execute("ALTER TABLE track ADD content_hash TEXT NOT NULL DEFAULT ''");
+		// Just increment the scan version of the settings to make the next scheduled scan rescan everything
+		ScanSettings::get(session).modify()->incScanVersion();
+	}
+
+	static
+	void
+	migrateFromV41(Session& session)
+	{
+		// Listen stats now account for the compacted listens: triggers will be created again, and the stats computed again
+		session.getDboSession().execute("DROP TRIGGER IF EXISTS track_listen_stats_delete");
+		session.getDboSession().execute("DROP TRIGGER IF EXISTS track_listen_stats_update");
+	}
+
+	static
+	void
+	migrateFromV42(Session& session)
+	{
+		// Directory tree, to browse the library by folders
+		session.getDboSession().execute("ALTER TABLE directory ADD name TEXT NOT NULL DEFAULT ''");
+		session.getDboSession().execute("ALTER TABLE directory ADD parent_id BIGINT REFERENCES directory(id) ON DELETE CASCADE DEFERRABLE INITIALLY DEFERRED");
+		session.getDboSession().execute("ALTER TABLE track ADD directory_id BIGINT REFERENCES directory(id) ON DELETE SET NULL DEFERRABLE INITIALLY DEFERRED");
+		// Previous directories are just fingerprints, not linked together
+		session.getDboSession().execute("DELETE FROM directory");
+		// Just increment the scan version of the settings to make the next scheduled scan rescan everything
+		ScanSettings::get(session).modify()->incScanVersion();
+	}
+
+	static
+	void
+	migrateFromV43(Session& session)
+	{
+		// Stream info, to avoid useless transcodes: need to read the audio properties again
+		session.getDboSession().execute("ALTER TABLE track ADD bitrate INTEGER NOT NULL DEFAULT 0");
+		session.getDboSession().execute("ALTER TABLE track ADD audio_codec INTEGER NOT NULL DEFAULT(" + std::to_string(static_cast<int>(AudioCodec::Unknown)) + ")");
+		// Just increment the scan version of the settings to make the next scheduled scan rescan everything
+		ScanSettings::get(session).modify()->incScanVersion();
+	}
+
+	static
+	void
+	migrateFromV44(Session& session)
+	{
+		// Several media roots
+		session.getDboSession().execute(R"(
+CREATE TABLE IF NOT EXISTS "media_root" (
+  "id" integer primary key autoincrement,
+  "version" integer not null,
+  "directory" text not null,
+  "audio_file_extensions" text not null,
+  "scan_settings_id" bigint,
+  constraint "fk_media_root_scan_settings" foreign key ("scan_settings_id") references "scan_settings" ("id") on delete cascade deferrable initially deferred
+))");
+		session.getDboSession().execute("INSERT INTO media_root (version, directory, audio_file_extensions, scan_settings_id) SELECT 0, media_directory, '', id FROM scan_settings WHERE media_directory <> ''");
+		// The media_directory column is no longer mapped: left as is, the scan settings row is never inserted again
+	}
+
+	static
+	void
+	migrateFromV45(Session& session)
+	{
+		// Resumable forced scans
+		session.getDboSession().execute("ALTER TABLE scan_settings ADD forced_scan_in_progress BOOLEAN NOT NULL DEFAULT(0)");
+	}
+
+	static
+	void
+	migrateFromV46(Session& session)
+	{
+		// Track paths are split into their directory and their file name
+		session.getDboSession().execute(R"(
+CREATE TABLE "track_backup" (
+  "id" integer primary key autoincrement,
+  "version" integer not null,
+  "scan_version" integer not null,
+  "track_number" integer not null,
+  "disc_number" integer not null,
+  "name" text not null,
+  "duration" integer,
+  "date" integer text,
+  "original_date" integer text,
+  "file_name" text not null,
+  "file_last_write" text,
+  "file_added" text,
+  "has_cover" boolean not null,
+  "mbid" text not null,
+  "copyright" text not null,
+  "copyright_url" text not null,
+  "release_id" bigint, total_disc INTEGER NOT NULL DEFAULT(0), total_track INTEGER NOT NULL DEFAULT(0), track_replay_gain REAL, release_replay_gain REAL, disc_subtitle TEXT NOT NULL DEFAULT '', recording_mbid TEXT, content_hash TEXT NOT NULL DEFAULT '', bitrate INTEGER NOT NULL DEFAULT 0, audio_codec INTEGER NOT NULL DEFAULT 0,
+  "directory_id" bigint,
+  constraint "fk_track_release" foreign key ("release_id") references "release" ("id") on delete cascade deferrable initially deferred,
+  constraint "fk_track_directory" foreign key ("directory_id") references "directory" ("id") on delete cascade deferrable initially deferred
+))");
+		// Tracks not linked to a directory yet keep their full path as file name
+		session.getDboSession().execute("INSERT INTO track_backup"
+				" (id, version, scan_version, track_number, disc_number, name, duration, date, original_date, file_name, file_last_write, file_added, has_cover, mbid, copyright, copyright_url, release_id, total_disc, total_track, track_replay_gain, release_replay_gain, disc_subtitle, recording_mbid, content_hash, bitrate, audio_codec, directory_id)"
+				" SELECT t.id, t.version, t.scan_version, t.track_number, t.disc_number, t.name, t.duration, t.date, t.original_date,"
+				" CASE WHEN d.id IS NULL THEN t.file_path ELSE SUBSTR(t.file_path, LENGTH(RTRIM(d.path, '/')) + 2) END,"
+				" t.file_last_write, t.file_added, t.has_cover, t.mbid, t.copyright, t.copyright_url, t.release_id, t.total_disc, t.total_track, t.track_replay_gain, t.release_replay_gain, t.disc_subtitle, t.recording_mbid, t.content_hash, t.bitrate, t.audio_codec, d.id"
+				" FROM track t LEFT OUTER JOIN directory d ON d.id = t.directory_id");
+		session.getDboSession().execute("DROP TABLE track");
+		session.getDboSession().execute("ALTER TABLE track_backup RENAME TO track");
+	}
+
+	using IdType = Wt::Dbo::dbo_default_traits::IdType;
+
+	// Data rewrite of a large table, done by chunks of rows processed by increasing id
+	struct ChunkResult
+	{
+		std::size_t	rowCount {};
+		IdType		lastId {};
+	};
+	struct DataMigrationStep
+	{
+		std::string_view table;
+		// Processes at most chunkSize rows whose id is greater than afterId
+		std::function<ChunkResult(Session& session, IdType afterId, std::size_t chunkSize)> processChunk;
+	};
+	using DataMigration = std::vector<DataMigrationStep>;
+
+	static
+	void
+	migrateFromV47(Session& session)
+	{
+		// Precomputed sort keys, replacing the NOCASE collations (see the data migration below)
+		session.getDboSession().execute("ALTER TABLE artist ADD name_sort_key TEXT NOT NULL DEFAULT ''");
+		session.getDboSession().execute("ALTER TABLE artist ADD sort_name_sort_key TEXT NOT NULL DEFAULT ''");
+		session.getDboSession().execute("ALTER TABLE release ADD name_sort_key TEXT NOT NULL DEFAULT ''");
+		session.getDboSession().execute("DROP INDEX IF EXISTS artist_sort_name_nocase_idx");
+		session.getDboSession().execute("DROP INDEX IF EXISTS release_name_nocase_idx");
+	}
+
+	static
+	ChunkResult
+	migrateArtistSortKeysFromV47(Session& session, IdType afterId, std::size_t chunkSize)
+	{
+		const auto artistRows {session.getDboSession().query<std::tuple<IdType, std::string, std::string>>("SELECT id, name, sort_name FROM artist")
+			.where("id > ?").bind(afterId)
+			.orderBy("id")
+			.limit(static_cast<int>(chunkSize))
+			.resultList()};
+		const std::vector<std::tuple<IdType, std::string, std::string>> artists (std::cbegin(artistRows), std::cend(artistRows));
+
+		ChunkResult res;
+		for (const auto& [id, name, sortName] : artists)
+		{
+			session.getDboSession().execute("UPDATE artist SET name_sort_key = ?, sort_name_sort_key = ? WHERE id = ?")
+				.bind(StringUtils::computeSortKey(name))
+				.bind(StringUtils::computeSortKey(sortName))
+				.bind(id);
+
+			res.rowCount++;
+			res.lastId = id;
+		}
+
+		return res;
+	}
+
+	static
+	ChunkResult
+	migrateReleaseSortKeysFromV47(Session& session, IdType afterId, std::size_t chunkSize)
+	{
+		const auto releaseRows {session.getDboSession().query<std::tuple<IdType, std::string>>("SELECT id, name FROM release")
+			.where("id > ?").bind(afterId)
+			.orderBy("id")
+			.limit(static_cast<int>(chunkSize))
+			.resultList()};
+		const std::vector<std::tuple<IdType, std::string>> releases (std::cbegin(releaseRows), std::cend(releaseRows));
+
+		ChunkResult res;
+		for (const auto& [id, name] : releases)
+		{
+			session.getDboSession().execute("UPDATE release SET name_sort_key = ? WHERE id = ?")
+				.bind(StringUtils::computeSortKey(name))
+				.bind(id);
+
+			res.rowCount++;
+			res.lastId = id;
+		}
+
+		return res;
+	}
+
+	static
+	void
+	migrateFromV48(Session& session)
+	{
+		// Embedded picture hash, to share the cached covers between tracks: need to read the pictures again
+		session.getDboSession().execute("ALTER TABLE track ADD cover_hash BIGINT NOT NULL DEFAULT 0");
+		// Just increment the scan version of the settings to make the next scheduled scan rescan everything
+		ScanSettings::get(session).modify()->incScanVersion();
+	}
+
+	static
+	void
+	migrateFromV49(Session& session)
+	{
+		// Added log: the existing tracks and releases are considered as added before the first recorded generation
+		session.getDboSession().execute("ALTER TABLE track ADD added_generation INTEGER NOT NULL DEFAULT 0");
+		session.getDboSession().execute("ALTER TABLE release ADD added_generation INTEGER NOT NULL DEFAULT 0");
+		session.getDboSession().execute("ALTER TABLE release ADD added TEXT");
+		session.getDboSession().execute("UPDATE release SET added = (SELECT MIN(t.file_added) FROM track t WHERE t.release_id = release.id)");
+	}
+
+	// The progress of the pending data migration is saved after each chunk, so that a killed migration resumes from the last committed chunk
+	struct DataMigrationCheckpoint
+	{
+		std::size_t	step {};
+		IdType		lastId {};
+	};
+
+	static
+	std::optional<DataMigrationCheckpoint>
+	getDataMigrationCheckpoint(Session& session, Version version)
+	{
+		session.getDboSession().execute("CREATE TABLE IF NOT EXISTS migration_checkpoint (version INTEGER PRIMARY KEY, step INTEGER NOT NULL, last_id INTEGER NOT NULL)");
+
+		const auto rows {session.getDboSession().query<std::tuple<int, IdType>>("SELECT step, last_id FROM migration_checkpoint")
+			.where("version = ?").bind(static_cast<int>(version))
+			.resultList()};
+		for (const auto& [step, lastId] : rows)
+			return DataMigrationCheckpoint {static_cast<std::size_t>(step), lastId};
+
+		return std::nullopt;
+	}
+
+	static
+	void
+	setDataMigrationCheckpoint(Session& session, Version version, const DataMigrationCheckpoint& checkpoint)
+	{
+		session.getDboSession().execute("INSERT OR REPLACE INTO migration_checkpoint (version, step, last_id) VALUES (?, ?, ?)")
+			.bind(static_cast<int>(version))
+			.bind(static_cast<int>(checkpoint.step))
+			.bind(checkpoint.lastId);
+	}
+
+	static
+	void
+	runDataMigration(Session& session, Version version, const DataMigration& dataMigration)
+	{
+		// Small enough to keep each transaction (and the work lost on a kill) short
+		constexpr std::size_t chunkSize {1000};
+		constexpr std::chrono::seconds progressLogPeriod {5};
+
+		DataMigrationCheckpoint checkpoint;
+		{
+			auto uniqueTransaction {session.createUniqueTransaction()};
+			checkpoint = getDataMigrationCheckpoint(session, version).value_or(DataMigrationCheckpoint {});
+		}
+
+		for (; checkpoint.step < dataMigration.size(); checkpoint.step++, checkpoint.lastId = 0)
+		{
+			const DataMigrationStep& step {dataMigration[checkpoint.step]};
+
+			std::size_t totalCount {};
+			std::size_t processedCount {};
+			{
+				auto uniqueTransaction {session.createUniqueTransaction()};
+				totalCount = session.getDboSession().query<int>("SELECT COUNT(*) FROM " + std::string {step.table}).resultValue();
+				processedCount = session.getDboSession().query<int>("SELECT COUNT(*) FROM " + std::string {step.table}).where("id <= ?").bind(checkpoint.lastId).resultValue();
+			}
+
+			LMS_LOG(DB, INFO) << "Migrating table '" << step.table << "': " << processedCount << "/" << totalCount << " rows already done";
+
+			auto lastProgressLogTime {std::chrono::steady_clock::now()};
+			while (true)
+			{
+				ChunkResult chunkResult;
+				{
+					auto uniqueTransaction {session.createUniqueTransaction()};
+
+					chunkResult = step.processChunk(session, checkpoint.lastId, chunkSize);
+					if (chunkResult.rowCount > 0)
+					{
+						checkpoint.lastId = chunkResult.lastId;
+						setDataMigrationCheckpoint(session, version, checkpoint);
+					}
+				}
+
+				processedCount += chunkResult.rowCount;
+				if (chunkResult.rowCount < chunkSize)
+					break;
+
+				const auto now {std::chrono::steady_clock::now()};
+				if (now - lastProgressLogTime >= progressLogPeriod)
+				{
+					LMS_LOG(DB, INFO) << "Migrating table '" << step.table << "': " << processedCount << "/" << totalCount << " rows (" << (totalCount ? processedCount * 100 / totalCount : 100) << "%)";
+					lastProgressLogTime = now;
+				}
+			}
+
+			LMS_LOG(DB, INFO) << "Migrating table '" << step.table << "' DONE (" << processedCount << " rows)";
+		}
+	}
+
 	void
 	doDbMigration(Session& session)
 	{
@@ -588,44 +1012,116 @@ CREATE TABLE "listen" (
 			{30, migrateFromV30},
 			{31, migrateFromV31},
 			{32, migrateFromV32},
+			{33, migrateFromV33},
+			{34, migrateFromV34},
+			{35, migrateFromV35},
+			{36, migrateFromV36},
+			{37, migrateFromV37},
+			{38, migrateFromV38},
+			{39, migrateFromV39},
+			{40, migrateFromV40},
+			{41, migrateFromV41},
+			{42, migrateFromV42},
+			{43, migrateFromV43},
+			{44, migrateFromV44},
+			{45, migrateFromV45},
+			{46, migrateFromV46},
+			{47, migrateFromV47},
+			{48, migrateFromV48},
+			{49, migrateFromV49},
 		};
 
-		while (1)
+		// Run after the schema migration of the same version, using their own transactions
+		const std::map<unsigned, DataMigration> dataMigrations
 		{
-			auto uniqueTransaction {session.createUniqueTransaction()};
+			{47, {{"artist", migrateArtistSortKeysFromV47}, {"release", migrateReleaseSortKeysFromV47}}},
+		};
 
+		while (1)
+		{
 			Version version;
-			try
 			{
-				version = VersionInfo::getOrCreate(session)->getVersion();
-				LMS_LOG(DB, INFO) << "Database version = " << version << ", LMS binary version = " << LMS_DATABASE_VERSION;
-			}
-			catch (std::exception& e)
-			{
-				LMS_LOG(DB, ERROR) << "Cannot get database version info: " << e.what();
-				throw LmsException {outdatedMsg};
+				auto uniqueTransaction {session.createUniqueTransaction()};
+
+				try
+				{
+					version = VersionInfo::getOrCreate(session)->getVersion();
+					LMS_LOG(DB, INFO) << "Database version = " << version << ", LMS binary version = " << LMS_DATABASE_VERSION;
+				}
+				catch (std::exception& e)
+				{
+					LMS_LOG(DB, ERROR) << "Cannot get database version info: " << e.what();
+					throw LmsException {outdatedMsg};
+				}
+
+				if (version == LMS_DATABASE_VERSION)
+				{
+					LMS_LOG(DB, DEBUG) << "Lms database version " << LMS_DATABASE_VERSION << ": up to date!";
+					return;
+				}
+				else if (version > LMS_DATABASE_VERSION)
+				{
+					throw LmsException {"Server binary outdated, please upgrade it to handle this database"};
+				}
+
+				if (version < migrationFunctions.begin()->first)
+					throw LmsException {outdatedMsg};
+
+				const bool hasDataMigration {dataMigrations.find(version) != std::cend(dataMigrations)};
+
+				// The schema migration is committed along with the checkpoint: the data migration is just resumed if interrupted
+				if (hasDataMigration && getDataMigrationCheckpoint(session, version))
+				{
+					LMS_LOG(DB, INFO) << "Resuming database migration from version " << version << "...";
+				}
+				else
+				{
+					LMS_LOG(DB, INFO) << "Migrating database from version " << version << "...";
+
+					auto itMigrationFunc {migrationFunctions.find(version)};
+					assert(itMigrationFunc != std::cend(migrationFunctions));
+					itMigrationFunc->second(session);
+
+					if (!hasDataMigration)
+					{
+						VersionInfo::get(session).modify()->setVersion(++version);
+						continue;
+					}
+
+					setDataMigrationCheckpoint(session, version, DataMigrationCheckpoint {});
+				}
 			}
 
-			if (version == LMS_DATABASE_VERSION)
-			{
-				LMS_LOG(DB, DEBUG) << "Lms database version " << LMS_DATABASE_VERSION << ": up to date!";
-				return;
-			}
-			else if (version > LMS_DATABASE_VERSION)
-			{
-				throw LmsException {"Server binary outdated, please upgrade it to handle this database"};
-			}
+			runDataMigration(session, version, dataMigrations.at(version));
 
-			if (version < migrationFunctions.begin()->first)
-				throw LmsException {outdatedMsg};
+			{
+				auto uniqueTransaction {session.createUniqueTransaction()};
 
-			LMS_LOG(DB, INFO) << "Migrating database from version " << version << "...";
+				session.getDboSession().execute("DROP TABLE migration_checkpoint");
+				VersionInfo::get(session).modify()->setVersion(++version);
+			}
+		}
+	}
 
-			auto itMigrationFunc {migrationFunctions.find(version)};
-			assert(itMigrationFunc != std::cend(migrationFunctions));
-			itMigrationFunc->second(session);
+	void
+	checkDbVersion(Session& session)
+	{
+		auto transaction {session.createSharedTransaction()};
 
-			VersionInfo::get(session).modify()->setVersion(++version);
+		Version version {};
+		try
+		{
+			const VersionInfo::pointer versionInfo {VersionInfo::get(session)};
+			if (versionInfo)
+				version = versionInfo->getVersion();
 		}
+		catch (std::exception& e)
+		{
+			LMS_LOG(DB, ERROR) << "Cannot get database version info: " << e.what();
+		}
+
+		LMS_LOG(DB, INFO) << "Database version = " << version << ", LMS binary version = " << LMS_DATABASE_VERSION;
+		if (version != LMS_DATABASE_VERSION)
+			throw LmsException {"Database not prepared for this binary version, please start the primary instance first"};
 	}
 }
@@ -26,7 +26,7 @@ namespace Database
 	class Session;
 
 	using Version = std::size_t;
-	static constexpr Version LMS_DATABASE_VERSION {33};
+	static constexpr Version LMS_DATABASE_VERSION {50};
 	class VersionInfo
 	{
 		public:
@@ -51,5 +51,7 @@ namespace Database
 	namespace Migration
 	{
 		void doDbMigration(Session& session);
+		// Throws if the database has not been migrated up to the current version
+		void checkDbVersion(Session& session);
 	}
 }
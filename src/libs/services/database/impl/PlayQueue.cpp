@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "services/database/PlayQueue.hpp"
+
+#include <Wt/Dbo/WtSqlTraits.h>
+
+#include "services/database/Session.hpp"
+#include "services/database/TrackList.hpp"
+#include "services/database/User.hpp"
+#include "IdTypeTraits.hpp"
+#include "Utils.hpp"
+
+namespace Database {
+
+PlayQueue::PlayQueue(ObjectPtr<User> user, ObjectPtr<TrackList> trackList)
+: _user {getDboPtr(user)},
+_trackList {getDboPtr(trackList)}
+{
+}
+
+PlayQueue::pointer
+PlayQueue::create(Session& session, ObjectPtr<User> user, ObjectPtr<TrackList> trackList)
+{
+	session.checkUniqueLocked();
+
+	PlayQueue::pointer res {session.getDboSession().add(std::make_unique<PlayQueue>(user, trackList))};
+	session.getDboSession().flush();
+
+	return res;
+}
+
+std::size_t
+PlayQueue::getCount(Session& session)
+{
+	session.checkSharedLocked();
+
+	return session.getDboSession().query<int>("SELECT COUNT(*) FROM playqueue");
+}
+
+PlayQueue::pointer
+PlayQueue::find(Session& session, UserId userId)
+{
+	session.checkSharedLocked();
+
+	return session.getDboSession().find<PlayQueue>()
+		.where("user_id = ?").bind(userId)
+		.resultValue();
+}
+
+void
+PlayQueue::setLastModifiedDateTime(const Wt::WDateTime& dateTime)
+{
+	_lastModifiedDateTime = normalizeDateTime(dateTime);
+}
+
+} // namespace Database
+
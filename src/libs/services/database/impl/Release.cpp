@@ -19,16 +19,21 @@
 
 #include "services/database/Release.hpp"
 
+#include <tuple>
+#include <unordered_map>
 #include <Wt/Dbo/WtSqlTraits.h>
 
 #include "services/database/Artist.hpp"
 #include "services/database/Cluster.hpp"
+#include "services/database/Db.hpp"
 #include "services/database/Session.hpp"
 #include "services/database/Track.hpp"
 #include "services/database/User.hpp"
 #include "utils/Logger.hpp"
+#include "utils/String.hpp"
 #include "SqlQuery.hpp"
 #include "IdTypeTraits.hpp"
+#include "LibraryIndex.hpp"
 #include "Utils.hpp"
 
 namespace Database
@@ -49,6 +54,9 @@ createQuery(Session& session, const Release::FindParameters& params)
 	if (params.writtenAfter.isValid())
 		query.where("t.file_last_write > ?").bind(params.writtenAfter);
 
+	if (params.addedAfterGeneration)
+		query.where("r.added_generation > ?").bind(static_cast<long long>(*params.addedAfterGeneration));
+
 	if (params.dateRange)
 	{
 		query.where("t.date >= ?").bind(params.dateRange->begin);
@@ -56,7 +64,7 @@ createQuery(Session& session, const Release::FindParameters& params)
 	}
 
 	for (std::string_view keyword : params.keywords)
-		query.where("r.name LIKE ? ESCAPE '" ESCAPE_CHAR_STR "'").bind("%" + escapeLikeKeyword(keyword) + "%");
+		query.where(bindKeywordClause(session, query, "release", "r", "name", keyword));
 
 	if (params.starringUser.isValid())
 	{
@@ -92,7 +100,7 @@ createQuery(Session& session, const Release::FindParameters& params)
 		case ReleaseSortMethod::None:
 			break;
 		case ReleaseSortMethod::Name:
-			query.orderBy("r.name COLLATE NOCASE");
+			query.orderBy("r.name_sort_key");
 			break;
 		case ReleaseSortMethod::Random:
 			query.orderBy("RANDOM()");
@@ -100,8 +108,11 @@ createQuery(Session& session, const Release::FindParameters& params)
 		case ReleaseSortMethod::LastWritten:
 			query.orderBy("t.file_last_write DESC");
 			break;
+		case ReleaseSortMethod::AddedDesc:
+			query.orderBy("r.added_generation DESC, r.id DESC");
+			break;
 		case ReleaseSortMethod::Date:
-			query.orderBy("t.date, r.name COLLATE NOCASE");
+			query.orderBy("t.date, r.name_sort_key");
 			break;
 		case ReleaseSortMethod::StarredDateDesc:
 			assert(params.starringUser.isValid());
@@ -114,10 +125,18 @@ createQuery(Session& session, const Release::FindParameters& params)
 
 Release::Release(const std::string& name, const std::optional<UUID>& MBID)
 : _name {std::string(name, 0 , _maxNameLength)},
+_nameSortKey {StringUtils::computeSortKey(_name)},
 _MBID {MBID ? MBID->getAsString() : ""}
 {
 }
 
+void
+Release::setName(std::string_view name)
+{
+	_name = name;
+	_nameSortKey = StringUtils::computeSortKey(_name);
+}
+
 std::vector<Release::pointer>
 Release::find(Session& session, const std::string& name)
 {
@@ -153,6 +172,88 @@ Release::find(Session& session, ReleaseId id)
 					.resultValue();
 }
 
+std::vector<Release::pointer>
+Release::find(Session& session, const std::vector<ReleaseId>& ids)
+{
+	session.checkSharedLocked();
+
+	const auto releases {loadByIds<Release>(session.getDboSession(), ids)};
+	return std::vector<Release::pointer>(std::cbegin(releases), std::cend(releases));
+}
+
+static
+void
+visitArtistListEntries(Session& session, const std::vector<ReleaseId>& releaseIds, TrackArtistLinkType linkType, const std::function<void(ReleaseId, Artist::ListEntryResult&&)>& func)
+{
+	if (releaseIds.empty())
+		return;
+
+	using QueryResultType = std::tuple<ReleaseId, ArtistId, std::string, std::string>;
+
+	auto query {session.getDboSession().query<QueryResultType>(
+			"SELECT DISTINCT t.release_id, a.id, a.name, a.mbid FROM artist a"
+			" INNER JOIN track_artist_link t_a_l ON t_a_l.artist_id = a.id"
+			" INNER JOIN track t ON t.id = t_a_l.track_id")
+		.where("t.release_id IN (" + getInListPlaceholders(releaseIds.size()) + ")")};
+	bindInListValues(query, releaseIds);
+	query.where("t_a_l.type = ?").bind(linkType);
+
+	for (const auto& [releaseId, artistId, name, MBID] : query.resultList())
+		func(releaseId, Artist::ListEntryResult {artistId, name, UUID::fromString(MBID)});
+}
+
+std::vector<Release::ListEntryResult>
+Release::findListEntries(Session& session, const std::vector<ReleaseId>& ids)
+{
+	using QueryResultType = std::tuple<ReleaseId, std::string, std::string>;
+
+	session.checkSharedLocked();
+
+	std::unordered_map<ReleaseId, ListEntryResult> entries;
+
+	constexpr std::size_t batchSize {256};
+	for (std::size_t offset {}; offset < ids.size(); offset += batchSize)
+	{
+		const std::vector<ReleaseId> batchIds (std::cbegin(ids) + offset, std::cbegin(ids) + std::min(ids.size(), offset + batchSize));
+
+		auto query {session.getDboSession().query<QueryResultType>("SELECT r.id, r.name, r.mbid FROM release r")
+			.where("r.id IN (" + getInListPlaceholders(batchIds.size()) + ")")};
+		bindInListValues(query, batchIds);
+
+		for (const auto& [releaseId, name, MBID] : query.resultList())
+			entries.emplace(releaseId, ListEntryResult {releaseId, name, UUID::fromString(MBID), {}});
+
+		// release artists, or artists if there is none
+		visitArtistListEntries(session, batchIds, TrackArtistLinkType::ReleaseArtist, [&](ReleaseId releaseId, Artist::ListEntryResult&& artist)
+		{
+			entries[releaseId].artists.push_back(std::move(artist));
+		});
+
+		std::vector<ReleaseId> releaseIdsWithoutReleaseArtist;
+		for (const ReleaseId releaseId : batchIds)
+		{
+			auto itEntry {entries.find(releaseId)};
+			if (itEntry != std::cend(entries) && itEntry->second.artists.empty())
+				releaseIdsWithoutReleaseArtist.push_back(releaseId);
+		}
+		visitArtistListEntries(session, releaseIdsWithoutReleaseArtist, TrackArtistLinkType::Artist, [&](ReleaseId releaseId, Artist::ListEntryResult&& artist)
+		{
+			entries[releaseId].artists.push_back(std::move(artist));
+		});
+	}
+
+	std::vector<ListEntryResult> res;
+	res.reserve(entries.size());
+	for (const ReleaseId id : ids)
+	{
+		auto itEntry {entries.find(id)};
+		if (itEntry != std::cend(entries))
+			res.push_back(itEntry->second); // ids may contain duplicates
+	}
+
+	return res;
+}
+
 bool
 Release::exists(Session& session, ReleaseId id)
 {
@@ -190,7 +291,7 @@ Release::findOrderedByArtist(Session& session, Range range)
 			" INNER JOIN track t ON r.id = t.release_id"
 			" INNER JOIN track_artist_link t_a_l ON t_a_l.track_id = t.id"
 			" INNER JOIN artist a ON t_a_l.artist_id = a.id")
-		 .orderBy("a.name COLLATE NOCASE, r.name COLLATE NOCASE")};
+		 .orderBy("a.name_sort_key, r.name_sort_key")};
 
 	return execQuery(query, range);
 }
@@ -204,11 +305,49 @@ Release::findOrphans(Session& session, Range range)
 	return execQuery(query, range);
 }
 
+std::size_t
+Release::getOrphanCount(Session& session)
+{
+	session.checkSharedLocked();
+
+	return session.getDboSession().query<int>("SELECT COUNT(*) FROM release r WHERE NOT EXISTS(SELECT 1 FROM track t WHERE t.release_id = r.id)");
+}
+
+std::size_t
+Release::removeOrphans(Session& session, std::size_t maxCount)
+{
+	session.checkUniqueLocked();
+
+	// Make sure pending changes are written before bypassing Dbo
+	session.getDboSession().flush();
+
+	session.getDboSession().execute("DELETE FROM release WHERE id IN (SELECT r.id FROM release r WHERE NOT EXISTS(SELECT 1 FROM track t WHERE t.release_id = r.id) LIMIT ?)")
+		.bind(static_cast<int>(maxCount));
+
+	return session.getDboSession().query<int>("SELECT changes()");
+}
+
 RangeResults<ReleaseId>
 Release::find(Session& session, const FindParameters& params)
 {
 	session.checkSharedLocked();
 
+	if (const std::shared_ptr<const LibraryIndex> libraryIndex {session.getDb().getLibraryIndex()})
+	{
+		if (auto res {libraryIndex->find(params)})
+			return *res;
+	}
+
+	if (params.sortMethod == ReleaseSortMethod::Random)
+	{
+		FindParameters unsortedParams {params};
+		unsortedParams.setSortMethod(ReleaseSortMethod::None);
+
+		auto query {createQuery(session, unsortedParams)};
+		if (auto res {findRandomIds(session.getDboSession(), query, "release", "r.id", params.range)})
+			return *res;
+	}
+
 	auto query {createQuery(session, params)};
 
 	return execQuery(query, params.range);
@@ -238,50 +377,43 @@ Release::getTotalDisc(void) const
 	return (res > 0) ? std::make_optional<std::size_t>(res) : std::nullopt;
 }
 
-std::optional<int>
-Release::getReleaseYear(bool original) const
+Release::Summary
+Release::getSummary() const
 {
 	assert(session());
 
-	const char* field {original ? "original_date" : "date"};
-
-	auto dates {session()->query<Wt::WDate>(
-			std::string {"SELECT "} + "t." + field + " FROM track t INNER JOIN release r ON r.id = t.release_id")
-		.where("r.id = ?")
-		.groupBy(field)
-		.bind(getId())
-		.resultList()};
-
-	// various dates => no date
-	if (dates.empty() || dates.size() > 1)
-		return std::nullopt;
-
-	auto date {dates.front().year()};
+	using milli = std::chrono::duration<int, std::milli>;
 
-	if (date > 0)
-		return date;
+	// No summary yet if the release has never had any track
+	auto query {session()->query<std::tuple<int, milli, int, int, std::string>>(
+			"SELECT COALESCE(MAX(track_count), 0), COALESCE(MAX(duration), 0), COALESCE(MAX(year), 0), COALESCE(MAX(original_year), 0), COALESCE(MAX(copyright), '') FROM release_summary")
+		.where("release_id = ?").bind(getId())};
+	const auto [trackCount, duration, year, originalYear, copyright] {query.resultValue()};
+
+	Summary summary;
+	summary.trackCount = trackCount;
+	summary.duration = duration;
+	if (year > 0)
+		summary.year = year;
+	if (originalYear > 0)
+		summary.originalYear = originalYear;
+	if (!copyright.empty())
+		summary.copyright = copyright;
+
+	return summary;
+}
 
-	return std::nullopt;
+std::optional<int>
+Release::getReleaseYear(bool original) const
+{
+	const Summary summary {getSummary()};
+	return original ? summary.originalYear : summary.year;
 }
 
 std::optional<std::string>
 Release::getCopyright() const
 {
-	assert(session());
-
-	Wt::Dbo::collection<std::string> copyrights = session()->query<std::string>
-		("SELECT copyright FROM track t INNER JOIN release r ON r.id = t.release_id")
-		.where("r.id = ?")
-		.groupBy("copyright")
-		.bind(getId());
-
-	std::vector<std::string> values(copyrights.begin(), copyrights.end());
-
-	// various copyrights => no copyright
-	if (values.empty() || values.size() > 1 || values.front().empty())
-		return std::nullopt;
-
-	return values.front();
+	return getSummary().copyright;
 }
 
 std::optional<std::string>
@@ -321,6 +453,29 @@ Release::getArtists(TrackArtistLinkType linkType) const
 	return std::vector<Artist::pointer>(res.begin(), res.end());
 }
 
+void
+Release::visitArtists(Session& session, const std::vector<ReleaseId>& releaseIds, TrackArtistLinkType linkType, const std::function<void(ReleaseId, const Artist::pointer&)>& func)
+{
+	session.checkSharedLocked();
+
+	constexpr std::size_t batchSize {256};
+	for (std::size_t offset {}; offset < releaseIds.size(); offset += batchSize)
+	{
+		const std::vector<ReleaseId> batchIds (std::cbegin(releaseIds) + offset, std::cbegin(releaseIds) + std::min(releaseIds.size(), offset + batchSize));
+
+		auto query {session.getDboSession().query<std::tuple<ReleaseId, Wt::Dbo::ptr<Artist>>>(
+				"SELECT DISTINCT t.release_id, a FROM artist a"
+				" INNER JOIN track_artist_link t_a_l ON t_a_l.artist_id = a.id"
+				" INNER JOIN track t ON t.id = t_a_l.track_id")
+			.where("t.release_id IN (" + getInListPlaceholders(batchIds.size()) + ")")};
+		bindInListValues(query, batchIds);
+		query.where("t_a_l.type = ?").bind(linkType);
+
+		for (const auto& [releaseId, artist] : query.resultList())
+			func(releaseId, artist);
+	}
+}
+
 std::vector<Release::pointer>
 Release::getSimilarReleases(std::optional<std::size_t> offset, std::optional<std::size_t> count) const
 {
@@ -357,29 +512,33 @@ Release::getTracks(const std::vector<ClusterId>& clusterIds) const
 {
 	assert(session());
 
+	// Most common case: keep the query constant so that its prepared statement gets reused
+	if (clusterIds.empty())
+	{
+		auto res {session()->find<Track>()
+			.where("release_id = ?").bind(getId())
+			.orderBy("disc_number,track_number")
+			.resultList()};
+
+		return std::vector<Track::pointer> (res.begin(), res.end());
+	}
+
 	WhereClause where;
 
 	std::ostringstream oss;
 	oss << "SELECT t FROM track t INNER JOIN release r ON t.release_id = r.id";
+	oss << " INNER JOIN cluster c ON c.id = t_c.cluster_id INNER JOIN track_cluster t_c ON t_c.track_id = t.id";
 
-	if (!clusterIds.empty())
-	{
-		oss << " INNER JOIN cluster c ON c.id = t_c.cluster_id INNER JOIN track_cluster t_c ON t_c.track_id = t.id";
-
-		WhereClause clusterClause;
+	WhereClause clusterClause;
+	for (auto id : clusterIds)
+		clusterClause.Or(WhereClause("c.id = ?")).bind(id.toString());
 
-		for (auto id : clusterIds)
-			clusterClause.Or(WhereClause("c.id = ?")).bind(id.toString());
-
-		where.And(clusterClause);
-	}
+	where.And(clusterClause);
 
 	where.And(WhereClause("r.id = ?")).bind(getId().toString());
 
 	oss << " " << where.get();
-
-	if (!clusterIds.empty())
-		oss << " GROUP BY t.id HAVING COUNT(*) = " << clusterIds.size();
+	oss << " GROUP BY t.id HAVING COUNT(*) = " << clusterIds.size();
 
 	oss << " ORDER BY t.disc_number,t.track_number";
 
@@ -394,7 +553,7 @@ Release::getTracks(const std::vector<ClusterId>& clusterIds) const
 std::size_t
 Release::getTracksCount() const
 {
-	return _tracks.size();
+	return getSummary().trackCount;
 }
 
 Track::pointer
@@ -413,14 +572,7 @@ Release::getFirstTrack() const
 std::chrono::milliseconds
 Release::getDuration() const
 {
-	assert(session());
-
-	using milli = std::chrono::duration<int, std::milli>;
-
-	Wt::Dbo::Query<milli> query {session()->query<milli>("SELECT COALESCE(SUM(duration), 0) FROM track t INNER JOIN release r ON t.release_id = r.id")
-			.where("r.id = ?").bind(getId())};
-
-	return query.resultValue();
+	return getSummary().duration;
 }
 
 Wt::WDateTime
@@ -19,6 +19,8 @@
 
 #include "services/database/ScanSettings.hpp"
 
+#include <algorithm>
+
 #include <Wt/Dbo/WtSqlTraits.h>
 
 #include "utils/Path.hpp"
@@ -26,6 +28,7 @@
 #include "utils/String.hpp"
 
 #include "services/database/Cluster.hpp"
+#include "services/database/MediaRoot.hpp"
 #include "services/database/Session.hpp"
 
 namespace {
@@ -82,10 +85,53 @@ ScanSettings::getClusterTypes() const
 	return std::vector<ClusterType::pointer>(std::cbegin(_clusterTypes), std::cend(_clusterTypes));
 }
 
+std::vector<MediaRoot::pointer>
+ScanSettings::getMediaRoots() const
+{
+	std::vector<MediaRoot::pointer> res(std::cbegin(_mediaRoots), std::cend(_mediaRoots));
+	std::sort(std::begin(res), std::end(res), [](const MediaRoot::pointer& lhs, const MediaRoot::pointer& rhs) { return lhs->getDirectory() < rhs->getDirectory(); });
+
+	return res;
+}
+
 void
-ScanSettings::setMediaDirectory(const std::filesystem::path& p)
+ScanSettings::setMediaRoots(Session& session, const std::vector<MediaRootInfo>& mediaRoots)
 {
-	_mediaDirectory = StringUtils::stringTrimEnd(p.string(), "/\\");
+	session.checkUniqueLocked();
+
+	auto normalize {[](const std::filesystem::path& directory) { return std::filesystem::path {StringUtils::stringTrimEnd(directory.string(), "/\\")}; }};
+
+	for (const MediaRootInfo& mediaRootInfo : mediaRoots)
+	{
+		auto itMediaRoot {std::find_if(std::cbegin(_mediaRoots), std::cend(_mediaRoots),
+			[&](const Wt::Dbo::ptr<MediaRoot>& mediaRoot) { return mediaRoot->getDirectory() == normalize(mediaRootInfo.directory); })};
+
+		MediaRoot::pointer mediaRoot;
+		if (itMediaRoot != std::cend(_mediaRoots))
+		{
+			mediaRoot = *itMediaRoot;
+		}
+		else
+		{
+			LMS_LOG(DB, INFO) << "Creating media root " << mediaRootInfo.directory.string();
+			mediaRoot = MediaRoot::create(session, mediaRootInfo.directory);
+			_mediaRoots.insert(getDboPtr(mediaRoot));
+		}
+
+		if (mediaRoot->getAudioFileExtensions() != mediaRootInfo.audioFileExtensions)
+			mediaRoot.modify()->setAudioFileExtensions(mediaRootInfo.audioFileExtensions);
+	}
+
+	// Delete no longer existing roots
+	for (Wt::Dbo::ptr<MediaRoot> mediaRoot : _mediaRoots)
+	{
+		if (std::none_of(std::cbegin(mediaRoots), std::cend(mediaRoots),
+			[&](const MediaRootInfo& mediaRootInfo) { return normalize(mediaRootInfo.directory) == mediaRoot->getDirectory(); }))
+		{
+			LMS_LOG(DB, INFO) << "Deleting media root " << mediaRoot->getDirectory().string();
+			mediaRoot.remove();
+		}
+	}
 }
 
 template <typename It>
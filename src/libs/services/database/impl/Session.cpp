@@ -20,15 +20,25 @@
 #include "services/database/Session.hpp"
 
 #include <cassert>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "utils/Exception.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Tracing.hpp"
 
 #include "services/database/Artist.hpp"
 #include "services/database/AuthToken.hpp"
 #include "services/database/Cluster.hpp"
 #include "services/database/Db.hpp"
+#include "services/database/Directory.hpp"
 #include "services/database/Listen.hpp"
+#include "services/database/MediaRoot.hpp"
+#include "services/database/PlayQueue.hpp"
 #include "services/database/Release.hpp"
 #include "services/database/ScanSettings.hpp"
 #include "services/database/StarredArtist.hpp"
@@ -40,13 +50,326 @@
 #include "services/database/TrackList.hpp"
 #include "services/database/TrackFeatures.hpp"
 #include "services/database/User.hpp"
+#include "DbStatsCollector.hpp"
 #include "Migration.hpp"
 
 namespace Database
 {
 
-Session::Session(Db& db)
+namespace
+{
+	// used in debug checks, shared transactions may not take any lock
+	thread_local std::size_t sharedTransactionCount {};
+
+	// gauge of the session whose transaction was last created by this thread
+	thread_local Metrics::Gauge* currentObjectGauge {};
+
+	Metrics::Histogram&
+	getLockWaitHistogram(DbStatsCollector::LockType lockType)
+	{
+		static Metrics::Histogram& sharedLockWaits {Metrics::getRegistry().createHistogram("lms_db_lock_wait_duration_seconds", "Time spent waiting for the database lock", "type=\"shared\"")};
+		static Metrics::Histogram& uniqueLockWaits {Metrics::getRegistry().createHistogram("lms_db_lock_wait_duration_seconds", "Time spent waiting for the database lock", "type=\"unique\"")};
+
+		return lockType == DbStatsCollector::LockType::Shared ? sharedLockWaits : uniqueLockWaits;
+	}
+
+	template <typename Lock>
+	Lock
+	acquireLock(RecursiveSharedMutex& mutex, DbStatsCollector* statsCollector, DbStatsCollector::LockType lockType)
+	{
+		const auto start {std::chrono::steady_clock::now()};
+		Lock lock {mutex, std::defer_lock};
+		{
+			const Tracing::ScopedSpan span {"db.lock_wait"};
+			lock.lock();
+		}
+		const auto waitDuration {std::chrono::steady_clock::now() - start};
+
+		getLockWaitHistogram(lockType).observe(std::chrono::duration_cast<Metrics::Histogram::Duration>(waitDuration));
+		if (statsCollector)
+			statsCollector->addLockWait(lockType, waitDuration);
+
+		return lock;
+	}
+
+	bool
+	isSchemaObjectExisting(Wt::Dbo::Session& session, const std::string& name)
+	{
+		return session.query<int>("SELECT COUNT(*) FROM sqlite_master").where("name = ?").bind(name).resultValue() > 0;
+	}
+
+	std::string
+	joinColumns(const std::vector<std::string>& columns, std::string_view prefix)
+	{
+		std::string res;
+		for (const std::string& column : columns)
+		{
+			if (!res.empty())
+				res += ", ";
+			res += prefix;
+			res += column;
+		}
+		return res;
+	}
+
+	// External content FTS5 table (trigram tokenizer), kept in sync with the content table using triggers
+	// Tables recreated by migrations lose their triggers: the index is rebuilt whenever something had to be created
+	void
+	createFullTextIndex(Wt::Dbo::Session& session, const std::string& table, const std::vector<std::string>& columns)
+	{
+		const std::string ftsTable {table + "_fts"};
+		const std::string insertTrigger {ftsTable + "_insert"};
+		const std::string deleteTrigger {ftsTable + "_delete"};
+		const std::string updateTrigger {ftsTable + "_update"};
+
+		const bool needRebuild {!isSchemaObjectExisting(session, ftsTable)
+			|| !isSchemaObjectExisting(session, insertTrigger)
+			|| !isSchemaObjectExisting(session, deleteTrigger)
+			|| !isSchemaObjectExisting(session, updateTrigger)};
+
+		const std::string insertNew {"INSERT INTO " + ftsTable + "(rowid, " + joinColumns(columns, "") + ") VALUES (new.id, " + joinColumns(columns, "new.") + ");"};
+		const std::string deleteOld {"INSERT INTO " + ftsTable + "(" + ftsTable + ", rowid, " + joinColumns(columns, "") + ") VALUES ('delete', old.id, " + joinColumns(columns, "old.") + ");"};
+
+		std::string updateCondition;
+		for (const std::string& column : columns)
+		{
+			if (!updateCondition.empty())
+				updateCondition += " OR ";
+			updateCondition += "old." + column + " IS NOT new." + column;
+		}
+
+		session.execute("CREATE VIRTUAL TABLE IF NOT EXISTS " + ftsTable + " USING fts5(" + joinColumns(columns, "") + ", content='" + table + "', content_rowid='id', tokenize='trigram')");
+		session.execute("CREATE TRIGGER IF NOT EXISTS " + insertTrigger + " AFTER INSERT ON " + table + " BEGIN " + insertNew + " END");
+		session.execute("CREATE TRIGGER IF NOT EXISTS " + deleteTrigger + " AFTER DELETE ON " + table + " BEGIN " + deleteOld + " END");
+		session.execute("CREATE TRIGGER IF NOT EXISTS " + updateTrigger + " AFTER UPDATE OF " + joinColumns(columns, "") + " ON " + table + " WHEN " + updateCondition + " BEGIN " + deleteOld + " " + insertNew + " END");
+
+		if (needRebuild)
+		{
+			LMS_LOG(DB, INFO) << "Building full text index for table '" << table << "'...";
+			session.execute("INSERT INTO " + ftsTable + "(" + ftsTable + ") VALUES ('rebuild')");
+		}
+	}
+
+	// The index may have been created using a SQLite library that supports it: its triggers would make the writes fail
+	// The index is rebuilt once supported again, since its triggers are missing
+	void
+	removeFullTextIndexTriggers(Wt::Dbo::Session& session, const std::string& table)
+	{
+		const std::string ftsTable {table + "_fts"};
+
+		session.execute("DROP TRIGGER IF EXISTS " + ftsTable + "_insert");
+		session.execute("DROP TRIGGER IF EXISTS " + ftsTable + "_delete");
+		session.execute("DROP TRIGGER IF EXISTS " + ftsTable + "_update");
+	}
+
+	// Per user, scrobbler and track listen count and last listen date time, kept in sync with the listen table using triggers
+	// Also account for the listens compacted into listen_period_stats (see Listen::compact)
+	// Like full text indexes, stats are computed again whenever something had to be created
+	void
+	createTrackListenStats(Wt::Dbo::Session& session)
+	{
+		session.execute(R"(CREATE TABLE IF NOT EXISTS listen_period_stats(
+			user_id BIGINT NOT NULL REFERENCES user(id) ON DELETE CASCADE,
+			scrobbler INTEGER NOT NULL,
+			period TEXT NOT NULL,
+			track_id BIGINT NOT NULL REFERENCES track(id) ON DELETE CASCADE,
+			listen_count INTEGER NOT NULL,
+			last_date_time TEXT,
+			PRIMARY KEY(user_id, scrobbler, period, track_id)))");
+		session.execute("CREATE INDEX IF NOT EXISTS listen_period_stats_track_idx ON listen_period_stats(track_id)");
+		session.execute("CREATE INDEX IF NOT EXISTS listen_period_stats_user_scrobbler_track_idx ON listen_period_stats(user_id, scrobbler, track_id)");
+
+		const bool needRebuild {!isSchemaObjectExisting(session, "track_listen_stats")
+			|| !isSchemaObjectExisting(session, "track_listen_stats_insert")
+			|| !isSchemaObjectExisting(session, "track_listen_stats_delete")
+			|| !isSchemaObjectExisting(session, "track_listen_stats_update")};
+
+		session.execute(R"(CREATE TABLE IF NOT EXISTS track_listen_stats(
+			user_id BIGINT NOT NULL REFERENCES user(id) ON DELETE CASCADE,
+			scrobbler INTEGER NOT NULL,
+			track_id BIGINT NOT NULL REFERENCES track(id) ON DELETE CASCADE,
+			listen_count INTEGER NOT NULL,
+			last_date_time TEXT,
+			PRIMARY KEY(user_id, scrobbler, track_id)))");
+		session.execute("CREATE INDEX IF NOT EXISTS track_listen_stats_track_idx ON track_listen_stats(track_id)");
+
+		const std::string addNew {R"(INSERT INTO track_listen_stats(user_id, scrobbler, track_id, listen_count, last_date_time) VALUES (new.user_id, new.scrobbler, new.track_id, 1, new.date_time)
+			ON CONFLICT(user_id, scrobbler, track_id) DO UPDATE SET listen_count = listen_count + 1, last_date_time = MAX(last_date_time, excluded.last_date_time);)"};
+		const std::string removeOld {R"(UPDATE track_listen_stats SET listen_count = listen_count - 1,
+				last_date_time = (SELECT MAX(date_time) FROM (SELECT l.date_time FROM listen l WHERE l.user_id = old.user_id AND l.scrobbler = old.scrobbler AND l.track_id = old.track_id
+					UNION ALL SELECT l_p_s.last_date_time FROM listen_period_stats l_p_s WHERE l_p_s.user_id = old.user_id AND l_p_s.scrobbler = old.scrobbler AND l_p_s.track_id = old.track_id))
+				WHERE user_id = old.user_id AND scrobbler = old.scrobbler AND track_id = old.track_id;
+			DELETE FROM track_listen_stats WHERE user_id = old.user_id AND scrobbler = old.scrobbler AND track_id = old.track_id AND listen_count <= 0;)"};
+
+		session.execute("CREATE TRIGGER IF NOT EXISTS track_listen_stats_insert AFTER INSERT ON listen BEGIN " + addNew + " END");
+		session.execute("CREATE TRIGGER IF NOT EXISTS track_listen_stats_delete AFTER DELETE ON listen BEGIN " + removeOld + " END");
+		session.execute("CREATE TRIGGER IF NOT EXISTS track_listen_stats_update AFTER UPDATE OF user_id, scrobbler, track_id, date_time ON listen"
+				" WHEN old.user_id IS NOT new.user_id OR old.scrobbler IS NOT new.scrobbler OR old.track_id IS NOT new.track_id OR old.date_time IS NOT new.date_time"
+				" BEGIN " + removeOld + " " + addNew + " END");
+
+		if (needRebuild)
+		{
+			LMS_LOG(DB, INFO) << "Computing listen stats...";
+			session.execute("DELETE FROM track_listen_stats");
+			session.execute("INSERT INTO track_listen_stats(user_id, scrobbler, track_id, listen_count, last_date_time)"
+					" SELECT user_id, scrobbler, track_id, SUM(listen_count), MAX(date_time) FROM ("
+					"  SELECT user_id, scrobbler, track_id, 1 AS listen_count, date_time FROM listen"
+					"  UNION ALL SELECT user_id, scrobbler, track_id, listen_count, last_date_time FROM listen_period_stats)"
+					" GROUP BY user_id, scrobbler, track_id");
+		}
+	}
+
+	// Per release track count, duration, year and copyright, kept in sync with the track table using triggers
+	// Like listen stats, summaries are computed again whenever something had to be created
+	void
+	createReleaseSummaries(Wt::Dbo::Session& session)
+	{
+		const bool needRebuild {!isSchemaObjectExisting(session, "release_summary")
+			|| !isSchemaObjectExisting(session, "release_summary_insert")
+			|| !isSchemaObjectExisting(session, "release_summary_delete")
+			|| !isSchemaObjectExisting(session, "release_summary_update")};
+
+		session.execute(R"(CREATE TABLE IF NOT EXISTS release_summary(
+			release_id BIGINT NOT NULL PRIMARY KEY REFERENCES release(id) ON DELETE CASCADE,
+			track_count INTEGER NOT NULL,
+			duration INTEGER NOT NULL,
+			year INTEGER,
+			original_year INTEGER,
+			copyright TEXT))");
+
+		// various dates or copyrights => no date or copyright
+		const std::string summarySelect {R"(SELECT r.id, COUNT(t.id), COALESCE(SUM(t.duration), 0),
+				CASE WHEN COUNT(DISTINCT COALESCE(t.date, '')) = 1 THEN CAST(SUBSTR(MAX(t.date), 1, 4) AS INTEGER) END,
+				CASE WHEN COUNT(DISTINCT COALESCE(t.original_date, '')) = 1 THEN CAST(SUBSTR(MAX(t.original_date), 1, 4) AS INTEGER) END,
+				CASE WHEN COUNT(DISTINCT t.copyright) = 1 THEN MAX(t.copyright) END
+			FROM release r LEFT JOIN track t ON t.release_id = r.id)"};
+		const auto refresh {[&](std::string_view releaseId)
+		{
+			return "INSERT OR REPLACE INTO release_summary(release_id, track_count, duration, year, original_year, copyright) " + summarySelect + " WHERE r.id = " + std::string {releaseId} + " GROUP BY r.id;";
+		}};
+
+		session.execute("CREATE TRIGGER IF NOT EXISTS release_summary_insert AFTER INSERT ON track BEGIN " + refresh("new.release_id") + " END");
+		session.execute("CREATE TRIGGER IF NOT EXISTS release_summary_delete AFTER DELETE ON track BEGIN " + refresh("old.release_id") + " END");
+		session.execute("CREATE TRIGGER IF NOT EXISTS release_summary_update AFTER UPDATE OF release_id, duration, date, original_date, copyright ON track"
+				" WHEN old.release_id IS NOT new.release_id OR old.duration IS NOT new.duration OR old.date IS NOT new.date OR old.original_date IS NOT new.original_date OR old.copyright IS NOT new.copyright"
+				" BEGIN " + refresh("old.release_id") + " " + refresh("new.release_id") + " END");
+
+		if (needRebuild)
+		{
+			LMS_LOG(DB, INFO) << "Computing release summaries...";
+			session.execute("DELETE FROM release_summary");
+			session.execute("INSERT INTO release_summary(release_id, track_count, duration, year, original_year, copyright) " + summarySelect + " GROUP BY r.id");
+		}
+	}
+
+	// Per tracklist entry count and duration, kept in sync with the tracklist_entry and track tables using triggers
+	// Deleted tracks are accounted before their entries get removed by the cascade
+	void
+	createTrackListSummaries(Wt::Dbo::Session& session)
+	{
+		const bool needRebuild {!isSchemaObjectExisting(session, "tracklist_summary")
+			|| !isSchemaObjectExisting(session, "tracklist_summary_insert")
+			|| !isSchemaObjectExisting(session, "tracklist_summary_delete")
+			|| !isSchemaObjectExisting(session, "tracklist_summary_update")
+			|| !isSchemaObjectExisting(session, "tracklist_summary_track_update")
+			|| !isSchemaObjectExisting(session, "tracklist_summary_track_delete")};
+
+		session.execute(R"(CREATE TABLE IF NOT EXISTS tracklist_summary(
+			tracklist_id BIGINT NOT NULL PRIMARY KEY REFERENCES tracklist(id) ON DELETE CASCADE,
+			track_count INTEGER NOT NULL,
+			duration INTEGER NOT NULL))");
+
+		const std::string addNew {R"(INSERT INTO tracklist_summary(tracklist_id, track_count, duration) SELECT new.tracklist_id, 1, COALESCE((SELECT duration FROM track WHERE id = new.track_id), 0) WHERE new.tracklist_id IS NOT NULL
+			ON CONFLICT(tracklist_id) DO UPDATE SET track_count = track_count + 1, duration = duration + excluded.duration;)"};
+		const std::string removeOld {R"(UPDATE tracklist_summary SET track_count = track_count - 1, duration = duration - COALESCE((SELECT duration FROM track WHERE id = old.track_id), 0)
+			WHERE tracklist_id = old.tracklist_id;)"};
+		const std::string trackEntryCount {"(SELECT COUNT(*) FROM tracklist_entry p_e WHERE p_e.tracklist_id = tracklist_summary.tracklist_id AND p_e.track_id = old.id)"};
+		const std::string trackTrackLists {"tracklist_id IN (SELECT tracklist_id FROM tracklist_entry WHERE track_id = old.id)"};
+
+		session.execute("CREATE TRIGGER IF NOT EXISTS tracklist_summary_insert AFTER INSERT ON tracklist_entry BEGIN " + addNew + " END");
+		session.execute("CREATE TRIGGER IF NOT EXISTS tracklist_summary_delete AFTER DELETE ON tracklist_entry BEGIN " + removeOld + " END");
+		session.execute("CREATE TRIGGER IF NOT EXISTS tracklist_summary_update AFTER UPDATE OF tracklist_id, track_id ON tracklist_entry"
+				" WHEN old.tracklist_id IS NOT new.tracklist_id OR old.track_id IS NOT new.track_id"
+				" BEGIN " + removeOld + " " + addNew + " END");
+		session.execute("CREATE TRIGGER IF NOT EXISTS tracklist_summary_track_update AFTER UPDATE OF duration ON track WHEN old.duration IS NOT new.duration"
+				" BEGIN UPDATE tracklist_summary SET duration = duration + (new.duration - old.duration) * " + trackEntryCount + " WHERE " + trackTrackLists + "; END");
+		session.execute("CREATE TRIGGER IF NOT EXISTS tracklist_summary_track_delete BEFORE DELETE ON track"
+				" BEGIN UPDATE tracklist_summary SET duration = duration - old.duration * " + trackEntryCount + " WHERE " + trackTrackLists + "; END");
+
+		if (needRebuild)
+		{
+			LMS_LOG(DB, INFO) << "Computing tracklist summaries...";
+			session.execute("DELETE FROM tracklist_summary");
+			session.execute("INSERT INTO tracklist_summary(tracklist_id, track_count, duration)"
+					" SELECT p_e.tracklist_id, COUNT(*), COALESCE(SUM(t.duration), 0) FROM tracklist_entry p_e LEFT JOIN track t ON t.id = p_e.track_id GROUP BY p_e.tracklist_id");
+		}
+	}
+
+	// Per artist and link type release and track counts, refreshed by the scanner (see Artist::updateSummaries)
+	// Triggers only keep track of the artists whose tracks changed: computing the counts again on each change would be too costly for artists with many tracks
+	void
+	createArtistSummaries(Wt::Dbo::Session& session)
+	{
+		const bool needRebuild {!isSchemaObjectExisting(session, "artist_summary")
+			|| !isSchemaObjectExisting(session, "artist_summary_dirty")
+			|| !isSchemaObjectExisting(session, "artist_summary_link_insert")
+			|| !isSchemaObjectExisting(session, "artist_summary_link_delete")
+			|| !isSchemaObjectExisting(session, "artist_summary_link_update")
+			|| !isSchemaObjectExisting(session, "artist_summary_track_update")};
+
+		session.execute(R"(CREATE TABLE IF NOT EXISTS artist_summary(
+			artist_id BIGINT NOT NULL REFERENCES artist(id) ON DELETE CASCADE,
+			link_type INTEGER NOT NULL,
+			release_count INTEGER NOT NULL,
+			track_count INTEGER NOT NULL,
+			PRIMARY KEY(artist_id, link_type)))");
+		session.execute(R"(CREATE TABLE IF NOT EXISTS artist_summary_dirty(
+			artist_id BIGINT NOT NULL PRIMARY KEY REFERENCES artist(id) ON DELETE CASCADE))");
+
+		// links are also removed along with their artist
+		const auto markChanged {[](std::string_view artistId)
+		{
+			return "INSERT OR IGNORE INTO artist_summary_dirty(artist_id) SELECT " + std::string {artistId} + " WHERE EXISTS (SELECT 1 FROM artist WHERE id = " + std::string {artistId} + ");";
+		}};
+
+		session.execute("CREATE TRIGGER IF NOT EXISTS artist_summary_link_insert AFTER INSERT ON track_artist_link BEGIN " + markChanged("new.artist_id") + " END");
+		session.execute("CREATE TRIGGER IF NOT EXISTS artist_summary_link_delete AFTER DELETE ON track_artist_link BEGIN " + markChanged("old.artist_id") + " END");
+		session.execute("CREATE TRIGGER IF NOT EXISTS artist_summary_link_update AFTER UPDATE OF artist_id, track_id, type ON track_artist_link"
+				" BEGIN " + markChanged("old.artist_id") + " " + markChanged("new.artist_id") + " END");
+		session.execute("CREATE TRIGGER IF NOT EXISTS artist_summary_track_update AFTER UPDATE OF release_id ON track WHEN old.release_id IS NOT new.release_id"
+				" BEGIN INSERT OR IGNORE INTO artist_summary_dirty(artist_id) SELECT artist_id FROM track_artist_link WHERE track_id = new.id; END");
+
+		if (needRebuild)
+		{
+			LMS_LOG(DB, INFO) << "Computing artist summaries...";
+			session.execute("DELETE FROM artist_summary");
+			session.execute("INSERT OR IGNORE INTO artist_summary_dirty(artist_id) SELECT id FROM artist");
+		}
+	}
+}
+
+namespace details
+{
+	Metrics::Gauge*
+	acquireObjectGauge()
+	{
+		if (currentObjectGauge)
+			currentObjectGauge->add();
+
+		return currentObjectGauge;
+	}
+
+	void
+	releaseObjectGauge(Metrics::Gauge* gauge)
+	{
+		if (gauge)
+			gauge->sub();
+	}
+}
+
+Session::Session(Db& db, std::string_view name)
 : _db {db}
+, _objectGauge {Metrics::getRegistry().createGauge("lms_db_session_objects", "Number of database objects loaded by a session and still referenced", "session=\"" + std::string {name} + "\"")}
 {
 	_session.setConnectionPool(_db.getConnectionPool());
 
@@ -55,7 +378,10 @@ Session::Session(Db& db)
 	_session.mapClass<AuthToken>("auth_token");
 	_session.mapClass<Cluster>("cluster");
 	_session.mapClass<ClusterType>("cluster_type");
+	_session.mapClass<Directory>("directory");
 	_session.mapClass<Listen>("listen");
+	_session.mapClass<MediaRoot>("media_root");
+	_session.mapClass<PlayQueue>("playqueue");
 	_session.mapClass<Release>("release");
 	_session.mapClass<ScanSettings>("scan_settings");
 	_session.mapClass<StarredArtist>("starred_artist");
@@ -70,16 +396,22 @@ Session::Session(Db& db)
 	_session.mapClass<User>("user");
 }
 
-UniqueTransaction::UniqueTransaction(RecursiveSharedMutex& mutex, Wt::Dbo::Session& session)
-: _lock {mutex},
+UniqueTransaction::UniqueTransaction(RecursiveSharedMutex& mutex, Wt::Dbo::Session& session, DbStatsCollector* statsCollector)
+: _lock {acquireLock<std::unique_lock<RecursiveSharedMutex>>(mutex, statsCollector, DbStatsCollector::LockType::Unique)},
  _transaction {session}
 {
 }
 
-SharedTransaction::SharedTransaction(RecursiveSharedMutex& mutex, Wt::Dbo::Session& session)
-: _lock {mutex},
+SharedTransaction::SharedTransaction(RecursiveSharedMutex* mutex, Wt::Dbo::Session& session, DbStatsCollector* statsCollector)
+: _lock {mutex ? acquireLock<std::shared_lock<RecursiveSharedMutex>>(*mutex, statsCollector, DbStatsCollector::LockType::Shared) : std::shared_lock<RecursiveSharedMutex> {}},
  _transaction {session}
 {
+	sharedTransactionCount++;
+}
+
+SharedTransaction::~SharedTransaction()
+{
+	sharedTransactionCount--;
 }
 
 void
@@ -91,24 +423,30 @@ Session::checkUniqueLocked()
 void
 Session::checkSharedLocked()
 {
-	assert(_db.getMutex().isSharedLocked());
+	assert(_db.getMutex().isSharedLocked() || sharedTransactionCount > 0);
 }
 
 UniqueTransaction
 Session::createUniqueTransaction()
 {
-	return UniqueTransaction {_db.getMutex(), _session};
+	currentObjectGauge = &_objectGauge;
+	return UniqueTransaction {_db.getMutex(), _session, _db.getStatsCollector()};
 }
 
 SharedTransaction
 Session::createSharedTransaction()
 {
-	return SharedTransaction {_db.getMutex(), _session};
+	currentObjectGauge = &_objectGauge;
+	// In SQLite mode, readers work on WAL snapshots: only writers need to be serialized
+	return SharedTransaction {_db.getConcurrencyMode() == Db::ConcurrencyMode::ApplicationLock ? &_db.getMutex() : nullptr, _session, _db.getStatsCollector()};
 }
 
 void
 Session::prepareTables()
 {
+	// Before creating the tables: nothing to rewrite on new databases
+	_db.enableIncrementalVacuum();
+
 	// Creation case
 	try
 	{
@@ -127,7 +465,8 @@ Session::prepareTables()
 	{
 		auto uniqueTransaction {createUniqueTransaction()};
 		_session.execute("CREATE INDEX IF NOT EXISTS artist_name_idx ON artist(name)");
-		_session.execute("CREATE INDEX IF NOT EXISTS artist_sort_name_nocase_idx ON artist(sort_name COLLATE NOCASE)");
+		_session.execute("CREATE INDEX IF NOT EXISTS artist_name_sort_key_idx ON artist(name_sort_key)");
+		_session.execute("CREATE INDEX IF NOT EXISTS artist_sort_name_sort_key_idx ON artist(sort_name_sort_key)");
 		_session.execute("CREATE INDEX IF NOT EXISTS artist_mbid_idx ON artist(mbid)");
 		_session.execute("CREATE INDEX IF NOT EXISTS auth_token_user_idx ON auth_token(user_id)");
 		_session.execute("CREATE INDEX IF NOT EXISTS auth_token_expiry_idx ON auth_token(expiry)");
@@ -135,20 +474,26 @@ Session::prepareTables()
 		_session.execute("CREATE INDEX IF NOT EXISTS cluster_name_idx ON cluster(name)");
 		_session.execute("CREATE INDEX IF NOT EXISTS cluster_cluster_type_idx ON cluster(cluster_type_id)");
 		_session.execute("CREATE INDEX IF NOT EXISTS cluster_type_name_idx ON cluster_type(name)");
+		_session.execute("CREATE INDEX IF NOT EXISTS directory_path_idx ON directory(path)");
+		_session.execute("CREATE INDEX IF NOT EXISTS directory_parent_name_idx ON directory(parent_id,name)");
 		_session.execute("CREATE INDEX IF NOT EXISTS release_name_idx ON release(name)");
-		_session.execute("CREATE INDEX IF NOT EXISTS release_name_nocase_idx ON release(name COLLATE NOCASE)");
 		_session.execute("CREATE INDEX IF NOT EXISTS release_mbid_idx ON release(mbid)");
+		_session.execute("CREATE INDEX IF NOT EXISTS release_name_sort_key_idx ON release(name_sort_key)");
+		_session.execute("CREATE INDEX IF NOT EXISTS release_added_generation_idx ON release(added_generation, id)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_file_last_write_idx ON track(file_last_write)");
-		_session.execute("CREATE INDEX IF NOT EXISTS track_path_idx ON track(file_path)");
+		_session.execute("CREATE INDEX IF NOT EXISTS track_added_generation_idx ON track(added_generation, id)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_name_idx ON track(name)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_name_nocase_idx ON track(name COLLATE NOCASE)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_mbid_idx ON track(mbid)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_recording_mbid_idx ON track(recording_mbid)");
-		_session.execute("CREATE INDEX IF NOT EXISTS track_release_idx ON track(release_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS track_release_disc_track_idx ON track(release_id,disc_number,track_number)");
+		_session.execute("CREATE INDEX IF NOT EXISTS track_directory_file_name_idx ON track(directory_id,file_name)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_date_idx ON track(date)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_original_date_idx ON track(original_date)");
 		_session.execute("CREATE INDEX IF NOT EXISTS tracklist_name_idx ON tracklist(name)");
 		_session.execute("CREATE INDEX IF NOT EXISTS tracklist_user_idx ON tracklist(user_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS tracklist_entry_tracklist_idx ON tracklist_entry(tracklist_id,id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS tracklist_entry_track_idx ON tracklist_entry(track_id)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_features_track_idx ON track_features(track_id)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_artist_link_artist_idx ON track_artist_link(artist_id)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_artist_link_name_idx ON track_artist_link(name)");
@@ -156,11 +501,51 @@ Session::prepareTables()
 		_session.execute("CREATE INDEX IF NOT EXISTS track_artist_link_type_idx ON track_artist_link(type)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_bookmark_user_idx ON track_bookmark(user_id)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_bookmark_user_track_idx ON track_bookmark(user_id,track_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS playqueue_user_idx ON playqueue(user_id)");
 		_session.execute("CREATE INDEX IF NOT EXISTS listen_scrobbler_idx ON listen(scrobbler)");
-		_session.execute("CREATE INDEX IF NOT EXISTS listen_user_scrobbler_idx ON listen(user_id,scrobbler)");
-		_session.execute("CREATE INDEX IF NOT EXISTS starred_artist_user_scrobbler_idx ON starred_artist(user_id,scrobbler)");
-		_session.execute("CREATE INDEX IF NOT EXISTS starred_release_user_scrobbler_idx ON starred_release(user_id,scrobbler)");
-		_session.execute("CREATE INDEX IF NOT EXISTS starred_track_user_scrobbler_idx ON starred_track(user_id,scrobbler)");
+		_session.execute("CREATE INDEX IF NOT EXISTS listen_user_scrobbler_date_time_idx ON listen(user_id,scrobbler,date_time)");
+		_session.execute("CREATE INDEX IF NOT EXISTS listen_user_scrobbler_track_date_time_idx ON listen(user_id,scrobbler,track_id,date_time)");
+		_session.execute("CREATE INDEX IF NOT EXISTS starred_artist_user_scrobbler_date_time_idx ON starred_artist(user_id,scrobbler,date_time,artist_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS starred_release_user_scrobbler_date_time_idx ON starred_release(user_id,scrobbler,date_time,release_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS starred_track_user_scrobbler_date_time_idx ON starred_track(user_id,scrobbler,date_time,track_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS track_cluster_cluster_track_idx ON track_cluster(cluster_id,track_id)");
+	}
+
+	// Full text indexes, used by keyword searches if supported (see bindKeywordClause)
+	{
+		auto uniqueTransaction {createUniqueTransaction()};
+
+		if (_db.isFullTextIndexUsable())
+		{
+			createFullTextIndex(_session, "artist", {"name", "sort_name"});
+			createFullTextIndex(_session, "release", {"name"});
+			createFullTextIndex(_session, "track", {"name"});
+		}
+		else
+		{
+			removeFullTextIndexTriggers(_session, "artist");
+			removeFullTextIndexTriggers(_session, "release");
+			removeFullTextIndexTriggers(_session, "track");
+		}
+	}
+
+	// Listen stats, used by top and recent queries
+	{
+		auto uniqueTransaction {createUniqueTransaction()};
+
+		createTrackListenStats(_session);
+	}
+
+	// Release, tracklist and artist summaries, used when listing them
+	{
+		auto uniqueTransaction {createUniqueTransaction()};
+
+		createReleaseSummaries(_session);
+		createTrackListSummaries(_session);
+		createArtistSummaries(_session);
+
+		// also completes the refresh of the scans that have been interrupted
+		Artist::updateSummaries(*this, std::numeric_limits<std::size_t>::max());
 	}
 
 	// Initial settings tables
@@ -171,6 +556,12 @@ Session::prepareTables()
 	}
 }
 
+void
+Session::checkTables()
+{
+	Migration::checkDbVersion(*this);
+}
+
 void
 Session::optimize()
 {
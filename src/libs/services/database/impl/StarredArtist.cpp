@@ -60,6 +60,22 @@ namespace Database
 			.resultValue();
 	}
 
+	std::string
+	StarredArtist::getUserSignature(Session& session, UserId userId, Scrobbler scrobbler)
+	{
+		session.checkSharedLocked();
+		return session.getDboSession().query<std::string>("SELECT COUNT(*) || '/' || COALESCE(MAX(date_time), '') FROM starred_artist")
+			.where("user_id = ?").bind(userId)
+			.where("scrobbler = ?").bind(scrobbler);
+	}
+
+	std::vector<ArtistId>
+	StarredArtist::findIds(Session& session, UserId userId, Scrobbler scrobbler)
+	{
+		session.checkSharedLocked();
+		return findStarredIds<ArtistId>(session.getDboSession(), "artist", userId, scrobbler);
+	}
+
 	StarredArtist::pointer
 	StarredArtist::create(Session& session, ObjectPtr<Artist> artist, ObjectPtr<User> user, Scrobbler scrobbler)
 	{
@@ -71,6 +87,20 @@ namespace Database
 		return res;
 	}
 
+	void
+	StarredArtist::setStarred(Session& session, UserId userId, Scrobbler scrobbler, const std::vector<ArtistId>& artistIds, const Wt::WDateTime& dateTime)
+	{
+		session.checkUniqueLocked();
+		Database::setStarred(session.getDboSession(), "artist", userId, scrobbler, artistIds, dateTime);
+	}
+
+	void
+	StarredArtist::unsetStarred(Session& session, UserId userId, Scrobbler scrobbler, const std::vector<ArtistId>& artistIds)
+	{
+		session.checkUniqueLocked();
+		Database::unsetStarred(session.getDboSession(), "artist", userId, scrobbler, artistIds);
+	}
+
 	void
 	StarredArtist::setDateTime(const Wt::WDateTime& dateTime)
 	{
@@ -60,6 +60,22 @@ namespace Database
 			.resultValue();
 	}
 
+	std::string
+	StarredRelease::getUserSignature(Session& session, UserId userId, Scrobbler scrobbler)
+	{
+		session.checkSharedLocked();
+		return session.getDboSession().query<std::string>("SELECT COUNT(*) || '/' || COALESCE(MAX(date_time), '') FROM starred_release")
+			.where("user_id = ?").bind(userId)
+			.where("scrobbler = ?").bind(scrobbler);
+	}
+
+	std::vector<ReleaseId>
+	StarredRelease::findIds(Session& session, UserId userId, Scrobbler scrobbler)
+	{
+		session.checkSharedLocked();
+		return findStarredIds<ReleaseId>(session.getDboSession(), "release", userId, scrobbler);
+	}
+
 	StarredRelease::pointer
 	StarredRelease::create(Session& session, ObjectPtr<Release> release, ObjectPtr<User> user, Scrobbler scrobbler)
 	{
@@ -71,6 +87,20 @@ namespace Database
 		return res;
 	}
 
+	void
+	StarredRelease::setStarred(Session& session, UserId userId, Scrobbler scrobbler, const std::vector<ReleaseId>& releaseIds, const Wt::WDateTime& dateTime)
+	{
+		session.checkUniqueLocked();
+		Database::setStarred(session.getDboSession(), "release", userId, scrobbler, releaseIds, dateTime);
+	}
+
+	void
+	StarredRelease::unsetStarred(Session& session, UserId userId, Scrobbler scrobbler, const std::vector<ReleaseId>& releaseIds)
+	{
+		session.checkUniqueLocked();
+		Database::unsetStarred(session.getDboSession(), "release", userId, scrobbler, releaseIds);
+	}
+
 	void
 	StarredRelease::setDateTime(const Wt::WDateTime& dateTime)
 	{
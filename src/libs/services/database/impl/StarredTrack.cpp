@@ -60,6 +60,22 @@ namespace Database
 			.resultValue();
 	}
 
+	std::string
+	StarredTrack::getUserSignature(Session& session, UserId userId, Scrobbler scrobbler)
+	{
+		session.checkSharedLocked();
+		return session.getDboSession().query<std::string>("SELECT COUNT(*) || '/' || COALESCE(MAX(date_time), '') FROM starred_track")
+			.where("user_id = ?").bind(userId)
+			.where("scrobbler = ?").bind(scrobbler);
+	}
+
+	std::vector<TrackId>
+	StarredTrack::findIds(Session& session, UserId userId, Scrobbler scrobbler)
+	{
+		session.checkSharedLocked();
+		return findStarredIds<TrackId>(session.getDboSession(), "track", userId, scrobbler);
+	}
+
 	StarredTrack::pointer
 	StarredTrack::create(Session& session, ObjectPtr<Track> track, ObjectPtr<User> user, Scrobbler scrobbler)
 	{
@@ -71,6 +87,20 @@ namespace Database
 		return res;
 	}
 
+	void
+	StarredTrack::setStarred(Session& session, UserId userId, Scrobbler scrobbler, const std::vector<TrackId>& trackIds, const Wt::WDateTime& dateTime)
+	{
+		session.checkUniqueLocked();
+		Database::setStarred(session.getDboSession(), "track", userId, scrobbler, trackIds, dateTime);
+	}
+
+	void
+	StarredTrack::unsetStarred(Session& session, UserId userId, Scrobbler scrobbler, const std::vector<TrackId>& trackIds)
+	{
+		session.checkUniqueLocked();
+		Database::unsetStarred(session.getDboSession(), "track", userId, scrobbler, trackIds);
+	}
+
 	void
 	StarredTrack::setDateTime(const Wt::WDateTime& dateTime)
 	{
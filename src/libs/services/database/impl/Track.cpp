@@ -19,10 +19,13 @@
 
 #include "services/database/Track.hpp"
 
+#include <unordered_map>
+
 #include <Wt/Dbo/WtSqlTraits.h>
 
 #include "services/database/Artist.hpp"
 #include "services/database/Cluster.hpp"
+#include "services/database/Db.hpp"
 #include "services/database/Release.hpp"
 #include "services/database/TrackArtistLink.hpp"
 #include "services/database/TrackFeatures.hpp"
@@ -31,6 +34,7 @@
 #include "utils/Logger.hpp"
 
 #include "IdTypeTraits.hpp"
+#include "LibraryIndex.hpp"
 #include "SqlQuery.hpp"
 #include "StringViewTraits.hpp"
 #include "Utils.hpp"
@@ -46,11 +50,14 @@ createQuery(Session& session, const Track::FindParameters& params)
 	auto query {session.getDboSession().query<TrackId>("SELECT t.id from track t")};
 
 	for (std::string_view keyword : params.keywords)
-		query.where("t.name LIKE ? ESCAPE '" ESCAPE_CHAR_STR "'").bind("%" + escapeLikeKeyword(keyword) + "%");
+		query.where(bindKeywordClause(session, query, "track", "t", "name", keyword));
 
 	if (params.writtenAfter.isValid())
 		query.where("t.file_last_write > ?").bind(params.writtenAfter);
 
+	if (params.addedAfterGeneration)
+		query.where("t.added_generation > ?").bind(static_cast<long long>(*params.addedAfterGeneration));
+
 	if (params.starringUser.isValid())
 	{
 		assert(params.scrobbler);
@@ -59,6 +66,9 @@ createQuery(Session& session, const Track::FindParameters& params)
 			.where("s_t.scrobbler = ?").bind(*params.scrobbler);
 	}
 
+	if (params.directory.isValid())
+		query.where("t.directory_id = ?").bind(params.directory);
+
 	if (!params.clusters.empty())
 	{
 		std::ostringstream oss;
@@ -86,6 +96,9 @@ createQuery(Session& session, const Track::FindParameters& params)
 		case TrackSortMethod::LastWritten:
 			query.orderBy("t.file_last_write DESC");
 			break;
+		case TrackSortMethod::AddedDesc:
+			query.orderBy("t.added_generation DESC, t.id DESC");
+			break;
 		case TrackSortMethod::Random:
 			query.orderBy("RANDOM()");
 			break;
@@ -93,13 +106,16 @@ createQuery(Session& session, const Track::FindParameters& params)
 			assert(params.starringUser.isValid());
 			query.orderBy("s_t.date_time DESC");
 			break;
+		case TrackSortMethod::FilePath:
+			query.orderBy("(SELECT d.path FROM directory d WHERE d.id = t.directory_id), t.file_name");
+			break;
 	}
 
 	return query;
 }
 
 Track::Track(const std::filesystem::path& p)
-: _filePath {p.string()}
+: _fileName {p.string()}
 {
 }
 
@@ -114,6 +130,21 @@ Track::create(Session& session, const std::filesystem::path& p)
 	return res;
 }
 
+void
+Track::removeByIds(Session& session, const std::vector<TrackId>& trackIds)
+{
+	session.checkUniqueLocked();
+
+	if (trackIds.empty())
+		return;
+
+	// Make sure pending changes are written before bypassing Dbo
+	session.getDboSession().flush();
+
+	auto call {session.getDboSession().execute("DELETE FROM track WHERE id IN (" + getInListPlaceholders(trackIds.size()) + ")")};
+	bindInListValues(call, trackIds);
+}
+
 std::size_t
 Track::getCount(Session& session)
 {
@@ -127,7 +158,10 @@ Track::findByPath(Session& session, const std::filesystem::path& p)
 {
 	session.checkSharedLocked();
 
-	return session.getDboSession().find<Track>().where("file_path = ?").bind(p.string()).resultValue();
+	return session.getDboSession().find<Track>()
+		.where("(directory_id = (SELECT d.id FROM directory d WHERE d.path = ?) AND file_name = ?) OR (directory_id IS NULL AND file_name = ?)")
+		.bind(p.parent_path().string()).bind(p.filename().string()).bind(p.string())
+		.resultValue();
 }
 
 Track::pointer
@@ -140,6 +174,89 @@ Track::find(Session& session, TrackId id)
 		.resultValue();
 }
 
+std::vector<Track::pointer>
+Track::find(Session& session, const std::vector<TrackId>& ids)
+{
+	session.checkSharedLocked();
+
+	const auto tracks {loadByIds<Track>(session.getDboSession(), ids)};
+
+	// Releases and directories are then found in the session instead of being loaded one by one
+	std::vector<ReleaseId> releaseIds;
+	std::vector<DirectoryId> directoryIds;
+	for (const Wt::Dbo::ptr<Track>& track : tracks)
+	{
+		if (track->_release)
+			releaseIds.push_back(track->_release.id());
+		if (track->_directory)
+			directoryIds.push_back(track->_directory.id());
+	}
+	std::sort(std::begin(releaseIds), std::end(releaseIds));
+	releaseIds.erase(std::unique(std::begin(releaseIds), std::end(releaseIds)), std::end(releaseIds));
+	loadByIds<Release>(session.getDboSession(), releaseIds);
+	std::sort(std::begin(directoryIds), std::end(directoryIds));
+	directoryIds.erase(std::unique(std::begin(directoryIds), std::end(directoryIds)), std::end(directoryIds));
+	loadByIds<Directory>(session.getDboSession(), directoryIds);
+
+	return std::vector<Track::pointer>(std::cbegin(tracks), std::cend(tracks));
+}
+
+std::vector<Track::ListEntryResult>
+Track::findListEntries(Session& session, const std::vector<TrackId>& ids)
+{
+	using QueryResultType = std::tuple<TrackId, std::string, std::chrono::duration<int, std::milli>, ReleaseId, std::string, std::string>;
+	using ArtistQueryResultType = std::tuple<TrackId, ArtistId, std::string, std::string>;
+
+	session.checkSharedLocked();
+
+	std::unordered_map<TrackId, ListEntryResult> entries;
+
+	constexpr std::size_t batchSize {256};
+	for (std::size_t offset {}; offset < ids.size(); offset += batchSize)
+	{
+		const std::vector<TrackId> batchIds (std::cbegin(ids) + offset, std::cbegin(ids) + std::min(ids.size(), offset + batchSize));
+
+		{
+			auto query {session.getDboSession().query<QueryResultType>(
+					"SELECT t.id, t.name, t.duration, t.release_id, COALESCE(r.name, ''), COALESCE(r.mbid, '') FROM track t"
+					" LEFT OUTER JOIN release r ON r.id = t.release_id")
+				.where("t.id IN (" + getInListPlaceholders(batchIds.size()) + ")")};
+			bindInListValues(query, batchIds);
+
+			for (const auto& [trackId, name, duration, releaseId, releaseName, releaseMBID] : query.resultList())
+				entries.emplace(trackId, ListEntryResult {trackId, name, duration, releaseId, releaseName, UUID::fromString(releaseMBID), {}});
+		}
+
+		{
+			auto query {session.getDboSession().query<ArtistQueryResultType>(
+					"SELECT t_a_l.track_id, a.id, a.name, a.mbid FROM artist a"
+					" INNER JOIN track_artist_link t_a_l ON t_a_l.artist_id = a.id")
+				.where("t_a_l.track_id IN (" + getInListPlaceholders(batchIds.size()) + ")")};
+			bindInListValues(query, batchIds);
+			query.where("t_a_l.type = ?").bind(TrackArtistLinkType::Artist);
+			query.orderBy("t_a_l.id");
+
+			for (const auto& [trackId, artistId, artistName, artistMBID] : query.resultList())
+			{
+				auto itEntry {entries.find(trackId)};
+				if (itEntry != std::end(entries))
+					itEntry->second.artists.push_back(Artist::ListEntryResult {artistId, artistName, UUID::fromString(artistMBID)});
+			}
+		}
+	}
+
+	std::vector<ListEntryResult> res;
+	res.reserve(entries.size());
+	for (const TrackId id : ids)
+	{
+		auto itEntry {entries.find(id)};
+		if (itEntry != std::end(entries))
+			res.push_back(itEntry->second); // ids may contain duplicates
+	}
+
+	return res;
+}
+
 bool
 Track::exists(Session& session, TrackId id)
 {
@@ -160,18 +277,35 @@ Track::findByRecordingMBID(Session& session, const UUID& mbid)
 	return std::vector<Track::pointer>(res.begin(), res.end());
 }
 
-RangeResults<Track::PathResult>
-Track::findPaths(Session& session, Range range)
+static
+std::filesystem::path
+getTrackPath(const std::string& directoryPath, const std::string& fileName)
 {
-	using QueryResultType = std::tuple<TrackId, std::string>;
-	session.checkSharedLocked();
+	// Tracks not linked to a directory hold their full path
+	if (directoryPath.empty())
+		return fileName;
 
-	// TODO Dbo traits on filesystem
-	auto query {session.getDboSession().query<QueryResultType>("SELECT id, file_path FROM track")};
+	return std::filesystem::path {directoryPath} / fileName;
+}
+
+std::filesystem::path
+Track::getPath() const
+{
+	if (!_directory)
+		return _fileName;
+
+	return _directory->getPath() / _fileName;
+}
+
+static
+RangeResults<Track::PathResult>
+execPathQuery(Wt::Dbo::Query<std::tuple<TrackId, std::string, std::string>>& query, Range range)
+{
+	using QueryResultType = std::tuple<TrackId, std::string, std::string>;
 
 	RangeResults<QueryResultType> queryResults {execQuery(query, range)};
 
-	RangeResults<PathResult> res;
+	RangeResults<Track::PathResult> res;
 	res.range = queryResults.range;
 	res.moreResults = queryResults.moreResults;
 	res.results.reserve(queryResults.results.size());
@@ -179,21 +313,75 @@ Track::findPaths(Session& session, Range range)
 	std::transform(std::cbegin(queryResults.results), std::cend(queryResults.results), std::back_inserter(res.results),
 			[](const QueryResultType& queryResult)
 			{
-				return PathResult {std::get<0>(queryResult), std::get<1>(queryResult)};
+				return Track::PathResult {std::get<0>(queryResult), getTrackPath(std::get<1>(queryResult), std::get<2>(queryResult))};
 			});
 
 	return res;
 }
 
-RangeResults<TrackId>
+RangeResults<Track::PathResult>
+Track::findPaths(Session& session, Range range)
+{
+	session.checkSharedLocked();
+
+	// TODO Dbo traits on filesystem
+	auto query {session.getDboSession().query<std::tuple<TrackId, std::string, std::string>>(
+			"SELECT t.id, COALESCE(d.path, ''), t.file_name FROM track t"
+			" LEFT OUTER JOIN directory d ON d.id = t.directory_id")};
+
+	return execPathQuery(query, range);
+}
+
+RangeResults<Track::PathResult>
+Track::findPathsUnder(Session& session, const std::filesystem::path& p, Range range)
+{
+	session.checkSharedLocked();
+
+	const std::string pattern {escapeLikeKeyword((p / "").string()) + "%"};
+
+	auto query {session.getDboSession().query<std::tuple<TrackId, std::string, std::string>>(
+			"SELECT t.id, COALESCE(d.path, ''), t.file_name FROM track t"
+			" LEFT OUTER JOIN directory d ON d.id = t.directory_id")
+		.where("d.path = ? OR d.path LIKE ? ESCAPE '" ESCAPE_CHAR_STR "'"
+			" OR (d.path = ? AND t.file_name = ?)"
+			" OR (t.directory_id IS NULL AND (t.file_name = ? OR t.file_name LIKE ? ESCAPE '" ESCAPE_CHAR_STR "'))")
+		.bind(p.string())
+		.bind(pattern)
+		.bind(p.parent_path().string())
+		.bind(p.filename().string())
+		.bind(p.string())
+		.bind(pattern)};
+
+	return execPathQuery(query, range);
+}
+
+RangeResults<Track::RecordingMBIDDuplicateResult>
 Track::findRecordingMBIDDuplicates(Session& session, Range range)
 {
+	using QueryResultType = std::tuple<TrackId, std::string, std::string, std::string>;
+
 	session.checkSharedLocked();
 
-	auto query {session.getDboSession().query<TrackId>( "SELECT track.id FROM track WHERE recording_mbid in (SELECT recording_mbid FROM track WHERE recording_mbid <> '' GROUP BY recording_mbid HAVING COUNT (*) > 1)")
-		.orderBy("track.release_id,track.disc_number,track.track_number,track.recording_mbid")};
+	auto query {session.getDboSession().query<QueryResultType>(
+			"SELECT t.id, t.recording_mbid, COALESCE(d.path, ''), t.file_name FROM track t"
+			" LEFT OUTER JOIN directory d ON d.id = t.directory_id"
+			" WHERE t.recording_mbid in (SELECT recording_mbid FROM track WHERE recording_mbid <> '' GROUP BY recording_mbid HAVING COUNT (*) > 1)")
+		.orderBy("t.release_id,t.disc_number,t.track_number,t.recording_mbid")};
 
-	return execQuery(query, range);
+	RangeResults<QueryResultType> queryResults {execQuery(query, range)};
+
+	RangeResults<RecordingMBIDDuplicateResult> res;
+	res.range = queryResults.range;
+	res.moreResults = queryResults.moreResults;
+	res.results.reserve(queryResults.results.size());
+
+	std::transform(std::cbegin(queryResults.results), std::cend(queryResults.results), std::back_inserter(res.results),
+			[](const QueryResultType& queryResult)
+			{
+				return RecordingMBIDDuplicateResult {std::get<0>(queryResult), std::get<1>(queryResult), getTrackPath(std::get<2>(queryResult), std::get<3>(queryResult))};
+			});
+
+	return res;
 }
 
 RangeResults<TrackId>
@@ -208,6 +396,73 @@ Track::findWithRecordingMBIDAndMissingFeatures(Session& session, Range range)
 	return execQuery(query, range);
 }
 
+void
+Track::visitClusterLinks(Session& session, const std::function<void(TrackId, ClusterId)>& func)
+{
+	session.checkSharedLocked();
+
+	auto query {session.getDboSession().query<std::tuple<TrackId, ClusterId>>("SELECT track_id, cluster_id FROM track_cluster")};
+
+	for (const auto& [trackId, clusterId] : query.resultList())
+		func(trackId, clusterId);
+}
+
+void
+Track::visitReleaseLinks(Session& session, const std::function<void(TrackId, ReleaseId)>& func)
+{
+	session.checkSharedLocked();
+
+	auto query {session.getDboSession().query<std::tuple<TrackId, ReleaseId>>("SELECT id, release_id FROM track")
+		.where("release_id IS NOT NULL")};
+
+	for (const auto& [trackId, releaseId] : query.resultList())
+		func(trackId, releaseId);
+}
+
+void
+Track::visitArtistLinks(Session& session, const std::function<void(TrackId, ArtistId, TrackArtistLinkType)>& func)
+{
+	session.checkSharedLocked();
+
+	auto query {session.getDboSession().query<std::tuple<TrackId, ArtistId, int>>("SELECT track_id, artist_id, type FROM track_artist_link")};
+
+	for (const auto& [trackId, artistId, type] : query.resultList())
+		func(trackId, artistId, static_cast<TrackArtistLinkType>(type));
+}
+
+void
+Track::visitArtists(Session& session, const std::vector<TrackId>& trackIds, EnumSet<TrackArtistLinkType> linkTypes, const std::function<void(TrackId, const Artist::pointer&)>& func)
+{
+	session.checkSharedLocked();
+
+	std::vector<TrackArtistLinkType> types;
+	for (TrackArtistLinkType type : linkTypes)
+		types.push_back(type);
+
+	constexpr std::size_t batchSize {256};
+	for (std::size_t offset {}; offset < trackIds.size(); offset += batchSize)
+	{
+		const std::vector<TrackId> batchIds (std::cbegin(trackIds) + offset, std::cbegin(trackIds) + std::min(trackIds.size(), offset + batchSize));
+
+		auto query {session.getDboSession().query<std::tuple<TrackId, Wt::Dbo::ptr<Artist>>>(
+				"SELECT t_a_l.track_id, a FROM artist a"
+				" INNER JOIN track_artist_link t_a_l ON t_a_l.artist_id = a.id")
+			.where("t_a_l.track_id IN (" + getInListPlaceholders(batchIds.size()) + ")")};
+		bindInListValues(query, batchIds);
+
+		if (!types.empty())
+		{
+			query.where("t_a_l.type IN (" + getInListPlaceholders(types.size()) + ")");
+			bindInListValues(query, types);
+		}
+
+		query.orderBy("t_a_l.id");
+
+		for (const auto& [trackId, artist] : query.resultList())
+			func(trackId, artist);
+	}
+}
+
 std::vector<Cluster::pointer>
 Track::getClusters() const
 {
@@ -232,6 +487,22 @@ Track::find(Session& session, const FindParameters& parameters)
 {
 	session.checkSharedLocked();
 
+	if (const std::shared_ptr<const LibraryIndex> libraryIndex {session.getDb().getLibraryIndex()})
+	{
+		if (auto res {libraryIndex->find(parameters)})
+			return *res;
+	}
+
+	if (parameters.sortMethod == TrackSortMethod::Random)
+	{
+		FindParameters unsortedParams {parameters};
+		unsortedParams.setSortMethod(TrackSortMethod::None);
+
+		auto query {createQuery(session, unsortedParams)};
+		if (auto res {findRandomIds(session.getDboSession(), query, "track", "t.id", parameters.range)})
+			return *res;
+	}
+
 	auto query {createQuery(session, parameters)};
 
 	return execQuery(query, parameters.range);
@@ -256,27 +527,18 @@ Track::findSimilarTracks(Session& session, const std::vector<TrackId>& tracks, R
 	assert(!tracks.empty());
 	session.checkSharedLocked();
 
-	std::ostringstream oss;
-	for (std::size_t i {}; i < tracks.size(); ++i)
-	{
-		if (!oss.str().empty())
-			oss << ", ";
-		oss << "?";
-	}
+	const std::string placeholders {getInListPlaceholders(tracks.size())};
 
 	auto query {session.getDboSession().query<TrackId>(
 			"SELECT t.id FROM track t"
 			" INNER JOIN track_cluster t_c ON t_c.track_id = t.id"
-					" AND t_c.cluster_id IN (SELECT c.id FROM cluster c INNER JOIN track_cluster t_c ON t_c.cluster_id = c.id WHERE t_c.track_id IN (" + oss.str() + "))"
-					" AND t.id NOT IN (" + oss.str() + ")")
+					" AND t_c.cluster_id IN (SELECT c.id FROM cluster c INNER JOIN track_cluster t_c ON t_c.cluster_id = c.id WHERE t_c.track_id IN (" + placeholders + "))"
+					" AND t.id NOT IN (" + placeholders + ")")
 		.groupBy("t.id")
 		.orderBy("COUNT(*) DESC, RANDOM()")};
 
-	for (TrackId trackId : tracks)
-		query.bind(trackId);
-
-	for (TrackId trackId : tracks)
-		query.bind(trackId);
+	bindInListValues(query, tracks);
+	bindInListValues(query, tracks);
 
 	return execQuery(query, range);
 }
@@ -19,23 +19,30 @@
 
 #include "services/database/TrackFeatures.hpp"
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
+#include <tuple>
 
 #include "services/database/Session.hpp"
 #include "services/database/Track.hpp"
 #include "utils/Logger.hpp"
 #include "IdTypeTraits.hpp"
+#include "TrackFeaturesEncoding.hpp"
 #include "Utils.hpp"
 
 namespace Database {
 
 TrackFeatures::TrackFeatures(ObjectPtr<Track> track, const std::string& jsonEncodedFeatures)
-: _data {jsonEncodedFeatures},
+: _schemaVersion {TrackFeaturesEncoding::schemaVersion},
+_featureValues {TrackFeaturesEncoding::encode(jsonEncodedFeatures)},
 _track {getDboPtr(track)}
 {
 }
 
+const std::vector<FeatureDef>&
+TrackFeatures::getFeatureDefs()
+{
+	return TrackFeaturesEncoding::getFeatureDefs();
+}
+
 std::size_t
 TrackFeatures::getCount(Session& session)
 {
@@ -74,6 +81,32 @@ TrackFeatures::find(Session& session, Range range)
 	return execQuery(query, range);
 }
 
+RangeResults<TrackId>
+TrackFeatures::findTrackIds(Session& session, Range range)
+{
+	session.checkSharedLocked();
+
+	auto query {session.getDboSession().query<TrackId>("SELECT track_id from track_features")};
+
+	return execQuery(query, range);
+}
+
+void
+TrackFeatures::visitFeatureValuesMaps(Session& session, const std::unordered_set<FeatureName>& featureNames, const std::function<void(TrackId, const FeatureValuesMap&)>& func)
+{
+	session.checkSharedLocked();
+
+	auto query {session.getDboSession().query<std::tuple<TrackId, std::vector<unsigned char>>>("SELECT track_id, feature_values from track_features")
+		.where("schema_version = ?").bind(TrackFeaturesEncoding::schemaVersion)};
+
+	for (const auto& [trackId, featureValues] : query.resultList())
+	{
+		const FeatureValuesMap featureValuesMap {TrackFeaturesEncoding::decode(featureValues, featureNames)};
+		if (!featureValuesMap.empty())
+			func(trackId, featureValuesMap);
+	}
+}
+
 TrackFeatures::pointer
 TrackFeatures::create(Session& session, ObjectPtr<Track> track, const std::string& jsonEncodedFeatures)
 {
@@ -95,39 +128,13 @@ TrackFeatures::getFeatureValues(const FeatureName& featureNode) const
 FeatureValuesMap
 TrackFeatures::getFeatureValuesMap(const std::unordered_set<FeatureName>& featureNames) const
 {
-	FeatureValuesMap res;
-
-	try
+	if (_schemaVersion != TrackFeaturesEncoding::schemaVersion)
 	{
-		std::istringstream iss {_data};
-		boost::property_tree::ptree root;
-
-		boost::property_tree::read_json(iss, root);
-
-		for (const FeatureName& featureName : featureNames)
-		{
-			FeatureValues& featureValues {res[featureName]};
-
-			auto node {root.get_child(featureName)};
-
-			bool hasChildren = false;
-			for (const auto& child : node.get_child(""))
-			{
-				hasChildren = true;
-				featureValues.push_back(child.second.get_value<double>());
-			}
-
-			if (!hasChildren)
-				featureValues.push_back(node.get_value<double>());
-		}
-	}
-	catch (boost::property_tree::ptree_error& error)
-	{
-		LMS_LOG(DB, ERROR) << "Track " << _track.id() << ": ptree exception: " << error.what();
-		res.clear();
+		LMS_LOG(DB, ERROR) << "Track " << _track.id() << ": outdated features schema version " << _schemaVersion;
+		return {};
 	}
 
-	return res;
+	return TrackFeaturesEncoding::decode(_featureValues, featureNames);
 }
 
 } // namespace Database
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "services/database/TrackFeatures.hpp"
+
+namespace Database::TrackFeaturesEncoding
+{
+	// Must be bumped whenever the feature definitions change
+	constexpr int schemaVersion {1};
+
+	const std::vector<FeatureDef>& getFeatureDefs();
+
+	// Extracts all the defined features from AcousticBrainz low-level JSON data
+	// Result is packed floats, in definition order. Missing or malformed features are stored as NaN
+	std::vector<unsigned char> encode(const std::string& jsonEncodedFeatures);
+
+	// Returns an empty map if a requested feature is missing
+	FeatureValuesMap decode(const std::vector<unsigned char>& encodedFeatures, const std::unordered_set<FeatureName>& featureNames);
+}
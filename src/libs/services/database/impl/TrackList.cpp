@@ -18,7 +18,9 @@
  */
 #include "services/database/TrackList.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <unordered_set>
 
 #include "utils/Logger.hpp"
 
@@ -118,7 +120,11 @@ TrackList::isEmpty() const
 std::size_t
 TrackList::getCount() const
 {
-	return _entries.size();
+	assert(session());
+
+	return session()->query<int>("SELECT COALESCE(MAX(track_count), 0) FROM tracklist_summary")
+		.where("tracklist_id = ?").bind(getId())
+		.resultValue();
 }
 
 TrackListEntry::pointer
@@ -149,6 +155,41 @@ TrackList::getEntries(std::optional<std::size_t> offset, std::optional<std::size
 	return std::vector<TrackListEntry::pointer>(entries.begin(), entries.end());
 }
 
+std::vector<TrackListEntry::pointer>
+TrackList::getEntriesAfter(TrackListEntryId entryId, std::size_t size) const
+{
+	assert(session());
+
+	auto entries {
+		session()->find<TrackListEntry>()
+		.where("tracklist_id = ?").bind(getId())
+		.where("id > ?").bind(entryId)
+		.orderBy("id")
+		.limit(static_cast<int>(size))
+		.resultList()};
+
+	return std::vector<TrackListEntry::pointer>(entries.begin(), entries.end());
+}
+
+std::vector<TrackListEntry::pointer>
+TrackList::getEntriesBefore(TrackListEntryId entryId, std::size_t size) const
+{
+	assert(session());
+
+	auto entries {
+		session()->find<TrackListEntry>()
+		.where("tracklist_id = ?").bind(getId())
+		.where("id < ?").bind(entryId)
+		.orderBy("id DESC")
+		.limit(static_cast<int>(size))
+		.resultList()};
+
+	std::vector<TrackListEntry::pointer> res(entries.begin(), entries.end());
+	std::reverse(std::begin(res), std::end(res));
+
+	return res;
+}
+
 TrackListEntry::pointer
 TrackList::getEntryByTrackAndDateTime(ObjectPtr<Track> track, const Wt::WDateTime& dateTime) const
 {
@@ -282,10 +323,10 @@ TrackList::getArtists(const std::vector<ClusterId>& clusterIds, std::optional<Tr
 		case ArtistSortMethod::None:
 			break;
 		case ArtistSortMethod::ByName:
-			query.orderBy("a.name COLLATE NOCASE");
+			query.orderBy("a.name_sort_key");
 			break;
 		case ArtistSortMethod::BySortName:
-			query.orderBy("a.sort_name COLLATE NOCASE");
+			query.orderBy("a.sort_name_sort_key");
 			break;
 		case ArtistSortMethod::Random:
 			query.orderBy("RANDOM()");
@@ -496,8 +537,8 @@ TrackList::getDuration() const
 
 	using milli = std::chrono::duration<int, std::milli>;
 
-	Wt::Dbo::Query<milli> query {session()->query<milli>("SELECT COALESCE(SUM(duration), 0) FROM track t INNER JOIN tracklist_entry p_e ON t.id = p_e.track_id")
-			.where("p_e.tracklist_id = ?").bind(getId())};
+	Wt::Dbo::Query<milli> query {session()->query<milli>("SELECT COALESCE(MAX(duration), 0) FROM tracklist_summary")
+			.where("tracklist_id = ?").bind(getId())};
 
 	return query.resultValue();
 }
@@ -599,6 +640,121 @@ TrackListEntry::create(Session& session, ObjectPtr<Track> track, ObjectPtr<Track
 	return res;
 }
 
+std::size_t
+TrackListEntry::create(Session& session, const std::vector<TrackId>& trackIds, ObjectPtr<TrackList> tracklist, const Wt::WDateTime& dateTime)
+{
+	session.checkUniqueLocked();
+	assert(tracklist);
+
+	// keep the statements (and their bound values) reasonably small
+	constexpr std::size_t batchSize {256};
+
+	Wt::Dbo::Session& dboSession {session.getDboSession()};
+	dboSession.flush();
+
+	const Wt::WDateTime normalizedDateTime {normalizeDateTime(dateTime)};
+
+	std::size_t res {};
+	for (std::size_t offset {}; offset < trackIds.size(); offset += batchSize)
+	{
+		const std::vector<TrackId> batchTrackIds (std::cbegin(trackIds) + offset, std::cbegin(trackIds) + std::min(trackIds.size(), offset + batchSize));
+
+		// skip the tracks that do not exist (anymore)
+		std::unordered_set<TrackId> existingTrackIds;
+		{
+			auto query {dboSession.query<TrackId>("SELECT id FROM track WHERE id IN (" + getInListPlaceholders(batchTrackIds.size()) + ")")};
+			bindInListValues(query, batchTrackIds);
+
+			for (const TrackId trackId : query.resultList())
+				existingTrackIds.insert(trackId);
+		}
+
+		std::vector<TrackId> insertedTrackIds;
+		insertedTrackIds.reserve(batchTrackIds.size());
+		for (const TrackId trackId : batchTrackIds)
+		{
+			if (existingTrackIds.find(trackId) != std::cend(existingTrackIds))
+				insertedTrackIds.push_back(trackId);
+		}
+
+		if (insertedTrackIds.empty())
+			continue;
+
+		std::string sql {"INSERT INTO tracklist_entry(version, date_time, track_id, tracklist_id) VALUES "};
+		for (std::size_t i {}; i < insertedTrackIds.size(); ++i)
+			sql += (i == 0 ? "(0, ?, ?, ?)" : ",(0, ?, ?, ?)");
+
+		Wt::Dbo::Call call {dboSession.execute(sql)};
+		for (const TrackId trackId : insertedTrackIds)
+			call.bind(normalizedDateTime).bind(trackId).bind(tracklist->getId());
+		call.run();
+
+		res += insertedTrackIds.size();
+	}
+
+	return res;
+}
+
+std::size_t
+TrackListEntry::remove(Session& session, ObjectPtr<TrackList> tracklist, const std::vector<std::size_t>& positions)
+{
+	session.checkUniqueLocked();
+	assert(tracklist);
+
+	if (positions.empty())
+		return 0;
+
+	constexpr std::size_t batchSize {256};
+
+	Wt::Dbo::Session& dboSession {session.getDboSession()};
+	dboSession.flush();
+
+	// Only fetch the ids once, instead of one offset query per position
+	std::vector<TrackListEntryId> entryIdsToRemove;
+	{
+		auto entryIds {dboSession.query<TrackListEntryId>("SELECT id FROM tracklist_entry")
+			.where("tracklist_id = ?").bind(tracklist->getId())
+			.orderBy("id")
+			.resultList()};
+		const std::vector<TrackListEntryId> orderedEntryIds (std::cbegin(entryIds), std::cend(entryIds));
+
+		std::vector<std::size_t> sortedPositions {positions};
+		std::sort(std::begin(sortedPositions), std::end(sortedPositions));
+		sortedPositions.erase(std::unique(std::begin(sortedPositions), std::end(sortedPositions)), std::end(sortedPositions));
+
+		for (const std::size_t position : sortedPositions)
+		{
+			if (position >= orderedEntryIds.size())
+				break;
+
+			entryIdsToRemove.push_back(orderedEntryIds[position]);
+		}
+	}
+
+	for (std::size_t offset {}; offset < entryIdsToRemove.size(); offset += batchSize)
+	{
+		const std::vector<TrackListEntryId> batchEntryIds (std::cbegin(entryIdsToRemove) + offset, std::cbegin(entryIdsToRemove) + std::min(entryIdsToRemove.size(), offset + batchSize));
+
+		Wt::Dbo::Call call {dboSession.execute("DELETE FROM tracklist_entry WHERE id IN (" + getInListPlaceholders(batchEntryIds.size()) + ")")};
+		bindInListValues(call, batchEntryIds);
+		call.run();
+	}
+
+	return entryIdsToRemove.size();
+}
+
+void
+TrackListEntry::removeAll(Session& session, ObjectPtr<TrackList> tracklist)
+{
+	session.checkUniqueLocked();
+	assert(tracklist);
+
+	Wt::Dbo::Session& dboSession {session.getDboSession()};
+	dboSession.flush();
+
+	dboSession.execute("DELETE FROM tracklist_entry WHERE tracklist_id = ?").bind(tracklist->getId());
+}
+
 TrackListEntry::pointer
 TrackListEntry::getById(Session& session, TrackListEntryId id)
 {
@@ -19,6 +19,8 @@
 
 #include "Utils.hpp"
 
+#include <algorithm>
+
 #include "utils/String.hpp"
 
 namespace Database
@@ -29,6 +31,53 @@ namespace Database
 		return StringUtils::escapeString(keyword, "%_", escapeChar);
 	}
 
+	bool
+	isFullTextSearchable(std::string_view keyword)
+	{
+		// count UTF-8 characters, not bytes
+		const std::size_t characterCount {static_cast<std::size_t>(std::count_if(std::cbegin(keyword), std::cend(keyword), [](char c) { return (static_cast<unsigned char>(c) & 0xC0) != 0x80; }))};
+		return characterCount >= fullTextMinKeywordSize;
+	}
+
+	std::string
+	getFullTextMatchExpression(std::string_view column, std::string_view keyword)
+	{
+		// Quoted as a phrase so that the FTS5 query syntax does not apply, the trigram tokenizer then does substring matching
+		std::string res {column};
+		res += " : \"";
+		for (char c : keyword)
+		{
+			if (c == '"')
+				res += '"';
+			res += c;
+		}
+		res += '"';
+
+		return res;
+	}
+
+	std::size_t
+	getInListPlaceholderCount(std::size_t valueCount)
+	{
+		std::size_t res {1};
+		while (res < valueCount)
+			res *= 2;
+
+		return res;
+	}
+
+	std::string
+	getInListPlaceholders(std::size_t valueCount)
+	{
+		std::string res;
+
+		const std::size_t placeholderCount {getInListPlaceholderCount(valueCount)};
+		for (std::size_t i {}; i < placeholderCount; ++i)
+			res += (i == 0 ? "?" : ",?");
+
+		return res;
+	}
+
 	Wt::WDateTime
 	normalizeDateTime(const Wt::WDateTime& dateTime)
 	{
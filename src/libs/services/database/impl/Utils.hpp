@@ -19,13 +19,25 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <optional>
+#include <random>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <Wt/Dbo/Dbo.h>
 #include <Wt/WDateTime.h>
 
+#include "services/database/Db.hpp"
+#include "services/database/Session.hpp"
 #include "services/database/Types.hpp"
+#include "services/database/UserId.hpp"
+#include "utils/Random.hpp"
 
 namespace Database
 {
@@ -33,6 +45,29 @@ namespace Database
 	static inline constexpr char escapeChar {'\\'};
 	std::string escapeLikeKeyword(std::string_view keywords);
 
+	// Full text indexes use the trigram tokenizer: keywords must be at least 3 characters long
+	static inline constexpr std::size_t fullTextMinKeywordSize {3};
+	bool isFullTextSearchable(std::string_view keyword);
+	std::string getFullTextMatchExpression(std::string_view column, std::string_view keyword);
+
+	// Binds the keyword and returns a clause matching the rows whose column contains it (case insensitive)
+	// The full text index table is named <table>_fts, it is used whenever supported and the keyword is long enough
+	template <typename T>
+	std::string
+	bindKeywordClause(Session& session, Wt::Dbo::Query<T>& query, std::string_view table, std::string_view tableAlias, std::string_view column, std::string_view keyword)
+	{
+		if (session.getDb().isFullTextIndexUsable() && isFullTextSearchable(keyword))
+		{
+			const std::string ftsTable {std::string {table} + "_fts"};
+
+			query.bind(getFullTextMatchExpression(column, keyword));
+			return std::string {tableAlias} + ".id IN (SELECT rowid FROM " + ftsTable + " WHERE " + ftsTable + " MATCH ?)";
+		}
+
+		query.bind("%" + escapeLikeKeyword(keyword) + "%");
+		return std::string {tableAlias} + "." + std::string {column} + " LIKE ? ESCAPE '" ESCAPE_CHAR_STR "'";
+	}
+
 	template <typename T>
 	RangeResults<T>
 	execQuery(Wt::Dbo::Query<T>& query, Range range)
@@ -81,6 +116,190 @@ namespace Database
 		return res;
 	}
 
+	// Prepared statements are cached per connection, using the SQL as key
+	// To keep the number of different "IN (?, ...)" statements low, the placeholder count is rounded up to the next power of 2
+	std::size_t getInListPlaceholderCount(std::size_t valueCount);
+	std::string getInListPlaceholders(std::size_t valueCount);
+
+	// Binds the values, then binds the last one again to fill the extra placeholders
+	template <typename Query, typename T>
+	void
+	bindInListValues(Query& query, const std::vector<T>& values)
+	{
+		assert(!values.empty());
+
+		for (const T& value : values)
+			query.bind(value);
+
+		for (std::size_t i {values.size()}; i < getInListPlaceholderCount(values.size()); ++i)
+			query.bind(values.back());
+	}
+
+	// Loads objects using batched "IN" queries, results are given in the same order as the ids (not found objects are skipped)
+	template <typename T>
+	std::vector<Wt::Dbo::ptr<T>>
+	loadByIds(Wt::Dbo::Session& session, const std::vector<typename T::IdType>& ids)
+	{
+		using IdType = typename T::IdType;
+		constexpr std::size_t batchSize {256};
+
+		std::unordered_map<IdType, Wt::Dbo::ptr<T>> objectsById;
+		for (std::size_t offset {}; offset < ids.size(); offset += batchSize)
+		{
+			const std::vector<IdType> batchIds (std::cbegin(ids) + offset, std::cbegin(ids) + std::min(ids.size(), offset + batchSize));
+
+			auto query {session.find<T>().where("id IN (" + getInListPlaceholders(batchIds.size()) + ")")};
+			bindInListValues(query, batchIds);
+
+			for (const Wt::Dbo::ptr<T>& object : query.resultList())
+				objectsById.emplace(object->getId(), object);
+		}
+
+		std::vector<Wt::Dbo::ptr<T>> res;
+		res.reserve(objectsById.size());
+		for (const IdType id : ids)
+		{
+			auto itObject {objectsById.find(id)};
+			if (itObject != std::cend(objectsById))
+				res.push_back(itObject->second);
+		}
+
+		return res;
+	}
+
+	// Picks random rows by probing random ids, instead of sorting the whole table using ORDER BY RANDOM()
+	// The unsorted query applies the filters on the probed ids
+	// Returns std::nullopt if not enough rows are found this way (restrictive filters, sparse ids, etc.)
+	template <typename IdType>
+	std::optional<RangeResults<IdType>>
+	findRandomIds(Wt::Dbo::Session& session, const Wt::Dbo::Query<IdType>& unsortedQuery, std::string_view table, std::string_view idColumn, Range range)
+	{
+		using ValueType = typename IdType::ValueType;
+
+		constexpr std::size_t maxProbeRounds {4};
+		constexpr std::size_t maxCandidatesPerRound {256};
+
+		if (range.offset != 0 || range.size == 0)
+			return std::nullopt;
+
+		const auto [minId, maxId] {session.query<std::tuple<ValueType, ValueType>>("SELECT COALESCE(MIN(id), 0), COALESCE(MAX(id), -1) FROM " + std::string {table}).resultValue()};
+		const std::size_t idCount {maxId >= minId ? static_cast<std::size_t>(maxId - minId + 1) : 0};
+
+		std::unordered_set<ValueType> probedIds;
+		std::vector<IdType> foundIds;
+		std::uniform_int_distribution<ValueType> dist {minId, std::max(minId, maxId)};
+		for (std::size_t round {}; round < maxProbeRounds && foundIds.size() < range.size && probedIds.size() < idCount; ++round)
+		{
+			std::vector<IdType> candidates;
+			if (idCount <= maxCandidatesPerRound)
+			{
+				// small table: just probe everything
+				for (ValueType id {minId}; id <= maxId; ++id)
+				{
+					if (probedIds.insert(id).second)
+						candidates.push_back(id);
+				}
+			}
+			else
+			{
+				const std::size_t candidateCount {std::min(maxCandidatesPerRound, (range.size - foundIds.size()) * 2)};
+				for (std::size_t attempt {}; attempt < candidateCount * 4 && candidates.size() < candidateCount; ++attempt)
+				{
+					const ValueType id {dist(Random::getRandGenerator())};
+					if (probedIds.insert(id).second)
+						candidates.push_back(id);
+				}
+			}
+
+			if (candidates.empty())
+				break;
+
+			auto query {unsortedQuery};
+			query.where(std::string {idColumn} + " IN (" + getInListPlaceholders(candidates.size()) + ")");
+			bindInListValues(query, candidates);
+
+			for (const IdType id : query.resultList())
+				foundIds.push_back(id);
+		}
+
+		if (foundIds.size() < range.size && probedIds.size() < idCount)
+			return std::nullopt;
+
+		Random::shuffleContainer(foundIds);
+
+		RangeResults<IdType> res;
+		res.moreResults = foundIds.size() > range.size;
+		if (res.moreResults)
+			foundIds.resize(range.size);
+		res.results = std::move(foundIds);
+		res.range.offset = 0;
+		res.range.size = res.results.size();
+
+		return res;
+	}
+
 	Wt::WDateTime normalizeDateTime(const Wt::WDateTime& dateTime);
+
+	// Set based updates of the starred_<table> tables, using batched "IN" queries
+	// Objects and users that do not exist are ignored
+	template <typename IdType>
+	void
+	setStarred(Wt::Dbo::Session& session, std::string_view table, UserId userId, Scrobbler scrobbler, const std::vector<IdType>& ids, const Wt::WDateTime& dateTime)
+	{
+		constexpr std::size_t batchSize {256};
+
+		const std::string starredTable {"starred_" + std::string {table}};
+		const std::string idColumn {std::string {table} + "_id"};
+		const Wt::WDateTime normalizedDateTime {normalizeDateTime(dateTime)};
+
+		for (std::size_t offset {}; offset < ids.size(); offset += batchSize)
+		{
+			const std::vector<IdType> batchIds (std::cbegin(ids) + offset, std::cbegin(ids) + std::min(ids.size(), offset + batchSize));
+			const std::string placeholders {getInListPlaceholders(batchIds.size())};
+
+			{
+				auto call {session.execute("UPDATE " + starredTable + " SET version = version + 1, date_time = ? WHERE user_id = ? AND scrobbler = ? AND " + idColumn + " IN (" + placeholders + ")")};
+				call.bind(normalizedDateTime).bind(userId).bind(scrobbler);
+				bindInListValues(call, batchIds);
+			}
+
+			{
+				auto call {session.execute("INSERT INTO " + starredTable + "(version, scrobbler, date_time, " + idColumn + ", user_id)"
+						" SELECT 0, ?, ?, o.id, u.id FROM " + std::string {table} + " o, user u WHERE u.id = ? AND o.id IN (" + placeholders + ")"
+						" AND NOT EXISTS (SELECT 1 FROM " + starredTable + " s WHERE s." + idColumn + " = o.id AND s.user_id = u.id AND s.scrobbler = ?)")};
+				call.bind(scrobbler).bind(normalizedDateTime).bind(userId);
+				bindInListValues(call, batchIds);
+				call.bind(scrobbler);
+			}
+		}
+	}
+
+	template <typename IdType>
+	std::vector<IdType>
+	findStarredIds(Wt::Dbo::Session& session, std::string_view table, UserId userId, Scrobbler scrobbler)
+	{
+		auto query {session.query<IdType>("SELECT " + std::string {table} + "_id FROM starred_" + std::string {table})
+			.where("user_id = ?").bind(userId)
+			.where("scrobbler = ?").bind(scrobbler)};
+
+		const auto results {query.resultList()};
+		return std::vector<IdType>(std::cbegin(results), std::cend(results));
+	}
+
+	template <typename IdType>
+	void
+	unsetStarred(Wt::Dbo::Session& session, std::string_view table, UserId userId, Scrobbler scrobbler, const std::vector<IdType>& ids)
+	{
+		constexpr std::size_t batchSize {256};
+
+		for (std::size_t offset {}; offset < ids.size(); offset += batchSize)
+		{
+			const std::vector<IdType> batchIds (std::cbegin(ids) + offset, std::cbegin(ids) + std::min(ids.size(), offset + batchSize));
+
+			auto call {session.execute("DELETE FROM starred_" + std::string {table} + " WHERE user_id = ? AND scrobbler = ? AND " + std::string {table} + "_id IN (" + getInListPlaceholders(batchIds.size()) + ")")};
+			call.bind(userId).bind(scrobbler);
+			bindInListValues(call, batchIds);
+		}
+	}
 } // namespace Database
 
@@ -22,6 +22,7 @@
 #include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <Wt/WDateTime.h>
@@ -69,6 +70,13 @@ class Artist : public Object<Artist, ArtistId>
 			FindParameters& setWrittenAfter(const Wt::WDateTime& _after) { writtenAfter = _after; return *this; }
 			FindParameters& setStarringUser(UserId _user, Scrobbler _scrobbler) { starringUser = _user; scrobbler = _scrobbler; return *this; }
 		};
+		// Lightweight projection to render lists, the artist is not loaded in the session
+		struct ListEntryResult
+		{
+			ArtistId				artistId;
+			std::string				name;
+			std::optional<UUID>		MBID;
+		};
 
 		Artist() = default;
 		Artist(const std::string& name, const std::optional<UUID>& MBID = {});
@@ -77,11 +85,25 @@ class Artist : public Object<Artist, ArtistId>
 		static std::size_t				getCount(Session& session);
 		static pointer					find(Session& session, const UUID& MBID);
 		static pointer					find(Session& session, ArtistId id);
+		static std::vector<pointer>		find(Session& session, const std::vector<ArtistId>& ids); // same order as ids, not found ones are skipped
 		static std::vector<pointer>		find(Session& session, const std::string& name);		// exact match on name field
 		static RangeResults<ArtistId>	find(Session& session, const FindParameters& parameters);
 		static RangeResults<ArtistId>	findAllOrphans(Session& session, Range range); // No track related
+		static std::size_t				getOrphanCount(Session& session);
+		static std::size_t				removeOrphans(Session& session, std::size_t maxCount); // single statement, returns the number of removed artists
 		static bool						exists(Session& session, ArtistId id);
 
+		// Maintained by the scanner, cheaper than computing the counts from the tracks
+		// No link type means any link type
+		struct Summary
+		{
+			std::size_t	releaseCount {};
+			std::size_t	trackCount {};
+		};
+		static std::unordered_map<ArtistId, Summary>	getSummaries(Session& session, std::optional<TrackArtistLinkType> linkType = std::nullopt); // artists with no track are not reported
+		// Refreshes the summaries of at most maxCount artists whose tracks changed, returns the number of refreshed artists
+		static std::size_t								updateSummaries(Session& session, std::size_t maxCount);
+
 
 		// Accessors
 		const std::string&	getName() const { return _name; }
@@ -90,6 +112,7 @@ class Artist : public Object<Artist, ArtistId>
 
 		std::vector<ObjectPtr<Release>>		getReleases(const std::vector<ClusterId>& clusterIds = {}) const; // if non empty, get the releases that match all these clusters
 		std::size_t							getReleaseCount() const;
+		Summary								getSummary(std::optional<TrackArtistLinkType> linkType = std::nullopt) const;
 		std::vector<ObjectPtr<Track>>		getTracks(std::optional<TrackArtistLinkType> linkType = {}) const;
 		bool								hasNonReleaseTracks(std::optional<TrackArtistLinkType> linkType = std::nullopt) const;
 		RangeResults<ObjectPtr<Track>>		getNonReleaseTracks(std::optional<TrackArtistLinkType> linkType, Range range) const;
@@ -103,7 +126,7 @@ class Artist : public Object<Artist, ArtistId>
 		// size is the max number of cluster per cluster type
 		std::vector<std::vector<ObjectPtr<Cluster>>> getClusterGroups(std::vector<ObjectPtr<ClusterType>> clusterTypes, std::size_t size) const;
 
-		void setName(std::string_view name)		{ _name  = name; }
+		void setName(std::string_view name);
 		void setMBID(const std::optional<UUID>& mbid)	{ _MBID = mbid ? mbid->getAsString() : ""; }
 		void setSortName(const std::string& sortName);
 
@@ -115,6 +138,8 @@ class Artist : public Object<Artist, ArtistId>
 			{
 				Wt::Dbo::field(a, _name, "name");
 				Wt::Dbo::field(a, _sortName, "sort_name");
+				Wt::Dbo::field(a, _nameSortKey, "name_sort_key");
+				Wt::Dbo::field(a, _sortNameSortKey, "sort_name_sort_key");
 				Wt::Dbo::field(a, _MBID, "mbid");
 
 				Wt::Dbo::hasMany(a, _trackArtistLinks, Wt::Dbo::ManyToOne, "artist");
@@ -126,6 +151,8 @@ class Artist : public Object<Artist, ArtistId>
 
 		std::string _name;
 		std::string _sortName;
+		std::string _nameSortKey;		// see StringUtils::computeSortKey
+		std::string _sortNameSortKey;
 		std::string _MBID;	// Musicbrainz Identifier
 
 		Wt::Dbo::collection<Wt::Dbo::ptr<TrackArtistLink>>	_trackArtistLinks;	// Tracks involving this artist
@@ -49,6 +49,8 @@ class Cluster : public Object<Cluster, ClusterId>
 		static RangeResults<ClusterId>	find(Session& session, Range range);
 		static pointer					find(Session& session, ClusterId id);
 		static RangeResults<ClusterId>	findOrphans(Session& session, Range range);
+		static std::size_t				getOrphanCount(Session& session);
+		static std::size_t				removeOrphans(Session& session, std::size_t maxCount); // single statement, returns the number of removed clusters
 
 		// Create utility
 		static pointer create(Session& session, ObjectPtr<ClusterType> type, std::string_view name);
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "services/database/ClusterId.hpp"
+
+namespace Database
+{
+	class Session;
+
+	// Immutable in-memory copy of the used cluster types and of their clusters, with their track and release counts
+	// Shared by all the sessions, and built again each time the library changes (see Db::buildClusterCatalog)
+	class ClusterCatalog
+	{
+		public:
+			struct Cluster
+			{
+				ClusterId	id;
+				std::string	name;
+				std::size_t	trackCount {};
+				std::size_t	releaseCount {};
+			};
+
+			struct ClusterType
+			{
+				ClusterTypeId			id;
+				std::string				name;
+				std::vector<Cluster>	clusters;	// sorted by name
+			};
+
+			// Shared lock must be held
+			static std::unique_ptr<ClusterCatalog> build(Session& session);
+			// Catalog shared by the db, built on the fly if not built yet
+			static std::shared_ptr<const ClusterCatalog> get(Session& session);
+
+			const std::vector<ClusterType>&	getClusterTypes() const { return _clusterTypes; } // only the types that have clusters
+			const ClusterType*				findClusterType(std::string_view name) const;
+			const Cluster*					findCluster(std::string_view typeName, std::string_view name) const;
+
+		private:
+			std::vector<ClusterType> _clusterTypes;
+	};
+} // namespace Database
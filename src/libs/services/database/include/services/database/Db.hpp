@@ -19,19 +19,47 @@
 
 #pragma once
 
+#include <cstddef>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 #include <Wt/Dbo/SqlConnectionPool.h>
 
+#include "services/database/DbBackup.hpp"
+#include "services/database/DbStats.hpp"
 #include "utils/RecursiveSharedMutex.hpp"
 
 namespace Database {
 
+// Applied to all the connections of the pool, unset values keep the SQLite defaults
+struct ConnectionSettings
+{
+	std::optional<long long>	cacheSize;			// pragma cache_size: pages if positive, KiB if negative
+	std::optional<std::size_t>	mmapSize;			// pragma mmap_size, in bytes
+	bool						tempStoreMemory {};	// pragma temp_store=memory
+	std::optional<std::size_t>	walAutoCheckpoint;	// pragma wal_autocheckpoint, in pages
+	bool						collectStats {};	// per query and lock wait statistics, see Db::getStats
+	std::optional<std::size_t>	maxCachedStatementCount;	// per connection, cached statements are dropped at the next transaction once exceeded
+};
+
+class DbBackupRunner;
+class DbStatsCollector;
+class ClusterCatalog;
+class LibraryIndex;
 class Session;
 class Db
 {
 	public:
-		Db(const std::filesystem::path& dbPath, std::size_t connectionCount = 10);
+		enum class ConcurrencyMode
+		{
+			ApplicationLock,	// readers and writers share a process-wide lock: a write blocks all the readers
+			SQLite,				// rely on WAL snapshots: readers never wait, writers are serialized and wait on busy databases
+		};
+
+		Db(const std::filesystem::path& dbPath, std::size_t connectionCount = 10, ConcurrencyMode concurrencyMode = ConcurrencyMode::ApplicationLock, const ConnectionSettings& connectionSettings = {});
 		~Db();
 
 		Db(const Db&) = delete;
@@ -43,11 +71,61 @@ class Db
 
 		void executeSql(const std::string& sql);
 
+		// Reads the schema using a dedicated read only connection: neither waits for the lock nor for the connection pool
+		// Meant to be used by health checks
+		bool isReachable() const;
+
+		// Meant to be called periodically: updates the query planner statistics and checkpoints the WAL file
+		void performMaintenance();
+
+		// Free pages are kept in the file until they are reclaimed (incremental auto vacuum)
+		// The conversion of a database created without auto vacuum rewrites the whole file, must be called at startup before any transaction
+		void enableIncrementalVacuum();
+		struct FreeSpace
+		{
+			std::size_t pageSize {};
+			std::size_t freePageCount {};
+		};
+		FreeSpace getFreeSpace();
+		// Gives at most maxPageCount free pages back to the file system, returns the number of reclaimed pages
+		// Blocks the writers of this process while running: meant to be called by small steps
+		std::size_t reclaimFreePages(std::size_t maxPageCount);
+
+		// Stats collection and backups use the SQLite3 API directly: only available if built with USE_SQLITE3_API
+		// and if Wt::Dbo uses the same SQLite library
+		bool isSQLiteApiUsable() const { return _sqliteApiUsable; }
+
+		// Keyword searches use full text indexes if the SQLite library supports them, plain LIKE clauses otherwise
+		bool isFullTextIndexUsable() const { return _fullTextIndexUsable; }
+
+		// Online backup, on a dedicated thread: neither the readers nor the writers are blocked. See DbBackup.hpp
+		// Returns false if a backup is already in progress, or if backups are not supported (see isSQLiteApiUsable)
+		bool							startBackup(const std::filesystem::path& backupPath);
+		std::optional<DbBackupStatus>	getBackupStatus() const; // current or last backup, if any
+
+		// Optional in-memory index used to answer the cluster filtered finds, to be built again each time the library changes
+		// See LibraryIndex.hpp
+		void							buildLibraryIndex();
+		void							clearLibraryIndex();
+		std::shared_ptr<const LibraryIndex>	getLibraryIndex() const; // nullptr if not built
+
+		// In-memory cluster catalog, to be built again each time the library changes
+		// See ClusterCatalog.hpp
+		void							buildClusterCatalog();
+		std::shared_ptr<const ClusterCatalog>	getClusterCatalog() const; // nullptr if not built
+
+		// Only set if stats are collected
+		std::optional<DbStats> getStats() const;
+		void logStats(std::size_t maxQueryCount = 10) const;
+
 	private:
 		friend class Session;
 
 		RecursiveSharedMutex&		getMutex() { return _sharedMutex; }
+		ConcurrencyMode				getConcurrencyMode() const { return _concurrencyMode; }
 		Wt::Dbo::SqlConnectionPool&	getConnectionPool() { return *_connectionPool; }
+		DbStatsCollector*			getStatsCollector() { return _statsCollector.get(); }
+		bool						isFileReadable() const;
 
 		class ScopedConnection
 		{
@@ -67,8 +145,20 @@ class Db
 				std::unique_ptr<Wt::Dbo::SqlConnection> _connection;
 		};
 
+		const std::filesystem::path		_dbPath;
+		const ConcurrencyMode			_concurrencyMode;
+		bool							_sqliteApiUsable {};
+		bool							_fullTextIndexUsable {};
 		RecursiveSharedMutex				_sharedMutex;
+		std::unique_ptr<DbStatsCollector>	_statsCollector; // must outlive the connections
 		std::unique_ptr<Wt::Dbo::SqlConnectionPool>	_connectionPool;
+		std::unique_ptr<DbBackupRunner>		_backupRunner;
+
+		mutable std::mutex					_libraryIndexMutex;
+		std::shared_ptr<const LibraryIndex>	_libraryIndex;
+
+		mutable std::mutex					_clusterCatalogMutex;
+		std::shared_ptr<const ClusterCatalog>	_clusterCatalog;
 
 		std::mutex _tlsSessionsMutex;
 		std::vector<std::unique_ptr<Session>> _tlsSessions;
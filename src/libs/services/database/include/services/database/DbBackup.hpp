@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+namespace Database
+{
+	struct DbBackupStatus
+	{
+		enum class State
+		{
+			InProgress,
+			Complete,
+			Failed,
+		};
+
+		State					state {State::InProgress};
+		std::filesystem::path	backupPath;
+		std::size_t				totalPageCount {};	// only known once the first step is done
+		std::size_t				copiedPageCount {};
+		std::string				error;				// set if failed
+	};
+} // namespace Database
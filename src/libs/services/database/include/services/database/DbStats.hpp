@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Database
+{
+	struct QueryStats
+	{
+		std::string					sql;			// query shape: bound values are not part of it
+		std::size_t					count {};
+		std::chrono::microseconds	totalDuration {};
+		std::chrono::microseconds	p99Duration {};
+		std::size_t					rowCount {};	// total rows returned
+	};
+
+	struct LockStats
+	{
+		std::size_t					count {};
+		std::chrono::microseconds	totalWaitDuration {};
+		std::chrono::microseconds	p99WaitDuration {};
+	};
+
+	struct DbStats
+	{
+		std::vector<QueryStats>	queries;	// most time consuming first
+		LockStats				sharedLocks;
+		LockStats				uniqueLocks;
+	};
+} // namespace Database
+
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include <Wt/WDateTime.h>
+#include <Wt/Dbo/Dbo.h>
+#include <Wt/Dbo/WtSqlTraits.h>
+
+#include "services/database/DirectoryId.hpp"
+#include "services/database/Object.hpp"
+#include "services/database/ReleaseId.hpp"
+#include "services/database/Types.hpp"
+
+namespace Database {
+
+class Session;
+
+// Directory of the media library, as seen during the last scan
+// Directories are linked to their parent directory, to browse the library by folders
+class Directory : public Object<Directory, DirectoryId>
+{
+	public:
+		Directory() = default;
+		Directory(const std::filesystem::path& p, ObjectPtr<Directory> parent);
+
+		// Create utility
+		static pointer	create(Session& session, const std::filesystem::path& p, ObjectPtr<Directory> parent = {});
+
+		// Find utility functions
+		static std::size_t				getCount(Session& session);
+		static pointer					find(Session& session, DirectoryId id);
+		static pointer					findByPath(Session& session, const std::filesystem::path& p);
+		static RangeResults<pointer>	find(Session& session, Range range);
+		static RangeResults<DirectoryId>	findRootDirectories(Session& session, Range range); // no parent, sorted by name
+		static RangeResults<DirectoryId>	findChildren(Session& session, DirectoryId parentId, Range range); // sorted by name
+		static RangeResults<DirectoryId>	findOrphans(Session& session, Range range); // no track and no sub directory
+		static std::size_t				getOrphanCount(Session& session);
+		static std::size_t				removeOrphans(Session& session, std::size_t maxCount); // single statement, returns the number of removed directories (parents may become orphans)
+
+		// Setters
+		void setLastWriteTime(const Wt::WDateTime& lastWriteTime)	{ _lastWriteTime = lastWriteTime; }
+		void setEntryCount(std::size_t entryCount)					{ _entryCount = static_cast<int>(entryCount); }
+		void setScanVersion(std::size_t scanVersion)				{ _scanVersion = static_cast<int>(scanVersion); }
+		void setParent(ObjectPtr<Directory> parent)					{ _parent = getDboPtr(parent); }
+		void resetFingerprint()										{ _lastWriteTime = {}; _entryCount = 0; }
+
+		// Getters
+		std::filesystem::path	getPath() const				{ return _path; }
+		const Wt::WDateTime&	getLastWriteTime() const	{ return _lastWriteTime; }
+		std::size_t				getEntryCount() const		{ return _entryCount; }
+		std::size_t				getScanVersion() const		{ return _scanVersion; }
+		bool					hasFingerprint() const		{ return _lastWriteTime.isValid(); }
+		const std::string&		getName() const				{ return _name; }
+		ObjectPtr<Directory>	getParent() const			{ return _parent; }
+		DirectoryId				getParentId() const			{ return _parent.id(); }
+		std::optional<ReleaseId>	getCoverReleaseId() const; // release of one of the tracks directly in this directory
+
+		template<class Action>
+			void persist(Action& a)
+			{
+				Wt::Dbo::field(a, _path,			"path");
+				Wt::Dbo::field(a, _name,			"name");
+				Wt::Dbo::field(a, _lastWriteTime,	"last_write");
+				Wt::Dbo::field(a, _entryCount,		"entry_count");
+				Wt::Dbo::field(a, _scanVersion,		"scan_version");
+
+				Wt::Dbo::belongsTo(a, _parent, "parent", Wt::Dbo::OnDeleteCascade);
+			}
+
+	private:
+		std::string		_path;
+		std::string		_name;
+		Wt::WDateTime	_lastWriteTime;
+		int				_entryCount {};
+		int				_scanVersion {};
+
+		Wt::Dbo::ptr<Directory>	_parent;
+};
+
+} // namespace Database
+
@@ -66,6 +66,13 @@ class Listen : public Object<Listen, ListenId>
 		// Create
 		static pointer create(Session& session, ObjectPtr<User> user, ObjectPtr<Track> track, Scrobbler scrobbler, const Wt::WDateTime& dateTime);
 
+		// Compaction
+		// Rolls up the synchronized listens older than dateTime into per month counts and removes them. Returns the number of compacted listens
+		// Compacted listens are still used by the top and recent queries, but can no longer be found
+		static std::size_t	compact(Session& session, const Wt::WDateTime& dateTime);
+		// true if some listens of the month of dateTime have been compacted for this user and scrobbler
+		static bool			isCompacted(Session& session, UserId userId, Scrobbler scrobbler, const Wt::WDateTime& dateTime);
+
 		// Stats
 		static RangeResults<ArtistId>	getTopArtists(Session& session,
 													UserId userId,
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <Wt/Dbo/Dbo.h>
+
+#include "services/database/IdType.hpp"
+#include "services/database/Object.hpp"
+
+LMS_DECLARE_IDTYPE(MediaRootId)
+
+namespace Database {
+
+class ScanSettings;
+class Session;
+
+// Top directory of the library, several ones can be scanned concurrently
+class MediaRoot : public Object<MediaRoot, MediaRootId>
+{
+	public:
+		MediaRoot() = default;
+		MediaRoot(const std::filesystem::path& directory);
+
+		static pointer create(Session& session, const std::filesystem::path& directory);
+
+		// Getters
+		std::filesystem::path				getDirectory() const { return _directory; }
+		std::vector<std::filesystem::path>	getAudioFileExtensions() const; // empty means the scan settings ones
+
+		// Setters
+		void setAudioFileExtensions(const std::vector<std::filesystem::path>& extensions);
+
+		template<class Action>
+		void persist(Action& a)
+		{
+			Wt::Dbo::field(a, _directory,			"directory");
+			Wt::Dbo::field(a, _audioFileExtensions,	"audio_file_extensions");
+			Wt::Dbo::belongsTo(a, _scanSettings, "scan_settings", Wt::Dbo::OnDeleteCascade);
+		}
+
+	private:
+		std::string	_directory;
+		std::string	_audioFileExtensions;
+		Wt::Dbo::ptr<ScanSettings> _scanSettings;
+};
+
+} // namespace Database
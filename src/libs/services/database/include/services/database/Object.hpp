@@ -22,8 +22,20 @@
 #include <Wt/Dbo/ptr.h>
 #include "services/database/IdType.hpp"
 
+namespace Metrics
+{
+	class Gauge;
+}
+
 namespace Database
 {
+	namespace details
+	{
+		// Objects are accounted to the session whose transaction was last created by the current thread
+		Metrics::Gauge* acquireObjectGauge();
+		void releaseObjectGauge(Metrics::Gauge* gauge);
+	}
+
 	template <typename T>
 	class ObjectPtr
 	{
@@ -61,9 +73,17 @@ namespace Database
 			typename Wt::Dbo::dbo_traits<T>::IdType id() const = delete;
 
 		protected:
+			Object() : _objectGauge {details::acquireObjectGauge()} {}
+			Object(const Object& other) : Wt::Dbo::Dbo<T> {other}, _objectGauge {details::acquireObjectGauge()} {}
+			Object& operator=(const Object& other) { Wt::Dbo::Dbo<T>::operator=(other); return *this; }
+			~Object() { details::releaseObjectGauge(_objectGauge); }
+
 			// Can get raw dbo ptr only from Objects
 			template <typename SomeObject>
 			static
 			Wt::Dbo::ptr<SomeObject> getDboPtr(ObjectPtr<SomeObject> ptr) { return ptr._obj; }
+
+		private:
+			Metrics::Gauge* const _objectGauge;
 	};
 }
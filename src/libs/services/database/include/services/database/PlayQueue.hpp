@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <string_view>
+
+#include <Wt/WDateTime.h>
+#include <Wt/Dbo/Dbo.h>
+
+#include "services/database/IdType.hpp"
+#include "services/database/Object.hpp"
+#include "services/database/UserId.hpp"
+
+LMS_DECLARE_IDTYPE(PlayQueueId)
+
+namespace Database {
+
+class Session;
+class TrackList;
+class User;
+
+// Play queue saved by clients (one per user), tracks are stored in an internal track list
+class PlayQueue : public Object<PlayQueue, PlayQueueId>
+{
+	public:
+		PlayQueue() = default;
+		PlayQueue(ObjectPtr<User> user, ObjectPtr<TrackList> trackList);
+
+		// Create utility
+		static pointer	create(Session& session, ObjectPtr<User> user, ObjectPtr<TrackList> trackList);
+
+		// Find utility functions
+		static std::size_t	getCount(Session& session);
+		static pointer		find(Session& session, UserId userId);
+
+		// Setters
+		void setCurrentIndex(std::size_t index)								{ _currentIndex = static_cast<int>(index); }
+		void setCurrentPositionInTrack(std::chrono::milliseconds position)	{ _currentPositionInTrack = position; }
+		void setLastModifiedDateTime(const Wt::WDateTime& dateTime);
+		void setChangedBy(std::string_view clientName)						{ _changedBy = clientName; }
+
+		// Getters
+		ObjectPtr<User>				getUser() const						{ return _user; }
+		ObjectPtr<TrackList>		getTrackList() const				{ return _trackList; }
+		std::size_t					getCurrentIndex() const				{ return _currentIndex; }
+		std::chrono::milliseconds	getCurrentPositionInTrack() const	{ return _currentPositionInTrack; }
+		const Wt::WDateTime&		getLastModifiedDateTime() const		{ return _lastModifiedDateTime; }
+		std::string_view			getChangedBy() const				{ return _changedBy; }
+
+		template<class Action>
+			void persist(Action& a)
+			{
+				Wt::Dbo::field(a, _currentIndex,			"current_index");
+				Wt::Dbo::field(a, _currentPositionInTrack,	"current_position_in_track");
+				Wt::Dbo::field(a, _lastModifiedDateTime,	"last_modified_date_time");
+				Wt::Dbo::field(a, _changedBy,				"changed_by");
+
+				Wt::Dbo::belongsTo(a, _user,		"user",			Wt::Dbo::OnDeleteCascade);
+				Wt::Dbo::belongsTo(a, _trackList,	"tracklist",	Wt::Dbo::OnDeleteCascade);
+			}
+
+	private:
+		int										_currentIndex {};
+		std::chrono::duration<int, std::milli>	_currentPositionInTrack {};
+		Wt::WDateTime							_lastModifiedDateTime;
+		std::string								_changedBy;
+
+		Wt::Dbo::ptr<User>		_user;
+		Wt::Dbo::ptr<TrackList>	_trackList;
+};
+
+} // namespace Database
+
@@ -19,12 +19,17 @@
 
 #pragma once
 
+#include <chrono>
+#include <filesystem>
+#include <functional>
 #include <optional>
+#include <string>
 #include <vector>
 
 #include <Wt/WDateTime.h>
 #include <Wt/Dbo/Dbo.h>
 
+#include "services/database/Artist.hpp"
 #include "services/database/ClusterId.hpp"
 #include "services/database/Object.hpp"
 #include "services/database/ReleaseId.hpp"
@@ -35,7 +40,6 @@
 namespace Database
 {
 
-class Artist;
 class Cluster;
 class ClusterType;
 class Release;
@@ -53,6 +57,7 @@ class Release : public Object<Release, ReleaseId>
 			ReleaseSortMethod				sortMethod {ReleaseSortMethod::None};
 			Range							range;
 			Wt::WDateTime					writtenAfter;
+			std::optional<std::size_t>		addedAfterGeneration;	// only releases added after this library generation
 			std::optional<DateRange>		dateRange;
 			UserId							starringUser;	// only releases starred by this user
 			std::optional<Scrobbler>			scrobbler;		// and for this scrobbler
@@ -62,9 +67,18 @@ class Release : public Object<Release, ReleaseId>
 			FindParameters& setSortMethod(ReleaseSortMethod _sortMethod) {sortMethod = _sortMethod; return *this; }
 			FindParameters& setRange(Range _range) {range = _range; return *this; }
 			FindParameters& setWrittenAfter(const Wt::WDateTime& _after) {writtenAfter = _after; return *this; }
+			FindParameters& setAddedAfterGeneration(std::optional<std::size_t> _generation) { addedAfterGeneration = _generation; return *this; }
 			FindParameters& setDateRange(const std::optional<DateRange>& _dateRange) {dateRange = _dateRange; return *this; }
 			FindParameters& setStarringUser(UserId _user, Scrobbler _scrobbler) { starringUser = _user; scrobbler = _scrobbler; return *this; }
 		};
+		// Lightweight projection to render lists, nothing is loaded in the session
+		struct ListEntryResult
+		{
+			ReleaseId							releaseId;
+			std::string							name;
+			std::optional<UUID>					MBID;
+			std::vector<Artist::ListEntryResult>	artists;	// release artists, or artists if there is none
+		};
 
 		Release() = default;
 		Release(const std::string& name, const std::optional<UUID>& MBID = {});
@@ -75,8 +89,12 @@ class Release : public Object<Release, ReleaseId>
 		static pointer					find(Session& session, const UUID& MBID);
 		static std::vector<pointer>		find(Session& session, const std::string& name);
 		static pointer					find(Session& session, ReleaseId id);
+		static std::vector<pointer>		find(Session& session, const std::vector<ReleaseId>& ids); // same order as ids, not found ones are skipped
+		static std::vector<ListEntryResult>	findListEntries(Session& session, const std::vector<ReleaseId>& ids); // same order as ids, not found ones are skipped
 		static RangeResults<ReleaseId>	find(Session& session, const FindParameters& parameters);
 		static RangeResults<ReleaseId>	findOrphans(Session& session, Range range); // no track related
+		static std::size_t				getOrphanCount(Session& session);
+		static std::size_t				removeOrphans(Session& session, std::size_t maxCount); // single statement, returns the number of removed releases
 		static RangeResults<ReleaseId>	findOrderedByArtist(Session& session, Range range);
 
 		std::vector<ObjectPtr<Track>>	getTracks(const std::vector<ClusterId>& clusters = {}) const;
@@ -91,6 +109,17 @@ class Release : public Object<Release, ReleaseId>
 		// Create
 		static pointer	create(Session& session, const std::string& name, const std::optional<UUID>& MBID = {});
 
+		// Maintained along with the tracks, cheaper than computing each value from the tracks
+		struct Summary
+		{
+			std::size_t					trackCount {};
+			std::chrono::milliseconds	duration {};
+			std::optional<int>			year;			// various years => no year
+			std::optional<int>			originalYear;	// various years => no year
+			std::optional<std::string>	copyright;		// various copyrights => no copyright
+		};
+		Summary	getSummary() const;
+
 		// Utility functions
 		std::optional<int>			getReleaseYear(bool originalDate = false) const;
 		std::optional<std::string>	getCopyright() const;
@@ -103,21 +132,33 @@ class Release : public Object<Release, ReleaseId>
 		std::optional<std::size_t>	getTotalDisc() const;
 		std::chrono::milliseconds	getDuration() const;
 		Wt::WDateTime				getLastWritten() const;
+		const Wt::WDateTime&		getAddedTime() const	{ return _added; }
+		std::size_t					getAddedGeneration() const	{ return static_cast<std::size_t>(_addedGeneration); } // library generation that published the release, 0 if added before generations were recorded
+		// Cover source chosen during the last scan: picture file, or audio file with an embedded picture (empty if none)
+		std::filesystem::path		getCoverPath() const	{ return _coverPath; }
 
 		// Get the artists of this release
 		std::vector<ObjectPtr<Artist> > getArtists(TrackArtistLinkType type = TrackArtistLinkType::Artist) const;
 		std::vector<ObjectPtr<Artist> > getReleaseArtists() const { return getArtists(TrackArtistLinkType::ReleaseArtist); }
+		// Artists of several releases using batched queries
+		static void visitArtists(Session& session, const std::vector<ReleaseId>& releaseIds, TrackArtistLinkType linkType, const std::function<void(ReleaseId, const ObjectPtr<Artist>&)>& func);
 		bool hasVariousArtists() const;
 		std::vector<pointer>		getSimilarReleases(std::optional<std::size_t> offset = {}, std::optional<std::size_t> count = {}) const;
 
-		void setName(std::string_view name)		{ _name = name; }
+		void setName(std::string_view name);
 		void setMBID(const std::optional<UUID>& mbid)	{ _MBID = mbid ? mbid->getAsString() : ""; }
+		void setCoverPath(const std::filesystem::path& coverPath)	{ _coverPath = coverPath.string(); }
+		void setAdded(std::size_t generation, const Wt::WDateTime& time)	{ _addedGeneration = static_cast<long long>(generation); _added = time; }
 
 		template<class Action>
 			void persist(Action& a)
 			{
 				Wt::Dbo::field(a, _name, "name");
+				Wt::Dbo::field(a, _nameSortKey, "name_sort_key");
 				Wt::Dbo::field(a, _MBID, "mbid");
+				Wt::Dbo::field(a, _coverPath, "cover_path");
+				Wt::Dbo::field(a, _addedGeneration, "added_generation");
+				Wt::Dbo::field(a, _added, "added");
 
 				Wt::Dbo::hasMany(a, _tracks, Wt::Dbo::ManyToOne, "release");
 			}
@@ -126,7 +167,11 @@ class Release : public Object<Release, ReleaseId>
 		static const std::size_t _maxNameLength {128};
 
 		std::string	_name;
+		std::string	_nameSortKey;	// see StringUtils::computeSortKey
 		std::string	_MBID;
+		std::string	_coverPath;
+		long long	_addedGeneration {};
+		Wt::WDateTime	_added;
 
 		Wt::Dbo::collection<Wt::Dbo::ptr<Track>>	_tracks; // Tracks in the release
 };
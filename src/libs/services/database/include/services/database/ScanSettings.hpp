@@ -33,6 +33,7 @@ LMS_DECLARE_IDTYPE(ScanSettingsId)
 namespace Database {
 
 class ClusterType;
+class MediaRoot;
 class Session;
 
 class ScanSettings : public Object<ScanSettings, ScanSettingsId>
@@ -52,6 +53,13 @@ class ScanSettings : public Object<ScanSettings, ScanSettingsId>
 		{
 			Clusters = 0,
 			Features,
+			Hnsw,
+		};
+
+		struct MediaRootInfo
+		{
+			std::filesystem::path				directory;
+			std::vector<std::filesystem::path>	audioFileExtensions; // empty means the scan settings ones
 		};
 
 		static void init(Session& session);
@@ -60,7 +68,9 @@ class ScanSettings : public Object<ScanSettings, ScanSettingsId>
 
 		// Getters
 		std::size_t				getScanVersion() const { return _scanVersion; }
-		std::filesystem::path	getMediaDirectory() const { return _mediaDirectory; }
+		std::size_t				getLibraryGeneration() const { return _libraryGeneration; }
+		bool					isForcedScanInProgress() const { return _forcedScanInProgress; }
+		std::vector<ObjectPtr<MediaRoot>>	getMediaRoots() const; // ordered by directory
 		Wt::WTime				getUpdateStartTime() const { return _startTime; }
 		UpdatePeriod			getUpdatePeriod() const { return _updatePeriod; }
 		std::vector<ObjectPtr<ClusterType>> getClusterTypes() const;
@@ -69,33 +79,39 @@ class ScanSettings : public Object<ScanSettings, ScanSettingsId>
 
 		// Setters
 		void addAudioFileExtension(const std::filesystem::path& ext);
-		void setMediaDirectory(const std::filesystem::path& p);
+		void setMediaRoots(Session& session, const std::vector<MediaRootInfo>& mediaRoots);
 		void setUpdateStartTime(Wt::WTime t) { _startTime = t; }
 		void setUpdatePeriod(UpdatePeriod p) { _updatePeriod = p; }
 		void setClusterTypes(Session& session, const std::set<std::string>& clusterTypeNames);
 		void setRecommendationEngineType(RecommendationEngineType type) { _recommendationEngineType = type; }
 		void incScanVersion();
+		void incLibraryGeneration() { _libraryGeneration += 1; }
+		void setForcedScanInProgress(bool inProgress) { _forcedScanInProgress = inProgress; }
 
 		template<class Action>
 		void persist(Action& a)
 		{
 			Wt::Dbo::field(a, _scanVersion,		"scan_version");
-			Wt::Dbo::field(a, _mediaDirectory,	"media_directory");
+			Wt::Dbo::field(a, _libraryGeneration,	"library_generation");
+			Wt::Dbo::field(a, _forcedScanInProgress,	"forced_scan_in_progress");
 			Wt::Dbo::field(a, _startTime,		"start_time");
 			Wt::Dbo::field(a, _updatePeriod,	"update_period");
 			Wt::Dbo::field(a, _audioFileExtensions,	"audio_file_extensions");
 			Wt::Dbo::field(a, _recommendationEngineType,"similarity_engine_type");
 			Wt::Dbo::hasMany(a, _clusterTypes, Wt::Dbo::ManyToOne, "scan_settings");
+			Wt::Dbo::hasMany(a, _mediaRoots, Wt::Dbo::ManyToOne, "scan_settings");
 		}
 
 	private:
 		int		_scanVersion {};
-		std::string	_mediaDirectory;
+		int		_libraryGeneration {}; // incremented each time a scan changes the library, watched by the replica instances
+		bool	_forcedScanInProgress {}; // set until a forced scan completes, so that it can be resumed
 		Wt::WTime	_startTime = Wt::WTime {0,0,0};
 		UpdatePeriod	_updatePeriod {UpdatePeriod::Never};
 		RecommendationEngineType _recommendationEngineType {RecommendationEngineType::Clusters};
 		std::string	_audioFileExtensions {".alac .mp3 .ogg .oga .aac .m4a .m4b .flac .wav .wma .aif .aiff .ape .mpc .shn .opus .wv"};
 		Wt::Dbo::collection<Wt::Dbo::ptr<ClusterType>>	_clusterTypes;
+		Wt::Dbo::collection<Wt::Dbo::ptr<MediaRoot>>	_mediaRoots;
 };
 
 
@@ -20,31 +20,44 @@
 #pragma once
 
 #include <mutex>
+#include <string_view>
 
 #include <Wt/Dbo/Dbo.h>
 #include <Wt/Dbo/SqlConnectionPool.h>
 
 #include "utils/RecursiveSharedMutex.hpp"
+#include "utils/Tracing.hpp"
+
+namespace Metrics
+{
+	class Gauge;
+}
 
 namespace Database
 {
+	class DbStatsCollector;
 
 	class UniqueTransaction
 	{
 		private:
 			friend class Session;
-			UniqueTransaction(RecursiveSharedMutex& mutex, Wt::Dbo::Session& session);
+			UniqueTransaction(RecursiveSharedMutex& mutex, Wt::Dbo::Session& session, DbStatsCollector* statsCollector);
 
+			Tracing::ScopedSpan _span {"db.unique_transaction"}; // first, to include the lock wait
 			std::unique_lock<RecursiveSharedMutex> _lock;
 			Wt::Dbo::Transaction _transaction;
 	};
 
 	class SharedTransaction
 	{
+		public:
+			~SharedTransaction();
+
 		private:
 			friend class Session;
-			SharedTransaction(RecursiveSharedMutex& mutex, Wt::Dbo::Session& session);
+			SharedTransaction(RecursiveSharedMutex* mutex, Wt::Dbo::Session& session, DbStatsCollector* statsCollector); // no mutex means relying on SQLite snapshots
 
+			Tracing::ScopedSpan _span {"db.shared_transaction"}; // first, to include the lock wait
 			std::shared_lock<RecursiveSharedMutex> _lock;
 			Wt::Dbo::Transaction _transaction;
 	};
@@ -53,7 +66,8 @@ namespace Database
 	class Session
 	{
 		public:
-			Session (Db& database);
+			// name is used to report the objects this session has loaded ('lms_db_session_objects' metric)
+			Session (Db& database, std::string_view name = "other");
 
 			Session(const Session&) = delete;
 			Session(Session&&) = delete;
@@ -69,12 +83,14 @@ namespace Database
 			void optimize();
 
 			void prepareTables(); // need to run only once at startup
+			void checkTables(); // instead of prepareTables, if another instance owns the database
 
 			Wt::Dbo::Session& getDboSession() { return _session; }
 			Db& getDb() { return _db; }
 
 		private:
 			Db&					_db;
+			Metrics::Gauge&		_objectGauge;
 			Wt::Dbo::Session	_session;
 	};
 
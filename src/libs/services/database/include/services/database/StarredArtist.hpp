@@ -19,6 +19,9 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include <Wt/WDateTime.h>
 #include <Wt/Dbo/Dbo.h>
 
@@ -47,9 +50,15 @@ namespace Database
 			static std::size_t	getCount(Session& session);
 			static pointer		find(Session& session, StarredArtistId id);
 			static pointer		find(Session& session, ArtistId artistId, UserId userId, Scrobbler scrobbler);
+			// Changes each time the user stars or unstars a artist
+			static std::string	getUserSignature(Session& session, UserId userId, Scrobbler scrobbler);
+			static std::vector<ArtistId>	findIds(Session& session, UserId userId, Scrobbler scrobbler);
 
 			// Create utility
 			static pointer		create(Session& session, ObjectPtr<Artist> artist, ObjectPtr<User> user, Scrobbler scrobbler);
+			// Set based utilities, objects that do not exist are ignored
+			static void			setStarred(Session& session, UserId userId, Scrobbler scrobbler, const std::vector<ArtistId>& artistIds, const Wt::WDateTime& dateTime);
+			static void			unsetStarred(Session& session, UserId userId, Scrobbler scrobbler, const std::vector<ArtistId>& artistIds);
 
 			// Accessors
 			ObjectPtr<Artist>	getArtist() const { return _artist; }
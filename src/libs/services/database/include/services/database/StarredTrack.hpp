@@ -19,6 +19,9 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include <Wt/WDateTime.h>
 #include <Wt/Dbo/Dbo.h>
 
@@ -47,9 +50,15 @@ namespace Database
 			static std::size_t	getCount(Session& session);
 			static pointer		find(Session& session, StarredTrackId id);
 			static pointer		find(Session& session, TrackId trackId, UserId userId, Scrobbler scrobbler);
+			// Changes each time the user stars or unstars a track
+			static std::string	getUserSignature(Session& session, UserId userId, Scrobbler scrobbler);
+			static std::vector<TrackId>	findIds(Session& session, UserId userId, Scrobbler scrobbler);
 
 			// Create utility
 			static pointer		create(Session& session, ObjectPtr<Track> track, ObjectPtr<User> user, Scrobbler scrobbler);
+			// Set based utilities, objects that do not exist are ignored
+			static void			setStarred(Session& session, UserId userId, Scrobbler scrobbler, const std::vector<TrackId>& trackIds, const Wt::WDateTime& dateTime);
+			static void			unsetStarred(Session& session, UserId userId, Scrobbler scrobbler, const std::vector<TrackId>& trackIds);
 
 			// Accessors
 			ObjectPtr<Track>	getTrack() const { return _track; }
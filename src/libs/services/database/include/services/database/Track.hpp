@@ -20,7 +20,9 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -34,16 +36,18 @@
 #include "utils/EnumSet.hpp"
 #include "utils/UUID.hpp"
 
+#include "services/database/Artist.hpp"
 #include "services/database/ArtistId.hpp"
 #include "services/database/ClusterId.hpp"
+#include "services/database/Directory.hpp"
 #include "services/database/Object.hpp"
+#include "services/database/ReleaseId.hpp"
 #include "services/database/TrackId.hpp"
 #include "services/database/Types.hpp"
 #include "services/database/UserId.hpp"
 
 namespace Database {
 
-class Artist;
 class Cluster;
 class ClusterType;
 class Release;
@@ -62,21 +66,42 @@ class Track : public Object<Track, TrackId>
 			TrackSortMethod					sortMethod {TrackSortMethod::None};
 			Range							range;
 			Wt::WDateTime					writtenAfter;
+			std::optional<std::size_t>		addedAfterGeneration;	// only tracks added after this library generation
 			UserId							starringUser;	// only tracks starred by this user
 			std::optional<Scrobbler>			scrobbler;		// and for this scrobbler
+			DirectoryId						directory;		// only tracks directly in this directory
 
 			FindParameters& setClusters(const std::vector<ClusterId>& _clusters) { clusters = _clusters; return *this; }
 			FindParameters& setKeywords(const std::vector<std::string_view>& _keywords) { keywords = _keywords; return *this; }
 			FindParameters& setSortMethod(TrackSortMethod _method) { sortMethod = _method; return *this; }
 			FindParameters& setRange(Range _range) { range = _range; return *this; }
 			FindParameters& setWrittenAfter(const Wt::WDateTime& _after) { writtenAfter = _after; return *this; }
+			FindParameters& setAddedAfterGeneration(std::optional<std::size_t> _generation) { addedAfterGeneration = _generation; return *this; }
 			FindParameters& setStarringUser(UserId _user, Scrobbler _scrobbler) { starringUser = _user; scrobbler = _scrobbler; return *this; }
+			FindParameters& setDirectory(DirectoryId _directory) { directory = _directory; return *this; }
 		};
 		struct PathResult
 		{
 			TrackId					trackId;
 			std::filesystem::path	path;
 		};
+		struct RecordingMBIDDuplicateResult
+		{
+			TrackId					trackId;
+			std::string				recordingMBID;
+			std::filesystem::path	path;
+		};
+		// Lightweight projection to render lists, nothing is loaded in the session
+		struct ListEntryResult
+		{
+			TrackId								trackId;
+			std::string							name;
+			std::chrono::milliseconds			duration {};
+			ReleaseId							releaseId;	// invalid if no release
+			std::string							releaseName;
+			std::optional<UUID>					releaseMBID;
+			std::vector<Artist::ListEntryResult>	artists;	// "Artist" links only, in link order
+		};
 
 		Track() = default;
 		Track(const std::filesystem::path& p);
@@ -85,19 +110,31 @@ class Track : public Object<Track, TrackId>
 		static std::size_t				getCount(Session& session);
 		static pointer					findByPath(Session& session, const std::filesystem::path& p);
 		static pointer 					find(Session& session, TrackId id);
+		static std::vector<pointer>		find(Session& session, const std::vector<TrackId>& ids); // same order as ids, not found ones are skipped, referenced releases are loaded too
 		static bool						exists(Session& session, TrackId id);
 		static std::vector<pointer>		findByRecordingMBID(Session& session, const UUID& MBID);
 		static RangeResults<TrackId>	findSimilarTracks(Session& session, const std::vector<TrackId>& trackIds, Range range);
 
 		static RangeResults<TrackId>	find(Session& session, const FindParameters& parameters);
 		static RangeResults<TrackId>	findByNameAndReleaseName(Session& session, std::string_view trackName, std::string_view releaseName);
+		static std::vector<ListEntryResult>	findListEntries(Session& session, const std::vector<TrackId>& ids); // same order as ids, not found ones are skipped
 		static RangeResults<PathResult>	findPaths(Session& session, Range range);
-		static RangeResults<TrackId>	findRecordingMBIDDuplicates(Session& session, Range range);
+		static RangeResults<PathResult>	findPathsUnder(Session& session, const std::filesystem::path& p, Range range); // p itself or any file inside p
+		static RangeResults<RecordingMBIDDuplicateResult>	findRecordingMBIDDuplicates(Session& session, Range range); // single GROUP BY query, no need to load the tracks
 		static RangeResults<TrackId>	findWithRecordingMBIDAndMissingFeatures(Session& session, Range range);
+		// Single sequential scans of all the links, to build in memory indexes
+		static void						visitClusterLinks(Session& session, const std::function<void(TrackId, ClusterId)>& func);
+		static void						visitReleaseLinks(Session& session, const std::function<void(TrackId, ReleaseId)>& func);
+		static void						visitArtistLinks(Session& session, const std::function<void(TrackId, ArtistId, TrackArtistLinkType)>& func);
+		// Artists of several tracks using batched queries, in link order (all link types if linkTypes is empty)
+		static void						visitArtists(Session& session, const std::vector<TrackId>& trackIds, EnumSet<TrackArtistLinkType> linkTypes, const std::function<void(TrackId, const ObjectPtr<Artist>&)>& func);
 
 		// Create utility
 		static pointer	create(Session& session, const std::filesystem::path& p);
 
+		// Remove utility (dependent entities are removed by cascade)
+		static void		removeByIds(Session& session, const std::vector<TrackId>& trackIds);
+
 		// Accessors
 		void setScanVersion(std::size_t version)			{ _scanVersion = version; }
 		void setTrackNumber(int num)					{ _trackNumber = num; }
@@ -107,11 +144,16 @@ class Track : public Object<Track, TrackId>
 		void setDiscSubtitle(const std::string& name)			{ _discSubtitle = name; }
 		void setName(const std::string& name)				{ _name = std::string(name, 0, _maxNameLength); }
 		void setDuration(std::chrono::milliseconds duration)		{ _duration = duration; }
+		void setBitrate(std::size_t bitrate)				{ _bitrate = static_cast<int>(bitrate); }
+		void setAudioCodec(AudioCodec codec)				{ _audioCodec = codec; }
 		void setLastWriteTime(Wt::WDateTime time)			{ _fileLastWrite = time; }
+		void setContentHash(const std::string& contentHash)		{ _contentHash = contentHash; }
 		void setAddedTime(Wt::WDateTime time)				{ _fileAdded = time; }
+		void setAddedGeneration(std::size_t generation)		{ _addedGeneration = static_cast<long long>(generation); }
 		void setDate(const Wt::WDate& date)							{ _date = date; }
 		void setOriginalDate(const Wt::WDate& date)					{ _originalDate = date; }
 		void setHasCover(bool hasCover)					{ _hasCover = hasCover; }
+		void setCoverHash(std::uint64_t coverHash)			{ _coverHash = static_cast<long long>(coverHash); }
 		void setTrackMBID(const std::optional<UUID>& MBID)			{ _trackMBID = MBID ? MBID->getAsString() : ""; }
 		void setRecordingMBID(const std::optional<UUID>& MBID)		{ _recordingMBID = MBID ? MBID->getAsString() : ""; }
 		void setCopyright(const std::string& copyright)			{ _copyright = std::string(copyright, 0, _maxCopyrightLength); }
@@ -121,6 +163,7 @@ class Track : public Object<Track, TrackId>
 		void clearArtistLinks();
 		void addArtistLink(const ObjectPtr<TrackArtistLink>& artistLink);
 		void setRelease(ObjectPtr<Release> release)			{ _release = getDboPtr(release); }
+		void setPath(ObjectPtr<Directory> directory, const std::filesystem::path& fileName) { _directory = getDboPtr(directory); _fileName = fileName.string(); }
 		void setClusters(const std::vector<ObjectPtr<Cluster>>& clusters );
 
 		std::size_t 				getScanVersion() const		{ return _scanVersion; }
@@ -130,14 +173,20 @@ class Track : public Object<Track, TrackId>
 		const std::string&			getDiscSubtitle() const { return _discSubtitle; }
 		std::optional<std::size_t>	getTotalDisc() const;
 		std::string 				getName() const			{ return _name; }
-		std::filesystem::path		getPath() const			{ return _filePath; }
+		std::filesystem::path		getPath() const; // loads the directory if needed
+		std::filesystem::path		getFileName() const		{ return _fileName; }
 		std::chrono::milliseconds	getDuration() const		{ return _duration; }
+		std::size_t					getBitrate() const		{ return _bitrate; } // in bps, 0 if unknown
+		AudioCodec					getAudioCodec() const	{ return _audioCodec; }
 		const Wt::WDateTime&		getLastWritten() const	{ return _fileLastWrite; }
 		std::optional<int>			getYear() const;
 		std::optional<int>			getOriginalYear() const;
 		Wt::WDateTime				getLastWriteTime() const	{ return _fileLastWrite; }
 		Wt::WDateTime				getAddedTime() const		{ return _fileAdded; }
+		std::size_t					getAddedGeneration() const	{ return static_cast<std::size_t>(_addedGeneration); } // library generation that published the track, 0 if added before generations were recorded
+		const std::string&			getContentHash() const		{ return _contentHash; } // empty if not computed yet
 		bool						hasCover() const		{ return _hasCover; }
+		std::uint64_t				getCoverHash() const	{ return static_cast<std::uint64_t>(_coverHash); } // identifies the embedded picture, 0 if unknown
 		std::optional<UUID>			getTrackMBID() const			{ return UUID::fromString(_trackMBID); }
 		std::optional<UUID>			getRecordingMBID() const			{ return UUID::fromString(_recordingMBID); }
 		std::optional<std::string>	getCopyright() const;
@@ -150,6 +199,7 @@ class Track : public Object<Track, TrackId>
 		std::vector<ArtistId>				getArtistIds(EnumSet<TrackArtistLinkType> artistLinkTypes) const;
 		std::vector<ObjectPtr<TrackArtistLink>>	getArtistLinks() const;
 		ObjectPtr<Release>				getRelease() const		{ return _release; }
+		DirectoryId						getDirectoryId() const	{ return _directory.id(); }
 		std::vector<ObjectPtr<Cluster>>	getClusters() const;
 		std::vector<ClusterId>				getClusterIds() const;
 
@@ -166,12 +216,17 @@ class Track : public Object<Track, TrackId>
 				Wt::Dbo::field(a, _totalDisc,		"total_disc");
 				Wt::Dbo::field(a, _name,			"name");
 				Wt::Dbo::field(a, _duration,		"duration");
+				Wt::Dbo::field(a, _bitrate,			"bitrate");
+				Wt::Dbo::field(a, _audioCodec,		"audio_codec");
 				Wt::Dbo::field(a, _date,			"date");
 				Wt::Dbo::field(a, _originalDate,	"original_date");
-				Wt::Dbo::field(a, _filePath,		"file_path");
+				Wt::Dbo::field(a, _fileName,		"file_name");
 				Wt::Dbo::field(a, _fileLastWrite,	"file_last_write");
 				Wt::Dbo::field(a, _fileAdded,		"file_added");
+				Wt::Dbo::field(a, _addedGeneration,	"added_generation");
+				Wt::Dbo::field(a, _contentHash,		"content_hash");
 				Wt::Dbo::field(a, _hasCover,		"has_cover");
+				Wt::Dbo::field(a, _coverHash,		"cover_hash");
 				Wt::Dbo::field(a, _trackMBID,		"mbid");
 				Wt::Dbo::field(a, _recordingMBID,	"recording_mbid");
 				Wt::Dbo::field(a, _copyright,		"copyright");
@@ -179,6 +234,7 @@ class Track : public Object<Track, TrackId>
 				Wt::Dbo::field(a, _trackReplayGain,	"track_replay_gain");
 				Wt::Dbo::field(a, _releaseReplayGain,	"release_replay_gain");
 				Wt::Dbo::belongsTo(a, _release, "release", Wt::Dbo::OnDeleteCascade);
+				Wt::Dbo::belongsTo(a, _directory, "directory", Wt::Dbo::OnDeleteCascade);
 				Wt::Dbo::hasMany(a, _trackArtistLinks, Wt::Dbo::ManyToOne, "track");
 				Wt::Dbo::hasMany(a, _clusters, Wt::Dbo::ManyToMany, "track_cluster", "", Wt::Dbo::OnDeleteCascade);
 			}
@@ -198,12 +254,17 @@ class Track : public Object<Track, TrackId>
 		std::string				_artistName;
 		std::string				_releaseName;
 		std::chrono::duration<int, std::milli>	_duration {};
+		int						_bitrate {};
+		AudioCodec				_audioCodec {AudioCodec::Unknown};
 		Wt::WDate				_date;
 		Wt::WDate				_originalDate;
-		std::string				_filePath;
+		std::string				_fileName;	// full path if not linked to a directory
 		Wt::WDateTime			_fileLastWrite;
 		Wt::WDateTime			_fileAdded;
+		long long				_addedGeneration {};
+		std::string				_contentHash;
 		bool					_hasCover {};
+		long long				_coverHash {};
 		std::string				_trackMBID;
 		std::string				_recordingMBID;
 		std::string				_copyright;
@@ -212,6 +273,7 @@ class Track : public Object<Track, TrackId>
 		std::optional<float>	_releaseReplayGain;
 
 		Wt::Dbo::ptr<Release>				_release;
+		Wt::Dbo::ptr<Directory>				_directory;
 		Wt::Dbo::collection<Wt::Dbo::ptr<TrackArtistLink>> _trackArtistLinks;
 		Wt::Dbo::collection<Wt::Dbo::ptr<Cluster>> 	_clusters;
 };
@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -42,19 +43,32 @@ using FeatureName = std::string;
 using FeatureValues  = std::vector<double>;
 using FeatureValuesMap = std::unordered_map<FeatureName, FeatureValues>;
 
+struct FeatureDef
+{
+	FeatureName	name;
+	std::size_t	nbDimensions {};
+};
+
 class TrackFeatures : public Object<TrackFeatures, TrackFeaturesId>
 {
 	public:
 		TrackFeatures() = default;
 		TrackFeatures(ObjectPtr<Track> track, const std::string& jsonEncodedFeatures);
 
+		// Features extracted from the AcousticBrainz data and stored for each track
+		static const std::vector<FeatureDef>& getFeatureDefs();
+
 		// Find utilities
 		static std::size_t						getCount(Session& session);
 		static pointer							find(Session& session, TrackFeaturesId id);
 		static pointer							find(Session& session, TrackId trackId);
 		static RangeResults<TrackFeaturesId>	find(Session& session, Range range);
+		static RangeResults<TrackId>			findTrackIds(Session& session, Range range); // tracks that have features
+		// Single sequential scan, much faster than finding features one by one
+		// func is not called for tracks that miss some of the requested features
+		static void visitFeatureValuesMaps(Session& session, const std::unordered_set<FeatureName>& featureNames, const std::function<void(TrackId, const FeatureValuesMap&)>& func);
 
-		// Create utility
+		// Create utility, only the defined features are extracted from the JSON data
 		static pointer		create(Session& session, ObjectPtr<Track> track, const std::string& jsonEncodedFeatures);
 
 		FeatureValues		getFeatureValues(const FeatureName& feature) const;
@@ -66,13 +80,15 @@ class TrackFeatures : public Object<TrackFeatures, TrackFeaturesId>
 		template<class Action>
 		void persist(Action& a)
 		{
-			Wt::Dbo::field(a, _data,	"data");
+			Wt::Dbo::field(a, _schemaVersion,	"schema_version");
+			Wt::Dbo::field(a, _featureValues,	"feature_values");
 			Wt::Dbo::belongsTo(a, _track, "track", Wt::Dbo::OnDeleteCascade);
 		}
 
 	private:
-		std::string _data;
-		Wt::Dbo::ptr<Track> _track;
+		int							_schemaVersion {};
+		std::vector<unsigned char>	_featureValues;	// packed floats, see getFeatureDefs
+		Wt::Dbo::ptr<Track>			_track;
 };
 
 
@@ -87,6 +87,9 @@ class TrackList : public Object<TrackList, TrackListId>
 		std::size_t									getCount() const;
 		ObjectPtr<TrackListEntry>					getEntry(std::size_t pos) const;
 		std::vector<ObjectPtr<TrackListEntry>>		getEntries(std::optional<std::size_t> offset = {}, std::optional<std::size_t> size = {}) const;
+		// Keyset pagination: no need to walk the skipped entries, unlike offsets
+		std::vector<ObjectPtr<TrackListEntry>>		getEntriesAfter(TrackListEntryId entryId, std::size_t size) const;
+		std::vector<ObjectPtr<TrackListEntry>>		getEntriesBefore(TrackListEntryId entryId, std::size_t size) const; // still ordered by position
 		ObjectPtr<TrackListEntry>					getEntryByTrackAndDateTime(ObjectPtr<Track> track, const Wt::WDateTime& dateTime) const;
 
 		std::vector<ObjectPtr<Artist>>				getArtists(const std::vector<ClusterId>& clusters, std::optional<TrackArtistLinkType> linkType, ArtistSortMethod sortMethod, std::optional<Range> range, bool& moreResults) const;
@@ -141,9 +144,16 @@ class TrackListEntry : public Object<TrackListEntry, TrackListEntryId>
 
 		// Create utility
 		static pointer create(Session& session, ObjectPtr<Track> track, ObjectPtr<TrackList> tracklist, const Wt::WDateTime& dateTime = {});
+		// Bulk version, appends the existing tracks in order using multi-row inserts. Returns the number of created entries
+		static std::size_t create(Session& session, const std::vector<TrackId>& trackIds, ObjectPtr<TrackList> tracklist, const Wt::WDateTime& dateTime = {});
+
+		// Bulk removal utility, positions refer to the entries before the removal. Out of range positions are ignored. Returns the number of removed entries
+		static std::size_t remove(Session& session, ObjectPtr<TrackList> tracklist, const std::vector<std::size_t>& positions);
+		static void removeAll(Session& session, ObjectPtr<TrackList> tracklist);
 
 		// Accessors
 		ObjectPtr<Track>	getTrack() const { return _track; }
+		TrackId				getTrackId() const { return _track.id(); }
 		const Wt::WDateTime& getDateTime() const { return _dateTime; }
 
 		template<class Action>
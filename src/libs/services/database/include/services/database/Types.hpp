@@ -100,6 +100,7 @@ namespace Database
 		Date,
 		Random,
 		LastWritten,
+		AddedDesc,	// most recently added first
 		StarredDateDesc,
 	};
 
@@ -108,7 +109,9 @@ namespace Database
 		None,
 		Random,
 		LastWritten,
+		AddedDesc,	// most recently added first
 		StarredDateDesc,
+		FilePath,
 	};
 
 	enum class TrackArtistLinkType
@@ -136,6 +139,16 @@ namespace Database
 		MATROSKA_OPUS	= 5,
 	};
 
+	// Codec of the audio stream of the tracks, Opus and Vorbis streams are in an Ogg container
+	enum class AudioCodec
+	{
+		Unknown	= 0,
+		MP3		= 1,
+		Opus	= 2,
+		Vorbis	= 3,
+		FLAC	= 4,
+	};
+
 	using Bitrate = std::uint32_t;
 	// Do not remove values!
 	void visitAllowedAudioBitrates(std::function<void(Bitrate)>);
@@ -95,7 +95,8 @@ class User : public Object<User, UserId>
 		void clearAuthTokens();
 		void setSubsonicArtistListMode(SubsonicArtistListMode mode)	{ _subsonicArtistListMode = mode; }
 		void setScrobbler(Scrobbler scrobbler)	{ _scrobbler = scrobbler; }
-		void setListenBrainzToken(const std::optional<UUID>& MBID)	{ _listenbrainzToken = MBID ? MBID->getAsString() : ""; }
+		void setListenBrainzToken(const std::optional<UUID>& MBID)	{ _listenbrainzToken = MBID ? MBID->getAsString() : ""; _listenbrainzSyncCursor = {}; }
+		void setListenBrainzSyncCursor(const Wt::WDateTime& dateTime)	{ _listenbrainzSyncCursor = dateTime; }
 
 		// read
 		bool			isAdmin() const { return _type == UserType::ADMIN; }
@@ -111,6 +112,7 @@ class User : public Object<User, UserId>
 		SubsonicArtistListMode	getSubsonicArtistListMode() const { return _subsonicArtistListMode; }
 		Scrobbler				getScrobbler() const { return _scrobbler; }
 		std::optional<UUID>		getListenBrainzToken() const	{ return UUID::fromString(_listenbrainzToken); }
+		const Wt::WDateTime&	getListenBrainzSyncCursor() const { return _listenbrainzSyncCursor; } // most recent synchronized listen
 
 		template<class Action>
 		void persist(Action& a)
@@ -127,6 +129,7 @@ class User : public Object<User, UserId>
 			Wt::Dbo::field(a, _uiTheme, "ui_theme");
 			Wt::Dbo::field(a, _scrobbler, "scrobbler");
 			Wt::Dbo::field(a, _listenbrainzToken, "listenbrainz_token");
+			Wt::Dbo::field(a, _listenbrainzSyncCursor, "listenbrainz_sync_cursor");
 
 			// UI player settings
 			Wt::Dbo::field(a, _curPlayingTrackPos, "cur_playing_track_pos");
@@ -144,6 +147,7 @@ class User : public Object<User, UserId>
 		UITheme		_uiTheme {defaultUITheme};
 		Scrobbler	_scrobbler {defaultScrobbler};
 		std::string	_listenbrainzToken; // Musicbrainz Identifier
+		Wt::WDateTime	_listenbrainzSyncCursor;
 
 		// Admin defined settings
 		UserType		_type {UserType::REGULAR};
@@ -315,6 +315,37 @@ TEST_F(DatabaseFixture, Artist_sortMethod)
 	}
 }
 
+TEST_F(DatabaseFixture, Artist_sortKey)
+{
+	ScopedArtist artistA {session, "The Zombies"};
+	ScopedArtist artistB {session, "Émilie Simon"};
+	ScopedArtist artistC {session, "motörhead"};
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto artists {Artist::find(session, Artist::FindParameters {}.setSortMethod(ArtistSortMethod::ByName))};
+		ASSERT_EQ(artists.results.size(), 3);
+		EXPECT_EQ(artists.results[0], artistB.getId());
+		EXPECT_EQ(artists.results[1], artistC.getId());
+		EXPECT_EQ(artists.results[2], artistA.getId());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		artistA.get().modify()->setName("Abba");
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto artists {Artist::find(session, Artist::FindParameters {}.setSortMethod(ArtistSortMethod::ByName))};
+		ASSERT_EQ(artists.results.size(), 3);
+		EXPECT_EQ(artists.results[0], artistA.getId());
+	}
+}
+
 TEST_F(DatabaseFixture, Artist_nonReleaseTracks)
 {
 	ScopedArtist artist {session, "artist"};
@@ -351,3 +382,54 @@ TEST_F(DatabaseFixture, Artist_nonReleaseTracks)
 	}
 }
 
+
+TEST_F(DatabaseFixture, Artist_summary)
+{
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedRelease release1 {session, "MyRelease1"};
+	ScopedRelease release2 {session, "MyRelease2"};
+	ScopedArtist artist {session, "MyArtist"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		TrackArtistLink::create(session, track1.get(), artist.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track1.get(), artist.get(), TrackArtistLinkType::ReleaseArtist);
+		TrackArtistLink::create(session, track2.get(), artist.get(), TrackArtistLinkType::Artist);
+		track1.get().modify()->setRelease(release1.get());
+		track2.get().modify()->setRelease(release1.get());
+
+		EXPECT_EQ(Artist::updateSummaries(session, 10), 1);
+		EXPECT_EQ(Artist::updateSummaries(session, 10), 0);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_EQ(artist->getSummary().releaseCount, 1);
+		EXPECT_EQ(artist->getSummary().trackCount, 2);
+		EXPECT_EQ(artist->getSummary(TrackArtistLinkType::Artist).trackCount, 2);
+		EXPECT_EQ(artist->getSummary(TrackArtistLinkType::ReleaseArtist).trackCount, 1);
+		EXPECT_EQ(artist->getSummary(TrackArtistLinkType::Writer).trackCount, 0);
+
+		const auto summaries {Artist::getSummaries(session, TrackArtistLinkType::ReleaseArtist)};
+		ASSERT_EQ(summaries.size(), 1);
+		EXPECT_EQ(summaries.at(artist.getId()).releaseCount, 1);
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track2.get().modify()->setRelease(release2.get());
+		EXPECT_EQ(Artist::updateSummaries(session, 10), 1);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_EQ(artist->getSummary().releaseCount, 2);
+		EXPECT_EQ(artist->getSummary(TrackArtistLinkType::ReleaseArtist).releaseCount, 1);
+		EXPECT_EQ(artist->getSummary().releaseCount, artist->getReleaseCount());
+	}
+}
@@ -21,6 +21,9 @@
 
 #include <algorithm>
 #include <list>
+#include <set>
+
+#include "services/database/ClusterCatalog.hpp"
 
 using namespace Database;
 
@@ -143,6 +146,44 @@ TEST_F(DatabaseFixture, Cluster_singleTrack)
 	}
 }
 
+TEST_F(DatabaseFixture, Cluster_randomTracks)
+{
+	// enough tracks to probe random ids instead of the whole table
+	std::list<ScopedTrack> tracks;
+	ScopedClusterType clusterType {session, "MyClusterType"};
+	ScopedCluster cluster {session, clusterType.lockAndGet(), "MyCluster"};
+
+	for (std::size_t i {}; i < 300; ++i)
+	{
+		tracks.emplace_back(session, "MyTrack" + std::to_string(i));
+
+		if (i % 2 == 0)
+		{
+			auto transaction {session.createUniqueTransaction()};
+			cluster.get().modify()->addTrack(tracks.back().get());
+		}
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto randomTracks {Track::find(session, Track::FindParameters {}.setSortMethod(TrackSortMethod::Random).setRange({0, 10}))};
+		EXPECT_EQ(randomTracks.results.size(), 10);
+		EXPECT_EQ(std::set<TrackId>(std::cbegin(randomTracks.results), std::cend(randomTracks.results)).size(), 10);
+
+		const auto randomClusterTracks {Track::find(session, Track::FindParameters {}.setClusters({cluster.getId()}).setSortMethod(TrackSortMethod::Random).setRange({0, 20}))};
+		EXPECT_EQ(randomClusterTracks.results.size(), 20);
+		for (const TrackId trackId : randomClusterTracks.results)
+		{
+			const auto track {Track::find(session, trackId)};
+			ASSERT_TRUE(track);
+			EXPECT_EQ(track->getClusterIds().size(), 1);
+		}
+
+		EXPECT_EQ(Track::find(session, Track::FindParameters {}.setClusters({cluster.getId()}).setSortMethod(TrackSortMethod::Random)).results.size(), 150);
+	}
+}
+
 TEST_F(DatabaseFixture, Cluster_multiTracks)
 {
 	std::list<ScopedTrack> tracks;
@@ -1092,4 +1133,49 @@ TEST_F(DatabaseFixture, MultipleTracksMultipleReleasesMultiClusters)
 	}
 }
 
+TEST_F(DatabaseFixture, ClusterCatalog)
+{
+	ScopedTrack track1 {session, "MyTrackFile1"};
+	ScopedTrack track2 {session, "MyTrackFile2"};
+	ScopedRelease release {session, "MyRelease"};
+	ScopedClusterType clusterType {session, "MyClusterType"};
+	ScopedClusterType unusedClusterType {session, "MyUnusedClusterType"};
+	ScopedCluster cluster1 {session, clusterType.lockAndGet(), "MyCluster1"};
+	ScopedCluster cluster2 {session, clusterType.lockAndGet(), "MyCluster2"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
 
+		track1.get().modify()->setRelease(release.get());
+		track2.get().modify()->setRelease(release.get());
+		cluster1.get().modify()->addTrack(track1.get());
+		cluster1.get().modify()->addTrack(track2.get());
+	}
+
+	session.getDb().buildClusterCatalog();
+
+	const std::shared_ptr<const ClusterCatalog> catalog {session.getDb().getClusterCatalog()};
+	ASSERT_TRUE(catalog);
+	EXPECT_EQ(ClusterCatalog::get(session), catalog);
+
+	ASSERT_EQ(catalog->getClusterTypes().size(), 1);
+	const ClusterCatalog::ClusterType& catalogClusterType {catalog->getClusterTypes().front()};
+	EXPECT_EQ(catalogClusterType.id, clusterType.getId());
+	EXPECT_EQ(catalogClusterType.name, "MyClusterType");
+	EXPECT_EQ(catalog->findClusterType("MyClusterType"), &catalogClusterType);
+	EXPECT_EQ(catalog->findClusterType("MyUnusedClusterType"), nullptr);
+
+	ASSERT_EQ(catalogClusterType.clusters.size(), 2);
+	EXPECT_EQ(catalogClusterType.clusters[0].id, cluster1.getId());
+	EXPECT_EQ(catalogClusterType.clusters[0].trackCount, 2);
+	EXPECT_EQ(catalogClusterType.clusters[0].releaseCount, 1);
+	EXPECT_EQ(catalogClusterType.clusters[1].id, cluster2.getId());
+	EXPECT_EQ(catalogClusterType.clusters[1].trackCount, 0);
+	EXPECT_EQ(catalogClusterType.clusters[1].releaseCount, 0);
+
+	const ClusterCatalog::Cluster* catalogCluster {catalog->findCluster("MyClusterType", "MyCluster2")};
+	ASSERT_TRUE(catalogCluster);
+	EXPECT_EQ(catalogCluster->id, cluster2.getId());
+	EXPECT_EQ(catalog->findCluster("MyClusterType", "MyCluster3"), nullptr);
+	EXPECT_EQ(catalog->findCluster("MyUnusedClusterType", "MyCluster1"), nullptr);
+}
@@ -19,9 +19,12 @@
 
 #include "Common.hpp"
 
+#include <Wt/Dbo/backend/Sqlite3.h>
+
 #include "services/database/Artist.hpp"
 #include "services/database/Cluster.hpp"
 #include "services/database/Db.hpp"
+#include "services/database/Directory.hpp"
 #include "services/database/Listen.hpp"
 #include "services/database/Release.hpp"
 #include "services/database/Session.hpp"
@@ -81,6 +84,25 @@ DatabaseFixture::TearDownTestCase()
 	_tmpDb.reset();
 }
 
+std::vector<std::string>
+DatabaseFixture::getQueryPlan(const std::string& sql)
+{
+	// Use a dedicated connection: the session cannot run raw statements that do not map to a query
+	Wt::Dbo::backend::Sqlite3 connection {_tmpDb->getPath().string()};
+	std::unique_ptr<Wt::Dbo::SqlStatement> statement {connection.prepareStatement("EXPLAIN QUERY PLAN " + sql)};
+	statement->execute();
+
+	std::vector<std::string> details;
+	while (statement->nextRow())
+	{
+		std::string detail;
+		if (statement->getResult(3, &detail, 0))
+			details.push_back(detail);
+	}
+
+	return details;
+}
+
 void
 DatabaseFixture::testDatabaseEmpty()
 {
@@ -91,6 +113,7 @@ DatabaseFixture::testDatabaseEmpty()
 	EXPECT_EQ(Artist::getCount(session), 0);
 	EXPECT_EQ(Cluster::getCount(session), 0);
 	EXPECT_EQ(ClusterType::getCount(session), 0);
+	EXPECT_EQ(Directory::getCount(session), 0);
 	EXPECT_EQ(Listen::getCount(session), 0);
 	EXPECT_EQ(Release::getCount(session), 0);
 	EXPECT_EQ(StarredArtist::getCount(session), 0);
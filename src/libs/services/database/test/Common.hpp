@@ -21,12 +21,15 @@
 
 #include <filesystem>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include "services/database/Artist.hpp"
 #include "services/database/Cluster.hpp"
 #include "services/database/Db.hpp"
+#include "services/database/Directory.hpp"
 #include "services/database/Listen.hpp"
 #include "services/database/Release.hpp"
 #include "services/database/Session.hpp"
@@ -98,6 +101,7 @@ class ScopedEntity
 using ScopedArtist = ScopedEntity<Database::Artist>;
 using ScopedCluster = ScopedEntity<Database::Cluster>;
 using ScopedClusterType = ScopedEntity<Database::ClusterType>;
+using ScopedDirectory = ScopedEntity<Database::Directory>;
 using ScopedRelease = ScopedEntity<Database::Release>;
 using ScopedTrack = ScopedEntity<Database::Track>;
 using ScopedTrackList = ScopedEntity<Database::TrackList>;
@@ -124,6 +128,7 @@ class TmpDatabase final
 		TmpDatabase ();
 
 		Database::Db& getDb();
+		const std::filesystem::path& getPath() const { return _tmpFile; }
 
 	private:
 		const std::filesystem::path _tmpFile;
@@ -140,6 +145,9 @@ public:
     static void SetUpTestCase();
     static void TearDownTestCase();
 
+	// Details of each step of the sqlite query plan
+	static std::vector<std::string> getQueryPlan(const std::string& sql);
+
 private:
 	void testDatabaseEmpty();
 
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <thread>
+
+#include "Common.hpp"
+
+using namespace Database;
+
+TEST(Database, DbStats)
+{
+	const std::filesystem::path tmpFile {std::tmpnam(nullptr)};
+	ScopedFileDeleter fileDeleter {tmpFile};
+
+	ConnectionSettings connectionSettings;
+	connectionSettings.collectStats = true;
+	Db db {tmpFile, 10, Db::ConcurrencyMode::ApplicationLock, connectionSettings};
+	if (!db.isSQLiteApiUsable())
+		GTEST_SKIP() << "Stats not supported";
+
+	{
+		Session session {db};
+		session.prepareTables();
+
+		auto transaction {session.createSharedTransaction()};
+		EXPECT_EQ(Track::getCount(session), 0);
+	}
+
+	const std::optional<DbStats> stats {db.getStats()};
+	ASSERT_TRUE(stats);
+	EXPECT_GT(stats->sharedLocks.count, 0);
+	EXPECT_GT(stats->uniqueLocks.count, 0);
+
+	auto itQuery {std::find_if(std::cbegin(stats->queries), std::cend(stats->queries), [](const QueryStats& query) { return query.sql.find("SELECT COUNT(*) FROM track") != std::string::npos; })};
+	ASSERT_NE(itQuery, std::cend(stats->queries));
+	EXPECT_EQ(itQuery->count, 1);
+	EXPECT_EQ(itQuery->rowCount, 1);
+	EXPECT_GE(itQuery->p99Duration, itQuery->totalDuration);
+
+	EXPECT_TRUE(std::is_sorted(std::cbegin(stats->queries), std::cend(stats->queries), [](const QueryStats& lhs, const QueryStats& rhs) { return lhs.totalDuration > rhs.totalDuration; }));
+}
+
+TEST_F(DatabaseFixture, DbStats_disabled)
+{
+	EXPECT_FALSE(session.getDb().getStats());
+}
+
+TEST_F(DatabaseFixture, Db_isReachable)
+{
+	EXPECT_TRUE(session.getDb().isReachable());
+
+	// must not wait for the lock
+	auto transaction {session.createUniqueTransaction()};
+	EXPECT_TRUE(session.getDb().isReachable());
+}
+
+TEST_F(DatabaseFixture, Db_backup)
+{
+	ScopedTrack track {session, "MyTrack"};
+
+	const std::filesystem::path backupFile {std::tmpnam(nullptr)};
+	ScopedFileDeleter fileDeleter {backupFile};
+
+	Db& db {session.getDb()};
+	if (!db.isSQLiteApiUsable())
+		GTEST_SKIP() << "Backups not supported";
+
+	ASSERT_TRUE(db.startBackup(backupFile));
+
+	std::optional<DbBackupStatus> status;
+	while ((status = db.getBackupStatus()) && status->state == DbBackupStatus::State::InProgress)
+		std::this_thread::sleep_for(std::chrono::milliseconds {10});
+
+	ASSERT_TRUE(status);
+	EXPECT_EQ(status->state, DbBackupStatus::State::Complete) << status->error;
+	EXPECT_EQ(status->backupPath, backupFile);
+	EXPECT_GT(status->totalPageCount, 0);
+	EXPECT_EQ(status->copiedPageCount, status->totalPageCount);
+
+	{
+		Db backupDb {backupFile};
+		Session backupSession {backupDb};
+
+		auto transaction {backupSession.createSharedTransaction()};
+		EXPECT_EQ(Track::getCount(backupSession), 1);
+	}
+}
+
+TEST_F(DatabaseFixture, Db_reclaimFreePages)
+{
+	Db& db {session.getDb()};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		for (std::size_t i {}; i < 1000; ++i)
+			Track::create(session, "/MyTrack" + std::to_string(i) + ".mp3").modify()->setName(std::string(128, 'a'));
+	}
+	{
+		auto transaction {session.createUniqueTransaction()};
+		session.getDboSession().execute("DELETE FROM track");
+	}
+
+	const Db::FreeSpace freeSpace {db.getFreeSpace()};
+	EXPECT_GT(freeSpace.pageSize, 0);
+	ASSERT_GT(freeSpace.freePageCount, 1);
+
+	EXPECT_EQ(db.reclaimFreePages(1), 1);
+	EXPECT_EQ(db.getFreeSpace().freePageCount, freeSpace.freePageCount - 1);
+
+	EXPECT_EQ(db.reclaimFreePages(freeSpace.freePageCount), freeSpace.freePageCount - 1);
+	EXPECT_EQ(db.getFreeSpace().freePageCount, 0);
+	EXPECT_EQ(db.reclaimFreePages(1), 0);
+}
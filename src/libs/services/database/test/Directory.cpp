@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Common.hpp"
+
+using namespace Database;
+
+TEST_F(DatabaseFixture, Directory)
+{
+	{
+		auto transaction {session.createSharedTransaction()};
+		EXPECT_EQ(Directory::getCount(session), 0);
+		EXPECT_FALSE(Directory::findByPath(session, "/root/dir"));
+	}
+
+	ScopedDirectory directory {session, "/root/dir"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		directory.get().modify()->setEntryCount(5);
+		directory.get().modify()->setScanVersion(2);
+		directory.get().modify()->setLastWriteTime(Wt::WDateTime::fromTime_t(1000));
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_EQ(Directory::getCount(session), 1);
+
+		const Directory::pointer dir {Directory::findByPath(session, "/root/dir")};
+		ASSERT_TRUE(dir);
+		EXPECT_EQ(dir->getId(), directory.getId());
+		EXPECT_EQ(dir->getPath(), "/root/dir");
+		EXPECT_EQ(dir->getEntryCount(), 5);
+		EXPECT_EQ(dir->getScanVersion(), 2);
+		EXPECT_EQ(dir->getLastWriteTime(), Wt::WDateTime::fromTime_t(1000));
+
+		EXPECT_FALSE(Directory::findByPath(session, "/root"));
+
+		const auto directories {Directory::find(session, Range {})};
+		ASSERT_EQ(directories.results.size(), 1);
+		EXPECT_EQ(directories.results.front()->getId(), directory.getId());
+	}
+}
+
+TEST_F(DatabaseFixture, Directory_tree)
+{
+	ScopedDirectory root {session, "/root"};
+	ScopedDirectory dirB {session, "/root/b", root.lockAndGet()};
+	ScopedDirectory dirA {session, "/root/a", root.lockAndGet()};
+	ScopedRelease release {session, "MyRelease"};
+	ScopedTrack track {session, "/root/a/track.mp3"};
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_EQ(root->getName(), "root");
+		EXPECT_FALSE(root->getParentId().isValid());
+		EXPECT_EQ(dirA->getName(), "a");
+		EXPECT_EQ(dirA->getParentId(), root.getId());
+
+		const auto rootDirectories {Directory::findRootDirectories(session, Range {})};
+		ASSERT_EQ(rootDirectories.results.size(), 1);
+		EXPECT_EQ(rootDirectories.results.front(), root.getId());
+
+		const auto children {Directory::findChildren(session, root.getId(), Range {})};
+		ASSERT_EQ(children.results.size(), 2);
+		EXPECT_EQ(children.results[0], dirA.getId());
+		EXPECT_EQ(children.results[1], dirB.getId());
+
+		EXPECT_TRUE(Directory::findChildren(session, dirA.getId(), Range {}).results.empty());
+
+		const auto orphans {Directory::findOrphans(session, Range {})};
+		ASSERT_EQ(orphans.results.size(), 2);
+
+		EXPECT_FALSE(dirA->getCoverReleaseId());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track.get().modify()->setPath(dirA.get(), "track.mp3");
+		track.get().modify()->setRelease(release.get());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_EQ(track->getDirectoryId(), dirA.getId());
+		EXPECT_EQ(track->getFileName(), "track.mp3");
+		EXPECT_EQ(track->getPath(), "/root/a/track.mp3");
+		EXPECT_EQ(Track::findByPath(session, "/root/a/track.mp3"), track.get());
+		EXPECT_FALSE(Track::findByPath(session, "/root/b/track.mp3"));
+
+		const auto orphans {Directory::findOrphans(session, Range {})};
+		ASSERT_EQ(orphans.results.size(), 1);
+		EXPECT_EQ(orphans.results.front(), dirB.getId());
+
+		const auto tracks {Track::find(session, Track::FindParameters {}.setDirectory(dirA.getId()))};
+		ASSERT_EQ(tracks.results.size(), 1);
+		EXPECT_EQ(tracks.results.front(), track.getId());
+		EXPECT_TRUE(Track::find(session, Track::FindParameters {}.setDirectory(dirB.getId())).results.empty());
+
+		EXPECT_EQ(dirA->getCoverReleaseId(), release.getId());
+	}
+}
+
+TEST_F(DatabaseFixture, Directory_removeOrphans)
+{
+	ScopedDirectory kept {session, "/root/kept"};
+	ScopedTrack track {session, "MyTrack"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track.get().modify()->setPath(kept.get(), "MyTrack");
+
+		const Directory::pointer root {Directory::create(session, "/root/removed")};
+		const Directory::pointer child {Directory::create(session, "/root/removed/a", root)};
+		Directory::create(session, "/root/removed/a/b", child);
+		Directory::create(session, "/root/removed/c", root);
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		EXPECT_EQ(Directory::getOrphanCount(session), 2);
+
+		EXPECT_EQ(Directory::removeOrphans(session, 1), 1);
+
+		// Removing a directory may make its parent an orphan too
+		std::size_t removedCount {1};
+		while (const std::size_t count {Directory::removeOrphans(session, 10)})
+			removedCount += count;
+		EXPECT_EQ(removedCount, 4);
+
+		EXPECT_EQ(Directory::getCount(session), 1);
+		EXPECT_EQ(Directory::getOrphanCount(session), 0);
+		EXPECT_TRUE(Directory::findByPath(session, "/root/kept"));
+	}
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Common.hpp"
+
+#include "services/database/generator/LibraryGenerator.hpp"
+
+using namespace Database;
+
+TEST(LibraryGenerator, generate)
+{
+	TmpDatabase tmpDb;
+	{
+		Session session {tmpDb.getDb()};
+		session.prepareTables();
+	}
+
+	Generator::LibraryParameters parameters;
+	parameters.artistCount = 20;
+	parameters.userCount = 2;
+	parameters.listensPerUser = 30;
+	parameters.playlistsPerUser = 2;
+	parameters.tracksPerPlaylist = 5;
+	parameters.trackFeaturesPercent = 50;
+
+	std::size_t lastGeneratedArtistCount {};
+	const Generator::Library library {Generator::generateLibrary(tmpDb.getDb(), parameters, [&](std::size_t generatedArtistCount) { lastGeneratedArtistCount = generatedArtistCount; })};
+	EXPECT_EQ(lastGeneratedArtistCount, parameters.artistCount);
+
+	EXPECT_EQ(library.userIds.size(), 2);
+	EXPECT_EQ(library.artistIds.size(), 20);
+	EXPECT_GE(library.releaseIds.size(), 20);
+	EXPECT_GE(library.trackIds.size(), library.releaseIds.size());
+	EXPECT_EQ(library.trackListIds.size(), 4);
+
+	Session session {tmpDb.getDb()};
+	auto transaction {session.createSharedTransaction()};
+
+	EXPECT_EQ(Artist::getCount(session), 20);
+	EXPECT_EQ(Release::getCount(session), library.releaseIds.size());
+	EXPECT_EQ(Track::getCount(session), library.trackIds.size());
+	EXPECT_GT(TrackFeatures::getCount(session), 0);
+	EXPECT_LT(TrackFeatures::getCount(session), library.trackIds.size());
+
+	// Everything is linked
+	EXPECT_TRUE(Artist::findAllOrphans(session, Range {}).results.empty());
+	EXPECT_TRUE(Release::findOrphans(session, Range {}).results.empty());
+
+	const TrackList::pointer trackList {TrackList::find(session, library.trackListIds.front())};
+	ASSERT_TRUE(trackList);
+	EXPECT_EQ(trackList->getCount(), 5);
+}
+
+TEST(LibraryGenerator, sameSeedSameLibrary)
+{
+	Generator::LibraryParameters parameters;
+	parameters.artistCount = 10;
+	parameters.listensPerUser = 0;
+
+	auto getTrackDescriptions {[&]
+	{
+		TmpDatabase tmpDb;
+		{
+			Session session {tmpDb.getDb()};
+			session.prepareTables();
+		}
+
+		const Generator::Library library {Generator::generateLibrary(tmpDb.getDb(), parameters)};
+
+		Session session {tmpDb.getDb()};
+		auto transaction {session.createSharedTransaction()};
+
+		std::vector<std::string> res;
+		for (const TrackId trackId : library.trackIds)
+		{
+			const Track::pointer track {Track::find(session, trackId)};
+			const std::optional<UUID> recordingMBID {track->getRecordingMBID()};
+			res.push_back(track->getName() + " " + (recordingMBID ? recordingMBID->getAsString() : ""));
+		}
+
+		return res;
+	}};
+
+	EXPECT_EQ(getTrackDescriptions(), getTrackDescriptions());
+}
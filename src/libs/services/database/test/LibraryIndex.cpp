@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Common.hpp"
+
+#include <list>
+#include <set>
+
+#include "services/database/Db.hpp"
+
+using namespace Database;
+
+namespace
+{
+	template <typename IdType>
+	std::set<IdType> toSet(const std::vector<IdType>& ids)
+	{
+		return std::set<IdType>(std::cbegin(ids), std::cend(ids));
+	}
+}
+
+TEST_F(DatabaseFixture, LibraryIndex)
+{
+	ScopedClusterType clusterType {session, "MyClusterType"};
+	ScopedCluster cluster1 {session, clusterType.lockAndGet(), "MyCluster1"};
+	ScopedCluster cluster2 {session, clusterType.lockAndGet(), "MyCluster2"};
+	ScopedCluster unusedCluster {session, clusterType.lockAndGet(), "UnusedCluster"};
+	ScopedRelease release1 {session, "MyRelease1"};
+	ScopedRelease release2 {session, "MyRelease2"};
+	ScopedArtist artist1 {session, "MyArtist1"};
+	ScopedArtist artist2 {session, "MyArtist2"};
+
+	std::list<ScopedTrack> tracks;
+	for (std::size_t i {}; i < 10; ++i)
+	{
+		tracks.emplace_back(session, "MyTrack" + std::to_string(i));
+
+		auto transaction {session.createUniqueTransaction()};
+
+		Track::pointer track {tracks.back().get()};
+		track.modify()->setRelease(i % 2 == 0 ? release1.get() : release2.get());
+		TrackArtistLink::create(session, track, i < 5 ? artist1.get() : artist2.get(), i % 3 == 0 ? TrackArtistLinkType::Artist : TrackArtistLinkType::Composer);
+
+		std::vector<Cluster::pointer> clusters {cluster1.get()};
+		if (i % 2 == 0)
+			clusters.push_back(cluster2.get());
+		track.modify()->setClusters(clusters);
+	}
+
+	const std::vector<Track::FindParameters> trackParams
+	{
+		Track::FindParameters {}.setClusters({cluster1.getId()}),
+		Track::FindParameters {}.setClusters({cluster1.getId(), cluster2.getId()}),
+		Track::FindParameters {}.setClusters({cluster1.getId(), unusedCluster.getId()}),
+		Track::FindParameters {}.setClusters({cluster1.getId()}).setSortMethod(TrackSortMethod::Random).setRange({2, 5}),
+	};
+	const std::vector<Release::FindParameters> releaseParams
+	{
+		Release::FindParameters {}.setClusters({cluster1.getId()}).setSortMethod(ReleaseSortMethod::Name),
+		Release::FindParameters {}.setClusters({cluster1.getId(), cluster2.getId()}).setSortMethod(ReleaseSortMethod::Name),
+		Release::FindParameters {}.setClusters({cluster1.getId()}).setSortMethod(ReleaseSortMethod::Name).setRange({1, 1}),
+	};
+	const std::vector<Artist::FindParameters> artistParams
+	{
+		Artist::FindParameters {}.setClusters({cluster1.getId()}).setSortMethod(ArtistSortMethod::ByName),
+		Artist::FindParameters {}.setClusters({cluster1.getId(), cluster2.getId()}).setSortMethod(ArtistSortMethod::ByName),
+		Artist::FindParameters {}.setClusters({cluster2.getId()}).setSortMethod(ArtistSortMethod::ByName).setLinkType(TrackArtistLinkType::Composer),
+		Artist::FindParameters {}.setClusters({cluster1.getId()}).setSortMethod(ArtistSortMethod::ByName).setRange({0, 1}),
+	};
+
+	std::vector<RangeResults<TrackId>> sqlTracks;
+	std::vector<RangeResults<ReleaseId>> sqlReleases;
+	std::vector<RangeResults<ArtistId>> sqlArtists;
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		for (const Track::FindParameters& params : trackParams)
+			sqlTracks.push_back(Track::find(session, params));
+		for (const Release::FindParameters& params : releaseParams)
+			sqlReleases.push_back(Release::find(session, params));
+		for (const Artist::FindParameters& params : artistParams)
+			sqlArtists.push_back(Artist::find(session, params));
+	}
+
+	EXPECT_EQ(sqlTracks[0].results.size(), 10);
+	EXPECT_EQ(sqlTracks[1].results.size(), 5);
+	EXPECT_TRUE(sqlTracks[2].results.empty());
+	EXPECT_EQ(sqlReleases[0].results.size(), 2);
+	EXPECT_EQ(sqlArtists[2].results.size(), 2);
+
+	session.getDb().buildLibraryIndex();
+	ASSERT_TRUE(session.getDb().getLibraryIndex());
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		for (std::size_t i {}; i < trackParams.size(); ++i)
+		{
+			const auto indexTracks {Track::find(session, trackParams[i])};
+			EXPECT_EQ(indexTracks.range.offset, sqlTracks[i].range.offset);
+			EXPECT_EQ(indexTracks.moreResults, sqlTracks[i].moreResults);
+			EXPECT_EQ(indexTracks.results.size(), sqlTracks[i].results.size());
+			if (trackParams[i].sortMethod == TrackSortMethod::None)
+				EXPECT_EQ(toSet(indexTracks.results), toSet(sqlTracks[i].results));
+		}
+
+		for (std::size_t i {}; i < releaseParams.size(); ++i)
+		{
+			const auto releases {Release::find(session, releaseParams[i])};
+			EXPECT_EQ(releases.results, sqlReleases[i].results);
+			EXPECT_EQ(releases.moreResults, sqlReleases[i].moreResults);
+		}
+
+		for (std::size_t i {}; i < artistParams.size(); ++i)
+		{
+			const auto artists {Artist::find(session, artistParams[i])};
+			EXPECT_EQ(artists.results, sqlArtists[i].results);
+			EXPECT_EQ(artists.moreResults, sqlArtists[i].moreResults);
+		}
+	}
+
+	session.getDb().clearLibraryIndex();
+}
@@ -901,3 +901,136 @@ TEST_F(DatabaseFixture, Listen_getRecentTracks_cluster)
 	}
 }
 
+
+TEST_F(DatabaseFixture, Listen_removedListens)
+{
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedUser user {session, "MyUser"};
+	const Wt::WDateTime dateTime {Wt::WDate{2000, 1, 2}, Wt::WTime{12,0, 1}};
+
+	ScopedListen listen1 {session, user.lockAndGet(), track1.lockAndGet(), Scrobbler::Internal, dateTime};
+	ScopedListen listen2 {session, user.lockAndGet(), track2.lockAndGet(), Scrobbler::Internal, dateTime.addSecs(1)};
+
+	{
+		ScopedListen listen3 {session, user.lockAndGet(), track1.lockAndGet(), Scrobbler::Internal, dateTime.addSecs(2)};
+		ScopedListen listen4 {session, user.lockAndGet(), track1.lockAndGet(), Scrobbler::Internal, dateTime.addSecs(3)};
+
+		auto transaction {session.createSharedTransaction()};
+
+		auto tracks {Listen::getTopTracks(session, user->getId(), Scrobbler::Internal, {})};
+		ASSERT_EQ(tracks.results.size(), 2);
+		EXPECT_EQ(tracks.results[0], track1.getId());
+		EXPECT_EQ(tracks.results[1], track2.getId());
+
+		tracks = Listen::getRecentTracks(session, user->getId(), Scrobbler::Internal, {});
+		ASSERT_EQ(tracks.results.size(), 2);
+		EXPECT_EQ(tracks.results[0], track1.getId());
+		EXPECT_EQ(tracks.results[1], track2.getId());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		// track1 was listened before track2 now
+		auto tracks {Listen::getRecentTracks(session, user->getId(), Scrobbler::Internal, {})};
+		ASSERT_EQ(tracks.results.size(), 2);
+		EXPECT_EQ(tracks.results[0], track2.getId());
+		EXPECT_EQ(tracks.results[1], track1.getId());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		Listen::create(session, user.get(), track2.get(), Scrobbler::Internal, dateTime.addSecs(10));
+		Listen::create(session, user.get(), track2.get(), Scrobbler::Internal, dateTime.addSecs(11));
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		auto tracks {Listen::getTopTracks(session, user->getId(), Scrobbler::Internal, {})};
+		ASSERT_EQ(tracks.results.size(), 2);
+		EXPECT_EQ(tracks.results[0], track2.getId());
+		EXPECT_EQ(tracks.results[1], track1.getId());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		Listen::find(session, user.getId(), track2.getId(), Scrobbler::Internal, dateTime.addSecs(10)).remove();
+		Listen::find(session, user.getId(), track2.getId(), Scrobbler::Internal, dateTime.addSecs(11)).remove();
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		auto tracks {Listen::getRecentTracks(session, user->getId(), Scrobbler::Internal, {})};
+		ASSERT_EQ(tracks.results.size(), 2);
+		EXPECT_EQ(tracks.results[0], track2.getId());
+		EXPECT_EQ(tracks.results[1], track1.getId());
+	}
+}
+
+TEST_F(DatabaseFixture, Listen_compact)
+{
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedUser user {session, "MyUser"};
+	const Wt::WDateTime dateTime {Wt::WDate {2000, 1, 2}, Wt::WTime {12, 0, 1}};
+	const Wt::WDateTime compactDateTime {Wt::WDate {2000, 6, 1}};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		for (int i {}; i < 3; ++i)
+			Listen::create(session, user.get(), track1.get(), Scrobbler::Internal, dateTime.addSecs(i)).modify()->setScrobblingState(ScrobblingState::Synchronized);
+
+		// pending listens must be kept
+		Listen::create(session, user.get(), track2.get(), Scrobbler::Internal, dateTime.addSecs(10));
+		Listen::create(session, user.get(), track2.get(), Scrobbler::Internal, dateTime.addYears(1)).modify()->setScrobblingState(ScrobblingState::Synchronized);
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		EXPECT_FALSE(Listen::isCompacted(session, user.getId(), Scrobbler::Internal, dateTime));
+		EXPECT_EQ(Listen::compact(session, compactDateTime), 3);
+		EXPECT_EQ(Listen::compact(session, compactDateTime), 0);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_EQ(Listen::getCount(session), 2);
+		EXPECT_FALSE(Listen::find(session, user.getId(), track1.getId(), Scrobbler::Internal, dateTime));
+		EXPECT_TRUE(Listen::find(session, user.getId(), track2.getId(), Scrobbler::Internal, dateTime.addSecs(10)));
+
+		EXPECT_TRUE(Listen::isCompacted(session, user.getId(), Scrobbler::Internal, dateTime));
+		EXPECT_FALSE(Listen::isCompacted(session, user.getId(), Scrobbler::ListenBrainz, dateTime));
+		EXPECT_FALSE(Listen::isCompacted(session, user.getId(), Scrobbler::Internal, dateTime.addYears(1)));
+
+		auto tracks {Listen::getTopTracks(session, user->getId(), Scrobbler::Internal, {})};
+		ASSERT_EQ(tracks.results.size(), 2);
+		EXPECT_EQ(tracks.results[0], track1.getId());
+		EXPECT_EQ(tracks.results[1], track2.getId());
+
+		tracks = Listen::getRecentTracks(session, user->getId(), Scrobbler::Internal, {});
+		ASSERT_EQ(tracks.results.size(), 2);
+		EXPECT_EQ(tracks.results[0], track2.getId());
+		EXPECT_EQ(tracks.results[1], track1.getId());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		Listen::find(session, user.getId(), track2.getId(), Scrobbler::Internal, dateTime.addYears(1)).remove();
+		Listen::find(session, user.getId(), track2.getId(), Scrobbler::Internal, dateTime.addSecs(10)).remove();
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto tracks {Listen::getRecentTracks(session, user->getId(), Scrobbler::Internal, {})};
+		ASSERT_EQ(tracks.results.size(), 1);
+		EXPECT_EQ(tracks.results[0], track1.getId());
+	}
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Common.hpp"
+
+#include "services/database/MediaRoot.hpp"
+#include "services/database/ScanSettings.hpp"
+
+using namespace Database;
+
+TEST_F(DatabaseFixture, MediaRoot)
+{
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		ScanSettings::pointer scanSettings {ScanSettings::get(session)};
+		EXPECT_TRUE(scanSettings->getMediaRoots().empty());
+
+		scanSettings.modify()->setMediaRoots(session, {{"/mnt/nfs/music/", {}}, {"/mnt/disk1/music", {".flac", ".ape"}}});
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto mediaRoots {ScanSettings::get(session)->getMediaRoots()};
+		ASSERT_EQ(mediaRoots.size(), 2);
+		EXPECT_EQ(mediaRoots[0]->getDirectory(), "/mnt/disk1/music");
+		EXPECT_EQ(mediaRoots[0]->getAudioFileExtensions(), std::vector<std::filesystem::path>({".flac", ".ape"}));
+		EXPECT_EQ(mediaRoots[1]->getDirectory(), "/mnt/nfs/music");
+		EXPECT_TRUE(mediaRoots[1]->getAudioFileExtensions().empty());
+	}
+
+	MediaRootId nfsMediaRootId;
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		ScanSettings::pointer scanSettings {ScanSettings::get(session)};
+		nfsMediaRootId = scanSettings->getMediaRoots()[1]->getId();
+
+		scanSettings.modify()->setMediaRoots(session, {{"/mnt/nfs/music", {".mp3"}}});
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto mediaRoots {ScanSettings::get(session)->getMediaRoots()};
+		ASSERT_EQ(mediaRoots.size(), 1);
+		EXPECT_EQ(mediaRoots[0]->getId(), nfsMediaRootId);
+		EXPECT_EQ(mediaRoots[0]->getAudioFileExtensions(), std::vector<std::filesystem::path>({".mp3"}));
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		ScanSettings::get(session).modify()->setMediaRoots(session, {});
+		EXPECT_TRUE(ScanSettings::get(session)->getMediaRoots().empty());
+	}
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Common.hpp"
+
+#include "services/database/PlayQueue.hpp"
+
+using ScopedPlayQueue = ScopedEntity<Database::PlayQueue>;
+
+using namespace Database;
+
+TEST_F(DatabaseFixture, PlayQueue)
+{
+	ScopedTrack track {session, "MyTrack"};
+	ScopedUser user {session, "MyUser"};
+	ScopedUser user2 {session, "MyUser2"};
+	ScopedTrackList trackList {session, "MyTrackList", TrackList::Type::Internal, false, user.lockAndGet()};
+
+	{
+		auto transaction {session.createSharedTransaction()};
+		EXPECT_EQ(PlayQueue::getCount(session), 0);
+		EXPECT_FALSE(PlayQueue::find(session, user.getId()));
+	}
+
+	ScopedPlayQueue playQueue {session, user.lockAndGet(), trackList.lockAndGet()};
+
+	const Wt::WDateTime dateTime {Wt::WDate {2021, 1, 2}, Wt::WTime {12, 30, 1}};
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		TrackListEntry::create(session, track.get(), trackList.get());
+
+		playQueue.get().modify()->setCurrentIndex(1);
+		playQueue.get().modify()->setCurrentPositionInTrack(std::chrono::milliseconds {5000});
+		playQueue.get().modify()->setLastModifiedDateTime(dateTime);
+		playQueue.get().modify()->setChangedBy("MyClient");
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_EQ(PlayQueue::getCount(session), 1);
+		EXPECT_FALSE(PlayQueue::find(session, user2.getId()));
+
+		const PlayQueue::pointer userPlayQueue {PlayQueue::find(session, user.getId())};
+		ASSERT_TRUE(userPlayQueue);
+		EXPECT_EQ(userPlayQueue, playQueue.get());
+		EXPECT_EQ(userPlayQueue->getCurrentIndex(), 1);
+		EXPECT_EQ(userPlayQueue->getCurrentPositionInTrack(), std::chrono::milliseconds {5000});
+		EXPECT_EQ(userPlayQueue->getLastModifiedDateTime(), dateTime);
+		EXPECT_EQ(userPlayQueue->getChangedBy(), "MyClient");
+		EXPECT_EQ(userPlayQueue->getTrackList()->getTrackIds(), std::vector<TrackId> {track.getId()});
+	}
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <string_view>
+
+#include "Common.hpp"
+
+namespace
+{
+	// Any "SCAN" step means a full table or index scan
+	void
+	checkNoFullScan(const std::string& sql)
+	{
+		const std::vector<std::string> queryPlan {DatabaseFixture::getQueryPlan(sql)};
+		ASSERT_FALSE(queryPlan.empty()) << sql;
+
+		for (const std::string& detail : queryPlan)
+			EXPECT_NE(detail.rfind("SCAN ", 0), 0) << "'" << sql << "': " << detail;
+	}
+
+	void
+	checkNoTempSort(const std::string& sql)
+	{
+		for (const std::string& detail : DatabaseFixture::getQueryPlan(sql))
+			EXPECT_EQ(detail.find("TEMP B-TREE"), std::string::npos) << "'" << sql << "': " << detail;
+	}
+}
+
+TEST_F(DatabaseFixture, QueryPlan_starred)
+{
+	for (const std::string_view table : {"artist", "release", "track"})
+	{
+		const std::string starredTable {"starred_" + std::string {table}};
+		const std::string sql {"SELECT " + starredTable + "." + std::string {table} + "_id FROM " + starredTable + " WHERE user_id = ? AND scrobbler = ? ORDER BY date_time DESC"};
+
+		checkNoFullScan(sql);
+		checkNoTempSort(sql);
+		checkNoFullScan("SELECT id FROM " + starredTable + " WHERE " + std::string {table} + "_id = ? AND user_id = ? AND scrobbler = ?");
+	}
+
+	checkNoFullScan("SELECT a.id FROM artist a INNER JOIN starred_artist s_a ON s_a.artist_id = a.id WHERE s_a.user_id = ? AND s_a.scrobbler = ? ORDER BY s_a.date_time DESC");
+	checkNoFullScan("SELECT r.id FROM release r INNER JOIN starred_release s_r ON s_r.release_id = r.id WHERE s_r.user_id = ? AND s_r.scrobbler = ? ORDER BY s_r.date_time DESC");
+	checkNoFullScan("SELECT t.id FROM track t INNER JOIN starred_track s_t ON s_t.track_id = t.id WHERE s_t.user_id = ? AND s_t.scrobbler = ? ORDER BY s_t.date_time DESC");
+}
+
+TEST_F(DatabaseFixture, QueryPlan_listens)
+{
+	const std::string sql {"SELECT id FROM listen WHERE user_id = ? AND scrobbler = ? ORDER BY date_time"};
+	checkNoFullScan(sql);
+	checkNoTempSort(sql);
+
+	checkNoFullScan("SELECT id FROM listen WHERE user_id = ? AND track_id = ? AND scrobbler = ? AND date_time = ?");
+	checkNoFullScan("SELECT t.id FROM track t INNER JOIN track_listen_stats l_s ON l_s.track_id = t.id WHERE l_s.user_id = ? AND l_s.scrobbler = ? ORDER BY l_s.last_date_time DESC");
+}
+
+TEST_F(DatabaseFixture, QueryPlan_releaseTracks)
+{
+	const std::string sql {"SELECT id FROM track WHERE release_id = ? ORDER BY disc_number,track_number"};
+	checkNoFullScan(sql);
+	checkNoTempSort(sql);
+}
+
+TEST_F(DatabaseFixture, QueryPlan_trackPath)
+{
+	checkNoFullScan("SELECT id FROM track WHERE (directory_id = (SELECT d.id FROM directory d WHERE d.path = ?) AND file_name = ?) OR (directory_id IS NULL AND file_name = ?)");
+}
+
+TEST_F(DatabaseFixture, QueryPlan_clusterTracks)
+{
+	checkNoFullScan("SELECT t.id FROM track t INNER JOIN track_cluster t_c ON t_c.track_id = t.id WHERE t_c.cluster_id = ?");
+	checkNoFullScan("SELECT t.id FROM track t INNER JOIN cluster c ON c.id = t_c.cluster_id INNER JOIN track_cluster t_c ON t_c.track_id = t.id WHERE c.id = ?");
+}
+
+TEST_F(DatabaseFixture, QueryPlan_trackListEntries)
+{
+	for (const std::string_view sql : {"SELECT id FROM tracklist_entry WHERE tracklist_id = ? ORDER BY id",
+			"SELECT id FROM tracklist_entry WHERE tracklist_id = ? AND id > ? ORDER BY id",
+			"SELECT id FROM tracklist_entry WHERE tracklist_id = ? AND id < ? ORDER BY id DESC"})
+	{
+		checkNoFullScan(std::string {sql});
+		checkNoTempSort(std::string {sql});
+	}
+}
@@ -111,6 +111,38 @@ TEST_F(DatabaseFixture, Release_singleTrack)
 	}
 }
 
+TEST_F(DatabaseFixture, Release_getTracks)
+{
+	ScopedRelease release {session, "MyRelease"};
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedTrack track3 {session, "MyTrack3"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setRelease(release.get());
+		track1.get().modify()->setDiscNumber(2);
+		track1.get().modify()->setTrackNumber(1);
+		track2.get().modify()->setRelease(release.get());
+		track2.get().modify()->setDiscNumber(1);
+		track2.get().modify()->setTrackNumber(2);
+		track3.get().modify()->setRelease(release.get());
+		track3.get().modify()->setDiscNumber(1);
+		track3.get().modify()->setTrackNumber(1);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto tracks {release->getTracks()};
+		ASSERT_EQ(tracks.size(), 3);
+		EXPECT_EQ(tracks[0]->getId(), track3.getId());
+		EXPECT_EQ(tracks[1]->getId(), track2.getId());
+		EXPECT_EQ(tracks[2]->getId(), track1.getId());
+	}
+}
+
 TEST_F(DatabaseFixture, MulitpleReleaseSearchByName)
 {
 	ScopedRelease release1 {session, "MyRelease"};
@@ -397,3 +429,254 @@ TEST_F(DatabaseFixture, Release_writtenAfter)
 }
 
 
+
+TEST_F(DatabaseFixture, Release_added)
+{
+	ScopedRelease release1 {session, "MyRelease1"};
+	ScopedRelease release2 {session, "MyRelease2"};
+	ScopedRelease release3 {session, "MyRelease3"};
+
+	const Wt::WDateTime dateTime {Wt::WDate {1950, 1, 1}, Wt::WTime {12, 30, 20}};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		release1.get().modify()->setAdded(2, dateTime);
+		release2.get().modify()->setAdded(1, dateTime);
+		release3.get().modify()->setAdded(2, dateTime);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+		EXPECT_EQ(release1->getAddedGeneration(), 2);
+		EXPECT_EQ(release1->getAddedTime(), dateTime);
+
+		// Most recent generation first, then most recently inserted first
+		const auto releases {Release::find(session, Release::FindParameters {}.setSortMethod(ReleaseSortMethod::AddedDesc))};
+		ASSERT_EQ(releases.results.size(), 3);
+		EXPECT_EQ(releases.results[0], release3.getId());
+		EXPECT_EQ(releases.results[1], release1.getId());
+		EXPECT_EQ(releases.results[2], release2.getId());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+		const auto releases {Release::find(session, Release::FindParameters {}.setSortMethod(ReleaseSortMethod::AddedDesc).setAddedAfterGeneration(1))};
+		ASSERT_EQ(releases.results.size(), 2);
+		EXPECT_EQ(releases.results[0], release3.getId());
+		EXPECT_EQ(releases.results[1], release1.getId());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+		EXPECT_TRUE(Release::find(session, Release::FindParameters {}.setAddedAfterGeneration(2)).results.empty());
+	}
+}
+
+TEST_F(DatabaseFixture, Release_coverPath)
+{
+	ScopedRelease release {session, "MyRelease"};
+
+	{
+		auto transaction {session.createSharedTransaction()};
+		EXPECT_TRUE(release->getCoverPath().empty());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		release.get().modify()->setCoverPath("/root/release/cover.jpg");
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+		const Release::pointer foundRelease {Release::find(session, release.getId())};
+		ASSERT_TRUE(foundRelease);
+		EXPECT_EQ(foundRelease->getCoverPath(), "/root/release/cover.jpg");
+	}
+}
+
+TEST_F(DatabaseFixture, Release_visitArtists)
+{
+	ScopedRelease release1 {session, "MyRelease1"};
+	ScopedRelease release2 {session, "MyRelease2"};
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedTrack track3 {session, "MyTrack3"};
+	ScopedArtist artist1 {session, "MyArtist1"};
+	ScopedArtist artist2 {session, "MyArtist2"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setRelease(release1.get());
+		track2.get().modify()->setRelease(release1.get());
+		track3.get().modify()->setRelease(release2.get());
+		TrackArtistLink::create(session, track1.get(), artist1.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track2.get(), artist1.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track3.get(), artist2.get(), TrackArtistLinkType::ReleaseArtist);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		std::vector<std::pair<ReleaseId, ArtistId>> links;
+		Release::visitArtists(session, {release1.getId(), release2.getId()}, TrackArtistLinkType::Artist, [&](ReleaseId releaseId, const Artist::pointer& artist)
+		{
+			links.emplace_back(releaseId, artist->getId());
+		});
+		ASSERT_EQ(links.size(), 1);
+		EXPECT_EQ(links[0], std::make_pair(release1.getId(), artist1.getId()));
+
+		links.clear();
+		Release::visitArtists(session, {release1.getId(), release2.getId()}, TrackArtistLinkType::ReleaseArtist, [&](ReleaseId releaseId, const Artist::pointer& artist)
+		{
+			links.emplace_back(releaseId, artist->getId());
+		});
+		ASSERT_EQ(links.size(), 1);
+		EXPECT_EQ(links[0], std::make_pair(release2.getId(), artist2.getId()));
+	}
+}
+
+TEST_F(DatabaseFixture, Release_findListEntries)
+{
+	ScopedRelease release1 {session, "MyRelease1"};
+	ScopedRelease release2 {session, "MyRelease2"};
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedTrack track3 {session, "MyTrack3"};
+	ScopedArtist artist1 {session, "MyArtist1"};
+	ScopedArtist artist2 {session, "MyArtist2"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setRelease(release1.get());
+		track2.get().modify()->setRelease(release1.get());
+		track3.get().modify()->setRelease(release2.get());
+		TrackArtistLink::create(session, track1.get(), artist1.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track2.get(), artist1.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track3.get(), artist1.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track3.get(), artist2.get(), TrackArtistLinkType::ReleaseArtist);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto entries {Release::findListEntries(session, {release2.getId(), release1.getId()})};
+		ASSERT_EQ(entries.size(), 2);
+
+		EXPECT_EQ(entries[0].releaseId, release2.getId());
+		EXPECT_EQ(entries[0].name, "MyRelease2");
+		ASSERT_EQ(entries[0].artists.size(), 1);
+		EXPECT_EQ(entries[0].artists[0].artistId, artist2.getId());
+
+		EXPECT_EQ(entries[1].releaseId, release1.getId());
+		EXPECT_EQ(entries[1].name, "MyRelease1");
+		ASSERT_EQ(entries[1].artists.size(), 1); // distinct
+		EXPECT_EQ(entries[1].artists[0].artistId, artist1.getId());
+		EXPECT_EQ(entries[1].artists[0].name, "MyArtist1");
+	}
+}
+
+TEST_F(DatabaseFixture, Release_summary)
+{
+	ScopedRelease release {session, "MyRelease"};
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedTrack track3 {session, "MyTrack3"};
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const Release::Summary summary {release->getSummary()};
+		EXPECT_EQ(summary.trackCount, 0);
+		EXPECT_EQ(summary.duration, std::chrono::milliseconds {0});
+		EXPECT_FALSE(summary.year);
+		EXPECT_FALSE(summary.originalYear);
+		EXPECT_FALSE(summary.copyright);
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		for (ScopedTrack* track : {&track1, &track2})
+		{
+			track->get().modify()->setRelease(release.get());
+			track->get().modify()->setDuration(std::chrono::seconds {10});
+			track->get().modify()->setDate(Wt::WDate {1994, 2, 3});
+			track->get().modify()->setCopyright("MyCopyright");
+		}
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const Release::Summary summary {release->getSummary()};
+		EXPECT_EQ(summary.trackCount, 2);
+		EXPECT_EQ(summary.duration, std::chrono::seconds {20});
+		EXPECT_EQ(summary.year, 1994);
+		EXPECT_FALSE(summary.originalYear);
+		EXPECT_EQ(summary.copyright, "MyCopyright");
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track3.get().modify()->setRelease(release.get());
+		track3.get().modify()->setDuration(std::chrono::seconds {5});
+		track3.get().modify()->setDate(Wt::WDate {1995, 2, 3});
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		// various dates and copyrights
+		const Release::Summary summary {release->getSummary()};
+		EXPECT_EQ(summary.trackCount, 3);
+		EXPECT_EQ(summary.duration, std::chrono::seconds {25});
+		EXPECT_FALSE(summary.year);
+		EXPECT_FALSE(summary.copyright);
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track3.get().modify()->setRelease({});
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const Release::Summary summary {release->getSummary()};
+		EXPECT_EQ(summary.trackCount, 2);
+		EXPECT_EQ(summary.duration, std::chrono::seconds {20});
+		EXPECT_EQ(summary.year, 1994);
+		EXPECT_EQ(summary.copyright, "MyCopyright");
+	}
+}
+
+TEST_F(DatabaseFixture, Release_removeOrphans)
+{
+	ScopedRelease kept {session, "MyRelease"};
+	ScopedTrack track {session, "MyTrack"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track.get().modify()->setRelease(kept.get());
+		for (std::size_t i {}; i < 3; ++i)
+			Release::create(session, "MyOrphanRelease");
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		EXPECT_EQ(Release::getOrphanCount(session), 3);
+		EXPECT_EQ(Release::removeOrphans(session, 2), 2);
+		EXPECT_EQ(Release::getOrphanCount(session), 1);
+		EXPECT_EQ(Release::removeOrphans(session, 2), 1);
+		EXPECT_EQ(Release::removeOrphans(session, 2), 0);
+
+		EXPECT_EQ(Release::getCount(session), 1);
+		EXPECT_TRUE(Release::exists(session, kept.getId()));
+	}
+}
@@ -17,6 +17,8 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
 #include "Common.hpp"
 #include "services/database/StarredTrack.hpp"
 
@@ -107,3 +109,129 @@ TEST_F(DatabaseFixture, StarredTrack_dateTime)
 		EXPECT_EQ(tracks.results[1], starredTrack1->getTrack()->getId());
 	}
 }
+
+TEST_F(DatabaseFixture, StarredTrack_userSignature)
+{
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedUser user {session, "MyUser"};
+	ScopedUser user2 {session, "MyUser2"};
+
+	std::string emptySignature;
+	{
+		auto transaction {session.createSharedTransaction()};
+		emptySignature = StarredTrack::getUserSignature(session, user->getId(), Scrobbler::Internal);
+	}
+
+	ScopedStarredTrack starredTrack1 {session, track1.lockAndGet(), user.lockAndGet(), Scrobbler::Internal};
+
+	std::string signature;
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		starredTrack1.get().modify()->setDateTime(Wt::WDateTime {Wt::WDate {1950, 1, 2}, Wt::WTime {12, 30, 1}});
+
+		signature = StarredTrack::getUserSignature(session, user->getId(), Scrobbler::Internal);
+		EXPECT_NE(signature, emptySignature);
+		EXPECT_EQ(StarredTrack::getUserSignature(session, user->getId(), Scrobbler::ListenBrainz), emptySignature);
+		EXPECT_EQ(StarredTrack::getUserSignature(session, user2->getId(), Scrobbler::Internal), emptySignature);
+	}
+
+	{
+		ScopedStarredTrack starredTrack2 {session, track2.lockAndGet(), user.lockAndGet(), Scrobbler::Internal};
+
+		auto transaction {session.createSharedTransaction()};
+		EXPECT_NE(StarredTrack::getUserSignature(session, user->getId(), Scrobbler::Internal), signature);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+		EXPECT_EQ(StarredTrack::getUserSignature(session, user->getId(), Scrobbler::Internal), signature);
+	}
+}
+
+TEST_F(DatabaseFixture, StarredTrack_setStarred)
+{
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedTrack track3 {session, "MyTrack3"};
+	ScopedUser user {session, "MyUser"};
+	const Wt::WDateTime dateTime {Wt::WDate {1950, 1, 1}, Wt::WTime {12, 30, 20}};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		// unknown track ids are ignored
+		StarredTrack::setStarred(session, user.getId(), Scrobbler::Internal, {track1.getId(), track2.getId(), TrackId {track3.getId().getValue() + 1}}, dateTime);
+		EXPECT_EQ(StarredTrack::getCount(session), 2);
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		// already starred tracks are updated
+		StarredTrack::setStarred(session, user.getId(), Scrobbler::Internal, {track2.getId(), track3.getId()}, dateTime.addSecs(1));
+		EXPECT_EQ(StarredTrack::getCount(session), 3);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const StarredTrack::pointer starredTrack1 {StarredTrack::find(session, track1.getId(), user.getId(), Scrobbler::Internal)};
+		ASSERT_TRUE(starredTrack1);
+		EXPECT_EQ(starredTrack1->getDateTime(), dateTime);
+
+		const StarredTrack::pointer starredTrack2 {StarredTrack::find(session, track2.getId(), user.getId(), Scrobbler::Internal)};
+		ASSERT_TRUE(starredTrack2);
+		EXPECT_EQ(starredTrack2->getDateTime(), dateTime.addSecs(1));
+
+		EXPECT_FALSE(StarredTrack::find(session, track1.getId(), user.getId(), Scrobbler::ListenBrainz));
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		StarredTrack::unsetStarred(session, user.getId(), Scrobbler::Internal, {track1.getId(), track3.getId()});
+		EXPECT_EQ(StarredTrack::getCount(session), 1);
+		EXPECT_TRUE(StarredTrack::find(session, track2.getId(), user.getId(), Scrobbler::Internal));
+
+		StarredTrack::unsetStarred(session, user.getId(), Scrobbler::Internal, {track2.getId()});
+		EXPECT_EQ(StarredTrack::getCount(session), 0);
+	}
+}
+
+TEST_F(DatabaseFixture, StarredTrack_findIds)
+{
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedUser user {session, "MyUser"};
+	ScopedUser user2 {session, "MyUser2"};
+
+	{
+		auto transaction {session.createSharedTransaction()};
+		EXPECT_TRUE(StarredTrack::findIds(session, user.getId(), Scrobbler::Internal).empty());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		StarredTrack::setStarred(session, user.getId(), Scrobbler::Internal, {track1.getId(), track2.getId()}, Wt::WDateTime {Wt::WDate {1950, 1, 1}});
+		StarredTrack::setStarred(session, user2.getId(), Scrobbler::ListenBrainz, {track2.getId()}, Wt::WDateTime {Wt::WDate {1950, 1, 1}});
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		std::vector<TrackId> trackIds {StarredTrack::findIds(session, user.getId(), Scrobbler::Internal)};
+		std::sort(std::begin(trackIds), std::end(trackIds));
+		EXPECT_EQ(trackIds, (std::vector<TrackId> {track1.getId(), track2.getId()}));
+
+		EXPECT_TRUE(StarredTrack::findIds(session, user.getId(), Scrobbler::ListenBrainz).empty());
+		EXPECT_EQ(StarredTrack::findIds(session, user2.getId(), Scrobbler::ListenBrainz), std::vector<TrackId> {track2.getId()});
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		StarredTrack::unsetStarred(session, user.getId(), Scrobbler::Internal, {track1.getId(), track2.getId()});
+		StarredTrack::unsetStarred(session, user2.getId(), Scrobbler::ListenBrainz, {track2.getId()});
+	}
+}
@@ -60,6 +60,137 @@ TEST_F(DatabaseFixture, MultipleTracks)
 	}
 }
 
+TEST_F(DatabaseFixture, Track_findByIds)
+{
+	ScopedRelease release {session, "MyRelease"};
+	ScopedTrack track1 {session, "MyTrackFile1"};
+	ScopedTrack track2 {session, "MyTrackFile2"};
+	ScopedTrack track3 {session, "MyTrackFile3"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		track2.get().modify()->setRelease(release.get());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_TRUE(Track::find(session, std::vector<TrackId> {}).empty());
+
+		const TrackId missingTrackId {track3.getId().getValue() + 1};
+		const auto tracks {Track::find(session, std::vector<TrackId> {track3.getId(), missingTrackId, track1.getId(), track2.getId()})};
+		ASSERT_EQ(tracks.size(), 3);
+		EXPECT_EQ(tracks[0]->getId(), track3.getId());
+		EXPECT_EQ(tracks[1]->getId(), track1.getId());
+		EXPECT_EQ(tracks[2]->getId(), track2.getId());
+		ASSERT_TRUE(tracks[2]->getRelease());
+		EXPECT_EQ(tracks[2]->getRelease()->getId(), release.getId());
+	}
+}
+
+TEST_F(DatabaseFixture, Track_findPathsUnder)
+{
+	ScopedTrack track1 {session, "/root/dir/file1.mp3"};
+	ScopedTrack track2 {session, "/root/dir/subdir/file2.mp3"};
+	ScopedTrack track3 {session, "/root/dir_other/file3.mp3"};
+	ScopedTrack track4 {session, "/root/dir%/file4.mp3"};
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto paths {Track::findPathsUnder(session, "/root/dir", Range {})};
+		ASSERT_EQ(paths.results.size(), 2);
+		EXPECT_TRUE(std::any_of(std::cbegin(paths.results), std::cend(paths.results), [&](const Track::PathResult& res) { return res.trackId == track1.getId(); }));
+		EXPECT_TRUE(std::any_of(std::cbegin(paths.results), std::cend(paths.results), [&](const Track::PathResult& res) { return res.trackId == track2.getId(); }));
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto paths {Track::findPathsUnder(session, "/root/dir/file1.mp3", Range {})};
+		ASSERT_EQ(paths.results.size(), 1);
+		EXPECT_EQ(paths.results.front().trackId, track1.getId());
+		EXPECT_EQ(paths.results.front().path, "/root/dir/file1.mp3");
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto paths {Track::findPathsUnder(session, "/root/dir%", Range {})};
+		ASSERT_EQ(paths.results.size(), 1);
+		EXPECT_EQ(paths.results.front().trackId, track4.getId());
+	}
+}
+
+TEST_F(DatabaseFixture, Track_findPathsUnder_directory)
+{
+	ScopedDirectory dir {session, "/root/dir"};
+	ScopedDirectory subdir {session, "/root/dir/subdir", dir.lockAndGet()};
+	ScopedDirectory otherDir {session, "/root/dir_other"};
+	ScopedTrack track1 {session, "file1.mp3"};
+	ScopedTrack track2 {session, "file2.mp3"};
+	ScopedTrack track3 {session, "file3.mp3"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setPath(dir.get(), "file1.mp3");
+		track2.get().modify()->setPath(subdir.get(), "file2.mp3");
+		track3.get().modify()->setPath(otherDir.get(), "file3.mp3");
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto paths {Track::findPathsUnder(session, "/root/dir", Range {})};
+		ASSERT_EQ(paths.results.size(), 2);
+		EXPECT_TRUE(std::any_of(std::cbegin(paths.results), std::cend(paths.results), [&](const Track::PathResult& res) { return res.trackId == track1.getId() && res.path == "/root/dir/file1.mp3"; }));
+		EXPECT_TRUE(std::any_of(std::cbegin(paths.results), std::cend(paths.results), [&](const Track::PathResult& res) { return res.trackId == track2.getId() && res.path == "/root/dir/subdir/file2.mp3"; }));
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto paths {Track::findPathsUnder(session, "/root/dir/file1.mp3", Range {})};
+		ASSERT_EQ(paths.results.size(), 1);
+		EXPECT_EQ(paths.results.front().trackId, track1.getId());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_EQ(Track::findByPath(session, "/root/dir/subdir/file2.mp3"), track2.get());
+		EXPECT_EQ(Track::findPaths(session, Range {}).results.size(), 3);
+	}
+}
+
+TEST_F(DatabaseFixture, Track_removeByIds)
+{
+	ScopedTrack track1 {session, "/root/file1.mp3"};
+	TrackId trackId2;
+	TrackId trackId3;
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		trackId2 = Track::create(session, "/root/file2.mp3")->getId();
+		trackId3 = Track::create(session, "/root/file3.mp3")->getId();
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		Track::removeByIds(session, {});
+		EXPECT_EQ(Track::getCount(session), 3);
+
+		Track::removeByIds(session, {trackId2, trackId3});
+		EXPECT_EQ(Track::getCount(session), 1);
+		EXPECT_TRUE(Track::exists(session, track1.getId()));
+		EXPECT_FALSE(Track::exists(session, trackId2));
+		EXPECT_FALSE(Track::exists(session, trackId3));
+	}
+}
+
 TEST_F(DatabaseFixture, MultipleTracksSearchByFilter)
 {
 	ScopedTrack track1 {session, ""};
@@ -106,6 +237,32 @@ TEST_F(DatabaseFixture, MultipleTracksSearchByFilter)
 	}
 }
 
+TEST_F(DatabaseFixture, Track_findByKeywordsUpdated)
+{
+	ScopedTrack track {session, "MyTrackFoo"};
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_EQ(Track::find(session, Track::FindParameters {}.setKeywords({"trackfoo"})).results.size(), 1);
+		EXPECT_EQ(Track::find(session, Track::FindParameters {}.setKeywords({"Fo"})).results.size(), 1);
+		EXPECT_TRUE(Track::find(session, Track::FindParameters {}.setKeywords({"TrackBar"})).results.empty());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		track.get().modify()->setName("MyTrackBar");
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_TRUE(Track::find(session, Track::FindParameters {}.setKeywords({"TrackFoo"})).results.empty());
+		EXPECT_EQ(Track::find(session, Track::FindParameters {}.setKeywords({"TrackBar"})).results.size(), 1);
+		EXPECT_EQ(Track::find(session, Track::FindParameters {}.setKeywords({"My", "Bar"})).results.size(), 1);
+	}
+}
+
 TEST_F(DatabaseFixture, Track_date)
 {
 	ScopedTrack track {session, "MyTrack"};
@@ -159,3 +316,137 @@ TEST_F(DatabaseFixture, Track_writtenAfter)
 	}
 }
 
+
+TEST_F(DatabaseFixture, Track_visitLinks)
+{
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedRelease release {session, "MyRelease"};
+	ScopedArtist artist {session, "MyArtist"};
+	ScopedClusterType clusterType {session, "MyClusterType"};
+	ScopedCluster cluster {session, clusterType.lockAndGet(), "MyCluster"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setRelease(release.get());
+		cluster.get().modify()->addTrack(track1.get());
+		cluster.get().modify()->addTrack(track2.get());
+		TrackArtistLink::create(session, track2.get(), artist.get(), TrackArtistLinkType::Composer);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		std::vector<TrackId> clusterTrackIds;
+		Track::visitClusterLinks(session, [&](TrackId trackId, ClusterId clusterId)
+		{
+			EXPECT_EQ(clusterId, cluster.getId());
+			clusterTrackIds.push_back(trackId);
+		});
+		std::sort(std::begin(clusterTrackIds), std::end(clusterTrackIds));
+		ASSERT_EQ(clusterTrackIds.size(), 2);
+		EXPECT_EQ(clusterTrackIds[0], std::min(track1.getId(), track2.getId()));
+
+		std::size_t releaseLinkCount {};
+		Track::visitReleaseLinks(session, [&](TrackId trackId, ReleaseId releaseId)
+		{
+			EXPECT_EQ(trackId, track1.getId());
+			EXPECT_EQ(releaseId, release.getId());
+			releaseLinkCount++;
+		});
+		EXPECT_EQ(releaseLinkCount, 1);
+
+		std::size_t artistLinkCount {};
+		Track::visitArtistLinks(session, [&](TrackId trackId, ArtistId artistId, TrackArtistLinkType type)
+		{
+			EXPECT_EQ(trackId, track2.getId());
+			EXPECT_EQ(artistId, artist.getId());
+			EXPECT_EQ(type, TrackArtistLinkType::Composer);
+			artistLinkCount++;
+		});
+		EXPECT_EQ(artistLinkCount, 1);
+	}
+}
+
+TEST_F(DatabaseFixture, Track_visitArtists)
+{
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedTrack track3 {session, "MyTrack3"};
+	ScopedArtist artist1 {session, "MyArtist1"};
+	ScopedArtist artist2 {session, "MyArtist2"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		TrackArtistLink::create(session, track1.get(), artist2.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track1.get(), artist1.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track2.get(), artist1.get(), TrackArtistLinkType::Composer);
+		TrackArtistLink::create(session, track3.get(), artist1.get(), TrackArtistLinkType::Artist);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		std::vector<std::pair<TrackId, ArtistId>> links;
+		Track::visitArtists(session, {track1.getId(), track2.getId()}, {TrackArtistLinkType::Artist}, [&](TrackId trackId, const Artist::pointer& artist)
+		{
+			links.emplace_back(trackId, artist->getId());
+		});
+		ASSERT_EQ(links.size(), 2);
+		EXPECT_EQ(links[0], std::make_pair(track1.getId(), artist2.getId()));
+		EXPECT_EQ(links[1], std::make_pair(track1.getId(), artist1.getId()));
+
+		links.clear();
+		Track::visitArtists(session, {track2.getId()}, {}, [&](TrackId trackId, const Artist::pointer& artist)
+		{
+			links.emplace_back(trackId, artist->getId());
+		});
+		ASSERT_EQ(links.size(), 1);
+		EXPECT_EQ(links[0], std::make_pair(track2.getId(), artist1.getId()));
+	}
+}
+
+TEST_F(DatabaseFixture, Track_findListEntries)
+{
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedRelease release {session, "MyRelease"};
+	ScopedArtist artist1 {session, "MyArtist1"};
+	ScopedArtist artist2 {session, "MyArtist2"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setDuration(std::chrono::seconds {42});
+		track1.get().modify()->setRelease(release.get());
+		TrackArtistLink::create(session, track1.get(), artist2.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track1.get(), artist1.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track2.get(), artist1.get(), TrackArtistLinkType::Composer);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto entries {Track::findListEntries(session, {track2.getId(), TrackId {}, track1.getId()})};
+		ASSERT_EQ(entries.size(), 2);
+
+		EXPECT_EQ(entries[0].trackId, track2.getId());
+		EXPECT_EQ(entries[0].name, "MyTrack2");
+		EXPECT_FALSE(entries[0].releaseId.isValid());
+		EXPECT_TRUE(entries[0].releaseName.empty());
+		EXPECT_TRUE(entries[0].artists.empty());
+
+		EXPECT_EQ(entries[1].trackId, track1.getId());
+		EXPECT_EQ(entries[1].name, "MyTrack1");
+		EXPECT_EQ(entries[1].duration, std::chrono::seconds {42});
+		EXPECT_EQ(entries[1].releaseId, release.getId());
+		EXPECT_EQ(entries[1].releaseName, "MyRelease");
+		EXPECT_FALSE(entries[1].releaseMBID);
+		ASSERT_EQ(entries[1].artists.size(), 2);
+		EXPECT_EQ(entries[1].artists[0].artistId, artist2.getId());
+		EXPECT_EQ(entries[1].artists[0].name, "MyArtist2");
+		EXPECT_EQ(entries[1].artists[1].artistId, artist1.getId());
+	}
+}
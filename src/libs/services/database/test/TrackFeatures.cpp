@@ -44,5 +44,53 @@ TEST_F(DatabaseFixture, TrackFeatures)
 		auto allTrackFeatures {TrackFeatures::find(session, Range {})};
 		ASSERT_EQ(allTrackFeatures.results.size(), 1);
 		EXPECT_EQ(allTrackFeatures.results.front(), trackFeatures.getId());
+
+		auto trackIds {TrackFeatures::findTrackIds(session, Range {})};
+		ASSERT_EQ(trackIds.results.size(), 1);
+		EXPECT_EQ(trackIds.results.front(), track.getId());
+	}
+}
+
+TEST_F(DatabaseFixture, TrackFeatures_values)
+{
+	ScopedTrack track {session, "MyTrack"};
+	ScopedTrack track2 {session, "MyTrack2"};
+
+	const std::string jsonEncodedFeatures {R"({"lowlevel": {"average_loudness": 0.5, "gfcc": {"mean": [1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13]}}})"};
+	ScopedTrackFeatures trackFeatures {session, track.lockAndGet(), jsonEncodedFeatures};
+	ScopedTrackFeatures trackFeatures2 {session, track2.lockAndGet(), R"({"lowlevel": {"average_loudness": 0.25}})"};
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const FeatureValuesMap featureValuesMap {trackFeatures->getFeatureValuesMap({"lowlevel.average_loudness", "lowlevel.gfcc.mean"})};
+		ASSERT_EQ(featureValuesMap.size(), 2);
+		ASSERT_EQ(featureValuesMap.at("lowlevel.average_loudness").size(), 1);
+		EXPECT_EQ(featureValuesMap.at("lowlevel.average_loudness").front(), 0.5);
+		ASSERT_EQ(featureValuesMap.at("lowlevel.gfcc.mean").size(), 13);
+		EXPECT_EQ(featureValuesMap.at("lowlevel.gfcc.mean").back(), 13);
+
+		// missing feature
+		EXPECT_TRUE(trackFeatures2->getFeatureValuesMap({"lowlevel.gfcc.mean"}).empty());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		std::vector<TrackId> visitedTrackIds;
+		TrackFeatures::visitFeatureValuesMaps(session, {"lowlevel.average_loudness"}, [&](TrackId trackId, const FeatureValuesMap& featureValuesMap)
+		{
+			visitedTrackIds.push_back(trackId);
+			EXPECT_EQ(featureValuesMap.at("lowlevel.average_loudness").front(), trackId == track.getId() ? 0.5 : 0.25);
+		});
+		EXPECT_EQ(visitedTrackIds.size(), 2);
+
+		visitedTrackIds.clear();
+		TrackFeatures::visitFeatureValuesMaps(session, {"lowlevel.gfcc.mean"}, [&](TrackId trackId, const FeatureValuesMap&)
+		{
+			visitedTrackIds.push_back(trackId);
+		});
+		ASSERT_EQ(visitedTrackIds.size(), 1);
+		EXPECT_EQ(visitedTrackIds.front(), track.getId());
 	}
 }
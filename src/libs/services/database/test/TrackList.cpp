@@ -18,6 +18,7 @@
  */
 
 #include <list>
+#include <optional>
 
 #include "Common.hpp"
 
@@ -81,6 +82,192 @@ TEST_F(DatabaseFixture, SingleTrackListMultipleTrack)
 	}
 }
 
+TEST_F(DatabaseFixture, SingleTrackListKeysetPagination)
+{
+	ScopedUser user {session, "MyUser"};
+	ScopedTrackList trackList {session, "MytrackList", TrackList::Type::Playlist, false, user.lockAndGet()};
+	ScopedTrack track {session, "MyTrack"};
+
+	std::vector<TrackListEntryId> entryIds;
+	{
+		auto transaction {session.createUniqueTransaction()};
+		for (std::size_t i {}; i < 10; ++i)
+			entryIds.push_back(TrackListEntry::create(session, track.get(), trackList.get())->getId());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto entries {trackList->getEntriesAfter(entryIds[2], 3)};
+		ASSERT_EQ(entries.size(), 3);
+		EXPECT_EQ(entries[0]->getId(), entryIds[3]);
+		EXPECT_EQ(entries[1]->getId(), entryIds[4]);
+		EXPECT_EQ(entries[2]->getId(), entryIds[5]);
+
+		EXPECT_EQ(trackList->getEntriesAfter(entryIds[8], 3).size(), 1);
+		EXPECT_TRUE(trackList->getEntriesAfter(entryIds[9], 3).empty());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto entries {trackList->getEntriesBefore(entryIds[5], 3)};
+		ASSERT_EQ(entries.size(), 3);
+		EXPECT_EQ(entries[0]->getId(), entryIds[2]);
+		EXPECT_EQ(entries[1]->getId(), entryIds[3]);
+		EXPECT_EQ(entries[2]->getId(), entryIds[4]);
+
+		EXPECT_EQ(trackList->getEntriesBefore(entryIds[1], 3).size(), 1);
+		EXPECT_TRUE(trackList->getEntriesBefore(entryIds[0], 3).empty());
+	}
+}
+
+TEST_F(DatabaseFixture, SingleTrackListSummary)
+{
+	ScopedUser user {session, "MyUser"};
+	ScopedTrackList trackList {session, "MytrackList", TrackList::Type::Playlist, false, user.lockAndGet()};
+	ScopedTrack track1 {session, "MyTrack1"};
+	std::optional<ScopedTrack> track2 {std::in_place, session, "MyTrack2"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setDuration(std::chrono::seconds {10});
+		track2->get().modify()->setDuration(std::chrono::seconds {5});
+
+		TrackListEntry::create(session, track1.get(), trackList.get());
+		TrackListEntry::create(session, track1.get(), trackList.get());
+		TrackListEntry::create(session, track2->get(), trackList.get());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_EQ(trackList->getCount(), 3);
+		EXPECT_EQ(trackList->getDuration(), std::chrono::seconds {25});
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setDuration(std::chrono::seconds {20});
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_EQ(trackList->getCount(), 3);
+		EXPECT_EQ(trackList->getDuration(), std::chrono::seconds {45});
+	}
+
+	// entries are removed along with the track
+	track2.reset();
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_EQ(trackList->getCount(), 2);
+		EXPECT_EQ(trackList->getDuration(), std::chrono::seconds {40});
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		trackList.get().modify()->clear();
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_EQ(trackList->getCount(), 0);
+		EXPECT_EQ(trackList->getDuration(), std::chrono::seconds {0});
+	}
+}
+
+TEST_F(DatabaseFixture, SingleTrackListBulkCreate)
+{
+	ScopedUser user {session, "MyUser"};
+	ScopedTrackList trackList {session, "MytrackList", TrackList::Type::Playlist, false, user.lockAndGet()};
+	std::list<ScopedTrack> tracks;
+
+	std::vector<TrackId> trackIds;
+	for (std::size_t i {}; i < 300; ++i)
+	{
+		tracks.emplace_back(session, "MyTrack" + std::to_string(i));
+		trackIds.push_back(tracks.back().getId());
+	}
+	// duplicates and unknown tracks
+	trackIds.push_back(tracks.front().getId());
+	trackIds.insert(std::cbegin(trackIds) + 10, TrackId {});
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		EXPECT_EQ(TrackListEntry::create(session, trackIds, trackList.get()), tracks.size() + 1);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto entryTrackIds {trackList->getTrackIds()};
+		ASSERT_EQ(entryTrackIds.size(), tracks.size() + 1);
+
+		// Same order
+		std::size_t i {};
+		for (const ScopedTrack& track : tracks)
+			EXPECT_EQ(track.getId(), entryTrackIds[i++]);
+		EXPECT_EQ(entryTrackIds.back(), tracks.front().getId());
+
+		const auto entries {trackList->getEntries(0, 1)};
+		ASSERT_EQ(entries.size(), 1);
+		EXPECT_EQ(entries.front()->getTrackId(), tracks.front().getId());
+	}
+}
+
+TEST_F(DatabaseFixture, SingleTrackListBulkRemove)
+{
+	ScopedUser user {session, "MyUser"};
+	ScopedTrackList trackList {session, "MytrackList", TrackList::Type::Playlist, false, user.lockAndGet()};
+	std::list<ScopedTrack> tracks;
+
+	std::vector<TrackId> trackIds;
+	for (std::size_t i {}; i < 10; ++i)
+	{
+		tracks.emplace_back(session, "MyTrack" + std::to_string(i));
+		trackIds.push_back(tracks.back().getId());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		EXPECT_EQ(TrackListEntry::create(session, trackIds, trackList.get()), trackIds.size());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		// duplicates and out of range positions
+		EXPECT_EQ(TrackListEntry::remove(session, trackList.get(), {9, 0, 5, 5, 42}), 3);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const std::vector<TrackId> expectedTrackIds {trackIds[1], trackIds[2], trackIds[3], trackIds[4], trackIds[6], trackIds[7], trackIds[8]};
+		EXPECT_EQ(trackList->getTrackIds(), expectedTrackIds);
+		EXPECT_EQ(trackList->getCount(), expectedTrackIds.size());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		TrackListEntry::removeAll(session, trackList.get());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		EXPECT_TRUE(trackList->isEmpty());
+		EXPECT_EQ(trackList->getCount(), 0);
+	}
+}
+
 TEST_F(DatabaseFixture, SingleTrackListMultipleTrackDateTime)
 {
 	ScopedUser user {session, "MyUser"};
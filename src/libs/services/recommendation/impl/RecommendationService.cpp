@@ -19,11 +19,14 @@
 
 #include "RecommendationService.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <unordered_map>
 #include <vector>
 
 #include "ClustersEngineCreator.hpp"
 #include "FeaturesEngineCreator.hpp"
+#include "HnswEngineCreator.hpp"
 
 #include "services/database/Db.hpp"
 #include "services/database/Session.hpp"
@@ -42,19 +45,21 @@ namespace Recommendation
 		{
 			case EngineType::Clusters: return "clusters";
 			case EngineType::Features: return "features";
+			case EngineType::Hnsw: return "hnsw";
 		}
 
 		throw LmsException {"Internal error"};
 	}
 
 	std::unique_ptr<IRecommendationService>
-	createRecommendationService(Database::Db& db)
+	createRecommendationService(Database::Db& db, std::optional<EngineType> engineType)
 	{
-		return std::make_unique<RecommendationService>(db);
+		return std::make_unique<RecommendationService>(db, engineType);
 	}
 
-	RecommendationService::RecommendationService(Database::Db& db)
+	RecommendationService::RecommendationService(Database::Db& db, std::optional<EngineType> forcedEngineType)
 		: _db {db}
+		, _forcedEngineType {forcedEngineType}
 	{
 	}
 
@@ -63,11 +68,11 @@ namespace Recommendation
 	{
 		TrackContainer res;
 
-		std::shared_lock lock {_enginesMutex};
-		for (const auto& engineType : _enginePriorities)
+		const std::shared_ptr<const Engines> engines {getEngines()};
+		for (const auto& engineType : engines->priorities)
 		{
-			auto itEngine {_engines.find(engineType)};
-			if (itEngine == std::cend(_engines))
+			auto itEngine {engines->engines.find(engineType)};
+			if (itEngine == std::cend(engines->engines))
 				continue;
 
 			res = itEngine->second->findSimilarTracksFromTrackList(trackListId, maxCount);
@@ -83,11 +88,11 @@ namespace Recommendation
 	{
 		TrackContainer res;
 
-		std::shared_lock lock {_enginesMutex};
-		for (EngineType engineType : _enginePriorities)
+		const std::shared_ptr<const Engines> engines {getEngines()};
+		for (EngineType engineType : engines->priorities)
 		{
-			auto itEngine {_engines.find(engineType)};
-			if (itEngine == std::cend(_engines))
+			auto itEngine {engines->engines.find(engineType)};
+			if (itEngine == std::cend(engines->engines))
 				continue;
 
 			const IEngine& engine {*itEngine->second};
@@ -107,11 +112,11 @@ namespace Recommendation
 	{
 		ReleaseContainer res;
 
-		std::shared_lock lock {_enginesMutex};
-		for (EngineType engineType : _enginePriorities)
+		const std::shared_ptr<const Engines> engines {getEngines()};
+		for (EngineType engineType : engines->priorities)
 		{
-			auto itEngine {_engines.find(engineType)};
-			if (itEngine == std::cend(_engines))
+			auto itEngine {engines->engines.find(engineType)};
+			if (itEngine == std::cend(engines->engines))
 				continue;
 
 			const IEngine& engine {*itEngine->second};
@@ -133,11 +138,11 @@ namespace Recommendation
 	{
 		ArtistContainer res;
 
-		std::shared_lock lock {_enginesMutex};
-		for (EngineType engineType : _enginePriorities)
+		const std::shared_ptr<const Engines> engines {getEngines()};
+		for (EngineType engineType : engines->priorities)
 		{
-			auto itEngine {_engines.find(engineType)};
-			if (itEngine == std::cend(_engines))
+			auto itEngine {engines->engines.find(engineType)};
+			if (itEngine == std::cend(engines->engines))
 				continue;
 
 			LMS_LOG(RECOMMENDATION, DEBUG) << "Trying engine '" << engineTypeToString(engineType) << "'";
@@ -170,30 +175,55 @@ namespace Recommendation
 
 		LMS_LOG(RECOMMENDATION, INFO) << "Reloading recommendation engines...";
 
-		EngineContainer enginesToLoad;
+		// ordered by load order
+		std::vector<std::pair<EngineType, std::shared_ptr<IEngine>>> enginesToLoad;
+		std::vector<EngineType> enginePriorities;
 
 		{
 			std::unique_lock controlLock {_controlMutex};
 
+			_loaded = false;
+
+			if (_forcedEngineType)
 			{
-				std::unique_lock lock {_enginesMutex};
-				_engines.clear();
+				enginePriorities = {*_forcedEngineType};
+				switch (*_forcedEngineType)
+				{
+					case EngineType::Clusters:
+						enginesToLoad.emplace_back(EngineType::Clusters, createClustersEngine(_db));
+						break;
+					case EngineType::Features:
+						enginesToLoad.emplace_back(EngineType::Features, createFeaturesEngine(_db));
+						break;
+					case EngineType::Hnsw:
+						enginesToLoad.emplace_back(EngineType::Hnsw, createHnswEngine(_db));
+						break;
+				}
 			}
-
-			switch (getRecommendationEngineType(_db.getTLSSession()))
+			else
 			{
-				case ScanSettings::RecommendationEngineType::Clusters:
-					_enginePriorities = {EngineType::Clusters};
-					enginesToLoad.try_emplace(EngineType::Clusters, createClustersEngine(_db));
-					break;
-
-				case ScanSettings::RecommendationEngineType::Features:
-					_enginePriorities = {EngineType::Features, EngineType::Clusters};
-
-					// not same order since clusters is faster to load
-					enginesToLoad.try_emplace(EngineType::Clusters, createClustersEngine(_db));
-					enginesToLoad.try_emplace(EngineType::Features, createFeaturesEngine(_db));
-					break;
+				switch (getRecommendationEngineType(_db.getTLSSession()))
+				{
+					case ScanSettings::RecommendationEngineType::Clusters:
+						enginePriorities = {EngineType::Clusters};
+						enginesToLoad.emplace_back(EngineType::Clusters, createClustersEngine(_db));
+						break;
+
+					case ScanSettings::RecommendationEngineType::Features:
+						enginePriorities = {EngineType::Features, EngineType::Clusters};
+
+						// not same order since clusters is much faster to load: it is used until features is ready
+						enginesToLoad.emplace_back(EngineType::Clusters, createClustersEngine(_db));
+						enginesToLoad.emplace_back(EngineType::Features, createFeaturesEngine(_db));
+						break;
+
+					case ScanSettings::RecommendationEngineType::Hnsw:
+						enginePriorities = {EngineType::Hnsw, EngineType::Clusters};
+
+						enginesToLoad.emplace_back(EngineType::Clusters, createClustersEngine(_db));
+						enginesToLoad.emplace_back(EngineType::Hnsw, createHnswEngine(_db));
+						break;
+				}
 			}
 
 			assert(_pendingEngines.empty());
@@ -201,16 +231,34 @@ namespace Recommendation
 				_pendingEngines.push_back(engine.get());
 		}
 
+		// The engines are loaded off to the side, the previous ones keep serving the queries until their replacement is ready
+		EngineContainer loadedEngines;
+		std::vector<EngineType> pendingEngineTypes;
+		for (const auto& [engineType, engine] : enginesToLoad)
+			pendingEngineTypes.push_back(engineType);
+
 		for (auto& [engineType, engine] : enginesToLoad)
-			loadPendingEngine(engineType, std::move(engine), forceReload, progressCallback);
+		{
+			pendingEngineTypes.erase(std::find(std::begin(pendingEngineTypes), std::end(pendingEngineTypes), engineType));
+
+			if (!loadPendingEngine(engineType, *engine, forceReload, progressCallback))
+				continue;
+
+			loadedEngines.emplace(engineType, std::move(engine));
+			publishEngines(enginePriorities, loadedEngines, pendingEngineTypes);
+		}
 
 		_pendingEnginesCondvar.notify_all();
 
+		if (_loadCancelled)
+			return;
+
+		_loaded = true;
 		LMS_LOG(RECOMMENDATION, INFO) << "Recommendation engines loaded!";
 	}
 
-	void
-	RecommendationService::loadPendingEngine(EngineType engineType, std::unique_ptr<IEngine> engine, bool forceReload, const ProgressCallback& progressCallback)
+	bool
+	RecommendationService::loadPendingEngine(EngineType engineType, IEngine& engine, bool forceReload, const ProgressCallback& progressCallback)
 	{
 		if (!_loadCancelled)
 		{
@@ -221,21 +269,37 @@ namespace Recommendation
 				progressCallback(progress);
 			}};
 
-			engine->load(forceReload, progressCallback ? progress : ProgressCallback {});
+			engine.load(forceReload, progressCallback ? progress : ProgressCallback {});
 
 			LMS_LOG(RECOMMENDATION, INFO) << "Initializing engine '" << engineTypeToString(engineType) << "': " << (_loadCancelled ? "aborted" : "complete");
 		}
 
 		{
 			std::scoped_lock lock {_controlMutex};
-			_pendingEngines.erase(std::find(std::begin(_pendingEngines), std::end(_pendingEngines), engine.get()));
+			_pendingEngines.erase(std::find(std::begin(_pendingEngines), std::end(_pendingEngines), &engine));
 		}
 
-		if (!_loadCancelled)
+		return !_loadCancelled;
+	}
+
+	void
+	RecommendationService::publishEngines(const std::vector<EngineType>& priorities, const EngineContainer& loadedEngines, const std::vector<EngineType>& pendingEngineTypes)
+	{
+		const std::shared_ptr<const Engines> previousEngines {getEngines()};
+
+		auto engines {std::make_shared<Engines>()};
+		engines->priorities = priorities;
+		engines->engines = loadedEngines;
+
+		// keep using the previous engines that are still being reloaded
+		for (EngineType engineType : pendingEngineTypes)
 		{
-			std::unique_lock lock {_enginesMutex};
-			_engines.emplace(engineType, std::move(engine));
+			auto itEngine {previousEngines->engines.find(engineType)};
+			if (itEngine != std::cend(previousEngines->engines))
+				engines->engines.emplace(engineType, itEngine->second);
 		}
+
+		std::atomic_store(&_engines, std::shared_ptr<const Engines> {std::move(engines)});
 	}
 
 	void
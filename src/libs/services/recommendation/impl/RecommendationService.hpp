@@ -19,9 +19,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
-#include <shared_mutex>
+#include <optional>
 #include <unordered_map>
 #include <vector>
 
@@ -35,16 +37,10 @@ namespace Database
 
 namespace Recommendation
 {
-	enum class EngineType
-	{
-		Clusters,
-		Features,
-	};
-
 	class RecommendationService : public IRecommendationService
 	{
 		public:
-			RecommendationService(Database::Db& db);
+			RecommendationService(Database::Db& db, std::optional<EngineType> forcedEngineType);
 			~RecommendationService() = default;
 
 			RecommendationService(const RecommendationService&) = delete;
@@ -55,30 +51,40 @@ namespace Recommendation
 		private:
 			void	load(bool forceReload, const ProgressCallback& progressCallback) override;
 			void	cancelLoad() override;
+			bool	isLoaded() const override { return _loaded; }
 
 			TrackContainer findSimilarTracksFromTrackList(Database::TrackListId tracklistId, std::size_t maxCount) const override;
 			TrackContainer findSimilarTracks(const std::vector<Database::TrackId>& tracksId, std::size_t maxCount) const override;
 			ReleaseContainer getSimilarReleases(Database::ReleaseId releaseId, std::size_t maxCount) const override;
 			ArtistContainer getSimilarArtists(Database::ArtistId artistId, EnumSet<Database::TrackArtistLinkType> linkTypes, std::size_t maxCount) const override;
 
-			void setEnginePriorities(const std::vector<EngineType>& engineTypes);
-			void clearEngines();
-			void loadPendingEngine(EngineType engineType, std::unique_ptr<IEngine> engine, bool forceReload, const ProgressCallback& progressCallback);
+			using EngineContainer = std::unordered_map<EngineType, std::shared_ptr<const IEngine>>;
+
+			// Never modified once published
+			struct Engines
+			{
+				std::vector<EngineType>	priorities; // ordered by priority
+				EngineContainer			engines;
+			};
+
+			// false if cancelled
+			bool loadPendingEngine(EngineType engineType, IEngine& engine, bool forceReload, const ProgressCallback& progressCallback);
+			void publishEngines(const std::vector<EngineType>& priorities, const EngineContainer& loadedEngines, const std::vector<EngineType>& pendingEngineTypes);
+			std::shared_ptr<const Engines> getEngines() const { return std::atomic_load(&_engines); }
 
 			Database::Db&				_db;
+			const std::optional<EngineType>	_forcedEngineType;
 
 			std::mutex					_controlMutex;
 			bool						_loadCancelled {};
+			std::atomic<bool>			_loaded {};
 
-			using EngineContainer = std::unordered_map<EngineType, std::unique_ptr<IEngine>>;
-			EngineContainer				_engines;
-			mutable std::shared_mutex	_enginesMutex;
+			// The engines are replaced as a whole once loaded: queries still use the previous ones meanwhile
+			// Only accessed using std::atomic_load/std::atomic_store
+			std::shared_ptr<const Engines>	_engines {std::make_shared<const Engines>()};
 
 			std::vector<IEngine*>		_pendingEngines;
-			std::shared_mutex			_pendingEnginesMutex;
 			std::condition_variable 	_pendingEnginesCondvar;
-
-			std::vector<EngineType>		_enginePriorities; // ordered by priority
 	};
 
 } // ns Recommendation
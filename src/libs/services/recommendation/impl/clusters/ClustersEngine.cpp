@@ -19,13 +19,14 @@
 
 #include "ClustersEngine.hpp"
 
-#include "services/database/Artist.hpp"
-#include "services/database/Cluster.hpp"
+#include <algorithm>
+
 #include "services/database/Db.hpp"
-#include "services/database/Release.hpp"
 #include "services/database/Session.hpp"
 #include "services/database/Track.hpp"
 #include "services/database/TrackList.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Random.hpp"
 
 namespace Recommendation {
 
@@ -36,15 +37,114 @@ std::unique_ptr<IEngine> createClustersEngine(Db& db)
 	return std::make_unique<ClusterEngine>(db);
 }
 
+template <typename IdType>
+static
+std::vector<IdType>
+getMostScoredIds(const std::unordered_map<IdType, std::size_t>& scores, std::size_t maxCount)
+{
+	std::vector<std::pair<IdType, std::size_t>> entries {std::cbegin(scores), std::cend(scores)};
+
+	// most scored first, random order for the same score
+	Random::shuffleContainer(entries);
+	const std::size_t count {std::min(maxCount, entries.size())};
+	std::partial_sort(std::begin(entries), std::next(std::begin(entries), count), std::end(entries),
+			[](const auto& a, const auto& b) { return a.second > b.second; });
+
+	std::vector<IdType> res;
+	res.reserve(count);
+	std::transform(std::cbegin(entries), std::next(std::cbegin(entries), count), std::back_inserter(res), [](const auto& entry) { return entry.first; });
+
+	return res;
+}
+
+void
+ClusterEngine::load(bool, const ProgressCallback&)
+{
+	Session& session {_db.getTLSSession()};
+
+	auto transaction {session.createSharedTransaction()};
+
+	{
+		std::unordered_map<ClusterId, ClusterIndex> clusterIndexes;
+		Track::visitClusterLinks(session, [&](TrackId trackId, ClusterId clusterId)
+		{
+			const auto [itCluster, inserted] {clusterIndexes.try_emplace(clusterId, clusterIndexes.size())};
+			if (inserted)
+				_clusterTracks.emplace_back();
+
+			_clusterTracks[itCluster->second].push_back(trackId);
+			_trackClusters[trackId].push_back(itCluster->second);
+		});
+	}
+
+	if (_loadCancelled)
+		return;
+
+	Track::visitReleaseLinks(session, [&](TrackId trackId, ReleaseId releaseId)
+	{
+		_trackReleases.emplace(trackId, releaseId);
+		_releaseTracks[releaseId].push_back(trackId);
+	});
+
+	if (_loadCancelled)
+		return;
+
+	Track::visitArtistLinks(session, [&](TrackId trackId, ArtistId artistId, TrackArtistLinkType linkType)
+	{
+		_trackArtistLinks[trackId].push_back({artistId, linkType});
+		_artistTracks[artistId].push_back(trackId);
+	});
+
+	// artists may be linked several times to the same track
+	for (auto& [artistId, trackIds] : _artistTracks)
+	{
+		std::sort(std::begin(trackIds), std::end(trackIds));
+		trackIds.erase(std::unique(std::begin(trackIds), std::end(trackIds)), std::end(trackIds));
+	}
+
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Loaded " << _clusterTracks.size() << " clusters, " << _trackClusters.size() << " tracks, " << _releaseTracks.size() << " releases and " << _artistTracks.size() << " artists";
+}
+
+void
+ClusterEngine::requestCancelLoad()
+{
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Requesting init cancellation";
+	_loadCancelled = true;
+}
+
+ClusterEngine::ClusterIndexes
+ClusterEngine::getClusterIndexes(const std::vector<TrackId>& trackIds) const
+{
+	ClusterIndexes res;
+
+	for (const TrackId trackId : trackIds)
+	{
+		const auto itClusters {_trackClusters.find(trackId)};
+		if (itClusters != std::cend(_trackClusters))
+			res.insert(std::end(res), std::cbegin(itClusters->second), std::cend(itClusters->second));
+	}
+
+	std::sort(std::begin(res), std::end(res));
+	res.erase(std::unique(std::begin(res), std::end(res)), std::end(res));
+
+	return res;
+}
+
 TrackContainer
 ClusterEngine::findSimilarTracks(const std::vector<TrackId>& trackIds, std::size_t maxCount) const
 {
-	Session& dbSession {_db.getTLSSession()};
+	std::unordered_map<TrackId, std::size_t> scores;
 
-	auto transaction {dbSession.createSharedTransaction()};
+	for (const ClusterIndex clusterIndex : getClusterIndexes(trackIds))
+	{
+		for (const TrackId trackId : _clusterTracks[clusterIndex])
+			scores[trackId]++;
+	}
+
+	for (const TrackId trackId : trackIds)
+		scores.erase(trackId);
 
-	const auto similarTrackIds {Track::findSimilarTracks(dbSession, trackIds, Range {0, maxCount})};
-	return std::move(similarTrackIds.results);
+	return getMostScoredIds(scores, maxCount);
 }
 
 TrackContainer
@@ -52,57 +152,68 @@ ClusterEngine::findSimilarTracksFromTrackList(TrackListId tracklistId, std::size
 {
 	Session& dbSession {_db.getTLSSession()};
 
-	TrackContainer res;
-
+	std::vector<TrackId> trackIds;
 	{
 		auto transaction {dbSession.createSharedTransaction()};
 
 		const TrackList::pointer trackList {TrackList::find(dbSession, tracklistId)};
 		if (!trackList)
-			return res;
+			return {};
 
-		const auto tracks {trackList->getSimilarTracks(0, maxCount)};
-		res.reserve(tracks.size());
-		std::transform(std::cbegin(tracks), std::cend(tracks), std::back_inserter(res), [](const auto& track) { return track->getId(); });
+		trackIds = trackList->getTrackIds();
 	}
 
-	return res;
+	return findSimilarTracks(trackIds, maxCount);
 }
 
 ReleaseContainer
 ClusterEngine::getSimilarReleases(ReleaseId releaseId, std::size_t maxCount) const
 {
-	Session& dbSession {_db.getTLSSession()};
-
-	ReleaseContainer res;
-	{
-		auto transaction {dbSession.createSharedTransaction()};
+	const auto itTracks {_releaseTracks.find(releaseId)};
+	if (itTracks == std::cend(_releaseTracks))
+		return {};
 
-		auto release {Release::find(dbSession, releaseId)};
-		if (!release)
-			return res;
+	std::unordered_map<ReleaseId, std::size_t> scores;
 
-		const auto releases {release->getSimilarReleases(0, maxCount)};
-		res.reserve(releases.size());
-		std::transform(std::cbegin(releases), std::cend(releases), std::back_inserter(res), [](const auto& release) { return release->getId(); });
+	for (const ClusterIndex clusterIndex : getClusterIndexes(itTracks->second))
+	{
+		for (const TrackId trackId : _clusterTracks[clusterIndex])
+		{
+			const auto itRelease {_trackReleases.find(trackId)};
+			if (itRelease != std::cend(_trackReleases) && itRelease->second != releaseId)
+				scores[itRelease->second]++;
+		}
 	}
 
-	return res;
+	return getMostScoredIds(scores, maxCount);
 }
 
 ArtistContainer
 ClusterEngine::getSimilarArtists(ArtistId artistId, EnumSet<TrackArtistLinkType> artistLinkTypes, std::size_t maxCount) const
 {
-	Session& dbSession {_db.getTLSSession()};
+	const auto itTracks {_artistTracks.find(artistId)};
+	if (itTracks == std::cend(_artistTracks))
+		return {};
 
-	auto transaction {dbSession.createSharedTransaction()};
+	std::unordered_map<ArtistId, std::size_t> scores;
 
-	auto artist {Artist::find(dbSession, artistId)};
-	if (!artist)
-		return {};
+	for (const ClusterIndex clusterIndex : getClusterIndexes(itTracks->second))
+	{
+		for (const TrackId trackId : _clusterTracks[clusterIndex])
+		{
+			const auto itArtistLinks {_trackArtistLinks.find(trackId)};
+			if (itArtistLinks == std::cend(_trackArtistLinks))
+				continue;
+
+			for (const ArtistLink& artistLink : itArtistLinks->second)
+			{
+				if (artistLink.artistId != artistId && (artistLinkTypes.empty() || artistLinkTypes.contains(artistLink.type)))
+					scores[artistLink.artistId]++;
+			}
+		}
+	}
 
-	const auto similarArtistIds {artist->findSimilarArtists(artistLinkTypes, Range {0, maxCount})};
-	return std::move(similarArtistIds.results);
+	return getMostScoredIds(scores, maxCount);
 }
 
 } // namespace Recommendation
@@ -19,6 +19,9 @@
 
 #pragma once
 
+#include <unordered_map>
+#include <vector>
+
 #include "IEngine.hpp"
 
 namespace Recommendation
@@ -35,15 +38,37 @@ namespace Recommendation
 			ClusterEngine& operator=(ClusterEngine&&) = delete;
 
 		private:
-			void load(bool, const ProgressCallback&) override {}
-			void requestCancelLoad() override {}
+			void load(bool forceReload, const ProgressCallback& progressCallback) override;
+			void requestCancelLoad() override;
 
 			TrackContainer		findSimilarTracksFromTrackList(Database::TrackListId tracklistId, std::size_t maxCount) const override;
 			TrackContainer		findSimilarTracks(const std::vector<Database::TrackId>& tracksId, std::size_t maxCount) const override;
 			ReleaseContainer	getSimilarReleases(Database::ReleaseId releaseId, std::size_t maxCount) const override;
 			ArtistContainer		getSimilarArtists(Database::ArtistId artistId, EnumSet<Database::TrackArtistLinkType> linkTypes, std::size_t maxCount) const override;
 
-			Database::Db& _db;
+			using ClusterIndex = std::size_t;
+			using ClusterIndexes = std::vector<ClusterIndex>;
+
+			// union of the clusters of the given tracks
+			ClusterIndexes getClusterIndexes(const std::vector<Database::TrackId>& trackIds) const;
+
+			Database::Db&	_db;
+			bool			_loadCancelled {};
+
+			// In memory inverted indexes, rebuilt on each load (engines are reloaded after scans)
+			// Similarities are computed as the number of links to the clusters of the requested objects
+			struct ArtistLink
+			{
+				Database::ArtistId				artistId;
+				Database::TrackArtistLinkType	type;
+			};
+
+			std::vector<std::vector<Database::TrackId>>						_clusterTracks;	// per cluster index
+			std::unordered_map<Database::TrackId, ClusterIndexes>			_trackClusters;
+			std::unordered_map<Database::TrackId, Database::ReleaseId>		_trackReleases;
+			std::unordered_map<Database::ReleaseId, std::vector<Database::TrackId>>	_releaseTracks;
+			std::unordered_map<Database::TrackId, std::vector<ArtistLink>>	_trackArtistLinks;
+			std::unordered_map<Database::ArtistId, std::vector<Database::TrackId>>	_artistTracks;
 	};
 
 } // namespace Recommendation
@@ -19,7 +19,9 @@
 
 #include "FeaturesEngine.hpp"
 
+#include <algorithm>
 #include <numeric>
+#include <thread>
 
 #include "services/database/Artist.hpp"
 #include "services/database/Db.hpp"
@@ -30,8 +32,12 @@
 #include "services/database/TrackFeatures.hpp"
 #include "services/database/TrackList.hpp"
 #include "som/DataNormalizer.hpp"
+#include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Profiling.hpp"
 #include "utils/Random.hpp"
+#include "utils/Service.hpp"
+#include "utils/WorkBudget.hpp"
 
 
 namespace Recommendation {
@@ -80,6 +86,25 @@ convertFeatureValuesMapToInputVector(const FeatureValuesMap& featureValuesMap, s
 	return res;
 }
 
+static
+std::unordered_set<FeatureName>
+getFeatureNames(const FeatureSettingsMap& featureSettingsMap)
+{
+	std::unordered_set<FeatureName> featureNames;
+	std::transform(std::cbegin(featureSettingsMap), std::cend(featureSettingsMap), std::inserter(featureNames, std::begin(featureNames)),
+		[](const auto& itFeatureSetting) { return itFeatureSetting.first; });
+
+	return featureNames;
+}
+
+static
+std::size_t
+getFeaturesDimensionCount(const std::unordered_set<FeatureName>& featureNames)
+{
+	return std::accumulate(std::cbegin(featureNames), std::cend(featureNames), std::size_t {0},
+			[](std::size_t sum, const FeatureName& featureName) { return sum + getFeatureDef(featureName).nbDimensions; });
+}
+
 static
 SOM::InputVector
 getInputVectorWeights(const FeatureSettingsMap& featureSettingsMap, std::size_t nbDimensions)
@@ -99,61 +124,139 @@ getInputVectorWeights(const FeatureSettingsMap& featureSettingsMap, std::size_t
 	return weights;
 }
 
+static
+std::size_t
+getThreadCount()
+{
+	const unsigned long configThreadCount {Service<IConfig>::get()->getULong("features-training-thread-count", 0)};
+	return configThreadCount ? configThreadCount : std::max<unsigned long>(1, std::thread::hardware_concurrency());
+}
+
+static
 void
-FeaturesEngine::loadFromTraining(const TrainSettings& trainSettings, const ProgressCallback& progressCallback)
+parallelFor(std::size_t count, std::size_t threadCount, const std::function<void(std::size_t /* first */, std::size_t /* last */)>& func)
 {
-	LMS_LOG(RECOMMENDATION, INFO) << "Constructing features classifier...";
+	auto runRange {[&func](std::size_t first, std::size_t last)
+	{
+		const WorkBudget::ScopedSlot slot {WorkBudget::WorkClass::Bulk};
+		const Profiling::ScopedLabel profilingLabel {"similarity_tables"};
+		func(first, last);
+	}};
 
-	std::unordered_set<FeatureName> featureNames;
-	std::transform(std::cbegin(trainSettings.featureSettingsMap), std::cend(trainSettings.featureSettingsMap), std::inserter(featureNames, std::begin(featureNames)),
-		[](const auto& itFeatureSetting) { return itFeatureSetting.first; });
+	threadCount = std::min(threadCount, count);
+	if (threadCount <= 1)
+	{
+		runRange(0, count);
+		return;
+	}
 
-	const std::size_t nbDimensions {std::accumulate(std::cbegin(featureNames), std::cend(featureNames), std::size_t {0},
-			[](std::size_t sum, const FeatureName& featureName) { return sum + getFeatureDef(featureName).nbDimensions; })};
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
 
-	LMS_LOG(RECOMMENDATION, DEBUG) << "Features dimension = " << nbDimensions;
+	const std::size_t rangeSize {(count + threadCount - 1) / threadCount};
+	for (std::size_t first {rangeSize}; first < count; first += rangeSize)
+		threads.emplace_back([=, &runRange] { runRange(first, std::min(first + rangeSize, count)); });
 
-	Session& session {_db.getTLSSession()};
+	runRange(0, std::min(rangeSize, count));
 
-	RangeResults<TrackFeaturesId> trackFeaturesIds;
-	{
-		auto transaction {session.createSharedTransaction()};
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+template <typename IdType>
+FeaturesEngine::SimilarityTable<IdType>
+FeaturesEngine::computeSimilarityTable(const ObjectIndex<IdType>& objectIndex,
+		const ObjectNeurons<IdType>& objectNeurons,
+		std::size_t similarCount,
+		std::size_t threadCount) const
+{
+	SimilarityTable<IdType> res;
 
-		LMS_LOG(RECOMMENDATION, DEBUG) << "Getting Track features...";
-		trackFeaturesIds = TrackFeatures::find(session, Range {});
-		LMS_LOG(RECOMMENDATION, DEBUG) << "Getting Track features DONE (found " << trackFeaturesIds.results.size() << " track features)";
+	std::vector<IdType> ids;
+	ids.reserve(objectNeurons.size());
+	for (const auto& [id, neurons] : objectNeurons)
+		ids.push_back(id);
+
+	std::vector<std::vector<IdType>> similarIds(ids.size());
+	parallelFor(ids.size(), threadCount, [&](std::size_t first, std::size_t last)
+	{
+		for (std::size_t i {first}; i < last && !_loadCancelled; ++i)
+			similarIds[i] = getSimilarObjects({ids[i]}, objectIndex, objectNeurons, similarCount);
+	});
+
+	res.indexes.reserve(ids.size());
+	res.offsets.reserve(ids.size() + 1);
+	res.offsets.push_back(0);
+	for (std::size_t i {}; i < ids.size(); ++i)
+	{
+		res.indexes.emplace(ids[i], i);
+		res.similarIds.insert(std::end(res.similarIds), std::cbegin(similarIds[i]), std::cend(similarIds[i]));
+		res.offsets.push_back(res.similarIds.size());
 	}
 
+	return res;
+}
+
+template <typename IdType>
+std::vector<IdType>
+FeaturesEngine::getSimilarObjects(IdType id,
+		const SimilarityTable<IdType>& similarityTable,
+		const ObjectIndex<IdType>& objectIndex,
+		const ObjectNeurons<IdType>& objectNeurons,
+		std::size_t maxCount) const
+{
+	const auto it {similarityTable.indexes.find(id)};
+	if (it == std::cend(similarityTable.indexes))
+		return getSimilarObjects({id}, objectIndex, objectNeurons, maxCount);
+
+	const auto first {std::next(std::cbegin(similarityTable.similarIds), similarityTable.offsets[it->second])};
+	const auto last {std::next(std::cbegin(similarityTable.similarIds), similarityTable.offsets[it->second + 1])};
+	const std::size_t similarCount {static_cast<std::size_t>(std::distance(first, last))};
+
+	// a shorter list means all the similar objects have been found
+	if (maxCount > similarCount && similarCount == _similarityTableCount)
+		return getSimilarObjects({id}, objectIndex, objectNeurons, maxCount);
+
+	return std::vector<IdType>(first, std::next(first, std::min(maxCount, similarCount)));
+}
+
+void
+FeaturesEngine::loadFromTraining(const TrainSettings& trainSettings, const ProgressCallback& progressCallback)
+{
+	LMS_LOG(RECOMMENDATION, INFO) << "Constructing features classifier...";
+
+	const std::unordered_set<FeatureName> featureNames {getFeatureNames(trainSettings.featureSettingsMap)};
+	const std::size_t nbDimensions {getFeaturesDimensionCount(featureNames)};
+
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Features dimension = " << nbDimensions;
+
+	Session& session {_db.getTLSSession()};
+
 	std::vector<SOM::InputVector> samples;
 	std::vector<TrackId> samplesTrackIds;
 
-	samples.reserve(trackFeaturesIds.results.size());
-	samplesTrackIds.reserve(trackFeaturesIds.results.size());
-
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Extracting features...";
-	// TODO handle errors using exceptions
-	for (const TrackFeaturesId trackFeaturesId : trackFeaturesIds.results)
 	{
-		if (_loadCancelled)
-			return;
-
 		auto transaction {session.createSharedTransaction()};
 
-		TrackFeatures::pointer trackFeatures {TrackFeatures::find(session, trackFeaturesId)};
-		if (!trackFeatures)
-			continue;
-
-		FeatureValuesMap featureValuesMap {trackFeatures->getFeatureValuesMap(featureNames)};
-		if (featureValuesMap.empty())
-			continue;
+		const std::size_t trackFeaturesCount {TrackFeatures::getCount(session)};
+		samples.reserve(trackFeaturesCount);
+		samplesTrackIds.reserve(trackFeaturesCount);
 
-		std::optional<SOM::InputVector> inputVector {convertFeatureValuesMapToInputVector(featureValuesMap, nbDimensions)};
-		if (!inputVector)
-			continue;
+		TrackFeatures::visitFeatureValuesMaps(session, featureNames, [&](TrackId trackId, const FeatureValuesMap& featureValuesMap)
+		{
+			std::optional<SOM::InputVector> inputVector {convertFeatureValuesMapToInputVector(featureValuesMap, nbDimensions)};
+			if (!inputVector)
+				return;
 
-		samples.emplace_back(std::move(*inputVector));
-		samplesTrackIds.emplace_back(trackFeatures->getTrack()->getId());
+			samples.emplace_back(std::move(*inputVector));
+			samplesTrackIds.emplace_back(trackId);
+		});
 	}
+
+	if (_loadCancelled)
+		return;
+
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Extracting features DONE";
 
 	if (samples.empty())
@@ -166,8 +269,7 @@ FeaturesEngine::loadFromTraining(const TrainSettings& trainSettings, const Progr
 	SOM::DataNormalizer dataNormalizer {nbDimensions};
 
 	dataNormalizer.computeNormalizationFactors(samples);
-	for (auto& sample : samples)
-		dataNormalizer.normalizeData(sample);
+	dataNormalizer.normalizeData(samples, trainSettings.batchTrainingThreadCount);
 
 	SOM::Coordinate size {static_cast<SOM::Coordinate>(std::sqrt(samples.size() / trainSettings.sampleCountPerNeuron))};
 	if (size < 2)
@@ -188,10 +290,20 @@ FeaturesEngine::loadFromTraining(const TrainSettings& trainSettings, const Progr
 		progressCallback(Progress {iter.idIteration, iter.iterationCount});
 	}};
 
-	LMS_LOG(RECOMMENDATION, DEBUG) << "Training network...";
-	network.train(samples, trainSettings.iterationCount,
-			progressCallback ? somProgressCallback : SOM::Network::ProgressCallback {},
-			[this] { return _loadCancelled; });
+	if (trainSettings.batchTraining)
+	{
+		LMS_LOG(RECOMMENDATION, DEBUG) << "Training network (batch, using " << trainSettings.batchTrainingThreadCount << " threads)...";
+		network.trainBatch(samples, trainSettings.iterationCount, trainSettings.batchTrainingThreadCount,
+				progressCallback ? somProgressCallback : SOM::Network::ProgressCallback {},
+				[this] { return _loadCancelled; });
+	}
+	else
+	{
+		LMS_LOG(RECOMMENDATION, DEBUG) << "Training network...";
+		network.train(samples, trainSettings.iterationCount,
+				progressCallback ? somProgressCallback : SOM::Network::ProgressCallback {},
+				[this] { return _loadCancelled; });
+	}
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Training network DONE";
 
 
@@ -209,6 +321,7 @@ FeaturesEngine::loadFromTraining(const TrainSettings& trainSettings, const Progr
 
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Classifying tracks DONE";
 
+	_trainingInfo.emplace(FeaturesEngineCache::TrainingInfo {std::move(dataNormalizer), 0});
 	load(std::move(network), std::move(trackPositions));
 }
 
@@ -217,9 +330,101 @@ FeaturesEngine::loadFromCache(FeaturesEngineCache cache)
 {
 	LMS_LOG(RECOMMENDATION, INFO) << "Constructing features classifier from cache...";
 
+	if (cache._trainingInfo)
+		_trainingInfo.emplace(std::move(*cache._trainingInfo));
 	load(std::move(cache._network), cache._trackPositions);
 }
 
+bool
+FeaturesEngine::loadFromCacheIncrementally(FeaturesEngineCache cache, unsigned long maxChangedPercent)
+{
+	if (!cache._trainingInfo)
+	{
+		LMS_LOG(RECOMMENDATION, DEBUG) << "No training info in cache, cannot update incrementally";
+		return false;
+	}
+
+	const std::unordered_set<FeatureName> featureNames {getFeatureNames(getDefaultTrainFeatureSettings())};
+	const std::size_t nbDimensions {getFeaturesDimensionCount(featureNames)};
+	if (nbDimensions != cache._network.getInputDimCount() || nbDimensions != cache._trainingInfo->dataNormalizer.getInputDimCount())
+	{
+		LMS_LOG(RECOMMENDATION, DEBUG) << "Features dimension changed, cannot update incrementally";
+		return false;
+	}
+
+	Session& session {_db.getTLSSession()};
+
+	std::unordered_set<TrackId> trackIds;
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const RangeResults<TrackId> trackIdResults {TrackFeatures::findTrackIds(session, Range {})};
+		trackIds.insert(std::cbegin(trackIdResults.results), std::cend(trackIdResults.results));
+	}
+
+	if (trackIds.empty())
+		return false;
+
+	TrackPositions& trackPositions {cache._trackPositions};
+	std::size_t removedTrackCount {};
+	for (auto it {std::begin(trackPositions)}; it != std::end(trackPositions);)
+	{
+		if (trackIds.find(it->first) == std::cend(trackIds))
+		{
+			it = trackPositions.erase(it);
+			removedTrackCount++;
+		}
+		else
+			++it;
+	}
+
+	std::vector<TrackId> addedTrackIds;
+	for (const TrackId trackId : trackIds)
+	{
+		if (trackPositions.find(trackId) == std::cend(trackPositions))
+			addedTrackIds.push_back(trackId);
+	}
+
+	// changes are accumulated across updates, the network was trained with the whole library
+	const std::size_t updatedTrackCount {cache._trainingInfo->updatedTrackCount + removedTrackCount + addedTrackIds.size()};
+	if (updatedTrackCount * 100 > maxChangedPercent * trackIds.size())
+	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Too many tracks changed since the last training (" << updatedTrackCount << "/" << trackIds.size() << "), a new training is needed";
+		return false;
+	}
+
+	LMS_LOG(RECOMMENDATION, INFO) << "Updating features classifier from cache: " << addedTrackIds.size() << " added, " << removedTrackCount << " removed tracks...";
+
+	for (const TrackId trackId : addedTrackIds)
+	{
+		if (_loadCancelled)
+			return true;
+
+		auto transaction {session.createSharedTransaction()};
+
+		const TrackFeatures::pointer trackFeatures {TrackFeatures::find(session, trackId)};
+		if (!trackFeatures)
+			continue;
+
+		const FeatureValuesMap featureValuesMap {trackFeatures->getFeatureValuesMap(featureNames)};
+		if (featureValuesMap.empty())
+			continue;
+
+		std::optional<SOM::InputVector> inputVector {convertFeatureValuesMapToInputVector(featureValuesMap, nbDimensions)};
+		if (!inputVector)
+			continue;
+
+		cache._trainingInfo->dataNormalizer.normalizeData(*inputVector);
+		trackPositions[trackId].push_back(cache._network.getClosestRefVectorPosition(*inputVector));
+	}
+
+	cache._trainingInfo->updatedTrackCount = updatedTrackCount;
+	_trainingInfo.emplace(std::move(*cache._trainingInfo));
+	load(cache._network, trackPositions);
+
+	return true;
+}
+
 TrackContainer
 FeaturesEngine::findSimilarTracksFromTrackList(TrackListId trackListId, std::size_t maxCount) const
 {
@@ -244,7 +449,7 @@ FeaturesEngine::findSimilarTracksFromTrackList(TrackListId trackListId, std::siz
 TrackContainer
 FeaturesEngine::findSimilarTracks(const std::vector<TrackId>& tracksIds, std::size_t maxCount) const
 {
-	auto similarTrackIds {getSimilarObjects(tracksIds, _trackMatrix, _trackPositions, maxCount)};
+	auto similarTrackIds {getSimilarObjects(tracksIds, _trackIndex, _trackNeurons, maxCount)};
 
 	Session& session {_db.getTLSSession()};
 
@@ -265,7 +470,7 @@ FeaturesEngine::findSimilarTracks(const std::vector<TrackId>& tracksIds, std::si
 ReleaseContainer
 FeaturesEngine::getSimilarReleases(ReleaseId releaseId, std::size_t maxCount) const
 {
-	auto similarReleaseIds {getSimilarObjects({releaseId}, _releaseMatrix, _releasePositions, maxCount)};
+	auto similarReleaseIds {getSimilarObjects(releaseId, _releaseSimilarityTable, _releaseIndex, _releaseNeurons, maxCount)};
 
 	Session& session {_db.getTLSSession()};
 
@@ -291,13 +496,13 @@ FeaturesEngine::getSimilarArtists(ArtistId artistId, EnumSet<TrackArtistLinkType
 	{
 		ArtistContainer similarArtistIds;
 
-		const auto itArtists {_artistMatrix.find(linkType)};
-		if (itArtists == std::cend(_artistMatrix))
+		const auto itArtists {_artistIndexes.find(linkType)};
+		if (itArtists == std::cend(_artistIndexes))
 		{
 			return similarArtistIds;
 		}
 
-		return getSimilarObjects({artistId}, itArtists->second, _artistPositions, maxCount);
+		return getSimilarObjects(artistId, _artistSimilarityTables.at(linkType), itArtists->second, _artistNeurons, maxCount);
 	}};
 
 	std::unordered_set<ArtistId> similarArtistIds;
@@ -331,7 +536,18 @@ FeaturesEngine::getSimilarArtists(ArtistId artistId, EnumSet<TrackArtistLinkType
 FeaturesEngineCache
 FeaturesEngine::toCache() const
 {
-	return FeaturesEngineCache {*_network, _trackPositions};
+	const SOM::Coordinate width {_network ? _network->getWidth() : _quantizedNetwork->getWidth()};
+
+	TrackPositions trackPositions;
+	for (const auto& [trackId, neurons] : _trackNeurons)
+	{
+		std::vector<SOM::Position>& positions {trackPositions[trackId]};
+		for (const NeuronIndex neuronIndex : neurons)
+			positions.push_back({static_cast<SOM::Coordinate>(neuronIndex % width), static_cast<SOM::Coordinate>(neuronIndex / width)});
+	}
+
+	// the quantized network is saved dequantized: quantizing it again on reload gives the same values
+	return FeaturesEngineCache {_network ? *_network : _quantizedNetwork->toNetwork(), std::move(trackPositions), _trainingInfo};
 }
 
 void
@@ -339,6 +555,19 @@ FeaturesEngine::load(bool forceReload, const ProgressCallback& progressCallback)
 {
 	if (forceReload)
 	{
+		// 0 means always train again
+		const unsigned long maxChangedPercent {Service<IConfig>::get()->getULong("features-incremental-update-max-changed-percent", 10)};
+		if (maxChangedPercent > 0)
+		{
+			std::optional<FeaturesEngineCache> cache {FeaturesEngineCache::read()};
+			if (cache && loadFromCacheIncrementally(std::move(*cache), maxChangedPercent))
+			{
+				if (!_loadCancelled)
+					toCache().write();
+				return;
+			}
+		}
+
 		FeaturesEngineCache::invalidate();
 	}
 	else if (const std::optional<FeaturesEngineCache> cache {FeaturesEngineCache::read()})
@@ -349,6 +578,8 @@ FeaturesEngine::load(bool forceReload, const ProgressCallback& progressCallback)
 
 	TrainSettings trainSettings;
 	trainSettings.featureSettingsMap = getDefaultTrainFeatureSettings();
+	trainSettings.batchTraining = Service<IConfig>::get()->getBool("features-batch-training", true);
+	trainSettings.batchTrainingThreadCount = getThreadCount();
 
 	loadFromTraining(trainSettings, progressCallback);
 	if (!_loadCancelled)
@@ -373,8 +604,11 @@ FeaturesEngine::load(const SOM::Network& network, const TrackPositions& trackPos
 	const SOM::Coordinate width {network.getWidth()};
 	const SOM::Coordinate height {network.getHeight()};
 
-	_releaseMatrix = ReleaseMatrix {width, height};
-	_trackMatrix = TrackMatrix {width, height};
+	computeNeuronNeighbours(network);
+
+	ReleaseMatrix releaseMatrix {width, height};
+	TrackMatrix trackMatrix {width, height};
+	std::unordered_map<Database::TrackArtistLinkType, ArtistMatrix> artistMatrix;
 
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Constructing maps...";
 
@@ -393,35 +627,120 @@ FeaturesEngine::load(const SOM::Network& network, const TrackPositions& trackPos
 
 		for (const SOM::Position& position : positions)
 		{
-			Utils::push_back_if_not_present(_trackPositions[trackId], position);
-			Utils::push_back_if_not_present(_trackMatrix[position], trackId);
+			const NeuronIndex neuronIndex {static_cast<NeuronIndex>(position.x + static_cast<std::size_t>(position.y) * width)};
+
+			Utils::push_back_if_not_present(_trackNeurons[trackId], neuronIndex);
+			trackMatrix[position].push_back(trackId);
 
 			if (Release::pointer release {track->getRelease()})
 			{
 				const ReleaseId releaseId {release->getId()};
-				Utils::push_back_if_not_present(_releasePositions[releaseId], position);
-				Utils::push_back_if_not_present(_releaseMatrix[position], releaseId);
+				Utils::push_back_if_not_present(_releaseNeurons[releaseId], neuronIndex);
+				releaseMatrix[position].push_back(releaseId);
 			}
 			for (const TrackArtistLink::pointer& artistLink : track->getArtistLinks())
 			{
 				const ArtistId artistId {artistLink->getArtist()->getId()};
 
-				Utils::push_back_if_not_present(_artistPositions[artistId], position);
-				auto itArtists {_artistMatrix.find(artistLink->getType())};
-				if (itArtists == std::cend(_artistMatrix))
+				Utils::push_back_if_not_present(_artistNeurons[artistId], neuronIndex);
+				auto itArtists {artistMatrix.find(artistLink->getType())};
+				if (itArtists == std::cend(artistMatrix))
 				{
-					auto [it, inserted] = _artistMatrix.try_emplace(artistLink->getType(), ArtistMatrix {width, height});
+					auto [it, inserted] = artistMatrix.try_emplace(artistLink->getType(), ArtistMatrix {width, height});
 					assert(inserted);
 					itArtists = it;
 				}
-				Utils::push_back_if_not_present(itArtists->second[position], artistId);
+				itArtists->second[position].push_back(artistId);
 			}
 		}
 	}
 
-	_network = std::make_unique<SOM::Network>(network);
+	_trackIndex = createObjectIndex(trackMatrix);
+	_releaseIndex = createObjectIndex(releaseMatrix);
+	for (const auto& [linkType, matrix] : artistMatrix)
+		_artistIndexes.insert_or_assign(linkType, createObjectIndex(matrix));
+
+	if (Service<IConfig>::get()->getBool("features-quantized-network", false))
+	{
+		LMS_LOG(RECOMMENDATION, DEBUG) << "Quantizing network...";
+		_quantizedNetwork = std::make_unique<SOM::QuantizedNetwork>(network);
+	}
+	else
+		_network = std::make_unique<SOM::Network>(network);
+
+	computeSimilarityTables(Service<IConfig>::get()->getULong("features-similarity-table-size", 20), getThreadCount());
+	if (_loadCancelled)
+		return;
 
 	LMS_LOG(RECOMMENDATION, INFO) << "Classifier successfully loaded!";
 }
 
+void
+FeaturesEngine::computeSimilarityTables(std::size_t similarCount, std::size_t threadCount)
+{
+	_similarityTableCount = similarCount;
+	_releaseSimilarityTable = {};
+	_artistSimilarityTables.clear();
+
+	// empty tables: everything is computed on request
+	for (const auto& [linkType, artistIndex] : _artistIndexes)
+		_artistSimilarityTables.emplace(linkType, ArtistSimilarityTable {});
+
+	if (similarCount == 0)
+		return;
+
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Computing similarity tables...";
+
+	_releaseSimilarityTable = computeSimilarityTable(_releaseIndex, _releaseNeurons, similarCount, threadCount);
+	for (const auto& [linkType, artistIndex] : _artistIndexes)
+	{
+		if (_loadCancelled)
+			return;
+
+		_artistSimilarityTables[linkType] = computeSimilarityTable(artistIndex, _artistNeurons, similarCount, threadCount);
+	}
+
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Similarity tables computed";
+}
+
+void
+FeaturesEngine::computeNeuronNeighbours(const SOM::Network& network)
+{
+	const SOM::Coordinate width {network.getWidth()};
+	const SOM::Coordinate height {network.getHeight()};
+
+	_neuronNeighbourOffsets.clear();
+	_neuronNeighbours.clear();
+
+	_neuronNeighbourOffsets.reserve(static_cast<std::size_t>(width) * height + 1);
+	_neuronNeighbourOffsets.push_back(0);
+	for (SOM::Coordinate y {}; y < height; ++y)
+	{
+		for (SOM::Coordinate x {}; x < width; ++x)
+		{
+			const SOM::Position position {x, y};
+			const auto first {_neuronNeighbours.size()};
+
+			auto addNeighbour {[&](SOM::Position neighbour)
+			{
+				_neuronNeighbours.push_back({neighbour.x + static_cast<std::size_t>(neighbour.y) * width, network.getRefVectorsDistance(position, neighbour)});
+			}};
+
+			if (x > 0)
+				addNeighbour({x - 1, y});
+			if (x < width - 1)
+				addNeighbour({x + 1, y});
+			if (y > 0)
+				addNeighbour({x, y - 1});
+			if (y < height - 1)
+				addNeighbour({x, y + 1});
+
+			std::sort(std::next(std::begin(_neuronNeighbours), first), std::end(_neuronNeighbours),
+					[](const NeuronNeighbour& a, const NeuronNeighbour& b) { return a.distance < b.distance; });
+
+			_neuronNeighbourOffsets.push_back(_neuronNeighbours.size());
+		}
+	}
+}
+
 } // ns Recommendation
@@ -20,14 +20,19 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <unordered_map>
 #include <optional>
+#include <queue>
 #include <string>
+#include <tuple>
+#include <unordered_set>
 #include <vector>
 
 #include "som/DataNormalizer.hpp"
 #include "som/Network.hpp"
+#include "som/QuantizedNetwork.hpp"
 #include "utils/Utils.hpp"
 #include "IEngine.hpp"
 #include "FeaturesEngineCache.hpp"
@@ -64,22 +69,32 @@ class FeaturesEngine : public IEngine
 		ArtistContainer getSimilarArtists(Database::ArtistId artistId, EnumSet<Database::TrackArtistLinkType> linkTypes, std::size_t maxCount) const override;
 
 		void loadFromCache(FeaturesEngineCache cache);
+		// Only classifies the tracks that are not in the cache
+		// Returns false if a full training is needed (too many changes, no training info)
+		bool loadFromCacheIncrementally(FeaturesEngineCache cache, unsigned long maxChangedPercent);
 
 		// Use training (may be very slow)
 		struct TrainSettings
 		{
 			std::size_t iterationCount {10};
 			float sampleCountPerNeuron {4};
+			bool batchTraining {};			// online training otherwise
+			std::size_t batchTrainingThreadCount {1};
 			FeatureSettingsMap featureSettingsMap;
 		};
 		void loadFromTraining(const TrainSettings& trainSettings, const ProgressCallback& progressCallback);
 
+		using TrackPositions = std::unordered_map<Database::TrackId, std::vector<SOM::Position>>;
+
+		// Compact version of the positions: neuron index is x + y * width
+		// (16 bits would limit the network to 256*256 neurons, which is reached by large libraries)
+		using NeuronIndex = std::uint32_t;
 		template <typename IdType>
-		using ObjectPositions = std::unordered_map<IdType, std::vector<SOM::Position>>;
+		using ObjectNeurons = std::unordered_map<IdType, std::vector<NeuronIndex>>;
 
-		using ArtistPositions = ObjectPositions<Database::ArtistId>;
-		using ReleasePositions = ObjectPositions<Database::ReleaseId>;
-		using TrackPositions = ObjectPositions<Database::TrackId>;
+		using ArtistNeurons = ObjectNeurons<Database::ArtistId>;
+		using ReleaseNeurons = ObjectNeurons<Database::ReleaseId>;
+		using TrackNeurons = ObjectNeurons<Database::TrackId>;
 
 		template <typename IdType>
 		using ObjectMatrix = SOM::Matrix<std::vector<IdType>>;
@@ -87,116 +102,197 @@ class FeaturesEngine : public IEngine
 		using ReleaseMatrix = ObjectMatrix<Database::ReleaseId>;
 		using TrackMatrix = ObjectMatrix<Database::TrackId>;
 
+		// Compact version of an object matrix: ids of neuron i are ids[offsets[i]] to ids[offsets[i + 1]]
+		// Neuron index is x + y * width
+		template <typename IdType>
+		struct ObjectIndex
+		{
+			std::vector<std::size_t>	offsets;
+			std::vector<IdType>			ids;
+		};
+		using ArtistIndex = ObjectIndex<Database::ArtistId>;
+		using ReleaseIndex = ObjectIndex<Database::ReleaseId>;
+		using TrackIndex = ObjectIndex<Database::TrackId>;
+
+		// Most similar objects of each object, most similar first
+		template <typename IdType>
+		struct SimilarityTable
+		{
+			std::unordered_map<IdType, std::size_t>	indexes;	// similar ids are similarIds[offsets[index]] to similarIds[offsets[index + 1]]
+			std::vector<std::size_t>				offsets;
+			std::vector<IdType>						similarIds;
+		};
+		using ArtistSimilarityTable = SimilarityTable<Database::ArtistId>;
+		using ReleaseSimilarityTable = SimilarityTable<Database::ReleaseId>;
+
+		struct NeuronNeighbour
+		{
+			std::size_t				neuronIndex;
+			SOM::InputVector::Distance	distance;	// between ref vectors
+		};
+
 		void load(const SOM::Network& network, const TrackPositions& tracksPosition);
+		void computeNeuronNeighbours(const SOM::Network& network);
+
+		void computeSimilarityTables(std::size_t similarCount, std::size_t threadCount);
 
 		FeaturesEngineCache toCache() const;
 
 		template <typename IdType>
-		static std::vector<SOM::Position> getMatchingRefVectorsPosition(const std::vector<IdType>& ids, const ObjectPositions<IdType>& objectPositions);
+		static ObjectIndex<IdType> createObjectIndex(const ObjectMatrix<IdType>& objectMatrix);
 
 		template <typename IdType>
-		static std::vector<IdType> getObjectsIds(const std::vector<SOM::Position>& positions, const ObjectMatrix<IdType>& objectsMatrix);
+		std::vector<IdType> getSimilarObjects(const std::vector<IdType>& ids,
+				const ObjectIndex<IdType>& objectIndex,
+				const ObjectNeurons<IdType>& objectNeurons,
+				std::size_t maxCount) const;
 
 		template <typename IdType>
-		std::vector<IdType> getSimilarObjects(const std::vector<IdType>& ids,
-				const ObjectMatrix<IdType>& objectMatrix,
-				const ObjectPositions<IdType>& objectPositions,
+		SimilarityTable<IdType> computeSimilarityTable(const ObjectIndex<IdType>& objectIndex,
+				const ObjectNeurons<IdType>& objectNeurons,
+				std::size_t similarCount,
+				std::size_t threadCount) const;
+
+		// Served from the similarity table if it has enough entries
+		template <typename IdType>
+		std::vector<IdType> getSimilarObjects(IdType id,
+				const SimilarityTable<IdType>& similarityTable,
+				const ObjectIndex<IdType>& objectIndex,
+				const ObjectNeurons<IdType>& objectNeurons,
 				std::size_t maxCount) const;
 
 		Database::Db&		_db;
 		bool				_loadCancelled {};
+		// Only one of them is set, depending on features-quantized-network
 		std::unique_ptr<SOM::Network>	_network;
+		std::unique_ptr<SOM::QuantizedNetwork>	_quantizedNetwork;
 		double				_networkRefVectorsDistanceMedian {};
+		std::optional<FeaturesEngineCache::TrainingInfo>	_trainingInfo;
 
-		ArtistPositions     _artistPositions;
-		std::unordered_map<Database::TrackArtistLinkType, ArtistMatrix> _artistMatrix;
-
-		ReleasePositions	_releasePositions;
-		ReleaseMatrix		_releaseMatrix;
-
-		TrackPositions		_trackPositions;
-		TrackMatrix			_trackMatrix;
-};
-
-template <typename IdType>
-std::vector<SOM::Position>
-FeaturesEngine::getMatchingRefVectorsPosition(const std::vector<IdType>& ids, const ObjectPositions<IdType>& objectPositions)
-{
-	std::vector<SOM::Position> res;
+		// 4-connected neighbours of each neuron, closest ref vectors first (CSR layout, same as ObjectIndex)
+		std::vector<std::size_t>		_neuronNeighbourOffsets;
+		std::vector<NeuronNeighbour>	_neuronNeighbours;
 
-	if (ids.empty())
-		return res;
+		std::size_t			_similarityTableCount {};
 
-	for (const IdType id : ids)
-	{
-		auto it = objectPositions.find(id);
-		if (it == objectPositions.end())
-			continue;
+		ArtistNeurons		_artistNeurons;
+		std::unordered_map<Database::TrackArtistLinkType, ArtistIndex> _artistIndexes;
+		std::unordered_map<Database::TrackArtistLinkType, ArtistSimilarityTable> _artistSimilarityTables;
 
-		for (const SOM::Position& position : it->second)
-			Utils::push_back_if_not_present(res, position);
-	}
+		ReleaseNeurons		_releaseNeurons;
+		ReleaseIndex		_releaseIndex;
+		ReleaseSimilarityTable	_releaseSimilarityTable;
 
-	return res;
-}
+		TrackNeurons		_trackNeurons;
+		TrackIndex			_trackIndex;
+};
 
 template <typename IdType>
-std::vector<IdType>
-FeaturesEngine::getObjectsIds(const std::vector<SOM::Position>& positions, const ObjectMatrix<IdType>& objectMatrix)
+FeaturesEngine::ObjectIndex<IdType>
+FeaturesEngine::createObjectIndex(const ObjectMatrix<IdType>& objectMatrix)
 {
-	std::vector<IdType> res;
+	ObjectIndex<IdType> res;
 
-	for (const SOM::Position& position : positions)
+	res.offsets.reserve(static_cast<std::size_t>(objectMatrix.getWidth()) * objectMatrix.getHeight() + 1);
+	res.offsets.push_back(0);
+	for (SOM::Coordinate y {}; y < objectMatrix.getHeight(); ++y)
 	{
-		for (const IdType id : objectMatrix.get(position))
-			Utils::push_back_if_not_present(res, id);
+		for (SOM::Coordinate x {}; x < objectMatrix.getWidth(); ++x)
+		{
+			// cells may contain duplicates
+			const std::vector<IdType>& ids {objectMatrix.get({x, y})};
+			const auto first {res.ids.insert(std::end(res.ids), std::cbegin(ids), std::cend(ids))};
+			std::sort(first, std::end(res.ids));
+			res.ids.erase(std::unique(first, std::end(res.ids)), std::end(res.ids));
+			res.offsets.push_back(res.ids.size());
+		}
 	}
 
 	return res;
 }
 
+// Grows a region of neurons from the ones of the requested objects, always picking the neighbour with the closest ref vector,
+// until enough objects are found or until the remaining neighbours are too far
 template <typename IdType>
 std::vector<IdType>
 FeaturesEngine::getSimilarObjects(const std::vector<IdType>& ids,
-		const ObjectMatrix<IdType>& objectMatrix,
-		const ObjectPositions<IdType>& objectPositions,
+		const ObjectIndex<IdType>& objectIndex,
+		const ObjectNeurons<IdType>& objectNeurons,
 		std::size_t maxCount) const
 {
 	std::vector<IdType> res;
 
-	std::vector<SOM::Position> searchedRefVectorsPosition {getMatchingRefVectorsPosition(ids, objectPositions)};
-	if (searchedRefVectorsPosition.empty())
+	if (ids.empty() || maxCount == 0 || objectIndex.offsets.empty())
 		return res;
 
-	while (1)
+	const std::size_t neuronCount {objectIndex.offsets.size() - 1};
+	const SOM::InputVector::Distance maxDistance {_networkRefVectorsDistanceMedian * 0.75};
+
+	// objects that are already in input or already reported
+	std::unordered_set<IdType> reportedIds {std::cbegin(ids), std::cend(ids)};
+	std::vector<bool> visitedNeurons(neuronCount);
+
+	struct Candidate
 	{
-		std::vector<IdType> closestObjectIds {getObjectsIds(searchedRefVectorsPosition, objectMatrix)};
+		SOM::InputVector::Distance	distance;
+		std::size_t				neuronIndex;
+
+		bool operator>(const Candidate& other) const { return std::tie(distance, neuronIndex) > std::tie(other.distance, other.neuronIndex); }
+	};
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
 
-		// Remove objects that are already in input or already reported
-		closestObjectIds.erase(std::remove_if(std::begin(closestObjectIds), std::end(closestObjectIds),
-					[&](IdType id)
-					{
-						return std::find(std::cbegin(ids), std::cend(ids), id) != std::cend(ids);
-					})
-				, std::end(closestObjectIds));
+	// returns true if enough objects have been found
+	auto visitNeuron {[&](std::size_t neuronIndex)
+	{
+		visitedNeurons[neuronIndex] = true;
 
-		for (IdType id : closestObjectIds)
+		for (std::size_t i {objectIndex.offsets[neuronIndex]}; i < objectIndex.offsets[neuronIndex + 1]; ++i)
 		{
+			const IdType id {objectIndex.ids[i]};
+			if (!reportedIds.insert(id).second)
+				continue;
+
+			res.push_back(id);
 			if (res.size() == maxCount)
-				break;
+				return true;
+		}
 
-			Utils::push_back_if_not_present(res, id);
+		for (std::size_t i {_neuronNeighbourOffsets[neuronIndex]}; i < _neuronNeighbourOffsets[neuronIndex + 1]; ++i)
+		{
+			const NeuronNeighbour& neighbour {_neuronNeighbours[i]};
+			if (!visitedNeurons[neighbour.neuronIndex] && neighbour.distance <= maxDistance)
+				candidates.push({neighbour.distance, neighbour.neuronIndex});
 		}
 
-		if (res.size() == maxCount)
-			break;
+		return false;
+	}};
 
-		// If there is not enough objects, try again with closest neighbour until there is too much distance
-		const std::optional<SOM::Position> closestRefVectorPosition {_network->getClosestRefVectorPosition(searchedRefVectorsPosition, _networkRefVectorsDistanceMedian * 0.75)};
-		if (!closestRefVectorPosition)
-			break;
+	for (const IdType id : ids)
+	{
+		auto it {objectNeurons.find(id)};
+		if (it == objectNeurons.end())
+			continue;
+
+		for (const NeuronIndex neuronIndex : it->second)
+		{
+			if (visitedNeurons[neuronIndex])
+				continue;
+
+			if (visitNeuron(neuronIndex))
+				return res;
+		}
+	}
+
+	while (!candidates.empty())
+	{
+		const std::size_t neuronIndex {candidates.top().neuronIndex};
+		candidates.pop();
 
-		Utils::push_back_if_not_present(searchedRefVectorsPosition, closestRefVectorPosition.value());
+		if (visitedNeurons[neuronIndex])
+			continue;
+
+		if (visitNeuron(neuronIndex))
+			break;
 	}
 
 	return res;
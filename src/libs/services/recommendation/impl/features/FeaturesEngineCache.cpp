@@ -19,9 +19,18 @@
 
 #include "FeaturesEngineCache.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 
+#include "utils/Crc32Calculator.hpp"
 #include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Service.hpp"
@@ -35,6 +44,12 @@ std::filesystem::path getCacheDirectory()
 	return Service<IConfig>::get()->getPath("working-dir") / "cache" / "features";
 }
 
+static std::filesystem::path getCacheFilePath()
+{
+	return getCacheDirectory() / "features.bin";
+}
+
+// Legacy XML files, only read to migrate existing caches
 static std::filesystem::path getCacheNetworkFilePath()
 {
 	return getCacheDirectory() / "network";
@@ -45,48 +60,9 @@ static std::filesystem::path getCacheTrackPositionsFilePath()
 	return getCacheDirectory() / "track_positions";
 }
 
-static
-bool
-networkToCacheFile(const SOM::Network& network, std::filesystem::path path)
+static std::filesystem::path getCacheTrainingInfoFilePath()
 {
-	try
-	{
-		boost::property_tree::ptree root;
-
-		root.put("width", network.getWidth());
-		root.put("height", network.getHeight());
-		root.put("dim_count", network.getInputDimCount());
-
-		for (SOM::InputVector::value_type weight : network.getDataWeights())
-			root.add("weights.weight", weight);
-
-		for (SOM::Coordinate x = 0; x < network.getWidth(); ++x)
-		{
-			for (SOM::Coordinate y = 0; y < network.getWidth(); ++y)
-			{
-				const auto& refVector = network.getRefVector({x, y});
-
-				boost::property_tree::ptree node;
-				for (auto value : refVector)
-					node.add("values.value", value);
-
-				node.put("coord_x", x);
-				node.put("coord_y", y);
-
-				root.add_child("ref_vectors.ref_vector", node);
-			}
-		}
-
-		boost::property_tree::write_xml(path.string(), root);
-
-		LMS_LOG(RECOMMENDATION, DEBUG) << "Created network cache";
-		return true;
-	}
-	catch (boost::property_tree::ptree_error& error)
-	{
-		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot create network cache: " << error.what();
-		return false;
-	}
+	return getCacheDirectory() / "training_info";
 }
 
 std::optional<SOM::Network>
@@ -142,86 +118,359 @@ FeaturesEngineCache::createNetworkFromCacheFile(const std::filesystem::path& pat
 	}
 }
 
-bool
-FeaturesEngineCache::objectPositionToCacheFile(const TrackPositions& trackPositions, const std::filesystem::path& path)
+std::optional<FeaturesEngineCache::TrackPositions>
+FeaturesEngineCache::createObjectPositionsFromCacheFile(const std::filesystem::path& path)
 {
 	try
 	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Reading object position from cache...";
+
 		boost::property_tree::ptree root;
 
-		for (const auto& [id, positions] : trackPositions)
-		{
-			boost::property_tree::ptree node;
+		boost::property_tree::read_xml(path.string(), root);
 
-			node.put("id", id.getValue());
+		TrackPositions res;
 
-			for (const SOM::Position& position : positions)
+		for (const auto& object : root.get_child("objects"))
+		{
+			const Database::TrackId id {object.second.get<Database::IdType::ValueType>("id")};
+			for (const auto& position : object.second.get_child("position"))
 			{
-				boost::property_tree::ptree positionNode;
-				positionNode.put("x", position.x);
-				positionNode.put("y", position.y);
+				auto x = position.second.get<SOM::Coordinate>("x");
+				auto y = position.second.get<SOM::Coordinate>("y");
 
-				node.add_child("position.position", positionNode);
+				res[id].push_back({x, y});
 			}
-
-			root.add_child("objects.object", node);
 		}
 
-		boost::property_tree::write_xml(path.string(), root);
-		return true;
+		LMS_LOG(RECOMMENDATION, INFO) << "Successfully read object position from cache";
+
+		return res;
 	}
 	catch (boost::property_tree::ptree_error& error)
 	{
-		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot cache object position: " << error.what();
-		return false;
+		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot create object position from cache file: " << error.what();
+		return std::nullopt;
 	}
 }
 
-std::optional<FeaturesEngineCache::TrackPositions>
-FeaturesEngineCache::createObjectPositionsFromCacheFile(const std::filesystem::path& path)
+std::optional<FeaturesEngineCache::TrainingInfo>
+FeaturesEngineCache::createTrainingInfoFromCacheFile(const std::filesystem::path& path)
 {
+	if (!std::filesystem::exists(path))
+		return std::nullopt;
+
 	try
 	{
-		LMS_LOG(RECOMMENDATION, INFO) << "Reading object position from cache...";
-
 		boost::property_tree::ptree root;
 
 		boost::property_tree::read_xml(path.string(), root);
 
-		TrackPositions res;
+		const boost::property_tree::ptree& normalizationNode {root.get_child("normalization")};
 
-		for (const auto& object : root.get_child("objects"))
+		SOM::DataNormalizer dataNormalizer {normalizationNode.size()};
+		std::size_t i {};
+		for (const auto& dim : normalizationNode)
+			dataNormalizer.setValue(i++, {dim.second.get<SOM::InputVector::value_type>("min"), dim.second.get<SOM::InputVector::value_type>("max")});
+
+		return TrainingInfo {std::move(dataNormalizer), root.get<std::size_t>("updated_track_count")};
+	}
+	catch (boost::property_tree::ptree_error& error)
+	{
+		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read training info from cache file: " << error.what();
+		return std::nullopt;
+	}
+}
+
+namespace
+{
+	// Binary cache layout, all values in host byte order:
+	// - header
+	// - weights: dimCount doubles
+	// - ref vectors: width * height * dimCount doubles, row major
+	// - normalization min/max: 2 * dimCount doubles (only if hasTrainingInfo)
+	// - track positions: trackPositionCount entries, sorted by track id
+	// The checksum covers everything after the header
+	constexpr char binaryMagic[8] {'L', 'M', 'S', 'F', 'E', 'A', 'T', 'C'};
+	constexpr std::uint32_t binaryVersion {1};
+
+	struct BinaryHeader
+	{
+		char			magic[8];
+		std::uint32_t	version;
+		std::uint32_t	width;
+		std::uint32_t	height;
+		std::uint32_t	dimCount;
+		std::uint32_t	hasTrainingInfo;
+		std::uint32_t	checksum;
+		std::uint64_t	updatedTrackCount;
+		std::uint64_t	trackPositionCount;
+	};
+	static_assert(std::is_trivially_copyable_v<BinaryHeader>);
+	static_assert(sizeof(BinaryHeader) % alignof(double) == 0);
+
+	struct BinaryTrackPosition
+	{
+		Database::IdType::ValueType	trackId;
+		std::uint32_t				x;
+		std::uint32_t				y;
+	};
+	static_assert(std::is_trivially_copyable_v<BinaryTrackPosition>);
+	static_assert(sizeof(BinaryTrackPosition) % alignof(double) == 0);
+
+	using Value = SOM::InputVector::value_type;
+	static_assert(std::is_same_v<Value, double>);
+
+	class ChecksumWriter
+	{
+		public:
+			ChecksumWriter(std::ofstream& ofs) : _ofs {ofs} {}
+
+			template <typename T>
+			void write(const T* data, std::size_t count)
+			{
+				const std::byte* bytes {reinterpret_cast<const std::byte*>(data)};
+				_crc.processBytes(bytes, count * sizeof(T));
+				_ofs.write(reinterpret_cast<const char*>(bytes), count * sizeof(T));
+			}
+
+			std::uint32_t getChecksum() const { return _crc.getResult(); }
+
+		private:
+			std::ofstream& _ofs;
+			Utils::Crc32Calculator _crc;
+	};
+}
+
+std::optional<FeaturesEngineCache>
+FeaturesEngineCache::readBinary(const std::filesystem::path& path)
+{
+	std::error_code ec;
+	const std::uintmax_t fileSize {std::filesystem::file_size(path, ec)};
+	if (ec)
+		return std::nullopt;
+
+	if (fileSize < sizeof(BinaryHeader))
+	{
+		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read features cache: file too small";
+		return std::nullopt;
+	}
+
+	try
+	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Reading features cache...";
+
+		const boost::interprocess::file_mapping mapping {path.c_str(), boost::interprocess::read_only};
+		const boost::interprocess::mapped_region region {mapping, boost::interprocess::read_only};
+		const std::byte* data {static_cast<const std::byte*>(region.get_address())};
+
+		BinaryHeader header;
+		std::memcpy(&header, data, sizeof(header));
+
+		if (std::memcmp(header.magic, binaryMagic, sizeof(binaryMagic)) != 0 || header.version != binaryVersion)
 		{
-			const Database::TrackId id {object.second.get<Database::IdType::ValueType>("id")};
-			for (const auto& position : object.second.get_child("position"))
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read features cache: unhandled format";
+			return std::nullopt;
+		}
+
+		const std::uint64_t dimCount {header.dimCount};
+		const std::uint64_t refVectorCount {static_cast<std::uint64_t>(header.width) * header.height};
+		const std::uint64_t valueCount {dimCount + refVectorCount * dimCount + (header.hasTrainingInfo ? 2 * dimCount : 0)};
+		const std::uint64_t expectedSize {sizeof(BinaryHeader) + valueCount * sizeof(Value) + header.trackPositionCount * sizeof(BinaryTrackPosition)};
+		if (header.width == 0 || header.height == 0 || dimCount == 0 || fileSize != expectedSize)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read features cache: bad size";
+			return std::nullopt;
+		}
+
+		{
+			Utils::Crc32Calculator crc;
+			crc.processBytes(data + sizeof(BinaryHeader), fileSize - sizeof(BinaryHeader));
+			if (crc.getResult() != header.checksum)
 			{
-				auto x = position.second.get<SOM::Coordinate>("x");
-				auto y = position.second.get<SOM::Coordinate>("y");
+				LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read features cache: bad checksum";
+				return std::nullopt;
+			}
+		}
 
-				res[id].push_back({x, y});
+		// sections are aligned: mappings start on page boundaries and section sizes are multiples of 8
+		const Value* values {reinterpret_cast<const Value*>(data + sizeof(BinaryHeader))};
+
+		SOM::Network network {header.width, header.height, dimCount};
+		{
+			SOM::InputVector weights {dimCount};
+			std::copy(values, values + dimCount, std::begin(weights));
+			network.setDataWeights(weights);
+			values += dimCount;
+
+			SOM::InputVector refVector {dimCount};
+			for (SOM::Coordinate y {}; y < header.height; ++y)
+			{
+				for (SOM::Coordinate x {}; x < header.width; ++x)
+				{
+					std::copy(values, values + dimCount, std::begin(refVector));
+					network.setRefVector({x, y}, refVector);
+					values += dimCount;
+				}
 			}
 		}
 
-		LMS_LOG(RECOMMENDATION, INFO) << "Successfully read object position from cache";
+		std::optional<TrainingInfo> trainingInfo;
+		if (header.hasTrainingInfo)
+		{
+			SOM::DataNormalizer dataNormalizer {dimCount};
+			for (std::size_t i {}; i < dimCount; ++i)
+				dataNormalizer.setValue(i, {values[2 * i], values[2 * i + 1]});
+			values += 2 * dimCount;
 
-		return res;
+			trainingInfo.emplace(TrainingInfo {std::move(dataNormalizer), header.updatedTrackCount});
+		}
+
+		TrackPositions trackPositions;
+		trackPositions.reserve(header.trackPositionCount);
+
+		const BinaryTrackPosition* binaryTrackPositions {reinterpret_cast<const BinaryTrackPosition*>(values)};
+		for (std::size_t i {}; i < header.trackPositionCount; ++i)
+		{
+			const BinaryTrackPosition& binaryTrackPosition {binaryTrackPositions[i]};
+			if (binaryTrackPosition.x >= header.width || binaryTrackPosition.y >= header.height)
+			{
+				LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read features cache: bad position";
+				return std::nullopt;
+			}
+
+			trackPositions[binaryTrackPosition.trackId].push_back({binaryTrackPosition.x, binaryTrackPosition.y});
+		}
+
+		LMS_LOG(RECOMMENDATION, INFO) << "Successfully read features cache";
+
+		return FeaturesEngineCache {std::move(network), std::move(trackPositions), std::move(trainingInfo)};
 	}
-	catch (boost::property_tree::ptree_error& error)
+	catch (const boost::interprocess::interprocess_exception& e)
 	{
-		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot create object position from cache file: " << error.what();
+		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot map features cache: " << e.what();
 		return std::nullopt;
 	}
 }
 
+bool
+FeaturesEngineCache::writeBinary(const std::filesystem::path& path) const
+{
+	std::vector<BinaryTrackPosition> binaryTrackPositions;
+	for (const auto& [trackId, positions] : _trackPositions)
+	{
+		for (const SOM::Position& position : positions)
+			binaryTrackPositions.push_back({trackId.getValue(), position.x, position.y});
+	}
+	// keep the position order of each track
+	std::stable_sort(std::begin(binaryTrackPositions), std::end(binaryTrackPositions), [](const BinaryTrackPosition& a, const BinaryTrackPosition& b)
+	{
+		return a.trackId < b.trackId;
+	});
+
+	BinaryHeader header {};
+	std::memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+	header.version = binaryVersion;
+	header.width = _network.getWidth();
+	header.height = _network.getHeight();
+	header.dimCount = _network.getInputDimCount();
+	header.hasTrainingInfo = _trainingInfo ? 1 : 0;
+	header.updatedTrackCount = _trainingInfo ? _trainingInfo->updatedTrackCount : 0;
+	header.trackPositionCount = binaryTrackPositions.size();
+
+	// write in a temporary file first so that an interrupted write does not leave a corrupted cache
+	std::filesystem::path tmpPath {path};
+	tmpPath += ".tmp";
+
+	{
+		std::ofstream ofs {tmpPath, std::ios::out | std::ios::binary | std::ios::trunc};
+		if (!ofs)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot create features cache file '" << tmpPath.string() << "'";
+			return false;
+		}
+
+		// header is written again once the checksum is known
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		ChecksumWriter writer {ofs};
+		writer.write(_network.getDataWeights().data(), header.dimCount);
+		for (SOM::Coordinate y {}; y < header.height; ++y)
+		{
+			for (SOM::Coordinate x {}; x < header.width; ++x)
+				writer.write(_network.getRefVector({x, y}).data(), header.dimCount);
+		}
+
+		if (_trainingInfo)
+		{
+			for (std::size_t i {}; i < header.dimCount; ++i)
+			{
+				const SOM::DataNormalizer::MinMax& minMax {_trainingInfo->dataNormalizer.getValue(i)};
+				const Value values[] {minMax.min, minMax.max};
+				writer.write(values, 2);
+			}
+		}
+		writer.write(binaryTrackPositions.data(), binaryTrackPositions.size());
+
+		header.checksum = writer.getChecksum();
+		ofs.seekp(0);
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		if (!ofs)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot write features cache file '" << tmpPath.string() << "'";
+			ofs.close();
+			std::filesystem::remove(tmpPath);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec)
+	{
+		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot rename features cache file: " << ec.message();
+		std::filesystem::remove(tmpPath, ec);
+		return false;
+	}
+
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Created features cache";
+	return true;
+}
+
 void
 FeaturesEngineCache::invalidate()
+{
+	std::filesystem::remove(getCacheFilePath());
+	removeLegacyFiles();
+}
+
+void
+FeaturesEngineCache::removeLegacyFiles()
 {
 	std::filesystem::remove(getCacheNetworkFilePath());
 	std::filesystem::remove(getCacheTrackPositionsFilePath());
+	std::filesystem::remove(getCacheTrainingInfoFilePath());
 }
 
 std::optional<FeaturesEngineCache>
 FeaturesEngineCache::read()
+{
+	if (std::filesystem::exists(getCacheFilePath()))
+		return readBinary(getCacheFilePath());
+
+	std::optional<FeaturesEngineCache> cache {readLegacy()};
+	if (cache)
+	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Migrating features cache to the binary format";
+		cache->write();
+	}
+
+	return cache;
+}
+
+std::optional<FeaturesEngineCache>
+FeaturesEngineCache::readLegacy()
 {
 	auto network{createNetworkFromCacheFile(getCacheNetworkFilePath())};
 	if (!network)
@@ -231,24 +480,27 @@ FeaturesEngineCache::read()
 	if (!trackPositions)
 		return std::nullopt;
 
-	return FeaturesEngineCache {std::move(*network), std::move(*trackPositions)};
+	return FeaturesEngineCache {std::move(*network), std::move(*trackPositions), createTrainingInfoFromCacheFile(getCacheTrainingInfoFilePath())};
 }
 
 void
 FeaturesEngineCache::write() const
 {
-	std::filesystem::create_directories(Service<IConfig>::get()->getPath("working-dir") / "cache" / "features");
+	std::filesystem::create_directories(getCacheDirectory());
 
-	if (!networkToCacheFile(_network, getCacheNetworkFilePath())
-		|| !objectPositionToCacheFile(_trackPositions, getCacheTrackPositionsFilePath()))
+	if (!writeBinary(getCacheFilePath()))
 	{
 		invalidate();
+		return;
 	}
+
+	removeLegacyFiles();
 }
 
-FeaturesEngineCache::FeaturesEngineCache(SOM::Network network, TrackPositions trackPositions)
+FeaturesEngineCache::FeaturesEngineCache(SOM::Network network, TrackPositions trackPositions, std::optional<TrainingInfo> trainingInfo)
 : _network {std::move(network)},
-_trackPositions {std::move(trackPositions)}
+_trackPositions {std::move(trackPositions)},
+_trainingInfo {std::move(trainingInfo)}
 {
 }
 
@@ -20,9 +20,11 @@
 #pragma once
 
 #include <filesystem>
+#include <optional>
 #include <unordered_map>
 
 #include "services/database/TrackId.hpp"
+#include "som/DataNormalizer.hpp"
 #include "som/Network.hpp"
 
 namespace Recommendation {
@@ -38,16 +40,30 @@ class FeaturesEngineCache
 	private:
 		using TrackPositions = std::unordered_map<Database::TrackId, std::vector<SOM::Position>>;
 
-		FeaturesEngineCache(SOM::Network network, TrackPositions trackPositions);
+		struct TrainingInfo
+		{
+			SOM::DataNormalizer	dataNormalizer;
+			std::size_t			updatedTrackCount {};	// tracks added or removed since the network was trained
+		};
 
+		FeaturesEngineCache(SOM::Network network, TrackPositions trackPositions, std::optional<TrainingInfo> trainingInfo);
+
+		// versioned, checksummed binary file, read using a memory mapping
+		static std::optional<FeaturesEngineCache> readBinary(const std::filesystem::path& path);
+		bool writeBinary(const std::filesystem::path& path) const;
+
+		// legacy XML files, only read to migrate existing caches
+		static std::optional<FeaturesEngineCache> readLegacy();
+		static void removeLegacyFiles();
 		static std::optional<SOM::Network> createNetworkFromCacheFile(const std::filesystem::path& path);
 		static std::optional<TrackPositions> createObjectPositionsFromCacheFile(const std::filesystem::path& path);
-		static bool objectPositionToCacheFile(const TrackPositions& trackPositions, const std::filesystem::path& path);
+		static std::optional<TrainingInfo> createTrainingInfoFromCacheFile(const std::filesystem::path& path);
 
 		friend class FeaturesEngine;
 
 		SOM::Network		_network;
 		TrackPositions		_trackPositions;
+		std::optional<TrainingInfo>	_trainingInfo;	// needed to update the positions incrementally, not set by old caches
 };
 
 } // namespace Recommendation
@@ -0,0 +1,506 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HnswEngine.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+#include "services/database/Artist.hpp"
+#include "services/database/Db.hpp"
+#include "services/database/Release.hpp"
+#include "services/database/Session.hpp"
+#include "services/database/Track.hpp"
+#include "services/database/TrackFeatures.hpp"
+#include "services/database/TrackList.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Service.hpp"
+#include "features/FeaturesEngine.hpp"
+
+namespace Recommendation {
+
+using namespace Database;
+
+std::unique_ptr<IEngine> createHnswEngine(Db& db)
+{
+	return std::make_unique<HnswEngine>(db);
+}
+
+namespace
+{
+	// releases and artists are found using the neighbours of their tracks
+	constexpr std::size_t neighbourCountPerResult {4};
+
+	HnswIndex::Settings
+	getIndexSettings()
+	{
+		HnswIndex::Settings settings;
+		settings.maxConnectionCount = std::max<unsigned long>(2, Service<IConfig>::get()->getULong("hnsw-max-connection-count", 16));
+		settings.efConstruction = std::max<unsigned long>(settings.maxConnectionCount, Service<IConfig>::get()->getULong("hnsw-ef-construction", 128));
+
+		return settings;
+	}
+
+	template <typename ObjectType, typename IdType>
+	void
+	eraseNonExistingIds(Session& session, std::vector<IdType>& ids)
+	{
+		if (ids.empty())
+			return;
+
+		// Report only existing ids, as the index may be a bit late
+		auto transaction {session.createSharedTransaction()};
+
+		ids.erase(std::remove_if(std::begin(ids), std::end(ids),
+			[&](IdType id)
+			{
+				return !ObjectType::exists(session, id);
+			}), std::end(ids));
+	}
+}
+
+void
+HnswEngine::load(bool forceReload, const ProgressCallback& progressCallback)
+{
+	const FeatureSettingsMap& featureSettings {FeaturesEngine::getDefaultTrainFeatureSettings()};
+
+	_featureNames.clear();
+	for (const auto& [featureName, settings] : featureSettings)
+		_featureNames.push_back(featureName);
+	std::sort(std::begin(_featureNames), std::end(_featureNames));
+
+	// the features have the same global weight, whatever their dimension count
+	_featureWeights.clear();
+	for (const FeatureName& featureName : _featureNames)
+	{
+		const std::size_t featureDimCount {getFeatureDef(featureName).nbDimensions};
+		const double weight {featureSettings.at(featureName).weight / featureDimCount};
+
+		_featureWeights.insert(std::end(_featureWeights), featureDimCount, static_cast<HnswIndex::Value>(std::sqrt(weight)));
+	}
+
+	_efSearch = Service<IConfig>::get()->getULong("hnsw-ef-search", 64);
+
+	std::optional<HnswEngineCache> cache {HnswEngineCache::read()};
+	if (cache && (cache->_index.getDimCount() != _featureWeights.size() || cache->_dataNormalizer.getInputDimCount() != _featureWeights.size()))
+	{
+		LMS_LOG(RECOMMENDATION, DEBUG) << "Features dimension changed, cannot use cache";
+		cache.reset();
+	}
+
+	bool indexUpdated {true};
+	if (!forceReload && cache)
+	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Loading HNSW index from cache...";
+
+		_index = std::make_unique<HnswIndex>(std::move(cache->_index));
+		_dataNormalizer.emplace(std::move(cache->_dataNormalizer));
+		_updatedTrackCount = cache->_updatedTrackCount;
+		indexUpdated = false;
+	}
+	else
+	{
+		// 0 means always build again
+		const unsigned long maxChangedPercent {Service<IConfig>::get()->getULong("hnsw-incremental-update-max-changed-percent", 20)};
+		if (!cache || maxChangedPercent == 0 || !loadFromCacheIncrementally(std::move(*cache), maxChangedPercent))
+		{
+			HnswEngineCache::invalidate();
+			build(progressCallback);
+		}
+	}
+
+	if (_loadCancelled || !_index)
+		return;
+
+	if (indexUpdated)
+		HnswEngineCache::write(*_index, *_dataNormalizer, _updatedTrackCount);
+
+	loadLinks();
+	if (_loadCancelled)
+		return;
+
+	LMS_LOG(RECOMMENDATION, INFO) << "HNSW index successfully loaded: " << (_index->getNodeCount() - _index->getDeletedCount()) << " tracks";
+}
+
+void
+HnswEngine::requestCancelLoad()
+{
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Requesting init cancellation";
+	_loadCancelled = true;
+}
+
+std::optional<std::vector<HnswIndex::Value>>
+HnswEngine::createVector(const FeatureValuesMap& featureValuesMap) const
+{
+	std::vector<HnswIndex::Value> res;
+	res.reserve(_featureWeights.size());
+
+	for (const FeatureName& featureName : _featureNames)
+	{
+		const auto itValues {featureValuesMap.find(featureName)};
+		const std::size_t expectedDimCount {getFeatureDef(featureName).nbDimensions};
+		if (itValues == std::cend(featureValuesMap) || itValues->second.size() != expectedDimCount)
+		{
+			LMS_LOG(RECOMMENDATION, WARNING) << "Dimension mismatch for feature '" << featureName << "'. Expected " << expectedDimCount << ", got " << (itValues == std::cend(featureValuesMap) ? 0 : itValues->second.size());
+			return std::nullopt;
+		}
+
+		res.insert(std::end(res), std::cbegin(itValues->second), std::cend(itValues->second));
+	}
+
+	return res;
+}
+
+namespace
+{
+	// normalized values, weighted so that the squared euclidean distance between two vectors is the weighted distance
+	std::vector<HnswIndex::Value>
+	toIndexVector(const SOM::DataNormalizer& dataNormalizer, const std::vector<HnswIndex::Value>& featureWeights, const std::vector<HnswIndex::Value>& values)
+	{
+		SOM::InputVector inputVector {values.size()};
+		for (std::size_t i {}; i < values.size(); ++i)
+			inputVector[i] = values[i];
+
+		dataNormalizer.normalizeData(inputVector);
+
+		std::vector<HnswIndex::Value> res(values.size());
+		for (std::size_t i {}; i < values.size(); ++i)
+			res[i] = static_cast<HnswIndex::Value>(inputVector[i]) * featureWeights[i];
+
+		return res;
+	}
+}
+
+void
+HnswEngine::build(const ProgressCallback& progressCallback)
+{
+	LMS_LOG(RECOMMENDATION, INFO) << "Building HNSW index...";
+
+	const std::size_t dimCount {_featureWeights.size()};
+	const FeatureNames featureNames {std::cbegin(_featureNames), std::cend(_featureNames)};
+
+	Session& session {_db.getTLSSession()};
+
+	std::vector<SOM::InputVector> samples;
+	std::vector<TrackId> samplesTrackIds;
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const std::size_t trackFeaturesCount {TrackFeatures::getCount(session)};
+		samples.reserve(trackFeaturesCount);
+		samplesTrackIds.reserve(trackFeaturesCount);
+
+		TrackFeatures::visitFeatureValuesMaps(session, featureNames, [&](TrackId trackId, const FeatureValuesMap& featureValuesMap)
+		{
+			const std::optional<std::vector<HnswIndex::Value>> values {createVector(featureValuesMap)};
+			if (!values)
+				return;
+
+			SOM::InputVector& sample {samples.emplace_back(dimCount)};
+			for (std::size_t i {}; i < dimCount; ++i)
+				sample[i] = (*values)[i];
+			samplesTrackIds.push_back(trackId);
+		});
+	}
+
+	if (_loadCancelled)
+		return;
+
+	if (samples.empty())
+	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Nothing to index!";
+		return;
+	}
+
+	SOM::DataNormalizer dataNormalizer {dimCount};
+	dataNormalizer.computeNormalizationFactors(samples);
+	dataNormalizer.normalizeData(samples);
+
+	auto index {std::make_unique<HnswIndex>(dimCount, getIndexSettings())};
+
+	std::vector<HnswIndex::Value> vector(dimCount);
+	const std::size_t progressStep {std::max<std::size_t>(1, samples.size() / 100)};
+	for (std::size_t sampleIndex {}; sampleIndex < samples.size(); ++sampleIndex)
+	{
+		if (_loadCancelled)
+			return;
+
+		for (std::size_t i {}; i < dimCount; ++i)
+			vector[i] = static_cast<HnswIndex::Value>(samples[sampleIndex][i]) * _featureWeights[i];
+
+		index->insert(samplesTrackIds[sampleIndex].getValue(), vector.data());
+
+		if (progressCallback && (sampleIndex % progressStep == 0))
+			progressCallback(Progress {samples.size(), sampleIndex});
+	}
+
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Indexed " << samples.size() << " tracks";
+
+	_index = std::move(index);
+	_dataNormalizer.emplace(std::move(dataNormalizer));
+	_updatedTrackCount = 0;
+}
+
+bool
+HnswEngine::loadFromCacheIncrementally(HnswEngineCache cache, std::size_t maxChangedPercent)
+{
+	Session& session {_db.getTLSSession()};
+
+	std::unordered_set<TrackId> trackIds;
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const RangeResults<TrackId> trackIdResults {TrackFeatures::findTrackIds(session, Range {})};
+		trackIds.insert(std::cbegin(trackIdResults.results), std::cend(trackIdResults.results));
+	}
+
+	if (trackIds.empty())
+		return false;
+
+	HnswIndex& index {cache._index};
+
+	std::vector<HnswIndex::Label> removedLabels;
+	index.visitLabels([&](HnswIndex::Label label)
+	{
+		if (trackIds.find(TrackId {label}) == std::cend(trackIds))
+			removedLabels.push_back(label);
+	});
+
+	std::vector<TrackId> addedTrackIds;
+	for (const TrackId trackId : trackIds)
+	{
+		if (!index.contains(trackId.getValue()))
+			addedTrackIds.push_back(trackId);
+	}
+
+	// changes are accumulated across updates: the removed nodes are still in the graph and the normalization factors are getting old
+	const std::size_t updatedTrackCount {cache._updatedTrackCount + removedLabels.size() + addedTrackIds.size()};
+	if (updatedTrackCount * 100 > maxChangedPercent * trackIds.size())
+	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Too many tracks changed since the last build (" << updatedTrackCount << "/" << trackIds.size() << "), a new build is needed";
+		return false;
+	}
+
+	LMS_LOG(RECOMMENDATION, INFO) << "Updating HNSW index from cache: " << addedTrackIds.size() << " added, " << removedLabels.size() << " removed tracks...";
+
+	for (const HnswIndex::Label label : removedLabels)
+		index.remove(label);
+
+	const FeatureNames featureNames {std::cbegin(_featureNames), std::cend(_featureNames)};
+	for (const TrackId trackId : addedTrackIds)
+	{
+		if (_loadCancelled)
+			return true;
+
+		std::optional<std::vector<HnswIndex::Value>> values;
+		{
+			auto transaction {session.createSharedTransaction()};
+
+			const TrackFeatures::pointer trackFeatures {TrackFeatures::find(session, trackId)};
+			if (!trackFeatures)
+				continue;
+
+			values = createVector(trackFeatures->getFeatureValuesMap(featureNames));
+		}
+
+		if (!values)
+			continue;
+
+		index.insert(trackId.getValue(), toIndexVector(cache._dataNormalizer, _featureWeights, *values).data());
+	}
+
+	_index = std::make_unique<HnswIndex>(std::move(index));
+	_dataNormalizer.emplace(std::move(cache._dataNormalizer));
+	_updatedTrackCount = updatedTrackCount;
+
+	return true;
+}
+
+void
+HnswEngine::loadLinks()
+{
+	Session& session {_db.getTLSSession()};
+
+	auto transaction {session.createSharedTransaction()};
+
+	Track::visitReleaseLinks(session, [&](TrackId trackId, ReleaseId releaseId)
+	{
+		_trackReleases.emplace(trackId, releaseId);
+		_releaseTracks[releaseId].push_back(trackId);
+	});
+
+	if (_loadCancelled)
+		return;
+
+	Track::visitArtistLinks(session, [&](TrackId trackId, ArtistId artistId, TrackArtistLinkType linkType)
+	{
+		_trackArtistLinks[trackId].push_back({artistId, linkType});
+		_artistTracks[artistId].push_back(trackId);
+	});
+
+	// artists may be linked several times to the same track
+	for (auto& [artistId, trackIds] : _artistTracks)
+	{
+		std::sort(std::begin(trackIds), std::end(trackIds));
+		trackIds.erase(std::unique(std::begin(trackIds), std::end(trackIds)), std::end(trackIds));
+	}
+}
+
+std::vector<HnswIndex::Neighbour>
+HnswEngine::searchNeighbours(const std::vector<TrackId>& trackIds, std::size_t maxCount) const
+{
+	std::vector<HnswIndex::Neighbour> res;
+	if (!_index || maxCount == 0)
+		return res;
+
+	const std::unordered_set<TrackId> inputTrackIds {std::cbegin(trackIds), std::cend(trackIds)};
+
+	// a track close to any of the input tracks is a good candidate
+	std::unordered_map<HnswIndex::Label, HnswIndex::Value> distances;
+	for (const TrackId trackId : inputTrackIds)
+	{
+		const HnswIndex::Value* vector {_index->getVector(trackId.getValue())};
+		if (!vector)
+			continue;
+
+		const std::size_t count {maxCount + inputTrackIds.size()};
+		for (const HnswIndex::Neighbour& neighbour : _index->search(vector, count, std::max(_efSearch, count)))
+		{
+			if (inputTrackIds.find(TrackId {neighbour.label}) != std::cend(inputTrackIds))
+				continue;
+
+			const auto [it, inserted] {distances.try_emplace(neighbour.label, neighbour.distance)};
+			if (!inserted)
+				it->second = std::min(it->second, neighbour.distance);
+		}
+	}
+
+	res.reserve(distances.size());
+	for (const auto& [label, distance] : distances)
+		res.push_back({label, distance});
+
+	const std::size_t count {std::min(maxCount, res.size())};
+	std::partial_sort(std::begin(res), std::next(std::begin(res), count), std::end(res),
+			[](const HnswIndex::Neighbour& a, const HnswIndex::Neighbour& b) { return a.distance < b.distance; });
+	res.resize(count);
+
+	return res;
+}
+
+TrackContainer
+HnswEngine::findSimilarTracksFromTrackList(TrackListId trackListId, std::size_t maxCount) const
+{
+	const TrackContainer trackIds {[&]
+	{
+		TrackContainer res;
+
+		Session& session {_db.getTLSSession()};
+
+		auto transaction {session.createSharedTransaction()};
+
+		const TrackList::pointer trackList {TrackList::find(session, trackListId)};
+		if (trackList)
+			res = trackList->getTrackIds();
+
+		return res;
+	}()};
+
+	return findSimilarTracks(trackIds, maxCount);
+}
+
+TrackContainer
+HnswEngine::findSimilarTracks(const std::vector<TrackId>& trackIds, std::size_t maxCount) const
+{
+	TrackContainer res;
+	for (const HnswIndex::Neighbour& neighbour : searchNeighbours(trackIds, maxCount))
+		res.push_back(TrackId {neighbour.label});
+
+	eraseNonExistingIds<Track>(_db.getTLSSession(), res);
+
+	return res;
+}
+
+ReleaseContainer
+HnswEngine::getSimilarReleases(ReleaseId releaseId, std::size_t maxCount) const
+{
+	ReleaseContainer res;
+
+	const auto itTracks {_releaseTracks.find(releaseId)};
+	if (itTracks == std::cend(_releaseTracks))
+		return res;
+
+	// closest tracks first: releases are reported in order of their closest track
+	for (const HnswIndex::Neighbour& neighbour : searchNeighbours(itTracks->second, maxCount * neighbourCountPerResult))
+	{
+		const auto itRelease {_trackReleases.find(TrackId {neighbour.label})};
+		if (itRelease == std::cend(_trackReleases) || itRelease->second == releaseId)
+			continue;
+
+		if (std::find(std::cbegin(res), std::cend(res), itRelease->second) == std::cend(res))
+			res.push_back(itRelease->second);
+
+		if (res.size() == maxCount)
+			break;
+	}
+
+	eraseNonExistingIds<Release>(_db.getTLSSession(), res);
+
+	return res;
+}
+
+ArtistContainer
+HnswEngine::getSimilarArtists(ArtistId artistId, EnumSet<TrackArtistLinkType> linkTypes, std::size_t maxCount) const
+{
+	ArtistContainer res;
+
+	const auto itTracks {_artistTracks.find(artistId)};
+	if (itTracks == std::cend(_artistTracks))
+		return res;
+
+	// closest tracks first: artists are reported in order of their closest track
+	for (const HnswIndex::Neighbour& neighbour : searchNeighbours(itTracks->second, maxCount * neighbourCountPerResult))
+	{
+		const auto itArtistLinks {_trackArtistLinks.find(TrackId {neighbour.label})};
+		if (itArtistLinks == std::cend(_trackArtistLinks))
+			continue;
+
+		for (const ArtistLink& artistLink : itArtistLinks->second)
+		{
+			if (artistLink.artistId == artistId || !linkTypes.contains(artistLink.type))
+				continue;
+
+			if (std::find(std::cbegin(res), std::cend(res), artistLink.artistId) == std::cend(res))
+				res.push_back(artistLink.artistId);
+		}
+
+		if (res.size() >= maxCount)
+			break;
+	}
+
+	if (res.size() > maxCount)
+		res.resize(maxCount);
+
+	eraseNonExistingIds<Artist>(_db.getTLSSession(), res);
+
+	return res;
+}
+
+} // namespace Recommendation
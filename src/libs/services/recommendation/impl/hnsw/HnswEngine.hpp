@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "som/DataNormalizer.hpp"
+#include "features/FeaturesDefs.hpp"
+#include "IEngine.hpp"
+#include "HnswEngineCache.hpp"
+#include "HnswIndex.hpp"
+
+namespace Recommendation
+{
+	// Tracks are indexed using their normalized and weighted features vectors in an HNSW graph
+	// Releases and artists are similar if their tracks are close
+	// After scans, the index is updated incrementally from its cache as long as not too many tracks changed
+	class HnswEngine : public IEngine
+	{
+		public:
+			HnswEngine(Database::Db& db) : _db {db} {}
+
+			HnswEngine(const HnswEngine&) = delete;
+			HnswEngine(HnswEngine&&) = delete;
+			HnswEngine& operator=(const HnswEngine&) = delete;
+			HnswEngine& operator=(HnswEngine&&) = delete;
+
+		private:
+			void load(bool forceReload, const ProgressCallback& progressCallback) override;
+			void requestCancelLoad() override;
+
+			TrackContainer		findSimilarTracksFromTrackList(Database::TrackListId tracklistId, std::size_t maxCount) const override;
+			TrackContainer		findSimilarTracks(const std::vector<Database::TrackId>& tracksId, std::size_t maxCount) const override;
+			ReleaseContainer	getSimilarReleases(Database::ReleaseId releaseId, std::size_t maxCount) const override;
+			ArtistContainer		getSimilarArtists(Database::ArtistId artistId, EnumSet<Database::TrackArtistLinkType> linkTypes, std::size_t maxCount) const override;
+
+			// Returns false if a full build is needed (too many changes, different features)
+			bool loadFromCacheIncrementally(HnswEngineCache cache, std::size_t maxChangedPercent);
+			void build(const ProgressCallback& progressCallback);
+			void loadLinks();
+
+			std::optional<std::vector<HnswIndex::Value>> createVector(const FeatureValuesMap& featureValuesMap) const;
+
+			// tracks closest to the given tracks, closest first. The given tracks are not reported
+			std::vector<HnswIndex::Neighbour> searchNeighbours(const std::vector<Database::TrackId>& trackIds, std::size_t maxCount) const;
+
+			Database::Db&	_db;
+			bool			_loadCancelled {};
+
+			// features, in vector order
+			std::vector<FeatureName>			_featureNames;
+			std::vector<HnswIndex::Value>		_featureWeights;	// square roots of the dimension weights
+			std::size_t							_efSearch {};
+
+			std::unique_ptr<HnswIndex>			_index;
+			std::optional<SOM::DataNormalizer>	_dataNormalizer;
+			std::size_t							_updatedTrackCount {};
+
+			struct ArtistLink
+			{
+				Database::ArtistId				artistId;
+				Database::TrackArtistLinkType	type;
+			};
+
+			std::unordered_map<Database::TrackId, Database::ReleaseId>				_trackReleases;
+			std::unordered_map<Database::ReleaseId, std::vector<Database::TrackId>>	_releaseTracks;
+			std::unordered_map<Database::TrackId, std::vector<ArtistLink>>			_trackArtistLinks;
+			std::unordered_map<Database::ArtistId, std::vector<Database::TrackId>>	_artistTracks;
+	};
+} // namespace Recommendation
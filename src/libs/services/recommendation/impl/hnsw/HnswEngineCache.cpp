@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HnswEngineCache.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "utils/Crc32Calculator.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Service.hpp"
+
+namespace Recommendation
+{
+	namespace
+	{
+		std::filesystem::path
+		getCacheDirectory()
+		{
+			return Service<IConfig>::get()->getPath("working-dir") / "cache" / "hnsw";
+		}
+
+		std::filesystem::path
+		getCacheFilePath()
+		{
+			return getCacheDirectory() / "hnsw.bin";
+		}
+
+		// Binary cache layout, all values in host byte order:
+		// - header
+		// - normalization min/max: 2 * dimCount doubles
+		// - nodes: nodeCount records
+		// - vectors: nodeCount * dimCount floats
+		// - bottom links: nodeCount * (2 * maxConnectionCount + 1) uint32
+		// - upper links: upperLinkCount uint32
+		// Each section is padded to a multiple of 8 bytes, the checksum covers everything after the header
+		constexpr char binaryMagic[8] {'L', 'M', 'S', 'H', 'N', 'S', 'W', 'C'};
+		constexpr std::uint32_t binaryVersion {1};
+
+		struct BinaryHeader
+		{
+			char			magic[8];
+			std::uint32_t	version;
+			std::uint32_t	dimCount;
+			std::uint32_t	maxConnectionCount;
+			std::uint32_t	efConstruction;
+			std::uint32_t	maxLevel;
+			std::uint32_t	entryPoint;
+			std::uint32_t	checksum;
+			std::uint32_t	padding;
+			std::uint64_t	nodeCount;
+			std::uint64_t	upperLinkCount;
+			std::uint64_t	updatedTrackCount;
+		};
+		static_assert(std::is_trivially_copyable_v<BinaryHeader>);
+		static_assert(sizeof(BinaryHeader) % alignof(double) == 0);
+
+		constexpr std::uint64_t
+		getPaddedSize(std::uint64_t size)
+		{
+			return (size + 7) / 8 * 8;
+		}
+
+		class ChecksumWriter
+		{
+			public:
+				ChecksumWriter(std::ofstream& ofs) : _ofs {ofs} {}
+
+				template <typename T>
+				void write(const T* data, std::size_t count)
+				{
+					writeBytes(reinterpret_cast<const std::byte*>(data), count * sizeof(T));
+				}
+
+				template <typename T>
+				void writeSection(const std::vector<T>& values)
+				{
+					write(values.data(), values.size());
+
+					const std::byte padding[8] {};
+					writeBytes(padding, getPaddedSize(values.size() * sizeof(T)) - values.size() * sizeof(T));
+				}
+
+				std::uint32_t getChecksum() const { return _crc.getResult(); }
+
+			private:
+				void writeBytes(const std::byte* bytes, std::size_t size)
+				{
+					_crc.processBytes(bytes, size);
+					_ofs.write(reinterpret_cast<const char*>(bytes), size);
+				}
+
+				std::ofstream& _ofs;
+				Utils::Crc32Calculator _crc;
+		};
+	}
+
+	HnswEngineCache::HnswEngineCache(HnswIndex index, SOM::DataNormalizer dataNormalizer, std::size_t updatedTrackCount)
+		: _index {std::move(index)}
+		, _dataNormalizer {std::move(dataNormalizer)}
+		, _updatedTrackCount {updatedTrackCount}
+	{
+	}
+
+	std::optional<HnswEngineCache>
+	HnswEngineCache::readBinary(const std::filesystem::path& path)
+	{
+		using NodeIndex = HnswIndex::NodeIndex;
+		using Node = HnswIndex::Node;
+		static_assert(std::is_trivially_copyable_v<Node>);
+		static_assert(sizeof(Node) % 8 == 0);
+
+		std::error_code ec;
+		const std::uintmax_t fileSize {std::filesystem::file_size(path, ec)};
+		if (ec)
+			return std::nullopt;
+
+		if (fileSize < sizeof(BinaryHeader))
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read HNSW cache: file too small";
+			return std::nullopt;
+		}
+
+		try
+		{
+			LMS_LOG(RECOMMENDATION, INFO) << "Reading HNSW cache...";
+
+			const boost::interprocess::file_mapping mapping {path.c_str(), boost::interprocess::read_only};
+			const boost::interprocess::mapped_region region {mapping, boost::interprocess::read_only};
+			const std::byte* data {static_cast<const std::byte*>(region.get_address())};
+
+			BinaryHeader header;
+			std::memcpy(&header, data, sizeof(header));
+
+			if (std::memcmp(header.magic, binaryMagic, sizeof(binaryMagic)) != 0 || header.version != binaryVersion)
+			{
+				LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read HNSW cache: unhandled format";
+				return std::nullopt;
+			}
+
+			const std::uint64_t dimCount {header.dimCount};
+			const std::uint64_t bottomLinkBlockSize {2 * static_cast<std::uint64_t>(header.maxConnectionCount) + 1};
+			const std::uint64_t upperLinkBlockSize {static_cast<std::uint64_t>(header.maxConnectionCount) + 1};
+			if (dimCount == 0 || header.maxConnectionCount == 0 || header.efConstruction == 0 || header.nodeCount >= HnswIndex::invalidNodeIndex)
+			{
+				LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read HNSW cache: bad settings";
+				return std::nullopt;
+			}
+
+			const std::uint64_t normalizerSize {2 * dimCount * sizeof(double)};
+			const std::uint64_t nodesSize {header.nodeCount * sizeof(Node)};
+			const std::uint64_t vectorsSize {getPaddedSize(header.nodeCount * dimCount * sizeof(HnswIndex::Value))};
+			const std::uint64_t bottomLinksSize {getPaddedSize(header.nodeCount * bottomLinkBlockSize * sizeof(NodeIndex))};
+			const std::uint64_t upperLinksSize {getPaddedSize(header.upperLinkCount * sizeof(NodeIndex))};
+			if (fileSize != sizeof(BinaryHeader) + normalizerSize + nodesSize + vectorsSize + bottomLinksSize + upperLinksSize)
+			{
+				LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read HNSW cache: bad size";
+				return std::nullopt;
+			}
+
+			{
+				Utils::Crc32Calculator crc;
+				crc.processBytes(data + sizeof(BinaryHeader), fileSize - sizeof(BinaryHeader));
+				if (crc.getResult() != header.checksum)
+				{
+					LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read HNSW cache: bad checksum";
+					return std::nullopt;
+				}
+			}
+
+			// sections are aligned: mappings start on page boundaries and section sizes are multiples of 8
+			const std::byte* section {data + sizeof(BinaryHeader)};
+
+			SOM::DataNormalizer dataNormalizer {dimCount};
+			{
+				const double* values {reinterpret_cast<const double*>(section)};
+				for (std::size_t i {}; i < dimCount; ++i)
+					dataNormalizer.setValue(i, {values[2 * i], values[2 * i + 1]});
+				section += normalizerSize;
+			}
+
+			HnswIndex index {dimCount, HnswIndex::Settings {header.maxConnectionCount, header.efConstruction}};
+
+			const Node* nodes {reinterpret_cast<const Node*>(section)};
+			index._nodes.assign(nodes, nodes + header.nodeCount);
+			section += nodesSize;
+
+			const HnswIndex::Value* vectors {reinterpret_cast<const HnswIndex::Value*>(section)};
+			index._vectors.assign(vectors, vectors + header.nodeCount * dimCount);
+			section += vectorsSize;
+
+			const NodeIndex* bottomLinks {reinterpret_cast<const NodeIndex*>(section)};
+			index._bottomLinks.assign(bottomLinks, bottomLinks + header.nodeCount * bottomLinkBlockSize);
+			section += bottomLinksSize;
+
+			const NodeIndex* upperLinks {reinterpret_cast<const NodeIndex*>(section)};
+			index._upperLinks.assign(upperLinks, upperLinks + header.upperLinkCount);
+
+			// Make sure the graph cannot lead out of bounds
+			auto checkLinks {[&](const NodeIndex* links, std::uint64_t maxLinkCount)
+			{
+				if (links[0] > maxLinkCount)
+					return false;
+
+				for (std::size_t i {1}; i <= links[0]; ++i)
+				{
+					if (links[i] >= header.nodeCount)
+						return false;
+				}
+				return true;
+			}};
+
+			for (NodeIndex nodeIndex {}; nodeIndex < header.nodeCount; ++nodeIndex)
+			{
+				const Node& node {index._nodes[nodeIndex]};
+				if (node.level > header.maxLevel
+					|| node.upperLinkOffset + node.level * upperLinkBlockSize > header.upperLinkCount
+					|| !checkLinks(index.getLinks(nodeIndex, 0), bottomLinkBlockSize - 1))
+				{
+					LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read HNSW cache: bad node";
+					return std::nullopt;
+				}
+
+				for (std::size_t level {1}; level <= node.level; ++level)
+				{
+					if (!checkLinks(index.getLinks(nodeIndex, level), upperLinkBlockSize - 1))
+					{
+						LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read HNSW cache: bad node";
+						return std::nullopt;
+					}
+				}
+
+				if (!node.deleted)
+					index._nodeIndexes.emplace(node.label, nodeIndex);
+			}
+
+			if (header.nodeCount > 0 && (header.entryPoint >= header.nodeCount || index._nodes[header.entryPoint].level != header.maxLevel))
+			{
+				LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read HNSW cache: bad entry point";
+				return std::nullopt;
+			}
+
+			index._entryPoint = header.nodeCount > 0 ? header.entryPoint : HnswIndex::invalidNodeIndex;
+			index._maxLevel = header.maxLevel;
+			index._levelGenerator.seed(header.nodeCount); // do not pick the same levels again
+
+			LMS_LOG(RECOMMENDATION, INFO) << "Successfully read HNSW cache";
+
+			return HnswEngineCache {std::move(index), std::move(dataNormalizer), header.updatedTrackCount};
+		}
+		catch (const boost::interprocess::interprocess_exception& e)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot map HNSW cache: " << e.what();
+			return std::nullopt;
+		}
+	}
+
+	bool
+	HnswEngineCache::writeBinary(const std::filesystem::path& path, const HnswIndex& index, const SOM::DataNormalizer& dataNormalizer, std::size_t updatedTrackCount)
+	{
+		BinaryHeader header {};
+		std::memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+		header.version = binaryVersion;
+		header.dimCount = index.getDimCount();
+		header.maxConnectionCount = index.getSettings().maxConnectionCount;
+		header.efConstruction = index.getSettings().efConstruction;
+		header.maxLevel = index._maxLevel;
+		header.entryPoint = index._entryPoint;
+		header.nodeCount = index._nodes.size();
+		header.upperLinkCount = index._upperLinks.size();
+		header.updatedTrackCount = updatedTrackCount;
+
+		// write in a temporary file first so that an interrupted write does not leave a corrupted cache
+		std::filesystem::path tmpPath {path};
+		tmpPath += ".tmp";
+
+		{
+			std::ofstream ofs {tmpPath, std::ios::out | std::ios::binary | std::ios::trunc};
+			if (!ofs)
+			{
+				LMS_LOG(RECOMMENDATION, ERROR) << "Cannot create HNSW cache file '" << tmpPath.string() << "'";
+				return false;
+			}
+
+			// header is written again once the checksum is known
+			ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			ChecksumWriter writer {ofs};
+			for (std::size_t i {}; i < header.dimCount; ++i)
+			{
+				const SOM::DataNormalizer::MinMax& minMax {dataNormalizer.getValue(i)};
+				const double values[] {minMax.min, minMax.max};
+				writer.write(values, 2);
+			}
+			writer.writeSection(index._nodes);
+			writer.writeSection(index._vectors);
+			writer.writeSection(index._bottomLinks);
+			writer.writeSection(index._upperLinks);
+
+			header.checksum = writer.getChecksum();
+			ofs.seekp(0);
+			ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			if (!ofs)
+			{
+				LMS_LOG(RECOMMENDATION, ERROR) << "Cannot write HNSW cache file '" << tmpPath.string() << "'";
+				ofs.close();
+				std::filesystem::remove(tmpPath);
+				return false;
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tmpPath, path, ec);
+		if (ec)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot rename HNSW cache file: " << ec.message();
+			std::filesystem::remove(tmpPath, ec);
+			return false;
+		}
+
+		LMS_LOG(RECOMMENDATION, DEBUG) << "Created HNSW cache";
+		return true;
+	}
+
+	void
+	HnswEngineCache::invalidate()
+	{
+		std::error_code ec;
+		std::filesystem::remove(getCacheFilePath(), ec);
+	}
+
+	std::optional<HnswEngineCache>
+	HnswEngineCache::read()
+	{
+		if (!std::filesystem::exists(getCacheFilePath()))
+			return std::nullopt;
+
+		return readBinary(getCacheFilePath());
+	}
+
+	void
+	HnswEngineCache::write(const HnswIndex& index, const SOM::DataNormalizer& dataNormalizer, std::size_t updatedTrackCount)
+	{
+		std::filesystem::create_directories(getCacheDirectory());
+
+		if (!writeBinary(getCacheFilePath(), index, dataNormalizer, updatedTrackCount))
+			invalidate();
+	}
+} // namespace Recommendation
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+
+#include "som/DataNormalizer.hpp"
+#include "HnswIndex.hpp"
+
+namespace Recommendation
+{
+	class HnswEngineCache
+	{
+		public:
+			static void invalidate();
+
+			static std::optional<HnswEngineCache> read();
+			static void write(const HnswIndex& index, const SOM::DataNormalizer& dataNormalizer, std::size_t updatedTrackCount);
+
+		private:
+			HnswEngineCache(HnswIndex index, SOM::DataNormalizer dataNormalizer, std::size_t updatedTrackCount);
+
+			// versioned, checksummed binary file, the index sections are stored as they are in memory and read using a memory mapping
+			static std::optional<HnswEngineCache> readBinary(const std::filesystem::path& path);
+			static bool writeBinary(const std::filesystem::path& path, const HnswIndex& index, const SOM::DataNormalizer& dataNormalizer, std::size_t updatedTrackCount);
+
+			friend class HnswEngine;
+
+			HnswIndex			_index;
+			SOM::DataNormalizer	_dataNormalizer;		// used to normalize the vectors of the tracks added incrementally
+			std::size_t			_updatedTrackCount {};	// tracks added or removed since the index was built
+	};
+} // namespace Recommendation
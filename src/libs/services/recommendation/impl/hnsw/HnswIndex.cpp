@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HnswIndex.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+
+#include "utils/Exception.hpp"
+
+namespace Recommendation
+{
+	namespace
+	{
+		// Avoids clearing a visited flag per node for each search
+		class VisitedNodes
+		{
+			public:
+				void reset(std::size_t nodeCount)
+				{
+					if (_tags.size() < nodeCount)
+						_tags.resize(nodeCount);
+
+					if (++_currentTag == 0)
+					{
+						std::fill(std::begin(_tags), std::end(_tags), 0);
+						_currentTag = 1;
+					}
+				}
+
+				// returns false if already visited
+				bool visit(std::size_t nodeIndex)
+				{
+					if (_tags[nodeIndex] == _currentTag)
+						return false;
+
+					_tags[nodeIndex] = _currentTag;
+					return true;
+				}
+
+			private:
+				std::vector<std::uint32_t>	_tags;
+				std::uint32_t				_currentTag {};
+		};
+
+		thread_local VisitedNodes visitedNodes;
+	}
+
+	HnswIndex::HnswIndex(std::size_t dimCount, const Settings& settings)
+		: _dimCount {dimCount}
+		, _settings {settings}
+		, _levelFactor {1 / std::log(static_cast<double>(std::max<std::size_t>(settings.maxConnectionCount, 2)))}
+	{
+		if (_dimCount == 0 || _settings.maxConnectionCount == 0 || _settings.efConstruction == 0)
+			throw LmsException {"Bad HNSW index settings"};
+	}
+
+	const HnswIndex::Value*
+	HnswIndex::getVector(Label label) const
+	{
+		auto it {_nodeIndexes.find(label)};
+		if (it == std::cend(_nodeIndexes))
+			return nullptr;
+
+		return getNodeVector(it->second);
+	}
+
+	HnswIndex::NodeIndex*
+	HnswIndex::getLinks(NodeIndex nodeIndex, std::size_t level)
+	{
+		if (level == 0)
+			return &_bottomLinks[static_cast<std::size_t>(nodeIndex) * (getMaxLinkCount(0) + 1)];
+
+		return &_upperLinks[_nodes[nodeIndex].upperLinkOffset + (level - 1) * (getMaxLinkCount(level) + 1)];
+	}
+
+	const HnswIndex::NodeIndex*
+	HnswIndex::getLinks(NodeIndex nodeIndex, std::size_t level) const
+	{
+		return const_cast<HnswIndex*>(this)->getLinks(nodeIndex, level);
+	}
+
+	HnswIndex::Value
+	HnswIndex::computeDistance(const Value* a, const Value* b) const
+	{
+		Value res {};
+		for (std::size_t i {}; i < _dimCount; ++i)
+		{
+			const Value diff {a[i] - b[i]};
+			res += diff * diff;
+		}
+
+		return res;
+	}
+
+	std::uint32_t
+	HnswIndex::pickRandomLevel()
+	{
+		std::uniform_real_distribution<double> distribution {0, 1};
+		const double value {std::max(distribution(_levelGenerator), std::numeric_limits<double>::min())};
+
+		// keeps the level small enough for degenerated generators
+		return static_cast<std::uint32_t>(std::min(-std::log(value) * _levelFactor, 32.));
+	}
+
+	void
+	HnswIndex::insert(Label label, const Value* vector)
+	{
+		remove(label);
+
+		const NodeIndex nodeIndex {static_cast<NodeIndex>(_nodes.size())};
+		if (nodeIndex == invalidNodeIndex)
+			throw LmsException {"HNSW index is full"};
+
+		const std::uint32_t level {pickRandomLevel()};
+
+		_nodes.push_back(Node {label, level, 0, _upperLinks.size()});
+		_vectors.insert(std::end(_vectors), vector, vector + _dimCount);
+		_bottomLinks.resize(_bottomLinks.size() + getMaxLinkCount(0) + 1);
+		_upperLinks.resize(_upperLinks.size() + level * (getMaxLinkCount(1) + 1));
+		_nodeIndexes.emplace(label, nodeIndex);
+
+		if (_entryPoint == invalidNodeIndex)
+		{
+			_entryPoint = nodeIndex;
+			_maxLevel = level;
+			return;
+		}
+
+		NodeIndex entryPoint {_entryPoint};
+		if (level < _maxLevel)
+			entryPoint = searchClosest(vector, entryPoint, _maxLevel, level + 1);
+
+		for (std::size_t currentLevel {std::min(level, _maxLevel) + 1}; currentLevel-- > 0;)
+		{
+			const std::vector<Candidate> candidates {searchLayer(vector, entryPoint, _settings.efConstruction, currentLevel)};
+			const std::vector<Candidate> neighbours {selectNeighbours(candidates, _settings.maxConnectionCount)};
+
+			NodeIndex* links {getLinks(nodeIndex, currentLevel)};
+			links[0] = 0;
+			for (const Candidate& neighbour : neighbours)
+			{
+				links[++links[0]] = neighbour.nodeIndex;
+				connect(neighbour.nodeIndex, nodeIndex, currentLevel);
+			}
+
+			entryPoint = candidates.front().nodeIndex;
+		}
+
+		if (level > _maxLevel)
+		{
+			_entryPoint = nodeIndex;
+			_maxLevel = level;
+		}
+	}
+
+	void
+	HnswIndex::remove(Label label)
+	{
+		auto it {_nodeIndexes.find(label)};
+		if (it == std::cend(_nodeIndexes))
+			return;
+
+		_nodes[it->second].deleted = 1;
+		_nodeIndexes.erase(it);
+	}
+
+	void
+	HnswIndex::connect(NodeIndex nodeIndex, NodeIndex neighbourIndex, std::size_t level)
+	{
+		NodeIndex* links {getLinks(nodeIndex, level)};
+		const std::size_t maxLinkCount {getMaxLinkCount(level)};
+
+		if (links[0] < maxLinkCount)
+		{
+			links[++links[0]] = neighbourIndex;
+			return;
+		}
+
+		// Too many links: keep the most relevant ones
+		const Value* vector {getNodeVector(nodeIndex)};
+
+		std::vector<Candidate> candidates;
+		candidates.reserve(maxLinkCount + 1);
+		candidates.push_back({computeDistance(vector, getNodeVector(neighbourIndex)), neighbourIndex});
+		for (std::size_t i {1}; i <= links[0]; ++i)
+			candidates.push_back({computeDistance(vector, getNodeVector(links[i])), links[i]});
+		std::sort(std::begin(candidates), std::end(candidates));
+
+		const std::vector<Candidate> neighbours {selectNeighbours(candidates, maxLinkCount)};
+		links[0] = 0;
+		for (const Candidate& neighbour : neighbours)
+			links[++links[0]] = neighbour.nodeIndex;
+	}
+
+	// Favors the candidates that are closer to the node than to the already selected neighbours, so that the links go in various directions
+	// Remaining slots are filled with the closest discarded candidates, to keep the graph well connected
+	std::vector<HnswIndex::Candidate>
+	HnswIndex::selectNeighbours(const std::vector<Candidate>& candidates, std::size_t maxCount) const
+	{
+		std::vector<Candidate> res;
+		res.reserve(maxCount);
+
+		std::vector<Candidate> discarded;
+		for (const Candidate& candidate : candidates)
+		{
+			if (res.size() == maxCount)
+				break;
+
+			const Value* candidateVector {getNodeVector(candidate.nodeIndex)};
+			const bool dominated {std::any_of(std::cbegin(res), std::cend(res), [&](const Candidate& neighbour)
+			{
+				return computeDistance(candidateVector, getNodeVector(neighbour.nodeIndex)) < candidate.distance;
+			})};
+
+			if (!dominated)
+				res.push_back(candidate);
+			else
+				discarded.push_back(candidate);
+		}
+
+		for (auto it {std::cbegin(discarded)}; it != std::cend(discarded) && res.size() < maxCount; ++it)
+			res.push_back(*it);
+
+		return res;
+	}
+
+	HnswIndex::NodeIndex
+	HnswIndex::searchClosest(const Value* query, NodeIndex entryPoint, std::size_t fromLevel, std::size_t toLevel) const
+	{
+		NodeIndex closest {entryPoint};
+		Value closestDistance {computeDistance(query, getNodeVector(closest))};
+
+		for (std::size_t level {fromLevel}; level >= toLevel && level > 0; --level)
+		{
+			bool changed {true};
+			while (changed)
+			{
+				changed = false;
+
+				const NodeIndex* links {getLinks(closest, level)};
+				for (std::size_t i {1}; i <= links[0]; ++i)
+				{
+					const Value distance {computeDistance(query, getNodeVector(links[i]))};
+					if (distance < closestDistance)
+					{
+						closestDistance = distance;
+						closest = links[i];
+						changed = true;
+					}
+				}
+			}
+		}
+
+		return closest;
+	}
+
+	std::vector<HnswIndex::Candidate>
+	HnswIndex::searchLayer(const Value* query, NodeIndex entryPoint, std::size_t ef, std::size_t level) const
+	{
+		VisitedNodes& visited {visitedNodes};
+		visited.reset(_nodes.size());
+
+		std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;	// closest on top
+		std::priority_queue<Candidate, std::vector<Candidate>, std::less<Candidate>> results;		// farthest on top
+
+		const Candidate first {computeDistance(query, getNodeVector(entryPoint)), entryPoint};
+		visited.visit(entryPoint);
+		candidates.push(first);
+		results.push(first);
+
+		while (!candidates.empty())
+		{
+			const Candidate candidate {candidates.top()};
+			if (candidate.distance > results.top().distance && results.size() >= ef)
+				break;
+			candidates.pop();
+
+			const NodeIndex* links {getLinks(candidate.nodeIndex, level)};
+			for (std::size_t i {1}; i <= links[0]; ++i)
+			{
+				const NodeIndex neighbourIndex {links[i]};
+				if (!visited.visit(neighbourIndex))
+					continue;
+
+				const Value distance {computeDistance(query, getNodeVector(neighbourIndex))};
+				if (results.size() < ef || distance < results.top().distance)
+				{
+					candidates.push({distance, neighbourIndex});
+					results.push({distance, neighbourIndex});
+					if (results.size() > ef)
+						results.pop();
+				}
+			}
+		}
+
+		std::vector<Candidate> res(results.size());
+		for (std::size_t i {res.size()}; i-- > 0;)
+		{
+			res[i] = results.top();
+			results.pop();
+		}
+
+		return res;
+	}
+
+	std::vector<HnswIndex::Neighbour>
+	HnswIndex::search(const Value* query, std::size_t count, std::size_t ef) const
+	{
+		std::vector<Neighbour> res;
+		if (_entryPoint == invalidNodeIndex || count == 0)
+			return res;
+
+		const NodeIndex entryPoint {searchClosest(query, _entryPoint, _maxLevel, 1)};
+		const std::vector<Candidate> candidates {searchLayer(query, entryPoint, std::max(ef, count), 0)};
+
+		res.reserve(std::min(count, candidates.size()));
+		for (const Candidate& candidate : candidates)
+		{
+			const Node& node {_nodes[candidate.nodeIndex]};
+			if (node.deleted)
+				continue;
+
+			res.push_back(Neighbour {node.label, candidate.distance});
+			if (res.size() == count)
+				break;
+		}
+
+		return res;
+	}
+} // namespace Recommendation
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace Recommendation
+{
+	// Hierarchical Navigable Small World graph, used for approximate nearest neighbour searches (squared euclidean distance)
+	// Nodes can be inserted at any time. Removed nodes are only marked as deleted: they are still used to navigate the graph, but are never reported
+	// Storage is flat (fixed size records and link blocks) so that it can be written and mapped back as is
+	// Searches are thread safe, modifications are not
+	class HnswIndex
+	{
+		public:
+			using Label = std::int64_t;
+			using Value = float;
+
+			struct Settings
+			{
+				std::size_t maxConnectionCount {16};	// per node and per layer, twice this value on the bottom layer
+				std::size_t efConstruction {128};		// size of the candidate list used to connect the inserted nodes
+			};
+
+			HnswIndex(std::size_t dimCount, const Settings& settings);
+
+			std::size_t		getDimCount() const { return _dimCount; }
+			const Settings&	getSettings() const { return _settings; }
+			std::size_t		getNodeCount() const { return _nodes.size(); } // including the deleted ones
+			std::size_t		getDeletedCount() const { return _nodes.size() - _nodeIndexes.size(); }
+
+			bool			contains(Label label) const { return _nodeIndexes.find(label) != std::cend(_nodeIndexes); }
+			const Value*	getVector(Label label) const; // nullptr if not found
+
+			// Inserting an existing label replaces its vector
+			void			insert(Label label, const Value* vector);
+			void			remove(Label label);
+
+			struct Neighbour
+			{
+				Label	label;
+				Value	distance;
+			};
+			// closest first, at most count neighbours. ef is the size of the candidate list, the larger the more accurate
+			std::vector<Neighbour> search(const Value* query, std::size_t count, std::size_t ef) const;
+
+			template <typename Func>
+			void visitLabels(Func func) const
+			{
+				for (const auto& [label, nodeIndex] : _nodeIndexes)
+					func(label);
+			}
+
+		private:
+			friend class HnswEngineCache;
+
+			using NodeIndex = std::uint32_t;
+			static constexpr NodeIndex invalidNodeIndex {~NodeIndex {}};
+
+			struct Node
+			{
+				Label			label;
+				std::uint32_t	level;
+				std::uint32_t	deleted;
+				std::uint64_t	upperLinkOffset;	// links of the levels 1 to level in _upperLinks, (maxConnectionCount + 1) values per level
+			};
+
+			struct Candidate
+			{
+				Value		distance;
+				NodeIndex	nodeIndex;
+
+				bool operator<(const Candidate& other) const { return distance < other.distance; }
+				bool operator>(const Candidate& other) const { return distance > other.distance; }
+			};
+
+			// link blocks: count followed by the links
+			std::size_t			getMaxLinkCount(std::size_t level) const { return level == 0 ? 2 * _settings.maxConnectionCount : _settings.maxConnectionCount; }
+			NodeIndex*			getLinks(NodeIndex nodeIndex, std::size_t level);
+			const NodeIndex*	getLinks(NodeIndex nodeIndex, std::size_t level) const;
+			const Value*		getNodeVector(NodeIndex nodeIndex) const { return &_vectors[static_cast<std::size_t>(nodeIndex) * _dimCount]; }
+
+			Value					computeDistance(const Value* a, const Value* b) const;
+			std::uint32_t			pickRandomLevel();
+			NodeIndex				searchClosest(const Value* query, NodeIndex entryPoint, std::size_t fromLevel, std::size_t toLevel) const;
+			std::vector<Candidate>	searchLayer(const Value* query, NodeIndex entryPoint, std::size_t ef, std::size_t level) const; // closest first
+			std::vector<Candidate>	selectNeighbours(const std::vector<Candidate>& candidates, std::size_t maxCount) const;
+			void					connect(NodeIndex nodeIndex, NodeIndex neighbourIndex, std::size_t level);
+
+			std::size_t							_dimCount;
+			Settings							_settings;
+			double								_levelFactor;
+			std::mt19937						_levelGenerator {0}; // reproducible graphs
+
+			std::vector<Node>					_nodes;
+			std::vector<Value>					_vectors;		// _dimCount values per node
+			std::vector<NodeIndex>				_bottomLinks;	// (2 * maxConnectionCount + 1) values per node
+			std::vector<NodeIndex>				_upperLinks;
+			NodeIndex							_entryPoint {invalidNodeIndex};
+			std::uint32_t						_maxLevel {};
+
+			std::unordered_map<Label, NodeIndex>	_nodeIndexes; // not deleted nodes only
+	};
+} // namespace Recommendation
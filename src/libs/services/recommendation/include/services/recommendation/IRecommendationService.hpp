@@ -20,6 +20,7 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include "utils/EnumSet.hpp"
 #include "services/database/TrackListId.hpp"
 #include "services/database/Types.hpp"
@@ -39,6 +40,8 @@ namespace Recommendation
 
 			virtual void load(bool forceReload, const ProgressCallback& progressCallback = {}) = 0;
 			virtual void cancelLoad() = 0;  // wait for cancel done
+			// true once all the engines are loaded, the engines loaded first are used in the meantime
+			virtual bool isLoaded() const = 0;
 
 			virtual TrackContainer findSimilarTracksFromTrackList(Database::TrackListId tracklistId, std::size_t maxCount) const = 0;
 			virtual TrackContainer findSimilarTracks(const std::vector<Database::TrackId>& tracksId, std::size_t maxCount) const = 0;
@@ -46,7 +49,8 @@ namespace Recommendation
 			virtual ArtistContainer getSimilarArtists(Database::ArtistId artistId, EnumSet<Database::TrackArtistLinkType> linkTypes, std::size_t maxCount) const = 0;
 	};
 
-	std::unique_ptr<IRecommendationService> createRecommendationService(Database::Db& db);
+	// If engineType is set, only this engine is used, whatever the scan settings are (benchmark purposes)
+	std::unique_ptr<IRecommendationService> createRecommendationService(Database::Db& db, std::optional<EngineType> engineType = std::nullopt);
 
 } // ns Recommendation
 
@@ -7,6 +7,13 @@
 
 namespace Recommendation
 {
+	enum class EngineType
+	{
+		Clusters,
+		Features,
+		Hnsw,
+	};
+
 	struct Progress
 	{
 		std::size_t totalElems {};
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AcousticBrainzDump.hpp"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "utils/Exception.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Path.hpp"
+#include "AcousticBrainzUtils.hpp"
+
+namespace AcousticBrainz
+{
+	namespace
+	{
+		// Same limit as the documents fetched using the API
+		constexpr std::size_t maxDocumentSize {maxResponseSize};
+
+		std::optional<std::string_view>
+		getRecordingMBID(std::string_view fileName)
+		{
+			constexpr std::size_t mbidSize {36};
+			constexpr std::string_view extension {".json"};
+
+			if (const std::size_t pos {fileName.find_last_of('/')}; pos != std::string_view::npos)
+				fileName.remove_prefix(pos + 1);
+
+			if (fileName.size() <= mbidSize + 1 + extension.size()
+					|| fileName[mbidSize] != '-'
+					|| fileName.substr(fileName.size() - extension.size()) != extension)
+				return std::nullopt;
+
+			return fileName.substr(0, mbidSize);
+		}
+
+		// Tar archives are made of 512 bytes blocks: a header block for each entry, followed by its padded content
+		constexpr std::size_t tarBlockSize {512};
+		using TarHeader = std::array<char, tarBlockSize>;
+
+		std::string_view
+		getTarField(const TarHeader& header, std::size_t offset, std::size_t size)
+		{
+			const std::string_view field {header.data() + offset, size};
+			return field.substr(0, field.find('\0'));
+		}
+
+		std::uint64_t
+		parseTarOctalField(std::string_view field)
+		{
+			std::uint64_t res {};
+			for (const char c : field)
+			{
+				if (c == ' ')
+					continue;
+				if (c < '0' || c > '7')
+					break;
+
+				res = res * 8 + (c - '0');
+			}
+
+			return res;
+		}
+
+		void
+		visitTar(const std::filesystem::path& tarPath, const DumpFilter& filter, const DumpVisitor& func)
+		{
+			std::ifstream ifs {tarPath, std::ios::binary};
+			if (!ifs)
+				throw LmsException {"Cannot open '" + tarPath.string() + "'"};
+
+			TarHeader header;
+			std::string longName;	// GNU extension, name of the next entry
+			std::string document;
+			while (ifs.read(header.data(), header.size()))
+			{
+				// end of archive
+				if (header[0] == '\0')
+					break;
+
+				const std::uint64_t size {parseTarOctalField(getTarField(header, 124, 12))};
+				const std::uint64_t paddedSize {(size + tarBlockSize - 1) / tarBlockSize * tarBlockSize};
+				const char type {header[156]};
+
+				if (type == 'L')
+				{
+					longName.resize(size);
+					if (!ifs.read(longName.data(), size))
+						break;
+					longName.erase(longName.find('\0') == std::string::npos ? longName.size() : longName.find('\0'));
+					ifs.seekg(paddedSize - size, std::ios::cur);
+					continue;
+				}
+
+				std::string name;
+				if (!longName.empty())
+					name = std::exchange(longName, {});
+				else
+				{
+					name = getTarField(header, 0, 100);
+					if (getTarField(header, 257, 5) == "ustar")
+					{
+						const std::string_view prefix {getTarField(header, 345, 155)};
+						if (!prefix.empty())
+							name = std::string {prefix} + "/" + name;
+					}
+				}
+
+				const bool isRegularFile {type == '0' || type == '\0'};
+				const std::optional<std::string_view> recordingMBID {isRegularFile && size <= maxDocumentSize ? getRecordingMBID(name) : std::nullopt};
+				if (!recordingMBID || !filter(*recordingMBID))
+				{
+					ifs.seekg(paddedSize, std::ios::cur);
+					continue;
+				}
+
+				document.resize(size);
+				if (!ifs.read(document.data(), size))
+					break;
+
+				if (!func(*recordingMBID, document))
+					return;
+
+				ifs.seekg(paddedSize - size, std::ios::cur);
+			}
+
+			if (ifs.bad() || (!ifs && !ifs.eof()))
+				throw LmsException {"Error while reading '" + tarPath.string() + "'"};
+		}
+
+		void
+		visitDirectory(const std::filesystem::path& directory, const DumpFilter& filter, const DumpVisitor& func)
+		{
+			std::string document;
+			exploreFilesRecursive(directory, [&](std::error_code ec, const std::filesystem::path& path)
+			{
+				if (ec)
+				{
+					LMS_LOG(DBUPDATER, ERROR) << "Cannot read dump entry '" << path.string() << "': " << ec.message();
+					return true;
+				}
+
+				const std::string fileName {path.filename().string()};
+				const std::optional<std::string_view> recordingMBID {getRecordingMBID(fileName)};
+				if (!recordingMBID || !filter(*recordingMBID))
+					return true;
+
+				std::error_code sizeEc;
+				const std::uintmax_t size {std::filesystem::file_size(path, sizeEc)};
+				if (sizeEc || size > maxDocumentSize)
+					return true;
+
+				std::ifstream ifs {path, std::ios::binary};
+				document.resize(size);
+				if (!ifs.read(document.data(), size))
+				{
+					LMS_LOG(DBUPDATER, ERROR) << "Cannot read dump entry '" << path.string() << "'";
+					return true;
+				}
+
+				return func(*recordingMBID, document);
+			});
+		}
+	}
+
+	void
+	visitLowLevelDump(const std::filesystem::path& dumpPath, const DumpFilter& filter, const DumpVisitor& func)
+	{
+		std::error_code ec;
+		if (std::filesystem::is_directory(dumpPath, ec))
+			visitDirectory(dumpPath, filter, func);
+		else
+			visitTar(dumpPath, filter, func);
+	}
+} // namespace AcousticBrainz
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <string_view>
+
+namespace AcousticBrainz
+{
+	// Visits the low-level documents of a locally downloaded AcousticBrainz dump, without any network access
+	// dumpPath is either an uncompressed tar archive of the dump or a directory where it has been extracted
+	// Documents are named "<recording MBID>-<submission index>.json"
+	// A document is only read if filter returns true for its recording MBID (lower case)
+	// Returning false from func stops the walk, throws LmsException if the dump cannot be read
+	using DumpFilter = std::function<bool(std::string_view recordingMBID)>;
+	using DumpVisitor = std::function<bool(std::string_view recordingMBID, std::string_view document)>;
+	void visitLowLevelDump(const std::filesystem::path& dumpPath, const DumpFilter& filter, const DumpVisitor& func);
+}
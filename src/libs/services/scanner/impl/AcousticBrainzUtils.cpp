@@ -19,69 +19,25 @@
 
 #include "AcousticBrainzUtils.hpp"
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
-
-#include <Wt/WIOService.h>
-#include <Wt/Http/Client.h>
-
 #include "utils/IConfig.hpp"
-#include "utils/Logger.hpp"
 #include "utils/Service.hpp"
 #include "utils/UUID.hpp"
 
-
 namespace AcousticBrainz
 {
 
-static
 std::string
-getJsonData(const UUID& mbid)
+getAPIBaseUrl()
 {
 	static constexpr std::string_view defaultAPIURL {"https://acousticbrainz.org"};
 
-	const std::string url {std::string {Service<IConfig>::get()->getString("acousticbrainz-api-base-url", defaultAPIURL)} + "/api/v1/" + std::string {mbid.getAsString()} + "/low-level"};
-
-	boost::asio::io_service ioService;
-
-	Wt::Http::Client client {ioService};
-	client.setFollowRedirect(true);
-	client.setSslCertificateVerificationEnabled(true);
-	client.setMaximumResponseSize(256*1024);
-
-	if (!client.get(url))
-	{
-		LMS_LOG(DBUPDATER, ERROR) << "Cannot perform a GET request to url '" << url << "'";
-		return {};
-	}
-
-	std::string response;
-	client.done().connect([&](Wt::AsioWrapper::error_code ec, const Wt::Http::Message &msg)
-	{
-		if (ec)
-		{
-			LMS_LOG(DBUPDATER, ERROR) << "GET request to url '" << url << "' failed: " << ec.message();
-			return;
-		}
-
-		if (msg.status() != 200)
-		{
-			LMS_LOG(DBUPDATER, ERROR) << "GET request to url '" << url << "' failed: status = " << msg.status() << ", body = " << msg.body();
-			return;
-		}
-
-		response = msg.body();
-	});
-
-	ioService.run();
-
-	return response;
+	return std::string {Service<IConfig>::get()->getString("acousticbrainz-api-base-url", defaultAPIURL)};
 }
 
 std::string
-extractLowLevelFeatures(const UUID& recordingMBID)
+getLowLevelFeaturesRelativeUrl(const UUID& recordingMBID)
 {
-	return getJsonData(recordingMBID);
+	return "/api/v1/" + std::string {recordingMBID.getAsString()} + "/low-level";
 }
 
-} // namespace Scanner::AcousticBrainz
+} // namespace AcousticBrainz
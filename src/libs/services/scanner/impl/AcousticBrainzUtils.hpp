@@ -19,12 +19,16 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 class UUID;
 
 namespace AcousticBrainz
 {
-	std::string extractLowLevelFeatures(const UUID& recordingMBID);
+	static inline constexpr std::size_t maxResponseSize {256 * 1024};
+
+	std::string getAPIBaseUrl();
+	std::string getLowLevelFeaturesRelativeUrl(const UUID& recordingMBID);
 }
 
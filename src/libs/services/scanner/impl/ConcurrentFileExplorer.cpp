@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ConcurrentFileExplorer.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "utils/Logger.hpp"
+#include "utils/Path.hpp"
+#include "utils/Profiling.hpp"
+
+namespace Scanner
+{
+	namespace
+	{
+		// Entries are handed over by batches to limit the lock contention
+		constexpr std::size_t entryBatchSize {64};
+		// Bounds the memory used when the consumer is slower than the walks
+		constexpr std::size_t maxPendingBatchCountPerWalker {16};
+
+		struct Entry
+		{
+			std::size_t				rootIndex;
+			std::error_code			ec;
+			std::filesystem::path	path;
+		};
+
+		struct Directory
+		{
+			std::size_t				rootIndex;
+			std::filesystem::path	path;
+		};
+	}
+
+	void
+	exploreFilesConcurrently(const std::vector<std::filesystem::path>& rootDirectories, const ConcurrentExploreFilter& filter, const ConcurrentExploreCallback& cb, const std::filesystem::path& excludeDirFileName, std::size_t walkerCount)
+	{
+		if (rootDirectories.empty())
+			return;
+
+		// No need for a worker
+		if (walkerCount <= 1)
+		{
+			for (std::size_t rootIndex {}; rootIndex < rootDirectories.size(); ++rootIndex)
+			{
+				const bool complete {exploreFilesRecursive(rootDirectories[rootIndex], [&](std::error_code ec, const std::filesystem::path& path)
+				{
+					if (!ec && !filter(rootIndex, path))
+						return true;
+
+					return cb(rootIndex, ec, path);
+				}, excludeDirFileName)};
+
+				if (!complete)
+					break;
+			}
+			return;
+		}
+
+		const std::size_t maxPendingBatchCount {maxPendingBatchCountPerWalker * walkerCount};
+
+		std::mutex mutex;
+		std::condition_variable producerCv;
+		std::condition_variable consumerCv;
+		std::condition_variable directoryCv;
+		std::deque<std::vector<Entry>> pendingBatches;
+		std::deque<Directory> pendingDirectories;
+		std::size_t busyWalkerCount {};	// walkers currently listing a directory
+		std::size_t runningWorkerCount {walkerCount};
+		bool aborted {};
+
+		for (std::size_t rootIndex {}; rootIndex < rootDirectories.size(); ++rootIndex)
+			pendingDirectories.push_back(Directory {rootIndex, rootDirectories[rootIndex]});
+
+		auto pushBatch {[&](std::vector<Entry>& batch)
+		{
+			{
+				std::unique_lock lock {mutex};
+				producerCv.wait(lock, [&] { return aborted || pendingBatches.size() < maxPendingBatchCount; });
+				if (aborted)
+					return false;
+
+				pendingBatches.push_back(std::move(batch));
+			}
+			consumerCv.notify_one();
+
+			batch.clear();
+			return true;
+		}};
+
+		auto abort {[&]
+		{
+			{
+				std::scoped_lock lock {mutex};
+				aborted = true;
+			}
+			producerCv.notify_all();
+			directoryCv.notify_all();
+		}};
+
+		// returns false if aborted
+		auto exploreDirectory {[&](const Directory& directory, std::vector<Entry>& batch)
+		{
+			auto addEntry {[&](std::error_code ec, const std::filesystem::path& path)
+			{
+				batch.push_back(Entry {directory.rootIndex, ec, path});
+				if (batch.size() >= entryBatchSize)
+					return pushBatch(batch);
+
+				return true;
+			}};
+
+			std::error_code ec;
+			std::filesystem::directory_iterator itPath {directory.path, std::filesystem::directory_options::follow_directory_symlink, ec};
+			if (ec)
+				return addEntry(ec, directory.path); // try to continue exploring anyway
+
+			if (!excludeDirFileName.empty())
+			{
+				const std::filesystem::path excludePath {directory.path / excludeDirFileName};
+				if (std::filesystem::exists(excludePath, ec))
+				{
+					LMS_LOG(DBUPDATER, DEBUG) << "Found '" << excludePath.string() << "': skipping directory";
+					return true;
+				}
+			}
+
+			std::vector<Directory> subDirectories;
+			for (std::filesystem::directory_iterator itEnd; itPath != itEnd; itPath.increment(ec))
+			{
+				bool continueExploring {true};
+
+				if (ec)
+				{
+					continueExploring = addEntry(ec, *itPath);
+				}
+				else if (itPath->is_regular_file(ec)) // file type cached by the iterator
+				{
+					if (filter(directory.rootIndex, *itPath))
+						continueExploring = addEntry(ec, *itPath);
+				}
+				else if (itPath->is_directory(ec))
+				{
+					if (!ec)
+						subDirectories.push_back(Directory {directory.rootIndex, *itPath});
+					else
+						continueExploring = addEntry(ec, *itPath);
+				}
+
+				if (!continueExploring)
+					return false;
+			}
+
+			if (!subDirectories.empty())
+			{
+				{
+					std::scoped_lock lock {mutex};
+					for (Directory& subDirectory : subDirectories)
+						pendingDirectories.push_back(std::move(subDirectory));
+				}
+				directoryCv.notify_all();
+			}
+
+			return true;
+		}};
+
+		std::vector<std::thread> workers;
+		workers.reserve(walkerCount);
+		for (std::size_t i {}; i < walkerCount; ++i)
+		{
+			workers.emplace_back([&]
+			{
+				const Profiling::ScopedLabel profilingLabel {"exploring_files"};
+
+				std::vector<Entry> batch;
+				batch.reserve(entryBatchSize);
+
+				bool continueExploring {true};
+				while (continueExploring)
+				{
+					Directory directory;
+					{
+						std::unique_lock lock {mutex};
+
+						// Do not keep entries while waiting for more work
+						if (!batch.empty() && pendingDirectories.empty())
+						{
+							lock.unlock();
+							if (!pushBatch(batch))
+								break;
+							lock.lock();
+						}
+
+						directoryCv.wait(lock, [&] { return aborted || !pendingDirectories.empty() || busyWalkerCount == 0; });
+						if (aborted || pendingDirectories.empty())
+							break;
+
+						directory = std::move(pendingDirectories.front());
+						pendingDirectories.pop_front();
+						busyWalkerCount++;
+					}
+
+					continueExploring = exploreDirectory(directory, batch);
+
+					bool walkCompleted {};
+					{
+						std::scoped_lock lock {mutex};
+						busyWalkerCount--;
+						walkCompleted = busyWalkerCount == 0 && pendingDirectories.empty();
+					}
+					if (walkCompleted)
+						directoryCv.notify_all();
+				}
+
+				if (continueExploring && !batch.empty())
+					pushBatch(batch);
+
+				{
+					std::scoped_lock lock {mutex};
+					runningWorkerCount--;
+				}
+				consumerCv.notify_one();
+			});
+		}
+
+		std::exception_ptr exception;
+		try
+		{
+			while (true)
+			{
+				std::vector<Entry> batch;
+				{
+					std::unique_lock lock {mutex};
+					consumerCv.wait(lock, [&] { return !pendingBatches.empty() || runningWorkerCount == 0; });
+					if (pendingBatches.empty())
+						break;
+
+					batch = std::move(pendingBatches.front());
+					pendingBatches.pop_front();
+				}
+				producerCv.notify_one();
+
+				bool continueExploring {true};
+				for (const Entry& entry : batch)
+				{
+					if (!cb(entry.rootIndex, entry.ec, entry.path))
+					{
+						continueExploring = false;
+						break;
+					}
+				}
+
+				if (!continueExploring)
+					break;
+			}
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+
+		// Workers may be waiting for some room in the queue or for more directories
+		abort();
+		for (std::thread& worker : workers)
+			worker.join();
+
+		if (exception)
+			std::rethrow_exception(exception);
+	}
+} // namespace Scanner
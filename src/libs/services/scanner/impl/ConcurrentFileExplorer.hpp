@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <system_error>
+#include <vector>
+
+namespace Scanner
+{
+	// Same as exploreFilesRecursive, but the directories are walked by a pool of I/O workers
+	// Subdirectories of the same root are listed concurrently, at most walkerCount directories are being read at the same time
+	// Entry types are taken from the directory listing (d_type), no stat is needed to tell files and directories apart on most filesystems
+	// Files are filtered by the workers, and handed over to the calling thread by batches: the callback is always called from the calling thread
+	// Entries of the different directories are interleaved
+	// Returning false from the callback stops all the walks
+	using ConcurrentExploreFilter = std::function<bool(std::size_t rootIndex, const std::filesystem::path& path)>;
+	using ConcurrentExploreCallback = std::function<bool(std::size_t rootIndex, std::error_code ec, const std::filesystem::path& path)>;
+	void exploreFilesConcurrently(const std::vector<std::filesystem::path>& rootDirectories, const ConcurrentExploreFilter& filter, const ConcurrentExploreCallback& cb, const std::filesystem::path& excludeDirFileName, std::size_t walkerCount);
+} // namespace Scanner
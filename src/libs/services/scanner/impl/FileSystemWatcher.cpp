@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FileSystemWatcher.hpp"
+
+#include <cerrno>
+#include <system_error>
+
+#include "utils/Exception.hpp"
+#include "utils/Logger.hpp"
+
+namespace Scanner
+{
+	namespace
+	{
+		constexpr std::uint32_t watchMask {IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR};
+
+		int
+		createInotifyDescriptor()
+		{
+			const int fd {::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)};
+			if (fd < 0)
+				throw LmsException {"inotify_init1 failed: " + std::error_code {errno, std::generic_category()}.message()};
+
+			return fd;
+		}
+
+		bool
+		isPathInDirectory(const std::filesystem::path& path, const std::filesystem::path& directory)
+		{
+			const auto itMismatch {std::mismatch(std::cbegin(directory), std::cend(directory), std::cbegin(path), std::cend(path))};
+			return itMismatch.first == std::cend(directory);
+		}
+	}
+
+	FileSystemWatcher::FileSystemWatcher(boost::asio::io_service& ioService, std::chrono::milliseconds settleDelay, ChangesCallback callback)
+	: _settleDelay {settleDelay}
+	, _callback {std::move(callback)}
+	, _inotifyDescriptor {ioService, createInotifyDescriptor()}
+	, _settleTimer {ioService}
+	{
+		asyncRead();
+	}
+
+	FileSystemWatcher::~FileSystemWatcher()
+	{
+		unwatch();
+	}
+
+	void
+	FileSystemWatcher::watch(const std::vector<std::filesystem::path>& rootDirectories, const std::filesystem::path& excludeDirFileName)
+	{
+		unwatch();
+
+		_rootDirectories = rootDirectories;
+		_excludeDirFileName = excludeDirFileName;
+		for (const std::filesystem::path& rootDirectory : _rootDirectories)
+		{
+			LMS_LOG(DBUPDATER, INFO) << "Watching directory '" << rootDirectory.string() << "'...";
+			addWatchRecursive(rootDirectory, false);
+		}
+
+		LMS_LOG(DBUPDATER, INFO) << _rootDirectories.size() << " root directories watched: " << _watchedDirectories.size() << " directories watched";
+	}
+
+	void
+	FileSystemWatcher::unwatch()
+	{
+		for (const auto& [wd, directory] : _watchedDirectories)
+			::inotify_rm_watch(_inotifyDescriptor.native_handle(), wd);
+
+		_watchedDirectories.clear();
+		_rootDirectories.clear();
+		_pendingChanges = {};
+		_settleTimer.cancel();
+	}
+
+	void
+	FileSystemWatcher::asyncRead()
+	{
+		_inotifyDescriptor.async_read_some(boost::asio::buffer(_buffer), [this](const boost::system::error_code& ec, std::size_t bytesRead)
+		{
+			if (ec)
+			{
+				if (ec != boost::asio::error::operation_aborted)
+					LMS_LOG(DBUPDATER, ERROR) << "Cannot read inotify events: " << ec.message();
+				return;
+			}
+
+			processEvents(bytesRead);
+			if (!_pendingChanges.empty())
+				scheduleNotify();
+
+			asyncRead();
+		});
+	}
+
+	void
+	FileSystemWatcher::processEvents(std::size_t bytesRead)
+	{
+		std::size_t offset {};
+		while (offset + sizeof(struct inotify_event) <= bytesRead)
+		{
+			const struct inotify_event* event {reinterpret_cast<const struct inotify_event*>(_buffer.data() + offset)};
+			processEvent(*event);
+
+			offset += sizeof(struct inotify_event) + event->len;
+		}
+	}
+
+	void
+	FileSystemWatcher::processEvent(const struct inotify_event& event)
+	{
+		if (event.mask & IN_Q_OVERFLOW)
+		{
+			LMS_LOG(DBUPDATER, WARNING) << "Inotify queue overflow, some events have been lost";
+			_pendingChanges.overflow = true;
+			return;
+		}
+
+		auto itDirectory {_watchedDirectories.find(event.wd)};
+		if (itDirectory == std::cend(_watchedDirectories))
+			return;
+
+		if (event.mask & IN_IGNORED)
+		{
+			// watch removed by the kernel (directory deleted, unmounted, etc.)
+			_watchedDirectories.erase(itDirectory);
+			return;
+		}
+
+		if (event.len == 0)
+			return;
+
+		const std::filesystem::path path {itDirectory->second / event.name};
+
+		if (event.mask & IN_ISDIR)
+		{
+			if (event.mask & (IN_CREATE | IN_MOVED_TO))
+			{
+				// Files may have been added before the watch is set up: report all of them
+				addWatchRecursive(path, true);
+			}
+			else if (event.mask & (IN_DELETE | IN_MOVED_FROM))
+			{
+				removeWatchRecursive(path);
+				_pendingChanges.removedPaths.insert(path);
+			}
+		}
+		else
+		{
+			if (event.mask & (IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_TO))
+				_pendingChanges.modifiedFiles.insert(path);
+			else if (event.mask & (IN_DELETE | IN_MOVED_FROM))
+				_pendingChanges.removedPaths.insert(path);
+		}
+	}
+
+	void
+	FileSystemWatcher::scheduleNotify()
+	{
+		// Wait for things to settle down (copying a whole album generates a lot of events)
+		_settleTimer.expires_from_now(_settleDelay);
+		_settleTimer.async_wait([this](const boost::system::error_code& ec)
+		{
+			if (ec)
+				return;
+
+			Changes changes;
+			std::swap(changes, _pendingChanges);
+			_callback(std::move(changes));
+		});
+	}
+
+	void
+	FileSystemWatcher::addWatchRecursive(const std::filesystem::path& directory, bool reportFiles)
+	{
+		std::error_code ec;
+
+		if (!_excludeDirFileName.empty() && std::filesystem::exists(directory / _excludeDirFileName, ec))
+		{
+			LMS_LOG(DBUPDATER, DEBUG) << "Found '" << (directory / _excludeDirFileName).string() << "': not watching directory";
+			return;
+		}
+
+		const int wd {::inotify_add_watch(_inotifyDescriptor.native_handle(), directory.c_str(), watchMask)};
+		if (wd < 0)
+		{
+			const int err {errno};
+			LMS_LOG(DBUPDATER, ERROR) << "Cannot watch directory '" << directory.string() << "': " << std::error_code {err, std::generic_category()}.message();
+			if (err == ENOSPC)
+				LMS_LOG(DBUPDATER, ERROR) << "Too many watched directories, consider increasing fs.inotify.max_user_watches";
+			return;
+		}
+		_watchedDirectories[wd] = directory;
+
+		std::filesystem::directory_iterator itEnd;
+		for (std::filesystem::directory_iterator itPath {directory, std::filesystem::directory_options::follow_directory_symlink, ec}; !ec && itPath != itEnd; itPath.increment(ec))
+		{
+			if (itPath->is_directory(ec))
+				addWatchRecursive(itPath->path(), reportFiles);
+			else if (reportFiles && itPath->is_regular_file(ec))
+				_pendingChanges.modifiedFiles.insert(itPath->path());
+		}
+	}
+
+	void
+	FileSystemWatcher::removeWatchRecursive(const std::filesystem::path& directory)
+	{
+		for (auto itWatch {std::begin(_watchedDirectories)}; itWatch != std::end(_watchedDirectories);)
+		{
+			if (isPathInDirectory(itWatch->second, directory))
+			{
+				::inotify_rm_watch(_inotifyDescriptor.native_handle(), itWatch->first);
+				itWatch = _watchedDirectories.erase(itWatch);
+			}
+			else
+				++itWatch;
+		}
+	}
+} // namespace Scanner
+
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <sys/inotify.h>
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "utils/Path.hpp"
+
+namespace Scanner
+{
+	// Watches a directory tree using inotify
+	// Changes are accumulated and reported once no more events are received during settleDelay
+	// All the callbacks are called from the given ioService
+	class FileSystemWatcher
+	{
+		public:
+			struct Changes
+			{
+				std::unordered_set<std::filesystem::path>	modifiedFiles;	// created, written or moved in files
+				std::unordered_set<std::filesystem::path>	removedPaths;	// deleted or moved out files and directories
+				bool overflow {};	// some events have been lost, a full scan is needed
+
+				bool empty() const { return modifiedFiles.empty() && removedPaths.empty() && !overflow; }
+			};
+			using ChangesCallback = std::function<void(Changes&& changes)>;
+
+			FileSystemWatcher(boost::asio::io_service& ioService, std::chrono::milliseconds settleDelay, ChangesCallback callback);
+			~FileSystemWatcher();
+
+			FileSystemWatcher(const FileSystemWatcher&) = delete;
+			FileSystemWatcher(FileSystemWatcher&&) = delete;
+			FileSystemWatcher& operator=(const FileSystemWatcher&) = delete;
+			FileSystemWatcher& operator=(FileSystemWatcher&&) = delete;
+
+			// Watch the whole trees, replacing any previously watched trees
+			void watch(const std::vector<std::filesystem::path>& rootDirectories, const std::filesystem::path& excludeDirFileName);
+			void unwatch();
+
+			const std::vector<std::filesystem::path>& getRootDirectories() const { return _rootDirectories; }
+
+		private:
+			void asyncRead();
+			void processEvents(std::size_t bytesRead);
+			void processEvent(const struct inotify_event& event);
+			void scheduleNotify();
+
+			void addWatchRecursive(const std::filesystem::path& directory, bool reportFiles);
+			void removeWatchRecursive(const std::filesystem::path& directory);
+
+			const std::chrono::milliseconds			_settleDelay;
+			ChangesCallback							_callback;
+			boost::asio::posix::stream_descriptor	_inotifyDescriptor;
+			boost::asio::steady_timer				_settleTimer;
+			alignas(struct inotify_event) std::array<char, 64 * 1024> _buffer;
+
+			std::vector<std::filesystem::path>					_rootDirectories;
+			std::filesystem::path								_excludeDirFileName;
+			std::unordered_map<int, std::filesystem::path>		_watchedDirectories;
+			Changes												_pendingChanges;
+	};
+} // namespace Scanner
+
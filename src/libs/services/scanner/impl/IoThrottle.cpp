@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "IoThrottle.hpp"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include "utils/Logger.hpp"
+#include "utils/MediaActivity.hpp"
+
+namespace Scanner
+{
+	namespace
+	{
+		// Media served within this window make the scan back off
+		constexpr std::chrono::seconds mediaActivityWindow {10};
+		// Max sleep duration, to react quickly to aborts and back-off changes
+		constexpr std::chrono::milliseconds maxSleepDuration {100};
+
+		// See linux/ioprio.h, not exposed by the libc
+		constexpr int ioprioWhoProcess {1};
+		constexpr int ioprioClassIdle {3};
+		constexpr int ioprioClassShift {13};
+
+		thread_local bool ioPriorityApplied {};
+	}
+
+	IoThrottle::IoThrottle(const Settings& settings, const std::atomic<bool>& abort)
+		: _settings {settings}
+		, _abort {abort}
+	{
+		LMS_LOG(DBUPDATER, INFO) << "IO throttling: maxFilesPerSecond = " << _settings.maxFilesPerSecond << ", backoffFilesPerSecond = " << _settings.backoffFilesPerSecond << ", idleIoPriority = " << _settings.idleIoPriority;
+	}
+
+	std::size_t
+	IoThrottle::getFilesPerSecond() const
+	{
+		if (_settings.backoffFilesPerSecond > 0 && MediaActivity::isActive(mediaActivityWindow))
+		{
+			if (_settings.maxFilesPerSecond == 0)
+				return _settings.backoffFilesPerSecond;
+
+			return std::min(_settings.maxFilesPerSecond, _settings.backoffFilesPerSecond);
+		}
+
+		return _settings.maxFilesPerSecond;
+	}
+
+	bool
+	IoThrottle::waitForFile()
+	{
+		while (true)
+		{
+			if (_abort)
+				return false;
+
+			const std::size_t filesPerSecond {getFilesPerSecond()};
+			if (filesPerSecond == 0)
+				return true;
+
+			const auto now {std::chrono::steady_clock::now()};
+			std::chrono::steady_clock::time_point slot;
+			{
+				const std::scoped_lock lock {_mutex};
+
+				// Do not accumulate credit while idle
+				_nextSlot = std::max(_nextSlot, now);
+				if (_nextSlot - now <= maxSleepDuration)
+				{
+					slot = _nextSlot;
+					_nextSlot += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds {1}) / filesPerSecond;
+				}
+			}
+
+			// Slot reserved, just wait for it
+			if (slot != std::chrono::steady_clock::time_point {})
+			{
+				std::this_thread::sleep_until(slot);
+				return !_abort;
+			}
+
+			// Too many waiting readers, check again later (the rate may have changed meanwhile)
+			std::this_thread::sleep_for(maxSleepDuration);
+		}
+	}
+
+	void
+	IoThrottle::applyIoPriority()
+	{
+		if (!_settings.idleIoPriority || ioPriorityApplied)
+			return;
+
+		ioPriorityApplied = true;
+
+		// Applies to the calling thread only
+		if (::syscall(SYS_ioprio_set, ioprioWhoProcess, 0, ioprioClassIdle << ioprioClassShift) < 0)
+			LMS_LOG(DBUPDATER, ERROR) << "Cannot set idle IO priority: " << ::strerror(errno);
+	}
+} // namespace Scanner
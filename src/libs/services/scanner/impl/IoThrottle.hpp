@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+namespace Scanner
+{
+	// Limits the rate at which the scanner reads files, to keep the storage responsive for the media playback
+	// Shared by all the parser workers
+	class IoThrottle
+	{
+		public:
+			struct Settings
+			{
+				std::size_t	maxFilesPerSecond {};		// 0 means unlimited
+				std::size_t	backoffFilesPerSecond {};	// used while media are being served, 0 means no back-off
+				bool		idleIoPriority {};			// use the idle I/O scheduling class for the scanner threads
+			};
+
+			IoThrottle(const Settings& settings, const std::atomic<bool>& abort);
+
+			IoThrottle(const IoThrottle&) = delete;
+			IoThrottle(IoThrottle&&) = delete;
+			IoThrottle& operator=(const IoThrottle&) = delete;
+			IoThrottle& operator=(IoThrottle&&) = delete;
+
+			// Blocks until the calling thread is allowed to read a file
+			// Returns false if aborted meanwhile
+			bool waitForFile();
+
+			// Once per thread, no-op if disabled
+			void applyIoPriority();
+
+		private:
+			std::size_t getFilesPerSecond() const;
+
+			const Settings							_settings;
+			const std::atomic<bool>&				_abort;
+			std::mutex								_mutex;
+			std::chrono::steady_clock::time_point	_nextSlot {};
+	};
+} // namespace Scanner
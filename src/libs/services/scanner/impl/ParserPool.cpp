@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ParserPool.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <mutex>
+
+#include "metadata/ContentHash.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Profiling.hpp"
+#include "utils/WorkBudget.hpp"
+
+namespace Scanner
+{
+	ParserPool::ParserPool(std::size_t workerCount, MetaData::TagLibParser::ReadStyle readStyle, bool memoryMapFiles, IoThrottle& ioThrottle)
+		: _ioThrottle {ioThrottle}
+	{
+		assert(workerCount > 0);
+
+		LMS_LOG(DBUPDATER, INFO) << "Using " << workerCount << " metadata parser worker(s)";
+
+		// For now, always use TagLib
+		for (std::size_t i {}; i < workerCount; ++i)
+			_parsers.emplace_back(std::make_unique<MetaData::TagLibParser>(readStyle, memoryMapFiles));
+
+		_ioService.setThreadCount(workerCount);
+		_ioService.start();
+	}
+
+	ParserPool::~ParserPool()
+	{
+		_ioService.stop();
+	}
+
+	void
+	ParserPool::setClusterTypeNames(const std::set<std::string>& clusterTypeNames)
+	{
+		for (std::unique_ptr<MetaData::IParser>& parser : _parsers)
+			parser->setClusterTypeNames(clusterTypeNames);
+	}
+
+	std::vector<ParserPool::ParseResult>
+	ParserPool::parse(const std::vector<FileToParse>& files)
+	{
+		std::vector<ParseResult> results(files.size());
+
+		const std::size_t jobCount {std::min(files.size(), _parsers.size())};
+		if (jobCount == 0)
+			return results;
+
+		std::atomic<std::size_t> nextFileIndex {};
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::size_t pendingJobCount {jobCount};
+
+		// Each job owns a parser and picks files until there is no more to process
+		for (std::size_t i {}; i < jobCount; ++i)
+		{
+			_ioService.post([&, parser = _parsers[i].get()]
+			{
+				const Profiling::ScopedLabel profilingLabel {"parsing_files"};
+				_ioThrottle.applyIoPriority();
+
+				for (std::size_t fileIndex {nextFileIndex++}; fileIndex < files.size(); fileIndex = nextFileIndex++)
+				{
+					const FileToParse& fileToParse {files[fileIndex]};
+					ParseResult& result {results[fileIndex]};
+
+					if (!_ioThrottle.waitForFile())
+						break;
+
+					const WorkBudget::ScopedSlot slot {WorkBudget::WorkClass::Background};
+
+					const auto start {std::chrono::steady_clock::now()};
+					result.track = fileToParse.tagsOnly ? parser->parseTags(fileToParse.file) : parser->parse(fileToParse.file);
+					result.duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+					std::error_code ec;
+					const std::uintmax_t fileSize {std::filesystem::file_size(fileToParse.file, ec)};
+					if (!ec)
+						result.fileSize = fileSize;
+
+					// Parsers may compute it while the file is open
+					if (result.track)
+						result.contentHash = !result.track->contentHash.empty() ? result.track->contentHash : MetaData::computeContentHash(fileToParse.file);
+				}
+
+				{
+					std::scoped_lock lock {mutex};
+					pendingJobCount--;
+				}
+				cv.notify_one();
+			});
+		}
+
+		std::unique_lock lock {mutex};
+		cv.wait(lock, [&] { return pendingJobCount == 0; });
+
+		return results;
+	}
+} // namespace Scanner
+
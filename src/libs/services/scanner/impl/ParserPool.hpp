@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <Wt/WIOService.h>
+
+#include "metadata/IParser.hpp"
+#include "metadata/TagLibParser.hpp"
+#include "IoThrottle.hpp"
+
+namespace Scanner
+{
+	// Parses files concurrently, each worker owning its own parser
+	class ParserPool
+	{
+		public:
+			ParserPool(std::size_t workerCount, MetaData::TagLibParser::ReadStyle readStyle, bool memoryMapFiles, IoThrottle& ioThrottle);
+			~ParserPool();
+
+			ParserPool(const ParserPool&) = delete;
+			ParserPool(ParserPool&&) = delete;
+			ParserPool& operator=(const ParserPool&) = delete;
+			ParserPool& operator=(ParserPool&&) = delete;
+
+			std::size_t getWorkerCount() const { return _parsers.size(); }
+
+			void setClusterTypeNames(const std::set<std::string>& clusterTypeNames);
+
+			struct FileToParse
+			{
+				std::filesystem::path	file;
+				bool					tagsOnly {};	// audio properties may be left empty
+			};
+
+			struct ParseResult
+			{
+				std::optional<MetaData::Track>	track;
+				std::uintmax_t					fileSize {};
+				std::string						contentHash;	// see computeContentHash
+				std::chrono::microseconds		duration {};
+			};
+
+			// Blocking call, results are given in the same order as the input files
+			// Files not parsed because the throttling was aborted have no track
+			std::vector<ParseResult> parse(const std::vector<FileToParse>& files);
+
+		private:
+			IoThrottle&	_ioThrottle;
+			Wt::WIOService _ioService;
+			std::vector<std::unique_ptr<MetaData::IParser>> _parsers;
+	};
+} // namespace Scanner
+
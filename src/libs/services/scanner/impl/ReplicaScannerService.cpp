@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ReplicaScannerService.hpp"
+
+#include "services/database/Db.hpp"
+#include "services/database/ScanSettings.hpp"
+#include "services/recommendation/IRecommendationService.hpp"
+#include "utils/Logger.hpp"
+
+namespace Scanner
+{
+	std::unique_ptr<IScannerService>
+	createReplicaScannerService(Database::Db& db, Recommendation::IRecommendationService& recommendationService, std::chrono::seconds pollPeriod)
+	{
+		return std::make_unique<ReplicaScannerService>(db, recommendationService, pollPeriod);
+	}
+
+	ReplicaScannerService::ReplicaScannerService(Database::Db& db, Recommendation::IRecommendationService& recommendationService, std::chrono::seconds pollPeriod)
+	: _recommendationService {recommendationService}
+	, _pollPeriod {pollPeriod}
+	, _dbSession {db}
+	{
+		LMS_LOG(DBUPDATER, INFO) << "Replica mode: scans are made by the primary instance, polling library changes every " << _pollPeriod.count() << "s";
+
+		_ioService.setThreadCount(1);
+		_ioService.post([this] { poll(); });
+		_ioService.start();
+	}
+
+	ReplicaScannerService::~ReplicaScannerService()
+	{
+		LMS_LOG(DBUPDATER, INFO) << "Stopping service...";
+		_pollTimer.cancel();
+		_recommendationService.cancelLoad();
+		_ioService.stop();
+		LMS_LOG(DBUPDATER, INFO) << "Service stopped!";
+	}
+
+	void
+	ReplicaScannerService::requestReload()
+	{
+		_ioService.post([this] { poll(); });
+	}
+
+	void
+	ReplicaScannerService::requestImmediateScan(bool)
+	{
+		LMS_LOG(DBUPDATER, WARNING) << "Scan request ignored: scans are made by the primary instance";
+	}
+
+	IScannerService::Status
+	ReplicaScannerService::getStatus() const
+	{
+		return {};
+	}
+
+	IScannerService::LibraryGeneration
+	ReplicaScannerService::getLibraryGeneration() const
+	{
+		std::shared_lock lock {_mutex};
+
+		return _libraryGeneration.value_or(LibraryGeneration {});
+	}
+
+	void
+	ReplicaScannerService::schedulePoll()
+	{
+		_pollTimer.expires_after(_pollPeriod);
+		_pollTimer.async_wait([this](const boost::system::error_code& ec)
+		{
+			if (ec)
+				return;
+
+			poll();
+		});
+	}
+
+	void
+	ReplicaScannerService::poll()
+	{
+		std::optional<std::size_t> libraryGeneration;
+		try
+		{
+			auto transaction {_dbSession.createSharedTransaction()};
+			libraryGeneration = Database::ScanSettings::get(_dbSession)->getLibraryGeneration();
+		}
+		catch (const std::exception& e)
+		{
+			LMS_LOG(DBUPDATER, ERROR) << "Cannot get library generation: " << e.what();
+		}
+
+		if (libraryGeneration)
+		{
+			bool changed {};
+			bool firstPoll {};
+			{
+				std::unique_lock lock {_mutex};
+
+				firstPoll = !_libraryGeneration;
+				changed = firstPoll || _libraryGeneration->value != *libraryGeneration;
+				if (changed)
+					_libraryGeneration = LibraryGeneration {*libraryGeneration, Wt::WDateTime::currentDateTime()};
+			}
+
+			if (changed)
+			{
+				LMS_LOG(DBUPDATER, INFO) << "Library generation = " << *libraryGeneration << (firstPoll ? "" : ", reloading");
+
+				_dbSession.getDb().buildClusterCatalog();
+
+				// Engines are reloaded from what the primary instance has computed
+				_recommendationService.load(!firstPoll);
+				if (!firstPoll)
+					_events.libraryChanged.emit();
+			}
+		}
+
+		schedulePoll();
+	}
+} // namespace Scanner
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <shared_mutex>
+
+#include <Wt/WIOService.h>
+#include <boost/asio/steady_timer.hpp>
+
+#include "services/database/Session.hpp"
+#include "services/scanner/IScannerService.hpp"
+
+namespace Recommendation
+{
+	class IRecommendationService;
+}
+
+namespace Scanner
+{
+	// Periodically polls the library generation written by the primary instance
+	// On change, reloads the similarity engines and notifies the listeners
+	class ReplicaScannerService : public IScannerService
+	{
+		public:
+			ReplicaScannerService(Database::Db& db, Recommendation::IRecommendationService& recommendationService, std::chrono::seconds pollPeriod);
+			~ReplicaScannerService();
+
+			ReplicaScannerService(const ReplicaScannerService&) = delete;
+			ReplicaScannerService(ReplicaScannerService&&) = delete;
+			ReplicaScannerService& operator=(const ReplicaScannerService&) = delete;
+			ReplicaScannerService& operator=(ReplicaScannerService&&) = delete;
+
+			void requestReload() override;
+			void requestImmediateScan(bool force) override;
+
+			Status	getStatus() const override;
+			LibraryGeneration getLibraryGeneration() const override;
+			Events&	getEvents() override { return _events; }
+
+		private:
+			void schedulePoll();
+			void poll();
+
+			Recommendation::IRecommendationService&	_recommendationService;
+			const std::chrono::seconds				_pollPeriod;
+			Database::Session						_dbSession;
+			Events									_events;
+			Wt::WIOService							_ioService;
+			boost::asio::steady_timer				_pollTimer {_ioService};
+
+			mutable std::shared_mutex				_mutex;
+			std::optional<LibraryGeneration>		_libraryGeneration; // not set until the first poll
+	};
+} // Scanner
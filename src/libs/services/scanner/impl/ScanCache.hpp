@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "services/database/Artist.hpp"
+#include "services/database/Cluster.hpp"
+#include "services/database/Release.hpp"
+
+namespace Scanner
+{
+	// Entities resolved while scanning files, in order to save database lookups
+	// Must be cleared once the scanned files are written, since entities may be removed afterwards
+	struct ScanCache
+	{
+		std::unordered_map<std::string, Database::Artist::pointer>	artistsByMBID;
+		std::unordered_map<std::string, Database::Artist::pointer>	artistsByName;					// only artists without MBID
+		std::unordered_map<std::string, Database::Artist::pointer>	artistsByNameWithMBIDFallback;	// any artist
+		std::unordered_map<std::string, Database::Release::pointer>	releasesByMBID;
+		std::unordered_map<std::string, Database::Release::pointer>	releasesByName;					// only releases without MBID
+		std::unordered_map<std::string, Database::ClusterType::pointer>				clusterTypes;	// null if the cluster type does not exist
+		std::map<std::pair<std::string, std::string>, Database::Cluster::pointer>	clusters;		// by cluster type name and cluster name
+
+		void clear()
+		{
+			artistsByMBID.clear();
+			artistsByName.clear();
+			artistsByNameWithMBIDFallback.clear();
+			releasesByMBID.clear();
+			releasesByName.clear();
+			clusterTypes.clear();
+			clusters.clear();
+		}
+	};
+} // namespace Scanner
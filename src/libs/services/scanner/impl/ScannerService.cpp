@@ -19,32 +19,168 @@
 
 #include "ScannerService.hpp"
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <ctime>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <boost/asio/placeholders.hpp>
 
 #include <Wt/WLocalDateTime.h>
 
 #include "services/database/Artist.hpp"
 #include "services/database/Cluster.hpp"
+#include "services/database/Db.hpp"
+#include "services/database/Directory.hpp"
+#include "services/database/MediaRoot.hpp"
 #include "services/database/Release.hpp"
 #include "services/database/ScanSettings.hpp"
 #include "services/database/Track.hpp"
 #include "services/database/TrackArtistLink.hpp"
 #include "services/database/TrackFeatures.hpp"
-#include "metadata/TagLibParser.hpp"
+#include "image/IRawImage.hpp"
+#include "metadata/ContentHash.hpp"
+#include "services/cover/ICoverService.hpp"
 #include "services/recommendation/IRecommendationService.hpp"
 #include "utils/Exception.hpp"
 #include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
 #include "utils/Path.hpp"
+#include "utils/Profiling.hpp"
 #include "utils/UUID.hpp"
+#include "utils/WorkBudget.hpp"
+#include "utils/http/IClient.hpp"
+#include "AcousticBrainzDump.hpp"
 #include "AcousticBrainzUtils.hpp"
+#include "ConcurrentFileExplorer.hpp"
 
 using namespace Database;
 
 namespace {
 
 const std::filesystem::path excludeDirFileName {".lmsignore"};
+constexpr std::chrono::seconds fileSystemWatcherSettleDelay {5};
+constexpr std::size_t featuresWriteBatchSize {50};
+
+// Used in the metrics and to label the profiles
+const char*
+getStepName(Scanner::ScanProgressStep step)
+{
+	switch (step)
+	{
+		case Scanner::ScanProgressStep::DiscoveringFiles:			return "discovering_files";
+		case Scanner::ScanProgressStep::ChekingForMissingFiles:		return "checking_for_missing_files";
+		case Scanner::ScanProgressStep::ScanningFiles:				return "scanning_files";
+		case Scanner::ScanProgressStep::RemovingOrphanEntries:		return "removing_orphan_entries";
+		case Scanner::ScanProgressStep::CheckingForDuplicates:		return "checking_for_duplicates";
+		case Scanner::ScanProgressStep::FetchingTrackFeatures:		return "fetching_track_features";
+		case Scanner::ScanProgressStep::ReloadingSimilarityEngine:	return "reloading_similarity_engine";
+		case Scanner::ScanProgressStep::GeneratingCovers:			return "generating_covers";
+		case Scanner::ScanProgressStep::ReclaimingDatabaseSpace:	return "reclaiming_database_space";
+	}
+
+	return "unknown";
+}
+
+// Accumulates the time spent in a scan step
+class ScopedStepTimer
+{
+	public:
+		ScopedStepTimer(Scanner::ScanStats& stats, Scanner::ScanProgressStep step)
+		: _stats {stats}
+		, _step {step}
+		, _profilingLabel {getStepName(step)}
+		{}
+
+		~ScopedStepTimer()
+		{
+			_stats.stepDurations[_step] += std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _start);
+		}
+
+		ScopedStepTimer(const ScopedStepTimer&) = delete;
+		ScopedStepTimer(ScopedStepTimer&&) = delete;
+		ScopedStepTimer& operator=(const ScopedStepTimer&) = delete;
+		ScopedStepTimer& operator=(ScopedStepTimer&&) = delete;
+
+	private:
+		Scanner::ScanStats&						_stats;
+		const Scanner::ScanProgressStep			_step;
+		const std::chrono::steady_clock::time_point	_start {std::chrono::steady_clock::now()};
+		const Profiling::ScopedLabel			_profilingLabel;
+};
+
+Metrics::Counter&
+getProcessedElemsCounter(Scanner::ScanProgressStep step)
+{
+	static const std::array<Metrics::Counter*, Scanner::ScanProgressStepCount> counters {[]
+	{
+		std::array<Metrics::Counter*, Scanner::ScanProgressStepCount> res;
+		for (unsigned i {}; i < Scanner::ScanProgressStepCount; ++i)
+			res[i] = &Metrics::getRegistry().createCounter("lms_scanner_processed_elements", "Number of elements processed by the scan steps", "step=\"" + std::string {getStepName(static_cast<Scanner::ScanProgressStep>(i))} + "\"");
+
+		return res;
+	}()};
+
+	return *counters[static_cast<unsigned>(step)];
+}
+
+std::size_t
+getParserWorkerCount()
+{
+	const unsigned long configParserWorkerCount {Service<IConfig>::get()->getULong("scanner-parser-thread-count", 0)};
+
+	return configParserWorkerCount ? configParserWorkerCount : std::max<unsigned long>(1, std::thread::hardware_concurrency());
+}
+
+Scanner::IoThrottle::Settings
+getIoThrottleSettings()
+{
+	Scanner::IoThrottle::Settings settings;
+	settings.maxFilesPerSecond = Service<IConfig>::get()->getULong("scanner-io-max-files-per-second", 0);
+	settings.backoffFilesPerSecond = Service<IConfig>::get()->getULong("scanner-io-backoff-files-per-second", 0);
+	settings.idleIoPriority = Service<IConfig>::get()->getBool("scanner-io-idle-priority", false);
+
+	return settings;
+}
+
+MetaData::TagLibParser::ReadStyle
+getParserReadStyle()
+{
+	const std::string readStyle {StringUtils::stringToLower(Service<IConfig>::get()->getString("scanner-parser-read-style", "fast"))};
+
+	if (readStyle == "fast")
+		return MetaData::TagLibParser::ReadStyle::Fast;
+	if (readStyle == "average")
+		return MetaData::TagLibParser::ReadStyle::Average;
+	if (readStyle == "accurate")
+		return MetaData::TagLibParser::ReadStyle::Accurate;
+
+	throw LmsException {"Bad value '" + readStyle + "' for 'scanner-parser-read-style'"};
+}
+
+std::vector<std::size_t>
+getCoverGenerationSizes()
+{
+	std::vector<std::size_t> sizes;
+
+	if (!Service<IConfig>::get()->getBool("scanner-generate-covers", false))
+		return sizes;
+
+	Service<IConfig>::get()->visitStrings("scanner-cover-generation-sizes",
+			[&](std::string_view str)
+			{
+				const std::optional<std::size_t> size {StringUtils::readAs<std::size_t>(str)};
+				if (!size || *size == 0)
+					throw LmsException {"Bad value '" + std::string {str} + "' for 'scanner-cover-generation-sizes'"};
+
+				sizes.push_back(*size);
+			}, {"128", "256", "512"});
+
+	return sizes;
+}
 
 Wt::WDate
 getNextMonday(Wt::WDate current)
@@ -68,6 +204,22 @@ getNextFirstOfMonth(Wt::WDate current)
 	return current;
 }
 
+std::optional<std::size_t>
+getDirectoryEntryCount(const std::filesystem::path& directory)
+{
+	std::error_code ec;
+	std::size_t count {};
+
+	std::filesystem::directory_iterator itEnd;
+	for (std::filesystem::directory_iterator itPath {directory, ec}; !ec && itPath != itEnd; itPath.increment(ec))
+		count++;
+
+	if (ec)
+		return std::nullopt;
+
+	return count;
+}
+
 bool
 isFileSupported(const std::filesystem::path& file, const std::unordered_set<std::filesystem::path>& extensions)
 {
@@ -76,6 +228,29 @@ isFileSupported(const std::filesystem::path& file, const std::unordered_set<std:
 	return (extensions.find(extension) != extensions.end());
 }
 
+bool
+isPathUnder(const std::filesystem::path& path, const std::filesystem::path& directory)
+{
+	auto itDirectory {std::cbegin(directory)};
+	for (auto itPath {std::cbegin(path)}; itPath != std::cend(path) && itDirectory != std::cend(directory); ++itPath, ++itDirectory)
+	{
+		if (*itPath != *itDirectory)
+			return false;
+	}
+
+	return itDirectory == std::cend(directory);
+}
+
+std::unordered_set<std::filesystem::path>
+toLowerExtensions(const std::vector<std::filesystem::path>& extensions)
+{
+	std::unordered_set<std::filesystem::path> res;
+	std::transform(std::cbegin(extensions), std::cend(extensions), std::inserter(res, std::begin(res)),
+			[](const std::filesystem::path& extension) { return std::filesystem::path {StringUtils::stringToLower(extension.string())}; });
+
+	return res;
+}
+
 bool
 isPathInMediaDirectory(const std::filesystem::path& path, const std::filesystem::path& rootPath)
 {
@@ -96,6 +271,22 @@ isPathInMediaDirectory(const std::filesystem::path& path, const std::filesystem:
 	return false;
 }
 
+static
+Database::AudioCodec
+toDatabaseAudioCodec(MetaData::AudioCodec codec)
+{
+	switch (codec)
+	{
+		case MetaData::AudioCodec::MP3:		return Database::AudioCodec::MP3;
+		case MetaData::AudioCodec::Opus:	return Database::AudioCodec::Opus;
+		case MetaData::AudioCodec::Vorbis:	return Database::AudioCodec::Vorbis;
+		case MetaData::AudioCodec::FLAC:	return Database::AudioCodec::FLAC;
+		case MetaData::AudioCodec::Unknown:	break;
+	}
+
+	return Database::AudioCodec::Unknown;
+}
+
 static
 Artist::pointer
 createArtist(Session& session, const MetaData::Artist& artistInfo)
@@ -128,7 +319,7 @@ updateArtistIfNeeded(Artist::pointer artist, const MetaData::Artist& artistInfo)
 }
 
 std::vector<Artist::pointer>
-getOrCreateArtists(Session& session, const std::vector<MetaData::Artist>& artistsInfo, bool allowFallbackOnMBIDEntries)
+getOrCreateArtists(Session& session, const std::vector<MetaData::Artist>& artistsInfo, bool allowFallbackOnMBIDEntries, Scanner::ScanCache& cache)
 {
 	std::vector<Artist::pointer> artists;
 
@@ -139,9 +330,13 @@ getOrCreateArtists(Session& session, const std::vector<MetaData::Artist>& artist
 		// First try to get by MBID
 		if (artistInfo.musicBrainzArtistID)
 		{
-			artist = Artist::find(session, *artistInfo.musicBrainzArtistID);
+			Artist::pointer& cachedArtist {cache.artistsByMBID[std::string {artistInfo.musicBrainzArtistID->getAsString()}]};
+			if (!cachedArtist)
+				cachedArtist = Artist::find(session, *artistInfo.musicBrainzArtistID);
+
+			artist = cachedArtist;
 			if (!artist)
-				artist = createArtist(session, artistInfo);
+				artist = cachedArtist = createArtist(session, artistInfo);
 			else
 				updateArtistIfNeeded(artist, artistInfo);
 
@@ -152,14 +347,24 @@ getOrCreateArtists(Session& session, const std::vector<MetaData::Artist>& artist
 		// Fall back on artist name (collisions may occur)
 		if (!artistInfo.name.empty())
 		{
-			for (const Artist::pointer& sameNamedArtist : Artist::find(session, artistInfo.name))
+			Artist::pointer& cachedArtist {(allowFallbackOnMBIDEntries ? cache.artistsByNameWithMBIDFallback : cache.artistsByName)[artistInfo.name]};
+
+			// Cached artist may have been renamed using its MBID in the meantime
+			if (cachedArtist && cachedArtist->getName() == artistInfo.name)
+			{
+				artist = cachedArtist;
+			}
+			else
 			{
-				// Do not fallback on artist that is correctly tagged
-				if (!allowFallbackOnMBIDEntries && sameNamedArtist->getMBID())
-					continue;
+				for (const Artist::pointer& sameNamedArtist : Artist::find(session, artistInfo.name))
+				{
+					// Do not fallback on artist that is correctly tagged
+					if (!allowFallbackOnMBIDEntries && sameNamedArtist->getMBID())
+						continue;
 
-				artist = sameNamedArtist;
-				break;
+					artist = sameNamedArtist;
+					break;
+				}
 			}
 
 			// No Artist found with the same name and without MBID -> creating
@@ -168,6 +373,7 @@ getOrCreateArtists(Session& session, const std::vector<MetaData::Artist>& artist
 			else
 				updateArtistIfNeeded(artist, artistInfo);
 
+			cachedArtist = artist;
 			artists.emplace_back(std::move(artist));
 			continue;
 		}
@@ -177,17 +383,30 @@ getOrCreateArtists(Session& session, const std::vector<MetaData::Artist>& artist
 }
 
 Release::pointer
-getOrCreateRelease(Session& session, const MetaData::Album& album)
+createRelease(Session& session, const std::string& name, const std::optional<UUID>& MBID, std::size_t addedGeneration)
+{
+	Release::pointer release {Release::create(session, name, MBID)};
+	release.modify()->setAdded(addedGeneration, Wt::WLocalDateTime::currentServerDateTime().toUTC());
+
+	return release;
+}
+
+Release::pointer
+getOrCreateRelease(Session& session, const MetaData::Album& album, std::size_t addedGeneration, Scanner::ScanCache& cache)
 {
 	Release::pointer release;
 
 	// First try to get by MBID
 	if (album.musicBrainzAlbumID)
 	{
-		release = Release::find(session, *album.musicBrainzAlbumID);
+		Release::pointer& cachedRelease {cache.releasesByMBID[std::string {album.musicBrainzAlbumID->getAsString()}]};
+		if (!cachedRelease)
+			cachedRelease = Release::find(session, *album.musicBrainzAlbumID);
+
+		release = cachedRelease;
 		if (!release)
 		{
-			release = Release::create(session, album.name, album.musicBrainzAlbumID);
+			release = cachedRelease = createRelease(session, album.name, album.musicBrainzAlbumID, addedGeneration);
 		}
 		else if (release->getName() != album.name)
 		{
@@ -201,6 +420,10 @@ getOrCreateRelease(Session& session, const MetaData::Album& album)
 	// Fall back on release name (collisions may occur)
 	if (!album.name.empty())
 	{
+		Release::pointer& cachedRelease {cache.releasesByName[album.name]};
+		if (cachedRelease)
+			return cachedRelease;
+
 		for (const Release::pointer& sameNamedRelease : Release::find(session, album.name))
 		{
 			// do not fallback on properly tagged releases
@@ -213,8 +436,9 @@ getOrCreateRelease(Session& session, const MetaData::Album& album)
 
 		// No release found with the same name and without MBID -> creating
 		if (!release)
-			release = Release::create(session, album.name);
+			release = createRelease(session, album.name, std::nullopt, addedGeneration);
 
+		cachedRelease = release;
 		return release;
 	}
 
@@ -222,19 +446,25 @@ getOrCreateRelease(Session& session, const MetaData::Album& album)
 }
 
 std::vector<Cluster::pointer>
-getOrCreateClusters(Session& session, const MetaData::Clusters& clustersNames)
+getOrCreateClusters(Session& session, const MetaData::Clusters& clustersNames, Scanner::ScanCache& cache)
 {
 	std::vector< Cluster::pointer > clusters;
 
-	for (auto clusterNames : clustersNames)
+	for (const auto& [clusterTypeName, clusterNames] : clustersNames)
 	{
-		auto clusterType = ClusterType::find(session, clusterNames.first);
+		auto itClusterType {cache.clusterTypes.find(clusterTypeName)};
+		if (itClusterType == std::cend(cache.clusterTypes))
+			itClusterType = cache.clusterTypes.emplace(clusterTypeName, ClusterType::find(session, clusterTypeName)).first;
+
+		const ClusterType::pointer clusterType {itClusterType->second};
 		if (!clusterType)
 			continue;
 
-		for (auto clusterName : clusterNames.second)
+		for (const std::string& clusterName : clusterNames)
 		{
-			auto cluster = clusterType->getCluster(clusterName);
+			Cluster::pointer& cluster {cache.clusters[{clusterTypeName, clusterName}]};
+			if (!cluster)
+				cluster = clusterType->getCluster(clusterName);
 			if (!cluster)
 				cluster = Cluster::create(session, clusterType, clusterName);
 
@@ -245,6 +475,24 @@ getOrCreateClusters(Session& session, const MetaData::Clusters& clustersNames)
 	return clusters;
 }
 
+// Uses several transactions to let readers go
+void
+removeTracks(Session& session, const std::vector<TrackId>& trackIds)
+{
+	// SQLite limits the number of bound parameters per query
+	constexpr std::size_t batchSize {500};
+
+	for (std::size_t offset {}; offset < trackIds.size(); offset += batchSize)
+	{
+		const auto itBegin {std::cbegin(trackIds) + offset};
+		const auto itEnd {itBegin + std::min(batchSize, trackIds.size() - offset)};
+
+		auto transaction {session.createUniqueTransaction()};
+
+		Track::removeByIds(session, std::vector<TrackId>(itBegin, itEnd));
+	}
+}
+
 } // namespace
 
 namespace Scanner {
@@ -258,16 +506,52 @@ createScannerService(Db& db, Recommendation::IRecommendationService& recommendat
 ScannerService::ScannerService(Db& db, Recommendation::IRecommendationService& recommendationService)
 : _recommendationService {recommendationService}
 , _skipDuplicateRecordingMBID {Service<IConfig>::get()->getBool("scanner-skip-duplicate-recording-mbid", false)}
+, _writeBatchSize {std::max<std::size_t>(1, Service<IConfig>::get()->getULong("scanner-write-batch-size", 500))}
+, _writeBatchMaxDuration {Service<IConfig>::get()->getULong("scanner-write-batch-max-duration-ms", 2000)}
+, _skipUnchangedDirectories {Service<IConfig>::get()->getBool("scanner-skip-unchanged-directories", false)}
+, _directoryWalkerCount {Service<IConfig>::get()->getULong("scanner-directory-walker-count", 4)}
+, _featuresFetchMaxConcurrentRequests {std::max<std::size_t>(1, Service<IConfig>::get()->getULong("scanner-features-fetch-max-concurrent-requests", 4))}
+, _featuresDumpPath {Service<IConfig>::get()->getPath("scanner-features-dump-path")}
+, _reuseUnchangedAudioProperties {Service<IConfig>::get()->getBool("scanner-reuse-unchanged-audio-properties", false)}
+, _buildLibraryIndex {Service<IConfig>::get()->getBool("db-library-index", false)}
 , _dbSession {db}
+, _ioThrottle {getIoThrottleSettings(), _abortScan}
+, _parserPool {getParserWorkerCount(), getParserReadStyle(), Service<IConfig>::get()->getBool("scanner-parser-mmap", false), _ioThrottle}
+, _coverGenerationSizes {getCoverGenerationSizes()}
+, _coverGenerationThreadCount {std::max<std::size_t>(1, Service<IConfig>::get()->getULong("scanner-cover-generation-thread-count", 1))}
+, _databaseVacuumStepPageCount {Service<IConfig>::get()->getULong("scanner-db-vacuum-step-page-count", 256)}
 {
 	LMS_LOG(DBUPDATER, INFO) << "skipDuplicateRecordingMBID = " << _skipDuplicateRecordingMBID;
-
-	// For now, always use TagLib
-	_metadataParser = std::make_unique<MetaData::TagLibParser>();
+	LMS_LOG(DBUPDATER, INFO) << "writeBatchSize = " << _writeBatchSize << ", writeBatchMaxDuration = " << _writeBatchMaxDuration.count() << "ms";
+	LMS_LOG(DBUPDATER, INFO) << "skipUnchangedDirectories = " << _skipUnchangedDirectories;
+	LMS_LOG(DBUPDATER, INFO) << "featuresFetchMaxConcurrentRequests = " << _featuresFetchMaxConcurrentRequests;
+	LMS_LOG(DBUPDATER, INFO) << "featuresDumpPath = '" << _featuresDumpPath.string() << "'";
+	LMS_LOG(DBUPDATER, INFO) << "reuseUnchangedAudioProperties = " << _reuseUnchangedAudioProperties;
+	LMS_LOG(DBUPDATER, INFO) << "buildLibraryIndex = " << _buildLibraryIndex;
+	LMS_LOG(DBUPDATER, INFO) << "coverGenerationSizeCount = " << _coverGenerationSizes.size() << ", coverGenerationThreadCount = " << _coverGenerationThreadCount;
+	LMS_LOG(DBUPDATER, INFO) << "databaseVacuumStepPageCount = " << _databaseVacuumStepPageCount;
 
 	_ioService.setThreadCount(1);
 
+	if (!_coverGenerationSizes.empty())
+	{
+		_coverGenerationIOService.setThreadCount(_coverGenerationThreadCount);
+		_coverGenerationIOService.start();
+	}
+
+	if (Service<IConfig>::get()->getBool("scanner-watch-media-directory", false))
+	{
+		_fileSystemWatcher = std::make_unique<FileSystemWatcher>(_ioService, fileSystemWatcherSettleDelay, [this](FileSystemWatcher::Changes&& changes)
+		{
+			processFileSystemChanges(changes);
+		});
+	}
+
 	refreshScanSettings();
+	{
+		auto transaction {_dbSession.createSharedTransaction()};
+		_libraryGeneration.value = ScanSettings::get(_dbSession)->getLibraryGeneration();
+	}
 
 	start();
 }
@@ -276,6 +560,8 @@ ScannerService::~ScannerService()
 {
 	LMS_LOG(DBUPDATER, INFO) << "Stopping service...";
 	stop();
+	if (!_coverGenerationSizes.empty())
+		_coverGenerationIOService.stop();
 	LMS_LOG(DBUPDATER, INFO) << "Service stopped!";
 }
 
@@ -289,6 +575,8 @@ ScannerService::start()
 		if (_abortScan)
 			return;
 
+		buildLibraryIndex();
+		_dbSession.getDb().buildClusterCatalog();
 		_recommendationService.load(false,
 				[](const Recommendation::Progress& progress)
 				{
@@ -370,12 +658,56 @@ ScannerService::getStatus() const
 	return res;
 }
 
+ScannerService::LibraryGeneration
+ScannerService::getLibraryGeneration() const
+{
+	std::shared_lock lock {_statusMutex};
+
+	return _libraryGeneration;
+}
+
+void
+ScannerService::notifyLibraryChanged()
+{
+	std::size_t libraryGeneration;
+	{
+		auto transaction {_dbSession.createUniqueTransaction()};
+
+		ScanSettings::pointer scanSettings {ScanSettings::get(_dbSession)};
+		scanSettings.modify()->incLibraryGeneration();
+		libraryGeneration = scanSettings->getLibraryGeneration();
+	}
+
+	{
+		std::unique_lock lock {_statusMutex};
+
+		_libraryGeneration.value = libraryGeneration;
+		_libraryGeneration.lastChangeDateTime = Wt::WDateTime::currentDateTime();
+	}
+
+	buildLibraryIndex();
+	_dbSession.getDb().buildClusterCatalog();
+
+	_events.libraryChanged.emit();
+}
+
+void
+ScannerService::buildLibraryIndex()
+{
+	if (!_buildLibraryIndex)
+		return;
+
+	LMS_LOG(DBUPDATER, INFO) << "Building library index...";
+	_dbSession.getDb().buildLibraryIndex();
+}
+
 void
 ScannerService::scheduleNextScan()
 {
 	LMS_LOG(DBUPDATER, INFO) << "Scheduling next scan";
 
 	refreshScanSettings();
+	updateWatchedDirectory();
 
 	const Wt::WDateTime now {Wt::WLocalDateTime::currentServerDateTime().toUTC()};
 
@@ -424,29 +756,39 @@ ScannerService::scheduleNextScan()
 	_events.scanScheduled.emit(_nextScheduledScan);
 }
 
-void
-ScannerService::countAllFiles(ScanStats& stats)
+ScannerService::DiscoveredFiles
+ScannerService::discoverFiles(ScanStats& stats)
 {
 	ScanStepStats stepStats{stats.startTime, ScanProgressStep::DiscoveringFiles};
+	ScopedStepTimer stepTimer {stats, ScanProgressStep::DiscoveringFiles};
+
+	DiscoveredFiles discoveredFiles;
 
 	stats.filesScanned = 0;
 	notifyInProgress(stepStats);
 
-	exploreFilesRecursive(_mediaDirectory, [&](std::error_code ec, const std::filesystem::path& path)
+	exploreFilesConcurrently(getMediaRootDirectories(), createSupportedFileFilter(), [&](std::size_t, std::error_code ec, const std::filesystem::path& path)
 	{
 		if (_abortScan)
 			return false;
 
-		if (!ec && isFileSupported(path, _fileExtensions))
+		if (ec)
+		{
+			discoveredFiles.errors = true;
+		}
+		else
 		{
+			discoveredFiles.files.insert(path);
 			stats.filesScanned++;
 			stepStats.processedElems++;
 			notifyInProgressIfNeeded(stepStats);
 		}
 
 		return true;
-	}, excludeDirFileName);
+	}, excludeDirFileName, _directoryWalkerCount);
 	notifyInProgress(stepStats);
+
+	return discoveredFiles;
 }
 
 void
@@ -494,33 +836,65 @@ ScannerService::scan(bool forceScan)
 
 	LMS_LOG(UI, INFO) << "New scan started!";
 
+	// Directory walks and moved file checks are done by this thread, the walk workers inherit its priority
+	_ioThrottle.applyIoPriority();
+
 	refreshScanSettings();
+	forceScan = startOrResumeForcedScan(forceScan);
 
-	removeMissingTracks(stats);
+	LMS_LOG(DBUPDATER, DEBUG) << "Discovering files in " << _mediaRoots.size() << " media root(s)...";
+	{
+		const DiscoveredFiles discoveredFiles {discoverFiles(stats)};
+		LMS_LOG(DBUPDATER, DEBUG) << "-> Nb files = " << stats.filesScanned;
 
-	LMS_LOG(DBUPDATER, DEBUG) << "Counting files in media directory '" << _mediaDirectory.string() << "'...";
-	countAllFiles(stats);
-	LMS_LOG(DBUPDATER, DEBUG) << "-> Nb files = " << stats.filesScanned;
+		removeMissingTracks(discoveredFiles, stats);
+	}
 
 	LMS_LOG(UI, INFO) << "Checks complete, force scan = " << forceScan;
 
-	LMS_LOG(DBUPDATER, INFO) << "scaning media directory '" << _mediaDirectory.string() << "'...";
-	scanMediaDirectory(_mediaDirectory, forceScan, stats);
-	LMS_LOG(DBUPDATER, INFO) << "scaning media directory '" << _mediaDirectory.string() << "' DONE";
+	LMS_LOG(DBUPDATER, INFO) << "Scanning " << _mediaRoots.size() << " media root(s)...";
+	scanMediaRoots(forceScan, stats);
+	LMS_LOG(DBUPDATER, INFO) << "Scanning " << _mediaRoots.size() << " media root(s) DONE";
 
-	removeOrphanEntries();
+	// The next steps are resumable by themselves
+	if (forceScan && !_abortScan)
+		completeForcedScan();
+
+	// Even if the scan is aborted, these tracks are known to be missing
+	removeUnmatchedMissingTracks(stats);
+
+	removeOrphanEntries(stats);
+	updateArtistSummaries();
 
 	if (!_abortScan)
 	{
 		checkDuplicatedAudioFiles(stats);
 		fetchTrackFeatures(stats);
 		reloadSimilarityEngine(stats);
+		updateReleaseCoverPaths();
+		generateCovers(stats);
+		reclaimDatabaseSpace(stats);
 	}
+	// not done for aborted scans
+	_changedReleaseIds.clear();
 
 	LMS_LOG(DBUPDATER, INFO) << "Scan " << (_abortScan ? "aborted" : "complete") << ". Changes = " << stats.nbChanges() << " (added = " << stats.additions << ", removed = " << stats.deletions << ", updated = " << stats.updates << "), Not changed = " << stats.skips << ", Scanned = " << stats.scans << " (errors = " << stats.errors.size() << "), features fetched = " << stats.featuresFetched << ",  duplicates = " << stats.duplicates.size();
+	LMS_LOG(DBUPDATER, INFO) << "Scan metrics: discovery = " << stats.getStepDuration(ScanProgressStep::DiscoveringFiles).count() << "ms"
+		<< ", missing files check = " << stats.getStepDuration(ScanProgressStep::ChekingForMissingFiles).count() << "ms"
+		<< ", file scan = " << stats.getStepDuration(ScanProgressStep::ScanningFiles).count() << "ms (" << stats.getScanRate() << " files/s, " << stats.bytesScanned << " bytes)"
+		<< ", features fetch = " << stats.getStepDuration(ScanProgressStep::FetchingTrackFeatures).count() << "ms"
+		<< ", similarity engine reload = " << stats.getStepDuration(ScanProgressStep::ReloadingSimilarityEngine).count() << "ms"
+		<< ", cover generation = " << stats.getStepDuration(ScanProgressStep::GeneratingCovers).count() << "ms"
+		<< ", database space reclaim = " << stats.getStepDuration(ScanProgressStep::ReclaimingDatabaseSpace).count() << "ms (" << stats.reclaimedDatabaseBytes << " bytes)"
+		<< ", parse p50/p99 = " << stats.parseDurations.getPercentile(50).count() << "/" << stats.parseDurations.getPercentile(99).count() << "us"
+		<< ", write p50/p99 = " << stats.writeDurations.getPercentile(50).count() << "/" << stats.writeDurations.getPercentile(99).count() << "us";
 
 	_dbSession.optimize();
 
+	// Even aborted scans may have changed the library
+	if (stats.nbChanges() > 0)
+		notifyLibraryChanged();
+
 	if (!_abortScan)
 	{
 		stats.stopTime = Wt::WLocalDateTime::currentDateTime().toUTC();
@@ -548,38 +922,50 @@ ScannerService::scan(bool forceScan)
 }
 
 bool
-ScannerService::fetchTrackFeatures(TrackId trackId, const UUID& recordingMBID)
+ScannerService::startOrResumeForcedScan(bool forceScan)
 {
-	std::map<std::string, double> features;
-
-	LMS_LOG(DBUPDATER, INFO) << "Fetching low level features for recording '" << recordingMBID.getAsString() << "'";
-	const std::string data {AcousticBrainz::extractLowLevelFeatures(recordingMBID)};
-	if (data.empty())
+	if (_forcedScanInProgress)
 	{
-		LMS_LOG(DBUPDATER, ERROR) << "Track " << trackId.getValue() << ", recording MBID = '" << recordingMBID.getAsString() << "': cannot extract features using AcousticBrainz";
-		return false;
+		LMS_LOG(DBUPDATER, INFO) << "Resuming interrupted forced scan";
+		return true;
 	}
 
-	{
-		auto uniqueTransaction {_dbSession.createUniqueTransaction()};
+	if (!forceScan)
+		return false;
 
-		Track::pointer track {Track::find(_dbSession, trackId)};
-		if (!track)
-			return false;
+	{
+		auto transaction {_dbSession.createUniqueTransaction()};
 
-		TrackFeatures::create(_dbSession, track, data);
+		ScanSettings::pointer scanSettings {ScanSettings::get(_dbSession)};
+		scanSettings.modify()->incScanVersion();
+		scanSettings.modify()->setForcedScanInProgress(true);
 	}
+	refreshScanSettings();
 
 	return true;
 }
 
+void
+ScannerService::completeForcedScan()
+{
+	{
+		auto transaction {_dbSession.createUniqueTransaction()};
+
+		ScanSettings::get(_dbSession).modify()->setForcedScanInProgress(false);
+	}
+
+	_forcedScanInProgress = false;
+}
+
 void
 ScannerService::fetchTrackFeatures(ScanStats& stats)
 {
-	if (_recommendationServiceType != ScanSettings::RecommendationEngineType::Features)
+	if (_recommendationServiceType != ScanSettings::RecommendationEngineType::Features
+			&& _recommendationServiceType != ScanSettings::RecommendationEngineType::Hnsw)
 		return;
 
 	ScanStepStats stepStats{stats.startTime, ScanProgressStep::FetchingTrackFeatures};
+	ScopedStepTimer stepTimer {stats, ScanProgressStep::FetchingTrackFeatures};
 
 	LMS_LOG(DBUPDATER, INFO) << "Fetching missing track features...";
 
@@ -610,18 +996,137 @@ ScannerService::fetchTrackFeatures(ScanStats& stats)
 
 	LMS_LOG(DBUPDATER, INFO) << "Found " << tracksToFetch.size() << " track(s) to fetch!";
 
-	for (const TrackInfo& trackToFetch : tracksToFetch)
+	// Fetched features are written by batches
+	struct FetchedFeatures
 	{
-		if (_abortScan)
-			return;
+		TrackId		trackId;
+		std::string	data;
+	};
+	std::vector<FetchedFeatures> fetchedFeatures;
+
+	auto writeFetchedFeatures {[&]
+	{
+		auto uniqueTransaction {_dbSession.createUniqueTransaction()};
+
+		for (const FetchedFeatures& features : fetchedFeatures)
+		{
+			const Track::pointer track {Track::find(_dbSession, features.trackId)};
+			if (!track)
+				continue;
 
-		if (fetchTrackFeatures(trackToFetch.id, trackToFetch.recordingMBID))
+			TrackFeatures::create(_dbSession, track, features.data);
 			stats.featuresFetched++;
+		}
 
-		stepStats.processedElems++;
-		notifyInProgressIfNeeded(stepStats);
+		fetchedFeatures.clear();
+	}};
+
+	if (!_featuresDumpPath.empty())
+	{
+		// No network access: the documents are read from a local dump, in a single pass
+		std::unordered_map<std::string, std::vector<TrackId>> trackIdsByRecordingMBID;
+		for (const TrackInfo& trackToFetch : tracksToFetch)
+			trackIdsByRecordingMBID[trackToFetch.recordingMBID.getAsString()].push_back(trackToFetch.id);
+
+		if (!trackIdsByRecordingMBID.empty())
+		{
+			try
+			{
+				AcousticBrainz::visitLowLevelDump(_featuresDumpPath,
+					[&](std::string_view recordingMBID)
+					{
+						return trackIdsByRecordingMBID.find(std::string {recordingMBID}) != std::cend(trackIdsByRecordingMBID);
+					},
+					[&](std::string_view recordingMBID, std::string_view document)
+					{
+						// Only the first submission of each recording is used
+						auto itTrackIds {trackIdsByRecordingMBID.find(std::string {recordingMBID})};
+						for (const TrackId trackId : itTrackIds->second)
+							fetchedFeatures.emplace_back(FetchedFeatures {trackId, std::string {document}});
+
+						stepStats.processedElems += itTrackIds->second.size();
+						trackIdsByRecordingMBID.erase(itTrackIds);
+
+						if (fetchedFeatures.size() >= _writeBatchSize)
+							writeFetchedFeatures();
+
+						notifyInProgressIfNeeded(stepStats);
+						return !_abortScan && !trackIdsByRecordingMBID.empty();
+					});
+			}
+			catch (const LmsException& e)
+			{
+				LMS_LOG(DBUPDATER, ERROR) << "Cannot import features from dump '" << _featuresDumpPath.string() << "': " << e.what();
+			}
+		}
+
+		if (!_abortScan)
+			LMS_LOG(DBUPDATER, INFO) << trackIdsByRecordingMBID.size() << " recording(s) not found in the dump";
+	}
+	else
+	{
+		// Each client sends its requests one by one: use several clients to have requests in flight concurrently
+		boost::asio::io_context ioContext;
+		std::vector<std::unique_ptr<Http::IClient>> clients;
+		{
+			const std::string baseUrl {AcousticBrainz::getAPIBaseUrl()};
+			const std::size_t clientCount {std::min(_featuresFetchMaxConcurrentRequests, tracksToFetch.size())};
+			for (std::size_t i {}; i < clientCount; ++i)
+				clients.emplace_back(Http::createClient(ioContext, baseUrl, AcousticBrainz::maxResponseSize));
+		}
+
+		std::size_t nextTrackIndex {};
+		std::function<void(Http::IClient&)> fetchNext;
+		fetchNext = [&](Http::IClient& client)
+		{
+			if (_abortScan)
+			{
+				ioContext.stop();
+				return;
+			}
+
+			if (nextTrackIndex == tracksToFetch.size())
+				return;
+
+			const TrackInfo& trackToFetch {tracksToFetch[nextTrackIndex++]};
+
+			auto onDone {[&, clientPtr = &client]
+			{
+				stepStats.processedElems++;
+				notifyInProgressIfNeeded(stepStats);
+
+				fetchNext(*clientPtr);
+			}};
+
+			Http::ClientGETRequestParameters request;
+			request.relativeUrl = AcousticBrainz::getLowLevelFeaturesRelativeUrl(trackToFetch.recordingMBID);
+			request.onSuccessFunc = [&, onDone, trackId = trackToFetch.id](std::string_view msgBody)
+			{
+				fetchedFeatures.emplace_back(FetchedFeatures {trackId, std::string {msgBody}});
+				if (fetchedFeatures.size() >= featuresWriteBatchSize)
+					writeFetchedFeatures();
+
+				onDone();
+			};
+			request.onFailureFunc = [&, onDone, trackId = trackToFetch.id]
+			{
+				LMS_LOG(DBUPDATER, ERROR) << "Track " << trackId.getValue() << ": cannot extract features using AcousticBrainz";
+				onDone();
+			};
+
+			client.sendGETRequest(std::move(request));
+		};
+
+		for (const std::unique_ptr<Http::IClient>& client : clients)
+			fetchNext(*client);
+
+		ioContext.run();
 	}
 
+	// Keep what has already been fetched, even if aborted
+	if (!fetchedFeatures.empty())
+		writeFetchedFeatures();
+
 	notifyInProgress(stepStats);
 	LMS_LOG(DBUPDATER, INFO) << "Track features fetched!";
 }
@@ -629,6 +1134,9 @@ ScannerService::fetchTrackFeatures(ScanStats& stats)
 void
 ScannerService::refreshScanSettings()
 {
+	// Cluster types may have changed
+	_scanCache.clear();
+
 	auto transaction {_dbSession.createSharedTransaction()};
 
 	const ScanSettings::pointer scanSettings {ScanSettings::get(_dbSession)};
@@ -638,14 +1146,25 @@ ScannerService::refreshScanSettings()
 	_scanVersion = scanSettings->getScanVersion();
 	_startTime = scanSettings->getUpdateStartTime();
 	_updatePeriod = scanSettings->getUpdatePeriod();
+	_forcedScanInProgress = scanSettings->isForcedScanInProgress();
 
 	{
-		const auto fileExtensions {scanSettings->getAudioFileExtensions()};
-		_fileExtensions.clear();
-		std::transform(std::cbegin(fileExtensions), std::end(fileExtensions), std::inserter(_fileExtensions, std::begin(_fileExtensions)),
-				[](const std::filesystem::path& extension) { return std::filesystem::path{ StringUtils::stringToLower(extension.string()) }; });
+		const std::unordered_set<std::filesystem::path> defaultFileExtensions {toLowerExtensions(scanSettings->getAudioFileExtensions())};
+
+		_mediaRoots.clear();
+		for (const Database::MediaRoot::pointer& mediaRoot : scanSettings->getMediaRoots())
+		{
+			// Ordered by directory: parent roots come first
+			if (const MediaRoot* parentMediaRoot {findMediaRoot(mediaRoot->getDirectory())})
+			{
+				LMS_LOG(DBUPDATER, WARNING) << "Ignoring media root '" << mediaRoot->getDirectory().string() << "': already part of media root '" << parentMediaRoot->directory.string() << "'";
+				continue;
+			}
+
+			const auto fileExtensions {mediaRoot->getAudioFileExtensions()};
+			_mediaRoots.emplace_back(MediaRoot {mediaRoot->getDirectory(), fileExtensions.empty() ? defaultFileExtensions : toLowerExtensions(fileExtensions)});
+		}
 	}
-	_mediaDirectory = scanSettings->getMediaDirectory();
 	_recommendationServiceType = scanSettings->getRecommendationEngineType();
 
 	const auto clusterTypes = scanSettings->getClusterTypes();
@@ -655,16 +1174,21 @@ ScannerService::refreshScanSettings()
 			std::inserter(clusterTypeNames, clusterTypeNames.begin()),
 			[](ClusterType::pointer clusterType) { return clusterType->getName(); });
 
-	_metadataParser->setClusterTypeNames(clusterTypeNames);
+	_parserPool.setClusterTypeNames(clusterTypeNames);
 }
 
 void
 ScannerService::notifyInProgress(const ScanStepStats& stepStats)
 {
+	std::size_t newProcessedElems {stepStats.processedElems};
 	{
 		std::unique_lock lock {_statusMutex};
+		if (_currentScanStepStats && _currentScanStepStats->currentStep == stepStats.currentStep && _currentScanStepStats->processedElems <= stepStats.processedElems)
+			newProcessedElems -= _currentScanStepStats->processedElems;
+
 		_currentScanStepStats = stepStats;
 	}
+	getProcessedElemsCounter(stepStats.currentStep).add(newProcessedElems);
 
 	const std::chrono::system_clock::time_point now {std::chrono::system_clock::now()};
 	_events.scanInProgress(stepStats);
@@ -680,8 +1204,8 @@ ScannerService::notifyInProgressIfNeeded(const ScanStepStats& stepStats)
 		notifyInProgress(stepStats);
 }
 
-void
-ScannerService::scanAudioFile(const std::filesystem::path& file, bool forceScan, ScanStats& stats)
+std::optional<ScannerService::FileToScan>
+ScannerService::checkAudioFile(const std::filesystem::path& file, bool forceScan, ScanStats& stats)
 {
 	Wt::WDateTime lastWriteTime;
 	try
@@ -692,60 +1216,205 @@ ScannerService::scanAudioFile(const std::filesystem::path& file, bool forceScan,
 	{
 		LMS_LOG(DBUPDATER, ERROR) << e.what();
 		stats.skips++;
-		return;
+		return std::nullopt;
 	}
 
-	if (!forceScan)
+	FileToScan fileToScan {file, lastWriteTime};
+
+	bool isKnownFile {};
 	{
-		// Skip file if last write is the same
 		auto transaction {_dbSession.createSharedTransaction()};
 
 		const Track::pointer track {Track::findByPath(_dbSession, file)};
+		isKnownFile = static_cast<bool>(track);
 
-		if (track && track->getLastWriteTime().toTime_t() == lastWriteTime.toTime_t()
-				&& track->getScanVersion() == _scanVersion)
+		// Skip file if last write is the same
+		// Forced scans bumped the scan version: files already scanned by an interrupted forced scan are skipped as well
+		if (track && track->getLastWriteTime().toTime_t() == lastWriteTime.toTime_t())
 		{
-			stats.skips++;
-			return;
+			if (track->getScanVersion() == _scanVersion)
+			{
+				stats.skips++;
+				return std::nullopt;
+			}
+
+			// Only the scan settings changed: the audio content is the same
+			if (!forceScan && _reuseUnchangedAudioProperties && track->getDuration() > std::chrono::milliseconds::zero() && track->getBitrate() > 0)
+				fileToScan.previousDuration = track->getDuration();
 		}
 	}
 
-	std::optional<MetaData::Track> trackInfo {_metadataParser->parse(file)};
-	if (!trackInfo)
-	{
-		stats.errors.emplace_back(file, ScanErrorType::CannotParseFile);
+	if (!isKnownFile && !_missingTracksByContentHash.empty())
+		checkMovedAudioFile(fileToScan);
+
+	return fileToScan;
+}
+
+void
+ScannerService::checkMovedAudioFile(FileToScan& fileToScan)
+{
+	const std::string contentHash {MetaData::computeContentHash(fileToScan.file)};
+	if (contentHash.empty())
 		return;
-	}
 
-	stats.scans++;
+	auto itMissingTracks {_missingTracksByContentHash.find(contentHash)};
+	if (itMissingTracks == std::end(_missingTracksByContentHash))
+		return;
 
-	auto uniqueTransaction {_dbSession.createUniqueTransaction()};
+	// Several missing tracks may have the same content, any of them will do
+	const TrackId movedTrackId {itMissingTracks->second.back()};
+	itMissingTracks->second.pop_back();
+	if (itMissingTracks->second.empty())
+		_missingTracksByContentHash.erase(itMissingTracks);
 
-	Track::pointer track {Track::findByPath(_dbSession, file) };
+	auto transaction {_dbSession.createSharedTransaction()};
 
-	// Skip duplicate recording MBID
-	if (trackInfo->recordingMBID && _skipDuplicateRecordingMBID)
-	{
-		for (Track::pointer otherTrack : Track::findByRecordingMBID(_dbSession, *trackInfo->recordingMBID))
-		{
-			if (track && track->getId() == otherTrack->getId())
-				continue;
+	const Track::pointer track {Track::find(_dbSession, movedTrackId)};
+	if (!track)
+		return;
 
-			LMS_LOG(DBUPDATER, DEBUG) << "Skipped '" << file.string() << "' (similar recording MBID in '" << otherTrack->getPath().string() << "')";
-			// This recording MBID already exists, just remove what we just scanned
-			if (track)
-			{
-				track.remove();
-				stats.deletions++;
-			}
-			return;
-		}
-	}
+	fileToScan.movedTrackId = movedTrackId;
+
+	// Same content: just update the path, unless the scan settings changed
+	if (track->getScanVersion() == _scanVersion)
+		fileToScan.moveOnly = true;
+	else if (_reuseUnchangedAudioProperties && track->getDuration() > std::chrono::milliseconds::zero() && track->getBitrate() > 0)
+		fileToScan.previousDuration = track->getDuration();
+}
+
+void
+ScannerService::scanAudioFiles(const std::vector<FileToScan>& files, ScanStats& stats)
+{
+	std::vector<ParserPool::FileToParse> filesToParse;
+	filesToParse.reserve(files.size());
+	for (const FileToScan& fileToScan : files)
+	{
+		if (!fileToScan.moveOnly)
+			filesToParse.push_back(ParserPool::FileToParse {fileToScan.file, fileToScan.previousDuration.has_value()});
+	}
+
+	// Parsing is done concurrently, but the database is updated in the same order as the files were discovered
+	const std::vector<ParserPool::ParseResult> parseResults {_parserPool.parse(filesToParse)};
+	for (const ParserPool::ParseResult& parseResult : parseResults)
+	{
+		stats.bytesScanned += parseResult.fileSize;
+		stats.parseDurations.add(parseResult.duration);
+	}
+
+	// Each file is written within a savepoint: a file that cannot be written does not discard the rest of its batch
+	Wt::Dbo::Session& dboSession {_dbSession.getDboSession()};
+	auto writeFile {[&](const FileToScan& fileToScan, const std::function<void()>& write)
+	{
+		dboSession.execute("SAVEPOINT scan_file");
+		try
+		{
+			write();
+			dboSession.flush(); // report the write errors of this very file
+			dboSession.execute("RELEASE scan_file");
+			return true;
+		}
+		catch (const std::exception& e)
+		{
+			LMS_LOG(DBUPDATER, ERROR) << "Cannot write file '" << fileToScan.file.string() << "' in database: " << e.what();
+
+			// the modifications must not be flushed again
+			dboSession.discardUnflushed();
+			dboSession.execute("ROLLBACK TO scan_file");
+			dboSession.execute("RELEASE scan_file");
+			// may reference the entities created by this file
+			_scanCache.clear();
+
+			stats.errors.emplace_back(ScanError {fileToScan.file, ScanErrorType::CannotWriteDatabase, e.what()});
+			return false;
+		}
+	}};
+
+	// Group updates in as few transactions as possible, but release the lock from time to time to let readers go
+	std::size_t i {};
+	std::size_t parseResultIndex {};
+	while (i < files.size())
+	{
+		if (_abortScan)
+			return;
+
+		auto uniqueTransaction {_dbSession.createUniqueTransaction()};
+
+		const auto batchStartTime {std::chrono::steady_clock::now()};
+		while (i < files.size())
+		{
+			if (_abortScan)
+				return;
+
+			const FileToScan& fileToScan {files[i]};
+			++i;
+
+			bool written {true};
+			if (fileToScan.moveOnly)
+			{
+				written = writeFile(fileToScan, [&] { moveAudioFile(fileToScan, stats); });
+			}
+			else
+			{
+				const ParserPool::ParseResult& parseResult {parseResults[parseResultIndex++]};
+
+				if (parseResult.track)
+				{
+					const auto writeStartTime {std::chrono::steady_clock::now()};
+					written = writeFile(fileToScan, [&] { updateAudioFile(fileToScan, *parseResult.track, parseResult.contentHash, stats); });
+					stats.writeDurations.add(std::chrono::duration_cast<DurationHistogram::Duration>(std::chrono::steady_clock::now() - writeStartTime));
+				}
+				else
+					stats.errors.emplace_back(fileToScan.file, ScanErrorType::CannotParseFile);
+			}
+
+			// The objects of a rolled back file are kept by the Dbo transaction until it ends: end it before their ids get reused
+			if (!written)
+				break;
+
+			if (std::chrono::steady_clock::now() - batchStartTime >= _writeBatchMaxDuration)
+				break;
+		}
+	}
+}
+
+void
+ScannerService::updateAudioFile(const FileToScan& fileToScan, const MetaData::Track& trackInfo, const std::string& contentHash, ScanStats& stats)
+{
+	const std::filesystem::path& file {fileToScan.file};
+
+	_dbSession.checkUniqueLocked();
+
+	stats.scans++;
+
+	Track::pointer track {fileToScan.movedTrackId ? Track::find(_dbSession, *fileToScan.movedTrackId) : Track::findByPath(_dbSession, file)};
+
+	// Skip duplicate recording MBID
+	if (trackInfo.recordingMBID && _skipDuplicateRecordingMBID)
+	{
+		for (Track::pointer otherTrack : Track::findByRecordingMBID(_dbSession, *trackInfo.recordingMBID))
+		{
+			if (track && track->getId() == otherTrack->getId())
+				continue;
+
+			LMS_LOG(DBUPDATER, DEBUG) << "Skipped '" << file.string() << "' (similar recording MBID in '" << otherTrack->getPath().string() << "')";
+			// This recording MBID already exists, just remove what we just scanned
+			if (track)
+			{
+				track.remove();
+				stats.deletions++;
+			}
+			return;
+		}
+	}
+
+	// Audio properties may not have been read if they can be reused
+	const bool reuseAudioProperties {trackInfo.audioStreams.empty() && fileToScan.previousDuration};
+	const std::chrono::milliseconds duration {reuseAudioProperties ? *fileToScan.previousDuration : trackInfo.duration};
 
 	// We estimate this is an audio file if:
 	// - we found a least one audio stream
 	// - the duration is not null
-	if (trackInfo->audioStreams.empty())
+	if (trackInfo.audioStreams.empty() && !reuseAudioProperties)
 	{
 		LMS_LOG(DBUPDATER, INFO) << "Skipped '" << file.string() << "' (no audio stream found)";
 
@@ -758,7 +1427,7 @@ ScannerService::scanAudioFile(const std::filesystem::path& file, bool forceScan,
 		stats.errors.emplace_back(ScanError {file, ScanErrorType::NoAudioTrack});
 		return;
 	}
-	if (trackInfo->duration == std::chrono::milliseconds::zero())
+	if (duration == std::chrono::milliseconds::zero())
 	{
 		LMS_LOG(DBUPDATER, INFO) << "Skipped '" << file.string() << "' (duration is 0)";
 
@@ -774,8 +1443,8 @@ ScannerService::scanAudioFile(const std::filesystem::path& file, bool forceScan,
 
 	// ***** Title
 	std::string title;
-	if (!trackInfo->title.empty())
-		title = trackInfo->title;
+	if (!trackInfo.title.empty())
+		title = trackInfo.title;
 	else
 	{
 		// TODO parse file name guess track etc.
@@ -783,19 +1452,36 @@ ScannerService::scanAudioFile(const std::filesystem::path& file, bool forceScan,
 		title = file.filename().string();
 	}
 
+	// Created objects are published by the next library generation
+	const std::size_t addedGeneration {getLibraryGeneration().value + 1};
+
 	// If file already exist, update data
 	// Otherwise, create it
 	if (!track)
 	{
 		// Create a new song
 		track = Track::create(_dbSession, file);
+		track.modify()->setPath(getOrCreateDirectory(file.parent_path()), file.filename());
+		track.modify()->setAddedTime(Wt::WLocalDateTime::currentServerDateTime().toUTC());
+		track.modify()->setAddedGeneration(addedGeneration);
 		LMS_LOG(DBUPDATER, INFO) << "Adding '" << file.string() << "'";
 		stats.additions++;
 	}
+	else if (fileToScan.movedTrackId)
+	{
+		LMS_LOG(DBUPDATER, INFO) << "Moving '" << track->getPath().string() << "' to '" << file.string() << "'";
+		track.modify()->setPath(getOrCreateDirectory(file.parent_path()), file.filename());
+
+		stats.updates++;
+	}
 	else
 	{
 		LMS_LOG(DBUPDATER, INFO) << "Updating '" << file.string() << "'";
 
+		// Tracks scanned before the directory tree was introduced
+		if (!track->getDirectoryId().isValid())
+			track.modify()->setPath(getOrCreateDirectory(file.parent_path()), file.filename());
+
 		stats.updates++;
 	}
 
@@ -804,73 +1490,159 @@ ScannerService::scanAudioFile(const std::filesystem::path& file, bool forceScan,
 
 	track.modify()->clearArtistLinks();
 	// Do not fallback on artists with the same name but having a MBID for artist and releaseArtists, as it may be corrected by properly tagging files
-	for (const Artist::pointer& artist : getOrCreateArtists(_dbSession, trackInfo->artists, false))
+	for (const Artist::pointer& artist : getOrCreateArtists(_dbSession, trackInfo.artists, false, _scanCache))
 		track.modify()->addArtistLink(TrackArtistLink::create(_dbSession, track, artist, TrackArtistLinkType::Artist));
 
-	for (const Artist::pointer& releaseArtist : getOrCreateArtists(_dbSession, trackInfo->albumArtists, false))
+	for (const Artist::pointer& releaseArtist : getOrCreateArtists(_dbSession, trackInfo.albumArtists, false, _scanCache))
 		track.modify()->addArtistLink(TrackArtistLink::create(_dbSession, track, releaseArtist, TrackArtistLinkType::ReleaseArtist));
 
 	// Allow fallbacks on artists with the same name even if they have MBID, since there is no tag to indicate the MBID of these artists
 	// We could ask MusicBrainz to get all the information, but that would heavily slow down the import process
-	for (const Artist::pointer& conductor : getOrCreateArtists(_dbSession, trackInfo->conductorArtists, true))
+	for (const Artist::pointer& conductor : getOrCreateArtists(_dbSession, trackInfo.conductorArtists, true, _scanCache))
 		track.modify()->addArtistLink(TrackArtistLink::create(_dbSession, track, conductor, TrackArtistLinkType::Conductor));
 
-	for (const Artist::pointer& composer : getOrCreateArtists(_dbSession, trackInfo->composerArtists, true))
+	for (const Artist::pointer& composer : getOrCreateArtists(_dbSession, trackInfo.composerArtists, true, _scanCache))
 		track.modify()->addArtistLink(TrackArtistLink::create(_dbSession, track, composer, TrackArtistLinkType::Composer));
 
-	for (const Artist::pointer& lyricist : getOrCreateArtists(_dbSession, trackInfo->lyricistArtists, true))
+	for (const Artist::pointer& lyricist : getOrCreateArtists(_dbSession, trackInfo.lyricistArtists, true, _scanCache))
 		track.modify()->addArtistLink(TrackArtistLink::create(_dbSession, track, lyricist, TrackArtistLinkType::Lyricist));
 
-	for (const Artist::pointer& mixer : getOrCreateArtists(_dbSession, trackInfo->mixerArtists, true))
+	for (const Artist::pointer& mixer : getOrCreateArtists(_dbSession, trackInfo.mixerArtists, true, _scanCache))
 		track.modify()->addArtistLink(TrackArtistLink::create(_dbSession, track, mixer, TrackArtistLinkType::Mixer));
 
-	for (const Artist::pointer& producer : getOrCreateArtists(_dbSession, trackInfo->producerArtists, true))
+	for (const Artist::pointer& producer : getOrCreateArtists(_dbSession, trackInfo.producerArtists, true, _scanCache))
 		track.modify()->addArtistLink(TrackArtistLink::create(_dbSession, track, producer, TrackArtistLinkType::Producer));
 
-	for (const Artist::pointer& remixer : getOrCreateArtists(_dbSession, trackInfo->remixerArtists, true))
+	for (const Artist::pointer& remixer : getOrCreateArtists(_dbSession, trackInfo.remixerArtists, true, _scanCache))
 		track.modify()->addArtistLink(TrackArtistLink::create(_dbSession, track, remixer, TrackArtistLinkType::Remixer));
 
 	track.modify()->setScanVersion(_scanVersion);
-	if (trackInfo->album)
-		track.modify()->setRelease(getOrCreateRelease(_dbSession, *trackInfo->album));
+	if (trackInfo.album)
+	{
+		const Release::pointer release {getOrCreateRelease(_dbSession, *trackInfo.album, addedGeneration, _scanCache)};
+		track.modify()->setRelease(release);
+
+		if (release)
+			_changedReleaseIds.insert(release->getId());
+	}
 	else
 		track.modify()->setRelease({});
-	track.modify()->setClusters(getOrCreateClusters(_dbSession, trackInfo->clusters));
-	track.modify()->setLastWriteTime(lastWriteTime);
+	track.modify()->setClusters(getOrCreateClusters(_dbSession, trackInfo.clusters, _scanCache));
+	track.modify()->setLastWriteTime(fileToScan.lastWriteTime);
+	track.modify()->setContentHash(contentHash);
 	track.modify()->setName(title);
-	track.modify()->setDuration(trackInfo->duration);
-	track.modify()->setAddedTime(Wt::WLocalDateTime::currentServerDateTime().toUTC());
-	track.modify()->setTrackNumber(trackInfo->trackNumber ? *trackInfo->trackNumber : 0);
-	track.modify()->setDiscNumber(trackInfo->discNumber ? *trackInfo->discNumber : 0);
-	track.modify()->setTotalTrack(trackInfo->totalTrack);
-	track.modify()->setTotalDisc(trackInfo->totalDisc);
-	track.modify()->setDiscSubtitle(trackInfo->discSubtitle);
-	track.modify()->setDate(trackInfo->date);
-	track.modify()->setOriginalDate(trackInfo->originalDate);
+	track.modify()->setDuration(duration);
+	if (!trackInfo.audioStreams.empty())
+	{
+		track.modify()->setBitrate(trackInfo.audioStreams.front().bitRate);
+		track.modify()->setAudioCodec(toDatabaseAudioCodec(trackInfo.audioStreams.front().codec));
+	}
+	track.modify()->setTrackNumber(trackInfo.trackNumber ? *trackInfo.trackNumber : 0);
+	track.modify()->setDiscNumber(trackInfo.discNumber ? *trackInfo.discNumber : 0);
+	track.modify()->setTotalTrack(trackInfo.totalTrack);
+	track.modify()->setTotalDisc(trackInfo.totalDisc);
+	track.modify()->setDiscSubtitle(trackInfo.discSubtitle);
+	track.modify()->setDate(trackInfo.date);
+	track.modify()->setOriginalDate(trackInfo.originalDate);
 
 	// If a file has an OriginalYear but no Year, set it to ease filtering
-	if (!trackInfo->date.isValid() && trackInfo->originalDate.isValid())
-		track.modify()->setDate(trackInfo->originalDate);
+	if (!trackInfo.date.isValid() && trackInfo.originalDate.isValid())
+		track.modify()->setDate(trackInfo.originalDate);
+
+	track.modify()->setRecordingMBID(trackInfo.recordingMBID);
+	track.modify()->setTrackMBID(trackInfo.trackMBID);
+	// Moved files have the same content, hence the same MBID
+	if (!fileToScan.movedTrackId)
+	{
+		if (auto trackFeatures {TrackFeatures::find(_dbSession, track->getId())})
+			trackFeatures.remove(); // TODO: only if MBID changed?
+	}
+	track.modify()->setHasCover(trackInfo.hasCover);
+	track.modify()->setCoverHash(trackInfo.coverHash);
+	track.modify()->setCopyright(trackInfo.copyright);
+	track.modify()->setCopyrightURL(trackInfo.copyrightURL);
+	track.modify()->setTrackReplayGain(trackInfo.trackReplayGain);
+	track.modify()->setReleaseReplayGain(trackInfo.albumReplayGain);
+}
+
+void
+ScannerService::moveAudioFile(const FileToScan& fileToScan, ScanStats& stats)
+{
+	const std::filesystem::path& file {fileToScan.file};
+
+	_dbSession.checkUniqueLocked();
+
+	const Track::pointer track {Track::find(_dbSession, *fileToScan.movedTrackId)};
+	if (!track)
+		return;
+
+	LMS_LOG(DBUPDATER, INFO) << "Moving '" << track->getPath().string() << "' to '" << file.string() << "'";
+
+	// Title may have been guessed from the file name
+	if (track->getName() == track->getPath().filename().string())
+		track.modify()->setName(file.filename().string());
+
+	track.modify()->setPath(getOrCreateDirectory(file.parent_path()), file.filename());
+	track.modify()->setLastWriteTime(fileToScan.lastWriteTime);
+
+	// The cover may be located in the new directory
+	if (const Release::pointer release {track->getRelease()})
+		_changedReleaseIds.insert(release->getId());
+
+	stats.updates++;
+}
+
+Directory::pointer
+ScannerService::getOrCreateDirectory(const std::filesystem::path& directory)
+{
+	_dbSession.checkUniqueLocked();
+
+	const bool isMediaDirectory {isMediaRootDirectory(directory)};
+
+	Directory::pointer res {Directory::findByPath(_dbSession, directory)};
+	if (res)
+	{
+		// The media directory may have been changed for one of its sub directories
+		if (isMediaDirectory && res->getParentId().isValid())
+			res.modify()->setParent({});
 
-	track.modify()->setRecordingMBID(trackInfo->recordingMBID);
-	track.modify()->setTrackMBID(trackInfo->trackMBID);
-	if (auto trackFeatures {TrackFeatures::find(_dbSession, track->getId())})
-		trackFeatures.remove(); // TODO: only if MBID changed?
-	track.modify()->setHasCover(trackInfo->hasCover);
-	track.modify()->setCopyright(trackInfo->copyright);
-	track.modify()->setCopyrightURL(trackInfo->copyrightURL);
-	track.modify()->setTrackReplayGain(trackInfo->trackReplayGain);
-	track.modify()->setReleaseReplayGain(trackInfo->albumReplayGain);
+		return res;
+	}
+
+	Directory::pointer parent;
+	if (!isMediaDirectory && directory.parent_path() != directory)
+		parent = getOrCreateDirectory(directory.parent_path());
+
+	return Directory::create(_dbSession, directory, parent);
 }
 
 void
-ScannerService::scanMediaDirectory(const std::filesystem::path& mediaDirectory, bool forceScan, ScanStats& stats)
+ScannerService::scanMediaRoots(bool forceScan, ScanStats& stats)
 {
 	ScanStepStats stepStats{stats.startTime, ScanProgressStep::ScanningFiles};
+	ScopedStepTimer stepTimer {stats, ScanProgressStep::ScanningFiles};
 	stepStats.totalElems = stats.filesScanned;
 	notifyInProgress(stepStats);
 
-	exploreFilesRecursive(mediaDirectory, [&](std::error_code ec, const std::filesystem::path& path)
+	// Files are parsed and written by batches
+	std::vector<FileToScan> filesToScan;
+	filesToScan.reserve(_writeBatchSize);
+
+	auto scanPendingFiles {[&]
+	{
+		scanAudioFiles(filesToScan, stats);
+
+		stepStats.processedElems += filesToScan.size();
+		notifyInProgressIfNeeded(stepStats);
+
+		filesToScan.clear();
+	}};
+
+	// Only used if directories can be skipped
+	DirectoryStates directoryStates;
+
+	// Roots are walked concurrently, but files are checked, parsed and written by the same pipeline
+	exploreFilesConcurrently(getMediaRootDirectories(), createSupportedFileFilter(), [&](std::size_t, std::error_code ec, const std::filesystem::path& path)
 	{
 		if (_abortScan)
 			return false;
@@ -880,23 +1652,180 @@ ScannerService::scanMediaDirectory(const std::filesystem::path& mediaDirectory,
 			LMS_LOG(DBUPDATER, ERROR) << "Cannot process entry '" << path.string() << "': " << ec.message();
 			stats.errors.emplace_back(ScanError {path, ScanErrorType::CannotReadFile, ec.message()});
 		}
-		else if (isFileSupported(path, _fileExtensions))
+		else
 		{
-			scanAudioFile(path, forceScan, stats );
+			bool skipFile {};
+			if (_skipUnchangedDirectories && !forceScan)
+			{
+				auto itDirectory {directoryStates.find(path.parent_path())};
+				if (itDirectory == std::cend(directoryStates))
+					itDirectory = directoryStates.emplace(path.parent_path(), checkDirectory(path.parent_path())).first;
 
-			stepStats.processedElems++;
-			notifyInProgressIfNeeded(stepStats);
+				skipFile = itDirectory->second.unchanged;
+			}
+
+			if (skipFile)
+			{
+				stats.skips++;
+				stepStats.processedElems++;
+				notifyInProgressIfNeeded(stepStats);
+			}
+			else if (std::optional<FileToScan> fileToScan {checkAudioFile(path, forceScan, stats)})
+			{
+				filesToScan.emplace_back(std::move(*fileToScan));
+				if (filesToScan.size() >= _writeBatchSize)
+					scanPendingFiles();
+			}
+			else
+			{
+				stepStats.processedElems++;
+				notifyInProgressIfNeeded(stepStats);
+			}
 		}
 
 		return true;
-	}, excludeDirFileName);
+	}, excludeDirFileName, _directoryWalkerCount);
+
+	if (!_abortScan && !filesToScan.empty())
+		scanPendingFiles();
+
+	// Partial walks cannot be used to tell which directories are gone
+	if (!_abortScan && _skipUnchangedDirectories && !forceScan)
+		updateDirectories(directoryStates, stats);
 
 	notifyInProgress(stepStats);
 }
 
-// Check if a file exists and is still in a media directory
-static bool
-checkFile(const std::filesystem::path& p, const std::filesystem::path& mediaDirectory, const std::unordered_set<std::filesystem::path>& extensions)
+ScannerService::DirectoryState
+ScannerService::checkDirectory(const std::filesystem::path& directory)
+{
+	DirectoryState state;
+
+	const std::optional<std::size_t> entryCount {getDirectoryEntryCount(directory)};
+	if (!entryCount)
+		return state;
+
+	try
+	{
+		state.fingerprint = DirectoryFingerprint {getLastWriteTime(directory), *entryCount};
+	}
+	catch (LmsException& e)
+	{
+		LMS_LOG(DBUPDATER, ERROR) << e.what();
+		return state;
+	}
+
+	auto transaction {_dbSession.createSharedTransaction()};
+
+	const Directory::pointer dbDirectory {Directory::findByPath(_dbSession, directory)};
+	state.unchanged = dbDirectory
+		&& dbDirectory->hasFingerprint()
+		&& dbDirectory->getLastWriteTime().toTime_t() == state.fingerprint->lastWriteTime.toTime_t()
+		&& dbDirectory->getEntryCount() == state.fingerprint->entryCount
+		&& dbDirectory->getScanVersion() == _scanVersion;
+
+	if (state.unchanged)
+		LMS_LOG(DBUPDATER, DEBUG) << "Skipping unchanged directory '" << directory.string() << "'";
+
+	return state;
+}
+
+void
+ScannerService::updateDirectories(const DirectoryStates& directoryStates, const ScanStats& stats)
+{
+	// Directories that contain files in error must be scanned again next time
+	std::unordered_set<std::filesystem::path> directoriesInError;
+	for (const ScanError& error : stats.errors)
+		directoriesInError.insert(error.file.parent_path());
+
+	// Directories are part of the directory tree: gone ones are removed along with the orphan entries
+	std::vector<DirectoryId> directoryIdsToReset;
+	{
+		auto transaction {_dbSession.createSharedTransaction()};
+
+		const auto directories {Directory::find(_dbSession, Range {})};
+		for (const Directory::pointer& directory : directories.results)
+		{
+			if (directory->hasFingerprint() && directoryStates.find(directory->getPath()) == std::cend(directoryStates))
+				directoryIdsToReset.push_back(directory->getId());
+		}
+	}
+
+	auto transaction {_dbSession.createUniqueTransaction()};
+
+	for (const DirectoryId directoryId : directoryIdsToReset)
+	{
+		Directory::pointer directory {Directory::find(_dbSession, directoryId)};
+		if (directory)
+			directory.modify()->resetFingerprint();
+	}
+
+	for (const auto& [path, state] : directoryStates)
+	{
+		if (state.unchanged)
+			continue;
+
+		Directory::pointer directory {Directory::findByPath(_dbSession, path)};
+
+		// Do not trust directories that may have been modified during the scan, or whose content could not be fully scanned
+		if (!state.fingerprint
+				|| state.fingerprint->lastWriteTime.toTime_t() >= stats.startTime.toTime_t()
+				|| directoriesInError.find(path) != std::cend(directoriesInError))
+		{
+			if (directory)
+				directory.modify()->resetFingerprint();
+			continue;
+		}
+
+		if (!directory)
+			directory = getOrCreateDirectory(path);
+
+		directory.modify()->setLastWriteTime(state.fingerprint->lastWriteTime);
+		directory.modify()->setEntryCount(state.fingerprint->entryCount);
+		directory.modify()->setScanVersion(_scanVersion);
+	}
+}
+
+const ScannerService::MediaRoot*
+ScannerService::findMediaRoot(const std::filesystem::path& path) const
+{
+	// Nested roots are ignored
+	for (const MediaRoot& mediaRoot : _mediaRoots)
+	{
+		if (isPathUnder(path, mediaRoot.directory))
+			return &mediaRoot;
+	}
+
+	return nullptr;
+}
+
+bool
+ScannerService::isMediaRootDirectory(const std::filesystem::path& directory) const
+{
+	return std::any_of(std::cbegin(_mediaRoots), std::cend(_mediaRoots), [&](const MediaRoot& mediaRoot) { return mediaRoot.directory == directory; });
+}
+
+std::vector<std::filesystem::path>
+ScannerService::getMediaRootDirectories() const
+{
+	std::vector<std::filesystem::path> res;
+	std::transform(std::cbegin(_mediaRoots), std::cend(_mediaRoots), std::back_inserter(res), [](const MediaRoot& mediaRoot) { return mediaRoot.directory; });
+
+	return res;
+}
+
+ConcurrentExploreFilter
+ScannerService::createSupportedFileFilter() const
+{
+	return [this](std::size_t rootIndex, const std::filesystem::path& path)
+	{
+		return isFileSupported(path, _mediaRoots[rootIndex].fileExtensions);
+	};
+}
+
+// Check if a file exists and is still in a media root
+bool
+ScannerService::checkFile(const std::filesystem::path& p) const
 {
 	try
 	{
@@ -909,13 +1838,14 @@ checkFile(const std::filesystem::path& p, const std::filesystem::path& mediaDire
 			return false;
 		}
 
-		if (!isPathInMediaDirectory(p, mediaDirectory))
+		const MediaRoot* mediaRoot {findMediaRoot(p)};
+		if (!mediaRoot || !isPathInMediaDirectory(p, mediaRoot->directory))
 		{
 			LMS_LOG(DBUPDATER, INFO) << "Removing '" << p.string() << "': out of media directory";
 			return false;
 		}
 
-		if (!isFileSupported(p, extensions))
+		if (!isFileSupported(p, mediaRoot->fileExtensions))
 		{
 			LMS_LOG(DBUPDATER, INFO) << "Removing '" << p.string() << "': file format no longer handled";
 			return false;
@@ -931,11 +1861,17 @@ checkFile(const std::filesystem::path& p, const std::filesystem::path& mediaDire
 }
 
 void
-ScannerService::removeMissingTracks(ScanStats& stats)
+ScannerService::removeMissingTracks(const DiscoveredFiles& discoveredFiles, ScanStats& stats)
 {
-	static constexpr std::size_t batchSize {50};
+	// SQLite limits the number of bound parameters per query
+	static constexpr std::size_t batchSize {500};
+
+	// An incomplete discovery cannot be used to tell which files are missing
+	if (_abortScan)
+		return;
 
 	ScanStepStats stepStats{stats.startTime, ScanProgressStep::ChekingForMissingFiles};
+	ScopedStepTimer stepTimer {stats, ScanProgressStep::ChekingForMissingFiles};
 
 	LMS_LOG(DBUPDATER, DEBUG) << "Checking tracks to be removed...";
 	std::size_t trackCount {};
@@ -950,12 +1886,10 @@ ScannerService::removeMissingTracks(ScanStats& stats)
 	notifyInProgress(stepStats);
 
 	RangeResults<Track::PathResult> trackPaths;
-	std::vector<TrackId> tracksToRemove;
+	std::vector<TrackId> missingTrackIds;
 
 	for (std::size_t i {trackCount < batchSize ? 0 : trackCount - batchSize}; ; i -= (i > batchSize ? batchSize : i))
 	{
-		tracksToRemove.clear();
-
 		{
 			auto transaction {_dbSession.createSharedTransaction()};
 			trackPaths = Track::findPaths(_dbSession, Range {i, batchSize});
@@ -966,25 +1900,14 @@ ScannerService::removeMissingTracks(ScanStats& stats)
 			if (_abortScan)
 				return;
 
-			if (!checkFile(trackPath.path, _mediaDirectory, _fileExtensions))
-				tracksToRemove.push_back(trackPath.trackId);
-
-			stepStats.processedElems++;
-		}
-
-		if (!tracksToRemove.empty())
-		{
-			auto transaction {_dbSession.createUniqueTransaction()};
-
-			for (const TrackId trackId : tracksToRemove)
+			// Only check the file system if the discovery could not explore everything
+			if (discoveredFiles.files.find(trackPath.path) == std::cend(discoveredFiles.files)
+					&& (!discoveredFiles.errors || !checkFile(trackPath.path)))
 			{
-				Track::pointer track {Track::find(_dbSession, trackId)};
-				if (track)
-				{
-					track.remove();
-					stats.deletions++;
-				}
+				missingTrackIds.push_back(trackPath.trackId);
 			}
+
+			stepStats.processedElems++;
 		}
 
 		notifyInProgressIfNeeded(stepStats);
@@ -993,80 +1916,291 @@ ScannerService::removeMissingTracks(ScanStats& stats)
 			break;
 	}
 
-	LMS_LOG(DBUPDATER, DEBUG) << trackCount << " tracks checked!";
+	LMS_LOG(DBUPDATER, DEBUG) << trackCount << " tracks checked, " << missingTrackIds.size() << " missing!";
+
+	addMissingTracks(missingTrackIds, stats);
+}
+
+void
+ScannerService::addMissingTracks(const std::vector<TrackId>& trackIds, ScanStats& stats)
+{
+	// SQLite limits the number of bound parameters per query
+	static constexpr std::size_t batchSize {500};
+
+	std::vector<TrackId> tracksToRemove;
+	for (std::size_t offset {}; offset < trackIds.size(); offset += batchSize)
+	{
+		const auto itBegin {std::cbegin(trackIds) + offset};
+		const auto itEnd {itBegin + std::min(batchSize, trackIds.size() - offset)};
+
+		auto transaction {_dbSession.createSharedTransaction()};
+
+		for (const Track::pointer& track : Track::find(_dbSession, std::vector<TrackId>(itBegin, itEnd)))
+		{
+			// Tracks scanned before content hashes were introduced cannot be matched
+			if (track->getContentHash().empty())
+				tracksToRemove.push_back(track->getId());
+			else
+				_missingTracksByContentHash[track->getContentHash()].push_back(track->getId());
+		}
+	}
+
+	removeTracks(_dbSession, tracksToRemove);
+	stats.deletions += tracksToRemove.size();
+}
+
+void
+ScannerService::removeUnmatchedMissingTracks(ScanStats& stats)
+{
+	std::vector<TrackId> tracksToRemove;
+	for (const auto& [contentHash, trackIds] : _missingTracksByContentHash)
+		tracksToRemove.insert(std::end(tracksToRemove), std::cbegin(trackIds), std::cend(trackIds));
+	_missingTracksByContentHash.clear();
+
+	removeTracks(_dbSession, tracksToRemove);
+	stats.deletions += tracksToRemove.size();
+}
+
+void
+ScannerService::updateWatchedDirectory()
+{
+	if (!_fileSystemWatcher)
+		return;
+
+	const std::vector<std::filesystem::path> mediaRootDirectories {getMediaRootDirectories()};
+	if (mediaRootDirectories.empty())
+		_fileSystemWatcher->unwatch();
+	else if (_fileSystemWatcher->getRootDirectories() != mediaRootDirectories)
+		_fileSystemWatcher->watch(mediaRootDirectories, excludeDirFileName);
 }
 
 void
-ScannerService::removeOrphanEntries()
+ScannerService::processFileSystemChanges(const FileSystemWatcher::Changes& changes)
 {
-	LMS_LOG(DBUPDATER, DEBUG) << "Checking orphan clusters...";
+	if (_abortScan)
+		return;
+
+	_ioThrottle.applyIoPriority();
+
+	if (changes.overflow)
 	{
-		auto transaction {_dbSession.createUniqueTransaction()};
+		LMS_LOG(DBUPDATER, WARNING) << "Some file system changes have been lost, scheduling a full scan";
+		scheduleScan(false);
+		return;
+	}
+
+	LMS_LOG(DBUPDATER, INFO) << "Processing file system changes: " << changes.modifiedFiles.size() << " modified file(s), " << changes.removedPaths.size() << " removed path(s)";
+
+	ScanStats stats;
+	stats.startTime = Wt::WLocalDateTime::currentDateTime().toUTC();
+
+	// Removed paths may be directories, check all the tracks they contain
+	{
+		std::vector<Track::PathResult> trackPaths;
+		{
+			auto transaction {_dbSession.createSharedTransaction()};
 
-		// Now process orphan Cluster (no track)
-		auto clusterIds {Cluster::findOrphans(_dbSession, Range {})};
-		for (ClusterId clusterId : clusterIds.results)
+			for (const std::filesystem::path& removedPath : changes.removedPaths)
+			{
+				RangeResults<Track::PathResult> removedTrackPaths {Track::findPathsUnder(_dbSession, removedPath, Range {})};
+				trackPaths.insert(std::end(trackPaths), std::make_move_iterator(std::begin(removedTrackPaths.results)), std::make_move_iterator(std::end(removedTrackPaths.results)));
+			}
+		}
+
+		std::vector<TrackId> missingTrackIds;
+		for (const Track::PathResult& trackPath : trackPaths)
 		{
-			Cluster::pointer cluster {Cluster::find(_dbSession, clusterId)};
-			LMS_LOG(DBUPDATER, DEBUG) << "Removing orphan cluster '" << cluster->getName() << "'";
-			cluster.remove();
+			if (!checkFile(trackPath.path))
+				missingTrackIds.push_back(trackPath.trackId);
 		}
+
+		// Moved files are reported as removed and modified paths
+		addMissingTracks(missingTrackIds, stats);
 	}
 
-	LMS_LOG(DBUPDATER, DEBUG) << "Checking orphan artists...";
 	{
-		auto transaction {_dbSession.createUniqueTransaction()};
+		std::vector<FileToScan> filesToScan;
+		for (const std::filesystem::path& file : changes.modifiedFiles)
+		{
+			const MediaRoot* mediaRoot {findMediaRoot(file)};
+			if (!mediaRoot)
+				continue;
+
+			std::error_code ec;
+			if (!std::filesystem::is_regular_file(file, ec)
+					|| !isFileSupported(file, mediaRoot->fileExtensions)
+					|| !isPathInMediaDirectory(file, mediaRoot->directory))
+				continue;
+
+			stats.filesScanned++;
+			if (std::optional<FileToScan> fileToScan {checkAudioFile(file, false, stats)})
+				filesToScan.emplace_back(std::move(*fileToScan));
+		}
+
+		std::sort(std::begin(filesToScan), std::end(filesToScan), [](const FileToScan& lhs, const FileToScan& rhs) { return lhs.file < rhs.file; });
 
-		auto artistIds {Artist::findAllOrphans(_dbSession, Range {})};
-		for (const ArtistId artistId : artistIds.results)
+		for (std::size_t offset {}; offset < filesToScan.size() && !_abortScan; offset += _writeBatchSize)
 		{
-			Artist::pointer artist {Artist::find(_dbSession, artistId)};
-			LMS_LOG(DBUPDATER, DEBUG) << "Removing orphan artist '" << artist->getName() << "'";
-			artist.remove();
+			const auto itBegin {std::cbegin(filesToScan) + offset};
+			const auto itEnd {itBegin + std::min(_writeBatchSize, filesToScan.size() - offset)};
+
+			scanAudioFiles(std::vector<FileToScan>(itBegin, itEnd), stats);
 		}
 	}
 
-	LMS_LOG(DBUPDATER, DEBUG) << "Checking orphan releases...";
+	removeUnmatchedMissingTracks(stats);
+
+	if (stats.nbChanges() == 0)
 	{
-		auto transaction {_dbSession.createUniqueTransaction()};
+		LMS_LOG(DBUPDATER, DEBUG) << "No change detected";
+		return;
+	}
+
+	removeOrphanEntries(stats);
+	updateArtistSummaries();
+
+	if (!_abortScan)
+	{
+		checkDuplicatedAudioFiles(stats);
+		fetchTrackFeatures(stats);
+		reloadSimilarityEngine(stats);
+		updateReleaseCoverPaths();
+		generateCovers(stats);
+		reclaimDatabaseSpace(stats);
+	}
+	// not done for aborted scans
+	_changedReleaseIds.clear();
+
+	{
+		std::unique_lock lock {_statusMutex};
+		_currentScanStepStats.reset();
+	}
+	notifyLibraryChanged();
+
+	LMS_LOG(DBUPDATER, INFO) << "File system changes processed. Changes = " << stats.nbChanges() << " (added = " << stats.additions << ", removed = " << stats.deletions << ", updated = " << stats.updates << "), Scanned = " << stats.scans << " (errors = " << stats.errors.size() << ")";
+
+	if (!_abortScan)
+	{
+		stats.stopTime = Wt::WLocalDateTime::currentDateTime().toUTC();
+		_events.scanComplete.emit(stats);
+	}
+}
+
+void
+ScannerService::removeOrphanEntries(ScanStats& stats)
+{
+	ScanStepStats stepStats {stats.startTime, ScanProgressStep::RemovingOrphanEntries};
+	ScopedStepTimer stepTimer {stats, ScanProgressStep::RemovingOrphanEntries};
+
+	// Cached entities may be removed
+	_scanCache.clear();
+
+	{
+		auto transaction {_dbSession.createSharedTransaction()};
+
+		// Removing directories may make their parents orphans too, so this is just an estimate
+		stepStats.totalElems = Cluster::getOrphanCount(_dbSession)
+			+ Artist::getOrphanCount(_dbSession)
+			+ Release::getOrphanCount(_dbSession)
+			+ Directory::getOrphanCount(_dbSession);
+	}
+	notifyInProgress(stepStats);
+
+	// Orphans are removed by chunks, to release the database lock from time to time
+	auto removeOrphans {[&](std::string_view entityName, std::size_t(*removeFunc)(Session&, std::size_t))
+	{
+		LMS_LOG(DBUPDATER, DEBUG) << "Removing orphan " << entityName << "...";
+
+		std::size_t removedCount {};
+		while (true)
+		{
+			std::size_t count;
+			{
+				auto transaction {_dbSession.createUniqueTransaction()};
+				count = removeFunc(_dbSession, _writeBatchSize);
+			}
+			if (count == 0)
+				break;
+
+			removedCount += count;
+			stepStats.processedElems = std::min(stepStats.processedElems + count, stepStats.totalElems);
+			notifyInProgressIfNeeded(stepStats);
+		}
+
+		LMS_LOG(DBUPDATER, DEBUG) << "Removed " << removedCount << " orphan " << entityName;
+	}};
+
+	removeOrphans("clusters", &Cluster::removeOrphans);
+	removeOrphans("artists", &Artist::removeOrphans);
+	removeOrphans("releases", &Release::removeOrphans);
+	removeOrphans("directories", &Directory::removeOrphans);
+
+	notifyInProgress(stepStats);
+	LMS_LOG(DBUPDATER, INFO) << "Orphan entries removed!";
+}
+
+void
+ScannerService::updateArtistSummaries()
+{
+	LMS_LOG(DBUPDATER, DEBUG) << "Updating artist summaries...";
 
-		auto releases {Release::findOrphans(_dbSession, Range {})};
-		for (const ReleaseId releaseId : releases.results)
+	// By chunks, to release the database lock from time to time
+	std::size_t updatedCount {};
+	while (true)
+	{
+		std::size_t count;
 		{
-			Release::pointer release {Release::find(_dbSession, releaseId)};
-			LMS_LOG(DBUPDATER, DEBUG) << "Removing orphan release '" << release->getName() << "'";
-			release.remove();
+			auto transaction {_dbSession.createUniqueTransaction()};
+			count = Artist::updateSummaries(_dbSession, _writeBatchSize);
 		}
+		if (count == 0)
+			break;
+
+		updatedCount += count;
 	}
 
-	LMS_LOG(DBUPDATER, INFO) << "Check audio files done!";
+	LMS_LOG(DBUPDATER, DEBUG) << "Updated " << updatedCount << " artist summaries";
 }
 
 void
 ScannerService::checkDuplicatedAudioFiles(ScanStats& stats)
 {
+	ScanStepStats stepStats {stats.startTime, ScanProgressStep::CheckingForDuplicates};
+	ScopedStepTimer stepTimer {stats, ScanProgressStep::CheckingForDuplicates};
+
 	LMS_LOG(DBUPDATER, INFO) << "Checking duplicated audio files";
+	notifyInProgress(stepStats);
 
-	auto transaction {_dbSession.createSharedTransaction()};
+	static constexpr std::size_t batchSize {1000};
 
-	const RangeResults<TrackId> tracks = Track::findRecordingMBIDDuplicates(_dbSession, Range {});
-	for (const TrackId trackId : tracks.results)
+	RangeResults<Track::RecordingMBIDDuplicateResult> duplicates;
+	duplicates.moreResults = true;
+	for (Range range {0, batchSize}; duplicates.moreResults && !_abortScan; range.offset += batchSize)
 	{
-		const Track::pointer track {Track::find(_dbSession, trackId)};
-		if (auto recordingMBID {track->getRecordingMBID()})
 		{
-			LMS_LOG(DBUPDATER, INFO) << "Found duplicated recording MBID [" << recordingMBID->getAsString() << "], file: " << track->getPath().string() << " - " << track->getName();
-			stats.duplicates.emplace_back(ScanDuplicate {track->getId(), DuplicateReason::SameRecordingMBID});
+			auto transaction {_dbSession.createSharedTransaction()};
+			duplicates = Track::findRecordingMBIDDuplicates(_dbSession, range);
 		}
+
+		for (const Track::RecordingMBIDDuplicateResult& duplicate : duplicates.results)
+		{
+			LMS_LOG(DBUPDATER, INFO) << "Found duplicated recording MBID [" << duplicate.recordingMBID << "], file: " << duplicate.path.string();
+			stats.duplicates.emplace_back(ScanDuplicate {duplicate.trackId, DuplicateReason::SameRecordingMBID});
+		}
+
+		stepStats.processedElems += duplicates.results.size();
+		notifyInProgressIfNeeded(stepStats);
 	}
 
-	LMS_LOG(DBUPDATER, INFO) << "Checking duplicated audio files done!";
+	notifyInProgress(stepStats);
+	LMS_LOG(DBUPDATER, INFO) << "Checking duplicated audio files done! Found " << stats.duplicates.size() << " duplicates";
 }
 
 void
 ScannerService::reloadSimilarityEngine(ScanStats& stats)
 {
 	ScanStepStats stepStats {stats.startTime, ScanProgressStep::ReloadingSimilarityEngine};
+	ScopedStepTimer stepTimer {stats, ScanProgressStep::ReloadingSimilarityEngine};
 
 	auto progressCallback {[&](const Recommendation::Progress& progress)
 	{
@@ -1080,4 +2214,172 @@ ScannerService::reloadSimilarityEngine(ScanStats& stats)
 	notifyInProgress(stepStats);
 }
 
+void
+ScannerService::updateReleaseCoverPaths()
+{
+	Cover::ICoverService* coverService {Service<Cover::ICoverService>::get()};
+	if (_changedReleaseIds.empty() || !coverService)
+		return;
+
+	LMS_LOG(DBUPDATER, INFO) << "Updating cover paths of " << _changedReleaseIds.size() << " releases...";
+
+	// Looking for the covers may take time (directory listings), do not hold the lock meanwhile
+	std::vector<std::pair<ReleaseId, std::filesystem::path>> coverPaths;
+	coverPaths.reserve(_changedReleaseIds.size());
+	for (const ReleaseId releaseId : _changedReleaseIds)
+	{
+		if (_abortScan)
+			return;
+
+		coverPaths.emplace_back(releaseId, coverService->findReleaseCoverPath(releaseId));
+	}
+
+	for (std::size_t offset {}; offset < coverPaths.size(); offset += _writeBatchSize)
+	{
+		auto transaction {_dbSession.createUniqueTransaction()};
+
+		for (std::size_t i {offset}; i < std::min(offset + _writeBatchSize, coverPaths.size()); ++i)
+		{
+			const auto& [releaseId, coverPath] {coverPaths[i]};
+
+			if (Release::pointer release {Release::find(_dbSession, releaseId)})
+			{
+				if (release->getCoverPath() != coverPath)
+					release.modify()->setCoverPath(coverPath);
+			}
+		}
+	}
+
+	LMS_LOG(DBUPDATER, INFO) << "Release cover paths updated!";
+}
+
+void
+ScannerService::generateCovers(ScanStats& stats)
+{
+	if (_coverGenerationSizes.empty() || _changedReleaseIds.empty())
+		return;
+
+	Cover::ICoverService* coverService {Service<Cover::ICoverService>::get()};
+	if (!coverService)
+		return;
+
+	const std::vector<ReleaseId> releaseIds(std::cbegin(_changedReleaseIds), std::cend(_changedReleaseIds));
+
+	ScanStepStats stepStats {stats.startTime, ScanProgressStep::GeneratingCovers};
+	ScopedStepTimer stepTimer {stats, ScanProgressStep::GeneratingCovers};
+
+	LMS_LOG(DBUPDATER, INFO) << "Generating covers of " << releaseIds.size() << " releases...";
+
+	stepStats.totalElems = releaseIds.size();
+	notifyInProgress(stepStats);
+
+	std::atomic<std::size_t> nextReleaseIndex {};
+	std::atomic<std::size_t> processedReleaseCount {};
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::size_t pendingJobCount {std::min(releaseIds.size(), _coverGenerationThreadCount)};
+
+	std::vector<Image::EncodingFormat> formats {Image::EncodingFormat::JPEG};
+	if (Image::isEncodingSupported(Image::EncodingFormat::WebP))
+		formats.push_back(Image::EncodingFormat::WebP);
+
+	// Generated covers end up in the cover caches, making further requests cheap
+	for (std::size_t i {}, jobCount {pendingJobCount}; i < jobCount; ++i)
+	{
+		_coverGenerationIOService.post([&]
+		{
+			for (std::size_t releaseIndex {nextReleaseIndex++}; releaseIndex < releaseIds.size() && !_abortScan; releaseIndex = nextReleaseIndex++)
+			{
+				try
+				{
+					const WorkBudget::ScopedSlot slot {WorkBudget::WorkClass::Background};
+					const Profiling::ScopedLabel profilingLabel {getStepName(ScanProgressStep::GeneratingCovers)};
+
+					for (const Image::EncodingFormat format : formats)
+					{
+						for (const std::size_t size : _coverGenerationSizes)
+							coverService->getFromRelease(releaseIds[releaseIndex], size, format);
+					}
+				}
+				catch (const std::exception& e)
+				{
+					LMS_LOG(DBUPDATER, ERROR) << "Cannot generate covers of release " << releaseIds[releaseIndex].toString() << ": " << e.what();
+				}
+
+				processedReleaseCount++;
+			}
+
+			{
+				std::scoped_lock lock {mutex};
+				pendingJobCount--;
+			}
+			cv.notify_one();
+		});
+	}
+
+	{
+		std::unique_lock lock {mutex};
+		while (!cv.wait_for(lock, std::chrono::seconds {1}, [&] { return pendingJobCount == 0; }))
+		{
+			stepStats.processedElems = processedReleaseCount;
+			notifyInProgressIfNeeded(stepStats);
+		}
+	}
+
+	stepStats.processedElems = processedReleaseCount;
+	notifyInProgress(stepStats);
+	LMS_LOG(DBUPDATER, INFO) << "Covers generated!";
+}
+
+void
+ScannerService::reclaimDatabaseSpace(ScanStats& stats)
+{
+	// Leave some room to the other writers between the steps
+	constexpr std::chrono::milliseconds stepPause {50};
+
+	if (_databaseVacuumStepPageCount == 0)
+		return;
+
+	Db& db {_dbSession.getDb()};
+
+	try
+	{
+		const Db::FreeSpace freeSpace {db.getFreeSpace()};
+		if (freeSpace.freePageCount == 0)
+			return;
+
+		ScanStepStats stepStats {stats.startTime, ScanProgressStep::ReclaimingDatabaseSpace};
+		ScopedStepTimer stepTimer {stats, ScanProgressStep::ReclaimingDatabaseSpace};
+
+		LMS_LOG(DBUPDATER, INFO) << "Reclaiming " << freeSpace.freePageCount << " free database pages...";
+
+		stepStats.totalElems = freeSpace.freePageCount;
+		notifyInProgress(stepStats);
+
+		while (!_abortScan && stepStats.processedElems < stepStats.totalElems)
+		{
+			std::size_t reclaimedPageCount;
+			{
+				const WorkBudget::ScopedSlot slot {WorkBudget::WorkClass::Background};
+				reclaimedPageCount = db.reclaimFreePages(std::min(_databaseVacuumStepPageCount, stepStats.totalElems - stepStats.processedElems));
+			}
+			if (reclaimedPageCount == 0)
+				break;
+
+			stepStats.processedElems += reclaimedPageCount;
+			stats.reclaimedDatabaseBytes += reclaimedPageCount * freeSpace.pageSize;
+			notifyInProgressIfNeeded(stepStats);
+
+			std::this_thread::sleep_for(stepPause);
+		}
+
+		notifyInProgress(stepStats);
+		LMS_LOG(DBUPDATER, INFO) << "Reclaimed " << stats.reclaimedDatabaseBytes << " bytes of database space";
+	}
+	catch (const std::exception& e)
+	{
+		LMS_LOG(DBUPDATER, ERROR) << "Cannot reclaim database space: " << e.what();
+	}
+}
+
 } // namespace Scanner
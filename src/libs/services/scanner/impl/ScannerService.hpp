@@ -22,7 +22,10 @@
 #include <chrono>
 #include <shared_mutex>
 #include <optional>
+#include <string>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <Wt/WDateTime.h>
 #include <Wt/WIOService.h>
@@ -30,12 +33,18 @@
 
 #include <boost/asio/system_timer.hpp>
 
+#include "services/database/Directory.hpp"
 #include "services/database/Types.hpp"
 #include "services/database/ScanSettings.hpp"
 #include "services/database/Session.hpp"
 #include "metadata/IParser.hpp"
 #include "services/scanner/IScannerService.hpp"
 #include "utils/Path.hpp"
+#include "ConcurrentFileExplorer.hpp"
+#include "FileSystemWatcher.hpp"
+#include "IoThrottle.hpp"
+#include "ParserPool.hpp"
+#include "ScanCache.hpp"
 
 class UUID;
 
@@ -61,6 +70,7 @@ namespace Scanner
 			void requestImmediateScan(bool force) override;
 
 			Status	getStatus() const override;
+			LibraryGeneration getLibraryGeneration() const override;
 			Events&	getEvents() override { return _events; }
 
 		private:
@@ -76,21 +86,79 @@ namespace Scanner
 			// Update database (scheduled callback)
 			void scan(bool force);
 
-			void scanMediaDirectory( const std::filesystem::path& mediaDirectory, bool forceScan, ScanStats& stats);
-			bool fetchTrackFeatures(Database::TrackId trackId, const UUID& MBID);
+			// Forced scans are resumed until their files are all scanned
+			bool startOrResumeForcedScan(bool forceScan);
+			void completeForcedScan();
+			void scanMediaRoots(bool forceScan, ScanStats& stats);
 			void fetchTrackFeatures(ScanStats& stats);
 
 			// Helpers
 			void refreshScanSettings();
-
-			void countAllFiles(ScanStats& stats);
-			void removeMissingTracks(ScanStats& stats);
-			void removeOrphanEntries();
+			void updateWatchedDirectory();
+			void processFileSystemChanges(const FileSystemWatcher::Changes& changes);
+
+			// Each media root is walked by its own I/O worker
+			struct MediaRoot
+			{
+				std::filesystem::path						directory;
+				std::unordered_set<std::filesystem::path>	fileExtensions;	// lower case
+			};
+			const MediaRoot* findMediaRoot(const std::filesystem::path& path) const;
+			bool isMediaRootDirectory(const std::filesystem::path& directory) const;
+			bool checkFile(const std::filesystem::path& file) const;
+			std::vector<std::filesystem::path> getMediaRootDirectories() const;
+			ConcurrentExploreFilter createSupportedFileFilter() const; // called from the walkers
+
+			struct DiscoveredFiles
+			{
+				std::unordered_set<std::filesystem::path>	files;	// supported files found in the media directory
+				bool										errors {};	// some entries could not be explored
+			};
+			DiscoveredFiles discoverFiles(ScanStats& stats);
+			void removeMissingTracks(const DiscoveredFiles& discoveredFiles, ScanStats& stats);
+			// Missing tracks are only removed once the new files had a chance to match them (moved files)
+			void addMissingTracks(const std::vector<Database::TrackId>& trackIds, ScanStats& stats);
+			void removeUnmatchedMissingTracks(ScanStats& stats);
+			void removeOrphanEntries(ScanStats& stats);
+			void updateArtistSummaries();
 			void checkDuplicatedAudioFiles(ScanStats& stats);
-			void scanAudioFile(const std::filesystem::path& file, bool forceScan, ScanStats& stats);
+
+			struct FileToScan
+			{
+				std::filesystem::path	file;
+				Wt::WDateTime			lastWriteTime;
+				std::optional<std::chrono::milliseconds>	previousDuration;	// set if audio properties can be reused from the last scan
+				std::optional<Database::TrackId>			movedTrackId;		// set if this file is a missing track that has been moved
+				bool										moveOnly {};		// moved track, no need to parse the file again
+			};
+			std::optional<FileToScan> checkAudioFile(const std::filesystem::path& file, bool forceScan, ScanStats& stats);
+			void checkMovedAudioFile(FileToScan& fileToScan);
+			void scanAudioFiles(const std::vector<FileToScan>& files, ScanStats& stats);
+			void updateAudioFile(const FileToScan& file, const MetaData::Track& trackInfo, const std::string& contentHash, ScanStats& stats);
+			void moveAudioFile(const FileToScan& file, ScanStats& stats);
+			Database::Directory::pointer getOrCreateDirectory(const std::filesystem::path& directory);
+
+			struct DirectoryFingerprint
+			{
+				Wt::WDateTime	lastWriteTime;
+				std::size_t		entryCount {};
+			};
+			struct DirectoryState
+			{
+				std::optional<DirectoryFingerprint>	fingerprint;	// not set if not available
+				bool								unchanged {};
+			};
+			using DirectoryStates = std::unordered_map<std::filesystem::path, DirectoryState>;
+			DirectoryState checkDirectory(const std::filesystem::path& directory);
+			void updateDirectories(const DirectoryStates& directoryStates, const ScanStats& stats);
 			void notifyInProgressIfNeeded(const ScanStepStats& stats);
 			void notifyInProgress(const ScanStepStats& stats);
 			void reloadSimilarityEngine(ScanStats& stats);
+			void updateReleaseCoverPaths();
+			void generateCovers(ScanStats& stats);
+			void reclaimDatabaseSpace(ScanStats& stats);
+			void notifyLibraryChanged();
+			void buildLibraryIndex();
 
 			Recommendation::IRecommendationService&	_recommendationService;
 
@@ -99,24 +167,43 @@ namespace Scanner
 			Wt::WIOService							_ioService;
 			boost::asio::system_timer				_scheduleTimer {_ioService};
 			const bool								_skipDuplicateRecordingMBID {};
+			const std::size_t						_writeBatchSize;
+			const std::chrono::milliseconds			_writeBatchMaxDuration;
+			const bool								_skipUnchangedDirectories {};
+			const std::size_t						_directoryWalkerCount;
+			const std::size_t						_featuresFetchMaxConcurrentRequests;
+			const std::filesystem::path				_featuresDumpPath;	// local AcousticBrainz dump, used instead of the API if set
+			const bool								_reuseUnchangedAudioProperties {};
+			const bool								_buildLibraryIndex {};
 			Events									_events;
 			std::chrono::system_clock::time_point	_lastScanInProgressEmit {};
 			Database::Session						_dbSession;
-			std::unique_ptr<MetaData::IParser>		_metadataParser;
+			IoThrottle								_ioThrottle;
+			ParserPool								_parserPool;
+			ScanCache								_scanCache;
+			const std::vector<std::size_t>			_coverGenerationSizes;	// empty if cover generation is disabled
+			const std::size_t						_coverGenerationThreadCount;
+			const std::size_t						_databaseVacuumStepPageCount;	// 0 if the free pages are never reclaimed
+			Wt::WIOService							_coverGenerationIOService;
+			std::unordered_set<Database::ReleaseId>	_changedReleaseIds;	// releases having new or changed tracks
+			std::unordered_map<std::string, std::vector<Database::TrackId>>	_missingTracksByContentHash; // not removed yet, may match moved files
 
 			mutable std::shared_mutex			_statusMutex;
 			State								_curState {State::NotScheduled};
 			std::optional<ScanStats> 			_lastCompleteScanStats;
 			std::optional<ScanStepStats> 		_currentScanStepStats;
 			Wt::WDateTime						_nextScheduledScan;
+			LibraryGeneration					_libraryGeneration {0, Wt::WDateTime::currentDateTime()};
 
 			// Current scan settings
 			std::size_t				_scanVersion {};
 			Wt::WTime				_startTime;
 			Database::ScanSettings::UpdatePeriod 	_updatePeriod {Database::ScanSettings::UpdatePeriod::Never};
-			std::unordered_set<std::filesystem::path>		_fileExtensions;
-			std::filesystem::path					_mediaDirectory;
+			bool									_forcedScanInProgress {};
+			std::vector<MediaRoot>					_mediaRoots;
 			Database::ScanSettings::RecommendationEngineType _recommendationServiceType;
+
+			std::unique_ptr<FileSystemWatcher>	_fileSystemWatcher; // only if enabled
 	};
 } // Scanner
 
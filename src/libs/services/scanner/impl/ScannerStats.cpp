@@ -40,6 +40,27 @@ ScanStats::nbChanges() const
 	return additions + deletions + updates;
 }
 
+std::chrono::milliseconds
+ScanStats::getStepDuration(ScanProgressStep step) const
+{
+	auto it {stepDurations.find(step)};
+	return it != std::cend(stepDurations) ? it->second : std::chrono::milliseconds {};
+}
+
+double
+ScanStats::getScanRate() const
+{
+	const std::chrono::milliseconds duration {getStepDuration(ScanProgressStep::ScanningFiles)};
+	return duration.count() ? scans * 1000. / duration.count() : 0;
+}
+
+double
+ScanStats::getScanThroughput() const
+{
+	const std::chrono::milliseconds duration {getStepDuration(ScanProgressStep::ScanningFiles)};
+	return duration.count() ? bytesScanned * 1000. / duration.count() : 0;
+}
+
 unsigned
 ScanStepStats::progress() const
 {
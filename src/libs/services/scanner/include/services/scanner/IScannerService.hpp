@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include <chrono>
+#include <memory>
 #include <optional>
 
 #include "ScannerEvents.hpp"
@@ -63,10 +65,22 @@ namespace Scanner
 
 			virtual Status getStatus() const = 0;
 
+			// Changes each time a scan modifies the library (value is persisted in the database and shared by all the instances)
+			struct LibraryGeneration
+			{
+				std::size_t		value {};
+				Wt::WDateTime	lastChangeDateTime;	// service start time if no change since
+			};
+
+			virtual LibraryGeneration getLibraryGeneration() const = 0;
+
 			virtual Events& getEvents() = 0;
 	};
 
 	std::unique_ptr<IScannerService> createScannerService(Database::Db& db, Recommendation::IRecommendationService& recommendationEngine);
 
+	// For the instances sharing the database of a primary instance: never scans, only watches the library changes made by the primary
+	std::unique_ptr<IScannerService> createReplicaScannerService(Database::Db& db, Recommendation::IRecommendationService& recommendationEngine, std::chrono::seconds pollPeriod);
+
 } // Scanner
 
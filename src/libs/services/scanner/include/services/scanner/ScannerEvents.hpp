@@ -40,6 +40,9 @@ namespace Scanner
 
 		// Called after a schedule
 		Wt::Signal<Wt::WDateTime>	scanScheduled;
+
+		// Called each time the library generation changes (also for the changes made by the primary instance)
+		Wt::Signal<>				libraryChanged;
 	};
 
 } // ns Scanner
@@ -21,10 +21,14 @@
 
 #include <Wt/WDateTime.h>
 
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <map>
 #include <vector>
 
 #include "services/database/TrackId.hpp"
+#include "utils/DurationHistogram.hpp"
 
 namespace Scanner
 {
@@ -34,6 +38,7 @@ namespace Scanner
 		CannotParseFile,		// cannot parse file
 		NoAudioTrack,			// no audio track found
 		BadDuration,			// bad duration
+		CannotWriteDatabase,	// cannot write file in database
 	};
 
 	enum class DuplicateReason
@@ -59,13 +64,17 @@ namespace Scanner
 
 	enum class ScanProgressStep : unsigned
 	{
-		ChekingForMissingFiles = 0,
-		DiscoveringFiles,
+		DiscoveringFiles = 0,
+		ChekingForMissingFiles,
 		ScanningFiles,
+		RemovingOrphanEntries,
+		CheckingForDuplicates,
 		FetchingTrackFeatures,
 		ReloadingSimilarityEngine,
+		GeneratingCovers,
+		ReclaimingDatabaseSpace,
 	};
-	static inline constexpr unsigned ScanProgressStepCount {5};
+	static inline constexpr unsigned ScanProgressStepCount {9};
 
 	// reduced scan stats
 	struct ScanStepStats
@@ -99,8 +108,18 @@ namespace Scanner
 		std::vector<ScanError>		errors;
 		std::vector<ScanDuplicate>	duplicates;
 
+		// Performance metrics
+		std::map<ScanProgressStep, std::chrono::milliseconds>	stepDurations;	// wall time spent in each step
+		std::uintmax_t		bytesScanned {};	// total size of the actually scanned files
+		DurationHistogram	parseDurations;		// per actually scanned file
+		DurationHistogram	writeDurations;		// per actually scanned file
+		std::uintmax_t		reclaimedDatabaseBytes {};	// database free pages given back to the file system
+
 		std::size_t	nbFiles() const;
 		std::size_t	nbChanges() const;
+		std::chrono::milliseconds	getStepDuration(ScanProgressStep step) const;
+		double		getScanRate() const;		// actually scanned files per second
+		double		getScanThroughput() const;	// actually scanned bytes per second
 	};
 } // namespace Scanner
 
@@ -22,6 +22,7 @@
 #include <chrono>
 #include <memory>
 #include <optional>
+#include <vector>
 
 #include "services/database/ArtistId.hpp"
 #include "services/database/ReleaseId.hpp"
@@ -55,6 +56,14 @@ namespace Scrobbling
  			virtual void onStarred(Database::UserId, Database::TrackId) {};
  			virtual void onUnstarred(Database::UserId, Database::TrackId) {};
 
+			// Batch variants, default to one call per object
+			virtual void onStarred(Database::UserId userId, const std::vector<Database::ArtistId>& artistIds) { for (Database::ArtistId artistId : artistIds) onStarred(userId, artistId); }
+			virtual void onUnstarred(Database::UserId userId, const std::vector<Database::ArtistId>& artistIds) { for (Database::ArtistId artistId : artistIds) onUnstarred(userId, artistId); }
+			virtual void onStarred(Database::UserId userId, const std::vector<Database::ReleaseId>& releaseIds) { for (Database::ReleaseId releaseId : releaseIds) onStarred(userId, releaseId); }
+			virtual void onUnstarred(Database::UserId userId, const std::vector<Database::ReleaseId>& releaseIds) { for (Database::ReleaseId releaseId : releaseIds) onUnstarred(userId, releaseId); }
+			virtual void onStarred(Database::UserId userId, const std::vector<Database::TrackId>& trackIds) { for (Database::TrackId trackId : trackIds) onStarred(userId, trackId); }
+			virtual void onUnstarred(Database::UserId userId, const std::vector<Database::TrackId>& trackIds) { for (Database::TrackId trackId : trackIds) onUnstarred(userId, trackId); }
+
 //			virtual void star(Database::TrackId trackId) = 0;
 //			virtual void unstar(Database::TrackId trackId) = 0;
 	};
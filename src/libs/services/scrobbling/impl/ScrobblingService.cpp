@@ -47,9 +47,15 @@ namespace Scrobbling
 
 	ScrobblingService::ScrobblingService(boost::asio::io_context& ioContext, Db& db)
 		: _db {db}
+		, _writeQueue {ioContext, db, [this](UserId userId, Scrobbler scrobbler)
+			{
+				// undo the star changes that have been applied before being queued
+				_starredCache.invalidate(userId, scrobbler);
+				_starGeneration++;
+			}}
 	{
 		LMS_LOG(SCROBBLING, INFO) << "Starting service...";
-		_scrobblers.emplace(Scrobbler::Internal, std::make_unique<InternalScrobbler>(_db));
+		_scrobblers.emplace(Scrobbler::Internal, std::make_unique<InternalScrobbler>(_writeQueue));
 		_scrobblers.emplace(Scrobbler::ListenBrainz, std::make_unique<ListenBrainz::Scrobbler>(ioContext, _db));
 		LMS_LOG(SCROBBLING, INFO) << "Service started!";
 	}
@@ -102,6 +108,8 @@ namespace Scrobbling
 		if (!scrobbler)
 			return res;
 
+		_writeQueue.flush(userId);
+
 		Session& session {_db.getTLSSession()};
 		auto transaction {session.createSharedTransaction()};
 
@@ -118,6 +126,8 @@ namespace Scrobbling
 		if (!scrobbler)
 			return res;
 
+		_writeQueue.flush(userId);
+
 		Session& session {_db.getTLSSession()};
 		auto transaction {session.createSharedTransaction()};
 
@@ -134,6 +144,8 @@ namespace Scrobbling
 		if (!scrobbler)
 			return res;
 
+		_writeQueue.flush(userId);
+
 		Session& session {_db.getTLSSession()};
 		auto transaction {session.createSharedTransaction()};
 
@@ -151,6 +163,8 @@ namespace Scrobbling
 		if (!scrobbler)
 			return res;
 
+		_writeQueue.flush(userId);
+
 		Session& session {_db.getTLSSession()};
 		auto transaction {session.createSharedTransaction()};
 
@@ -167,6 +181,8 @@ namespace Scrobbling
 		if (!scrobbler)
 			return res;
 
+		_writeQueue.flush(userId);
+
 		Session& session {_db.getTLSSession()};
 		auto transaction {session.createSharedTransaction()};
 
@@ -183,6 +199,8 @@ namespace Scrobbling
 		if (!scrobbler)
 			return res;
 
+		_writeQueue.flush(userId);
+
 		Session& session {_db.getTLSSession()};
 		auto transaction {session.createSharedTransaction()};
 
@@ -193,19 +211,31 @@ namespace Scrobbling
 	void
 	ScrobblingService::star(UserId userId, ArtistId artistId)
 	{
-		star<Artist, ArtistId, StarredArtist>(userId, artistId);
+		setStarred(userId, std::vector<ArtistId> {artistId}, true);
 	}
 
 	void
 	ScrobblingService::unstar(UserId userId, ArtistId artistId)
 	{
-		unstar<Artist, ArtistId, StarredArtist>(userId, artistId);
+		setStarred(userId, std::vector<ArtistId> {artistId}, false);
+	}
+
+	void
+	ScrobblingService::star(UserId userId, const std::vector<ArtistId>& artistIds)
+	{
+		setStarred(userId, artistIds, true);
+	}
+
+	void
+	ScrobblingService::unstar(UserId userId, const std::vector<ArtistId>& artistIds)
+	{
+		setStarred(userId, artistIds, false);
 	}
 
 	bool
 	ScrobblingService::isStarred(UserId userId, ArtistId artistId)
 	{
-		return isStarred<Artist, ArtistId, StarredArtist>(userId, artistId);
+		return isStarred<ArtistId, StarredArtist>(userId, artistId);
 	}
 
 	ScrobblingService::ArtistContainer
@@ -218,6 +248,8 @@ namespace Scrobbling
 		if (!scrobbler)
 			return {};
 
+		_writeQueue.flush(userId);
+
 		Artist::FindParameters params;
 		params.setStarringUser(userId, *scrobbler);
 		params.setClusters(clusterIds);
@@ -234,19 +266,31 @@ namespace Scrobbling
 	void
 	ScrobblingService::star(UserId userId, ReleaseId releaseId)
 	{
-		star<Release, ReleaseId, StarredRelease>(userId, releaseId);
+		setStarred(userId, std::vector<ReleaseId> {releaseId}, true);
 	}
 
 	void
 	ScrobblingService::unstar(UserId userId, ReleaseId releaseId)
 	{
-		unstar<Release, ReleaseId, StarredRelease>(userId, releaseId);
+		setStarred(userId, std::vector<ReleaseId> {releaseId}, false);
+	}
+
+	void
+	ScrobblingService::star(UserId userId, const std::vector<ReleaseId>& releaseIds)
+	{
+		setStarred(userId, releaseIds, true);
+	}
+
+	void
+	ScrobblingService::unstar(UserId userId, const std::vector<ReleaseId>& releaseIds)
+	{
+		setStarred(userId, releaseIds, false);
 	}
 
 	bool
 	ScrobblingService::isStarred(UserId userId, ReleaseId releaseId)
 	{
-		return isStarred<Release, ReleaseId, StarredRelease>(userId, releaseId);
+		return isStarred<ReleaseId, StarredRelease>(userId, releaseId);
 	}
 
 	ScrobblingService::ReleaseContainer
@@ -256,6 +300,8 @@ namespace Scrobbling
 		if (!scrobbler)
 			return {};
 
+		_writeQueue.flush(userId);
+
 		Release::FindParameters params;
 		params.setStarringUser(userId, *scrobbler);
 		params.setClusters(clusterIds);
@@ -271,19 +317,31 @@ namespace Scrobbling
 	void
 	ScrobblingService::star(UserId userId, TrackId trackId)
 	{
-		star<Track, TrackId, StarredTrack>(userId, trackId);
+		setStarred(userId, std::vector<TrackId> {trackId}, true);
 	}
 
 	void
 	ScrobblingService::unstar(UserId userId, TrackId trackId)
 	{
-		unstar<Track, TrackId, StarredTrack>(userId, trackId);
+		setStarred(userId, std::vector<TrackId> {trackId}, false);
+	}
+
+	void
+	ScrobblingService::star(UserId userId, const std::vector<TrackId>& trackIds)
+	{
+		setStarred(userId, trackIds, true);
+	}
+
+	void
+	ScrobblingService::unstar(UserId userId, const std::vector<TrackId>& trackIds)
+	{
+		setStarred(userId, trackIds, false);
 	}
 
 	bool
 	ScrobblingService::isStarred(UserId userId, TrackId trackId)
 	{
-		return isStarred<Track, TrackId, StarredTrack>(userId, trackId);
+		return isStarred<TrackId, StarredTrack>(userId, trackId);
 	}
 
 	ScrobblingService::TrackContainer
@@ -293,6 +351,8 @@ namespace Scrobbling
 		if (!scrobbler)
 			return {};
 
+		_writeQueue.flush(userId);
+
 		Track::FindParameters params;
 		params.setStarringUser(userId, *scrobbler);
 		params.setClusters(clusterIds);
@@ -19,12 +19,15 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <optional>
 #include <unordered_map>
 
 #include "services/scrobbling/IScrobblingService.hpp"
 #include "IScrobbler.hpp"
+#include "StarredCache.hpp"
+#include "WriteQueue.hpp"
 
 namespace Scrobbling
 {
@@ -84,17 +87,27 @@ namespace Scrobbling
 			bool isStarred(Database::UserId userId, Database::TrackId trackId) override;
 			TrackContainer getStarredTracks(Database::UserId userId, const std::vector<Database::ClusterId>& clusterIds, Database::Range range) override;
 
+			void star(Database::UserId userId, const std::vector<Database::ArtistId>& artistIds) override;
+			void unstar(Database::UserId userId, const std::vector<Database::ArtistId>& artistIds) override;
+			void star(Database::UserId userId, const std::vector<Database::ReleaseId>& releaseIds) override;
+			void unstar(Database::UserId userId, const std::vector<Database::ReleaseId>& releaseIds) override;
+			void star(Database::UserId userId, const std::vector<Database::TrackId>& trackIds) override;
+			void unstar(Database::UserId userId, const std::vector<Database::TrackId>& trackIds) override;
+
+			std::size_t getStarGeneration() const override { return _starGeneration; }
+
 			std::optional<Database::Scrobbler> getUserScrobbler(Database::UserId userId);
 
-			template <typename ObjType, typename ObjIdType, typename StarredObjType>
-			void star(Database::UserId userId, ObjIdType id);
-			template <typename ObjType, typename ObjIdType, typename StarredObjType>
-			void unstar(Database::UserId userId, ObjIdType id);
-			template <typename ObjType, typename ObjIdType, typename StarredObjType>
+			template <typename ObjIdType>
+			void setStarred(Database::UserId userId, const std::vector<ObjIdType>& ids, bool starred);
+			template <typename ObjIdType, typename StarredObjType>
 			bool isStarred(Database::UserId userId, ObjIdType id);
 
 			Database::Db& _db;
+			StarredCache _starredCache;	// used by _writeQueue
+			WriteQueue _writeQueue;
 			std::unordered_map<Database::Scrobbler, std::unique_ptr<IScrobbler>> _scrobblers;
+			std::atomic<std::size_t> _starGeneration {};
 	};
 
 } // ns Scrobbling
@@ -27,55 +27,27 @@ namespace Scrobbling
 {
 	using namespace Database;
 
-	template <typename ObjType, typename ObjIdType, typename StarredObjType>
+	template <typename ObjIdType>
 	void
-	ScrobblingService::star(UserId userId, ObjIdType objId)
+	ScrobblingService::setStarred(UserId userId, const std::vector<ObjIdType>& objIds, bool starred)
 	{
-		auto scrobbler {getUserScrobbler(userId)};
-		if (!scrobbler)
+		if (objIds.empty())
 			return;
 
-		{
-			Session& session {_db.getTLSSession()};
-			auto transaction {session.createUniqueTransaction()};
-
-			typename StarredObjType::pointer starredObj {StarredObjType::find(session, objId, userId, *scrobbler)};
-			if (!starredObj)
-			{
-				const typename ObjType::pointer obj {ObjType::find(session, objId)};
-				if (!obj)
-					return;
-
-				const User::pointer user {User::find(session, userId)};
-				if (!user)
-					return;
-
-				starredObj = StarredObjType::create(session, obj, user, *scrobbler);
-			}
-			starredObj.modify()->setDateTime(Wt::WDateTime::currentDateTime());
-		}
-		_scrobblers[*scrobbler]->onStarred(userId, objId);
-	}
-
-	template <typename ObjType, typename ObjIdType, typename StarredObjType>
-	void
-	ScrobblingService::unstar(UserId userId, ObjIdType objId)
-	{
 		auto scrobbler {getUserScrobbler(userId)};
 		if (!scrobbler)
 			return;
 
-		{
-			Session& session {_db.getTLSSession()};
-			auto transaction {session.createUniqueTransaction()};
-
-			if (typename StarredObjType::pointer starredObj {StarredObjType::find(session, objId, userId, *scrobbler)})
-				starredObj.remove();
-		}
-		_scrobblers[*scrobbler]->onUnstarred(userId, objId);
+		_starredCache.setStarred(userId, *scrobbler, objIds, starred);
+		_writeQueue.setStarred(userId, *scrobbler, objIds, starred);
+		_starGeneration++;
+		if (starred)
+			_scrobblers[*scrobbler]->onStarred(userId, objIds);
+		else
+			_scrobblers[*scrobbler]->onUnstarred(userId, objIds);
 	}
 
-	template <typename ObjType, typename ObjIdType, typename StarredObjType>
+	template <typename ObjIdType, typename StarredObjType>
 	bool
 	ScrobblingService::isStarred(UserId userId, ObjIdType objId)
 	{
@@ -83,10 +55,23 @@ namespace Scrobbling
 		if (!scrobbler)
 			return false;
 
-		Session& session {_db.getTLSSession()};
-		auto transaction {session.createSharedTransaction()};
+		if (const std::optional<bool> starred {_starredCache.isStarred(userId, *scrobbler, objId)})
+			return *starred;
+
+		// First use: the stars made from now on are applied by the cache once loaded, the previous ones must be committed
+		_starredCache.beginLoad<ObjIdType>(userId, *scrobbler);
+		_writeQueue.flush(userId);
+
+		std::vector<ObjIdType> starredObjIds;
+		{
+			Session& session {_db.getTLSSession()};
+			auto transaction {session.createSharedTransaction()};
+
+			starredObjIds = StarredObjType::findIds(session, userId, *scrobbler);
+		}
+		_starredCache.endLoad(userId, *scrobbler, starredObjIds);
 
-		return StarredObjType::find(session, objId, userId, *scrobbler);
+		return _starredCache.isStarred(userId, *scrobbler, objId).value_or(false);
 	}
 
 } // ns Scrobbling
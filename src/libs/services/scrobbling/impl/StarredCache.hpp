@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "services/database/ArtistId.hpp"
+#include "services/database/ReleaseId.hpp"
+#include "services/database/TrackId.hpp"
+#include "services/database/Types.hpp"
+#include "services/database/UserId.hpp"
+
+namespace Scrobbling
+{
+	// In memory sets of the objects starred by each user, for each scrobbler
+	// A set is loaded on first use, star changes made while it is being loaded are applied once loaded
+	class StarredCache
+	{
+		public:
+			// std::nullopt if not loaded yet
+			template <typename ObjIdType>
+			std::optional<bool> isStarred(Database::UserId userId, Database::Scrobbler scrobbler, ObjIdType objId) const
+			{
+				const std::scoped_lock lock {_mutex};
+
+				const StarredSets<ObjIdType>& sets {std::get<StarredSets<ObjIdType>>(_starredSets)};
+				auto it {sets.find({userId, scrobbler})};
+				if (it == std::cend(sets) || !it->second.loaded)
+					return std::nullopt;
+
+				return it->second.objIds.find(objId) != std::cend(it->second.objIds);
+			}
+
+			// To be called before reading the starred objects from the database
+			template <typename ObjIdType>
+			void beginLoad(Database::UserId userId, Database::Scrobbler scrobbler)
+			{
+				const std::scoped_lock lock {_mutex};
+				std::get<StarredSets<ObjIdType>>(_starredSets).try_emplace({userId, scrobbler});
+			}
+
+			template <typename ObjIdType>
+			void endLoad(Database::UserId userId, Database::Scrobbler scrobbler, const std::vector<ObjIdType>& starredObjIds)
+			{
+				const std::scoped_lock lock {_mutex};
+
+				StarredSet<ObjIdType>& set {std::get<StarredSets<ObjIdType>>(_starredSets)[{userId, scrobbler}]};
+				if (set.loaded) // concurrently loaded
+					return;
+
+				set.objIds.insert(std::cbegin(starredObjIds), std::cend(starredObjIds));
+				for (const auto& [objId, starred] : set.changesDuringLoad)
+					apply(set, objId, starred);
+
+				set.changesDuringLoad.clear();
+				set.loaded = true;
+			}
+
+			template <typename ObjIdType>
+			void setStarred(Database::UserId userId, Database::Scrobbler scrobbler, const std::vector<ObjIdType>& objIds, bool starred)
+			{
+				const std::scoped_lock lock {_mutex};
+
+				StarredSets<ObjIdType>& sets {std::get<StarredSets<ObjIdType>>(_starredSets)};
+				auto it {sets.find({userId, scrobbler})};
+				if (it == std::end(sets))
+					return; // will be loaded from the database
+
+				for (const ObjIdType objId : objIds)
+				{
+					if (it->second.loaded)
+						apply(it->second, objId, starred);
+					else
+						it->second.changesDuringLoad.emplace_back(objId, starred);
+				}
+			}
+
+			// The sets of this user are reloaded from the database on next use (ex: star changes that could not be committed)
+			void invalidate(Database::UserId userId, Database::Scrobbler scrobbler)
+			{
+				const std::scoped_lock lock {_mutex};
+				std::apply([&](auto&... sets) { (sets.erase({userId, scrobbler}), ...); }, _starredSets);
+			}
+
+		private:
+			template <typename ObjIdType>
+			struct StarredSet
+			{
+				bool									loaded {};
+				std::unordered_set<ObjIdType>			objIds;
+				std::vector<std::pair<ObjIdType, bool>>	changesDuringLoad;
+			};
+
+			template <typename ObjIdType>
+			static void apply(StarredSet<ObjIdType>& set, ObjIdType objId, bool starred)
+			{
+				if (starred)
+					set.objIds.insert(objId);
+				else
+					set.objIds.erase(objId);
+			}
+
+			template <typename ObjIdType>
+			using StarredSets = std::map<std::pair<Database::UserId, Database::Scrobbler>, StarredSet<ObjIdType>>;
+
+			mutable std::mutex	_mutex;
+			std::tuple<StarredSets<Database::ArtistId>, StarredSets<Database::ReleaseId>, StarredSets<Database::TrackId>> _starredSets;
+	};
+} // ns Scrobbling
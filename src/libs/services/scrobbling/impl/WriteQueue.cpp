@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "WriteQueue.hpp"
+
+#include <algorithm>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <Wt/Dbo/Exception.h>
+
+#include "services/database/Db.hpp"
+#include "services/database/Listen.hpp"
+#include "services/database/Session.hpp"
+#include "services/database/StarredArtist.hpp"
+#include "services/database/StarredRelease.hpp"
+#include "services/database/StarredTrack.hpp"
+#include "services/database/Track.hpp"
+#include "services/database/User.hpp"
+#include "utils/Logger.hpp"
+
+namespace Scrobbling
+{
+	using namespace Database;
+
+	namespace
+	{
+		void
+		saveListen(Session& session, const TimedListen& listen)
+		{
+			if (Database::Listen::find(session, listen.userId, listen.trackId, Scrobbler::Internal, listen.listenedAt))
+				return;
+
+			const User::pointer user {User::find(session, listen.userId)};
+			if (!user)
+				return;
+
+			const Track::pointer track {Track::find(session, listen.trackId)};
+			if (!track)
+				return;
+
+			auto dbListen {Database::Listen::create(session, user, track, Scrobbler::Internal, listen.listenedAt)};
+			dbListen.modify()->setScrobblingState(ScrobblingState::Synchronized);
+		}
+	}
+
+	WriteQueue::WriteQueue(boost::asio::io_context& ioContext, Db& db, DroppedStarsCallback droppedStarsCallback)
+		: _db {db}
+		, _droppedStarsCallback {std::move(droppedStarsCallback)}
+		, _strand {ioContext}
+		, _flushTimer {ioContext}
+	{
+	}
+
+	WriteQueue::~WriteQueue()
+	{
+		{
+			const std::scoped_lock lock {_mutex};
+			_stopped = true;
+			_flushTimer.cancel();
+		}
+
+		const std::scoped_lock flushLock {_flushMutex};
+		flush();
+	}
+
+	void
+	WriteQueue::addListen(const TimedListen& listen)
+	{
+		const std::scoped_lock lock {_mutex};
+
+		_pendingListens.push_back(listen);
+		onWriteAdded();
+	}
+
+	void
+	WriteQueue::processScheduledFlush()
+	{
+		{
+			const std::scoped_lock lock {_mutex};
+			_flushScheduled = false;
+		}
+
+		const std::scoped_lock flushLock {_flushMutex};
+		flush();
+	}
+
+	void
+	WriteQueue::onWriteAdded(std::size_t writeCount)
+	{
+		const bool reachedMaxPendingWriteCount {_pendingWriteCount < _maxPendingWriteCount && _pendingWriteCount + writeCount >= _maxPendingWriteCount};
+		_pendingWriteCount += writeCount;
+		// no need to hurry while failing
+		if (reachedMaxPendingWriteCount && _failedCommitCount == 0)
+		{
+			boost::asio::post(_strand, [this] { processScheduledFlush(); });
+			return;
+		}
+
+		if (_flushScheduled)
+			return;
+
+		scheduleFlush(_maxWriteDelay);
+	}
+
+	void
+	WriteQueue::scheduleFlush(std::chrono::milliseconds delay)
+	{
+		// also cancels the wait in progress, if any
+		_flushScheduled = true;
+		_flushTimer.expires_after(delay);
+		_flushTimer.async_wait(boost::asio::bind_executor(_strand, [this](const boost::system::error_code& ec)
+		{
+			if (ec == boost::asio::error::operation_aborted)
+				return;
+
+			processScheduledFlush();
+		}));
+	}
+
+	bool
+	WriteQueue::hasPendingWrites(UserId userId) const
+	{
+		if (std::any_of(std::cbegin(_pendingListens), std::cend(_pendingListens), [=](const TimedListen& listen) { return listen.userId == userId; }))
+			return true;
+
+		return std::apply([=](const auto&... pendingStars)
+		{
+			return (std::any_of(std::cbegin(pendingStars), std::cend(pendingStars), [=](const auto& entry) { return std::get<UserId>(entry.first) == userId; }) || ...);
+		}, _pendingStars);
+	}
+
+	void
+	WriteQueue::flush(UserId userId)
+	{
+		// also waits for the commit in progress, if any
+		const std::scoped_lock flushLock {_flushMutex};
+
+		{
+			const std::scoped_lock lock {_mutex};
+			if (!hasPendingWrites(userId))
+				return;
+
+			// Do not bypass the retry delay, pending stars are still served by isStarred
+			if (_failedCommitCount > 0)
+				return;
+		}
+
+		flush();
+	}
+
+	void
+	WriteQueue::flush()
+	{
+		std::vector<TimedListen> listens;
+		AllPendingStars pendingStars;
+		{
+			const std::scoped_lock lock {_mutex};
+
+			listens.swap(_pendingListens);
+			// copied: keep on serving them until they are committed
+			pendingStars = _pendingStars;
+			_pendingWriteCount = 0;
+		}
+
+		if (listens.empty() && std::apply([](const auto&... stars) { return (stars.empty() && ...); }, pendingStars))
+			return;
+
+		bool committed {};
+		try
+		{
+			commit(listens, pendingStars);
+			committed = true;
+		}
+		catch (const Wt::Dbo::Exception& e)
+		{
+			LMS_LOG(SCROBBLING, ERROR) << "Cannot commit " << listens.size() << " listens and star changes: " << e.what();
+		}
+
+		std::set<std::pair<UserId, Scrobbler>> droppedStarOwners;
+		{
+			const std::scoped_lock lock {_mutex};
+
+			if (!committed)
+			{
+				_failedCommitCount++;
+				if (_failedCommitCount < _maxCommitAttemptCount && !_stopped)
+				{
+					// Retried first, along with the writes added meanwhile. Pending stars have been kept
+					_pendingListens.insert(std::begin(_pendingListens), std::cbegin(listens), std::cend(listens));
+					_pendingWriteCount += listens.size();
+
+					const std::chrono::milliseconds retryDelay {_maxWriteDelay * (1 << _failedCommitCount)};
+					LMS_LOG(SCROBBLING, INFO) << "Retrying in " << retryDelay.count() << " ms (attempt " << _failedCommitCount + 1 << "/" << _maxCommitAttemptCount << ")";
+					scheduleFlush(retryDelay);
+					return;
+				}
+
+				LMS_LOG(SCROBBLING, ERROR) << "Dropping " << listens.size() << " listens and star changes after " << _failedCommitCount << " failed attempts";
+				getStarOwners(std::get<PendingStars<ArtistId>>(pendingStars), droppedStarOwners);
+				getStarOwners(std::get<PendingStars<ReleaseId>>(pendingStars), droppedStarOwners);
+				getStarOwners(std::get<PendingStars<TrackId>>(pendingStars), droppedStarOwners);
+			}
+
+			_failedCommitCount = 0;
+			removeCommittedStars(std::get<PendingStars<ArtistId>>(_pendingStars), std::get<PendingStars<ArtistId>>(pendingStars));
+			removeCommittedStars(std::get<PendingStars<ReleaseId>>(_pendingStars), std::get<PendingStars<ReleaseId>>(pendingStars));
+			removeCommittedStars(std::get<PendingStars<TrackId>>(_pendingStars), std::get<PendingStars<TrackId>>(pendingStars));
+		}
+
+		for (const auto& [userId, scrobbler] : droppedStarOwners)
+			_droppedStarsCallback(userId, scrobbler);
+	}
+
+	void
+	WriteQueue::commit(const std::vector<TimedListen>& listens, const AllPendingStars& pendingStars)
+	{
+		Session& session {_db.getTLSSession()};
+		auto transaction {session.createUniqueTransaction()};
+
+		for (const TimedListen& listen : listens)
+			saveListen(session, listen);
+
+		commitStars<StarredArtist>(session, std::get<PendingStars<ArtistId>>(pendingStars));
+		commitStars<StarredRelease>(session, std::get<PendingStars<ReleaseId>>(pendingStars));
+		commitStars<StarredTrack>(session, std::get<PendingStars<TrackId>>(pendingStars));
+
+		LMS_LOG(SCROBBLING, DEBUG) << "Committed " << listens.size() << " listens and "
+			<< std::apply([](const auto&... stars) { return (stars.size() + ...); }, pendingStars) << " star changes";
+	}
+
+	template <typename StarredObjType, typename ObjIdType>
+	void
+	WriteQueue::commitStars(Session& session, const PendingStars<ObjIdType>& pendingStars)
+	{
+		// Objects starred or unstarred together share the same date time: apply them using set based operations
+		std::map<std::tuple<UserId, Scrobbler, bool, Wt::WDateTime>, std::vector<ObjIdType>> batches;
+		for (const auto& [key, pendingStar] : pendingStars)
+		{
+			const auto& [userId, scrobbler, objId] {key};
+			batches[{userId, scrobbler, pendingStar.starred, pendingStar.starred ? pendingStar.dateTime : Wt::WDateTime {}}].push_back(objId);
+		}
+
+		for (const auto& [key, objIds] : batches)
+		{
+			const auto& [userId, scrobbler, starred, dateTime] {key};
+			if (starred)
+				StarredObjType::setStarred(session, userId, scrobbler, objIds, dateTime);
+			else
+				StarredObjType::unsetStarred(session, userId, scrobbler, objIds);
+		}
+	}
+} // ns Scrobbling
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/io_context_strand.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <Wt/WDateTime.h>
+
+#include "services/database/ArtistId.hpp"
+#include "services/database/ReleaseId.hpp"
+#include "services/database/TrackId.hpp"
+#include "services/database/Types.hpp"
+#include "services/database/UserId.hpp"
+#include "services/scrobbling/Listen.hpp"
+
+namespace Database
+{
+	class Db;
+	class Session;
+}
+
+namespace Scrobbling
+{
+	// Coalesces the internal listens and the star/unstar writes, and commits them in batches from a dedicated strand
+	// Pending stars are visible through isStarred until they are committed
+	// Failed commits are retried with a backoff, the writes are only dropped once all the attempts failed
+	class WriteQueue
+	{
+		public:
+			// Called, unlocked, for each user whose star changes have been dropped
+			using DroppedStarsCallback = std::function<void(Database::UserId, Database::Scrobbler)>;
+
+			WriteQueue(boost::asio::io_context& ioContext, Database::Db& db, DroppedStarsCallback droppedStarsCallback);
+			~WriteQueue();
+
+			WriteQueue(const WriteQueue&) = delete;
+			WriteQueue& operator=(const WriteQueue&) = delete;
+
+			// listen to be saved using the internal scrobbler
+			void addListen(const TimedListen& listen);
+
+			// all the objects share the same date time, so that they can be committed together
+			template <typename ObjIdType>
+			void setStarred(Database::UserId userId, Database::Scrobbler scrobbler, const std::vector<ObjIdType>& objIds, bool starred)
+			{
+				if (objIds.empty())
+					return;
+
+				const Wt::WDateTime now {Wt::WDateTime::currentDateTime()};
+
+				const std::scoped_lock lock {_mutex};
+
+				for (const ObjIdType objId : objIds)
+				{
+					PendingStar& pendingStar {std::get<PendingStars<ObjIdType>>(_pendingStars)[{userId, scrobbler, objId}]};
+					pendingStar.starred = starred;
+					pendingStar.dateTime = now;
+					pendingStar.sequence = ++_sequence;
+				}
+
+				onWriteAdded(objIds.size());
+			}
+
+			// std::nullopt if there is no pending write for this object
+			template <typename ObjIdType>
+			std::optional<bool> isStarred(Database::UserId userId, Database::Scrobbler scrobbler, ObjIdType objId) const
+			{
+				const std::scoped_lock lock {_mutex};
+
+				const PendingStars<ObjIdType>& pendingStars {std::get<PendingStars<ObjIdType>>(_pendingStars)};
+				auto it {pendingStars.find({userId, scrobbler, objId})};
+				if (it == std::cend(pendingStars))
+					return std::nullopt;
+
+				return it->second.starred;
+			}
+
+			// synchronously commits the pending writes if some of them concern this user
+			// Used to get consistent results in the queries that are not served by the pending writes
+			void flush(Database::UserId userId);
+
+		private:
+			struct PendingStar
+			{
+				bool			starred {};
+				Wt::WDateTime	dateTime;
+				std::size_t		sequence {}; // used to detect changes made during a commit
+			};
+
+			template <typename ObjIdType>
+			using PendingStars = std::map<std::tuple<Database::UserId, Database::Scrobbler, ObjIdType>, PendingStar>;
+			using AllPendingStars = std::tuple<PendingStars<Database::ArtistId>, PendingStars<Database::ReleaseId>, PendingStars<Database::TrackId>>;
+
+			// _mutex must be held
+			void onWriteAdded(std::size_t writeCount = 1);
+			void scheduleFlush(std::chrono::milliseconds delay);
+			bool hasPendingWrites(Database::UserId userId) const;
+
+			void processScheduledFlush();
+
+			// _flushMutex must be held
+			void flush();
+
+			void commit(const std::vector<TimedListen>& listens, const AllPendingStars& pendingStars);
+			template <typename StarredObjType, typename ObjIdType>
+			static void commitStars(Database::Session& session, const PendingStars<ObjIdType>& pendingStars);
+
+			template <typename ObjIdType>
+			static void getStarOwners(const PendingStars<ObjIdType>& pendingStars, std::set<std::pair<Database::UserId, Database::Scrobbler>>& owners)
+			{
+				for (const auto& [key, pendingStar] : pendingStars)
+					owners.emplace(std::get<Database::UserId>(key), std::get<Database::Scrobbler>(key));
+			}
+
+			template <typename ObjIdType>
+			static void removeCommittedStars(PendingStars<ObjIdType>& pendingStars, const PendingStars<ObjIdType>& committedStars)
+			{
+				for (const auto& [key, committedStar] : committedStars)
+				{
+					auto it {pendingStars.find(key)};
+					if (it != std::end(pendingStars) && it->second.sequence == committedStar.sequence)
+						pendingStars.erase(it);
+				}
+			}
+
+			static constexpr std::size_t				_maxPendingWriteCount {100};
+			static constexpr std::chrono::milliseconds	_maxWriteDelay {1000};
+			static constexpr std::size_t				_maxCommitAttemptCount {5};	// the retry delay doubles after each failure
+
+			Database::Db&					_db;
+			const DroppedStarsCallback		_droppedStarsCallback;
+			boost::asio::io_context::strand	_strand;
+
+			std::mutex						_flushMutex; // held during the whole flush operations
+
+			mutable std::mutex				_mutex; // protects all the members below
+			boost::asio::steady_timer		_flushTimer;
+			bool							_flushScheduled {};
+			std::size_t						_pendingWriteCount {};
+			std::size_t						_sequence {};
+			std::size_t						_failedCommitCount {};	// of the current writes
+			bool							_stopped {};
+			std::vector<TimedListen>		_pendingListens;
+			AllPendingStars					_pendingStars;
+	};
+} // ns Scrobbling
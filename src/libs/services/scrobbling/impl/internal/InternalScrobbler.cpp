@@ -19,16 +19,12 @@
 
 #include "InternalScrobbler.hpp"
 
-#include "services/database/Db.hpp"
-#include "services/database/Listen.hpp"
-#include "services/database/Session.hpp"
-#include "services/database/User.hpp"
-#include "services/database/Track.hpp"
+#include "WriteQueue.hpp"
 
 namespace Scrobbling
 {
-	InternalScrobbler::InternalScrobbler(Database::Db& db)
-		: _db {db}
+	InternalScrobbler::InternalScrobbler(WriteQueue& writeQueue)
+		: _writeQueue {writeQueue}
 	{}
 
 	void
@@ -50,22 +46,7 @@ namespace Scrobbling
 	void
 	InternalScrobbler::addTimedListen(const TimedListen& listen)
 	{
-		Database::Session& session {_db.getTLSSession()};
-		auto transaction {session.createUniqueTransaction()};
-
-		if (Database::Listen::find(session, listen.userId, listen.trackId, Database::Scrobbler::Internal, listen.listenedAt))
-			return;
-
-		const Database::User::pointer user {Database::User::find(session, listen.userId)};
-		if (!user)
-			return;
-
-		const Database::Track::pointer track {Database::Track::find(session, listen.trackId)};
-		if (!track)
-			return;
-
-		auto dbListen {Database::Listen::create(session, user, track, Database::Scrobbler::Internal, listen.listenedAt)};
-		dbListen.modify()->setScrobblingState(Database::ScrobblingState::Synchronized);
+		_writeQueue.addListen(listen);
 	}
 } // Scrobbling
 
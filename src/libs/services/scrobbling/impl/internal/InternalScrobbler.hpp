@@ -21,17 +21,14 @@
 
 #include "IScrobbler.hpp"
 
-namespace Database
-{
-	class Db;
-}
-
 namespace Scrobbling
 {
+	class WriteQueue;
+
 	class InternalScrobbler final : public IScrobbler
 	{
 		public:
-			InternalScrobbler(Database::Db&	db);
+			InternalScrobbler(WriteQueue& writeQueue);
 
 		private:
 			// IScrobbler
@@ -39,7 +36,7 @@ namespace Scrobbling
 			void listenFinished(const Listen& listen, std::optional<std::chrono::seconds> duration) override;
 			void addTimedListen(const TimedListen& listen) override;
 
-			Database::Db&			_db;
+			WriteQueue&			_writeQueue;
 	};
 } // Scrobbling
 
@@ -55,7 +55,7 @@ namespace Scrobbling::ListenBrainz
 		: _ioContext {ioContext}
 		, _db {db}
 		, _baseAPIUrl {Service<IConfig>::get()->getString("listenbrainz-api-base-url", "https://api.listenbrainz.org")}
-		, _client {Http::createClient(_ioContext, _baseAPIUrl)}
+		, _client {Http::createClient(_ioContext, _baseAPIUrl, Http::defaultMaxResponseSize, Service<IConfig>::get()->getULong("listenbrainz-max-concurrent-requests", 4))}
 		, _listensSynchronizer {_ioContext, db, *_client}
 	{
 		LOG(INFO) << "Starting ListenBrainz scrobbler... API endpoint = '" << _baseAPIUrl;
@@ -19,6 +19,8 @@
 
 #include "ListenBrainzScrobbler.hpp"
 
+#include <sstream>
+
 #include <boost/asio/bind_executor.hpp>
 #include <Wt/Json/Array.h>
 #include <Wt/Json/Object.h>
@@ -36,8 +38,10 @@
 #include "services/scrobbling/Exception.hpp"
 #include "utils/IConfig.hpp"
 #include "utils/http/IClient.hpp"
+#include "utils/JsonStreamParser.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Service.hpp"
+#include "utils/String.hpp"
 
 #include "Utils.hpp"
 
@@ -128,72 +132,240 @@ namespace
 		return res;
 	}
 
+	// sentListens: listens that could be converted, in the same order
+	std::string
+	listensToJsonString(Database::Session& session, const std::vector<Scrobbling::TimedListen>& listens, std::vector<Scrobbling::TimedListen>& sentListens)
+	{
+		std::string res;
+
+		Wt::Json::Array payloads;
+		for (const Scrobbling::TimedListen& listen : listens)
+		{
+			std::optional<Wt::Json::Object> payload {listenToJsonPayload(session, listen, listen.listenedAt)};
+			if (!payload)
+				continue;
+
+			payloads.push_back(std::move(*payload));
+			sentListens.push_back(listen);
+		}
+
+		if (payloads.empty())
+			return res;
+
+		Wt::Json::Object root;
+		// "single" only accepts one listen
+		root["listen_type"] = Wt::Json::Value {std::string {payloads.size() == 1 ? "single" : "import"}};
+		root["payload"] = std::move(payloads);
+
+		res = Wt::Json::serialize(root);
+		return res;
+	}
+
+	// Extracts some scalar values, the rest of the document is skipped
+	class ScalarExtractor : public JsonStream::IHandler
+	{
+		public:
+			ScalarExtractor(std::initializer_list<std::string_view> paths)
+				: _paths {paths}
+			{}
+
+			std::optional<std::string_view>
+			getValue(std::string_view path, JsonStream::ScalarType type) const
+			{
+				auto it {_values.find(std::string {path})};
+				if (it == std::cend(_values) || it->second.first != type)
+					return std::nullopt;
+
+				return it->second.second;
+			}
+
+		private:
+			bool onStartObject(std::string_view path) override
+			{
+				return path.empty() || std::any_of(std::cbegin(_paths), std::cend(_paths), [&](std::string_view wantedPath)
+				{
+					return wantedPath.size() > path.size() && wantedPath.substr(0, path.size()) == path && wantedPath[path.size()] == '.';
+				});
+			}
+
+			bool onStartArray(std::string_view) override
+			{
+				return false;
+			}
+
+			void onScalar(std::string_view path, JsonStream::ScalarType type, std::string_view value) override
+			{
+				if (std::find(std::cbegin(_paths), std::cend(_paths), path) != std::cend(_paths))
+					_values[std::string {path}] = {type, std::string {value}};
+			}
+
+			const std::vector<std::string_view> _paths;
+			std::unordered_map<std::string, std::pair<JsonStream::ScalarType, std::string>> _values;
+	};
+
 	std::string
 	parseValidateToken(std::string_view msgBody)
 	{
 		std::string listenBrainzUserName;
 
-		Wt::Json::ParseError error;
-		Wt::Json::Object root;
-		if (!Wt::Json::parse(std::string {msgBody}, root, error))
+		ScalarExtractor extractor {"valid", "user_name"};
+		if (!JsonStream::parse(msgBody, extractor))
 		{
-			LOG(ERROR) << "Cannot parse 'validate-token' result: " << error.what();
+			LOG(ERROR) << "Cannot parse 'validate-token' result: malformed JSON";
 			return listenBrainzUserName;
 		}
 
-		if (!root.get("valid").orIfNull(false))
+		if (extractor.getValue("valid", JsonStream::ScalarType::Boolean) != "true")
 		{
 			LOG(INFO) << "Invalid listenbrainz user";
 			return listenBrainzUserName;
 		}
 
-		listenBrainzUserName = root.get("user_name").orIfNull("");
+		listenBrainzUserName = extractor.getValue("user_name", JsonStream::ScalarType::String).value_or("");
 		return listenBrainzUserName;
 	}
 
 	std::optional<std::size_t>
 	parseListenCount(std::string_view msgBody)
 	{
-		try
+		ScalarExtractor extractor {"payload.count"};
+		if (!JsonStream::parse(msgBody, extractor))
 		{
-			Wt::Json::Object root;
-			Wt::Json::parse(std::string {msgBody}, root);
-
-			const Wt::Json::Object& payload {static_cast<const Wt::Json::Object&>(root.get("payload"))};
-			return static_cast<int>(payload.get("count"));
+			LOG(ERROR) << "Cannot parse listen count response: malformed JSON";
+			return std::nullopt;
 		}
-		catch (const Wt::WException& e)
+
+		const std::optional<std::string_view> count {extractor.getValue("payload.count", JsonStream::ScalarType::Number)};
+		if (!count)
 		{
-			LOG(ERROR) << "Cannot parse listen count response: " << e.what();
+			LOG(ERROR) << "Cannot parse listen count response: missing count";
 			return std::nullopt;
 		}
+
+		return StringUtils::readAs<std::size_t>(*count);
 	}
 
+	// Only the fields used to match a listen
+	struct ListenMetadata
+	{
+		std::optional<std::string>	trackName;		// mandatory
+		std::optional<std::string>	releaseName;	// mandatory
+		std::string					artistName;
+		std::optional<UUID>			recordingMBID;
+		std::optional<UUID>			releaseMBID;
+		std::optional<int>			trackNumber;
+
+		// the same tracks are often listened several times
+		std::string
+		computeKey() const
+		{
+			std::ostringstream oss;
+			oss << trackName.value_or("") << '\0' << releaseName.value_or("") << '\0' << artistName << '\0'
+				<< (recordingMBID ? recordingMBID->getAsString() : "") << '\0'
+				<< (releaseMBID ? releaseMBID->getAsString() : "") << '\0'
+				<< trackNumber.value_or(-1);
+			return oss.str();
+		}
+	};
+
+	struct ParsedListen
+	{
+		std::optional<std::time_t>	listenedAt;
+		ListenMetadata				metadata;
+	};
+
+	// Listen pages can be large: the listens are streamed, only the fields used to match them are kept
+	class GetListensExtractor : public JsonStream::IHandler
+	{
+		public:
+			std::vector<ParsedListen> listens;
+
+		private:
+			bool onStartObject(std::string_view path) override
+			{
+				if (path == "payload.listens")
+				{
+					if (!_inListens)
+						return false;
+
+					listens.emplace_back();
+					return true;
+				}
+
+				return path.empty()
+					|| path == "payload"
+					|| (!listens.empty() && (path == "payload.listens.track_metadata" || path == "payload.listens.track_metadata.additional_info"));
+			}
+
+			bool onStartArray(std::string_view path) override
+			{
+				if (path != "payload.listens")
+					return false;
+
+				_inListens = true;
+				return true;
+			}
+
+			void onEndArray(std::string_view) override
+			{
+				_inListens = false;
+			}
+
+			void onScalar(std::string_view path, JsonStream::ScalarType type, std::string_view value) override
+			{
+				if (listens.empty() || path.substr(0, listensPrefix.size()) != listensPrefix)
+					return;
+
+				path.remove_prefix(listensPrefix.size());
+				ParsedListen& listen {listens.back()};
+
+				if (path == "listened_at" && type == JsonStream::ScalarType::Number)
+					listen.listenedAt = StringUtils::readAs<std::time_t>(value);
+				else if (type == JsonStream::ScalarType::String)
+				{
+					if (path == "track_metadata.track_name")
+						listen.metadata.trackName = value;
+					else if (path == "track_metadata.release_name")
+						listen.metadata.releaseName = value;
+					else if (path == "track_metadata.artist_name")
+						listen.metadata.artistName = value;
+					else if (path == "track_metadata.additional_info.recording_mbid")
+						listen.metadata.recordingMBID = UUID::fromString(value);
+					else if (path == "track_metadata.additional_info.release_mbid")
+						listen.metadata.releaseMBID = UUID::fromString(value);
+					else if (path == "track_metadata.additional_info.tracknumber")
+						listen.metadata.trackNumber = StringUtils::readAs<int>(value);
+				}
+				else if (path == "track_metadata.additional_info.tracknumber" && type == JsonStream::ScalarType::Number)
+					listen.metadata.trackNumber = StringUtils::readAs<int>(value);
+			}
+
+			static constexpr std::string_view listensPrefix {"payload.listens."};
+			bool _inListens {};
+	};
+
 	Database::TrackId
-	tryMatchListen(Database::Session& session, const Wt::Json::Object& metadata)
+	tryMatchListen(Database::Session& session, const ListenMetadata& metadata)
 	{
 		using namespace Database;
 
-		//LOG(DEBUG) << "Trying to match track' " << Wt::Json::serialize(metadata) << "'";
-
 		// first try to get the associated track using MBIDs, and then fallback on names
-		if (metadata.type("additional_info") == Wt::Json::Type::Object)
+		if (metadata.recordingMBID)
 		{
-			const Wt::Json::Object& additionalInfo = metadata.get("additional_info");
-			if (std::optional<UUID> recordingMBID {UUID::fromString(additionalInfo.get("recording_mbid").orIfNull(""))})
-			{
-				const auto tracks {Track::findByRecordingMBID(session, *recordingMBID)};
-				// if duplicated files, do not record it (let the user correct its database)
-				if (tracks.size() == 1)
-					return tracks.front()->getId();
-			}
+			const auto tracks {Track::findByRecordingMBID(session, *metadata.recordingMBID)};
+			// if duplicated files, do not record it (let the user correct its database)
+			if (tracks.size() == 1)
+				return tracks.front()->getId();
 		}
 
 		// these fields are mandatory
-		const std::string trackName {static_cast<std::string>(metadata.get("track_name"))};
-		const std::string releaseName {static_cast<std::string>(metadata.get("release_name"))};
+		if (!metadata.trackName || !metadata.releaseName)
+		{
+			LOG(DEBUG) << "Missing track or release name, cannot match listen";
+			return {};
+		}
 
-		auto tracks {Track::findByNameAndReleaseName(session, trackName, releaseName)};
+		auto tracks {Track::findByNameAndReleaseName(session, *metadata.trackName, *metadata.releaseName)};
 		if (tracks.results.size() > 1)
 		{
 			tracks.results.erase(std::remove_if(std::begin(tracks.results), std::end(tracks.results),
@@ -201,30 +373,23 @@ namespace
 				{
 					const Track::pointer track {Track::find(session, trackId)};
 
-					if (std::string artistName {metadata.get("artist_name").orIfNull("")}; !artistName.empty())
+					if (!metadata.artistName.empty())
 					{
 						const auto& artists {track->getArtists({TrackArtistLinkType::Artist})};
-						if (std::none_of(std::begin(artists), std::end(artists), [&](const Artist::pointer& artist) { return artist->getName() == artistName; }))
+						if (std::none_of(std::begin(artists), std::end(artists), [&](const Artist::pointer& artist) { return artist->getName() == metadata.artistName; }))
 							return true;
 					}
-					if (metadata.type("additional_info") == Wt::Json::Type::Object)
+
+					if (track->getTrackNumber())
 					{
-						const Wt::Json::Object& additionalInfo = metadata.get("additional_info");
-						if (track->getTrackNumber())
-						{
-							int otherTrackNumber {additionalInfo.get("tracknumber").orIfNull(-1)};
-							if (otherTrackNumber > 0 && static_cast<std::size_t>(otherTrackNumber) != *track->getTrackNumber())
-								return true;
-						}
-
-						if (auto releaseMBID {track->getRelease()->getMBID()})
-						{
-							if (std::optional<UUID> otherReleaseMBID {UUID::fromString(additionalInfo.get("release_mbid").orIfNull(""))})
-							{
-								if (otherReleaseMBID->getAsString() != releaseMBID->getAsString())
-									return true;
-							}
-						}
+						if (metadata.trackNumber && *metadata.trackNumber > 0 && static_cast<std::size_t>(*metadata.trackNumber) != *track->getTrackNumber())
+							return true;
+					}
+
+					if (auto releaseMBID {track->getRelease()->getMBID()})
+					{
+						if (metadata.releaseMBID && *metadata.releaseMBID != *releaseMBID)
+							return true;
 					}
 
 					return false;
@@ -240,54 +405,64 @@ namespace
 	struct ParseGetListensResult
 	{
 		Wt::WDateTime oldestEntry;
+		Wt::WDateTime newestEntry;
 		std::size_t listenCount{};
+		bool reachedSyncCursor {}; // got listens that were already synchronized
 		std::vector<Scrobbling::TimedListen> matchedListens;
 	};
 	ParseGetListensResult
-	parseGetListens(Database::Session& session, std::string_view msgBody, Database::UserId userId)
+	parseGetListens(Database::Session& session, std::string_view msgBody, Database::UserId userId, const Wt::WDateTime& syncCursor)
 	{
 		ParseGetListensResult result;
 
-		try
+		GetListensExtractor extractor;
+		if (!JsonStream::parse(msgBody, extractor))
 		{
-			Wt::Json::Object root;
-			Wt::Json::parse(std::string {msgBody}, root);
+			LOG(ERROR) << "Cannot parse 'get-listens' result: malformed JSON";
+			return result;
+		}
 
-			const Wt::Json::Object& payload = root.get("payload");
-			const Wt::Json::Array& listens = payload.get("listens");
+		LOG(DEBUG) << "Got " << extractor.listens.size() << " listens";
 
-			LOG(DEBUG) << "Got " << listens.size() << " listens";
+		if (extractor.listens.empty())
+			return result;
 
-			if (listens.empty())
-				return result;
+		auto transaction {session.createSharedTransaction()};
 
-			auto transaction {session.createSharedTransaction()};
+		// the same tracks are often listened several times
+		std::unordered_map<std::string, Database::TrackId> matchedTracks;
 
-			for (const Wt::Json::Value& value : listens)
+		for (const ParsedListen& listen : extractor.listens)
+		{
+			const Wt::WDateTime listenedAt {listen.listenedAt ? Wt::WDateTime::fromTime_t(*listen.listenedAt) : Wt::WDateTime {}};
+			if (!listenedAt.isValid())
 			{
-				const Wt::Json::Object& listen = value;
-				const Wt::WDateTime listenedAt {Wt::WDateTime::fromTime_t(static_cast<int>(listen.get("listened_at")))};
-				const Wt::Json::Object& metadata = listen.get("track_metadata");
+				LOG(ERROR) << "bad listened_at field!";
+				continue;
+			}
 
-				if (!listenedAt.isValid())
-				{
-					LOG(ERROR) << "bad listened_at field!";
-					continue;
-				}
+			result.listenCount++;
+			if (!result.oldestEntry.isValid())
+				result.oldestEntry = listenedAt;
+			else if (listenedAt < result.oldestEntry)
+				result.oldestEntry = listenedAt;
 
-				result.listenCount++;
-				if (!result.oldestEntry.isValid())
-					result.oldestEntry = listenedAt;
-				else if (listenedAt < result.oldestEntry)
-					result.oldestEntry = listenedAt;
+			if (!result.newestEntry.isValid() || listenedAt > result.newestEntry)
+				result.newestEntry = listenedAt;
 
-				if (Database::TrackId trackId {tryMatchListen(session, metadata)}; trackId.isValid())
-					result.matchedListens.emplace_back(Scrobbling::TimedListen {{userId, trackId}, listenedAt});
+			if (syncCursor.isValid() && listenedAt <= syncCursor)
+			{
+				result.reachedSyncCursor = true;
+				continue;
 			}
-		}
-		catch (const Wt::WException& error)
-		{
-			LOG(ERROR) << "Cannot parse 'get-listens' result: " << error.what();
+
+			const std::string metadataKey {listen.metadata.computeKey()};
+			auto itMatchedTrack {matchedTracks.find(metadataKey)};
+			if (itMatchedTrack == std::cend(matchedTracks))
+				itMatchedTrack = matchedTracks.emplace(metadataKey, tryMatchListen(session, listen.metadata)).first;
+
+			if (const Database::TrackId trackId {itMatchedTrack->second}; trackId.isValid())
+				result.matchedListens.emplace_back(Scrobbling::TimedListen {{userId, trackId}, listenedAt});
 		}
 
 		return result;
@@ -302,6 +477,8 @@ namespace Scrobbling::ListenBrainz
 		, _client {client}
 		, _maxSyncListenCount {Service<IConfig>::get()->getULong("listenbrainz-max-sync-listen-count", 1000)}
 		, _syncListensPeriod {Service<IConfig>::get()->getULong("listenbrainz-sync-listens-period-hours", 1)}
+		, _maxBatchListenCount {std::max<std::size_t>(1, Service<IConfig>::get()->getULong("listenbrainz-max-batch-listen-count", 100))}
+		, _maxBatchDelay {Service<IConfig>::get()->getULong("listenbrainz-max-batch-delay-seconds", 5)}
 	{
 		LOG(INFO) << "Starting Listens synchronizer, maxSyncListenCount = " << _maxSyncListenCount << ", _syncListensPeriod = " << _syncListensPeriod.count() << " hours";
 
@@ -312,62 +489,134 @@ namespace Scrobbling::ListenBrainz
 	ListensSynchronizer::enqueListen(const TimedListen& listen)
 	{
 		assert(listen.listenedAt.isValid());
-		enqueListen(listen, listen.listenedAt);
+
+		// We want the listen to be sent again later in case of failure, so we just save it as pending send
+		saveListen(listen, Database::ScrobblingState::PendingAdd);
+
+		_strand.dispatch([=]
+		{
+			addPendingListen(listen);
+		});
 	}
 
 	void
 	ListensSynchronizer::enqueListenNow(const Listen& listen)
 	{
-		enqueListen(listen, {});
+		Http::ClientPOSTRequestParameters request;
+		request.relativeUrl = "/1/submit-listens";
+		// We want "listen now" to appear as soon as possible
+		request.priority = Http::ClientRequestParameters::Priority::High;
+		// don't retry on failure
+
+		std::string bodyText {listenToJsonString(_db.getTLSSession(), listen, {}, "playing_now")};
+		if (bodyText.empty())
+		{
+			LOG(DEBUG) << "Cannot convert listen to json: skipping";
+			return;
+		}
+
+		const std::optional<UUID> listenBrainzToken {Utils::getListenBrainzToken(_db.getTLSSession(), listen.userId)};
+		if (!listenBrainzToken)
+		{
+			LOG(DEBUG) << "No listenbrainz token found: skipping";
+			return;
+		}
+
+		request.message.addBodyText(bodyText);
+		request.message.addHeader("Authorization", "Token " + std::string {listenBrainzToken->getAsString()});
+		request.message.addHeader("Content-Type", "application/json");
+		_client.sendPOSTRequest(std::move(request));
+	}
+
+	void
+	ListensSynchronizer::addPendingListen(const TimedListen& listen)
+	{
+		assert(_strand.running_in_this_thread());
+
+		UserContext& context {getUserContext(listen.userId)};
+
+		// may already be queued if pending listens are enqued again during a sync
+		if (std::any_of(std::cbegin(context.pendingListens), std::cend(context.pendingListens),
+				[&](const TimedListen& pendingListen) { return pendingListen.trackId == listen.trackId && pendingListen.listenedAt == listen.listenedAt; }))
+		{
+			return;
+		}
+
+		context.pendingListens.push_back(listen);
+		if (context.pendingListens.size() >= _maxBatchListenCount)
+			sendPendingListens(context);
+		else
+			scheduleSendPendingListens();
 	}
 
 	void
-	ListensSynchronizer::enqueListen(const Listen& listen, const Wt::WDateTime& timePoint)
+	ListensSynchronizer::scheduleSendPendingListens()
 	{
-		Http::ClientPOSTRequestParameters request;
-		request.relativeUrl = "/1/submit-listens";
+		if (_sendPendingListensScheduled)
+			return;
 
-		if (timePoint.isValid())
+		_sendPendingListensScheduled = true;
+		_sendPendingListensTimer.expires_after(_maxBatchDelay);
+		_sendPendingListensTimer.async_wait(boost::asio::bind_executor(_strand, [this] (const boost::system::error_code& ec)
 		{
-			const TimedListen timedListen {listen, timePoint};
-			// We want the listen to be sent again later in case of failure, so we just save it as pending send
-			saveListen(timedListen, Database::ScrobblingState::PendingAdd);
+			if (ec == boost::asio::error::operation_aborted)
+				return;
+			else if (ec)
+				throw Exception {"Send listens timer failure: " + std::string {ec.message()} };
 
-			request.priority = Http::ClientRequestParameters::Priority::Normal;
-			request.onSuccessFunc = [=](std::string_view)
+			_sendPendingListensScheduled = false;
+			for (auto& [userId, context] : _userContexts)
 			{
-				_strand.dispatch([=]
-				{
-					if (saveListen(timedListen, Database::ScrobblingState::Synchronized))
-					{
-						UserContext& context {getUserContext(listen.userId)};
-						if (context.listenCount)
-							(*context.listenCount)++;
-					}
-				});
-			};
-			// on failure, this listen will be sent during the next sync
-		}
-		else
+				if (!context.pendingListens.empty())
+					sendPendingListens(context);
+			}
+		}));
+	}
+
+	void
+	ListensSynchronizer::sendPendingListens(UserContext& context)
+	{
+		assert(_strand.running_in_this_thread());
+
+		std::vector<TimedListen> listens;
+		listens.swap(context.pendingListens);
+
+		const std::optional<UUID> listenBrainzToken {Utils::getListenBrainzToken(_db.getTLSSession(), context.userId)};
+		if (!listenBrainzToken)
 		{
-			// We want "listen now" to appear as soon as possible
-			request.priority = Http::ClientRequestParameters::Priority::High;
-			// don't retry on failure
+			LOG(DEBUG) << "No listenbrainz token found: skipping " << listens.size() << " listens";
+			return;
 		}
 
-		std::string bodyText {listenToJsonString(_db.getTLSSession(), listen, timePoint, timePoint.isValid() ? "single" : "playing_now")};
+		std::vector<TimedListen> sentListens;
+		std::string bodyText {listensToJsonString(_db.getTLSSession(), listens, sentListens)};
 		if (bodyText.empty())
 		{
-			LOG(DEBUG) << "Cannot convert listen to json: skipping";
+			LOG(DEBUG) << "Cannot convert listens to json: skipping";
 			return;
 		}
 
-		const std::optional<UUID> listenBrainzToken {Utils::getListenBrainzToken(_db.getTLSSession(), listen.userId)};
-		if (!listenBrainzToken)
+		LOG(DEBUG) << "Sending " << sentListens.size() << " listens";
+
+		Http::ClientPOSTRequestParameters request;
+		request.relativeUrl = "/1/submit-listens";
+		request.priority = Http::ClientRequestParameters::Priority::Normal;
+		request.onSuccessFunc = [this, sentListens = std::move(sentListens)](std::string_view)
 		{
-			LOG(DEBUG) << "No listenbrainz token found: skipping";
-			return;
-		}
+			_strand.dispatch([this, sentListens]
+			{
+				for (const TimedListen& listen : sentListens)
+				{
+					if (saveListen(listen, Database::ScrobblingState::Synchronized))
+					{
+						UserContext& context {getUserContext(listen.userId)};
+						if (context.listenCount)
+							(*context.listenCount)++;
+					}
+				}
+			});
+		};
+		// on failure, these listens stay pending and will be sent during the next sync
 
 		request.message.addBodyText(bodyText);
 		request.message.addHeader("Authorization", "Token " + std::string {listenBrainzToken->getAsString()});
@@ -377,15 +626,27 @@ namespace Scrobbling::ListenBrainz
 
 	bool
 	ListensSynchronizer::saveListen(const TimedListen& listen, Database::ScrobblingState scrobblingState)
+	{
+		Database::Session& session {_db.getTLSSession()};
+		auto transaction {session.createUniqueTransaction()};
+
+		return saveListen(session, listen, scrobblingState);
+	}
+
+	bool
+	ListensSynchronizer::saveListen(Database::Session& session, const TimedListen& listen, Database::ScrobblingState scrobblingState)
 	{
 		using namespace Database;
 
-		Session& session {_db.getTLSSession()};
-		auto transaction {session.createUniqueTransaction()};
+		session.checkUniqueLocked();
 
 		Database::Listen::pointer dbListen {Database::Listen::find(session, listen.userId, listen.trackId, Database::Scrobbler::ListenBrainz, listen.listenedAt)};
 		if (!dbListen)
 		{
+			// Compacted listens cannot be found anymore, do not import them again
+			if (Database::Listen::isCompacted(session, listen.userId, Database::Scrobbler::ListenBrainz, listen.listenedAt))
+				return false;
+
 			const User::pointer user {User::find(session, listen.userId)};
 			if (!user)
 				return false;
@@ -442,8 +703,9 @@ namespace Scrobbling::ListenBrainz
 
 		LOG(DEBUG) << "Queing " << pendingListens.size() << " pending listen";
 
+		// already saved as pending
 		for (const TimedListen& pendingListen : pendingListens)
-			enqueListen(pendingListen);
+			addPendingListen(pendingListen);
 	}
 
 	ListensSynchronizer::UserContext&
@@ -524,13 +786,38 @@ namespace Scrobbling::ListenBrainz
 		context.syncing = true;
 		context.listenBrainzUserName = "";
 		context.maxDateTime = {};
+		context.newestListenDateTime = {};
 		context.fetchedListenCount = 0;
 		context.matchedListenCount = 0;
 		context.importedListenCount = 0;
 
+		{
+			Database::Session& session {_db.getTLSSession()};
+			auto transaction {session.createSharedTransaction()};
+
+			const Database::User::pointer user {Database::User::find(session, context.userId)};
+			context.syncCursor = user ? user->getListenBrainzSyncCursor() : Wt::WDateTime {};
+		}
+
 		enqueValidateToken(context);
 	}
 
+	void
+	ListensSynchronizer::onSyncCompleted(UserContext& context)
+	{
+		// next syncs only need to fetch the listens that are more recent
+		if (context.newestListenDateTime.isValid() && (!context.syncCursor.isValid() || context.newestListenDateTime > context.syncCursor))
+		{
+			Database::Session& session {_db.getTLSSession()};
+			auto transaction {session.createUniqueTransaction()};
+
+			if (const Database::User::pointer user {Database::User::find(session, context.userId)})
+				user.modify()->setListenBrainzSyncCursor(context.newestListenDateTime);
+		}
+
+		onSyncEnded(context);
+	}
+
 	void
 	ListensSynchronizer::onSyncEnded(UserContext& context)
 	{
@@ -618,14 +905,14 @@ namespace Scrobbling::ListenBrainz
 		assert(!context.listenBrainzUserName.empty());
 
 		Http::ClientGETRequestParameters request;
-		request.relativeUrl = "/1/user/" + context.listenBrainzUserName + "/listens?max_ts=" + std::to_string(context.maxDateTime.toTime_t());
+		request.relativeUrl = "/1/user/" + context.listenBrainzUserName + "/listens?max_ts=" + std::to_string(context.maxDateTime.toTime_t()) + "&count=" + std::to_string(_getListensPageSize);
 		request.priority = Http::ClientRequestParameters::Priority::Low;
 		request.onSuccessFunc = [=, &context] (std::string_view msgBody)
 			{
-				processGetListensResponse(msgBody, context);
-				if (context.fetchedListenCount >= _maxSyncListenCount || !context.maxDateTime.isValid())
+				const bool reachedSyncCursor {processGetListensResponse(msgBody, context)};
+				if (reachedSyncCursor || context.fetchedListenCount >= _maxSyncListenCount || !context.maxDateTime.isValid())
 				{
-					onSyncEnded(context);
+					onSyncCompleted(context);
 					return;
 				}
 
@@ -639,21 +926,30 @@ namespace Scrobbling::ListenBrainz
 		_client.sendGETRequest(std::move(request));
 	}
 
-	void
+	bool
 	ListensSynchronizer::processGetListensResponse(std::string_view msgBody, UserContext& context)
 	{
 		Database::Session& session {_db.getTLSSession()};
 
-		const ParseGetListensResult parseResult {parseGetListens(session, msgBody, context.userId)};
+		const ParseGetListensResult parseResult {parseGetListens(session, msgBody, context.userId, context.syncCursor)};
 
 		context.fetchedListenCount += parseResult.listenCount;
 		context.matchedListenCount += parseResult.matchedListens.size();
 		context.maxDateTime = parseResult.oldestEntry;
+		if (parseResult.newestEntry.isValid() && (!context.newestListenDateTime.isValid() || parseResult.newestEntry > context.newestListenDateTime))
+			context.newestListenDateTime = parseResult.newestEntry;
 
-		for (const TimedListen& listen : parseResult.matchedListens)
+		if (!parseResult.matchedListens.empty())
 		{
-			if (saveListen(listen, Database::ScrobblingState::Synchronized))
-				context.importedListenCount++;
+			auto transaction {session.createUniqueTransaction()};
+
+			for (const TimedListen& listen : parseResult.matchedListens)
+			{
+				if (saveListen(session, listen, Database::ScrobblingState::Synchronized))
+					context.importedListenCount++;
+			}
 		}
+
+		return parseResult.reachedSyncCursor;
 	}
 } // namespace Scrobbling::ListenBrainz
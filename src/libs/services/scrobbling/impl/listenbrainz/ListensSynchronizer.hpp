@@ -21,6 +21,7 @@
 
 #include <optional>
 #include <unordered_map>
+#include <vector>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/io_context_strand.hpp>
 #include <boost/asio/steady_timer.hpp>
@@ -54,8 +55,8 @@ namespace Scrobbling::ListenBrainz
 			void enqueListenNow(const Listen& listen);
 
 		private:
-			void enqueListen(const Listen& listen, const Wt::WDateTime& timePoint);
 			bool saveListen(const TimedListen& listen, Database::ScrobblingState scrobblinState);
+			bool saveListen(Database::Session& session, const TimedListen& listen, Database::ScrobblingState scrobblinState);
 
 			void enquePendingListens();
 
@@ -71,36 +72,51 @@ namespace Scrobbling::ListenBrainz
 				const Database::UserId	userId;
 				bool					syncing {};
 				std::optional<std::size_t> listenCount {};
+				std::vector<TimedListen> pendingListens; // to be sent in the next batch, in listen order
 
 				// resetted at each sync
 				std::string		listenBrainzUserName; // need to be resolved first
+				Wt::WDateTime	syncCursor; // persisted, listens up to this date are already synchronized
 				Wt::WDateTime	maxDateTime;
+				Wt::WDateTime	newestListenDateTime;
 				std::size_t		fetchedListenCount{};
 				std::size_t		matchedListenCount{};
 				std::size_t		importedListenCount{};
 			};
 
+			// Listens are coalesced per user and sent in batches
+			void addPendingListen(const TimedListen& listen);
+			void scheduleSendPendingListens();
+			void sendPendingListens(UserContext& context);
+
 			UserContext& getUserContext(Database::UserId userId);
 			bool isSyncing() const;
 			void scheduleSync(std::chrono::seconds fromNow);
 			void startSync();
 			void startSync(UserContext& context);
+			void onSyncCompleted(UserContext& context);
 			void onSyncEnded(UserContext& context);
 			void enqueValidateToken(UserContext& context);
 			void enqueGetListenCount(UserContext& context);
 			void enqueGetListens(UserContext& context);
-			void processGetListensResponse(std::string_view body, UserContext& context);
+			// returns true if the sync cursor has been reached
+			bool processGetListensResponse(std::string_view body, UserContext& context);
 
 			boost::asio::io_context&		_ioContext;
 			boost::asio::io_context::strand	_strand {_ioContext};
 			Database::Db&					_db;
 			boost::asio::steady_timer		_syncTimer {_ioContext};
+			boost::asio::steady_timer		_sendPendingListensTimer {_ioContext};
+			bool							_sendPendingListensScheduled {};
 			Http::IClient&					_client;
 
 			std::unordered_map<Database::UserId, UserContext> _userContexts;
 
 			const std::size_t			_maxSyncListenCount;
 			const std::chrono::hours	_syncListensPeriod;
+			static constexpr std::size_t	_getListensPageSize {100};
+			const std::size_t			_maxBatchListenCount;
+			const std::chrono::seconds	_maxBatchDelay;
 	};
 } // Scrobbling::ListenBrainz
 
@@ -24,6 +24,7 @@
 #include <chrono>
 #include <memory>
 #include <optional>
+#include <vector>
 
 #include "services/scrobbling/Listen.hpp"
 #include "services/database/ArtistId.hpp"
@@ -102,6 +103,17 @@ namespace Scrobbling
 			virtual void 				unstar(Database::UserId userId, Database::TrackId trackId) = 0;
 			virtual bool 				isStarred(Database::UserId userId, Database::TrackId artistId) = 0;
 			virtual TrackContainer		getStarredTracks(Database::UserId userId, const std::vector<Database::ClusterId>& clusterIds, Database::Range range) = 0;
+
+			// Batch variants, applied together
+			virtual void				star(Database::UserId userId, const std::vector<Database::ArtistId>& artistIds) = 0;
+			virtual void				unstar(Database::UserId userId, const std::vector<Database::ArtistId>& artistIds) = 0;
+			virtual void				star(Database::UserId userId, const std::vector<Database::ReleaseId>& releaseIds) = 0;
+			virtual void				unstar(Database::UserId userId, const std::vector<Database::ReleaseId>& releaseIds) = 0;
+			virtual void				star(Database::UserId userId, const std::vector<Database::TrackId>& trackIds) = 0;
+			virtual void				unstar(Database::UserId userId, const std::vector<Database::TrackId>& trackIds) = 0;
+
+			// Changes each time something is starred or unstarred, whatever the user (not persisted)
+			virtual std::size_t			getStarGeneration() const = 0;
 	};
 
 	std::unique_ptr<IScrobblingService> createScrobblingService(boost::asio::io_service& ioService, Database::Db& db);
@@ -23,6 +23,8 @@
 #include <numeric>
 #include <sstream>
 
+#include "utils/ParallelForPool.hpp"
+
 namespace SOM
 {
 
@@ -46,7 +48,8 @@ variance(const std::vector<T>& vec)
 }
 
 DataNormalizer::DataNormalizer(std::size_t inputDimCount)
-: _inputDimCount{inputDimCount}
+: _inputDimCount {inputDimCount}
+, _minmax(inputDimCount)
 {
 }
 
@@ -68,23 +71,29 @@ DataNormalizer::computeNormalizationFactors(const std::vector<InputVector>& inpu
 	if (inputVectors.empty())
 		throw Exception("Empty input vectors");
 
-	// For each dimension of the input, compute the min/max
-	_minmax.clear();
-	_minmax.resize(_inputDimCount);
+	for (const InputVector& inputVector : inputVectors)
+		checkSameDimensions(inputVector, _inputDimCount);
 
-	for (std::size_t dimId {}; dimId < _inputDimCount; ++dimId)
-	{
-		std::vector<InputVector::value_type> values;
+	// Single pass over the vectors, the min/max of all the dimensions are updated at once
+	std::vector<InputVector::value_type> mins(inputVectors.front().data(), inputVectors.front().data() + _inputDimCount);
+	std::vector<InputVector::value_type> maxs {mins};
 
-		for (const auto& inputVector: inputVectors)
+	InputVector::value_type* __restrict min {mins.data()};
+	InputVector::value_type* __restrict max {maxs.data()};
+	for (const InputVector& inputVector : inputVectors)
+	{
+		const InputVector::value_type* __restrict values {inputVector.data()};
+		for (std::size_t dimId {}; dimId < _inputDimCount; ++dimId)
 		{
-			checkSameDimensions(inputVector, _inputDimCount);
-			values.push_back(inputVector[dimId]);
+			min[dimId] = std::min(min[dimId], values[dimId]);
+			max[dimId] = std::max(max[dimId], values[dimId]);
 		}
-
-		auto result {std::minmax_element(values.begin(), values.end())};
-		_minmax[dimId] = {*result.first, *result.second};
 	}
+
+	_minmax.clear();
+	_minmax.resize(_inputDimCount);
+	for (std::size_t dimId {}; dimId < _inputDimCount; ++dimId)
+		_minmax[dimId] = {mins[dimId], maxs[dimId]};
 }
 
 InputVector::value_type
@@ -104,10 +113,50 @@ DataNormalizer::normalizeData(InputVector& a) const
 {
 	checkSameDimensions(a, _inputDimCount);
 
+	InputVector::value_type* values {a.data()};
+	for (std::size_t dimId {}; dimId < _inputDimCount; ++dimId)
+		values[dimId] = normalizeValue(values[dimId], dimId);
+}
+
+void
+DataNormalizer::normalizeData(std::vector<InputVector>& inputVectors, std::size_t threadCount) const
+{
+	for (const InputVector& inputVector : inputVectors)
+		checkSameDimensions(inputVector, _inputDimCount);
+
+	// Flat copies of the factors, so that the inner loop can be vectorized
+	std::vector<InputVector::value_type> mins(_inputDimCount);
+	std::vector<InputVector::value_type> maxs(_inputDimCount);
+	std::vector<InputVector::value_type> ranges(_inputDimCount);
 	for (std::size_t dimId {}; dimId < _inputDimCount; ++dimId)
 	{
-		a[dimId] = normalizeValue(a[dimId], dimId);
+		mins[dimId] = _minmax[dimId].min;
+		maxs[dimId] = _minmax[dimId].max;
+		ranges[dimId] = _minmax[dimId].max - _minmax[dimId].min;
 	}
+
+	auto normalizeRange {[&](std::size_t first, std::size_t last)
+	{
+		const InputVector::value_type* __restrict min {mins.data()};
+		const InputVector::value_type* __restrict max {maxs.data()};
+		const InputVector::value_type* __restrict range {ranges.data()};
+
+		for (std::size_t i {first}; i < last; ++i)
+		{
+			InputVector::value_type* __restrict values {inputVectors[i].data()};
+			for (std::size_t dimId {}; dimId < _inputDimCount; ++dimId)
+				values[dimId] = (std::clamp(values[dimId], min[dimId], max[dimId]) - min[dimId]) / range[dimId];
+		}
+	}};
+
+	if (threadCount <= 1)
+	{
+		normalizeRange(0, inputVectors.size());
+		return;
+	}
+
+	Utils::ParallelForPool pool {threadCount};
+	pool.parallelFor(inputVectors.size(), normalizeRange);
 }
 
 void
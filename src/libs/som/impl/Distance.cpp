@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2018 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Distance.hpp"
+
+#include <array>
+#include <cmath>
+
+#include "utils/TargetClones.hpp"
+
+// The kernels are written so that the compiler vectorizes them
+// On x86-64 (glibc), several versions are built and picked at load time depending on the CPU
+#define LMS_SOM_KERNEL LMS_TARGET_CLONES("avx2", "default")
+
+namespace SOM::Distance
+{
+	namespace
+	{
+		// independent accumulators, so that the reductions can be vectorized without reordering float operations
+		constexpr std::size_t laneCount {4};
+		using Lanes = std::array<value_type, laneCount>;
+
+		value_type
+		sumLanes(const Lanes& lanes)
+		{
+			return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+		}
+
+		InputVector::Distance
+		weightedEuclidianSquare(const value_type* __restrict a, const value_type* __restrict b, const value_type* __restrict weights, std::size_t dimCount)
+		{
+			Lanes lanes{};
+			std::size_t i {};
+			for (; i + laneCount <= dimCount; i += laneCount)
+			{
+				for (std::size_t lane {}; lane < laneCount; ++lane)
+				{
+					const value_type diff {a[i + lane] - b[i + lane]};
+					lanes[lane] += diff * diff * weights[i + lane];
+				}
+			}
+
+			value_type res {sumLanes(lanes)};
+			for (; i < dimCount; ++i)
+			{
+				const value_type diff {a[i] - b[i]};
+				res += diff * diff * weights[i];
+			}
+
+			return res;
+		}
+
+		struct CosineTerms
+		{
+			value_type dotProduct;
+			value_type squareNorm;
+		};
+
+		CosineTerms
+		computeCosineTerms(const value_type* __restrict a, const value_type* __restrict b, const value_type* __restrict weights, std::size_t dimCount)
+		{
+			Lanes dotProductLanes{};
+			Lanes squareNormLanes{};
+			std::size_t i {};
+			for (; i + laneCount <= dimCount; i += laneCount)
+			{
+				for (std::size_t lane {}; lane < laneCount; ++lane)
+				{
+					const value_type weightedA {a[i + lane] * weights[i + lane]};
+					dotProductLanes[lane] += weightedA * b[i + lane];
+					squareNormLanes[lane] += weightedA * a[i + lane];
+				}
+			}
+
+			CosineTerms res {sumLanes(dotProductLanes), sumLanes(squareNormLanes)};
+			for (; i < dimCount; ++i)
+			{
+				const value_type weightedA {a[i] * weights[i]};
+				res.dotProduct += weightedA * b[i];
+				res.squareNorm += weightedA * a[i];
+			}
+
+			return res;
+		}
+
+		InputVector::Distance
+		cosineDistance(value_type dotProduct, value_type squareNormA, value_type squareNormB)
+		{
+			const value_type normProduct {std::sqrt(squareNormA * squareNormB)};
+			if (normProduct == 0)
+				return 1;
+
+			return 1 - dotProduct / normProduct;
+		}
+
+		InputVector::Distance
+		quantizedWeightedEuclidianSquare(const quantized_type* __restrict a, const quantized_type* __restrict b, const value_type* __restrict factors, std::size_t dimCount)
+		{
+			Lanes lanes{};
+			std::size_t i {};
+			for (; i + laneCount <= dimCount; i += laneCount)
+			{
+				for (std::size_t lane {}; lane < laneCount; ++lane)
+				{
+					const int diff {a[i + lane] - b[i + lane]};
+					lanes[lane] += static_cast<value_type>(diff * diff) * factors[i + lane];
+				}
+			}
+
+			value_type res {sumLanes(lanes)};
+			for (; i < dimCount; ++i)
+			{
+				const int diff {a[i] - b[i]};
+				res += static_cast<value_type>(diff * diff) * factors[i];
+			}
+
+			return res;
+		}
+
+		value_type
+		computeWeightedSquareNorm(const value_type* a, const value_type* weights, std::size_t dimCount)
+		{
+			return computeCosineTerms(a, a, weights, dimCount).squareNorm;
+		}
+	}
+
+	InputVector::Distance
+	computeWeightedEuclidianSquare(const value_type* a, const value_type* b, const value_type* weights, std::size_t dimCount)
+	{
+		return weightedEuclidianSquare(a, b, weights, dimCount);
+	}
+
+	InputVector::Distance
+	computeWeightedCosine(const value_type* a, const value_type* b, const value_type* weights, std::size_t dimCount)
+	{
+		const CosineTerms terms {computeCosineTerms(a, b, weights, dimCount)};
+		return cosineDistance(terms.dotProduct, terms.squareNorm, computeWeightedSquareNorm(b, weights, dimCount));
+	}
+
+	LMS_SOM_KERNEL
+	std::size_t
+	findClosestWeightedEuclidianSquare(const value_type* vectors, std::size_t vectorCount, const value_type* data, const value_type* weights, std::size_t dimCount)
+	{
+		std::size_t closestIndex {};
+		InputVector::Distance closestDistance {weightedEuclidianSquare(vectors, data, weights, dimCount)};
+		for (std::size_t index {1}; index < vectorCount; ++index)
+		{
+			const InputVector::Distance distance {weightedEuclidianSquare(vectors + index * dimCount, data, weights, dimCount)};
+			if (distance < closestDistance)
+			{
+				closestDistance = distance;
+				closestIndex = index;
+			}
+		}
+
+		return closestIndex;
+	}
+
+	LMS_SOM_KERNEL
+	std::size_t
+	findClosestWeightedCosine(const value_type* vectors, std::size_t vectorCount, const value_type* data, const value_type* weights, std::size_t dimCount)
+	{
+		const value_type dataSquareNorm {computeWeightedSquareNorm(data, weights, dimCount)};
+
+		std::size_t closestIndex {};
+		InputVector::Distance closestDistance {};
+		for (std::size_t index {}; index < vectorCount; ++index)
+		{
+			const CosineTerms terms {computeCosineTerms(vectors + index * dimCount, data, weights, dimCount)};
+			const InputVector::Distance distance {cosineDistance(terms.dotProduct, terms.squareNorm, dataSquareNorm)};
+			if (index == 0 || distance < closestDistance)
+			{
+				closestDistance = distance;
+				closestIndex = index;
+			}
+		}
+
+		return closestIndex;
+	}
+
+	InputVector::Distance
+	computeQuantizedWeightedEuclidianSquare(const quantized_type* a, const quantized_type* b, const value_type* factors, std::size_t dimCount)
+	{
+		return quantizedWeightedEuclidianSquare(a, b, factors, dimCount);
+	}
+
+	LMS_SOM_KERNEL
+	std::size_t
+	findClosestQuantizedWeightedEuclidianSquare(const quantized_type* vectors, std::size_t vectorCount, const quantized_type* data, const value_type* factors, std::size_t dimCount)
+	{
+		std::size_t closestIndex {};
+		InputVector::Distance closestDistance {quantizedWeightedEuclidianSquare(vectors, data, factors, dimCount)};
+		for (std::size_t index {1}; index < vectorCount; ++index)
+		{
+			const InputVector::Distance distance {quantizedWeightedEuclidianSquare(vectors + index * dimCount, data, factors, dimCount)};
+			if (distance < closestDistance)
+			{
+				closestDistance = distance;
+				closestIndex = index;
+			}
+		}
+
+		return closestIndex;
+	}
+}
+
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2018 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "som/InputVector.hpp"
+
+namespace SOM::Distance
+{
+	using value_type = InputVector::value_type;
+
+	// Built-in kernels, no dimension check
+	InputVector::Distance computeWeightedEuclidianSquare(const value_type* a, const value_type* b, const value_type* weights, std::size_t dimCount);
+	InputVector::Distance computeWeightedCosine(const value_type* a, const value_type* b, const value_type* weights, std::size_t dimCount);
+
+	// Index of the closest vector among vectorCount contiguous vectors (vectorCount must not be 0)
+	std::size_t findClosestWeightedEuclidianSquare(const value_type* vectors, std::size_t vectorCount, const value_type* data, const value_type* weights, std::size_t dimCount);
+	std::size_t findClosestWeightedCosine(const value_type* vectors, std::size_t vectorCount, const value_type* data, const value_type* weights, std::size_t dimCount);
+
+	// Same on quantized vectors, factors are weight * scale² for each dimension
+	using quantized_type = std::int8_t;
+	InputVector::Distance computeQuantizedWeightedEuclidianSquare(const quantized_type* a, const quantized_type* b, const value_type* factors, std::size_t dimCount);
+	std::size_t findClosestQuantizedWeightedEuclidianSquare(const quantized_type* vectors, std::size_t vectorCount, const quantized_type* data, const value_type* factors, std::size_t dimCount);
+}
+
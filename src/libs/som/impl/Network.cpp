@@ -20,6 +20,7 @@
 #include "som/Network.hpp"
 
 #include <algorithm>
+#include <cassert>
 #include <chrono>
 #include <cmath>
 #include <random>
@@ -27,7 +28,11 @@
 #include <unordered_set>
 
 #include "utils/Logger.hpp"
+#include "utils/ParallelForPool.hpp"
+#include "utils/Profiling.hpp"
 #include "utils/Random.hpp"
+#include "utils/WorkBudget.hpp"
+#include "Distance.hpp"
 
 namespace SOM
 {
@@ -54,11 +59,6 @@ defaultLearningFactor(Network::CurrentIteration iteration)
 	return initialValue * exp(-((iteration.idIteration + 1) / static_cast<LearningFactor>(iteration.iterationCount)));
 }
 
-static InputVector::Distance
-euclidianSquareDistance(const InputVector& a, const InputVector& b, const InputVector& weights)
-{
-	return a.computeEuclidianSquareDistance(b, weights);
-}
 
 static
 InputVector::value_type
@@ -78,24 +78,66 @@ defaultNeighbourhoodFunc(Norm norm, const Network::CurrentIteration& iteration)
 	return exp(-norm / (2 * sigma * sigma));
 }
 
-Network::Network(Coordinate width, Coordinate height, std::size_t inputDimCount)
+Network::Network(Coordinate width, Coordinate height, std::size_t inputDimCount, std::optional<std::uint_fast32_t> seed)
 :
+_width {width},
+_height {height},
 _inputDimCount {inputDimCount},
 _weights {inputDimCount, static_cast<InputVector::value_type>(1)},
-_refVectors {width, height, _inputDimCount},
-_distanceFunc {euclidianSquareDistance},
+_refVectors(static_cast<std::size_t>(width) * height * inputDimCount),
 _learningFactorFunc {defaultLearningFactor},
 _neighbourhoodFunc {defaultNeighbourhoodFunc}
+{
+	if (seed)
+	{
+		Random::RandGenerator randGenerator {Random::createSeededGenerator(*seed)};
+		initRefVectors(randGenerator);
+	}
+	else
+		initRefVectors(Random::getRandGenerator());
+}
+
+void
+Network::initRefVectors(Random::RandGenerator& randGenerator)
 {
 	// init each vector with a random normalized value
-	for (Coordinate y {}; y < _refVectors.getHeight(); ++y)
+	std::uniform_real_distribution<InputVector::value_type> dist {0, 1};
+	for (InputVector::value_type& val : _refVectors)
+		val = dist(randGenerator);
+}
+
+void
+Network::setDistanceType(DistanceType distanceType)
+{
+	_distanceType = distanceType;
+	_distanceFunc = {};
+}
+
+void
+Network::setDistanceFunc(DistanceFunc distanceFunc)
+{
+	_distanceFunc = std::move(distanceFunc);
+}
+
+Network::DistanceFunc
+Network::getDistanceFunc() const
+{
+	if (_distanceFunc)
+		return _distanceFunc;
+
+	return [distanceType = _distanceType](const InputVector& a, const InputVector& b, const InputVector& weights)
 	{
-		for (Coordinate x {}; x < _refVectors.getWidth(); ++x)
+		checkSameDimensions(a, b);
+		checkSameDimensions(a, weights);
+
+		switch (distanceType)
 		{
-			for (InputVector::value_type& val : _refVectors.get({x,y}))
-				val = Random::getRealRandom<InputVector::value_type>(0, 1);
+			case DistanceType::WeightedEuclidianSquare:	return Distance::computeWeightedEuclidianSquare(a.data(), b.data(), weights.data(), a.getNbDimensions());
+			case DistanceType::WeightedCosine:			return Distance::computeWeightedCosine(a.data(), b.data(), weights.data(), a.getNbDimensions());
 		}
-	}
+
+		throw Exception {"Unhandled distance type"};
+	};
 }
 
 void
@@ -111,27 +153,65 @@ Network::setRefVector(const Position& position, const InputVector& data)
 {
 	checkSameDimensions(data, _inputDimCount);
 
-	_refVectors[position] = data;
+	std::copy(std::cbegin(data), std::cend(data), getRefVectorData(position));
+}
+
+InputVector::value_type*
+Network::getRefVectorData(const Position& position)
+{
+	assert(position.x < _width);
+	assert(position.y < _height);
+	return &_refVectors[(position.x + static_cast<std::size_t>(_width) * position.y) * _inputDimCount];
+}
+
+const InputVector::value_type*
+Network::getRefVectorData(const Position& position) const
+{
+	assert(position.x < _width);
+	assert(position.y < _height);
+	return &_refVectors[(position.x + static_cast<std::size_t>(_width) * position.y) * _inputDimCount];
+}
+
+InputVector::Distance
+Network::computeDistance(const InputVector::value_type* a, const InputVector::value_type* b) const
+{
+	if (_distanceFunc)
+	{
+		InputVector vectorA {_inputDimCount};
+		InputVector vectorB {_inputDimCount};
+		std::copy(a, a + _inputDimCount, std::begin(vectorA));
+		std::copy(b, b + _inputDimCount, std::begin(vectorB));
+
+		return _distanceFunc(vectorA, vectorB, _weights);
+	}
+
+	switch (_distanceType)
+	{
+		case DistanceType::WeightedEuclidianSquare:	return Distance::computeWeightedEuclidianSquare(a, b, _weights.data(), _inputDimCount);
+		case DistanceType::WeightedCosine:			return Distance::computeWeightedCosine(a, b, _weights.data(), _inputDimCount);
+	}
+
+	throw Exception {"Unhandled distance type"};
 }
 
 InputVector::Distance
 Network::getRefVectorsDistance(const Position& position1, const Position& position2) const
 {
-	return _distanceFunc(_refVectors.get(position1), _refVectors.get(position2), _weights);
+	return computeDistance(getRefVectorData(position1), getRefVectorData(position2));
 }
 
 InputVector::Distance
 Network::computeRefVectorsDistanceMean() const
 {
 	std::vector<InputVector::Distance> values;
-	values.reserve(2 * _refVectors.getHeight()*_refVectors.getWidth() - _refVectors.getWidth() - _refVectors.getHeight());
-	for (Coordinate y {}; y < _refVectors.getHeight(); ++y)
+	values.reserve(2 * _height*_width - _width - _height);
+	for (Coordinate y {}; y < _height; ++y)
 	{
-		for (Coordinate x {}; x < _refVectors.getWidth(); ++x)
+		for (Coordinate x {}; x < _width; ++x)
 		{
-			if (x != _refVectors.getWidth() - 1)
+			if (x != _width - 1)
 				values.emplace_back(getRefVectorsDistance( {x, y}, {x + 1, y}));
-			if (y != _refVectors.getHeight() - 1)
+			if (y != _height - 1)
 				values.emplace_back(getRefVectorsDistance( {x, y}, {x, y + 1}));
 		}
 	}
@@ -143,14 +223,14 @@ double
 Network::computeRefVectorsDistanceMedian() const
 {
 	std::vector<InputVector::Distance> values;
-	values.reserve(2*_refVectors.getHeight()*_refVectors.getWidth() - _refVectors.getWidth() - _refVectors.getHeight());
-	for (Coordinate y {}; y < _refVectors.getHeight(); ++y)
+	values.reserve(2*_height*_width - _width - _height);
+	for (Coordinate y {}; y < _height; ++y)
 	{
-		for (Coordinate x {}; x < _refVectors.getWidth(); ++x)
+		for (Coordinate x {}; x < _width; ++x)
 		{
-			if (x != _refVectors.getWidth() - 1)
+			if (x != _width - 1)
 				values.emplace_back(getRefVectorsDistance( {x, y}, {x + 1, y}));
-			if (y != _refVectors.getHeight() - 1)
+			if (y != _height - 1)
 				values.emplace_back(getRefVectorsDistance( {x, y}, {x, y + 1}));
 		}
 	}
@@ -163,13 +243,13 @@ Network::computeRefVectorsDistanceMedian() const
 void
 Network::dump(std::ostream& os) const
 {
-	os << "Width: " << _refVectors.getWidth() << ", Height: " << _refVectors.getHeight() << std::endl;;
+	os << "Width: " << _width << ", Height: " << _height << std::endl;;
 
-	for (Coordinate y {}; y < _refVectors.getHeight(); ++y)
+	for (Coordinate y {}; y < _height; ++y)
 	{
-		for (Coordinate x {}; x < _refVectors.getWidth(); ++x)
+		for (Coordinate x {}; x < _width; ++x)
 		{
-			os << _refVectors.get({x, y}) << " ";
+			os << getRefVector({x, y}) << " ";
 		}
 
 		os << std::endl;
@@ -177,13 +257,49 @@ Network::dump(std::ostream& os) const
 	os << std::endl;
 }
 
+std::size_t
+Network::getClosestRefVectorIndex(const InputVector::value_type* data) const
+{
+	const std::size_t refVectorCount {static_cast<std::size_t>(_width) * _height};
+	assert(refVectorCount > 0);
+
+	// single pass over the contiguous ref vectors
+	if (_distanceFunc)
+	{
+		std::size_t closestIndex {};
+		InputVector::Distance closestDistance {computeDistance(&_refVectors[0], data)};
+		for (std::size_t index {1}; index < refVectorCount; ++index)
+		{
+			const InputVector::Distance distance {computeDistance(&_refVectors[index * _inputDimCount], data)};
+			if (distance < closestDistance)
+			{
+				closestDistance = distance;
+				closestIndex = index;
+			}
+		}
+
+		return closestIndex;
+	}
+
+	switch (_distanceType)
+	{
+		case DistanceType::WeightedEuclidianSquare:
+			return Distance::findClosestWeightedEuclidianSquare(_refVectors.data(), refVectorCount, data, _weights.data(), _inputDimCount);
+		case DistanceType::WeightedCosine:
+			return Distance::findClosestWeightedCosine(_refVectors.data(), refVectorCount, data, _weights.data(), _inputDimCount);
+	}
+
+	throw Exception {"Unhandled distance type"};
+}
+
 Position
 Network::getClosestRefVectorPosition(const InputVector& data) const
 {
-	return _refVectors.getPositionMinElement([&](const auto& a, const auto& b)
-			{
-				return (_distanceFunc(a, data, _weights) < _distanceFunc(b, data, _weights));
-			});
+	checkSameDimensions(data, _inputDimCount);
+
+	const std::size_t closestIndex {getClosestRefVectorIndex(data.data())};
+
+	return {static_cast<Coordinate>(closestIndex % _width), static_cast<Coordinate>(closestIndex / _width)};
 }
 
 std::optional<Position>
@@ -191,7 +307,7 @@ Network::getClosestRefVectorPosition(const InputVector& data, InputVector::Dista
 {
 	std::optional<Position> position {getClosestRefVectorPosition(data)};
 
-	if (_distanceFunc(data, _refVectors.get(*position), _weights) > maxDistance)
+	if (computeDistance(data.data(), getRefVectorData(*position)) > maxDistance)
 		position.reset();
 
 	return position;
@@ -205,11 +321,11 @@ Network::getClosestRefVectorPosition(const std::vector<Position>& refVectorsPosi
 	{
 		if (refVectorPosition.y > 0)
 			neighboursPosition.insert({ refVectorPosition.x, refVectorPosition.y - 1 });
-		if (refVectorPosition.y < _refVectors.getHeight() - 1)
+		if (refVectorPosition.y < _height - 1)
 			neighboursPosition.insert({ refVectorPosition.x, refVectorPosition.y + 1 });
 		if (refVectorPosition.x > 0)
 			neighboursPosition.insert({ refVectorPosition.x - 1, refVectorPosition.y });
-		if (refVectorPosition.x < _refVectors.getWidth() - 1)
+		if (refVectorPosition.x < _width - 1)
 			neighboursPosition.insert({ refVectorPosition.x + 1, refVectorPosition.y });
 	}
 
@@ -265,18 +381,19 @@ computePositionNorm(const Position& c1, const Position& c2)
 void
 Network::updateRefVectors(const Position& closestRefVectorPosition, const InputVector& input, LearningFactor learningFactor, const CurrentIteration& iteration)
 {
-	for (Coordinate y {}; y < _refVectors.getHeight(); ++y)
+	const InputVector::value_type* __restrict inputData {input.data()};
+
+	for (Coordinate y {}; y < _height; ++y)
 	{
-		for (Coordinate x {}; x < _refVectors.getWidth(); ++x)
+		for (Coordinate x {}; x < _width; ++x)
 		{
-			InputVector& refVector {_refVectors.get({x, y})};
+			InputVector::value_type* __restrict refVector {getRefVectorData({x, y})};
 
 			const Norm norm {computePositionNorm({x, y}, closestRefVectorPosition)};
+			const InputVector::value_type factor {learningFactor * _neighbourhoodFunc(norm, iteration)};
 
-			InputVector delta {input - refVector};
-			delta *= (learningFactor * _neighbourhoodFunc(norm, iteration));
-
-			refVector += delta;
+			for (std::size_t i {}; i < _inputDimCount; ++i)
+				refVector[i] += factor * (inputData[i] - refVector[i]);
 		}
 	}
 }
@@ -318,10 +435,153 @@ Network::train(const std::vector<InputVector>& inputData, std::size_t nbIteratio
 	}
 }
 
-const InputVector&
+// Runs func(first, last) on chunks of [0, count), using the pool threads
+static void
+parallelFor(Utils::ParallelForPool& pool, std::size_t count, const Utils::ParallelForPool::RangeFunc& func)
+{
+	pool.parallelFor(count, [&func](std::size_t first, std::size_t last)
+	{
+		const WorkBudget::ScopedSlot slot {WorkBudget::WorkClass::Bulk};
+		const Profiling::ScopedLabel profilingLabel {"som_training"};
+		func(first, last);
+	});
+}
+
+void
+Network::trainBatch(const std::vector<InputVector>& inputData, std::size_t nbIterations, std::size_t threadCount, ProgressCallback progressCallback, RequestStopCallback requestStopCallback)
+{
+	Utils::ParallelForPool pool {std::max<std::size_t>(threadCount, 1)};
+	trainBatch(inputData, nbIterations, pool, progressCallback, requestStopCallback);
+}
+
+void
+Network::trainBatch(const std::vector<InputVector>& inputData, std::size_t nbIterations, Utils::ParallelForPool& pool, ProgressCallback progressCallback, RequestStopCallback requestStopCallback)
+{
+	for (const InputVector& input : inputData)
+		checkSameDimensions(input, _inputDimCount);
+
+	if (inputData.empty())
+		return;
+
+	// neighbourhood contributions below this ratio of the BMU contribution are ignored
+	constexpr InputVector::value_type neighbourhoodThreshold {1e-4};
+
+	const std::size_t refVectorCount {static_cast<std::size_t>(_width) * _height};
+	std::vector<std::size_t> closestIndexes(inputData.size());
+	std::vector<InputVector::value_type> sums(refVectorCount * _inputDimCount);
+	std::vector<std::size_t> counts(refVectorCount);
+	std::vector<InputVector::value_type> neighbourhood(refVectorCount); // indexed by |dx| + |dy| * width
+
+	for (std::size_t i {}; i < nbIterations; ++i)
+	{
+		const CurrentIteration curIter {i, nbIterations};
+
+		if (progressCallback)
+			progressCallback(curIter);
+
+		if (requestStopCallback && requestStopCallback())
+			return;
+
+		parallelFor(pool, inputData.size(), [&](std::size_t first, std::size_t last)
+		{
+			for (std::size_t sampleIndex {first}; sampleIndex < last; ++sampleIndex)
+				closestIndexes[sampleIndex] = getClosestRefVectorIndex(inputData[sampleIndex].data());
+		});
+
+		if (requestStopCallback && requestStopCallback())
+			return;
+
+		// Accumulated in sample order, so that results do not depend on the thread count
+		// (cheap compared to the BMU searches)
+		std::fill(std::begin(sums), std::end(sums), 0);
+		std::fill(std::begin(counts), std::end(counts), 0);
+		for (std::size_t sampleIndex {}; sampleIndex < inputData.size(); ++sampleIndex)
+		{
+			const std::size_t closestIndex {closestIndexes[sampleIndex]};
+			const InputVector::value_type* __restrict input {inputData[sampleIndex].data()};
+			InputVector::value_type* __restrict sum {&sums[closestIndex * _inputDimCount]};
+
+			for (std::size_t dim {}; dim < _inputDimCount; ++dim)
+				sum[dim] += input[dim];
+			counts[closestIndex]++;
+		}
+
+		// Neighbourhood only depends on the position offset: compute it once and only keep the significant window
+		Coordinate windowRadius {};
+		const InputVector::value_type maxNeighbourhood {_neighbourhoodFunc(0, curIter)};
+		for (Coordinate dy {}; dy < _height; ++dy)
+		{
+			for (Coordinate dx {}; dx < _width; ++dx)
+			{
+				InputVector::value_type& value {neighbourhood[dx + static_cast<std::size_t>(dy) * _width]};
+				value = _neighbourhoodFunc(computePositionNorm({dx, dy}, {0, 0}), curIter);
+				if (value >= maxNeighbourhood * neighbourhoodThreshold)
+					windowRadius = std::max({windowRadius, dx, dy});
+				else
+					value = 0;
+			}
+		}
+
+		parallelFor(pool, _height, [&](std::size_t firstRow, std::size_t lastRow)
+		{
+			std::vector<InputVector::value_type> numerator(_inputDimCount);
+
+			for (Coordinate y {static_cast<Coordinate>(firstRow)}; y < static_cast<Coordinate>(lastRow); ++y)
+			{
+				const Coordinate firstY {y > windowRadius ? y - windowRadius : 0};
+				const Coordinate lastY {std::min(y + windowRadius, _height - 1)};
+
+				for (Coordinate x {}; x < _width; ++x)
+				{
+					const Coordinate firstX {x > windowRadius ? x - windowRadius : 0};
+					const Coordinate lastX {std::min(x + windowRadius, _width - 1)};
+
+					std::fill(std::begin(numerator), std::end(numerator), 0);
+					InputVector::value_type denominator {};
+
+					for (Coordinate neighbourY {firstY}; neighbourY <= lastY; ++neighbourY)
+					{
+						for (Coordinate neighbourX {firstX}; neighbourX <= lastX; ++neighbourX)
+						{
+							const std::size_t neighbourIndex {neighbourX + static_cast<std::size_t>(neighbourY) * _width};
+							if (counts[neighbourIndex] == 0)
+								continue;
+
+							const Coordinate dx {neighbourX > x ? neighbourX - x : x - neighbourX};
+							const Coordinate dy {neighbourY > y ? neighbourY - y : y - neighbourY};
+							const InputVector::value_type factor {neighbourhood[dx + static_cast<std::size_t>(dy) * _width]};
+							if (factor == 0)
+								continue;
+
+							const InputVector::value_type* __restrict sum {&sums[neighbourIndex * _inputDimCount]};
+							for (std::size_t dim {}; dim < _inputDimCount; ++dim)
+								numerator[dim] += factor * sum[dim];
+							denominator += factor * counts[neighbourIndex];
+						}
+					}
+
+					// no sample mapped in the neighbourhood: keep the current value
+					if (denominator == 0)
+						continue;
+
+					InputVector::value_type* __restrict refVector {getRefVectorData({x, y})};
+					for (std::size_t dim {}; dim < _inputDimCount; ++dim)
+						refVector[dim] = numerator[dim] / denominator;
+				}
+			}
+		});
+	}
+}
+
+InputVector
 Network::getRefVector(const Position& position) const
 {
-	return _refVectors[position];
+	InputVector res {_inputDimCount};
+
+	const InputVector::value_type* refVector {getRefVectorData(position)};
+	std::copy(refVector, refVector + _inputDimCount, std::begin(res));
+
+	return res;
 }
 
 
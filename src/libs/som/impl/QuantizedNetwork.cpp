@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "som/QuantizedNetwork.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "Distance.hpp"
+
+namespace SOM
+{
+
+namespace
+{
+	constexpr int quantizedMax {std::numeric_limits<std::int8_t>::max()};
+}
+
+QuantizedNetwork::QuantizedNetwork(const Network& network)
+: _width {network.getWidth()}
+, _height {network.getHeight()}
+, _inputDimCount {network.getInputDimCount()}
+, _weights {network.getDataWeights()}
+, _offsets(_inputDimCount)
+, _scales(_inputDimCount)
+, _distanceFactors(_inputDimCount)
+{
+	if (network.getDistanceType() != Network::DistanceType::WeightedEuclidianSquare)
+		throw Exception {"Unsupported distance type for quantization"};
+
+	std::vector<InputVector> refVectors;
+	refVectors.reserve(static_cast<std::size_t>(_width) * _height);
+	for (Coordinate y {}; y < _height; ++y)
+	{
+		for (Coordinate x {}; x < _width; ++x)
+			refVectors.push_back(network.getRefVector({x, y}));
+	}
+
+	for (std::size_t dimId {}; dimId < _inputDimCount; ++dimId)
+	{
+		const auto [itMin, itMax] {std::minmax_element(std::cbegin(refVectors), std::cend(refVectors),
+				[=](const InputVector& a, const InputVector& b) { return a[dimId] < b[dimId]; })};
+
+		const InputVector::value_type min {(*itMin)[dimId]};
+		const InputVector::value_type max {(*itMax)[dimId]};
+
+		_offsets[dimId] = (min + max) / 2;
+		_scales[dimId] = (max - min) / (2 * quantizedMax);
+		_distanceFactors[dimId] = _weights[dimId] * _scales[dimId] * _scales[dimId];
+	}
+
+	_refVectors.reserve(refVectors.size() * _inputDimCount);
+	for (const InputVector& refVector : refVectors)
+	{
+		const std::vector<quantized_type> quantized {quantize(refVector)};
+		_refVectors.insert(std::end(_refVectors), std::cbegin(quantized), std::cend(quantized));
+	}
+}
+
+std::vector<QuantizedNetwork::quantized_type>
+QuantizedNetwork::quantize(const InputVector& data) const
+{
+	checkSameDimensions(data, _inputDimCount);
+
+	std::vector<quantized_type> res(_inputDimCount);
+	for (std::size_t dimId {}; dimId < _inputDimCount; ++dimId)
+	{
+		if (_scales[dimId] == 0)
+			continue;
+
+		const long value {std::lround((data[dimId] - _offsets[dimId]) / _scales[dimId])};
+		res[dimId] = static_cast<quantized_type>(std::clamp<long>(value, -quantizedMax, quantizedMax));
+	}
+
+	return res;
+}
+
+const QuantizedNetwork::quantized_type*
+QuantizedNetwork::getRefVectorData(const Position& position) const
+{
+	assert(position.x < _width);
+	assert(position.y < _height);
+	return &_refVectors[(position.x + static_cast<std::size_t>(_width) * position.y) * _inputDimCount];
+}
+
+InputVector
+QuantizedNetwork::getRefVector(const Position& position) const
+{
+	InputVector res {_inputDimCount};
+
+	const quantized_type* refVector {getRefVectorData(position)};
+	for (std::size_t dimId {}; dimId < _inputDimCount; ++dimId)
+		res[dimId] = _offsets[dimId] + refVector[dimId] * _scales[dimId];
+
+	return res;
+}
+
+Network
+QuantizedNetwork::toNetwork() const
+{
+	Network network {_width, _height, _inputDimCount};
+	network.setDataWeights(_weights);
+
+	for (Coordinate y {}; y < _height; ++y)
+	{
+		for (Coordinate x {}; x < _width; ++x)
+			network.setRefVector({x, y}, getRefVector({x, y}));
+	}
+
+	return network;
+}
+
+Position
+QuantizedNetwork::getClosestRefVectorPosition(const InputVector& data) const
+{
+	const std::vector<quantized_type> quantized {quantize(data)};
+	const std::size_t index {Distance::findClosestQuantizedWeightedEuclidianSquare(_refVectors.data(), static_cast<std::size_t>(_width) * _height, quantized.data(), _distanceFactors.data(), _inputDimCount)};
+
+	return {static_cast<Coordinate>(index % _width), static_cast<Coordinate>(index / _width)};
+}
+
+InputVector::Distance
+QuantizedNetwork::getRefVectorsDistance(const Position& position1, const Position& position2) const
+{
+	return Distance::computeQuantizedWeightedEuclidianSquare(getRefVectorData(position1), getRefVectorData(position2), _distanceFactors.data(), _inputDimCount);
+}
+
+} // namespace SOM
@@ -47,6 +47,8 @@ class DataNormalizer
 		void computeNormalizationFactors(const std::vector<InputVector>& dataSamples);
 
 		void normalizeData(InputVector& data) const;
+		// Same as normalizing each vector, spread over threadCount threads
+		void normalizeData(std::vector<InputVector>& data, std::size_t threadCount = 1) const;
 
 		void dump(std::ostream& os) const;
 
@@ -20,8 +20,9 @@
 
 #pragma once
 
-#include <vector>
 #include <cmath>
+#include <ostream>
+#include <vector>
 
 #include "utils/Exception.hpp"
 
@@ -132,6 +133,16 @@ class InputVector
 			return res;
 		}
 
+		value_type* data()
+		{
+			return _values.data();
+		}
+
+		const value_type* data() const
+		{
+			return _values.data();
+		}
+
 		std::vector<value_type>::iterator begin()
 		{
 			return _values.begin();
@@ -19,14 +19,22 @@
 
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <optional>
 #include <ostream>
 #include <functional>
 
+#include "utils/Random.hpp"
+
 #include "InputVector.hpp"
 #include "Matrix.hpp"
 
+namespace Utils
+{
+	class ParallelForPool;
+}
+
 namespace SOM
 {
 
@@ -42,10 +50,11 @@ class Network
 	public:
 
 		// Init a network with random values
-		Network(Coordinate width, Coordinate height, std::size_t inputDimCount);
+		// Use a seed to get reproducible results (along with trainBatch)
+		Network(Coordinate width, Coordinate height, std::size_t inputDimCount, std::optional<std::uint_fast32_t> seed = std::nullopt);
 
-		Coordinate getWidth() const { return _refVectors.getWidth(); }
-		Coordinate getHeight() const { return _refVectors.getHeight(); }
+		Coordinate getWidth() const { return _width; }
+		Coordinate getHeight() const { return _height; }
 		std::size_t getInputDimCount() const { return _inputDimCount; }
 		const InputVector& getDataWeights() const { return _weights; }
 
@@ -65,7 +74,14 @@ class Network
 		using RequestStopCallback = std::function<bool()>;
 		void train(const std::vector<InputVector>& dataSamples, std::size_t nbIterations, ProgressCallback = ProgressCallback{}, RequestStopCallback = RequestStopCallback{});
 
-		const InputVector& getRefVector(const Position& position) const;
+		// Batch training: at each iteration, all the ref vectors are recomputed from the samples mapped on their neighbourhood
+		// BMU searches and updates are spread over threadCount threads, results do not depend on the thread count
+		// The learning factor function is not used
+		void trainBatch(const std::vector<InputVector>& dataSamples, std::size_t nbIterations, std::size_t threadCount, ProgressCallback = ProgressCallback{}, RequestStopCallback = RequestStopCallback{});
+		// Same, using the threads of an existing pool (useful to chain several trainings)
+		void trainBatch(const std::vector<InputVector>& dataSamples, std::size_t nbIterations, Utils::ParallelForPool& pool, ProgressCallback = ProgressCallback{}, RequestStopCallback = RequestStopCallback{});
+
+		InputVector getRefVector(const Position& position) const;
 		Position getClosestRefVectorPosition(const InputVector& data) const;
 		std::optional<Position> getClosestRefVectorPosition(const InputVector& data, InputVector::Distance maxDistance) const;
 
@@ -82,9 +98,19 @@ class Network
 		// i is the current iteration
 		// refVector(i+1) = refVector(i) + LearningFactor(i) * NeighbourhoodFunc(i) * (MatchingRefVector - refVector)
 
+		// Built-in distances, default is WeightedEuclidianSquare
+		enum class DistanceType
+		{
+			WeightedEuclidianSquare,
+			WeightedCosine,
+		};
+		void setDistanceType(DistanceType distanceType);
+		DistanceType getDistanceType() const { return _distanceType; }
+
+		// Custom distance, much slower than the built-in ones
 		using DistanceFunc = std::function<InputVector::Distance(const InputVector& /* a */, const InputVector& /* b */, const InputVector& /* weights */)>;
 		void setDistanceFunc(DistanceFunc distanceFunc);
-		DistanceFunc getDistanceFunc() { return _distanceFunc; }
+		DistanceFunc getDistanceFunc() const;
 
 		using LearningFactorFunc = std::function<LearningFactor(const CurrentIteration&)>;
 		void setLearningFactorFunc(LearningFactorFunc learningFactorFunc);
@@ -94,13 +120,22 @@ class Network
 
 	private:
 
+		void initRefVectors(Random::RandGenerator& randGenerator);
 		void updateRefVectors(const Position& closestRefVectorPosition, const InputVector& input, LearningFactor learningFactor, const CurrentIteration& iteration);
+		std::size_t getClosestRefVectorIndex(const InputVector::value_type* data) const;
+
+		InputVector::value_type* getRefVectorData(const Position& position);
+		const InputVector::value_type* getRefVectorData(const Position& position) const;
+		InputVector::Distance computeDistance(const InputVector::value_type* a, const InputVector::value_type* b) const;
 
+		Coordinate _width {};
+		Coordinate _height {};
 		std::size_t _inputDimCount {};
 		InputVector _weights;	// weight for each dimension
-		Matrix<InputVector> _refVectors;
+		std::vector<InputVector::value_type> _refVectors;	// contiguous, inputDimCount values per ref vector, row major
 
-		DistanceFunc _distanceFunc;
+		DistanceType _distanceType {DistanceType::WeightedEuclidianSquare};
+		DistanceFunc _distanceFunc;	// overrides the built-in distance if set
 		LearningFactorFunc _learningFactorFunc;
 		NeighbourhoodFunc _neighbourhoodFunc;
 };
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "InputVector.hpp"
+#include "Matrix.hpp"
+#include "Network.hpp"
+
+namespace SOM
+{
+
+// Read-only copy of a trained network, with ref vectors stored as int8 values (8 times less memory)
+// Each dimension is quantized on 255 steps spanning the min/max of the ref vectors for this dimension
+// Values are off by at most half a step, distances are computed in the quantized domain
+// Only the WeightedEuclidianSquare distance is supported
+class QuantizedNetwork
+{
+	public:
+		explicit QuantizedNetwork(const Network& network);
+
+		Coordinate getWidth() const { return _width; }
+		Coordinate getHeight() const { return _height; }
+		std::size_t getInputDimCount() const { return _inputDimCount; }
+		const InputVector& getDataWeights() const { return _weights; }
+
+		// Dequantized values
+		InputVector getRefVector(const Position& position) const;
+		Network toNetwork() const;
+
+		Position getClosestRefVectorPosition(const InputVector& data) const;
+		InputVector::Distance getRefVectorsDistance(const Position& position1, const Position& position2) const;
+
+	private:
+		using quantized_type = std::int8_t;
+
+		std::vector<quantized_type> quantize(const InputVector& data) const;
+		const quantized_type* getRefVectorData(const Position& position) const;
+
+		Coordinate _width {};
+		Coordinate _height {};
+		std::size_t _inputDimCount {};
+		InputVector _weights;
+		std::vector<InputVector::value_type> _offsets;			// for each dimension, value = offset + quantized value * scale
+		std::vector<InputVector::value_type> _scales;
+		std::vector<InputVector::value_type> _distanceFactors;	// for each dimension, weight * scale²
+		std::vector<quantized_type> _refVectors;				// contiguous, inputDimCount values per ref vector, row major
+};
+
+} // namespace SOM
@@ -17,10 +17,13 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <limits>
+#include <unordered_map>
 #include <unordered_set>
 #include <gtest/gtest.h>
 #include "som/DataNormalizer.hpp"
 #include "som/Network.hpp"
+#include "som/QuantizedNetwork.hpp"
 
 using namespace SOM;
 
@@ -126,8 +129,258 @@ TEST(som, Network)
 	}
 }
 
+TEST(som, NetworkDistances)
+{
+	auto createVector {[](std::initializer_list<InputVector::value_type> values)
+	{
+		InputVector res {values.size()};
+		std::copy(std::cbegin(values), std::cend(values), std::begin(res));
+		return res;
+	}};
+
+	{
+		const InputVector weights {createVector({3, 1, 1})};
+		Network network {2, 2, 3};
+		auto distFunc {network.getDistanceFunc()};
+		EXPECT_LT(std::abs(distFunc(createVector({1, 2, 3}), createVector({2, 4, 6}), weights) - 16), EPSILON);
+		EXPECT_THROW(distFunc(createVector({1, 2}), createVector({2, 4, 6}), weights), Exception);
+
+		network.setDistanceType(Network::DistanceType::WeightedCosine);
+		distFunc = network.getDistanceFunc();
+		EXPECT_LT(std::abs(distFunc(createVector({1, 2, 3}), createVector({2, 4, 6}), weights)), EPSILON);
+		EXPECT_LT(std::abs(distFunc(createVector({1, 0, 0}), createVector({0, 1, 0}), weights) - 1), EPSILON);
+		EXPECT_LT(std::abs(distFunc(createVector({0, 0, 0}), createVector({0, 1, 0}), weights) - 1), EPSILON);
+	}
+
+	// built-in kernels and custom functions must give the same results
+	for (const Network::DistanceType distanceType : {Network::DistanceType::WeightedEuclidianSquare, Network::DistanceType::WeightedCosine})
+	{
+		constexpr std::size_t dimCount {7}; // not a multiple of the kernel lane count
+		Network network {3, 4, dimCount};
+		network.setDistanceType(distanceType);
+
+		for (Coordinate y {}; y < network.getHeight(); ++y)
+		{
+			for (Coordinate x {}; x < network.getWidth(); ++x)
+			{
+				InputVector refVector {dimCount};
+				for (std::size_t i {}; i < dimCount; ++i)
+					refVector[i] = static_cast<InputVector::value_type>((x * 7 + y * 3 + i * 5) % 11) / 11;
+				network.setRefVector({x, y}, refVector);
+			}
+		}
+
+		std::vector<InputVector> inputs;
+		for (std::size_t i {}; i < 20; ++i)
+		{
+			InputVector input {dimCount};
+			for (std::size_t j {}; j < dimCount; ++j)
+				input[j] = static_cast<InputVector::value_type>((i * 3 + j * 7) % 13) / 13;
+			inputs.push_back(input);
+		}
+
+		std::vector<Position> builtinPositions;
+		for (const InputVector& input : inputs)
+			builtinPositions.push_back(network.getClosestRefVectorPosition(input));
+
+		network.setDistanceFunc(network.getDistanceFunc());
+		for (std::size_t i {}; i < inputs.size(); ++i)
+			EXPECT_EQ(network.getClosestRefVectorPosition(inputs[i]), builtinPositions[i]);
+	}
+}
+
 int main(int argc, char **argv)
 {
 	::testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
 }
+
+TEST(som, NetworkBatchTraining)
+{
+	// 4 clusters
+	std::vector<InputVector> trainData;
+	for (std::size_t i {}; i < 100; ++i)
+	{
+		InputVector input {2};
+		const InputVector::value_type noise {static_cast<InputVector::value_type>(i % 10) / 100};
+		input[0] = (i % 2 ? 0.9 : 0.1) + noise;
+		input[1] = ((i / 2) % 2 ? 0.9 : 0.1) - noise;
+		trainData.push_back(input);
+	}
+
+	constexpr std::size_t iterationCount {10};
+	auto trainNetwork {[&](std::size_t threadCount)
+	{
+		Network network {4, 4, 2, 42};
+
+		std::size_t progressCount {};
+		network.trainBatch(trainData, iterationCount, threadCount, [&](const Network::CurrentIteration& iter)
+		{
+			EXPECT_EQ(iter.idIteration, progressCount);
+			EXPECT_EQ(iter.iterationCount, iterationCount);
+			progressCount++;
+		});
+		EXPECT_EQ(progressCount, iterationCount);
+
+		return network;
+	}};
+
+	const Network network {trainNetwork(1)};
+	{
+		// samples of different clusters never share the same ref vector
+		std::unordered_map<Position, std::size_t> clusterByPosition;
+		for (std::size_t i {}; i < trainData.size(); ++i)
+		{
+			const auto [it, inserted] {clusterByPosition.emplace(network.getClosestRefVectorPosition(trainData[i]), i % 4)};
+			EXPECT_EQ(it->second, i % 4);
+		}
+		EXPECT_GE(clusterByPosition.size(), 4);
+	}
+
+	// same seed: same result, whatever the thread count
+	for (std::size_t threadCount : {2, 3, 16})
+	{
+		const Network otherNetwork {trainNetwork(threadCount)};
+		for (Coordinate y {}; y < network.getHeight(); ++y)
+		{
+			for (Coordinate x {}; x < network.getWidth(); ++x)
+			{
+				const InputVector refVector {network.getRefVector({x, y})};
+				const InputVector otherRefVector {otherNetwork.getRefVector({x, y})};
+				for (std::size_t i {}; i < refVector.getNbDimensions(); ++i)
+					EXPECT_EQ(refVector[i], otherRefVector[i]);
+			}
+		}
+	}
+
+	// stop requested
+	{
+		Network stoppedNetwork {4, 4, 2, 42};
+		const InputVector refVector {stoppedNetwork.getRefVector({0, 0})};
+		stoppedNetwork.trainBatch(trainData, iterationCount, 2, {}, [] { return true; });
+		const InputVector otherRefVector {stoppedNetwork.getRefVector({0, 0})};
+		for (std::size_t i {}; i < refVector.getNbDimensions(); ++i)
+			EXPECT_EQ(refVector[i], otherRefVector[i]);
+	}
+}
+
+TEST(som, DataNormalizer)
+{
+	std::vector<InputVector> data;
+	for (std::size_t i {}; i < 1000; ++i)
+	{
+		InputVector input {3};
+		input[0] = static_cast<InputVector::value_type>(i);
+		input[1] = -static_cast<InputVector::value_type>(i % 10);
+		input[2] = 5;
+		data.push_back(input);
+	}
+	data[500][2] = 15;
+
+	DataNormalizer normalizer {3};
+	normalizer.computeNormalizationFactors(data);
+	EXPECT_EQ(normalizer.getValue(0).min, 0);
+	EXPECT_EQ(normalizer.getValue(0).max, 999);
+	EXPECT_EQ(normalizer.getValue(1).min, -9);
+	EXPECT_EQ(normalizer.getValue(1).max, 0);
+	EXPECT_EQ(normalizer.getValue(2).min, 5);
+	EXPECT_EQ(normalizer.getValue(2).max, 15);
+
+	// same results as normalizing each vector, whatever the thread count
+	std::vector<InputVector> expected {data};
+	for (InputVector& input : expected)
+		normalizer.normalizeData(input);
+
+	for (std::size_t threadCount : {1, 4})
+	{
+		std::vector<InputVector> normalized {data};
+		normalizer.normalizeData(normalized, threadCount);
+		for (std::size_t i {}; i < data.size(); ++i)
+		{
+			for (std::size_t dimId {}; dimId < 3; ++dimId)
+				EXPECT_EQ(normalized[i][dimId], expected[i][dimId]);
+		}
+	}
+
+	// out of range values are clamped
+	{
+		InputVector input {3};
+		input[0] = 2000;
+		input[1] = -20;
+		input[2] = 10;
+		normalizer.normalizeData(input);
+		EXPECT_EQ(input[0], 1);
+		EXPECT_EQ(input[1], 0);
+		EXPECT_EQ(input[2], 0.5);
+	}
+}
+
+TEST(som, QuantizedNetwork)
+{
+	std::vector<InputVector> trainData;
+	for (std::size_t i {}; i < 400; ++i)
+	{
+		InputVector input {3};
+		input[0] = (i % 2 ? 0.9 : 0.1);
+		input[1] = ((i / 2) % 2 ? 0.9 : 0.1);
+		input[2] = static_cast<InputVector::value_type>(i % 7) / 7;
+		trainData.push_back(input);
+	}
+
+	Network network {6, 6, 3, 42};
+	network.trainBatch(trainData, 10, 1);
+
+	const QuantizedNetwork quantizedNetwork {network};
+	ASSERT_EQ(quantizedNetwork.getWidth(), network.getWidth());
+	ASSERT_EQ(quantizedNetwork.getHeight(), network.getHeight());
+	ASSERT_EQ(quantizedNetwork.getInputDimCount(), network.getInputDimCount());
+
+	// values are off by at most half a quantization step
+	for (std::size_t dimId {}; dimId < network.getInputDimCount(); ++dimId)
+	{
+		InputVector::value_type min {std::numeric_limits<InputVector::value_type>::max()};
+		InputVector::value_type max {std::numeric_limits<InputVector::value_type>::lowest()};
+		for (Coordinate y {}; y < network.getHeight(); ++y)
+		{
+			for (Coordinate x {}; x < network.getWidth(); ++x)
+			{
+				min = std::min(min, network.getRefVector({x, y})[dimId]);
+				max = std::max(max, network.getRefVector({x, y})[dimId]);
+			}
+		}
+
+		const InputVector::value_type maxError {(max - min) / 254 / 2 + 1e-9};
+		for (Coordinate y {}; y < network.getHeight(); ++y)
+		{
+			for (Coordinate x {}; x < network.getWidth(); ++x)
+				EXPECT_LE(std::abs(network.getRefVector({x, y})[dimId] - quantizedNetwork.getRefVector({x, y})[dimId]), maxError);
+		}
+	}
+
+	// same distances, up to the quantization error
+	{
+		const Network& refNetwork {network};
+		const InputVector::Distance distance {refNetwork.getRefVectorsDistance({0, 0}, {5, 5})};
+		EXPECT_NEAR(quantizedNetwork.getRefVectorsDistance({0, 0}, {5, 5}), distance, distance * 0.05);
+	}
+
+	// samples mostly get the same ref vectors
+	std::size_t samePositionCount {};
+	for (const InputVector& input : trainData)
+	{
+		if (quantizedNetwork.getClosestRefVectorPosition(input) == network.getClosestRefVectorPosition(input))
+			samePositionCount++;
+	}
+	EXPECT_GE(samePositionCount, trainData.size() * 95 / 100);
+
+	// quantizing the dequantized network gives the same values
+	const QuantizedNetwork otherQuantizedNetwork {quantizedNetwork.toNetwork()};
+	for (Coordinate y {}; y < network.getHeight(); ++y)
+	{
+		for (Coordinate x {}; x < network.getWidth(); ++x)
+		{
+			for (std::size_t dimId {}; dimId < network.getInputDimCount(); ++dimId)
+				EXPECT_NEAR(otherQuantizedNetwork.getRefVector({x, y})[dimId], quantizedNetwork.getRefVector({x, y})[dimId], 1e-9);
+		}
+	}
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ArtistIndexCache.hpp"
+
+#include <cctype>
+#include <optional>
+#include <unordered_map>
+
+#include "services/database/Artist.hpp"
+#include "services/database/Session.hpp"
+#include "utils/Logger.hpp"
+
+namespace API::Subsonic
+{
+	std::shared_ptr<const ArtistIndexCache::Indexes>
+	ArtistIndexCache::get(Database::Session& session, Database::SubsonicArtistListMode listMode, std::size_t libraryGeneration)
+	{
+		const std::scoped_lock lock {_mutex};
+
+		Entry& entry {_entries[listMode]};
+		if (!entry.indexes || entry.libraryGeneration != libraryGeneration)
+		{
+			entry.indexes = std::make_shared<const Indexes>(computeIndexes(session, listMode));
+			entry.libraryGeneration = libraryGeneration;
+		}
+
+		return entry.indexes;
+	}
+
+	ArtistIndexCache::Indexes
+	ArtistIndexCache::computeIndexes(Database::Session& session, Database::SubsonicArtistListMode listMode)
+	{
+		using namespace Database;
+
+		Database::Artist::FindParameters parameters;
+		parameters.setSortMethod(ArtistSortMethod::BySortName);
+		switch (listMode)
+		{
+			case SubsonicArtistListMode::AllArtists:
+				break;
+			case SubsonicArtistListMode::ReleaseArtists:
+				parameters.setLinkType(TrackArtistLinkType::ReleaseArtist);
+				break;
+			case SubsonicArtistListMode::TrackArtists:
+				parameters.setLinkType(TrackArtistLinkType::Artist);
+				break;
+		}
+
+		Indexes indexes;
+		std::optional<std::size_t> currentIndex; // position in indexes
+		std::optional<std::size_t> unknownIndex;
+
+		const RangeResults<ArtistId> artistIds {Database::Artist::find(session, parameters)};
+		const std::unordered_map<ArtistId, Database::Artist::Summary> summaries {Database::Artist::getSummaries(session)};
+		for (const ArtistId artistId : artistIds.results)
+		{
+			const Database::Artist::pointer artist {Database::Artist::find(session, artistId)};
+			if (!artist)
+				continue;
+
+			const std::string& sortName {artist->getSortName()};
+
+			std::size_t index;
+			if (sortName.empty() || !std::isalpha(static_cast<unsigned char>(sortName[0])))
+			{
+				if (!unknownIndex)
+				{
+					unknownIndex = indexes.size();
+					indexes.push_back(Index {"?", {}});
+				}
+				index = *unknownIndex;
+			}
+			else
+			{
+				const std::string indexName {static_cast<char>(std::toupper(static_cast<unsigned char>(sortName[0])))};
+				if (!currentIndex || indexes[*currentIndex].name != indexName)
+				{
+					currentIndex = indexes.size();
+					indexes.push_back(Index {indexName, {}});
+				}
+				index = *currentIndex;
+			}
+
+			const auto itSummary {summaries.find(artistId)};
+			const std::size_t releaseCount {itSummary != std::cend(summaries) ? itSummary->second.releaseCount : 0};
+
+			indexes[index].artists.push_back(ArtistIndexCache::Artist {artist->getId(), artist->getName(), releaseCount});
+		}
+
+		LMS_LOG(API_SUBSONIC, DEBUG) << "Artist index computed: " << artistIds.results.size() << " artists, " << indexes.size() << " indexes";
+
+		return indexes;
+	}
+} // namespace API::Subsonic
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "services/database/ArtistId.hpp"
+#include "services/database/Types.hpp"
+
+namespace Database
+{
+	class Session;
+}
+
+namespace API::Subsonic
+{
+	// Artists grouped by the first letter of their sort name, for each artist list mode
+	// Computed once per library generation, so that getIndexes/getArtists do not have to sort and group all the artists on each request
+	class ArtistIndexCache
+	{
+		public:
+			struct Artist
+			{
+				Database::ArtistId	id;
+				std::string			name;
+				std::size_t			releaseCount {};
+			};
+
+			struct Index
+			{
+				std::string			name;		// "?" for all the artists whose sort name does not start with a letter
+				std::vector<Artist>	artists;	// sorted by sort name
+			};
+			using Indexes = std::vector<Index>;
+
+			ArtistIndexCache() = default;
+			ArtistIndexCache(const ArtistIndexCache&) = delete;
+			ArtistIndexCache& operator=(const ArtistIndexCache&) = delete;
+
+			// A shared transaction must be held, the index is computed again if the library generation changed
+			std::shared_ptr<const Indexes> get(Database::Session& session, Database::SubsonicArtistListMode listMode, std::size_t libraryGeneration);
+
+		private:
+			static Indexes computeIndexes(Database::Session& session, Database::SubsonicArtistListMode listMode);
+
+			struct Entry
+			{
+				std::size_t						libraryGeneration {};
+				std::shared_ptr<const Indexes>	indexes;
+			};
+
+			std::mutex	_mutex; // held during the computations, concurrent requests just wait for the result
+			std::map<Database::SubsonicArtistListMode, Entry>	_entries;
+	};
+} // namespace API::Subsonic
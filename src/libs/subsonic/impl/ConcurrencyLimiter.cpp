@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ConcurrencyLimiter.hpp"
+
+#include <cassert>
+
+namespace API::Subsonic
+{
+	ConcurrencyLimiter::Slot::~Slot()
+	{
+		if (_limiter)
+			_limiter->release(_cost, _userId);
+	}
+
+	ConcurrencyLimiter::Slot&
+	ConcurrencyLimiter::Slot::operator=(Slot&& other)
+	{
+		if (this != &other)
+		{
+			if (_limiter)
+				_limiter->release(_cost, _userId);
+
+			_limiter = other._limiter;
+			_cost = other._cost;
+			_userId = other._userId;
+			other._limiter = nullptr;
+		}
+
+		return *this;
+	}
+
+	std::optional<ConcurrencyLimiter::Slot>
+	ConcurrencyLimiter::tryAcquire(RequestCost cost, Database::UserId userId)
+	{
+		if (cost == RequestCost::Interactive)
+			return std::optional<Slot> {std::in_place, nullptr, cost, userId};
+
+		const std::size_t maxRequestCount {cost == RequestCost::Browsing ? _limits.maxBrowsingRequestCount : _limits.maxMediaRequestCount};
+
+		const std::scoped_lock lock {_mutex};
+
+		std::size_t& requestCount {getRequestCount(cost)};
+		if (maxRequestCount && requestCount >= maxRequestCount)
+			return std::nullopt;
+
+		std::size_t& userRequestCount {_requestCountByUser[userId]};
+		if (_limits.maxRequestCountPerUser && userRequestCount >= _limits.maxRequestCountPerUser)
+			return std::nullopt;
+
+		requestCount++;
+		userRequestCount++;
+
+		return std::optional<Slot> {std::in_place, this, cost, userId};
+	}
+
+	void
+	ConcurrencyLimiter::release(RequestCost cost, Database::UserId userId)
+	{
+		const std::scoped_lock lock {_mutex};
+
+		std::size_t& requestCount {getRequestCount(cost)};
+		assert(requestCount > 0);
+		requestCount--;
+
+		auto itUser {_requestCountByUser.find(userId)};
+		assert(itUser != std::end(_requestCountByUser));
+		if (--itUser->second == 0)
+			_requestCountByUser.erase(itUser);
+	}
+
+	std::size_t&
+	ConcurrencyLimiter::getRequestCount(RequestCost cost)
+	{
+		assert(cost != RequestCost::Interactive);
+		return cost == RequestCost::Browsing ? _browsingRequestCount : _mediaRequestCount;
+	}
+} // namespace API::Subsonic
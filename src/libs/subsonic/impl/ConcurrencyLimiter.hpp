@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include "services/database/UserId.hpp"
+
+namespace API::Subsonic
+{
+	enum class RequestCost
+	{
+		Interactive,	// never limited
+		Browsing,		// bulk listings and searches
+		Media,			// streams and downloads
+	};
+
+	// Bounds the number of costly requests handled at the same time, so that they cannot occupy all the http server threads
+	// Requests exceeding a limit are meant to be rejected right away: waiting would also hold a thread
+	class ConcurrencyLimiter
+	{
+		public:
+			// 0 means no limit
+			struct Limits
+			{
+				std::size_t maxBrowsingRequestCount {};
+				std::size_t maxMediaRequestCount {};
+				std::size_t maxRequestCountPerUser {};	// costly requests only
+			};
+
+			class Slot
+			{
+				public:
+					// limiter is nullptr for the interactive requests
+					Slot(ConcurrencyLimiter* limiter, RequestCost cost, Database::UserId userId) : _limiter {limiter}, _cost {cost}, _userId {userId} {}
+					~Slot();
+
+					Slot(const Slot&) = delete;
+					Slot(Slot&& other) : _limiter {other._limiter}, _cost {other._cost}, _userId {other._userId} { other._limiter = nullptr; }
+					Slot& operator=(const Slot&) = delete;
+					Slot& operator=(Slot&& other);
+
+				private:
+					ConcurrencyLimiter*	_limiter;
+					RequestCost			_cost;
+					Database::UserId	_userId;
+			};
+
+			ConcurrencyLimiter(const Limits& limits) : _limits {limits} {}
+
+			ConcurrencyLimiter(const ConcurrencyLimiter&) = delete;
+			ConcurrencyLimiter(ConcurrencyLimiter&&) = delete;
+			ConcurrencyLimiter& operator=(const ConcurrencyLimiter&) = delete;
+			ConcurrencyLimiter& operator=(ConcurrencyLimiter&&) = delete;
+
+			// std::nullopt if a limit is reached
+			std::optional<Slot> tryAcquire(RequestCost cost, Database::UserId userId);
+
+		private:
+			void release(RequestCost cost, Database::UserId userId);
+			std::size_t& getRequestCount(RequestCost cost);
+
+			const Limits	_limits;
+
+			std::mutex		_mutex;
+			std::size_t		_browsingRequestCount {};
+			std::size_t		_mediaRequestCount {};
+			std::unordered_map<Database::UserId, std::size_t> _requestCountByUser;
+	};
+} // namespace API::Subsonic
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "EntityNodeCache.hpp"
+
+#include <mutex>
+
+#include "utils/Logger.hpp"
+
+namespace API::Subsonic
+{
+	EntityNodeCache::EntityNodeCache(std::size_t maxEntryCount)
+		: _maxEntryCount {maxEntryCount}
+		, _referenced {std::make_unique<std::atomic<bool>[]>(maxEntryCount)}
+	{
+		_slotKeys.reserve(_maxEntryCount);
+		LMS_LOG(API_SUBSONIC, INFO) << "Entity node cache: max entry count = " << _maxEntryCount;
+	}
+
+	Response::Node
+	EntityNodeCache::get(EntityType type, Database::IdType::ValueType id, std::size_t libraryGeneration, const std::function<Response::Node()>& buildNode)
+	{
+		if (_maxEntryCount == 0)
+			return buildNode();
+
+		const Key key {type, id};
+
+		{
+			std::shared_lock lock {_mutex};
+
+			if (_libraryGeneration == libraryGeneration)
+			{
+				if (auto it {_nodes.find(key)}; it != std::cend(_nodes))
+				{
+					++_hits;
+					_referenced[it->second.slot].store(true, std::memory_order_relaxed);
+					return it->second.node;
+				}
+			}
+		}
+
+		++_misses;
+		Response::Node node {buildNode()};
+
+		{
+			std::unique_lock lock {_mutex};
+
+			if (_libraryGeneration != libraryGeneration)
+			{
+				// built from an outdated library
+				if (libraryGeneration < _libraryGeneration)
+					return node;
+
+				LMS_LOG(API_SUBSONIC, DEBUG) << "Entity node cache: library changed, dropping " << _nodes.size() << " entries (hits = " << _hits << ", misses = " << _misses << ")";
+				_nodes.clear();
+				_slotKeys.clear();
+				_clockHand = 0;
+				_libraryGeneration = libraryGeneration;
+			}
+
+			// concurrent misses on the same entity
+			if (_nodes.find(key) != std::cend(_nodes))
+				return node;
+
+			const std::size_t slot {acquireSlot()};
+			_slotKeys[slot] = key;
+			_referenced[slot].store(false, std::memory_order_relaxed);
+			_nodes.emplace(key, Entry {node, slot});
+		}
+
+		return node;
+	}
+
+	std::size_t
+	EntityNodeCache::acquireSlot()
+	{
+		if (_slotKeys.size() < _maxEntryCount)
+		{
+			_slotKeys.push_back({});
+			return _slotKeys.size() - 1;
+		}
+
+		// Referenced entries get a second chance: at most one full turn
+		while (true)
+		{
+			const std::size_t slot {_clockHand};
+			_clockHand = (_clockHand + 1) % _slotKeys.size();
+
+			if (!_referenced[slot].exchange(false, std::memory_order_relaxed))
+			{
+				_nodes.erase(_slotKeys[slot]);
+				return slot;
+			}
+		}
+	}
+} // namespace API::Subsonic
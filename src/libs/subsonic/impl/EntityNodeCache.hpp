@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "services/database/IdType.hpp"
+#include "SubsonicResponse.hpp"
+
+namespace API::Subsonic
+{
+	// User independent parts of the entity nodes (tracks, albums and artists), built once per library generation
+	// Nodes do not depend on the response format nor on the protocol version: the same entry serves all the clients
+	// User dependent attributes (starred, transcoded suffix, ...) must be set by the callers on the returned copy
+	class EntityNodeCache
+	{
+		public:
+			enum class EntityType
+			{
+				Track,
+				Album,
+				AlbumId3,
+				Artist,
+				ArtistId3,
+			};
+
+			EntityNodeCache(std::size_t maxEntryCount);
+
+			EntityNodeCache(const EntityNodeCache&) = delete;
+			EntityNodeCache& operator=(const EntityNodeCache&) = delete;
+
+			// All the entries are dropped as soon as the library generation changes
+			// buildNode is called without any lock held, concurrent misses on the same entity may build it several times
+			Response::Node get(EntityType type, Database::IdType::ValueType id, std::size_t libraryGeneration, const std::function<Response::Node()>& buildNode);
+
+		private:
+			struct Key
+			{
+				EntityType					type;
+				Database::IdType::ValueType	id;
+
+				bool operator==(const Key& other) const { return type == other.type && id == other.id; }
+			};
+
+			struct KeyHash
+			{
+				std::size_t operator()(const Key& key) const
+				{
+					return std::hash<Database::IdType::ValueType>()(key.id) ^ (static_cast<std::size_t>(key.type) << 1);
+				}
+			};
+
+			// _mutex must be held exclusively
+			std::size_t	acquireSlot();
+
+			const std::size_t	_maxEntryCount;
+
+			// Eviction using the CLOCK algorithm: hits only set a reference bit, so that they can be served under a shared lock
+			struct Entry
+			{
+				Response::Node	node;
+				std::size_t		slot;
+			};
+			std::shared_mutex	_mutex;
+			std::size_t			_libraryGeneration {};
+			std::unordered_map<Key, Entry, KeyHash>	_nodes;
+			std::vector<Key>						_slotKeys;		// key of each used slot
+			std::unique_ptr<std::atomic<bool>[]>	_referenced;	// per slot, set on hits
+			std::size_t								_clockHand {};
+			std::atomic<std::size_t>	_hits {};
+			std::atomic<std::size_t>	_misses {};
+	};
+} // namespace API::Subsonic
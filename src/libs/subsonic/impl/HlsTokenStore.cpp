@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HlsTokenStore.hpp"
+
+#include <Wt/WRandom.h>
+
+namespace API::Subsonic
+{
+	namespace
+	{
+		constexpr std::chrono::minutes purgePeriod {1};
+	}
+
+	std::string
+	HlsTokenStore::createToken(const Grant& grant, Database::TrackId trackId, std::chrono::seconds lifetime)
+	{
+		std::string token {Wt::WRandom::generateId(32)};
+
+		Grant storedGrant {grant};
+		storedGrant.clientInfo.password.clear();
+
+		const auto now {std::chrono::steady_clock::now()};
+
+		const std::scoped_lock lock {_mutex};
+		purgeExpiredTokens(now);
+		_entries.insert_or_assign(token, Entry {std::move(storedGrant), trackId, now + lifetime});
+
+		return token;
+	}
+
+	std::optional<HlsTokenStore::Grant>
+	HlsTokenStore::findGrant(std::string_view token, Database::TrackId trackId)
+	{
+		const auto now {std::chrono::steady_clock::now()};
+
+		const std::scoped_lock lock {_mutex};
+
+		auto it {_entries.find(std::string {token})};
+		if (it == std::cend(_entries) || it->second.expiry <= now || it->second.trackId != trackId)
+			return std::nullopt;
+
+		return it->second.grant;
+	}
+
+	void
+	HlsTokenStore::purgeExpiredTokens(std::chrono::steady_clock::time_point now)
+	{
+		if (now < _nextPurge)
+			return;
+
+		_nextPurge = now + purgePeriod;
+		for (auto it {std::begin(_entries)}; it != std::end(_entries);)
+		{
+			if (it->second.expiry <= now)
+				it = _entries.erase(it);
+			else
+				++it;
+		}
+	}
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "services/database/TrackId.hpp"
+#include "services/database/UserId.hpp"
+#include "ClientInfo.hpp"
+
+namespace API::Subsonic
+{
+	// Short lived tokens put in the HLS playlists instead of the credentials of the user
+	// A token only grants access to the playlists and segments of one track
+	class HlsTokenStore
+	{
+		public:
+			HlsTokenStore() = default;
+			HlsTokenStore(const HlsTokenStore&) = delete;
+			HlsTokenStore& operator=(const HlsTokenStore&) = delete;
+
+			struct Grant
+			{
+				Database::UserId	userId;
+				ClientInfo			clientInfo;	// without the password
+			};
+
+			std::string createToken(const Grant& grant, Database::TrackId trackId, std::chrono::seconds lifetime);
+
+			// std::nullopt if expired or not issued for this track
+			std::optional<Grant> findGrant(std::string_view token, Database::TrackId trackId);
+
+		private:
+			struct Entry
+			{
+				Grant									grant;
+				Database::TrackId						trackId;
+				std::chrono::steady_clock::time_point	expiry;
+			};
+
+			// _mutex must be held
+			void purgeExpiredTokens(std::chrono::steady_clock::time_point now);
+
+			std::mutex								_mutex;
+			std::unordered_map<std::string, Entry>	_entries;
+			std::chrono::steady_clock::time_point	_nextPurge {};
+	};
+}
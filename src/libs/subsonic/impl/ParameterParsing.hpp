@@ -18,6 +18,12 @@
  */
 #pragma once
 
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
 #include <Wt/Http/Request.h>
 
 #include "services/database/Types.hpp"
@@ -26,6 +32,16 @@
 
 namespace API::Subsonic
 {
+	// std::string_view values refer to the parameter map, no copy is made
+	template<typename T>
+	std::optional<T>
+	readParameterAs(const std::string& value)
+	{
+		if constexpr (std::is_same_v<T, std::string_view>)
+			return std::string_view {value};
+		else
+			return StringUtils::readAs<T>(value);
+	}
 
 	template<typename T>
 	std::vector<T>
@@ -37,9 +53,10 @@ namespace API::Subsonic
 		if (it == parameterMap.end())
 			return res;
 
+		res.reserve(it->second.size());
 		for (const std::string& param : it->second)
 		{
-			auto value {StringUtils::readAs<T>(param)};
+			auto value {readParameterAs<T>(param)};
 			if (value)
 				res.emplace_back(std::move(*value));
 		}
@@ -62,8 +79,16 @@ namespace API::Subsonic
 	std::optional<T>
 	getParameterAs(const Wt::Http::ParameterMap& parameterMap, const std::string& param)
 	{
-		std::vector<T> params {getMultiParametersAs<T>(parameterMap, param)};
+		// Most parameters have a single value: no need to build the value list
+		auto it = parameterMap.find(param);
+		if (it == parameterMap.end())
+			return std::nullopt;
 
+		if (it->second.size() == 1)
+			return readParameterAs<T>(it->second.front());
+
+		// Only one of the values must be valid
+		std::vector<T> params {getMultiParametersAs<T>(parameterMap, param)};
 		if (params.size() != 1)
 			return std::nullopt;
 
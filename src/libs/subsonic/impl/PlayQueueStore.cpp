@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PlayQueueStore.hpp"
+
+#include <algorithm>
+
+#include "services/database/Db.hpp"
+#include "services/database/PlayQueue.hpp"
+#include "services/database/Session.hpp"
+#include "services/database/Track.hpp"
+#include "services/database/TrackList.hpp"
+#include "services/database/User.hpp"
+#include "utils/Logger.hpp"
+
+namespace API::Subsonic
+{
+	namespace
+	{
+		const std::string playQueueTrackListName {"__subsonic_playqueue__"};
+	}
+
+	PlayQueueStore::PlayQueueStore(Database::Db& db, std::chrono::seconds flushPeriod)
+		: _db {db}
+		, _flushPeriod {flushPeriod}
+	{
+		LMS_LOG(API_SUBSONIC, INFO) << "Play queue flush period = " << _flushPeriod.count() << "s";
+
+		_ioService.setThreadCount(1);
+		_ioService.start();
+	}
+
+	PlayQueueStore::~PlayQueueStore()
+	{
+		{
+			std::scoped_lock lock {_mutex};
+			_flushTimer.cancel();
+		}
+		_ioService.stop();
+
+		flush();
+	}
+
+	std::optional<PlayQueueStore::PlayQueue>
+	PlayQueueStore::get(Database::UserId userId)
+	{
+		{
+			std::scoped_lock lock {_mutex};
+
+			auto it {_playQueues.find(userId)};
+			if (it != std::cend(_playQueues))
+				return it->second;
+		}
+
+		std::optional<PlayQueue> playQueue {load(userId)};
+
+		std::scoped_lock lock {_mutex};
+
+		// may have been saved in the meantime
+		auto [it, inserted] {_playQueues.try_emplace(userId, std::move(playQueue))};
+		return it->second;
+	}
+
+	void
+	PlayQueueStore::save(Database::UserId userId, PlayQueue playQueue)
+	{
+		std::scoped_lock lock {_mutex};
+
+		_playQueues[userId] = std::move(playQueue);
+		_dirtyUserIds.insert(userId);
+		scheduleFlush();
+	}
+
+	std::optional<PlayQueueStore::PlayQueue>
+	PlayQueueStore::load(Database::UserId userId)
+	{
+		Database::Session& session {_db.getTLSSession()};
+		auto transaction {session.createSharedTransaction()};
+
+		const Database::PlayQueue::pointer dbPlayQueue {Database::PlayQueue::find(session, userId)};
+		if (!dbPlayQueue)
+			return std::nullopt;
+
+		PlayQueue playQueue;
+		playQueue.trackIds = dbPlayQueue->getTrackList()->getTrackIds();
+		playQueue.currentIndex = dbPlayQueue->getCurrentIndex();
+		playQueue.currentPositionInTrack = dbPlayQueue->getCurrentPositionInTrack();
+		playQueue.lastModifiedDateTime = dbPlayQueue->getLastModifiedDateTime();
+		playQueue.changedBy = dbPlayQueue->getChangedBy();
+
+		return playQueue;
+	}
+
+	void
+	PlayQueueStore::scheduleFlush()
+	{
+		// must be called locked
+		if (_flushScheduled)
+			return;
+
+		_flushScheduled = true;
+		_flushTimer.expires_after(_flushPeriod);
+		_flushTimer.async_wait([this](const boost::system::error_code& ec)
+		{
+			if (ec)
+				return;
+
+			flush();
+		});
+	}
+
+	void
+	PlayQueueStore::flush()
+	{
+		std::unordered_set<Database::UserId> dirtyUserIds;
+		std::vector<std::pair<Database::UserId, std::optional<PlayQueue>>> playQueues;
+		{
+			std::scoped_lock lock {_mutex};
+
+			dirtyUserIds.swap(_dirtyUserIds);
+			for (const Database::UserId userId : dirtyUserIds)
+				playQueues.emplace_back(userId, _playQueues[userId]);
+
+			_flushScheduled = false;
+		}
+
+		if (playQueues.empty())
+			return;
+
+		LMS_LOG(API_SUBSONIC, DEBUG) << "Flushing " << playQueues.size() << " play queue(s)";
+
+		try
+		{
+			Database::Session& session {_db.getTLSSession()};
+			auto transaction {session.createUniqueTransaction()};
+
+			for (const auto& [userId, playQueue] : playQueues)
+			{
+				if (!playQueue)
+					continue;
+
+				const Database::User::pointer user {Database::User::find(session, userId)};
+				if (!user)
+					continue;
+
+				Database::PlayQueue::pointer dbPlayQueue {Database::PlayQueue::find(session, userId)};
+				if (!dbPlayQueue)
+				{
+					const Database::TrackList::pointer trackList {Database::TrackList::create(session, playQueueTrackListName, Database::TrackList::Type::Internal, false, user)};
+					dbPlayQueue = Database::PlayQueue::create(session, user, trackList);
+				}
+
+				Database::TrackList::pointer trackList {dbPlayQueue->getTrackList()};
+				trackList.modify()->clear();
+
+				// tracks may have been removed since the queue was saved
+				std::size_t currentIndex {playQueue->currentIndex};
+				std::size_t index {};
+				for (const Database::TrackId trackId : playQueue->trackIds)
+				{
+					const Database::Track::pointer track {Database::Track::find(session, trackId)};
+					if (track)
+						Database::TrackListEntry::create(session, track, trackList);
+					else if (index < playQueue->currentIndex)
+						currentIndex--;
+
+					index++;
+				}
+
+				dbPlayQueue.modify()->setCurrentIndex(currentIndex);
+				dbPlayQueue.modify()->setCurrentPositionInTrack(playQueue->currentPositionInTrack);
+				dbPlayQueue.modify()->setLastModifiedDateTime(playQueue->lastModifiedDateTime);
+				dbPlayQueue.modify()->setChangedBy(playQueue->changedBy);
+			}
+		}
+		catch (const std::exception& e)
+		{
+			LMS_LOG(API_SUBSONIC, ERROR) << "Cannot flush play queues: " << e.what();
+
+			// Retried at the next flush, along with the queues saved in the meantime
+			std::scoped_lock lock {_mutex};
+			_dirtyUserIds.insert(std::cbegin(dirtyUserIds), std::cend(dirtyUserIds));
+			scheduleFlush();
+		}
+	}
+} // namespace API::Subsonic
+
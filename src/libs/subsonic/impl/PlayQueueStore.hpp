@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/asio/steady_timer.hpp>
+#include <Wt/WDateTime.h>
+#include <Wt/WIOService.h>
+
+#include "services/database/TrackId.hpp"
+#include "services/database/UserId.hpp"
+
+namespace Database
+{
+	class Db;
+}
+
+namespace API::Subsonic
+{
+	// Per user play queues, kept in memory and persisted asynchronously
+	// Clients save their queue very often (track change, seek, ...): consecutive saves are coalesced
+	class PlayQueueStore
+	{
+		public:
+			struct PlayQueue
+			{
+				std::vector<Database::TrackId>	trackIds;
+				std::size_t						currentIndex {};
+				std::chrono::milliseconds		currentPositionInTrack {};
+				Wt::WDateTime					lastModifiedDateTime;
+				std::string						changedBy;
+			};
+
+			PlayQueueStore(Database::Db& db, std::chrono::seconds flushPeriod);
+			~PlayQueueStore();	// pending changes are flushed
+
+			PlayQueueStore(const PlayQueueStore&) = delete;
+			PlayQueueStore(PlayQueueStore&&) = delete;
+			PlayQueueStore& operator=(const PlayQueueStore&) = delete;
+			PlayQueueStore& operator=(PlayQueueStore&&) = delete;
+
+			// Loaded from the database on first access
+			std::optional<PlayQueue>	get(Database::UserId userId);
+			// Never waits for the database write lock
+			void						save(Database::UserId userId, PlayQueue playQueue);
+
+		private:
+			std::optional<PlayQueue> load(Database::UserId userId);
+			void scheduleFlush();
+			void flush();
+
+			Database::Db&				_db;
+			const std::chrono::seconds	_flushPeriod;
+			Wt::WIOService				_ioService;
+			boost::asio::steady_timer	_flushTimer {_ioService};
+
+			std::mutex		_mutex;
+			std::unordered_map<Database::UserId, std::optional<PlayQueue>>	_playQueues;	// not set if the user has no play queue
+			std::unordered_set<Database::UserId>	_dirtyUserIds;
+			bool			_flushScheduled {};
+	};
+} // namespace API::Subsonic
+
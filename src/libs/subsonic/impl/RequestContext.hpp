@@ -26,6 +26,7 @@
 #include "services/database/UserId.hpp"
 #include "ClientInfo.hpp"
 #include "ProtocolVersion.hpp"
+#include "SubsonicResponse.hpp"
 
 namespace Database
 {
@@ -34,6 +35,12 @@ namespace Database
 
 namespace API::Subsonic
 {
+	class ArtistIndexCache;
+	class EntityNodeCache;
+	class HlsTokenStore;
+	class PlayQueueStore;
+	class Shuffler;
+
 	struct RequestContext
 	{
 		const Wt::Http::ParameterMap& parameters;
@@ -41,6 +48,12 @@ namespace API::Subsonic
 		Database::UserId userId;
 		ClientInfo clientInfo;
 		ProtocolVersion serverProtocolVersion;
+		ResponseFormat responseFormat;
+		PlayQueueStore& playQueueStore;
+		ArtistIndexCache& artistIndexCache;
+		Shuffler& shuffler;
+		EntityNodeCache& entityNodeCache;
+		HlsTokenStore& hlsTokenStore;
 	};
 }
 
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResponseCache.hpp"
+
+#include <mutex>
+
+#include "utils/Logger.hpp"
+#include "utils/Random.hpp"
+
+namespace API::Subsonic
+{
+	ResponseCache::ResponseCache(std::size_t maxSize, std::chrono::seconds maxAge)
+		: _maxSize {maxSize}
+		, _maxAge {maxAge}
+	{
+		LMS_LOG(API_SUBSONIC, INFO) << "Response cache: max size = " << _maxSize << ", max age = " << _maxAge.count() << "s";
+	}
+
+	std::shared_ptr<const ResponseCache::Entry>
+	ResponseCache::get(const std::string& key, const Version& version)
+	{
+		std::shared_lock lock {_mutex};
+
+		auto it {_entries.find(key)};
+		if (it == std::cend(_entries)
+				|| !(it->second.version == version)
+				|| std::chrono::steady_clock::now() - it->second.creationTime > _maxAge)
+		{
+			++_misses;
+			return nullptr;
+		}
+
+		++_hits;
+		return it->second.entry;
+	}
+
+	void
+	ResponseCache::put(const std::string& key, const Version& version, std::shared_ptr<const Entry> entry)
+	{
+		const std::size_t entrySize {getEntrySize(key, *entry)};
+		if (entrySize > _maxSize)
+			return;
+
+		std::unique_lock lock {_mutex};
+
+		if (auto it {_entries.find(key)}; it != std::end(_entries))
+		{
+			_size -= getEntrySize(it->first, *it->second.entry);
+			_entries.erase(it);
+		}
+
+		while (_size + entrySize > _maxSize && !_entries.empty())
+		{
+			auto itRandom {Random::pickRandom(_entries)};
+			_size -= getEntrySize(itRandom->first, *itRandom->second.entry);
+			_entries.erase(itRandom);
+		}
+
+		_size += entrySize;
+		_entries.emplace(key, CachedEntry {version, std::chrono::steady_clock::now(), std::move(entry)});
+
+		LMS_LOG(API_SUBSONIC, DEBUG) << "Response cache: hits = " << _hits << ", misses = " << _misses << ", nb entries = " << _entries.size() << ", size = " << _size;
+	}
+
+	std::size_t
+	ResponseCache::getEntrySize(const std::string& key, const Entry& entry)
+	{
+		return key.size() + entry.mimeType.size() + entry.body.size() + entry.gzipBody.size() + (entry.entityTag ? entry.entityTag->size() : 0);
+	}
+} // namespace API::Subsonic
+
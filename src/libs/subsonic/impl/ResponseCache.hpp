@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace API::Subsonic
+{
+	// Size-bounded cache of serialized responses
+	class ResponseCache
+	{
+		public:
+			// Entries are considered as outdated as soon as the version changes
+			struct Version
+			{
+				std::size_t	libraryGeneration {};
+				std::size_t	starGeneration {};
+
+				bool operator==(const Version& other) const { return libraryGeneration == other.libraryGeneration && starGeneration == other.starGeneration; }
+			};
+
+			struct Entry
+			{
+				std::string					mimeType;
+				std::string					body;
+				std::string					gzipBody;	// empty if the body is not worth compressing
+				std::optional<std::string>	entityTag;
+			};
+
+			ResponseCache(std::size_t maxSize, std::chrono::seconds maxAge);
+
+			ResponseCache(const ResponseCache&) = delete;
+			ResponseCache(ResponseCache&&) = delete;
+			ResponseCache& operator=(const ResponseCache&) = delete;
+			ResponseCache& operator=(ResponseCache&&) = delete;
+
+			std::shared_ptr<const Entry>	get(const std::string& key, const Version& version);
+			void							put(const std::string& key, const Version& version, std::shared_ptr<const Entry> entry);
+
+		private:
+			struct CachedEntry
+			{
+				Version									version;
+				std::chrono::steady_clock::time_point	creationTime;
+				std::shared_ptr<const Entry>			entry;
+			};
+
+			static std::size_t getEntrySize(const std::string& key, const Entry& entry);
+
+			const std::size_t			_maxSize;
+			const std::chrono::seconds	_maxAge;
+
+			std::shared_mutex			_mutex;
+			std::unordered_map<std::string, CachedEntry>	_entries;
+			std::size_t					_size {};
+			std::atomic<std::size_t>	_hits {};
+			std::atomic<std::size_t>	_misses {};
+	};
+} // namespace API::Subsonic
+
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResponseCompression.hpp"
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <sstream>
+#include <vector>
+
+#include <zlib.h>
+
+#include "utils/Exception.hpp"
+#include "utils/String.hpp"
+
+namespace API::Subsonic
+{
+	namespace
+	{
+		constexpr std::size_t chunkSize {16 * 1024};
+		constexpr int gzipWindowBits {15 + 16};	// max window size, gzip header and trailer
+		constexpr int memLevel {8};
+
+		bool
+		isQValueZero(std::string_view parameter)
+		{
+			parameter = StringUtils::stringTrim(parameter);
+			if (parameter.size() < 2 || (parameter[0] != 'q' && parameter[0] != 'Q') || parameter[1] != '=')
+				return false;
+
+			const std::optional<double> qValue {StringUtils::readAs<double>(parameter.substr(2))};
+			return qValue && *qValue == 0;
+		}
+	}
+
+	bool
+	isGzipAccepted(std::string_view acceptEncodingHeader)
+	{
+		for (std::string_view coding : StringUtils::splitString(acceptEncodingHeader, ","))
+		{
+			const std::vector<std::string_view> parameters {StringUtils::splitString(coding, ";")};
+			if (parameters.empty())
+				continue;
+
+			const std::string name {StringUtils::stringToLower(StringUtils::stringTrim(parameters.front()))};
+			if (name != "gzip" && name != "*")
+				continue;
+
+			if (std::none_of(std::next(std::cbegin(parameters)), std::cend(parameters), isQValueZero))
+				return true;
+		}
+
+		return false;
+	}
+
+	void
+	writeGzip(std::string_view data, std::ostream& os)
+	{
+		z_stream stream {};
+		if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, gzipWindowBits, memLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+			throw LmsException {"Cannot init gzip compression"};
+
+		stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+		stream.avail_in = static_cast<uInt>(data.size());
+
+		std::array<char, chunkSize> chunk;
+		int res;
+		do
+		{
+			stream.next_out = reinterpret_cast<Bytef*>(chunk.data());
+			stream.avail_out = static_cast<uInt>(chunk.size());
+
+			res = deflate(&stream, Z_FINISH);
+			if (res == Z_STREAM_ERROR)
+			{
+				deflateEnd(&stream);
+				throw LmsException {"Gzip compression failed"};
+			}
+
+			os.write(chunk.data(), chunk.size() - stream.avail_out);
+		} while (res != Z_STREAM_END);
+
+		deflateEnd(&stream);
+	}
+
+	std::string
+	compressGzip(std::string_view data)
+	{
+		std::ostringstream oss;
+		writeGzip(data, oss);
+		return oss.str();
+	}
+} // namespace API::Subsonic
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace API::Subsonic
+{
+	// Whether the client accepts gzip encoded responses, given its HTTP Accept-Encoding header
+	bool isGzipAccepted(std::string_view acceptEncodingHeader);
+
+	// Compressed data is written to the stream by chunks, as soon as it is produced
+	void writeGzip(std::string_view data, std::ostream& os);
+	std::string compressGzip(std::string_view data);
+} // namespace API::Subsonic
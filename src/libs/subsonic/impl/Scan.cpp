@@ -19,6 +19,8 @@
 
 #include "Scan.hpp"
 
+#include <chrono>
+
 #include "services/scanner/IScannerService.hpp"
 #include "utils/Service.hpp"
 
@@ -45,6 +47,35 @@ namespace API::Subsonic::Scan
 			statusResponse.setAttribute("count", count);
 		}
 
+		// Not part of the Subsonic API: current library generation, to be used to get what has been added since
+		statusResponse.setAttribute("lmsLibraryGeneration", Service<IScannerService>::get()->getLibraryGeneration().value);
+
+		// Not part of the Subsonic API: metrics of the last complete scan
+		if (scanStatus.lastCompleteScanStats)
+		{
+			const ScanStats& stats {*scanStatus.lastCompleteScanStats};
+			Response::Node& lastScanNode {statusResponse.createChild("lmsLastScan")};
+
+			lastScanNode.setAttribute("durationMs", std::chrono::duration_cast<std::chrono::milliseconds>(stats.stopTime.toTimePoint() - stats.startTime.toTimePoint()).count());
+			lastScanNode.setAttribute("discoveryDurationMs", stats.getStepDuration(ScanProgressStep::DiscoveringFiles).count());
+			lastScanNode.setAttribute("missingFilesCheckDurationMs", stats.getStepDuration(ScanProgressStep::ChekingForMissingFiles).count());
+			lastScanNode.setAttribute("fileScanDurationMs", stats.getStepDuration(ScanProgressStep::ScanningFiles).count());
+			lastScanNode.setAttribute("orphanRemovalDurationMs", stats.getStepDuration(ScanProgressStep::RemovingOrphanEntries).count());
+			lastScanNode.setAttribute("duplicatesCheckDurationMs", stats.getStepDuration(ScanProgressStep::CheckingForDuplicates).count());
+			lastScanNode.setAttribute("featuresFetchDurationMs", stats.getStepDuration(ScanProgressStep::FetchingTrackFeatures).count());
+			lastScanNode.setAttribute("similarityEngineReloadDurationMs", stats.getStepDuration(ScanProgressStep::ReloadingSimilarityEngine).count());
+			lastScanNode.setAttribute("coverGenerationDurationMs", stats.getStepDuration(ScanProgressStep::GeneratingCovers).count());
+			lastScanNode.setAttribute("databaseSpaceReclaimDurationMs", stats.getStepDuration(ScanProgressStep::ReclaimingDatabaseSpace).count());
+			lastScanNode.setAttribute("reclaimedDatabaseBytes", stats.reclaimedDatabaseBytes);
+			lastScanNode.setAttribute("scannedFiles", stats.scans);
+			lastScanNode.setAttribute("scannedBytes", stats.bytesScanned);
+			lastScanNode.setAttribute("filesPerSecond", stats.getScanRate());
+			lastScanNode.setAttribute("parseP50Us", stats.parseDurations.getPercentile(50).count());
+			lastScanNode.setAttribute("parseP99Us", stats.parseDurations.getPercentile(99).count());
+			lastScanNode.setAttribute("writeP50Us", stats.writeDurations.getPercentile(50).count());
+			lastScanNode.setAttribute("writeP99Us", stats.writeDurations.getPercentile(99).count());
+		}
+
 		return statusResponse;
 	}
 
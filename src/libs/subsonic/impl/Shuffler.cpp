@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Shuffler.hpp"
+
+#include <algorithm>
+
+#include "services/database/Release.hpp"
+#include "services/database/Session.hpp"
+#include "services/database/Track.hpp"
+#include "utils/Random.hpp"
+
+namespace API::Subsonic
+{
+	namespace
+	{
+		std::uint64_t
+		createSeed()
+		{
+			Random::RandGenerator& generator {Random::getRandGenerator()};
+			return (static_cast<std::uint64_t>(generator()) << 32) | generator();
+		}
+	}
+
+	std::vector<Database::TrackId>
+	Shuffler::getNextTracks(Database::Session& session, Database::UserId userId, std::optional<Database::ClusterId> clusterId, std::size_t count, std::size_t libraryGeneration)
+	{
+		const std::scoped_lock lock {_mutex};
+
+		checkLibraryGeneration(libraryGeneration);
+
+		const Ids<Database::TrackId> trackIds {getTrackIds(session, clusterId)};
+
+		auto [itOrder, inserted] {_userTrackOrders.try_emplace({userId, clusterId})};
+		UserOrder& order {itOrder->second};
+		if (inserted || order.position >= trackIds->size())
+			order = UserOrder {createSeed(), 0};
+
+		const Random::Permutation permutation {trackIds->size(), order.seed};
+
+		std::vector<Database::TrackId> res;
+		res.reserve(std::min(count, trackIds->size() - order.position));
+		for (; res.size() < count && order.position < trackIds->size(); ++order.position)
+			res.push_back((*trackIds)[permutation[order.position]]);
+
+		return res;
+	}
+
+	std::vector<Database::ReleaseId>
+	Shuffler::getReleases(Database::Session& session, Database::UserId userId, Database::Range range, std::size_t libraryGeneration)
+	{
+		const std::scoped_lock lock {_mutex};
+
+		checkLibraryGeneration(libraryGeneration);
+
+		const Ids<Database::ReleaseId> releaseIds {getReleaseIds(session)};
+
+		auto [itOrder, inserted] {_userReleaseOrders.try_emplace(userId)};
+		UserOrder& order {itOrder->second};
+		if (inserted || range.offset == 0)
+			order = UserOrder {createSeed(), 0};
+
+		const Random::Permutation permutation {releaseIds->size(), order.seed};
+
+		std::vector<Database::ReleaseId> res;
+		for (std::size_t position {range.offset}; res.size() < range.size && position < releaseIds->size(); ++position)
+			res.push_back((*releaseIds)[permutation[position]]);
+
+		return res;
+	}
+
+	void
+	Shuffler::checkLibraryGeneration(std::size_t libraryGeneration)
+	{
+		if (libraryGeneration == _libraryGeneration)
+			return;
+
+		// orders are relative to the id lists
+		_libraryGeneration = libraryGeneration;
+		_trackIds.clear();
+		_releaseIds.reset();
+		_userTrackOrders.clear();
+		_userReleaseOrders.clear();
+	}
+
+	Shuffler::Ids<Database::TrackId>
+	Shuffler::getTrackIds(Database::Session& session, std::optional<Database::ClusterId> clusterId)
+	{
+		Ids<Database::TrackId>& trackIds {_trackIds[clusterId]};
+		if (!trackIds)
+		{
+			Database::Track::FindParameters params;
+			if (clusterId)
+				params.setClusters({*clusterId});
+
+			trackIds = std::make_shared<const std::vector<Database::TrackId>>(Database::Track::find(session, params).results);
+		}
+
+		return trackIds;
+	}
+
+	Shuffler::Ids<Database::ReleaseId>
+	Shuffler::getReleaseIds(Database::Session& session)
+	{
+		if (!_releaseIds)
+			_releaseIds = std::make_shared<const std::vector<Database::ReleaseId>>(Database::Release::find(session, Database::Release::FindParameters {}).results);
+
+		return _releaseIds;
+	}
+} // namespace API::Subsonic
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+#include "services/database/ClusterId.hpp"
+#include "services/database/ReleaseId.hpp"
+#include "services/database/TrackId.hpp"
+#include "services/database/Types.hpp"
+#include "services/database/UserId.hpp"
+
+namespace Database
+{
+	class Session;
+}
+
+namespace API::Subsonic
+{
+	// Per user random orders of the tracks and releases, served page by page without repeats
+	// Only a seed and a position are kept for each user: the orders are permutations of the id lists, computed once per library generation
+	class Shuffler
+	{
+		public:
+			Shuffler() = default;
+			Shuffler(const Shuffler&) = delete;
+			Shuffler& operator=(const Shuffler&) = delete;
+
+			// A shared transaction must be held
+			// Next tracks of the current random order of the user, a new order is started once all the tracks have been returned
+			std::vector<Database::TrackId>		getNextTracks(Database::Session& session, Database::UserId userId, std::optional<Database::ClusterId> clusterId, std::size_t count, std::size_t libraryGeneration);
+			// A new random order is started when range.offset is 0
+			std::vector<Database::ReleaseId>	getReleases(Database::Session& session, Database::UserId userId, Database::Range range, std::size_t libraryGeneration);
+
+		private:
+			template <typename IdType>
+			using Ids = std::shared_ptr<const std::vector<IdType>>;
+
+			struct UserOrder
+			{
+				std::uint64_t	seed {};
+				std::size_t		position {};
+			};
+
+			// _mutex must be held
+			void checkLibraryGeneration(std::size_t libraryGeneration);
+			Ids<Database::TrackId>		getTrackIds(Database::Session& session, std::optional<Database::ClusterId> clusterId);
+			Ids<Database::ReleaseId>	getReleaseIds(Database::Session& session);
+
+			std::mutex	_mutex;
+			std::size_t	_libraryGeneration {};
+			std::map<std::optional<Database::ClusterId>, Ids<Database::TrackId>>	_trackIds;
+			Ids<Database::ReleaseId>	_releaseIds;
+			std::map<std::tuple<Database::UserId, std::optional<Database::ClusterId>>, UserOrder>	_userTrackOrders;
+			std::map<Database::UserId, UserOrder>	_userReleaseOrders;
+	};
+} // namespace API::Subsonic
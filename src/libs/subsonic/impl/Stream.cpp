@@ -19,7 +19,15 @@
 
 #include "Stream.hpp"
 
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <iterator>
+
+#include <Wt/Utils.h>
+
 #include "av/TranscodeParameters.hpp"
+#include "av/TranscodeProfiles.hpp"
 #include "av/TranscodeResourceHandlerCreator.hpp"
 #include "av/Types.hpp"
 #include "services/database/Session.hpp"
@@ -28,7 +36,9 @@
 #include "utils/IResourceHandler.hpp"
 #include "utils/Logger.hpp"
 #include "utils/FileResourceHandlerCreator.hpp"
+#include "utils/Tracing.hpp"
 #include "utils/Utils.hpp"
+#include "HlsTokenStore.hpp"
 #include "ParameterParsing.hpp"
 #include "SubsonicId.hpp"
 
@@ -52,10 +62,37 @@ userTranscodeFormatToAvFormat(AudioFormat format)
 	}
 }
 
+enum class TranscodeBypass
+{
+	None,		// full transcode
+	Remux,		// the audio stream already fits, only the container differs
+	Direct,		// the file can be served as it is
+};
+
+static
+TranscodeBypass
+getTranscodeBypass(AudioCodec sourceCodec, std::size_t sourceBitrate, const Av::TranscodeParameters& transcodeParameters)
+{
+	// Re-encoding a stream to a higher bitrate does not give a better quality
+	if (sourceBitrate == 0 || sourceBitrate > transcodeParameters.bitrate)
+		return TranscodeBypass::None;
+
+	switch (transcodeParameters.format)
+	{
+		case Av::Format::MP3:			return sourceCodec == AudioCodec::MP3 ? TranscodeBypass::Direct : TranscodeBypass::None;
+		case Av::Format::OGG_OPUS:		return sourceCodec == AudioCodec::Opus ? TranscodeBypass::Direct : TranscodeBypass::None;
+		case Av::Format::MATROSKA_OPUS:	return sourceCodec == AudioCodec::Opus ? TranscodeBypass::Remux : TranscodeBypass::None;
+		case Av::Format::OGG_VORBIS:	return sourceCodec == AudioCodec::Vorbis ? TranscodeBypass::Direct : TranscodeBypass::None;
+		case Av::Format::WEBM_VORBIS:	return sourceCodec == AudioCodec::Vorbis ? TranscodeBypass::Remux : TranscodeBypass::None;
+		default:						return TranscodeBypass::None;
+	}
+}
+
 struct StreamParameters
 {
 	std::filesystem::path trackPath;
 	std::optional<Av::TranscodeParameters> transcodeParameters;
+	Av::TranscodeRequestInfo transcodeRequestInfo;
 };
 
 static
@@ -68,17 +105,27 @@ getStreamParameters(RequestContext& context)
 	// Optional params
 	std::optional<std::size_t> maxBitRate {getParameterAs<std::size_t>(context.parameters, "maxBitRate")};
 	std::optional<std::string> format {getParameterAs<std::string>(context.parameters, "format")};
+	// Clients caching tracks for offline use usually want the content length to be estimated
+	const bool estimateContentLength {getParameterAs<bool>(context.parameters, "estimateContentLength").value_or(false)};
 
 	StreamParameters parameters;
+	parameters.transcodeRequestInfo.clientId = context.userId.toString();
+	parameters.transcodeRequestInfo.priority = estimateContentLength ? Av::TranscodePriority::Prefetch : Av::TranscodePriority::Interactive;
 
 	auto transaction {context.dbSession.createSharedTransaction()};
 
+	std::size_t sourceBitrate {};
+	AudioCodec sourceCodec {AudioCodec::Unknown};
 	{
 		auto track {Track::find(context.dbSession, id)};
 		if (!track)
 			throw RequestedDataNotFoundError {};
 
 		parameters.trackPath = track->getPath();
+		sourceBitrate = track->getBitrate();
+		sourceCodec = track->getAudioCodec();
+		if (estimateContentLength)
+			parameters.transcodeRequestInfo.trackDuration = track->getDuration();
 	}
 
 	{
@@ -102,6 +149,28 @@ getStreamParameters(RequestContext& context)
 			transcodeParameters.format = userTranscodeFormatToAvFormat(user->getSubsonicTranscodeFormat());
 			transcodeParameters.stripMetadata = false; // We want clients to use metadata (offline use, replay gain, etc.)
 
+			if (const Av::TranscodeProfile* profile {Av::findTranscodeProfile(user->getLoginName(), context.clientInfo.name)})
+			{
+				LMS_LOG(API_SUBSONIC, DEBUG) << "Using transcode profile '" << profile->name << "'";
+				Av::applyTranscodeProfile(*profile, transcodeParameters);
+			}
+
+			switch (getTranscodeBypass(sourceCodec, sourceBitrate, transcodeParameters))
+			{
+				case TranscodeBypass::Direct:
+					LMS_LOG(API_SUBSONIC, DEBUG) << "Source already fits the transcode parameters, serving the file directly";
+					return parameters;
+
+				case TranscodeBypass::Remux:
+					LMS_LOG(API_SUBSONIC, DEBUG) << "Source codec already fits the transcode parameters, remuxing only";
+					transcodeParameters.copyAudio = true;
+					transcodeParameters.bitrate = sourceBitrate; // used to estimate the content length
+					break;
+
+				case TranscodeBypass::None:
+					break;
+			}
+
 			parameters.transcodeParameters = std::move(transcodeParameters);
 		}
 	}
@@ -131,7 +200,7 @@ handleDownload(RequestContext& context, const Wt::Http::Request& request, Wt::Ht
 			trackPath = track->getPath();
 		}
 
-		resourceHandler = createFileResourceHandler(trackPath);
+		resourceHandler = createOffloadableFileResourceHandler(trackPath, EgressScheduler::TransferInfo {EgressScheduler::TrafficClass::Bulk, context.userId.toString()});
 	}
 	else
 	{
@@ -153,11 +222,191 @@ handleStream(RequestContext& context, const Wt::Http::Request& request, Wt::Http
 		Wt::Http::ResponseContinuation* continuation = request.continuation();
 		if (!continuation)
 		{
+			const Tracing::ScopedSpan span {"stream.setup"};
+
 			StreamParameters streamParameters {getStreamParameters(context)};
 			if (streamParameters.transcodeParameters)
-				resourceHandler = Av::createTranscodeResourceHandler(streamParameters.trackPath, *streamParameters.transcodeParameters);
+				resourceHandler = Av::createTranscodeResourceHandler(streamParameters.trackPath, *streamParameters.transcodeParameters, streamParameters.transcodeRequestInfo);
 			else
-				resourceHandler = createFileResourceHandler(streamParameters.trackPath);
+			{
+				const EgressScheduler::TrafficClass trafficClass {streamParameters.transcodeRequestInfo.priority == Av::TranscodePriority::Prefetch ? EgressScheduler::TrafficClass::Bulk : EgressScheduler::TrafficClass::Interactive};
+				resourceHandler = createOffloadableFileResourceHandler(streamParameters.trackPath, EgressScheduler::TransferInfo {trafficClass, streamParameters.transcodeRequestInfo.clientId});
+			}
+		}
+		else
+		{
+			resourceHandler = Wt::cpp17::any_cast<std::shared_ptr<IResourceHandler>>(continuation->data());
+		}
+
+		continuation = resourceHandler->processRequest(request, response);
+		if (continuation)
+			continuation->setData(resourceHandler);
+	}
+	catch (const Av::Exception& e)
+	{
+		LMS_LOG(API_SUBSONIC, ERROR) << "Caught Av exception: " << e.what();
+	}
+}
+
+// Segments are transcoded on demand (and cached), using mp3 in MPEG-TS so that each segment carries the timestamps of its position in the track
+static constexpr std::chrono::seconds hlsSegmentDuration {10};
+static constexpr std::array<std::size_t, 4> hlsDefaultBitRates {64, 128, 192, 320};
+// Playlists and segments must remain fetchable during the whole playback of the track
+static constexpr std::chrono::minutes hlsTokenExtraLifetime {30};
+
+// Playlists and segments are fetched using a token only valid for this track, the credentials are never put in the playlists
+static
+std::string
+getHlsTokenQueryString(RequestContext& context, TrackId trackId, std::chrono::milliseconds duration)
+{
+	// Media playlists are fetched using the token of the variant playlist
+	std::optional<std::string> token {getParameterAs<std::string>(context.parameters, "hlsToken")};
+	if (!token)
+	{
+		HlsTokenStore::Grant grant {context.userId, context.clientInfo};
+		token = context.hlsTokenStore.createToken(grant, trackId, std::chrono::duration_cast<std::chrono::seconds>(duration) + hlsTokenExtraLifetime);
+	}
+
+	return "&hlsToken=" + Wt::Utils::urlEncode(*token);
+}
+
+static
+std::size_t
+getUserMaxBitRate(RequestContext& context)
+{
+	const User::pointer user {User::find(context.dbSession, context.userId)};
+	if (!user)
+		throw UserNotAuthorizedError {};
+
+	return user->getSubsonicTranscodeBitrate() / 1000;
+}
+
+void
+handleHls(RequestContext& context, const Wt::Http::Request& /*request*/, Wt::Http::Response& response)
+{
+	// Mandatory params
+	const TrackId id {getMandatoryParameterAs<TrackId>(context.parameters, "id")};
+
+	// Optional params
+	std::vector<std::size_t> bitRates {getMultiParametersAs<std::size_t>(context.parameters, "bitRate")};
+
+	std::chrono::milliseconds duration;
+	std::size_t maxBitRate;
+	{
+		auto transaction {context.dbSession.createSharedTransaction()};
+
+		auto track {Track::find(context.dbSession, id)};
+		if (!track)
+			throw RequestedDataNotFoundError {};
+
+		duration = track->getDuration();
+		maxBitRate = getUserMaxBitRate(context);
+	}
+
+	for (std::size_t& bitRate : bitRates)
+		bitRate = Utils::clamp(bitRate, std::size_t {48}, maxBitRate);
+
+	// No bitrate set => variant playlist of the default renditions
+	if (bitRates.empty())
+	{
+		std::copy_if(std::cbegin(hlsDefaultBitRates), std::cend(hlsDefaultBitRates), std::back_inserter(bitRates), [=](std::size_t bitRate) { return bitRate <= maxBitRate; });
+		if (bitRates.empty())
+			bitRates.push_back(maxBitRate);
+	}
+
+	std::sort(std::begin(bitRates), std::end(bitRates));
+	bitRates.erase(std::unique(std::begin(bitRates), std::end(bitRates)), std::end(bitRates));
+
+	const std::string trackId {idToString(id)};
+	const std::string authQueryString {getHlsTokenQueryString(context, id, duration)};
+
+	std::ostream& os {response.out()};
+	os << "#EXTM3U\n";
+
+	if (bitRates.size() > 1)
+	{
+		for (const std::size_t bitRate : bitRates)
+		{
+			os << "#EXT-X-STREAM-INF:BANDWIDTH=" << bitRate * 1000 << ",CODECS=\"mp4a.40.34\"\n";
+			os << "hls.m3u8?id=" << trackId << "&bitRate=" << bitRate << authQueryString << "\n";
+		}
+	}
+	else
+	{
+		os << "#EXT-X-VERSION:3\n";
+		os << "#EXT-X-TARGETDURATION:" << hlsSegmentDuration.count() << "\n";
+		os << "#EXT-X-MEDIA-SEQUENCE:0\n";
+		os << "#EXT-X-PLAYLIST-TYPE:VOD\n";
+
+		std::size_t index {};
+		for (std::chrono::milliseconds offset {}; offset < duration; offset += hlsSegmentDuration, ++index)
+		{
+			const std::chrono::milliseconds segmentDuration {std::min<std::chrono::milliseconds>(hlsSegmentDuration, duration - offset)};
+
+			os << "#EXTINF:" << std::fixed << std::setprecision(3) << (segmentDuration.count() / float {1000}) << ",\n";
+			os << "hlsSegment?id=" << trackId << "&bitRate=" << bitRates.front() << "&index=" << index << authQueryString << "\n";
+		}
+
+		os << "#EXT-X-ENDLIST\n";
+	}
+
+	response.setMimeType("application/vnd.apple.mpegurl");
+}
+
+void
+handleHlsSegment(RequestContext& context, const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+	std::shared_ptr<IResourceHandler> resourceHandler;
+
+	try
+	{
+		Wt::Http::ResponseContinuation* continuation {request.continuation()};
+		if (!continuation)
+		{
+			// Mandatory params
+			const TrackId id {getMandatoryParameterAs<TrackId>(context.parameters, "id")};
+			const std::size_t bitRate {getMandatoryParameterAs<std::size_t>(context.parameters, "bitRate")};
+			const std::size_t index {getMandatoryParameterAs<std::size_t>(context.parameters, "index")};
+
+			std::filesystem::path trackPath;
+			std::chrono::milliseconds duration;
+			std::size_t maxBitRate;
+			const Av::TranscodeProfile* transcodeProfile {};
+			{
+				auto transaction {context.dbSession.createSharedTransaction()};
+
+				auto track {Track::find(context.dbSession, id)};
+				if (!track)
+					throw RequestedDataNotFoundError {};
+
+				trackPath = track->getPath();
+				duration = track->getDuration();
+				maxBitRate = getUserMaxBitRate(context);
+
+				const User::pointer user {User::find(context.dbSession, context.userId)};
+				transcodeProfile = user ? Av::findTranscodeProfile(user->getLoginName(), context.clientInfo.name) : nullptr;
+			}
+
+			const std::chrono::milliseconds offset {static_cast<std::chrono::milliseconds::rep>(index) * hlsSegmentDuration};
+			if (offset >= duration)
+				throw RequestedDataNotFoundError {};
+
+			Av::TranscodeParameters transcodeParameters;
+			transcodeParameters.format = Av::Format::MPEGTS_MP3;
+			transcodeParameters.bitrate = Utils::clamp(bitRate, std::size_t {48}, maxBitRate) * 1000;
+			transcodeParameters.offset = offset;
+			transcodeParameters.duration = std::min<std::chrono::milliseconds>(hlsSegmentDuration, duration - offset);
+			transcodeParameters.stripMetadata = true;
+			if (transcodeProfile)
+			{
+				Av::applyTranscodeProfile(*transcodeProfile, transcodeParameters);
+				transcodeParameters.format = Av::Format::MPEGTS_MP3; // segments must stay in the playlist format
+			}
+
+			Av::TranscodeRequestInfo transcodeRequestInfo;
+			transcodeRequestInfo.clientId = context.userId.toString();
+
+			resourceHandler = Av::createTranscodeResourceHandler(trackPath, transcodeParameters, transcodeRequestInfo);
 		}
 		else
 		{
@@ -28,5 +28,9 @@ namespace API::Subsonic::Stream
 {
 	void handleDownload(RequestContext& context, const Wt::Http::Request& request, Wt::Http::Response& response);
 	void handleStream(RequestContext& context, const Wt::Http::Request& request, Wt::Http::Response& response);
+
+	// HTTP live streaming: variant/media playlists and transcoded segments
+	void handleHls(RequestContext& context, const Wt::Http::Request& request, Wt::Http::Response& response);
+	void handleHlsSegment(RequestContext& context, const Wt::Http::Request& request, Wt::Http::Response& response);
 }
 
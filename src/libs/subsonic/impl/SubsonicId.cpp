@@ -32,6 +32,12 @@ namespace API::Subsonic
 		return "ar-" + id.toString();
 	}
 
+	std::string
+	idToString(Database::DirectoryId id)
+	{
+		return "dir-" + id.toString();
+	}
+
 	std::string
 	idToString(Database::ReleaseId id)
 	{
@@ -59,38 +65,42 @@ namespace API::Subsonic
 
 namespace StringUtils
 {
-	template<>
-	std::optional<Database::ArtistId>
-	readAs(std::string_view str)
+	namespace
 	{
-		std::vector<std::string_view> values {StringUtils::splitString(str, "-")};
-		if (values.size() != 2)
-			return std::nullopt;
+		// "<prefix><value>", parsed in place
+		template <typename IdType>
+		std::optional<IdType>
+		readIdAs(std::string_view str, std::string_view prefix)
+		{
+			if (str.substr(0, prefix.size()) != prefix)
+				return std::nullopt;
+
+			if (const auto value {StringUtils::readAs<typename IdType::ValueType>(str.substr(prefix.size()))})
+				return IdType {*value};
 
-		if (values[0] != "ar")
 			return std::nullopt;
+		}
+	}
 
-		if (const auto value {StringUtils::readAs<Database::ArtistId::ValueType>(values[1])})
-			return Database::ArtistId {*value};
+	template<>
+	std::optional<Database::ArtistId>
+	readAs(std::string_view str)
+	{
+		return readIdAs<Database::ArtistId>(str, "ar-");
+	}
 
-		return std::nullopt;
+	template<>
+	std::optional<Database::DirectoryId>
+	readAs(std::string_view str)
+	{
+		return readIdAs<Database::DirectoryId>(str, "dir-");
 	}
 
 	template<>
 	std::optional<Database::ReleaseId>
 	readAs(std::string_view str)
 	{
-		std::vector<std::string_view> values {StringUtils::splitString(str, "-")};
-		if (values.size() != 2)
-			return std::nullopt;
-
-		if (values[0] != "al")
-			return std::nullopt;
-
-		if (const auto value {StringUtils::readAs<Database::ReleaseId::ValueType>(values[1])})
-			return Database::ReleaseId {*value};
-
-		return std::nullopt;
+		return readIdAs<Database::ReleaseId>(str, "al-");
 	}
 
 	template<>
@@ -107,34 +117,14 @@ namespace StringUtils
 	std::optional<Database::TrackId>
 	readAs(std::string_view str)
 	{
-		std::vector<std::string_view> values {StringUtils::splitString(str, "-")};
-		if (values.size() != 2)
-			return std::nullopt;
-
-		if (values[0] != "tr")
-			return std::nullopt;
-
-		if (const auto value {StringUtils::readAs<Database::TrackId::ValueType>(values[1])})
-			return Database::TrackId {*value};
-
-		return std::nullopt;
+		return readIdAs<Database::TrackId>(str, "tr-");
 	}
 
 	template<>
 	std::optional<Database::TrackListId>
 	readAs(std::string_view str)
 	{
-		std::vector<std::string_view> values {StringUtils::splitString(str, "-")};
-		if (values.size() != 2)
-			return std::nullopt;
-
-		if (values[0] != "pl")
-			return std::nullopt;
-
-		if (const auto value {StringUtils::readAs<Database::TrackListId::ValueType>(values[1])})
-			return Database::TrackListId {*value};
-
-		return std::nullopt;
+		return readIdAs<Database::TrackListId>(str, "pl-");
 	}
 
 	template<>
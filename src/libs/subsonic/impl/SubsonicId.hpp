@@ -20,6 +20,7 @@
 #pragma once
 
 #include "services/database/ArtistId.hpp"
+#include "services/database/DirectoryId.hpp"
 #include "services/database/ReleaseId.hpp"
 #include "services/database/TrackId.hpp"
 #include "services/database/TrackListId.hpp"
@@ -30,6 +31,7 @@ namespace API::Subsonic
 	struct RootId {};
 
 	std::string			idToString(Database::ArtistId id);
+	std::string			idToString(Database::DirectoryId id);
 	std::string			idToString(Database::ReleaseId id);
 	std::string			idToString(Database::TrackId id);
 	std::string			idToString(Database::TrackListId id);
@@ -47,6 +49,10 @@ namespace StringUtils
 	std::optional<Database::ArtistId>
 	readAs(std::string_view str);
 
+	template<>
+	std::optional<Database::DirectoryId>
+	readAs(std::string_view str);
+
 	template<>
 	std::optional<Database::ReleaseId>
 	readAs(std::string_view str);
@@ -19,36 +19,56 @@
 
 #include "SubsonicResource.hpp"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <ctime>
+#include <functional>
 #include <iomanip>
+#include <map>
+#include <optional>
+#include <sstream>
 #include <unordered_map>
+#include <unordered_set>
 
+#include <boost/asio/post.hpp>
 #include <Wt/WLocalDateTime.h>
+#include <Wt/Http/ResponseContinuation.h>
 
 #include "services/auth/IPasswordService.hpp"
 #include "services/auth/IEnvService.hpp"
 #include "services/database/Artist.hpp"
 #include "services/database/Cluster.hpp"
+#include "services/database/ClusterCatalog.hpp"
 #include "services/database/Db.hpp"
+#include "services/database/Directory.hpp"
 #include "services/database/Release.hpp"
 #include "services/database/Session.hpp"
+#include "services/database/StarredArtist.hpp"
+#include "services/database/StarredRelease.hpp"
+#include "services/database/StarredTrack.hpp"
 #include "services/database/Track.hpp"
 #include "services/database/TrackBookmark.hpp"
 #include "services/database/TrackList.hpp"
 #include "services/database/User.hpp"
 #include "services/recommendation/IRecommendationService.hpp"
+#include "services/scanner/IScannerService.hpp"
 #include "services/scrobbling/IScrobblingService.hpp"
 #include "services/cover/ICoverService.hpp"
 #include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Profiling.hpp"
 #include "utils/Random.hpp"
 #include "utils/Service.hpp"
 #include "utils/String.hpp"
+#include "utils/Tracing.hpp"
 #include "utils/Utils.hpp"
 #include "ParameterParsing.hpp"
+#include "PlayQueueStore.hpp"
 #include "ProtocolVersion.hpp"
 #include "RequestContext.hpp"
+#include "ResponseCompression.hpp"
 #include "Scan.hpp"
 #include "Stream.hpp"
 #include "SubsonicId.hpp"
@@ -59,7 +79,6 @@ using namespace Database;
 static const std::string	genreClusterName {"GENRE"};
 static const std::string	reportedStarredDate {"2000-01-01T00:00:00"};
 static const std::string	reportedDummyDate {"2000-01-01T00:00:00"};
-static const unsigned long long	reportedDummyDateULong {946684800000ULL}; // 2000-01-01T00:00:00 UTC
 
 
 
@@ -123,7 +142,27 @@ readConfigProtocolVersions()
 SubsonicResource::SubsonicResource(Db& db)
 : _serverProtocolVersionsByClient {readConfigProtocolVersions()}
 , _db {db}
+, _responseCache {Service<IConfig>::get()->getULong("api-subsonic-response-cache-size", 10) * 1000 * 1000,
+					std::chrono::seconds {Service<IConfig>::get()->getULong("api-subsonic-response-cache-max-age", 300)}}
+, _playQueueStore {db, std::chrono::seconds {Service<IConfig>::get()->getULong("api-subsonic-playqueue-flush-period", 30)}}
+, _entityNodeCache {Service<IConfig>::get()->getULong("api-subsonic-entity-node-cache-size", 20000)}
+, _tracingSettings {std::chrono::milliseconds {Service<IConfig>::get()->getULong("api-subsonic-slow-request-threshold", 0)},
+					static_cast<unsigned>(Service<IConfig>::get()->getULong("api-subsonic-slow-request-sampling", 100))}
+, _concurrencyLimiter {ConcurrencyLimiter::Limits {Service<IConfig>::get()->getULong("api-subsonic-max-concurrent-browsing-requests", 0),
+					Service<IConfig>::get()->getULong("api-subsonic-max-concurrent-media-requests", 0),
+					Service<IConfig>::get()->getULong("api-subsonic-max-concurrent-requests-per-user", 0)}}
+, _retryAfter {Service<IConfig>::get()->getULong("api-subsonic-busy-retry-after", 5)}
+, _compressionMinSize {Service<IConfig>::get()->getULong("api-subsonic-compression-min-size", 1024)}
 {
+	if (const std::size_t workerThreadCount {Service<IConfig>::get()->getULong("api-subsonic-worker-thread-count", 0)})
+		_workerRunner.emplace(_workerIOContext, workerThreadCount);
+}
+
+SubsonicResource::~SubsonicResource()
+{
+	// Pending handlers use this resource
+	_workerRunner.reset();
+	beingDeleted();
 }
 
 static
@@ -267,9 +306,16 @@ dateTimeToCreatedString(const Wt::WDateTime& dateTime)
 		return oss.str();
 }
 
+static
+std::size_t
+getLibraryGeneration()
+{
+	return Service<Scanner::IScannerService>::get()->getLibraryGeneration().value;
+}
+
 static
 Response::Node
-trackToResponseNode(const Track::pointer& track, Session& dbSession, const User::pointer& user)
+trackToUserIndependentResponseNode(const Track::pointer& track, Session& dbSession)
 {
 	Response::Node trackResponse;
 
@@ -297,9 +343,6 @@ trackToResponseNode(const Track::pointer& track, Session& dbSession, const User:
 		trackResponse.setAttribute("suffix", extension.string().substr(1));
 	}
 
-	if (user->getSubsonicTranscodeEnable())
-		trackResponse.setAttribute("transcodedSuffix", formatToSuffix(user->getSubsonicTranscodeFormat()));
-
 	trackResponse.setAttribute("coverArt", idToString(track->getId()));
 
 	const std::vector<Artist::pointer>& artists {track->getArtists({TrackArtistLinkType::Artist})};
@@ -322,9 +365,6 @@ trackToResponseNode(const Track::pointer& track, Session& dbSession, const User:
 	trackResponse.setAttribute("type", "music");
 	trackResponse.setAttribute("created", dateTimeToCreatedString(track->getLastWritten()));
 
-	if (Service<Scrobbling::IScrobblingService>::get()->isStarred(user->getId(), track->getId()))
-		trackResponse.setAttribute("starred", reportedStarredDate);
-
 	// Report the first GENRE for this track
 	ClusterType::pointer clusterType {ClusterType::find(dbSession, genreClusterName)};
 	if (clusterType)
@@ -337,6 +377,21 @@ trackToResponseNode(const Track::pointer& track, Session& dbSession, const User:
 	return trackResponse;
 }
 
+static
+Response::Node
+trackToResponseNode(const RequestContext& context, const Track::pointer& track, const User::pointer& user)
+{
+	Response::Node trackResponse {context.entityNodeCache.get(EntityNodeCache::EntityType::Track, track->getId().getValue(), getLibraryGeneration(), [&] { return trackToUserIndependentResponseNode(track, context.dbSession); })};
+
+	if (user->getSubsonicTranscodeEnable())
+		trackResponse.setAttribute("transcodedSuffix", formatToSuffix(user->getSubsonicTranscodeFormat()));
+
+	if (Service<Scrobbling::IScrobblingService>::get()->isStarred(user->getId(), track->getId()))
+		trackResponse.setAttribute("starred", reportedStarredDate);
+
+	return trackResponse;
+}
+
 static
 Response::Node
 trackBookmarkToResponseNode(const TrackBookmark::pointer& trackBookmark)
@@ -355,15 +410,16 @@ trackBookmarkToResponseNode(const TrackBookmark::pointer& trackBookmark)
 
 static
 Response::Node
-releaseToResponseNode(const Release::pointer& release, Session& dbSession, const User::pointer& user, bool id3)
+releaseToUserIndependentResponseNode(const Release::pointer& release, Session& dbSession, bool id3)
 {
 	Response::Node albumNode;
 
+	const Release::Summary summary {release->getSummary()};
 	if (id3)
 	{
 		albumNode.setAttribute("name", release->getName());
-		albumNode.setAttribute("songCount", release->getTracksCount());
-		albumNode.setAttribute("duration", std::chrono::duration_cast<std::chrono::seconds>(release->getDuration()).count());
+		albumNode.setAttribute("songCount", summary.trackCount);
+		albumNode.setAttribute("duration", std::chrono::duration_cast<std::chrono::seconds>(summary.duration).count());
 	}
 	else
 	{
@@ -374,9 +430,8 @@ releaseToResponseNode(const Release::pointer& release, Session& dbSession, const
 	albumNode.setAttribute("created", dateTimeToCreatedString(release->getLastWritten()));
 	albumNode.setAttribute("id", idToString(release->getId()));
 	albumNode.setAttribute("coverArt", idToString(release->getId()));
-	auto releaseYear {release->getReleaseYear()};
-	if (releaseYear)
-		albumNode.setAttribute("year", *releaseYear);
+	if (summary.year)
+		albumNode.setAttribute("year", *summary.year);
 
 	auto artists {release->getReleaseArtists()};
 	if (artists.empty())
@@ -413,23 +468,108 @@ releaseToResponseNode(const Release::pointer& release, Session& dbSession, const
 		}
 	}
 
+	return albumNode;
+}
+
+static
+Response::Node
+releaseToResponseNode(const RequestContext& context, const Release::pointer& release, const User::pointer& user, bool id3)
+{
+	const EntityNodeCache::EntityType entityType {id3 ? EntityNodeCache::EntityType::AlbumId3 : EntityNodeCache::EntityType::Album};
+	Response::Node albumNode {context.entityNodeCache.get(entityType, release->getId().getValue(), getLibraryGeneration(), [&] { return releaseToUserIndependentResponseNode(release, context.dbSession, id3); })};
+
 	if (Service<Scrobbling::IScrobblingService>::get()->isStarred(user->getId(), release->getId()))
 		albumNode.setAttribute("starred", reportedStarredDate);
 
 	return albumNode;
 }
 
+// Browse the directory tree of the media library instead of the artist/release hierarchy
+static
+bool
+isFolderBrowsingEnabled()
+{
+	static const bool enabled {Service<IConfig>::get()->getBool("api-subsonic-folder-browsing", false)};
+	return enabled;
+}
+
 static
 Response::Node
-artistToResponseNode(const User::pointer& user, const Artist::pointer& artist, bool id3)
+directoryToResponseNode(const Directory::pointer& directory)
+{
+	Response::Node directoryNode;
+
+	directoryNode.setAttribute("id", idToString(directory->getId()));
+	directoryNode.setAttribute("title", directory->getName());
+	directoryNode.setAttribute("isDir", true);
+	if (directory->getParentId().isValid())
+		directoryNode.setAttribute("parent", idToString(directory->getParentId()));
+	else
+		directoryNode.setAttribute("parent", idToString(RootId {}));
+
+	if (const std::optional<ReleaseId> releaseId {directory->getCoverReleaseId()})
+		directoryNode.setAttribute("coverArt", idToString(*releaseId));
+
+	return directoryNode;
+}
+
+// Sub directories first, then tracks
+static
+void
+addDirectoryEntries(const RequestContext& context, Response::Node& node, const User::pointer& user, const Directory::pointer& directory)
+{
+	Session& dbSession {context.dbSession};
+
+	const RangeResults<DirectoryId> childIds {Directory::findChildren(dbSession, directory->getId(), Range {})};
+	for (const DirectoryId childId : childIds.results)
+	{
+		if (const Directory::pointer child {Directory::find(dbSession, childId)})
+			node.addArrayChild("child", directoryToResponseNode(child));
+	}
+
+	const RangeResults<TrackId> trackIds {Track::find(dbSession, Track::FindParameters {}.setDirectory(directory->getId()).setSortMethod(TrackSortMethod::FilePath))};
+	for (const Track::pointer& track : Track::find(dbSession, trackIds.results))
+	{
+		Response::Node trackNode {trackToResponseNode(context, track, user)};
+		trackNode.setAttribute("parent", idToString(directory->getId()));
+		node.addArrayChild("child", std::move(trackNode));
+	}
+}
+
+static
+Response::Node
+artistToResponseNode(const User::pointer& user, ArtistId artistId, const std::string& name, std::optional<std::size_t> releaseCount)
 {
 	Response::Node artistNode;
 
-	artistNode.setAttribute("id", idToString(artist->getId()));
-	artistNode.setAttribute("name", artist->getName());
+	artistNode.setAttribute("id", idToString(artistId));
+	artistNode.setAttribute("name", name);
 
-	if (id3)
-		artistNode.setAttribute("albumCount", artist->getReleaseCount());
+	if (releaseCount)
+		artistNode.setAttribute("albumCount", *releaseCount);
+
+	if (Service<Scrobbling::IScrobblingService>::get()->isStarred(user->getId(), artistId))
+		artistNode.setAttribute("starred", reportedStarredDate);
+
+	return artistNode;
+}
+
+static
+Response::Node
+artistToResponseNode(const RequestContext& context, const User::pointer& user, const Artist::pointer& artist, bool id3)
+{
+	const EntityNodeCache::EntityType entityType {id3 ? EntityNodeCache::EntityType::ArtistId3 : EntityNodeCache::EntityType::Artist};
+	Response::Node artistNode {context.entityNodeCache.get(entityType, artist->getId().getValue(), getLibraryGeneration(), [&]
+	{
+		Response::Node node;
+
+		node.setAttribute("id", idToString(artist->getId()));
+		node.setAttribute("name", artist->getName());
+		if (id3)
+			node.setAttribute("albumCount", artist->getSummary().releaseCount);
+
+		return node;
+	})};
 
 	if (Service<Scrobbling::IScrobblingService>::get()->isStarred(user->getId(), artist->getId()))
 		artistNode.setAttribute("starred", reportedStarredDate);
@@ -439,13 +579,13 @@ artistToResponseNode(const User::pointer& user, const Artist::pointer& artist, b
 
 static
 Response::Node
-clusterToResponseNode(const Cluster::pointer& cluster)
+clusterToResponseNode(const ClusterCatalog::Cluster& cluster)
 {
 	Response::Node clusterNode;
 
-	clusterNode.setValue(cluster->getName());
-	clusterNode.setAttribute("songCount", cluster->getTracksCount());
-	clusterNode.setAttribute("albumCount", cluster->getReleasesCount());
+	clusterNode.setValue(cluster.name);
+	clusterNode.setAttribute("songCount", cluster.trackCount);
+	clusterNode.setAttribute("albumCount", cluster.releaseCount);
 
 	return clusterNode;
 }
@@ -532,7 +672,7 @@ handleCreatePlaylistRequest(RequestContext& context)
 	const auto id {getParameterAs<TrackListId>(context.parameters, "playlistId")};
 	auto name {getParameterAs<std::string>(context.parameters, "name")};
 
-	std::vector<TrackId> trackIds {getMultiParametersAs<TrackId>(context.parameters, "songId")};
+	const std::vector<TrackId> trackIds {getMultiParametersAs<TrackId>(context.parameters, "songId")};
 
 	if (!name && !id)
 		throw RequiredParameterMissingError {"name or id"};
@@ -556,20 +696,16 @@ handleCreatePlaylistRequest(RequestContext& context)
 
 		if (name)
 			tracklist.modify()->setName(*name);
+
+		// "if updating, the list of songs replaces the existing"
+		TrackListEntry::removeAll(context.dbSession, tracklist);
 	}
 	else
 	{
 		tracklist = TrackList::create(context.dbSession, *name, TrackList::Type::Playlist, false, user);
 	}
 
-	for (const TrackId trackId : trackIds)
-	{
-		Track::pointer track {Track::find(context.dbSession, trackId)};
-		if (!track)
-			continue;
-
-		TrackListEntry::create(context.dbSession, track, tracklist);
-	}
+	TrackListEntry::create(context.dbSession, trackIds, tracklist);
 
 	return Response::createOkResponse(context.serverProtocolVersion);
 }
@@ -693,23 +829,35 @@ handleGetRandomSongsRequest(RequestContext& context)
 	std::size_t size {getParameterAs<std::size_t>(context.parameters, "size").value_or(50)};
 	size = std::min(size, std::size_t {500});
 
+	const std::optional<std::string> genre {getParameterAs<std::string>(context.parameters, "genre")};
+
+	const std::size_t libraryGeneration {Service<Scanner::IScannerService>::get()->getLibraryGeneration().value};
+
 	auto transaction {context.dbSession.createSharedTransaction()};
 
 	User::pointer user {User::find(context.dbSession, context.userId)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
-	const auto trackIds {Track::find(context.dbSession, Track::FindParameters {}.setSortMethod(TrackSortMethod::Random).setRange({0, size}))};
-
 	Response response {Response::createOkResponse(context.serverProtocolVersion)};
-
 	Response::Node& randomSongsNode {response.createNode("randomSongs")};
-	for (const TrackId trackId : trackIds.results)
+
+	std::optional<ClusterId> clusterId;
+	if (genre)
 	{
-		const Track::pointer track {Track::find(context.dbSession, trackId)};
-		randomSongsNode.addArrayChild("song", trackToResponseNode(track, context.dbSession, user));
+		const ClusterType::pointer clusterType {ClusterType::find(context.dbSession, genreClusterName)};
+		const Cluster::pointer cluster {clusterType ? clusterType->getCluster(*genre) : Cluster::pointer {}};
+		if (!cluster)
+			return response;
+
+		clusterId = cluster->getId();
 	}
 
+	// Consecutive calls do not repeat tracks until all of them have been returned
+	const std::vector<TrackId> trackIds {context.shuffler.getNextTracks(context.dbSession, context.userId, clusterId, size, libraryGeneration)};
+	for (const Track::pointer& track : Track::find(context.dbSession, trackIds))
+		randomSongsNode.addArrayChild("song", trackToResponseNode(context, track, user));
+
 	return response;
 }
 
@@ -784,20 +932,17 @@ handleGetAlbumListRequestCommon(const RequestContext& context, bool id3)
 	else if (type == "newest")
 	{
 		Release::FindParameters params;
-		params.setSortMethod(ReleaseSortMethod::LastWritten);
+		params.setSortMethod(ReleaseSortMethod::AddedDesc);
+		// Not part of the Subsonic API: only the releases added since this library generation (see getScanStatus)
+		params.setAddedAfterGeneration(getParameterAs<std::size_t>(context.parameters, "lmsAddedSinceGeneration"));
 		params.setRange(range);
 
 		releases = Release::find(context.dbSession, params);
 	}
 	else if (type == "random")
 	{
-		// Random results are paginated, but there is no acceptable way to handle the pagination params without repeating some albums
-		// (no seed provided by subsonic, ot it would require to store some kind of context for each user/client when iterating over the random albums)
-		Release::FindParameters params;
-		params.setSortMethod(ReleaseSortMethod::Random);
-		params.setRange({0, size});
-
-		releases = Release::find(context.dbSession, params);
+		// The random order of the user is kept while paginating, a new one is started at offset 0
+		releases.results = context.shuffler.getReleases(context.dbSession, context.userId, range, Service<Scanner::IScannerService>::get()->getLibraryGeneration().value);
 	}
 	else if (type == "recent")
 	{
@@ -813,11 +958,8 @@ handleGetAlbumListRequestCommon(const RequestContext& context, bool id3)
 	Response response {Response::createOkResponse(context.serverProtocolVersion)};
 	Response::Node& albumListNode {response.createNode(id3 ? "albumList2" : "albumList")};
 
-	for (const ReleaseId releaseId : releases.results)
-	{
-		const Release::pointer release {Release::find(context.dbSession, releaseId)};
-		albumListNode.addArrayChild("album", releaseToResponseNode(release, context.dbSession, user, id3));
-	}
+	for (const Release::pointer& release : Release::find(context.dbSession, releases.results))
+		albumListNode.addArrayChild("album", releaseToResponseNode(context, release, user, id3));
 
 	return response;
 }
@@ -854,11 +996,11 @@ handleGetAlbumRequest(RequestContext& context)
 		throw UserNotAuthorizedError {};
 
 	Response response {Response::createOkResponse(context.serverProtocolVersion)};
-	Response::Node releaseNode {releaseToResponseNode(release, context.dbSession, user, true /* id3 */)};
+	Response::Node releaseNode {releaseToResponseNode(context, release, user, true /* id3 */)};
 
 	auto tracks {release->getTracks()};
 	for (const Track::pointer& track : tracks)
-		releaseNode.addArrayChild("song", trackToResponseNode(track, context.dbSession, user));
+		releaseNode.addArrayChild("song", trackToResponseNode(context, track, user));
 
 	response.addNode("album", std::move(releaseNode));
 
@@ -883,11 +1025,11 @@ handleGetArtistRequest(RequestContext& context)
 		throw UserNotAuthorizedError {};
 
 	Response response {Response::createOkResponse(context.serverProtocolVersion)};
-	Response::Node artistNode {artistToResponseNode(user, artist, true /* id3 */)};
+	Response::Node artistNode {artistToResponseNode(context, user, artist, true /* id3 */)};
 
 	auto releases {artist->getReleases()};
 	for (const Release::pointer& release : releases)
-		artistNode.addArrayChild("album", releaseToResponseNode(release, context.dbSession, user, true /* id3 */));
+		artistNode.addArrayChild("album", releaseToResponseNode(context, release, user, true /* id3 */));
 
 	response.addNode("artist", std::move(artistNode));
 
@@ -932,7 +1074,7 @@ handleGetArtistInfoRequestCommon(RequestContext& context, bool id3)
 		{
 			const Artist::pointer similarArtist {Artist::find(context.dbSession, similarArtistId)};
 			if (similarArtist)
-				artistInfoNode.addArrayChild("similarArtist", artistToResponseNode(user, similarArtist, id3));
+				artistInfoNode.addArrayChild("similarArtist", artistToResponseNode(context, user, similarArtist, id3));
 		}
 	}
 
@@ -962,8 +1104,9 @@ handleGetMusicDirectoryRequest(RequestContext& context)
 	const auto releaseId {getParameterAs<ReleaseId>(context.parameters, "id")};
 	const auto trackId {getParameterAs<TrackId>(context.parameters, "id")};
 	const auto root {getParameterAs<RootId>(context.parameters, "id")};
+	const auto directoryId {getParameterAs<DirectoryId>(context.parameters, "id")};
 
-	if (!root && !artistId && !releaseId && !trackId)
+	if (!root && !artistId && !releaseId && !trackId && !directoryId)
 		throw BadParameterGenericError {"id"};
 
 	Response response {Response::createOkResponse(context.serverProtocolVersion)};
@@ -975,7 +1118,34 @@ handleGetMusicDirectoryRequest(RequestContext& context)
 	if (!user)
 		throw UserNotAuthorizedError {};
 
-	if (root)
+	if (root && isFolderBrowsingEnabled())
+	{
+		directoryNode.setAttribute("id", idToString(RootId {}));
+		directoryNode.setAttribute("name", "Music");
+
+		const RangeResults<DirectoryId> rootDirectoryIds {Directory::findRootDirectories(context.dbSession, Range {})};
+		for (const DirectoryId rootDirectoryId : rootDirectoryIds.results)
+		{
+			if (const Directory::pointer rootDirectory {Directory::find(context.dbSession, rootDirectoryId)})
+				addDirectoryEntries(context, directoryNode, user, rootDirectory);
+		}
+	}
+	else if (directoryId)
+	{
+		const Directory::pointer directory {Directory::find(context.dbSession, *directoryId)};
+		if (!directory)
+			throw RequestedDataNotFoundError {};
+
+		directoryNode.setAttribute("id", idToString(directory->getId()));
+		directoryNode.setAttribute("name", directory->getName());
+		if (directory->getParentId().isValid())
+			directoryNode.setAttribute("parent", idToString(directory->getParentId()));
+		else
+			directoryNode.setAttribute("parent", idToString(RootId {}));
+
+		addDirectoryEntries(context, directoryNode, user, directory);
+	}
+	else if (root)
 	{
 		directoryNode.setAttribute("id", idToString(RootId {}));
 		directoryNode.setAttribute("name", "Music");
@@ -984,7 +1154,7 @@ handleGetMusicDirectoryRequest(RequestContext& context)
 		for (const ArtistId artistId : artistIds.results)
 		{
 			const Artist::pointer artist {Artist::find(context.dbSession, artistId)};
-			directoryNode.addArrayChild("child", artistToResponseNode(user, artist, false /* no id3 */));
+			directoryNode.addArrayChild("child", artistToResponseNode(context, user, artist, false /* no id3 */));
 		}
 	}
 	else if (artistId)
@@ -999,7 +1169,7 @@ handleGetMusicDirectoryRequest(RequestContext& context)
 
 		auto releases {artist->getReleases()};
 		for (const Release::pointer& release : releases)
-			directoryNode.addArrayChild("child", releaseToResponseNode(release, context.dbSession, user, false /* no id3 */));
+			directoryNode.addArrayChild("child", releaseToResponseNode(context, release, user, false /* no id3 */));
 	}
 	else if (releaseId)
 	{
@@ -1013,7 +1183,7 @@ handleGetMusicDirectoryRequest(RequestContext& context)
 
 		auto tracks {release->getTracks()};
 		for (const Track::pointer& track : tracks)
-			directoryNode.addArrayChild("child", trackToResponseNode(track, context.dbSession, user));
+			directoryNode.addArrayChild("child", trackToResponseNode(context, track, user));
 	}
 	else
 		throw BadParameterGenericError {"id"};
@@ -1043,7 +1213,18 @@ handleGetArtistsRequestCommon(RequestContext& context, bool id3)
 
 	Response::Node& artistsNode {response.createNode(id3 ? "artists" : "indexes")};
 	artistsNode.setAttribute("ignoredArticles", "");
-	artistsNode.setAttribute("lastModified", reportedDummyDateULong);
+
+	const Scanner::IScannerService::LibraryGeneration libraryGeneration {Service<Scanner::IScannerService>::get()->getLibraryGeneration()};
+	const long long lastModifiedMs {std::chrono::duration_cast<std::chrono::milliseconds>(libraryGeneration.lastChangeDateTime.toTimePoint().time_since_epoch()).count()};
+	artistsNode.setAttribute("lastModified", lastModifiedMs);
+
+	if (!id3)
+	{
+		// "If specified, only return a result if the artist collection has changed since the given time"
+		const std::optional<long long> ifModifiedSince {getParameterAs<long long>(context.parameters, "ifModifiedSince")};
+		if (ifModifiedSince && *ifModifiedSince >= lastModifiedMs)
+			return response;
+	}
 
 	auto transaction {context.dbSession.createSharedTransaction()};
 
@@ -1051,60 +1232,101 @@ handleGetArtistsRequestCommon(RequestContext& context, bool id3)
 	if (!user)
 		throw UserNotAuthorizedError {};
 
-	Artist::FindParameters parameters;
-	parameters.setSortMethod(ArtistSortMethod::BySortName);
-	switch (user->getSubsonicArtistListMode())
+	const std::shared_ptr<const ArtistIndexCache::Indexes> indexes {context.artistIndexCache.get(context.dbSession, user->getSubsonicArtistListMode(), libraryGeneration.value)};
+	for (const ArtistIndexCache::Index& index : *indexes)
 	{
-		case SubsonicArtistListMode::AllArtists:
-			break;
-		case SubsonicArtistListMode::ReleaseArtists:
-			parameters.setLinkType(TrackArtistLinkType::ReleaseArtist);
-			break;
-		case SubsonicArtistListMode::TrackArtists:
-			parameters.setLinkType(TrackArtistLinkType::Artist);
-			break;
+		Response::Node& indexNode {artistsNode.createArrayChild("index")};
+		indexNode.setAttribute("name", index.name);
+
+		for (const ArtistIndexCache::Artist& artist : index.artists)
+			indexNode.addArrayChild("artist", artistToResponseNode(user, artist.id, artist.name, id3 ? std::make_optional(artist.releaseCount) : std::nullopt));
 	}
 
-	Response::Node* currentIndexNode {};
-	char currentIndex{};
+	return response;
+}
 
-	Response::Node* unknownIndexNode {};
-	auto getOrCreateUnknownIndexNode {[&]
+// Content of the root directories, sub directories are grouped by their first letter
+static
+Response
+handleGetDirectoryIndexesRequest(RequestContext& context)
+{
+	Response response {Response::createOkResponse(context.serverProtocolVersion)};
+
+	Response::Node& indexesNode {response.createNode("indexes")};
+	indexesNode.setAttribute("ignoredArticles", "");
+
+	const Wt::WDateTime lastModified {Service<Scanner::IScannerService>::get()->getLibraryGeneration().lastChangeDateTime};
+	const long long lastModifiedMs {std::chrono::duration_cast<std::chrono::milliseconds>(lastModified.toTimePoint().time_since_epoch()).count()};
+	indexesNode.setAttribute("lastModified", lastModifiedMs);
+
+	const std::optional<long long> ifModifiedSince {getParameterAs<long long>(context.parameters, "ifModifiedSince")};
+	if (ifModifiedSince && *ifModifiedSince >= lastModifiedMs)
+		return response;
+
+	auto transaction {context.dbSession.createSharedTransaction()};
+
+	User::pointer user {User::find(context.dbSession, context.userId)};
+	if (!user)
+		throw UserNotAuthorizedError {};
+
+	std::map<char, std::vector<Directory::pointer>> directoriesByIndex;
+	std::vector<Directory::pointer> rootDirectories;
+
+	const RangeResults<DirectoryId> rootDirectoryIds {Directory::findRootDirectories(context.dbSession, Range {})};
+	for (const DirectoryId rootDirectoryId : rootDirectoryIds.results)
 	{
-		if (!unknownIndexNode)
+		const Directory::pointer rootDirectory {Directory::find(context.dbSession, rootDirectoryId)};
+		if (!rootDirectory)
+			continue;
+
+		rootDirectories.push_back(rootDirectory);
+
+		const RangeResults<DirectoryId> childIds {Directory::findChildren(context.dbSession, rootDirectoryId, Range {})};
+		for (const DirectoryId childId : childIds.results)
 		{
-			unknownIndexNode = &artistsNode.createArrayChild("index");
-			unknownIndexNode->setAttribute("name", "?");
-		}
+			const Directory::pointer child {Directory::find(context.dbSession, childId)};
+			if (!child)
+				continue;
 
-		return unknownIndexNode;
-	}};
+			const std::string& name {child->getName()};
+			const char index {name.empty() || !std::isalpha(name[0]) ? '?' : static_cast<char>(std::toupper(name[0]))};
+			directoriesByIndex[index].push_back(child);
+		}
+	}
 
-	auto getOrCreateIndexNode {[&](char first)
+	auto addIndexNode {[&](char index, const std::vector<Directory::pointer>& directories)
 	{
-		if (!currentIndexNode || currentIndex != first)
+		Response::Node& indexNode {indexesNode.createArrayChild("index")};
+		indexNode.setAttribute("name", std::string {index});
+
+		for (const Directory::pointer& directory : directories)
 		{
-			currentIndexNode = &artistsNode.createArrayChild("index");
-			currentIndexNode->setAttribute("name", std::string {first});
-			currentIndex = first;
+			Response::Node artistNode;
+			artistNode.setAttribute("id", idToString(directory->getId()));
+			artistNode.setAttribute("name", directory->getName());
+			indexNode.addArrayChild("artist", std::move(artistNode));
 		}
-
-		return currentIndexNode;
 	}};
 
-	const RangeResults<ArtistId> artists {Artist::find(context.dbSession, parameters)};
-	for (const ArtistId artistId : artists.results)
+	// unknown index is reported last, as for the artists
+	for (const auto& [index, directories] : directoriesByIndex)
 	{
-		const Artist::pointer artist {Artist::find(context.dbSession, artistId)};
-		const std::string& sortName {artist->getSortName()};
-
-		Response::Node* indexNode{};
-		if (sortName.empty() || !std::isalpha(sortName[0]))
-			indexNode = getOrCreateUnknownIndexNode();
-		else
-			indexNode = getOrCreateIndexNode(std::toupper(sortName[0]));
+		if (index != '?')
+			addIndexNode(index, directories);
+	}
+	if (auto itUnknown {directoriesByIndex.find('?')}; itUnknown != std::cend(directoriesByIndex))
+		addIndexNode(itUnknown->first, itUnknown->second);
 
-		indexNode->addArrayChild("artist", artistToResponseNode(user, artist, id3));
+	// Tracks located directly in the root directories
+	for (const Directory::pointer& rootDirectory : rootDirectories)
+	{
+		const RangeResults<TrackId> trackIds {Track::find(context.dbSession, Track::FindParameters {}.setDirectory(rootDirectory->getId()).setSortMethod(TrackSortMethod::FilePath))};
+		for (const Track::pointer& track : Track::find(context.dbSession, trackIds.results))
+		{
+			Response::Node trackNode {trackToResponseNode(context, track, user)};
+			trackNode.setAttribute("parent", idToString(rootDirectory->getId()));
+			indexesNode.addArrayChild("child", std::move(trackNode));
+		}
 	}
 
 	return response;
@@ -1114,6 +1336,9 @@ static
 Response
 handleGetIndexesRequest(RequestContext& context)
 {
+	if (isFolderBrowsingEnabled())
+		return handleGetDirectoryIndexesRequest(context);
+
 	return handleGetArtistsRequestCommon(context, false /* no id3 */);
 }
 
@@ -1125,14 +1350,10 @@ handleGetGenresRequest(RequestContext& context)
 
 	Response::Node& genresNode {response.createNode("genres")};
 
-	auto transaction {context.dbSession.createSharedTransaction()};
-
-	const ClusterType::pointer clusterType {ClusterType::find(context.dbSession, genreClusterName)};
-	if (clusterType)
+	const std::shared_ptr<const ClusterCatalog> clusterCatalog {ClusterCatalog::get(context.dbSession)};
+	if (const ClusterCatalog::ClusterType* clusterType {clusterCatalog->findClusterType(genreClusterName)})
 	{
-		const auto clusters {clusterType->getClusters()};
-
-		for (const Cluster::pointer& cluster : clusters)
+		for (const ClusterCatalog::Cluster& cluster : clusterType->clusters)
 			genresNode.addArrayChild("genre", clusterToResponseNode(cluster));
 	}
 
@@ -1188,7 +1409,7 @@ handleGetSimilarSongsRequestCommon(RequestContext& context, bool id3)
 	Response response {Response::createOkResponse(context.serverProtocolVersion)};
 	Response::Node& similarSongsNode {response.createNode(id3 ? "similarSongs2" : "similarSongs")};
 	for (const Track::pointer& track : tracks)
-		similarSongsNode.addArrayChild("song", trackToResponseNode(track, context.dbSession, user));
+		similarSongsNode.addArrayChild("song", trackToResponseNode(context, track, user));
 
 	return response;
 }
@@ -1222,23 +1443,14 @@ handleGetStarredRequestCommon(RequestContext& context, bool id3)
 
 	Scrobbling::IScrobblingService& scrobbling {*Service<Scrobbling::IScrobblingService>::get()};
 
-	for (const ArtistId artistId : scrobbling.getStarredArtists(context.userId, {} /* clusters */, std::nullopt /* linkType */, ArtistSortMethod::BySortName, Range {}).results)
-	{
-		if (auto artist {Artist::find(context.dbSession, artistId)})
-			starredNode.addArrayChild("artist", artistToResponseNode(user, artist, id3));
-	}
+	for (const Artist::pointer& artist : Artist::find(context.dbSession, scrobbling.getStarredArtists(context.userId, {} /* clusters */, std::nullopt /* linkType */, ArtistSortMethod::BySortName, Range {}).results))
+		starredNode.addArrayChild("artist", artistToResponseNode(context, user, artist, id3));
 
-	for (const ReleaseId releaseId : scrobbling.getStarredReleases(context.userId, {} /* clusters */, Range {}).results)
-	{
-		if (auto release {Release::find(context.dbSession, releaseId)})
-			starredNode.addArrayChild("album", releaseToResponseNode(release, context.dbSession, user, id3));
-	}
+	for (const Release::pointer& release : Release::find(context.dbSession, scrobbling.getStarredReleases(context.userId, {} /* clusters */, Range {}).results))
+		starredNode.addArrayChild("album", releaseToResponseNode(context, release, user, id3));
 
-	for (const TrackId trackId : scrobbling.getStarredTracks(context.userId, {} /* clusters */, Range {}).results)
-	{
-		if (auto track {Track::find(context.dbSession, trackId)})
-			starredNode.addArrayChild("song", trackToResponseNode(track, context.dbSession, user));
-	}
+	for (const Track::pointer& track : Track::find(context.dbSession, scrobbling.getStarredTracks(context.userId, {} /* clusters */, Range {}).results))
+		starredNode.addArrayChild("song", trackToResponseNode(context, track, user));
 
 	return response;
 
@@ -1297,9 +1509,9 @@ handleGetPlaylistRequest(RequestContext& context)
 
 	auto entries {tracklist->getEntries()};
 	for (const TrackListEntry::pointer& entry : entries)
-		playlistNode.addArrayChild("entry", trackToResponseNode(entry->getTrack(), context.dbSession, user));
+		playlistNode.addArrayChild("entry", trackToResponseNode(context, entry->getTrack(), user));
 
-	response.addNode("playlist", playlistNode );
+	response.addNode("playlist", std::move(playlistNode));
 
 	return response;
 }
@@ -1358,11 +1570,8 @@ handleGetSongsByGenreRequest(RequestContext& context)
 	params.setRange({offset, size});
 
 	auto trackIds {Track::find(context.dbSession, params)};
-	for (const TrackId trackId : trackIds.results)
-	{
-		const Track::pointer track {Track::find(context.dbSession, trackId)};
-		songsByGenreNode.addArrayChild("song", trackToResponseNode(track, context.dbSession, user));
-	}
+	for (const Track::pointer& track : Track::find(context.dbSession, trackIds.results))
+		songsByGenreNode.addArrayChild("song", trackToResponseNode(context, track, user));
 
 	return response;
 }
@@ -1439,11 +1648,8 @@ handleSearchRequestCommon(RequestContext& context, bool id3)
 		params.setRange({artistOffset, artistCount});
 
 		RangeResults<ArtistId> artistIds {Artist::find(context.dbSession, params)};
-		for (const ArtistId artistId : artistIds.results)
-		{
-			const auto artist {Artist::find(context.dbSession, artistId)};
-			searchResult2Node.addArrayChild("artist", artistToResponseNode(user, artist, id3));
-		}
+		for (const Artist::pointer& artist : Artist::find(context.dbSession, artistIds.results))
+			searchResult2Node.addArrayChild("artist", artistToResponseNode(context, user, artist, id3));
 	}
 
 	{
@@ -1453,11 +1659,8 @@ handleSearchRequestCommon(RequestContext& context, bool id3)
 		params.setRange({albumOffset, albumCount});
 
 		RangeResults<ReleaseId> releaseIds {Release::find(context.dbSession, params)};
-		for (const ReleaseId releaseId : releaseIds.results)
-		{
-			const auto release {Release::find(context.dbSession, releaseId)};
-			searchResult2Node.addArrayChild("album", releaseToResponseNode(release, context.dbSession, user, id3));
-		}
+		for (const Release::pointer& release : Release::find(context.dbSession, releaseIds.results))
+			searchResult2Node.addArrayChild("album", releaseToResponseNode(context, release, user, id3));
 	}
 
 	{
@@ -1466,11 +1669,8 @@ handleSearchRequestCommon(RequestContext& context, bool id3)
 		params.setRange({songOffset, songCount});
 
 		RangeResults<TrackId> trackIds {Track::find(context.dbSession, params)};
-		for (const TrackId trackId : trackIds.results)
-		{
-			const auto track {Track::find(context.dbSession, trackId)};
-			searchResult2Node.addArrayChild("song", trackToResponseNode(track, context.dbSession, user));
-		}
+		for (const Track::pointer& track : Track::find(context.dbSession, trackIds.results))
+			searchResult2Node.addArrayChild("song", trackToResponseNode(context, track, user));
 	}
 
 	return response;
@@ -1503,14 +1703,9 @@ handleStarRequest(RequestContext& context)
 {
 	StarParameters params {getStarParameters(context.parameters)};
 
-	for (const ArtistId id : params.artistIds)
-		Service<Scrobbling::IScrobblingService>::get()->star(context.userId, id);
-
-	for (const ReleaseId id : params.releaseIds)
-		Service<Scrobbling::IScrobblingService>::get()->star(context.userId, id);
-
-	for (const TrackId id : params.trackIds)
-		Service<Scrobbling::IScrobblingService>::get()->star(context.userId, id);
+	Service<Scrobbling::IScrobblingService>::get()->star(context.userId, params.artistIds);
+	Service<Scrobbling::IScrobblingService>::get()->star(context.userId, params.releaseIds);
+	Service<Scrobbling::IScrobblingService>::get()->star(context.userId, params.trackIds);
 
 	return Response::createOkResponse(context.serverProtocolVersion);
 }
@@ -1535,14 +1730,9 @@ handleUnstarRequest(RequestContext& context)
 {
 	StarParameters params {getStarParameters(context.parameters)};
 
-	for (const ArtistId id : params.artistIds)
-		Service<Scrobbling::IScrobblingService>::get()->unstar(context.userId, id);
-
-	for (const ReleaseId id : params.releaseIds)
-		Service<Scrobbling::IScrobblingService>::get()->unstar(context.userId, id);
-
-	for (const TrackId id : params.trackIds)
-		Service<Scrobbling::IScrobblingService>::get()->unstar(context.userId, id);
+	Service<Scrobbling::IScrobblingService>::get()->unstar(context.userId, params.artistIds);
+	Service<Scrobbling::IScrobblingService>::get()->unstar(context.userId, params.releaseIds);
+	Service<Scrobbling::IScrobblingService>::get()->unstar(context.userId, params.trackIds);
 
 	return Response::createOkResponse(context.serverProtocolVersion);
 }
@@ -1646,7 +1836,7 @@ handleUpdatePlaylistRequest(RequestContext& context)
 	auto isPublic {getParameterAs<bool>(context.parameters, "public")};
 
 	std::vector<TrackId> trackIdsToAdd {getMultiParametersAs<TrackId>(context.parameters, "songIdToAdd")};
-	std::vector<std::size_t> trackPositionsToRemove {getMultiParametersAs<std::size_t>(context.parameters, "songIndexToRemove")};
+	const std::vector<std::size_t> trackPositionsToRemove {getMultiParametersAs<std::size_t>(context.parameters, "songIndexToRemove")};
 
 	auto transaction {context.dbSession.createUniqueTransaction()};
 
@@ -1668,27 +1858,9 @@ handleUpdatePlaylistRequest(RequestContext& context)
 	if (isPublic)
 		tracklist.modify()->setIsPublic(*isPublic);
 
-	{
-		// Remove from end to make indexes stable
-		std::sort(std::begin(trackPositionsToRemove), std::end(trackPositionsToRemove), std::greater<std::size_t>());
-
-		for (std::size_t trackPositionToRemove : trackPositionsToRemove)
-		{
-			auto entry {tracklist->getEntry(trackPositionToRemove)};
-			if (entry)
-				entry.remove();
-		}
-	}
-
-	// Add tracks
-	for (const TrackId trackIdToAdd : trackIdsToAdd)
-	{
-		Track::pointer track {Track::find(context.dbSession, trackIdToAdd)};
-		if (!track)
-			continue;
-
-		TrackListEntry::create(context.dbSession, track, tracklist);
-	}
+	// Positions refer to the playlist before the removal
+	TrackListEntry::remove(context.dbSession, tracklist, trackPositionsToRemove);
+	TrackListEntry::create(context.dbSession, trackIdsToAdd, tracklist);
 
 	return Response::createOkResponse(context.serverProtocolVersion);
 }
@@ -1712,7 +1884,7 @@ handleGetBookmarks(RequestContext& context)
 	{
 		const TrackBookmark::pointer bookmark {TrackBookmark::find(context.dbSession, bookmarkId)};
 		Response::Node bookmarkNode {trackBookmarkToResponseNode(bookmark)};
-		bookmarkNode.addArrayChild("entry", trackToResponseNode(bookmark->getTrack(), context.dbSession, user));
+		bookmarkNode.addArrayChild("entry", trackToResponseNode(context, bookmark->getTrack(), user));
 
 		bookmarksNode.addArrayChild("bookmark", std::move(bookmarkNode));
 	}
@@ -1769,6 +1941,70 @@ handleDeleteBookmark(RequestContext& context)
 	return Response::createOkResponse(context.serverProtocolVersion);
 }
 
+static
+Response
+handleGetPlayQueue(RequestContext& context)
+{
+	const std::optional<PlayQueueStore::PlayQueue> playQueue {context.playQueueStore.get(context.userId)};
+
+	Response response {Response::createOkResponse(context.serverProtocolVersion)};
+	if (!playQueue)
+		return response;
+
+	auto transaction {context.dbSession.createSharedTransaction()};
+
+	const User::pointer user {User::find(context.dbSession, context.userId)};
+	if (!user)
+		throw UserNotAuthorizedError {};
+
+	Response::Node& playQueueNode {response.createNode("playQueue")};
+	if (playQueue->currentIndex < playQueue->trackIds.size())
+		playQueueNode.setAttribute("current", idToString(playQueue->trackIds[playQueue->currentIndex]));
+	playQueueNode.setAttribute("position", playQueue->currentPositionInTrack.count());
+	playQueueNode.setAttribute("username", user->getLoginName());
+	playQueueNode.setAttribute("changed", dateTimeToCreatedString(playQueue->lastModifiedDateTime));
+	playQueueNode.setAttribute("changedBy", playQueue->changedBy);
+
+	for (const TrackId trackId : playQueue->trackIds)
+	{
+		// tracks may have been removed since the queue was saved
+		const Track::pointer track {Track::find(context.dbSession, trackId)};
+		if (track)
+			playQueueNode.addArrayChild("entry", trackToResponseNode(context, track, user));
+	}
+
+	return response;
+}
+
+static
+Response
+handleSavePlayQueue(RequestContext& context)
+{
+	// Optional params
+	std::vector<TrackId> trackIds {getMultiParametersAs<TrackId>(context.parameters, "id")};
+	const std::optional<TrackId> currentTrackId {getParameterAs<TrackId>(context.parameters, "current")};
+	const std::optional<unsigned long> position {getParameterAs<unsigned long>(context.parameters, "position")};
+
+	PlayQueueStore::PlayQueue playQueue;
+	if (currentTrackId)
+	{
+		auto itCurrent {std::find(std::cbegin(trackIds), std::cend(trackIds), *currentTrackId)};
+		if (itCurrent == std::cend(trackIds))
+			throw BadParameterGenericError {"current"};
+
+		playQueue.currentIndex = std::distance(std::cbegin(trackIds), itCurrent);
+	}
+	playQueue.trackIds = std::move(trackIds);
+	playQueue.currentPositionInTrack = std::chrono::milliseconds {position.value_or(0)};
+	playQueue.lastModifiedDateTime = Wt::WDateTime::currentDateTime();
+	playQueue.changedBy = context.clientInfo.name;
+
+	// persisted later on, so that frequent saves do not contend for the database write lock
+	context.playQueueStore.save(context.userId, std::move(playQueue));
+
+	return Response::createOkResponse(context.serverProtocolVersion);
+}
+
 static
 Response
 handleNotImplemented(RequestContext&)
@@ -1777,8 +2013,15 @@ handleNotImplemented(RequestContext&)
 }
 
 static
-void
-handleGetCoverArt(RequestContext& context, const Wt::Http::Request& /*request*/, Wt::Http::Response& response)
+bool
+isEntityTagMatching(const Wt::Http::Request& request, const std::string& entityTag)
+{
+	return request.headerValue("If-None-Match").find(entityTag) != std::string::npos;
+}
+
+static
+std::shared_ptr<Image::IEncodedImage>
+getCoverArt(RequestContext& context, Image::EncodingFormat format)
 {
 	// Mandatory params
 	const auto trackId {getParameterAs<TrackId>(context.parameters, "id")};
@@ -1792,12 +2035,38 @@ handleGetCoverArt(RequestContext& context, const Wt::Http::Request& /*request*/,
 
 	std::shared_ptr<Image::IEncodedImage> cover;
 	if (trackId)
-		cover = Service<Cover::ICoverService>::get()->getFromTrack(*trackId, size);
+		cover = Service<Cover::ICoverService>::get()->getFromTrack(*trackId, size, format);
 	else if (releaseId)
-		cover = Service<Cover::ICoverService>::get()->getFromRelease(*releaseId, size);
+		cover = Service<Cover::ICoverService>::get()->getFromRelease(*releaseId, size, format);
 
-	response.out().write(reinterpret_cast<const char*>(cover->getData()), cover->getDataSize());
-	response.setMimeType(std::string {cover->getMimeType()});
+	return cover;
+}
+
+static
+void
+writeCoverArt(const Wt::Http::Request& request, Wt::Http::Response& response, const Image::IEncodedImage& cover)
+{
+	// Clients revalidate the covers they already have, the cover is usually in the cover cache
+	const std::string entityTag {Cover::computeEntityTag(cover)};
+	response.addHeader("ETag", entityTag);
+	response.addHeader("Cache-Control", "private, no-cache");
+	response.addHeader("Vary", "Accept");
+	if (isEntityTagMatching(request, entityTag))
+	{
+		response.setStatus(304);
+		return;
+	}
+
+	response.out().write(reinterpret_cast<const char*>(cover.getData()), cover.getDataSize());
+	response.setMimeType(std::string {cover.getMimeType()});
+}
+
+static
+void
+handleGetCoverArt(RequestContext& context, const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+	const std::shared_ptr<Image::IEncodedImage> cover {getCoverArt(context, Cover::selectEncodingFormat(request.headerValue("Accept")))};
+	writeCoverArt(request, response, *cover);
 }
 
 using RequestHandlerFunc = std::function<Response(RequestContext& context)>;
@@ -1809,7 +2078,8 @@ struct RequestEntryPointInfo
 	CheckImplementedFunc		checkFunc {};
 };
 
-static const std::unordered_map<std::string, RequestEntryPointInfo> requestEntryPoints
+// Keys are literals, hence looking up views is safe
+static const std::unordered_map<std::string_view, RequestEntryPointInfo> requestEntryPoints
 {
 	// System
 	{"ping",		{handlePingRequest}},
@@ -1855,7 +2125,6 @@ static const std::unordered_map<std::string, RequestEntryPointInfo> requestEntry
 	{"deletePlaylist",	{handleDeletePlaylistRequest}},
 
 	// Media retrieval
-	{"hls",				{handleNotImplemented}},
 	{"getCaptions",		{handleNotImplemented}},
 	{"getLyrics",		{handleNotImplemented}},
 	{"getAvatar",		{handleNotImplemented}},
@@ -1906,47 +2175,413 @@ static const std::unordered_map<std::string, RequestEntryPointInfo> requestEntry
 	{"getBookmarks",	{handleGetBookmarks}},
 	{"createBookmark",	{handleCreateBookmark}},
 	{"deleteBookmark",	{handleDeleteBookmark}},
-	{"getPlayQueue",	{handleNotImplemented}},
-	{"savePlayQueue",	{handleNotImplemented}},
+	{"getPlayQueue",	{handleGetPlayQueue}},
+	{"savePlayQueue",	{handleSavePlayQueue}},
 
 	// Media library scanning
 	{"getScanStatus",	{Scan::handleGetScanStatus,		{UserType::ADMIN}}},
 	{"startScan",		{Scan::handleStartScan,			{UserType::ADMIN}}},
 };
 
+// Responses that only depend on the library content, the user settings and the user stars
+static const std::unordered_set<std::string_view> cacheableEntryPoints
+{
+	"getIndexes",
+	"getMusicDirectory",
+	"getArtists",
+	"getAlbumList",
+	"getAlbumList2",
+};
+
+static
+bool
+isCacheable(std::string_view requestPath, const Wt::Http::ParameterMap& parameters)
+{
+	if (cacheableEntryPoints.find(requestPath) == std::cend(cacheableEntryPoints))
+		return false;
+
+	if (requestPath == "getAlbumList" || requestPath == "getAlbumList2")
+	{
+		// these ones change at each call or at each listen
+		const std::optional<std::string> type {getParameterAs<std::string>(parameters, "type")};
+		if (type == "random" || type == "frequent" || type == "recent")
+			return false;
+	}
+
+	return true;
+}
+
+static
+void
+writeNormalizedParameters(std::ostream& os, const Wt::Http::ParameterMap& parameters)
+{
+	// parameters are sorted by name
+	for (const auto& [name, values] : parameters)
+	{
+		// skip authentication parameters, salt changes at each request
+		if (name == "u" || name == "p" || name == "t" || name == "s" || name == "hlsToken")
+			continue;
+
+		for (const std::string& value : values)
+			os << name << '=' << value << '\n';
+	}
+}
+
+// Responses that do not depend on the listens and that are expensive to build
+static
+bool
+isResponseCacheable(std::string_view requestPath, const Wt::Http::ParameterMap& parameters)
+{
+	if (requestPath == "getIndexes" || requestPath == "getArtists" || requestPath == "getGenres")
+		return true;
+
+	// Folder browsing clients walk the whole tree
+	if (requestPath == "getMusicDirectory")
+		return true;
+
+	if (requestPath == "getAlbumList" || requestPath == "getAlbumList2")
+	{
+		const std::optional<std::string> type {getParameterAs<std::string>(parameters, "type")};
+		return type == "alphabeticalByName" || type == "alphabeticalByArtist" || type == "newest";
+	}
+
+	return false;
+}
+
+static
+std::string
+computeResponseCacheKey(const RequestContext& context, std::string_view requestPath)
+{
+	std::ostringstream oss;
+	oss << requestPath << '\n' << context.userId.getValue() << '\n';
+	writeNormalizedParameters(oss, context.parameters);
+
+	return oss.str();
+}
+
+static
+ResponseCache::Version
+getResponseCacheVersion()
+{
+	return {Service<Scanner::IScannerService>::get()->getLibraryGeneration().value, Service<Scrobbling::IScrobblingService>::get()->getStarGeneration()};
+}
+
+static
+std::string
+computeEntityTag(RequestContext& context, std::string_view requestPath)
+{
+	const Scanner::IScannerService::LibraryGeneration libraryGeneration {Service<Scanner::IScannerService>::get()->getLibraryGeneration()};
+
+	std::ostringstream oss;
+	oss << requestPath << '\n' << libraryGeneration.value << '/' << libraryGeneration.lastChangeDateTime.toTime_t() << '\n';
+
+	{
+		auto transaction {context.dbSession.createSharedTransaction()};
+
+		const User::pointer user {User::find(context.dbSession, context.userId)};
+		if (!user)
+			throw UserNotAuthorizedError {};
+
+		const Scrobbler scrobbler {user->getScrobbler()};
+		oss << context.userId.getValue() << '/' << static_cast<int>(scrobbler)
+			<< '/' << static_cast<int>(user->getSubsonicArtistListMode())
+			<< '/' << user->getSubsonicTranscodeEnable() << '/' << static_cast<int>(user->getSubsonicTranscodeFormat()) << '\n';
+		oss << StarredArtist::getUserSignature(context.dbSession, context.userId, scrobbler) << '\n';
+		oss << StarredRelease::getUserSignature(context.dbSession, context.userId, scrobbler) << '\n';
+		oss << StarredTrack::getUserSignature(context.dbSession, context.userId, scrobbler) << '\n';
+	}
+
+	writeNormalizedParameters(oss, context.parameters);
+
+	std::ostringstream entityTag;
+	entityTag << '"' << std::hex << std::hash<std::string> {}(oss.str()) << '"';
+
+	return entityTag.str();
+}
+
 using MediaRetrievalHandlerFunc = std::function<void(RequestContext&, const Wt::Http::Request&, Wt::Http::Response&)>;
-static std::unordered_map<std::string, MediaRetrievalHandlerFunc> mediaRetrievalHandlers
+static const std::unordered_map<std::string_view, MediaRetrievalHandlerFunc> mediaRetrievalHandlers
 {
 	// Media retrieval
 	{"download",		Stream::handleDownload},
 	{"stream",			Stream::handleStream},
+	{"hls",				Stream::handleHls},
+	{"hls.m3u8",		Stream::handleHls},
+	{"hlsSegment",		Stream::handleHlsSegment},
 	{"getCoverArt",		handleGetCoverArt},
 };
 
+struct EndpointMetrics
+{
+	const char*			name; // literal, also used to label the profiles
+	Metrics::Counter&	requests;
+	Metrics::Counter&	errors;
+	Metrics::Counter&	rejections;
+	Metrics::Histogram&	duration;
+};
+
+// endpoint must be a literal
+static EndpointMetrics
+createEndpointMetrics(std::string_view endpoint)
+{
+	const std::string labels {"endpoint=\"" + std::string {endpoint} + "\""};
+
+	Metrics::Registry& registry {Metrics::getRegistry()};
+	return EndpointMetrics {
+		endpoint.data(),
+		registry.createCounter("lms_subsonic_requests", "Number of Subsonic API requests", labels),
+		registry.createCounter("lms_subsonic_request_errors", "Number of Subsonic API requests that ended up in an error response", labels),
+		registry.createCounter("lms_subsonic_rejected_requests", "Number of Subsonic API requests rejected because of the concurrency limits", labels),
+		registry.createHistogram("lms_subsonic_request_duration_seconds", "Time spent handling the Subsonic API requests", labels),
+	};
+}
+
+// Only known endpoints get their own metrics, so that clients cannot make the metric count grow
+static const EndpointMetrics&
+getEndpointMetrics(std::string_view requestPath)
+{
+	static const std::unordered_map<std::string_view, EndpointMetrics> endpointMetrics {[]
+	{
+		std::unordered_map<std::string_view, EndpointMetrics> res;
+		for (const auto& [endpoint, entryPoint] : requestEntryPoints)
+			res.emplace(endpoint, createEndpointMetrics(endpoint));
+		for (const auto& [endpoint, handler] : mediaRetrievalHandlers)
+			res.emplace(endpoint, createEndpointMetrics(endpoint));
+
+		return res;
+	}()};
+	static const EndpointMetrics unknownEndpointMetrics {createEndpointMetrics("unknown")};
+
+	auto it {endpointMetrics.find(requestPath)};
+	return it != std::cend(endpointMetrics) ? it->second : unknownEndpointMetrics;
+}
+
+
+// Endpoints not listed here are cheap enough to be always served
+static RequestCost
+getRequestCost(std::string_view requestPath)
+{
+	static const std::unordered_map<std::string_view, RequestCost> requestCosts
+	{
+		{"getIndexes",			RequestCost::Browsing},
+		{"getMusicDirectory",	RequestCost::Browsing},
+		{"getArtists",			RequestCost::Browsing},
+		{"getSimilarSongs",		RequestCost::Browsing},
+		{"getSimilarSongs2",	RequestCost::Browsing},
+		{"getAlbumList",		RequestCost::Browsing},
+		{"getAlbumList2",		RequestCost::Browsing},
+		{"getRandomSongs",		RequestCost::Browsing},
+		{"getSongsByGenre",		RequestCost::Browsing},
+		{"getStarred",			RequestCost::Browsing},
+		{"getStarred2",			RequestCost::Browsing},
+		{"search2",				RequestCost::Browsing},
+		{"search3",				RequestCost::Browsing},
+		// covers are not limited: clients request them in bursts, and they are mostly served from the caches
+		{"stream",				RequestCost::Media},
+		{"download",			RequestCost::Media},
+	};
+
+	auto it {requestCosts.find(requestPath)};
+	return it != std::cend(requestCosts) ? it->second : RequestCost::Interactive;
+}
+
+// Endpoints cheap enough to be always handled by the Wt threads, even if there are workers
+static
+bool
+isHandledInline(std::string_view requestPath)
+{
+	return requestPath == "ping" || requestPath == "getLicense";
+}
+
+// Request handled by a worker thread, the response is written by a continuation of the request once done
+struct AsyncResponse
+{
+	std::size_t								requestId;
+	std::string								requestPath;
+	const EndpointMetrics&					endpointMetrics;
+	std::chrono::steady_clock::time_point	start;
+	std::optional<ConcurrencyLimiter::Slot>	concurrencySlot;	// released as soon as the handler is done
+	bool									acceptsGzip;
+
+	// set by the worker
+	std::string								mimeType;
+	std::string								body;
+	std::string								gzipBody;	// empty if not worth compressing, or not accepted by the client
+	std::optional<std::string>				entityTag;
+	std::shared_ptr<Image::IEncodedImage>	cover;	// getCoverArt only
+};
+
+// gzipBody is empty if the body is not worth compressing
+static
+void
+writeBody(const Wt::Http::Request& request, Wt::Http::Response& response, std::string_view body, std::string_view gzipBody)
+{
+	if (!gzipBody.empty())
+	{
+		response.addHeader("Vary", "Accept-Encoding");
+		if (isGzipAccepted(request.headerValue("Accept-Encoding")))
+		{
+			response.addHeader("Content-Encoding", "gzip");
+			response.out().write(gzipBody.data(), gzipBody.size());
+			return;
+		}
+	}
+
+	response.out().write(body.data(), body.size());
+}
+
+static
+void
+writeAsyncResponse(const Wt::Http::Request& request, Wt::Http::Response& response, const AsyncResponse& asyncResponse)
+{
+	if (asyncResponse.cover)
+	{
+		writeCoverArt(request, response, *asyncResponse.cover);
+	}
+	else
+	{
+		if (asyncResponse.entityTag)
+		{
+			response.addHeader("ETag", *asyncResponse.entityTag);
+			response.addHeader("Cache-Control", "private, no-cache");
+		}
+
+		writeBody(request, response, asyncResponse.body, asyncResponse.gzipBody);
+		response.setMimeType(asyncResponse.mimeType);
+	}
+
+	asyncResponse.endpointMetrics.duration.observe(std::chrono::duration_cast<Metrics::Histogram::Duration>(std::chrono::steady_clock::now() - asyncResponse.start));
+	LMS_LOG(API_SUBSONIC, DEBUG) << "Request " << asyncResponse.requestId << " '" << asyncResponse.requestPath << "' handled!";
+}
 
 void
 SubsonicResource::handleRequest(const Wt::Http::Request &request, Wt::Http::Response &response)
 {
+	// The worker is done with this request: just write its response
+	if (Wt::Http::ResponseContinuation* continuation {request.continuation()})
+	{
+		const Wt::cpp17::any data {continuation->data()};
+		if (const auto* asyncResponse {Wt::cpp17::any_cast<std::shared_ptr<AsyncResponse>>(&data)})
+		{
+			writeAsyncResponse(request, response, **asyncResponse);
+			return;
+		}
+	}
+
 	static std::atomic<std::size_t> curRequestId {};
 
 	const std::size_t requestId {curRequestId++};
 
-	LMS_LOG(API_SUBSONIC, DEBUG) << "Handling request " << requestId << " '" << request.pathInfo() << "', continuation = " << (request.continuation() ? "true" : "false") << ", params = " << parameterMapToDebugString(request.getParameterMap());
+	const std::string pathInfo {request.pathInfo()};
+
+	LMS_LOG(API_SUBSONIC, DEBUG) << "Handling request " << requestId << " '" << pathInfo << "', continuation = " << (request.continuation() ? "true" : "false") << ", params = " << parameterMapToDebugString(request.getParameterMap());
 
-	std::string requestPath {request.pathInfo()};
+	std::string_view requestPath {pathInfo};
 	if (StringUtils::stringEndsWith(requestPath, ".view"))
-		requestPath.resize(requestPath.length() - 5);
+		requestPath.remove_suffix(5);
+
+	// continuations are parts of the same streaming request
+	const EndpointMetrics& endpointMetrics {getEndpointMetrics(requestPath)};
+	if (!request.continuation())
+		endpointMetrics.requests.add();
+	Metrics::ScopedTimer requestTimer {endpointMetrics.duration};
+	const Profiling::ScopedLabel profilingLabel {endpointMetrics.name};
+
+	std::optional<Tracing::ScopedTrace> trace;
+	if (!request.continuation())
+	{
+		trace.emplace(std::string {requestPath}, _tracingSettings, [requestId](const Tracing::Trace& trace)
+		{
+			LMS_LOG(API_SUBSONIC, WARNING) << "Slow request " << requestId << " " << trace;
+		});
+	}
 
 	// Optional parameters
-	const ResponseFormat format {getParameterAs<std::string>(request.getParameterMap(), "f").value_or("xml") == "json" ? ResponseFormat::json : ResponseFormat::xml};
+	const ResponseFormat format {getParameterAs<std::string_view>(request.getParameterMap(), "f").value_or("xml") == "json" ? ResponseFormat::json : ResponseFormat::xml};
 
 	ProtocolVersion protocolVersion {defaultServerProtocolVersion};
 
 	try
 	{
-		// We need to parse client a soon as possible to make sure to answer with the right protocol version
-		protocolVersion = getServerProtocolVersion(getMandatoryParameterAs<std::string>(request.getParameterMap(), "c"));
-		RequestContext requestContext {buildRequestContext(request)};
+		RequestContext requestContext {[&]
+		{
+			const Tracing::ScopedSpan span {"auth"};
+			return buildRequestContext(request, requestPath, format, protocolVersion);
+		}()};
+
+		// continuations are parts of already accepted requests
+		std::optional<ConcurrencyLimiter::Slot> concurrencySlot;
+		if (!request.continuation())
+		{
+			concurrencySlot = _concurrencyLimiter.tryAcquire(getRequestCost(requestPath), requestContext.userId);
+			if (!concurrencySlot)
+			{
+				endpointMetrics.rejections.add();
+				LMS_LOG(API_SUBSONIC, DEBUG) << "Request " << requestId << " '" << requestPath << "' rejected: too many concurrent requests";
+
+				// Not handled as the other errors: cheap, and not worth an error log
+				response.setStatus(503);
+				response.addHeader("Retry-After", std::to_string(_retryAfter.count()));
+				Response resp {Response::createFailedResponse(protocolVersion, ServerBusyGenericError {})};
+				resp.write(response.out(), format);
+				response.setMimeType(ResponseFormatToMimeType(format));
+				return;
+			}
+		}
+
+		// Runs work on the worker threads, the Wt thread is released until the response is ready
+		auto dispatchToWorkers {[&](std::function<void(RequestContext&, AsyncResponse&)> work)
+		{
+			requestTimer.dismiss();
+			auto asyncResponse {std::make_shared<AsyncResponse>(AsyncResponse {requestId, std::string {requestPath}, endpointMetrics, requestTimer.getStart(), std::move(concurrencySlot), isGzipAccepted(request.headerValue("Accept-Encoding"))})};
+
+			Wt::Http::ResponseContinuation* continuation {response.createContinuation()};
+			continuation->setData(asyncResponse);
+			continuation->waitForMoreData();
+
+			boost::asio::post(_workerIOContext, [this, requestContext, protocolVersion, format, work, asyncResponse, continuation]
+			{
+				const Profiling::ScopedLabel profilingLabel {asyncResponse->endpointMetrics.name};
+
+				// Database sessions are per thread
+				RequestContext workerRequestContext {requestContext.parameters, _db.getTLSSession(), requestContext.userId, requestContext.clientInfo,
+					requestContext.serverProtocolVersion, requestContext.responseFormat, requestContext.playQueueStore, requestContext.artistIndexCache, requestContext.shuffler, requestContext.entityNodeCache, requestContext.hlsTokenStore};
+
+				auto setFailedResponse {[&](const Error& e)
+				{
+					asyncResponse->endpointMetrics.errors.add();
+					LMS_LOG(API_SUBSONIC, ERROR) << "Error while processing request '" << asyncResponse->requestPath << "'"
+						<< ", params = [" << parameterMapToDebugString(requestContext.parameters) << "]"
+						<< ", code = " << static_cast<int>(e.getCode()) << ", msg = '" << e.getMessage() << "'";
+
+					Response resp {Response::createFailedResponse(protocolVersion, e)};
+					std::ostringstream oss;
+					resp.write(oss, format);
+
+					asyncResponse->cover.reset();
+					asyncResponse->entityTag.reset();
+					asyncResponse->body = oss.str();
+					asyncResponse->gzipBody.clear();
+					asyncResponse->mimeType = ResponseFormatToMimeType(format);
+				}};
+
+				try
+				{
+					work(workerRequestContext, *asyncResponse);
+				}
+				catch (const Error& e)
+				{
+					setFailedResponse(e);
+				}
+				catch (const std::exception& e)
+				{
+					setFailedResponse(InternalErrorGenericError {e.what()});
+				}
+
+				asyncResponse->concurrencySlot.reset();
+				continuation->haveMoreData();
+			});
+		}};
 
 		auto itEntryPoint {requestEntryPoints.find(requestPath)};
 		if (itEntryPoint != requestEntryPoints.end())
@@ -1956,19 +2591,163 @@ SubsonicResource::handleRequest(const Wt::Http::Request &request, Wt::Http::Resp
 
 			checkUserTypeIsAllowed(requestContext, itEntryPoint->second.allowedUserTypes);
 
-			Response resp {(itEntryPoint->second.func)(requestContext)};
+			std::optional<std::string> responseCacheKey;
+			ResponseCache::Version responseCacheVersion;
+			if (isResponseCacheable(requestPath, requestContext.parameters))
+			{
+				// Version must be retrieved before building the response
+				responseCacheVersion = getResponseCacheVersion();
+				responseCacheKey = computeResponseCacheKey(requestContext, requestPath);
+				if (const std::shared_ptr<const ResponseCache::Entry> entry {_responseCache.get(*responseCacheKey, responseCacheVersion)})
+				{
+					if (entry->entityTag)
+					{
+						response.addHeader("ETag", *entry->entityTag);
+						response.addHeader("Cache-Control", "private, no-cache");
+						if (isEntityTagMatching(request, *entry->entityTag))
+						{
+							response.setStatus(304);
+							LMS_LOG(API_SUBSONIC, DEBUG) << "Request " << requestId << " '" << requestPath << "' not modified (cached)!";
+							return;
+						}
+					}
+
+					writeBody(request, response, entry->body, entry->gzipBody);
+					response.setMimeType(entry->mimeType);
+
+					LMS_LOG(API_SUBSONIC, DEBUG) << "Request " << requestId << " '" << requestPath << "' handled (cached)!";
+					return;
+				}
+			}
 
-			resp.write(response.out(), format);
-			response.setMimeType(ResponseFormatToMimeType(format));
+			std::optional<std::string> entityTag;
+			if (isCacheable(requestPath, requestContext.parameters))
+			{
+				entityTag = computeEntityTag(requestContext, requestPath);
+				if (isEntityTagMatching(request, *entityTag))
+				{
+					response.setStatus(304);
+					response.addHeader("ETag", *entityTag);
+
+					LMS_LOG(API_SUBSONIC, DEBUG) << "Request " << requestId << " '" << requestPath << "' not modified!";
+					return;
+				}
+			}
+
+			if (_workerRunner && !isHandledInline(requestPath))
+			{
+				dispatchToWorkers([this, &entryPoint = itEntryPoint->second, format, entityTag, responseCacheKey, responseCacheVersion](RequestContext& context, AsyncResponse& asyncResponse)
+				{
+					Response resp {entryPoint.func(context)};
+
+					std::ostringstream oss;
+					resp.write(oss, format);
+					asyncResponse.body = oss.str();
+					asyncResponse.mimeType = ResponseFormatToMimeType(format);
+					asyncResponse.entityTag = entityTag;
+
+					// Cached responses are compressed once for all the clients
+					const bool compress {isCompressible(asyncResponse.body.size()) && (asyncResponse.acceptsGzip || responseCacheKey)};
+					if (compress)
+						asyncResponse.gzipBody = compressGzip(asyncResponse.body);
+
+					if (responseCacheKey)
+					{
+						auto entry {std::make_shared<ResponseCache::Entry>()};
+						entry->mimeType = asyncResponse.mimeType;
+						entry->entityTag = entityTag;
+						entry->body = asyncResponse.body;
+						entry->gzipBody = asyncResponse.gzipBody;
+
+						_responseCache.put(*responseCacheKey, responseCacheVersion, std::move(entry));
+					}
+				});
+
+				LMS_LOG(API_SUBSONIC, DEBUG) << "Request " << requestId << " '" << requestPath << "' dispatched to the workers";
+				return;
+			}
+
+			Response resp {[&]
+			{
+				const Tracing::ScopedSpan span {"handler"};
+				return (itEntryPoint->second.func)(requestContext);
+			}()};
+
+			const Tracing::ScopedSpan serializationSpan {"serialization"};
+
+			if (entityTag)
+			{
+				response.addHeader("ETag", *entityTag);
+				response.addHeader("Cache-Control", "private, no-cache");
+			}
+
+			if (responseCacheKey)
+			{
+				auto entry {std::make_shared<ResponseCache::Entry>()};
+				entry->mimeType = ResponseFormatToMimeType(format);
+				entry->entityTag = entityTag;
+				{
+					std::ostringstream oss;
+					resp.write(oss, format);
+					entry->body = oss.str();
+				}
+				if (isCompressible(entry->body.size()))
+					entry->gzipBody = compressGzip(entry->body);
+
+				writeBody(request, response, entry->body, entry->gzipBody);
+				response.setMimeType(entry->mimeType);
+
+				_responseCache.put(*responseCacheKey, responseCacheVersion, std::move(entry));
+			}
+			else if (_compressionMinSize && isGzipAccepted(request.headerValue("Accept-Encoding")))
+			{
+				// Size must be known to decide whether to compress
+				std::ostringstream oss;
+				resp.write(oss, format);
+				const std::string body {oss.str()};
+
+				if (isCompressible(body.size()))
+				{
+					response.addHeader("Vary", "Accept-Encoding");
+					response.addHeader("Content-Encoding", "gzip");
+					writeGzip(body, response.out());
+				}
+				else
+				{
+					response.out() << body;
+				}
+				response.setMimeType(ResponseFormatToMimeType(format));
+			}
+			else
+			{
+				resp.write(response.out(), format);
+				response.setMimeType(ResponseFormatToMimeType(format));
+			}
 
 			LMS_LOG(API_SUBSONIC, DEBUG) << "Request " << requestId << " '" << requestPath << "' handled!";
 			return;
 		}
 
+		// Covers may have to be decoded, resized and encoded again
+		if (_workerRunner && requestPath == "getCoverArt")
+		{
+			const Image::EncodingFormat coverFormat {Cover::selectEncodingFormat(request.headerValue("Accept"))};
+			dispatchToWorkers([coverFormat](RequestContext& context, AsyncResponse& asyncResponse)
+			{
+				asyncResponse.cover = getCoverArt(context, coverFormat);
+			});
+
+			LMS_LOG(API_SUBSONIC, DEBUG) << "Request " << requestId << " '" << requestPath << "' dispatched to the workers";
+			return;
+		}
+
 		auto itStreamHandler {mediaRetrievalHandlers.find(requestPath)};
 		if (itStreamHandler != mediaRetrievalHandlers.end())
 		{
-			itStreamHandler->second(requestContext, request, response);
+			{
+				const Tracing::ScopedSpan span {"handler"};
+				itStreamHandler->second(requestContext, request, response);
+			}
 			LMS_LOG(API_SUBSONIC, DEBUG) << "Request " << requestId  << " '" << requestPath << "' handled!";
 			return;
 		}
@@ -1978,6 +2757,8 @@ SubsonicResource::handleRequest(const Wt::Http::Request &request, Wt::Http::Resp
 	}
 	catch (const Error& e)
 	{
+		endpointMetrics.errors.add();
+
 		LMS_LOG(API_SUBSONIC, ERROR) << "Error while processing request '" << requestPath << "'"
 			<< ", params = [" << parameterMapToDebugString(request.getParameterMap()) << "]"
 			<< ", code = " << static_cast<int>(e.getCode()) << ", msg = '" << e.getMessage() << "'";
@@ -2014,12 +2795,15 @@ SubsonicResource::checkProtocolVersion(ProtocolVersion client, ProtocolVersion s
 }
 
 ClientInfo
-SubsonicResource::getClientInfo(const Wt::Http::ParameterMap& parameters)
+SubsonicResource::getClientInfo(const Wt::Http::ParameterMap& parameters, ProtocolVersion& serverProtocolVersion) const
 {
 	ClientInfo res;
 
 	// Mandatory parameters
 	res.name = getMandatoryParameterAs<std::string>(parameters, "c");
+	// We need to parse client a soon as possible to make sure to answer with the right protocol version
+	serverProtocolVersion = getServerProtocolVersion(res.name);
+
 	res.version = getMandatoryParameterAs<ProtocolVersion>(parameters, "v");
 	res.user = getMandatoryParameterAs<std::string>(parameters, "u");
 	res.password = decodePasswordIfNeeded(getMandatoryParameterAs<std::string>(parameters, "p"));
@@ -2028,13 +2812,28 @@ SubsonicResource::getClientInfo(const Wt::Http::ParameterMap& parameters)
 }
 
 RequestContext
-SubsonicResource::buildRequestContext(const Wt::Http::Request& request)
+SubsonicResource::buildRequestContext(const Wt::Http::Request& request, std::string_view requestPath, ResponseFormat responseFormat, ProtocolVersion& serverProtocolVersion)
 {
 	const Wt::Http::ParameterMap& parameters {request.getParameterMap()};
-	const ClientInfo clientInfo {getClientInfo(parameters)};
+
+	// Requests issued from HLS playlists carry a token scoped to the streamed track instead of the credentials
+	if (requestPath == "hls" || requestPath == "hls.m3u8" || requestPath == "hlsSegment")
+	{
+		if (const std::optional<std::string> hlsToken {getParameterAs<std::string>(parameters, "hlsToken")})
+		{
+			const std::optional<HlsTokenStore::Grant> grant {_hlsTokenStore.findGrant(*hlsToken, getMandatoryParameterAs<Database::TrackId>(parameters, "id"))};
+			if (!grant)
+				throw UserNotAuthorizedError {};
+
+			serverProtocolVersion = getServerProtocolVersion(grant->clientInfo.name);
+			return {parameters, _db.getTLSSession(), grant->userId, grant->clientInfo, serverProtocolVersion, responseFormat, _playQueueStore, _artistIndexCache, _shuffler, _entityNodeCache, _hlsTokenStore};
+		}
+	}
+
+	const ClientInfo clientInfo {getClientInfo(parameters, serverProtocolVersion)};
 	const Database::UserId userId {authenticateUser(request, clientInfo)};
 
-	return {parameters, _db.getTLSSession(), userId, clientInfo, getServerProtocolVersion(clientInfo.name)};
+	return {parameters, _db.getTLSSession(), userId, clientInfo, serverProtocolVersion, responseFormat, _playQueueStore, _artistIndexCache, _shuffler, _entityNodeCache, _hlsTokenStore};
 }
 
 Database::UserId
@@ -2062,6 +2861,8 @@ SubsonicResource::authenticateUser(const Wt::Http::Request& request, const Clien
 				throw WrongUsernameOrPasswordError {};
 			case Auth::IPasswordService::CheckResult::State::Throttled:
 				throw LoginThrottledGenericError {};
+			case Auth::IPasswordService::CheckResult::State::Busy:
+				throw ServerBusyGenericError {};
 		}
 	}
 
@@ -18,15 +18,28 @@
  */
 #pragma once
 
+#include <chrono>
+#include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
 
+#include <boost/asio/io_service.hpp>
 #include <Wt/WResource.h>
 #include <Wt/Http/Response.h>
 
 #include "services/database/Types.hpp"
+#include "utils/IOContextRunner.hpp"
+#include "utils/Tracing.hpp"
+#include "ArtistIndexCache.hpp"
 #include "ClientInfo.hpp"
+#include "ConcurrencyLimiter.hpp"
+#include "EntityNodeCache.hpp"
+#include "HlsTokenStore.hpp"
+#include "PlayQueueStore.hpp"
 #include "RequestContext.hpp"
+#include "ResponseCache.hpp"
+#include "Shuffler.hpp"
 
 namespace Database
 {
@@ -40,18 +53,35 @@ namespace API::Subsonic
 	{
 		public:
 			SubsonicResource(Database::Db& db);
+			~SubsonicResource();
 
 		private:
 			void handleRequest(const Wt::Http::Request &request, Wt::Http::Response &response) override;
 			ProtocolVersion getServerProtocolVersion(const std::string& clientName) const;
+			bool isCompressible(std::size_t bodySize) const { return _compressionMinSize && bodySize >= _compressionMinSize; }
 
 			static void checkProtocolVersion(ProtocolVersion client, ProtocolVersion server);
-			ClientInfo getClientInfo(const Wt::Http::ParameterMap& parameters);
-			RequestContext buildRequestContext(const Wt::Http::Request& request);
+			// serverProtocolVersion is set as soon as the client name is known, to report errors using the right protocol version
+			ClientInfo getClientInfo(const Wt::Http::ParameterMap& parameters, ProtocolVersion& serverProtocolVersion) const;
+			RequestContext buildRequestContext(const Wt::Http::Request& request, std::string_view requestPath, ResponseFormat responseFormat, ProtocolVersion& serverProtocolVersion);
 			Database::UserId authenticateUser(const Wt::Http::Request& request, const ClientInfo& clientInfo);
 
 			const std::unordered_map<std::string, ProtocolVersion> _serverProtocolVersionsByClient;
 			Database::Db& _db;
+			ResponseCache _responseCache;
+			PlayQueueStore _playQueueStore;
+			ArtistIndexCache _artistIndexCache;
+			Shuffler _shuffler;
+			EntityNodeCache _entityNodeCache;
+			HlsTokenStore _hlsTokenStore;
+			const Tracing::Settings _tracingSettings;
+			ConcurrencyLimiter _concurrencyLimiter;
+			const std::chrono::seconds _retryAfter;
+			const std::size_t _compressionMinSize;	// 0 if responses are never compressed
+
+			// Handlers are run here if set, the Wt threads only parse the requests and write the responses
+			boost::asio::io_service _workerIOContext;
+			std::optional<IOContextRunner> _workerRunner;
 	};
 
 } // namespace
@@ -19,13 +19,9 @@
 
 #include "SubsonicResponse.hpp"
 
-#include <Wt/Json/Array.h>
-#include <Wt/Json/Object.h>
-#include <Wt/Json/Value.h>
-#include <Wt/Json/Serializer.h>
-
-#include <boost/property_tree/json_parser.hpp>
-#include <boost/property_tree/xml_parser.hpp>
+#include <algorithm>
+#include <array>
+#include <type_traits>
 
 #include "utils/Exception.hpp"
 #include "utils/String.hpp"
@@ -34,6 +30,103 @@
 namespace API::Subsonic
 {
 
+namespace
+{
+	// Writes the unescaped parts in chunks
+	template <typename EscapeFunc>
+	void
+	writeEscaped(std::ostream& os, std::string_view str, EscapeFunc escapeFunc)
+	{
+		std::size_t begin {};
+		for (std::size_t i {}; i < str.size(); ++i)
+		{
+			const char* escaped {escapeFunc(str[i])};
+			if (!escaped)
+				continue;
+
+			os.write(str.data() + begin, i - begin);
+			os << escaped;
+			begin = i + 1;
+		}
+		os.write(str.data() + begin, str.size() - begin);
+	}
+
+	const char*
+	escapeXMLChar(char c)
+	{
+		switch (c)
+		{
+			case '&': return "&amp;";
+			case '<': return "&lt;";
+			case '>': return "&gt;";
+			case '"': return "&quot;";
+			case '\'': return "&apos;";
+		}
+		return nullptr;
+	}
+
+	const char*
+	escapeJSONChar(char c)
+	{
+		static constexpr std::array<const char*, 0x20> controlChars
+		{
+			"\\u0000", "\\u0001", "\\u0002", "\\u0003", "\\u0004", "\\u0005", "\\u0006", "\\u0007",
+			"\\b", "\\t", "\\n", "\\u000b", "\\f", "\\r", "\\u000e", "\\u000f",
+			"\\u0010", "\\u0011", "\\u0012", "\\u0013", "\\u0014", "\\u0015", "\\u0016", "\\u0017",
+			"\\u0018", "\\u0019", "\\u001a", "\\u001b", "\\u001c", "\\u001d", "\\u001e", "\\u001f",
+		};
+
+		switch (c)
+		{
+			case '"': return "\\\"";
+			case '\\': return "\\\\";
+		}
+
+		const unsigned char uc {static_cast<unsigned char>(c)};
+		return uc < controlChars.size() ? controlChars[uc] : nullptr;
+	}
+
+	void
+	writeJSONString(std::ostream& os, std::string_view str)
+	{
+		os << '"';
+		writeEscaped(os, str, escapeJSONChar);
+		os << '"';
+	}
+
+	template <typename Value>
+	void
+	writeXMLValue(std::ostream& os, const Value& value)
+	{
+		std::visit([&](const auto& v)
+		{
+			using T = std::decay_t<decltype(v)>;
+			if constexpr (std::is_same_v<T, std::string>)
+				writeEscaped(os, v, escapeXMLChar);
+			else if constexpr (std::is_same_v<T, bool>)
+				os << (v ? "true" : "false");
+			else
+				os << v;
+		}, value);
+	}
+
+	template <typename Value>
+	void
+	writeJSONValue(std::ostream& os, const Value& value)
+	{
+		std::visit([&](const auto& v)
+		{
+			using T = std::decay_t<decltype(v)>;
+			if constexpr (std::is_same_v<T, std::string>)
+				writeJSONString(os, v);
+			else if constexpr (std::is_same_v<T, bool>)
+				os << (v ? "true" : "false");
+			else
+				os << v;
+		}, value);
+	}
+}
+
 std::string
 ResponseFormatToMimeType(ResponseFormat format)
 {
@@ -65,42 +158,59 @@ Response::Node::setValue(long long value)
 }
 
 void
-Response::Node::setAttribute(std::string_view key, std::string_view value)
+Response::Node::setAttribute(Key key, std::string_view value)
 {
-	_attributes[std::string {key}] = std::string {value};
+	setAttributeValue(key, std::string {value});
 }
 
 void
-Response::Node::addChild(const std::string& key, Node node)
+Response::Node::setAttributeValue(Key key, Value value)
+{
+	auto itAttribute {std::find_if(std::begin(_attributes), std::end(_attributes), [&](const auto& attribute) { return attribute.first == key; })};
+	if (itAttribute != std::end(_attributes))
+		itAttribute->second = std::move(value);
+	else
+		_attributes.emplace_back(key, std::move(value));
+}
+
+std::vector<Response::Node>&
+Response::Node::getOrCreateChildren(Children& children, Key key)
+{
+	auto itChildren {std::find_if(std::begin(children), std::end(children), [&](const auto& keyChildren) { return keyChildren.first == key; })};
+	if (itChildren == std::end(children))
+		return children.emplace_back(key, std::vector<Node> {}).second;
+
+	return itChildren->second;
+}
+
+void
+Response::Node::addChild(Key key, Node node)
 {
 	if (_value)
 		throw LmsException {"Node already has a value"};
 
-	_children[key].emplace_back(std::move(node));
+	getOrCreateChildren(_children, key).emplace_back(std::move(node));
 }
 
 void
-Response::Node::addArrayChild(const std::string& key, Node node)
+Response::Node::addArrayChild(Key key, Node node)
 {
 	if (_value)
 		throw LmsException {"Node already has a value"};
 
-	_childrenArrays[key].emplace_back(std::move(node));
+	getOrCreateChildren(_childrenArrays, key).emplace_back(std::move(node));
 }
 
-
 Response::Node&
-Response::Node::createChild(const std::string& key)
+Response::Node::createChild(Key key)
 {
-	_children[key].emplace_back();
-	return _children[key].back();
+	return getOrCreateChildren(_children, key).emplace_back();
 }
 
 Response::Node&
-Response::Node::createArrayChild(const std::string& key)
+Response::Node::createArrayChild(Key key)
 {
-	_childrenArrays[key].emplace_back();
-	return _childrenArrays[key].back();
+	return getOrCreateChildren(_childrenArrays, key).emplace_back();
 }
 
 void
@@ -137,22 +247,29 @@ Response::createFailedResponse(ProtocolVersion protocolVersion, const Error& err
 	return response;
 }
 
+Response::Node&
+Response::getResponseNode()
+{
+	// "subsonic-response", always created first
+	return _root._children.front().second.front();
+}
+
 void
-Response::addNode(const std::string& key, Node node)
+Response::addNode(Key key, Node node)
 {
-	return _root._children["subsonic-response"].front().addChild(key, std::move(node));
+	return getResponseNode().addChild(key, std::move(node));
 }
 
 Response::Node&
-Response::createNode(const std::string& key)
+Response::createNode(Key key)
 {
-	return _root._children["subsonic-response"].front().createChild(key);
+	return getResponseNode().createChild(key);
 }
 
 Response::Node&
-Response::createArrayNode(const std::string& key)
+Response::createArrayNode(Key key)
 {
-	return _root._children["subsonic-response"].front().createArrayChild(key);
+	return getResponseNode().createArrayChild(key);
 }
 
 void
@@ -172,108 +289,116 @@ Response::write(std::ostream& os, ResponseFormat format)
 void
 Response::writeXML(std::ostream& os)
 {
-	std::function<boost::property_tree::ptree(const Response::Node&)> nodeToPropertyTree = [&] (const Response::Node& node)
+	os << R"(<?xml version="1.0" encoding="utf-8"?>)" << '\n';
+
+	for (const auto& [key, childNodes] : _root._children)
 	{
-		boost::property_tree::ptree res;
+		for (const Node& childNode : childNodes)
+			writeXMLNode(os, key, childNode);
+	}
+}
 
-		for (auto itAttribute : node._attributes)
-		{
-			if (std::holds_alternative<std::string>(itAttribute.second))
-				res.put("<xmlattr>." + itAttribute.first, std::get<std::string>(itAttribute.second));
-			else if (std::holds_alternative<bool>(itAttribute.second))
-				res.put("<xmlattr>." + itAttribute.first, std::get<bool>(itAttribute.second));
-			else if (std::holds_alternative<long long>(itAttribute.second))
-				res.put("<xmlattr>." + itAttribute.first, std::get<long long>(itAttribute.second));
-		}
+void
+Response::writeXMLNode(std::ostream& os, Key key, const Node& node)
+{
+	os << '<' << key;
+	for (const auto& [name, value] : node._attributes)
+	{
+		os << ' ' << name << "=\"";
+		writeXMLValue(os, value);
+		os << '"';
+	}
 
-		if (node._value)
+	const bool hasValue {node._value && !(std::holds_alternative<std::string>(*node._value) && std::get<std::string>(*node._value).empty())};
+	if (!hasValue && node._children.empty() && node._childrenArrays.empty())
+	{
+		os << "/>";
+		return;
+	}
+
+	os << '>';
+	if (hasValue)
+	{
+		writeXMLValue(os, *node._value);
+	}
+	else
+	{
+		for (const auto& [childKey, childNodes] : node._children)
 		{
-			const auto& value {*node._value};
-
-			if (std::holds_alternative<std::string>(value))
-				res.put_value(std::get<std::string>(value));
-			else if (std::holds_alternative<bool>(value))
-				res.put_value(std::get<bool>(value));
-			else if (std::holds_alternative<long long>(value))
-				res.put_value(std::get<long long>(value));
+			for (const Node& childNode : childNodes)
+				writeXMLNode(os, childKey, childNode);
 		}
-		else
-		{
-			for (auto itChildNode : node._children)
-			{
-				for (const Response::Node& childNode : itChildNode.second)
-					res.add_child(itChildNode.first, nodeToPropertyTree(childNode));
-			}
-
-			for (auto itChildArrayNode : node._childrenArrays)
-			{
-				const std::vector<Response::Node>& childArrayNodes {itChildArrayNode.second};
 
-				for (const Response::Node& childNode : childArrayNodes )
-					res.add_child(itChildArrayNode.first, nodeToPropertyTree(childNode));
-			}
+		for (const auto& [childKey, childNodes] : node._childrenArrays)
+		{
+			for (const Node& childNode : childNodes)
+				writeXMLNode(os, childKey, childNode);
 		}
-
-		return res;
-	};
-
-	boost::property_tree::ptree root {nodeToPropertyTree(_root)};
-	boost::property_tree::write_xml(os, root);
+	}
+	os << "</" << key << '>';
 }
 
 void
 Response::writeJSON(std::ostream& os)
 {
-	namespace Json = Wt::Json;
+	writeJSONNode(os, _root);
+}
 
-	std::function<Json::Object(const Response::Node&)> nodeToJsonObject = [&] (const Response::Node& node)
+void
+Response::writeJSONNode(std::ostream& os, const Node& node)
+{
+	bool first {true};
+	auto writeKey {[&](std::string_view key)
 	{
-		Json::Object res;
+		if (!first)
+			os << ',';
+		first = false;
 
-		auto valueToJsonValue {[](const Node::Value& value) -> Json::Value
-		{
-			if (std::holds_alternative<std::string>(value))
-				return Json::Value {std::get<std::string>(value)};
-			else if (std::holds_alternative<bool>(value))
-				return Json::Value {std::get<bool>(value)};
-			else if (std::holds_alternative<long long>(value))
-				return Json::Value {std::get<long long>(value)};
+		writeJSONString(os, key);
+		os << ':';
+	}};
 
-			throw LmsException("Unexpected value type");
-		}};
+	os << '{';
 
-		for (auto itAttribute : node._attributes)
-			res[itAttribute.first] = valueToJsonValue(itAttribute.second);
+	for (const auto& [name, value] : node._attributes)
+	{
+		writeKey(name);
+		writeJSONValue(os, value);
+	}
 
-		if (node._value)
+	if (node._value)
+	{
+		writeKey("value");
+		writeJSONValue(os, *node._value);
+	}
+	else
+	{
+		for (const auto& [childKey, childNodes] : node._children)
 		{
-			res["value"] = valueToJsonValue(*node._value);
+			// Objects: only one child per key
+			if (childNodes.empty())
+				continue;
+
+			writeKey(childKey);
+			writeJSONNode(os, childNodes.back());
 		}
-		else
+
+		for (const auto& [childKey, childNodes] : node._childrenArrays)
 		{
-			for (auto itChildNode : node._children)
-			{
-				for (const Response::Node& childNode : itChildNode.second)
-					res[itChildNode.first] = nodeToJsonObject(childNode);
-			}
+			writeKey(childKey);
 
-			for (auto itChildArrayNode : node._childrenArrays)
+			os << '[';
+			for (std::size_t i {}; i < childNodes.size(); ++i)
 			{
-				const std::vector<Response::Node>& childArrayNodes {itChildArrayNode .second};
-
-				Json::Array array;
-				for (const Response::Node& childNode : childArrayNodes )
-					array.emplace_back(nodeToJsonObject(childNode));
-
-				res[itChildArrayNode.first] = std::move(array);
+				if (i > 0)
+					os << ',';
+				writeJSONNode(os, childNodes[i]);
 			}
+			os << ']';
 		}
+	}
 
-		return res;
-	};
-
-	Json::Object root {nodeToJsonObject(_root)};
-	os << Json::serialize(root);
+	os << '}';
 }
 
 } // namespace
@@ -18,14 +18,14 @@
  */
 #pragma once
 
-#include <map>
 #include <optional>
+#include <ostream>
 #include <string>
 #include <string_view>
 #include <variant>
 #include <vector>
 
-#include "RequestContext.hpp"
+#include "ProtocolVersion.hpp"
 
 namespace API::Subsonic
 {
@@ -145,6 +145,11 @@ class UnknownEntryPointGenericError : public GenericError
 	std::string getMessage() const override { return "Unknown API method"; }
 };
 
+class ServerBusyGenericError : public GenericError
+{
+	std::string getMessage() const override { return "Server busy, please retry later"; }
+};
+
 class PasswordTooWeakGenericError : public GenericError
 {
 	std::string getMessage() const override { return "Password too weak"; }
@@ -179,39 +184,46 @@ class BadParameterGenericError : public GenericError
 class Response
 {
 	public:
+		// Keys are not copied: they must outlive the response (use string literals)
+		using Key = std::string_view;
+
 		class Node
 		{
 			public:
-				void setAttribute(std::string_view key, std::string_view value);
+				void setAttribute(Key key, std::string_view value);
 
 				template <typename T, std::enable_if_t<std::is_arithmetic<T>::value>* = nullptr>
-				void setAttribute(std::string_view key, T value)
+				void setAttribute(Key key, T value)
 				{
 					if constexpr (std::is_same<bool, T>::value)
-						_attributes[std::string {key}] = value;
+						setAttributeValue(key, value);
 					else
-						_attributes[std::string {key}] = static_cast<long long>(value);
+						setAttributeValue(key, static_cast<long long>(value));
 				}
 
 				// A Node has either a value or some children
 				void setValue(std::string_view value);
 				void setValue(long long value);
-				Node& createChild(const std::string& key);
-				Node& createArrayChild(const std::string& key);
+				Node& createChild(Key key);
+				Node& createArrayChild(Key key);
 
-				void addChild(const std::string& key, Node node);
-				void addArrayChild(const std::string& key, Node node);
+				void addChild(Key key, Node node);
+				void addArrayChild(Key key, Node node);
 
 			private:
+				friend class Response;
+				using Value = std::variant<std::string, bool, long long>;
+				// Few distinct keys per node: flat vectors, kept in insertion order
+				using Children = std::vector<std::pair<Key, std::vector<Node>>>;
 
+				void setAttributeValue(Key key, Value value);
 				void setVersionAttribute(ProtocolVersion version);
+				static std::vector<Node>& getOrCreateChildren(Children& children, Key key);
 
-				friend class Response;
-				using Value = std::variant<std::string, bool, long long>;
-				std::map<std::string, Value> _attributes;
+				std::vector<std::pair<Key, Value>> _attributes;
 				std::optional<Value> _value;
-				std::map<std::string, std::vector<Node>> _children;
-				std::map<std::string, std::vector<Node>> _childrenArrays;
+				Children _children;
+				Children _childrenArrays;
 		};
 
 		static Response createOkResponse(ProtocolVersion protocolVersion);
@@ -223,15 +235,20 @@ class Response
 		Response(Response&&) = default;
 		Response& operator=(Response&&) = default;
 
-		void addNode(const std::string& key, Node node);
-		Node& createNode(const std::string& key);
-		Node& createArrayNode(const std::string& key);
+		void addNode(Key key, Node node);
+		Node& createNode(Key key);
+		Node& createArrayNode(Key key);
 
 		void write(std::ostream& os, ResponseFormat format);
 
 	private:
+		Node& getResponseNode();
+
+		// Serialize directly to the output stream, without building any intermediate document
 		void writeJSON(std::ostream& os);
 		void writeXML(std::ostream& os);
+		static void writeJSONNode(std::ostream& os, const Node& node);
+		static void writeXMLNode(std::ostream& os, Key key, const Node& node);
 
 		Response() = default;
 		Node _root;
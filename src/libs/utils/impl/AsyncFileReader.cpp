@@ -0,0 +1,406 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/AsyncFileReader.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+	#define LMS_SUPPORT_IO_URING 1
+	#include <linux/io_uring.h>
+	#include <sys/eventfd.h>
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+	#include <sys/uio.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+#include "utils/IOContextRunner.hpp"
+#include "utils/Logger.hpp"
+
+namespace AsyncFileReader
+{
+	namespace
+	{
+		std::atomic<Engine> currentEngine {Engine::Sync};
+
+		void
+		syncRead(int fd, std::uint64_t offset, std::byte* buffer, std::size_t size, const ReadCallback& callback)
+		{
+			::ssize_t res;
+			do
+			{
+				res = ::pread(fd, buffer, size, static_cast<::off_t>(offset));
+			}
+			while (res < 0 && errno == EINTR);
+
+			if (res < 0)
+				callback(std::error_code {errno, std::system_category()}, 0);
+			else
+				callback({}, static_cast<std::size_t>(res));
+		}
+
+#if LMS_SUPPORT_IO_URING
+		// Minimal io_uring usage through the raw system calls (no dependency on liburing)
+		// Completions are notified using an eventfd, watched by a dedicated io context
+		class IoUringEngine
+		{
+			public:
+				static std::unique_ptr<IoUringEngine> create(unsigned queueDepth)
+				{
+					std::unique_ptr<IoUringEngine> engine {new IoUringEngine};
+					if (!engine->init(queueDepth))
+						return {};
+
+					return engine;
+				}
+
+				~IoUringEngine()
+				{
+					_ioContextRunner.reset();
+					_eventFdDescriptor.reset();
+
+					if (_sqes)
+						::munmap(_sqes, _sqesSize);
+					if (_cqRing && _cqRing != _sqRing)
+						::munmap(_cqRing, _cqRingSize);
+					if (_sqRing)
+						::munmap(_sqRing, _sqRingSize);
+					if (_ringFd >= 0)
+						::close(_ringFd);
+				}
+
+				IoUringEngine(const IoUringEngine&) = delete;
+				IoUringEngine& operator=(const IoUringEngine&) = delete;
+
+				void
+				read(int fd, std::uint64_t offset, std::byte* buffer, std::size_t size, ReadCallback callback)
+				{
+					PendingRead read {fd, offset, buffer, size, std::move(callback)};
+
+					bool submitFailed {};
+					{
+						const std::scoped_lock lock {_mutex};
+
+						// Reads beyond the queue depth wait for some room
+						if (_freeSlots.empty())
+						{
+							_queuedReads.push_back(std::move(read));
+							return;
+						}
+
+						submitFailed = !submit(read);
+					}
+
+					if (submitFailed)
+						syncRead(read.fd, read.offset, read.buffer, read.size, read.callback);
+				}
+
+			private:
+				IoUringEngine() = default;
+
+				struct PendingRead
+				{
+					int				fd;
+					std::uint64_t	offset;
+					std::byte*		buffer;
+					std::size_t		size;
+					ReadCallback	callback;
+				};
+
+				struct Slot
+				{
+					::iovec			iov {};
+					ReadCallback	callback;
+				};
+
+				bool
+				init(unsigned queueDepth)
+				{
+					::io_uring_params params {};
+					_ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, queueDepth, &params));
+					if (_ringFd < 0)
+					{
+						LMS_LOG(UTILS, ERROR) << "Cannot setup io_uring: " << ::strerror(errno);
+						return false;
+					}
+
+					_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+					_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+					const bool singleMmap {(params.features & IORING_FEAT_SINGLE_MMAP) != 0};
+					if (singleMmap)
+						_sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+
+					_sqRing = mapRing(_sqRingSize, IORING_OFF_SQ_RING);
+					if (!_sqRing)
+						return false;
+
+					_cqRing = singleMmap ? _sqRing : mapRing(_cqRingSize, IORING_OFF_CQ_RING);
+					if (!_cqRing)
+						return false;
+
+					_sqesSize = params.sq_entries * sizeof(::io_uring_sqe);
+					_sqes = static_cast<::io_uring_sqe*>(mapRing(_sqesSize, IORING_OFF_SQES));
+					if (!_sqes)
+						return false;
+
+					std::byte* sqRing {static_cast<std::byte*>(_sqRing)};
+					_sqTail = reinterpret_cast<unsigned*>(sqRing + params.sq_off.tail);
+					_sqMask = *reinterpret_cast<unsigned*>(sqRing + params.sq_off.ring_mask);
+					_sqArray = reinterpret_cast<unsigned*>(sqRing + params.sq_off.array);
+
+					std::byte* cqRing {static_cast<std::byte*>(_cqRing)};
+					_cqHead = reinterpret_cast<unsigned*>(cqRing + params.cq_off.head);
+					_cqTail = reinterpret_cast<unsigned*>(cqRing + params.cq_off.tail);
+					_cqMask = *reinterpret_cast<unsigned*>(cqRing + params.cq_off.ring_mask);
+					_cqes = reinterpret_cast<::io_uring_cqe*>(cqRing + params.cq_off.cqes);
+
+					// Never more reads in flight than completion entries
+					_slots.resize(std::min(params.sq_entries, params.cq_entries));
+					for (unsigned i {}; i < _slots.size(); ++i)
+						_freeSlots.push_back(i);
+
+					const int eventFd {::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)};
+					if (eventFd < 0)
+					{
+						LMS_LOG(UTILS, ERROR) << "Cannot create eventfd: " << ::strerror(errno);
+						return false;
+					}
+
+					_eventFdDescriptor = std::make_unique<boost::asio::posix::stream_descriptor>(_ioContext, eventFd);
+					if (::syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_EVENTFD, &eventFd, 1) < 0)
+					{
+						LMS_LOG(UTILS, ERROR) << "Cannot register io_uring eventfd: " << ::strerror(errno);
+						return false;
+					}
+
+					waitForCompletions();
+					_ioContextRunner = std::make_unique<IOContextRunner>(_ioContext, 1);
+
+					LMS_LOG(UTILS, INFO) << "Using io_uring file reads, queue depth = " << _slots.size();
+					return true;
+				}
+
+				void*
+				mapRing(std::size_t size, std::uint64_t offset)
+				{
+					void* res {::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, static_cast<::off_t>(offset))};
+					if (res == MAP_FAILED)
+					{
+						LMS_LOG(UTILS, ERROR) << "Cannot map io_uring: " << ::strerror(errno);
+						return nullptr;
+					}
+
+					return res;
+				}
+
+				// mutex must be held, a slot must be available
+				bool
+				submit(PendingRead& read)
+				{
+					const unsigned slotIndex {_freeSlots.back()};
+					Slot& slot {_slots[slotIndex]};
+					slot.iov.iov_base = read.buffer;
+					slot.iov.iov_len = read.size;
+
+					// readv is available on older kernels than read
+					const unsigned tail {*_sqTail};
+					const unsigned index {tail & _sqMask};
+					::io_uring_sqe& sqe {_sqes[index]};
+					std::memset(&sqe, 0, sizeof(sqe));
+					sqe.opcode = IORING_OP_READV;
+					sqe.fd = read.fd;
+					sqe.off = read.offset;
+					sqe.addr = reinterpret_cast<std::uint64_t>(&slot.iov);
+					sqe.len = 1;
+					sqe.user_data = slotIndex;
+					_sqArray[index] = index;
+					__atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+					int res;
+					do
+					{
+						res = static_cast<int>(::syscall(__NR_io_uring_enter, _ringFd, 1, 0, 0, nullptr, 0));
+					}
+					while (res < 0 && errno == EINTR);
+
+					if (res != 1)
+					{
+						// not consumed by the kernel: take the entry back
+						LMS_LOG(UTILS, ERROR) << "Cannot submit io_uring read: " << ::strerror(errno);
+						__atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+						return false;
+					}
+
+					slot.callback = std::move(read.callback);
+					_freeSlots.pop_back();
+					return true;
+				}
+
+				void
+				waitForCompletions()
+				{
+					_eventFdDescriptor->async_wait(boost::asio::posix::stream_descriptor::wait_read, [this](const boost::system::error_code& ec)
+					{
+						if (ec)
+							return;
+
+						std::uint64_t eventCount;
+						[[maybe_unused]] const ::ssize_t res {::read(_eventFdDescriptor->native_handle(), &eventCount, sizeof(eventCount))};
+
+						processCompletions();
+						waitForCompletions();
+					});
+				}
+
+				void
+				processCompletions()
+				{
+					struct Completion
+					{
+						ReadCallback	callback;
+						int				result;
+					};
+					std::vector<Completion> completions;
+					std::vector<PendingRead> failedReads;
+
+					{
+						const std::scoped_lock lock {_mutex};
+
+						unsigned head {*_cqHead};
+						const unsigned tail {__atomic_load_n(_cqTail, __ATOMIC_ACQUIRE)};
+						for (; head != tail; ++head)
+						{
+							const ::io_uring_cqe& cqe {_cqes[head & _cqMask]};
+							const unsigned slotIndex {static_cast<unsigned>(cqe.user_data)};
+
+							completions.push_back(Completion {std::move(_slots[slotIndex].callback), cqe.res});
+							_freeSlots.push_back(slotIndex);
+						}
+						__atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+
+						while (!_queuedReads.empty() && !_freeSlots.empty())
+						{
+							PendingRead read {std::move(_queuedReads.front())};
+							_queuedReads.pop_front();
+
+							if (!submit(read))
+								failedReads.push_back(std::move(read));
+						}
+					}
+
+					for (Completion& completion : completions)
+					{
+						if (completion.result < 0)
+							completion.callback(std::error_code {-completion.result, std::system_category()}, 0);
+						else
+							completion.callback({}, static_cast<std::size_t>(completion.result));
+					}
+
+					for (const PendingRead& read : failedReads)
+						syncRead(read.fd, read.offset, read.buffer, read.size, read.callback);
+				}
+
+				int						_ringFd {-1};
+				void*					_sqRing {};
+				std::size_t				_sqRingSize {};
+				void*					_cqRing {};
+				std::size_t				_cqRingSize {};
+				::io_uring_sqe*			_sqes {};
+				std::size_t				_sqesSize {};
+
+				unsigned*				_sqTail {};
+				unsigned				_sqMask {};
+				unsigned*				_sqArray {};
+				unsigned*				_cqHead {};
+				unsigned*				_cqTail {};
+				unsigned				_cqMask {};
+				::io_uring_cqe*			_cqes {};
+
+				std::mutex				_mutex;
+				std::vector<Slot>		_slots;
+				std::vector<unsigned>	_freeSlots;
+				std::deque<PendingRead>	_queuedReads;
+
+				boost::asio::io_context									_ioContext;
+				std::unique_ptr<boost::asio::posix::stream_descriptor>	_eventFdDescriptor;
+				std::unique_ptr<IOContextRunner>						_ioContextRunner;
+		};
+
+		std::unique_ptr<IoUringEngine> ioUringEngine;
+#endif // LMS_SUPPORT_IO_URING
+	}
+
+	void
+	setEngine(Engine engine, [[maybe_unused]] std::size_t queueDepth)
+	{
+		if (engine == Engine::IoUring)
+		{
+#if LMS_SUPPORT_IO_URING
+			if (!ioUringEngine)
+				ioUringEngine = IoUringEngine::create(static_cast<unsigned>(std::max<std::size_t>(queueDepth, 1)));
+
+			if (!ioUringEngine)
+			{
+				LMS_LOG(UTILS, WARNING) << "io_uring not available, using synchronous file reads";
+				engine = Engine::Sync;
+			}
+#else
+			LMS_LOG(UTILS, WARNING) << "io_uring not supported on this system, using synchronous file reads";
+			engine = Engine::Sync;
+#endif
+		}
+
+		currentEngine = engine;
+	}
+
+	Engine
+	getEngine()
+	{
+		return currentEngine;
+	}
+
+	void
+	asyncRead(int fd, std::uint64_t offset, std::byte* buffer, std::size_t size, ReadCallback callback)
+	{
+		switch (currentEngine.load())
+		{
+			case Engine::Sync:
+				syncRead(fd, offset, buffer, size, callback);
+				break;
+
+			case Engine::IoUring:
+#if LMS_SUPPORT_IO_URING
+				ioUringEngine->read(fd, offset, buffer, size, std::move(callback));
+#endif
+				break;
+		}
+	}
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/AsyncLogger.hpp"
+
+#include <chrono>
+
+namespace
+{
+	std::size_t
+	getQueueSize(std::size_t maxQueuedLogCount)
+	{
+		std::size_t size {1};
+		while (size < maxQueuedLogCount)
+			size <<= 1;
+
+		return size;
+	}
+
+	// wake up period of the flush thread, in case a notification is missed
+	constexpr std::chrono::milliseconds maxFlushDelay {50};
+	// the flush thread may be stuck in the forwarded logger: never hold a fatal log forever
+	constexpr std::chrono::seconds maxFatalWait {1};
+}
+
+AsyncLogger::AsyncLogger(std::unique_ptr<Logger> logger, std::size_t maxQueuedLogCount)
+	: _logger {std::move(logger)}
+	, _queueSize {getQueueSize(maxQueuedLogCount)}
+	, _queue {std::make_unique<Entry[]>(_queueSize)}
+{
+	for (std::size_t i {}; i < _queueSize; ++i)
+		_queue[i].sequence.store(i, std::memory_order_relaxed);
+
+	_thread = std::thread {[this] { processQueuedLogs(); }};
+}
+
+AsyncLogger::~AsyncLogger()
+{
+	_stop = true;
+	_cv.notify_one();
+	_thread.join();
+}
+
+bool
+AsyncLogger::isSeverityActive(Module module, Severity severity) const
+{
+	return _logger->isSeverityActive(module, severity);
+}
+
+void
+AsyncLogger::processLog(const Log& log)
+{
+	if (log.getSeverity() == Severity::FATAL)
+	{
+		waitForQueuedLogs();
+		forward(log.getModule(), log.getSeverity(), log.getMessage());
+		return;
+	}
+
+	if (!tryPush(log.getModule(), log.getSeverity(), log.getMessage()))
+	{
+		_droppedLogCount.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	if (_waiting.load(std::memory_order_relaxed))
+		_cv.notify_one();
+}
+
+// Bounded MPMC queue from D. Vyukov, used with a single consumer
+bool
+AsyncLogger::tryPush(Module module, Severity severity, std::string&& message)
+{
+	std::size_t position {_enqueuePosition.load(std::memory_order_relaxed)};
+	Entry* entry;
+	while (true)
+	{
+		entry = &_queue[position & (_queueSize - 1)];
+		const std::size_t sequence {entry->sequence.load(std::memory_order_acquire)};
+
+		if (sequence == position)
+		{
+			if (_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (sequence < position)
+			return false; // full
+		else
+			position = _enqueuePosition.load(std::memory_order_relaxed);
+	}
+
+	entry->module = module;
+	entry->severity = severity;
+	entry->message = std::move(message);
+	entry->sequence.store(position + 1, std::memory_order_release);
+
+	return true;
+}
+
+bool
+AsyncLogger::tryPop(Module& module, Severity& severity, std::string& message)
+{
+	Entry& entry {_queue[_dequeuePosition & (_queueSize - 1)]};
+	if (entry.sequence.load(std::memory_order_acquire) != _dequeuePosition + 1)
+		return false; // empty
+
+	module = entry.module;
+	severity = entry.severity;
+	message = std::move(entry.message);
+	entry.sequence.store(_dequeuePosition + _queueSize, std::memory_order_release);
+	_dequeuePosition++;
+
+	return true;
+}
+
+void
+AsyncLogger::forward(Module module, Severity severity, const std::string& message)
+{
+	Log log {nullptr, module, severity};
+	log.getOstream() << message;
+
+	_logger->processLog(log);
+}
+
+void
+AsyncLogger::waitForQueuedLogs()
+{
+	const std::size_t position {_enqueuePosition.load(std::memory_order_relaxed)};
+
+	std::unique_lock lock {_mutex};
+	_cv.notify_one();
+	_forwardedCv.wait_for(lock, maxFatalWait, [&] { return _forwardedPosition >= position; });
+}
+
+void
+AsyncLogger::processQueuedLogs()
+{
+	Module module;
+	Severity severity;
+	std::string message;
+
+	while (true)
+	{
+		while (tryPop(module, severity, message))
+			forward(module, severity, message);
+
+		{
+			std::scoped_lock lock {_mutex};
+			_forwardedPosition = _dequeuePosition;
+		}
+		_forwardedCv.notify_all();
+
+		if (const std::size_t droppedLogCount {_droppedLogCount.exchange(0, std::memory_order_relaxed)}; droppedLogCount > 0)
+			forward(Module::UTILS, Severity::WARNING, std::to_string(droppedLogCount) + " log messages dropped!");
+
+		if (_stop)
+			break;
+
+		std::unique_lock lock {_mutex};
+		_waiting = true;
+		_cv.wait_for(lock, maxFlushDelay);
+		_waiting = false;
+	}
+
+	// logs made while stopping
+	while (tryPop(module, severity, message))
+		forward(module, severity, message);
+}
@@ -22,6 +22,7 @@
 #include <cstring>
 #include <cerrno>
 #include <fcntl.h>
+#include <spawn.h>
 #include <stdexcept>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -38,6 +39,8 @@
 #include "utils/Exception.hpp"
 #include "utils/Logger.hpp"
 
+#include "ChildProcessReaper.hpp"
+
 namespace
 {
 	class SystemException : public ChildProcessException
@@ -53,8 +56,9 @@ namespace
 	};
 }
 
-ChildProcess::ChildProcess(boost::asio::io_context& ioContext, const std::filesystem::path& path, const Args& args)
+ChildProcess::ChildProcess(boost::asio::io_context& ioContext, ChildProcessReaper& reaper, const std::filesystem::path& path, const Args& args, CpuPlacement::Workload workload)
 : _ioContext {ioContext}
+, _reaper {reaper}
 , _childStdout {_ioContext}
 
 {
@@ -80,38 +84,59 @@ ChildProcess::ChildProcess(boost::asio::io_context& ioContext, const std::filesy
 #endif
 	}
 
-	res = fork();
-	if (res == -1)
-		throw SystemException {errno, "fork failed!"};
+	// posix_spawn does not duplicate the page tables of the parent (vfork-like on Linux): the spawn time does not depend on the memory used by the server
+	posix_spawn_file_actions_t fileActions;
+	res = posix_spawn_file_actions_init(&fileActions);
+	if (res != 0)
+		throw SystemException {res, "posix_spawn_file_actions_init failed!"};
+
+	// other file descriptors are closed on exec
+	res = posix_spawn_file_actions_addclose(&fileActions, STDIN_FILENO);
+	if (res == 0)
+		res = posix_spawn_file_actions_addclose(&fileActions, STDERR_FILENO);
+	if (res == 0)
+		res = posix_spawn_file_actions_adddup2(&fileActions, pipe[1], STDOUT_FILENO); // Replace stdout with pipe write
+	if (res != 0)
+	{
+		posix_spawn_file_actions_destroy(&fileActions);
+		close(pipe[0]);
+		close(pipe[1]);
+		throw SystemException {res, "posix_spawn_file_actions failed!"};
+	}
+
+	std::vector<char*> execArgs;
+	std::transform(std::cbegin(args), std::cend(args), std::back_inserter(execArgs), [](const std::string& arg) { return const_cast<char*>(arg.c_str()); });
+	execArgs.push_back(nullptr);
 
-	if (res == 0) // CHILD
+	pid_t pid;
+	{
+		// The child inherits the CPU affinity of this thread before exec
+		const CpuPlacement::ScopedSpawnPlacement spawnPlacement {workload};
+		res = posix_spawn(&pid, path.c_str(), &fileActions, nullptr, execArgs.data(), environ);
+	}
+	posix_spawn_file_actions_destroy(&fileActions);
+	close(pipe[1]);
+	if (res != 0)
 	{
 		close(pipe[0]);
-		close(STDIN_FILENO);
-		close(STDERR_FILENO);
+		throw SystemException {res, "posix_spawn failed!"};
+	}
 
-		// Replace stdout with pipe write
-		if (dup2(pipe[1], STDOUT_FILENO) == -1)
-			exit(-1);
+	_childPID = pid;
 
-		std::vector<const char*> execArgs;
-		std::transform(std::cbegin(args), std::cend(args), std::back_inserter(execArgs), [](const std::string& arg) { return arg.c_str(); });
-		execArgs.push_back(nullptr);
+	CpuPlacement::placeProcess(workload, pid);
 
-		res = execv(path.string().c_str(), (char *const*)&execArgs[0]);
-		if (res == -1)
-			exit(-1);
-	}
-	else // PARENT
 	{
-		close(pipe[1]);
+		boost::system::error_code assignError;
+		_childStdout.assign(pipe[0], assignError);
+		if (assignError)
 		{
-			boost::system::error_code assignError;
-			_childStdout.assign(pipe[0], assignError);
-			if (assignError)
-				throw SystemException {assignError, "fork failed!"};
+			// the destructor is not called: nobody would reap the child
+			close(pipe[0]);
+			kill();
+			waitpid(pid, nullptr, 0);
+			throw SystemException {assignError, "assign failed!"};
 		}
-		_childPID = res;
 	}
 }
 
@@ -127,7 +152,17 @@ ChildProcess::~ChildProcess()
 				LMS_LOG(CHILDPROCESS, ERROR) << "Closed failed: " << closeError.message();
 		}
 		kill();
-		wait(true);
+
+		// Do not block the destroying thread (usually a request thread) until the process exits
+		try
+		{
+			if (!wait(false))
+				_reaper.reap(_childPID);
+		}
+		catch (const ChildProcessException& e)
+		{
+			LMS_LOG(CHILDPROCESS, ERROR) << "Cannot wait for child process: " << e.what();
+		}
 	}
 }
 
@@ -225,3 +260,24 @@ ChildProcess::finished()
 	return _finished;
 }
 
+bool
+ChildProcess::succeeded()
+{
+	assert(finished());
+
+	try
+	{
+		// stdout is closed: the process is exiting
+		if (!_waited)
+			wait(true);
+	}
+	catch (const ChildProcessException& e)
+	{
+		LMS_LOG(CHILDPROCESS, ERROR) << "Cannot wait for child process: " << e.what();
+		return false;
+	}
+
+	// not set if killed by a signal
+	return _exitCode && *_exitCode == 0;
+}
+
@@ -29,20 +29,23 @@
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/posix/stream_descriptor.hpp>
 
+#include "utils/CpuPlacement.hpp"
 #include "utils/IChildProcess.hpp"
 
+class ChildProcessReaper;
 
 class ChildProcess : public IChildProcess
 {
 	public:
 		~ChildProcess();
-		ChildProcess(boost::asio::io_context& ioContext, const std::filesystem::path& path, const Args& args);
+		ChildProcess(boost::asio::io_context& ioContext, ChildProcessReaper& reaper, const std::filesystem::path& path, const Args& args, CpuPlacement::Workload workload);
 
 	private:
 		void		asyncRead(std::byte* data, std::size_t bufferSize, ReadCallback callback) override;
 		void		asyncWaitForData(WaitCallback cb) override;
 		std::size_t	readSome(std::byte* data, std::size_t bufferSize) override;
 		bool		finished() override;
+		bool		succeeded() override;
 
 		void	kill();
 		void	drain();
@@ -51,6 +54,7 @@ class ChildProcess : public IChildProcess
 		using FileDescriptor = boost::asio::posix::stream_descriptor;
 
 		boost::asio::io_context&	_ioContext;
+		ChildProcessReaper&			_reaper;
 		FileDescriptor				_childStdout;
 		::pid_t						_childPID {};
 		bool						_waited {};
@@ -32,13 +32,14 @@ createChildProcessManager(boost::asio::io_context& ioContext)
 
 ChildProcessManager::ChildProcessManager(boost::asio::io_context& ioContext)
 : _ioContext {ioContext}
+, _reaper {ioContext}
 {
 }
 
 std::unique_ptr<IChildProcess>
-ChildProcessManager::spawnChildProcess(const std::filesystem::path& path, const IChildProcess::Args& args)
+ChildProcessManager::spawnChildProcess(const std::filesystem::path& path, const IChildProcess::Args& args, CpuPlacement::Workload workload)
 {
-	return std::make_unique<ChildProcess>(_ioContext, path, args);
+	return std::make_unique<ChildProcess>(_ioContext, _reaper, path, args, workload);
 }
 
 
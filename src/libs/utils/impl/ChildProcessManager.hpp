@@ -26,6 +26,8 @@
 
 #include "utils/IChildProcessManager.hpp"
 
+#include "ChildProcessReaper.hpp"
+
 class ChildProcessManager : public IChildProcessManager
 {
 	public:
@@ -38,9 +40,10 @@ class ChildProcessManager : public IChildProcessManager
 		ChildProcessManager& operator=(ChildProcessManager&&) = delete;
 
 	private:
-		std::unique_ptr<IChildProcess> spawnChildProcess(const std::filesystem::path& path, const IChildProcess::Args& args) override;
+		std::unique_ptr<IChildProcess> spawnChildProcess(const std::filesystem::path& path, const IChildProcess::Args& args, CpuPlacement::Workload workload) override;
 
 		boost::asio::io_context&	_ioContext;
+		ChildProcessReaper			_reaper;
 };
 
 
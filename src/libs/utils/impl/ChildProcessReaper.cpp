@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ChildProcessReaper.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "utils/Logger.hpp"
+
+namespace
+{
+	constexpr std::chrono::milliseconds minPollPeriod {10};
+	constexpr std::chrono::milliseconds maxPollPeriod {1000};
+
+	// true if the process has been reaped (or does not exist anymore)
+	bool
+	tryReap(::pid_t pid)
+	{
+		const ::pid_t res {::waitpid(pid, nullptr, WNOHANG)};
+		if (res == -1)
+		{
+			LMS_LOG(CHILDPROCESS, ERROR) << "waitpid failed for pid " << pid << ": " << ::strerror(errno);
+			return true;
+		}
+
+		return res != 0;
+	}
+
+	std::optional<int>
+	openPidFd([[maybe_unused]] ::pid_t pid)
+	{
+#if defined(__linux__) && defined(SYS_pidfd_open)
+		const int fd {static_cast<int>(::syscall(SYS_pidfd_open, pid, 0))};
+		if (fd >= 0)
+			return fd;
+#endif
+		return std::nullopt;
+	}
+}
+
+struct ChildProcessReaper::PendingChild
+{
+	PendingChild(boost::asio::io_context& ioContext, ::pid_t _pid)
+		: pid {_pid}
+		, pidFd {ioContext}
+		, timer {ioContext}
+	{}
+
+	const ::pid_t								pid;
+	boost::asio::posix::stream_descriptor		pidFd;
+	boost::asio::steady_timer					timer;
+	std::chrono::milliseconds					pollPeriod {minPollPeriod};
+};
+
+struct ChildProcessReaper::State
+{
+	std::mutex													mutex;
+	bool														stopped {};
+	std::unordered_map<::pid_t, std::shared_ptr<PendingChild>>	pendingChildren;
+
+	// mutex must be held, returns true if the child is not pending anymore
+	bool
+	tryReapPendingChild(const PendingChild& pendingChild)
+	{
+		if (stopped)
+			return true;
+
+		if (!tryReap(pendingChild.pid))
+			return false;
+
+		LMS_LOG(CHILDPROCESS, DEBUG) << "Reaped child process " << pendingChild.pid;
+		pendingChildren.erase(pendingChild.pid);
+		return true;
+	}
+};
+
+ChildProcessReaper::ChildProcessReaper(boost::asio::io_context& ioContext)
+: _ioContext {ioContext}
+, _state {std::make_shared<State>()}
+{
+}
+
+ChildProcessReaper::~ChildProcessReaper()
+{
+	const std::scoped_lock lock {_state->mutex};
+
+	_state->stopped = true;
+	for (auto& [pid, pendingChild] : _state->pendingChildren)
+	{
+		boost::system::error_code ec;
+		pendingChild->pidFd.cancel(ec);
+		pendingChild->timer.cancel();
+
+		// already killed, should not last
+		::waitpid(pid, nullptr, 0);
+	}
+	_state->pendingChildren.clear();
+}
+
+void
+ChildProcessReaper::reap(::pid_t pid)
+{
+	const std::scoped_lock lock {_state->mutex};
+
+	// may have exited meanwhile
+	if (tryReap(pid))
+		return;
+
+	auto pendingChild {std::make_shared<PendingChild>(_ioContext, pid)};
+	_state->pendingChildren.emplace(pid, pendingChild);
+
+	if (const std::optional<int> pidFd {openPidFd(pid)})
+		watchUsingPidFd(_state, pendingChild, *pidFd);
+	else
+		watchUsingTimer(_state, pendingChild);
+}
+
+void
+ChildProcessReaper::watchUsingPidFd(const std::shared_ptr<State>& state, const std::shared_ptr<PendingChild>& pendingChild, int pidFd)
+{
+	boost::system::error_code ec;
+	pendingChild->pidFd.assign(pidFd, ec);
+	if (ec)
+	{
+		::close(pidFd);
+		watchUsingTimer(state, pendingChild);
+		return;
+	}
+
+	// readable once the process has exited
+	pendingChild->pidFd.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+		[state, pendingChild](const boost::system::error_code& ec)
+		{
+			if (ec == boost::asio::error::operation_aborted)
+				return;
+
+			const std::scoped_lock lock {state->mutex};
+			if (!state->tryReapPendingChild(*pendingChild))
+				watchUsingTimer(state, pendingChild);
+		});
+}
+
+void
+ChildProcessReaper::watchUsingTimer(const std::shared_ptr<State>& state, const std::shared_ptr<PendingChild>& pendingChild)
+{
+	pendingChild->timer.expires_after(pendingChild->pollPeriod);
+	pendingChild->timer.async_wait([state, pendingChild](const boost::system::error_code& ec)
+	{
+		if (ec == boost::asio::error::operation_aborted)
+			return;
+
+		const std::scoped_lock lock {state->mutex};
+		if (state->tryReapPendingChild(*pendingChild))
+			return;
+
+		pendingChild->pollPeriod = std::min(pendingChild->pollPeriod * 2, maxPollPeriod);
+		watchUsingTimer(state, pendingChild);
+	});
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <memory>
+
+#include <boost/asio/io_context.hpp>
+
+// Waits for the killed child processes in the background, so that destroying a child process never blocks the calling thread
+// Uses a pidfd watched on the io context when available, or polls otherwise
+class ChildProcessReaper
+{
+	public:
+		ChildProcessReaper(boost::asio::io_context& ioContext);
+		~ChildProcessReaper(); // blocks until the pending processes are reaped
+
+		ChildProcessReaper(const ChildProcessReaper&) = delete;
+		ChildProcessReaper& operator=(const ChildProcessReaper&) = delete;
+
+		// The process must have been killed
+		void reap(::pid_t pid);
+
+	private:
+		struct State;
+		struct PendingChild;
+
+		// state mutex must be held, handlers only rely on the shared state
+		static void watchUsingPidFd(const std::shared_ptr<State>& state, const std::shared_ptr<PendingChild>& pendingChild, int pidFd);
+		static void watchUsingTimer(const std::shared_ptr<State>& state, const std::shared_ptr<PendingChild>& pendingChild);
+
+		boost::asio::io_context&	_ioContext;
+		std::shared_ptr<State>		_state; // shared with the handlers, that may be called after destruction
+};
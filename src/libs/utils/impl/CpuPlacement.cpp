@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/CpuPlacement.hpp"
+
+#include <sched.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <mutex>
+
+#include "utils/Logger.hpp"
+#include "utils/String.hpp"
+
+namespace CpuPlacement
+{
+	namespace
+	{
+		constexpr std::size_t workloadCount {3};
+		constexpr int maxNice {19};
+		// Same as CPU_SETSIZE on Linux
+		constexpr unsigned maxCpuCount {1024};
+
+		thread_local std::optional<Workload> currentThreadWorkload;
+
+		const char*
+		getWorkloadName(Workload workload)
+		{
+			switch (workload)
+			{
+				case Workload::Background:	return "background";
+				case Workload::Bulk:		return "bulk";
+				case Workload::Transcoder:	return "transcoder";
+			}
+			return "";
+		}
+
+		std::optional<unsigned>
+		parseNumber(std::string_view str)
+		{
+			const std::string cpu {StringUtils::stringTrim(str)};
+
+			unsigned res;
+			const auto [ptr, ec] {std::from_chars(cpu.data(), cpu.data() + cpu.size(), res)};
+			if (ec != std::errc {} || ptr != cpu.data() + cpu.size())
+				return std::nullopt;
+
+			return res;
+		}
+
+		class Placements
+		{
+			public:
+				Placements()
+				{
+					// Whatever the process has been started with, used to restore the threads that are not restricted anymore
+					errno = 0;
+					const int nice {::getpriority(PRIO_PROCESS, 0)};
+					if (errno == 0)
+						_processNice = nice;
+
+#if defined(__linux__)
+					CPU_ZERO(&_processCpus);
+					if (::sched_getaffinity(0, sizeof(_processCpus), &_processCpus) != 0)
+					{
+						LMS_LOG(UTILS, ERROR) << "Cannot get the CPU affinity of the process: " << ::strerror(errno);
+						for (int cpu {}; cpu < CPU_SETSIZE; ++cpu)
+							CPU_SET(cpu, &_processCpus);
+					}
+#endif
+				}
+
+				void set(Workload workload, const Placement& placement)
+				{
+					const std::scoped_lock lock {_mutex};
+					_placements[static_cast<std::size_t>(workload)] = placement;
+				}
+
+				Placement get(Workload workload) const
+				{
+					const std::scoped_lock lock {_mutex};
+					return _placements[static_cast<std::size_t>(workload)];
+				}
+
+				int getNice(const Placement& placement) const
+				{
+					return std::min(_processNice + static_cast<int>(std::min<unsigned>(placement.niceIncrement, maxNice)), maxNice);
+				}
+
+#if defined(__linux__)
+				cpu_set_t getCpuSet(const Placement& placement) const
+				{
+					if (placement.cpus.empty())
+						return _processCpus;
+
+					cpu_set_t cpuSet;
+					CPU_ZERO(&cpuSet);
+					for (const unsigned cpu : placement.cpus)
+					{
+						if (cpu < CPU_SETSIZE)
+							CPU_SET(cpu, &cpuSet);
+					}
+
+					return cpuSet;
+				}
+#endif
+
+			private:
+				mutable std::mutex						_mutex;
+				std::array<Placement, workloadCount>	_placements;
+				int										_processNice {};
+#if defined(__linux__)
+				cpu_set_t								_processCpus;
+#endif
+		};
+
+		Placements&
+		getPlacements()
+		{
+			static Placements placements;
+			return placements;
+		}
+
+		// who is a thread or a process id, 0 means the calling thread
+		void
+		applyCpus(Workload workload, const Placement& placement, pid_t who)
+		{
+#if defined(__linux__)
+			const cpu_set_t cpuSet {getPlacements().getCpuSet(placement)};
+			if (::sched_setaffinity(who, sizeof(cpuSet), &cpuSet) != 0)
+				LMS_LOG(UTILS, ERROR) << "Cannot set the CPU affinity for the " << getWorkloadName(workload) << " workload: " << ::strerror(errno);
+#else
+			if (!placement.cpus.empty())
+				LMS_LOG(UTILS, ERROR) << "Cannot set the CPU affinity for the " << getWorkloadName(workload) << " workload: not supported";
+#endif
+		}
+
+		// On Linux, the nice value is per thread
+		void
+		applyNice(Workload workload, const Placement& placement, pid_t who)
+		{
+			const int nice {getPlacements().getNice(placement)};
+
+			errno = 0;
+			const int currentNice {::getpriority(PRIO_PROCESS, who)};
+			if (errno != 0 || currentNice >= nice)
+				return;
+
+			if (::setpriority(PRIO_PROCESS, who, nice) != 0)
+				LMS_LOG(UTILS, ERROR) << "Cannot set the nice value for the " << getWorkloadName(workload) << " workload: " << ::strerror(errno);
+		}
+
+		void
+		applyCgroup(Workload workload, const Placement& placement, pid_t pid)
+		{
+			// Must be written at once
+			std::ofstream ofs {placement.cgroup / "cgroup.procs", std::ios::app};
+			ofs << std::to_string(pid) << std::flush;
+			if (!ofs)
+				LMS_LOG(UTILS, ERROR) << "Cannot move the " << getWorkloadName(workload) << " process into cgroup '" << placement.cgroup.string() << "'";
+		}
+	}
+
+	std::optional<std::vector<unsigned>>
+	parseCpuList(std::string_view str)
+	{
+		std::vector<unsigned> cpus;
+
+		for (std::string_view range : StringUtils::splitString(str, ","))
+		{
+			if (StringUtils::stringTrim(range).empty())
+				continue;
+
+			const std::size_t separatorPos {range.find('-')};
+			const std::optional<unsigned> first {parseNumber(range.substr(0, separatorPos))};
+			const std::optional<unsigned> last {separatorPos == std::string_view::npos ? first : parseNumber(range.substr(separatorPos + 1))};
+			if (!first || !last || *first > *last || *last >= maxCpuCount)
+				return std::nullopt;
+
+			for (unsigned cpu {*first}; cpu <= *last; ++cpu)
+				cpus.push_back(cpu);
+		}
+
+		std::sort(std::begin(cpus), std::end(cpus));
+		cpus.erase(std::unique(std::begin(cpus), std::end(cpus)), std::end(cpus));
+
+		return cpus;
+	}
+
+	void
+	setPlacement(Workload workload, const Placement& placement)
+	{
+		getPlacements().set(workload, placement);
+	}
+
+	Placement
+	getPlacement(Workload workload)
+	{
+		return getPlacements().get(workload);
+	}
+
+	void
+	placeCurrentThread(Workload workload)
+	{
+		if (currentThreadWorkload == workload)
+			return;
+
+		const Placement placement {getPlacement(workload)};
+
+		// A thread moving from another workload may have to be given its CPUs back
+		if (!placement.cpus.empty() || currentThreadWorkload)
+			applyCpus(workload, placement, 0);
+		if (placement.niceIncrement > 0)
+			applyNice(workload, placement, 0);
+
+		currentThreadWorkload = workload;
+	}
+
+	ScopedSpawnPlacement::ScopedSpawnPlacement(Workload workload)
+	{
+#if defined(__linux__)
+		const Placement placement {getPlacement(workload)};
+		if (placement.cpus.empty())
+			return;
+
+		cpu_set_t previousCpus;
+		if (::sched_getaffinity(0, sizeof(previousCpus), &previousCpus) != 0)
+		{
+			LMS_LOG(UTILS, ERROR) << "Cannot get the CPU affinity of the spawning thread: " << ::strerror(errno);
+			return;
+		}
+
+		_previousCpus = previousCpus;
+		applyCpus(workload, placement, 0);
+#else
+		(void)workload;
+#endif
+	}
+
+	ScopedSpawnPlacement::~ScopedSpawnPlacement()
+	{
+#if defined(__linux__)
+		if (_previousCpus && ::sched_setaffinity(0, sizeof(*_previousCpus), &*_previousCpus) != 0)
+			LMS_LOG(UTILS, ERROR) << "Cannot restore the CPU affinity of the spawning thread: " << ::strerror(errno);
+#endif
+	}
+
+	void
+	placeProcess(Workload workload, pid_t pid)
+	{
+		const Placement placement {getPlacement(workload)};
+
+		if (!placement.cgroup.empty())
+			applyCgroup(workload, placement, pid);
+
+		if (placement.niceIncrement > 0)
+		{
+#if defined(__linux__)
+			// The nice value is per thread on Linux: the threads the process may have already created must be updated too
+			std::error_code ec;
+			std::filesystem::directory_iterator itTask {"/proc/" + std::to_string(pid) + "/task", ec};
+			if (ec)
+				applyNice(workload, placement, pid);
+
+			for (; !ec && itTask != std::filesystem::directory_iterator {}; itTask.increment(ec))
+			{
+				if (const std::optional<unsigned> tid {parseNumber(itTask->path().filename().string())})
+					applyNice(workload, placement, static_cast<pid_t>(*tid));
+			}
+#else
+			applyNice(workload, placement, pid);
+#endif
+		}
+	}
+}
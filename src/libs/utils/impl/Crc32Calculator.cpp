@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/Crc32Calculator.hpp"
+
+#include <array>
+#include <cstring>
+
+#if defined(__ARM_FEATURE_CRC32)
+	#include <arm_acle.h>
+#endif
+
+namespace Utils
+{
+	namespace
+	{
+#if defined(__ARM_FEATURE_CRC32)
+		std::uint32_t
+		updateCrc32(std::uint32_t crc, const std::byte* data, std::size_t dataSize)
+		{
+			for (; dataSize >= 8; data += 8, dataSize -= 8)
+			{
+				std::uint64_t value;
+				std::memcpy(&value, data, sizeof(value));
+				crc = __crc32d(crc, value);
+			}
+
+			for (; dataSize > 0; ++data, --dataSize)
+				crc = __crc32b(crc, std::to_integer<std::uint8_t>(*data));
+
+			return crc;
+		}
+#else
+		constexpr std::uint32_t polynomial {0xEDB88320};
+
+		// tables[n][i]: CRC of byte i followed by n zero bytes
+		using Crc32Tables = std::array<std::array<std::uint32_t, 256>, 8>;
+
+		constexpr Crc32Tables
+		computeCrc32Tables()
+		{
+			Crc32Tables tables {};
+			for (std::uint32_t i {}; i < 256; ++i)
+			{
+				std::uint32_t crc {i};
+				for (int bit {}; bit < 8; ++bit)
+					crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+
+				tables[0][i] = crc;
+			}
+
+			for (std::size_t n {1}; n < tables.size(); ++n)
+			{
+				for (std::size_t i {}; i < 256; ++i)
+					tables[n][i] = (tables[n - 1][i] >> 8) ^ tables[0][tables[n - 1][i] & 0xFF];
+			}
+
+			return tables;
+		}
+
+		constexpr Crc32Tables crc32Tables {computeCrc32Tables()};
+
+		std::uint32_t
+		readU32LE(const std::byte* data)
+		{
+			return std::to_integer<std::uint32_t>(data[0])
+				| (std::to_integer<std::uint32_t>(data[1]) << 8)
+				| (std::to_integer<std::uint32_t>(data[2]) << 16)
+				| (std::to_integer<std::uint32_t>(data[3]) << 24);
+		}
+
+		// slicing-by-8: processes 8 bytes per iteration
+		std::uint32_t
+		updateCrc32(std::uint32_t crc, const std::byte* data, std::size_t dataSize)
+		{
+			for (; dataSize >= 8; data += 8, dataSize -= 8)
+			{
+				const std::uint32_t low {readU32LE(data) ^ crc};
+				const std::uint32_t high {readU32LE(data + 4)};
+
+				crc = crc32Tables[7][low & 0xFF]
+					^ crc32Tables[6][(low >> 8) & 0xFF]
+					^ crc32Tables[5][(low >> 16) & 0xFF]
+					^ crc32Tables[4][low >> 24]
+					^ crc32Tables[3][high & 0xFF]
+					^ crc32Tables[2][(high >> 8) & 0xFF]
+					^ crc32Tables[1][(high >> 16) & 0xFF]
+					^ crc32Tables[0][high >> 24];
+			}
+
+			for (; dataSize > 0; ++data, --dataSize)
+				crc = (crc >> 8) ^ crc32Tables[0][(crc ^ std::to_integer<std::uint32_t>(*data)) & 0xFF];
+
+			return crc;
+		}
+#endif
+	}
+
+	void
+	Crc32Calculator::processBytes(const std::byte* data, std::size_t dataSize)
+	{
+		_crc = updateCrc32(_crc, data, dataSize);
+	}
+}
+
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/DurationHistogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void
+DurationHistogram::add(Duration duration)
+{
+	const double value {static_cast<double>(std::max<Duration::rep>(duration.count(), 0)) + 1};
+	const std::size_t bucket {std::min(static_cast<std::size_t>(std::log2(value) * bucketsPerPowerOfTwo), bucketCount - 1)};
+
+	_buckets[bucket]++;
+	_count++;
+}
+
+DurationHistogram::Duration
+DurationHistogram::getPercentile(unsigned percentile) const
+{
+	if (_count == 0)
+		return Duration {};
+
+	const std::size_t rank {std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(_count * std::min(percentile, 100U) / 100.)))};
+
+	std::size_t accumulatedCount {};
+	std::size_t bucket {};
+	for (; bucket < bucketCount; ++bucket)
+	{
+		accumulatedCount += _buckets[bucket];
+		if (accumulatedCount >= rank)
+			break;
+	}
+
+	return Duration {static_cast<Duration::rep>(std::exp2(static_cast<double>(bucket + 1) / bucketsPerPowerOfTwo)) - 1};
+}
+
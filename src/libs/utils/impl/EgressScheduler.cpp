@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/EgressScheduler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <Wt/Http/Response.h>
+#include <Wt/Http/ResponseContinuation.h>
+#include <Wt/WIOService.h>
+
+#include "utils/Metrics.hpp"
+
+namespace EgressScheduler
+{
+	namespace
+	{
+		constexpr std::size_t trafficClassCount {2};
+		// Max amount of data a client can send at once after being idle
+		constexpr std::chrono::milliseconds burstDuration {1000};
+
+		std::string_view
+		toString(TrafficClass trafficClass)
+		{
+			switch (trafficClass)
+			{
+				case TrafficClass::Interactive:	return "interactive";
+				case TrafficClass::Bulk:		return "bulk";
+			}
+
+			return "";
+		}
+
+		struct ClassMetrics
+		{
+			Metrics::Counter& bytes;
+			Metrics::Counter& delays;
+		};
+
+		ClassMetrics
+		createClassMetrics(TrafficClass trafficClass)
+		{
+			const std::string labels {"class=\"" + std::string {toString(trafficClass)} + "\""};
+			return ClassMetrics {Metrics::getRegistry().createCounter("lms_egress_bytes", "Media bytes sent to the clients", labels),
+				Metrics::getRegistry().createCounter("lms_egress_delays", "Number of media transfers paused to stick to the egress rate", labels)};
+		}
+
+		ClassMetrics&
+		getClassMetrics(TrafficClass trafficClass)
+		{
+			static ClassMetrics interactiveMetrics {createClassMetrics(TrafficClass::Interactive)};
+			static ClassMetrics bulkMetrics {createClassMetrics(TrafficClass::Bulk)};
+
+			return trafficClass == TrafficClass::Bulk ? bulkMetrics : interactiveMetrics;
+		}
+
+		// One token bucket per client, the rate of the class is shared equally by its active clients
+		class Buckets
+		{
+			public:
+				void setLimits(Limits limits)
+				{
+					const std::scoped_lock lock {_mutex};
+					_limits = limits;
+				}
+
+				Limits getLimits() const
+				{
+					const std::scoped_lock lock {_mutex};
+					return _limits;
+				}
+
+				void addTransfer(TrafficClass trafficClass, const std::string& clientId)
+				{
+					const std::scoped_lock lock {_mutex};
+
+					auto [it, inserted] {_clients[static_cast<std::size_t>(trafficClass)].try_emplace(clientId)};
+					// new clients start with a full bucket
+					if (inserted)
+						it->second.lastRefill = std::chrono::steady_clock::now() - burstDuration;
+					it->second.transferCount++;
+				}
+
+				void removeTransfer(TrafficClass trafficClass, const std::string& clientId)
+				{
+					const std::scoped_lock lock {_mutex};
+
+					ClientMap& clients {_clients[static_cast<std::size_t>(trafficClass)]};
+					auto it {clients.find(clientId)};
+					if (it != std::end(clients) && --it->second.transferCount == 0)
+						clients.erase(it);
+				}
+
+				std::chrono::steady_clock::duration consume(TrafficClass trafficClass, const std::string& clientId, std::size_t byteCount)
+				{
+					const std::scoped_lock lock {_mutex};
+
+					const std::uint64_t classRate {trafficClass == TrafficClass::Bulk ? _limits.bulkRate : _limits.interactiveRate};
+					if (classRate == 0)
+						return {};
+
+					ClientMap& clients {_clients[static_cast<std::size_t>(trafficClass)]};
+					auto it {clients.find(clientId)};
+					if (it == std::end(clients))
+						return {};
+
+					const double rate {static_cast<double>(classRate) / clients.size()};	// bytes per second
+					const double maxTokens {rate * std::chrono::duration<double> {burstDuration}.count()};
+
+					Client& client {it->second};
+					const auto now {std::chrono::steady_clock::now()};
+					client.tokens = std::min(maxTokens, client.tokens + rate * std::chrono::duration<double> {now - client.lastRefill}.count());
+					client.lastRefill = now;
+
+					// may go in debt: the data has already been sent
+					client.tokens -= static_cast<double>(byteCount);
+					if (client.tokens >= 0)
+						return {};
+
+					return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double> {-client.tokens / rate});
+				}
+
+			private:
+				struct Client
+				{
+					std::size_t								transferCount {};
+					double									tokens {};
+					std::chrono::steady_clock::time_point	lastRefill;
+				};
+				using ClientMap = std::unordered_map<std::string, Client>;
+
+				mutable std::mutex							_mutex;
+				Limits										_limits;
+				std::array<ClientMap, trafficClassCount>	_clients;
+		};
+
+		Buckets&
+		getBuckets()
+		{
+			static Buckets buckets;
+			return buckets;
+		}
+
+		Wt::WIOService&
+		getTimerService()
+		{
+			static const std::unique_ptr<Wt::WIOService> ioService {[]
+			{
+				auto ioService {std::make_unique<Wt::WIOService>()};
+				ioService->setThreadCount(1);
+				ioService->start();
+
+				return ioService;
+			}()};
+
+			return *ioService;
+		}
+	}
+
+	void
+	setLimits(Limits limits)
+	{
+		getBuckets().setLimits(limits);
+	}
+
+	Limits
+	getLimits()
+	{
+		return getBuckets().getLimits();
+	}
+
+	Transfer::Transfer(const TransferInfo& info)
+		: _trafficClass {info.trafficClass}
+		, _clientId {info.clientId}
+	{
+		getBuckets().addTransfer(_trafficClass, _clientId);
+	}
+
+	Transfer::~Transfer()
+	{
+		getBuckets().removeTransfer(_trafficClass, _clientId);
+	}
+
+	std::chrono::steady_clock::duration
+	Transfer::onDataSent(std::size_t byteCount)
+	{
+		ClassMetrics& metrics {getClassMetrics(_trafficClass)};
+		metrics.bytes.add(byteCount);
+
+		const std::chrono::steady_clock::duration delay {getBuckets().consume(_trafficClass, _clientId, byteCount)};
+		if (delay > std::chrono::steady_clock::duration::zero())
+			metrics.delays.add();
+
+		return delay;
+	}
+
+	Wt::Http::ResponseContinuation*
+	Transfer::createContinuation(Wt::Http::Response& response, std::size_t sentByteCount)
+	{
+		const std::chrono::steady_clock::duration delay {onDataSent(sentByteCount)};
+
+		Wt::Http::ResponseContinuation* continuation {response.createContinuation()};
+		if (delay > std::chrono::steady_clock::duration::zero())
+		{
+			continuation->waitForMoreData();
+			resumeAfter(continuation, delay);
+		}
+
+		return continuation;
+	}
+
+	void
+	resumeAfter(Wt::Http::ResponseContinuation* continuation, std::chrono::steady_clock::duration delay)
+	{
+		getTimerService().schedule(delay, [continuation] { continuation->haveMoreData(); });
+	}
+}
@@ -19,19 +19,69 @@
 
 #include "FileResourceHandler.hpp"
 
-#include <fstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <sstream>
+
+#include <Wt/Http/ResponseContinuation.h>
+
+#include "utils/AsyncFileReader.hpp"
+#include "utils/Exception.hpp"
+#include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/MediaActivity.hpp"
+#include "utils/Service.hpp"
+#include "OffloadedFileResourceHandler.hpp"
+
+std::unique_ptr<IResourceHandler>
+createFileResourceHandler(const std::filesystem::path& path, const EgressScheduler::TransferInfo& transferInfo)
+{
+	return std::make_unique<FileResourceHandler>(path, transferInfo);
+}
+
+static
+std::optional<OffloadedFileResourceHandler::Mode>
+getFileOffloadMode()
+{
+	const std::string mode {Service<IConfig>::get()->getString("file-offload-mode", "none")};
+
+	if (mode == "none")
+		return std::nullopt;
+	if (mode == "x-accel-redirect")
+		return OffloadedFileResourceHandler::Mode::XAccelRedirect;
+	if (mode == "x-sendfile")
+		return OffloadedFileResourceHandler::Mode::XSendfile;
+
+	throw LmsException {"Bad value '" + mode + "' for 'file-offload-mode'"};
+}
 
 std::unique_ptr<IResourceHandler>
-createFileResourceHandler(const std::filesystem::path& path)
+createOffloadableFileResourceHandler(const std::filesystem::path& path, const EgressScheduler::TransferInfo& transferInfo)
 {
-	return std::make_unique<FileResourceHandler>(path);
+	static const std::optional<OffloadedFileResourceHandler::Mode> mode {getFileOffloadMode()};
+	if (!mode)
+		return createFileResourceHandler(path, transferInfo);
+
+	static const std::string locationPrefix {Service<IConfig>::get()->getString("file-offload-location-prefix", "/lms-files")};
+	return std::make_unique<OffloadedFileResourceHandler>(path, *mode, locationPrefix);
 }
 
 
-FileResourceHandler::FileResourceHandler(const std::filesystem::path& path)
+FileResourceHandler::ReadState::~ReadState()
+{
+	if (fd >= 0)
+		::close(fd);
+}
+
+FileResourceHandler::FileResourceHandler(const std::filesystem::path& path, const EgressScheduler::TransferInfo& transferInfo)
 : _path {path}
+, _transfer {transferInfo}
 {
 }
 
@@ -39,14 +89,17 @@ FileResourceHandler::FileResourceHandler(const std::filesystem::path& path)
 Wt::Http::ResponseContinuation*
 FileResourceHandler::processRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
 {
-	::uint64_t startByte {_offset};
-	std::ifstream ifs {_path.string().c_str(), std::ios::in | std::ios::binary};
+	MediaActivity::notify();
 
-	if (startByte == 0)
+	if (!_readState)
 	{
-		if (!ifs)
+		_readState = std::make_shared<ReadState>();
+		_readState->fd = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+
+		struct stat sb {};
+		if (_readState->fd < 0 || ::fstat(_readState->fd, &sb) < 0)
 		{
-			LMS_LOG(UTILS, ERROR) << "Cannot open file stream for '" << _path.string() << "'";
+			LMS_LOG(UTILS, ERROR) << "Cannot open file '" << _path.string() << "': " << ::strerror(errno);
 			response.setStatus(404);
 			_isFinished = true;
 			return {};
@@ -56,9 +109,7 @@ FileResourceHandler::processRequest(const Wt::Http::Request& request, Wt::Http::
 			response.setStatus(200);
 		}
 
-		ifs.seekg(0, std::ios::end);
-		const ::uint64_t fileSize {static_cast<::uint64_t>(ifs.tellg())};
-		ifs.seekg(0, std::ios::beg);
+		const ::uint64_t fileSize {static_cast<::uint64_t>(sb.st_size)};
 
 		LMS_LOG(UTILS, DEBUG) << "File '" << _path.string() << "', fileSize = " << fileSize;
 
@@ -80,15 +131,15 @@ FileResourceHandler::processRequest(const Wt::Http::Request& request, Wt::Http::
 			LMS_LOG(UTILS, DEBUG) << "Range requested = " << ranges[0].firstByte() << "/" << ranges[0].lastByte();
 
 			response.setStatus(206);
-			startByte = ranges[0].firstByte();
+			_offset = ranges[0].firstByte();
 			_beyondLastByte = ranges[0].lastByte() + 1;
 
 			std::ostringstream contentRange;
-			contentRange << "bytes " << startByte << "-"
+			contentRange << "bytes " << _offset << "-"
 				<< _beyondLastByte - 1 << "/" << fileSize;
 
 			response.addHeader("Content-Range", contentRange.str());
-			response.setContentLength(_beyondLastByte - startByte);
+			response.setContentLength(_beyondLastByte - _offset);
 		}
 		else
 		{
@@ -97,42 +148,66 @@ FileResourceHandler::processRequest(const Wt::Http::Request& request, Wt::Http::
 			_beyondLastByte = fileSize;
 			response.setContentLength(_beyondLastByte);
 		}
-	}
-	else if (!ifs)
-	{
-		LMS_LOG(UTILS, ERROR) << "Cannot reopen file stream for '" << _path.string() << "'";
-		_isFinished = true;
-		return {};
-	}
 
-	ifs.seekg(static_cast<std::istream::pos_type>(startByte));
+		if (_offset >= _beyondLastByte)
+		{
+			_isFinished = true;
+			return {};
+		}
 
-	std::vector<char> buf;
-	buf.resize(_chunkSize);
+		_readState->buffer.resize(_chunkSize);
+	}
 
-	::uint64_t restSize = _beyondLastByte - startByte;
-	::uint64_t pieceSize = buf.size() > restSize ? restSize : buf.size();
+	std::chrono::steady_clock::duration delay {};
+	if (_readPending)
+	{
+		// resumed once the previous read completed
+		_readPending = false;
 
-	ifs.read(&buf[0], pieceSize);
-	const ::uint64_t actualPieceSize {static_cast<::uint64_t>(ifs.gcount())};
-	response.out().write(&buf[0], actualPieceSize);
+		if (_readState->ec)
+		{
+			LMS_LOG(UTILS, ERROR) << "Cannot read file '" << _path.string() << "': " << _readState->ec.message();
+			_isFinished = true;
+			return {};
+		}
 
-	LMS_LOG(UTILS, DEBUG) << "Written " << actualPieceSize << " bytes";
+		const ::uint64_t actualPieceSize {_readState->readByteCount};
+		response.out().write(reinterpret_cast<const char*>(_readState->buffer.data()), actualPieceSize);
+		_offset += actualPieceSize;
 
-	LMS_LOG(UTILS, DEBUG) << "Progress: " << actualPieceSize << "/" << restSize;
-	if (ifs.good() && actualPieceSize < restSize)
-	{
-		_offset = startByte + actualPieceSize;
-		LMS_LOG(UTILS, DEBUG) << "Job not complete! Next chunk offset = " << _offset;
+		LMS_LOG(UTILS, DEBUG) << "Written " << actualPieceSize << " bytes, progress: " << _offset << "/" << _beyondLastByte;
 
-		return response.createContinuation();
+		if (actualPieceSize == 0 || _offset >= _beyondLastByte)
+		{
+			_isFinished = true;
+			LMS_LOG(UTILS, DEBUG) << "Job complete!";
+			return {};
+		}
+
+		delay = _transfer.onDataSent(actualPieceSize);
 	}
 
-	_isFinished = true;
-	LMS_LOG(UTILS, DEBUG) << "Job complete!";
+	// The next chunk is read while the current one is being sent
+	// Completion may happen on the reader thread, or right away with synchronous reads
+	Wt::Http::ResponseContinuation* continuation {response.createContinuation()};
+	continuation->waitForMoreData();
+	_readPending = true;
 
-	return {};
+	const ::uint64_t pieceSize {std::min<::uint64_t>(_readState->buffer.size(), _beyondLastByte - _offset)};
+	const auto readStartTime {std::chrono::steady_clock::now()};
+	AsyncFileReader::asyncRead(_readState->fd, _offset, _readState->buffer.data(), pieceSize,
+		[readState = _readState, continuation, delay, readStartTime](std::error_code ec, std::size_t readByteCount)
+		{
+			readState->ec = ec;
+			readState->readByteCount = readByteCount;
+
+			// The read time counts in the delay to wait before sending more data
+			const std::chrono::steady_clock::duration remainingDelay {delay - (std::chrono::steady_clock::now() - readStartTime)};
+			if (remainingDelay > std::chrono::steady_clock::duration::zero())
+				EgressScheduler::resumeAfter(continuation, remainingDelay);
+			else
+				continuation->haveMoreData();
+		});
+
+	return continuation;
 }
-
-
-
@@ -20,23 +20,42 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "utils/EgressScheduler.hpp"
 #include "utils/IResourceHandler.hpp"
 
 class FileResourceHandler final : public IResourceHandler
 {
 	public:
-		FileResourceHandler(const std::filesystem::path& filePath);
+		FileResourceHandler(const std::filesystem::path& filePath, const EgressScheduler::TransferInfo& transferInfo);
 
 	private:
 
 		Wt::Http::ResponseContinuation* processRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
 
-		static constexpr std::size_t _chunkSize {65536};
+		static constexpr std::size_t _chunkSize {262144};
+
+		// Shared with the pending read, that may complete after the handler is destroyed
+		struct ReadState
+		{
+			~ReadState();
+
+			int						fd {-1};	// kept open across continuations
+			std::vector<std::byte>	buffer;		// reused across continuations
+			std::error_code			ec;
+			std::size_t				readByteCount {};
+		};
 
 		std::filesystem::path	_path;
+		std::shared_ptr<ReadState>	_readState;
+		bool			_readPending {};
 		::uint64_t		_beyondLastByte {};
 		::uint64_t		_offset {};
 		bool			_isFinished {};
+		EgressScheduler::Transfer	_transfer;
 
 };
 
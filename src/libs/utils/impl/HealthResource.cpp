@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/HealthResource.hpp"
+
+#include <Wt/Http/Response.h>
+
+HealthResource::HealthResource(Type type)
+	: _type {type}
+{
+}
+
+HealthResource::~HealthResource()
+{
+	beingDeleted();
+}
+
+void
+HealthResource::addComponent(std::string name, GetStatusFunc getStatusFunc, bool requiredForReadiness)
+{
+	_components.push_back(Component {std::move(name), std::move(getStatusFunc), requiredForReadiness});
+}
+
+void
+HealthResource::handleRequest(const Wt::Http::Request&, Wt::Http::Response& response)
+{
+	bool ready {true};
+	for (const Component& component : _components)
+	{
+		const ComponentStatus status {component.getStatusFunc()};
+		if (!status.ready && component.requiredForReadiness)
+			ready = false;
+
+		response.out() << component.name << ": " << (status.ready ? "ready" : "not ready");
+		if (!status.details.empty())
+			response.out() << " (" << status.details << ")";
+		response.out() << "\n";
+	}
+
+	response.setStatus(_type == Type::Health || ready ? 200 : 503);
+	response.setMimeType("text/plain");
+	response.addHeader("Cache-Control", "no-cache");
+}
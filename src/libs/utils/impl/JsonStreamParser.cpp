@@ -0,0 +1,398 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/JsonStreamParser.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace JsonStream
+{
+	namespace
+	{
+		// Protects the stack against hostile documents
+		constexpr std::size_t maxDepth {512};
+
+		bool
+		isDigit(char c)
+		{
+			return c >= '0' && c <= '9';
+		}
+
+		std::optional<unsigned>
+		parseHexDigit(char c)
+		{
+			if (c >= '0' && c <= '9')
+				return c - '0';
+			if (c >= 'a' && c <= 'f')
+				return c - 'a' + 10;
+			if (c >= 'A' && c <= 'F')
+				return c - 'A' + 10;
+
+			return std::nullopt;
+		}
+
+		void
+		appendUtf8(std::string& str, std::uint32_t codePoint)
+		{
+			if (codePoint < 0x80)
+				str.push_back(static_cast<char>(codePoint));
+			else if (codePoint < 0x800)
+			{
+				str.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+				str.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+			}
+			else if (codePoint < 0x10000)
+			{
+				str.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+				str.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+				str.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+			}
+			else
+			{
+				str.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+				str.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+				str.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+				str.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+			}
+		}
+
+		class Parser
+		{
+			public:
+				Parser(std::string_view document, IHandler& handler)
+					: _document {document}
+					, _handler {handler}
+				{}
+
+				bool
+				parse()
+				{
+					if (!parseValue(true))
+						return false;
+
+					skipWhitespaces();
+					return _pos == _document.size();
+				}
+
+			private:
+				void
+				skipWhitespaces()
+				{
+					while (_pos < _document.size())
+					{
+						const char c {_document[_pos]};
+						if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+							break;
+						_pos++;
+					}
+				}
+
+				bool
+				consume(char c)
+				{
+					skipWhitespaces();
+					if (_pos >= _document.size() || _document[_pos] != c)
+						return false;
+
+					_pos++;
+					return true;
+				}
+
+				bool
+				parseValue(bool notify)
+				{
+					skipWhitespaces();
+					if (_pos >= _document.size())
+						return false;
+
+					switch (_document[_pos])
+					{
+						case '{':
+							return parseObject(notify);
+
+						case '[':
+							return parseArray(notify);
+
+						case '"':
+							if (!parseString(notify))
+								return false;
+							if (notify)
+								_handler.onScalar(_path, ScalarType::String, _buffer);
+							return true;
+
+						case 't':
+							return parseLiteral("true", ScalarType::Boolean, notify);
+						case 'f':
+							return parseLiteral("false", ScalarType::Boolean, notify);
+						case 'n':
+							return parseLiteral("null", ScalarType::Null, notify);
+
+						default:
+							return parseNumber(notify);
+					}
+				}
+
+				bool
+				parseObject(bool notify)
+				{
+					if (++_depth > maxDepth)
+						return false;
+
+					_pos++; // '{'
+					if (notify)
+						notify = _handler.onStartObject(_path);
+
+					if (!consume('}'))
+					{
+						do
+						{
+							skipWhitespaces();
+							if (_pos >= _document.size() || _document[_pos] != '"')
+								return false;
+
+							// keys are always needed to build the paths
+							if (!parseString(notify))
+								return false;
+
+							if (!consume(':'))
+								return false;
+
+							const std::size_t parentPathSize {_path.size()};
+							if (notify)
+							{
+								if (!_path.empty())
+									_path.push_back('.');
+								_path.append(_buffer);
+							}
+
+							if (!parseValue(notify))
+								return false;
+
+							_path.resize(parentPathSize);
+						}
+						while (consume(','));
+
+						if (!consume('}'))
+							return false;
+					}
+
+					if (notify)
+						_handler.onEndObject(_path);
+
+					_depth--;
+					return true;
+				}
+
+				bool
+				parseArray(bool notify)
+				{
+					if (++_depth > maxDepth)
+						return false;
+
+					_pos++; // '['
+					if (notify)
+						notify = _handler.onStartArray(_path);
+
+					if (!consume(']'))
+					{
+						do
+						{
+							if (!parseValue(notify))
+								return false;
+						}
+						while (consume(','));
+
+						if (!consume(']'))
+							return false;
+					}
+
+					if (notify)
+						_handler.onEndArray(_path);
+
+					_depth--;
+					return true;
+				}
+
+				// Unescaped result is only built in _buffer if needed
+				bool
+				parseString(bool unescape)
+				{
+					_pos++; // '"'
+					_buffer.clear();
+
+					while (_pos < _document.size())
+					{
+						const char c {_document[_pos++]};
+						if (c == '"')
+							return true;
+
+						if (static_cast<unsigned char>(c) < 0x20)
+							return false;
+
+						if (c != '\\')
+						{
+							if (unescape)
+								_buffer.push_back(c);
+							continue;
+						}
+
+						if (_pos >= _document.size())
+							return false;
+
+						const char escaped {_document[_pos++]};
+						char unescaped {};
+						switch (escaped)
+						{
+							case '"':	unescaped = '"'; break;
+							case '\\':	unescaped = '\\'; break;
+							case '/':	unescaped = '/'; break;
+							case 'b':	unescaped = '\b'; break;
+							case 'f':	unescaped = '\f'; break;
+							case 'n':	unescaped = '\n'; break;
+							case 'r':	unescaped = '\r'; break;
+							case 't':	unescaped = '\t'; break;
+							case 'u':
+							{
+								std::optional<std::uint32_t> codePoint {parseCodeUnit()};
+								if (!codePoint)
+									return false;
+
+								// surrogate pair
+								if (*codePoint >= 0xD800 && *codePoint <= 0xDBFF)
+								{
+									if (_document.substr(_pos, 2) != "\\u")
+										return false;
+									_pos += 2;
+
+									const std::optional<std::uint32_t> lowSurrogate {parseCodeUnit()};
+									if (!lowSurrogate || *lowSurrogate < 0xDC00 || *lowSurrogate > 0xDFFF)
+										return false;
+
+									codePoint = 0x10000 + ((*codePoint - 0xD800) << 10) + (*lowSurrogate - 0xDC00);
+								}
+
+								if (unescape)
+									appendUtf8(_buffer, *codePoint);
+								continue;
+							}
+
+							default:
+								return false;
+						}
+
+						if (unescape)
+							_buffer.push_back(unescaped);
+					}
+
+					return false;
+				}
+
+				std::optional<std::uint32_t>
+				parseCodeUnit()
+				{
+					if (_document.size() - _pos < 4)
+						return std::nullopt;
+
+					std::uint32_t res {};
+					for (std::size_t i {}; i < 4; ++i)
+					{
+						const std::optional<unsigned> digit {parseHexDigit(_document[_pos++])};
+						if (!digit)
+							return std::nullopt;
+
+						res = (res << 4) | *digit;
+					}
+
+					return res;
+				}
+
+				bool
+				parseLiteral(std::string_view literal, ScalarType type, bool notify)
+				{
+					if (_document.substr(_pos, literal.size()) != literal)
+						return false;
+
+					_pos += literal.size();
+					if (notify)
+						_handler.onScalar(_path, type, literal);
+
+					return true;
+				}
+
+				bool
+				parseNumber(bool notify)
+				{
+					const std::size_t start {_pos};
+
+					auto skipDigits {[&]
+					{
+						const std::size_t digitsStart {_pos};
+						while (_pos < _document.size() && isDigit(_document[_pos]))
+							_pos++;
+
+						return _pos != digitsStart;
+					}};
+
+					if (_document[_pos] == '-')
+						_pos++;
+
+					if (_pos < _document.size() && _document[_pos] == '0')
+						_pos++;
+					else if (!skipDigits())
+						return false;
+
+					if (_pos < _document.size() && _document[_pos] == '.')
+					{
+						_pos++;
+						if (!skipDigits())
+							return false;
+					}
+
+					if (_pos < _document.size() && (_document[_pos] == 'e' || _document[_pos] == 'E'))
+					{
+						_pos++;
+						if (_pos < _document.size() && (_document[_pos] == '+' || _document[_pos] == '-'))
+							_pos++;
+						if (!skipDigits())
+							return false;
+					}
+
+					if (notify)
+						_handler.onScalar(_path, ScalarType::Number, _document.substr(start, _pos - start));
+
+					return true;
+				}
+
+				const std::string_view	_document;
+				IHandler&				_handler;
+				std::size_t				_pos {};
+				std::size_t				_depth {};
+				std::string				_path;
+				std::string				_buffer;
+		};
+	}
+
+	bool
+	parse(std::string_view document, IHandler& handler)
+	{
+		return Parser {document, handler}.parse();
+	}
+}
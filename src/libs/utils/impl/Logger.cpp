@@ -58,6 +58,13 @@ const char* getSeverityName(Severity sev)
 	return "";
 }
 
+bool
+isLogActive(Module module, Severity severity)
+{
+	const Logger* logger {Service<Logger>::get()};
+	return logger && logger->isSeverityActive(module, severity);
+}
+
 Log::Log(Logger* logger, Module module, Severity severity)
 	: _module {module},
 	_severity {severity},
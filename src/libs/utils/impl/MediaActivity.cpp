@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "utils/MediaActivity.hpp"
+
+#include <atomic>
+
+namespace MediaActivity
+{
+	namespace
+	{
+		// steady clock ticks, zero if never notified
+		std::atomic<std::chrono::steady_clock::rep> lastActivity {};
+	}
+
+	void
+	notify()
+	{
+		lastActivity.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+	}
+
+	bool
+	isActive(std::chrono::steady_clock::duration window)
+	{
+		const std::chrono::steady_clock::rep last {lastActivity.load(std::memory_order_relaxed)};
+		if (last == 0)
+			return false;
+
+		return std::chrono::steady_clock::now() - std::chrono::steady_clock::time_point {std::chrono::steady_clock::duration {last}} < window;
+	}
+}
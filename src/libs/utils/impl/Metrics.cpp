@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/Metrics.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+
+#include "utils/Exception.hpp"
+
+namespace Metrics
+{
+	namespace details
+	{
+		std::size_t
+		getCurrentShard()
+		{
+			static std::atomic<std::size_t> nextShard {};
+			static thread_local const std::size_t shard {nextShard.fetch_add(1, std::memory_order_relaxed) % shardCount};
+
+			return shard;
+		}
+	}
+
+	namespace
+	{
+		constexpr std::size_t valuesPerCacheLine {64 / sizeof(std::uint64_t)};
+
+		void
+		writeSeconds(std::ostream& os, Histogram::Duration duration)
+		{
+			os << std::chrono::duration<double> {duration}.count();
+		}
+
+		void
+		writeSeriesName(std::ostream& os, std::string_view name, std::string_view suffix, std::string_view labels, std::string_view extraLabel = {})
+		{
+			os << name << suffix;
+			if (!labels.empty() || !extraLabel.empty())
+			{
+				os << '{' << labels;
+				if (!labels.empty() && !extraLabel.empty())
+					os << ',';
+				os << extraLabel << '}';
+			}
+			os << ' ';
+		}
+	}
+
+	std::uint64_t
+	Counter::get() const
+	{
+		std::uint64_t res {};
+		for (const details::CounterShard& shard : _shards)
+			res += shard.value.load(std::memory_order_relaxed);
+
+		return res;
+	}
+
+	Histogram::Histogram(std::vector<Duration> bucketUpperBounds)
+		: _bucketUpperBounds {std::move(bucketUpperBounds)}
+		, _shardStride {((_bucketUpperBounds.size() + 2 + valuesPerCacheLine - 1) / valuesPerCacheLine) * valuesPerCacheLine}
+		, _values {std::make_unique<std::atomic<std::uint64_t>[]>(details::shardCount * _shardStride)}
+	{
+		assert(std::is_sorted(std::cbegin(_bucketUpperBounds), std::cend(_bucketUpperBounds)));
+	}
+
+	void
+	Histogram::observe(Duration duration)
+	{
+		const std::size_t shard {details::getCurrentShard()};
+
+		// last bucket is +Inf
+		const std::size_t bucket {static_cast<std::size_t>(std::distance(std::cbegin(_bucketUpperBounds), std::lower_bound(std::cbegin(_bucketUpperBounds), std::cend(_bucketUpperBounds), duration)))};
+		_values[getIndex(shard, bucket)].fetch_add(1, std::memory_order_relaxed);
+		_values[getIndex(shard, _bucketUpperBounds.size() + 1)].fetch_add(static_cast<std::uint64_t>(std::max<Duration::rep>(duration.count(), 0)), std::memory_order_relaxed);
+	}
+
+	Histogram::Snapshot
+	Histogram::get() const
+	{
+		Snapshot res;
+		res.bucketUpperBounds = _bucketUpperBounds;
+		res.cumulativeCounts.resize(_bucketUpperBounds.size() + 1);
+
+		std::uint64_t sum {};
+		for (std::size_t shard {}; shard < details::shardCount; ++shard)
+		{
+			for (std::size_t bucket {}; bucket < res.cumulativeCounts.size(); ++bucket)
+				res.cumulativeCounts[bucket] += _values[getIndex(shard, bucket)].load(std::memory_order_relaxed);
+
+			sum += _values[getIndex(shard, _bucketUpperBounds.size() + 1)].load(std::memory_order_relaxed);
+		}
+
+		for (std::size_t bucket {1}; bucket < res.cumulativeCounts.size(); ++bucket)
+			res.cumulativeCounts[bucket] += res.cumulativeCounts[bucket - 1];
+
+		res.count = res.cumulativeCounts.back();
+		res.sum = Duration {static_cast<Duration::rep>(sum)};
+
+		return res;
+	}
+
+	std::vector<Histogram::Duration>
+	Histogram::getDefaultBucketUpperBounds()
+	{
+		using namespace std::chrono_literals;
+
+		return {1ms, 5ms, 10ms, 25ms, 50ms, 100ms, 250ms, 500ms, 1s, 2500ms, 5s, 10s};
+	}
+
+	Counter&
+	Registry::createCounter(std::string_view name, std::string_view help, std::string_view labels)
+	{
+		const std::scoped_lock lock {_mutex};
+
+		if (const Entry* entry {findEntry(name, labels, Type::Counter)})
+			return *entry->counter;
+
+		Counter& res {_counters.emplace_back()};
+		_entries.push_back(Entry {std::string {name}, std::string {help}, std::string {labels}, Type::Counter, &res, nullptr, nullptr});
+
+		return res;
+	}
+
+	Gauge&
+	Registry::createGauge(std::string_view name, std::string_view help, std::string_view labels)
+	{
+		const std::scoped_lock lock {_mutex};
+
+		if (const Entry* entry {findEntry(name, labels, Type::Gauge)})
+			return *entry->gauge;
+
+		Gauge& res {_gauges.emplace_back()};
+		_entries.push_back(Entry {std::string {name}, std::string {help}, std::string {labels}, Type::Gauge, nullptr, &res, nullptr});
+
+		return res;
+	}
+
+	Histogram&
+	Registry::createHistogram(std::string_view name, std::string_view help, std::string_view labels, std::vector<Histogram::Duration> bucketUpperBounds)
+	{
+		const std::scoped_lock lock {_mutex};
+
+		if (const Entry* entry {findEntry(name, labels, Type::Histogram)})
+			return *entry->histogram;
+
+		Histogram& res {_histograms.emplace_back(std::move(bucketUpperBounds))};
+		_entries.push_back(Entry {std::string {name}, std::string {help}, std::string {labels}, Type::Histogram, nullptr, nullptr, &res});
+
+		return res;
+	}
+
+	const Registry::Entry*
+	Registry::findEntry(std::string_view name, std::string_view labels, Type type) const
+	{
+		for (const Entry& entry : _entries)
+		{
+			if (entry.name != name)
+				continue;
+
+			if (entry.type != type)
+				throw LmsException {"Metric '" + std::string {name} + "' already registered with another type"};
+
+			if (entry.labels == labels)
+				return &entry;
+		}
+
+		return nullptr;
+	}
+
+	void
+	Registry::serialize(std::ostream& os) const
+	{
+		std::vector<const Entry*> entries;
+		{
+			const std::scoped_lock lock {_mutex};
+
+			entries.reserve(_entries.size());
+			for (const Entry& entry : _entries)
+				entries.push_back(&entry);
+		}
+
+		// series of a same metric must be grouped
+		std::stable_sort(std::begin(entries), std::end(entries), [](const Entry* lhs, const Entry* rhs) { return lhs->name < rhs->name; });
+
+		auto typeToString {[](Type type) -> std::string_view
+		{
+			switch (type)
+			{
+				case Type::Counter:		return "counter";
+				case Type::Gauge:		return "gauge";
+				case Type::Histogram:	return "histogram";
+			}
+			return "untyped";
+		}};
+
+		const std::string* previousName {};
+		for (const Entry* entry : entries)
+		{
+			if (!previousName || *previousName != entry->name)
+			{
+				os << "# HELP " << entry->name << ' ' << entry->help << '\n';
+				os << "# TYPE " << entry->name << ' ' << typeToString(entry->type) << '\n';
+				previousName = &entry->name;
+			}
+
+			switch (entry->type)
+			{
+				case Type::Counter:
+					writeSeriesName(os, entry->name, "_total", entry->labels);
+					os << entry->counter->get() << '\n';
+					break;
+
+				case Type::Gauge:
+					writeSeriesName(os, entry->name, "", entry->labels);
+					os << entry->gauge->get() << '\n';
+					break;
+
+				case Type::Histogram:
+				{
+					const Histogram::Snapshot snapshot {entry->histogram->get()};
+					for (std::size_t bucket {}; bucket < snapshot.bucketUpperBounds.size(); ++bucket)
+					{
+						std::ostringstream le;
+						le << "le=\"";
+						writeSeconds(le, snapshot.bucketUpperBounds[bucket]);
+						le << '"';
+
+						writeSeriesName(os, entry->name, "_bucket", entry->labels, le.str());
+						os << snapshot.cumulativeCounts[bucket] << '\n';
+					}
+					writeSeriesName(os, entry->name, "_bucket", entry->labels, "le=\"+Inf\"");
+					os << snapshot.count << '\n';
+
+					writeSeriesName(os, entry->name, "_sum", entry->labels);
+					writeSeconds(os, snapshot.sum);
+					os << '\n';
+
+					writeSeriesName(os, entry->name, "_count", entry->labels);
+					os << snapshot.count << '\n';
+					break;
+				}
+			}
+		}
+	}
+
+	Registry&
+	getRegistry()
+	{
+		static Registry registry;
+		return registry;
+	}
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "OffloadedFileResourceHandler.hpp"
+
+#include <Wt/Utils.h>
+
+#include "utils/Logger.hpp"
+#include "utils/MediaActivity.hpp"
+
+OffloadedFileResourceHandler::OffloadedFileResourceHandler(const std::filesystem::path& path, Mode mode, const std::string& locationPrefix)
+: _path {path}
+, _mode {mode}
+, _locationPrefix {locationPrefix}
+{
+}
+
+Wt::Http::ResponseContinuation*
+OffloadedFileResourceHandler::processRequest(const Wt::Http::Request&, Wt::Http::Response& response)
+{
+	// The proxy reads the file right after
+	MediaActivity::notify();
+
+	// Report missing files ourselves, the proxy would not know which error to log
+	std::error_code ec;
+	if (!std::filesystem::is_regular_file(_path, ec))
+	{
+		LMS_LOG(UTILS, ERROR) << "Cannot find file '" << _path.string() << "'";
+		response.setStatus(404);
+		return {};
+	}
+
+	const std::string absolutePath {std::filesystem::absolute(_path, ec).string()};
+
+	response.setStatus(200);
+	switch (_mode)
+	{
+		case Mode::XAccelRedirect:
+			response.addHeader("X-Accel-Redirect", _locationPrefix + Wt::Utils::urlEncode(absolutePath, "/"));
+			break;
+
+		case Mode::XSendfile:
+			response.addHeader("X-Sendfile", absolutePath);
+			break;
+	}
+
+	LMS_LOG(UTILS, DEBUG) << "File '" << absolutePath << "' offloaded to the reverse proxy";
+
+	return {};
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+#include "utils/IResourceHandler.hpp"
+
+// Only replies with a header telling the reverse proxy which file to serve: the proxy handles the ranges and the transfer
+class OffloadedFileResourceHandler final : public IResourceHandler
+{
+	public:
+		enum class Mode
+		{
+			XAccelRedirect,	// nginx: internal location prefix + url encoded absolute path
+			XSendfile,		// Apache (mod_xsendfile), lighttpd: absolute path
+		};
+
+		OffloadedFileResourceHandler(const std::filesystem::path& filePath, Mode mode, const std::string& locationPrefix);
+
+	private:
+		Wt::Http::ResponseContinuation* processRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+
+		std::filesystem::path	_path;
+		Mode					_mode;
+		std::string				_locationPrefix;
+};
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/ParallelForPool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace Utils
+{
+	namespace
+	{
+		// Enough chunks per participant to balance uneven chunk costs
+		constexpr std::size_t autoChunkCountPerParticipant {8};
+	}
+
+	ParallelForPool::ParallelForPool(std::size_t threadCount)
+	: _shares {std::make_unique<Share[]>(std::max<std::size_t>(threadCount, 1))}
+	{
+		for (std::size_t i {1}; i < threadCount; ++i)
+			_workers.emplace_back([this, i] { workerLoop(i); });
+	}
+
+	ParallelForPool::~ParallelForPool()
+	{
+		{
+			std::scoped_lock lock {_mutex};
+			_stop = true;
+		}
+		_workerCv.notify_all();
+
+		for (std::thread& worker : _workers)
+			worker.join();
+	}
+
+	void
+	ParallelForPool::parallelFor(std::size_t count, const RangeFunc& func, std::size_t chunkSize)
+	{
+		if (count == 0)
+			return;
+
+		const std::size_t participantCount {getThreadCount()};
+		if (chunkSize == 0)
+			chunkSize = std::max<std::size_t>(count / (participantCount * autoChunkCountPerParticipant), 1);
+
+		const std::size_t chunkCount {(count + chunkSize - 1) / chunkSize};
+		if (participantCount == 1 || chunkCount == 1)
+		{
+			for (std::size_t first {}; first < count; first += chunkSize)
+				func(first, std::min(first + chunkSize, count));
+			return;
+		}
+
+		for (std::size_t i {}; i < participantCount; ++i)
+		{
+			_shares[i].next.store(i * chunkCount / participantCount, std::memory_order_relaxed);
+			_shares[i].end = (i + 1) * chunkCount / participantCount;
+		}
+
+		{
+			std::scoped_lock lock {_mutex};
+
+			_func = &func;
+			_count = count;
+			_chunkSize = chunkSize;
+			_failed = false;
+			_exception = nullptr;
+			_runningWorkerCount = _workers.size();
+			_generation++;
+		}
+		_workerCv.notify_all();
+
+		runChunks(0);
+
+		std::exception_ptr exception;
+		{
+			std::unique_lock lock {_mutex};
+			_doneCv.wait(lock, [this] { return _runningWorkerCount == 0; });
+
+			_func = nullptr;
+			exception = std::exchange(_exception, nullptr);
+		}
+
+		if (exception)
+			std::rethrow_exception(exception);
+	}
+
+	void
+	ParallelForPool::workerLoop(std::size_t participantIndex)
+	{
+		std::size_t lastGeneration {};
+
+		while (true)
+		{
+			{
+				std::unique_lock lock {_mutex};
+				_workerCv.wait(lock, [&] { return _stop || _generation != lastGeneration; });
+				if (_stop)
+					return;
+
+				lastGeneration = _generation;
+			}
+
+			runChunks(participantIndex);
+
+			bool done {};
+			{
+				std::scoped_lock lock {_mutex};
+				done = (--_runningWorkerCount == 0);
+			}
+			if (done)
+				_doneCv.notify_one();
+		}
+	}
+
+	void
+	ParallelForPool::runChunks(std::size_t participantIndex)
+	{
+		const std::size_t participantCount {getThreadCount()};
+
+		// Own share first, then steal from the next participants
+		for (std::size_t i {}; i < participantCount; ++i)
+		{
+			Share& share {_shares[(participantIndex + i) % participantCount]};
+
+			while (!_failed.load(std::memory_order_relaxed))
+			{
+				const std::size_t chunk {share.next.fetch_add(1, std::memory_order_relaxed)};
+				if (chunk >= share.end)
+					break;
+
+				const std::size_t first {chunk * _chunkSize};
+				try
+				{
+					(*_func)(first, std::min(first + _chunkSize, _count));
+				}
+				catch (...)
+				{
+					std::scoped_lock lock {_mutex};
+					if (!_exception)
+						_exception = std::current_exception();
+					_failed = true;
+				}
+			}
+		}
+	}
+} // namespace Utils
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/Profiling.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
+#include <pthread.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace Profiling
+{
+	namespace
+	{
+		struct ThreadState
+		{
+			clockid_t					cpuClock {};
+			bool						hasCpuClock {};
+			std::atomic<const char*>	label {};
+			std::atomic<const char*>	subLabel {};
+		};
+
+		class ThreadRegistry
+		{
+			public:
+				void add(const std::shared_ptr<ThreadState>& state)
+				{
+					const std::scoped_lock lock {_mutex};
+					_states.push_back(state);
+				}
+
+				void remove(const std::shared_ptr<ThreadState>& state)
+				{
+					const std::scoped_lock lock {_mutex};
+					_states.erase(std::remove(std::begin(_states), std::end(_states), state), std::end(_states));
+				}
+
+				std::vector<std::shared_ptr<ThreadState>> getStates() const
+				{
+					const std::scoped_lock lock {_mutex};
+					return _states;
+				}
+
+			private:
+				mutable std::mutex							_mutex;
+				std::vector<std::shared_ptr<ThreadState>>	_states;
+		};
+
+		ThreadRegistry&
+		getThreadRegistry()
+		{
+			static ThreadRegistry registry;
+			return registry;
+		}
+
+		// Registered on first use, unregistered at thread exit
+		class ThreadRegistration
+		{
+			public:
+				ThreadRegistration()
+				{
+					_state->hasCpuClock = pthread_getcpuclockid(pthread_self(), &_state->cpuClock) == 0;
+					getThreadRegistry().add(_state);
+				}
+
+				~ThreadRegistration()
+				{
+					getThreadRegistry().remove(_state);
+				}
+
+				ThreadState& getState() { return *_state; }
+
+			private:
+				const std::shared_ptr<ThreadState> _state {std::make_shared<ThreadState>()};
+		};
+
+		ThreadState&
+		getCurrentThreadState()
+		{
+			static thread_local ThreadRegistration registration;
+			return registration.getState();
+		}
+
+		std::optional<std::chrono::nanoseconds>
+		getCpuTime(clockid_t clock)
+		{
+			timespec ts;
+			if (clock_gettime(clock, &ts) != 0)
+				return std::nullopt;
+
+			return std::chrono::seconds {ts.tv_sec} + std::chrono::nanoseconds {ts.tv_nsec};
+		}
+	}
+
+	ScopedLabel::ScopedLabel(const char* label)
+	{
+		ThreadState& state {getCurrentThreadState()};
+
+		_previousLabel = state.label.exchange(label, std::memory_order_relaxed);
+		_previousSubLabel = state.subLabel.exchange(nullptr, std::memory_order_relaxed);
+	}
+
+	ScopedLabel::~ScopedLabel()
+	{
+		ThreadState& state {getCurrentThreadState()};
+
+		state.label.store(_previousLabel, std::memory_order_relaxed);
+		state.subLabel.store(_previousSubLabel, std::memory_order_relaxed);
+	}
+
+	ScopedSubLabel::ScopedSubLabel(const char* subLabel)
+		: _previousSubLabel {getCurrentThreadState().subLabel.exchange(subLabel, std::memory_order_relaxed)}
+	{
+	}
+
+	ScopedSubLabel::~ScopedSubLabel()
+	{
+		getCurrentThreadState().subLabel.store(_previousSubLabel, std::memory_order_relaxed);
+	}
+
+	CpuProfile
+	captureCpuProfile(std::chrono::milliseconds duration, std::chrono::milliseconds samplingPeriod)
+	{
+		using Clock = std::chrono::steady_clock;
+
+		struct ThreadSample
+		{
+			std::shared_ptr<ThreadState>	state; // keeps the state alive if the thread exits
+			std::chrono::nanoseconds		cpuTime;
+		};
+		std::unordered_map<const ThreadState*, ThreadSample> lastSamples;
+		std::unordered_map<std::string, std::chrono::nanoseconds> cpuTimeByLabel;
+
+		auto sample {[&](bool attribute)
+		{
+			for (const std::shared_ptr<ThreadState>& state : getThreadRegistry().getStates())
+			{
+				if (!state->hasCpuClock)
+					continue;
+
+				const std::optional<std::chrono::nanoseconds> cpuTime {getCpuTime(state->cpuClock)};
+				if (!cpuTime)
+					continue;
+
+				auto [itLastSample, inserted] {lastSamples.try_emplace(state.get(), ThreadSample {state, *cpuTime})};
+				if (inserted || !attribute)
+					continue;
+
+				const std::chrono::nanoseconds cpuTimeDelta {*cpuTime - itLastSample->second.cpuTime};
+				itLastSample->second.cpuTime = *cpuTime;
+				if (cpuTimeDelta.count() <= 0)
+					continue;
+
+				const char* label {state->label.load(std::memory_order_relaxed)};
+				const char* subLabel {state->subLabel.load(std::memory_order_relaxed)};
+
+				std::string key {label ? label : "(unlabelled)"};
+				if (subLabel)
+				{
+					key += " > ";
+					key += subLabel;
+				}
+				cpuTimeByLabel[key] += cpuTimeDelta;
+			}
+		}};
+
+		const std::optional<std::chrono::nanoseconds> processCpuTimeStart {getCpuTime(CLOCK_PROCESS_CPUTIME_ID)};
+		const Clock::time_point start {Clock::now()};
+		const Clock::time_point end {start + duration};
+
+		sample(false);
+		for (Clock::time_point next {start + samplingPeriod}; next < end; next += samplingPeriod)
+		{
+			std::this_thread::sleep_until(next);
+			sample(true);
+		}
+		std::this_thread::sleep_until(end);
+		sample(true);
+
+		const std::optional<std::chrono::nanoseconds> processCpuTimeEnd {getCpuTime(CLOCK_PROCESS_CPUTIME_ID)};
+
+		CpuProfile profile;
+		profile.duration = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+		if (processCpuTimeStart && processCpuTimeEnd)
+			profile.processCpuTime = std::chrono::duration_cast<std::chrono::microseconds>(*processCpuTimeEnd - *processCpuTimeStart);
+
+		for (const auto& [label, cpuTime] : cpuTimeByLabel)
+			profile.entries.push_back(CpuProfile::Entry {label, std::chrono::duration_cast<std::chrono::microseconds>(cpuTime)});
+
+		std::sort(std::begin(profile.entries), std::end(profile.entries), [](const CpuProfile::Entry& lhs, const CpuProfile::Entry& rhs) { return lhs.cpuTime > rhs.cpuTime; });
+
+		return profile;
+	}
+
+	std::string
+	getHeapInfo()
+	{
+		std::string res;
+
+#ifdef __GLIBC__
+		char* buffer {};
+		std::size_t bufferSize {};
+		if (FILE* stream {open_memstream(&buffer, &bufferSize)})
+		{
+			if (malloc_info(0, stream) == 0)
+			{
+				std::fflush(stream);
+				res.assign(buffer, bufferSize);
+			}
+			std::fclose(stream);
+			std::free(buffer);
+		}
+#endif
+
+		return res;
+	}
+}
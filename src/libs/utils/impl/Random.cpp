@@ -19,6 +19,8 @@
 
 #include "utils/Random.hpp"
 
+#include <cassert>
+
 namespace Random {
 
 RandGenerator& getRandGenerator()
@@ -34,5 +36,64 @@ RandGenerator createSeededGenerator(uint_fast32_t seed)
 	return RandGenerator {seed};
 }
 
+namespace
+{
+	std::uint64_t
+	mix(std::uint64_t value)
+	{
+		// splitmix64 finalizer
+		value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+		return value ^ (value >> 31);
+	}
+}
+
+Permutation::Permutation(std::size_t size, std::uint64_t seed)
+: _size {size}
+{
+	// Feistel network over the smallest even bit count covering size
+	while ((std::uint64_t {1} << (2 * _halfBitCount)) < _size)
+		++_halfBitCount;
+
+	for (std::uint64_t& roundKey : _roundKeys)
+	{
+		seed = mix(seed + 0x9E3779B97F4A7C15ULL);
+		roundKey = seed;
+	}
+}
+
+std::size_t
+Permutation::operator[](std::size_t index) const
+{
+	assert(index < _size);
+
+	// cycle walking: the network permutes a range at most 4 times bigger than size
+	std::uint64_t value {index};
+	do
+	{
+		value = encrypt(value);
+	}
+	while (value >= _size);
+
+	return value;
+}
+
+std::uint64_t
+Permutation::encrypt(std::uint64_t value) const
+{
+	const std::uint64_t halfMask {(std::uint64_t {1} << _halfBitCount) - 1};
+
+	std::uint64_t left {value >> _halfBitCount};
+	std::uint64_t right {value & halfMask};
+	for (const std::uint64_t roundKey : _roundKeys)
+	{
+		const std::uint64_t newRight {left ^ (mix(right ^ roundKey) & halfMask)};
+		left = right;
+		right = newRight;
+	}
+
+	return (left << _halfBitCount) | right;
+}
+
 } // Random
 
@@ -19,7 +19,52 @@
 
 #include "utils/RecursiveSharedMutex.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <vector>
+
+namespace
+{
+	struct SharedCount
+	{
+		const RecursiveSharedMutex* mutex;
+		std::size_t count;
+	};
+
+	// Threads usually hold very few mutexes at once: a small vector is enough
+	thread_local std::vector<SharedCount> sharedCounts;
+
+	std::vector<SharedCount>::iterator
+	findSharedCount(const RecursiveSharedMutex* mutex)
+	{
+		return std::find_if(std::begin(sharedCounts), std::end(sharedCounts), [=](const SharedCount& sharedCount) { return sharedCount.mutex == mutex; });
+	}
+
+	std::size_t&
+	getOrCreateSharedCount(const RecursiveSharedMutex* mutex)
+	{
+		auto it {findSharedCount(mutex)};
+		if (it == std::end(sharedCounts))
+			return sharedCounts.emplace_back(SharedCount {mutex, 0}).count;
+
+		return it->count;
+	}
+
+	// returns the remaining count
+	std::size_t
+	decrementSharedCount(const RecursiveSharedMutex* mutex)
+	{
+		auto it {findSharedCount(mutex)};
+		assert(it != std::end(sharedCounts));
+		assert(it->count > 0);
+
+		const std::size_t count {--it->count};
+		if (count == 0)
+			sharedCounts.erase(it);
+
+		return count;
+	}
+}
 
 void
 RecursiveSharedMutex::lock()
@@ -47,7 +92,7 @@ RecursiveSharedMutex::unlock()
 
 	if (--_uniqueCount == 0)
 	{
-		_uniqueOwner = {};
+		_uniqueOwner = std::thread::id {};
 		_mutex.unlock();
 	}
 }
@@ -55,83 +100,37 @@ RecursiveSharedMutex::unlock()
 void
 RecursiveSharedMutex::lock_shared()
 {
-	const auto thisThreadId {std::this_thread::get_id()};
-
-	if (_uniqueOwner == thisThreadId )
-	{
-		// alone here, no need to lock
-		_sharedCounts[thisThreadId]++;
-
-		return;
-	}
-
-	bool needLock {};
-
-	{
-		std::scoped_lock lock {_sharedCountMutex};
-
-		auto& sharedCount {_sharedCounts[thisThreadId]};
-		if (sharedCount == 0)
-			needLock = true;
-		else
-			++sharedCount;
-	}
+	std::size_t& sharedCount {getOrCreateSharedCount(this)};
 
-	if (needLock)
+	// alone here or already shared locked: no need to lock
+	if (_uniqueOwner != std::this_thread::get_id() && sharedCount == 0)
 	{
 		_mutex.lock_shared();
-
 		assert(_uniqueOwner == std::thread::id {});
-
-		std::scoped_lock lock {_sharedCountMutex};
-		_sharedCounts[thisThreadId]++;
 	}
+
+	sharedCount++;
 }
 
 void
 RecursiveSharedMutex::unlock_shared()
 {
-	const auto thisThreadId {std::this_thread::get_id()};
+	const bool uniqueLocked {_uniqueOwner == std::this_thread::get_id()};
 
-	if (_uniqueOwner == thisThreadId )
-	{
-		// alone here, no need to lock
-		auto& sharedCount {_sharedCounts[thisThreadId ]};
-		assert(sharedCount > 0);
-		--sharedCount;
-
-		return;
-	}
-
-	bool needUnlock {};
-
-	{
-		std::scoped_lock lock {_sharedCountMutex};
-
-		auto& sharedCount {_sharedCounts[thisThreadId]};
-		assert(sharedCount > 0);
-		needUnlock = (--sharedCount == 0);
-	}
-
-	if (needUnlock)
+	if (decrementSharedCount(this) == 0 && !uniqueLocked)
 		_mutex.unlock_shared();
 }
 
 #ifndef NDEBUG
 bool
-RecursiveSharedMutex::isUniqueLocked()
+RecursiveSharedMutex::isUniqueLocked() const
 {
 	return _uniqueOwner == std::this_thread::get_id();
 }
 
 bool
-RecursiveSharedMutex::isSharedLocked()
+RecursiveSharedMutex::isSharedLocked() const
 {
-	const auto thisThreadId {std::this_thread::get_id()};
-	if (_uniqueOwner == thisThreadId )
-		return true;
-
-	std::scoped_lock lock {_sharedCountMutex};
-	return _sharedCounts[thisThreadId] > 0;
+	return isUniqueLocked() || findSharedCount(this) != std::end(sharedCounts);
 }
 #endif
@@ -20,6 +20,7 @@
 #include "utils/String.hpp"
 
 #include <algorithm>
+#include <cctype>
 #include <iomanip>
 #include <unordered_map>
 
@@ -27,8 +28,105 @@
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string.hpp>
 
+#include "utils/TargetClones.hpp"
+
+// The kernels process blocks of bytes without early exit, so that the compiler vectorizes them
+// On x86-64 (glibc), several versions are built and picked at load time depending on the CPU
+#define LMS_STRING_KERNEL LMS_TARGET_CLONES("avx2", "sse4.2", "default")
+
 namespace StringUtils {
 
+namespace
+{
+	constexpr std::size_t blockSize {16};
+	// Larger sets are not worth comparing against each byte of the blocks
+	constexpr std::size_t maxBlockSetSize {8};
+
+	// Index of the first char that belongs to the set (or that does not, if inSet is false), size if none
+	LMS_STRING_KERNEL
+	std::size_t
+	findFirst(const char* data, std::size_t size, const char* set, std::size_t setSize, bool inSet)
+	{
+		const unsigned char flip {inSet ? static_cast<unsigned char>(0) : static_cast<unsigned char>(1)};
+
+		std::size_t i {};
+		if (setSize <= maxBlockSetSize)
+		{
+			for (; i + blockSize <= size; i += blockSize)
+			{
+				unsigned char matches[blockSize] {};
+				for (std::size_t k {}; k < setSize; ++k)
+				{
+					for (std::size_t j {}; j < blockSize; ++j)
+						matches[j] |= (data[i + j] == set[k]);
+				}
+
+				unsigned char found {};
+				for (std::size_t j {}; j < blockSize; ++j)
+				{
+					matches[j] ^= flip;
+					found |= matches[j];
+				}
+
+				if (found)
+				{
+					for (std::size_t j {}; j < blockSize; ++j)
+					{
+						if (matches[j])
+							return i + j;
+					}
+				}
+			}
+		}
+
+		for (; i < size; ++i)
+		{
+			unsigned char match {};
+			for (std::size_t k {}; k < setSize; ++k)
+				match |= (data[i] == set[k]);
+
+			if (match ^ flip)
+				return i;
+		}
+
+		return size;
+	}
+
+	// Same as std::tolower in the "C" locale, the one used by LMS
+	LMS_STRING_KERNEL
+	void
+	asciiToLower(const char* input, char* output, std::size_t size)
+	{
+		for (std::size_t i {}; i < size; ++i)
+		{
+			const unsigned char c {static_cast<unsigned char>(input[i])};
+			output[i] = static_cast<char>(c + (static_cast<unsigned char>(c - 'A') < 26 ? 'a' - 'A' : 0));
+		}
+	}
+
+	// Same as std::string_view::find_first_of
+	std::size_t
+	findFirstOf(std::string_view str, std::size_t pos, std::string_view set)
+	{
+		if (pos >= str.size())
+			return std::string_view::npos;
+
+		const std::size_t res {pos + findFirst(str.data() + pos, str.size() - pos, set.data(), set.size(), true)};
+		return res < str.size() ? res : std::string_view::npos;
+	}
+
+	// Same as std::string_view::find_first_not_of
+	std::size_t
+	findFirstNotOf(std::string_view str, std::size_t pos, std::string_view set)
+	{
+		if (pos >= str.size())
+			return std::string_view::npos;
+
+		const std::size_t res {pos + findFirst(str.data() + pos, str.size() - pos, set.data(), set.size(), false)};
+		return res < str.size() ? res : std::string_view::npos;
+	}
+}
+
 bool
 readList(const std::string& str, const std::string& separators, std::list<std::string>& results)
 {
@@ -81,9 +179,9 @@ splitString(std::string_view str, std::string_view separators)
 
 	std::string_view::size_type strBegin {};
 
-	while ((strBegin = str.find_first_not_of(separators, strBegin)) != std::string_view::npos)
+	while ((strBegin = findFirstNotOf(str, strBegin, separators)) != std::string_view::npos)
 	{
-		auto strEnd {str.find_first_of(separators, strBegin + 1)};
+		auto strEnd {findFirstOf(str, strBegin + 1, separators)};
 		if (strEnd == std::string_view::npos)
 		{
 			res.push_back(str.substr(strBegin, str.size() - strBegin));
@@ -125,10 +223,8 @@ stringTrimEnd(std::string_view str, std::string_view whitespaces)
 std::string
 stringToLower(std::string_view str)
 {
-	std::string res;
-	res.reserve(str.size());
-
-	std::transform(std::cbegin(str), std::cend(str), std::back_inserter(res), [](unsigned char c) { return std::tolower(c);});
+	std::string res (str.size(), '\0');
+	asciiToLower(str.data(), res.data(), str.size());
 
 	return res;
 }
@@ -136,7 +232,7 @@ stringToLower(std::string_view str)
 void
 stringToLower(std::string& str)
 {
-	std::transform(std::cbegin(str), std::cend(str), std::begin(str), [](unsigned char c) { return std::tolower(c);});
+	asciiToLower(str.data(), str.data(), str.size());
 }
 
 std::string
@@ -181,6 +277,7 @@ replaceInString(const std::string& str, const std::string& from, const std::stri
 std::string
 jsEscape(const std::string& str)
 {
+	static constexpr std::string_view charsToEscape {"\\\n\r\t\"\'"};
 	static const std::unordered_map<char, std::string_view> escapeMap
 	{
 		{ '\\', "\\\\" },
@@ -194,16 +291,17 @@ jsEscape(const std::string& str)
 	std::string escaped;
 	escaped.reserve(str.length());
 
-	for (const char c : str)
+	// Copy the runs of chars that do not need to be escaped at once
+	std::size_t pos {};
+	while (pos < str.size())
 	{
-		auto it {escapeMap.find(c)};
-		if (it == std::cend(escapeMap))
-		{
-			escaped += c;
-			continue;
-		}
+		const std::size_t escapePos {std::min(findFirstOf(str, pos, charsToEscape), str.size())};
+		escaped.append(str, pos, escapePos - pos);
+		if (escapePos == str.size())
+			break;
 
-		escaped += it->second;
+		escaped += escapeMap.find(str[escapePos])->second;
+		pos = escapePos + 1;
 	}
 
 	return escaped;
@@ -215,21 +313,27 @@ escapeString(std::string_view str, std::string_view charsToEscape, char escapeCh
 	std::string res;
 	res.reserve(str.size());
 
-	for (const char c : str)
+	// Copy the runs of chars that do not need to be escaped at once
+	std::size_t pos {};
+	while (pos < str.size())
 	{
-		if (std::any_of(std::cbegin(charsToEscape), std::cend(charsToEscape), [c](char charToEscape) { return c == charToEscape; }))
-			res += escapeChar;
+		const std::size_t escapePos {std::min(findFirstOf(str, pos, charsToEscape), str.size())};
+		res.append(str, pos, escapePos - pos);
+		if (escapePos == str.size())
+			break;
 
-		res += c;
+		res += escapeChar;
+		res += str[escapePos];
+		pos = escapePos + 1;
 	}
 
 	return res;
 }
 
 bool
-stringEndsWith(const std::string& str, const std::string& ending)
+stringEndsWith(std::string_view str, std::string_view ending)
 {
-	return boost::algorithm::ends_with(str, ending);
+	return str.size() >= ending.size() && str.compare(str.size() - ending.size(), ending.size(), ending) == 0;
 }
 
 std::optional<std::string>
@@ -263,5 +367,97 @@ stringFromHex(const std::string& str)
 	return res;
 }
 
+namespace
+{
+	struct FoldedRange
+	{
+		char32_t			first;
+		char32_t			last;
+		std::string_view	folded;
+	};
+
+	// Latin-1 Supplement and Latin Extended-A letters, sorted
+	constexpr FoldedRange foldedRanges[]
+	{
+		{0x00C0, 0x00C5, "a"}, {0x00C6, 0x00C6, "ae"}, {0x00C7, 0x00C7, "c"}, {0x00C8, 0x00CB, "e"}, {0x00CC, 0x00CF, "i"},
+		{0x00D0, 0x00D0, "d"}, {0x00D1, 0x00D1, "n"}, {0x00D2, 0x00D6, "o"}, {0x00D8, 0x00D8, "o"}, {0x00D9, 0x00DC, "u"},
+		{0x00DD, 0x00DD, "y"}, {0x00DE, 0x00DE, "th"}, {0x00DF, 0x00DF, "ss"},
+		{0x00E0, 0x00E5, "a"}, {0x00E6, 0x00E6, "ae"}, {0x00E7, 0x00E7, "c"}, {0x00E8, 0x00EB, "e"}, {0x00EC, 0x00EF, "i"},
+		{0x00F0, 0x00F0, "d"}, {0x00F1, 0x00F1, "n"}, {0x00F2, 0x00F6, "o"}, {0x00F8, 0x00F8, "o"}, {0x00F9, 0x00FC, "u"},
+		{0x00FD, 0x00FD, "y"}, {0x00FE, 0x00FE, "th"}, {0x00FF, 0x00FF, "y"},
+		{0x0100, 0x0105, "a"}, {0x0106, 0x010D, "c"}, {0x010E, 0x0111, "d"}, {0x0112, 0x011B, "e"}, {0x011C, 0x0123, "g"},
+		{0x0124, 0x0127, "h"}, {0x0128, 0x0131, "i"}, {0x0132, 0x0133, "ij"}, {0x0134, 0x0135, "j"}, {0x0136, 0x0138, "k"},
+		{0x0139, 0x0142, "l"}, {0x0143, 0x014B, "n"}, {0x014C, 0x0151, "o"}, {0x0152, 0x0153, "oe"}, {0x0154, 0x0159, "r"},
+		{0x015A, 0x0161, "s"}, {0x0162, 0x0167, "t"}, {0x0168, 0x0173, "u"}, {0x0174, 0x0175, "w"}, {0x0176, 0x0178, "y"},
+		{0x0179, 0x017E, "z"}, {0x017F, 0x017F, "s"},
+	};
+
+	constexpr std::string_view leadingArticles[] {"the ", "an ", "a ", "les ", "le ", "la ", "l'"};
+
+	std::optional<std::string_view>
+	getFolded(char32_t codePoint)
+	{
+		auto it {std::upper_bound(std::cbegin(foldedRanges), std::cend(foldedRanges), codePoint, [](char32_t value, const FoldedRange& range) { return value < range.first; })};
+		if (it == std::cbegin(foldedRanges))
+			return std::nullopt;
+
+		--it;
+		if (codePoint > it->last)
+			return std::nullopt;
+
+		return it->folded;
+	}
+}
+
+std::string
+computeSortKey(std::string_view str)
+{
+	std::string res;
+	res.reserve(str.size());
+
+	for (std::size_t i {}; i < str.size();)
+	{
+		const unsigned char c {static_cast<unsigned char>(str[i])};
+		if (c < 0x80)
+		{
+			res.push_back(static_cast<char>(std::tolower(c)));
+			i++;
+			continue;
+		}
+
+		// Only two bytes sequences may be folded, anything else is kept as is
+		if ((c & 0xE0) == 0xC0 && i + 1 < str.size() && (static_cast<unsigned char>(str[i + 1]) & 0xC0) == 0x80)
+		{
+			const char32_t codePoint {static_cast<char32_t>(((c & 0x1F) << 6) | (static_cast<unsigned char>(str[i + 1]) & 0x3F))};
+			if (const std::optional<std::string_view> folded {getFolded(codePoint)})
+			{
+				res.append(*folded);
+				i += 2;
+				continue;
+			}
+		}
+
+		res.push_back(str[i++]);
+	}
+
+	std::string_view key {res};
+
+	// Skip leading spaces and ASCII punctuation ("...And Justice for All", quotes, brackets)
+	const std::size_t start {static_cast<std::size_t>(std::distance(std::cbegin(key), std::find_if(std::cbegin(key), std::cend(key), [](char c) { return !std::ispunct(static_cast<unsigned char>(c)) && !std::isspace(static_cast<unsigned char>(c)); })))};
+	if (start < key.size())
+		key.remove_prefix(start);
+
+	for (std::string_view article : leadingArticles)
+	{
+		if (key.size() > article.size() && key.substr(0, article.size()) == article)
+		{
+			key.remove_prefix(article.size());
+			break;
+		}
+	}
+
+	return std::string {key};
+}
+
 } // StringUtils
 
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/Tracing.hpp"
+
+#include "utils/Random.hpp"
+
+namespace Tracing
+{
+	namespace
+	{
+		thread_local Trace* currentTrace {};
+
+		void
+		writeMilliseconds(std::ostream& os, Trace::Clock::duration duration)
+		{
+			os << std::chrono::duration<double, std::milli> {duration}.count() << "ms";
+		}
+	}
+
+	Trace::Trace(std::string name)
+		: _name {std::move(name)}
+	{
+	}
+
+	std::ostream&
+	operator<<(std::ostream& os, const Trace& trace)
+	{
+		os << "'" << trace.getName() << "' ";
+		writeMilliseconds(os, trace.getDuration());
+		os << ":";
+
+		for (const Trace::Span& span : trace.getSpans())
+		{
+			os << " " << std::string(span.depth + 1, '>') << " " << span.name << " [+";
+			writeMilliseconds(os, span.start);
+			os << ", ";
+			writeMilliseconds(os, span.duration);
+			os << "]";
+		}
+
+		if (trace.getDroppedSpanCount() > 0)
+			os << " (" << trace.getDroppedSpanCount() << " dropped spans)";
+
+		return os;
+	}
+
+	ScopedTrace::ScopedTrace(std::string name, const Settings& settings, ReportFunc reportFunc)
+		: _slowThreshold {settings.slowThreshold}
+		, _reportFunc {std::move(reportFunc)}
+	{
+		// nested traces are merged into the outer one
+		if (currentTrace || settings.slowThreshold.count() == 0 || settings.samplingPercent == 0)
+			return;
+
+		if (settings.samplingPercent < 100 && Random::getRandom(1, 100) > static_cast<int>(settings.samplingPercent))
+			return;
+
+		_trace = std::make_unique<Trace>(std::move(name));
+		currentTrace = _trace.get();
+	}
+
+	ScopedTrace::~ScopedTrace()
+	{
+		if (!_trace)
+			return;
+
+		currentTrace = nullptr;
+
+		_trace->_duration = Trace::Clock::now() - _trace->_start;
+		if (_trace->_duration >= _slowThreshold)
+			_reportFunc(*_trace);
+	}
+
+	ScopedSpan::ScopedSpan(const char* name)
+		: _subLabel {name}
+		, _trace {currentTrace}
+	{
+		if (!_trace)
+			return;
+
+		if (_trace->_spans.size() >= Trace::_maxSpanCount)
+		{
+			_trace->_droppedSpanCount++;
+			_trace = nullptr;
+			return;
+		}
+
+		_index = _trace->_spans.size();
+		_trace->_spans.push_back(Trace::Span {name, _trace->_depth++, Trace::Clock::now() - _trace->_start});
+	}
+
+	ScopedSpan::~ScopedSpan()
+	{
+		if (!_trace)
+			return;
+
+		Trace::Span& span {_trace->_spans[_index]};
+		span.duration = (Trace::Clock::now() - _trace->_start) - span.start;
+		_trace->_depth--;
+	}
+}
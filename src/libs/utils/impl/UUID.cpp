@@ -19,7 +19,8 @@
 
 #include "utils/UUID.hpp"
 
-#include <regex>
+#include <algorithm>
+#include <cassert>
 
 #include "utils/String.hpp"
 
@@ -33,26 +34,73 @@ namespace StringUtils
 	}
 }
 
-static
-bool
-stringIsUUID(std::string_view str)
+namespace
 {
-	static const std::regex re { R"([0-9a-fA-F]{8}\-[0-9a-fA-F]{4}\-[0-9a-fA-F]{4}\-[0-9a-fA-F]{4}\-[0-9a-fA-F]{12})"};
+	constexpr std::size_t uuidStringSize {36};
+	constexpr std::array<std::size_t, 4> dashPositions {8, 13, 18, 23};
 
-	return std::regex_match(std::cbegin(str), std::cend(str), re);
-}
+	std::optional<std::uint8_t>
+	hexCharToValue(char c)
+	{
+		if (c >= '0' && c <= '9')
+			return c - '0';
+		if (c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F')
+			return c - 'A' + 10;
 
-UUID::UUID(std::string_view str)
-	: _value {StringUtils::stringToLower(str)}
-{
+		return std::nullopt;
+	}
 }
 
 std::optional<UUID>
 UUID::fromString(std::string_view str)
 {
-	if (!stringIsUUID(str))
+	if (str.size() != uuidStringSize)
 		return std::nullopt;
 
-	return UUID {str};
+	Bytes bytes {};
+	std::size_t byteIndex {};
+	for (std::size_t i {}; i < str.size();)
+	{
+		if (std::find(std::cbegin(dashPositions), std::cend(dashPositions), i) != std::cend(dashPositions))
+		{
+			if (str[i] != '-')
+				return std::nullopt;
+
+			++i;
+			continue;
+		}
+
+		// groups have an even digit count: the low digit of a byte is never at a dash position
+		const std::optional<std::uint8_t> high {hexCharToValue(str[i])};
+		const std::optional<std::uint8_t> low {hexCharToValue(str[i + 1])};
+		if (!high || !low)
+			return std::nullopt;
+
+		bytes[byteIndex++] = (*high << 4) | *low;
+		i += 2;
+	}
+	assert(byteIndex == bytes.size());
+
+	return UUID {bytes};
 }
 
+std::string
+UUID::getAsString() const
+{
+	static constexpr char hexChars[] {"0123456789abcdef"};
+
+	std::string res;
+	res.reserve(uuidStringSize);
+	for (std::size_t i {}; i < _bytes.size(); ++i)
+	{
+		if (i == 4 || i == 6 || i == 8 || i == 10)
+			res.push_back('-');
+
+		res.push_back(hexChars[_bytes[i] >> 4]);
+		res.push_back(hexChars[_bytes[i] & 0x0F]);
+	}
+
+	return res;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/WorkBudget.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "utils/CpuPlacement.hpp"
+
+namespace WorkBudget
+{
+	namespace
+	{
+		thread_local bool hasSlot {};
+
+		class Slots
+		{
+			public:
+				void setLimits(Limits limits)
+				{
+					limits.slotCount = std::max<std::size_t>(limits.slotCount, 1);
+					limits.bulkSlotCount = std::clamp<std::size_t>(limits.bulkSlotCount, 1, limits.slotCount);
+					{
+						const std::scoped_lock lock {_mutex};
+						_limits = limits;
+					}
+					_cv.notify_all();
+				}
+
+				Limits getLimits() const
+				{
+					const std::scoped_lock lock {_mutex};
+					return _limits;
+				}
+
+				void acquire(WorkClass workClass)
+				{
+					std::unique_lock lock {_mutex};
+
+					if (workClass == WorkClass::Background)
+					{
+						_waitingBackgroundCount++;
+						_cv.wait(lock, [this] { return _usedSlotCount < _limits.slotCount; });
+						_waitingBackgroundCount--;
+					}
+					else
+					{
+						_cv.wait(lock, [this] { return _usedSlotCount < _limits.slotCount && _usedBulkSlotCount < _limits.bulkSlotCount && _waitingBackgroundCount == 0; });
+						_usedBulkSlotCount++;
+					}
+
+					_usedSlotCount++;
+				}
+
+				void release(WorkClass workClass)
+				{
+					{
+						const std::scoped_lock lock {_mutex};
+						_usedSlotCount--;
+						if (workClass == WorkClass::Bulk)
+							_usedBulkSlotCount--;
+					}
+					_cv.notify_all();
+				}
+
+			private:
+				mutable std::mutex		_mutex;
+				std::condition_variable	_cv;
+				Limits					_limits {getDefaultLimits()};
+				std::size_t				_usedSlotCount {};
+				std::size_t				_usedBulkSlotCount {};
+				std::size_t				_waitingBackgroundCount {};
+		};
+
+		Slots&
+		getSlots()
+		{
+			static Slots slots;
+			return slots;
+		}
+	}
+
+	Limits
+	getDefaultLimits()
+	{
+		const std::size_t coreCount {std::max<std::size_t>(std::thread::hardware_concurrency(), 1)};
+		const std::size_t slotCount {std::max<std::size_t>(coreCount - 1, 1)};
+
+		return Limits {slotCount, std::max<std::size_t>(slotCount / 2, 1)};
+	}
+
+	void
+	setLimits(Limits limits)
+	{
+		getSlots().setLimits(limits);
+	}
+
+	Limits
+	getLimits()
+	{
+		return getSlots().getLimits();
+	}
+
+	ScopedSlot::ScopedSlot(WorkClass workClass)
+		: _workClass {workClass}
+	{
+		if (hasSlot)
+			return;
+
+		getSlots().acquire(_workClass);
+		hasSlot = true;
+		_acquired = true;
+
+		CpuPlacement::placeCurrentThread(_workClass == WorkClass::Background ? CpuPlacement::Workload::Background : CpuPlacement::Workload::Bulk);
+	}
+
+	ScopedSlot::~ScopedSlot()
+	{
+		if (!_acquired)
+			return;
+
+		hasSlot = false;
+		getSlots().release(_workClass);
+	}
+}
@@ -30,3 +30,10 @@ WtLogger::processLog(const Log& log)
 	Wt::log(getSeverityName(log.getSeverity())) << Wt::WLogger::sep << "[" << getModuleName(log.getModule()) << "]" << Wt::WLogger::sep << log.getMessage();
 }
 
+
+bool
+WtLogger::isSeverityActive(Module module, Severity severity) const
+{
+	// the scope is the first field of the message
+	return Wt::logging(getSeverityName(severity), std::string {"["} + getModuleName(module) + "]");
+}
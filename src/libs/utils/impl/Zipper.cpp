@@ -19,8 +19,11 @@
 
 #include "utils/Zipper.hpp"
 
+#include <array>
 #include <cstddef>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
 
 #include <Wt/WDate.h>
 #include <Wt/WTime.h>
@@ -268,18 +271,18 @@ namespace Zip
 			else
 				fileContext.lastModifiedTime = getLastWriteTime(filePath);
 
-			_files[filename] = std::move(fileContext);
+			fileContext.localFileHeaderOffset = _totalZipSize;
+			_totalZipSize += getLocalFileSize(filename, fileContext);
 
-			_totalZipSize += LocalFileHeader::getHeaderSize();
-			_totalZipSize += filename.size();
-			_totalZipSize += Zip64ExtendedInformationExtraField::getHeaderSize();
-			_totalZipSize += fileContext.fileSize;
-			_totalZipSize += DataDescriptor::getHeaderSize();
-			_totalZipSize += CentralDirectoryHeader::getHeaderSize();
-			_totalZipSize += filename.size();
-			_totalZipSize += Zip64ExtendedInformationExtraField::getHeaderSize(Zip64ExtendedInformationExtraField::WithFileOffset {});
+			_files[filename] = std::move(fileContext);
 		}
 
+		_centralDirectoryOffset = _totalZipSize;
+		for (const auto& [filename, fileContext] : _files)
+			_centralDirectorySize += getCentralDirectoryHeaderSize(filename);
+		_totalZipSize += _centralDirectorySize;
+
+		_zip64EndOfCentralDirectoryRecordOffset = _totalZipSize;
 		_totalZipSize += Zip64EndOfCentralDirectoryRecord::getHeaderSize();
 		_totalZipSize += Zip64EndOfCentralDirectoryLocator::getHeaderSize();
 		_totalZipSize += EndOfCentralDirectoryRecord::getHeaderSize();
@@ -287,6 +290,193 @@ namespace Zip
 		_currentFile = std::begin(_files);
 	}
 
+	std::string
+	Zipper::computeEntityTag() const
+	{
+		// entries are sorted by name
+		std::ostringstream entries;
+		for (const auto& [fileName, fileContext] : _files)
+			entries << fileName << '\0' << fileContext.filePath.string() << '\0' << fileContext.fileSize << '\0' << fileContext.lastModifiedTime.toTime_t() << '\n';
+
+		const std::string entriesStr {entries.str()};
+		Utils::Crc32Calculator crc32;
+		crc32.processBytes(reinterpret_cast<const std::byte*>(entriesStr.data()), entriesStr.size());
+
+		std::ostringstream oss;
+		oss << '"' << std::hex << std::setfill('0') << std::setw(8) << crc32.getResult() << '-' << std::dec << _totalZipSize << '"';
+		return oss.str();
+	}
+
+	SizeType
+	Zipper::getLocalFileSize(const std::string& fileName, const FileContext& fileContext)
+	{
+		return LocalFileHeader::getHeaderSize()
+			+ fileName.size()
+			+ Zip64ExtendedInformationExtraField::getHeaderSize()
+			+ fileContext.fileSize
+			+ DataDescriptor::getHeaderSize();
+	}
+
+	SizeType
+	Zipper::getCentralDirectoryHeaderSize(const std::string& fileName)
+	{
+		return CentralDirectoryHeader::getHeaderSize()
+			+ fileName.size()
+			+ Zip64ExtendedInformationExtraField::getHeaderSize(Zip64ExtendedInformationExtraField::WithFileOffset {});
+	}
+
+	std::uint32_t
+	Zipper::getCrc32(FileContext& fileContext)
+	{
+		if (!fileContext.crc32)
+		{
+			if (fileContext.crc32ProcessedSize == fileContext.fileSize)
+				fileContext.crc32 = fileContext.fileCrc32.getResult();
+			else
+			{
+				// some parts have been skipped
+				try
+				{
+					fileContext.crc32 = computeCrc32(fileContext.filePath);
+				}
+				catch (const LmsException& e)
+				{
+					throw ZipperException {"File '" + fileContext.filePath.string() + "': cannot compute checksum: " + e.what()};
+				}
+			}
+		}
+
+		return *fileContext.crc32;
+	}
+
+	void
+	Zipper::setCrc32(const std::string& fileName, std::uint32_t crc32)
+	{
+		auto itFile {_files.find(fileName)};
+		if (itFile == std::end(_files))
+			throw ZipperException {"File '" + fileName + "' is not part of the zip"};
+
+		itFile->second.crc32 = crc32;
+	}
+
+	std::optional<Zipper::FileDataExtent>
+	Zipper::takeFileDataExtent()
+	{
+		if (_writeState != WriteState::FileData)
+			return std::nullopt;
+
+		assert(_currentFile != std::end(_files));
+
+		FileDataExtent extent {_currentFile->second.filePath, _currentOffset, _currentFile->second.fileSize - _currentOffset};
+
+		_currentFileStream.close();
+		_currentOffset = 0;
+		_writeState = WriteState::DataDescriptor;
+
+		return extent;
+	}
+
+	void
+	Zipper::seek(SizeType offset)
+	{
+		_currentFile = std::begin(_files);
+		_currentOffset = 0;
+		_bytesToSkip = 0;
+
+		if (offset >= _totalZipSize)
+		{
+			_writeState = WriteState::Complete;
+			return;
+		}
+
+		if (offset < _centralDirectoryOffset)
+		{
+			// local file entries
+			while (std::next(_currentFile) != std::end(_files) && std::next(_currentFile)->second.localFileHeaderOffset <= offset)
+				++_currentFile;
+
+			SizeType fileOffset {offset - _currentFile->second.localFileHeaderOffset};
+			const SizeType fileNameSize {_currentFile->first.size()};
+			const SizeType fileSize {_currentFile->second.fileSize};
+
+			if (fileOffset < LocalFileHeader::getHeaderSize())
+			{
+				_writeState = WriteState::LocalFileHeader;
+				_bytesToSkip = fileOffset;
+			}
+			else if ((fileOffset -= LocalFileHeader::getHeaderSize()) < fileNameSize)
+			{
+				_writeState = WriteState::LocalFileHeaderFileName;
+				_currentOffset = fileOffset;
+			}
+			else if ((fileOffset -= fileNameSize) < Zip64ExtendedInformationExtraField::getHeaderSize())
+			{
+				_writeState = WriteState::LocalFileHeaderExtraFields;
+				_bytesToSkip = fileOffset;
+			}
+			else if ((fileOffset -= Zip64ExtendedInformationExtraField::getHeaderSize()) < fileSize)
+			{
+				_writeState = WriteState::FileData;
+				_currentOffset = fileOffset;
+			}
+			else
+			{
+				_writeState = WriteState::DataDescriptor;
+				_bytesToSkip = fileOffset - fileSize;
+			}
+		}
+		else if (offset < _zip64EndOfCentralDirectoryRecordOffset)
+		{
+			// central directory entries
+			SizeType headerOffset {_centralDirectoryOffset};
+			while (offset >= headerOffset + getCentralDirectoryHeaderSize(_currentFile->first))
+			{
+				headerOffset += getCentralDirectoryHeaderSize(_currentFile->first);
+				++_currentFile;
+			}
+
+			SizeType fileOffset {offset - headerOffset};
+			const SizeType fileNameSize {_currentFile->first.size()};
+
+			if (fileOffset < CentralDirectoryHeader::getHeaderSize())
+			{
+				_writeState = WriteState::CentralDirectoryHeader;
+				_bytesToSkip = fileOffset;
+			}
+			else if ((fileOffset -= CentralDirectoryHeader::getHeaderSize()) < fileNameSize)
+			{
+				_writeState = WriteState::CentralDirectoryHeaderFileName;
+				_currentOffset = fileOffset;
+			}
+			else
+			{
+				_writeState = WriteState::CentralDirectoryHeaderExtraFields;
+				_bytesToSkip = fileOffset - fileNameSize;
+			}
+		}
+		else
+		{
+			_currentFile = std::end(_files);
+
+			SizeType recordOffset {offset - _zip64EndOfCentralDirectoryRecordOffset};
+			if (recordOffset < Zip64EndOfCentralDirectoryRecord::getHeaderSize())
+			{
+				_writeState = WriteState::Zip64EndOfCentralDirectoryRecord;
+				_bytesToSkip = recordOffset;
+			}
+			else if ((recordOffset -= Zip64EndOfCentralDirectoryRecord::getHeaderSize()) < Zip64EndOfCentralDirectoryLocator::getHeaderSize())
+			{
+				_writeState = WriteState::Zip64EndOfCentralDirectoryLocator;
+				_bytesToSkip = recordOffset;
+			}
+			else
+			{
+				_writeState = WriteState::EndOfCentralDirectoryRecord;
+				_bytesToSkip = recordOffset - Zip64EndOfCentralDirectoryLocator::getHeaderSize();
+			}
+		}
+	}
+
 	SizeType
 	Zipper::writeSome(std::byte* buffer, SizeType bufferSize)
 	{
@@ -297,65 +487,79 @@ namespace Zip
 
 		while (!isComplete() && (bufferSize >= minOutputBufferSize))
 		{
+			if (_fileDataExtents && _writeState == WriteState::FileData)
+				break;
+
 			SizeType nbWrittenBytes {};
 
-			switch (_writeState)
+			if (_bytesToSkip > 0)
 			{
-				case WriteState::LocalFileHeader:
-					nbWrittenBytes = writeLocalFileHeader(buffer, bufferSize);
-					break;
+				// only the end of this header is wanted
+				std::array<std::byte, minOutputBufferSize> header;
+				const SizeType headerSize {writeNextElement(header.data(), header.size())};
+				if (headerSize > _bytesToSkip)
+				{
+					nbWrittenBytes = headerSize - _bytesToSkip;
+					std::copy(std::next(std::cbegin(header), _bytesToSkip), std::next(std::cbegin(header), headerSize), buffer);
+					_bytesToSkip = 0;
+				}
+				else
+					_bytesToSkip -= headerSize;
+			}
+			else
+				nbWrittenBytes = writeNextElement(buffer, bufferSize);
+
+			buffer += nbWrittenBytes;
+			bufferSize -= nbWrittenBytes;
+			nbTotalWrittenBytes += nbWrittenBytes ;
+		}
+
+		return nbTotalWrittenBytes;
+	}
 
-				case WriteState::LocalFileHeaderFileName:
-					nbWrittenBytes = writeLocalFileHeaderFileName(buffer, bufferSize);
-					break;
+	SizeType
+	Zipper::writeNextElement(std::byte* buffer, SizeType bufferSize)
+	{
+		switch (_writeState)
+		{
+			case WriteState::LocalFileHeader:
+				return writeLocalFileHeader(buffer, bufferSize);
 
-				case WriteState::LocalFileHeaderExtraFields:
-					nbWrittenBytes = writeLocalFileHeaderExtraFields(buffer, bufferSize);
-					break;
+			case WriteState::LocalFileHeaderFileName:
+				return writeLocalFileHeaderFileName(buffer, bufferSize);
 
-				case WriteState::FileData:
-					nbWrittenBytes = writeFileData(buffer, bufferSize);
-					break;
+			case WriteState::LocalFileHeaderExtraFields:
+				return writeLocalFileHeaderExtraFields(buffer, bufferSize);
 
-				case WriteState::DataDescriptor:
-					nbWrittenBytes = writeDataDescriptor(buffer, bufferSize);
-					break;
+			case WriteState::FileData:
+				return writeFileData(buffer, bufferSize);
 
-				case WriteState::CentralDirectoryHeader:
-					nbWrittenBytes = writeCentralDirectoryHeader(buffer, bufferSize);
-					break;
+			case WriteState::DataDescriptor:
+				return writeDataDescriptor(buffer, bufferSize);
 
-				case WriteState::CentralDirectoryHeaderFileName:
-					nbWrittenBytes = writeCentralDirectoryHeaderFileName(buffer, bufferSize);
-					break;
+			case WriteState::CentralDirectoryHeader:
+				return writeCentralDirectoryHeader(buffer, bufferSize);
 
-				case WriteState::CentralDirectoryHeaderExtraFields:
-					nbWrittenBytes = writeCentralDirectoryHeaderExtraFields(buffer, bufferSize);
-					break;
+			case WriteState::CentralDirectoryHeaderFileName:
+				return writeCentralDirectoryHeaderFileName(buffer, bufferSize);
 
-				case WriteState::Zip64EndOfCentralDirectoryRecord:
-					nbWrittenBytes = writeZip64EndOfCentralDirectoryRecord(buffer, bufferSize);
-					break;
+			case WriteState::CentralDirectoryHeaderExtraFields:
+				return writeCentralDirectoryHeaderExtraFields(buffer, bufferSize);
 
-				case WriteState::Zip64EndOfCentralDirectoryLocator:
-					nbWrittenBytes = writeZip64EndOfCentralDirectoryLocator(buffer, bufferSize);
-					break;
+			case WriteState::Zip64EndOfCentralDirectoryRecord:
+				return writeZip64EndOfCentralDirectoryRecord(buffer, bufferSize);
 
-				case WriteState::EndOfCentralDirectoryRecord:
-					nbWrittenBytes = writeEndOfCentralDirectoryRecord(buffer, bufferSize);
-					break;
+			case WriteState::Zip64EndOfCentralDirectoryLocator:
+				return writeZip64EndOfCentralDirectoryLocator(buffer, bufferSize);
 
-				case WriteState::Complete:
-					break;
-			}
+			case WriteState::EndOfCentralDirectoryRecord:
+				return writeEndOfCentralDirectoryRecord(buffer, bufferSize);
 
-			buffer += nbWrittenBytes;
-			bufferSize -= nbWrittenBytes;
-			_currentZipOffset += nbWrittenBytes;
-			nbTotalWrittenBytes += nbWrittenBytes ;
+			case WriteState::Complete:
+				break;
 		}
 
-		return nbTotalWrittenBytes;
+		return 0;
 	}
 
 	bool
@@ -392,7 +596,6 @@ namespace Zip
 		header.setExtraFieldLength(Zip64ExtendedInformationExtraField::getHeaderSize());
 
 		_writeState = WriteState::LocalFileHeaderFileName;
-		_currentFile->second.localFileHeaderOffset = _currentZipOffset;
 
 		return header.getHeaderSize();
 	}
@@ -444,6 +647,7 @@ namespace Zip
 
 		if (_currentOffset == _currentFile->second.fileSize)
 		{
+			_currentFileStream.close();
 			_currentOffset = 0;
 			_writeState = WriteState::DataDescriptor;
 			return 0;
@@ -451,24 +655,34 @@ namespace Zip
 
 		const std::string filePath {_currentFile->second.filePath.string()};
 
-		std::ifstream ifs {filePath.c_str(), std::ios_base::binary};
-		if (!ifs)
-			throw ZipperException {"File '" + filePath + "' does no longer exist!"};
+		// Kept open until the file is completely written
+		if (!_currentFileStream.is_open())
+		{
+			_currentFileStream.open(filePath.c_str(), std::ios_base::binary);
+			if (!_currentFileStream)
+				throw ZipperException {"File '" + filePath + "' does no longer exist!"};
 
-		ifs.seekg(0, std::ios::end);
-		const ::uint64_t fileSize {static_cast<::uint64_t>(ifs.tellg())};
-		ifs.seekg(0, std::ios::beg);
+			_currentFileStream.seekg(0, std::ios::end);
+			const ::uint64_t fileSize {static_cast<::uint64_t>(_currentFileStream.tellg())};
+			_currentFileStream.seekg(_currentOffset, std::ios::beg);
 
-		if (fileSize != _currentFile->second.fileSize)
-			throw ZipperException {"File '" + filePath + "': size mismatch!"};
+			if (fileSize != _currentFile->second.fileSize)
+				throw ZipperException {"File '" + filePath + "': size mismatch!"};
+		}
 
-		const SizeType nbBytesToRead {std::min(static_cast<std::size_t>(fileSize) - _currentOffset, bufferSize)};
+		const SizeType nbBytesToRead {std::min(_currentFile->second.fileSize - _currentOffset, bufferSize)};
 
-		ifs.seekg(_currentOffset, std::ios::beg);
-		ifs.read(reinterpret_cast<char*>(buffer), nbBytesToRead );
-		const ::uint64_t actualReadSize {static_cast<::uint64_t>(ifs.gcount())};
+		_currentFileStream.read(reinterpret_cast<char*>(buffer), nbBytesToRead);
+		const ::uint64_t actualReadSize {static_cast<::uint64_t>(_currentFileStream.gcount())};
+		if (actualReadSize == 0)
+			throw ZipperException {"File '" + filePath + "': read error!"};
 
-		_currentFile->second.fileCrc32.processBytes(buffer, actualReadSize);
+		// checksum can only be computed on the fly if no data was skipped
+		if (!_currentFile->second.crc32 && _currentFile->second.crc32ProcessedSize == _currentOffset)
+		{
+			_currentFile->second.fileCrc32.processBytes(buffer, actualReadSize);
+			_currentFile->second.crc32ProcessedSize += actualReadSize;
+		}
 		_currentOffset += actualReadSize;
 
 		return actualReadSize;
@@ -484,7 +698,7 @@ namespace Zip
 
 		DataDescriptor desc {buffer, bufferSize};
 		desc.setSignature();
-		desc.setCrc32UncompressedData(_currentFile->second.fileCrc32.getResult());
+		desc.setCrc32UncompressedData(getCrc32(_currentFile->second));
 		desc.setCompressedSize(_currentFile->second.fileSize);
 		desc.setUncompressedSize(_currentFile->second.fileSize);
 
@@ -500,9 +714,6 @@ namespace Zip
 		assert(bufferSize >= minOutputBufferSize);
 		static_assert(CentralDirectoryHeader::getHeaderSize() <= minOutputBufferSize);
 
-		if (_currentFile == std::begin(_files))
-			_centralDirectoryOffset = _currentZipOffset;
-
 		if (_currentFile == std::end(_files))
 		{
 			_writeState = WriteState::Zip64EndOfCentralDirectoryRecord;
@@ -519,7 +730,7 @@ namespace Zip
 		header.setCompressedSize();
 		header.setUncompressedSize();
 		header.setLastModifiedDateTime(_currentFile->second.lastModifiedTime);
-		header.setCrc32UncompressedData(_currentFile->second.fileCrc32.getResult());
+		header.setCrc32UncompressedData(getCrc32(_currentFile->second));
 		header.setFileNameLength(_currentFile->first.size());
 		header.setExtraFieldLength(Zip64ExtendedInformationExtraField::getHeaderSize(Zip64ExtendedInformationExtraField::WithFileOffset {}));
 		header.setFileCommentLength(0);
@@ -529,7 +740,6 @@ namespace Zip
 		header.setRelativeFileHeaderOffset();
 
 		_writeState = WriteState::CentralDirectoryHeaderFileName;
-		_centralDirectorySize += header.getHeaderSize();
 
 		return header.getHeaderSize();
 	}
@@ -553,7 +763,6 @@ namespace Zip
 		std::copy(std::next(std::begin(fileName), _currentOffset), std::next(std::begin(fileName), _currentOffset + nbBytesToCopy), reinterpret_cast<unsigned char*>(buffer));
 
 		_currentOffset += nbBytesToCopy;
-		_centralDirectorySize += nbBytesToCopy;
 		return nbBytesToCopy;
 	}
 
@@ -574,7 +783,6 @@ namespace Zip
 
 		++_currentFile;
 		_writeState  = WriteState::CentralDirectoryHeader;
-		_centralDirectorySize += header.getHeaderSize(Zip64ExtendedInformationExtraField::WithFileOffset {});
 
 		return header.getHeaderSize(Zip64ExtendedInformationExtraField::WithFileOffset {});
 	}
@@ -598,7 +806,6 @@ namespace Zip
 		record.setCentralDirectorySize(_centralDirectorySize);
 		record.setCentralDirectoryOffset(_centralDirectoryOffset);
 
-		_zip64EndOfCentralDirectoryRecordOffset = _currentZipOffset;
 		_writeState = WriteState::Zip64EndOfCentralDirectoryLocator;
 		return record.getHeaderSize();
 	}
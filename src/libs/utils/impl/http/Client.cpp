@@ -23,9 +23,9 @@
 namespace Http
 {
 	std::unique_ptr<IClient>
-	createClient(boost::asio::io_context& ioContext, std::string_view baseUrl)
+	createClient(boost::asio::io_context& ioContext, std::string_view baseUrl, std::size_t maxResponseSize, std::size_t maxConcurrentRequests)
 	{
-		return std::make_unique<Client>(ioContext, baseUrl);
+		return std::make_unique<Client>(ioContext, baseUrl, maxResponseSize, maxConcurrentRequests);
 	}
 
 	void
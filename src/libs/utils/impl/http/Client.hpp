@@ -31,9 +31,9 @@ namespace Http
 	class Client final : public IClient
 	{
 		public:
-			Client(boost::asio::io_context& ioContext, std::string_view baseUrl)
+			Client(boost::asio::io_context& ioContext, std::string_view baseUrl, std::size_t maxResponseSize, std::size_t maxConcurrentRequests)
 			: _ioContext {ioContext}
-			, _sendQueue {ioContext, baseUrl}
+			, _sendQueue {ioContext, baseUrl, maxResponseSize, maxConcurrentRequests}
 			{}
 
 		private:
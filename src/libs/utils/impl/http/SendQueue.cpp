@@ -19,11 +19,14 @@
 
 #include "SendQueue.hpp"
 
+#include <algorithm>
+
 #include <boost/asio/dispatch.hpp>
 #include <boost/asio/bind_executor.hpp>
 
 #include "utils/Exception.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
 #include "utils/String.hpp"
 
 #define LOG(sev)	LMS_LOG(SCROBBLING, sev) << "[Http SendQueue] - "
@@ -56,26 +59,43 @@ namespace
 
 		return res;
 	}
+
+	Metrics::Gauge&
+	getQueuedRequestsGauge()
+	{
+		static Metrics::Gauge& queuedRequests {Metrics::getRegistry().createGauge("lms_http_send_queue_requests", "Number of outgoing HTTP requests waiting to be sent")};
+		return queuedRequests;
+	}
 }
 
 namespace Http
 {
-	SendQueue::SendQueue(boost::asio::io_context& ioContext, std::string_view baseUrl)
+	SendQueue::SendQueue(boost::asio::io_context& ioContext, std::string_view baseUrl, std::size_t maxResponseSize, std::size_t maxConcurrentRequests)
 	: _ioContext {ioContext}
 	, _baseUrl {baseUrl}
 	{
-		_client.done().connect([this](Wt::AsioWrapper::error_code ec, const Wt::Http::Message& msg)
+		for (std::size_t i {}; i < std::max<std::size_t>(1, maxConcurrentRequests); ++i)
 		{
-			_strand.dispatch([=, msg = std::move(msg)]
+			Slot& slot {*_slots.emplace_back(std::make_unique<Slot>())};
+			slot.client = std::make_unique<Wt::Http::Client>(_ioContext);
+			slot.client->setMaximumResponseSize(maxResponseSize);
+			slot.client->done().connect([this, &slot](Wt::AsioWrapper::error_code ec, const Wt::Http::Message& msg)
 			{
-				onClientDone(ec, msg);
+				_strand.dispatch([=, &slot, msg = std::move(msg)]
+				{
+					onClientDone(slot, ec, msg);
+				});
 			});
-		});
+		}
 	}
 
 	SendQueue::~SendQueue()
 	{
-		_client.abort();
+		for (const std::unique_ptr<Slot>& slot : _slots)
+			slot->client->abort();
+
+		for (const auto& [prio, requests] : _sendQueue)
+			getQueuedRequestsGauge().sub(requests.size());
 	}
 
 	void
@@ -84,38 +104,97 @@ namespace Http
 		boost::asio::dispatch(_strand, [this, request = std::move(request)]() mutable
 		{
 			_sendQueue[request->getParameters().priority].emplace_back(std::move(request));
+			getQueuedRequestsGauge().add();
 
-			if (_state == State::Idle)
-				sendNextQueuedRequest();
+			sendQueuedRequests();
 		});
 	}
 
-	void
-	SendQueue::sendNextQueuedRequest()
+	SendQueue::ThrottleKey
+	SendQueue::getThrottleKey(const ClientRequest& request)
 	{
-		assert(_state == State::Idle);
-		assert(!_currentRequest);
+		ThrottleKey res;
 
+		switch (request.getType())
+		{
+			case ClientRequest::Type::GET:
+				for (const Wt::Http::Message::Header& header : request.getGETParameters().headers)
+				{
+					if (header.name() == "Authorization")
+						res = header.value();
+				}
+				break;
+
+			case ClientRequest::Type::POST:
+				if (const std::string* header {request.getPOSTParameters().message.getHeader("Authorization")})
+					res = *header;
+				break;
+		}
+
+		return res;
+	}
+
+	bool
+	SendQueue::isSendable(const ClientRequest& request) const
+	{
+		const ThrottleKey key {getThrottleKey(request)};
+
+		if (const auto itThrottled {_throttledKeys.find(key)}; itThrottled != std::cend(_throttledKeys) && itThrottled->second > Clock::now())
+			return false;
+
+		// keep the order of the requests of a same user
+		if (!key.empty() && _inFlightKeys.find(key) != std::cend(_inFlightKeys))
+			return false;
+
+		return true;
+	}
+
+	std::unique_ptr<ClientRequest>
+	SendQueue::popNextSendableRequest()
+	{
 		for (auto& [prio, requests] : _sendQueue)
 		{
-			LOG(DEBUG) << "Processing prio " << static_cast<int>(prio) << ", request count = " << requests.size();
-			while (!requests.empty())
-			{
-				std::unique_ptr<ClientRequest> request {std::move(requests.front())};
-				requests.pop_front();
+			auto itRequest {std::find_if(std::begin(requests), std::end(requests), [this](const std::unique_ptr<ClientRequest>& request) { return isSendable(*request); })};
+			if (itRequest == std::end(requests))
+				continue;
+
+			std::unique_ptr<ClientRequest> request {std::move(*itRequest)};
+			requests.erase(itRequest);
+			getQueuedRequestsGauge().sub();
+			return request;
+		}
 
-				if (!sendRequest(*request))
+		return {};
+	}
+
+	void
+	SendQueue::sendQueuedRequests()
+	{
+		for (const std::unique_ptr<Slot>& slot : _slots)
+		{
+			if (slot->request)
+				continue;
+
+			while (std::unique_ptr<ClientRequest> request {popNextSendableRequest()})
+			{
+				if (!sendRequest(*slot, *request))
 					continue;
 
-				_state = State::Sending;
-				_currentRequest = std::move(request);
-				return;
+				const ThrottleKey key {getThrottleKey(*request)};
+				if (!key.empty())
+					_inFlightKeys.insert(key);
+
+				slot->request = std::move(request);
+				break;
 			}
+
+			if (!slot->request)
+				break; // nothing more to send for now
 		}
 	}
 
 	bool
-	SendQueue::sendRequest(const ClientRequest& request)
+	SendQueue::sendRequest(Slot& slot, const ClientRequest& request)
 	{
 		std::string url {_baseUrl + request.getParameters().relativeUrl};
 		LOG(DEBUG) << "Sending request to url '" << url << "'";
@@ -124,11 +203,11 @@ namespace Http
 		switch (request.getType())
 		{
 			case ClientRequest::Type::GET:
-				res = _client.get(url, request.getGETParameters().headers);
+				res = slot.client->get(url, request.getGETParameters().headers);
 				break;
 
 			case ClientRequest::Type::POST:
-				res = _client.post(url, request.getPOSTParameters().message);
+				res = slot.client->post(url, request.getPOSTParameters().message);
 				break;
 		}
 
@@ -139,7 +218,7 @@ namespace Http
 	}
 
 	void
-	SendQueue::onClientDone(Wt::AsioWrapper::error_code ec, const Wt::Http::Message& msg)
+	SendQueue::onClientDone(Slot& slot, Wt::AsioWrapper::error_code ec, const Wt::Http::Message& msg)
 	{
 		if (ec == boost::asio::error::operation_aborted)
 		{
@@ -147,14 +226,17 @@ namespace Http
 			return;
 		}
 
-		assert(_currentRequest);
-		_state = State::Idle;
+		assert(slot.request);
+		std::unique_ptr<ClientRequest> request {std::move(slot.request)};
+		_inFlightKeys.erase(getThrottleKey(*request));
 
 		LOG(DEBUG) << "Client done. status = " << msg.status();
 		if (ec)
-			onClientDoneError(std::move(_currentRequest), ec);
+			onClientDoneError(std::move(request), ec);
 		else
-			onClientDoneSuccess(std::move(_currentRequest), msg);
+			onClientDoneSuccess(std::move(request), msg);
+
+		sendQueuedRequests();
 	}
 
 	void
@@ -163,11 +245,12 @@ namespace Http
 		LOG(ERROR) << "Retry " << request->retryCount << ", client error: '" << ec.message() << "'";
 
 		// may be a network error, try again later
-		throttle(_defaultRetryWaitDuration);
+		throttle(getThrottleKey(*request), _defaultRetryWaitDuration);
 
 		if (request->retryCount++ < _maxRetryCount)
 		{
 			_sendQueue[request->getParameters().priority].emplace_front(std::move(request));
+			getQueuedRequestsGauge().add();
 		}
 		else
 		{
@@ -180,51 +263,68 @@ namespace Http
 	void
 	SendQueue::onClientDoneSuccess(std::unique_ptr<ClientRequest> request, const Wt::Http::Message& msg)
 	{
+		const ThrottleKey key {getThrottleKey(*request)};
 		const ClientRequestParameters& requestParameters {request->getParameters()};
-		bool mustThrottle{};
-		if (msg.status() == 429)
-		{
-			_sendQueue[requestParameters.priority].emplace_front(std::move(request));
-			mustThrottle = true;
-		}
 
 		const auto remainingCount {headerReadAs<std::size_t>(msg, "X-RateLimit-Remaining")};
 		LOG(DEBUG) << "Remaining messages = " << (remainingCount ? *remainingCount : 0);
-		if (mustThrottle || (remainingCount && *remainingCount == 0))
+		if (msg.status() == 429 || (remainingCount && *remainingCount == 0))
 		{
-			const auto waitDuration {headerReadAs<std::chrono::seconds>(msg, "X-RateLimit-Reset-In")};
-			throttle(waitDuration.value_or(_defaultRetryWaitDuration));
+			std::optional<std::chrono::seconds> waitDuration {headerReadAs<std::chrono::seconds>(msg, "X-RateLimit-Reset-In")};
+			if (!waitDuration)
+				waitDuration = headerReadAs<std::chrono::seconds>(msg, "Retry-After");
+
+			throttle(key, waitDuration.value_or(_defaultRetryWaitDuration));
 		}
 
-		if (!mustThrottle)
+		if (msg.status() == 429)
 		{
-			if (msg.status() == 200)
-			{
-				if (requestParameters.onSuccessFunc)
-					requestParameters.onSuccessFunc(msg.body());
-			}
-			else
-			{
-				LOG(ERROR) << "Send error: '" << msg.body() << "'";
-				if (requestParameters.onFailureFunc)
-					requestParameters.onFailureFunc();
-			}
+			_sendQueue[requestParameters.priority].emplace_front(std::move(request));
+			getQueuedRequestsGauge().add();
+		}
+		else if (msg.status() == 200)
+		{
+			if (requestParameters.onSuccessFunc)
+				requestParameters.onSuccessFunc(msg.body());
+		}
+		else
+		{
+			LOG(ERROR) << "Send error: '" << msg.body() << "'";
+			if (requestParameters.onFailureFunc)
+				requestParameters.onFailureFunc();
 		}
-
-		if (_state == State::Idle)
-			sendNextQueuedRequest();
 	}
 
 	void
-	SendQueue::throttle(std::chrono::seconds requestedDuration)
+	SendQueue::throttle(const ThrottleKey& key, std::chrono::seconds requestedDuration)
 	{
-		assert(_state == State::Idle);
-
 		const std::chrono::seconds duration {clamp(requestedDuration, _minRetryWaitDuration, _maxRetryWaitDuration)};
 		LOG(DEBUG) << "Throttling for " << duration.count() << " seconds";
 
-		_throttleTimer.expires_after(duration);
-		_throttleTimer.async_wait([this](const boost::system::error_code& ec)
+		_throttledKeys[key] = Clock::now() + duration;
+		scheduleThrottleTimer();
+	}
+
+	void
+	SendQueue::scheduleThrottleTimer()
+	{
+		const Clock::time_point now {Clock::now()};
+		for (auto itThrottled {std::begin(_throttledKeys)}; itThrottled != std::end(_throttledKeys);)
+		{
+			if (itThrottled->second <= now)
+				itThrottled = _throttledKeys.erase(itThrottled);
+			else
+				++itThrottled;
+		}
+
+		if (_throttledKeys.empty())
+			return;
+
+		const auto itFirstExpired {std::min_element(std::cbegin(_throttledKeys), std::cend(_throttledKeys), [](const auto& a, const auto& b) { return a.second < b.second; })};
+
+		// cancels the previous wait, if any
+		_throttleTimer.expires_at(itFirstExpired->second);
+		_throttleTimer.async_wait(boost::asio::bind_executor(_strand, [this](const boost::system::error_code& ec)
 		{
 			if (ec == boost::asio::error::operation_aborted)
 			{
@@ -236,9 +336,8 @@ namespace Http
 				throw LmsException {"Throttle timer failure: " + std::string {ec.message()} };
 			}
 
-			_state = State::Idle;
-			sendNextQueuedRequest();
-		});
-		_state = State::Throttled;
+			scheduleThrottleTimer();
+			sendQueuedRequests();
+		}));
 	}
 } // namespace Scrobbling::ListenBrainz
@@ -19,9 +19,16 @@
 
 #pragma once
 
+#include <chrono>
 #include <deque>
-#include <vector>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/io_context_strand.hpp>
@@ -32,10 +39,12 @@
 
 namespace Http
 {
+	// Requests are sent by priority, using up to maxConcurrentRequests connections
+	// Requests sharing the same authorization token are sent one at a time, in order, and are throttled together
 	class SendQueue
 	{
 		public:
-			SendQueue(boost::asio::io_context& ioContext, std::string_view baseUrl);
+			SendQueue(boost::asio::io_context& ioContext, std::string_view baseUrl, std::size_t maxResponseSize, std::size_t maxConcurrentRequests);
 			~SendQueue();
 
 			SendQueue(const SendQueue&) = delete;
@@ -46,12 +55,26 @@ namespace Http
 			void sendRequest(std::unique_ptr<ClientRequest> request);
 
 		private:
-			void sendNextQueuedRequest();
-			bool sendRequest(const ClientRequest& request);
-			void onClientDone(Wt::AsioWrapper::error_code ec, const Wt::Http::Message& msg);
+			using Clock = std::chrono::steady_clock;
+			using ThrottleKey = std::string; // authorization token, empty if none
+
+			struct Slot
+			{
+				std::unique_ptr<Wt::Http::Client>	client;
+				std::unique_ptr<ClientRequest>		request; // in flight request, if any
+			};
+
+			void sendQueuedRequests();
+			std::unique_ptr<ClientRequest> popNextSendableRequest();
+			bool isSendable(const ClientRequest& request) const;
+			bool sendRequest(Slot& slot, const ClientRequest& request);
+			void onClientDone(Slot& slot, Wt::AsioWrapper::error_code ec, const Wt::Http::Message& msg);
 			void onClientDoneError(std::unique_ptr<ClientRequest> request, Wt::AsioWrapper::error_code ec);
 			void onClientDoneSuccess(std::unique_ptr<ClientRequest> request, const Wt::Http::Message& msg);
-			void throttle(std::chrono::seconds duration);
+			void throttle(const ThrottleKey& key, std::chrono::seconds duration);
+			void scheduleThrottleTimer();
+
+			static ThrottleKey getThrottleKey(const ClientRequest& request);
 
 			const std::size_t			_maxRetryCount {2};
 			const std::chrono::seconds	_defaultRetryWaitDuration {30};
@@ -63,17 +86,10 @@ namespace Http
 			boost::asio::steady_timer		_throttleTimer {_ioContext};
 			std::string						_baseUrl;
 
-			enum class State
-			{
-				Idle,
-				Throttled,
-				Sending,
-			};
-			State								_state {State::Idle};
-			Wt::Http::Client					_client {_ioContext};
+			std::vector<std::unique_ptr<Slot>>	_slots;
 			std::map<ClientRequestParameters::Priority, std::deque<std::unique_ptr<ClientRequest>>> _sendQueue;
-			std::unique_ptr<ClientRequest>		_currentRequest;
+			std::unordered_map<ThrottleKey, Clock::time_point>	_throttledKeys; // until when
+			std::unordered_set<ThrottleKey>						_inFlightKeys; // empty key not tracked
 	};
 
 } // namespace Scrobbling::ListenBrainz
-
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <system_error>
+
+// Process wide engine used to read file chunks without blocking the request threads on slow storage
+// With the io_uring engine, reads are submitted to the kernel and completed on a dedicated event loop thread,
+// so that many concurrent streams only need a few threads
+namespace AsyncFileReader
+{
+	enum class Engine
+	{
+		Sync,		// reads are made by the calling thread
+		IoUring,	// Linux only
+	};
+
+	// to be called at startup, before any read
+	// Falls back on the Sync engine if io_uring is not supported by the system
+	void setEngine(Engine engine, std::size_t queueDepth);
+	Engine getEngine();
+
+	// ec is set on error, readByteCount == 0 means end of file
+	using ReadCallback = std::function<void(std::error_code ec, std::size_t readByteCount)>;
+
+	// The file descriptor and the buffer must remain valid until the callback is called
+	// The callback is called from the engine thread, or before returning with the Sync engine
+	void asyncRead(int fd, std::uint64_t offset, std::byte* buffer, std::size_t size, ReadCallback callback);
+}
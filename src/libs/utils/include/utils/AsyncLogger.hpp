@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Logger.hpp"
+
+// Forwards the logs to another logger, from a dedicated thread
+// Logs are queued in a fixed size lock-free queue: when it is full, logs are dropped (and counted) instead of blocking the caller
+// Fatal logs are forwarded synchronously, once the logs queued before them have been forwarded
+// Note: the forwarding thread has no context of the caller (for instance, no Wt session id in the Wt logs)
+class AsyncLogger final : public Logger
+{
+	public:
+		AsyncLogger(std::unique_ptr<Logger> logger, std::size_t maxQueuedLogCount = 8192);
+		~AsyncLogger();
+
+		AsyncLogger(const AsyncLogger&) = delete;
+		AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+		void processLog(const Log& log) override;
+		bool isSeverityActive(Module module, Severity severity) const override;
+
+	private:
+		struct Entry
+		{
+			std::atomic<std::size_t>	sequence;
+			Module						module;
+			Severity					severity;
+			std::string					message;
+		};
+
+		bool tryPush(Module module, Severity severity, std::string&& message);
+		bool tryPop(Module& module, Severity& severity, std::string& message);
+		void forward(Module module, Severity severity, const std::string& message);
+		void waitForQueuedLogs();
+		void processQueuedLogs();
+
+		const std::unique_ptr<Logger>	_logger;
+		const std::size_t				_queueSize; // power of 2
+		std::unique_ptr<Entry[]>		_queue;
+
+		alignas(64) std::atomic<std::size_t>	_enqueuePosition {};
+		alignas(64) std::size_t					_dequeuePosition {}; // only used by the flush thread
+		std::atomic<std::size_t>				_droppedLogCount {};
+		std::size_t								_forwardedPosition {}; // protected by _mutex
+
+		std::atomic<bool>			_stop {};
+		std::atomic<bool>			_waiting {};
+		std::mutex					_mutex;
+		std::condition_variable		_cv;
+		std::condition_variable		_forwardedCv;
+		std::thread					_thread;
+};
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <sched.h>
+#include <sys/types.h>
+
+// Placement of the CPU intensive workloads on the cores, so that they do not compete with the request threads
+// The request threads are never restricted: confining the other workloads to some of the cores keeps the
+// remaining cores available for the request handling.
+namespace CpuPlacement
+{
+	enum class Workload
+	{
+		Background,	// scan, cover generation
+		Bulk,		// recommendation engine training
+		Transcoder,	// ffmpeg child processes
+	};
+
+	struct Placement
+	{
+		std::vector<unsigned>	cpus;				// empty means all the CPUs
+		unsigned				niceIncrement {};	// added to the nice value of the process, 0 means unchanged
+		std::filesystem::path	cgroup;				// cgroup v2 directory the processes are moved into, empty means none (processes only)
+	};
+
+	// Linux CPU list format, ex: "0-3,6", empty list if str is empty
+	std::optional<std::vector<unsigned>> parseCpuList(std::string_view str);
+
+	// to be called at startup, from the main thread
+	void setPlacement(Workload workload, const Placement& placement);
+	Placement getPlacement(Workload workload);
+
+	// Applies to the calling thread only, no-op if already done for this workload
+	// Nice values cannot be decreased without privileges: a thread keeps the highest nice value it has been given
+	void placeCurrentThread(Workload workload);
+
+	// Spawned processes inherit the CPU affinity of the spawning thread: the calling thread is restricted to the
+	// CPUs of the workload during the lifetime of this object, so that the process and all its threads start on them
+	class ScopedSpawnPlacement
+	{
+		public:
+			ScopedSpawnPlacement(Workload workload);
+			~ScopedSpawnPlacement();
+
+			ScopedSpawnPlacement(const ScopedSpawnPlacement&) = delete;
+			ScopedSpawnPlacement& operator=(const ScopedSpawnPlacement&) = delete;
+
+		private:
+#if defined(__linux__)
+			std::optional<cpu_set_t>	_previousCpus;	// set if the calling thread has to be restored
+#endif
+	};
+
+	// Moves a just spawned process into the cgroup of the workload and applies the nice value to all its threads
+	// The nice value is applied after the spawn since the spawning thread could not get its own nice value back
+	void placeProcess(Workload workload, pid_t pid);
+}
@@ -19,28 +19,26 @@
 
 #pragma once
 
-#include <boost/crc.hpp>  // for boost::crc_32_type
+#include <cstddef>
+#include <cstdint>
 
 namespace Utils
 {
 
+	// CRC-32 (same as zlib), using the CPU instructions if available
 	class Crc32Calculator
 	{
 		public:
 
-			void processBytes(const std::byte* _data, std::size_t dataSize)
-			{
-				_result.process_bytes(_data, dataSize);
-			}
+			void processBytes(const std::byte* data, std::size_t dataSize);
 
 			std::uint32_t getResult() const
 			{
-				return _result.checksum();
+				return ~_crc;
 			}
 
 		private:
-			using Crc32Type = boost::crc_32_type;
-			Crc32Type _result;
+			std::uint32_t _crc {0xFFFFFFFF};
 	};
 
 }
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2021 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+// Approximate distribution of durations, using a fixed amount of memory
+class DurationHistogram
+{
+	public:
+		using Duration = std::chrono::microseconds;
+
+		void		add(Duration duration);
+
+		std::size_t	getCount() const { return _count; }
+		Duration	getPercentile(unsigned percentile) const; // percentile in range [0-100], upper bound of the matching bucket
+
+	private:
+		static constexpr std::size_t	bucketsPerPowerOfTwo {4};
+		static constexpr std::size_t	bucketCount {bucketsPerPowerOfTwo * 40};
+
+		std::array<std::size_t, bucketCount>	_buckets {};
+		std::size_t								_count {};
+};
+
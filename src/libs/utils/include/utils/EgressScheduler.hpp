@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Wt::Http
+{
+	class Response;
+	class ResponseContinuation;
+}
+
+// Process wide pacing of the media data sent to the clients, so that bulk transfers cannot saturate the uplink
+// Each traffic class has its own rate, shared equally by the clients currently transferring data in this class
+// Transfers exceeding their share are resumed later using delayed continuations: no thread is ever blocked
+namespace EgressScheduler
+{
+	enum class TrafficClass
+	{
+		Interactive,	// streams, transcodes someone is listening to
+		Bulk,			// downloads, offline caching
+	};
+
+	struct Limits
+	{
+		std::uint64_t	interactiveRate {};	// bytes per second, 0 means unlimited
+		std::uint64_t	bulkRate {};		// bytes per second, 0 means unlimited
+	};
+
+	// to be called at startup, before any transfer
+	void setLimits(Limits limits);
+	Limits getLimits();
+
+	struct TransferInfo
+	{
+		TrafficClass	trafficClass {TrafficClass::Interactive};
+		std::string		clientId;	// usually the user
+	};
+
+	// Must live as long as the response is being sent
+	class Transfer
+	{
+		public:
+			Transfer(const TransferInfo& info);
+			~Transfer();
+
+			Transfer(const Transfer&) = delete;
+			Transfer& operator=(const Transfer&) = delete;
+
+			// Accounts for data just written to the response, returns how long to wait before sending more data
+			std::chrono::steady_clock::duration onDataSent(std::size_t byteCount);
+
+			// Continuation to send the next chunk, resumed once the client is allowed to send more data
+			Wt::Http::ResponseContinuation* createContinuation(Wt::Http::Response& response, std::size_t sentByteCount);
+
+		private:
+			const TrafficClass	_trafficClass;
+			const std::string	_clientId;
+	};
+
+	// The continuation must be waiting for more data
+	void resumeAfter(Wt::Http::ResponseContinuation* continuation, std::chrono::steady_clock::duration delay);
+}
@@ -22,7 +22,13 @@
 #include <filesystem>
 #include <memory>
 
+#include "utils/EgressScheduler.hpp"
 #include "utils/IResourceHandler.hpp"
 
-std::unique_ptr<IResourceHandler> createFileResourceHandler(const std::filesystem::path& path);
+// Sent data is paced by the egress scheduler
+std::unique_ptr<IResourceHandler> createFileResourceHandler(const std::filesystem::path& path, const EgressScheduler::TransferInfo& transferInfo = {});
+
+// For the media files, that may be served by the reverse proxy instead, depending on "file-offload-mode" (not paced in that case)
+// The access checks must have been done before
+std::unique_ptr<IResourceHandler> createOffloadableFileResourceHandler(const std::filesystem::path& path, const EgressScheduler::TransferInfo& transferInfo = {});
 
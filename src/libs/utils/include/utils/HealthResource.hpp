@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <Wt/WResource.h>
+
+// Reports the state of the components, one per line
+// Health always responds 200 as long as the server is running
+// Readiness responds 503 as long as one of the components required for readiness is not ready
+// No session is created, the checks must not wait for anything
+class HealthResource final : public Wt::WResource
+{
+	public:
+		enum class Type
+		{
+			Health,
+			Readiness,
+		};
+
+		struct ComponentStatus
+		{
+			bool		ready {};
+			std::string	details;
+		};
+		using GetStatusFunc = std::function<ComponentStatus()>;
+
+		HealthResource(Type type);
+		~HealthResource() override;
+
+		// to be called before the server is started
+		void addComponent(std::string name, GetStatusFunc getStatusFunc, bool requiredForReadiness);
+
+	private:
+		void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+
+		struct Component
+		{
+			std::string		name;
+			GetStatusFunc	getStatusFunc;
+			bool			requiredForReadiness;
+		};
+
+		const Type				_type;
+		std::vector<Component>	_components;
+};
@@ -52,5 +52,7 @@ class IChildProcess
 		virtual void		asyncWaitForData(WaitCallback cb) = 0;
 		virtual std::size_t	readSome(std::byte* data, std::size_t bufferSize) = 0;
 		virtual bool		finished() = 0;
+		// Only once finished: waits for the process to exit, true if it exited with code 0
+		virtual bool		succeeded() = 0;
 };
 
@@ -22,6 +22,7 @@
 #include <memory>
 #include <boost/asio/io_service.hpp>
 
+#include "CpuPlacement.hpp"
 #include "IChildProcess.hpp"
 
 class IChildProcessManager
@@ -29,7 +30,8 @@ class IChildProcessManager
 	public:
 		virtual ~IChildProcessManager() = default;
 
-		virtual std::unique_ptr<IChildProcess> spawnChildProcess(const std::filesystem::path& path, const IChildProcess::Args& args) = 0;
+		// The process is placed on the CPUs of the given workload
+		virtual std::unique_ptr<IChildProcess> spawnChildProcess(const std::filesystem::path& path, const IChildProcess::Args& args, CpuPlacement::Workload workload) = 0;
 };
 
 std::unique_ptr<IChildProcessManager> createChildProcessManager(boost::asio::io_service& ioService);
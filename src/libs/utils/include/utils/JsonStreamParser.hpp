@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string_view>
+
+// Event based JSON parser, no document tree is built
+// Meant to extract a few fields out of large payloads: containers the handler is not interested in are skipped
+// Paths are made of the object keys leading to a value, joined by '.'. Array elements share the path of their array
+namespace JsonStream
+{
+	enum class ScalarType
+	{
+		String,
+		Number,
+		Boolean,
+		Null,
+	};
+
+	class IHandler
+	{
+		public:
+			virtual ~IHandler() = default;
+
+			// Return false to skip the whole content of the container (the matching end callback is not called either)
+			virtual bool onStartObject([[maybe_unused]] std::string_view path) { return true; }
+			virtual void onEndObject([[maybe_unused]] std::string_view path) {}
+			virtual bool onStartArray([[maybe_unused]] std::string_view path) { return true; }
+			virtual void onEndArray([[maybe_unused]] std::string_view path) {}
+
+			// Strings are unescaped, other values are given as their raw JSON token
+			virtual void onScalar(std::string_view path, ScalarType type, std::string_view value) = 0;
+	};
+
+	// Returns false if the document is malformed (the handler may already have been called)
+	bool parse(std::string_view document, IHandler& handler);
+}
@@ -83,8 +83,28 @@ class Logger
 	public:
 		virtual ~Logger() = default;
 		virtual void processLog(const Log& log) = 0;
+
+		// Used to skip the message formatting if it would be discarded anyway
+		virtual bool isSeverityActive(Module, Severity) const { return true; }
+};
+
+bool isLogActive(Module module, Severity severity);
+
+// Logs that are more verbose than this severity are compiled out
+#ifndef LMS_LOG_MAX_SEVERITY
+#define LMS_LOG_MAX_SEVERITY DEBUG
+#endif
+
+// Turns the streaming expression into void, so that it can be used in a conditional expression
+// operator& binds less tightly than operator<< and more tightly than ?:
+class LogVoidify
+{
+	public:
+		void operator&(std::ostream&) {}
 };
 
-#define LMS_LOG(module, severity)		Log(Service<Logger>::get(), Module::module, Severity::severity).getOstream()
-#define LMS_LOG_EX(module, severity)	Log(Service<Logger>::get(), module, severity).getOstream()
+// Streamed values are not evaluated if the log is not active
+// Expression form, so that unbraced if/else around a log are safe and do not trigger -Wdangling-else
+#define LMS_LOG(module, severity)		(Severity::severity > Severity::LMS_LOG_MAX_SEVERITY || !isLogActive(Module::module, Severity::severity)) ? (void)0 : LogVoidify() & Log(Service<Logger>::get(), Module::module, Severity::severity).getOstream()
+#define LMS_LOG_EX(module, severity)	!isLogActive(module, severity) ? (void)0 : LogVoidify() & Log(Service<Logger>::get(), module, severity).getOstream()
 
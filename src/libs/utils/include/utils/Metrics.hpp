@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Process wide runtime metrics, exposed using the Prometheus text format
+// Updates are lock free and only touch a per thread shard, reads sum all the shards
+namespace Metrics
+{
+	namespace details
+	{
+		static inline constexpr std::size_t shardCount {16};
+
+		std::size_t getCurrentShard();
+
+		struct alignas(64) CounterShard
+		{
+			std::atomic<std::uint64_t>	value {};
+		};
+	}
+
+	class Counter
+	{
+		public:
+			void add(std::uint64_t value = 1)
+			{
+				_shards[details::getCurrentShard()].value.fetch_add(value, std::memory_order_relaxed);
+			}
+
+			std::uint64_t get() const;
+
+		private:
+			std::array<details::CounterShard, details::shardCount> _shards;
+	};
+
+	// Current value of something (queue depth, running items, etc.)
+	class Gauge
+	{
+		public:
+			void add(std::int64_t value = 1) { _value.fetch_add(value, std::memory_order_relaxed); }
+			void sub(std::int64_t value = 1) { _value.fetch_sub(value, std::memory_order_relaxed); }
+			void set(std::int64_t value) { _value.store(value, std::memory_order_relaxed); }
+
+			std::int64_t get() const { return _value.load(std::memory_order_relaxed); }
+
+		private:
+			std::atomic<std::int64_t> _value {};
+	};
+
+	// Gauge incremented during its lifetime
+	class ScopedGaugeIncrement
+	{
+		public:
+			ScopedGaugeIncrement(Gauge& gauge) : _gauge {gauge} { _gauge.add(); }
+			~ScopedGaugeIncrement() { _gauge.sub(); }
+
+			ScopedGaugeIncrement(const ScopedGaugeIncrement&) = delete;
+			ScopedGaugeIncrement& operator=(const ScopedGaugeIncrement&) = delete;
+
+		private:
+			Gauge& _gauge;
+	};
+
+	// Distribution of durations, using fixed buckets
+	class Histogram
+	{
+		public:
+			using Duration = std::chrono::microseconds;
+
+			Histogram(std::vector<Duration> bucketUpperBounds);
+
+			void observe(Duration duration);
+
+			struct Snapshot
+			{
+				std::vector<Duration>		bucketUpperBounds;
+				std::vector<std::uint64_t>	cumulativeCounts; // last one is +Inf
+				Duration					sum {};
+				std::uint64_t				count {};
+			};
+			Snapshot get() const;
+
+			static std::vector<Duration> getDefaultBucketUpperBounds();
+
+		private:
+			std::size_t getIndex(std::size_t shard, std::size_t bucket) const { return shard * _shardStride + bucket; }
+
+			const std::vector<Duration>					_bucketUpperBounds;
+			const std::size_t							_shardStride; // buckets, +Inf and sum, rounded to a cache line
+			std::unique_ptr<std::atomic<std::uint64_t>[]>	_values;
+	};
+
+	// Records the duration of a scope
+	class ScopedTimer
+	{
+		public:
+			ScopedTimer(Histogram& histogram) : _histogram {histogram} {}
+			~ScopedTimer() { if (!_dismissed) _histogram.observe(std::chrono::duration_cast<Histogram::Duration>(std::chrono::steady_clock::now() - _start)); }
+
+			ScopedTimer(const ScopedTimer&) = delete;
+			ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+			// Nothing is recorded: the duration is to be observed by other means (ex: the scope hands over the work to another thread)
+			void dismiss() { _dismissed = true; }
+			std::chrono::steady_clock::time_point getStart() const { return _start; }
+
+		private:
+			Histogram&									_histogram;
+			const std::chrono::steady_clock::time_point	_start {std::chrono::steady_clock::now()};
+			bool										_dismissed {};
+	};
+
+	// Metrics are never destroyed, hence references can be kept in static variables by the hot paths
+	// Metrics with the same name must have the same type and help, and are told apart by their labels (ex: 'endpoint="ping"')
+	class Registry
+	{
+		public:
+			Counter&	createCounter(std::string_view name, std::string_view help, std::string_view labels = {});
+			Gauge&		createGauge(std::string_view name, std::string_view help, std::string_view labels = {});
+			Histogram&	createHistogram(std::string_view name, std::string_view help, std::string_view labels = {}, std::vector<Histogram::Duration> bucketUpperBounds = Histogram::getDefaultBucketUpperBounds());
+
+			void serialize(std::ostream& os) const;
+
+		private:
+			enum class Type
+			{
+				Counter,
+				Gauge,
+				Histogram,
+			};
+
+			struct Entry
+			{
+				std::string	name;
+				std::string	help;
+				std::string	labels;
+				Type		type;
+				Counter*	counter {};
+				Gauge*		gauge {};
+				Histogram*	histogram {};
+			};
+
+			const Entry* findEntry(std::string_view name, std::string_view labels, Type type) const;
+
+			mutable std::mutex		_mutex;
+			std::deque<Counter>		_counters;
+			std::deque<Gauge>		_gauges;
+			std::deque<Histogram>	_histograms;
+			std::vector<Entry>		_entries;
+	};
+
+	Registry& getRegistry();
+}
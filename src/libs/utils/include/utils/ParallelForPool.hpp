@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Utils
+{
+	// Persistent threads to run parallel loops, the calling thread also takes part in the work
+	// Loops are split into chunks: each participant starts with its own share of the chunks,
+	// then steals the remaining chunks of the others once done
+	class ParallelForPool
+	{
+		public:
+			// threadCount includes the calling thread
+			ParallelForPool(std::size_t threadCount);
+			~ParallelForPool();
+
+			ParallelForPool(const ParallelForPool&) = delete;
+			ParallelForPool& operator=(const ParallelForPool&) = delete;
+
+			std::size_t getThreadCount() const { return _workers.size() + 1; }
+
+			// Calls func(first, last) on contiguous chunks of [0, count), of at most chunkSize elements (0 means automatic)
+			// Returns once all the chunks are processed, rethrows the first exception thrown by func
+			// Only one loop at a time: must not be called from func
+			using RangeFunc = std::function<void(std::size_t /* first */, std::size_t /* last */)>;
+			void parallelFor(std::size_t count, const RangeFunc& func, std::size_t chunkSize = 0);
+
+		private:
+			void workerLoop(std::size_t participantIndex);
+			void runChunks(std::size_t participantIndex);
+
+			// Chunks [next, end) not processed yet, own cache line to limit false sharing
+			struct alignas(64) Share
+			{
+				std::atomic<std::size_t>	next {};
+				std::size_t					end {};
+			};
+
+			std::vector<std::thread>	_workers;
+			std::unique_ptr<Share[]>	_shares;
+
+			std::mutex					_mutex;
+			std::condition_variable		_workerCv;
+			std::condition_variable		_doneCv;
+			std::size_t					_generation {};
+			std::size_t					_runningWorkerCount {};
+			bool						_stop {};
+
+			// current loop
+			const RangeFunc*			_func {};
+			std::size_t					_count {};
+			std::size_t					_chunkSize {};
+			std::atomic<bool>			_failed {};
+			std::exception_ptr			_exception;
+	};
+} // namespace Utils
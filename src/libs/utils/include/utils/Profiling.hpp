@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Built-in CPU profiler, attributing the CPU time of the threads to what they are doing
+// Threads label what they are doing using scoped labels (Subsonic endpoint, scan step, etc.) and sub labels
+// (tracing spans: database transactions, cover computation, etc.). Setting labels only costs thread local stores.
+// During a capture, the CPU clocks of the labelled threads are periodically sampled, and their CPU time
+// since the previous sample is attributed to their current labels.
+namespace Profiling
+{
+	// label must have a static storage duration (literals, etc.)
+	class ScopedLabel
+	{
+		public:
+			ScopedLabel(const char* label);
+			~ScopedLabel();
+
+			ScopedLabel(const ScopedLabel&) = delete;
+			ScopedLabel& operator=(const ScopedLabel&) = delete;
+
+		private:
+			const char* _previousLabel;
+			const char* _previousSubLabel;
+	};
+
+	// label must have a static storage duration (literals, etc.)
+	class ScopedSubLabel
+	{
+		public:
+			ScopedSubLabel(const char* subLabel);
+			~ScopedSubLabel();
+
+			ScopedSubLabel(const ScopedSubLabel&) = delete;
+			ScopedSubLabel& operator=(const ScopedSubLabel&) = delete;
+
+		private:
+			const char* _previousSubLabel;
+	};
+
+	struct CpuProfile
+	{
+		struct Entry
+		{
+			std::string					label; // "label > sublabel"
+			std::chrono::microseconds	cpuTime {};
+		};
+
+		std::chrono::microseconds	duration {};
+		std::chrono::microseconds	processCpuTime {};	// whole process, including the unlabelled threads
+		std::vector<Entry>			entries;			// by decreasing CPU time
+	};
+
+	// Blocks the calling thread during the capture, the other threads are not interrupted
+	CpuProfile captureCpuProfile(std::chrono::milliseconds duration, std::chrono::milliseconds samplingPeriod = std::chrono::milliseconds {10});
+
+	// Heap statistics of the allocator (glibc malloc_info XML output), empty if not supported
+	std::string getHeapInfo();
+}
@@ -20,6 +20,9 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <random>
 
 namespace Random {
@@ -29,6 +32,24 @@ RandGenerator& getRandGenerator();
 
 RandGenerator createSeededGenerator(uint_fast32_t seed);
 
+// Seeded random permutation of [0, size), without storing it
+// Each element is computed in constant time, so that it can be iterated page by page
+class Permutation
+{
+	public:
+		Permutation(std::size_t size, std::uint64_t seed);
+
+		std::size_t getSize() const { return _size; }
+		std::size_t operator[](std::size_t index) const;
+
+	private:
+		std::uint64_t encrypt(std::uint64_t value) const;
+
+		std::size_t						_size;
+		unsigned						_halfBitCount {};
+		std::array<std::uint64_t, 4>	_roundKeys;
+};
+
 template <typename T>
 T
 getRandom(T min, T max)
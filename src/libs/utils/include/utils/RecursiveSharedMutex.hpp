@@ -19,12 +19,13 @@
 
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <shared_mutex>
 #include <thread>
-#include <unordered_map>
 
 // API compatible with shared_mutex
+// Per thread shared lock counts are kept in thread local storage: uncontended shared locks only cost the underlying shared_mutex
 class RecursiveSharedMutex
 {
 	public:
@@ -35,15 +36,11 @@ class RecursiveSharedMutex
 		void unlock_shared();
 
 #ifndef NDEBUG
-		bool isSharedLocked();
-		bool isUniqueLocked();
+		bool isSharedLocked() const;
+		bool isUniqueLocked() const;
 #endif // NDEBUG
 	private:
 		std::shared_mutex _mutex;
-		std::thread::id _uniqueOwner;
+		std::atomic<std::thread::id> _uniqueOwner;
 		std::size_t _uniqueCount{};
-
-		std::mutex _sharedCountMutex;
-		std::unordered_map<std::thread::id, std::size_t> _sharedCounts;
 };
-
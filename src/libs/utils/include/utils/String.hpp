@@ -19,11 +19,14 @@
 
 #pragma once
 
+#include <charconv>
 #include <initializer_list>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <sstream>
+#include <system_error>
+#include <type_traits>
 #include <vector>
 
 #define QUOTEME(x) QUOTEME_1(x)
@@ -63,10 +66,28 @@ std::optional<T> readAs(std::string_view str)
 {
 	T res;
 
-	std::istringstream iss {std::string {str}};
-	iss >> res;
-	if (iss.fail())
-		return std::nullopt;
+	// Integers are often read while scanning files or handling requests: avoid the stream allocations
+	if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+	{
+		// Same leading characters as the stream extraction
+		const std::size_t start {str.find_first_not_of(" \t\n\v\f\r")};
+		if (start == std::string_view::npos)
+			return std::nullopt;
+
+		str.remove_prefix(start);
+		if (str.front() == '+')
+			str.remove_prefix(1);
+
+		if (std::from_chars(str.data(), str.data() + str.size(), res).ec != std::errc {})
+			return std::nullopt;
+	}
+	else
+	{
+		std::istringstream iss {std::string {str}};
+		iss >> res;
+		if (iss.fail())
+			return std::nullopt;
+	}
 
 	return res;
 }
@@ -85,10 +106,15 @@ std::string
 escapeString(std::string_view str, std::string_view charsToEscape, char escapeChar);
 
 bool
-stringEndsWith(const std::string& str, const std::string& ending);
+stringEndsWith(std::string_view str, std::string_view ending);
 
 std::optional<std::string>
 stringFromHex(const std::string& str);
 
+// Key to sort names: case folded, latin diacritics stripped, leading punctuation and articles skipped
+// Meant to be computed once and stored, compared using plain binary comparisons
+std::string
+computeSortKey(std::string_view str);
+
 } // StringUtils
 
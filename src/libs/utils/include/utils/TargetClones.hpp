@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2024 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#if __has_include(<features.h>)
+#include <features.h> // defines __GLIBC__
+#endif
+
+// Builds several versions of a function, the one matching the CPU is picked at load time
+// Relies on ifunc, only provided by glibc (not by musl for instance): other builds use the portable version only
+#if defined(__x86_64__) && defined(__GLIBC__) && defined(__has_attribute)
+	#if __has_attribute(target_clones)
+		#define LMS_TARGET_CLONES(...) __attribute__((target_clones(__VA_ARGS__)))
+	#endif
+#endif
+#ifndef LMS_TARGET_CLONES
+	#define LMS_TARGET_CLONES(...)
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "utils/Profiling.hpp"
+
+// Lightweight request tracing
+// A trace is attached to the current thread while its ScopedTrace is alive, and the ScopedSpans opened
+// in the meantime on the same thread are recorded in it, whatever the layer they belong to.
+// Spans opened on a thread without any active trace are no-ops, spans must not outlive their trace.
+namespace Tracing
+{
+	struct Settings
+	{
+		std::chrono::milliseconds	slowThreshold {}; // 0 means disabled
+		unsigned					samplingPercent {100};
+	};
+
+	class Trace
+	{
+		public:
+			using Clock = std::chrono::steady_clock;
+
+			struct Span
+			{
+				const char*			name; // must be a literal
+				std::size_t			depth {};
+				Clock::duration		start {}; // relative to the trace start
+				Clock::duration		duration {};
+			};
+
+			Trace(std::string name);
+
+			const std::string&			getName() const { return _name; }
+			Clock::duration				getDuration() const { return _duration; }
+			const std::vector<Span>&	getSpans() const { return _spans; }
+			std::size_t					getDroppedSpanCount() const { return _droppedSpanCount; }
+
+		private:
+			friend class ScopedTrace;
+			friend class ScopedSpan;
+
+			static constexpr std::size_t _maxSpanCount {256};
+
+			const std::string			_name;
+			const Clock::time_point		_start {Clock::now()};
+			Clock::duration				_duration {};
+			std::size_t					_depth {};
+			std::vector<Span>			_spans;
+			std::size_t					_droppedSpanCount {};
+	};
+
+	// one line, spans are prefixed by their depth
+	std::ostream& operator<<(std::ostream& os, const Trace& trace);
+
+	class ScopedTrace
+	{
+		public:
+			// called at the end of the scope if the trace took more than the threshold
+			using ReportFunc = std::function<void(const Trace&)>;
+
+			ScopedTrace(std::string name, const Settings& settings, ReportFunc reportFunc);
+			~ScopedTrace();
+
+			ScopedTrace(const ScopedTrace&) = delete;
+			ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+		private:
+			std::unique_ptr<Trace>		_trace; // nullptr if not sampled
+			std::chrono::milliseconds	_slowThreshold;
+			ReportFunc					_reportFunc;
+	};
+
+	class ScopedSpan
+	{
+		public:
+			ScopedSpan(const char* name);
+			~ScopedSpan();
+
+			ScopedSpan(const ScopedSpan&) = delete;
+			ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+		private:
+			Profiling::ScopedSubLabel	_subLabel; // spans are also used to label the profiles, even if not traced
+			Trace*						_trace;
+			std::size_t					_index {};
+	};
+}
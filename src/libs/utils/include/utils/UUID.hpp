@@ -19,23 +19,32 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <string_view>
 
 #include "utils/String.hpp"
 
+// Held as raw bytes: parsing and comparisons are cheap, the string form is only built when needed
 class UUID
 {
 	public:
+		using Bytes = std::array<std::uint8_t, 16>;
 
+		// Accepts the canonical 8-4-4-4-12 hex form, whatever the case
 		static std::optional<UUID> fromString(std::string_view str);
 
-		std::string_view getAsString() const { return _value; }
+		const Bytes& getBytes() const { return _bytes; }
+		std::string getAsString() const; // lower case
+
+		bool operator==(const UUID& other) const { return _bytes == other._bytes; }
+		bool operator!=(const UUID& other) const { return _bytes != other._bytes; }
 
 	private:
-		UUID(std::string_view value);
-		std::string _value;
+		UUID(const Bytes& bytes) : _bytes {bytes} {}
+		Bytes _bytes;
 };
 
 namespace StringUtils
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+// Process wide budget of the CPU intensive work done outside of the request handling
+// The Wt server threads are never limited: the background and bulk works share a number of slots
+// smaller than the core count, so that a scan or a training cannot starve the request handling.
+// Background work has priority over bulk work, which also has its own cap.
+namespace WorkBudget
+{
+	enum class WorkClass
+	{
+		Background,	// scan, cover generation
+		Bulk,		// recommendation engine training
+	};
+
+	struct Limits
+	{
+		std::size_t	slotCount;		// shared by all the classes
+		std::size_t	bulkSlotCount;	// <= slotCount
+	};
+
+	// defaults to cores - 1 slots, half of them for bulk work
+	Limits getDefaultLimits();
+
+	// to be called at startup, before any slot is acquired
+	void setLimits(Limits limits);
+	Limits getLimits();
+
+	// Blocks until a slot is available for this class, then places the calling thread on the CPUs of this class (see CpuPlacement)
+	// Nested slots on the same thread do not consume another slot
+	class ScopedSlot
+	{
+		public:
+			ScopedSlot(WorkClass workClass);
+			~ScopedSlot();
+
+			ScopedSlot(const ScopedSlot&) = delete;
+			ScopedSlot& operator=(const ScopedSlot&) = delete;
+
+		private:
+			const WorkClass	_workClass;
+			bool			_acquired {};
+	};
+}
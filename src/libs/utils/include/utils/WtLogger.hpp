@@ -25,5 +25,6 @@ class WtLogger final : public Logger
 {
 	public:
 		void processLog(const Log& log) override;
+		bool isSeverityActive(Module module, Severity severity) const override;
 };
 
@@ -20,7 +20,10 @@
 #pragma once
 
 #include <filesystem>
+#include <fstream>
 #include <map>
+#include <optional>
+#include <string>
 
 #include <Wt/WDateTime.h>
 
@@ -37,6 +40,7 @@ namespace Zip
 	};
 
 	// Very simple on-the-fly zip creator, "store" method only
+	// The layout is deterministic: same files and same modification times give the same output
 	class Zipper
 	{
 		public:
@@ -49,8 +53,32 @@ namespace Zip
 
 			SizeType getTotalZipFile() const { return _totalZipSize; }
 
+			// Strong entity tag of the zip content, computed from the entries (names, paths, sizes and modification times)
+			std::string computeEntityTag() const;
+
+			// Next writes will start at this offset in the zip file, must be called before any write
+			// Note: the checksums of the skipped file contents are computed by reading the files
+			void seek(SizeType offset);
+
+			// Checksum known in advance, the file content is then not processed to compute it
+			void setCrc32(const std::string& fileName, std::uint32_t crc32);
+
+			// Extent mode: writeSome stops before each file content, that is then to be taken using takeFileDataExtent
+			// and sent by the caller straight from the file (sendfile, mmap, etc.)
+			// Note: unless set using setCrc32, the checksums are computed by reading the files again
+			void enableFileDataExtents() { _fileDataExtents = true; }
+
+			struct FileDataExtent
+			{
+				std::filesystem::path	filePath;
+				SizeType				offset {};
+				SizeType				size {};
+			};
+			// Part of the current file content still to be sent, if any: next writes will start after it
+			std::optional<FileDataExtent> takeFileDataExtent();
+
 		private:
-			void setComplete();
+			SizeType writeNextElement(std::byte* buffer, SizeType bufferSize);
 
 			SizeType writeLocalFileHeader(std::byte* buffer, SizeType bufferSize);
 			SizeType writeLocalFileHeaderFileName(std::byte* buffer, SizeType bufferSize);
@@ -70,9 +98,15 @@ namespace Zip
 				SizeType fileSize;
 				Wt::WDateTime lastModifiedTime;
 				Utils::Crc32Calculator fileCrc32;
+				SizeType crc32ProcessedSize {};
+				std::optional<std::uint32_t> crc32; // set once all the file content has been processed
 				SizeType localFileHeaderOffset {};
 			};
 
+			static SizeType getLocalFileSize(const std::string& fileName, const FileContext& fileContext);
+			static SizeType getCentralDirectoryHeaderSize(const std::string& fileName);
+			static std::uint32_t getCrc32(FileContext& fileContext);
+
 			using FileContainer = std::map<std::string, FileContext>;
 			FileContainer _files;
 
@@ -95,11 +129,13 @@ namespace Zip
 			SizeType _totalZipSize {};
 			WriteState _writeState {WriteState::LocalFileHeader};
 			FileContainer::iterator _currentFile;
+			std::ifstream _currentFileStream;
 			SizeType _currentOffset {};
-			SizeType _currentZipOffset {};
+			SizeType _bytesToSkip {}; // in the next fixed size header, after a seek
 			SizeType _centralDirectoryOffset {};
 			SizeType _centralDirectorySize {};
 			SizeType _zip64EndOfCentralDirectoryRecordOffset {};
+			bool _fileDataExtents {};
 	};
 
 } // namespace Zip
@@ -35,6 +35,8 @@ namespace Http
 			virtual void sendPOSTRequest(ClientPOSTRequestParameters&& request) = 0;
 	};
 
-	std::unique_ptr<IClient> createClient(boost::asio::io_context& ioContext, std::string_view baseUrl);
+	static inline constexpr std::size_t defaultMaxResponseSize {64 * 1024};
+	// Requests using different authorization tokens can be sent concurrently, up to maxConcurrentRequests
+	std::unique_ptr<IClient> createClient(boost::asio::io_context& ioContext, std::string_view baseUrl, std::size_t maxResponseSize = defaultMaxResponseSize, std::size_t maxConcurrentRequests = 1);
 } // namespace Http
 
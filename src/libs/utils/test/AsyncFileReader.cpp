@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "utils/AsyncFileReader.hpp"
+
+namespace
+{
+	struct ReadResult
+	{
+		std::error_code	ec;
+		std::size_t		readByteCount {};
+	};
+
+	ReadResult
+	readAndWait(int fd, std::uint64_t offset, std::byte* buffer, std::size_t size)
+	{
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::optional<ReadResult> result;
+
+		AsyncFileReader::asyncRead(fd, offset, buffer, size, [&](std::error_code ec, std::size_t readByteCount)
+		{
+			{
+				std::scoped_lock lock {mutex};
+				result = ReadResult {ec, readByteCount};
+			}
+			cv.notify_one();
+		});
+
+		std::unique_lock lock {mutex};
+		cv.wait(lock, [&] { return result.has_value(); });
+		return *result;
+	}
+}
+
+TEST(AsyncFileReader, read)
+{
+	// Falls back on synchronous reads if io_uring is not available
+	AsyncFileReader::setEngine(AsyncFileReader::Engine::IoUring, 4);
+
+	const std::filesystem::path path {std::filesystem::temp_directory_path() / "lms-test-async-file-reader"};
+	std::string content;
+	for (std::size_t i {}; i < 100000; ++i)
+		content.push_back(static_cast<char>('a' + i % 26));
+
+	{
+		std::ofstream ofs {path, std::ios::binary};
+		ofs << content;
+	}
+
+	const int fd {::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+	ASSERT_GE(fd, 0);
+
+	std::vector<std::byte> buffer(4096);
+	{
+		const ReadResult result {readAndWait(fd, 1000, buffer.data(), buffer.size())};
+		EXPECT_FALSE(result.ec);
+		ASSERT_EQ(result.readByteCount, buffer.size());
+		EXPECT_EQ(std::string(reinterpret_cast<const char*>(buffer.data()), buffer.size()), content.substr(1000, buffer.size()));
+	}
+
+	{
+		const ReadResult result {readAndWait(fd, content.size() - 10, buffer.data(), buffer.size())};
+		EXPECT_FALSE(result.ec);
+		EXPECT_EQ(result.readByteCount, 10);
+	}
+
+	{
+		const ReadResult result {readAndWait(fd, content.size(), buffer.data(), buffer.size())};
+		EXPECT_FALSE(result.ec);
+		EXPECT_EQ(result.readByteCount, 0);
+	}
+
+	// more concurrent reads than the queue depth
+	{
+		constexpr std::size_t readCount {32};
+		std::vector<std::vector<std::byte>> buffers(readCount, std::vector<std::byte>(1000));
+
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::size_t completedReadCount {};
+		std::size_t failedReadCount {};
+
+		for (std::size_t i {}; i < readCount; ++i)
+		{
+			AsyncFileReader::asyncRead(fd, i * 1000, buffers[i].data(), buffers[i].size(), [&, i](std::error_code ec, std::size_t readByteCount)
+			{
+				const bool success {!ec && readByteCount == 1000 && std::string(reinterpret_cast<const char*>(buffers[i].data()), 1000) == content.substr(i * 1000, 1000)};
+				{
+					std::scoped_lock lock {mutex};
+					completedReadCount++;
+					if (!success)
+						failedReadCount++;
+				}
+				cv.notify_one();
+			});
+		}
+
+		std::unique_lock lock {mutex};
+		cv.wait(lock, [&] { return completedReadCount == readCount; });
+		EXPECT_EQ(failedReadCount, 0);
+	}
+
+	::close(fd);
+	std::filesystem::remove(path);
+
+	{
+		const ReadResult result {readAndWait(-1, 0, buffer.data(), buffer.size())};
+		EXPECT_TRUE(result.ec);
+	}
+}
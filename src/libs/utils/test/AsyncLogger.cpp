@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/AsyncLogger.hpp"
+
+namespace
+{
+	class CollectLogger : public Logger
+	{
+		public:
+			CollectLogger(std::mutex& mutex, std::set<std::string>& messages) : _mutex {mutex}, _messages {messages} {}
+
+			void processLog(const Log& log) override
+			{
+				const std::scoped_lock lock {_mutex};
+				_messages.insert(log.getMessage());
+			}
+
+		private:
+			std::mutex&				_mutex;
+			std::set<std::string>&	_messages;
+	};
+
+	void
+	log(Logger& logger, Severity severity, const std::string& message)
+	{
+		Log log {nullptr, Module::UTILS, severity};
+		log.getOstream() << message;
+		logger.processLog(log);
+	}
+}
+
+TEST(AsyncLogger, multipleProducers)
+{
+	constexpr std::size_t threadCount {4};
+	constexpr std::size_t logCountPerThread {1000};
+
+	std::mutex mutex;
+	std::set<std::string> messages;
+	{
+		AsyncLogger logger {std::make_unique<CollectLogger>(mutex, messages), threadCount * logCountPerThread};
+
+		std::vector<std::thread> threads;
+		for (std::size_t i {}; i < threadCount; ++i)
+		{
+			threads.emplace_back([&, i]
+			{
+				for (std::size_t j {}; j < logCountPerThread; ++j)
+					log(logger, Severity::INFO, std::to_string(i) + "-" + std::to_string(j));
+			});
+		}
+
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	// all the queued logs are processed on destruction
+	EXPECT_EQ(messages.size(), threadCount * logCountPerThread);
+	EXPECT_EQ(messages.count("0-0"), 1);
+	EXPECT_EQ(messages.count("3-999"), 1);
+}
+
+TEST(AsyncLogger, fatal)
+{
+	std::mutex mutex;
+	std::set<std::string> messages;
+
+	AsyncLogger logger {std::make_unique<CollectLogger>(mutex, messages)};
+	log(logger, Severity::FATAL, "fatal");
+
+	// processed synchronously
+	const std::scoped_lock lock {mutex};
+	EXPECT_EQ(messages.count("fatal"), 1);
+}
+
+TEST(AsyncLogger, fatalAfterQueuedLogs)
+{
+	std::mutex mutex;
+	std::vector<std::string> messages;
+
+	class OrderedLogger : public Logger
+	{
+		public:
+			OrderedLogger(std::mutex& mutex, std::vector<std::string>& messages) : _mutex {mutex}, _messages {messages} {}
+
+			void processLog(const Log& log) override
+			{
+				const std::scoped_lock lock {_mutex};
+				_messages.push_back(log.getMessage());
+			}
+
+		private:
+			std::mutex&					_mutex;
+			std::vector<std::string>&	_messages;
+	};
+
+	AsyncLogger logger {std::make_unique<OrderedLogger>(mutex, messages)};
+	for (std::size_t i {}; i < 100; ++i)
+		log(logger, Severity::INFO, std::to_string(i));
+	log(logger, Severity::FATAL, "fatal");
+
+	const std::scoped_lock lock {mutex};
+	ASSERT_EQ(messages.size(), 101);
+	EXPECT_EQ(messages.front(), "0");
+	EXPECT_EQ(messages.back(), "fatal");
+}
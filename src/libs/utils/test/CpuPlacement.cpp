@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sched.h>
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "utils/CpuPlacement.hpp"
+
+using namespace CpuPlacement;
+
+TEST(CpuPlacement, parseCpuList)
+{
+	EXPECT_EQ(parseCpuList(""), std::vector<unsigned> {});
+	EXPECT_EQ(parseCpuList("3"), std::vector<unsigned> {3});
+	EXPECT_EQ(parseCpuList("0-3"), (std::vector<unsigned> {0, 1, 2, 3}));
+	EXPECT_EQ(parseCpuList(" 6, 0-1 ,1"), (std::vector<unsigned> {0, 1, 6}));
+
+	EXPECT_FALSE(parseCpuList("a"));
+	EXPECT_FALSE(parseCpuList("1-"));
+	EXPECT_FALSE(parseCpuList("3-1"));
+	EXPECT_FALSE(parseCpuList("-1"));
+	EXPECT_FALSE(parseCpuList("0-100000"));
+}
+
+#if defined(__linux__)
+TEST(CpuPlacement, placeCurrentThread)
+{
+	cpu_set_t processCpus;
+	ASSERT_EQ(::sched_getaffinity(0, sizeof(processCpus), &processCpus), 0);
+
+	unsigned firstCpu {};
+	while (!CPU_ISSET(firstCpu, &processCpus))
+		firstCpu++;
+
+	const Placement previousPlacement {getPlacement(Workload::Bulk)};
+	setPlacement(Workload::Bulk, Placement {{firstCpu}, 0, {}});
+
+	int bulkCpuCount {};
+	int backgroundCpuCount {};
+	std::thread thread {[&]
+	{
+		cpu_set_t cpus;
+
+		placeCurrentThread(Workload::Bulk);
+		if (::sched_getaffinity(0, sizeof(cpus), &cpus) == 0)
+			bulkCpuCount = CPU_COUNT(&cpus);
+
+		// not restricted
+		placeCurrentThread(Workload::Background);
+		if (::sched_getaffinity(0, sizeof(cpus), &cpus) == 0)
+			backgroundCpuCount = CPU_COUNT(&cpus);
+	}};
+	thread.join();
+
+	setPlacement(Workload::Bulk, previousPlacement);
+
+	EXPECT_EQ(bulkCpuCount, 1);
+	EXPECT_EQ(backgroundCpuCount, CPU_COUNT(&processCpus));
+}
+
+TEST(CpuPlacement, scopedSpawnPlacement)
+{
+	cpu_set_t processCpus;
+	ASSERT_EQ(::sched_getaffinity(0, sizeof(processCpus), &processCpus), 0);
+
+	unsigned firstCpu {};
+	while (!CPU_ISSET(firstCpu, &processCpus))
+		firstCpu++;
+
+	const Placement previousPlacement {getPlacement(Workload::Transcoder)};
+	setPlacement(Workload::Transcoder, Placement {{firstCpu}, 0, {}});
+
+	int spawnCpuCount {};
+	int restoredCpuCount {};
+	std::thread thread {[&]
+	{
+		cpu_set_t cpus;
+		{
+			const ScopedSpawnPlacement spawnPlacement {Workload::Transcoder};
+			if (::sched_getaffinity(0, sizeof(cpus), &cpus) == 0)
+				spawnCpuCount = CPU_COUNT(&cpus);
+		}
+		if (::sched_getaffinity(0, sizeof(cpus), &cpus) == 0)
+			restoredCpuCount = CPU_COUNT(&cpus);
+	}};
+	thread.join();
+
+	setPlacement(Workload::Transcoder, previousPlacement);
+
+	EXPECT_EQ(spawnCpuCount, 1);
+	EXPECT_EQ(restoredCpuCount, CPU_COUNT(&processCpus));
+}
+#endif
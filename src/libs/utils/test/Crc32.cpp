@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string_view>
+#include <vector>
+
+#include <boost/crc.hpp>
+
+#include "utils/Crc32Calculator.hpp"
+
+namespace
+{
+	std::uint32_t
+	computeCrc32(std::string_view str)
+	{
+		Utils::Crc32Calculator crc;
+		crc.processBytes(reinterpret_cast<const std::byte*>(str.data()), str.size());
+		return crc.getResult();
+	}
+}
+
+TEST(Crc32Calculator, knownValues)
+{
+	EXPECT_EQ(computeCrc32(""), 0);
+	EXPECT_EQ(computeCrc32("a"), 0xE8B7BE43);
+	EXPECT_EQ(computeCrc32("123456789"), 0xCBF43926);
+	EXPECT_EQ(computeCrc32("The quick brown fox jumps over the lazy dog"), 0x414FA339);
+}
+
+TEST(Crc32Calculator, chunks)
+{
+	std::vector<std::byte> data(10'000);
+	for (std::size_t i {}; i < data.size(); ++i)
+		data[i] = static_cast<std::byte>((i * 7919) ^ (i >> 3));
+
+	boost::crc_32_type reference;
+	reference.process_bytes(data.data(), data.size());
+
+	// odd sized, unaligned chunks
+	for (const std::size_t chunkSize : {1, 3, 7, 8, 9, 63, 4096})
+	{
+		Utils::Crc32Calculator crc;
+		for (std::size_t offset {}; offset < data.size(); offset += chunkSize)
+			crc.processBytes(data.data() + offset, std::min(chunkSize, data.size() - offset));
+
+		EXPECT_EQ(crc.getResult(), reference.checksum()) << "chunkSize = " << chunkSize;
+	}
+}
+
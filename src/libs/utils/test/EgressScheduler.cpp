@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "utils/EgressScheduler.hpp"
+
+using namespace EgressScheduler;
+
+namespace
+{
+	class ScopedLimits
+	{
+		public:
+			ScopedLimits(Limits limits) { setLimits(limits); }
+			~ScopedLimits() { setLimits(_previousLimits); }
+
+		private:
+			const Limits _previousLimits {getLimits()};
+	};
+
+	constexpr std::chrono::milliseconds tolerance {100};
+}
+
+TEST(EgressScheduler, unlimited)
+{
+	const ScopedLimits limits {Limits {0, 0}};
+
+	Transfer transfer {TransferInfo {TrafficClass::Bulk, "client"}};
+	EXPECT_EQ(transfer.onDataSent(100'000'000), std::chrono::steady_clock::duration::zero());
+}
+
+TEST(EgressScheduler, rate)
+{
+	const ScopedLimits limits {Limits {0, 1'000'000}};
+
+	Transfer transfer {TransferInfo {TrafficClass::Bulk, "client"}};
+
+	// 1 second burst
+	EXPECT_EQ(transfer.onDataSent(500'000), std::chrono::steady_clock::duration::zero());
+	EXPECT_NEAR(std::chrono::duration_cast<std::chrono::milliseconds>(transfer.onDataSent(1'000'000)).count(), 500, tolerance.count());
+
+	// other class not affected
+	Transfer interactiveTransfer {TransferInfo {TrafficClass::Interactive, "client"}};
+	EXPECT_EQ(interactiveTransfer.onDataSent(100'000'000), std::chrono::steady_clock::duration::zero());
+}
+
+TEST(EgressScheduler, fairness)
+{
+	const ScopedLimits limits {Limits {0, 1'000'000}};
+
+	Transfer transfer1 {TransferInfo {TrafficClass::Bulk, "client1"}};
+	Transfer transfer2 {TransferInfo {TrafficClass::Bulk, "client1"}};
+	Transfer otherTransfer {TransferInfo {TrafficClass::Bulk, "client2"}};
+
+	// transfers of the same client share the same half of the rate
+	EXPECT_EQ(transfer1.onDataSent(500'000), std::chrono::steady_clock::duration::zero());
+	EXPECT_NEAR(std::chrono::duration_cast<std::chrono::milliseconds>(transfer2.onDataSent(500'000)).count(), 1000, tolerance.count());
+
+	EXPECT_EQ(otherTransfer.onDataSent(500'000), std::chrono::steady_clock::duration::zero());
+}
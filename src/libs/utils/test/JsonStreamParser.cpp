@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "utils/JsonStreamParser.hpp"
+
+namespace
+{
+	// Records all the events as strings
+	class TestHandler : public JsonStream::IHandler
+	{
+		public:
+			std::vector<std::string> events;
+			std::optional<std::string> skippedPath;
+
+		private:
+			bool onStartObject(std::string_view path) override
+			{
+				events.push_back("{" + std::string {path});
+				return path != skippedPath;
+			}
+
+			void onEndObject(std::string_view path) override
+			{
+				events.push_back("}" + std::string {path});
+			}
+
+			bool onStartArray(std::string_view path) override
+			{
+				events.push_back("[" + std::string {path});
+				return path != skippedPath;
+			}
+
+			void onEndArray(std::string_view path) override
+			{
+				events.push_back("]" + std::string {path});
+			}
+
+			void onScalar(std::string_view path, JsonStream::ScalarType type, std::string_view value) override
+			{
+				char typeChar {};
+				switch (type)
+				{
+					case JsonStream::ScalarType::String: typeChar = 's'; break;
+					case JsonStream::ScalarType::Number: typeChar = 'n'; break;
+					case JsonStream::ScalarType::Boolean: typeChar = 'b'; break;
+					case JsonStream::ScalarType::Null: typeChar = '0'; break;
+				}
+				events.push_back(std::string {path} + "=" + typeChar + std::string {value});
+			}
+	};
+}
+
+TEST(JsonStream, events)
+{
+	TestHandler handler;
+	ASSERT_TRUE(JsonStream::parse(R"( {"a": {"b": [1, -2.5e3, "x"], "c": true}, "d": null, "e": [{"f": false}] } )", handler));
+
+	const std::vector<std::string> expected {
+		"{", "{a", "[a.b", "a.b=n1", "a.b=n-2.5e3", "a.b=sx", "]a.b", "a.c=btrue", "}a", "d=0null", "[e", "{e", "e.f=bfalse", "}e", "]e", "}",
+	};
+	EXPECT_EQ(handler.events, expected);
+}
+
+TEST(JsonStream, skip)
+{
+	TestHandler handler;
+	handler.skippedPath = "a";
+	ASSERT_TRUE(JsonStream::parse(R"({"a": {"b": [1, {"c": "\"}"}], "c": true}, "d": 1})", handler));
+
+	const std::vector<std::string> expected {"{", "{a", "d=n1", "}"};
+	EXPECT_EQ(handler.events, expected);
+}
+
+TEST(JsonStream, strings)
+{
+	TestHandler handler;
+	ASSERT_TRUE(JsonStream::parse(R"({"k\"ey": "a\\b\n\u00e9\ud83c\udfb5"})", handler));
+
+	ASSERT_EQ(handler.events.size(), 3);
+	EXPECT_EQ(handler.events[1], "k\"ey=sa\\b\n\xC3\xA9\xF0\x9F\x8E\xB5");
+}
+
+TEST(JsonStream, malformed)
+{
+	for (std::string_view document : {"", "{", "{\"a\"}", "{\"a\":1,}", "[1 2]", "[01]", "[1.]", "[tru]", "\"abc", "{} {}", "[\"\\ud800\"]", "-"})
+	{
+		TestHandler handler;
+		EXPECT_FALSE(JsonStream::parse(document, handler)) << "document = '" << document << "'";
+	}
+}
+
+TEST(JsonStream, depth)
+{
+	TestHandler handler;
+	EXPECT_FALSE(JsonStream::parse(std::string(10000, '['), handler));
+}
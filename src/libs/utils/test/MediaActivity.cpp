@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "utils/MediaActivity.hpp"
+
+TEST(MediaActivity, window)
+{
+	MediaActivity::notify();
+
+	EXPECT_TRUE(MediaActivity::isActive(std::chrono::minutes {1}));
+	EXPECT_FALSE(MediaActivity::isActive(std::chrono::steady_clock::duration::zero()));
+}
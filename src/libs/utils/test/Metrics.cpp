@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "utils/Exception.hpp"
+#include "utils/Metrics.hpp"
+
+using namespace std::chrono_literals;
+
+TEST(Metrics, counter)
+{
+	Metrics::Counter counter;
+
+	std::vector<std::thread> threads;
+	for (std::size_t i {}; i < 8; ++i)
+	{
+		threads.emplace_back([&]
+		{
+			for (std::size_t j {}; j < 10000; ++j)
+				counter.add();
+		});
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(counter.get(), 8 * 10000);
+}
+
+TEST(Metrics, histogram)
+{
+	Metrics::Histogram histogram {{1ms, 10ms}};
+
+	histogram.observe(500us);
+	histogram.observe(1ms);
+	histogram.observe(5ms);
+	histogram.observe(1s);
+
+	const Metrics::Histogram::Snapshot snapshot {histogram.get()};
+	ASSERT_EQ(snapshot.cumulativeCounts.size(), 3);
+	EXPECT_EQ(snapshot.cumulativeCounts[0], 2);
+	EXPECT_EQ(snapshot.cumulativeCounts[1], 3);
+	EXPECT_EQ(snapshot.cumulativeCounts[2], 4);
+	EXPECT_EQ(snapshot.count, 4);
+	EXPECT_EQ(snapshot.sum, 500us + 1ms + 5ms + 1s);
+}
+
+TEST(Metrics, registry)
+{
+	Metrics::Registry registry;
+
+	Metrics::Counter& counter1 {registry.createCounter("lms_test_requests", "Test requests", "endpoint=\"ping\"")};
+	Metrics::Counter& counter2 {registry.createCounter("lms_test_requests", "Test requests", "endpoint=\"getAlbum\"")};
+	EXPECT_EQ(&counter1, &registry.createCounter("lms_test_requests", "Test requests", "endpoint=\"ping\""));
+	EXPECT_NE(&counter1, &counter2);
+	EXPECT_THROW(registry.createGauge("lms_test_requests", "Test requests"), LmsException);
+
+	registry.createGauge("lms_test_sessions", "Test sessions").set(3);
+	Metrics::Histogram& histogram {registry.createHistogram("lms_test_duration_seconds", "Test durations", {}, {1ms})};
+	counter1.add(2);
+	histogram.observe(2ms);
+
+	std::ostringstream oss;
+	registry.serialize(oss);
+
+	EXPECT_EQ(oss.str(),
+		"# HELP lms_test_duration_seconds Test durations\n"
+		"# TYPE lms_test_duration_seconds histogram\n"
+		"lms_test_duration_seconds_bucket{le=\"0.001\"} 0\n"
+		"lms_test_duration_seconds_bucket{le=\"+Inf\"} 1\n"
+		"lms_test_duration_seconds_sum 0.002\n"
+		"lms_test_duration_seconds_count 1\n"
+		"# HELP lms_test_requests Test requests\n"
+		"# TYPE lms_test_requests counter\n"
+		"lms_test_requests_total{endpoint=\"ping\"} 2\n"
+		"lms_test_requests_total{endpoint=\"getAlbum\"} 0\n"
+		"# HELP lms_test_sessions Test sessions\n"
+		"# TYPE lms_test_sessions gauge\n"
+		"lms_test_sessions 3\n");
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "utils/ParallelForPool.hpp"
+
+using namespace Utils;
+
+TEST(ParallelForPool, allElementsProcessedOnce)
+{
+	for (const std::size_t threadCount : {1, 2, 4})
+	{
+		ParallelForPool pool {threadCount};
+		EXPECT_EQ(pool.getThreadCount(), threadCount);
+
+		for (const std::size_t count : {0, 1, 7, 1000})
+		{
+			for (const std::size_t chunkSize : {0, 1, 3, 64})
+			{
+				std::vector<std::atomic<unsigned>> processCounts(count);
+				pool.parallelFor(count, [&](std::size_t first, std::size_t last)
+				{
+					ASSERT_LT(first, last);
+					ASSERT_LE(last, count);
+					if (chunkSize)
+					{
+						ASSERT_LE(last - first, chunkSize);
+					}
+
+					for (std::size_t i {first}; i < last; ++i)
+						processCounts[i]++;
+				}, chunkSize);
+
+				for (const std::atomic<unsigned>& processCount : processCounts)
+					EXPECT_EQ(processCount, 1);
+			}
+		}
+	}
+}
+
+TEST(ParallelForPool, workStealing)
+{
+	ParallelForPool pool {4};
+
+	// The first participant's share is slow: its chunks are expected to be stolen
+	std::mutex mutex;
+	std::set<std::thread::id> threadIds;
+	pool.parallelFor(64, [&](std::size_t first, std::size_t)
+	{
+		if (first < 16)
+			std::this_thread::sleep_for(std::chrono::milliseconds {5});
+
+		std::scoped_lock lock {mutex};
+		threadIds.insert(std::this_thread::get_id());
+	}, 1);
+
+	EXPECT_GT(threadIds.size(), 1);
+}
+
+TEST(ParallelForPool, exception)
+{
+	ParallelForPool pool {4};
+
+	EXPECT_THROW(pool.parallelFor(100, [&](std::size_t first, std::size_t)
+	{
+		if (first == 42)
+			throw std::runtime_error {"error"};
+	}, 1), std::runtime_error);
+
+	// still usable
+	std::atomic<std::size_t> total {};
+	pool.parallelFor(100, [&](std::size_t first, std::size_t last) { total += last - first; });
+	EXPECT_EQ(total, 100);
+}
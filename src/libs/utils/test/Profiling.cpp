@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "utils/Profiling.hpp"
+
+using namespace Profiling;
+
+TEST(Profiling, cpuProfile)
+{
+	std::atomic<bool> stop {};
+	std::thread busyThread {[&]
+	{
+		ScopedLabel label {"busy"};
+		ScopedSubLabel subLabel {"loop"};
+
+		while (!stop)
+			;
+	}};
+
+	std::thread unlabelledThread {[&]
+	{
+		// registered, but never labelled during the capture
+		{
+			ScopedLabel label {"done"};
+		}
+		while (!stop)
+			std::this_thread::sleep_for(std::chrono::milliseconds {1});
+	}};
+
+	// let the threads register themselves
+	std::this_thread::sleep_for(std::chrono::milliseconds {20});
+
+	const CpuProfile profile {captureCpuProfile(std::chrono::milliseconds {200}, std::chrono::milliseconds {10})};
+	stop = true;
+	busyThread.join();
+	unlabelledThread.join();
+
+	EXPECT_GE(profile.duration, std::chrono::milliseconds {200});
+	ASSERT_FALSE(profile.entries.empty());
+	EXPECT_EQ(profile.entries.front().label, "busy > loop");
+	EXPECT_GT(profile.entries.front().cpuTime, std::chrono::milliseconds {100});
+	EXPECT_GE(profile.processCpuTime, profile.entries.front().cpuTime);
+	EXPECT_TRUE(std::none_of(std::cbegin(profile.entries), std::cend(profile.entries), [](const CpuProfile::Entry& entry) { return entry.label.find("done") != std::string::npos; }));
+	EXPECT_TRUE(std::is_sorted(std::cbegin(profile.entries), std::cend(profile.entries), [](const CpuProfile::Entry& lhs, const CpuProfile::Entry& rhs) { return lhs.cpuTime > rhs.cpuTime; }));
+}
+
+TEST(Profiling, nestedLabels)
+{
+	// nothing to observe without capture, must just restore the labels properly
+	ScopedLabel label {"outer"};
+	{
+		ScopedSubLabel subLabel {"sub"};
+		ScopedLabel innerLabel {"inner"};
+	}
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "utils/Random.hpp"
+
+TEST(Random, permutation)
+{
+	for (const std::size_t size : {0, 1, 2, 3, 5, 16, 17, 1000, 4097})
+	{
+		const Random::Permutation permutation {size, 42};
+		ASSERT_EQ(permutation.getSize(), size);
+
+		std::vector<std::size_t> values;
+		for (std::size_t i {}; i < size; ++i)
+			values.push_back(permutation[i]);
+
+		std::sort(std::begin(values), std::end(values));
+		std::vector<std::size_t> expected(size);
+		std::iota(std::begin(expected), std::end(expected), 0);
+		EXPECT_EQ(values, expected) << "size = " << size;
+	}
+}
+
+TEST(Random, permutationSeed)
+{
+	constexpr std::size_t size {1000};
+
+	const Random::Permutation permutation1 {size, 1};
+	const Random::Permutation permutation1Bis {size, 1};
+	const Random::Permutation permutation2 {size, 2};
+
+	std::size_t identicalCount {};
+	std::size_t fixedPointCount {};
+	for (std::size_t i {}; i < size; ++i)
+	{
+		EXPECT_EQ(permutation1[i], permutation1Bis[i]);
+		if (permutation1[i] == permutation2[i])
+			identicalCount++;
+		if (permutation1[i] == i)
+			fixedPointCount++;
+	}
+
+	EXPECT_LT(identicalCount, size / 10);
+	EXPECT_LT(fixedPointCount, size / 10);
+}
@@ -56,6 +56,34 @@ TEST(RecursiveSharedMutex, SingleThreaded)
 	}
 }
 
+TEST(RecursiveSharedMutex, SeveralMutexes)
+{
+	RecursiveSharedMutex mutex1;
+	RecursiveSharedMutex mutex2;
+
+	{
+		std::shared_lock lock1 {mutex1};
+		{
+			std::unique_lock lock2 {mutex2};
+			std::shared_lock lock3 {mutex2};
+		}
+
+		// mutex2 must be free for other threads
+		std::thread t {[&]
+		{
+			std::unique_lock lock {mutex2};
+		}};
+		t.join();
+	}
+
+	std::thread t {[&]
+	{
+		std::unique_lock lock1 {mutex1};
+		std::unique_lock lock2 {mutex2};
+	}};
+	t.join();
+}
+
 TEST(RecursiveSharedMutex, MultiThreaded)
 {
 	{
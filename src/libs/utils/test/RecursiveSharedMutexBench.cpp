@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2019 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Measures how shared locks scale with the number of reader threads
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/RecursiveSharedMutex.hpp"
+
+namespace
+{
+	constexpr std::chrono::milliseconds benchDuration {500};
+
+	// returns the number of shared lock/unlock per second performed by all the threads
+	template <typename Mutex>
+	double
+	benchSharedLocks(std::size_t threadCount)
+	{
+		Mutex mutex;
+		std::atomic<bool> start {};
+		std::atomic<bool> stop {};
+		std::atomic<std::size_t> totalCount {};
+
+		std::vector<std::thread> threads;
+		for (std::size_t i {}; i < threadCount; ++i)
+		{
+			threads.emplace_back([&]
+			{
+				while (!start)
+					std::this_thread::yield();
+
+				std::size_t count {};
+				while (!stop)
+				{
+					std::shared_lock lock {mutex};
+					count++;
+				}
+				totalCount += count;
+			});
+		}
+
+		const auto begin {std::chrono::steady_clock::now()};
+		start = true;
+		std::this_thread::sleep_for(benchDuration);
+		stop = true;
+
+		for (std::thread& thread : threads)
+			thread.join();
+
+		const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - begin};
+		return totalCount / elapsed.count();
+	}
+}
+
+int main()
+{
+	std::cout << std::setw(8) << "threads" << std::setw(24) << "shared_mutex (op/s)" << std::setw(32) << "RecursiveSharedMutex (op/s)" << std::endl;
+
+	for (std::size_t threadCount : {1, 4, 16, 64})
+	{
+		std::cout << std::setw(8) << threadCount
+			<< std::setw(24) << std::fixed << std::setprecision(0) << benchSharedLocks<std::shared_mutex>(threadCount)
+			<< std::setw(32) << benchSharedLocks<RecursiveSharedMutex>(threadCount) << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -74,6 +74,29 @@ TEST(StringUtils, splitString)
 		EXPECT_EQ(strings[2], "c");
 		EXPECT_EQ(strings[3], "defgh");
 	}
+
+	{
+		// spans several blocks
+		const std::string test{"first,second||third  fourth_with_a_long_name_\xC3\xA9\xC3\xA8,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,last"};
+
+		const std::vector<std::string_view> strings {StringUtils::splitString(test, " ,|")};
+		ASSERT_EQ(strings.size(), 5);
+		EXPECT_EQ(strings[0], "first");
+		EXPECT_EQ(strings[1], "second");
+		EXPECT_EQ(strings[2], "third");
+		EXPECT_EQ(strings[3], "fourth_with_a_long_name_\xC3\xA9\xC3\xA8");
+		EXPECT_EQ(strings[4], "last");
+	}
+
+	{
+		// more separators than handled by blocks
+		const std::string test{"0123456789abcdefghijklmnopqrstuvwxyz;0123456789abcdefghijklmnopqrstuvwxyz"};
+
+		const std::vector<std::string_view> strings {StringUtils::splitString(test, ";:!?/#%&=+")};
+		ASSERT_EQ(strings.size(), 2);
+		EXPECT_EQ(strings[0], "0123456789abcdefghijklmnopqrstuvwxyz");
+		EXPECT_EQ(strings[1], "0123456789abcdefghijklmnopqrstuvwxyz");
+	}
 }
 
 TEST(StringUtils, escapeString)
@@ -85,5 +108,73 @@ TEST(StringUtils, escapeString)
 	EXPECT_EQ(StringUtils::escapeString("*a*", "*", '_'), "_*a_*");
 	EXPECT_EQ(StringUtils::escapeString("*a|", "*|", '_'), "_*a_|");
 	EXPECT_EQ(StringUtils::escapeString("**||", "*|", '_'), "_*_*_|_|");
+	EXPECT_EQ(StringUtils::escapeString("0123456789abcdefghijklmnopqrstuvwxyz*0123456789abcdefghijklmnopqrstuvwxyz|", "*|", '_'), "0123456789abcdefghijklmnopqrstuvwxyz_*0123456789abcdefghijklmnopqrstuvwxyz_|");
+}
+
+TEST(StringUtils, jsEscape)
+{
+	EXPECT_EQ(StringUtils::jsEscape(""), "");
+	EXPECT_EQ(StringUtils::jsEscape("abc"), "abc");
+	EXPECT_EQ(StringUtils::jsEscape("a\"b'c\\d"), "a\\\"b\\'c\\\\d");
+	EXPECT_EQ(StringUtils::jsEscape("0123456789abcdefghijklmnopqrstuvwxyz\n0123456789abcdefghijklmnopqrstuvwxyz\t"), "0123456789abcdefghijklmnopqrstuvwxyz\\n0123456789abcdefghijklmnopqrstuvwxyz\\t");
 }
 
+TEST(StringUtils, stringToLower)
+{
+	EXPECT_EQ(StringUtils::stringToLower(""), "");
+	EXPECT_EQ(StringUtils::stringToLower("AbC@[`{"), "abc@[`{");
+	EXPECT_EQ(StringUtils::stringToLower("THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG \xC3\x89T\xC3\x89"), "the quick brown fox jumps over the lazy dog \xC3\x89t\xC3\x89");
+
+	std::string str {"ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789abcdefghijklmnopqrstuvwxyz"};
+	StringUtils::stringToLower(str);
+	EXPECT_EQ(str, "abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz");
+}
+
+
+TEST(StringUtils, stringEndsWith)
+{
+	EXPECT_TRUE(StringUtils::stringEndsWith("getIndexes.view", ".view"));
+	EXPECT_TRUE(StringUtils::stringEndsWith(".view", ".view"));
+	EXPECT_TRUE(StringUtils::stringEndsWith("getIndexes", ""));
+	EXPECT_FALSE(StringUtils::stringEndsWith("getIndexes", ".view"));
+	EXPECT_FALSE(StringUtils::stringEndsWith("view", ".view"));
+	EXPECT_FALSE(StringUtils::stringEndsWith("", ".view"));
+}
+
+TEST(StringUtils, readAs)
+{
+	EXPECT_EQ(StringUtils::readAs<int>("42"), 42);
+	EXPECT_EQ(StringUtils::readAs<int>(" -42"), -42);
+	EXPECT_EQ(StringUtils::readAs<int>("+42"), 42);
+	EXPECT_EQ(StringUtils::readAs<std::size_t>("12/14"), 12);
+	EXPECT_EQ(StringUtils::readAs<long long>("9223372036854775807"), 9223372036854775807LL);
+	EXPECT_FALSE(StringUtils::readAs<int>(""));
+	EXPECT_FALSE(StringUtils::readAs<int>("  "));
+	EXPECT_FALSE(StringUtils::readAs<int>("a12"));
+	EXPECT_FALSE(StringUtils::readAs<unsigned>("4294967296"));
+	EXPECT_EQ(StringUtils::readAs<float>("-1.5"), -1.5f);
+}
+
+TEST(StringUtils, computeSortKey)
+{
+	EXPECT_EQ(StringUtils::computeSortKey(""), "");
+	EXPECT_EQ(StringUtils::computeSortKey("ABC"), "abc");
+	EXPECT_EQ(StringUtils::computeSortKey("The Beatles"), "beatles");
+	EXPECT_EQ(StringUtils::computeSortKey("the"), "the");
+	EXPECT_EQ(StringUtils::computeSortKey("Theatre of Tragedy"), "theatre of tragedy");
+	EXPECT_EQ(StringUtils::computeSortKey("L'Affaire Louis' Trio"), "affaire louis' trio");
+	EXPECT_EQ(StringUtils::computeSortKey("...And Justice for All"), "and justice for all");
+	EXPECT_EQ(StringUtils::computeSortKey("\"Heroes\""), "heroes\"");
+	EXPECT_EQ(StringUtils::computeSortKey("!!!"), "!!!");
+	EXPECT_EQ(StringUtils::computeSortKey("Éléonore"), "eleonore");
+	EXPECT_EQ(StringUtils::computeSortKey("Motörhead"), "motorhead");
+	EXPECT_EQ(StringUtils::computeSortKey("Sigur Rós"), "sigur ros");
+	EXPECT_EQ(StringUtils::computeSortKey("Straße"), "strasse");
+	EXPECT_EQ(StringUtils::computeSortKey("Łódź"), "lodz");
+	EXPECT_EQ(StringUtils::computeSortKey("Œuvre"), "oeuvre");
+	EXPECT_EQ(StringUtils::computeSortKey("東京事変"), "東京事変");
+	EXPECT_EQ(StringUtils::computeSortKey("×"), "×");
+
+	EXPECT_LT(StringUtils::computeSortKey("Émilie Simon"), StringUtils::computeSortKey("Florent Marchet"));
+	EXPECT_LT(StringUtils::computeSortKey("abba"), StringUtils::computeSortKey("The Beatles"));
+}
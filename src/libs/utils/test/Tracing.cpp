@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <optional>
+#include <sstream>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "utils/Tracing.hpp"
+
+using namespace Tracing;
+
+namespace
+{
+	const Settings alwaysReportedSettings {std::chrono::milliseconds {1}, 100};
+}
+
+TEST(Tracing, spans)
+{
+	std::optional<Trace> reportedTrace;
+	{
+		ScopedTrace trace {"request", alwaysReportedSettings, [&](const Trace& trace) { reportedTrace.emplace(trace); }};
+		{
+			ScopedSpan span {"outer"};
+			{
+				ScopedSpan span {"inner"};
+				std::this_thread::sleep_for(std::chrono::milliseconds {2});
+			}
+		}
+		ScopedSpan span {"last"};
+	}
+
+	ASSERT_TRUE(reportedTrace);
+	EXPECT_EQ(reportedTrace->getName(), "request");
+	EXPECT_GE(reportedTrace->getDuration(), std::chrono::milliseconds {2});
+
+	const std::vector<Trace::Span>& spans {reportedTrace->getSpans()};
+	ASSERT_EQ(spans.size(), 3);
+	EXPECT_STREQ(spans[0].name, "outer");
+	EXPECT_EQ(spans[0].depth, 0);
+	EXPECT_STREQ(spans[1].name, "inner");
+	EXPECT_EQ(spans[1].depth, 1);
+	EXPECT_GE(spans[0].duration, spans[1].duration);
+	EXPECT_STREQ(spans[2].name, "last");
+	EXPECT_EQ(spans[2].depth, 0);
+	EXPECT_GE(spans[2].start, spans[0].start + spans[0].duration);
+
+	std::ostringstream oss;
+	oss << *reportedTrace;
+	EXPECT_NE(oss.str().find("'request'"), std::string::npos);
+	EXPECT_NE(oss.str().find(">> inner"), std::string::npos);
+}
+
+TEST(Tracing, notReported)
+{
+	bool reported {};
+	{
+		ScopedTrace trace {"fast", Settings {std::chrono::milliseconds {10'000}, 100}, [&](const Trace&) { reported = true; }};
+		ScopedSpan span {"span"};
+	}
+	EXPECT_FALSE(reported);
+
+	{
+		ScopedTrace trace {"disabled", Settings {}, [&](const Trace&) { reported = true; }};
+		std::this_thread::sleep_for(std::chrono::milliseconds {2});
+	}
+	EXPECT_FALSE(reported);
+
+	{
+		ScopedTrace trace {"notSampled", Settings {std::chrono::milliseconds {1}, 0}, [&](const Trace&) { reported = true; }};
+		std::this_thread::sleep_for(std::chrono::milliseconds {2});
+	}
+	EXPECT_FALSE(reported);
+}
+
+TEST(Tracing, noTrace)
+{
+	// must not crash
+	ScopedSpan span {"span"};
+}
+
+TEST(Tracing, otherThread)
+{
+	std::optional<Trace> reportedTrace;
+	{
+		ScopedTrace trace {"request", alwaysReportedSettings, [&](const Trace& trace) { reportedTrace.emplace(trace); }};
+		std::thread {[] { ScopedSpan span {"otherThread"}; }}.join();
+		std::this_thread::sleep_for(std::chrono::milliseconds {2});
+	}
+
+	ASSERT_TRUE(reportedTrace);
+	EXPECT_TRUE(reportedTrace->getSpans().empty());
+}
+
+TEST(Tracing, maxSpans)
+{
+	std::optional<Trace> reportedTrace;
+	{
+		ScopedTrace trace {"request", alwaysReportedSettings, [&](const Trace& trace) { reportedTrace.emplace(trace); }};
+		for (std::size_t i {}; i < 1000; ++i)
+			ScopedSpan span {"span"};
+		std::this_thread::sleep_for(std::chrono::milliseconds {2});
+	}
+
+	ASSERT_TRUE(reportedTrace);
+	EXPECT_EQ(reportedTrace->getSpans().size() + reportedTrace->getDroppedSpanCount(), 1000);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include "utils/UUID.hpp"
+
+TEST(UUID, fromString)
+{
+	{
+		const std::optional<UUID> uuid {UUID::fromString("2b8d4c2e-6c57-4dc3-93a3-64d3cc5fb3ea")};
+		ASSERT_TRUE(uuid);
+		EXPECT_EQ(uuid->getAsString(), "2b8d4c2e-6c57-4dc3-93a3-64d3cc5fb3ea");
+		EXPECT_EQ(uuid->getBytes()[0], 0x2b);
+		EXPECT_EQ(uuid->getBytes()[15], 0xea);
+	}
+
+	{
+		// stored in lower case
+		const std::optional<UUID> uuid {UUID::fromString("2B8D4C2E-6C57-4DC3-93A3-64D3CC5FB3EA")};
+		ASSERT_TRUE(uuid);
+		EXPECT_EQ(uuid->getAsString(), "2b8d4c2e-6c57-4dc3-93a3-64d3cc5fb3ea");
+		EXPECT_EQ(*uuid, *UUID::fromString("2b8d4c2e-6c57-4dc3-93a3-64d3cc5fb3ea"));
+	}
+}
+
+TEST(UUID, fromBadString)
+{
+	EXPECT_FALSE(UUID::fromString(""));
+	EXPECT_FALSE(UUID::fromString("2b8d4c2e-6c57-4dc3-93a3-64d3cc5fb3e"));
+	EXPECT_FALSE(UUID::fromString("2b8d4c2e-6c57-4dc3-93a3-64d3cc5fb3eaa"));
+	EXPECT_FALSE(UUID::fromString("2b8d4c2e6c57-4dc3-93a3-64d3cc5fb3eaa"));
+	EXPECT_FALSE(UUID::fromString("2b8d4c2e-6c57-4dc3-93a3-64d3cc5fb3eg"));
+	EXPECT_FALSE(UUID::fromString("-b8d4c2e-6c57-4dc3-93a3-64d3cc5fb3ea"));
+	EXPECT_FALSE(UUID::fromString(" 2b8d4c2e-6c57-4dc3-93a3-64d3cc5fb3e"));
+
+	// misplaced dashes
+	EXPECT_FALSE(UUID::fromString("01-34-67-9abc-def0-1234-56789abcdef0"));
+	EXPECT_FALSE(UUID::fromString("2b8d4c2e6-c57-4dc3-93a3-64d3cc5fb3ea"));
+	EXPECT_FALSE(UUID::fromString("2b8d4c2e-6c57-4dc3-93a364d3-cc5fb3ea"));
+
+	// extra dashes
+	EXPECT_FALSE(UUID::fromString("2b8d4c2e-6c57-4dc3-93a3-64d3cc5fb3-a"));
+	EXPECT_FALSE(UUID::fromString("2b8d4c2e--6c57-4dc3-93a3-64d3cc5fb3e"));
+	EXPECT_FALSE(UUID::fromString("------------------------------------"));
+
+	// short inputs
+	EXPECT_FALSE(UUID::fromString("2b8d4c2e"));
+	EXPECT_FALSE(UUID::fromString("2b8d4c2e-6c57-4dc3-93a3"));
+	EXPECT_FALSE(UUID::fromString("2b8d4c2e-6c57-4dc3-93a3-"));
+}
+
+TEST(UUID, comparison)
+{
+	const std::optional<UUID> uuid1 {UUID::fromString("2b8d4c2e-6c57-4dc3-93a3-64d3cc5fb3ea")};
+	const std::optional<UUID> uuid2 {UUID::fromString("2b8d4c2e-6c57-4dc3-93a3-64d3cc5fb3eb")};
+	ASSERT_TRUE(uuid1);
+	ASSERT_TRUE(uuid2);
+
+	EXPECT_NE(*uuid1, *uuid2);
+	EXPECT_EQ(*uuid1, *uuid1);
+}
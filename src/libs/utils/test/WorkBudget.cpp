@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "utils/WorkBudget.hpp"
+
+using namespace WorkBudget;
+
+namespace
+{
+	// runs threadCount threads holding a slot for a while, returns the max concurrent slot count
+	std::size_t
+	getMaxConcurrency(WorkClass workClass, std::size_t threadCount)
+	{
+		std::atomic<std::size_t> current {};
+		std::atomic<std::size_t> max {};
+
+		std::vector<std::thread> threads;
+		for (std::size_t i {}; i < threadCount; ++i)
+		{
+			threads.emplace_back([&]
+			{
+				ScopedSlot slot {workClass};
+
+				const std::size_t value {++current};
+				std::size_t maxValue {max.load()};
+				while (value > maxValue && !max.compare_exchange_weak(maxValue, value))
+					;
+
+				std::this_thread::sleep_for(std::chrono::milliseconds {5});
+				--current;
+			});
+		}
+
+		for (std::thread& thread : threads)
+			thread.join();
+
+		return max;
+	}
+
+	class ScopedLimits
+	{
+		public:
+			ScopedLimits(Limits limits) { setLimits(limits); }
+			~ScopedLimits() { setLimits(_previousLimits); }
+
+		private:
+			const Limits _previousLimits {getLimits()};
+	};
+}
+
+TEST(WorkBudget, limits)
+{
+	const ScopedLimits limits {Limits {3, 2}};
+
+	EXPECT_LE(getMaxConcurrency(WorkClass::Background, 10), 3);
+	EXPECT_LE(getMaxConcurrency(WorkClass::Bulk, 10), 2);
+}
+
+TEST(WorkBudget, sanitizedLimits)
+{
+	const ScopedLimits limits {Limits {0, 5}};
+
+	EXPECT_EQ(getLimits().slotCount, 1);
+	EXPECT_EQ(getLimits().bulkSlotCount, 1);
+}
+
+TEST(WorkBudget, nested)
+{
+	const ScopedLimits limits {Limits {1, 1}};
+
+	// must not dead lock
+	ScopedSlot slot {WorkClass::Background};
+	ScopedSlot nestedSlot {WorkClass::Bulk};
+}
+
+TEST(WorkBudget, backgroundPriority)
+{
+	const ScopedLimits limits {Limits {1, 1}};
+
+	std::atomic<bool> backgroundDone {};
+	std::atomic<bool> bulkDoneBeforeBackground {};
+
+	std::thread bulkThread;
+	std::thread backgroundThread;
+	{
+		ScopedSlot slot {WorkClass::Background};
+
+		backgroundThread = std::thread {[&]
+		{
+			ScopedSlot slot {WorkClass::Background};
+			backgroundDone = true;
+		}};
+		// make sure the background work waits first
+		std::this_thread::sleep_for(std::chrono::milliseconds {20});
+
+		bulkThread = std::thread {[&]
+		{
+			ScopedSlot slot {WorkClass::Bulk};
+			bulkDoneBeforeBackground = !backgroundDone;
+		}};
+		std::this_thread::sleep_for(std::chrono::milliseconds {20});
+	}
+
+	backgroundThread.join();
+	bulkThread.join();
+
+	EXPECT_TRUE(backgroundDone);
+	EXPECT_FALSE(bulkDoneBeforeBackground);
+}
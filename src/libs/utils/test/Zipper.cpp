@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "utils/Path.hpp"
+#include "utils/Zipper.hpp"
+
+namespace
+{
+	// Removed on destruction
+	class TemporaryFile
+	{
+		public:
+			TemporaryFile(const std::string& name, std::size_t size)
+			: _path {std::filesystem::temp_directory_path() / ("lms-test-zipper-" + std::to_string(::getpid()) + "-" + name)}
+			{
+				std::ofstream ofs {_path, std::ios_base::binary};
+				for (std::size_t i {}; i < size; ++i)
+					ofs.put(static_cast<char>((i * 7919) ^ (i >> 3)));
+			}
+
+			~TemporaryFile()
+			{
+				std::error_code ec;
+				std::filesystem::remove(_path, ec);
+			}
+
+			TemporaryFile(const TemporaryFile&) = delete;
+			TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+			const std::filesystem::path& getPath() const { return _path; }
+
+		private:
+			const std::filesystem::path _path;
+	};
+
+	std::vector<std::byte>
+	readFile(const std::filesystem::path& path, Zip::SizeType offset, Zip::SizeType size)
+	{
+		std::vector<std::byte> res(size);
+
+		std::ifstream ifs {path, std::ios_base::binary};
+		ifs.seekg(offset);
+		ifs.read(reinterpret_cast<char*>(res.data()), size);
+
+		return res;
+	}
+
+	std::vector<std::byte>
+	writeZip(Zip::Zipper& zipper, std::size_t bufferSize)
+	{
+		std::vector<std::byte> res;
+		std::vector<std::byte> buffer(bufferSize);
+
+		while (!zipper.isComplete())
+		{
+			if (const std::optional<Zip::Zipper::FileDataExtent> extent {zipper.takeFileDataExtent()})
+			{
+				const std::vector<std::byte> data {readFile(extent->filePath, extent->offset, extent->size)};
+				res.insert(std::end(res), std::cbegin(data), std::cend(data));
+				continue;
+			}
+
+			const Zip::SizeType nbWrittenBytes {zipper.writeSome(buffer.data(), buffer.size())};
+			res.insert(std::end(res), std::cbegin(buffer), std::cbegin(buffer) + nbWrittenBytes);
+		}
+
+		return res;
+	}
+}
+
+TEST(Zipper, fileDataExtents)
+{
+	const TemporaryFile file1 {"1", 100'000};
+	const TemporaryFile file2 {"2", 0};
+	const TemporaryFile file3 {"3", 1'000};
+	const std::map<std::string, std::filesystem::path> files {{"a/1", file1.getPath()}, {"a/2", file2.getPath()}, {"b/3", file3.getPath()}};
+	const Wt::WDateTime lastModifiedTime {Wt::WDate {2020, 1, 1}};
+
+	Zip::Zipper reference {files, lastModifiedTime};
+	const std::vector<std::byte> referenceZip {writeZip(reference, 4096)};
+	ASSERT_EQ(referenceZip.size(), reference.getTotalZipFile());
+
+	for (const std::size_t bufferSize : {Zip::Zipper::minOutputBufferSize, std::size_t {100}, std::size_t {65536}})
+	{
+		Zip::Zipper zipper {files, lastModifiedTime};
+		zipper.enableFileDataExtents();
+
+		EXPECT_EQ(writeZip(zipper, bufferSize), referenceZip) << "bufferSize = " << bufferSize;
+	}
+}
+
+TEST(Zipper, precomputedCrc32)
+{
+	const TemporaryFile file1 {"1", 10'000};
+	const TemporaryFile file2 {"2", 20'000};
+	const std::map<std::string, std::filesystem::path> files {{"1", file1.getPath()}, {"2", file2.getPath()}};
+	const Wt::WDateTime lastModifiedTime {Wt::WDate {2020, 1, 1}};
+
+	Zip::Zipper reference {files, lastModifiedTime};
+	const std::vector<std::byte> referenceZip {writeZip(reference, 4096)};
+
+	{
+		Zip::Zipper zipper {files, lastModifiedTime};
+		zipper.setCrc32("1", computeCrc32(file1.getPath()));
+		zipper.setCrc32("2", computeCrc32(file2.getPath()));
+		zipper.enableFileDataExtents();
+
+		EXPECT_EQ(writeZip(zipper, 4096), referenceZip);
+	}
+
+	{
+		// the given checksum is trusted
+		Zip::Zipper zipper {files, lastModifiedTime};
+		zipper.setCrc32("1", computeCrc32(file1.getPath()) + 1);
+
+		EXPECT_NE(writeZip(zipper, 4096), referenceZip);
+	}
+
+	{
+		Zip::Zipper zipper {files, lastModifiedTime};
+		EXPECT_THROW(zipper.setCrc32("3", 0), Zip::ZipperException);
+	}
+}
+
+TEST(Zipper, entityTag)
+{
+	const TemporaryFile file1 {"1", 10'000};
+	const TemporaryFile file2 {"2", 20'000};
+	const std::map<std::string, std::filesystem::path> files {{"1", file1.getPath()}, {"2", file2.getPath()}};
+	const Wt::WDateTime lastModifiedTime {Wt::WDate {2020, 1, 1}};
+
+	const std::string entityTag {Zip::Zipper {files, lastModifiedTime}.computeEntityTag()};
+	EXPECT_EQ(entityTag.front(), '"');
+	EXPECT_EQ(entityTag.back(), '"');
+	EXPECT_EQ(Zip::Zipper(files, lastModifiedTime).computeEntityTag(), entityTag);
+
+	EXPECT_NE(Zip::Zipper(files, Wt::WDateTime {Wt::WDate {2020, 1, 2}}).computeEntityTag(), entityTag);
+	EXPECT_NE(Zip::Zipper({{"1", file1.getPath()}, {"3", file2.getPath()}}, lastModifiedTime).computeEntityTag(), entityTag);
+	EXPECT_NE(Zip::Zipper({{"1", file1.getPath()}}, lastModifiedTime).computeEntityTag(), entityTag);
+}
@@ -17,34 +17,63 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <thread>
 
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 
 #include <Wt/WServer.h>
 #include <Wt/WApplication.h>
+#include <Wt/WDate.h>
+#include <Wt/WDateTime.h>
 
+#include "av/TranscodeProfiles.hpp"
+#include "av/TranscodeResourceHandlerCreator.hpp"
 #include "image/IRawImage.hpp"
 #include "services/auth/IAuthTokenService.hpp"
 #include "services/auth/IPasswordService.hpp"
 #include "services/auth/IEnvService.hpp"
 #include "services/cover/ICoverService.hpp"
 #include "services/database/Db.hpp"
+#include "services/database/Listen.hpp"
 #include "services/database/Session.hpp"
 #include "services/recommendation/IRecommendationService.hpp"
 #include "services/scanner/IScannerService.hpp"
 #include "services/scrobbling/IScrobblingService.hpp"
 #include "subsonic/SubsonicResource.hpp"
+#include "ui/LibrarySnapshot.hpp"
 #include "ui/LmsApplication.hpp"
 #include "ui/LmsApplicationManager.hpp"
+#include "utils/AsyncFileReader.hpp"
+#include "utils/AsyncLogger.hpp"
+#include "utils/CpuPlacement.hpp"
+#include "utils/EgressScheduler.hpp"
+#include "utils/HealthResource.hpp"
 #include "utils/IChildProcessManager.hpp"
 #include "utils/IConfig.hpp"
 #include "utils/IOContextRunner.hpp"
+#include "utils/MetricsResource.hpp"
 #include "utils/Service.hpp"
 #include "utils/String.hpp"
+#include "utils/WorkBudget.hpp"
 #include "utils/WtLogger.hpp"
 
+static
+std::unique_ptr<Logger>
+createLogger()
+{
+	std::unique_ptr<Logger> logger {std::make_unique<WtLogger>()};
+	if (Service<IConfig>::get()->getBool("log-async", false))
+		logger = std::make_unique<AsyncLogger>(std::move(logger));
+
+	return logger;
+}
+
 static
 std::size_t
 getThreadCount()
@@ -55,6 +84,282 @@ getThreadCount()
 	return configHttpServerThreadCount ? configHttpServerThreadCount : std::max<unsigned long>(2, std::thread::hardware_concurrency());
 }
 
+static
+WorkBudget::Limits
+getWorkBudgetLimits()
+{
+	WorkBudget::Limits limits {WorkBudget::getDefaultLimits()};
+
+	if (const unsigned long configSlotCount {Service<IConfig>::get()->getULong("background-work-thread-count", 0)})
+	{
+		limits.slotCount = configSlotCount;
+		limits.bulkSlotCount = std::max<std::size_t>(configSlotCount / 2, 1);
+	}
+	if (const unsigned long configBulkSlotCount {Service<IConfig>::get()->getULong("bulk-work-thread-count", 0)})
+		limits.bulkSlotCount = configBulkSlotCount;
+
+	return limits;
+}
+
+static
+CpuPlacement::Placement
+getCpuPlacement(const std::string& configPrefix)
+{
+	CpuPlacement::Placement placement;
+
+	const std::string cpuList {Service<IConfig>::get()->getString(configPrefix + "-cpus")};
+	const std::optional<std::vector<unsigned>> cpus {CpuPlacement::parseCpuList(cpuList)};
+	if (!cpus)
+		throw LmsException {"Bad value '" + cpuList + "' for '" + configPrefix + "-cpus'"};
+
+	placement.cpus = *cpus;
+	placement.niceIncrement = Service<IConfig>::get()->getULong(configPrefix + "-nice", 0);
+
+	return placement;
+}
+
+static
+void
+setCpuPlacements()
+{
+	auto setPlacement {[](CpuPlacement::Workload workload, const std::string& configPrefix)
+	{
+		CpuPlacement::Placement placement {getCpuPlacement(configPrefix)};
+		// cgroups only apply to processes
+		if (workload == CpuPlacement::Workload::Transcoder)
+			placement.cgroup = Service<IConfig>::get()->getPath("transcoder-cgroup");
+
+		CpuPlacement::setPlacement(workload, placement);
+
+		LMS_LOG(MAIN, INFO) << "CPU placement for " << configPrefix << ": cpus = '" << Service<IConfig>::get()->getString(configPrefix + "-cpus") << "', nice increment = " << placement.niceIncrement << ", cgroup = '" << placement.cgroup.string() << "'";
+	}};
+
+	setPlacement(CpuPlacement::Workload::Background, "background-work");
+	setPlacement(CpuPlacement::Workload::Bulk, "bulk-work");
+	setPlacement(CpuPlacement::Workload::Transcoder, "transcoder");
+}
+
+static
+EgressScheduler::Limits
+getEgressLimits()
+{
+	// KBytes per second
+	return EgressScheduler::Limits {Service<IConfig>::get()->getULong("egress-interactive-rate", 0) * 1000,
+									Service<IConfig>::get()->getULong("egress-bulk-rate", 0) * 1000};
+}
+
+static
+AsyncFileReader::Engine
+getFileReadEngine()
+{
+	const std::string engine {Service<IConfig>::get()->getString("file-read-engine", "sync")};
+
+	if (engine == "sync")
+		return AsyncFileReader::Engine::Sync;
+	if (engine == "io-uring")
+		return AsyncFileReader::Engine::IoUring;
+
+	throw LmsException {"Bad value '" + engine + "' for 'file-read-engine'"};
+}
+
+static
+void
+addHealthComponents(HealthResource& resource, Database::Db& database, const std::atomic<bool>& dbOptimized, const std::atomic<bool>& librarySnapshotBuilt, const Scanner::IScannerService& scanner, const Recommendation::IRecommendationService& recommendationService)
+{
+	resource.addComponent("database", [&]
+	{
+		if (!database.isReachable())
+			return HealthResource::ComponentStatus {false, "unreachable"};
+		if (!dbOptimized)
+			return HealthResource::ComponentStatus {false, "optimizing"};
+
+		return HealthResource::ComponentStatus {true, ""};
+	}, true);
+
+	resource.addComponent("library", [&]
+	{
+		return HealthResource::ComponentStatus {librarySnapshotBuilt.load(), ""};
+	}, false);
+
+	const bool scanningIsNotReady {Service<IConfig>::get()->getBool("health-not-ready-during-scan", false)};
+	resource.addComponent("scanner", [&]
+	{
+		const Scanner::IScannerService::Status status {scanner.getStatus()};
+		switch (status.currentState)
+		{
+			case Scanner::IScannerService::State::NotScheduled:
+				return HealthResource::ComponentStatus {true, "not scheduled"};
+			case Scanner::IScannerService::State::Scheduled:
+				return HealthResource::ComponentStatus {true, "scheduled"};
+			case Scanner::IScannerService::State::InProgress:
+				break;
+		}
+
+		std::string details {"in progress"};
+		if (status.currentScanStepStats)
+			details += ", step " + std::to_string(static_cast<unsigned>(status.currentScanStepStats->currentStep) + 1) + "/" + std::to_string(Scanner::ScanProgressStepCount) + ", " + std::to_string(status.currentScanStepStats->progress()) + "%";
+
+		return HealthResource::ComponentStatus {false, details};
+	}, scanningIsNotReady);
+
+	resource.addComponent("recommendation", [&]
+	{
+		const bool loaded {recommendationService.isLoaded()};
+		return HealthResource::ComponentStatus {loaded, loaded ? "" : "loading"};
+	}, false);
+
+	resource.addComponent("transcoder", []
+	{
+		const Av::TranscodeLoad load {Av::getTranscodeLoad()};
+		return HealthResource::ComponentStatus {true, std::to_string(load.runningCount) + " running, " + std::to_string(load.queuedCount) + " queued"};
+	}, false);
+}
+
+static
+Database::Db::ConcurrencyMode
+getDbConcurrencyMode()
+{
+	const std::string mode {StringUtils::stringToLower(Service<IConfig>::get()->getString("db-concurrency-mode", "application-lock"))};
+
+	if (mode == "application-lock")
+		return Database::Db::ConcurrencyMode::ApplicationLock;
+	if (mode == "sqlite")
+		return Database::Db::ConcurrencyMode::SQLite;
+
+	throw LmsException {"Bad value '" + mode + "' for 'db-concurrency-mode'"};
+}
+
+static
+bool
+isReplicaInstance()
+{
+	const std::string role {StringUtils::stringToLower(Service<IConfig>::get()->getString("instance-role", "primary"))};
+
+	if (role == "primary")
+		return false;
+	if (role == "replica")
+		return true;
+
+	throw LmsException {"Bad value '" + role + "' for 'instance-role'"};
+}
+
+static
+std::size_t
+getDbConnectionCount()
+{
+	const unsigned long configConnectionCount {Service<IConfig>::get()->getULong("db-connection-count", 0)};
+
+	// Each http server thread, Subsonic worker thread and password check thread may need its own connection
+	return configConnectionCount ? configConnectionCount : getThreadCount()
+		+ Service<IConfig>::get()->getULong("api-subsonic-worker-thread-count", 0)
+		+ Service<IConfig>::get()->getULong("login-check-thread-count", 2);
+}
+
+static
+Database::ConnectionSettings
+getDbConnectionSettings()
+{
+	const IConfig& config {*Service<IConfig>::get()};
+
+	Database::ConnectionSettings settings;
+	if (const unsigned long cacheSize {config.getULong("db-cache-size", 0)})
+		settings.cacheSize = -static_cast<long long>(cacheSize); // negative means KiB
+	if (const unsigned long mmapSize {config.getULong("db-mmap-size", 0)})
+		settings.mmapSize = mmapSize * 1024 * 1024;
+	settings.tempStoreMemory = config.getBool("db-temp-store-memory", false);
+	if (const unsigned long walAutoCheckpoint {config.getULong("db-wal-autocheckpoint", 0)})
+		settings.walAutoCheckpoint = walAutoCheckpoint;
+	settings.collectStats = config.getBool("db-stats", false);
+	if (const unsigned long maxCachedStatementCount {config.getULong("db-max-cached-statements", 500)})
+		settings.maxCachedStatementCount = maxCachedStatementCount;
+
+	return settings;
+}
+
+static
+std::filesystem::path
+getDbBackupPath()
+{
+	return Service<IConfig>::get()->getPath("db-backup-file", Service<IConfig>::get()->getPath("working-dir") / "lms.db.backup");
+}
+
+static
+void
+compactListens(Database::Db& database, unsigned long retentionMonths)
+{
+	// Only compact whole months
+	const Wt::WDate currentDate {Wt::WDateTime::currentDateTime().date()};
+	const Wt::WDateTime compactBefore {Wt::WDate {currentDate.year(), currentDate.month(), 1}.addMonths(-static_cast<int>(retentionMonths))};
+
+	Database::Session& session {database.getTLSSession()};
+	auto transaction {session.createUniqueTransaction()};
+
+	if (const std::size_t count {Database::Listen::compact(session, compactBefore)}; count > 0)
+		LMS_LOG(MAIN, INFO) << "Compacted " << count << " listens older than " << compactBefore.toString();
+}
+
+static
+void
+scheduleDbMaintenance(boost::asio::steady_timer& timer, std::chrono::minutes period, unsigned long listenRetentionMonths, Database::Db& database)
+{
+	timer.expires_after(period);
+	timer.async_wait([&timer, period, listenRetentionMonths, &database](const boost::system::error_code& ec)
+	{
+		if (ec)
+			return;
+
+		try
+		{
+			if (listenRetentionMonths > 0)
+				compactListens(database, listenRetentionMonths);
+
+			database.performMaintenance();
+			database.logStats();
+		}
+		catch (const std::exception& e)
+		{
+			LMS_LOG(MAIN, ERROR) << "Db maintenance failed: " << e.what();
+		}
+
+		scheduleDbMaintenance(timer, period, listenRetentionMonths, database);
+	});
+}
+
+static
+void
+scheduleDbBackup(boost::asio::steady_timer& timer, std::chrono::hours period, const std::filesystem::path& backupPath, Database::Db& database)
+{
+	timer.expires_after(period);
+	timer.async_wait([&timer, period, backupPath, &database](const boost::system::error_code& ec)
+	{
+		if (ec)
+			return;
+
+		// Performed on a dedicated thread
+		if (!database.startBackup(backupPath))
+			LMS_LOG(MAIN, WARNING) << "Db backup skipped: previous backup still in progress";
+
+		scheduleDbBackup(timer, period, backupPath, database);
+	});
+}
+
+static
+void
+scheduleIdleApplicationTrim(boost::asio::steady_timer& timer, std::chrono::minutes idleDuration, UserInterface::LmsApplicationManager& appManager)
+{
+	// no need to be accurate
+	timer.expires_after(std::max(idleDuration / 4, std::chrono::minutes {1}));
+	timer.async_wait([&timer, idleDuration, &appManager](const boost::system::error_code& ec)
+	{
+		if (ec)
+			return;
+
+		appManager.trimIdleApplications(idleDuration);
+
+		scheduleIdleApplicationTrim(timer, idleDuration, appManager);
+	});
+}
+
 static
 std::vector<std::string>
 generateWtConfig(std::string execPath)
@@ -132,7 +437,7 @@ generateWtConfig(std::string execPath)
 
 static
 void
-proxyScannerEventsToApplication(Scanner::IScannerService& scanner, Wt::WServer& server)
+proxyScannerEventsToApplication(Scanner::IScannerService& scanner, Wt::WServer& server, UserInterface::LmsApplicationManager& appManager)
 {
 	auto postAll {[](Wt::WServer& server, std::function<void()> cb)
 	{
@@ -164,11 +469,7 @@ proxyScannerEventsToApplication(Scanner::IScannerService& scanner, Wt::WServer&
 
 	scanner.getEvents().scanInProgress.connect([&] (const Scanner::ScanStepStats& stats)
 	{
-		postAll(server, [=]
-		{
-			LmsApp->getScannerEvents().scanInProgress.emit(stats);
-			LmsApp->triggerUpdate();
-		});
+		appManager.publishScanInProgress(stats);
 	});
 
 	scanner.getEvents().scanScheduled.connect([&] (const Wt::WDateTime dateTime)
@@ -204,7 +505,7 @@ int main(int argc, char* argv[])
 		close(STDIN_FILENO);
 
 		Service<IConfig> config {createConfig(configFilePath)};
-		Service<Logger> logger {std::make_unique<WtLogger>()};
+		Service<Logger> logger {createLogger()};
 
 		// Make sure the working directory exists
 		std::filesystem::create_directories(config->getPath("working-dir"));
@@ -226,15 +527,49 @@ int main(int argc, char* argv[])
 
 		IOContextRunner ioContextRunner {ioContext, getThreadCount()};
 
+		WorkBudget::setLimits(getWorkBudgetLimits());
+		LMS_LOG(MAIN, INFO) << "Background work threads = " << WorkBudget::getLimits().slotCount << ", bulk work threads = " << WorkBudget::getLimits().bulkSlotCount;
+		setCpuPlacements();
+
+		EgressScheduler::setLimits(getEgressLimits());
+		LMS_LOG(MAIN, INFO) << "Egress rates: interactive = " << EgressScheduler::getLimits().interactiveRate << " B/s, bulk = " << EgressScheduler::getLimits().bulkRate << " B/s";
+
+		AsyncFileReader::setEngine(getFileReadEngine(), config->getULong("file-read-queue-depth", 64));
+
+		Av::initTranscodeProfiles();
+
+		// Replicas share the database of the primary instance, that owns the schema, the maintenance and the scans
+		const bool replicaInstance {isReplicaInstance()};
+		LMS_LOG(MAIN, INFO) << "Instance role = " << (replicaInstance ? "replica" : "primary");
+
 		// Initializing a connection pool to the database that will be shared along services
-		Database::Db database {config->getPath("working-dir") / "lms.db", getThreadCount()};
+		Database::Db database {config->getPath("db-file", config->getPath("working-dir") / "lms.db"), getDbConnectionCount(), getDbConcurrencyMode(), getDbConnectionSettings()};
 		{
 			Database::Session session {database};
-			session.prepareTables();
-			session.optimize();
+			if (replicaInstance)
+				session.checkTables();
+			else
+				session.prepareTables();
+		}
+
+		boost::asio::steady_timer dbMaintenanceTimer {ioContext};
+		if (const std::chrono::minutes dbMaintenancePeriod {static_cast<std::chrono::minutes::rep>(config->getULong("db-maintenance-period", 60))}; dbMaintenancePeriod.count() > 0 && !replicaInstance)
+			scheduleDbMaintenance(dbMaintenanceTimer, dbMaintenancePeriod, config->getULong("listen-retention-months", 0), database);
+
+		boost::asio::steady_timer dbBackupTimer {ioContext};
+		if (const std::chrono::hours dbBackupPeriod {static_cast<std::chrono::hours::rep>(config->getULong("db-backup-period", 0))}; dbBackupPeriod.count() > 0 && !replicaInstance)
+		{
+			if (database.isSQLiteApiUsable())
+				scheduleDbBackup(dbBackupTimer, dbBackupPeriod, getDbBackupPath(), database);
+			else
+				LMS_LOG(MAIN, WARNING) << "Db backups not supported, ignoring 'db-backup-period'";
 		}
 
-		UserInterface::LmsApplicationManager appManager;
+		UserInterface::LmsApplicationManager appManager {database};
+
+		boost::asio::steady_timer idleApplicationTrimTimer {ioContext};
+		if (const std::chrono::minutes idleApplicationTrimDelay {static_cast<std::chrono::minutes::rep>(config->getULong("ui-idle-session-trim-delay", 30))}; idleApplicationTrimDelay.count() > 0)
+			scheduleIdleApplicationTrim(idleApplicationTrimTimer, idleApplicationTrimDelay, appManager);
 
 		// Service initialization order is important (reverse-order for deinit)
 		Service<IChildProcessManager> childProcessManagerService {createChildProcessManager(ioContext)};
@@ -245,7 +580,7 @@ int main(int argc, char* argv[])
 		const std::string authenticationBackend {StringUtils::stringToLower(config->getString("authentication-backend", "internal"))};
 		if (authenticationBackend == "internal" || authenticationBackend == "pam")
 		{
-			authTokenService.assign(Auth::createAuthTokenService(database, config->getULong("login-throttler-max-entriees", 10000)));
+			authTokenService.assign(Auth::createAuthTokenService(ioContext, database, config->getULong("login-throttler-max-entriees", 10000)));
 			authPasswordService.assign(Auth::createPasswordService(authenticationBackend, database, config->getULong("login-throttler-max-entriees", 10000), *authTokenService.get()));
 		}
 		else if (authenticationBackend == "http-headers")
@@ -258,7 +593,9 @@ int main(int argc, char* argv[])
 		Image::init(argv[0]);
 		Service<Cover::ICoverService> coverService {Cover::createCoverService(database, argv[0], server.appRoot() + "/images/unknown-cover.jpg")};
 		Service<Recommendation::IRecommendationService> recommendationService {Recommendation::createRecommendationService(database)};
-		Service<Scanner::IScannerService> scannerService {Scanner::createScannerService(database, *recommendationService)};
+		Service<Scanner::IScannerService> scannerService {replicaInstance
+			? Scanner::createReplicaScannerService(database, *recommendationService, std::chrono::seconds {config->getULong("replica-poll-period", 30)})
+			: Scanner::createScannerService(database, *recommendationService)};
 
 		scannerService->getEvents().scanComplete.connect([&]
 		{
@@ -266,6 +603,22 @@ int main(int argc, char* argv[])
 			// covers may be external files that changed and we don't keep track of them
 			coverService->flushCache();
 		});
+		if (replicaInstance)
+		{
+			// Replicas never complete scans
+			scannerService->getEvents().libraryChanged.connect([&]
+			{
+				coverService->flushCache();
+			});
+		}
+
+		// Library lists are served from this snapshot, shared by all the sessions (built once the server is started)
+		std::atomic<bool> librarySnapshotBuilt {};
+		scannerService->getEvents().libraryChanged.connect([&]
+		{
+			appManager.setLibrarySnapshot(UserInterface::LibrarySnapshot::build(database.getTLSSession()));
+			librarySnapshotBuilt = true;
+		});
 
 		Service<Scrobbling::IScrobblingService> scrobblingService {Scrobbling::createScrobblingService(ioContext, database)};
 
@@ -278,6 +631,25 @@ int main(int argc, char* argv[])
 			server.addResource(subsonicResource.get(), "rest/");
 		}
 
+		std::unique_ptr<Wt::WResource> metricsResource;
+		if (config->getBool("metrics-enable", false))
+		{
+			metricsResource = std::make_unique<Metrics::MetricsResource>();
+			server.addResource(metricsResource.get(), "metrics");
+		}
+
+		std::atomic<bool> dbOptimized {};
+		// No session, no database lock: cheap enough to be probed frequently
+		HealthResource healthResource {HealthResource::Type::Health};
+		addHealthComponents(healthResource, database, dbOptimized, librarySnapshotBuilt, *scannerService, *recommendationService);
+		server.addResource(&healthResource, "health");
+		HealthResource readinessResource {HealthResource::Type::Readiness};
+		addHealthComponents(readinessResource, database, dbOptimized, librarySnapshotBuilt, *scannerService, *recommendationService);
+		server.addResource(&readinessResource, "ready");
+
+		// UI templates and messages are shared by all the sessions
+		server.setLocalizedStrings(UserInterface::LmsApplication::createSharedLocalizedStrings(server.appRoot()));
+
 		// bind UI entry point
 		server.addEntryPoint(Wt::EntryPointType::Application,
 			[&](const Wt::WEnvironment &env)
@@ -285,16 +657,42 @@ int main(int argc, char* argv[])
 				return UserInterface::LmsApplication::create(env, database, appManager);
 			});
 
-		proxyScannerEventsToApplication(*scannerService, server);
+		proxyScannerEventsToApplication(*scannerService, server, appManager);
 
 		LMS_LOG(MAIN, INFO) << "Starting server...";
 		server.start();
 
+		// The costly startup work is done once the server is reachable: meanwhile, the lists are directly served from the database
+		// Similarity engines are loaded by the scanner, using the clusters engine while the features one is loading
+		std::future<void> startupTasks {std::async(std::launch::async, [&]
+		{
+			try
+			{
+				if (!replicaInstance)
+				{
+					Database::Session session {database};
+					session.optimize();
+				}
+				dbOptimized = true;
+
+				std::shared_ptr<const UserInterface::LibrarySnapshot> librarySnapshot {UserInterface::LibrarySnapshot::build(database.getTLSSession())};
+				if (!librarySnapshotBuilt.exchange(true))
+					appManager.setLibrarySnapshot(std::move(librarySnapshot));
+			}
+			catch (const std::exception& e)
+			{
+				LMS_LOG(MAIN, ERROR) << "Startup tasks failed: " << e.what();
+			}
+		})};
+
 		LMS_LOG(MAIN, INFO) << "Now running...";
 		Wt::WServer::waitForShutdown();
 
 		LMS_LOG(MAIN, INFO) << "Stopping server...";
 		server.stop();
+		startupTasks.wait();
+		dbMaintenanceTimer.cancel();
+		idleApplicationTrimTimer.cancel();
 
 		LMS_LOG(MAIN, INFO) << "Quitting...";
 		res = EXIT_SUCCESS;
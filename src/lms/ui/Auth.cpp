@@ -145,6 +145,9 @@ class AuthModel : public Wt::WFormModel
 					case ::Auth::IPasswordService::CheckResult::State::Throttled:
 						error = Wt::WString::tr("Lms.password-client-throttled");
 						break;
+					case ::Auth::IPasswordService::CheckResult::State::Busy:
+						error = Wt::WString::tr("Lms.password-server-busy");
+						break;
 				}
 			}
 			else
@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LibrarySnapshot.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <tuple>
+
+#include "services/database/Artist.hpp"
+#include "services/database/Release.hpp"
+#include "services/database/Session.hpp"
+#include "services/database/Track.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Random.hpp"
+
+namespace UserInterface
+{
+	using namespace Database;
+
+	namespace
+	{
+		template <typename IdType>
+		std::size_t
+		getIndex(const std::vector<IdType>& sortedIds, IdType id)
+		{
+			auto it {std::lower_bound(std::cbegin(sortedIds), std::cend(sortedIds), id)};
+			assert(it != std::cend(sortedIds) && *it == id);
+
+			return std::distance(std::cbegin(sortedIds), it);
+		}
+
+		// ids may contain objects that are not in sortedIds, if created in the meantime
+		template <typename IdType>
+		std::vector<std::size_t>
+		getIndexes(const std::vector<IdType>& sortedIds, const std::vector<IdType>& ids)
+		{
+			std::vector<std::size_t> res;
+			res.reserve(ids.size());
+
+			for (const IdType id : ids)
+			{
+				auto it {std::lower_bound(std::cbegin(sortedIds), std::cend(sortedIds), id)};
+				if (it != std::cend(sortedIds) && *it == id)
+					res.push_back(std::distance(std::cbegin(sortedIds), it));
+			}
+
+			return res;
+		}
+
+		// orderedIndexes: natural order if not set
+		template <typename IdType, typename Filter>
+		RangeResults<IdType>
+		getRange(const std::vector<IdType>& ids, const std::vector<std::size_t>* orderedIndexes, const Filter& filter, Range range)
+		{
+			RangeResults<IdType> res;
+			res.range.offset = range.offset;
+			res.moreResults = false;
+
+			std::size_t matchCount {};
+			const std::size_t count {orderedIndexes ? orderedIndexes->size() : ids.size()};
+			for (std::size_t i {}; i < count; ++i)
+			{
+				const std::size_t index {orderedIndexes ? (*orderedIndexes)[i] : i};
+				if (filter && !filter->test(index))
+					continue;
+
+				if (matchCount++ < range.offset)
+					continue;
+
+				if (range.size && res.results.size() == range.size)
+				{
+					res.moreResults = true;
+					break;
+				}
+
+				res.results.push_back(ids[index]);
+			}
+
+			res.range.size = res.results.size();
+			return res;
+		}
+
+		template <typename IdType, typename Filter>
+		RangeResults<IdType>
+		getRandomRange(const std::vector<IdType>& ids, const Filter& filter, std::size_t count)
+		{
+			RangeResults<IdType> res;
+			res.moreResults = false;
+
+			for (std::size_t index {}; index < ids.size(); ++index)
+			{
+				if (!filter || filter->test(index))
+					res.results.push_back(ids[index]);
+			}
+
+			Random::shuffleContainer(res.results);
+			if (res.results.size() > count)
+				res.results.resize(count);
+
+			res.range.size = res.results.size();
+			return res;
+		}
+	}
+
+	LibrarySnapshot::Bitmap&
+	LibrarySnapshot::Bitmap::operator&=(const Bitmap& other)
+	{
+		assert(_words.size() == other._words.size());
+
+		for (std::size_t i {}; i < _words.size(); ++i)
+			_words[i] &= other._words[i];
+
+		return *this;
+	}
+
+	std::shared_ptr<const LibrarySnapshot>
+	LibrarySnapshot::build(Session& session)
+	{
+		const auto start {std::chrono::steady_clock::now()};
+
+		std::shared_ptr<LibrarySnapshot> snapshot {new LibrarySnapshot};
+
+		auto transaction {session.createSharedTransaction()};
+
+		// Orderings are computed using the same queries as the collectors
+		{
+			Artist::FindParameters params;
+			params.setSortMethod(ArtistSortMethod::BySortName);
+			const std::vector<ArtistId> artistIds {Artist::find(session, params).results};
+
+			snapshot->_artistIds = artistIds;
+			std::sort(std::begin(snapshot->_artistIds), std::end(snapshot->_artistIds));
+			snapshot->_artistsBySortName = getIndexes(snapshot->_artistIds, artistIds);
+		}
+
+		{
+			Release::FindParameters params;
+			params.setSortMethod(ReleaseSortMethod::Name);
+			const std::vector<ReleaseId> releaseIds {Release::find(session, params).results};
+
+			snapshot->_releaseIds = releaseIds;
+			std::sort(std::begin(snapshot->_releaseIds), std::end(snapshot->_releaseIds));
+			snapshot->_releasesByName = getIndexes(snapshot->_releaseIds, releaseIds);
+
+			params.setSortMethod(ReleaseSortMethod::AddedDesc);
+			snapshot->_releasesByAdded = getIndexes(snapshot->_releaseIds, Release::find(session, params).results);
+		}
+
+		{
+			snapshot->_trackIds = Track::find(session, Track::FindParameters {}).results;
+			std::sort(std::begin(snapshot->_trackIds), std::end(snapshot->_trackIds));
+		}
+
+		const std::size_t trackCount {snapshot->_trackIds.size()};
+
+		snapshot->_trackReleases.resize(trackCount, noIndex);
+		Track::visitReleaseLinks(session, [&](TrackId trackId, ReleaseId releaseId)
+		{
+			snapshot->_trackReleases[getIndex(snapshot->_trackIds, trackId)] = getIndex(snapshot->_releaseIds, releaseId);
+		});
+
+		{
+			std::vector<std::tuple<std::size_t, std::size_t, TrackArtistLinkType>> links;
+			Track::visitArtistLinks(session, [&](TrackId trackId, ArtistId artistId, TrackArtistLinkType linkType)
+			{
+				links.emplace_back(getIndex(snapshot->_trackIds, trackId), getIndex(snapshot->_artistIds, artistId), linkType);
+			});
+			std::sort(std::begin(links), std::end(links), [](const auto& a, const auto& b) { return std::get<0>(a) < std::get<0>(b); });
+
+			snapshot->_trackArtistOffsets.resize(trackCount + 1);
+			snapshot->_trackArtists.reserve(links.size());
+			std::size_t trackIndex {};
+			for (const auto& [linkTrackIndex, artistIndex, linkType] : links)
+			{
+				while (trackIndex <= linkTrackIndex)
+					snapshot->_trackArtistOffsets[trackIndex++] = snapshot->_trackArtists.size();
+
+				snapshot->_trackArtists.push_back(artistIndex);
+
+				auto itBitmap {snapshot->_artistsByLinkType.find(linkType)};
+				if (itBitmap == std::end(snapshot->_artistsByLinkType))
+					itBitmap = snapshot->_artistsByLinkType.emplace(linkType, Bitmap {snapshot->_artistIds.size()}).first;
+				itBitmap->second.set(artistIndex);
+			}
+			while (trackIndex <= trackCount)
+				snapshot->_trackArtistOffsets[trackIndex++] = snapshot->_trackArtists.size();
+		}
+
+		Track::visitClusterLinks(session, [&](TrackId trackId, ClusterId clusterId)
+		{
+			auto itBitmap {snapshot->_clusterTracks.find(clusterId)};
+			if (itBitmap == std::end(snapshot->_clusterTracks))
+				itBitmap = snapshot->_clusterTracks.emplace(clusterId, Bitmap {trackCount}).first;
+
+			itBitmap->second.set(getIndex(snapshot->_trackIds, trackId));
+		});
+
+		LMS_LOG(UI, INFO) << "Library snapshot built in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms ("
+			<< snapshot->_artistIds.size() << " artists, " << snapshot->_releaseIds.size() << " releases, " << trackCount << " tracks)";
+
+		return snapshot;
+	}
+
+	LibrarySnapshot::Bitmap
+	LibrarySnapshot::getTracksInClusters(const std::vector<ClusterId>& clusterIds) const
+	{
+		assert(!clusterIds.empty());
+
+		Bitmap res {_trackIds.size()};
+		for (std::size_t i {}; i < clusterIds.size(); ++i)
+		{
+			auto itBitmap {_clusterTracks.find(clusterIds[i])};
+			if (itBitmap == std::cend(_clusterTracks))
+				return Bitmap {_trackIds.size()}; // unknown or empty cluster
+
+			if (i == 0)
+				res = itBitmap->second;
+			else
+				res &= itBitmap->second;
+		}
+
+		return res;
+	}
+
+	std::optional<LibrarySnapshot::Bitmap>
+	LibrarySnapshot::getArtistFilter(const std::vector<ClusterId>& clusterIds, std::optional<TrackArtistLinkType> linkType) const
+	{
+		std::optional<Bitmap> res;
+
+		if (linkType)
+		{
+			auto itBitmap {_artistsByLinkType.find(*linkType)};
+			res = itBitmap != std::cend(_artistsByLinkType) ? itBitmap->second : Bitmap {_artistIds.size()};
+		}
+
+		if (!clusterIds.empty())
+		{
+			// artists linked to at least one track that belongs to all the clusters, whatever the link type is
+			Bitmap artists {_artistIds.size()};
+			getTracksInClusters(clusterIds).visit([&](std::size_t trackIndex)
+			{
+				for (std::size_t i {_trackArtistOffsets[trackIndex]}; i < _trackArtistOffsets[trackIndex + 1]; ++i)
+					artists.set(_trackArtists[i]);
+			});
+
+			if (res)
+				*res &= artists;
+			else
+				res = std::move(artists);
+		}
+
+		return res;
+	}
+
+	std::optional<LibrarySnapshot::Bitmap>
+	LibrarySnapshot::getReleaseFilter(const std::vector<ClusterId>& clusterIds) const
+	{
+		if (clusterIds.empty())
+			return std::nullopt;
+
+		// releases having at least one track that belongs to all the clusters
+		Bitmap releases {_releaseIds.size()};
+		getTracksInClusters(clusterIds).visit([&](std::size_t trackIndex)
+		{
+			if (_trackReleases[trackIndex] != noIndex)
+				releases.set(_trackReleases[trackIndex]);
+		});
+
+		return releases;
+	}
+
+	std::optional<LibrarySnapshot::Bitmap>
+	LibrarySnapshot::getTrackFilter(const std::vector<ClusterId>& clusterIds) const
+	{
+		if (clusterIds.empty())
+			return std::nullopt;
+
+		return getTracksInClusters(clusterIds);
+	}
+
+	RangeResults<ArtistId>
+	LibrarySnapshot::getArtists(const std::vector<ClusterId>& clusterIds, std::optional<TrackArtistLinkType> linkType, Range range) const
+	{
+		return getRange(_artistIds, &_artistsBySortName, getArtistFilter(clusterIds, linkType), range);
+	}
+
+	RangeResults<ArtistId>
+	LibrarySnapshot::getRandomArtists(const std::vector<ClusterId>& clusterIds, std::optional<TrackArtistLinkType> linkType, std::size_t count) const
+	{
+		return getRandomRange(_artistIds, getArtistFilter(clusterIds, linkType), count);
+	}
+
+	RangeResults<ReleaseId>
+	LibrarySnapshot::getReleases(const std::vector<ClusterId>& clusterIds, ReleaseSortMethod sortMethod, Range range) const
+	{
+		assert(sortMethod == ReleaseSortMethod::Name || sortMethod == ReleaseSortMethod::AddedDesc);
+
+		return getRange(_releaseIds, sortMethod == ReleaseSortMethod::Name ? &_releasesByName : &_releasesByAdded, getReleaseFilter(clusterIds), range);
+	}
+
+	RangeResults<ReleaseId>
+	LibrarySnapshot::getRandomReleases(const std::vector<ClusterId>& clusterIds, std::size_t count) const
+	{
+		return getRandomRange(_releaseIds, getReleaseFilter(clusterIds), count);
+	}
+
+	RangeResults<TrackId>
+	LibrarySnapshot::getTracks(const std::vector<ClusterId>& clusterIds, Range range) const
+	{
+		return getRange(_trackIds, nullptr, getTrackFilter(clusterIds), range);
+	}
+
+	RangeResults<TrackId>
+	LibrarySnapshot::getRandomTracks(const std::vector<ClusterId>& clusterIds, std::size_t count) const
+	{
+		return getRandomRange(_trackIds, getTrackFilter(clusterIds), count);
+	}
+} // namespace UserInterface
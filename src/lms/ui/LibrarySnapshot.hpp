@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "services/database/ArtistId.hpp"
+#include "services/database/ClusterId.hpp"
+#include "services/database/ReleaseId.hpp"
+#include "services/database/TrackId.hpp"
+#include "services/database/Types.hpp"
+
+namespace Database
+{
+	class Session;
+}
+
+namespace UserInterface
+{
+	// Immutable in-memory view of the library, shared by all the sessions and rebuilt after each scan
+	// Used to serve the artist, release and track lists without querying the database
+	// Results are ordered as the corresponding database queries, cluster filters have the same meaning
+	class LibrarySnapshot
+	{
+		public:
+			static std::shared_ptr<const LibrarySnapshot> build(Database::Session& session);
+
+			// sorted by sort name
+			Database::RangeResults<Database::ArtistId>	getArtists(const std::vector<Database::ClusterId>& clusterIds, std::optional<Database::TrackArtistLinkType> linkType, Database::Range range) const;
+			Database::RangeResults<Database::ArtistId>	getRandomArtists(const std::vector<Database::ClusterId>& clusterIds, std::optional<Database::TrackArtistLinkType> linkType, std::size_t count) const;
+
+			// sortMethod must be Name or AddedDesc
+			Database::RangeResults<Database::ReleaseId>	getReleases(const std::vector<Database::ClusterId>& clusterIds, Database::ReleaseSortMethod sortMethod, Database::Range range) const;
+			Database::RangeResults<Database::ReleaseId>	getRandomReleases(const std::vector<Database::ClusterId>& clusterIds, std::size_t count) const;
+
+			// sorted by id
+			Database::RangeResults<Database::TrackId>	getTracks(const std::vector<Database::ClusterId>& clusterIds, Database::Range range) const;
+			Database::RangeResults<Database::TrackId>	getRandomTracks(const std::vector<Database::ClusterId>& clusterIds, std::size_t count) const;
+
+		private:
+			LibrarySnapshot() = default;
+
+			class Bitmap
+			{
+				public:
+					Bitmap() = default;
+					explicit Bitmap(std::size_t size) : _words((size + 63) / 64) {}
+
+					void set(std::size_t index) { _words[index / 64] |= std::uint64_t {1} << (index % 64); }
+					bool test(std::size_t index) const { return _words[index / 64] & (std::uint64_t {1} << (index % 64)); }
+					Bitmap& operator&=(const Bitmap& other);
+
+					template <typename Func>
+					void visit(Func&& func) const
+					{
+						for (std::size_t word {}; word < _words.size(); ++word)
+						{
+							if (!_words[word])
+								continue;
+
+							for (std::size_t bit {}; bit < 64; ++bit)
+							{
+								if (_words[word] & (std::uint64_t {1} << bit))
+									func(word * 64 + bit);
+							}
+						}
+					}
+
+				private:
+					std::vector<std::uint64_t> _words;
+			};
+
+			// tracks that belong to all the given clusters
+			Bitmap getTracksInClusters(const std::vector<Database::ClusterId>& clusterIds) const;
+			std::optional<Bitmap> getArtistFilter(const std::vector<Database::ClusterId>& clusterIds, std::optional<Database::TrackArtistLinkType> linkType) const;
+			std::optional<Bitmap> getReleaseFilter(const std::vector<Database::ClusterId>& clusterIds) const;
+			std::optional<Bitmap> getTrackFilter(const std::vector<Database::ClusterId>& clusterIds) const;
+
+			static constexpr std::size_t noIndex {static_cast<std::size_t>(-1)};
+
+			// objects are referred by their index in the id vectors (sorted)
+			std::vector<Database::ArtistId>		_artistIds;
+			std::vector<Database::ReleaseId>	_releaseIds;
+			std::vector<Database::TrackId>		_trackIds;
+
+			std::vector<std::size_t>			_artistsBySortName;
+			std::vector<std::size_t>			_releasesByName;
+			std::vector<std::size_t>			_releasesByAdded;
+
+			std::vector<std::size_t>			_trackReleases;			// release by track, noIndex if none
+			std::vector<std::size_t>			_trackArtistOffsets;	// artists of track t are in _trackArtists[_trackArtistOffsets[t], _trackArtistOffsets[t + 1])
+			std::vector<std::size_t>			_trackArtists;
+			std::unordered_map<Database::TrackArtistLinkType, Bitmap>	_artistsByLinkType;
+			std::unordered_map<Database::ClusterId, Bitmap>				_clusterTracks;
+	};
+} // namespace UserInterface
@@ -19,9 +19,12 @@
 
 #include "LmsApplication.hpp"
 
+#include <filesystem>
+
 #include <Wt/WAnchor.h>
 #include <Wt/WEnvironment.h>
 #include <Wt/WLineEdit.h>
+#include <Wt/WMessageResourceBundle.h>
 #include <Wt/WPopupMenu.h>
 #include <Wt/WPushButton.h>
 #include <Wt/WServer.h>
@@ -64,6 +67,21 @@ namespace UserInterface {
 
 static constexpr const char* defaultPath {"/releases"};
 
+std::shared_ptr<Wt::WLocalizedStrings>
+LmsApplication::createSharedLocalizedStrings(const std::string& appRoot)
+{
+	auto bundle {std::make_shared<Wt::WMessageResourceBundle>()};
+
+	for (std::string_view name : {"admin-database", "admin-initwizard", "admin-scannercontroller", "admin-user", "admin-users",
+			"artist", "artists", "error", "explore", "login", "mediaplayer", "messages", "playqueue",
+			"release", "releases", "search", "settings", "templates", "tracks"})
+	{
+		bundle->use((std::filesystem::path {appRoot} / name).string());
+	}
+
+	return bundle;
+}
+
 std::unique_ptr<Wt::WApplication>
 LmsApplication::create(const Wt::WEnvironment& env, Database::Db& db, LmsApplicationManager& appManager)
 {
@@ -89,6 +107,12 @@ LmsApplication::instance()
 	return reinterpret_cast<LmsApplication*>(Wt::WApplication::instance());
 }
 
+std::shared_ptr<const LibrarySnapshot>
+LmsApplication::getLibrarySnapshot() const
+{
+	return _appManager.getLibrarySnapshot();
+}
+
 Database::Session&
 LmsApplication::getDbSession()
 {
@@ -164,27 +188,6 @@ LmsApplication::init()
 {
 	useStyleSheet("resources/font-awesome/css/font-awesome.min.css");
 
-	// Add a resource bundle
-	messageResourceBundle().use(appRoot() + "admin-database");
-	messageResourceBundle().use(appRoot() + "admin-initwizard");
-	messageResourceBundle().use(appRoot() + "admin-scannercontroller");
-	messageResourceBundle().use(appRoot() + "admin-user");
-	messageResourceBundle().use(appRoot() + "admin-users");
-	messageResourceBundle().use(appRoot() + "artist");
-	messageResourceBundle().use(appRoot() + "artists");
-	messageResourceBundle().use(appRoot() + "error");
-	messageResourceBundle().use(appRoot() + "explore");
-	messageResourceBundle().use(appRoot() + "login");
-	messageResourceBundle().use(appRoot() + "mediaplayer");
-	messageResourceBundle().use(appRoot() + "messages");
-	messageResourceBundle().use(appRoot() + "playqueue");
-	messageResourceBundle().use(appRoot() + "release");
-	messageResourceBundle().use(appRoot() + "releases");
-	messageResourceBundle().use(appRoot() + "search");
-	messageResourceBundle().use(appRoot() + "settings");
-	messageResourceBundle().use(appRoot() + "templates");
-	messageResourceBundle().use(appRoot() + "tracks");
-
 	// Require js here to avoid async problems
 	requireJQuery("js/jquery-1.10.2.min.js");
 	require("js/bootstrap-notify.js");
@@ -269,22 +272,34 @@ LmsApplication::finalize()
 Wt::WLink
 LmsApplication::createArtistLink(Database::Artist::pointer artist)
 {
-	if (const auto mbid {artist->getMBID()})
-		return Wt::WLink {Wt::LinkType::InternalPath, "/artist/mbid/" + std::string {mbid->getAsString()}};
+	return createArtistLink(artist->getId(), artist->getMBID());
+}
+
+Wt::WLink
+LmsApplication::createArtistLink(Database::ArtistId artistId, const std::optional<UUID>& MBID)
+{
+	if (MBID)
+		return Wt::WLink {Wt::LinkType::InternalPath, "/artist/mbid/" + std::string {MBID->getAsString()}};
 	else
-		return Wt::WLink {Wt::LinkType::InternalPath, "/artist/" + artist->getId().toString()};
+		return Wt::WLink {Wt::LinkType::InternalPath, "/artist/" + artistId.toString()};
 }
 
 std::unique_ptr<Wt::WAnchor>
 LmsApplication::createArtistAnchor(Database::Artist::pointer artist, bool addText)
 {
-	auto res = std::make_unique<Wt::WAnchor>(createArtistLink(artist));
+	return createArtistAnchor(artist->getId(), artist->getName(), artist->getMBID(), addText);
+}
+
+std::unique_ptr<Wt::WAnchor>
+LmsApplication::createArtistAnchor(Database::ArtistId artistId, std::string_view name, const std::optional<UUID>& MBID, bool addText)
+{
+	auto res = std::make_unique<Wt::WAnchor>(createArtistLink(artistId, MBID));
 
 	if (addText)
 	{
 		res->setTextFormat(Wt::TextFormat::Plain);
-		res->setText(Wt::WString::fromUTF8(artist->getName()));
-		res->setToolTip(Wt::WString::fromUTF8(artist->getName()), Wt::TextFormat::Plain);
+		res->setText(Wt::WString::fromUTF8(std::string {name}));
+		res->setToolTip(Wt::WString::fromUTF8(std::string {name}), Wt::TextFormat::Plain);
 	}
 
 	return res;
@@ -293,23 +308,35 @@ LmsApplication::createArtistAnchor(Database::Artist::pointer artist, bool addTex
 Wt::WLink
 LmsApplication::createReleaseLink(Database::Release::pointer release)
 {
-	if (const auto mbid {release->getMBID()})
-		return Wt::WLink {Wt::LinkType::InternalPath, "/release/mbid/" + std::string {mbid->getAsString()}};
+	return createReleaseLink(release->getId(), release->getMBID());
+}
+
+Wt::WLink
+LmsApplication::createReleaseLink(Database::ReleaseId releaseId, const std::optional<UUID>& MBID)
+{
+	if (MBID)
+		return Wt::WLink {Wt::LinkType::InternalPath, "/release/mbid/" + std::string {MBID->getAsString()}};
 	else
-		return Wt::WLink {Wt::LinkType::InternalPath, "/release/" + release->getId().toString()};
+		return Wt::WLink {Wt::LinkType::InternalPath, "/release/" + releaseId.toString()};
 }
 
 std::unique_ptr<Wt::WAnchor>
 LmsApplication::createReleaseAnchor(Database::Release::pointer release, bool addText)
 {
-	auto res = std::make_unique<Wt::WAnchor>(createReleaseLink(release));
+	return createReleaseAnchor(release->getId(), release->getName(), release->getMBID(), addText);
+}
+
+std::unique_ptr<Wt::WAnchor>
+LmsApplication::createReleaseAnchor(Database::ReleaseId releaseId, std::string_view name, const std::optional<UUID>& MBID, bool addText)
+{
+	auto res = std::make_unique<Wt::WAnchor>(createReleaseLink(releaseId, MBID));
 
 	if (addText)
 	{
 		res->setWordWrap(false);
 		res->setTextFormat(Wt::TextFormat::Plain);
-		res->setText(Wt::WString::fromUTF8(release->getName()));
-		res->setToolTip(Wt::WString::fromUTF8(release->getName()), Wt::TextFormat::Plain);
+		res->setText(Wt::WString::fromUTF8(std::string {name}));
+		res->setToolTip(Wt::WString::fromUTF8(std::string {name}), Wt::TextFormat::Plain);
 	}
 
 	return res;
@@ -573,6 +600,11 @@ LmsApplication::createHome()
 		_mediaPlayer->stop();
 	});
 
+	_playQueue->upcomingTracksSelected.connect([this] (const std::vector<Database::TrackId>& trackIds)
+	{
+		_mediaPlayer->setUpcomingTracks(trackIds);
+	});
+
 	const bool isAdmin {getUserType() == Database::UserType::ADMIN};
 	if (isAdmin)
 	{
@@ -599,6 +631,13 @@ LmsApplication::createHome()
 void
 LmsApplication::notify(const Wt::WEvent& event)
 {
+	// posted functions and timers do not count as activity
+	if (event.eventType() == Wt::EventType::User)
+	{
+		_lastUserActivity = std::chrono::steady_clock::now();
+		_trimmed = false;
+	}
+
 	try
 	{
 		WApplication::notify(event);
@@ -627,6 +666,24 @@ static std::string msgTypeToString(LmsApplication::MsgType type)
 	return "";
 }
 
+void
+LmsApplication::trim()
+{
+	if (_trimmed)
+		return;
+
+	LMS_LOG(UI, DEBUG) << "Trimming session, displayed entries = " << _displayedEntryCount;
+
+	_trimmed = true;
+	_trimRequested.emit();
+}
+
+void
+LmsApplication::setScanInProgressListened(bool listened)
+{
+	_appManager.setScanInProgressListened(*this, listened);
+}
+
 void
 LmsApplication::post(std::function<void()> func)
 {
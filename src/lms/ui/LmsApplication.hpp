@@ -19,14 +19,22 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <optional>
+#include <string>
+#include <string_view>
 
 #include <Wt/WApplication.h>
 
+#include "services/database/ArtistId.hpp"
 #include "services/database/Object.hpp"
+#include "services/database/ReleaseId.hpp"
 #include "services/database/UserId.hpp"
 #include "services/database/Types.hpp"
 #include "services/scanner/ScannerEvents.hpp"
+#include "utils/UUID.hpp"
 
 namespace Database
 {
@@ -45,6 +53,7 @@ namespace Wt
 namespace UserInterface {
 
 class CoverResource;
+class LibrarySnapshot;
 class LmsApplicationException;
 class MediaPlayer;
 class PlayQueue;
@@ -60,10 +69,15 @@ class LmsApplication : public Wt::WApplication
 		static std::unique_ptr<Wt::WApplication> create(const Wt::WEnvironment& env, Database::Db& db, LmsApplicationManager& appManager);
 		static LmsApplication* instance();
 
+		// Templates and messages are parsed once and shared by all the sessions, to be set on the server
+		// Each locale variant is loaded on its first use
+		static std::shared_ptr<Wt::WLocalizedStrings> createSharedLocalizedStrings(const std::string& appRoot);
+
 
 		// Session application data
 		std::shared_ptr<CoverResource> getCoverResource() { return _coverResource; }
 		Database::Session& getDbSession(); // always thread safe
+		Database::Db& getDb() { return _db; } // to be used by the threads that are not bound to the application
 
 		Database::ObjectPtr<Database::User>	getUser();
 		Database::UserId				getUserId();
@@ -72,7 +86,14 @@ class LmsApplication : public Wt::WApplication
 		std::string						getUserLoginName(); // user must be logged in prior this call
 
 		// Proxified scanner events
+		// scanInProgress is only proxified if listened, as it is emitted a lot during scans
 		Scanner::Events& getScannerEvents() { return _scannerEvents; }
+		void setScanInProgressListened(bool listened);
+
+		// May be null if not built yet
+		std::shared_ptr<const LibrarySnapshot> getLibrarySnapshot() const;
+
+		LmsApplicationManager& getApplicationManager() { return _appManager; }
 
 		// Utils
 		void post(std::function<void()> func);
@@ -88,9 +109,13 @@ class LmsApplication : public Wt::WApplication
 		void notifyMsg(MsgType type, const Wt::WString& message, std::chrono::milliseconds duration = std::chrono::milliseconds {4000});
 
 		static Wt::WLink					createArtistLink(Database::ObjectPtr<Database::Artist> artist);
+		static Wt::WLink					createArtistLink(Database::ArtistId artistId, const std::optional<UUID>& MBID);
 		static std::unique_ptr<Wt::WAnchor>	createArtistAnchor(Database::ObjectPtr<Database::Artist> artist, bool addText = true);
+		static std::unique_ptr<Wt::WAnchor>	createArtistAnchor(Database::ArtistId artistId, std::string_view name, const std::optional<UUID>& MBID, bool addText = true);
 		static Wt::WLink					createReleaseLink(Database::ObjectPtr<Database::Release> release);
+		static Wt::WLink					createReleaseLink(Database::ReleaseId releaseId, const std::optional<UUID>& MBID);
 		static std::unique_ptr<Wt::WAnchor> createReleaseAnchor(Database::ObjectPtr<Database::Release> release, bool addText = true);
+		static std::unique_ptr<Wt::WAnchor> createReleaseAnchor(Database::ReleaseId releaseId, std::string_view name, const std::optional<UUID>& MBID, bool addText = true);
 		static std::unique_ptr<Wt::WText>	createCluster(Database::ObjectPtr<Database::Cluster> cluster, bool canDelete = false);
 		Wt::WPopupMenu* createPopupMenu();
 
@@ -100,6 +125,18 @@ class LmsApplication : public Wt::WApplication
 		// Signal emitted just before the session ends (user may already be logged out)
 		Wt::Signal<>&	preQuit() { return _preQuit; }
 
+		// Memory accounting, may be read from any thread
+		// Entries displayed in the lists, reported by the lists themselves
+		void						updateDisplayedEntryCount(std::ptrdiff_t delta) { _displayedEntryCount += delta; }
+		std::size_t					getDisplayedEntryCount() const { return _displayedEntryCount; }
+		std::chrono::steady_clock::time_point getLastUserActivity() const { return _lastUserActivity; }
+		bool						isTrimmed() const { return _trimmed; }
+
+		// Releases what can be rebuilt (lists that are not displayed, etc.), the session is kept
+		// Emitted when the user has been idle for a while, see ui-idle-session-trim-delay
+		Wt::Signal<>&	trimRequested() { return _trimRequested; }
+		void			trim();
+
 	private:
 		void init();
 		void setTheme();
@@ -118,6 +155,10 @@ class LmsApplication : public Wt::WApplication
 
 		Database::Db&							_db;
 		Wt::Signal<>							_preQuit;
+		Wt::Signal<>							_trimRequested;
+		std::atomic<std::size_t>				_displayedEntryCount {};
+		std::atomic<std::chrono::steady_clock::time_point>	_lastUserActivity {std::chrono::steady_clock::now()};
+		std::atomic<bool>						_trimmed {};
 		LmsApplicationManager&   				_appManager;
 		Scanner::Events							_scannerEvents;
 		struct UserAuthInfo
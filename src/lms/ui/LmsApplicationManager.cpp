@@ -19,10 +19,30 @@
 
 #include "LmsApplicationManager.hpp"
 
+#include <Wt/WServer.h>
+
+#include "utils/IConfig.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Service.hpp"
 #include "LmsApplication.hpp"
 
 namespace UserInterface
 {
+	namespace
+	{
+		Metrics::Gauge&
+		getSessionGauge()
+		{
+			static Metrics::Gauge& sessions {Metrics::getRegistry().createGauge("lms_ui_sessions", "Number of active web interface sessions")};
+			return sessions;
+		}
+	}
+
+	LmsApplicationManager::LmsApplicationManager(Database::Db& db)
+		: _playQueueStore {db, std::chrono::seconds {Service<IConfig>::get()->getULong("ui-playqueue-flush-period", 30)}}
+	{
+	}
+
 	void
 	LmsApplicationManager::registerApplication(LmsApplication& application)
 	{
@@ -30,6 +50,7 @@ namespace UserInterface
 			std::scoped_lock lock {_mutex};
 			m_applications[application.getUserId()].insert(&application);
 		}
+		getSessionGauge().add();
 
 		applicationRegistered.emit(application);
 	}
@@ -41,8 +62,123 @@ namespace UserInterface
 			std::scoped_lock lock {_mutex};
 			m_applications[application.getUserId()].erase(&application);
 		}
+		getSessionGauge().sub();
+		setScanInProgressListened(application, false);
 
 		applicationUnregistered.emit(application);
 	}
 
+	std::vector<LmsApplicationManager::ApplicationStats>
+	LmsApplicationManager::getApplicationStats() const
+	{
+		std::vector<ApplicationStats> res;
+
+		const auto now {std::chrono::steady_clock::now()};
+
+		// applications are unregistered before being destroyed
+		std::scoped_lock lock {_mutex};
+		for (const auto& [userId, applications] : m_applications)
+		{
+			for (const LmsApplication* application : applications)
+			{
+				ApplicationStats& stats {res.emplace_back()};
+				stats.userId = userId;
+				stats.idleDuration = std::chrono::duration_cast<std::chrono::seconds>(now - application->getLastUserActivity());
+				stats.displayedEntryCount = application->getDisplayedEntryCount();
+				stats.estimatedMemoryUsage = _estimatedApplicationMemoryUsage + stats.displayedEntryCount * _estimatedDisplayedEntryMemoryUsage;
+				stats.trimmed = application->isTrimmed();
+			}
+		}
+
+		return res;
+	}
+
+	void
+	LmsApplicationManager::trimIdleApplications(std::chrono::seconds idleDuration)
+	{
+		const auto now {std::chrono::steady_clock::now()};
+
+		std::scoped_lock lock {_mutex};
+		for (const auto& [userId, applications] : m_applications)
+		{
+			for (const LmsApplication* application : applications)
+			{
+				if (application->isTrimmed() || now - application->getLastUserActivity() < idleDuration)
+					continue;
+
+				Wt::WServer::instance()->post(application->sessionId(), []
+				{
+					// may be nullptr, see https://redmine.webtoolkit.eu/issues/8202
+					if (LmsApp)
+						LmsApp->trim();
+				});
+			}
+		}
+	}
+
+	std::shared_ptr<const LibrarySnapshot>
+	LmsApplicationManager::getLibrarySnapshot() const
+	{
+		std::scoped_lock lock {_librarySnapshotMutex};
+		return _librarySnapshot;
+	}
+
+	void
+	LmsApplicationManager::setLibrarySnapshot(std::shared_ptr<const LibrarySnapshot> snapshot)
+	{
+		std::scoped_lock lock {_librarySnapshotMutex};
+		_librarySnapshot = std::move(snapshot);
+	}
+
+	void
+	LmsApplicationManager::publishScanInProgress(const Scanner::ScanStepStats& stats)
+	{
+		std::scoped_lock lock {_scanInProgressMutex};
+
+		_lastScanStepStats = stats;
+		for (auto& [application, listener] : _scanInProgressListeners)
+		{
+			if (listener.deliveryPending)
+				continue;
+
+			listener.deliveryPending = true;
+			Wt::WServer::instance()->post(listener.sessionId, [this] { deliverScanInProgress(); });
+		}
+	}
+
+	void
+	LmsApplicationManager::setScanInProgressListened(LmsApplication& application, bool listened)
+	{
+		std::scoped_lock lock {_scanInProgressMutex};
+
+		if (listened)
+			_scanInProgressListeners.emplace(&application, ScanInProgressListener {application.sessionId()});
+		else
+			_scanInProgressListeners.erase(&application);
+	}
+
+	void
+	LmsApplicationManager::deliverScanInProgress()
+	{
+		// may be nullptr, see https://redmine.webtoolkit.eu/issues/8202
+		if (!LmsApp)
+			return;
+
+		Scanner::ScanStepStats stats;
+		{
+			std::scoped_lock lock {_scanInProgressMutex};
+
+			// the application may have stopped listening in the meantime
+			auto it {_scanInProgressListeners.find(LmsApp)};
+			if (it == std::end(_scanInProgressListeners))
+				return;
+
+			it->second.deliveryPending = false;
+			stats = *_lastScanStepStats;
+		}
+
+		LmsApp->getScannerEvents().scanInProgress.emit(stats);
+		LmsApp->triggerUpdate();
+	}
+
 } // UserInterface
@@ -19,30 +19,91 @@
 
 #pragma once
 
+#include <chrono>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <string>
 #include <unordered_set>
 #include <unordered_map>
+#include <vector>
 
 #include <Wt/WSignal.h>
 
 #include "services/database/UserId.hpp"
+#include "services/scanner/ScannerStats.hpp"
+#include "PlayQueueStore.hpp"
+
+namespace Database
+{
+	class Db;
+}
 
 namespace UserInterface
 {
+	class LibrarySnapshot;
 	class LmsApplication;
 	class LmsApplicationManager
 	{
 		public:
+			LmsApplicationManager(Database::Db& db);
+
 			Wt::Signal<LmsApplication&> applicationRegistered;
 			Wt::Signal<LmsApplication&> applicationUnregistered;
 
+			// Shared by all the applications, may be null
+			std::shared_ptr<const LibrarySnapshot> getLibrarySnapshot() const;
+			void setLibrarySnapshot(std::shared_ptr<const LibrarySnapshot> snapshot);
+
+			// Shared by all the applications, to coalesce the play queue writes
+			PlayQueueStore& getPlayQueueStore() { return _playQueueStore; }
+
+			struct ApplicationStats
+			{
+				Database::UserId		userId;
+				std::chrono::seconds	idleDuration;
+				std::size_t				displayedEntryCount {};
+				std::size_t				estimatedMemoryUsage {}; // in bytes
+				bool					trimmed {};
+			};
+			std::vector<ApplicationStats> getApplicationStats() const;
+
+			// Asks the sessions whose user has been idle for at least idleDuration to trim their contents
+			void trimIdleApplications(std::chrono::seconds idleDuration); // any thread
+
+			// Only the latest stats are delivered to the listening applications
+			// An application does not get another post until it has handled the previous one
+			void publishScanInProgress(const Scanner::ScanStepStats& stats); // any thread
+
 		private:
 			friend class LmsApplication;
 
 			void registerApplication(LmsApplication& application);
 			void unregisterApplication(LmsApplication& application);
 
-			std::mutex _mutex;
+			void setScanInProgressListened(LmsApplication& application, bool listened);
+			void deliverScanInProgress(); // in the listening application's session
+
+			// rough estimate of the memory used by a displayed list entry (widgets, bound strings, links, etc.)
+			static inline constexpr std::size_t _estimatedDisplayedEntryMemoryUsage {4 * 1024};
+			// base memory used by a session (main widgets, play queue, etc.)
+			static inline constexpr std::size_t _estimatedApplicationMemoryUsage {256 * 1024};
+
+			mutable std::mutex _mutex;
 			std::unordered_map<Database::UserId, std::unordered_set<LmsApplication*>>  m_applications;
+
+			PlayQueueStore _playQueueStore;
+
+			mutable std::mutex _librarySnapshotMutex;
+			std::shared_ptr<const LibrarySnapshot> _librarySnapshot;
+
+			struct ScanInProgressListener
+			{
+				std::string	sessionId;
+				bool		deliveryPending {};
+			};
+			std::mutex _scanInProgressMutex;
+			std::optional<Scanner::ScanStepStats> _lastScanStepStats;
+			std::unordered_map<const LmsApplication*, ScanInProgressListener> _scanInProgressListeners;
 	};
 } // UserInterface
@@ -19,11 +19,17 @@
 
 #include "MediaPlayer.hpp"
 
+#include <algorithm>
+#include <string_view>
+#include <utility>
+
 #include <Wt/Json/Object.h>
 #include <Wt/Json/Value.h>
 #include <Wt/Json/Serializer.h>
 
+#include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Service.hpp"
 
 #include "services/database/Artist.hpp"
 #include "services/database/Release.hpp"
@@ -191,6 +197,53 @@ static MediaPlayer::Settings settingsfromJSString(const std::string& strSettings
 	return settings;
 }
 
+// Keep in sync with LMS.mediaplayer js
+static
+EnumSet<Database::AudioCodec>
+codecsFromJSString(std::string_view strCodecs)
+{
+	EnumSet<Database::AudioCodec> codecs;
+
+	for (std::string_view strCodec : StringUtils::splitString(strCodecs, ","))
+	{
+		const auto value {StringUtils::readAs<int>(strCodec)};
+		if (!value)
+			continue;
+
+		const Database::AudioCodec codec {static_cast<Database::AudioCodec>(*value)};
+		switch (codec)
+		{
+			case Database::AudioCodec::MP3:
+			case Database::AudioCodec::Opus:
+			case Database::AudioCodec::Vorbis:
+			case Database::AudioCodec::FLAC:
+				codecs.insert(codec);
+				break;
+
+			case Database::AudioCodec::Unknown:
+				break;
+		}
+	}
+
+	return codecs;
+}
+
+static
+std::size_t
+getTranscodePrefetchCount()
+{
+	static const std::size_t prefetchCount {Service<IConfig>::get()->getULong("transcode-prefetch-count", 0)};
+	return prefetchCount;
+}
+
+static
+std::size_t
+getTranscodeSessionTrackCount()
+{
+	static const std::size_t sessionTrackCount {Service<IConfig>::get()->getULong("transcode-session-track-count", 0)};
+	return sessionTrackCount;
+}
+
 MediaPlayer::MediaPlayer()
 : Wt::WTemplate {Wt::WString::tr("Lms.MediaPlayer.template")}
 , playPrevious {this, "playPrevious"}
@@ -199,6 +252,8 @@ MediaPlayer::MediaPlayer()
 , scrobbleListenFinished {this, "scrobbleListenFinished"}
 , playbackEnded {this, "playbackEnded"}
 , _settingsLoaded {this, "settingsLoaded"}
+, _sessionTrackEnded {this, "sessionTrackEnded"}
+, _codecsReported {this, "codecsReported"}
 {
 	addFunction("tr", &Wt::WTemplate::Functions::tr);
 
@@ -218,6 +273,20 @@ MediaPlayer::MediaPlayer()
 		settingsLoaded.emit();
 	});
 
+	_codecsReported.connect([this](const std::string& codecs)
+	{
+		LMS_LOG(UI, DEBUG) << "Playable codecs reported: '" << codecs << "'";
+
+		_playableCodecs = codecsFromJSString(codecs);
+	});
+
+	// The current track ended but the transcode goes on with the next one
+	_sessionTrackEnded.connect([this]
+	{
+		_sessionTrackEndReached = true;
+		playbackEnded.emit();
+	});
+
 	{
 		Settings defaultSettings;
 
@@ -237,6 +306,15 @@ MediaPlayer::loadTrack(Database::TrackId trackId, bool play, float replayGain)
 {
 	LMS_LOG(UI, DEBUG) << "Playing track ID = " << trackId.toString();
 
+	// Already being transcoded if it follows the previous track in the same session
+	const bool continueSession {std::exchange(_sessionTrackEndReached, false) && !_sessionTrackIds.empty() && _sessionTrackIds.front() == trackId};
+	if (continueSession)
+		_sessionTrackIds.erase(std::cbegin(_sessionTrackIds));
+	else if (_settings && _settings->transcode.mode == Settings::Transcode::Mode::Always)
+		_sessionTrackIds.assign(std::cbegin(_upcomingTrackIds), std::cbegin(_upcomingTrackIds) + std::min(_upcomingTrackIds.size(), getTranscodeSessionTrackCount()));
+	else
+		_sessionTrackIds.clear();
+
 	std::ostringstream oss;
 	{
 		auto transaction {LmsApp->getDbSession().createSharedTransaction()};
@@ -245,9 +323,29 @@ MediaPlayer::loadTrack(Database::TrackId trackId, bool play, float replayGain)
 		if (!track)
 			return;
 
-		const std::string transcodeResource {_audioTranscodeResource->getUrl(trackId)};
+		// Durations are used by the player to detect track changes
+		std::ostringstream sessionDurations;
+		if (!_sessionTrackIds.empty())
+		{
+			sessionDurations << track->getDuration().count() / 1000.;
+			for (auto itTrackId {std::cbegin(_sessionTrackIds)}; itTrackId != std::cend(_sessionTrackIds); ++itTrackId)
+			{
+				const auto sessionTrack {Database::Track::find(LmsApp->getDbSession(), *itTrackId)};
+				if (!sessionTrack)
+				{
+					_sessionTrackIds.erase(itTrackId, std::cend(_sessionTrackIds));
+					break;
+				}
+				sessionDurations << ", " << sessionTrack->getDuration().count() / 1000.;
+			}
+		}
+
+		const std::string transcodeResource {_sessionTrackIds.empty() ? _audioTranscodeResource->getUrl(trackId) : _audioTranscodeResource->getSessionUrl(trackId, _sessionTrackIds)};
 		const std::string nativeResource {_audioFileResource->getUrl(trackId)};
 
+		const std::optional<bool> directPlay {continueSession ? std::optional<bool> {false} : isDirectPlayable(track->getAudioCodec(), track->getBitrate())};
+		LMS_LOG(UI, DEBUG) << "Direct play = " << (directPlay ? (*directPlay ? "yes" : "no") : "let the browser choose");
+
 		const auto artists {track->getArtists({Database::TrackArtistLinkType::Artist})};
 
 		oss
@@ -257,6 +355,9 @@ MediaPlayer::loadTrack(Database::TrackId trackId, bool play, float replayGain)
 			<< " transcodeResource: \"" << transcodeResource << "\","
 			<< " duration: " << std::chrono::duration_cast<std::chrono::seconds>(track->getDuration()).count() << ","
 			<< " replayGain: " << replayGain << ","
+			<< " continueSession: " << (continueSession ? "true" : "false") << ","
+			<< " directPlay: " << (directPlay ? (*directPlay ? "true" : "false") : "null") << ","
+			<< " sessionDurations: [" << sessionDurations.str() << "],"
 			<< " title: \"" << StringUtils::jsEscape(track->getName()) << "\","
 			<< " artist: \"" << (!artists.empty() ? StringUtils::jsEscape(artists.front()->getName()) : "") << "\","
 			<< " release: \"" << (track->getRelease() ? StringUtils::jsEscape(track->getRelease()->getName()) : "") << "\","
@@ -302,6 +403,54 @@ MediaPlayer::loadTrack(Database::TrackId trackId, bool play, float replayGain)
 	trackLoaded.emit(*_trackIdLoaded);
 }
 
+std::optional<bool>
+MediaPlayer::isDirectPlayable(Database::AudioCodec codec, std::size_t bitrate) const
+{
+	if (!_settings)
+		return std::nullopt;
+
+	switch (_settings->transcode.mode)
+	{
+		case Settings::Transcode::Mode::Never:
+			return true;
+
+		case Settings::Transcode::Mode::Always:
+			return false;
+
+		case Settings::Transcode::Mode::IfFormatNotSupported:
+			break;
+	}
+
+	// Let the browser pick among the file and the transcode
+	if (!_playableCodecs || codec == Database::AudioCodec::Unknown)
+		return std::nullopt;
+
+	// Unknown bitrates are considered as fitting
+	return _playableCodecs->contains(codec) && bitrate <= _settings->transcode.bitrate;
+}
+
+std::size_t
+MediaPlayer::getUpcomingTrackCount() const
+{
+	if (!_settings || _settings->transcode.mode != Settings::Transcode::Mode::Always)
+		return 0;
+
+	// Tracks transcoded in the same session are not prefetched
+	return getTranscodeSessionTrackCount() > 0 ? getTranscodeSessionTrackCount() : getTranscodePrefetchCount();
+}
+
+void
+MediaPlayer::setUpcomingTracks(const std::vector<Database::TrackId>& trackIds)
+{
+	_upcomingTrackIds = trackIds;
+
+	if (!_settings || _settings->transcode.mode != Settings::Transcode::Mode::Always || getTranscodeSessionTrackCount() > 0)
+		return;
+
+	for (const Database::TrackId trackId : trackIds)
+		AudioTranscodeResource::prefetch(trackId, _settings->transcode.format, _settings->transcode.bitrate);
+}
+
 void
 MediaPlayer::stop()
 {
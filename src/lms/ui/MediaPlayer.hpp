@@ -21,6 +21,7 @@
 
 #include <chrono>
 #include <optional>
+#include <vector>
 
 #include <Wt/WAnchor.h>
 #include <Wt/WJavaScript.h>
@@ -29,6 +30,7 @@
 
 #include "services/database/TrackId.hpp"
 #include "services/database/Types.hpp"
+#include "utils/EnumSet.hpp"
 
 namespace UserInterface {
 
@@ -100,6 +102,11 @@ class MediaPlayer : public Wt::WTemplate
 		void loadTrack(Database::TrackId trackId, bool play, float replayGain);
 		void stop();
 
+		// Number of upcoming tracks the player wants to know about, depends on the settings
+		std::size_t getUpcomingTrackCount() const;
+		// Must be set before the current track is loaded
+		void setUpcomingTracks(const std::vector<Database::TrackId>& trackIds);
+
 		std::optional<Settings>	getSettings() const { return _settings; }
 		void			setSettings(const Settings& settings);
 
@@ -115,13 +122,22 @@ class MediaPlayer : public Wt::WTemplate
 		Wt::JSignal<>			playbackEnded;
 
 	private:
+		// none if the browser has to pick by itself (codecs not reported yet, unknown codec)
+		std::optional<bool> isDirectPlayable(Database::AudioCodec codec, std::size_t bitrate) const;
+
 		std::unique_ptr<AudioFileResource>		_audioFileResource;
 		std::unique_ptr<AudioTranscodeResource>	_audioTranscodeResource;
 
 		std::optional<Database::TrackId> _trackIdLoaded;
 		std::optional<Settings>		_settings;
+		std::vector<Database::TrackId>	_upcomingTrackIds;
+		std::vector<Database::TrackId>	_sessionTrackIds;	// next tracks of the transcode being played
+		bool							_sessionTrackEndReached {};
+		std::optional<EnumSet<Database::AudioCodec>>	_playableCodecs;	// reported once by the browser
 
 		Wt::JSignal<std::string> 	_settingsLoaded;
+		Wt::JSignal<>				_sessionTrackEnded;
+		Wt::JSignal<std::string>	_codecsReported;
 
 		Wt::WText*		_title {};
 		Wt::WAnchor*	_release {};
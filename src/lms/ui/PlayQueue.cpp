@@ -19,14 +19,18 @@
 
 #include "PlayQueue.hpp"
 
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
 #include <Wt/WPopupMenu.h>
 #include <Wt/WText.h>
 
+#include "services/database/Artist.hpp"
 #include "services/database/Cluster.hpp"
 #include "services/database/Release.hpp"
 #include "services/database/Session.hpp"
 #include "services/database/Track.hpp"
-#include "services/database/TrackList.hpp"
 #include "services/database/User.hpp"
 #include "services/scrobbling/IScrobblingService.hpp"
 #include "services/recommendation/IRecommendationService.hpp"
@@ -39,6 +43,7 @@
 #include "resource/CoverResource.hpp"
 #include "resource/DownloadResource.hpp"
 #include "LmsApplication.hpp"
+#include "LmsApplicationManager.hpp"
 #include "MediaPlayer.hpp"
 #include "TrackStringUtils.hpp"
 
@@ -69,28 +74,25 @@ PlayQueue::PlayQueue()
 		clearTracks();
 	});
 
-	_entriesContainer = bindNew<InfiniteScrollingContainer>("entries");
+	_entriesContainer = bindNew<InfiniteScrollingContainer>("entries", Wt::WString::tr("Lms.infinite-scrolling-container"), _maxDisplayedEntryCount);
 	_entriesContainer->onRequestElements.connect([this]
 	{
 		addSome();
 		updateCurrentTrack(true);
 	});
+	_entriesContainer->onRequestPreviousElements.connect([this]
+	{
+		addSomePrevious();
+		updateCurrentTrack(true);
+	});
 
 	Wt::WText* shuffleBtn = bindNew<Wt::WText>("shuffle-btn", Wt::WString::tr("Lms.PlayQueue.template.shuffle-btn"), Wt::TextFormat::XHTML);
 	setToolTip(*shuffleBtn, Wt::WString::tr("Lms.PlayQueue.shuffle"));
 	shuffleBtn->clicked().connect([=]
 	{
-		{
-			auto transaction {LmsApp->getDbSession().createUniqueTransaction()};
-
-			Database::TrackList::pointer trackList {getTrackList()};
-			auto entries {trackList->getEntries()};
-			Random::shuffleContainer(entries);
+		Random::shuffleContainer(_trackIds);
+		saveQueue();
 
-			getTrackList().modify()->clear();
-			for (const auto& entry : entries)
-				Database::TrackListEntry::create(LmsApp->getDbSession(), entry->getTrack(), trackList);
-		}
 		_entriesContainer->clear();
 		addSome();
 	});
@@ -125,55 +127,32 @@ PlayQueue::PlayQueue()
 
 	_nbTracks = bindNew<Wt::WText>("nb-tracks");
 
-	LmsApp->preQuit().connect([=]
 	{
-		auto transaction {LmsApp->getDbSession().createUniqueTransaction()};
+		auto transaction {LmsApp->getDbSession().createSharedTransaction()};
 
-		if (LmsApp->getUser()->isDemo())
-		{
-			LMS_LOG(UI, DEBUG) << "Removing tracklist id " << _tracklistId.toString();
-			auto tracklist = Database::TrackList::find(LmsApp->getDbSession(), _tracklistId);
-			if (tracklist)
-				tracklist.remove();
-		}
-	});
+		// the queue of the demo user only lives in the session
+		_persisted = !LmsApp->getUser()->isDemo();
+	}
 
+	if (_persisted)
 	{
-		auto transaction {LmsApp->getDbSession().createUniqueTransaction()};
-
-		Database::TrackList::pointer trackList;
+		const PlayQueueStore::PlayQueue playQueue {getPlayQueueStore().get(LmsApp->getUserId())};
+		_trackIds = playQueue.trackIds;
 
-		if (!LmsApp->getUser()->isDemo())
+		LmsApp->getMediaPlayer().settingsLoaded.connect([=, trackPos = playQueue.currentIndex]
 		{
-			LmsApp->getMediaPlayer().settingsLoaded.connect([=]
-			{
-				if (_mediaPlayerSettingsLoaded)
-					return;
-
-				_mediaPlayerSettingsLoaded = true;
-
-				std::size_t trackPos {};
-
-				{
-					auto transaction {LmsApp->getDbSession().createSharedTransaction()};
-					trackPos = LmsApp->getUser()->getCurPlayingTrackPos();
-				}
+			if (_mediaPlayerSettingsLoaded)
+				return;
 
-				loadTrack(trackPos, false);
-			});
+			_mediaPlayerSettingsLoaded = true;
+			loadTrack(trackPos, false);
+		});
 
-			static const std::string queuedListName {"__queued_tracks__"};
-			trackList = Database::TrackList::find(LmsApp->getDbSession(), queuedListName, Database::TrackList::Type::Internal, LmsApp->getUserId());
-			if (!trackList)
-				trackList = Database::TrackList::create(LmsApp->getDbSession(), queuedListName, Database::TrackList::Type::Internal, false, LmsApp->getUser());
-		}
-		else
+		// do not wait for the next flush period
+		LmsApp->preQuit().connect([]
 		{
-			static const std::string currentPlayQueueName {"__current__playqueue__"};
-			trackList = Database::TrackList::create(LmsApp->getDbSession(), currentPlayQueueName, Database::TrackList::Type::Internal, false, LmsApp->getUser());
-		}
-
-		_tracklistId = trackList->getId();
+			getPlayQueueStore().requestFlush();
+		});
 	}
 
 	updateInfo();
@@ -194,27 +173,34 @@ PlayQueue::updateRadioBtn()
 	_radioBtn->toggleStyleClass("text-muted", !_radioMode);
 }
 
-Database::TrackList::pointer
-PlayQueue::getTrackList() const
+PlayQueueStore&
+PlayQueue::getPlayQueueStore()
 {
-	return Database::TrackList::find(LmsApp->getDbSession(), _tracklistId);
+	return LmsApp->getApplicationManager().getPlayQueueStore();
+}
+
+void
+PlayQueue::saveQueue()
+{
+	if (!_persisted)
+		return;
+
+	getPlayQueueStore().save(LmsApp->getUserId(), PlayQueueStore::PlayQueue {_trackIds, _trackPos.value_or(0)});
 }
 
 bool
 PlayQueue::isFull() const
 {
-	auto transaction {LmsApp->getDbSession().createSharedTransaction()};
-	return getTrackList()->getCount() == _nbMaxEntries;
+	return _trackIds.size() >= _nbMaxEntries;
 }
 
 void
 PlayQueue::clearTracks()
 {
-	{
-		auto transaction {LmsApp->getDbSession().createUniqueTransaction()};
-		getTrackList().modify()->clear();
-	}
+	_trackIds.clear();
+	saveQueue();
 
+	_radioCandidates.clear();
 	_entriesContainer->clear();
 	updateInfo();
 }
@@ -232,46 +218,44 @@ PlayQueue::loadTrack(std::size_t pos, bool play)
 {
 	updateCurrentTrack(false);
 
-	Database::TrackId trackId {};
-	bool addRadioTrack {};
-	std::optional<float> replayGain {};
+	// If out of range, stop playing
+	if (pos >= _trackIds.size())
 	{
-		auto transaction {LmsApp->getDbSession().createSharedTransaction()};
-
-		Database::TrackList::pointer tracklist {getTrackList()};
-
-		// If out of range, stop playing
-		if (pos >= tracklist->getCount())
+		if (!_repeatAll || _trackIds.empty())
 		{
-			if (!_repeatAll || tracklist->getCount() == 0)
-			{
-				stop();
-				return;
-			}
-
-			pos = 0;
+			stop();
+			return;
 		}
 
-		// If last and radio mode, fill the next song
-		if (_radioMode && pos == tracklist->getCount() - 1)
-			addRadioTrack = true;
+		pos = 0;
+	}
 
-		_trackPos = pos;
-		auto track = tracklist->getEntry(*_trackPos)->getTrack();
+	// If last and radio mode, fill the next song
+	const bool addRadioTrack {_radioMode && pos == _trackIds.size() - 1};
 
-		trackId = track->getId();
+	_trackPos = pos;
+	const Database::TrackId trackId {_trackIds[pos]};
 
-		replayGain = getReplayGain(pos, track);
+	std::optional<float> replayGain {};
+	{
+		auto transaction {LmsApp->getDbSession().createSharedTransaction()};
 
-		if (!LmsApp->getUser()->isDemo())
-			LmsApp->getUser().modify()->setCurPlayingTrackPos(pos);
+		if (const Database::Track::pointer track {Database::Track::find(LmsApp->getDbSession(), trackId)})
+			replayGain = getReplayGain(pos, track);
 	}
 
+	const std::size_t upcomingTrackCount {std::min(LmsApp->getMediaPlayer().getUpcomingTrackCount(), _trackIds.size() - pos - 1)};
+	const std::vector<Database::TrackId> upcomingTrackIds (std::cbegin(_trackIds) + pos + 1, std::cbegin(_trackIds) + pos + 1 + upcomingTrackCount);
+
+	if (_persisted)
+		getPlayQueueStore().saveCurrentIndex(LmsApp->getUserId(), pos);
+
 	if (addRadioTrack)
 		enqueueRadioTracks();
 
 	updateCurrentTrack(true);
 
+	upcomingTracksSelected.emit(upcomingTrackIds);
 	trackSelected.emit(trackId, play, replayGain ? *replayGain : 0);
 }
 
@@ -302,17 +286,16 @@ PlayQueue::playNext()
 void
 PlayQueue::updateInfo()
 {
-	auto transaction {LmsApp->getDbSession().createSharedTransaction()};
-
-	_nbTracks->setText(Wt::WString::tr("Lms.PlayQueue.nb-tracks").arg(static_cast<unsigned>(getTrackList()->getCount())));
+	_nbTracks->setText(Wt::WString::tr("Lms.PlayQueue.nb-tracks").arg(static_cast<unsigned>(_trackIds.size())));
 }
 
 void
 PlayQueue::updateCurrentTrack(bool selected)
 {
-	if (!_trackPos || *_trackPos >= static_cast<std::size_t>(_entriesContainer->getCount()))
+	if (!_trackPos)
 		return;
 
+	// may not be displayed
 	Wt::WTemplate* entry {static_cast<Wt::WTemplate*>(_entriesContainer->getWidget(*_trackPos))};
 	if (entry)
 		entry->bindString("is-selected", selected ? "Lms-playqueue-selected" : "");
@@ -321,27 +304,9 @@ PlayQueue::updateCurrentTrack(bool selected)
 std::size_t
 PlayQueue::enqueueTracks(const std::vector<Database::TrackId>& trackIds)
 {
-	std::size_t nbTracksQueued {};
-
-	{
-		auto transaction {LmsApp->getDbSession().createUniqueTransaction()};
-
-		auto tracklist {getTrackList()};
-
-		std::size_t nbTracksToEnqueue {tracklist->getCount() + trackIds.size() > _nbMaxEntries ? _nbMaxEntries - tracklist->getCount() : trackIds.size()};
-		for (const Database::TrackId trackId : trackIds)
-		{
-			Database::Track::pointer track {Database::Track::find(LmsApp->getDbSession(), trackId)};
-			if (!track)
-				continue;
-
-			if (nbTracksQueued == nbTracksToEnqueue)
-				break;
-
-			Database::TrackListEntry::create(LmsApp->getDbSession(), track, tracklist);
-			nbTracksQueued++;
-		}
-	}
+	const std::size_t nbTracksQueued {std::min(trackIds.size(), _nbMaxEntries - std::min(_trackIds.size(), _nbMaxEntries))};
+	_trackIds.insert(std::end(_trackIds), std::cbegin(trackIds), std::cbegin(trackIds) + nbTracksQueued);
+	saveQueue();
 
 	updateInfo();
 	addSome();
@@ -394,54 +359,96 @@ PlayQueue::processTracks(PlayQueueAction action, const std::vector<Database::Tra
 void
 PlayQueue::addSome()
 {
-	auto transaction {LmsApp->getDbSession().createSharedTransaction()};
+	const std::size_t offset {_entriesContainer->getFirstIndex() + _entriesContainer->getCount()};
+	const std::size_t count {offset < _trackIds.size() ? std::min(_trackIds.size() - offset, _batchSize) : 0};
 
-	auto tracklist = getTrackList();
+	for (std::unique_ptr<Wt::WTemplate>& entry : createEntries(offset, count))
+		_entriesContainer->add(std::move(entry));
 
-	auto tracklistEntries = tracklist->getEntries(_entriesContainer->getCount(), _batchSize);
-	for (const Database::TrackListEntry::pointer& tracklistEntry : tracklistEntries)
-		addEntry(tracklistEntry);
-
-	_entriesContainer->setHasMore(_entriesContainer->getCount() < tracklist->getCount());
+	_entriesContainer->setHasMore(_entriesContainer->getFirstIndex() + _entriesContainer->getCount() < _trackIds.size());
 }
 
 void
-PlayQueue::addEntry(const Database::TrackListEntry::pointer& tracklistEntry)
+PlayQueue::addSomePrevious()
+{
+	const std::size_t firstIndex {_entriesContainer->getFirstIndex()};
+	const std::size_t count {std::min(firstIndex, _batchSize)};
+
+	auto entries {createEntries(firstIndex - count, count)};
+	for (auto itEntry {std::rbegin(entries)}; itEntry != std::rend(entries); ++itEntry)
+		_entriesContainer->addFront(std::move(*itEntry));
+
+	_entriesContainer->setHasPrevious(_entriesContainer->getFirstIndex() > 0);
+}
+
+std::vector<std::unique_ptr<Wt::WTemplate>>
+PlayQueue::createEntries(std::size_t offset, std::size_t count)
 {
-	const Database::TrackListEntryId tracklistEntryId {tracklistEntry->getId()};
-	const auto track {tracklistEntry->getTrack()};
-	const Database::TrackId trackId {track->getId()};
+	// Only what is rendered is fetched, using batched queries: tracks, releases and artists are not loaded in the session
+	const std::vector<Database::TrackId> trackIds (std::cbegin(_trackIds) + offset, std::cbegin(_trackIds) + offset + count);
 
-	Wt::WTemplate* entry = _entriesContainer->addNew<Wt::WTemplate>(Wt::WString::tr("Lms.PlayQueue.template.entry"));
+	std::unordered_map<Database::TrackId, Database::Track::ListEntryResult> tracks;
+	{
+		auto transaction {LmsApp->getDbSession().createSharedTransaction()};
+
+		for (Database::Track::ListEntryResult& track : Database::Track::findListEntries(LmsApp->getDbSession(), trackIds))
+			tracks.emplace(track.trackId, std::move(track));
+	}
+
+	std::vector<std::unique_ptr<Wt::WTemplate>> entries;
+	entries.reserve(trackIds.size());
+	for (const Database::TrackId trackId : trackIds)
+	{
+		// tracks removed since they were queued are kept as empty entries, to keep the positions in sync
+		auto itTrack {tracks.find(trackId)};
+		if (itTrack != std::cend(tracks))
+			entries.push_back(createEntry(itTrack->second));
+		else
+		{
+			Database::Track::ListEntryResult removedTrack;
+			removedTrack.trackId = trackId;
+			entries.push_back(createEntry(removedTrack));
+		}
+	}
+
+	return entries;
+}
+
+std::unique_ptr<Wt::WTemplate>
+PlayQueue::createEntry(const Database::Track::ListEntryResult& track)
+{
+	const Database::TrackId trackId {track.trackId};
+
+	auto entryWidget {std::make_unique<Wt::WTemplate>(Wt::WString::tr("Lms.PlayQueue.template.entry"))};
+	Wt::WTemplate* entry {entryWidget.get()};
 
 	entry->bindString("is-selected", "");
-	entry->bindString("name", Wt::WString::fromUTF8(track->getName()), Wt::TextFormat::Plain);
+	entry->bindString("name", Wt::WString::fromUTF8(track.name), Wt::TextFormat::Plain);
 
-	const auto artists {track->getArtists({Database::TrackArtistLinkType::Artist})};
-	const auto release {track->getRelease()};
+	const bool hasRelease {track.releaseId.isValid()};
 
-	if (!artists.empty() || release)
+	if (!track.artists.empty() || hasRelease)
 		entry->setCondition("if-has-artists-or-release", true);
 
-	if (!artists.empty())
+	if (!track.artists.empty())
 	{
 		entry->setCondition("if-has-artists", true);
 
 		Wt::WContainerWidget* artistContainer {entry->bindNew<Wt::WContainerWidget>("artists")};
-		for (const auto& artist : artists)
+		for (const Database::Artist::ListEntryResult& artist : track.artists)
 		{
 			Wt::WTemplate* a {artistContainer->addNew<Wt::WTemplate>(Wt::WString::tr("Lms.PlayQueue.template.entry-artist"))};
-			a->bindWidget("artist", LmsApplication::createArtistAnchor(artist));
+			a->bindWidget("artist", LmsApplication::createArtistAnchor(artist.artistId, artist.name, artist.MBID));
 		}
 	}
-	if (release)
+	if (hasRelease)
 	{
 		entry->setCondition("if-has-release", true);
-		entry->bindWidget("release", LmsApplication::createReleaseAnchor(release));
+		entry->bindWidget("release", LmsApplication::createReleaseAnchor(track.releaseId, track.releaseName, track.releaseMBID));
 		{
-			Wt::WAnchor* anchor = entry->bindWidget("cover", LmsApplication::createReleaseAnchor(release, false));
+			Wt::WAnchor* anchor = entry->bindWidget("cover", LmsApplication::createReleaseAnchor(track.releaseId, track.releaseName, track.releaseMBID, false));
 			auto cover = std::make_unique<Wt::WImage>();
-			cover->setImageLink(LmsApp->getCoverResource()->getReleaseUrl(release->getId(), CoverResource::Size::Large));
+			cover->setImageLink(LmsApp->getCoverResource()->getReleaseUrl(track.releaseId, CoverResource::Size::Large));
 			cover->setStyleClass("Lms-cover");
 			cover->setAttributeValue("onload", LmsApp->javaScriptClass() + ".onLoadCover(this)");
 			anchor->setImage(std::move(cover));
@@ -450,12 +457,12 @@ PlayQueue::addEntry(const Database::TrackListEntry::pointer& tracklistEntry)
 	else
 	{
 		auto cover = entry->bindNew<Wt::WImage>("cover");
-		cover->setImageLink(LmsApp->getCoverResource()->getTrackUrl(track->getId(), CoverResource::Size::Large));
+		cover->setImageLink(LmsApp->getCoverResource()->getTrackUrl(trackId, CoverResource::Size::Large));
 		cover->setStyleClass("Lms-cover");
 		cover->setAttributeValue("onload", LmsApp->javaScriptClass() + ".onLoadCover(this)");
 	}
 
-	entry->bindString("duration", durationToString(track->getDuration()), Wt::TextFormat::Plain);
+	entry->bindString("duration", durationToString(track.duration), Wt::TextFormat::Plain);
 
 	Wt::WText* playBtn {entry->bindNew<Wt::WText>("play-btn", Wt::WString::tr("Lms.PlayQueue.template.play-btn"), Wt::TextFormat::XHTML)};
 	playBtn->clicked().connect([=]
@@ -469,19 +476,16 @@ PlayQueue::addEntry(const Database::TrackListEntry::pointer& tracklistEntry)
 	delBtn->clicked().connect([=]
 	{
 		// Remove the entry n both the widget tree and the playqueue
-		{
-			auto transaction {LmsApp->getDbSession().createUniqueTransaction()};
+		const std::optional<std::size_t> pos {_entriesContainer->getIndexOf(*entry)};
+		if (!pos)
+			return;
 
-			Database::TrackListEntry::pointer entryToRemove {Database::TrackListEntry::getById(LmsApp->getDbSession(), tracklistEntryId)};
-			entryToRemove.remove();
-		}
+		_trackIds.erase(std::begin(_trackIds) + *pos);
 
-		if (_trackPos)
-		{
-			const std::optional<std::size_t> pos {_entriesContainer->getIndexOf(*entry)};
-			if (pos && *_trackPos >= *pos)
-				(*_trackPos)--;
-		}
+		if (_trackPos && *_trackPos >= *pos)
+			(*_trackPos)--;
+
+		saveQueue();
 
 		_entriesContainer->remove(*entry);
 
@@ -507,18 +511,60 @@ PlayQueue::addEntry(const Database::TrackListEntry::pointer& tracklistEntry)
 
 		popup->popup(moreBtn);
 	});
+
+	return entryWidget;
 }
 
 void
 PlayQueue::enqueueRadioTracks()
 {
-	const auto similarTrackIds {Service<Recommendation::IRecommendationService>::get()->findSimilarTracksFromTrackList(_tracklistId, 3)};
+	if (_radioCandidates.size() < _radioTrackCount)
+		refillRadioCandidates();
+
+	// the queue may have been changed since the candidates were computed
+	const std::unordered_set<Database::TrackId> queuedTrackIds {std::cbegin(_trackIds), std::cend(_trackIds)};
+
+	std::vector<Database::TrackId> trackToAddIds;
+	while (!_radioCandidates.empty() && trackToAddIds.size() < _radioTrackCount)
+	{
+		const Database::TrackId trackId {_radioCandidates.front()};
+		_radioCandidates.pop_front();
+
+		if (queuedTrackIds.find(trackId) == std::cend(queuedTrackIds))
+			trackToAddIds.push_back(trackId);
+	}
 
-	std::vector<Database::TrackId> trackToAddIds(std::cbegin(similarTrackIds), std::cend(similarTrackIds));
-	Random::shuffleContainer(trackToAddIds);
 	enqueueTracks(trackToAddIds);
 }
 
+void
+PlayQueue::refillRadioCandidates()
+{
+	std::unordered_set<Database::TrackId> excludedTrackIds {std::cbegin(_radioCandidates), std::cend(_radioCandidates)};
+	excludedTrackIds.insert(std::cbegin(_trackIds), std::cend(_trackIds));
+
+	const std::size_t seedCount {std::min(_trackIds.size(), _radioSeedTrackCount)};
+	const std::vector<Database::TrackId> seedTrackIds (std::cend(_trackIds) - seedCount, std::cend(_trackIds));
+
+	// refined from the last tracks only, the whole queue is only used as a fallback
+	const Recommendation::IRecommendationService& recommendationService {*Service<Recommendation::IRecommendationService>::get()};
+	std::vector<Database::TrackId> similarTrackIds;
+	if (!seedTrackIds.empty())
+		similarTrackIds = recommendationService.findSimilarTracks(seedTrackIds, _radioCandidatePoolSize + seedTrackIds.size());
+	if (similarTrackIds.empty() && !_trackIds.empty())
+		similarTrackIds = recommendationService.findSimilarTracks(_trackIds, _radioCandidatePoolSize);
+
+	Random::shuffleContainer(similarTrackIds);
+	for (const Database::TrackId trackId : similarTrackIds)
+	{
+		if (_radioCandidates.size() >= _radioCandidatePoolSize)
+			break;
+
+		if (excludedTrackIds.insert(trackId).second)
+			_radioCandidates.push_back(trackId);
+	}
+}
+
 std::optional<float>
 PlayQueue::getReplayGain(std::size_t pos, const Database::Track::pointer& track) const
 {
@@ -545,11 +591,8 @@ PlayQueue::getReplayGain(std::size_t pos, const Database::Track::pointer& track)
 
 		case MediaPlayer::Settings::ReplayGain::Mode::Auto:
 		{
-			const auto trackList {getTrackList()};
-			const auto prevEntry {pos > 0 ? trackList->getEntry(pos - 1) : Database::TrackListEntry::pointer {}};
-			const auto nextEntry {trackList->getEntry(pos + 1)};
-			const Database::Track::pointer prevTrack {prevEntry ? prevEntry->getTrack() : Database::Track::pointer {}};
-			const Database::Track::pointer nextTrack {nextEntry ? nextEntry->getTrack() : Database::Track::pointer {}};
+			const Database::Track::pointer prevTrack {pos > 0 ? Database::Track::find(LmsApp->getDbSession(), _trackIds[pos - 1]) : Database::Track::pointer {}};
+			const Database::Track::pointer nextTrack {pos + 1 < _trackIds.size() ? Database::Track::find(LmsApp->getDbSession(), _trackIds[pos + 1]) : Database::Track::pointer {}};
 
 			if ((prevTrack && prevTrack->getRelease() && prevTrack->getRelease() == track->getRelease())
 				||
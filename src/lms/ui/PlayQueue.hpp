@@ -19,31 +19,30 @@
 
 #pragma once
 
+#include <deque>
+#include <memory>
 #include <optional>
+#include <vector>
 
 #include <Wt/WContainerWidget.h>
 #include <Wt/WTemplate.h>
 #include <Wt/WText.h>
 
 #include "services/database/Object.hpp"
-#include "services/database/TrackListId.hpp"
+#include "services/database/Track.hpp"
+#include "services/database/TrackId.hpp"
 #include "PlayQueueAction.hpp"
 
-namespace Similarity
-{
-	class Finder;
-}
-
 namespace Database
 {
+	class Artist;
 	class Track;
-	class TrackList;
-	class TrackListEntry;
 }
 
 namespace UserInterface {
 
 class InfiniteScrollingContainer;
+class PlayQueueStore;
 
 class PlayQueue : public Wt::WTemplate
 {
@@ -64,15 +63,22 @@ class PlayQueue : public Wt::WTemplate
 		// Signal emitted when track is unselected (has to be stopped)
 		Wt::Signal<> trackUnselected;
 
+		// Signal emitted with the next tracks to be played, as many as wanted by the media player, before trackSelected
+		Wt::Signal<const std::vector<Database::TrackId>&> upcomingTracksSelected;
+
 	private:
-		Database::ObjectPtr<Database::TrackList> getTrackList() const;
+		static PlayQueueStore& getPlayQueueStore();
+		void saveQueue(); // the in memory queue is the reference, writes are coalesced by the store
 		bool isFull() const;
 
 		void clearTracks();
 		std::size_t enqueueTracks(const std::vector<Database::TrackId>& trackIds);
 		void addSome();
-		void addEntry(const Database::ObjectPtr<Database::TrackListEntry>& entry);
+		void addSomePrevious();
+		std::vector<std::unique_ptr<Wt::WTemplate>> createEntries(std::size_t offset, std::size_t count);
+		std::unique_ptr<Wt::WTemplate> createEntry(const Database::Track::ListEntryResult& track);
 		void enqueueRadioTracks();
+		void refillRadioCandidates();
 		void updateInfo();
 		void updateCurrentTrack(bool selected);
 		void updateRepeatBtn();
@@ -81,22 +87,26 @@ class PlayQueue : public Wt::WTemplate
 		void loadTrack(std::size_t pos, bool play);
 		void stop();
 
-		void addRadioTrackFromSimilarity(std::shared_ptr<Similarity::Finder> similarityFinder);
-		void addRadioTrackFromClusters();
 		std::optional<float> getReplayGain(std::size_t pos, const Database::ObjectPtr<Database::Track>& track) const;
 
 		static inline constexpr std::size_t _nbMaxEntries {1000};
 		static inline constexpr std::size_t _batchSize {12};
+		static inline constexpr std::size_t _maxDisplayedEntryCount {_batchSize * 5}; // older entries are removed when scrolling
+		static inline constexpr std::size_t _radioTrackCount {3}; // tracks added each time the queue runs out
+		static inline constexpr std::size_t _radioCandidatePoolSize {30};
+		static inline constexpr std::size_t _radioSeedTrackCount {5}; // last tracks of the queue used to refill the candidates
 
 		bool _repeatAll {};
 		bool _radioMode {};
 		bool _mediaPlayerSettingsLoaded {};
-		Database::TrackListId _tracklistId {};
+		bool _persisted {};
+		std::vector<Database::TrackId> _trackIds; // whole queue
 		InfiniteScrollingContainer* _entriesContainer {};
 		Wt::WText* _nbTracks {};
 		Wt::WText* _repeatBtn {};
 		Wt::WText* _radioBtn {};
 		std::optional<std::size_t> _trackPos;	// current track position, if set
+		std::deque<Database::TrackId> _radioCandidates; // next radio tracks, not in the queue when computed
 };
 
 } // namespace UserInterface
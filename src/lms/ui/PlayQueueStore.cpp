@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PlayQueueStore.hpp"
+
+#include <boost/asio/post.hpp>
+
+#include "services/database/Db.hpp"
+#include "services/database/Session.hpp"
+#include "services/database/TrackList.hpp"
+#include "services/database/User.hpp"
+#include "utils/Logger.hpp"
+
+namespace UserInterface
+{
+	namespace
+	{
+		const std::string queuedListName {"__queued_tracks__"};
+	}
+
+	PlayQueueStore::PlayQueueStore(Database::Db& db, std::chrono::seconds flushPeriod)
+		: _db {db}
+		, _flushPeriod {flushPeriod}
+	{
+		LMS_LOG(UI, INFO) << "Play queue flush period = " << _flushPeriod.count() << "s";
+
+		_ioService.setThreadCount(1);
+		_ioService.start();
+	}
+
+	PlayQueueStore::~PlayQueueStore()
+	{
+		{
+			std::scoped_lock lock {_mutex};
+			_flushTimer.cancel();
+		}
+		_ioService.stop();
+
+		flush();
+	}
+
+	PlayQueueStore::PlayQueue
+	PlayQueueStore::get(Database::UserId userId)
+	{
+		{
+			std::scoped_lock lock {_mutex};
+
+			auto it {_playQueues.find(userId)};
+			if (it != std::cend(_playQueues))
+				return it->second;
+		}
+
+		PlayQueue playQueue {load(userId)};
+
+		std::scoped_lock lock {_mutex};
+
+		// may have been saved in the meantime
+		auto [it, inserted] {_playQueues.try_emplace(userId, std::move(playQueue))};
+		return it->second;
+	}
+
+	void
+	PlayQueueStore::save(Database::UserId userId, PlayQueue playQueue)
+	{
+		std::scoped_lock lock {_mutex};
+
+		_playQueues[userId] = std::move(playQueue);
+		_dirtyUserIds.insert(userId);
+		scheduleFlush();
+	}
+
+	void
+	PlayQueueStore::saveCurrentIndex(Database::UserId userId, std::size_t currentIndex)
+	{
+		std::scoped_lock lock {_mutex};
+
+		// the queue is always loaded before being played
+		auto it {_playQueues.find(userId)};
+		if (it == std::end(_playQueues) || it->second.currentIndex == currentIndex)
+			return;
+
+		it->second.currentIndex = currentIndex;
+		_dirtyUserIds.insert(userId);
+		scheduleFlush();
+	}
+
+	void
+	PlayQueueStore::requestFlush()
+	{
+		boost::asio::post(_ioService, [this] { flush(); });
+	}
+
+	PlayQueueStore::PlayQueue
+	PlayQueueStore::load(Database::UserId userId)
+	{
+		Database::Session& session {_db.getTLSSession()};
+		auto transaction {session.createSharedTransaction()};
+
+		PlayQueue playQueue;
+
+		const Database::User::pointer user {Database::User::find(session, userId)};
+		if (!user)
+			return playQueue;
+
+		playQueue.currentIndex = user->getCurPlayingTrackPos();
+		if (const Database::TrackList::pointer trackList {Database::TrackList::find(session, queuedListName, Database::TrackList::Type::Internal, userId)})
+			playQueue.trackIds = trackList->getTrackIds();
+
+		return playQueue;
+	}
+
+	void
+	PlayQueueStore::scheduleFlush()
+	{
+		// must be called locked
+		if (_flushScheduled)
+			return;
+
+		_flushScheduled = true;
+		_flushTimer.expires_after(_flushPeriod);
+		_flushTimer.async_wait([this](const boost::system::error_code& ec)
+		{
+			if (ec)
+				return;
+
+			flush();
+		});
+	}
+
+	void
+	PlayQueueStore::flush()
+	{
+		std::vector<std::pair<Database::UserId, PlayQueue>> playQueues;
+		{
+			std::scoped_lock lock {_mutex};
+
+			for (const Database::UserId userId : _dirtyUserIds)
+				playQueues.emplace_back(userId, _playQueues[userId]);
+
+			_dirtyUserIds.clear();
+			_flushScheduled = false;
+			_flushTimer.cancel();
+		}
+
+		if (playQueues.empty())
+			return;
+
+		LMS_LOG(UI, DEBUG) << "Flushing " << playQueues.size() << " play queue(s)";
+
+		try
+		{
+			Database::Session& session {_db.getTLSSession()};
+			auto transaction {session.createUniqueTransaction()};
+
+			for (const auto& [userId, playQueue] : playQueues)
+			{
+				Database::User::pointer user {Database::User::find(session, userId)};
+				if (!user)
+					continue;
+
+				Database::TrackList::pointer trackList {Database::TrackList::find(session, queuedListName, Database::TrackList::Type::Internal, userId)};
+				if (!trackList)
+					trackList = Database::TrackList::create(session, queuedListName, Database::TrackList::Type::Internal, false, user);
+
+				// tracks removed since the queue was saved are skipped
+				trackList.modify()->clear();
+				Database::TrackListEntry::create(session, playQueue.trackIds, trackList);
+
+				user.modify()->setCurPlayingTrackPos(playQueue.currentIndex);
+			}
+		}
+		catch (const std::exception& e)
+		{
+			LMS_LOG(UI, ERROR) << "Cannot flush play queues: " << e.what();
+		}
+	}
+} // namespace UserInterface
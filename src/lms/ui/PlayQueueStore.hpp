@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/asio/steady_timer.hpp>
+#include <Wt/WIOService.h>
+
+#include "services/database/TrackId.hpp"
+#include "services/database/UserId.hpp"
+
+namespace Database
+{
+	class Db;
+}
+
+namespace UserInterface
+{
+	// Per user web play queues, kept in memory and persisted asynchronously
+	// Queue changes are coalesced: they are written at most once per flush period, or when requested (session end)
+	class PlayQueueStore
+	{
+		public:
+			struct PlayQueue
+			{
+				std::vector<Database::TrackId>	trackIds;
+				std::size_t						currentIndex {};
+			};
+
+			PlayQueueStore(Database::Db& db, std::chrono::seconds flushPeriod);
+			~PlayQueueStore();	// pending changes are flushed
+
+			PlayQueueStore(const PlayQueueStore&) = delete;
+			PlayQueueStore(PlayQueueStore&&) = delete;
+			PlayQueueStore& operator=(const PlayQueueStore&) = delete;
+			PlayQueueStore& operator=(PlayQueueStore&&) = delete;
+
+			// Loaded from the database on first access
+			PlayQueue	get(Database::UserId userId);
+			// Never waits for the database write lock
+			void		save(Database::UserId userId, PlayQueue playQueue);
+			void		saveCurrentIndex(Database::UserId userId, std::size_t currentIndex);
+			// Asynchronously writes the pending changes now
+			void		requestFlush();
+
+		private:
+			PlayQueue load(Database::UserId userId);
+			void scheduleFlush();
+			void flush();
+
+			Database::Db&				_db;
+			const std::chrono::seconds	_flushPeriod;
+			Wt::WIOService				_ioService;
+			boost::asio::steady_timer	_flushTimer {_ioService};
+
+			std::mutex		_mutex;
+			std::unordered_map<Database::UserId, PlayQueue>	_playQueues;
+			std::unordered_set<Database::UserId>	_dirtyUserIds;
+			bool			_flushScheduled {};
+	};
+} // namespace UserInterface
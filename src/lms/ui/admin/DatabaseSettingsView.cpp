@@ -19,18 +19,32 @@
 
 #include "DatabaseSettingsView.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <optional>
+
+#include <Wt/Http/Response.h>
 #include <Wt/WComboBox.h>
 #include <Wt/WFormModel.h>
 #include <Wt/WLineEdit.h>
 #include <Wt/WPushButton.h>
+#include <Wt/WResource.h>
 #include <Wt/WString.h>
 #include <Wt/WTemplateFormView.h>
+#include <Wt/WTextArea.h>
+#include <Wt/WText.h>
+#include <Wt/WTimer.h>
 
 #include "services/database/Cluster.hpp"
+#include "services/database/Db.hpp"
+#include "services/database/MediaRoot.hpp"
 #include "services/database/ScanSettings.hpp"
 #include "services/database/Session.hpp"
 #include "services/scanner/IScannerService.hpp"
+#include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Profiling.hpp"
 #include "utils/Service.hpp"
 #include "utils/String.hpp"
 
@@ -39,17 +53,243 @@
 #include "common/ValueStringModel.hpp"
 #include "ScannerController.hpp"
 #include "LmsApplication.hpp"
+#include "LmsApplicationManager.hpp"
 
 namespace UserInterface {
 
 using namespace Database;
 
 
+class DbStatsResource : public Wt::WResource
+{
+	public:
+		DbStatsResource(const DbStats& stats)
+		: _stats {stats}
+		{
+			suggestFileName("db-stats.txt");
+		}
+
+		~DbStatsResource()
+		{
+			beingDeleted();
+		}
+
+		void handleRequest(const Wt::Http::Request&, Wt::Http::Response& response)
+		{
+			response.setMimeType("text/plain");
+
+			response.out() << "Shared locks: count = " << _stats.sharedLocks.count << ", total wait = " << _stats.sharedLocks.totalWaitDuration.count() << " us, p99 wait = " << _stats.sharedLocks.p99WaitDuration.count() << " us" << std::endl;
+			response.out() << "Unique locks: count = " << _stats.uniqueLocks.count << ", total wait = " << _stats.uniqueLocks.totalWaitDuration.count() << " us, p99 wait = " << _stats.uniqueLocks.p99WaitDuration.count() << " us" << std::endl;
+			response.out() << std::endl;
+
+			response.out() << "total (us)\tcount\tp99 (us)\trows\tquery" << std::endl;
+			for (const QueryStats& query : _stats.queries)
+				response.out() << query.totalDuration.count() << '\t' << query.count << '\t' << query.p99Duration.count() << '\t' << query.rowCount << '\t' << query.sql << '\n';
+		}
+
+	private:
+		const DbStats _stats;
+};
+
+// Computed when requested
+class ApplicationStatsResource : public Wt::WResource
+{
+	public:
+		ApplicationStatsResource(const LmsApplicationManager& appManager)
+		: _appManager {appManager}
+		{
+			suggestFileName("session-stats.txt");
+		}
+
+		~ApplicationStatsResource()
+		{
+			beingDeleted();
+		}
+
+		void handleRequest(const Wt::Http::Request&, Wt::Http::Response& response)
+		{
+			response.setMimeType("text/plain");
+
+			const std::vector<LmsApplicationManager::ApplicationStats> stats {_appManager.getApplicationStats()};
+
+			std::size_t totalMemoryUsage {};
+			for (const LmsApplicationManager::ApplicationStats& applicationStats : stats)
+				totalMemoryUsage += applicationStats.estimatedMemoryUsage;
+
+			response.out() << "Sessions: " << stats.size() << ", estimated memory usage = " << totalMemoryUsage / 1024 << " KiB" << std::endl;
+			response.out() << std::endl;
+
+			response.out() << "user id	idle (s)	displayed entries	estimated memory (KiB)	trimmed" << std::endl;
+			for (const LmsApplicationManager::ApplicationStats& applicationStats : stats)
+			{
+				response.out() << applicationStats.userId.toString() << '\t' << applicationStats.idleDuration.count() << '\t' << applicationStats.displayedEntryCount
+					<< '\t' << applicationStats.estimatedMemoryUsage / 1024 << '\t' << (applicationStats.trimmed ? "yes" : "no") << '\n';
+			}
+		}
+
+	private:
+		const LmsApplicationManager& _appManager;
+};
+
+// Captured when requested, the server keeps handling the other requests meanwhile
+// Duration can be set using the 'duration' parameter, in seconds
+class CpuProfileResource : public Wt::WResource
+{
+	public:
+		CpuProfileResource()
+		{
+			suggestFileName("cpu-profile.txt");
+		}
+
+		~CpuProfileResource()
+		{
+			beingDeleted();
+		}
+
+		void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
+		{
+			std::chrono::seconds duration {_defaultDuration};
+			if (const std::string* durationParameter {request.getParameter("duration")})
+			{
+				if (const std::optional<std::size_t> value {StringUtils::readAs<std::size_t>(*durationParameter)})
+					duration = std::chrono::seconds {std::clamp<std::size_t>(*value, 1, _maxDuration.count())};
+			}
+
+			LMS_LOG(UI, INFO) << "Capturing CPU profile for " << duration.count() << " seconds...";
+			const Profiling::CpuProfile profile {Profiling::captureCpuProfile(duration)};
+			LMS_LOG(UI, INFO) << "CPU profile captured!";
+
+			response.setMimeType("text/plain");
+
+			std::chrono::microseconds labelledCpuTime {};
+			for (const Profiling::CpuProfile::Entry& entry : profile.entries)
+				labelledCpuTime += entry.cpuTime;
+
+			response.out() << "Duration = " << profile.duration.count() / 1000 << " ms, process CPU time = " << profile.processCpuTime.count() / 1000 << " ms, labelled threads CPU time = " << labelledCpuTime.count() / 1000 << " ms" << std::endl;
+			response.out() << std::endl;
+
+			response.out() << "CPU time (ms)\t%\tlabel" << std::endl;
+			for (const Profiling::CpuProfile::Entry& entry : profile.entries)
+			{
+				const double percent {profile.processCpuTime.count() > 0 ? 100. * entry.cpuTime.count() / profile.processCpuTime.count() : 0.};
+				response.out() << entry.cpuTime.count() / 1000 << '\t' << std::fixed << std::setprecision(1) << percent << '\t' << entry.label << '\n';
+			}
+		}
+
+	private:
+		static constexpr std::chrono::seconds _defaultDuration {10};
+		static constexpr std::chrono::seconds _maxDuration {60};
+};
+
+class HeapInfoResource : public Wt::WResource
+{
+	public:
+		HeapInfoResource()
+		{
+			suggestFileName("heap-info.xml");
+		}
+
+		~HeapInfoResource()
+		{
+			beingDeleted();
+		}
+
+		void handleRequest(const Wt::Http::Request&, Wt::Http::Response& response)
+		{
+			response.setMimeType("text/xml");
+			response.out() << Profiling::getHeapInfo();
+		}
+};
+
+// One media root per line: "directory", or "directory | .ext1 .ext2" to override the audio file extensions
+static
+std::vector<ScanSettings::MediaRootInfo>
+parseMediaRoots(const std::string& str)
+{
+	std::vector<ScanSettings::MediaRootInfo> res;
+
+	for (std::string_view line : StringUtils::splitString(str, "\n"))
+	{
+		const auto fields {StringUtils::splitString(line, "|")};
+		if (fields.empty())
+			continue;
+
+		ScanSettings::MediaRootInfo mediaRootInfo;
+		mediaRootInfo.directory = StringUtils::stringTrim(fields.front(), " \t\r");
+		if (mediaRootInfo.directory.empty())
+			continue;
+
+		if (fields.size() > 1)
+		{
+			for (std::string_view extension : StringUtils::splitString(fields[1], " \t\r"))
+			{
+				if (!extension.empty())
+					mediaRootInfo.audioFileExtensions.emplace_back(extension);
+			}
+		}
+
+		res.emplace_back(std::move(mediaRootInfo));
+	}
+
+	return res;
+}
+
+static
+std::string
+formatMediaRoots(const std::vector<MediaRoot::pointer>& mediaRoots)
+{
+	std::vector<std::string> lines;
+	for (const MediaRoot::pointer& mediaRoot : mediaRoots)
+	{
+		std::string line {mediaRoot->getDirectory().string()};
+
+		const auto extensions {mediaRoot->getAudioFileExtensions()};
+		if (!extensions.empty())
+		{
+			line += " |";
+			for (const std::filesystem::path& extension : extensions)
+				line += " " + extension.string();
+		}
+
+		lines.emplace_back(std::move(line));
+	}
+
+	return StringUtils::joinStrings(lines, "\n");
+}
+
+class MediaRootsValidator : public Wt::WValidator
+{
+	public:
+		MediaRootsValidator()
+		{
+			setMandatory(true);
+		}
+
+		Wt::WValidator::Result validate(const Wt::WString& input) const override
+		{
+			const std::vector<ScanSettings::MediaRootInfo> mediaRoots {parseMediaRoots(input.toUTF8())};
+			if (mediaRoots.empty())
+				return Wt::WValidator::validate({});
+
+			for (const ScanSettings::MediaRootInfo& mediaRoot : mediaRoots)
+			{
+				const Wt::WValidator::Result result {_directoryValidator->validate(mediaRoot.directory.string())};
+				if (result.state() != Wt::ValidationState::Valid)
+					return result;
+			}
+
+			return Wt::WValidator::Result {Wt::ValidationState::Valid};
+		}
+
+	private:
+		const std::shared_ptr<Wt::WValidator> _directoryValidator {createDirectoryValidator()};
+};
+
 class DatabaseSettingsModel : public Wt::WFormModel
 {
 	public:
 		// Associate each field with a unique string literal.
-		static inline constexpr Field MediaDirectoryField {"media-directory"};
+		static inline constexpr Field MediaRootsField {"media-roots"};
 		static inline constexpr Field UpdatePeriodField {"update-period"};
 		static inline constexpr Field UpdateStartTimeField {"update-start-time"};
 		static inline constexpr Field RecommendationEngineTypeField {"recommendation-engine-type"};
@@ -61,15 +301,13 @@ class DatabaseSettingsModel : public Wt::WFormModel
 		{
 			initializeModels();
 
-			addField(MediaDirectoryField);
+			addField(MediaRootsField);
 			addField(UpdatePeriodField);
 			addField(UpdateStartTimeField);
 			addField(RecommendationEngineTypeField);
 			addField(TagsField);
 
-			auto dirValidator {createDirectoryValidator()};
-			dirValidator->setMandatory(true);
-			setValidator(MediaDirectoryField, dirValidator);
+			setValidator(MediaRootsField, std::make_shared<MediaRootsValidator>());
 
 			setValidator(UpdatePeriodField, createMandatoryValidator());
 			setValidator(UpdateStartTimeField, createMandatoryValidator());
@@ -90,7 +328,7 @@ class DatabaseSettingsModel : public Wt::WFormModel
 
 			const ScanSettings::pointer scanSettings {ScanSettings::get(LmsApp->getDbSession())};
 
-			setValue(MediaDirectoryField, scanSettings->getMediaDirectory().string());
+			setValue(MediaRootsField, formatMediaRoots(scanSettings->getMediaRoots()));
 
 			auto periodRow {_updatePeriodModel->getRowFromValue(scanSettings->getUpdatePeriod())};
 			if (periodRow)
@@ -125,7 +363,7 @@ class DatabaseSettingsModel : public Wt::WFormModel
 
 			ScanSettings::pointer scanSettings {ScanSettings::get(LmsApp->getDbSession())};
 
-			scanSettings.modify()->setMediaDirectory(valueText(MediaDirectoryField).toUTF8());
+			scanSettings.modify()->setMediaRoots(LmsApp->getDbSession(), parseMediaRoots(valueText(MediaRootsField).toUTF8()));
 
 			auto updatePeriodRow {_updatePeriodModel->getRowFromString(valueText(UpdatePeriodField))};
 			if (updatePeriodRow)
@@ -169,6 +407,7 @@ class DatabaseSettingsModel : public Wt::WFormModel
 			_recommendationEngineTypeModel = std::make_shared<ValueStringModel<ScanSettings::RecommendationEngineType>>();
 			_recommendationEngineTypeModel->add(Wt::WString::tr("Lms.Admin.Database.recommendation-engine-type.clusters"), ScanSettings::RecommendationEngineType::Clusters);
 			_recommendationEngineTypeModel->add(Wt::WString::tr("Lms.Admin.Database.recommendation-engine-type.features"), ScanSettings::RecommendationEngineType::Features);
+			_recommendationEngineTypeModel->add(Wt::WString::tr("Lms.Admin.Database.recommendation-engine-type.hnsw"), ScanSettings::RecommendationEngineType::Hnsw);
 		}
 
 		std::shared_ptr<UpdatePeriodModel>											_updatePeriodModel;
@@ -176,6 +415,26 @@ class DatabaseSettingsModel : public Wt::WFormModel
 		std::shared_ptr<ValueStringModel<ScanSettings::RecommendationEngineType>>	_recommendationEngineTypeModel;
 };
 
+static
+Wt::WString
+backupStatusToString(const std::optional<DbBackupStatus>& status)
+{
+	if (!status)
+		return Wt::WString::tr("Lms.Admin.Database.backup-none");
+
+	switch (status->state)
+	{
+		case DbBackupStatus::State::InProgress:
+			return Wt::WString::tr("Lms.Admin.Database.backup-in-progress").arg(status->totalPageCount ? status->copiedPageCount * 100 / status->totalPageCount : 0);
+		case DbBackupStatus::State::Complete:
+			return Wt::WString::tr("Lms.Admin.Database.backup-complete").arg(status->backupPath.string());
+		case DbBackupStatus::State::Failed:
+			return Wt::WString::tr("Lms.Admin.Database.backup-failed").arg(status->error);
+	}
+
+	return {};
+}
+
 DatabaseSettingsView::DatabaseSettingsView()
 {
 	wApp->internalPathChanged().connect(this, [this]
@@ -197,8 +456,8 @@ DatabaseSettingsView::refreshView()
 	auto t {addNew<Wt::WTemplateFormView>(Wt::WString::tr("Lms.Admin.Database.template"))};
 	auto model {std::make_shared<DatabaseSettingsModel>()};
 
-	// Media Directory
-	t->setFormWidget(DatabaseSettingsModel::MediaDirectoryField, std::make_unique<Wt::WLineEdit>());
+	// Media roots
+	t->setFormWidget(DatabaseSettingsModel::MediaRootsField, std::make_unique<Wt::WTextArea>());
 
 	// Update Period
 	auto updatePeriod {std::make_unique<Wt::WComboBox>()};
@@ -232,6 +491,75 @@ DatabaseSettingsView::refreshView()
 
 	t->bindNew<ScannerController>("scanner-controller");
 
+	if (const std::optional<DbStats> dbStats {LmsApp->getDbSession().getDb().getStats()})
+	{
+		t->setCondition("if-db-stats", true);
+		Wt::WPushButton* dbStatsBtn {t->bindNew<Wt::WPushButton>("db-stats-btn", Wt::WString::tr("Lms.Admin.Database.get-db-stats"))};
+
+		Wt::WLink link {std::make_shared<DbStatsResource>(*dbStats)};
+		link.setTarget(Wt::LinkTarget::NewWindow);
+		dbStatsBtn->setLink(link);
+	}
+
+	{
+		Wt::WPushButton* sessionStatsBtn {t->bindNew<Wt::WPushButton>("session-stats-btn", Wt::WString::tr("Lms.Admin.Database.get-session-stats"))};
+
+		Wt::WLink link {std::make_shared<ApplicationStatsResource>(LmsApp->getApplicationManager())};
+		link.setTarget(Wt::LinkTarget::NewWindow);
+		sessionStatsBtn->setLink(link);
+	}
+
+	{
+		Wt::WPushButton* cpuProfileBtn {t->bindNew<Wt::WPushButton>("cpu-profile-btn", Wt::WString::tr("Lms.Admin.Database.get-cpu-profile"))};
+
+		Wt::WLink link {std::make_shared<CpuProfileResource>()};
+		link.setTarget(Wt::LinkTarget::NewWindow);
+		cpuProfileBtn->setLink(link);
+	}
+
+	{
+		Wt::WPushButton* heapInfoBtn {t->bindNew<Wt::WPushButton>("heap-info-btn", Wt::WString::tr("Lms.Admin.Database.get-heap-info"))};
+
+		Wt::WLink link {std::make_shared<HeapInfoResource>()};
+		link.setTarget(Wt::LinkTarget::NewWindow);
+		heapInfoBtn->setLink(link);
+	}
+
+	// Database backup
+	{
+		Wt::WPushButton* backupBtn {t->bindNew<Wt::WPushButton>("backup-btn", Wt::WString::tr("Lms.Admin.Database.backup-now"))};
+		backupBtn->setEnabled(LmsApp->getDbSession().getDb().isSQLiteApiUsable());
+		Wt::WText* backupStatus {t->bindNew<Wt::WText>("backup-status")};
+
+		Wt::WTimer* backupStatusTimer {t->addChild(std::make_unique<Wt::WTimer>())};
+		backupStatusTimer->setInterval(std::chrono::seconds {1});
+
+		auto refreshBackupStatus {[=]
+		{
+			const std::optional<DbBackupStatus> status {LmsApp->getDbSession().getDb().getBackupStatus()};
+			backupStatus->setText(backupStatusToString(status));
+
+			if (status && status->state == DbBackupStatus::State::InProgress)
+				backupStatusTimer->start();
+			else
+				backupStatusTimer->stop();
+		}};
+		backupStatusTimer->timeout().connect(refreshBackupStatus);
+
+		backupBtn->clicked().connect([=]
+		{
+			const std::filesystem::path backupPath {Service<IConfig>::get()->getPath("db-backup-file", Service<IConfig>::get()->getPath("working-dir") / "lms.db.backup")};
+			if (LmsApp->getDbSession().getDb().startBackup(backupPath))
+				LmsApp->notifyMsg(LmsApplication::MsgType::Info, Wt::WString::tr("Lms.Admin.Database.backup-launched"));
+			else
+				LmsApp->notifyMsg(LmsApplication::MsgType::Warning, Wt::WString::tr("Lms.Admin.Database.backup-already-in-progress"));
+
+			refreshBackupStatus();
+		});
+
+		refreshBackupStatus();
+	}
+
 	saveBtn->clicked().connect([=]
 	{
 		t->updateModel(model.get());
@@ -53,6 +53,24 @@ durationToString(const Wt::WDateTime& begin, const Wt::WDateTime& end)
 	return oss.str();
 }
 
+static
+std::string
+durationToString(std::chrono::milliseconds duration)
+{
+	const Wt::WDateTime begin {Wt::WDateTime::fromTime_t(0)};
+	return durationToString(begin, begin.addMSecs(duration.count()));
+}
+
+static
+std::string
+latencyToString(std::chrono::microseconds latency)
+{
+	std::ostringstream oss;
+	oss << std::fixed << std::setprecision(1) << latency.count() / 1000.;
+
+	return oss.str();
+}
+
 
 class ReportResource : public Wt::WResource
 {
@@ -113,6 +131,7 @@ class ReportResource : public Wt::WResource
 				case Scanner::ScanErrorType::CannotParseFile: return Wt::WString::tr("Lms.Admin.ScannerController.cannot-parse-file");
 				case Scanner::ScanErrorType::NoAudioTrack: return Wt::WString::tr("Lms.Admin.ScannerController.no-audio-track");
 				case Scanner::ScanErrorType::BadDuration: return Wt::WString::tr("Lms.Admin.ScannerController.bad-duration");
+				case Scanner::ScanErrorType::CannotWriteDatabase: return Wt::WString::tr("Lms.Admin.ScannerController.cannot-write-database");
 			}
 			return "?";
 		}
@@ -147,10 +166,17 @@ ScannerController::ScannerController()
 	LmsApp->getScannerEvents().scanComplete.connect(this, onDbEvent);
 	LmsApp->getScannerEvents().scanInProgress.connect(this, onDbEvent);
 	LmsApp->getScannerEvents().scanScheduled.connect(this, onDbEvent);
+	LmsApp->setScanInProgressListened(true);
 
 	refreshContents();
 }
 
+ScannerController::~ScannerController()
+{
+	if (LmsApp)
+		LmsApp->setScanInProgressListened(false);
+}
+
 void
 ScannerController::refreshContents()
 {
@@ -187,6 +213,21 @@ ScannerController::refreshContents()
 				.arg(status.lastCompleteScanStats->duplicates.size())
 			  );
 
+		const ScanStats& stats {*status.lastCompleteScanStats};
+		bindString("last-scan-metrics", Wt::WString::tr("Lms.Admin.ScannerController.last-scan-metrics")
+				.arg(durationToString(stats.getStepDuration(ScanProgressStep::DiscoveringFiles)))
+				.arg(durationToString(stats.getStepDuration(ScanProgressStep::ChekingForMissingFiles)))
+				.arg(durationToString(stats.getStepDuration(ScanProgressStep::ScanningFiles)))
+				.arg(static_cast<int>(stats.getScanRate()))
+				.arg(static_cast<int>(stats.bytesScanned / (1024 * 1024)))
+				.arg(durationToString(stats.getStepDuration(ScanProgressStep::FetchingTrackFeatures)))
+				.arg(durationToString(stats.getStepDuration(ScanProgressStep::ReloadingSimilarityEngine)))
+				.arg(latencyToString(stats.parseDurations.getPercentile(50)))
+				.arg(latencyToString(stats.parseDurations.getPercentile(99)))
+				.arg(latencyToString(stats.writeDurations.getPercentile(50)))
+				.arg(latencyToString(stats.writeDurations.getPercentile(99)))
+			  );
+
 		Wt::WLink link {std::make_shared<ReportResource>(*status.lastCompleteScanStats)};
 		link.setTarget(Wt::LinkTarget::NewWindow);
 		reportBtn->setLink(link);
@@ -194,6 +235,7 @@ ScannerController::refreshContents()
 	else
 	{
 		bindString("last-scan", Wt::WString::tr("Lms.Admin.ScannerController.last-scan-not-available"));
+		bindEmpty("last-scan-metrics");
 		reportBtn->setEnabled(false);
 	}
 
@@ -233,6 +275,16 @@ ScannerController::refreshContents()
 						.arg(status.currentScanStepStats->progress()));
 					break;
 
+				case Scanner::ScanProgressStep::RemovingOrphanEntries:
+					bindString("step-status", Wt::WString::tr("Lms.Admin.ScannerController.step-removing-orphan-entries")
+						.arg(status.currentScanStepStats->progress()));
+					break;
+
+				case Scanner::ScanProgressStep::CheckingForDuplicates:
+					bindString("step-status", Wt::WString::tr("Lms.Admin.ScannerController.step-checking-for-duplicates")
+						.arg(status.currentScanStepStats->processedElems));
+					break;
+
 				case Scanner::ScanProgressStep::FetchingTrackFeatures:
 					bindString("step-status", Wt::WString::tr("Lms.Admin.ScannerController.step-fetching-track-features")
 						.arg(status.currentScanStepStats->processedElems)
@@ -243,6 +295,18 @@ ScannerController::refreshContents()
 					bindString("step-status", Wt::WString::tr("Lms.Admin.ScannerController.step-reloading-similarity-engine")
 						.arg(status.currentScanStepStats->progress()));
 					break;
+				case Scanner::ScanProgressStep::GeneratingCovers:
+					bindString("step-status", Wt::WString::tr("Lms.Admin.ScannerController.step-generating-covers")
+						.arg(status.currentScanStepStats->processedElems)
+						.arg(status.currentScanStepStats->totalElems)
+						.arg(status.currentScanStepStats->progress()));
+					break;
+				case Scanner::ScanProgressStep::ReclaimingDatabaseSpace:
+					bindString("step-status", Wt::WString::tr("Lms.Admin.ScannerController.step-reclaiming-database-space")
+						.arg(status.currentScanStepStats->processedElems)
+						.arg(status.currentScanStepStats->totalElems)
+						.arg(status.currentScanStepStats->progress()));
+					break;
 			}
 			break;
 	}
@@ -28,6 +28,7 @@ namespace UserInterface
 	{
 		public:
 			ScannerController();
+			~ScannerController();
 
 		private:
 			void refreshContents();
@@ -19,65 +19,167 @@
 
 #include "InfiniteScrollingContainer.hpp"
 
+#include <cassert>
+
+#include "utils/IConfig.hpp"
+#include "utils/Service.hpp"
+
+#include "LmsApplication.hpp"
 #include "LoadingIndicator.hpp"
 
 namespace UserInterface
 {
-	InfiniteScrollingContainer::InfiniteScrollingContainer(const Wt::WString& text)
+	namespace
+	{
+		std::size_t
+		getPrefetchPageCount()
+		{
+			static const std::size_t prefetchPageCount {Service<IConfig>::get()->getULong("ui-prefetch-page-count", 1)};
+			return prefetchPageCount;
+		}
+	}
+
+	InfiniteScrollingContainer::InfiniteScrollingContainer(const Wt::WString& text, std::optional<std::size_t> maxDisplayedCount)
 		: Wt::WTemplate {text}
+		, _maxDisplayedCount {maxDisplayedCount}
+		, _maxPrefetchedPageCount {maxDisplayedCount ? 0 : getPrefetchPageCount()}
 		, _elements {bindNew<Wt::WContainerWidget>("elements")}
 		, _loadingIndicator {bindWidget<Wt::WTemplate>("loading-indicator", createLoadingIndicator())}
 	{
 		hideLoadingIndicator();
+		hidePreviousLoadingIndicator();
+	}
+
+	InfiniteScrollingContainer::~InfiniteScrollingContainer()
+	{
+		if (LmsApp)
+			LmsApp->updateDisplayedEntryCount(-static_cast<std::ptrdiff_t>(_reportedCount));
 	}
 
 	void
 	InfiniteScrollingContainer::clear()
 	{
 		_elements->clear();
+		_prefetchedPages.clear();
+		_prefetchedElementCount = 0;
+		_firstIndex = 0;
 		hideLoadingIndicator();
+		hidePreviousLoadingIndicator();
+		reportCount();
 	}
 
 	std::size_t
 	InfiniteScrollingContainer::getCount()
 	{
-		return _elements->count();
+		return _elements->count() + _prefetchedElementCount;
 	}
 
 	void
 	InfiniteScrollingContainer::add(std::unique_ptr<Wt::WWidget> result)
 	{
-		return _elements->addWidget(std::move(result));
+		if (_prefetching)
+		{
+			_prefetchedPages.back().elements.push_back(std::move(result));
+			_prefetchedElementCount++;
+			reportCount();
+			return;
+		}
+
+		_elements->addWidget(std::move(result));
+
+		if (_maxDisplayedCount && static_cast<std::size_t>(_elements->count()) > *_maxDisplayedCount)
+		{
+			_elements->removeWidget(_elements->widget(0));
+			_firstIndex++;
+
+			if (!_previousLoadingIndicator)
+				displayPreviousLoadingIndicator();
+		}
+
+		reportCount();
+	}
+
+	void
+	InfiniteScrollingContainer::addFront(std::unique_ptr<Wt::WWidget> result)
+	{
+		assert(_firstIndex > 0);
+
+		_elements->insertWidget(0, std::move(result));
+		_firstIndex--;
+
+		if (_maxDisplayedCount && static_cast<std::size_t>(_elements->count()) > *_maxDisplayedCount)
+		{
+			_elements->removeWidget(_elements->widget(_elements->count() - 1));
+
+			if (!_loadingIndicator)
+				displayLoadingIndicator();
+		}
+
+		reportCount();
 	}
 
 	void
 	InfiniteScrollingContainer::setHasMore(bool hasMore)
 	{
+		if (_prefetching)
+		{
+			_prefetchedPages.back().hasMore = hasMore;
+			return;
+		}
+
 		if (hasMore)
+		{
 			displayLoadingIndicator();
+			schedulePrefetch();
+		}
 		else
 			hideLoadingIndicator();
 	}
 
+	void
+	InfiniteScrollingContainer::setHasPrevious(bool hasPrevious)
+	{
+		if (hasPrevious)
+			displayPreviousLoadingIndicator();
+		else
+			hidePreviousLoadingIndicator();
+	}
+
 	void
 	InfiniteScrollingContainer::remove(Wt::WWidget& widget)
 	{
 		_elements->removeWidget(&widget);
+		reportCount();
 	}
 
 	Wt::WWidget*
 	InfiniteScrollingContainer::getWidget(std::size_t pos) const
 	{
-		return _elements->widget(pos);
+		if (pos < _firstIndex || pos - _firstIndex >= static_cast<std::size_t>(_elements->count()))
+			return nullptr;
+
+		return _elements->widget(pos - _firstIndex);
 	}
 
 	std::optional<std::size_t>
 	InfiniteScrollingContainer::getIndexOf(Wt::WWidget& widget) const
 	{
-		return _elements->indexOf(&widget);
+		const int index {_elements->indexOf(&widget)};
+		if (index < 0)
+			return std::nullopt;
+
+		return _firstIndex + index;
 	}
 
 
+	void
+	InfiniteScrollingContainer::reportCount()
+	{
+		const std::size_t count {getCount()};
+		LmsApp->updateDisplayedEntryCount(static_cast<std::ptrdiff_t>(count) - static_cast<std::ptrdiff_t>(_reportedCount));
+		_reportedCount = count;
+	}
+
 	void
 	InfiniteScrollingContainer::displayLoadingIndicator()
 	{
@@ -87,7 +189,7 @@ namespace UserInterface
 			if (!visible)
 				return;
 
-			onRequestElements.emit();
+			onLoadingIndicatorVisible();
 		});
 	}
 
@@ -98,4 +200,89 @@ namespace UserInterface
 		bindEmpty("loading-indicator");
 	}
 
+	void
+	InfiniteScrollingContainer::onLoadingIndicatorVisible()
+	{
+		if (_prefetchedPages.empty())
+		{
+			onRequestElements.emit();
+			return;
+		}
+
+		// render from the prefetched elements, without requesting the view
+		PrefetchedPage page {std::move(_prefetchedPages.front())};
+		_prefetchedPages.pop_front();
+		_prefetchedElementCount -= page.elements.size();
+
+		for (std::unique_ptr<Wt::WWidget>& element : page.elements)
+			_elements->addWidget(std::move(element));
+
+		setHasMore(page.hasMore);
+	}
+
+	void
+	InfiniteScrollingContainer::schedulePrefetch()
+	{
+		if (_prefetchScheduled
+			|| _prefetchedPages.size() >= _maxPrefetchedPageCount
+			|| (!_prefetchedPages.empty() && !_prefetchedPages.back().hasMore))
+		{
+			return;
+		}
+
+		// done after the current event is processed, so that the displayed page is not delayed
+		_prefetchScheduled = true;
+		LmsApp->post(bindSafe(&InfiniteScrollingContainer::prefetch));
+	}
+
+	void
+	InfiniteScrollingContainer::prefetch()
+	{
+		_prefetchScheduled = false;
+
+		// may have been cleared in the meantime
+		if (!_loadingIndicator)
+			return;
+
+		if (_prefetchedPages.size() >= _maxPrefetchedPageCount
+			|| (!_prefetchedPages.empty() && !_prefetchedPages.back().hasMore))
+		{
+			return;
+		}
+
+		_prefetchedPages.emplace_back();
+		_prefetching = true;
+		onRequestElements.emit();
+		_prefetching = false;
+
+		if (_prefetchedPages.back().elements.empty())
+		{
+			// nothing more, will be handled as usual when the loading indicator is visible
+			_prefetchedPages.pop_back();
+			return;
+		}
+
+		schedulePrefetch();
+	}
+
+	void
+	InfiniteScrollingContainer::displayPreviousLoadingIndicator()
+	{
+		_previousLoadingIndicator = bindWidget<Wt::WTemplate>("previous-loading-indicator", createLoadingIndicator());
+		_previousLoadingIndicator->scrollVisibilityChanged().connect([this](bool visible)
+		{
+			if (!visible)
+				return;
+
+			onRequestPreviousElements.emit();
+		});
+	}
+
+	void
+	InfiniteScrollingContainer::hidePreviousLoadingIndicator()
+	{
+		_previousLoadingIndicator = nullptr;
+		bindEmpty("previous-loading-indicator");
+	}
+
 }
@@ -19,8 +19,10 @@
 
 #pragma once
 
+#include <deque>
 #include <optional>
 #include <utility>
+#include <vector>
 
 #include <Wt/WContainerWidget.h>
 #include <Wt/WSignal.h>
@@ -33,16 +35,27 @@ namespace UserInterface
 	{
 		public:
 			// "text" must contain loading-indicator and "elements"
-			InfiniteScrollingContainer(const Wt::WString& text = Wt::WString::tr("Lms.infinite-scrolling-container"));
+			// If maxDisplayedCount is set, only a sliding window of elements is kept ("text" must then contain previous-loading-indicator)
+			// Positions are then relative to the whole list, not to the displayed elements
+			// Otherwise, the next pages are requested ahead of time (see ui-prefetch-page-count), and
+			// displayed when the loading indicator becomes visible
+			InfiniteScrollingContainer(const Wt::WString& text = Wt::WString::tr("Lms.infinite-scrolling-container"), std::optional<std::size_t> maxDisplayedCount = std::nullopt);
+			~InfiniteScrollingContainer();
 
 			void clear();
-			std::size_t getCount();
-			void add(std::unique_ptr<Wt::WWidget> result);
+			std::size_t getCount(); // displayed and prefetched elements
+			std::size_t getFirstIndex() const { return _firstIndex; } // position of the first displayed element
+			void add(std::unique_ptr<Wt::WWidget> result); // may remove the first displayed elements
+			void addFront(std::unique_ptr<Wt::WWidget> result); // may remove the last displayed elements
 
 			template<typename T, typename... Args>
 			T* addNew(Args&&... args)
 			{
-				return _elements->addNew<T>(std::forward<Args>(args)...);
+				auto widget {std::make_unique<T>(std::forward<Args>(args)...)};
+				T* res {widget.get()};
+				add(std::move(widget));
+
+				return res;
 			}
 
 			void remove(Wt::WWidget& widget);
@@ -51,14 +64,38 @@ namespace UserInterface
 			std::optional<std::size_t>	getIndexOf(Wt::WWidget& widget) const;
 
 			void setHasMore(bool hasMore);
+			void setHasPrevious(bool hasPrevious);
 
 			Wt::Signal<>	onRequestElements;
+			Wt::Signal<>	onRequestPreviousElements; // only used with a maxDisplayedCount
 
 		private:
 			void displayLoadingIndicator();
 			void hideLoadingIndicator();
+			void displayPreviousLoadingIndicator();
+			void hidePreviousLoadingIndicator();
+			void onLoadingIndicatorVisible();
+			void reportCount(); // to the application, for memory accounting
+			void schedulePrefetch();
+			void prefetch();
+
+			// elements added and hasMore set while onRequestElements is emitted by prefetch()
+			struct PrefetchedPage
+			{
+				std::vector<std::unique_ptr<Wt::WWidget>>	elements;
+				bool										hasMore {true};
+			};
 
+			const std::optional<std::size_t>	_maxDisplayedCount;
+			const std::size_t					_maxPrefetchedPageCount;
+			std::deque<PrefetchedPage>			_prefetchedPages;
+			std::size_t							_prefetchedElementCount {};
+			bool								_prefetching {};
+			bool								_prefetchScheduled {};
+			std::size_t							_reportedCount {};
+			std::size_t				_firstIndex {};
 			Wt::WContainerWidget*	_elements;
 			Wt::WTemplate*			_loadingIndicator;
+			Wt::WTemplate*			_previousLoadingIndicator {};
 	};
 }
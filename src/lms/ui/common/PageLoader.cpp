@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PageLoader.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "utils/IConfig.hpp"
+#include "utils/Service.hpp"
+
+namespace UserInterface
+{
+	namespace
+	{
+		class QueryPool
+		{
+			public:
+				QueryPool(std::size_t threadCount)
+				{
+					for (std::size_t i {}; i < threadCount; ++i)
+						_threads.emplace_back([this] { run(); });
+				}
+
+				~QueryPool()
+				{
+					{
+						std::scoped_lock lock {_mutex};
+						_stop = true;
+					}
+					_cv.notify_all();
+
+					for (std::thread& thread : _threads)
+						thread.join();
+				}
+
+				QueryPool(const QueryPool&) = delete;
+				QueryPool& operator=(const QueryPool&) = delete;
+
+				void post(std::function<void()> func)
+				{
+					{
+						std::scoped_lock lock {_mutex};
+						_pendingFuncs.push_back(std::move(func));
+					}
+					_cv.notify_one();
+				}
+
+			private:
+				void run()
+				{
+					while (true)
+					{
+						std::function<void()> func;
+						{
+							std::unique_lock lock {_mutex};
+							_cv.wait(lock, [this] { return _stop || !_pendingFuncs.empty(); });
+							if (_stop)
+								return;
+
+							func = std::move(_pendingFuncs.front());
+							_pendingFuncs.pop_front();
+						}
+
+						func();
+					}
+				}
+
+				std::mutex							_mutex;
+				std::condition_variable				_cv;
+				std::deque<std::function<void()>>	_pendingFuncs;
+				bool								_stop {};
+				std::vector<std::thread>			_threads;
+		};
+
+		// nullptr if the queries are run by the calling thread
+		QueryPool*
+		getQueryPool()
+		{
+			static const std::size_t threadCount {Service<IConfig>::get()->getULong("ui-page-loader-thread-count", 4)};
+			if (threadCount == 0)
+				return nullptr;
+
+			static QueryPool pool {threadCount};
+			return &pool;
+		}
+	}
+
+	struct PageLoader::Query
+	{
+		std::function<void()>	func; // must not throw
+		std::atomic<bool>		started {};
+		std::promise<void>		done;
+		std::future<void>		doneFuture {done.get_future()};
+
+		// run by the first caller only
+		void run()
+		{
+			if (started.exchange(true))
+				return;
+
+			func();
+			done.set_value();
+		}
+	};
+
+	PageLoader::~PageLoader()
+	{
+		// the queries may refer to the caller's data
+		wait();
+	}
+
+	void
+	PageLoader::addQuery(std::function<void()> func)
+	{
+		auto query {std::make_shared<Query>()};
+		query->func = std::move(func);
+		_queries.push_back(query);
+
+		if (QueryPool* pool {getQueryPool()})
+			pool->post([query] { query->run(); });
+	}
+
+	void
+	PageLoader::wait()
+	{
+		for (const std::shared_ptr<Query>& query : _queries)
+			query->run();
+
+		for (const std::shared_ptr<Query>& query : _queries)
+			query->doneFuture.wait();
+
+		_queries.clear();
+	}
+} // namespace UserInterface
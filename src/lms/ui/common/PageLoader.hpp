@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace UserInterface
+{
+	// Runs the independent queries needed to render a page concurrently, on a pool of threads shared by all the sessions
+	// Queries are run out of the application: they must use the database session of their thread (Db::getTLSSession)
+	// and return ids or plain values, never database objects
+	// While waiting, the calling thread runs the queries that are not started yet: a busy pool only makes pages slower
+	class PageLoader
+	{
+		public:
+			PageLoader() = default;
+			~PageLoader(); // waits for the started queries
+
+			PageLoader(const PageLoader&) = delete;
+			PageLoader(PageLoader&&) = delete;
+			PageLoader& operator=(const PageLoader&) = delete;
+			PageLoader& operator=(PageLoader&&) = delete;
+
+			// The query is started as soon as a thread is available, exceptions are reported by the future
+			template <typename Func>
+			std::future<std::invoke_result_t<Func>> add(Func func)
+			{
+				using Result = std::invoke_result_t<Func>;
+
+				auto task {std::make_shared<std::packaged_task<Result()>>(std::move(func))};
+				std::future<Result> res {task->get_future()};
+				addQuery([task] { (*task)(); });
+
+				return res;
+			}
+
+			// Returns once all the queries are complete
+			void wait();
+
+		private:
+			struct Query;
+			void addQuery(std::function<void()> func);
+
+			std::vector<std::shared_ptr<Query>> _queries;
+	};
+} // namespace UserInterface
@@ -91,6 +91,8 @@ namespace UserInterface
 				return Wt::WValidator::Result {Wt::ValidationState::Invalid, Wt::WString::tr("Lms.Settings.password-bad")};
 			case ::Auth::IPasswordService::CheckResult::State::Throttled:
 				return Wt::WValidator::Result {Wt::ValidationState::Invalid, Wt::WString::tr("Lms.password-client-throttled")};
+			case ::Auth::IPasswordService::CheckResult::State::Busy:
+				return Wt::WValidator::Result {Wt::ValidationState::Invalid, Wt::WString::tr("Lms.password-server-busy")};
 		}
 
 		throw LmsException {"InternalError"};
@@ -25,6 +25,7 @@
 #include "services/scrobbling/IScrobblingService.hpp"
 #include "utils/Service.hpp"
 #include "Filters.hpp"
+#include "LibrarySnapshot.hpp"
 #include "LmsApplication.hpp"
 
 namespace UserInterface
@@ -83,6 +84,12 @@ namespace UserInterface
 
 			case Mode::All:
 			{
+				if (const auto snapshot {LmsApp->getLibrarySnapshot()})
+				{
+					artists = snapshot->getArtists(getFilters().getClusterIds(), _linkType, range);
+					break;
+				}
+
 				Artist::FindParameters params;
 				params.setClusters(getFilters().getClusterIds());
 				params.setLinkType(_linkType);
@@ -107,6 +114,12 @@ namespace UserInterface
 
 		if (!_randomArtists)
 		{
+			if (const auto snapshot {LmsApp->getLibrarySnapshot()})
+			{
+				_randomArtists = snapshot->getRandomArtists(getFilters().getClusterIds(), _linkType, getMaxCount());
+				return _randomArtists->getSubRange(range);
+			}
+
 			Artist::FindParameters params;
 			params.setClusters(getFilters().getClusterIds());
 			params.setLinkType(_linkType);
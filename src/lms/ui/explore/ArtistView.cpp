@@ -27,6 +27,7 @@
 
 #include "services/database/Artist.hpp"
 #include "services/database/Cluster.hpp"
+#include "services/database/Db.hpp"
 #include "services/database/Release.hpp"
 #include "services/database/ScanSettings.hpp"
 #include "services/database/Session.hpp"
@@ -38,6 +39,7 @@
 #include "utils/String.hpp"
 
 #include "common/InfiniteScrollingContainer.hpp"
+#include "common/PageLoader.hpp"
 #include "resource/DownloadResource.hpp"
 #include "ArtistListHelpers.hpp"
 #include "Filters.hpp"
@@ -103,9 +105,60 @@ Artist::refreshView()
 	if (!artistId)
 		throw ArtistNotFoundException {};
 
-	const auto similarArtistIds {Service<Recommendation::IRecommendationService>::get()->getSimilarArtists(*artistId, {TrackArtistLinkType::Artist, TrackArtistLinkType::ReleaseArtist}, 5)};
+	// Independent queries, run concurrently
+	const std::vector<ClusterId> clusterIds {_filters->getClusterIds()};
+	Db& db {LmsApp->getDb()};
+	PageLoader loader;
 
-    auto transaction {LmsApp->getDbSession().createSharedTransaction()};
+	auto similarArtistIds {loader.add([artistId = *artistId]
+	{
+		return Service<Recommendation::IRecommendationService>::get()->getSimilarArtists(artistId, {TrackArtistLinkType::Artist, TrackArtistLinkType::ReleaseArtist}, 5);
+	})};
+
+	auto releaseIds {loader.add([&db, artistId = *artistId, clusterIds]
+	{
+		Session& session {db.getTLSSession()};
+		auto transaction {session.createSharedTransaction()};
+
+		std::vector<ReleaseId> res;
+		if (const Database::Artist::pointer artist {Database::Artist::find(session, artistId)})
+		{
+			for (const Database::Release::pointer& release : artist->getReleases(clusterIds))
+				res.push_back(release->getId());
+		}
+		return res;
+	})};
+
+	auto hasNonReleaseTracks {loader.add([&db, artistId = *artistId]
+	{
+		Session& session {db.getTLSSession()};
+		auto transaction {session.createSharedTransaction()};
+
+		const Database::Artist::pointer artist {Database::Artist::find(session, artistId)};
+		return artist && artist->hasNonReleaseTracks();
+	})};
+
+	auto clusterIdGroups {loader.add([&db, artistId = *artistId]
+	{
+		Session& session {db.getTLSSession()};
+		auto transaction {session.createSharedTransaction()};
+
+		std::vector<std::vector<ClusterId>> res;
+		if (const Database::Artist::pointer artist {Database::Artist::find(session, artistId)})
+		{
+			for (const auto& clusters : artist->getClusterGroups(ScanSettings::get(session)->getClusterTypes(), 3))
+			{
+				std::vector<ClusterId>& group {res.emplace_back()};
+				for (const Cluster::pointer& cluster : clusters)
+					group.push_back(cluster->getId());
+			}
+		}
+		return res;
+	})};
+
+	loader.wait();
+
+	auto transaction {LmsApp->getDbSession().createSharedTransaction()};
 
 	const Database::Artist::pointer artist {Database::Artist::find(LmsApp->getDbSession(), *artistId)};
 	if (!artist)
@@ -113,28 +166,26 @@ Artist::refreshView()
 
 	_artistId = *artistId;
 
-	refreshReleases(artist);
-	refreshNonReleaseTracks(artist);
+	refreshReleases(releaseIds.get(), artist);
+	refreshNonReleaseTracks(hasNonReleaseTracks.get());
 	refreshLinks(artist);
-	refreshSimilarArtists(similarArtistIds);
+	refreshSimilarArtists(similarArtistIds.get());
 
 	Wt::WContainerWidget* clusterContainers = bindNew<Wt::WContainerWidget>("clusters");
 
+	for (const std::vector<ClusterId>& clusterGroup : clusterIdGroups.get())
 	{
-		auto clusterTypes = ScanSettings::get(LmsApp->getDbSession())->getClusterTypes();
-		auto clusterGroups = artist->getClusterGroups(clusterTypes, 3);
-
-		for (auto clusters : clusterGroups)
+		for (const ClusterId clusterId : clusterGroup)
 		{
-			for (auto cluster : clusters)
+			const Cluster::pointer cluster {Cluster::find(LmsApp->getDbSession(), clusterId)};
+			if (!cluster)
+				continue;
+
+			auto entry = clusterContainers->addWidget(LmsApp->createCluster(cluster));
+			entry->clicked().connect([=]
 			{
-				auto clusterId = cluster->getId();
-				auto entry = clusterContainers->addWidget(LmsApp->createCluster(cluster));
-				entry->clicked().connect([=]
-				{
-					_filters->add(clusterId);
-				});
-			}
+				_filters->add(clusterId);
+			});
 		}
 	}
 
@@ -184,9 +235,9 @@ Artist::refreshView()
 }
 
 void
-Artist::refreshReleases(const ObjectPtr<Database::Artist>& artist)
+Artist::refreshReleases(const std::vector<ReleaseId>& releaseIds, const ObjectPtr<Database::Artist>& artist)
 {
-	const auto releases {artist->getReleases(_filters->getClusterIds())};
+	const auto releases {Database::Release::find(LmsApp->getDbSession(), releaseIds)};
 	if (releases.empty())
 		return;
 
@@ -200,9 +251,9 @@ Artist::refreshReleases(const ObjectPtr<Database::Artist>& artist)
 }
 
 void
-Artist::refreshNonReleaseTracks(const ObjectPtr<Database::Artist>& artist)
+Artist::refreshNonReleaseTracks(bool hasNonReleaseTracks)
 {
-	if (!artist->hasNonReleaseTracks())
+	if (!hasNonReleaseTracks)
 		return;
 
 	setCondition("if-has-non-release-track", true);
@@ -224,14 +275,8 @@ Artist::refreshSimilarArtists(const std::vector<ArtistId>& similarArtistsId)
 	setCondition("if-has-similar-artists", true);
 	Wt::WContainerWidget* similarArtistsContainer {bindNew<Wt::WContainerWidget>("similar-artists")};
 
-	for (const ArtistId artistId : similarArtistsId)
-	{
-		const Database::Artist::pointer similarArtist {Database::Artist::find(LmsApp->getDbSession(), artistId)};
-		if (!similarArtist)
-			continue;
-
+	for (const Database::Artist::pointer& similarArtist : Database::Artist::find(LmsApp->getDbSession(), similarArtistsId))
 		similarArtistsContainer->addWidget(ArtistListHelpers::createEntrySmall(similarArtist));
-	}
 }
 
 void
@@ -258,20 +303,19 @@ Artist::addSomeNonReleaseTracks()
 	if (!artist)
 		return;
 
-	const auto tracks {artist->getNonReleaseTracks(std::nullopt, Range {static_cast<std::size_t>(_trackContainer->getCount()), _tracksBatchSize})};
+	auto tracks {artist->getNonReleaseTracks(std::nullopt, Range {static_cast<std::size_t>(_trackContainer->getCount()), _tracksBatchSize})};
 	bool moreResults {tracks.moreResults};
 
-	for (const Track::pointer& track : tracks.results)
+	const std::size_t remainingCount {_tracksMaxCount - _trackContainer->getCount()};
+	if (tracks.results.size() >= remainingCount)
 	{
-		if (_trackContainer->getCount() == _tracksMaxCount)
-		{
-			moreResults = false;
-			break;
-		}
-
-		_trackContainer->add(TrackListHelpers::createEntry(track, tracksAction));
+		tracks.results.erase(std::begin(tracks.results) + remainingCount, std::end(tracks.results));
+		moreResults = false;
 	}
 
+	for (std::unique_ptr<Wt::WTemplate>& entry : TrackListHelpers::createEntries(tracks.results, tracksAction))
+		_trackContainer->add(std::move(entry));
+
 	_trackContainer->setHasMore(moreResults);
 }
 
@@ -26,6 +26,7 @@
 #include <Wt/WTemplate.h>
 
 #include "services/database/Object.hpp"
+#include "services/database/ReleaseId.hpp"
 #include "PlayQueueAction.hpp"
 
 namespace Database
@@ -50,8 +51,8 @@ namespace UserInterface
 
 		private:
 			void refreshView();
-			void refreshReleases(const Database::ObjectPtr<Database::Artist>& artist);
-			void refreshNonReleaseTracks(const Database::ObjectPtr<Database::Artist>& artist);
+			void refreshReleases(const std::vector<Database::ReleaseId>& releaseIds, const Database::ObjectPtr<Database::Artist>& artist);
+			void refreshNonReleaseTracks(bool hasNonReleaseTracks);
 			void refreshSimilarArtists(const std::vector<Database::ArtistId>& similarArtistsId);
 			void refreshLinks(const Database::ObjectPtr<Database::Artist>& artist);
 
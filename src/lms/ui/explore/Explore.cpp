@@ -19,6 +19,9 @@
 
 #include "Explore.hpp"
 
+#include <cassert>
+#include <map>
+
 #include <Wt/WStackedWidget.h>
 #include <Wt/WTemplate.h>
 #include <Wt/WText.h>
@@ -41,22 +44,85 @@
 
 namespace UserInterface {
 
-namespace {
-
-void
-handleContentsPathChange(Wt::WStackedWidget* stack)
+Explore::Explore(Filters* filters)
+: Wt::WTemplate {Wt::WString::tr("Lms.Explore.template")}
+, _filters {filters}
 {
-	enum Idx
+	addFunction("tr", &Functions::tr);
+
+	// Contents
+	_contentsStack = bindNew<Wt::WStackedWidget>("contents");
+	_contentsStack->setAttributeValue("style", "overflow-x:visible;overflow-y:visible;");
+
+	_views[IdxArtists] = {[this]
 	{
-		IdxArtists = 0,
-		IdxArtist,
-		IdxReleases,
-		IdxRelease,
-		IdxSearch,
-		IdxTracks,
-	};
+		return std::make_unique<Artists>(*_filters);
+	}, true};
+
+	_views[IdxArtist] = {[this]
+	{
+		auto artist = std::make_unique<Artist>(_filters);
+		artist->artistsAction.connect(this, &Explore::handleArtistsAction);
+		artist->tracksAction.connect(this, &Explore::handleTracksAction);
+		return artist;
+	}, false};
+
+	_views[IdxReleases] = {[this]
+	{
+		auto releases = std::make_unique<Releases>(*_filters);
+		releases->releasesAction.connect(this, &Explore::handleReleasesAction);
+		return releases;
+	}, true};
+
+	_views[IdxRelease] = {[this]
+	{
+		auto release = std::make_unique<Release>(_filters);
+		release->releasesAction.connect(this, &Explore::handleReleasesAction);
+		release->tracksAction.connect(this, &Explore::handleTracksAction);
+		return release;
+	}, false};
+
+	// not released, keeps the current search
+	_views[IdxSearch] = {[this]
+	{
+		auto search = std::make_unique<SearchView>(_filters);
+		search->tracksAction.connect(this, &Explore::handleTracksAction);
+		_search = search.get();
+		return search;
+	}, false};
+
+	_views[IdxTracks] = {[this]
+	{
+		auto tracks = std::make_unique<Tracks>(*_filters);
+		tracks->tracksAction.connect(this, &Explore::handleTracksAction);
+		return tracks;
+	}, true};
+
+	// placeholders
+	for (std::size_t i {}; i < _views.size(); ++i)
+		_contentsStack->addNew<Wt::WContainerWidget>();
 
-	static const std::map<std::string, int> indexes =
+	wApp->internalPathChanged().connect(this, [this]
+	{
+		handleContentsPathChange();
+	});
+
+	LmsApp->trimRequested().connect(this, [this]
+	{
+		for (std::size_t i {}; i < _views.size(); ++i)
+		{
+			if (static_cast<int>(i) != _contentsStack->currentIndex() && _views[i].created && _views[i].releasable)
+				releaseView(static_cast<ViewIdx>(i));
+		}
+	});
+
+	handleContentsPathChange();
+}
+
+void
+Explore::handleContentsPathChange()
+{
+	static const std::map<std::string, ViewIdx> indexes =
 	{
 		{ "/artists",		IdxArtists },
 		{ "/artist",		IdxArtist },
@@ -70,61 +136,69 @@ handleContentsPathChange(Wt::WStackedWidget* stack)
 	{
 		if (wApp->internalPathMatches(index.first))
 		{
-			stack->setCurrentIndex(index.second);
+			displayView(index.second);
 			return;
 		}
 	}
 }
 
-} // namespace
-
-Explore::Explore(Filters* filters)
-: Wt::WTemplate {Wt::WString::tr("Lms.Explore.template")}
-, _filters {filters}
+void
+Explore::displayView(ViewIdx idx)
 {
-	addFunction("tr", &Functions::tr);
+	const auto now {std::chrono::steady_clock::now()};
 
-	// Contents
-	Wt::WStackedWidget* contentsStack = bindNew<Wt::WStackedWidget>("contents");
-	contentsStack->setAttributeValue("style", "overflow-x:visible;overflow-y:visible;");
+	for (std::size_t i {}; i < _views.size(); ++i)
+	{
+		View& view {_views[i]};
+		if (i != static_cast<std::size_t>(idx) && view.created && view.releasable && now - view.lastDisplayed > _viewReleaseDelay)
+			releaseView(static_cast<ViewIdx>(i));
+	}
 
-	auto artists = std::make_unique<Artists>(*_filters);
-	contentsStack->addWidget(std::move(artists));
+	createView(idx);
+	_views[idx].lastDisplayed = now;
+	_contentsStack->setCurrentIndex(idx);
+}
 
-	auto artist = std::make_unique<Artist>(_filters);
-	artist->artistsAction.connect(this, &Explore::handleArtistsAction);
-	artist->tracksAction.connect(this, &Explore::handleTracksAction);
-	contentsStack->addWidget(std::move(artist));
+void
+Explore::createView(ViewIdx idx)
+{
+	View& view {_views[idx]};
+	if (view.created)
+		return;
 
-	auto releases = std::make_unique<Releases>(*_filters);
-	releases->releasesAction.connect(this, &Explore::handleReleasesAction);
-	contentsStack->addWidget(std::move(releases));
+	LMS_LOG(UI, DEBUG) << "Creating explore view " << idx;
 
-	auto release = std::make_unique<Release>(_filters);
-	release->releasesAction.connect(this, &Explore::handleReleasesAction);
-	release->tracksAction.connect(this, &Explore::handleTracksAction);
-	contentsStack->addWidget(std::move(release));
+	replaceWidget(idx, view.create());
+	view.created = true;
+}
 
-	auto search = std::make_unique<SearchView>(_filters);
-	search->tracksAction.connect(this, &Explore::handleTracksAction);
-	_search = search.get();
-	contentsStack->addWidget(std::move(search));
+void
+Explore::replaceWidget(ViewIdx idx, std::unique_ptr<Wt::WWidget> widget)
+{
+	const int currentIndex {_contentsStack->currentIndex()};
 
-	auto tracks = std::make_unique<Tracks>(*_filters);
-	tracks->tracksAction.connect(this, &Explore::handleTracksAction);
-	contentsStack->addWidget(std::move(tracks));
+	_contentsStack->removeWidget(_contentsStack->widget(idx));
+	_contentsStack->insertWidget(idx, std::move(widget));
 
-	wApp->internalPathChanged().connect(this, [=]
-	{
-		handleContentsPathChange(contentsStack);
-	});
+	_contentsStack->setCurrentIndex(currentIndex);
+}
+
+void
+Explore::releaseView(ViewIdx idx)
+{
+	View& view {_views[idx]};
+	assert(view.created && view.releasable);
+
+	LMS_LOG(UI, DEBUG) << "Releasing explore view " << idx;
 
-	handleContentsPathChange(contentsStack);
+	replaceWidget(idx, std::make_unique<Wt::WContainerWidget>());
+	view.created = false;
 }
 
 void
 Explore::search(const Wt::WString& searchText)
 {
+	createView(IdxSearch);
 	_search->refreshView(searchText);
 }
 
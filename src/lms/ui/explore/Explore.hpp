@@ -19,11 +19,21 @@
 
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <functional>
+#include <memory>
+
 #include <Wt/WTemplate.h>
 
 #include "services/database/Types.hpp"
 #include "PlayQueueAction.hpp"
 
+namespace Wt
+{
+	class WStackedWidget;
+}
+
 namespace UserInterface
 {
 	class Filters;
@@ -39,11 +49,42 @@ namespace UserInterface
 			PlayQueueActionTrackSignal tracksAction;
 
 		private:
+			enum ViewIdx
+			{
+				IdxArtists = 0,
+				IdxArtist,
+				IdxReleases,
+				IdxRelease,
+				IdxSearch,
+				IdxTracks,
+				IdxCount,
+			};
+
+			// Views are created on first display, and some of them are released once not displayed for a while,
+			// or when the session is trimmed
+			struct View
+			{
+				std::function<std::unique_ptr<Wt::WWidget>()>	create;
+				bool											releasable {};
+				bool											created {};
+				std::chrono::steady_clock::time_point			lastDisplayed;
+			};
+
+			void handleContentsPathChange();
+			void displayView(ViewIdx idx);
+			void createView(ViewIdx idx);
+			void releaseView(ViewIdx idx);
+			void replaceWidget(ViewIdx idx, std::unique_ptr<Wt::WWidget> widget);
+
 			void handleArtistsAction(PlayQueueAction action, const std::vector<Database::ArtistId>& artistsId);
 			void handleReleasesAction(PlayQueueAction action, const std::vector<Database::ReleaseId>& releasesId);
 			void handleTracksAction(PlayQueueAction action, const std::vector<Database::TrackId>& tracksId);
 
+			static inline constexpr std::chrono::minutes _viewReleaseDelay {10};
+
 			Filters* _filters {};
+			Wt::WStackedWidget* _contentsStack {};
+			std::array<View, IdxCount> _views;
 			SearchView* _search {};
 	};
 } // namespace UserInterface
@@ -25,6 +25,7 @@
 #include <Wt/WTemplate.h>
 
 #include "services/database/Cluster.hpp"
+#include "services/database/ClusterCatalog.hpp"
 #include "services/database/Session.hpp"
 
 #include "LmsApplication.hpp"
@@ -50,44 +51,30 @@ Filters::showDialog()
 	Wt::WPushButton* cancelBtn = container->bindNew<Wt::WPushButton>("cancel-btn", Wt::WString::tr("Lms.cancel"));
 	cancelBtn->clicked().connect(dialog.get(), &Wt::WDialog::reject);
 
-	// Populate data
-	{
-		auto transaction {LmsApp->getDbSession().createSharedTransaction()};
+	// Populate data, from the catalog shared by all the sessions
+	const std::shared_ptr<const ClusterCatalog> clusterCatalog {ClusterCatalog::get(LmsApp->getDbSession())};
 
-		const auto clusterTypesIds {ClusterType::findUsed(LmsApp->getDbSession(), Range {})};
-		for (const ClusterTypeId clusterTypeId : clusterTypesIds.results)
+	auto addClusters {[=](const ClusterCatalog::ClusterType& clusterType)
+	{
+		for (const ClusterCatalog::Cluster& cluster : clusterType.clusters)
 		{
-			const auto clusterType {ClusterType::find(LmsApp->getDbSession(), clusterTypeId)};
-			typeCombo->addItem(Wt::WString::fromUTF8(clusterType->getName()));
+			if (std::find(std::cbegin(_clusterIds), std::cend(_clusterIds), cluster.id) == _clusterIds.end())
+				valueCombo->addItem(Wt::WString::fromUTF8(cluster.name));
 		}
+	}};
 
-		if (!clusterTypesIds.results.empty())
-		{
-			const auto clusterType {ClusterType::find(LmsApp->getDbSession(), clusterTypesIds.results.front())};
+	for (const ClusterCatalog::ClusterType& clusterType : clusterCatalog->getClusterTypes())
+		typeCombo->addItem(Wt::WString::fromUTF8(clusterType.name));
 
-			for (const Cluster::pointer cluster : clusterType->getClusters())
-			{
-				if (std::find(std::cbegin(_clusterIds), std::cend(_clusterIds), cluster->getId()) == _clusterIds.end())
-					valueCombo->addItem(Wt::WString::fromUTF8(cluster->getName()));
-			}
-		}
-	}
+	if (!clusterCatalog->getClusterTypes().empty())
+		addClusters(clusterCatalog->getClusterTypes().front());
 
 	typeCombo->changed().connect([=]
 	{
-		const std::string name {typeCombo->valueText().toUTF8()};
-
 		valueCombo->clear();
 
-		auto transaction {LmsApp->getDbSession().createSharedTransaction()};
-
-		auto clusterType = ClusterType::find(LmsApp->getDbSession(), name);
-
-		for (const Cluster::pointer& cluster : clusterType->getClusters())
-		{
-			if (std::find(std::cbegin(_clusterIds), std::cend(_clusterIds), cluster->getId()) == _clusterIds.end())
-				valueCombo->addItem(Wt::WString::fromUTF8(cluster->getName()));
-		}
+		if (const ClusterCatalog::ClusterType* clusterType {clusterCatalog->findClusterType(typeCombo->valueText().toUTF8())})
+			addClusters(*clusterType);
 	});
 
 	dialog->setModal(true);
@@ -105,23 +92,11 @@ Filters::showDialog()
 		const std::string value {valueCombo->valueText().toUTF8()};
 
 		// TODO use a model to store the cluster.id() values
-		ClusterId clusterId {};
-
-		{
-			auto transaction {LmsApp->getDbSession().createSharedTransaction()};
-
-			ClusterType::pointer clusterType {ClusterType::find(LmsApp->getDbSession(), type)};
-			if (!clusterType)
-				return;
-
-			Cluster::pointer cluster {clusterType->getCluster(value)};
-			if (!cluster)
-				return;
-
-			clusterId = cluster->getId();
-		}
+		const ClusterCatalog::Cluster* cluster {clusterCatalog->findCluster(type, value)};
+		if (!cluster)
+			return;
 
-		add(clusterId);
+		add(cluster->id);
 	});
 
 	dialog->show();
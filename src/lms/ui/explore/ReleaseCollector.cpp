@@ -28,6 +28,7 @@
 #include "services/scrobbling/IScrobblingService.hpp"
 #include "utils/Service.hpp"
 #include "Filters.hpp"
+#include "LibrarySnapshot.hpp"
 #include "LmsApplication.hpp"
 
 namespace UserInterface
@@ -62,9 +63,15 @@ namespace UserInterface
 
 			case Mode::RecentlyAdded:
 			{
+				if (const auto snapshot {LmsApp->getLibrarySnapshot()})
+				{
+					releases = snapshot->getReleases(getFilters().getClusterIds(), ReleaseSortMethod::AddedDesc, range);
+					break;
+				}
+
 				Release::FindParameters params;
 				params.setClusters(getFilters().getClusterIds());
-				params.setSortMethod(ReleaseSortMethod::LastWritten);
+				params.setSortMethod(ReleaseSortMethod::AddedDesc);
 				params.setRange(range);
 
 				releases = Release::find(LmsApp->getDbSession(), params);
@@ -85,6 +92,12 @@ namespace UserInterface
 
 			case Mode::All:
 			{
+				if (const auto snapshot {LmsApp->getLibrarySnapshot()})
+				{
+					releases = snapshot->getReleases(getFilters().getClusterIds(), ReleaseSortMethod::Name, range);
+					break;
+				}
+
 				Release::FindParameters params;
 				params.setClusters(getFilters().getClusterIds());
 				params.setSortMethod(ReleaseSortMethod::Name);
@@ -108,6 +121,12 @@ namespace UserInterface
 
 		if (!_randomReleases)
 		{
+			if (const auto snapshot {LmsApp->getLibrarySnapshot()})
+			{
+				_randomReleases = snapshot->getRandomReleases(getFilters().getClusterIds(), getMaxCount());
+				return _randomReleases->getSubRange(range);
+			}
+
 			Release::FindParameters params;
 			params.setClusters(getFilters().getClusterIds());
 			params.setSortMethod(ReleaseSortMethod::Random);
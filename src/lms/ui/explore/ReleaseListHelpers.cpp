@@ -19,12 +19,16 @@
 
 #include "ReleaseListHelpers.hpp"
 
+#include <optional>
+#include <string_view>
+
 #include <Wt/WAnchor.h>
 #include <Wt/WImage.h>
 #include <Wt/WText.h>
 
 #include "services/database/Artist.hpp"
 #include "services/database/Release.hpp"
+#include "services/database/Session.hpp"
 #include "resource/CoverResource.hpp"
 
 #include "LmsApplication.hpp"
@@ -35,23 +39,28 @@ namespace UserInterface::ReleaseListHelpers
 {
 	static
 	std::unique_ptr<Wt::WTemplate>
-	createEntryInternal(const Release::pointer& release, const std::string& templateKey, const Artist::pointer& artist, const bool showYear)
+	createEntryTemplate(ReleaseId releaseId, std::string_view name, const std::optional<UUID>& MBID, const std::string& templateKey)
 	{
 		auto entry {std::make_unique<Wt::WTemplate>(Wt::WString::tr(templateKey))};
 
-		entry->bindWidget("release-name", LmsApplication::createReleaseAnchor(release));
+		entry->bindWidget("release-name", LmsApplication::createReleaseAnchor(releaseId, name, MBID));
 		entry->addFunction("tr", &Wt::WTemplate::Functions::tr);
 
-		Wt::WAnchor* anchor = entry->bindWidget("cover", LmsApplication::createReleaseAnchor(release, false));
+		Wt::WAnchor* anchor = entry->bindWidget("cover", LmsApplication::createReleaseAnchor(releaseId, name, MBID, false));
 		auto cover = std::make_unique<Wt::WImage>();
-		cover->setImageLink(LmsApp->getCoverResource()->getReleaseUrl(release->getId(), CoverResource::Size::Large));
+		cover->setImageLink(LmsApp->getCoverResource()->getReleaseUrl(releaseId, CoverResource::Size::Large));
 		cover->setStyleClass("Lms-cover");
 		cover->setAttributeValue("onload", LmsApp->javaScriptClass() + ".onLoadCover(this)");
 		anchor->setImage(std::move(cover));
 
-		auto artists = release->getReleaseArtists();
-		if (artists.empty())
-			artists = release->getArtists();
+		return entry;
+	}
+
+	static
+	std::unique_ptr<Wt::WTemplate>
+	createEntryInternal(const Release::pointer& release, const std::string& templateKey, const std::vector<Artist::pointer>& artists, const Artist::pointer& artist, const bool showYear)
+	{
+		auto entry {createEntryTemplate(release->getId(), release->getName(), release->getMBID(), templateKey)};
 
 		bool isSameArtist {(std::find(std::cbegin(artists), std::cend(artists), artist) != artists.end())};
 
@@ -67,16 +76,16 @@ namespace UserInterface::ReleaseListHelpers
 
 		if (showYear)
 		{
-			if (std::optional<int> year {release->getReleaseYear()})
+			const Release::Summary summary {release->getSummary()};
+			if (summary.year)
 			{
 				entry->setCondition("if-has-year", true);
 
-				std::string strYear {std::to_string(*year)};
+				std::string strYear {std::to_string(*summary.year)};
 
-				std::optional<int> originalYear {release->getReleaseYear(true)};
-				if (originalYear && *originalYear != *year)
+				if (summary.originalYear && *summary.originalYear != *summary.year)
 				{
-					strYear += " (" + std::to_string(*originalYear) + ")";
+					strYear += " (" + std::to_string(*summary.originalYear) + ")";
 				}
 
 				entry->bindString("year", strYear);
@@ -86,10 +95,21 @@ namespace UserInterface::ReleaseListHelpers
 		return entry;
 	}
 
+	static
+	std::vector<Artist::pointer>
+	getArtists(const Release::pointer& release)
+	{
+		auto artists {release->getReleaseArtists()};
+		if (artists.empty())
+			artists = release->getArtists();
+
+		return artists;
+	}
+
 	std::unique_ptr<Wt::WTemplate>
 	createEntry(const Release::pointer& release, const Artist::pointer& artist, bool showYear)
 	{
-		return createEntryInternal(release, "Lms.Explore.Releases.template.entry-grid", artist, showYear);
+		return createEntryInternal(release, "Lms.Explore.Releases.template.entry-grid", getArtists(release), artist, showYear);
 	}
 
 	std::unique_ptr<Wt::WTemplate>
@@ -98,6 +118,33 @@ namespace UserInterface::ReleaseListHelpers
 		return createEntry(release, Artist::pointer {}, false /*year*/);
 	}
 
+	std::vector<std::unique_ptr<Wt::WTemplate>>
+	createEntries(const std::vector<ReleaseId>& releaseIds)
+	{
+		std::vector<std::unique_ptr<Wt::WTemplate>> entries;
+		entries.reserve(releaseIds.size());
+		for (const Release::ListEntryResult& release : Release::findListEntries(LmsApp->getDbSession(), releaseIds))
+		{
+			auto entry {createEntryTemplate(release.releaseId, release.name, release.MBID, "Lms.Explore.Releases.template.entry-grid")};
+
+			if (release.artists.size() > 1)
+			{
+				entry->setCondition("if-has-various-artists", true);
+			}
+			else if (release.artists.size() == 1)
+			{
+				const Artist::ListEntryResult& artist {release.artists.front()};
+
+				entry->setCondition("if-has-artist", true);
+				entry->bindWidget("artist-name", LmsApplication::createArtistAnchor(artist.artistId, artist.name, artist.MBID));
+			}
+
+			entries.push_back(std::move(entry));
+		}
+
+		return entries;
+	}
+
 	std::unique_ptr<Wt::WTemplate>
 	createEntryForArtist(const Database::Release::pointer& release, const Database::Artist::pointer& artist)
 	{
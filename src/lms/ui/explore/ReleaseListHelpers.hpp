@@ -20,9 +20,11 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include <Wt/WTemplate.h>
 #include "services/database/Object.hpp"
+#include "services/database/ReleaseId.hpp"
 
 namespace Database
 {
@@ -33,6 +35,8 @@ namespace Database
 namespace UserInterface::ReleaseListHelpers
 {
 	std::unique_ptr<Wt::WTemplate> createEntry(const Database::ObjectPtr<Database::Release>& release);
+	// Same as createEntry, but only what is rendered is fetched, for all the releases at once
+	std::vector<std::unique_ptr<Wt::WTemplate>> createEntries(const std::vector<Database::ReleaseId>& releaseIds);
 	std::unique_ptr<Wt::WTemplate> createEntryForArtist(const Database::ObjectPtr<Database::Release>& release, const Database::ObjectPtr<Database::Artist>& artist);
 } // namespace UserInterface
 
@@ -26,6 +26,7 @@
 #include <Wt/WText.h>
 
 #include "services/database/Cluster.hpp"
+#include "services/database/Db.hpp"
 #include "services/database/Release.hpp"
 #include "services/database/ScanSettings.hpp"
 #include "services/database/Session.hpp"
@@ -34,6 +35,7 @@
 #include "utils/Logger.hpp"
 #include "utils/String.hpp"
 
+#include "common/PageLoader.hpp"
 #include "resource/DownloadResource.hpp"
 #include "resource/CoverResource.hpp"
 #include "Filters.hpp"
@@ -101,9 +103,60 @@ Release::refreshView()
 	if (!releaseId)
 		throw ReleaseNotFoundException {};
 
-	auto similarReleasesIds {Service<Recommendation::IRecommendationService>::get()->getSimilarReleases(*releaseId, 6)};
+	// Independent queries, run concurrently
+	const std::vector<ClusterId> clusterIds {_filters->getClusterIds()};
+	Db& db {LmsApp->getDb()};
+	PageLoader loader;
 
-    auto transaction {LmsApp->getDbSession().createSharedTransaction()};
+	auto similarReleasesIds {loader.add([releaseId = *releaseId]
+	{
+		return Service<Recommendation::IRecommendationService>::get()->getSimilarReleases(releaseId, 6);
+	})};
+
+	auto trackIds {loader.add([&db, releaseId = *releaseId, clusterIds]
+	{
+		Session& session {db.getTLSSession()};
+		auto transaction {session.createSharedTransaction()};
+
+		std::vector<TrackId> res;
+		if (const Database::Release::pointer release {Database::Release::find(session, releaseId)})
+		{
+			for (const Track::pointer& track : release->getTracks(clusterIds))
+				res.push_back(track->getId());
+		}
+		return res;
+	})};
+
+	auto variousArtists {loader.add([&db, releaseId = *releaseId]
+	{
+		Session& session {db.getTLSSession()};
+		auto transaction {session.createSharedTransaction()};
+
+		const Database::Release::pointer release {Database::Release::find(session, releaseId)};
+		return release && release->hasVariousArtists();
+	})};
+
+	auto clusterIdGroups {loader.add([&db, releaseId = *releaseId]
+	{
+		Session& session {db.getTLSSession()};
+		auto transaction {session.createSharedTransaction()};
+
+		std::vector<std::vector<ClusterId>> res;
+		if (const Database::Release::pointer release {Database::Release::find(session, releaseId)})
+		{
+			for (const auto& clusters : release->getClusterGroups(ScanSettings::get(session)->getClusterTypes(), 3))
+			{
+				std::vector<ClusterId>& group {res.emplace_back()};
+				for (const Cluster::pointer& cluster : clusters)
+					group.push_back(cluster->getId());
+			}
+		}
+		return res;
+	})};
+
+	loader.wait();
+
+	auto transaction {LmsApp->getDbSession().createSharedTransaction()};
 
 	const Database::Release::pointer release {Database::Release::find(LmsApp->getDbSession(), *releaseId)};
 	if (!release)
@@ -111,25 +164,24 @@ Release::refreshView()
 
 	refreshCopyright(release);
 	refreshLinks(release);
-	refreshSimilarReleases(similarReleasesIds);
+	refreshSimilarReleases(similarReleasesIds.get());
 
 	bindString("name", Wt::WString::fromUTF8(release->getName()), Wt::TextFormat::Plain);
 
-	std::optional<int> year {release->getReleaseYear()};
-	if (year)
+	const Database::Release::Summary summary {release->getSummary()};
+	if (summary.year)
 	{
 		setCondition("if-has-year", true);
-		bindInt("year", *year);
+		bindInt("year", *summary.year);
 
-		std::optional<int> originalYear {release->getReleaseYear(true)};
-		if (originalYear && *originalYear != *year)
+		if (summary.originalYear && *summary.originalYear != *summary.year)
 		{
 			setCondition("if-has-orig-year", true);
-			bindInt("orig-year", *originalYear);
+			bindInt("orig-year", *summary.originalYear);
 		}
 	}
 
-	bindString("duration", durationToString(release->getDuration()), Wt::TextFormat::Plain);
+	bindString("duration", durationToString(summary.duration), Wt::TextFormat::Plain);
 
 	refreshReleaseArtists(release);
 
@@ -140,21 +192,19 @@ Release::refreshView()
 	}
 
 	Wt::WContainerWidget* clusterContainers {bindNew<Wt::WContainerWidget>("clusters")};
+	for (const std::vector<ClusterId>& clusterGroup : clusterIdGroups.get())
 	{
-		const auto clusterTypes {ScanSettings::get(LmsApp->getDbSession())->getClusterTypes()};
-		const auto clusterGroups {release->getClusterGroups(clusterTypes, 3)};
-
-		for (const auto& clusters : clusterGroups)
+		for (const ClusterId clusterId : clusterGroup)
 		{
-			for (const auto& cluster : clusters)
+			const Cluster::pointer cluster {Cluster::find(LmsApp->getDbSession(), clusterId)};
+			if (!cluster)
+				continue;
+
+			auto entry {clusterContainers->addWidget(LmsApp->createCluster(cluster))};
+			entry->clicked().connect([=]
 			{
-				const ClusterId clusterId {cluster->getId()};
-				auto entry {clusterContainers->addWidget(LmsApp->createCluster(cluster))};
-				entry->clicked().connect([=]
-				{
-					_filters->add(clusterId);
-				});
-			}
+				_filters->add(clusterId);
+			});
 		}
 	}
 
@@ -176,7 +226,7 @@ Release::refreshView()
 
 	Wt::WContainerWidget* rootContainer {bindNew<Wt::WContainerWidget>("container")};
 
-	const bool variousArtists {release->hasVariousArtists()};
+	const bool hasVariousArtists {variousArtists.get()};
 	const auto totalDisc {release->getTotalDisc()};
 	const bool isReleaseMultiDisc {totalDisc && *totalDisc > 1};
 
@@ -203,8 +253,7 @@ Release::refreshView()
 		return tracksContainer;
 	};
 
-	const auto clusterIds {_filters->getClusterIds()};
-	const auto tracks {release->getTracks(clusterIds)};
+	const auto tracks {Track::find(LmsApp->getDbSession(), trackIds.get())};
 
 	for (const auto& track : tracks)
 	{
@@ -221,7 +270,7 @@ Release::refreshView()
 		entry->bindString("name", Wt::WString::fromUTF8(track->getName()), Wt::TextFormat::Plain);
 
 		const auto artists {track->getArtists({TrackArtistLinkType::Artist})};
-		if (variousArtists && !artists.empty())
+		if (hasVariousArtists && !artists.empty())
 		{
 			entry->setCondition("if-has-artists", true);
 
@@ -350,14 +399,8 @@ Release::refreshSimilarReleases(const std::vector<ReleaseId>& similarReleasesId)
 	setCondition("if-has-similar-releases", true);
 	auto* similarReleasesContainer {bindNew<Wt::WContainerWidget>("similar-releases")};
 
-	for (const ReleaseId id : similarReleasesId)
-	{
-		const Database::Release::pointer similarRelease {Database::Release::find(LmsApp->getDbSession(), id)};
-		if (!similarRelease)
-			continue;
-
+	for (const Database::Release::pointer& similarRelease : Database::Release::find(LmsApp->getDbSession(), similarReleasesId))
 		similarReleasesContainer->addWidget(ReleaseListHelpers::createEntry(similarRelease));
-	}
 }
 
 } // namespace UserInterface
@@ -119,11 +119,8 @@ Releases::addSome()
 	auto transaction {LmsApp->getDbSession().createSharedTransaction()};
 
 	const auto releaseIds {_releaseCollector.get(Range {static_cast<std::size_t>(_container->getCount()), _batchSize})};
-	for (const ReleaseId releaseId : releaseIds.results)
-	{
-		if (const Release::pointer release {Release::find(LmsApp->getDbSession(), releaseId)})
-			_container->add(ReleaseListHelpers::createEntry(release));
-	}
+	for (std::unique_ptr<Wt::WTemplate>& entry : ReleaseListHelpers::createEntries(releaseIds.results))
+		_container->add(std::move(entry));
 
 	_container->setHasMore(releaseIds.moreResults);
 }
@@ -75,6 +75,11 @@ namespace UserInterface
 		{
 			refreshView();
 		});
+
+		_searchTimer = addChild(std::make_unique<Wt::WTimer>());
+		_searchTimer->setSingleShot(true);
+		_searchTimer->setInterval(_searchDelay);
+		_searchTimer->timeout().connect(this, &SearchView::applyPendingSearch);
 	}
 
 	std::size_t
@@ -114,9 +119,21 @@ namespace UserInterface
 	void
 	SearchView::refreshView(const Wt::WString& searchText)
 	{
-		_releaseCollector.setSearch(searchText.toUTF8());
-		_artistCollector.setSearch(searchText.toUTF8());
-		_trackCollector.setSearch(searchText.toUTF8());
+		// restarts the timer if already active, the previous pending search is discarded
+		_pendingSearchText = searchText.toUTF8();
+		_searchTimer->start();
+	}
+
+	void
+	SearchView::applyPendingSearch()
+	{
+		if (_pendingSearchText == _searchText)
+			return;
+
+		_searchText = _pendingSearchText;
+		_releaseCollector.setSearch(_searchText);
+		_artistCollector.setSearch(_searchText);
+		_trackCollector.setSearch(_searchText);
 		refreshView();
 	}
 
@@ -169,11 +186,8 @@ namespace UserInterface
 			const Range range {results.getCount(), getBatchSize(Mode::Release)};
 			const RangeResults<ReleaseId> releaseIds {_releaseCollector.get(range)};
 
-			for (const ReleaseId releaseId : releaseIds.results)
-			{
-				const Release::pointer release {Release::find(LmsApp->getDbSession(), releaseId)};
-				results.add(ReleaseListHelpers::createEntry(release));
-			}
+			for (std::unique_ptr<Wt::WTemplate>& entry : ReleaseListHelpers::createEntries(releaseIds.results))
+				results.add(std::move(entry));
 
 			results.setHasMore(moreResults);
 		}
@@ -193,11 +207,9 @@ namespace UserInterface
 			const Range range {results.getCount(), getBatchSize(Mode::Track)};
 			const RangeResults<TrackId> trackIds {_trackCollector.get(range)};
 
-			for (const TrackId trackId : trackIds.results)
-			{
-				const Track::pointer track {Track::find(LmsApp->getDbSession(), trackId)};
-				results.add(TrackListHelpers::createEntry(track, tracksAction));
-			}
+			const std::vector<Track::pointer> tracks {Track::find(LmsApp->getDbSession(), trackIds.results)};
+			for (std::unique_ptr<Wt::WTemplate>& entry : TrackListHelpers::createEntries(tracks, tracksAction))
+				results.add(std::move(entry));
 
 			results.setHasMore(trackIds.moreResults);
 		}
@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -27,6 +28,7 @@
 #include <Wt/WContainerWidget.h>
 #include <Wt/WMenu.h>
 #include <Wt/WTemplate.h>
+#include <Wt/WTimer.h>
 
 #include "ArtistCollector.hpp"
 #include "ReleaseCollector.hpp"
@@ -46,6 +48,7 @@ namespace UserInterface
 
 			PlayQueueActionTrackSignal tracksAction;
 
+			// Debounced: only the last search text is applied, once typing stopped for a while
 			void refreshView(const Wt::WString& searchText);
 
 		private:
@@ -77,13 +80,19 @@ namespace UserInterface
 			std::size_t getBatchSize(Mode mode) const;
 			std::size_t getMaxCount(Mode mode) const;
 
+			void applyPendingSearch();
 			void refreshView();
 			void addSomeReleases();
 			void addSomeArtists();
 			void addSomeTracks();
 
+			static inline constexpr std::chrono::milliseconds _searchDelay {250};
+
 			Filters* _filters {};
 			Wt::WMenu* _menu {};
+			Wt::WTimer* _searchTimer {};
+			std::string _searchText;
+			std::string _pendingSearchText;
 			ReleaseCollector	_releaseCollector;
 			ArtistCollector		_artistCollector;
 			TrackCollector		_trackCollector;
@@ -28,6 +28,7 @@
 #include "services/scrobbling/IScrobblingService.hpp"
 #include "utils/Service.hpp"
 #include "Filters.hpp"
+#include "LibrarySnapshot.hpp"
 #include "LmsApplication.hpp"
 
 namespace UserInterface
@@ -63,7 +64,7 @@ namespace UserInterface
 			{
 				Track::FindParameters params;
 				params.setClusters(getFilters().getClusterIds());
-				params.setSortMethod(TrackSortMethod::LastWritten);
+				params.setSortMethod(TrackSortMethod::AddedDesc);
 				params.setRange(range);
 
 				tracks = Track::find(LmsApp->getDbSession(), params);
@@ -83,6 +84,12 @@ namespace UserInterface
 
 			case Mode::All:
 			{
+				if (const auto snapshot {LmsApp->getLibrarySnapshot()})
+				{
+					tracks = snapshot->getTracks(getFilters().getClusterIds(), range);
+					break;
+				}
+
 				Track::FindParameters params;
 				params.setClusters(getFilters().getClusterIds());
 				params.setRange(range);
@@ -105,6 +112,12 @@ namespace UserInterface
 
 		if (!_randomTracks)
 		{
+			if (const auto snapshot {LmsApp->getLibrarySnapshot()})
+			{
+				_randomTracks = snapshot->getRandomTracks(getFilters().getClusterIds(), getMaxCount());
+				return _randomTracks->getSubRange(range);
+			}
+
 			Track::FindParameters params;
 			params.setClusters(getFilters().getClusterIds());
 			params.setSortMethod(TrackSortMethod::Random);
@@ -19,6 +19,8 @@
 
 #include "TrackListHelpers.hpp"
 
+#include <unordered_map>
+
 #include <Wt/WAnchor.h>
 #include <Wt/WContainerWidget.h>
 #include <Wt/WImage.h>
@@ -26,6 +28,7 @@
 
 #include "services/database/Artist.hpp"
 #include "services/database/Release.hpp"
+#include "services/database/Session.hpp"
 #include "services/database/Track.hpp"
 #include "resource/DownloadResource.hpp"
 #include "resource/CoverResource.hpp"
@@ -38,8 +41,9 @@ using namespace Database;
 
 namespace UserInterface::TrackListHelpers
 {
+	static
 	std::unique_ptr<Wt::WTemplate>
-	createEntry(const Database::ObjectPtr<Database::Track>& track, PlayQueueActionTrackSignal& tracksAction)
+	createEntry(const Track::pointer& track, const std::vector<Artist::pointer>& artists, PlayQueueActionTrackSignal& tracksAction)
 	{
 		auto entry {std::make_unique<Wt::WTemplate>(Wt::WString::tr("Lms.Explore.Tracks.template.entry"))};
 		auto* entryPtr {entry.get()};
@@ -47,7 +51,6 @@ namespace UserInterface::TrackListHelpers
 		Wt::WText* name {entry->bindNew<Wt::WText>("name", Wt::WString::fromUTF8(track->getName()), Wt::TextFormat::Plain)};
 		name->setToolTip(Wt::WString::fromUTF8(track->getName()));
 
-		const auto artists {track->getArtists({TrackArtistLinkType::Artist})};
 		const Release::pointer release {track->getRelease()};
 		const TrackId trackId {track->getId()};
 
@@ -66,10 +69,10 @@ namespace UserInterface::TrackListHelpers
 			}
 		}
 
-		if (track->getRelease())
+		if (release)
 		{
 			entry->setCondition("if-has-release", true);
-			entry->bindWidget("release", LmsApplication::createReleaseAnchor(track->getRelease()));
+			entry->bindWidget("release", LmsApplication::createReleaseAnchor(release));
 			{
 				Wt::WAnchor* anchor {entry->bindWidget("cover", LmsApplication::createReleaseAnchor(release, false))};
 				auto cover {std::make_unique<Wt::WImage>()};
@@ -116,5 +119,27 @@ namespace UserInterface::TrackListHelpers
 		return entry;
 	}
 
+	std::vector<std::unique_ptr<Wt::WTemplate>>
+	createEntries(const std::vector<Track::pointer>& tracks, PlayQueueActionTrackSignal& tracksAction)
+	{
+		std::vector<TrackId> trackIds;
+		trackIds.reserve(tracks.size());
+		for (const Track::pointer& track : tracks)
+			trackIds.push_back(track->getId());
+
+		std::unordered_map<TrackId, std::vector<Artist::pointer>> artistsByTrack;
+		Track::visitArtists(LmsApp->getDbSession(), trackIds, {TrackArtistLinkType::Artist}, [&](TrackId trackId, const Artist::pointer& artist)
+		{
+			artistsByTrack[trackId].push_back(artist);
+		});
+
+		std::vector<std::unique_ptr<Wt::WTemplate>> entries;
+		entries.reserve(tracks.size());
+		for (const Track::pointer& track : tracks)
+			entries.push_back(createEntry(track, artistsByTrack[track->getId()], tracksAction));
+
+		return entries;
+	}
+
 } // namespace UserInterface
 
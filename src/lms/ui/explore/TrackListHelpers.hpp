@@ -20,6 +20,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include <Wt/WTemplate.h>
 #include "services/database/Object.hpp"
@@ -32,6 +33,7 @@ namespace Database
 
 namespace UserInterface::TrackListHelpers
 {
-	std::unique_ptr<Wt::WTemplate> createEntry(const Database::ObjectPtr<Database::Track>& track, PlayQueueActionTrackSignal& tracksAction);
+	// The artists of all the tracks are fetched at once, releases are expected to be already loaded (see Track::find)
+	std::vector<std::unique_ptr<Wt::WTemplate>> createEntries(const std::vector<Database::ObjectPtr<Database::Track>>& tracks, PlayQueueActionTrackSignal& tracksAction);
 } // namespace UserInterface
 
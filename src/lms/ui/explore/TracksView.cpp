@@ -123,11 +123,9 @@ Tracks::addSome()
 
 	const auto trackIds {_trackCollector.get(Range {static_cast<std::size_t>(_container->getCount()), _batchSize})};
 
-	for (const TrackId trackId : trackIds.results)
-	{
-		if (const Track::pointer track {Track::find(LmsApp->getDbSession(), trackId)})
-			_container->add(TrackListHelpers::createEntry(track, tracksAction));
-	}
+	const std::vector<Track::pointer> tracks {Track::find(LmsApp->getDbSession(), trackIds.results)};
+	for (std::unique_ptr<Wt::WTemplate>& entry : TrackListHelpers::createEntries(tracks, tracksAction))
+		_container->add(std::move(entry));
 
 	_container->setHasMore(trackIds.moreResults);
 }
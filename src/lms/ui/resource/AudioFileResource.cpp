@@ -94,7 +94,7 @@ AudioFileResource::handleRequest(const Wt::Http::Request& request,
 		if (!trackPath)
 			return;
 
-		fileResourceHandler = createFileResourceHandler(*trackPath);
+		fileResourceHandler = createOffloadableFileResourceHandler(*trackPath, EgressScheduler::TransferInfo {EgressScheduler::TrafficClass::Interactive, LmsApp->getUserId().toString()});
 	}
 	else
 	{
@@ -19,16 +19,21 @@
 
 #include "AudioTranscodeResource.hpp"
 
+#include <algorithm>
+#include <iterator>
 #include <optional>
 #include <Wt/Http/Response.h>
 
 #include "av/TranscodeParameters.hpp"
+#include "av/TranscodeProfiles.hpp"
 #include "av/TranscodeResourceHandlerCreator.hpp"
 #include "av/Types.hpp"
 #include "services/database/Session.hpp"
 #include "services/database/Track.hpp"
 #include "services/database/User.hpp"
+#include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Service.hpp"
 #include "utils/String.hpp"
 
 #include "LmsApplication.hpp"
@@ -100,6 +105,69 @@ AudioTranscodeResource::getUrl(Database::TrackId trackId) const
 	return url() + "&trackid=" + trackId.toString();
 }
 
+std::string
+AudioTranscodeResource::getSessionUrl(Database::TrackId trackId, const std::vector<Database::TrackId>& nextTrackIds) const
+{
+	std::vector<std::string> nextTrackIdStrs;
+	std::transform(std::cbegin(nextTrackIds), std::cend(nextTrackIds), std::back_inserter(nextTrackIdStrs), [](Database::TrackId nextTrackId) { return nextTrackId.toString(); });
+
+	{
+		std::scoped_lock lock {_issuedSessionsMutex};
+
+		_issuedSessions.push_back(IssuedSession {trackId, nextTrackIds});
+		if (_issuedSessions.size() > _maxIssuedSessionCount)
+			_issuedSessions.pop_front();
+	}
+
+	return getUrl(trackId) + "&nexttrackids=" + StringUtils::joinStrings(nextTrackIdStrs, ",");
+}
+
+bool
+AudioTranscodeResource::isSessionIssued(Database::TrackId trackId, const std::vector<Database::TrackId>& nextTrackIds) const
+{
+	std::scoped_lock lock {_issuedSessionsMutex};
+
+	return std::any_of(std::cbegin(_issuedSessions), std::cend(_issuedSessions), [&](const IssuedSession& session) { return session.trackId == trackId && session.nextTrackIds == nextTrackIds; });
+}
+
+// Must be the same for requests and prefetches, so that prefetched outputs are found in the transcode cache
+static
+Av::TranscodeParameters
+createTranscodeParameters(Av::Format format, Database::Bitrate bitrate)
+{
+	Av::TranscodeParameters parameters;
+
+	parameters.stripMetadata = true;
+	parameters.format = format;
+	parameters.bitrate = bitrate;
+
+	if (const Av::TranscodeProfile* profile {Av::findTranscodeProfile(LmsApp->getUserLoginName())})
+		Av::applyTranscodeProfile(*profile, parameters);
+
+	return parameters;
+}
+
+void
+AudioTranscodeResource::prefetch(Database::TrackId trackId, Database::AudioFormat format, Database::Bitrate bitrate)
+{
+	const std::optional<Av::Format> avFormat {AudioFormatToAvFormat(format)};
+	if (!avFormat || !Database::isAudioBitrateAllowed(bitrate))
+		return;
+
+	std::filesystem::path trackPath;
+	{
+		auto transaction {LmsApp->getDbSession().createSharedTransaction()};
+
+		const Database::Track::pointer track {Database::Track::find(LmsApp->getDbSession(), trackId)};
+		if (!track)
+			return;
+
+		trackPath = track->getPath();
+	}
+
+	Av::prefetchTranscode(trackPath, createTranscodeParameters(*avFormat, bitrate), LmsApp->getUserId().toString());
+}
+
 template<typename T>
 std::optional<T>
 readParameterAs(const Wt::Http::Request& request, const std::string& parameterName)
@@ -121,12 +189,22 @@ readParameterAs(const Wt::Http::Request& request, const std::string& parameterNa
 struct TranscodeParameters
 {
 	std::filesystem::path file;
+	std::vector<Av::TranscodeSessionTrack> sessionTracks;	// if set, includes the file
 	Av::TranscodeParameters transcodeParameters;
+	Av::TranscodeRequestInfo transcodeRequestInfo;
 };
 
+static
+std::size_t
+getMaxSessionTrackCount()
+{
+	static const std::size_t sessionTrackCount {Service<IConfig>::get()->getULong("transcode-session-track-count", 0)};
+	return sessionTrackCount;
+}
+
 static
 std::optional<TranscodeParameters>
-readTranscodeParameters(const Wt::Http::Request& request)
+readTranscodeParameters(const AudioTranscodeResource& resource, const Wt::Http::Request& request)
 {
 	TranscodeParameters parameters;
 
@@ -158,6 +236,44 @@ readTranscodeParameters(const Wt::Http::Request& request)
 
 		parameters.file = track->getPath();
 
+		if (const auto nextTrackIdsStr {request.getParameter("nexttrackids")})
+		{
+			std::vector<Database::TrackId> nextTrackIds;
+			for (std::string_view nextTrackIdStr : StringUtils::splitString(*nextTrackIdsStr, ","))
+			{
+				// Never more than what the server would have asked for
+				if (nextTrackIds.size() >= getMaxSessionTrackCount())
+					break;
+
+				const std::optional<Database::TrackId::ValueType> nextTrackId {StringUtils::readAs<Database::TrackId::ValueType>(nextTrackIdStr)};
+				if (!nextTrackId)
+				{
+					LOG(ERROR) << "Bad next track '" << nextTrackIdStr << "'";
+					return std::nullopt;
+				}
+				nextTrackIds.emplace_back(*nextTrackId);
+			}
+
+			if (!resource.isSessionIssued(*trackId, nextTrackIds))
+			{
+				LOG(ERROR) << "Session not issued for this user";
+				return std::nullopt;
+			}
+
+			parameters.sessionTracks.push_back({track->getPath(), track->getDuration()});
+			for (const Database::TrackId nextTrackId : nextTrackIds)
+			{
+				const Database::Track::pointer nextTrack {Database::Track::find(LmsApp->getDbSession(), nextTrackId)};
+				if (!nextTrack)
+				{
+					LOG(ERROR) << "Missing next track '" << nextTrackId.toString() << "'";
+					return std::nullopt;
+				}
+
+				parameters.sessionTracks.push_back({nextTrack->getPath(), nextTrack->getDuration()});
+			}
+		}
+
 		if (!Database::isAudioBitrateAllowed(*bitrate))
 		{
 			LOG(ERROR) << "Bitrate '" << *bitrate << "' is not allowed";
@@ -165,10 +281,9 @@ readTranscodeParameters(const Wt::Http::Request& request)
 		}
 	}
 
-	parameters.transcodeParameters.stripMetadata = true;
-	parameters.transcodeParameters.format = *avFormat;
-	parameters.transcodeParameters.bitrate = *bitrate;
+	parameters.transcodeParameters = createTranscodeParameters(*avFormat, *bitrate);
 	parameters.transcodeParameters.offset = std::chrono::seconds {offset};
+	parameters.transcodeRequestInfo.clientId = LmsApp->getUserId().toString();
 
 	return parameters;
 }
@@ -184,9 +299,11 @@ AudioTranscodeResource::handleRequest(const Wt::Http::Request& request,
 		Wt::Http::ResponseContinuation* continuation {request.continuation()};
 		if (!continuation)
 		{
-			const std::optional<TranscodeParameters>& parameters {readTranscodeParameters(request)};
-			if (parameters)
-				resourceHandler = Av::createTranscodeResourceHandler(parameters->file, parameters->transcodeParameters);
+			const std::optional<TranscodeParameters>& parameters {readTranscodeParameters(*this, request)};
+			if (parameters && !parameters->sessionTracks.empty())
+				resourceHandler = Av::createTranscodeSessionResourceHandler(parameters->sessionTracks, parameters->transcodeParameters, parameters->transcodeRequestInfo);
+			else if (parameters)
+				resourceHandler = Av::createTranscodeResourceHandler(parameters->file, parameters->transcodeParameters, parameters->transcodeRequestInfo);
 		}
 		else
 		{
@@ -19,10 +19,15 @@
 
 #pragma once
 
+#include <deque>
+#include <mutex>
+#include <vector>
+
 #include <Wt/Dbo/ptr.h>
 #include <Wt/WResource.h>
 
 #include "services/database/TrackId.hpp"
+#include "services/database/Types.hpp"
 
 namespace Database
 {
@@ -38,11 +43,28 @@ namespace UserInterface
 
 			// Url depends on the user since settings are used in parameters
 			std::string getUrl(Database::TrackId trackId) const;
+			// The next tracks are transcoded in the same session, for a gapless playback
+			// Only the sessions handed out by this function can then be requested
+			std::string getSessionUrl(Database::TrackId trackId, const std::vector<Database::TrackId>& nextTrackIds) const;
+			bool isSessionIssued(Database::TrackId trackId, const std::vector<Database::TrackId>& nextTrackIds) const;
+
+			// Transcodes in the background, as it would be requested by the player using these settings
+			static void prefetch(Database::TrackId trackId, Database::AudioFormat format, Database::Bitrate bitrate);
 
 			void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response);
 
 		private:
 			static constexpr std::size_t	_chunkSize {262144};
+			// Some previous sessions are kept since the player may still request them (seeks)
+			static constexpr std::size_t	_maxIssuedSessionCount {8};
+
+			struct IssuedSession
+			{
+				Database::TrackId				trackId;
+				std::vector<Database::TrackId>	nextTrackIds;
+			};
+			mutable std::mutex					_issuedSessionsMutex;
+			mutable std::deque<IssuedSession>	_issuedSessions;
 	};
 } // namespace UserInterface
 
@@ -24,6 +24,7 @@
 
 #include "services/cover/ICoverService.hpp"
 #include "services/database/Track.hpp"
+#include "services/scanner/IScannerService.hpp"
 #include "utils/Exception.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Service.hpp"
@@ -49,16 +50,24 @@ CoverResource::~CoverResource()
 	beingDeleted();
 }
 
+// Covers only change along with the library: versioned URLs can be cached forever by the browsers
+static
+std::string
+getVersionParameter()
+{
+	return "&v=" + std::to_string(Service<Scanner::IScannerService>::get()->getLibraryGeneration().value);
+}
+
 std::string
 CoverResource::getReleaseUrl(Database::ReleaseId releaseId, Size size) const
 {
-	return url() + "&releaseid=" + releaseId.toString() + "&size=" + std::to_string(static_cast<std::size_t>(size));
+	return url() + "&releaseid=" + releaseId.toString() + "&size=" + std::to_string(static_cast<std::size_t>(size)) + getVersionParameter();
 }
 
 std::string
 CoverResource::getTrackUrl(Database::TrackId trackId, Size size) const
 {
-	return url() + "&trackid=" + trackId.toString() + "&size=" + std::to_string(static_cast<std::size_t>(size));
+	return url() + "&trackid=" + trackId.toString() + "&size=" + std::to_string(static_cast<std::size_t>(size)) + getVersionParameter();
 }
 
 void
@@ -83,6 +92,7 @@ CoverResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Respons
 		return;
 	}
 
+	const Image::EncodingFormat format {Cover::selectEncodingFormat(request.headerValue("Accept"))};
 	std::shared_ptr<Image::IEncodedImage> cover;
 
 	if (trackIdStr)
@@ -96,7 +106,7 @@ CoverResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Respons
 			return;
 		}
 
-		cover = Service<Cover::ICoverService>::get()->getFromTrack(*trackId, *size);
+		cover = Service<Cover::ICoverService>::get()->getFromTrack(*trackId, *size, format);
 	}
 	else if (releaseIdStr)
 	{
@@ -106,7 +116,7 @@ CoverResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Respons
 		if (!releaseId)
 			return;
 
-		cover = Service<Cover::ICoverService>::get()->getFromRelease(*releaseId, *size);
+		cover = Service<Cover::ICoverService>::get()->getFromRelease(*releaseId, *size, format);
 	}
 	else
 	{
@@ -114,8 +124,18 @@ CoverResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Respons
 		return;
 	}
 
-	response.setMimeType(std::string {cover->getMimeType()});
+	const std::string entityTag {Cover::computeEntityTag(*cover)};
+	response.addHeader("ETag", entityTag);
+	response.addHeader("Vary", "Accept");
+	response.addHeader("Cache-Control", request.getParameter("v") ? "private, max-age=31536000, immutable" : "private, no-cache");
 
+	if (request.headerValue("If-None-Match").find(entityTag) != std::string::npos)
+	{
+		response.setStatus(304);
+		return;
+	}
+
+	response.setMimeType(std::string {cover->getMimeType()});
 	response.out().write(reinterpret_cast<const char *>(cover->getData()), cover->getDataSize());
 }
 
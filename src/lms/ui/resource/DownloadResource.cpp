@@ -19,17 +19,18 @@
 
 #include "DownloadResource.hpp"
 
+#include <algorithm>
 #include <array>
 #include <iostream>
 #include <iomanip>
 
 #include <Wt/Http/Response.h>
-#include <Wt/WLocalDateTime.h>
 
 #include "services/database/Artist.hpp"
 #include "services/database/Release.hpp"
 #include "services/database/Session.hpp"
 #include "services/database/Track.hpp"
+#include "utils/EgressScheduler.hpp"
 #include "utils/Exception.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Zipper.hpp"
@@ -45,36 +46,82 @@ DownloadResource::~DownloadResource()
 	beingDeleted();
 }
 
+namespace
+{
+	struct DownloadContext
+	{
+		DownloadContext(const std::string& clientId)
+			: transfer {EgressScheduler::TransferInfo {EgressScheduler::TrafficClass::Bulk, clientId}}
+		{}
+
+		std::unique_ptr<Zip::Zipper>	zipper;
+		Zip::SizeType					remainingSize {};
+		EgressScheduler::Transfer		transfer;
+	};
+}
+
 void
 DownloadResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
 {
 	try
 	{
-		std::shared_ptr<Zip::Zipper> zipper;
+		std::shared_ptr<DownloadContext> context;
 
 		// First, see if this request is for a continuation
 		Wt::Http::ResponseContinuation *continuation = request.continuation();
 		if (continuation)
-			zipper = Wt::cpp17::any_cast<std::shared_ptr<Zip::Zipper>>(continuation->data());
+			context = Wt::cpp17::any_cast<std::shared_ptr<DownloadContext>>(continuation->data());
 		else
 		{
-			zipper = createZipper();
-			response.setContentLength(zipper->getTotalZipFile());
+			std::unique_ptr<Zip::Zipper> zipper {createZipper()};
+			if (!zipper)
+				return;
+
+			const Zip::SizeType zipSize {zipper->getTotalZipFile()};
+			const std::string entityTag {zipper->computeEntityTag()};
 			response.setMimeType("application/zip");
+			response.addHeader("Accept-Ranges", "bytes");
+			response.addHeader("ETag", entityTag);
+
+			// Resumed downloads: the ranges only apply if the content did not change in the meantime, the whole content is sent otherwise
+			const std::string ifRange {request.headerValue("If-Range")};
+			const bool applyRanges {ifRange.empty() || ifRange == entityTag};
+			const Wt::Http::Request::ByteRangeSpecifier ranges {applyRanges ? request.getRanges(zipSize) : Wt::Http::Request::ByteRangeSpecifier {}};
+			if (!ranges.isSatisfiable())
+			{
+				response.setStatus(416); // Requested range not satisfiable
+				response.addHeader("Content-Range", "bytes */" + std::to_string(zipSize));
+				return;
+			}
+
+			context = std::make_shared<DownloadContext>(LmsApp->getUserId().toString());
+			if (ranges.size() == 1)
+			{
+				LOG(DEBUG) << "Range requested = " << ranges[0].firstByte() << "-" << ranges[0].lastByte();
+
+				zipper->seek(ranges[0].firstByte());
+				context->remainingSize = ranges[0].lastByte() + 1 - ranges[0].firstByte();
+
+				response.setStatus(206);
+				response.addHeader("Content-Range", "bytes " + std::to_string(ranges[0].firstByte()) + "-" + std::to_string(ranges[0].lastByte()) + "/" + std::to_string(zipSize));
+			}
+			else
+				context->remainingSize = zipSize;
+
+			response.setContentLength(context->remainingSize);
+			context->zipper = std::move(zipper);
 		}
 
-		if (!zipper)
-			return;
-
 		std::array<std::byte, bufferSize> buffer;
-		Zip::SizeType nbWrittenBytes {zipper->writeSome(buffer.data(), buffer.size())};
+		const Zip::SizeType nbWrittenBytes {std::min(context->zipper->writeSome(buffer.data(), buffer.size()), context->remainingSize)};
 
 		response.out().write(reinterpret_cast<const char *>(buffer.data()), nbWrittenBytes);
+		context->remainingSize -= nbWrittenBytes;
 
-		if (!zipper->isComplete())
+		if (!context->zipper->isComplete() && context->remainingSize > 0)
 		{
-			auto* continuation {response.createContinuation()};
-			continuation->setData(zipper);
+			auto* continuation {context->transfer.createContinuation(response, nbWrittenBytes)};
+			continuation->setData(context);
 		}
 	}
 	catch (Zip::ZipperException& exception)
@@ -168,7 +215,8 @@ createZipper(const std::vector<Database::Track::pointer>& tracks)
 		files.emplace(fileName, track->getPath());
 	}
 
-	return std::make_unique<Zip::Zipper>(files, Wt::WLocalDateTime::currentDateTime().toUTC());
+	// use the file modification times, so that the zip content does not change between requests (needed for range requests)
+	return std::make_unique<Zip::Zipper>(files);
 }
 
 DownloadArtistResource::DownloadArtistResource(Database::ArtistId artistId)
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "som/Network.hpp"
+
+namespace
+{
+	// Close to the default recommendation engine settings
+	constexpr std::size_t inputDimCount {64};
+
+	void
+	BM_getClosestRefVectorPosition(benchmark::State& state)
+	{
+		const SOM::Coordinate size {static_cast<SOM::Coordinate>(state.range(0))};
+		const SOM::Network network {size, size, inputDimCount, 42};
+
+		SOM::InputVector input {inputDimCount};
+		for (std::size_t i {}; i < inputDimCount; ++i)
+			input[i] = static_cast<double>(i % 7) / 7;
+
+		for (auto _ : state)
+			benchmark::DoNotOptimize(network.getClosestRefVectorPosition(input));
+	}
+	BENCHMARK(BM_getClosestRefVectorPosition)->Arg(10)->Arg(50);
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <string_view>
+
+#include <benchmark/benchmark.h>
+
+#include "utils/String.hpp"
+
+namespace
+{
+	// Typical multi valued tag
+	constexpr std::string_view tagValue {"Artist One; Artist Two / Artist Three; Artist Four feat. Artist Five"};
+
+	void
+	BM_splitString(benchmark::State& state)
+	{
+		for (auto _ : state)
+			benchmark::DoNotOptimize(StringUtils::splitString(tagValue, ";/"));
+	}
+	BENCHMARK(BM_splitString);
+
+	void
+	BM_escapeString(benchmark::State& state)
+	{
+		const std::string str (static_cast<std::size_t>(state.range(0)), 'a');
+		std::string strWithEscapes {str};
+		for (std::size_t i {}; i < strWithEscapes.size(); i += 8)
+			strWithEscapes[i] = '%';
+
+		for (auto _ : state)
+			benchmark::DoNotOptimize(StringUtils::escapeString(strWithEscapes, "%_", '\\'));
+
+		state.SetBytesProcessed(state.iterations() * state.range(0));
+	}
+	BENCHMARK(BM_escapeString)->Arg(16)->Arg(256);
+
+	void
+	BM_jsEscape(benchmark::State& state)
+	{
+		const std::string str {"Don't \"stop\" me now\\ <Queen>"};
+
+		for (auto _ : state)
+			benchmark::DoNotOptimize(StringUtils::jsEscape(str));
+	}
+	BENCHMARK(BM_jsEscape);
+
+	void
+	BM_stringToLower(benchmark::State& state)
+	{
+		std::string str;
+		while (str.size() < static_cast<std::size_t>(state.range(0)))
+			str += "The Quick Brown Fox ";
+		str.resize(static_cast<std::size_t>(state.range(0)));
+
+		for (auto _ : state)
+			benchmark::DoNotOptimize(StringUtils::stringToLower(std::string_view {str}));
+
+		state.SetBytesProcessed(state.iterations() * state.range(0));
+	}
+	BENCHMARK(BM_stringToLower)->Arg(16)->Arg(256);
+}
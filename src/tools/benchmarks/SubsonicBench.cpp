@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+
+#include <benchmark/benchmark.h>
+
+#include "SubsonicId.hpp"
+#include "SubsonicResponse.hpp"
+
+namespace
+{
+	using namespace API::Subsonic;
+
+	void
+	BM_SubsonicIdFormat(benchmark::State& state)
+	{
+		const Database::TrackId trackId {123456};
+
+		for (auto _ : state)
+			benchmark::DoNotOptimize(idToString(trackId));
+	}
+	BENCHMARK(BM_SubsonicIdFormat);
+
+	void
+	BM_SubsonicIdParse(benchmark::State& state)
+	{
+		for (auto _ : state)
+			benchmark::DoNotOptimize(StringUtils::readAs<Database::TrackId>("tr-123456"));
+	}
+	BENCHMARK(BM_SubsonicIdParse);
+
+	// Looks like a getAlbumList2 response
+	Response
+	createResponse(std::size_t albumCount)
+	{
+		Response response {Response::createOkResponse(defaultServerProtocolVersion)};
+
+		Response::Node& albumListNode {response.createNode("albumList2")};
+		for (std::size_t i {}; i < albumCount; ++i)
+		{
+			Response::Node& albumNode {albumListNode.createArrayChild("album")};
+			albumNode.setAttribute("id", idToString(Database::ReleaseId {static_cast<Database::ReleaseId::ValueType>(i)}));
+			albumNode.setAttribute("name", "My \"Album\" & co");
+			albumNode.setAttribute("artist", "My Artist");
+			albumNode.setAttribute("coverArt", idToString(Database::ReleaseId {static_cast<Database::ReleaseId::ValueType>(i)}));
+			albumNode.setAttribute("songCount", 12);
+			albumNode.setAttribute("duration", 2400);
+			albumNode.setAttribute("year", 1994);
+			albumNode.setAttribute("starred", false);
+		}
+
+		return response;
+	}
+
+	void
+	BM_ResponseWrite(benchmark::State& state, ResponseFormat format)
+	{
+		Response response {createResponse(static_cast<std::size_t>(state.range(0)))};
+
+		for (auto _ : state)
+		{
+			std::ostringstream oss;
+			response.write(oss, format);
+			benchmark::DoNotOptimize(oss.tellp());
+		}
+	}
+	BENCHMARK_CAPTURE(BM_ResponseWrite, xml, ResponseFormat::xml)->Arg(10)->Arg(500);
+	BENCHMARK_CAPTURE(BM_ResponseWrite, json, ResponseFormat::json)->Arg(10)->Arg(500);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "utils/Crc32Calculator.hpp"
+#include "utils/RecursiveSharedMutex.hpp"
+#include "utils/UUID.hpp"
+
+namespace
+{
+	void
+	BM_Crc32Calculator(benchmark::State& state)
+	{
+		std::vector<std::byte> data(static_cast<std::size_t>(state.range(0)));
+		for (std::size_t i {}; i < data.size(); ++i)
+			data[i] = static_cast<std::byte>((i * 7919) ^ (i >> 3));
+
+		for (auto _ : state)
+		{
+			Utils::Crc32Calculator crc;
+			crc.processBytes(data.data(), data.size());
+			benchmark::DoNotOptimize(crc.getResult());
+		}
+
+		state.SetBytesProcessed(state.iterations() * state.range(0));
+	}
+	BENCHMARK(BM_Crc32Calculator)->Arg(64)->Arg(64 * 1024);
+
+	void
+	BM_UUIDFromString(benchmark::State& state)
+	{
+		constexpr std::string_view str {"3F8A7E5C-1B2D-4E6F-9A0B-C1D2E3F4A5B6"};
+
+		for (auto _ : state)
+			benchmark::DoNotOptimize(UUID::fromString(str));
+	}
+	BENCHMARK(BM_UUIDFromString);
+
+	RecursiveSharedMutex sharedMutex;
+
+	void
+	BM_RecursiveSharedMutexShared(benchmark::State& state)
+	{
+		for (auto _ : state)
+		{
+			std::shared_lock lock {sharedMutex};
+			// Recursive lock, as done by nested shared transactions
+			std::shared_lock recursiveLock {sharedMutex};
+		}
+	}
+	BENCHMARK(BM_RecursiveSharedMutexShared)->ThreadRange(1, 8);
+
+	void
+	BM_RecursiveSharedMutexUnique(benchmark::State& state)
+	{
+		RecursiveSharedMutex mutex;
+
+		for (auto _ : state)
+		{
+			std::unique_lock lock {mutex};
+			std::unique_lock recursiveLock {mutex};
+		}
+	}
+	BENCHMARK(BM_RecursiveSharedMutexUnique);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unistd.h>
+
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "utils/Zipper.hpp"
+
+namespace
+{
+	// Removed on destruction
+	class TemporaryFile
+	{
+		public:
+			TemporaryFile(std::size_t size)
+			: _path {std::filesystem::temp_directory_path() / ("lms-benchmarks-" + std::to_string(::getpid()) + "-" + std::to_string(size))}
+			{
+				std::ofstream ofs {_path, std::ios_base::binary};
+				const std::vector<char> data(size, 'a');
+				ofs.write(data.data(), data.size());
+			}
+
+			~TemporaryFile()
+			{
+				std::error_code ec;
+				std::filesystem::remove(_path, ec);
+			}
+
+			TemporaryFile(const TemporaryFile&) = delete;
+			TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+			const std::filesystem::path& getPath() const { return _path; }
+
+		private:
+			const std::filesystem::path _path;
+	};
+
+	void
+	BM_ZipperWriteSome(benchmark::State& state)
+	{
+		constexpr std::size_t fileCount {10};
+		const std::size_t fileSize {static_cast<std::size_t>(state.range(0))};
+		const TemporaryFile file {fileSize};
+
+		std::map<std::string, std::filesystem::path> files;
+		for (std::size_t i {}; i < fileCount; ++i)
+			files.emplace("Artist/Release/" + std::to_string(i) + ".mp3", file.getPath());
+
+		std::array<std::byte, 65536> buffer;
+		for (auto _ : state)
+		{
+			Zip::Zipper zipper {files};
+			while (!zipper.isComplete())
+				benchmark::DoNotOptimize(zipper.writeSome(buffer.data(), buffer.size()));
+		}
+
+		state.SetBytesProcessed(state.iterations() * fileCount * fileSize);
+	}
+	BENCHMARK(BM_ZipperWriteSome)->Arg(4 * 1024)->Arg(1024 * 1024);
+}
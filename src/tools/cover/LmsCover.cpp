@@ -17,10 +17,18 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
 #include <stdlib.h>
+#include <thread>
 
 #include <boost/program_options.hpp>
 
@@ -28,32 +36,181 @@
 #include "services/database/Release.hpp"
 #include "services/database/Session.hpp"
 #include "services/database/Track.hpp"
+#include "services/cover/CoverMetrics.hpp"
 #include "services/cover/ICoverService.hpp"
 #include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/ParallelForPool.hpp"
 #include "utils/Service.hpp"
 #include "utils/StreamLogger.hpp"
 
-static
-void
-dumpTrackCovers(Database::Session& session, Image::ImageSize width)
+namespace
 {
-	using namespace Database;
+	struct GenerationParameters
+	{
+		std::vector<Image::ImageSize>	sizes;
+		Image::EncodingFormat			format;
+		std::size_t						threadCount;
+		bool							verbose;
+	};
+
+	struct ProcessingStats
+	{
+		static constexpr std::array sources {Cover::CoverSource::Embedded, Cover::CoverSource::File};
+		static constexpr std::array sourceFormats {Cover::CoverSourceFormat::JPEG, Cover::CoverSourceFormat::PNG, Cover::CoverSourceFormat::Other};
+		static constexpr std::array stages {Cover::ProcessingStage::Decode, Cover::ProcessingStage::Resize, Cover::ProcessingStage::Encode};
+
+		struct Entry
+		{
+			Metrics::Histogram::Duration	sum {};
+			std::uint64_t					count {};
+		};
+		std::array<Entry, sources.size() * sourceFormats.size() * stages.size()> entries;
+
+		static ProcessingStats
+		get()
+		{
+			ProcessingStats res;
+
+			std::size_t i {};
+			for (Cover::CoverSource source : sources)
+			{
+				for (Cover::CoverSourceFormat sourceFormat : sourceFormats)
+				{
+					for (Cover::ProcessingStage stage : stages)
+					{
+						const Metrics::Histogram::Snapshot snapshot {Cover::getProcessingHistogram(source, sourceFormat, stage).get()};
+						res.entries[i++] = Entry {snapshot.sum, snapshot.count};
+					}
+				}
+			}
+
+			return res;
+		}
+	};
+
+	// Time spent in each stage by the covers that were not found in the disk cache
+	void
+	printProcessingReport(const ProcessingStats& before, const ProcessingStats& after)
+	{
+		std::cout << std::left << std::setw(10) << "source" << std::setw(8) << "format" << std::setw(8) << "stage"
+			<< std::right << std::setw(10) << "count" << std::setw(14) << "total (ms)" << std::setw(12) << "avg (ms)" << std::endl;
+
+		std::size_t i {};
+		for (Cover::CoverSource source : ProcessingStats::sources)
+		{
+			for (Cover::CoverSourceFormat sourceFormat : ProcessingStats::sourceFormats)
+			{
+				for (Cover::ProcessingStage stage : ProcessingStats::stages)
+				{
+					const std::uint64_t count {after.entries[i].count - before.entries[i].count};
+					const double totalMs {std::chrono::duration<double, std::milli> {after.entries[i].sum - before.entries[i].sum}.count()};
+					i++;
+
+					if (!count)
+						continue;
+
+					std::cout << std::left << std::setw(10) << Cover::toString(source) << std::setw(8) << Cover::toString(sourceFormat) << std::setw(8) << Cover::toString(stage)
+						<< std::right << std::setw(10) << count << std::fixed << std::setprecision(1) << std::setw(14) << totalMs << std::setprecision(3) << std::setw(12) << totalMs / count << std::endl;
+				}
+			}
+		}
+	}
+
+	// Each id is requested in all the sizes, the service stores the results in its disk cache
+	template <typename IdType>
+	void
+	generateCovers(std::string_view objectName, const std::vector<IdType>& ids, const GenerationParameters& params, std::function<void(IdType, Image::ImageSize, Image::EncodingFormat)> getCover)
+	{
+		std::cout << "Generating covers for " << ids.size() << " " << objectName << "s, " << params.sizes.size() << " size(s), using " << params.threadCount << " thread(s)" << std::endl;
+
+		std::mutex outputMutex;
+		std::atomic<std::size_t> errorCount {};
+		const ProcessingStats statsBefore {ProcessingStats::get()};
+		const auto start {std::chrono::steady_clock::now()};
+
+		Utils::ParallelForPool pool {params.threadCount};
+		pool.parallelFor(ids.size(), [&](std::size_t first, std::size_t last)
+		{
+			for (std::size_t i {first}; i < last; ++i)
+			{
+				for (const Image::ImageSize size : params.sizes)
+				{
+					try
+					{
+						getCover(ids[i], size, params.format);
+
+						if (params.verbose)
+						{
+							const std::scoped_lock lock {outputMutex};
+							std::cout << "Got cover for " << objectName << " id " << ids[i].toString() << ", size " << size << std::endl;
+						}
+					}
+					catch (const std::exception& e)
+					{
+						errorCount++;
+
+						const std::scoped_lock lock {outputMutex};
+						std::cerr << "Cannot get cover for " << objectName << " id " << ids[i].toString() << ", size " << size << ": " << e.what() << std::endl;
+					}
+				}
+			}
+		}, 1);
+
+		const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - start};
+		const std::size_t coverCount {ids.size() * params.sizes.size()};
+
+		std::cout << "Generated " << coverCount << " covers (" << errorCount << " errors) in " << std::fixed << std::setprecision(2) << elapsed.count() << "s";
+		if (elapsed.count() > 0)
+			std::cout << " (" << std::setprecision(1) << coverCount / elapsed.count() << " covers/s)";
+		std::cout << std::endl;
+
+		printProcessingReport(statsBefore, ProcessingStats::get());
+	}
+
+	void
+	generateTrackCovers(Database::Session& session, const GenerationParameters& params)
+	{
+		Database::RangeResults<Database::TrackId> trackIds;
+		{
+			auto transaction {session.createSharedTransaction()};
+			trackIds = Database::Track::find(session, Database::Track::FindParameters {});
+		}
 
-	RangeResults<Database::TrackId> trackIds;
+		generateCovers<Database::TrackId>("track", trackIds.results, params, [](Database::TrackId trackId, Image::ImageSize size, Image::EncodingFormat format)
+		{
+			Service<Cover::ICoverService>::get()->getFromTrack(trackId, size, format);
+		});
+	}
+
+	void
+	generateReleaseCovers(Database::Session& session, const GenerationParameters& params)
 	{
-		auto transaction {session.createSharedTransaction()};
-		trackIds = Database::Track::find(session, Database::Track::FindParameters {});
+		Database::RangeResults<Database::ReleaseId> releaseIds;
+		{
+			auto transaction {session.createSharedTransaction()};
+			releaseIds = Database::Release::find(session, Database::Release::FindParameters {});
+		}
+
+		generateCovers<Database::ReleaseId>("release", releaseIds.results, params, [](Database::ReleaseId releaseId, Image::ImageSize size, Image::EncodingFormat format)
+		{
+			Service<Cover::ICoverService>::get()->getFromRelease(releaseId, size, format);
+		});
 	}
 
-	for (const Database::TrackId trackId : trackIds.results)
+	Image::EncodingFormat
+	parseEncodingFormat(const std::string& str)
 	{
-		std::cout << "Getting cover for track id " << trackId.toString() << std::endl;
-		Service<Cover::ICoverService>::get()->getFromTrack(trackId, width);
+		if (str == "jpeg")
+			return Image::EncodingFormat::JPEG;
+		if (str == "webp")
+			return Image::EncodingFormat::WebP;
+
+		throw std::runtime_error {"Unhandled format '" + str + "'"};
 	}
 }
 
-
 int main(int argc, char *argv[])
 {
 	try
@@ -69,9 +226,13 @@ int main(int argc, char *argv[])
         ("help,h", "print usage message")
 		("conf,c", po::value<std::string>()->default_value("/etc/lms.conf"), "LMS config file")
         ("default-cover,d", po::value<std::string>(), "Default cover path")
-        ("tracks,t", "dump covers for tracks")
-		("size,s", po::value<unsigned>()->default_value(512), "Requested cover size")
+        ("tracks,t", "generate covers for all tracks")
+        ("releases,r", "generate covers for all releases")
+		("size,s", po::value<std::vector<unsigned>>()->multitoken()->default_value(std::vector<unsigned> {512}, "512"), "Requested cover size(s)")
+		("format,f", po::value<std::string>()->default_value("jpeg"), "Encoding format (jpeg, webp)")
 		("quality,q", po::value<unsigned>()->default_value(75), "JPEG quality (1-100)")
+		("threads,j", po::value<unsigned>()->default_value(std::max(1U, std::thread::hardware_concurrency())), "Number of threads")
+		("verbose,v", "print a line per generated cover")
         ;
 
         po::variables_map vm;
@@ -80,6 +241,7 @@ int main(int argc, char *argv[])
         if (vm.count("help"))
 		{
 			std::cout << desc << std::endl;
+			std::cout << "Covers are stored in the disk cache: set 'cover-disk-cache-size' to 0 to benchmark the whole processing on each run" << std::endl;
             return EXIT_SUCCESS;
         }
 
@@ -89,10 +251,19 @@ int main(int argc, char *argv[])
 
 		coverArtService->setJpegQuality(config->getULong("cover-jpeg-quality", vm["quality"].as<unsigned>()));
 
+		GenerationParameters params;
+		for (const unsigned size : vm["size"].as<std::vector<unsigned>>())
+			params.sizes.push_back(size);
+		params.format = parseEncodingFormat(vm["format"].as<std::string>());
+		params.threadCount = std::max(1U, vm["threads"].as<unsigned>());
+		params.verbose = vm.count("verbose");
+
 		Database::Session session {db};
 
+		if (vm.count("releases"))
+			generateReleaseCovers(session, params);
 		if (vm.count("tracks"))
-			dumpTrackCovers(session, vm["size"].as<unsigned>());
+			generateTrackCovers(session, params);
 	}
 	catch( std::exception& e)
 	{
@@ -102,4 +273,3 @@ int main(int argc, char *argv[])
 
 	return EXIT_SUCCESS;
 }
-
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+// Reference implementation: the stb resize that was used by the stb backend
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_RESIZE_STATIC
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+
+#define STBIR_DEFAULT_FILTER_DOWNSAMPLE   STBIR_FILTER_MITCHELL
+#define STBIR_DEFAULT_FILTER_UPSAMPLE   STBIR_FILTER_CATMULLROM
+
+#include <stb/stb_image.h>
+#include <stb/stb_image_resize.h>
+
+#include "utils/String.hpp"
+#include "Resize.hpp"
+
+namespace
+{
+	struct SourceImage
+	{
+		std::string					name;
+		int							width;
+		int							height;
+		std::vector<unsigned char>	data;	// RGB8
+	};
+
+	SourceImage
+	createSyntheticImage(int width, int height)
+	{
+		SourceImage image {"synthetic", width, height, {}};
+		image.data.resize(static_cast<std::size_t>(width) * height * 3);
+
+		// gradients and some high frequency content
+		for (int y {}; y < height; ++y)
+		{
+			for (int x {}; x < width; ++x)
+			{
+				unsigned char* pixel {&image.data[(static_cast<std::size_t>(y) * width + x) * 3]};
+				pixel[0] = static_cast<unsigned char>(x * 255 / width);
+				pixel[1] = static_cast<unsigned char>(y * 255 / height);
+				pixel[2] = ((x / 4 + y / 4) % 2) ? 255 : 0;
+			}
+		}
+
+		return image;
+	}
+
+	SourceImage
+	loadImage(const std::string& path)
+	{
+		int width;
+		int height;
+		int n;
+		std::unique_ptr<unsigned char, decltype(&std::free)> data {stbi_load(path.c_str(), &width, &height, &n, 3), std::free};
+		if (!data)
+			throw std::runtime_error {"Cannot load image '" + path + "'"};
+
+		return SourceImage {path, width, height, {data.get(), data.get() + static_cast<std::size_t>(width) * height * 3}};
+	}
+
+	using ResizeFunc = std::function<void(const SourceImage&, unsigned char* output, int outputWidth, int outputHeight)>;
+
+	void
+	stbResize(const SourceImage& image, unsigned char* output, int outputWidth, int outputHeight)
+	{
+		if (stbir_resize_uint8_srgb(image.data.data(), image.width, image.height, 0,
+					output, outputWidth, outputHeight, 0,
+					3, STBIR_ALPHA_CHANNEL_NONE, 0) == 0)
+		{
+			throw std::runtime_error {"stb resize failed"};
+		}
+	}
+
+	void
+	lmsResize(const SourceImage& image, unsigned char* output, int outputWidth, int outputHeight)
+	{
+		Image::STB::resizeRGB8(image.data.data(), image.width, image.height, output, outputWidth, outputHeight);
+	}
+
+	// mean duration of a resize, in microseconds
+	double
+	measure(const ResizeFunc& func, const SourceImage& image, std::vector<unsigned char>& output, int outputWidth, int outputHeight, std::size_t iterationCount)
+	{
+		func(image, output.data(), outputWidth, outputHeight); // warm up
+
+		const auto start {std::chrono::steady_clock::now()};
+		for (std::size_t i {}; i < iterationCount; ++i)
+			func(image, output.data(), outputWidth, outputHeight);
+		const auto duration {std::chrono::steady_clock::now() - start};
+
+		return std::chrono::duration<double, std::micro> {duration}.count() / iterationCount;
+	}
+
+	void
+	bench(const SourceImage& image, const std::vector<int>& widths, std::size_t iterationCount)
+	{
+		std::cout << std::endl << image.name << " (" << image.width << "x" << image.height << ")" << std::endl;
+		std::cout << std::left << std::setw(8) << "width" << std::right
+			<< std::setw(12) << "stb (us)" << std::setw(12) << "lms (us)" << std::setw(10) << "speedup" << std::setw(10) << "max diff" << std::endl;
+
+		for (const int width : widths)
+		{
+			// same aspect ratio computation as the stb backend
+			const int height {std::max(1, static_cast<int>(static_cast<float>(width) / image.width * image.height))};
+
+			std::vector<unsigned char> stbOutput(static_cast<std::size_t>(width) * height * 3);
+			std::vector<unsigned char> lmsOutput(stbOutput.size());
+
+			const double stbDuration {measure(stbResize, image, stbOutput, width, height, iterationCount)};
+			const double lmsDuration {measure(lmsResize, image, lmsOutput, width, height, iterationCount)};
+
+			int maxDiff {};
+			for (std::size_t i {}; i < stbOutput.size(); ++i)
+				maxDiff = std::max(maxDiff, std::abs(stbOutput[i] - lmsOutput[i]));
+
+			std::cout << std::left << std::setw(8) << width << std::right << std::fixed << std::setprecision(1)
+				<< std::setw(12) << stbDuration
+				<< std::setw(12) << lmsDuration
+				<< std::setprecision(2)
+				<< std::setw(10) << (lmsDuration > 0 ? stbDuration / lmsDuration : 0)
+				<< std::setw(10) << maxDiff
+				<< std::endl;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		namespace po = boost::program_options;
+
+		po::options_description desc{"Allowed options"};
+		desc.add_options()
+		("help,h", "print usage message")
+		("widths,w", po::value<std::string>()->default_value("64,128,256,512,1024"), "Comma separated output widths")
+		("iterations,n", po::value<std::size_t>()->default_value(20), "Number of resizes per width and implementation")
+		("synthetic-size", po::value<int>()->default_value(1200), "Size of the synthetic square image used if no input is provided")
+		("input", po::value<std::vector<std::string>>(), "Image files (same formats as the stb backend)")
+		;
+
+		po::positional_options_description positional;
+		positional.add("input", -1);
+
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+
+		if (vm.count("help"))
+		{
+			std::cout << "Usage: " << argv[0] << " [options] [input...]" << std::endl << desc << std::endl;
+			return EXIT_SUCCESS;
+		}
+		po::notify(vm);
+
+		std::vector<int> widths;
+		for (std::string_view width : StringUtils::splitString(vm["widths"].as<std::string>(), ","))
+		{
+			const std::optional<int> value {StringUtils::readAs<int>(width)};
+			if (!value || *value <= 0)
+				throw std::runtime_error {"Bad width '" + std::string {width} + "'"};
+
+			widths.push_back(*value);
+		}
+
+		std::vector<SourceImage> images;
+		if (vm.count("input"))
+		{
+			for (const std::string& path : vm["input"].as<std::vector<std::string>>())
+				images.push_back(loadImage(path));
+		}
+		else
+		{
+			const int size {std::max(vm["synthetic-size"].as<int>(), 1)};
+			images.push_back(createSyntheticImage(size, size));
+		}
+
+		const std::size_t iterationCount {std::max<std::size_t>(vm["iterations"].as<std::size_t>(), 1)};
+		for (const SourceImage& image : images)
+			bench(image, widths, iterationCount);
+
+		std::cout << std::endl << "stb: generic stb resize, lms: stb backend resize, max diff: max channel difference between both outputs" << std::endl;
+	}
+	catch (const boost::program_options::error& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Caught exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <boost/program_options.hpp>
+
+#include "services/database/Db.hpp"
+#include "services/database/ScanSettings.hpp"
+#include "services/database/Session.hpp"
+#include "services/database/generator/LibraryGenerator.hpp"
+#include "utils/Service.hpp"
+#include "utils/StreamLogger.hpp"
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		namespace po = boost::program_options;
+
+		const Database::Generator::LibraryParameters defaultParameters;
+
+		po::options_description desc{"Allowed options"};
+		desc.add_options()
+		("help,h", "print usage message")
+		("db", po::value<std::string>(), "Database file to create")
+		("artist-count", po::value<std::size_t>()->default_value(defaultParameters.artistCount), "Number of artists")
+		("releases-per-artist", po::value<std::size_t>()->default_value(defaultParameters.releasesPerArtist), "Mean number of releases per artist")
+		("tracks-per-release", po::value<std::size_t>()->default_value(defaultParameters.tracksPerRelease), "Mean number of tracks per release")
+		("multi-artist-track-percent", po::value<unsigned>()->default_value(defaultParameters.multiArtistTrackPercent), "Percentage of tracks that have several artists")
+		("mbid-percent", po::value<unsigned>()->default_value(defaultParameters.mbidPercent), "Percentage of artists, releases and tracks that have a MusicBrainz id")
+		("genre-count", po::value<std::size_t>()->default_value(defaultParameters.genreCount), "Number of genres")
+		("mood-count", po::value<std::size_t>()->default_value(defaultParameters.moodCount), "Number of moods")
+		("user-count", po::value<std::size_t>()->default_value(defaultParameters.userCount), "Number of users")
+		("starred-percent", po::value<unsigned>()->default_value(defaultParameters.starredPercent), "Percentage of starred artists, releases and tracks, per user")
+		("listens-per-user", po::value<std::size_t>()->default_value(defaultParameters.listensPerUser), "Number of listens per user")
+		("playlists-per-user", po::value<std::size_t>()->default_value(defaultParameters.playlistsPerUser), "Number of playlists per user")
+		("tracks-per-playlist", po::value<std::size_t>()->default_value(defaultParameters.tracksPerPlaylist), "Number of tracks per playlist")
+		("track-features-percent", po::value<unsigned>()->default_value(defaultParameters.trackFeaturesPercent), "Percentage of tracks that have features")
+		("media-directory,m", po::value<std::string>()->default_value(defaultParameters.mediaDirectory.string()), "Media directory of the tracks, also set as the media root")
+		("create-files", "Create sparse placeholder files for the tracks in the media directory")
+		("seed", po::value<std::uint_fast32_t>()->default_value(defaultParameters.seed), "Random seed")
+		("verbose,v", "Log database messages")
+		;
+
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+
+		if (vm.count("help") || !vm.count("db"))
+		{
+			std::cout << desc << std::endl;
+			return vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		std::ostream nullStream {nullptr};
+		Service<Logger> logger {std::make_unique<StreamLogger>(vm.count("verbose") ? std::cout : nullStream)};
+
+		const std::filesystem::path dbPath {vm["db"].as<std::string>()};
+		if (std::filesystem::exists(dbPath))
+		{
+			std::cerr << "Database file '" << dbPath.string() << "' already exists" << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		Database::Generator::LibraryParameters parameters;
+		parameters.artistCount = vm["artist-count"].as<std::size_t>();
+		parameters.releasesPerArtist = vm["releases-per-artist"].as<std::size_t>();
+		parameters.tracksPerRelease = vm["tracks-per-release"].as<std::size_t>();
+		parameters.multiArtistTrackPercent = vm["multi-artist-track-percent"].as<unsigned>();
+		parameters.mbidPercent = vm["mbid-percent"].as<unsigned>();
+		parameters.genreCount = vm["genre-count"].as<std::size_t>();
+		parameters.moodCount = vm["mood-count"].as<std::size_t>();
+		parameters.userCount = vm["user-count"].as<std::size_t>();
+		parameters.starredPercent = vm["starred-percent"].as<unsigned>();
+		parameters.listensPerUser = vm["listens-per-user"].as<std::size_t>();
+		parameters.playlistsPerUser = vm["playlists-per-user"].as<std::size_t>();
+		parameters.tracksPerPlaylist = vm["tracks-per-playlist"].as<std::size_t>();
+		parameters.trackFeaturesPercent = vm["track-features-percent"].as<unsigned>();
+		parameters.mediaDirectory = vm["media-directory"].as<std::string>();
+		parameters.createFiles = vm.count("create-files") > 0;
+		parameters.seed = vm["seed"].as<std::uint_fast32_t>();
+
+		Database::Db db {dbPath};
+		{
+			Database::Session session {db};
+			session.prepareTables();
+
+			auto transaction {session.createUniqueTransaction()};
+
+			Database::ScanSettings::get(session).modify()->setMediaRoots(session, {Database::ScanSettings::MediaRootInfo {parameters.mediaDirectory, {}}});
+		}
+
+		std::cout << "Generating " << parameters.artistCount << " artists..." << std::endl;
+		const Database::Generator::Library library {Database::Generator::generateLibrary(db, parameters, [&](std::size_t generatedArtistCount)
+		{
+			if (generatedArtistCount % 100 == 0)
+				std::cout << generatedArtistCount << "/" << parameters.artistCount << " artists generated" << std::endl;
+		})};
+
+		{
+			Database::Session session {db};
+			session.optimize();
+		}
+
+		std::cout << "Generated " << library.artistIds.size() << " artists, " << library.releaseIds.size() << " releases, " << library.trackIds.size() << " tracks, "
+			<< library.userIds.size() << " users and " << library.trackListIds.size() << " playlists" << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Caught exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
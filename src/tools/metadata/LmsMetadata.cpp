@@ -17,17 +17,29 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <map>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
 #include <stdlib.h>
 #include <iostream>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 
+#include <boost/program_options.hpp>
 #include <Wt/WDate.h>
 
 #include "metadata/AvFormatParser.hpp"
 #include "metadata/TagLibParser.hpp"
+#include "utils/DurationHistogram.hpp"
+#include "utils/Path.hpp"
 #include "utils/StreamLogger.hpp"
+#include "utils/String.hpp"
 
 std::ostream& operator<<(std::ostream& os, const MetaData::Artist& artist)
 {
@@ -163,22 +175,209 @@ void parse(MetaData::IParser& parser, const std::filesystem::path& file)
 	std::cout << std::endl;
 }
 
-int main(int argc, char *argv[])
+namespace
 {
-	if (argc == 1)
+	// Same as the default scan settings
+	const std::unordered_set<std::filesystem::path> audioFileExtensions {".alac", ".mp3", ".ogg", ".oga", ".aac", ".m4a", ".m4b", ".flac", ".wav", ".wma", ".aif", ".aiff", ".ape", ".mpc", ".shn", ".opus", ".wv"};
+
+	std::vector<std::filesystem::path>
+	findAudioFiles(const std::vector<std::filesystem::path>& paths)
 	{
-		std::cerr << "Usage: <file> [<file> ...]" << std::endl;
-		return EXIT_FAILURE;
+		std::vector<std::filesystem::path> files;
+
+		for (const std::filesystem::path& path : paths)
+		{
+			if (!std::filesystem::is_directory(path))
+			{
+				files.push_back(path);
+				continue;
+			}
+
+			exploreFilesRecursive(path, [&](std::error_code ec, const std::filesystem::path& file)
+			{
+				if (ec)
+					std::cerr << "Cannot explore '" << file.string() << "': " << ec.message() << std::endl;
+				else if (audioFileExtensions.find(StringUtils::stringToLower(file.extension().string())) != std::cend(audioFileExtensions))
+					files.push_back(file);
+
+				return true;
+			});
+		}
+
+		return files;
+	}
+
+	struct ParseTimes
+	{
+		std::size_t					fileCount {};
+		std::size_t					failureCount {};
+		std::chrono::microseconds	totalDuration {};
+	};
+
+	struct ParserReport
+	{
+		std::size_t									outlierCount {};
+		ParseTimes									total;
+		DurationHistogram							durations;
+		std::map<std::string, ParseTimes>			byExtension;
+		std::map<std::filesystem::path, ParseTimes>	byDirectory;
+	};
+
+	void
+	add(ParseTimes& times, std::chrono::microseconds duration, bool success)
+	{
+		times.fileCount++;
+		times.totalDuration += duration;
+		if (!success)
+			times.failureCount++;
+	}
+
+	template <typename Key>
+	void
+	printParseTimes(std::string_view title, const std::map<Key, ParseTimes>& parseTimes, std::size_t maxCount)
+	{
+		std::vector<std::pair<Key, ParseTimes>> sortedParseTimes(std::cbegin(parseTimes), std::cend(parseTimes));
+		std::sort(std::begin(sortedParseTimes), std::end(sortedParseTimes), [](const auto& lhs, const auto& rhs) { return lhs.second.totalDuration > rhs.second.totalDuration; });
+		if (sortedParseTimes.size() > maxCount)
+			sortedParseTimes.resize(maxCount);
+
+		std::cout << "  " << title << ":" << std::endl;
+		for (const auto& [key, times] : sortedParseTimes)
+		{
+			std::cout << "    " << key << ": " << times.totalDuration.count() / 1000 << "ms, " << times.fileCount << " files (avg = " << times.totalDuration.count() / 1000. / times.fileCount << "ms)";
+			if (times.failureCount)
+				std::cout << ", " << times.failureCount << " failures";
+			std::cout << std::endl;
+		}
+	}
+
+	// Each worker owns a parser, since parsers are not thread safe
+	template <typename Parser>
+	void
+	benchmarkParser(std::string_view parserName, const std::vector<std::filesystem::path>& files, std::size_t threadCount, std::chrono::milliseconds outlierThreshold, bool printAllFiles)
+	{
+		std::cout << "Parsing " << files.size() << " files using " << parserName << " (" << threadCount << " thread(s))..." << std::endl;
+
+		ParserReport report;
+		std::mutex mutex;
+		std::atomic<std::size_t> nextFileIndex {};
+
+		const auto start {std::chrono::steady_clock::now()};
+
+		std::vector<std::thread> threads;
+		for (std::size_t i {}; i < threadCount; ++i)
+		{
+			threads.emplace_back([&]
+			{
+				Parser concreteParser;
+				MetaData::IParser& parser {concreteParser};
+
+				for (std::size_t fileIndex {nextFileIndex++}; fileIndex < files.size(); fileIndex = nextFileIndex++)
+				{
+					const std::filesystem::path& file {files[fileIndex]};
+
+					const auto parseStart {std::chrono::steady_clock::now()};
+					const bool success {parser.parse(file).has_value()};
+					const auto duration {std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - parseStart)};
+					const bool isOutlier {duration >= outlierThreshold};
+
+					std::scoped_lock lock {mutex};
+
+					add(report.total, duration, success);
+					add(report.byExtension[StringUtils::stringToLower(file.extension().string())], duration, success);
+					add(report.byDirectory[file.parent_path()], duration, success);
+					report.durations.add(duration);
+					if (isOutlier)
+						report.outlierCount++;
+
+					if (printAllFiles || isOutlier || !success)
+					{
+						std::cout << parserName << ": " << duration.count() / 1000. << "ms " << file.string();
+						if (!success)
+							std::cout << " [FAILED]";
+						if (isOutlier)
+							std::cout << " [SLOW]";
+						std::cout << std::endl;
+					}
+				}
+			});
+		}
+
+		for (std::thread& thread : threads)
+			thread.join();
+
+		const auto wallDuration {std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)};
+
+		std::cout << parserName << " summary:" << std::endl;
+		std::cout << "  " << report.total.fileCount << " files in " << wallDuration.count() << "ms (" << (wallDuration.count() ? report.total.fileCount * 1000. / wallDuration.count() : 0) << " files/s)"
+			<< ", " << report.total.failureCount << " failures"
+			<< ", " << report.outlierCount << " outliers (>= " << outlierThreshold.count() << "ms)" << std::endl;
+		std::cout << "  parse time: total = " << report.total.totalDuration.count() / 1000 << "ms"
+			<< ", p50 = " << report.durations.getPercentile(50).count() / 1000. << "ms"
+			<< ", p99 = " << report.durations.getPercentile(99).count() / 1000. << "ms" << std::endl;
+		printParseTimes("by format", report.byExtension, report.byExtension.size());
+		printParseTimes("most expensive directories", report.byDirectory, 10);
+		std::cout << std::endl;
 	}
+}
 
+int main(int argc, char *argv[])
+{
 	try
 	{
+		namespace po = boost::program_options;
+
+		po::options_description desc{"Allowed options"};
+		desc.add_options()
+		("help,h", "print usage message")
+		("recursive,r", "Benchmark mode: parse all the audio files found in the given paths and report parse times, instead of printing the metadata")
+		("parser,p", po::value<std::string>()->default_value("all"), "Benchmark mode: parser to use: 'taglib', 'avformat' or 'all'")
+		("threads,t", po::value<std::size_t>()->default_value(std::max<std::size_t>(1, std::thread::hardware_concurrency())), "Benchmark mode: number of parsing threads")
+		("outlier-threshold", po::value<unsigned>()->default_value(100), "Benchmark mode: files parsed in more than this duration (in ms) are reported")
+		("all-files,a", "Benchmark mode: report the parse time of every file, not only the outliers and failures")
+		("file", po::value<std::vector<std::string>>(), "Files to parse (or directories in benchmark mode)")
+		;
+
+		po::positional_options_description positional;
+		positional.add("file", -1);
+
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+
+		if (vm.count("help") || !vm.count("file"))
+		{
+			std::cout << "Usage: " << argv[0] << " [options] <file> [<file> ...]" << std::endl << desc << std::endl;
+			return vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		const std::vector<std::string>& paths {vm["file"].as<std::vector<std::string>>()};
+
+		if (vm.count("recursive"))
+		{
+			// Parser errors are reported by the benchmark itself
+			std::ostream nullStream {nullptr};
+			Service<Logger> logger {std::make_unique<StreamLogger>(nullStream)};
+
+			const std::vector<std::filesystem::path> files {findAudioFiles(std::vector<std::filesystem::path>(std::cbegin(paths), std::cend(paths)))};
+			const std::string parser {StringUtils::stringToLower(vm["parser"].as<std::string>())};
+			const std::size_t threadCount {std::max<std::size_t>(1, vm["threads"].as<std::size_t>())};
+			const std::chrono::milliseconds outlierThreshold {vm["outlier-threshold"].as<unsigned>()};
+			const bool printAllFiles {vm.count("all-files") > 0};
+
+			if (parser == "taglib" || parser == "all")
+				benchmarkParser<MetaData::TagLibParser>("TagLib", files, threadCount, outlierThreshold, printAllFiles);
+			if (parser == "avformat" || parser == "all")
+				benchmarkParser<MetaData::AvFormatParser>("AvFormat", files, threadCount, outlierThreshold, printAllFiles);
+
+			return EXIT_SUCCESS;
+		}
+
 		// log to stdout
 		Service<Logger> logger {std::make_unique<StreamLogger>(std::cout)};
 
-		for (std::size_t  i {}; i < static_cast<std::size_t>(argc - 1); ++i)
+		for (const std::string& path : paths)
 		{
-			std::filesystem::path file {argv[i + 1]};
+			const std::filesystem::path file {path};
 
 			std::cout << "Parsing file '" << file << "'" << std::endl;
 
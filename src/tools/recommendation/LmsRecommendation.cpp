@@ -17,10 +17,18 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <optional>
 #include <stdexcept>
 #include <stdlib.h>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <boost/program_options.hpp>
 
@@ -32,7 +40,9 @@
 #include "services/database/Track.hpp"
 #include "services/database/Types.hpp"
 #include "services/recommendation/IRecommendationService.hpp"
+#include "utils/DurationHistogram.hpp"
 #include "utils/IConfig.hpp"
+#include "utils/Random.hpp"
 #include "utils/Service.hpp"
 #include "utils/StreamLogger.hpp"
 
@@ -130,6 +140,117 @@ dumpArtistsRecommendation(Session session, Recommendation::IRecommendationServic
 	}
 }
 
+namespace
+{
+	// resident set size, in KiB (Linux only)
+	std::optional<std::size_t>
+	getResidentMemorySize()
+	{
+		std::ifstream ifs {"/proc/self/status"};
+		std::string line;
+		while (std::getline(ifs, line))
+		{
+			if (line.rfind("VmRSS:", 0) == 0)
+				return std::stoul(line.substr(6));
+		}
+
+		return std::nullopt;
+	}
+
+	template <typename IdType>
+	std::vector<IdType>
+	pickSample(std::vector<IdType> ids, std::size_t sampleCount, Random::RandGenerator& generator)
+	{
+		std::vector<IdType> res;
+		std::sample(std::cbegin(ids), std::cend(ids), std::back_inserter(res), sampleCount, generator);
+		return res;
+	}
+
+	template <typename IdType, typename Func>
+	void
+	benchQueries(std::string_view engineName, std::string_view queryName, const std::vector<IdType>& ids, Func func)
+	{
+		DurationHistogram latencies;
+		std::size_t totalResultCount {};
+		std::size_t emptyResultCount {};
+
+		for (const IdType id : ids)
+		{
+			const auto start {std::chrono::steady_clock::now()};
+			const std::size_t resultCount {func(id)};
+			latencies.add(std::chrono::duration_cast<DurationHistogram::Duration>(std::chrono::steady_clock::now() - start));
+
+			totalResultCount += resultCount;
+			if (resultCount == 0)
+				emptyResultCount++;
+		}
+
+		std::cout << "{\"engine\": \"" << engineName << "\", \"query\": \"" << queryName << "\""
+			<< ", \"count\": " << latencies.getCount()
+			<< ", \"p50_us\": " << latencies.getPercentile(50).count()
+			<< ", \"p90_us\": " << latencies.getPercentile(90).count()
+			<< ", \"p99_us\": " << latencies.getPercentile(99).count()
+			<< ", \"mean_result_count\": " << (ids.empty() ? 0. : static_cast<double>(totalResultCount) / ids.size())
+			<< ", \"empty_result_count\": " << emptyResultCount
+			<< "}" << std::endl;
+	}
+
+	void
+	bench(Db& db, Recommendation::EngineType engineType, std::size_t sampleCount, unsigned maxSimilarityCount, std::uint_fast32_t seed)
+	{
+		const std::string_view engineName {[&]
+		{
+			switch (engineType)
+			{
+				case Recommendation::EngineType::Clusters: return "clusters";
+				case Recommendation::EngineType::Features: return "features";
+				case Recommendation::EngineType::Hnsw: return "hnsw";
+			}
+			return "";
+		}()};
+
+		Session session {db};
+		Random::RandGenerator generator {Random::createSeededGenerator(seed)};
+
+		std::vector<TrackId> trackIds;
+		std::vector<ReleaseId> releaseIds;
+		std::vector<ArtistId> artistIds;
+		{
+			auto transaction {session.createSharedTransaction()};
+
+			trackIds = pickSample(Track::find(session, Track::FindParameters {}).results, sampleCount, generator);
+			releaseIds = pickSample(Release::find(session, Release::FindParameters {}).results, sampleCount, generator);
+			artistIds = pickSample(Artist::find(session, Artist::FindParameters {}).results, sampleCount, generator);
+		}
+
+		const std::optional<std::size_t> memorySizeBeforeLoad {getResidentMemorySize()};
+		const auto loadStart {std::chrono::steady_clock::now()};
+
+		const auto recommendationService {Recommendation::createRecommendationService(db, engineType)};
+		recommendationService->load(false);
+
+		const auto loadDuration {std::chrono::steady_clock::now() - loadStart};
+		const std::optional<std::size_t> memorySizeAfterLoad {getResidentMemorySize()};
+
+		std::cout << "{\"engine\": \"" << engineName << "\", \"load_ms\": " << std::chrono::duration_cast<std::chrono::milliseconds>(loadDuration).count();
+		if (memorySizeBeforeLoad && memorySizeAfterLoad)
+			std::cout << ", \"memory_kib\": " << (*memorySizeAfterLoad > *memorySizeBeforeLoad ? *memorySizeAfterLoad - *memorySizeBeforeLoad : 0);
+		std::cout << "}" << std::endl;
+
+		benchQueries(engineName, "findSimilarTracks", trackIds, [&](TrackId trackId)
+		{
+			return recommendationService->findSimilarTracks({trackId}, maxSimilarityCount).size();
+		});
+		benchQueries(engineName, "getSimilarReleases", releaseIds, [&](ReleaseId releaseId)
+		{
+			return recommendationService->getSimilarReleases(releaseId, maxSimilarityCount).size();
+		});
+		benchQueries(engineName, "getSimilarArtists", artistIds, [&](ArtistId artistId)
+		{
+			return recommendationService->getSimilarArtists(artistId, {TrackArtistLinkType::Artist, TrackArtistLinkType::ReleaseArtist}, maxSimilarityCount).size();
+		});
+	}
+}
 
 int main(int argc, char *argv[])
 {
@@ -137,9 +258,6 @@ int main(int argc, char *argv[])
 	{
 		namespace po = boost::program_options;
 
-		// log to stdout
-		Service<Logger> logger {std::make_unique<StreamLogger>(std::cout)};
-
 		po::options_description desc{"Allowed options"};
         desc.add_options()
         ("help,h", "print usage message")
@@ -148,6 +266,10 @@ int main(int argc, char *argv[])
         ("releases,r", "Display recommendation for releases")
         ("tracks,t", "Display recommendation for tracks")
 		("max,m", po::value<unsigned>()->default_value(3), "Max similarity result count")
+		("bench,b", "Benchmark mode: measure load time, memory and query latencies of the engines, one JSON object per line")
+		("engine,e", po::value<std::string>()->default_value("all"), "Benchmarked engine: clusters, features, hnsw or all")
+		("sample-count,n", po::value<std::size_t>()->default_value(1000), "Number of random tracks, releases and artists queried in benchmark mode")
+		("seed", po::value<std::uint_fast32_t>()->default_value(0), "Seed used to pick the benchmark samples")
         ;
 
         po::variables_map vm;
@@ -159,10 +281,32 @@ int main(int argc, char *argv[])
             return EXIT_SUCCESS;
         }
 
+		// log to stdout, or to stderr to keep the benchmark output machine readable
+		Service<Logger> logger {std::make_unique<StreamLogger>(vm.count("bench") ? std::cerr : std::cout)};
+
 		Service<IConfig> config {createConfig(vm["conf"].as<std::string>())};
 
 		Db db {config->getPath("working-dir") / "lms.db"};
-		Session session {db};
+
+		if (vm.count("bench"))
+		{
+			const std::string engine {vm["engine"].as<std::string>()};
+			if (engine != "all" && engine != "clusters" && engine != "features" && engine != "hnsw")
+				throw std::runtime_error {"Bad engine '" + engine + "'"};
+
+			std::vector<Recommendation::EngineType> engineTypes;
+			if (engine == "all" || engine == "clusters")
+				engineTypes.push_back(Recommendation::EngineType::Clusters);
+			if (engine == "all" || engine == "features")
+				engineTypes.push_back(Recommendation::EngineType::Features);
+			if (engine == "all" || engine == "hnsw")
+				engineTypes.push_back(Recommendation::EngineType::Hnsw);
+
+			for (Recommendation::EngineType engineType : engineTypes)
+				bench(db, engineType, vm["sample-count"].as<std::size_t>(), vm["max"].as<unsigned>(), vm["seed"].as<std::uint_fast32_t>());
+
+			return EXIT_SUCCESS;
+		}
 
 		std::cout << "Creating recommendation recommendationService..." << std::endl;
 		const auto recommendationService {Recommendation::createRecommendationService(db)};
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <stdlib.h>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "metadata/AvFormatParser.hpp"
+#include "metadata/TagLibParser.hpp"
+#include "services/database/Db.hpp"
+#include "services/database/ScanSettings.hpp"
+#include "services/database/Session.hpp"
+#include "services/recommendation/IRecommendationService.hpp"
+#include "services/scanner/IScannerService.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/Path.hpp"
+#include "utils/Service.hpp"
+#include "utils/StreamLogger.hpp"
+#include "utils/String.hpp"
+
+namespace
+{
+	// Removed with all its content on destruction
+	class TemporaryDirectory
+	{
+		public:
+			TemporaryDirectory()
+			: _path {std::filesystem::temp_directory_path() / ("lms-scan-bench-" + std::to_string(::getpid()))}
+			{
+				std::filesystem::create_directories(_path);
+			}
+
+			~TemporaryDirectory()
+			{
+				std::error_code ec;
+				std::filesystem::remove_all(_path, ec);
+			}
+
+			TemporaryDirectory(const TemporaryDirectory&) = delete;
+			TemporaryDirectory(TemporaryDirectory&&) = delete;
+			TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+			TemporaryDirectory& operator=(TemporaryDirectory&&) = delete;
+
+			const std::filesystem::path& getPath() const { return _path; }
+
+		private:
+			const std::filesystem::path _path;
+	};
+
+	// Build a tree that looks like a regular library, using copies of the same file
+	void
+	generateSyntheticTree(const std::filesystem::path& sampleFile, std::size_t fileCount, const std::filesystem::path& rootDirectory)
+	{
+		static constexpr std::size_t filesPerRelease {12};
+		static constexpr std::size_t releasesPerArtist {5};
+
+		std::cout << "Generating " << fileCount << " files in '" << rootDirectory.string() << "'..." << std::endl;
+
+		for (std::size_t i {}; i < fileCount; ++i)
+		{
+			const std::size_t releaseIndex {i / filesPerRelease};
+			const std::filesystem::path directory {rootDirectory / ("artist-" + std::to_string(releaseIndex / releasesPerArtist)) / ("release-" + std::to_string(releaseIndex))};
+
+			std::filesystem::create_directories(directory);
+			std::filesystem::copy_file(sampleFile, directory / ("track-" + std::to_string(i % filesPerRelease) + sampleFile.extension().string()));
+		}
+	}
+
+	std::vector<std::filesystem::path>
+	findAudioFiles(const std::filesystem::path& directory, const std::vector<std::filesystem::path>& fileExtensions)
+	{
+		std::unordered_set<std::filesystem::path> extensions;
+		for (const std::filesystem::path& extension : fileExtensions)
+			extensions.insert(StringUtils::stringToLower(extension.string()));
+
+		std::vector<std::filesystem::path> files;
+		exploreFilesRecursive(directory, [&](std::error_code ec, const std::filesystem::path& path)
+		{
+			if (!ec && extensions.find(StringUtils::stringToLower(path.extension().string())) != std::cend(extensions))
+				files.push_back(path);
+
+			return true;
+		});
+
+		return files;
+	}
+
+	double
+	getRate(std::size_t count, std::chrono::milliseconds duration)
+	{
+		return duration.count() ? count * 1000. / duration.count() : 0;
+	}
+
+	void
+	benchmarkParser(MetaData::IParser& parser, std::string_view parserName, const std::vector<std::filesystem::path>& files)
+	{
+		std::cout << "Parsing " << files.size() << " files using " << parserName << "..." << std::endl;
+
+		std::size_t failureCount {};
+		const auto start {std::chrono::steady_clock::now()};
+		for (const std::filesystem::path& file : files)
+		{
+			if (!parser.parse(file))
+				failureCount++;
+		}
+		const auto duration {std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)};
+
+		std::cout << parserName << ": " << duration.count() << "ms, " << getRate(files.size(), duration) << " files/s, " << failureCount << " failures" << std::endl;
+	}
+
+	void
+	printScanStats(std::string_view scanName, const Scanner::ScanStats& stats)
+	{
+		using namespace Scanner;
+
+		auto printStep {[&](std::string_view stepName, ScanProgressStep step, std::optional<std::size_t> count)
+		{
+			const std::chrono::milliseconds duration {stats.getStepDuration(step)};
+
+			std::cout << "\t" << std::left << std::setw(28) << stepName << std::right << std::setw(10) << duration.count() << "ms";
+			if (count)
+				std::cout << std::setw(12) << std::fixed << std::setprecision(1) << getRate(*count, duration) << " files/s";
+			std::cout << std::endl;
+		}};
+
+		std::cout << "*** " << scanName << " ***" << std::endl;
+		std::cout << "Total duration: " << std::chrono::duration_cast<std::chrono::milliseconds>(stats.stopTime.toTimePoint() - stats.startTime.toTimePoint()).count() << "ms" << std::endl;
+		std::cout << "Files: " << stats.filesScanned << ", scanned = " << stats.scans << ", skipped = " << stats.skips << ", errors = " << stats.errors.size()
+			<< ", added = " << stats.additions << ", updated = " << stats.updates << ", removed = " << stats.deletions << std::endl;
+
+		printStep("Discovering files", ScanProgressStep::DiscoveringFiles, stats.filesScanned);
+		printStep("Checking for missing files", ScanProgressStep::ChekingForMissingFiles, std::nullopt);
+		printStep("Scanning files", ScanProgressStep::ScanningFiles, stats.nbFiles());
+		printStep("Removing orphan entries", ScanProgressStep::RemovingOrphanEntries, std::nullopt);
+		printStep("Checking for duplicates", ScanProgressStep::CheckingForDuplicates, stats.duplicates.size());
+		printStep("Fetching track features", ScanProgressStep::FetchingTrackFeatures, std::nullopt);
+		printStep("Reloading similarity engine", ScanProgressStep::ReloadingSimilarityEngine, std::nullopt);
+
+		std::cout << "Scanned bytes: " << stats.bytesScanned << " (" << std::fixed << std::setprecision(1) << stats.getScanThroughput() / (1024 * 1024) << " MB/s)" << std::endl;
+		std::cout << "Parse latency p50/p99: " << stats.parseDurations.getPercentile(50).count() << "/" << stats.parseDurations.getPercentile(99).count() << "us" << std::endl;
+		std::cout << "Write latency p50/p99: " << stats.writeDurations.getPercentile(50).count() << "/" << stats.writeDurations.getPercentile(99).count() << "us" << std::endl;
+		std::cout << std::endl;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		namespace po = boost::program_options;
+
+		po::options_description desc{"Allowed options"};
+		desc.add_options()
+		("help,h", "print usage message")
+		("conf,c", po::value<std::string>()->default_value("/etc/lms.conf"), "LMS config file, used for the scanner settings")
+		("media-directory,m", po::value<std::string>(), "Directory to scan")
+		("synthetic-sample", po::value<std::string>(), "Generate a synthetic tree made of copies of this file, instead of using a media directory")
+		("synthetic-count", po::value<std::size_t>()->default_value(1000), "Number of files in the synthetic tree")
+		("parser,p", po::value<std::string>()->default_value("none"), "Also benchmark parsers alone: 'taglib', 'taglib-mmap', 'avformat', 'all' or 'none'")
+		("rescan,r", "Run a second, non forced, scan to measure unchanged files")
+		("verbose,v", "Log scanner messages")
+		;
+
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+
+		if (vm.count("help") || (!vm.count("media-directory") && !vm.count("synthetic-sample")))
+		{
+			std::cout << desc << std::endl;
+			return vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		// Scanner logs are discarded unless requested
+		std::ostream nullStream {nullptr};
+		Service<Logger> logger {std::make_unique<StreamLogger>(vm.count("verbose") ? std::cout : nullStream)};
+		Service<IConfig> config {createConfig(vm["conf"].as<std::string>())};
+
+		const TemporaryDirectory workingDirectory;
+
+		std::filesystem::path mediaDirectory;
+		if (vm.count("synthetic-sample"))
+		{
+			mediaDirectory = workingDirectory.getPath() / "media";
+			generateSyntheticTree(vm["synthetic-sample"].as<std::string>(), vm["synthetic-count"].as<std::size_t>(), mediaDirectory);
+		}
+		else
+			mediaDirectory = vm["media-directory"].as<std::string>();
+
+		// Throwaway database, in order not to mess with the real one
+		Database::Db db {workingDirectory.getPath() / "lms.db"};
+		std::vector<std::filesystem::path> fileExtensions;
+		{
+			Database::Session session {db};
+			session.prepareTables();
+
+			auto transaction {session.createUniqueTransaction()};
+
+			Database::ScanSettings::pointer scanSettings {Database::ScanSettings::get(session)};
+			scanSettings.modify()->setMediaRoots(session, {Database::ScanSettings::MediaRootInfo {mediaDirectory, {}}});
+			fileExtensions = scanSettings->getAudioFileExtensions();
+		}
+
+		const std::string parser {StringUtils::stringToLower(vm["parser"].as<std::string>())};
+		if (parser != "none")
+		{
+			const std::vector<std::filesystem::path> files {findAudioFiles(mediaDirectory, fileExtensions)};
+
+			if (parser == "taglib" || parser == "all")
+			{
+				MetaData::TagLibParser tagLibParser;
+				benchmarkParser(tagLibParser, "TagLib", files);
+			}
+			if (parser == "taglib-mmap" || parser == "all")
+			{
+				MetaData::TagLibParser tagLibParser {MetaData::TagLibParser::ReadStyle::Fast, true};
+				benchmarkParser(tagLibParser, "TagLib (memory mapped)", files);
+			}
+			if (parser == "avformat" || parser == "all")
+			{
+				MetaData::AvFormatParser avFormatParser;
+				benchmarkParser(avFormatParser, "AvFormat", files);
+			}
+			std::cout << std::endl;
+		}
+
+		const auto recommendationService {Recommendation::createRecommendationService(db)};
+		const auto scannerService {Scanner::createScannerService(db, *recommendationService)};
+
+		// Scan complete events are emitted from the scanner thread
+		std::promise<Scanner::ScanStats>* scanCompletePromise {};
+		scannerService->getEvents().scanComplete.connect([&](const Scanner::ScanStats& stats)
+		{
+			scanCompletePromise->set_value(stats);
+		});
+
+		auto runScan {[&](std::string_view scanName)
+		{
+			std::promise<Scanner::ScanStats> promise;
+			scanCompletePromise = &promise;
+
+			std::cout << "Running " << scanName << " on '" << mediaDirectory.string() << "'..." << std::endl;
+			scannerService->requestImmediateScan(false);
+			printScanStats(scanName, promise.get_future().get());
+		}};
+
+		runScan("First scan");
+		if (vm.count("rescan"))
+			runScan("Rescan");
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Caught exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -17,7 +17,10 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <mutex>
 #include <numeric>
+#include <optional>
+#include <unordered_map>
 
 #include "utils/Random.hpp"
 
@@ -32,6 +35,7 @@ class GeneticAlgorithm
 		using BreedFunction = std::function<Individual(const Individual&, const Individual&)>;
 		using MutateFunction = std::function<void(Individual&)>;
 		using ScoreFunction = std::function<Score(const Individual&)>;
+		using HashFunction = std::function<std::size_t(const Individual&)>;
 
 		struct Params
 		{
@@ -42,6 +46,7 @@ class GeneticAlgorithm
 			BreedFunction	breedFunction;
 			MutateFunction		mutateFunction;
 			ScoreFunction		scoreFunction;
+			HashFunction		hashFunction;	// optional, individuals with the same hash are only scored once
 		};
 
 		GeneticAlgorithm(const Params& params);
@@ -62,12 +67,20 @@ class GeneticAlgorithm
 		typename std::vector<ScoredIndividual>::const_iterator pickRandomRouletteWheel(const std::vector<ScoredIndividual>& population, Score totalScore);
 
 		Params _params;
+		Utils::ParallelForPool _pool; // kept across generations
+
+		std::mutex _scoreCacheMutex;
+		std::unordered_map<std::size_t, Score> _scoreCache; // by individual hash
+		std::size_t _scoreCacheHitCount {};
 };
 
 template<typename Individual>
 GeneticAlgorithm<Individual>::GeneticAlgorithm(const Params& params)
 : _params {params}
+, _pool {params.nbWorkers}
 {
+	if (params.nbWorkers == 0)
+		throw std::runtime_error("Invalid worker count");
 }
 
 
@@ -125,6 +138,8 @@ GeneticAlgorithm<Individual>::simulate(const std::vector<Individual>& initialPop
 
 		std::cout << "Mean score = " << getTotalScore(scoredPopulation) / scoredPopulation.size() << std::endl;
 		std::cout << "Current best score = " << *scoredPopulation.front().score << std::endl;
+		if (_params.hashFunction)
+			std::cout << "Score cache hits = " << _scoreCacheHitCount << std::endl;
 	}
 
 	std::cout << "Best score = " << *scoredPopulation.front().score << std::endl;
@@ -136,11 +151,34 @@ template<typename Individual>
 void
 GeneticAlgorithm<Individual>::scoreAndSortPopulation(std::vector<ScoredIndividual>& scoredPopulation)
 {
-	parallel_foreach(_params.nbWorkers, std::begin(scoredPopulation), std::end(scoredPopulation),
+	parallel_foreach(_pool, std::begin(scoredPopulation), std::end(scoredPopulation),
 			[&](ScoredIndividual& scoredIndividual)
 			{
-				if (!scoredIndividual.score)
-					scoredIndividual.score = _params.scoreFunction(scoredIndividual.individual);
+				if (scoredIndividual.score)
+					return;
+
+				std::optional<std::size_t> hash;
+				if (_params.hashFunction)
+				{
+					hash = _params.hashFunction(scoredIndividual.individual);
+
+					std::scoped_lock lock {_scoreCacheMutex};
+					auto itScore {_scoreCache.find(*hash)};
+					if (itScore != std::cend(_scoreCache))
+					{
+						scoredIndividual.score = itScore->second;
+						_scoreCacheHitCount++;
+						return;
+					}
+				}
+
+				scoredIndividual.score = _params.scoreFunction(scoredIndividual.individual);
+
+				if (hash)
+				{
+					std::scoped_lock lock {_scoreCacheMutex};
+					_scoreCache.emplace(*hash, *scoredIndividual.score);
+				}
 			});
 
 	std::sort(std::begin(scoredPopulation), std::end(scoredPopulation), [](const ScoredIndividual& a, const ScoredIndividual& b) { return a.score > b.score; });
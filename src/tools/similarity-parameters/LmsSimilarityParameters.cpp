@@ -17,9 +17,17 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <iostream>
 #include <filesystem>
+#include <numeric>
+#include <optional>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "database/Artist.hpp"
 #include "database/Cluster.hpp"
@@ -28,14 +36,17 @@
 #include "database/SessionPool.hpp"
 #include "database/Track.hpp"
 #include "database/TrackFeatures.hpp"
-#include "similarity/features/SimilarityFeaturesSearcher.hpp"
+#include "features/FeaturesDefs.hpp"
+#include "som/DataNormalizer.hpp"
+#include "som/Network.hpp"
 #include "utils/Config.hpp"
+#include "utils/Random.hpp"
 #include "utils/Service.hpp"
 #include "utils/StreamLogger.hpp"
 
 #include "GeneticAlgorithm.hpp"
 
-using namespace Similarity;
+using namespace Recommendation;
 using SimilarityScore = GeneticAlgorithm<FeatureSettingsMap>::Score;
 
 // An individual is just a FeatureSettingsMap
@@ -160,55 +171,211 @@ const FeatureSettingsMap featuresSettings
 	{ "lowlevel.zerocrossingrate.var",		{1}},
 };
 
+// Features of all the tracks, loaded and normalized once
+// Read-only once constructed: shared by all the concurrent evaluations
+struct TrainingData
+{
+	struct TrackInfo
+	{
+		Database::IdType				trackId;
+		std::optional<Database::IdType>	releaseId;
+		std::vector<Database::IdType>	artistIds;	// sorted
+		std::vector<Database::IdType>	clusterIds;	// sorted
+	};
+
+	std::vector<TrackInfo>							tracks;
+	std::vector<SOM::InputVector>					featureVectors;	// one per track, all the features
+	std::unordered_map<FeatureName, std::size_t>	featureOffsets;	// first dimension of each feature in the vectors
+};
+
+struct TrainSettings
+{
+	std::size_t iterationCount {10};
+	float sampleCountPerNeuron {4};
+};
+
 static
-std::unordered_map<Database::IdType, FeatureValuesMap>
-constructFeaturesCache(Database::Session& session, const FeatureSettingsMap& featureSettings)
+TrainingData
+constructTrainingData(Database::Session& session, const FeatureSettingsMap& featureSettings)
 {
-	std::unordered_map<Database::IdType, FeatureValuesMap> cache;
+	TrainingData data;
 
+	std::size_t dimCount {};
 	std::unordered_set<FeatureName> names;
-	std::transform(std::cbegin(featureSettings), std::cend(featureSettings), std::inserter(names, std::begin(names)),
-			[](const auto& itFeature) { return itFeature.first; });
-
-	auto transaction {session.createSharedTransaction()};
+	for (const auto& [name, settings] : featureSettings)
+	{
+		data.featureOffsets.emplace(name, dimCount);
+		dimCount += getFeatureDef(name).nbDimensions;
+		names.insert(name);
+	}
 
-	for (auto trackId : Database::Track::getAllIdsWithFeatures(session))
 	{
-		const Database::Track::pointer track {Database::Track::getById(session, trackId)};
-		const Database::TrackFeatures::pointer trackFeatures {track->getTrackFeatures()};
+		auto transaction {session.createSharedTransaction()};
+
+		for (auto trackId : Database::Track::getAllIdsWithFeatures(session))
+		{
+			const Database::Track::pointer track {Database::Track::getById(session, trackId)};
+			const FeatureValuesMap featureValuesMap {track->getTrackFeatures()->getFeatureValuesMap(names)};
+
+			SOM::InputVector featureVector {dimCount};
+			bool complete {true};
+			for (const auto& [name, offset] : data.featureOffsets)
+			{
+				auto itValues {featureValuesMap.find(name)};
+				if (itValues == std::cend(featureValuesMap) || itValues->second.size() != getFeatureDef(name).nbDimensions)
+				{
+					complete = false;
+					break;
+				}
+
+				for (std::size_t i {}; i < itValues->second.size(); ++i)
+					featureVector[offset + i] = itValues->second[i];
+			}
+
+			if (!complete)
+				continue;
+
+			TrainingData::TrackInfo& trackInfo {data.tracks.emplace_back()};
+			trackInfo.trackId = trackId;
+			if (track->getRelease())
+				trackInfo.releaseId = track->getRelease().id();
+			trackInfo.artistIds = track->getArtistIds();
+			std::sort(std::begin(trackInfo.artistIds), std::end(trackInfo.artistIds));
+			trackInfo.clusterIds = track->getClusterIds();
+			std::sort(std::begin(trackInfo.clusterIds), std::end(trackInfo.clusterIds));
 
-		cache[trackId] = trackFeatures->getFeatureValuesMap(names);
+			data.featureVectors.emplace_back(std::move(featureVector));
+		}
 	}
 
-	return cache;
+	// Normalization factors are computed per dimension: normalizing all the features at once
+	// gives the same values as normalizing the ones of each individual
+	SOM::DataNormalizer dataNormalizer {dimCount};
+	dataNormalizer.computeNormalizationFactors(data.featureVectors);
+	for (SOM::InputVector& featureVector : data.featureVectors)
+		dataNormalizer.normalizeData(featureVector);
+
+	return data;
 }
 
+// Order independent, so that the same settings always get the same hash
 static
-std::optional<FeatureValuesMap>
-getFeaturesFromCache(const std::unordered_map<Database::IdType, FeatureValuesMap>& cache, Database::IdType trackId, const FeatureNames& names)
+std::size_t
+hashFeatureSettingsMap(const FeatureSettingsMap& featureSettings)
 {
-	std::optional<FeatureValuesMap> res;
+	std::vector<std::pair<FeatureName, double>> entries;
+	entries.reserve(featureSettings.size());
+	for (const auto& [name, settings] : featureSettings)
+		entries.emplace_back(name, settings.weight);
+	std::sort(std::begin(entries), std::end(entries));
+
+	std::size_t res {};
+	for (const auto& [name, weight] : entries)
+	{
+		res ^= std::hash<FeatureName>{}(name) + 0x9e3779b9 + (res << 6) + (res >> 2);
+		res ^= std::hash<double>{}(weight) + 0x9e3779b9 + (res << 6) + (res >> 2);
+	}
 
-	auto it {cache.find(trackId)};
-	if (it == std::cend(cache))
-		return res;
+	return res;
+}
 
-	res = FeatureValuesMap{};
+// Trains a network using the given features of the given tracks (indexes in the training data)
+// Then calls func(trackIndex, similarTrackIndexes) for each of these tracks, most similar first
+using SimilarTracksVisitor = std::function<void(std::size_t /* trackIndex */, const std::vector<std::size_t>& /* similarTrackIndexes */)>;
+static
+void
+visitSimilarTracks(const TrainingData& data, const std::vector<std::size_t>& trackIndexes, const FeatureSettingsMap& featureSettings, const TrainSettings& trainSettings, std::size_t maxSimilarCount, const SimilarTracksVisitor& func)
+{
+	std::size_t dimCount {};
+	for (const auto& [name, settings] : featureSettings)
+		dimCount += getFeatureDef(name).nbDimensions;
 
-	const FeatureValuesMap& trackFeatures {it->second};
-	for (const FeatureName& name : names)
+	// Only the dimensions of the requested features
+	std::vector<SOM::InputVector> samples;
+	samples.reserve(trackIndexes.size());
+	for (const std::size_t trackIndex : trackIndexes)
 	{
-		auto itFeatures {trackFeatures.find(name)};
-		if (itFeatures == std::cend(trackFeatures))
+		const SOM::InputVector& featureVector {data.featureVectors[trackIndex]};
+		SOM::InputVector& sample {samples.emplace_back(dimCount)};
+
+		std::size_t dim {};
+		for (const auto& [name, settings] : featureSettings)
 		{
-			res.reset();
-			break;
+			const std::size_t offset {data.featureOffsets.at(name)};
+			for (std::size_t i {}; i < getFeatureDef(name).nbDimensions; ++i)
+				sample[dim++] = featureVector[offset + i];
 		}
+	}
 
-		res->emplace(name, itFeatures ->second);
+	SOM::InputVector weights {dimCount};
+	{
+		std::size_t dim {};
+		for (const auto& [name, settings] : featureSettings)
+		{
+			const std::size_t featureDimCount {getFeatureDef(name).nbDimensions};
+			for (std::size_t i {}; i < featureDimCount; ++i)
+				weights[dim++] = 1. / featureDimCount * settings.weight;
+		}
 	}
 
-	return res;
+	const SOM::Coordinate size {std::max<SOM::Coordinate>(2, static_cast<SOM::Coordinate>(std::sqrt(samples.size() / trainSettings.sampleCountPerNeuron)))};
+	SOM::Network network {size, size, dimCount};
+	network.setDataWeights(weights);
+	network.train(samples, trainSettings.iterationCount);
+
+	std::vector<SOM::Position> positions;
+	positions.reserve(samples.size());
+	std::vector<std::vector<std::size_t>> neuronSampleIndexes(static_cast<std::size_t>(size) * size);
+	for (std::size_t sampleIndex {}; sampleIndex < samples.size(); ++sampleIndex)
+	{
+		const SOM::Position& position {positions.emplace_back(network.getClosestRefVectorPosition(samples[sampleIndex]))};
+		neuronSampleIndexes[position.x + static_cast<std::size_t>(position.y) * size].push_back(sampleIndex);
+	}
+
+	std::vector<std::size_t> similarTrackIndexes;
+	std::vector<SOM::Position> neighbours;
+	for (std::size_t sampleIndex {}; sampleIndex < samples.size(); ++sampleIndex)
+	{
+		similarTrackIndexes.clear();
+
+		auto addNeuronTracks {[&](const SOM::Position& position)
+		{
+			for (const std::size_t otherSampleIndex : neuronSampleIndexes[position.x + static_cast<std::size_t>(position.y) * size])
+			{
+				if (similarTrackIndexes.size() == maxSimilarCount)
+					break;
+
+				if (otherSampleIndex != sampleIndex)
+					similarTrackIndexes.push_back(trackIndexes[otherSampleIndex]);
+			}
+		}};
+
+		// Same neuron first, then the closest neighbour neurons
+		const SOM::Position& position {positions[sampleIndex]};
+		addNeuronTracks(position);
+		if (similarTrackIndexes.size() < maxSimilarCount)
+		{
+			neighbours.clear();
+			if (position.x > 0)
+				neighbours.push_back({position.x - 1, position.y});
+			if (position.x + 1 < size)
+				neighbours.push_back({position.x + 1, position.y});
+			if (position.y > 0)
+				neighbours.push_back({position.x, position.y - 1});
+			if (position.y + 1 < size)
+				neighbours.push_back({position.x, position.y + 1});
+
+			std::sort(std::begin(neighbours), std::end(neighbours), [&](const SOM::Position& a, const SOM::Position& b)
+			{
+				return network.getRefVectorsDistance(position, a) < network.getRefVectorsDistance(position, b);
+			});
+
+			for (const SOM::Position& neighbour : neighbours)
+				addNeuronTracks(neighbour);
+		}
+
+		func(trackIndexes[sampleIndex], similarTrackIndexes);
+	}
 }
 
 static
@@ -241,26 +408,18 @@ trackToString(Database::Session& session, Database::IdType trackId)
 
 static
 SimilarityScore
-computeTrackScore(Database::Session& session, Database::IdType track1Id, Database::IdType track2Id)
+computeTrackScore(const TrainingData::TrackInfo& track1, const TrainingData::TrackInfo& track2)
 {
 	SimilarityScore score {};
 
-	auto transaction {session.createSharedTransaction()};
-
-	auto track1 {Database::Track::getById(session, track1Id)};
-	auto track2 {Database::Track::getById(session, track2Id)};
-
-	if (track1->getRelease() == track2->getRelease())
+	if (track1.releaseId && track1.releaseId == track2.releaseId)
 		score += 1;
 
 	// Artists in common
 	{
-		auto track1ArtistIds {track1->getArtistIds()};
-		auto track2ArtistIds {track2->getArtistIds()};
-
 		std::vector<Database::IdType> commonArtistIds;
-		std::set_intersection(std::cbegin(track1ArtistIds), std::cend(track1ArtistIds),
-				std::cbegin(track2ArtistIds), std::cend(track2ArtistIds),
+		std::set_intersection(std::cbegin(track1.artistIds), std::cend(track1.artistIds),
+				std::cbegin(track2.artistIds), std::cend(track2.artistIds),
 				std::back_inserter(commonArtistIds));
 
 		score += commonArtistIds.size();
@@ -268,12 +427,9 @@ computeTrackScore(Database::Session& session, Database::IdType track1Id, Databas
 
 	// Clusters in common
 	{
-		auto track1ClusterIds {track1->getClusterIds()};
-		auto track2ClusterIds {track2->getClusterIds()};
-
 		std::vector<Database::IdType> commonClusterIds;
-		std::set_intersection(std::cbegin(track1ClusterIds), std::cend(track1ClusterIds),
-				std::cbegin(track2ClusterIds), std::cend(track2ClusterIds),
+		std::set_intersection(std::cbegin(track1.clusterIds), std::cend(track1.clusterIds),
+				std::cbegin(track2.clusterIds), std::cend(track2.clusterIds),
 				std::back_inserter(commonClusterIds));
 
 		score += commonClusterIds.size();
@@ -282,67 +438,38 @@ computeTrackScore(Database::Session& session, Database::IdType track1Id, Databas
 	return score;
 }
 
+constexpr std::size_t nbSimilarTracks {3};
+
 static
 SimilarityScore
-computeSimilarityScore(Database::Session& session, FeaturesSearcher::TrainSettings trainSettings)
+computeSimilarityScore(const TrainingData& data, const std::vector<std::size_t>& trackIndexes, const FeatureSettingsMap& featureSettings, const TrainSettings& trainSettings)
 {
-	std::cout << "Compute score of: ";
-	printFeatureSettingsMap(trainSettings.featureSettingsMap);
-	std::cout << std::endl;
-
-	FeaturesSearcher searcher {session, trainSettings};
-
-	const std::vector<Database::IdType> trackIds = std::invoke([&]()
-			{
-				auto transaction {session.createSharedTransaction()};
-				return Database::Track::getAllIdsWithFeatures(session);
-			});
-
 	SimilarityScore score {};
-	for (Database::IdType trackId : trackIds)
+	visitSimilarTracks(data, trackIndexes, featureSettings, trainSettings, nbSimilarTracks, [&](std::size_t trackIndex, const std::vector<std::size_t>& similarTrackIndexes)
 	{
-		constexpr std::size_t nbSimilarTracks {3};
-//		std::cout << "Processing track '" << trackToString(session, trackId) << "'" << std::endl;
-		SimilarityScore factor {1};		
-		for (Database::IdType similarTrackId : searcher.getSimilarTracks({trackId}, nbSimilarTracks))
+		SimilarityScore factor {1};
+		for (const std::size_t similarTrackIndex : similarTrackIndexes)
 		{
-			SimilarityScore trackScore {computeTrackScore(session, trackId, similarTrackId)};
-//			std::cout << "\tScore = " << trackScore << " (*" << factor << ") with track '" << trackToString(session, similarTrackId) << "'" << std::endl;
-			trackScore *= factor;
-			score += trackScore;
-
-			factor -= (SimilarityScore {1}/nbSimilarTracks );
+			score += computeTrackScore(data.tracks[trackIndex], data.tracks[similarTrackIndex]) * factor;
+			factor -= (SimilarityScore {1} / nbSimilarTracks);
 		}
-	}
-
-	std::cout << "Total score = " << score << std::endl;
+	});
 
 	return score;
 }
 
 static
 void
-printBadlyClassifiedTracks(Database::Session& session, FeaturesSearcher::TrainSettings trainSettings)
+printBadlyClassifiedTracks(Database::Session& session, const TrainingData& data, const std::vector<std::size_t>& trackIndexes, const FeatureSettingsMap& featureSettings, const TrainSettings& trainSettings)
 {
-	
-	FeaturesSearcher searcher {session, trainSettings};
-
-	const std::vector<Database::IdType> trackIds = std::invoke([&]()
-			{
-				auto transaction {session.createSharedTransaction()};
-				return Database::Track::getAllIdsWithFeatures(session);
-			});
-
-	for (Database::IdType trackId : trackIds)
+	visitSimilarTracks(data, trackIndexes, featureSettings, trainSettings, nbSimilarTracks, [&](std::size_t trackIndex, const std::vector<std::size_t>& similarTrackIndexes)
 	{
-		constexpr std::size_t nbSimilarTracks {3};
-		for (Database::IdType similarTrackId : searcher.getSimilarTracks({trackId}, nbSimilarTracks))
+		for (const std::size_t similarTrackIndex : similarTrackIndexes)
 		{
-			SimilarityScore trackScore {computeTrackScore(session, trackId, similarTrackId)};
-			if (trackScore == 0)
-				std::cout << "Badly classified tracks: '" << trackToString(session, trackId) << "'\n\twith track '" << trackToString(session, similarTrackId) << "'" <<std::endl;
+			if (computeTrackScore(data.tracks[trackIndex], data.tracks[similarTrackIndex]) == 0)
+				std::cout << "Badly classified tracks: '" << trackToString(session, data.tracks[trackIndex].trackId) << "'\n\twith track '" << trackToString(session, data.tracks[similarTrackIndex].trackId) << "'" << std::endl;
 		}
-	}
+	});
 }
 
 
@@ -388,30 +515,35 @@ int main(int argc, char *argv[])
 		// log to stdout
 //		ServiceProvider<Logger>::create<StreamLogger>(std::cout);
 
-		if (argc != 3)
+		if (argc != 3 && argc != 4)
 		{
-			std::cerr << "usage: <lms_conf_file> <nb_workers>" << std::endl;
+			std::cerr << "usage: <lms_conf_file> <nb_workers> [<evaluated_track_percent>]" << std::endl;
 			return EXIT_FAILURE;
 		}
 
 		const std::filesystem::path configFilePath {std::string(argv[1], 0, 256)};
 		const std::size_t nbWorkers = atoi(argv[2]);
+		const unsigned evaluatedTrackPercent = argc == 4 ? std::clamp(atoi(argv[3]), 1, 100) : 100;
 
 		ServiceProvider<Config>::create(configFilePath);
 
 		Database::Db db {ServiceProvider<Config>::get()->getPath("working-dir") / "lms.db"};
 		Database::SessionPool sessionPool {db, nbWorkers};
 
-		std::cout << "Caching all features..." << std::endl;
-		// Cache all the features of all the music in order to speed up the multiple trainings
-		const auto cachedFeatures { constructFeaturesCache(Database::SessionPool::ScopedSession {sessionPool}.get(), featuresSettings) };
-		std::cout << "Caching all features DONE" << std::endl;
+		std::cout << "Loading all features..." << std::endl;
+		// Loaded and normalized only once, then shared by all the trainings
+		const TrainingData trainingData {constructTrainingData(Database::SessionPool::ScopedSession {sessionPool}.get(), featuresSettings)};
+		std::cout << "Loading all features DONE (" << trainingData.tracks.size() << " tracks)" << std::endl;
 
-		FeaturesSearcher::setFeaturesFetchFunc(
-				[&](Database::IdType trackId, const FeatureNames& featureNames)
-				{
-					return getFeaturesFromCache(cachedFeatures, trackId, featureNames);
-				});
+		// All the individuals are evaluated on the same tracks, so that their scores can be compared
+		std::vector<std::size_t> evaluatedTrackIndexes(trainingData.tracks.size());
+		std::iota(std::begin(evaluatedTrackIndexes), std::end(evaluatedTrackIndexes), 0);
+		if (evaluatedTrackPercent < 100)
+		{
+			Random::shuffleContainer(evaluatedTrackIndexes);
+			evaluatedTrackIndexes.resize(evaluatedTrackIndexes.size() * evaluatedTrackPercent / 100);
+			std::sort(std::begin(evaluatedTrackIndexes), std::end(evaluatedTrackIndexes));
+		}
 
 		// Create some random settings (i.e random population)
 		std::vector<FeatureSettingsMap> initialPopulation;
@@ -432,7 +564,7 @@ int main(int argc, char *argv[])
 			initialPopulation.emplace_back(std::move(settings));
 		}
 
-		FeaturesSearcher::TrainSettings trainSettings;
+		TrainSettings trainSettings;
 		trainSettings.iterationCount = 8;
 		trainSettings.sampleCountPerNeuron = 1.5;
 
@@ -446,12 +578,9 @@ int main(int argc, char *argv[])
 		params.scoreFunction =
 			[&](const FeatureSettingsMap& featureSettings)
 			{
-				FeaturesSearcher::TrainSettings settings {trainSettings};
-				settings.featureSettingsMap = featureSettings;
-
-				Database::SessionPool::ScopedSession scopedSession {sessionPool};
-				return computeSimilarityScore(scopedSession.get(), settings);
+				return computeSimilarityScore(trainingData, evaluatedTrackIndexes, featureSettings, trainSettings);
 			};
+		params.hashFunction = hashFeatureSettingsMap;
 
 		GeneticAlgorithm<FeatureSettingsMap> geneticAlgorithm {params};
 
@@ -462,8 +591,9 @@ int main(int argc, char *argv[])
 			<< "\tnbFeatures = " << nbFeatures << "\n"
 			<< "\tcrossoverRatio = " << params.crossoverRatio << "\n"
 			<< "\tmutationProbability = " << params.mutationProbability << "\n"
+			<< "\tevaluated tracks = " << evaluatedTrackIndexes.size() << " (" << evaluatedTrackPercent << "%)\n"
 			<< std::endl;
-			
+
 		std::cout << "Starting simulation..." << std::endl;
 		const FeatureSettingsMap selectedSettings {geneticAlgorithm.simulate(initialPopulation)};
 		std::cout << "Simulation complete! Best result:" << std::endl;
@@ -471,11 +601,8 @@ int main(int argc, char *argv[])
 
 		// print all badly classified tracks
 		{
-			FeaturesSearcher::TrainSettings settings {trainSettings};
-			settings.featureSettingsMap = selectedSettings;
-
 			Database::SessionPool::ScopedSession scopedSession {sessionPool};
-			printBadlyClassifiedTracks(scopedSession.get(), settings);
+			printBadlyClassifiedTracks(scopedSession.get(), trainingData, evaluatedTrackIndexes, selectedSettings, trainSettings);
 		}
 	}
 	catch (std::exception& e)
@@ -17,31 +17,17 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <functional>
-#include <thread>
-#include <boost/asio/io_context.hpp>
+#include <iterator>
 
+#include "utils/ParallelForPool.hpp"
+
+// Scores are expensive and uneven: elements are handed over one by one so that idle workers steal from the busy ones
 template <typename It, typename Func>
-void parallel_foreach(std::size_t nbWorkers, It begin, It end, Func&& func)
+void parallel_foreach(Utils::ParallelForPool& pool, It begin, It end, Func&& func)
 {
-	if (nbWorkers == 0)
-		throw std::runtime_error("Invalid worker count");
-
-	boost::asio::io_context ioContext;
-
-	for (It it {begin}; it != end; ++it)
+	pool.parallelFor(static_cast<std::size_t>(std::distance(begin, end)), [&](std::size_t first, std::size_t last)
 	{
-		auto refValue {std::ref<typename It::value_type>(*it)};
-		ioContext.post([refValue, &func]() { std::cout << "EXEC FROM WORKER" << std::endl; func(refValue); std::cout << "END EXEC FROM WORKER" << std::endl; });
-	}
-
-	std::vector<std::thread> threads;
-	for (std::size_t i {}; i < nbWorkers - 1; ++i)
-		threads.emplace_back([&]() { ioContext.run(); });
-
-	ioContext.run();
-
-	for (std::thread& t : threads)
-		t.join();
+		for (std::size_t i {first}; i < last; ++i)
+			func(*(begin + i));
+	}, 1);
 }
-
@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/program_options.hpp>
+#include <Wt/WResource.h>
+#include <Wt/WServer.h>
+
+#include "services/auth/IAuthTokenService.hpp"
+#include "services/auth/IPasswordService.hpp"
+#include "services/database/Db.hpp"
+#include "services/database/Session.hpp"
+#include "services/database/generator/LibraryGenerator.hpp"
+#include "services/recommendation/IRecommendationService.hpp"
+#include "services/scanner/IScannerService.hpp"
+#include "services/scrobbling/IScrobblingService.hpp"
+#include "subsonic/SubsonicResource.hpp"
+#include "utils/DurationHistogram.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/Service.hpp"
+#include "utils/StreamLogger.hpp"
+
+namespace
+{
+	const std::string userName {"user-0"}; // first user created by the library generator
+	const std::string userPassword {"Lms-Subsonic-Bench-1"};
+
+	// Removed with all its content on destruction
+	class TemporaryDirectory
+	{
+		public:
+			TemporaryDirectory()
+			: _path {std::filesystem::temp_directory_path() / ("lms-subsonic-bench-" + std::to_string(::getpid()))}
+			{
+				std::filesystem::create_directories(_path);
+			}
+
+			~TemporaryDirectory()
+			{
+				std::error_code ec;
+				std::filesystem::remove_all(_path, ec);
+			}
+
+			TemporaryDirectory(const TemporaryDirectory&) = delete;
+			TemporaryDirectory(TemporaryDirectory&&) = delete;
+			TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+			TemporaryDirectory& operator=(TemporaryDirectory&&) = delete;
+
+			const std::filesystem::path& getPath() const { return _path; }
+
+		private:
+			const std::filesystem::path _path;
+	};
+
+	enum class RequestType
+	{
+		Search3,
+		GetAlbumList2,
+		GetAlbum,
+		GetArtist,
+		GetStarred2,
+		GetRandomSongs,
+	};
+
+	struct RequestTypeInfo
+	{
+		RequestType			type;
+		std::string_view	name;
+		unsigned			weight;	// relative frequency in the mix
+	};
+
+	// Roughly what a client browsing the library sends
+	constexpr std::array<RequestTypeInfo, 6> requestTypeInfos
+	{{
+		{RequestType::Search3,			"search3",			15},
+		{RequestType::GetAlbumList2,	"getAlbumList2",	25},
+		{RequestType::GetAlbum,			"getAlbum",			25},
+		{RequestType::GetArtist,		"getArtist",		20},
+		{RequestType::GetStarred2,		"getStarred2",		5},
+		{RequestType::GetRandomSongs,	"getRandomSongs",	10},
+	}};
+
+	template <typename T>
+	const T&
+	pickRandom(const std::vector<T>& values, std::mt19937& randGenerator)
+	{
+		return values[std::uniform_int_distribution<std::size_t> {0, values.size() - 1}(randGenerator)];
+	}
+
+	std::string
+	buildRequestTarget(const RequestTypeInfo& requestTypeInfo, const Database::Generator::Library& library, std::mt19937& randGenerator)
+	{
+		std::ostringstream oss;
+		oss << "/rest/" << requestTypeInfo.name << ".view?u=" << userName << "&p=" << userPassword << "&v=1.16.1&c=lms-subsonic-bench";
+
+		switch (requestTypeInfo.type)
+		{
+			case RequestType::Search3:
+				// matches all the artists, releases and tracks sharing this prefix
+				oss << "&query=" << pickRandom(library.artistIds, randGenerator).getValue() % 100;
+				break;
+
+			case RequestType::GetAlbumList2:
+			{
+				static const std::vector<std::string_view> listTypes {"alphabeticalByName", "alphabeticalByArtist", "newest", "random", "frequent", "starred"};
+				constexpr std::size_t pageSize {50};
+				const std::size_t pageCount {std::max<std::size_t>(library.releaseIds.size() / pageSize, 1)};
+
+				oss << "&type=" << pickRandom(listTypes, randGenerator) << "&size=" << pageSize
+					<< "&offset=" << std::uniform_int_distribution<std::size_t> {0, pageCount - 1}(randGenerator) * pageSize;
+				break;
+			}
+
+			case RequestType::GetAlbum:
+				oss << "&id=al-" << pickRandom(library.releaseIds, randGenerator).getValue();
+				break;
+
+			case RequestType::GetArtist:
+				oss << "&id=ar-" << pickRandom(library.artistIds, randGenerator).getValue();
+				break;
+
+			case RequestType::GetStarred2:
+				break;
+
+			case RequestType::GetRandomSongs:
+				oss << "&size=50";
+				break;
+		}
+
+		return oss.str();
+	}
+
+	struct HttpResult
+	{
+		unsigned	statusCode {};
+		bool		subsonicError {};
+		std::size_t	bodySize {};
+	};
+
+	// Simple blocking HTTP/1.0 client: no keep alive, the whole response is read
+	HttpResult
+	sendRequest(const std::string& port, const std::string& target)
+	{
+		boost::asio::ip::tcp::iostream stream {"127.0.0.1", port};
+		if (!stream)
+			throw std::runtime_error {"Cannot connect to server: " + stream.error().message()};
+
+		stream << "GET " << target << " HTTP/1.0\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n" << std::flush;
+
+		HttpResult result;
+		std::string httpVersion;
+		stream >> httpVersion >> result.statusCode;
+
+		const std::string response {std::istreambuf_iterator<char> {stream}, std::istreambuf_iterator<char> {}};
+		result.subsonicError = response.find("status=\"failed\"") != std::string::npos;
+		result.bodySize = response.size();
+
+		return result;
+	}
+
+	struct RequestTypeStats
+	{
+		std::mutex			mutex;
+		DurationHistogram	latencies;
+		std::size_t			errorCount {};
+		std::size_t			totalBodySize {};
+	};
+
+	std::size_t
+	getTotalQueryCount(const Database::Db& db)
+	{
+		std::size_t count {};
+
+		if (const std::optional<Database::DbStats> stats {db.getStats()})
+		{
+			for (const Database::QueryStats& query : stats->queries)
+				count += query.count;
+		}
+
+		return count;
+	}
+
+	void
+	printLatencies(std::string_view name, const DurationHistogram& latencies, std::size_t errorCount, std::size_t totalBodySize)
+	{
+		std::cout << std::left << std::setw(18) << name << std::right
+			<< std::setw(8) << latencies.getCount()
+			<< std::setw(8) << errorCount
+			<< std::setw(10) << latencies.getPercentile(50).count()
+			<< std::setw(10) << latencies.getPercentile(90).count()
+			<< std::setw(10) << latencies.getPercentile(99).count()
+			<< std::setw(10) << (latencies.getCount() ? totalBodySize / latencies.getCount() : 0)
+			<< std::endl;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		namespace po = boost::program_options;
+
+		po::options_description desc{"Allowed options"};
+		desc.add_options()
+		("help,h", "print usage message")
+		("conf,c", po::value<std::string>()->default_value("/etc/lms.conf"), "LMS config file, used for the Subsonic API settings")
+		("artist-count", po::value<std::size_t>()->default_value(500), "Number of artists in the synthetic library")
+		("releases-per-artist", po::value<std::size_t>()->default_value(4), "Mean number of releases per artist")
+		("tracks-per-release", po::value<std::size_t>()->default_value(10), "Mean number of tracks per release")
+		("genre-count", po::value<std::size_t>()->default_value(20), "Number of genres")
+		("starred-percent", po::value<unsigned>()->default_value(5), "Percentage of starred artists, releases and tracks")
+		("client-threads,t", po::value<std::size_t>()->default_value(8), "Number of concurrent clients")
+		("server-threads", po::value<std::size_t>()->default_value(8), "Number of http server threads")
+		("request-count,n", po::value<std::size_t>()->default_value(10000), "Total number of requests to send")
+		("verbose,v", "Log LMS messages")
+		;
+
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+
+		if (vm.count("help"))
+		{
+			std::cout << desc << std::endl;
+			return EXIT_SUCCESS;
+		}
+
+		std::ostream nullStream {nullptr};
+		Service<Logger> logger {std::make_unique<StreamLogger>(vm.count("verbose") ? std::cout : nullStream)};
+		Service<IConfig> config {createConfig(vm["conf"].as<std::string>())};
+
+		const TemporaryDirectory workingDirectory;
+
+		const std::size_t serverThreadCount {std::max<std::size_t>(vm["server-threads"].as<std::size_t>(), 1)};
+		const std::size_t clientThreadCount {std::max<std::size_t>(vm["client-threads"].as<std::size_t>(), 1)};
+		const std::size_t requestCount {vm["request-count"].as<std::size_t>()};
+
+		// Throwaway database, stats are needed to report the queries per request
+		Database::ConnectionSettings connectionSettings;
+		connectionSettings.collectStats = true;
+		Database::Db db {workingDirectory.getPath() / "lms.db", serverThreadCount + 1, Database::Db::ConcurrencyMode::ApplicationLock, connectionSettings};
+		{
+			Database::Session session {db};
+			session.prepareTables();
+		}
+
+		Database::Generator::LibraryParameters libraryParameters;
+		libraryParameters.artistCount = std::max<std::size_t>(vm["artist-count"].as<std::size_t>(), 1);
+		libraryParameters.releasesPerArtist = std::max<std::size_t>(vm["releases-per-artist"].as<std::size_t>(), 1);
+		libraryParameters.tracksPerRelease = std::max<std::size_t>(vm["tracks-per-release"].as<std::size_t>(), 1);
+		libraryParameters.genreCount = vm["genre-count"].as<std::size_t>();
+		libraryParameters.starredPercent = vm["starred-percent"].as<unsigned>();
+		libraryParameters.mediaDirectory = "/lms-subsonic-bench";
+
+		std::cout << "Generating " << libraryParameters.artistCount << " artists..." << std::endl;
+		const Database::Generator::Library library {Database::Generator::generateLibrary(db, libraryParameters)};
+		std::cout << "Generated " << library.releaseIds.size() << " releases, " << library.trackIds.size() << " tracks" << std::endl;
+		{
+			Database::Session session {db};
+			session.optimize();
+		}
+		const Database::UserId userId {library.userIds.front()};
+
+		// Same service set up as the main application, minus what the request mix does not need
+		boost::asio::io_context ioContext;
+		Service<Auth::IAuthTokenService> authTokenService {Auth::createAuthTokenService(ioContext, db, 10000)};
+		Service<Auth::IPasswordService> authPasswordService {Auth::createPasswordService("internal", db, 10000, *authTokenService.get())};
+		authPasswordService->setPassword(userId, userPassword);
+
+		Service<Recommendation::IRecommendationService> recommendationService {Recommendation::createRecommendationService(db)};
+		Service<Scanner::IScannerService> scannerService {Scanner::createScannerService(db, *recommendationService.get())};
+		Service<Scrobbling::IScrobblingService> scrobblingService {Scrobbling::createScrobblingService(ioContext, db)};
+
+		// Wt::Http::Request and Response cannot be built outside of the http server: serve the resource on the loopback interface
+		const std::filesystem::path wtConfigPath {workingDirectory.getPath() / "wt_config.xml"};
+		{
+			std::ofstream wtConfig {wtConfigPath};
+			wtConfig << R"(<server><application-settings location="*"><log-config>* -debug -info</log-config></application-settings></server>)";
+		}
+
+		const std::vector<std::string> wtServerArgs
+		{
+			argv[0],
+			"--config=" + wtConfigPath.string(),
+			"--docroot=" + workingDirectory.getPath().string(),
+			"--http-address=127.0.0.1",
+			"--http-port=0",
+			"--accesslog=/dev/null",
+			"--threads=" + std::to_string(serverThreadCount),
+		};
+		std::vector<const char*> wtArgv;
+		for (const std::string& arg : wtServerArgs)
+			wtArgv.push_back(arg.c_str());
+
+		Wt::WServer server {argv[0]};
+		server.setServerConfiguration(wtArgv.size(), const_cast<char**>(wtArgv.data()));
+
+		const std::unique_ptr<Wt::WResource> subsonicResource {API::Subsonic::createSubsonicResource(db)};
+		server.addResource(subsonicResource.get(), "rest/");
+		if (!server.start())
+			throw std::runtime_error {"Cannot start http server"};
+
+		const std::string port {std::to_string(server.httpPort())};
+
+		std::array<RequestTypeStats, requestTypeInfos.size()> requestTypeStats;
+		std::vector<unsigned> weights;
+		for (const RequestTypeInfo& requestTypeInfo : requestTypeInfos)
+			weights.push_back(requestTypeInfo.weight);
+
+		std::cout << "Sending " << requestCount << " requests using " << clientThreadCount << " clients, " << serverThreadCount << " server threads..." << std::endl;
+
+		const std::size_t queryCountBefore {getTotalQueryCount(db)};
+		std::atomic<std::size_t> sentRequestCount {};
+		const auto start {std::chrono::steady_clock::now()};
+		{
+			std::vector<std::thread> clients;
+			for (std::size_t i {}; i < clientThreadCount; ++i)
+			{
+				clients.emplace_back([&, seed = i]
+				{
+					std::mt19937 randGenerator {static_cast<std::mt19937::result_type>(seed)};
+					std::discrete_distribution<std::size_t> requestTypeDistribution {std::cbegin(weights), std::cend(weights)};
+
+					while (sentRequestCount++ < requestCount)
+					{
+						const std::size_t requestTypeIndex {requestTypeDistribution(randGenerator)};
+						const std::string target {buildRequestTarget(requestTypeInfos[requestTypeIndex], library, randGenerator)};
+
+						const auto requestStart {std::chrono::steady_clock::now()};
+						const HttpResult result {sendRequest(port, target)};
+						const auto requestDuration {std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - requestStart)};
+
+						RequestTypeStats& stats {requestTypeStats[requestTypeIndex]};
+						std::scoped_lock lock {stats.mutex};
+						stats.latencies.add(requestDuration);
+						stats.totalBodySize += result.bodySize;
+						if (result.statusCode != 200 || result.subsonicError)
+							stats.errorCount++;
+					}
+				});
+			}
+
+			for (std::thread& client : clients)
+				client.join();
+		}
+		const auto duration {std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)};
+		const std::size_t queryCount {getTotalQueryCount(db) - queryCountBefore};
+
+		server.stop();
+
+		std::cout << std::endl << std::left << std::setw(18) << "request" << std::right
+			<< std::setw(8) << "count" << std::setw(8) << "errors"
+			<< std::setw(10) << "p50 (us)" << std::setw(10) << "p90 (us)" << std::setw(10) << "p99 (us)" << std::setw(10) << "bytes" << std::endl;
+
+		std::size_t totalErrorCount {};
+		for (std::size_t i {}; i < requestTypeInfos.size(); ++i)
+		{
+			const RequestTypeStats& stats {requestTypeStats[i]};
+			printLatencies(requestTypeInfos[i].name, stats.latencies, stats.errorCount, stats.totalBodySize);
+
+			totalErrorCount += stats.errorCount;
+		}
+
+		std::size_t totalCount {};
+		for (const RequestTypeStats& stats : requestTypeStats)
+			totalCount += stats.latencies.getCount();
+
+		std::cout << std::endl;
+		std::cout << "Total duration: " << duration.count() << "ms, " << totalCount << " requests, " << totalErrorCount << " errors" << std::endl;
+		std::cout << "Throughput: " << std::fixed << std::setprecision(1) << (duration.count() ? totalCount * 1000. / duration.count() : 0) << " requests/s" << std::endl;
+		std::cout << "Queries per request: " << std::fixed << std::setprecision(1) << (totalCount ? static_cast<double>(queryCount) / totalCount : 0) << std::endl;
+	}
+	catch (const Wt::WServer::Exception& e)
+	{
+		std::cerr << "Caught WServer::Exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Caught exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 2022 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <string_view>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/program_options.hpp>
+
+#include "av/IAudioFile.hpp"
+#include "av/ITranscoder.hpp"
+#include "av/TranscodeParameters.hpp"
+#include "av/Types.hpp"
+#include "utils/DurationHistogram.hpp"
+#include "utils/IChildProcessManager.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/IOContextRunner.hpp"
+#include "utils/Path.hpp"
+#include "utils/Service.hpp"
+#include "utils/StreamLogger.hpp"
+#include "utils/String.hpp"
+
+namespace
+{
+	struct BackendInfo
+	{
+		Av::TranscoderBackend	backend;
+		std::string_view		name;
+	};
+
+	constexpr std::array<BackendInfo, 2> backendInfos
+	{{
+		{Av::TranscoderBackend::FFmpeg,	"ffmpeg"},
+		{Av::TranscoderBackend::LibAv,	"libav"},
+	}};
+
+	struct FormatInfo
+	{
+		Av::Format			format;
+		std::string_view	name;
+	};
+
+	constexpr std::array<FormatInfo, 5> formatInfos
+	{{
+		{Av::Format::MP3,			"mp3"},
+		{Av::Format::OGG_OPUS,		"ogg_opus"},
+		{Av::Format::MATROSKA_OPUS,	"matroska_opus"},
+		{Av::Format::OGG_VORBIS,	"ogg_vorbis"},
+		{Av::Format::WEBM_VORBIS,	"webm_vorbis"},
+		{Av::Format::MPEGTS_MP3,	"mpegts_mp3"},
+	}};
+
+	template <typename Info, std::size_t N>
+	std::vector<Info>
+	selectInfos(const std::array<Info, N>& infos, const std::string& names)
+	{
+		if (names == "all")
+			return {std::cbegin(infos), std::cend(infos)};
+
+		std::vector<Info> res;
+		for (std::string_view name : StringUtils::splitString(names, ","))
+		{
+			auto it {std::find_if(std::cbegin(infos), std::cend(infos), [&](const Info& info) { return info.name == name; })};
+			if (it == std::cend(infos))
+				throw std::runtime_error {"Unknown value '" + std::string {name} + "'"};
+
+			res.push_back(*it);
+		}
+
+		return res;
+	}
+
+	struct SampleFile
+	{
+		std::filesystem::path		path;
+		std::chrono::milliseconds	duration;
+	};
+
+	std::optional<SampleFile>
+	parseSampleFile(const std::filesystem::path& path)
+	{
+		try
+		{
+			const std::unique_ptr<Av::IAudioFile> audioFile {Av::parseAudioFile(path)};
+			if (!audioFile->getBestStream() || audioFile->getDuration().count() <= 0)
+				return std::nullopt;
+
+			return SampleFile {path, audioFile->getDuration()};
+		}
+		catch (const Av::Exception&)
+		{
+			return std::nullopt;
+		}
+	}
+
+	// Directories are explored recursively, non audio files are skipped
+	std::vector<SampleFile>
+	findSampleFiles(const std::vector<std::string>& inputs)
+	{
+		std::vector<SampleFile> sampleFiles;
+
+		for (const std::filesystem::path input : inputs)
+		{
+			if (!std::filesystem::is_directory(input))
+			{
+				if (std::optional<SampleFile> sampleFile {parseSampleFile(input)})
+					sampleFiles.push_back(*sampleFile);
+				else
+					std::cerr << "Skipping '" << input.string() << "': not an audio file" << std::endl;
+
+				continue;
+			}
+
+			exploreFilesRecursive(input, [&](std::error_code ec, const std::filesystem::path& path)
+			{
+				if (!ec)
+				{
+					if (std::optional<SampleFile> sampleFile {parseSampleFile(path)})
+						sampleFiles.push_back(*sampleFile);
+				}
+
+				return true;
+			});
+		}
+
+		return sampleFiles;
+	}
+
+	// Blocks until the transcoder has filled the buffer, or until the end of the output
+	std::size_t
+	read(Av::ITranscoder& transcoder, std::byte* buffer, std::size_t bufferSize)
+	{
+		std::promise<std::size_t> promise;
+		std::future<std::size_t> future {promise.get_future()};
+
+		transcoder.asyncRead(buffer, bufferSize, [&](std::size_t nbBytesRead)
+		{
+			promise.set_value(nbBytesRead);
+		});
+
+		return future.get();
+	}
+
+	// This process and its terminated ffmpeg children
+	std::chrono::microseconds
+	getCpuTime()
+	{
+		auto toDuration {[](const timeval& time) { return std::chrono::seconds {time.tv_sec} + std::chrono::microseconds {time.tv_usec}; }};
+
+		rusage self {};
+		rusage children {};
+		if (::getrusage(RUSAGE_SELF, &self) != 0 || ::getrusage(RUSAGE_CHILDREN, &children) != 0)
+			throw std::runtime_error {"getrusage failed"};
+
+		return toDuration(self.ru_utime) + toDuration(self.ru_stime) + toDuration(children.ru_utime) + toDuration(children.ru_stime);
+	}
+
+	struct RunParameters
+	{
+		Av::TranscoderBackend	backend;
+		Av::Format				format;
+		std::size_t				bitrate;
+		std::size_t				concurrency;
+		std::size_t				transcodeCount;
+		std::size_t				readSize;
+	};
+
+	struct RunResult
+	{
+		DurationHistogram			timesToFirstByte;
+		std::size_t					errorCount {};
+		std::uint64_t				outputSize {};
+		std::chrono::milliseconds	audioDuration {};
+		std::chrono::milliseconds	duration {};
+		std::chrono::microseconds	cpuTime {};
+	};
+
+	RunResult
+	run(const RunParameters& parameters, const std::vector<SampleFile>& sampleFiles)
+	{
+		RunResult result;
+		std::mutex resultMutex;
+
+		std::atomic<std::size_t> nextTranscodeIndex {};
+		const std::chrono::microseconds cpuTimeBefore {getCpuTime()};
+		const auto start {std::chrono::steady_clock::now()};
+		{
+			std::vector<std::thread> workers;
+			for (std::size_t i {}; i < parameters.concurrency; ++i)
+			{
+				workers.emplace_back([&]
+				{
+					std::vector<std::byte> buffer(parameters.readSize);
+
+					for (std::size_t transcodeIndex {nextTranscodeIndex++}; transcodeIndex < parameters.transcodeCount; transcodeIndex = nextTranscodeIndex++)
+					{
+						const SampleFile& sampleFile {sampleFiles[transcodeIndex % sampleFiles.size()]};
+
+						Av::TranscodeParameters transcodeParameters;
+						transcodeParameters.format = parameters.format;
+						transcodeParameters.bitrate = parameters.bitrate;
+
+						std::optional<std::chrono::microseconds> timeToFirstByte;
+						std::uint64_t outputSize {};
+						try
+						{
+							const auto transcodeStart {std::chrono::steady_clock::now()};
+
+							std::unique_ptr<Av::ITranscoder> transcoder {Av::createTranscoder(std::vector<std::filesystem::path> {sampleFile.path}, transcodeParameters, parameters.backend)};
+							while (!transcoder->finished())
+							{
+								const std::size_t nbBytesRead {read(*transcoder, buffer.data(), buffer.size())};
+								if (nbBytesRead == 0)
+									break;
+
+								if (!timeToFirstByte)
+									timeToFirstByte = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - transcodeStart);
+								outputSize += nbBytesRead;
+							}
+						}
+						catch (const Av::Exception& e)
+						{
+							std::cerr << "Cannot transcode '" << sampleFile.path.string() << "': " << e.what() << std::endl;
+						}
+
+						std::scoped_lock lock {resultMutex};
+						if (!timeToFirstByte)
+						{
+							result.errorCount++;
+							continue;
+						}
+
+						result.timesToFirstByte.add(*timeToFirstByte);
+						result.outputSize += outputSize;
+						result.audioDuration += sampleFile.duration;
+					}
+				});
+			}
+
+			for (std::thread& worker : workers)
+				worker.join();
+		}
+		result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+		result.cpuTime = getCpuTime() - cpuTimeBefore;
+
+		return result;
+	}
+
+	void
+	printResult(std::string_view backendName, std::string_view formatName, const RunResult& result)
+	{
+		const double audioMinutes {result.audioDuration.count() / 60000.};
+
+		std::cout << std::left << std::setw(8) << backendName << std::setw(15) << formatName << std::right
+			<< std::setw(7) << result.timesToFirstByte.getCount()
+			<< std::setw(7) << result.errorCount
+			<< std::setw(10) << result.timesToFirstByte.getPercentile(50).count() / 1000
+			<< std::setw(10) << result.timesToFirstByte.getPercentile(90).count() / 1000
+			<< std::setw(10) << result.timesToFirstByte.getPercentile(99).count() / 1000
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(10) << (result.duration.count() ? result.audioDuration.count() / static_cast<double>(result.duration.count()) : 0)
+			<< std::setw(10) << (result.duration.count() ? result.outputSize / 1024. / (result.duration.count() / 1000.) : 0)
+			<< std::setprecision(2)
+			<< std::setw(12) << (audioMinutes > 0 ? result.cpuTime.count() / 1000000. / audioMinutes : 0)
+			<< std::endl;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		namespace po = boost::program_options;
+
+		po::options_description desc{"Allowed options"};
+		desc.add_options()
+		("help,h", "print usage message")
+		("conf,c", po::value<std::string>()->default_value("/etc/lms.conf"), "LMS config file, used for the ffmpeg path and the libav thread count")
+		("backends,b", po::value<std::string>()->default_value("all"), "Comma separated transcoder backends to compare (ffmpeg, libav), or 'all'")
+		("formats,f", po::value<std::string>()->default_value("all"), "Comma separated output formats (mp3, ogg_opus, matroska_opus, ogg_vorbis, webm_vorbis), or 'all'")
+		("bitrate", po::value<std::size_t>()->default_value(128000), "Output bitrate")
+		("concurrency,j", po::value<std::size_t>()->default_value(4), "Number of concurrent transcodes")
+		("transcode-count,n", po::value<std::size_t>(), "Number of transcodes per backend and format (default: number of files, at least the concurrency)")
+		("read-size", po::value<std::size_t>()->default_value(32768), "Size of each read, the time to first byte is the time to get the first one")
+		("verbose,v", "Log LMS messages")
+		("input", po::value<std::vector<std::string>>()->required(), "Audio files or directories")
+		;
+
+		po::positional_options_description positional;
+		positional.add("input", -1);
+
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+
+		if (vm.count("help"))
+		{
+			std::cout << "Usage: " << argv[0] << " [options] input..." << std::endl << desc << std::endl;
+			return EXIT_SUCCESS;
+		}
+		po::notify(vm);
+
+		std::ostream nullStream {nullptr};
+		Service<Logger> logger {std::make_unique<StreamLogger>(vm.count("verbose") ? std::cout : nullStream)};
+		Service<IConfig> config {createConfig(vm["conf"].as<std::string>())};
+
+		// ffmpeg outputs are read using the io context
+		boost::asio::io_context ioContext;
+		IOContextRunner ioContextRunner {ioContext, std::max<unsigned>(std::thread::hardware_concurrency(), 1)};
+		Service<IChildProcessManager> childProcessManager {createChildProcessManager(ioContext)};
+
+		const std::vector<BackendInfo> backends {selectInfos(backendInfos, vm["backends"].as<std::string>())};
+		const std::vector<FormatInfo> formats {selectInfos(formatInfos, vm["formats"].as<std::string>())};
+
+		std::cout << "Looking for audio files..." << std::endl;
+		const std::vector<SampleFile> sampleFiles {findSampleFiles(vm["input"].as<std::vector<std::string>>())};
+		if (sampleFiles.empty())
+			throw std::runtime_error {"No audio file found"};
+
+		std::chrono::milliseconds sampleFilesDuration {};
+		for (const SampleFile& sampleFile : sampleFiles)
+			sampleFilesDuration += sampleFile.duration;
+
+		const std::size_t concurrency {std::max<std::size_t>(vm["concurrency"].as<std::size_t>(), 1)};
+		const std::size_t transcodeCount {vm.count("transcode-count") ? vm["transcode-count"].as<std::size_t>() : std::max(sampleFiles.size(), concurrency)};
+
+		std::cout << "Found " << sampleFiles.size() << " files (" << std::chrono::duration_cast<std::chrono::seconds>(sampleFilesDuration).count() << "s of audio)" << std::endl;
+		std::cout << "Running " << transcodeCount << " transcodes per backend and format, " << concurrency << " at a time..." << std::endl;
+
+		std::cout << std::endl << std::left << std::setw(8) << "backend" << std::setw(15) << "format" << std::right
+			<< std::setw(7) << "count" << std::setw(7) << "errors"
+			<< std::setw(10) << "p50 (ms)" << std::setw(10) << "p90 (ms)" << std::setw(10) << "p99 (ms)"
+			<< std::setw(10) << "realtime" << std::setw(10) << "KB/s" << std::setw(12) << "cpu s/min" << std::endl;
+
+		for (const FormatInfo& format : formats)
+		{
+			for (const BackendInfo& backend : backends)
+			{
+				const RunParameters runParameters
+				{
+					backend.backend,
+					format.format,
+					vm["bitrate"].as<std::size_t>(),
+					concurrency,
+					transcodeCount,
+					std::max<std::size_t>(vm["read-size"].as<std::size_t>(), 1),
+				};
+
+				printResult(backend.name, format.name, run(runParameters, sampleFiles));
+			}
+		}
+
+		std::cout << std::endl << "p50/p90/p99: time to first byte, realtime: audio duration transcoded per wall second, cpu s/min: CPU seconds per minute of audio" << std::endl;
+	}
+	catch (const boost::program_options::error& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Caught exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -17,73 +17,317 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
 #include <unistd.h>
 
-#include <array>
-#include <fstream>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 
+#include <boost/program_options.hpp>
+
+#include "utils/Path.hpp"
 #include "utils/Service.hpp"
 #include "utils/StreamLogger.hpp"
+#include "utils/String.hpp"
 #include "utils/Zipper.hpp"
 
-int main(int argc, char* argv[])
+namespace
 {
-	// log to stdout
-	Service<Logger> logger {std::make_unique<StreamLogger>(std::cout)};
+	using FileMap = std::map<std::string, std::filesystem::path>;
 
-	if (argc < 2)
+	enum class WriteMethod
 	{
-		std::cerr << "Usage: <archive> <file> [...]" << std::endl;
-		return EXIT_FAILURE;
-	}
-
-	std::filesystem::path zipPath {argv[1]};
+		Stream,	// file contents copied in the output buffer by the zipper
+		Extent,	// file contents sent straight from the files
+	};
 
-	std::map<std::string, std::filesystem::path> files;
-	for (int i {2}; i < argc; ++i)
+	std::string_view
+	toString(WriteMethod method)
 	{
-		std::filesystem::path path {argv[i]};
-		files.emplace(path.relative_path(), path);
+		switch (method)
+		{
+			case WriteMethod::Stream:	return "stream";
+			case WriteMethod::Extent:	return "extent";
+		}
+
+		return "";
 	}
 
+	// Closed on destruction
+	class FileDescriptor
+	{
+		public:
+			FileDescriptor(const std::filesystem::path& path, int flags)
+			: _fd {::open(path.c_str(), flags, 0644)}
+			{
+				if (_fd < 0)
+					throw std::runtime_error {"Cannot open file '" + path.string() + "': " + std::strerror(errno)};
+			}
+
+			~FileDescriptor() { ::close(_fd); }
+
+			FileDescriptor(const FileDescriptor&) = delete;
+			FileDescriptor& operator=(const FileDescriptor&) = delete;
 
-	std::cout << "Compressing " << files.size() << " files..." << std::endl;
+			int get() const { return _fd; }
 
-	using namespace Zip;
+		private:
+			const int _fd;
+	};
 
-	std::ofstream ofs {zipPath.string().c_str(), std::ios_base::binary};
-	if (!ofs)
+	void
+	writeAll(int fd, const std::byte* data, std::size_t size)
 	{
-		std::cerr << "Cannot open file '" << zipPath.string() << "' for writing";
-		return EXIT_FAILURE;
+		while (size > 0)
+		{
+			const ::ssize_t res {::write(fd, data, size)};
+			if (res < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				throw std::runtime_error {std::string {"Write error: "} + std::strerror(errno)};
+			}
+
+			data += res;
+			size -= res;
+		}
 	}
 
-	try
+	void
+	sendExtent(int outputFd, const Zip::Zipper::FileDataExtent& extent)
+	{
+		const FileDescriptor input {extent.filePath, O_RDONLY};
+
+		::off_t offset {static_cast<::off_t>(extent.offset)};
+		Zip::SizeType remainingSize {extent.size};
+		while (remainingSize > 0)
+		{
+			const ::ssize_t res {::sendfile(outputFd, input.get(), &offset, remainingSize)};
+			if (res < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				throw std::runtime_error {"Cannot send file '" + extent.filePath.string() + "': " + std::strerror(errno)};
+			}
+			if (res == 0)
+				throw std::runtime_error {"File '" + extent.filePath.string() + "': unexpected end of file"};
+
+			remainingSize -= res;
+		}
+	}
+
+	using Crc32Map = std::map<std::string, std::uint32_t>;
+
+	// Written size
+	Zip::SizeType
+	writeZip(const FileMap& files, const std::filesystem::path& outputPath, std::size_t bufferSize, WriteMethod method, const Crc32Map* crc32s)
 	{
-		Zipper zipper {files};
+		Zip::Zipper zipper {files};
+		if (crc32s)
+		{
+			for (const auto& [fileName, crc32] : *crc32s)
+				zipper.setCrc32(fileName, crc32);
+		}
+		if (method == WriteMethod::Extent)
+			zipper.enableFileDataExtents();
+
+		const FileDescriptor output {outputPath, O_WRONLY | O_CREAT | O_TRUNC};
 
+		std::vector<std::byte> buffer(std::max<std::size_t>(bufferSize, Zip::Zipper::minOutputBufferSize));
 		Zip::SizeType nbTotalWrittenBytes {};
 		while (!zipper.isComplete())
 		{
-			//std::array<std::byte, Zipper::minOutputBufferSize> buffer;
-			std::array<std::byte, 65536> buffer;
+			if (const std::optional<Zip::Zipper::FileDataExtent> extent {zipper.takeFileDataExtent()})
+			{
+				sendExtent(output.get(), *extent);
+				nbTotalWrittenBytes += extent->size;
+				continue;
+			}
 
 			const Zip::SizeType nbWrittenBytes {zipper.writeSome(buffer.data(), buffer.size())};
-			ofs.write(reinterpret_cast<const char*>(buffer.data()), nbWrittenBytes);
+			writeAll(output.get(), buffer.data(), nbWrittenBytes);
 			nbTotalWrittenBytes += nbWrittenBytes;
 		}
 
 		if (nbTotalWrittenBytes != zipper.getTotalZipFile())
-			std::cerr << "ERROR: actual size mismatch!" << std::endl;
+			throw std::runtime_error {"Actual size mismatch!"};
+
+		return nbTotalWrittenBytes;
+	}
+
+	// Stands for the checksums that would be stored in the database
+	Crc32Map
+	computeCrc32s(const FileMap& files)
+	{
+		Crc32Map res;
+		for (const auto& [fileName, filePath] : files)
+			res.emplace(fileName, computeCrc32(filePath));
+
+		return res;
+	}
+
+	std::chrono::duration<double>
+	getCpuTime()
+	{
+		struct ::rusage usage {};
+		::getrusage(RUSAGE_SELF, &usage);
+
+		auto toDuration {[](const ::timeval& tv) { return std::chrono::seconds {tv.tv_sec} + std::chrono::microseconds {tv.tv_usec}; }};
+		return toDuration(usage.ru_utime) + toDuration(usage.ru_stime);
+	}
+
+	void
+	bench(const FileMap& files, const std::filesystem::path& outputPath, const std::vector<std::size_t>& bufferSizes, std::size_t iterationCount)
+	{
+		const Crc32Map crc32s {computeCrc32s(files)};	// also warms up the page cache
+
+		std::cout << std::left << std::setw(8) << "method" << std::setw(13) << "crc" << std::right << std::setw(12) << "buffer" << std::setw(12) << "MB/s" << std::setw(14) << "CPU (ms)" << std::setw(14) << "wall (ms)" << std::endl;
+
+		for (const std::size_t bufferSize : bufferSizes)
+		{
+			for (const WriteMethod method : {WriteMethod::Stream, WriteMethod::Extent})
+			{
+				for (const bool precomputedCrc32 : {false, true})
+				{
+					Zip::SizeType writtenSize {};
+					const auto cpuStart {getCpuTime()};
+					const auto start {std::chrono::steady_clock::now()};
+					for (std::size_t i {}; i < iterationCount; ++i)
+						writtenSize += writeZip(files, outputPath, bufferSize, method, precomputedCrc32 ? &crc32s : nullptr);
+					const std::chrono::duration<double> duration {std::chrono::steady_clock::now() - start};
+					const std::chrono::duration<double> cpuDuration {getCpuTime() - cpuStart};
 
-		std::cout << "Total zip size = " << zipper.getTotalZipFile() << std::endl;
+					std::cout << std::left << std::setw(8) << toString(method) << std::setw(13) << (precomputedCrc32 ? "precomputed" : "on-the-fly")
+						<< std::right << std::setw(12) << bufferSize << std::fixed << std::setprecision(1)
+						<< std::setw(12) << (duration.count() > 0 ? writtenSize / duration.count() / (1000 * 1000) : 0)
+						<< std::setw(14) << std::chrono::duration<double, std::milli> {cpuDuration}.count() / iterationCount
+						<< std::setw(14) << std::chrono::duration<double, std::milli> {duration}.count() / iterationCount
+						<< std::endl;
+				}
+			}
+		}
+
+		std::cout << std::endl << "on-the-fly: checksums computed while writing (read again from the files by the extent method)" << std::endl;
+	}
+
+	// Directories are added recursively, using paths relative to their parent (ex: "Artist/Release/Track.mp3")
+	FileMap
+	collectFiles(const std::vector<std::string>& inputs)
+	{
+		FileMap files;
+
+		for (const std::filesystem::path input : inputs)
+		{
+			std::error_code ec;
+			if (!std::filesystem::is_directory(input, ec))
+			{
+				files.emplace(input.relative_path().string(), input);
+				continue;
+			}
+
+			const std::filesystem::path basePath {input.lexically_normal().parent_path()};
+			exploreFilesRecursive(input, [&](std::error_code ec, const std::filesystem::path& path)
+			{
+				if (!ec)
+					files.emplace(path.lexically_normal().lexically_relative(basePath).string(), path);
+				return true;
+			});
+		}
+
+		return files;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		namespace po = boost::program_options;
+
+		// log to stdout
+		Service<Logger> logger {std::make_unique<StreamLogger>(std::cout)};
+
+		po::options_description desc{"Allowed options"};
+		desc.add_options()
+		("help,h", "print usage message")
+		("benchmark,b", "compare the write methods, checksum modes and buffer sizes (use /dev/null as output)")
+		("buffer-sizes,s", po::value<std::string>()->default_value("65536"), "Comma separated output buffer sizes")
+		("method,m", po::value<std::string>()->default_value("stream"), "Write method, if not benchmarking (stream, extent)")
+		("iterations,n", po::value<std::size_t>()->default_value(3), "Number of zips per benchmark run")
+		("output", po::value<std::string>()->required(), "Output zip file")
+		("input", po::value<std::vector<std::string>>()->required(), "Files or directories to add (ex: release or artist directories)")
+		;
+
+		po::positional_options_description positional;
+		positional.add("output", 1);
+		positional.add("input", -1);
+
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+
+		if (vm.count("help"))
+		{
+			std::cout << "Usage: " << argv[0] << " [options] <output> <input> [...]" << std::endl << desc << std::endl;
+			return EXIT_SUCCESS;
+		}
+		po::notify(vm);
+
+		std::vector<std::size_t> bufferSizes;
+		for (std::string_view bufferSize : StringUtils::splitString(vm["buffer-sizes"].as<std::string>(), ","))
+		{
+			const std::optional<std::size_t> value {StringUtils::readAs<std::size_t>(bufferSize)};
+			if (!value || *value < Zip::Zipper::minOutputBufferSize)
+				throw std::runtime_error {"Bad buffer size '" + std::string {bufferSize} + "', min is " + std::to_string(Zip::Zipper::minOutputBufferSize)};
+
+			bufferSizes.push_back(*value);
+		}
+
+		const std::filesystem::path outputPath {vm["output"].as<std::string>()};
+		const FileMap files {collectFiles(vm["input"].as<std::vector<std::string>>())};
+
+		std::cout << "Compressing " << files.size() << " files..." << std::endl;
+
+		if (vm.count("benchmark"))
+		{
+			bench(files, outputPath, bufferSizes, std::max<std::size_t>(vm["iterations"].as<std::size_t>(), 1));
+		}
+		else
+		{
+			const std::string method {vm["method"].as<std::string>()};
+			if (method != toString(WriteMethod::Stream) && method != toString(WriteMethod::Extent))
+				throw std::runtime_error {"Bad method '" + method + "'"};
+
+			const Zip::SizeType zipSize {writeZip(files, outputPath, bufferSizes.front(), method == toString(WriteMethod::Stream) ? WriteMethod::Stream : WriteMethod::Extent, nullptr)};
+			std::cout << "Total zip size = " << zipSize << std::endl;
+		}
+	}
+	catch (const boost::program_options::error& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
 	}
-	catch (const ZipperException& e)
+	catch (const Zip::ZipperException& e)
 	{
 		std::cerr << "Caught Zipper exception: " << e.what() << std::endl;
 		return EXIT_FAILURE;
 	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Caught exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
 
 	return EXIT_SUCCESS;
 }